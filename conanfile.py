@@ -57,6 +57,7 @@ class HomestoreConan(ConanFile):
         self.requires("nuraft_mesg/[^3.4]@oss/main", transitive_headers=True)
 
         self.requires("farmhash/cci.20190513@", transitive_headers=True)
+        self.requires("lz4/1.9.4")
         if self.settings.arch in ['x86', 'x86_64']:
             self.requires("isa-l/2.30.0", transitive_headers=True)
 
@@ -93,8 +93,15 @@ public:
 struct MultiBlkId : public BlkId {
     static constexpr uint32_t max_addln_pieces{5};
     static constexpr uint32_t max_pieces{max_addln_pieces + 1};
+    static constexpr uint8_t compact_version{1};
 
 private:
+    // First byte of the compact encoding, whose lowest bit is never set, unlike the first byte of the full encoding
+    // which has the multi bit there
+    static constexpr uint8_t s_compact_tag_base{0xC0};
+
+    void deserialize_compact(sisl::blob const& b);
+
     struct chain_blkid {
         blk_num_t m_blk_num;
         blk_count_t m_nblks{0};
@@ -129,6 +136,23 @@ public:
     uint32_t serialized_size() const;
     void deserialize(sisl::blob const& b, bool copy);
 
+    /*
+     * Compact encoding, which takes the chunk number once and only as many bytes for the blk numbers and counts as
+     * their values need, behind a version tag. Widths can be raised to at least the given ones, so that all the blkids
+     * of the same number of pieces and widths are of the same size, like when one has to be replaced in place by
+     * another. deserialize takes either encoding.
+     */
+    struct compact_widths {
+        uint8_t chunk_num{1}; // 1 or 2 bytes
+        uint8_t blk_num{1};   // 1 to 4 bytes
+        uint8_t nblks{1};     // 1 or 2 bytes
+    };
+    compact_widths needed_compact_widths() const;
+    uint32_t compact_serialized_size(compact_widths const& min_widths = {}) const;
+    uint32_t serialize_compact(uint8_t* buf, compact_widths const& min_widths = {}) const;
+    static uint32_t compact_serialized_size(uint16_t num_pieces, compact_widths const& widths);
+    static bool is_compact(sisl::blob const& b);
+
     bool has_room() const;
     BlkId to_single_blkid() const;
 
@@ -247,11 +271,22 @@ VENUM(BlkAllocStatus, uint32_t,
       TOO_MANY_PIECES = 1ul << 8 // Allocation results in more pieces than passed on
 );
 
+// Temperature of the data, callers can tag the allocation with. Blks of same temperature are allocated from the same
+// set of portions of a chunk, so that the data which is rewritten or freed together is co-located.
+// Temperatures beyond the configured num_blk_temperatures are folded to the coldest one.
+struct blk_temp {
+    static constexpr blk_temp_t any{0}; // No preference, reuse recently freed blks
+    static constexpr blk_temp_t hot{1};
+    static constexpr blk_temp_t warm{2};
+    static constexpr blk_temp_t cold{3};
+};
+
 struct blk_alloc_hints {
-    blk_temp_t desired_temp{0};                  // Temperature hint for the device
+    blk_temp_t desired_temp{blk_temp::any};      // Temperature hint for the device
     std::optional< uint32_t > pdev_id_hint;      // which physical device to pick (hint if any) -1 for don't care
     std::optional< chunk_num_t > chunk_id_hint;  // any specific chunk id to pick for this allocation
     std::optional< stream_id_t > stream_id_hint; // any specific stream to pick
+    std::optional< uint64_t > tenant_id_hint;    // tenant whose blks are kept together, by tenant affine selector
     bool can_look_for_other_chunk{true};         // If alloc on device not available can I pick other device
     bool is_contiguous{true};                    // Should the entire allocation be one contiguous block
     bool partial_alloc_ok{false};   // ok to allocate only portion of nblks? Mutually exclusive with is_contiguous
@@ -15,8 +15,14 @@
  *********************************************************************************/
 #pragma once
 #include <sys/uio.h>
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
 
+#include <folly/Function.h>
 #include <folly/small_vector.h>
 #include <folly/futures/Future.h>
 #include <sisl/fds/buffer.hpp>
@@ -29,10 +35,72 @@ namespace homestore {
 // callback type for caller to provide
 typedef std::function< void(std::error_condition) > io_completion_cb_t;
 
+// Returns the blkids of the given chunk which are still referenced by the consumer, used by compaction
+using live_blks_cb_t = std::function< std::vector< BlkId >(chunk_num_t) >;
+
+// Called by compaction once a live blkid is copied to its new location, for the consumer to repoint its mapping
+using relocate_blk_cb_t = std::function< void(BlkId const& from, MultiBlkId const& to) >;
+
+class BlkDataService;
+
+/*
+ * Completion state of a callback based io of BlkDataService, which caller embeds in its own io request. Callback is set
+ * once and the same context is then used for one io after another, with no heap allocation per io by HomeStore when
+ * the data vdev goes through io_uring. Context is owned by HomeStore from the submission of an io till its callback is
+ * called, it must neither be destroyed nor used for another io in that window.
+ */
+class data_io_ctx {
+public:
+    data_io_ctx() = default;
+    explicit data_io_ctx(io_completion_cb_t cb) : m_cb{std::move(cb)} {}
+    data_io_ctx(data_io_ctx const&) = delete;
+    data_io_ctx& operator=(data_io_ctx const&) = delete;
+    data_io_ctx(data_io_ctx&&) noexcept = delete;
+    data_io_ctx& operator=(data_io_ctx&&) noexcept = delete;
+    ~data_io_ctx() = default;
+
+    void set_completion_cb(io_completion_cb_t cb) { m_cb = std::move(cb); }
+
+private:
+    friend class BlkDataService;
+
+    // Device io of one piece of the blkid
+    struct piece_req : public dev_io_req {
+        data_io_ctx* ctx{nullptr};
+        BlkId bid;
+        uint8_t* buf{nullptr};      // Buffer of the piece, if it is not an sg io
+        sisl::sg_iovs_t iovs;       // Iovs of the piece of an sg io, which have to be valid till device io completes
+        void* read_ticket{nullptr}; // Counter of the read in read epoch tracker, if it is enabled
+    };
+
+    io_completion_cb_t m_cb;
+    BlkDataService* m_svc{nullptr};
+    bool m_is_read{false};
+    uint64_t m_start_ticks{0}; // Tsc of the start of the io, for its latency
+    std::atomic< uint32_t > m_pending{0};
+    std::atomic< bool > m_failed{false};
+    std::error_code m_ec; // Set only by the first failed piece, read by the last piece
+    std::array< piece_req, MultiBlkId::max_pieces > m_pieces;
+};
+
+// Location of a small write which is packed with other small writes into a shared blk
+struct packed_blk_loc {
+    BlkId bid;
+    uint32_t offset{0}; // Offset of the data within the blk
+    uint32_t size{0};
+
+    std::string to_string() const { return fmt::format("{}@{}+{}", bid.to_string(), offset, size); }
+};
+
 class VirtualDev;
 struct vdev_info;
 struct stream_info_t;
 class BlkReadTracker;
+class ReadEpochTracker;
+class BlkReadCache;
+class SmallWritePacker;
+class BlkReadMerger;
+class SeqReadPrefetcher;
 struct blk_alloc_hints;
 class ChunkSelector;
 
@@ -64,9 +132,10 @@ public:
      * @param alloc_type The type of block allocator to use for the virtual device.
      * @param chunk_sel_type The type of chunk selector to use for the virtual device.
      * @param num_chunks The number of chunks to use for the virtual device.
+     * @param integrity_offload Check data integrity by the protection info of the drives, if they all have it.
      */
     void create_vdev(uint64_t size, HSDevType devType, uint32_t blk_size, blk_allocator_type_t alloc_type,
-                     chunk_selector_type_t chunk_sel_type, uint32_t num_chunks);
+                     chunk_selector_type_t chunk_sel_type, uint32_t num_chunks, bool integrity_offload = false);
 
     /**
      * @brief Opens a virtual device with the specified virtual device information.
@@ -113,7 +182,10 @@ public:
                                                  bool part_of_batch = false);
 
     /**
-     * @brief Asynchronously reads data from the specified block ID into the provided buffer.
+     * @brief Asynchronously reads data from the specified block ID into the provided buffer. If the read cache is
+     * enabled by resource_limits.data_read_cache_percent, it is served from cache where possible.
+     * Device reads of adjacent blks are merged, if generic.data_read_merge_window_us is set.
+     * Sequential reads are prefetched into the read cache, if generic.data_read_prefetch_max_reads is set.
      *
      * @param bid The ID of the block to read from.
      * @param buf The buffer to read data into.
@@ -137,6 +209,80 @@ public:
     folly::Future< std::error_code > async_read(MultiBlkId const& bid, sisl::sg_list& sgs, uint32_t size,
                                                 bool part_of_batch = false);
 
+    /**
+     * @brief Checksummed variants of async_alloc_write, async_write and async_read. Writes compute CRC32C of every blk
+     * of the data, in the order of the blks of the blkid, which caller stores along with the blkid and passes to the
+     * reads of it. Reads verify the crc of every whole blk which is read and fail with std::errc::bad_message if any of
+     * them mismatch. CRC32C is computed with SSE4.2 or ARMv8 crc instructions if the cpu has them.
+     *
+     * If the vdev is formatted with integrity offload, drives check the data by their protection info instead, writes
+     * return no crcs and reads fail with the error of the drive on a mismatch.
+     *
+     * @param out_crcs Crcs of the blks written, set before the write is submitted.
+     * @param crcs Crcs returned by the write of the blkid, which are copied.
+     * Arguments otherwise are the same as the variants without crcs.
+     */
+    folly::Future< std::error_code > async_alloc_write(sisl::sg_list const& sgs, blk_alloc_hints const& hints,
+                                                       MultiBlkId& out_blkids, std::vector< crc32_t >& out_crcs,
+                                                       bool part_of_batch = false);
+    folly::Future< std::error_code > async_write(const char* buf, uint32_t size, MultiBlkId const& bid,
+                                                 std::vector< crc32_t >& out_crcs, bool part_of_batch = false);
+    folly::Future< std::error_code > async_write(sisl::sg_list const& sgs, MultiBlkId const& bid,
+                                                 std::vector< crc32_t >& out_crcs, bool part_of_batch = false);
+    folly::Future< std::error_code > async_read(MultiBlkId const& bid, uint8_t* buf, uint32_t size,
+                                                std::vector< crc32_t > const& crcs, bool part_of_batch = false);
+    folly::Future< std::error_code > async_read(MultiBlkId const& bid, sisl::sg_list& sgs, uint32_t size,
+                                                std::vector< crc32_t > const& crcs, bool part_of_batch = false);
+
+    /**
+     * @brief Callback based variants of async_read and async_write, which call the callback of ctx once the io
+     * completes instead of returning a future. They do not allocate per io when the data vdev goes through io_uring
+     * (device.data_vdev_uring), in which case callback is called on the completion thread of the drive, else it is
+     * called on the thread which completes the io. Callback could also be called inline, like on a read cache hit or
+     * if the io could not be submitted.
+     *
+     * @param ctx : Completion state of the io, which caller keeps alive along with the buffers till the callback.
+     * Arguments otherwise are the same as the future based variants.
+     */
+    void async_read(MultiBlkId const& bid, uint8_t* buf, uint32_t size, data_io_ctx& ctx, bool part_of_batch = false);
+    void async_read(MultiBlkId const& bid, sisl::sg_list const& sgs, uint32_t size, data_io_ctx& ctx,
+                    bool part_of_batch = false);
+    void async_write(const char* buf, uint32_t size, MultiBlkId const& bid, data_io_ctx& ctx,
+                     bool part_of_batch = false);
+    void async_write(sisl::sg_list const& sgs, MultiBlkId const& bid, data_io_ctx& ctx, bool part_of_batch = false);
+
+    /**
+     * @brief Asynchronously writes data smaller than a blk, by packing it with other small writes into a shared blk.
+     * Requires generic.data_packed_writes. The shared blk is written once it has no room for another write or once
+     * generic.data_packed_write_flush_us has passed since its first write, upon which the future is completed.
+     *
+     * @param sgs The data to write, of at most blk size.
+     * @param hints Hints for allocating the shared blk, used only if this write opens a new one.
+     * @param out_loc Location of the data, set before this returns and which can be read from right away.
+     * @return A Future that will resolve to an error code once the shared blk is written.
+     */
+    folly::Future< std::error_code > async_packed_write(sisl::sg_list const& sgs, blk_alloc_hints const& hints,
+                                                        packed_blk_loc& out_loc);
+
+    /**
+     * @brief Asynchronously reads the data of a packed write.
+     *
+     * @param loc Location of the data, as returned by async_packed_write.
+     * @param buf Buffer to read the data into, of at least loc.size bytes.
+     */
+    folly::Future< std::error_code > async_packed_read(packed_blk_loc const& loc, uint8_t* buf);
+
+    /**
+     * @brief Frees the data of a packed write. The shared blk is freed once all the data packed into it is freed.
+     */
+    folly::Future< std::error_code > async_packed_free(packed_blk_loc const& loc);
+
+    /**
+     * @brief Commits the location of a packed write on recovery. Since the count of live data in a shared blk is not
+     * persisted, every location still in use has to be committed before any packed write or free.
+     */
+    void commit_packed(packed_blk_loc const& loc);
+
     /**
      * @brief Commits the block with the given MultiBlkId.
      *
@@ -154,6 +300,18 @@ public:
      */
     BlkAllocStatus alloc_blks(uint32_t size, blk_alloc_hints const& hints, MultiBlkId& out_blkids);
 
+    /**
+     * @brief Allocates blocks for a batch of requests of given sizes in one call, amortizing the chunk selection
+     * across them. Either all of the requests are allocated or none of them.
+     *
+     * @param sizes The size of each request to allocate, in bytes.
+     * @param hints Hints for how to allocate the blocks, applied to all requests.
+     * @param out_blkids Output parameter to which the allocated blkids of each request are appended, in order.
+     * @return The status of the batch allocation attempt.
+     */
+    BlkAllocStatus alloc_blks(std::vector< uint32_t > const& sizes, blk_alloc_hints const& hints,
+                              std::vector< MultiBlkId >& out_blkids);
+
     /**
      * @brief Asynchronously frees the specified block IDs.
      * It is asynchronous because it might need to wait for pending read to complete if same block is being read and not
@@ -178,6 +336,15 @@ public:
      */
     uint32_t get_align_size() const;
 
+    /**
+     * @brief : get the widths of the compact encoding of blkids of this data service, which fit any of its blkids of
+     * the given number of blks. Replicas with data vdevs of the same chunks get the same widths.
+     *
+     * @param nblks : number of blks of the blkid
+     * @return : widths of the compact encoding
+     */
+    MultiBlkId::compact_widths compact_blkid_widths(blk_count_t nblks) const;
+
     /**
      * @brief : get the read block tracker handle;
      *
@@ -185,6 +352,30 @@ public:
      */
     BlkReadTracker* read_blk_tracker() { return m_blk_read_tracker.get(); }
 
+    /**
+     * @brief : Calls back once the reads on the given blkids, which are pending at the time of this call, complete.
+     * Depending on generic.data_read_epoch_tracking, it could also wait for pending reads of other blkids.
+     *
+     * @param blkids : blkids that caller wants to wait on for pending reads;
+     * @param cb : the callback, called inline if there are no pending reads to wait for;
+     */
+    void wait_for_pending_reads(MultiBlkId const& blkids, folly::Function< void(void) >&& cb);
+
+    /**
+     * @brief : Drops the blks of the given chunk from the read cache, for blks which are reused without being freed,
+     * like on reset of the chunk. No-op if resource_limits.data_read_cache_percent is 0.
+     *
+     * @param chunk_num : chunk whose blks are to be dropped;
+     */
+    void invalidate_read_cache(chunk_num_t chunk_num);
+
+    /**
+     * @brief : get the read cache handle;
+     *
+     * @return : the read cache pointer, nullptr if the cache is not enabled;
+     */
+    BlkReadCache* read_cache() { return m_read_cache.get(); }
+
     /**
      * @brief Starts the block data service.
      *
@@ -194,10 +385,43 @@ public:
      */
     void start();
 
+    /**
+     * @brief Stops the background activity of the service, like writing out the pending packed writes. Called on
+     * shutdown, before checkpointing is stopped.
+     */
+    void stop();
+
     uint64_t get_total_capacity() const;
 
     uint64_t get_used_capacity() const;
 
+    /**
+     * @brief : get the health of the devices of this data service, as the lowest of their health scores, from 0 when
+     * every recent io of a device is slow or failing to 100 when none is. Consumers like the replication layer can use
+     * it to steer work away from this replica while one of its devices is sick.
+     *
+     * @return : health score
+     */
+    uint32_t health_score() const;
+
+    /**
+     * @brief Checks if all the blks of the blkid are allocated in the allocators of their chunks, like the scrub of
+     * the index tables does for the blkids their entries refer to.
+     */
+    bool is_blk_alloced(MultiBlkId const& blkid) const;
+
+    /**
+     * @brief Compacts the most fragmented chunks of an append blk allocator based data service, by relocating
+     * their live blks to other chunks and resetting them. Only one compaction runs at a time, it runs synchronously
+     * and it is throttled by blkallocator.append_gc_max_bandwidth_mbps.
+     *
+     * @param live_cb Provides the blkids of a victim chunk which are still in use.
+     * @param relocate_cb Called after each live blkid is copied, for the consumer to use the new blkid instead.
+     * The updated mapping has to be persisted on or before the next CP, which compaction forces before the reset.
+     * @return Number of blks reclaimed.
+     */
+    uint64_t compact(live_blks_cb_t const& live_cb, relocate_blk_cb_t const& relocate_cb);
+
 private:
     /**
      * @brief Initializes the block data service.
@@ -217,11 +441,38 @@ private:
      */
     static void process_data_completion(std::error_condition ec, void* cookie);
 
+    /**
+     * @brief Consults the admission control of the resource manager for a write of the given size, blocking the
+     * caller for the throttle delay if it is admitted.
+     *
+     * @return false if the write is rejected, to be retried by the caller.
+     */
+    bool admit_write(uint64_t size);
+
+    std::error_code verify_blk_crcs(MultiBlkId const& bid, sisl::sg_iovs_t const& iovs, uint32_t size,
+                                    std::vector< crc32_t > const& crcs);
+    folly::Future< std::error_code > vdev_read(BlkId const& bid, uint8_t* buf, uint32_t size, bool part_of_batch);
+    folly::Future< std::error_code > vdev_readv(BlkId const& bid, sisl::sg_iovs_t iovs, uint32_t size,
+                                                bool part_of_batch);
+    folly::Future< std::error_code > written(folly::Future< std::error_code >&& f, MultiBlkId const& blkid);
+    void start_io(data_io_ctx& ctx, uint32_t npieces, bool is_read);
+    void submit_read(data_io_ctx::piece_req& p, bool part_of_batch);
+    void read_done(data_io_ctx::piece_req& p, std::error_code const& ec);
+    static void on_piece_completion(dev_io_req* req, std::error_code ec);
+    static void complete_piece(data_io_ctx& ctx, std::error_code const& ec);
+
 private:
     std::shared_ptr< VirtualDev > m_vdev;
     std::unique_ptr< BlkReadTracker > m_blk_read_tracker;
+    std::unique_ptr< ReadEpochTracker > m_read_epoch_tracker; // Used instead of read tracker when enabled
+    std::unique_ptr< BlkReadCache > m_read_cache;
+    std::unique_ptr< SmallWritePacker > m_packer; // Created on start, if packed writes are enabled
+    std::unique_ptr< BlkReadMerger > m_read_merger; // Created on start, if read merging is enabled
+    std::unique_ptr< SeqReadPrefetcher > m_prefetcher; // Created on start, if prefetch is enabled
     std::shared_ptr< ChunkSelector > m_custom_chunk_selector;
     uint32_t m_blk_size;
+    MultiBlkId::compact_widths m_blkid_widths{.chunk_num = 2, .blk_num = 4, .nblks = 2}; // Set on start
+    std::mutex m_compact_mtx;
 };
 
 extern BlkDataService& data_service();
@@ -17,6 +17,11 @@
 
 #include <atomic>
 #include <array>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <unordered_map>
 
 #include <boost/intrusive_ptr.hpp>
 #include <folly/small_vector.h>
@@ -26,6 +31,7 @@
 #include "btree_kv.hpp"
 #include <homestore/btree/detail/btree_internal.hpp>
 #include <homestore/btree/detail/btree_node.hpp>
+#include <homestore/btree/detail/btree_range_lock.hpp>
 
 SISL_LOGGING_DECL(btree)
 
@@ -100,6 +106,22 @@ protected:
 protected:
     BtreeConfig m_bt_cfg;
 
+    struct key_less {
+        bool operator()(K const& a, K const& b) const { return a.compare(b) < 0; }
+    };
+
+    // Keys routing to the underfull nodes, marked by removes in lazy merge mode
+    std::mutex m_underfull_mtx;
+    std::set< K, key_less > m_underfull_keys;
+
+    // High keys of the left leaves of the B-link splits, whose separators are not yet installed in their parents
+    mutable std::mutex m_split_mtx;
+    std::unordered_map< bnodeid_t, K > m_split_high_keys;
+
+    // Key range locks of the serializable queries and the mutations, if turned on in config
+    std::unique_ptr< BtreeRangeLockTable< K > > m_range_locks;
+    using range_write_lock_t = std::optional< typename BtreeRangeLockTable< K >::WriteLock >;
+
 public:
     /////////////////////////////////////// All External APIs /////////////////////////////
     Btree(const BtreeConfig& cfg);
@@ -108,14 +130,28 @@ public:
     template < typename ReqT >
     btree_status_t put(ReqT& put_req);
 
+    // Apply a sorted list of range updates, applying all the updates which fall in a leaf under a single descent
+    btree_status_t put_batch(BtreeBatchRangePutRequest< K >& breq);
+
     template < typename ReqT >
     btree_status_t get(ReqT& get_req) const;
 
     template < typename ReqT >
     btree_status_t remove(ReqT& rreq);
 
+    // Merge upto max_nodes of the underfull nodes marked by the removes in lazy merge mode. Returns has_more if there
+    // are still marked nodes left to be merged
+    btree_status_t rebalance_underfull_nodes(uint32_t max_nodes = std::numeric_limits< uint32_t >::max(),
+                                             void* context = nullptr);
+
     btree_status_t query(BtreeQueryRequest< K >& query_req, std::vector< std::pair< K, V > >& out_values) const;
 
+    // Yield upto max_count entries from where the cursor left off. Returns has_more if cursor is not done with the range
+    btree_status_t cursor_next(BtreeCursor< K >& cursor, uint32_t max_count, cursor_cb_t const& cb) const;
+
+    // Build the tree bottom-up from the key/values, which are expected to be sorted and unique. Tree has to be empty
+    btree_status_t bulk_load(std::vector< std::pair< K, V > > const& sorted_kvs, void* context = nullptr);
+
     // bool verify_tree(bool update_debug_bm) const;
     virtual std::pair< btree_status_t, uint64_t > destroy_btree(void* context);
     nlohmann::json get_status(int log_level) const;
@@ -147,6 +183,8 @@ protected:
     /////////////////////////// Methods the underlying store is expected to handle ///////////////////////////
     virtual BtreeNodePtr alloc_node(bool is_leaf) = 0;
     virtual BtreeNode* init_node(uint8_t* node_buf, bnodeid_t id, bool init_buf, bool is_leaf) const;
+    static BtreeNode* create_btree_node(uint8_t* node_buf, bnodeid_t id, bool init_buf, bool is_leaf,
+                                        BtreeConfig const& cfg);
     virtual btree_status_t read_node_impl(bnodeid_t id, BtreeNodePtr& node) const = 0;
     virtual btree_status_t write_node_impl(const BtreeNodePtr& node, void* context) = 0;
     virtual btree_status_t refresh_node(const BtreeNodePtr& node, bool for_read_modify_write, void* context) const = 0;
@@ -157,6 +195,15 @@ protected:
     virtual btree_status_t on_root_changed(BtreeNodePtr const& root, void* context) = 0;
     virtual std::string btree_store_type() const = 0;
 
+    // Hint to the store to bring the nodes to memory in the background, so that a subsequent read of these nodes does
+    // not wait for the device. Stores which are already in memory need not do anything.
+    virtual void prefetch_nodes(std::vector< bnodeid_t > const& ids) const {}
+
+    // Brackets a lock free descent of the tree. Stores which do not refcount the nodes they hand out in
+    // read_node_impl(), are expected to delay reclaiming the freed nodes until all such readers have exited.
+    virtual uint64_t enter_optimistic_read() const { return 0; }
+    virtual void exit_optimistic_read(uint64_t token) const {}
+
     /////////////////////////// Methods the application use case is expected to handle ///////////////////////////
 
 protected:
@@ -198,6 +245,7 @@ protected:
     btree_status_t post_order_traversal(const BtreeNodePtr& node, locktype_t acq_lock, const auto& cb);
     void get_all_kvs(std::vector< std::pair< K, V > >& kvs) const;
     btree_status_t do_destroy(uint64_t& n_freed_nodes, void* context);
+    btree_status_t destroy_batch(uint64_t& n_freed_nodes, void* context);
     uint64_t get_btree_node_cnt() const;
     uint64_t get_child_node_cnt(bnodeid_t bnodeid) const;
     void to_string(bnodeid_t bnodeid, std::string& buf) const;
@@ -228,11 +276,19 @@ protected:
 
     btree_status_t split_node(const BtreeNodePtr& parent_node, const BtreeNodePtr& child_node, uint32_t parent_ind,
                               K* out_split_key, void* context);
+    K separator_key(const BtreeNodePtr& left_node, const BtreeNodePtr& right_node) const;
+    btree_status_t split_leaf_right(const BtreeNodePtr& leaf_node, void* context);
+    btree_status_t complete_split(const BtreeNodePtr& parent_node, locktype_t& parent_cur_lock,
+                                  const BtreeNodePtr& child_node, locktype_t& child_cur_lock, void* context);
+    bool lock_right_on_split(const BtreeNodePtr& node, const BtreeKey& key, BtreeNodePtr& right_node,
+                             void* context) const;
     btree_status_t mutate_extents_in_leaf(const BtreeNodePtr& my_node, BtreeRangePutRequest< K >& rpreq);
+    void mutate_batch_in_leaf(const BtreeNodePtr& my_node, BtreeRangePutRequest< K >& rpreq);
 
     ///////// Remove Impl Methods
     template < typename ReqT >
     btree_status_t check_collapse_root(ReqT& rreq);
+    void mark_underfull(K&& key);
 
     template < typename ReqT >
     btree_status_t do_remove(const BtreeNodePtr& my_node, locktype_t curlock, ReqT& rreq);
@@ -241,11 +297,25 @@ protected:
                                uint32_t end_indx, void* context);
     bool remove_extents_in_leaf(const BtreeNodePtr& node, BtreeRangeRemoveRequest< K >& rrreq);
 
+    ///////// Bulk Load Impl Methods
+    btree_status_t bulk_build_leaves(std::vector< std::pair< K, V > > const& sorted_kvs,
+                                     std::vector< std::vector< BtreeNodePtr > >& levels);
+    btree_status_t bulk_build_interior_level(std::vector< std::vector< BtreeNodePtr > >& levels);
+    btree_status_t bulk_transact_level(std::vector< BtreeNodePtr > const& parents,
+                                       std::vector< BtreeNodePtr > const& children, void* context);
+
     ///////// Query Impl Methods
     btree_status_t do_sweep_query(BtreeNodePtr& my_node, BtreeQueryRequest< K >& qreq,
                                   std::vector< std::pair< K, V > >& out_values) const;
     btree_status_t do_traversal_query(const BtreeNodePtr& my_node, BtreeQueryRequest< K >& qreq,
                                       std::vector< std::pair< K, V > >& out_values) const;
+    void readahead_children(const BtreeNodePtr& parent_node, uint32_t start_idx) const;
+    void readahead_children(const BtreeNodePtr& parent_node, uint32_t start_idx, uint32_t end_idx) const;
+    btree_status_t cursor_seek(BtreeCursor< K >& cursor, BtreeNodePtr& leaf, uint32_t& idx) const;
+    btree_status_t do_cursor_next(BtreeCursor< K >& cursor, BtreeNodePtr& leaf, uint32_t idx, uint32_t max_count,
+                                  cursor_cb_t const& cb) const;
+    template < typename ReqT >
+    void write_lock_range(ReqT const& req, range_write_lock_t& lock) const;
 #ifdef SERIALIZABLE_QUERY_IMPLEMENTATION
     btree_status_t do_serialzable_query(const BtreeNodePtr& my_node, BtreeSerializableQueryRequest& qreq,
                                         std::vector< std::pair< K, V > >& out_values);
@@ -257,5 +327,8 @@ protected:
     ///////// Get Impl Methods
     template < typename ReqT >
     btree_status_t do_get(const BtreeNodePtr& my_node, ReqT& greq) const;
+    btree_status_t do_optimistic_get(BtreeSingleGetRequest& greq) const;
+    btree_status_t do_multi_get(const BtreeNodePtr& my_node, BtreeMultiGetRequest< K >& greq, uint32_t start_key_idx,
+                                uint32_t end_key_idx) const;
 };
 } // namespace homestore
@@ -26,12 +26,14 @@
 #include <sisl/fds/buffer.hpp>
 
 #include <homestore/btree/btree.hpp>
+#include <homestore/cpu_accounting.hpp>
 #include <homestore/btree/detail/btree_common.ipp>
 #include <homestore/btree/detail/btree_node_mgr.ipp>
 #include <homestore/btree/detail/btree_mutate_impl.ipp>
 #include <homestore/btree/detail/btree_query_impl.ipp>
 #include <homestore/btree/detail/btree_get_impl.ipp>
 #include <homestore/btree/detail/btree_remove_impl.ipp>
+#include <homestore/btree/detail/btree_bulk_load_impl.ipp>
 #include <homestore/btree/detail/btree_node.hpp>
 
 namespace homestore {
@@ -39,6 +41,13 @@ template < typename K, typename V >
 Btree< K, V >::Btree(const BtreeConfig& cfg) :
         m_metrics{cfg.name().c_str()}, m_node_size{cfg.node_size()}, m_bt_cfg{cfg} {
     m_bt_cfg.set_node_data_size(cfg.node_size() - sizeof(persistent_hdr_t));
+    if (m_bt_cfg.m_optimistic_reads &&
+        ((m_bt_cfg.leaf_node_type() != btree_node_type::FIXED) ||
+         (m_bt_cfg.interior_node_type() != btree_node_type::FIXED))) {
+        BT_LOG(WARN, "Optimistic reads are supported only on fixed node types, disabling it");
+        m_bt_cfg.m_optimistic_reads = false;
+    }
+    if (m_bt_cfg.m_range_locks) { m_range_locks = std::make_unique< BtreeRangeLockTable< K > >(); }
 }
 
 template < typename K, typename V >
@@ -75,10 +84,14 @@ template < typename ReqT >
 btree_status_t Btree< K, V >::put(ReqT& put_req) {
     static_assert(std::is_same_v< ReqT, BtreeSinglePutRequest > || std::is_same_v< ReqT, BtreeRangePutRequest< K > >,
                   "put api is called with non put request type");
+    HS_CPU_SCOPE(BTREE);
+    if (m_bt_cfg.m_read_only) { return btree_status_t::not_supported; }
     COUNTER_INCREMENT(m_metrics, btree_write_ops_count, 1);
     auto acq_lock = locktype_t::READ;
     bool is_leaf = false;
 
+    range_write_lock_t range_lock;
+    if (m_range_locks) { write_lock_range(put_req, range_lock); }
     m_btree_lock.lock_shared();
     btree_status_t ret = btree_status_t::success;
 
@@ -116,6 +129,7 @@ retry:
         acq_lock = locktype_t::WRITE;
         goto retry;
     } else {
+        if constexpr (std::is_same_v< ReqT, BtreeRangePutRequest< K > >) { put_req.m_subtree_end_key.reset(); }
         ret = do_put(root, acq_lock, put_req);
         if ((ret == btree_status_t::retry) || (ret == btree_status_t::has_more)) {
             // Need to start from top down again, since there was a split or we have more to insert in case of range put
@@ -140,21 +154,71 @@ out:
     return ret;
 }
 
+template < typename K, typename V >
+btree_status_t Btree< K, V >::put_batch(BtreeBatchRangePutRequest< K >& breq) {
+    btree_status_t ret{btree_status_t::success};
+
+    while (breq.m_next_idx < breq.num_updates()) {
+        auto const cur_idx = breq.m_next_idx++;
+        auto const& [range, value] = breq.m_updates[cur_idx];
+        BT_DBG_ASSERT((breq.m_next_idx == breq.num_updates()) ||
+                          (range.end_key().compare(breq.m_updates[breq.m_next_idx].first.start_key()) < 0),
+                      "Batch range put updates are not sorted or are overlapping at idx={}", breq.m_next_idx);
+
+        BtreeRangePutRequest< K > rreq{BtreeKeyRange< K >{range}, breq.m_put_type, value, breq.m_app_context,
+                                       std::numeric_limits< uint32_t >::max(), breq.m_filter_cb};
+        rreq.m_op_context = breq.m_op_context;
+        rreq.m_batch = &breq;
+        if (breq.m_resume_key) {
+            rreq.shift_working_range(std::move(*breq.m_resume_key), true /* inclusive */);
+            breq.m_resume_key.reset();
+        }
+
+        ++breq.m_num_descents;
+        ret = put(rreq);
+        if (ret != btree_status_t::success) {
+            // Leave the failed update as the next one, so that caller can retry the rest of the batch
+            if (breq.m_next_idx == cur_idx + 1) { breq.m_next_idx = cur_idx; }
+            break;
+        }
+    }
+    return ret;
+}
+
 template < typename K, typename V >
 template < typename ReqT >
 btree_status_t Btree< K, V >::get(ReqT& greq) const {
-    static_assert(std::is_same_v< BtreeSingleGetRequest, ReqT > || std::is_same_v< BtreeGetAnyRequest< K >, ReqT >,
+    static_assert(std::is_same_v< BtreeSingleGetRequest, ReqT > || std::is_same_v< BtreeGetAnyRequest< K >, ReqT > ||
+                      std::is_same_v< BtreeMultiGetRequest< K >, ReqT >,
                   "get api is called with non get request type");
+    HS_CPU_SCOPE(BTREE);
 
     btree_status_t ret = btree_status_t::success;
 
     m_btree_lock.lock_shared();
     BtreeNodePtr root;
 
+    if constexpr (std::is_same_v< BtreeSingleGetRequest, ReqT >) {
+        if (m_bt_cfg.m_optimistic_reads) {
+            auto const token = enter_optimistic_read();
+            ret = do_optimistic_get(greq);
+            exit_optimistic_read(token);
+            if (ret != btree_status_t::retry) { goto out; }
+            COUNTER_INCREMENT(m_metrics, optimistic_read_fallback_count, 1);
+        }
+    }
+
     ret = read_and_lock_node(m_root_node_info.bnode_id(), root, locktype_t::READ, locktype_t::READ, greq.m_op_context);
     if (ret != btree_status_t::success) { goto out; }
 
-    ret = do_get(root, greq);
+    if constexpr (std::is_same_v< BtreeMultiGetRequest< K >, ReqT >) {
+        ret = do_multi_get(root, greq, 0u, greq.num_keys());
+        if ((ret == btree_status_t::success) && (greq.num_found() != greq.num_keys())) {
+            ret = btree_status_t::not_found;
+        }
+    } else {
+        ret = do_get(root, greq);
+    }
 out:
     m_btree_lock.unlock_shared();
 
@@ -169,10 +233,15 @@ template < typename ReqT >
 btree_status_t Btree< K, V >::remove(ReqT& req) {
     static_assert(std::is_same_v< ReqT, BtreeSingleRemoveRequest > ||
                       std::is_same_v< ReqT, BtreeRangeRemoveRequest< K > > ||
-                      std::is_same_v< ReqT, BtreeRemoveAnyRequest< K > >,
+                      std::is_same_v< ReqT, BtreeRemoveAnyRequest< K > > ||
+                      std::is_same_v< ReqT, BtreeRebalanceRequest< K > >,
                   "remove api is called with non remove request type");
+    HS_CPU_SCOPE(BTREE);
+    if (m_bt_cfg.m_read_only) { return btree_status_t::not_supported; }
 
     locktype_t acq_lock = locktype_t::READ;
+    range_write_lock_t range_lock;
+    if (m_range_locks) { write_lock_range(req, range_lock); }
     m_btree_lock.lock_shared();
 
 retry:
@@ -225,13 +294,71 @@ out:
     return ret;
 }
 
+template < typename K, typename V >
+template < typename ReqT >
+void Btree< K, V >::write_lock_range(ReqT const& req, range_write_lock_t& lock) const {
+    auto& table = *m_range_locks;
+    if constexpr (std::is_same_v< ReqT, BtreeSinglePutRequest > || std::is_same_v< ReqT, BtreeSingleRemoveRequest >) {
+        lock.emplace(table, req.key(), req.key());
+    } else if constexpr (std::is_same_v< ReqT, BtreeRangePutRequest< K > > ||
+                         std::is_same_v< ReqT, BtreeRangeRemoveRequest< K > >) {
+        lock.emplace(table, req.input_range().start_key(), req.input_range().end_key());
+    } else if constexpr (std::is_same_v< ReqT, BtreeRemoveAnyRequest< K > >) {
+        lock.emplace(table, req.m_range.start_key(), req.m_range.end_key());
+    }
+    // Rebalance moves the entries across the nodes, but does not change any of them
+}
+
+template < typename K, typename V >
+btree_status_t Btree< K, V >::rebalance_underfull_nodes(uint32_t max_nodes, void* context) {
+    std::vector< K > keys;
+    {
+        std::unique_lock lg(m_underfull_mtx);
+        while (!m_underfull_keys.empty() && (keys.size() < max_nodes)) {
+            keys.emplace_back(std::move(m_underfull_keys.extract(m_underfull_keys.begin()).value()));
+        }
+    }
+
+    btree_status_t ret{btree_status_t::success};
+    size_t i{0};
+    for (; i < keys.size(); ++i) {
+        BtreeRebalanceRequest< K > req{&keys[i]};
+        req.m_op_context = context;
+        ret = remove(req);
+
+        // Nothing is removed by rebalance, so not_found is the expected outcome
+        if ((ret != btree_status_t::success) && (ret != btree_status_t::not_found)) { break; }
+        ret = btree_status_t::success;
+    }
+
+    std::unique_lock lg(m_underfull_mtx);
+    for (; i < keys.size(); ++i) {
+        m_underfull_keys.insert(std::move(keys[i])); // Put back whatever we couldn't finish
+    }
+    if ((ret == btree_status_t::success) && !m_underfull_keys.empty()) { ret = btree_status_t::has_more; }
+    return ret;
+}
+
 template < typename K, typename V >
 btree_status_t Btree< K, V >::query(BtreeQueryRequest< K >& qreq, std::vector< std::pair< K, V > >& out_values) const {
+    HS_CPU_SCOPE(BTREE);
     COUNTER_INCREMENT(m_metrics, btree_query_ops_count, 1);
 
     btree_status_t ret = btree_status_t::success;
     if (qreq.batch_size() == 0) { return ret; }
 
+    if (qreq.query_type() == BtreeQueryType::SERIALIZABLE_QUERY) {
+        if (!m_range_locks) {
+            LOGERROR("Serializable query needs the range locks turned on in btree={} config", m_bt_cfg.name());
+            return btree_status_t::not_supported;
+        }
+        // Lock is held across the pages, till the query completes
+        if (!qreq.m_range_lock) {
+            qreq.m_range_lock =
+                std::make_unique< typename BtreeRangeLockTable< K >::ReadLock >(*m_range_locks, qreq.input_range());
+        }
+    }
+
     m_btree_lock.lock_shared();
     BtreeNodePtr root = nullptr;
     ret = read_and_lock_node(m_root_node_info.bnode_id(), root, locktype_t::READ, locktype_t::READ, qreq.m_op_context);
@@ -239,6 +366,7 @@ btree_status_t Btree< K, V >::query(BtreeQueryRequest< K >& qreq, std::vector< s
 
     switch (qreq.query_type()) {
     case BtreeQueryType::SWEEP_NON_INTRUSIVE_PAGINATION_QUERY:
+    case BtreeQueryType::SERIALIZABLE_QUERY:
         ret = do_sweep_query(root, qreq, out_values);
         break;
 
@@ -253,6 +381,7 @@ btree_status_t Btree< K, V >::query(BtreeQueryRequest< K >& qreq, std::vector< s
     }
 
     if ((qreq.query_type() == BtreeQueryType::SWEEP_NON_INTRUSIVE_PAGINATION_QUERY ||
+         qreq.query_type() == BtreeQueryType::SERIALIZABLE_QUERY ||
          qreq.query_type() == BtreeQueryType::TREE_TRAVERSAL_QUERY)) {
         if (out_values.size()) {
             K out_last_key = out_values.back().first;
@@ -265,6 +394,7 @@ btree_status_t Btree< K, V >::query(BtreeQueryRequest< K >& qreq, std::vector< s
 
 out:
     m_btree_lock.unlock_shared();
+    if (ret != btree_status_t::has_more) { qreq.m_range_lock.reset(); }
 #ifndef NDEBUG
     check_lock_debug();
 #endif
@@ -275,6 +405,30 @@ out:
     return ret;
 }
 
+template < typename K, typename V >
+btree_status_t Btree< K, V >::cursor_next(BtreeCursor< K >& cursor, uint32_t max_count, cursor_cb_t const& cb) const {
+    COUNTER_INCREMENT(m_metrics, btree_query_ops_count, 1);
+    if (cursor.is_done() || (max_count == 0)) { return btree_status_t::success; }
+
+    m_btree_lock.lock_shared();
+    BtreeNodePtr leaf;
+    uint32_t idx{0};
+    auto ret = cursor_seek(cursor, leaf, idx);
+    if ((ret == btree_status_t::success) && !cursor.is_done()) {
+        ret = do_cursor_next(cursor, leaf, idx, max_count, cb);
+    }
+    m_btree_lock.unlock_shared();
+
+#ifndef NDEBUG
+    check_lock_debug();
+#endif
+    if ((ret != btree_status_t::success) && (ret != btree_status_t::has_more)) {
+        BT_LOG(ERROR, "btree cursor next failed {}", ret);
+        COUNTER_INCREMENT(m_metrics, query_err_cnt, 1);
+    }
+    return ret;
+}
+
 #if 0
 /**
  * @brief : verify btree is consistent and no corruption;
@@ -15,7 +15,9 @@
  *********************************************************************************/
 #pragma once
 
+#include <concepts>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <fmt/format.h>
 #include <sisl/fds/buffer.hpp>
@@ -57,6 +59,24 @@ public:
     virtual bool is_interval_key() const { return false; }
 };
 
+// Keys whose serialized form is a single native endian unsigned integer and whose compare() follows the integer
+// order, can opt into integer specialized search inside the fixed size nodes by declaring
+//     using btree_int_key_t = uint64_t;
+// The on-disk node format is not affected, it only allows the node to compare the keys without going through compare()
+template < typename K >
+concept BtreeIntegerKey = requires { typename K::btree_int_key_t; } &&
+    std::is_unsigned_v< typename K::btree_int_key_t >;
+
+// Keys which can produce a separator shorter than the full key, such that left <= separator < right, typically the
+// shortest prefix of right which is still greater than left, can opt in by providing
+//     static K shortest_separator(K const& left, K const& right);
+// Btree then stores these truncated separators in the variable key size interior nodes, instead of the last key
+// of the left leaf, increasing the interior node fan-out. Leaf keys are untouched and node format is not affected.
+template < typename K >
+concept BtreeSeparatorKey = requires(K const& left, K const& right) {
+    { K::shortest_separator(left, right) } -> std::convertible_to< K >;
+};
+
 // An extension of BtreeKey where each key is part of an interval range. Keys are not neccessarily only needs to be
 // integers, but it needs to be able to get next or prev key from a given key in the key range
 class BtreeIntervalKey : public BtreeKey {
@@ -14,8 +14,12 @@
  *
  *********************************************************************************/
 #pragma once
+#include <algorithm>
+#include <optional>
+#include <boost/intrusive_ptr.hpp>
 #include <sisl/fds/buffer.hpp>
 #include <homestore/btree/btree_kv.hpp>
+#include <homestore/btree/detail/btree_range_lock.hpp>
 
 namespace homestore {
 struct BtreeRequest;
@@ -99,6 +103,9 @@ public:
     put_filter_cb_t m_filter_cb;
 };
 
+template < typename K >
+struct BtreeBatchRangePutRequest;
+
 template < typename K >
 struct BtreeRangePutRequest : public BtreeRangeRequest< K > {
 public:
@@ -113,6 +120,36 @@ public:
     const btree_put_type m_put_type{btree_put_type::UPDATE};
     const BtreeValue* m_newval;
     put_filter_cb_t m_filter_cb;
+
+    // Set when this put is part of a sorted batch, so that rest of the batch landing on the same leaf is applied
+    // while holding its lock. Subtree end key is the inclusive upper bound of the subtree being descended.
+    BtreeBatchRangePutRequest< K >* m_batch{nullptr};
+    std::optional< K > m_subtree_end_key;
+};
+
+// Sorted list of non-overlapping range updates, each with its own value. Descends the tree once for a set of
+// updates which falls on the same leaf and re-descends only when an update doesn't fit the leaf it is in.
+template < typename K >
+struct BtreeBatchRangePutRequest : public BtreeRequest {
+public:
+    using update_t = std::pair< BtreeKeyRange< K >, const BtreeValue* >;
+
+    BtreeBatchRangePutRequest(std::vector< update_t >&& updates, btree_put_type put_type, void* app_context = nullptr,
+                              put_filter_cb_t filter_cb = nullptr) :
+            BtreeRequest{app_context, nullptr},
+            m_updates{std::move(updates)},
+            m_put_type{put_type},
+            m_filter_cb{std::move(filter_cb)} {}
+
+    uint32_t num_updates() const { return m_updates.size(); }
+
+    std::vector< update_t > m_updates;
+    const btree_put_type m_put_type{btree_put_type::UPDATE};
+    put_filter_cb_t m_filter_cb;
+
+    uint32_t m_next_idx{0};          // Next update in the list to apply
+    std::optional< K > m_resume_key; // If next update is partially applied, key from where it needs to be resumed
+    uint32_t m_num_descents{0};      // Number of times the tree was descended to apply the batch so far
 };
 
 /////////////////////////// 2: Remove Operations /////////////////////////////////////
@@ -127,6 +164,17 @@ public:
     BtreeValue* m_outval;
 };
 
+// Descends the tree along the key, merging any underfull node on its route, without removing anything
+template < typename K >
+struct BtreeRebalanceRequest : public BtreeRequest {
+public:
+    BtreeRebalanceRequest(const K* k) : m_k{k} {}
+
+    const BtreeKey& key() const { return *m_k; }
+
+    const K* m_k;
+};
+
 template < typename K >
 struct BtreeRemoveAnyRequest : public BtreeRequest {
 public:
@@ -175,6 +223,27 @@ public:
     BtreeValue* m_outval;
 };
 
+// Get a batch of keys in one descent of the tree. Keys are expected to be sorted in ascending order and
+// m_outvals[i] receives the value of m_keys[i]. Every interior and leaf node which covers one or more of the keys is
+// read and locked only once for the entire batch.
+template < typename K >
+struct BtreeMultiGetRequest : public BtreeRequest {
+public:
+    BtreeMultiGetRequest(std::vector< K >&& keys, std::vector< BtreeValue* >&& out_vals) :
+            m_keys{std::move(keys)}, m_outvals{std::move(out_vals)}, m_found(m_keys.size(), false) {
+        DEBUG_ASSERT_EQ(m_keys.size(), m_outvals.size(), "Multi get request need value for every key");
+    }
+
+    uint32_t num_keys() const { return uint32_cast(m_keys.size()); }
+    const K& key(uint32_t i) const { return m_keys[i]; }
+    bool is_found(uint32_t i) const { return m_found[i]; }
+    uint32_t num_found() const { return uint32_cast(std::count(m_found.begin(), m_found.end(), true)); }
+
+    std::vector< K > m_keys;
+    std::vector< BtreeValue* > m_outvals;
+    std::vector< bool > m_found;
+};
+
 /////////////////////////// 4 Range Query Operations /////////////////////////////////////
 ENUM(BtreeQueryType, uint8_t,
      // This is default query which walks to first element in range, and then sweeps/walks
@@ -192,9 +261,10 @@ ENUM(BtreeQueryType, uint8_t,
      // recover if parent and leaf node are in different generations or crash recovery cases.
      TREE_TRAVERSAL_QUERY,
 
-     // This is both inefficient and quiet intrusive/unsafe query, where it locks the range
-     // that is being queried for and do not allow any insert or update within that range. It
-     // essentially create a serializable level of isolation.
+     // Sweep query which read locks the range being queried for, across all its pages, and do not
+     // allow any insert or update within that range till the query completes or the request is
+     // destroyed. It essentially creates a serializable level of isolation. Needs the range locks
+     // turned on in the btree config.
      SERIALIZABLE_QUERY)
 
 using get_filter_cb_t = std::function< bool(BtreeKey const&, BtreeValue const&) >;
@@ -219,6 +289,43 @@ public:
 protected:
     const BtreeQueryType m_query_type; // Type of the query
     get_filter_cb_t m_filter_cb;
+
+public:
+    // Lock of the input range held by a serializable query across its pages
+    std::unique_ptr< typename BtreeRangeLockTable< K >::ReadLock > m_range_lock;
+};
+
+// Called for every entry the cursor yields. Returning false stops the cursor after this entry.
+using cursor_cb_t = std::function< bool(BtreeKey const&, BtreeValue const&) >;
+
+// Forward cursor over a key range, which yields the entries lazily through Btree::cursor_next(). In between the calls
+// no lock is held, cursor keeps a reference on the leaf it stopped at along with its generation and the index within
+// that leaf. Reference keeps the node alive even if it is freed by a merge, and it is not evicted from the cache of an
+// index table meanwhile. If the leaf is freed or modified in between, cursor descends again from the last yielded key.
+// Cursor is expected to be destroyed before its btree.
+template < typename K >
+struct BtreeCursor : public BtreeRequest {
+public:
+    BtreeCursor(BtreeKeyRange< K >&& range, bool zero_copy = false, bool prefetch_next = false,
+                void* app_context = nullptr) :
+            BtreeRequest{app_context, nullptr},
+            m_range{std::move(range)},
+            m_zero_copy{zero_copy},
+            m_prefetch_next{prefetch_next} {}
+
+    const BtreeKeyRange< K >& range() const { return m_range; }
+    bool is_done() const { return m_done; }
+
+    BtreeKeyRange< K > m_range;
+    bool m_zero_copy;     // Key/Value passed to the callback points to the node buffer and is valid only within it
+    bool m_prefetch_next; // Read the next leaf while the current leaf is being consumed
+    bool m_done{false};
+
+    // Resumable position within the tree
+    boost::intrusive_ptr< BtreeNode > m_leaf;
+    uint64_t m_leaf_gen{0};
+    uint32_t m_next_idx{0};
+    std::optional< K > m_last_key;
 };
 
 /* This class is a top level class to keep track of the locks that are held currently. It is
@@ -0,0 +1,184 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <homestore/btree/btree.hpp>
+
+namespace homestore {
+
+/*
+ * Build the entire tree bottom-up from the sorted list of key/values. Leaves are packed upto the ideal fill size
+ * and linked together, after which every level of interior nodes is built from the separator key of each child of
+ * the level below, until we are left with a single node, which becomes the new root. The rightmost child of every
+ * level is set as the edge of the rightmost interior node, exactly how a split would have left it.
+ *
+ * The new nodes are not visible to anyone until the root is switched at the end, so no locks are taken on them.
+ * The nodes are transacted top down before the switch, so that every new node depends on the new root, which in-turn
+ * depends on the meta upon the switch, thus the entire tree is committed or discarded atomically along with the root
+ * change. Switching the root is the last step which can fail, so upon any failure the tree is left empty as it was.
+ */
+template < typename K, typename V >
+btree_status_t Btree< K, V >::bulk_load(std::vector< std::pair< K, V > > const& sorted_kvs, void* context) {
+    btree_status_t ret{btree_status_t::success};
+    std::vector< std::vector< BtreeNodePtr > > levels;
+    BtreeNodePtr old_root;
+
+    m_btree_lock.lock();
+    ret = read_and_lock_node(m_root_node_info.bnode_id(), old_root, locktype_t::WRITE, locktype_t::WRITE, context);
+    if (ret != btree_status_t::success) { goto done; }
+
+    if (!old_root->is_leaf() || (old_root->total_entries() != 0)) {
+        BT_LOG(ERROR, "Bulk load is supported only on an empty btree, root node={} has entries",
+               old_root->node_id());
+        unlock_node(old_root, locktype_t::WRITE);
+        ret = btree_status_t::not_supported;
+        goto done;
+    }
+
+    if (sorted_kvs.empty()) {
+        unlock_node(old_root, locktype_t::WRITE);
+        goto done;
+    }
+
+    ret = bulk_build_leaves(sorted_kvs, levels);
+    while ((ret == btree_status_t::success) && (levels.back().size() > 1)) {
+        ret = bulk_build_interior_level(levels);
+    }
+
+    if (ret == btree_status_t::success) { ret = write_node(levels.back()[0], context); }
+    for (auto l = levels.size() - 1; (ret == btree_status_t::success) && (l > 0); --l) {
+        ret = bulk_transact_level(levels[l], levels[l - 1], context);
+    }
+    if (ret == btree_status_t::success) { ret = on_root_changed(levels.back()[0], context); }
+
+    if (ret != btree_status_t::success) {
+        BT_LOG(ERROR, "Bulk load of {} entries failed, ret={}, releasing all nodes built so far", sorted_kvs.size(),
+               ret);
+        for (auto const& level_nodes : levels) {
+            for (auto const& node : level_nodes) {
+                free_node(node, locktype_t::NONE, context);
+            }
+        }
+        unlock_node(old_root, locktype_t::WRITE);
+        goto done;
+    }
+
+    m_root_node_info = levels.back()[0]->link_info();
+    COUNTER_INCREMENT(m_metrics, btree_depth, levels.size() - 1);
+    BT_LOG(INFO, "Bulk loaded {} entries into {} leaf nodes with btree depth={}, new root={}", sorted_kvs.size(),
+           levels[0].size(), levels.size(), m_root_node_info.bnode_id());
+    free_node(old_root, locktype_t::WRITE, context);
+
+done:
+    m_btree_lock.unlock();
+    return ret;
+}
+
+template < typename K, typename V >
+btree_status_t Btree< K, V >::bulk_build_leaves(std::vector< std::pair< K, V > > const& sorted_kvs,
+                                                std::vector< std::vector< BtreeNodePtr > >& levels) {
+    auto& leaves = levels.emplace_back();
+    BtreeNodePtr cur_leaf;
+
+    for (size_t i{0}; i < sorted_kvs.size(); ++i) {
+        auto const& [k, v] = sorted_kvs[i];
+        BT_DBG_ASSERT((i == 0) || (sorted_kvs[i - 1].first.compare(k) < 0),
+                      "Bulk load input is not sorted or has duplicates at index={}", i);
+
+        if ((cur_leaf == nullptr) || (cur_leaf->occupied_size() >= m_bt_cfg.ideal_fill_size(true)) ||
+            !cur_leaf->has_room_for_put(btree_put_type::INSERT, k.serialized_size(), v.serialized_size())) {
+            auto new_leaf = alloc_leaf_node();
+            if (new_leaf == nullptr) { return btree_status_t::space_not_avail; }
+            new_leaf->set_level(0u);
+            if (cur_leaf) { cur_leaf->set_next_bnode(new_leaf->node_id()); }
+            leaves.push_back(new_leaf);
+            cur_leaf = std::move(new_leaf);
+        }
+
+        auto const ret = cur_leaf->insert(cur_leaf->total_entries(), k, v);
+        if (ret != btree_status_t::success) { return ret; }
+    }
+    return btree_status_t::success;
+}
+
+template < typename K, typename V >
+btree_status_t Btree< K, V >::bulk_build_interior_level(std::vector< std::vector< BtreeNodePtr > >& levels) {
+    auto const& children = levels.back();
+    std::vector< BtreeNodePtr > parents;
+    BtreeNodePtr cur_parent;
+
+    for (size_t i{0}; i < children.size(); ++i) {
+        auto const& child = children[i];
+        bool const is_last_child = (i == children.size() - 1);
+
+        // Edge is held in the node header, so the last child never needs a new node of its own
+        if ((cur_parent == nullptr) ||
+            (!is_last_child &&
+             ((cur_parent->occupied_size() >= m_bt_cfg.ideal_fill_size(false)) ||
+              !cur_parent->has_room_for_put(btree_put_type::INSERT, K::get_max_size(),
+                                            BtreeLinkInfo::get_fixed_size())))) {
+            auto new_parent = alloc_interior_node();
+            if (new_parent == nullptr) {
+                levels.push_back(std::move(parents));
+                return btree_status_t::space_not_avail;
+            }
+            new_parent->set_level(child->level() + 1);
+            if (cur_parent) { cur_parent->set_next_bnode(new_parent->node_id()); }
+            parents.push_back(new_parent);
+            cur_parent = std::move(new_parent);
+        }
+
+        if (is_last_child) {
+            cur_parent->set_edge_value(child->link_info());
+        } else {
+            auto const ret = cur_parent->insert(cur_parent->total_entries(), separator_key(child, children[i + 1]),
+                                                child->link_info());
+            if (ret != btree_status_t::success) {
+                levels.push_back(std::move(parents));
+                return ret;
+            }
+        }
+    }
+
+    levels.push_back(std::move(parents));
+    return btree_status_t::success;
+}
+
+template < typename K, typename V >
+btree_status_t Btree< K, V >::bulk_transact_level(std::vector< BtreeNodePtr > const& parents,
+                                                  std::vector< BtreeNodePtr > const& children, void* context) {
+    // Number of new nodes in a single transaction is limited by what txn journal record can hold
+    static constexpr size_t max_nodes_per_txn = 128;
+
+    size_t child_idx{0};
+    for (auto const& parent : parents) {
+        auto const end_idx = std::min(child_idx + parent->total_entries() + (parent->has_valid_edge() ? 1 : 0),
+                                      children.size());
+        while (child_idx < end_idx) {
+            BtreeNodeList new_nodes;
+            auto const batch_end = std::min(child_idx + max_nodes_per_txn, end_idx);
+            for (; child_idx < batch_end; ++child_idx) {
+                new_nodes.push_back(children[child_idx]);
+            }
+
+            // All the children are new nodes, with parent as its in-place child, so that the dependency is
+            // established on the parent's up buffer
+            auto const ret = transact_nodes(new_nodes, {}, parent, nullptr, context);
+            if (ret != btree_status_t::success) { return ret; }
+        }
+    }
+    return btree_status_t::success;
+}
+} // namespace homestore
@@ -95,6 +95,101 @@ btree_status_t Btree< K, V >::do_destroy(uint64_t& n_freed_nodes, void* context)
                                 });
 }
 
+// Frees the tree from its bottom left, all the leaves of the leftmost parent or an interior node emptied by an earlier
+// batch at a time, unlinking them from their parent in the same transaction. So the tree left behind after each batch
+// is consistent to resume the destroy from, including after a crash. Returns has_more till the root is freed as well.
+template < typename K, typename V >
+btree_status_t Btree< K, V >::destroy_batch(uint64_t& n_freed_nodes, void* context) {
+    static auto const child_id = [](BtreeNodePtr const& node, uint32_t idx) {
+        BtreeLinkInfo child_info;
+        if (idx == node->total_entries()) {
+            child_info.set_bnode_id(node->has_valid_edge() ? node->edge_id() : empty_bnodeid);
+        } else {
+            node->get_nth_value(idx, &child_info, false /* copy */);
+        }
+        return child_info.bnode_id();
+    };
+    static auto const is_childless = [](BtreeNodePtr const& node) {
+        return !node->is_leaf() && (node->total_entries() == 0) && !node->has_valid_edge();
+    };
+
+    m_btree_lock.lock();
+    btree_status_t ret{btree_status_t::success};
+    BtreeNodePtr parent;
+    if (m_root_node_info.bnode_id() == empty_bnodeid) { goto done; }
+
+    ret = read_and_lock_node(m_root_node_info.bnode_id(), parent, locktype_t::WRITE, locktype_t::WRITE, context);
+    if (ret != btree_status_t::success) { goto done; }
+
+    while (true) {
+        if (parent->is_leaf() || is_childless(parent)) {
+            // Only the root is left
+            free_node(parent, locktype_t::WRITE, context);
+            ++n_freed_nodes;
+            m_root_node_info = BtreeLinkInfo{};
+            break;
+        }
+
+        BtreeNodePtr child;
+        ret = read_and_lock_node(child_id(parent, 0), child, locktype_t::WRITE, locktype_t::WRITE, context);
+        if (ret != btree_status_t::success) {
+            unlock_node(parent, locktype_t::WRITE);
+            break;
+        }
+
+        if (is_childless(child)) {
+            if (parent->total_entries() == 0) {
+                parent->invalidate_edge();
+            } else {
+                parent->remove(0);
+            }
+            ret = transact_nodes({}, {child}, parent, nullptr, context);
+            if (ret == btree_status_t::success) {
+                ++n_freed_nodes;
+                ret = btree_status_t::has_more;
+            } else {
+                unlock_node(child, locktype_t::WRITE);
+            }
+            unlock_node(parent, locktype_t::WRITE);
+            break;
+        }
+
+        if (child->is_leaf()) {
+            // Tree is balanced, so all the other children of the parent are leaves as well. Nodes are all locked before
+            // any of them is modified, so that a failure to lock leaves the tree as is.
+            BtreeNodeList leaves{child};
+            for (uint32_t i{1}; (i <= parent->total_entries()) && (ret == btree_status_t::success); ++i) {
+                auto const id = child_id(parent, i);
+                if (id == empty_bnodeid) { break; }
+                ret = read_and_lock_node(id, child, locktype_t::WRITE, locktype_t::WRITE, context);
+                if (ret == btree_status_t::success) { leaves.push_back(child); }
+            }
+            if (ret == btree_status_t::success) {
+                parent->remove_all(m_bt_cfg);
+                parent->invalidate_edge();
+                ret = transact_nodes({}, leaves, parent, nullptr, context);
+            }
+            if (ret == btree_status_t::success) {
+                n_freed_nodes += leaves.size();
+                ret = btree_status_t::has_more;
+            } else {
+                for (auto const& leaf : leaves) {
+                    unlock_node(leaf, locktype_t::WRITE);
+                }
+            }
+            unlock_node(parent, locktype_t::WRITE);
+            break;
+        }
+
+        unlock_node(parent, locktype_t::WRITE);
+        parent = std::move(child);
+    }
+
+done:
+    m_btree_lock.unlock();
+    return ret;
+}
+
 template < typename K, typename V >
 uint64_t Btree< K, V >::get_btree_node_cnt() const {
     uint64_t cnt = 1; /* increment it for root */
@@ -32,6 +32,16 @@ btree_status_t Btree< K, V >::do_get(const BtreeNodePtr& my_node, ReqT& greq) co
             std::tie(found, idx) = my_node->find(greq.key(), greq.m_outval, true);
         }
         if (!found) {
+            BtreeNodePtr right_node;
+            if constexpr (std::is_same_v< BtreeGetAnyRequest< K >, ReqT >) {
+                if (lock_right_on_split(my_node, greq.m_range.end_key(), right_node, greq.m_op_context)) {
+                    return do_get(right_node, greq);
+                }
+            } else if constexpr (std::is_same_v< BtreeSingleGetRequest, ReqT >) {
+                if (lock_right_on_split(my_node, greq.key(), right_node, greq.m_op_context)) {
+                    return do_get(right_node, greq);
+                }
+            }
             ret = btree_status_t::not_found;
         } else {
             if (greq.route_tracing) { append_route_trace(greq, my_node, btree_event_t::READ, idx, idx); }
@@ -61,4 +71,105 @@ out:
     unlock_node(my_node, locktype_t::READ);
     return ret;
 }
+
+// Lock free descent for a single key. Lock version of every node is recorded before reading it and validated after
+// reading the child link out of it and again after the child's version is recorded, so any writer which raced on the
+// path is detected (OLC style). Returns retry upon any conflict, in which case the caller falls back to locked path.
+template < typename K, typename V >
+btree_status_t Btree< K, V >::do_optimistic_get(BtreeSingleGetRequest& greq) const {
+    BtreeNodePtr node;
+    uint64_t version;
+
+    auto ret = read_node_impl(m_root_node_info.bnode_id(), node);
+    if (ret != btree_status_t::success) { return ret; }
+    if (!node->optimistic_read_begin(version)) { return btree_status_t::retry; }
+
+    while (!node->is_leaf()) {
+        BtreeLinkInfo child_info;
+        auto const idx = node->find(greq.key(), &child_info, true).second;
+        if (!node->optimistic_read_validate(version) || node->is_node_deleted()) { return btree_status_t::retry; }
+        if ((idx == node->total_entries()) && !node->has_valid_edge()) { return btree_status_t::retry; }
+
+        BtreeNodePtr child_node;
+        uint64_t child_version;
+        ret = read_node_impl(child_info.bnode_id(), child_node);
+        if (ret != btree_status_t::success) { return ret; }
+        if (!child_node->optimistic_read_begin(child_version) || !node->optimistic_read_validate(version)) {
+            return btree_status_t::retry;
+        }
+
+        node = std::move(child_node);
+        version = child_version;
+    }
+
+    // Key could be right past a B-link split, which is left to the locked path to follow
+    if (node->is_split_pending()) { return btree_status_t::retry; }
+    auto const found = node->find(greq.key(), greq.m_outval, true).first;
+    if (!node->optimistic_read_validate(version) || node->is_node_deleted()) { return btree_status_t::retry; }
+    return found ? btree_status_t::success : btree_status_t::not_found;
+}
+
+// Serves keys [start_key_idx, end_key_idx) of the request from the subtree under my_node. my_node is expected to be
+// read locked and it is unlocked before returning. Consecutive keys which falls under the same child are grouped
+// together, so that each child is read and locked only once
+template < typename K, typename V >
+btree_status_t Btree< K, V >::do_multi_get(const BtreeNodePtr& my_node, BtreeMultiGetRequest< K >& greq,
+                                           uint32_t start_key_idx, uint32_t end_key_idx) const {
+    btree_status_t ret{btree_status_t::success};
+
+    if (my_node->is_leaf()) {
+        for (auto i{start_key_idx}; i < end_key_idx; ++i) {
+            auto const [found, idx] = my_node->find(greq.key(i), greq.m_outvals[i], true);
+            greq.m_found[i] = found;
+            if (found && greq.route_tracing) { append_route_trace(greq, my_node, btree_event_t::READ, idx, idx); }
+        }
+
+        // Keys are sorted, so the ones beyond the high key of a pending B-link split are all served from the right
+        for (auto i{start_key_idx}; my_node->is_split_pending() && (i < end_key_idx); ++i) {
+            BtreeNodePtr right_node;
+            if (!greq.m_found[i] && lock_right_on_split(my_node, greq.key(i), right_node, greq.m_op_context)) {
+                return do_multi_get(right_node, greq, i, end_key_idx);
+            }
+        }
+        unlock_node(my_node, locktype_t::READ);
+        return ret;
+    }
+
+    auto key_idx = start_key_idx;
+    while (key_idx < end_key_idx) {
+        BtreeLinkInfo child_info;
+        auto const [found, child_idx] = my_node->find(greq.key(key_idx), &child_info, true);
+        ASSERT_IS_VALID_INTERIOR_CHILD_INDX(found, child_idx, my_node);
+        if (greq.route_tracing) { append_route_trace(greq, my_node, btree_event_t::READ, child_idx, child_idx); }
+
+        // Find all subsequent keys which are covered by this child. Child at child_idx covers all keys <= its
+        // separator key, edge covers everything else.
+        auto group_end = key_idx + 1;
+        if (child_idx < my_node->total_entries()) {
+            while ((group_end < end_key_idx) && (my_node->compare_nth_key(greq.key(group_end), child_idx) >= 0)) {
+                ++group_end;
+            }
+        } else {
+            group_end = end_key_idx;
+        }
+
+        if (child_idx == my_node->total_entries() && !my_node->has_valid_edge()) {
+            // Keys are beyond the last child of the node, none of them is present
+            key_idx = group_end;
+            continue;
+        }
+
+        BtreeNodePtr child_node;
+        ret = read_and_lock_node(child_info.bnode_id(), child_node, locktype_t::READ, locktype_t::READ,
+                                 greq.m_op_context);
+        if (ret != btree_status_t::success) { break; }
+
+        ret = do_multi_get(child_node, greq, key_idx, group_end);
+        if (ret != btree_status_t::success) { break; }
+        key_idx = group_end;
+    }
+
+    unlock_node(my_node, locktype_t::READ);
+    return ret;
+}
 } // namespace homestore
@@ -239,6 +239,9 @@ struct trace_route_entry {
 
 struct BtreeConfig {
     uint32_t m_node_size;
+    // Size of the leaf nodes, if it differs from the interior ones. Index tables need it to be a multiple of the
+    // node size, since their leaves take that many contiguous blks of the index vdev. 0 keeps it same as interior.
+    uint32_t m_leaf_node_size{0};
     uint32_t m_node_data_size;
     uint8_t m_ideal_fill_pct{90};
     uint8_t m_suggested_min_pct{30};
@@ -250,6 +253,38 @@ struct BtreeConfig {
     bool m_rebalance_turned_on{false};
     bool m_merge_turned_on{true};
 
+    // Removes do not merge the underfull nodes inline, but only mark them, to be merged later in batches by
+    // rebalance_underfull_nodes(), which the user is expected to call periodically (say per cp or when idle)
+    bool m_lazy_merge{false};
+
+    // Single key gets descend the tree without taking node locks and validate the node versions instead, falling back
+    // to locked descent on any conflict. Supported only when both leaf and interior nodes are FIXED type.
+    bool m_optimistic_reads{false};
+
+    // Number of leaf siblings to read ahead asynchronously in the background during sweep queries. 0 disables it
+    uint32_t m_sweep_readahead_nodes{0};
+
+    // Descents prefetch the buffer of a child to the cpu cache while its lock is being acquired, and range puts and
+    // removes read ahead the rest of the matched children of a parent of leaves while they work on the first of them
+    bool m_descent_prefetch{false};
+
+    // Search the nodes with integer keys by interpolating the key position first, bounded by a few probes before
+    // falling back to binary search. Benefits monotonic, evenly spread keys and doesn't change the node format.
+    bool m_interpolation_search{false};
+
+    // B-link leaf splits: a leaf splits under its own lock alone and links its new right sibling, which readers reach
+    // by the right link till the writer installs the separator in the parent. Parent is write locked only for that
+    // insert, not for the whole split. Supported only by the in memory btree, whose nodes are not persisted.
+    bool m_blink_splits{false};
+
+    // Key range locks for the serializable queries, which every put and remove then takes for its keys. A thread
+    // which writes in the range of a query it has not completed yet, waits forever.
+    bool m_range_locks{false};
+
+    // Btree is never mutated, like the index tables of a read only open of HomeStore. Nodes are read without taking
+    // their locks and puts and removes fail with not_supported.
+    bool m_read_only{false};
+
     btree_node_type m_leaf_node_type{btree_node_type::VAR_OBJECT};
     btree_node_type m_int_node_type{btree_node_type::VAR_KEY};
     std::string m_btree_name; // Unique name for the btree
@@ -266,6 +301,9 @@ public:
 
     virtual ~BtreeConfig() = default;
     uint32_t node_size() const { return m_node_size; };
+    uint32_t node_size(bool is_leaf) const {
+        return (is_leaf && (m_leaf_node_size != 0)) ? m_leaf_node_size : m_node_size;
+    }
 
     void set_node_data_size(uint32_t data_size) {
         m_node_data_size = data_size;
@@ -278,6 +316,15 @@ public:
     uint32_t suggested_min_size() const { return m_suggested_min_size; }
     uint32_t node_data_size() const { return m_node_data_size; }
 
+    // Thresholds of the nodes of the level, whose data size grows by the same bytes as its node size
+    uint32_t node_data_size(bool is_leaf) const { return m_node_data_size + node_size(is_leaf) - m_node_size; }
+    uint32_t ideal_fill_size(bool is_leaf) const {
+        return is_leaf ? (uint32_t)(node_data_size(true) * m_ideal_fill_pct) / 100 : m_ideal_fill_size;
+    }
+    uint32_t suggested_min_size(bool is_leaf) const {
+        return is_leaf ? (uint32_t)(node_data_size(true) * m_suggested_min_pct) / 100 : m_suggested_min_size;
+    }
+
     void set_ideal_fill_pct(uint8_t pct) {
         m_ideal_fill_pct = pct;
         m_ideal_fill_size = (uint32_t)(node_data_size() * m_ideal_fill_pct) / 100;
@@ -303,6 +350,8 @@ public:
                          {"node_type", "interior"}, _publish_as::publish_as_gauge);
         REGISTER_COUNTER(btree_split_count, "Total number of btree node splits");
         REGISTER_COUNTER(btree_merge_count, "Total number of btree node merges");
+        REGISTER_COUNTER(btree_blink_move_right_count, "Number of reads moved right past a B-link split");
+        REGISTER_COUNTER(btree_lazy_merge_marks, "Number of underfull nodes marked to be merged lazily");
         REGISTER_COUNTER(btree_depth, "Depth of btree", _publish_as::publish_as_gauge);
 
         REGISTER_COUNTER(btree_int_node_writes, "Total number of btree interior node writes", "btree_node_writes",
@@ -310,12 +359,14 @@ public:
         REGISTER_COUNTER(btree_leaf_node_writes, "Total number of btree leaf node writes", "btree_node_writes",
                          {"node_type", "leaf"});
         REGISTER_COUNTER(btree_num_pc_gen_mismatch, "Number of gen mismatches to recover");
+        REGISTER_COUNTER(btree_recovery_repaired_nodes, "Number of nodes repaired during index recovery");
 
         REGISTER_HISTOGRAM(btree_int_node_occupancy, "Interior node occupancy", "btree_node_occupancy",
                            {"node_type", "interior"}, HistogramBucketsType(LinearUpto128Buckets));
         REGISTER_HISTOGRAM(btree_leaf_node_occupancy, "Leaf node occupancy", "btree_node_occupancy",
                            {"node_type", "leaf"}, HistogramBucketsType(LinearUpto128Buckets));
         REGISTER_COUNTER(btree_retry_count, "number of retries");
+        REGISTER_COUNTER(optimistic_read_fallback_count, "number of optimistic reads fallen back to locked read");
         REGISTER_COUNTER(write_err_cnt, "number of errors in write");
         REGISTER_COUNTER(query_err_cnt, "number of errors in query");
         REGISTER_COUNTER(read_node_count_in_write_ops, "number of nodes read in write_op");
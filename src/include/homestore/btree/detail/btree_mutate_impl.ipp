@@ -42,6 +42,12 @@ btree_status_t Btree< K, V >::do_put(const BtreeNodePtr& my_node, locktype_t cur
         return ret;
     }
 
+    // Upper bound of this subtree, to derive the bound of the child being descended to, for batched range puts
+    [[maybe_unused]] std::optional< K > my_end_key;
+    if constexpr (std::is_same_v< ReqT, BtreeRangePutRequest< K > >) {
+        if (req.m_batch) { my_end_key = req.m_subtree_end_key; }
+    }
+
     auto unlock_lambda = [this](const BtreeNodePtr& node, locktype_t& cur_lock) {
         unlock_node(node, cur_lock);
         cur_lock = locktype_t::NONE;
@@ -70,6 +76,11 @@ retry:
 
     if (req.route_tracing) { append_route_trace(req, my_node, btree_event_t::READ, start_idx, end_idx); }
 
+    // Leaves after the first one matched are read in the background, while the first one is being worked on
+    if (m_bt_cfg.m_descent_prefetch && (my_node->level() == 1) && (start_idx < end_idx)) {
+        readahead_children(my_node, start_idx + 1, end_idx + 1);
+    }
+
     curr_idx = start_idx;
     while (curr_idx <= end_idx) { // iterate all matched childrens
         locktype_t child_cur_lock = locktype_t::NONE;
@@ -92,7 +103,27 @@ retry:
 
         // Directly get write lock for leaf, since its an insert.
         child_cur_lock = (child_node->is_leaf()) ? locktype_t::WRITE : locktype_t::READ;
-        if (is_split_needed(child_node, req)) {
+        if (child_node->is_split_pending()) {
+            // Writers never go right past a B-link split, they install its separator in this node first
+            ret = complete_split(my_node, curlock, child_node, child_cur_lock, req.m_op_context);
+            if (ret != btree_status_t::success) { goto out; }
+            goto retry;
+        }
+
+        if (m_bt_cfg.m_blink_splits && child_node->is_leaf() && is_split_needed(child_node, req)) {
+            BT_NODE_LOG(TRACE, child_node, "B-link split of leaf needed");
+            ret = split_leaf_right(child_node, req.m_op_context);
+            if (ret != btree_status_t::success) {
+                unlock_lambda(child_node, child_cur_lock);
+                goto out;
+            }
+
+            if (req.route_tracing) { append_route_trace(req, child_node, btree_event_t::SPLIT); }
+            COUNTER_INCREMENT(m_metrics, btree_split_count, 1);
+            ret = complete_split(my_node, curlock, child_node, child_cur_lock, req.m_op_context);
+            if (ret != btree_status_t::success) { goto out; }
+            goto retry; // After split, retry search and walk down.
+        } else if (is_split_needed(child_node, req)) {
             ret = upgrade_node_locks(my_node, child_node, curlock, child_cur_lock, req.m_op_context);
             if (ret != btree_status_t::success) {
                 BT_NODE_LOG(DEBUG, my_node, "Upgrade of node lock failed, retrying from root");
@@ -125,6 +156,14 @@ retry:
                 BT_NODE_LOG(DEBUG, my_node, "Subrange:idx=[{}-{}],c={},working={}", start_idx, end_idx, curr_idx,
                             req.working_range().to_string());
             }
+
+            if (req.m_batch) {
+                if (curr_idx < my_node->total_entries()) {
+                    req.m_subtree_end_key = my_node->get_nth_key< K >(curr_idx, true);
+                } else {
+                    req.m_subtree_end_key = my_end_key;
+                }
+            }
         }
 
 #ifndef NDEBUG
@@ -180,6 +219,7 @@ btree_status_t Btree< K, V >::mutate_write_leaf_node(const BtreeNodePtr& my_node
             req.shift_working_range(std::move(last_failed_key), true /* make it including last_failed_key */);
         } else if (ret == btree_status_t::success) {
             req.shift_working_range();
+            if (req.m_batch) { mutate_batch_in_leaf(my_node, req); }
         }
     } else if constexpr (std::is_same_v< ReqT, BtreeSinglePutRequest >) {
         if (!to_variant_node(my_node)->put(req.key(), req.value(), req.m_put_type, req.m_existing_val,
@@ -196,6 +236,40 @@ btree_status_t Btree< K, V >::mutate_write_leaf_node(const BtreeNodePtr& my_node
     return ret;
 }
 
+// Apply the subsequent updates of the batch, which falls entirely within this leaf, while we hold its write lock. It is
+// attempted only if the current update itself is completed in this leaf. An update which doesn't fit in the leaf is
+// left (or resumed from where it stopped) for the next descent, which would split the leaf as needed.
+template < typename K, typename V >
+void Btree< K, V >::mutate_batch_in_leaf(const BtreeNodePtr& my_node, BtreeRangePutRequest< K >& rpreq) {
+    auto& breq = *rpreq.m_batch;
+    auto const& end_key = rpreq.m_subtree_end_key;
+    auto const within_leaf = [&end_key](BtreeKeyRange< K > const& range) {
+        return !end_key || (range.end_key().compare(*end_key) <= 0);
+    };
+    if (!within_leaf(rpreq.input_range())) { return; }
+
+    while (breq.m_next_idx < breq.num_updates()) {
+        auto const& [range, value] = breq.m_updates[breq.m_next_idx];
+        if (!within_leaf(range) ||
+            !my_node->has_room_for_put(breq.m_put_type, range.start_key().serialized_size(),
+                                       value->serialized_size())) {
+            break;
+        }
+
+        K last_failed_key;
+        auto const ret = to_variant_node(my_node)->multi_put(range, range.start_key(), *value, breq.m_put_type,
+                                                             &last_failed_key, breq.m_filter_cb);
+        if (ret == btree_status_t::has_more) {
+            breq.m_resume_key = std::move(last_failed_key);
+            break;
+        } else if (ret != btree_status_t::success) {
+            // Let the regular path deal with it and report the failure if any
+            break;
+        }
+        ++breq.m_next_idx;
+    }
+}
+
 template < typename K, typename V >
 template < typename ReqT >
 btree_status_t Btree< K, V >::check_split_root(ReqT& req) {
@@ -275,8 +349,8 @@ btree_status_t Btree< K, V >::split_node(const BtreeNodePtr& parent_node, const
                           "Unable to split entries in the child node"); // means cannot split entries
     BT_NODE_DBG_ASSERT_GT(child_node1->total_entries(), 0, child_node1);
 
-    // Insert the last entry in first child to parent node
-    *out_split_key = child_node1->get_last_key< K >();
+    // Insert the last entry (or a shorter separator) in first child to parent node
+    *out_split_key = separator_key(child_node1, child_node2);
 
     BT_NODE_LOG(TRACE, parent_node, "Available space for split entry={}", parent_node->available_size());
 
@@ -299,6 +373,114 @@ btree_status_t Btree< K, V >::split_node(const BtreeNodePtr& parent_node, const
     return ret;
 }
 
+// First half of a B-link split of the write locked leaf: its upper half moves to a new right sibling, which is linked
+// next to it, and the leaf is marked split pending with its new high key, without touching the parent. Till
+// complete_split() installs the separator in the parent, readers of the keys beyond the high key go right by the link.
+template < typename K, typename V >
+btree_status_t Btree< K, V >::split_leaf_right(const BtreeNodePtr& leaf_node, void* context) {
+    BtreeNodePtr right_node = alloc_leaf_node();
+    if (right_node == nullptr) { return btree_status_t::space_not_avail; }
+
+    right_node->set_next_bnode(leaf_node->next_bnode());
+    leaf_node->set_next_bnode(right_node->node_id());
+    right_node->set_level(leaf_node->level());
+    uint32_t filled_size = leaf_node->node_data_size() - leaf_node->available_size();
+    uint32_t res = leaf_node->move_out_to_right_by_size(m_bt_cfg, *right_node, m_bt_cfg.split_size(filled_size));
+    BT_NODE_REL_ASSERT_GT(res, 0, leaf_node, "Unable to split entries in the leaf node");
+    BT_NODE_DBG_ASSERT_GT(leaf_node->total_entries(), 0, leaf_node);
+
+    {
+        std::unique_lock lg{m_split_mtx};
+        m_split_high_keys.insert_or_assign(leaf_node->node_id(), separator_key(leaf_node, right_node));
+    }
+    leaf_node->set_split_pending(true);
+    BT_NODE_LOG(DEBUG, leaf_node, "B-link split of leaf with new right node={}", right_node->node_id());
+
+    return transact_nodes({right_node}, {}, leaf_node, nullptr, context);
+}
+
+// Second half of a B-link split, installs the separator of the split pending child in the parent. Parent is expected
+// to be locked and the child write locked. On success the parent is left write locked and the child unlocked. Else
+// both are unlocked and retry asks the caller to start over from the root, to split the parent first if it is full.
+template < typename K, typename V >
+btree_status_t Btree< K, V >::complete_split(const BtreeNodePtr& parent_node, locktype_t& parent_cur_lock,
+                                             const BtreeNodePtr& child_node, locktype_t& child_cur_lock,
+                                             void* context) {
+    unlock_node(child_node, child_cur_lock);
+    child_cur_lock = locktype_t::NONE;
+
+    btree_status_t ret{btree_status_t::success};
+    if (parent_cur_lock != locktype_t::WRITE) {
+        // Any change to the parent meanwhile, including another writer completing this split, fails the upgrade
+        ret = upgrade_node_lock(parent_node, parent_cur_lock, context);
+        if (ret != btree_status_t::success) { return ret; }
+    }
+
+    if (!parent_node->has_room_for_put(btree_put_type::UPSERT, K::get_max_size(), BtreeLinkInfo::get_fixed_size())) {
+        unlock_node(parent_node, parent_cur_lock);
+        parent_cur_lock = locktype_t::NONE;
+        return btree_status_t::retry;
+    }
+
+    ret = lock_node(child_node, locktype_t::WRITE, context);
+    if (ret != btree_status_t::success) {
+        unlock_node(parent_node, parent_cur_lock);
+        parent_cur_lock = locktype_t::NONE;
+        return ret;
+    }
+    child_cur_lock = locktype_t::WRITE;
+    BT_NODE_DBG_ASSERT(child_node->is_split_pending(), child_node, "Expected the split of the child to be pending");
+
+    K high_key;
+    {
+        std::unique_lock lg{m_split_mtx};
+        auto it = m_split_high_keys.find(child_node->node_id());
+        BT_NODE_REL_ASSERT(it != m_split_high_keys.end(), child_node, "High key of the split pending node not found");
+        high_key = std::move(it->second);
+        m_split_high_keys.erase(it);
+    }
+
+    auto const idx = parent_node->find(high_key, nullptr, false).second;
+    BtreeLinkInfo child_info;
+    if (idx == parent_node->total_entries()) {
+        child_info = parent_node->get_edge_value();
+    } else {
+        parent_node->get_nth_value(idx, &child_info, false /* copy */);
+    }
+    BT_NODE_REL_ASSERT_EQ(child_info.bnode_id(), child_node->node_id(), parent_node,
+                          "Parent doesn't route the high key of the split pending child to it");
+
+    BtreeNodePtr right_node;
+    read_node_or_fail(child_node->next_bnode(), right_node);
+
+    child_node->inc_link_version();
+    parent_node->update(idx, right_node->link_info());
+    parent_node->insert(idx, high_key, child_node->link_info());
+    child_node->set_split_pending(false);
+    BT_NODE_LOG(DEBUG, parent_node, "Completed B-link split of child_node={} with right_node={}, split_key={}",
+                child_node->node_id(), right_node->node_id(), high_key.to_string());
+
+    ret = transact_nodes({}, {}, child_node, parent_node, context);
+    unlock_node(child_node, child_cur_lock);
+    child_cur_lock = locktype_t::NONE;
+    return ret;
+}
+
+// Key which separates the left node from its right sibling in the parent. It is the last key of the left node, unless
+// the key type can provide a shorter separator for a leaf and the interior nodes store it in variable size. Interior
+// children always use their last key, since the parent key of an interior child is expected to be its last key.
+template < typename K, typename V >
+K Btree< K, V >::separator_key(const BtreeNodePtr& left_node, const BtreeNodePtr& right_node) const {
+    if constexpr (BtreeSeparatorKey< K >) {
+        auto const int_node_type = m_bt_cfg.interior_node_type();
+        if (left_node->is_leaf() && (right_node->total_entries() != 0) &&
+            ((int_node_type == btree_node_type::VAR_KEY) || (int_node_type == btree_node_type::VAR_OBJECT))) {
+            return K::shortest_separator(left_node->get_last_key< K >(), right_node->get_first_key< K >());
+        }
+    }
+    return left_node->get_last_key< K >();
+}
+
 template < typename K, typename V >
 template < typename ReqT >
 bool Btree< K, V >::is_split_needed(const BtreeNodePtr& node, ReqT& req) const {
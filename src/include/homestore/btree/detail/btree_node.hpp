@@ -15,6 +15,7 @@
  *********************************************************************************/
 
 #pragma once
+#include <atomic>
 #include <iostream>
 #include <queue>
 #include <iomgr/fiber_lib.hpp>
@@ -36,6 +37,7 @@ struct transient_hdr_t {
 
     /* these variables are accessed without taking lock and are not expected to change after init */
     uint8_t leaf_node{0};
+    uint8_t interpolation_search{0};
     uint64_t max_keys_in_node{0};
 
     bool is_leaf() const { return (leaf_node != 0); }
@@ -100,6 +102,14 @@ public:
     transient_hdr_t m_trans_hdr;
     uint8_t* m_phys_node_buf;
 
+    // Bumped on every write lock and unlock, so it is odd while the node is write locked. Optimistic readers use this
+    // to validate that the node is not modified while they read it without any lock.
+    mutable std::atomic< uint64_t > m_lock_version{0};
+
+    // Set on the left leaf of a B-link split till the separator of its right sibling is installed in the parent. It is
+    // changed under the write lock of the node and read by the optimistic readers without any lock too.
+    std::atomic< bool > m_split_pending{false};
+
 public:
     BtreeNode(uint8_t* node_buf, bnodeid_t id, bool init_buf, bool is_leaf, BtreeConfig const& cfg) :
             m_phys_node_buf{node_buf} {
@@ -107,13 +117,14 @@ public:
             new (node_buf) persistent_hdr_t{};
             set_node_id(id);
             set_leaf(is_leaf);
-            set_node_size(cfg.node_size());
+            set_node_size(cfg.node_size(is_leaf));
         } else {
             DEBUG_ASSERT_EQ(node_id(), id);
             DEBUG_ASSERT_EQ(magic(), BTREE_NODE_MAGIC);
             DEBUG_ASSERT_EQ(version(), BTREE_NODE_VERSION);
         }
         m_trans_hdr.leaf_node = is_leaf;
+        m_trans_hdr.interpolation_search = cfg.m_interpolation_search;
 #ifdef _PRERELEASE
         m_trans_hdr.max_keys_in_node = cfg.m_max_keys_in_node;
 #endif
@@ -333,12 +344,15 @@ public:
 
     // uint32_t total_entries() const { return (has_valid_edge() ? total_entries() + 1 : total_entries()); }
     uint64_t max_keys_in_node() const { return m_trans_hdr.max_keys_in_node; }
+    bool is_interpolation_search() const { return (m_trans_hdr.interpolation_search != 0); }
 
     void lock(locktype_t l) const {
         if (l == locktype_t::READ) {
             m_trans_hdr.lock.lock_shared();
         } else if (l == locktype_t::WRITE) {
             m_trans_hdr.lock.lock();
+            m_lock_version.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
         }
     }
 
@@ -346,10 +360,24 @@ public:
         if (l == locktype_t::READ) {
             m_trans_hdr.lock.unlock_shared();
         } else if (l == locktype_t::WRITE) {
+            m_lock_version.fetch_add(1, std::memory_order_release);
             m_trans_hdr.lock.unlock();
         }
     }
 
+    // Start reading the node without taking any lock. Returns false if node is write locked at the moment, in which
+    // case the reader is expected to fallback to locked read
+    bool optimistic_read_begin(uint64_t& version) const {
+        version = m_lock_version.load(std::memory_order_acquire);
+        return ((version & 0x1) == 0);
+    }
+
+    // Validate that none of the reads done after optimistic_read_begin() raced with a writer
+    bool optimistic_read_validate(uint64_t version) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return (m_lock_version.load(std::memory_order_relaxed) == version);
+    }
+
     void lock_upgrade() {
         m_trans_hdr.upgraders.increment(1);
         this->unlock(locktype_t::READ);
@@ -435,7 +463,7 @@ public:
     virtual std::string to_dot_keys() const = 0;
 
 protected:
-    node_find_result_t bsearch_node(const BtreeKey& key) const {
+    virtual node_find_result_t bsearch_node(const BtreeKey& key) const {
         DEBUG_ASSERT_EQ(magic(), BTREE_NODE_MAGIC);
         auto [found, idx] = bsearch(-1, total_entries(), key);
         if (found) { DEBUG_ASSERT_LT(idx, total_entries()); }
@@ -476,6 +504,14 @@ public:
     uint8_t* node_data_area() { return (m_phys_node_buf + sizeof(persistent_hdr_t)); }
     const uint8_t* node_data_area_const() const { return (m_phys_node_buf + sizeof(persistent_hdr_t)); }
 
+    // Starts bringing the header and the start of the data area to the cpu cache, without reading them, so that the
+    // misses on them overlap with whatever is done before the node is searched, like acquiring its lock
+    void prefetch_for_search() const {
+        __builtin_prefetch(m_phys_node_buf);
+        __builtin_prefetch(m_phys_node_buf + 64);
+        __builtin_prefetch(node_data_area_const() + 64);
+    }
+
     uint8_t magic() const { return get_persistent_header_const()->magic; }
     void set_magic() { get_persistent_header()->magic = BTREE_NODE_MAGIC; }
 
@@ -522,10 +558,18 @@ public:
 
     void set_node_deleted() { get_persistent_header()->node_deleted = 0x1; }
     bool is_node_deleted() const { return (get_persistent_header_const()->node_deleted == 0x1); }
+    bool is_split_pending() const { return m_split_pending.load(std::memory_order_acquire); }
+    void set_split_pending(bool pending) { m_split_pending.store(pending, std::memory_order_release); }
 
     BtreeLinkInfo link_info() const { return BtreeLinkInfo{node_id(), link_version()}; }
 
     virtual uint32_t occupied_size() const { return (node_data_size() - available_size()); }
+
+    // Node data is only within [0, head) and [tail, node_data_size()) of the data area, so that a copy of the node need
+    // not copy the rest. Nodes whose free space is not in one contiguous gap report the entire data area as in use.
+    virtual std::pair< uint32_t, uint32_t > used_data_extents() const {
+        return std::pair{node_data_size(), node_data_size()};
+    }
     bool is_merge_needed(const BtreeConfig& cfg) const {
 #if 0
 #ifdef _PRERELEASE
@@ -537,7 +581,7 @@ public:
        if (ret && occupied_size() < (ret.get() * node_data_size() / 100)) { return true; }
 #endif
 #endif
-        return (occupied_size() < cfg.suggested_min_size());
+        return (occupied_size() < cfg.suggested_min_size(is_leaf()));
     }
 
     bnodeid_t next_bnode() const { return get_persistent_header_const()->next_node; }
@@ -19,6 +19,7 @@
 #include <homestore/btree/detail/simple_node.hpp>
 #include <homestore/btree/detail/varlen_node.hpp>
 #include <homestore/btree/detail/prefix_node.hpp>
+#include <homestore/btree/detail/compact_node.hpp>
 #include <sisl/fds/utils.hpp>
 // #include <iomgr/iomgr_flip.hpp>
 
@@ -62,6 +63,7 @@ btree_status_t Btree< K, V >::read_and_lock_node(bnodeid_t id, BtreeNodePtr& nod
         return ret;
     }
 
+    if (m_bt_cfg.m_descent_prefetch) { node_ptr->prefetch_for_search(); }
     auto acq_lock = (node_ptr->is_leaf()) ? leaf_lock_type : int_lock_type;
     ret = lock_node(node_ptr, acq_lock, context);
     if (ret != btree_status_t::success) { BT_LOG(ERROR, "Node lock and refresh failed"); }
@@ -88,11 +90,32 @@ btree_status_t Btree< K, V >::get_child_and_lock_node(const BtreeNodePtr& node,
     return (read_and_lock_node(child_info.bnode_id(), child_node, int_lock_type, leaf_lock_type, context));
 }
 
+// Readers arriving at the left leaf of a pending B-link split with a key beyond its high key, have to go right by the
+// link to find it. If so, the right sibling is read locked into right_node and the read locked leaf is unlocked.
+template < typename K, typename V >
+bool Btree< K, V >::lock_right_on_split(const BtreeNodePtr& node, const BtreeKey& key, BtreeNodePtr& right_node,
+                                        void* context) const {
+    if (!node->is_split_pending()) { return false; }
+    {
+        std::unique_lock lg{m_split_mtx};
+        auto const it = m_split_high_keys.find(node->node_id());
+        if ((it == m_split_high_keys.end()) || (it->second.compare(key) >= 0)) { return false; }
+    }
+
+    if (read_and_lock_node(node->next_bnode(), right_node, locktype_t::READ, locktype_t::READ, context) !=
+        btree_status_t::success) {
+        return false;
+    }
+    unlock_node(node, locktype_t::READ);
+    COUNTER_INCREMENT(m_metrics, btree_blink_move_right_count, 1);
+    return true;
+}
+
 template < typename K, typename V >
 btree_status_t Btree< K, V >::write_node(const BtreeNodePtr& node, void* context) {
     COUNTER_INCREMENT_IF_ELSE(m_metrics, node->is_leaf(), btree_leaf_node_writes, btree_int_node_writes, 1);
     HISTOGRAM_OBSERVE_IF_ELSE(m_metrics, node->is_leaf(), btree_leaf_node_occupancy, btree_int_node_occupancy,
-                              ((m_node_size - node->available_size()) * 100) / m_node_size);
+                              (node->occupied_size() * 100) / node->node_data_size());
 
     return (write_node_impl(node, context));
 }
@@ -207,6 +230,9 @@ btree_status_t Btree< K, V >::upgrade_node_lock(const BtreeNodePtr& node, lockty
 template < typename K, typename V >
 btree_status_t Btree< K, V >::_lock_node(const BtreeNodePtr& node, locktype_t type, void* context, const char* fname,
                                          int line) const {
+    // Nodes of a read only btree never change underneath the readers
+    if (m_bt_cfg.m_read_only) { return refresh_node(node, false /* for_read_modify_write */, context); }
+
     _start_of_lock(node, type, fname, line);
     node->lock(type);
 
@@ -222,6 +248,7 @@ btree_status_t Btree< K, V >::_lock_node(const BtreeNodePtr& node, locktype_t ty
 
 template < typename K, typename V >
 void Btree< K, V >::unlock_node(const BtreeNodePtr& node, locktype_t type) const {
+    if (m_bt_cfg.m_read_only) { return; }
     node->unlock(type);
     auto time_spent = end_of_lock(node, type);
     observe_lock_time(node, type, time_spent);
@@ -254,38 +281,50 @@ static BtreeNode* create_node(Args&&... args) {
 
 template < typename K, typename V >
 BtreeNode* Btree< K, V >::init_node(uint8_t* node_buf, bnodeid_t id, bool init_buf, bool is_leaf) const {
+    return create_btree_node(node_buf, id, init_buf, is_leaf, m_bt_cfg);
+}
+
+// Nodes do not hold any reference to the btree, so they can be created without the btree instance, given its config
+template < typename K, typename V >
+BtreeNode* Btree< K, V >::create_btree_node(uint8_t* node_buf, bnodeid_t id, bool init_buf, bool is_leaf,
+                                            BtreeConfig const& cfg) {
     BtreeNode* n{nullptr};
-    btree_node_type node_type = is_leaf ? m_bt_cfg.leaf_node_type() : m_bt_cfg.interior_node_type();
+    btree_node_type node_type = is_leaf ? cfg.leaf_node_type() : cfg.interior_node_type();
 
     switch (node_type) {
     case btree_node_type::VAR_OBJECT:
-        n = is_leaf ? create_node< VarObjSizeNode< K, V > >(node_buf, id, init_buf, true, this->m_bt_cfg)
-                    : create_node< VarObjSizeNode< K, BtreeLinkInfo > >(node_buf, id, init_buf, false, this->m_bt_cfg);
+        n = is_leaf ? create_node< VarObjSizeNode< K, V > >(node_buf, id, init_buf, true, cfg)
+                    : create_node< VarObjSizeNode< K, BtreeLinkInfo > >(node_buf, id, init_buf, false, cfg);
         break;
 
     case btree_node_type::FIXED:
-        n = is_leaf ? create_node< SimpleNode< K, V > >(node_buf, id, init_buf, true, this->m_bt_cfg)
-                    : create_node< SimpleNode< K, BtreeLinkInfo > >(node_buf, id, init_buf, false, this->m_bt_cfg);
+        n = is_leaf ? create_node< SimpleNode< K, V > >(node_buf, id, init_buf, true, cfg)
+                    : create_node< SimpleNode< K, BtreeLinkInfo > >(node_buf, id, init_buf, false, cfg);
         break;
 
     case btree_node_type::VAR_VALUE:
         n = is_leaf
-            ? create_node< VarValueSizeNode< K, V > >(node_buf, id, init_buf, true, this->m_bt_cfg)
-            : create_node< VarValueSizeNode< K, BtreeLinkInfo > >(node_buf, id, init_buf, false, this->m_bt_cfg);
+            ? create_node< VarValueSizeNode< K, V > >(node_buf, id, init_buf, true, cfg)
+            : create_node< VarValueSizeNode< K, BtreeLinkInfo > >(node_buf, id, init_buf, false, cfg);
         break;
 
     case btree_node_type::VAR_KEY:
-        n = is_leaf ? create_node< VarKeySizeNode< K, V > >(node_buf, id, init_buf, true, this->m_bt_cfg)
-                    : create_node< VarKeySizeNode< K, BtreeLinkInfo > >(node_buf, id, init_buf, false, this->m_bt_cfg);
+        n = is_leaf ? create_node< VarKeySizeNode< K, V > >(node_buf, id, init_buf, true, cfg)
+                    : create_node< VarKeySizeNode< K, BtreeLinkInfo > >(node_buf, id, init_buf, false, cfg);
         break;
 
     case btree_node_type::PREFIX:
-        n = is_leaf ? create_node< FixedPrefixNode< K, V > >(node_buf, id, init_buf, true, this->m_bt_cfg)
-                    : create_node< FixedPrefixNode< K, BtreeLinkInfo > >(node_buf, id, init_buf, false, this->m_bt_cfg);
+        n = is_leaf ? create_node< FixedPrefixNode< K, V > >(node_buf, id, init_buf, true, cfg)
+                    : create_node< FixedPrefixNode< K, BtreeLinkInfo > >(node_buf, id, init_buf, false, cfg);
+        break;
+
+    case btree_node_type::COMPACT:
+        n = is_leaf ? create_node< CompactNode< K, V > >(node_buf, id, init_buf, true, cfg)
+                    : create_node< CompactNode< K, BtreeLinkInfo > >(node_buf, id, init_buf, false, cfg);
         break;
 
     default:
-        BT_REL_ASSERT(false, "Unsupported node type {}", node_type);
+        RELEASE_ASSERT(false, "Unsupported node type {}", node_type);
         break;
     }
     return n;
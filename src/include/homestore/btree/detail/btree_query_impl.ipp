@@ -32,6 +32,11 @@ btree_status_t Btree< K, V >::do_sweep_query(BtreeNodePtr& my_node, BtreeQueryRe
             if (next_node) {
                 unlock_node(my_node, locktype_t::READ);
                 my_node = next_node;
+
+                // Keep atleast one leaf being read ahead, after we go past the siblings read ahead from the parent
+                if ((m_bt_cfg.m_sweep_readahead_nodes != 0) && (my_node->next_bnode() != empty_bnodeid)) {
+                    prefetch_nodes({my_node->next_bnode()});
+                }
             }
 
             uint32_t start_ind{0};
@@ -71,6 +76,9 @@ btree_status_t Btree< K, V >::do_sweep_query(BtreeNodePtr& my_node, BtreeQueryRe
     ASSERT_IS_VALID_INTERIOR_CHILD_INDX(isfound, idx, my_node);
     if (qreq.route_tracing) { append_route_trace(qreq, my_node, btree_event_t::READ, idx, idx); }
 
+    // Sweep is going to walk across the leaves next to the start leaf, start reading them ahead while we consume this
+    if ((m_bt_cfg.m_sweep_readahead_nodes != 0) && (my_node->level() == 1)) { readahead_children(my_node, idx + 1); }
+
     BtreeNodePtr child_node;
     ret = read_and_lock_node(start_child_info.bnode_id(), child_node, locktype_t::READ, locktype_t::READ,
                              qreq.m_op_context);
@@ -96,6 +104,13 @@ btree_status_t Btree< K, V >::do_traversal_query(const BtreeNodePtr& my_node, Bt
         if (qreq.route_tracing) {
             append_route_trace(qreq, my_node, btree_event_t::READ, start_ind, start_ind + cur_count);
         }
+
+        // Rest of the range could be right past a pending B-link split, which the parent doesn't route to yet
+        BtreeNodePtr right_node;
+        if ((out_values.size() < qreq.batch_size()) &&
+            lock_right_on_split(my_node, qreq.input_range().end_key(), right_node, qreq.m_op_context)) {
+            return do_traversal_query(right_node, qreq, out_values);
+        }
         unlock_node(my_node, locktype_t::READ);
         if (ret != btree_status_t::success || out_values.size() >= qreq.batch_size()) {
             if (out_values.size() >= qreq.batch_size()) { ret = btree_status_t::has_more; }
@@ -143,6 +158,140 @@ done:
     return ret;
 }
 
+// Read ahead the children of the parent starting at start_idx, including the edge, upto the configured window
+template < typename K, typename V >
+void Btree< K, V >::readahead_children(const BtreeNodePtr& parent_node, uint32_t start_idx) const {
+    auto const nchildren = parent_node->total_entries() + (parent_node->has_valid_edge() ? 1 : 0);
+    readahead_children(parent_node, start_idx, std::min(start_idx + m_bt_cfg.m_sweep_readahead_nodes, nchildren));
+}
+
+// Read ahead the children of the parent in [start_idx, end_idx), where end_idx could include the edge
+template < typename K, typename V >
+void Btree< K, V >::readahead_children(const BtreeNodePtr& parent_node, uint32_t start_idx, uint32_t end_idx) const {
+    if (start_idx >= end_idx) { return; }
+
+    std::vector< bnodeid_t > ids;
+    ids.reserve(end_idx - start_idx);
+    for (auto i{start_idx}; i < end_idx; ++i) {
+        BtreeLinkInfo child_info;
+        parent_node->get_nth_value(i, &child_info, false /* copy */);
+        ids.push_back(child_info.bnode_id());
+    }
+    prefetch_nodes(ids);
+}
+
+// Position the cursor on a read locked leaf and the index of the next entry to yield. If the leaf cursor stopped at is
+// neither freed nor modified since, it resumes from there directly, otherwise it descends from the last yielded key (or
+// range start). Leaf is pinned by the cursor, so it is the same node even if its blk is reused by another node.
+template < typename K, typename V >
+btree_status_t Btree< K, V >::cursor_seek(BtreeCursor< K >& cursor, BtreeNodePtr& leaf, uint32_t& idx) const {
+    btree_status_t ret;
+    if (cursor.m_leaf != nullptr) {
+        leaf = std::move(cursor.m_leaf);
+        ret = lock_node(leaf, locktype_t::READ, cursor.m_op_context);
+        if (ret != btree_status_t::success) { return ret; }
+        if (!leaf->is_node_deleted() && (leaf->node_gen() == cursor.m_leaf_gen) &&
+            (cursor.m_next_idx <= leaf->total_entries())) {
+            idx = cursor.m_next_idx;
+            return btree_status_t::success;
+        }
+        unlock_node(leaf, locktype_t::READ);
+    }
+
+    K const& seek_key = cursor.m_last_key ? *cursor.m_last_key : cursor.m_range.start_key();
+    bool const seek_incl = cursor.m_last_key ? false : cursor.m_range.is_start_inclusive();
+
+    ret = read_and_lock_node(m_root_node_info.bnode_id(), leaf, locktype_t::READ, locktype_t::READ,
+                             cursor.m_op_context);
+    if (ret != btree_status_t::success) { return ret; }
+
+    while (!leaf->is_leaf()) {
+        BtreeLinkInfo child_info;
+        auto const child_idx = leaf->find(seek_key, &child_info, false).second;
+        if ((child_idx == leaf->total_entries()) && !leaf->has_valid_edge()) {
+            // Seek key is beyond the last key of the tree
+            unlock_node(leaf, locktype_t::READ);
+            cursor.m_done = true;
+            return btree_status_t::success;
+        }
+
+        BtreeNodePtr child_node;
+        ret = read_and_lock_node(child_info.bnode_id(), child_node, locktype_t::READ, locktype_t::READ,
+                                 cursor.m_op_context);
+        unlock_node(leaf, locktype_t::READ);
+        if (ret != btree_status_t::success) { return ret; }
+        leaf = std::move(child_node);
+    }
+
+    auto const [found, leaf_idx] = leaf->find(seek_key, nullptr, false);
+    idx = (found && !seek_incl) ? leaf_idx + 1 : leaf_idx;
+    return btree_status_t::success;
+}
+
+// Yield entries from the read locked leaf starting at idx, walking across the sibling leaves until the range end or
+// max_count entries or the callback stops. The position is saved in the cursor and the leaf is unlocked on return.
+template < typename K, typename V >
+btree_status_t Btree< K, V >::do_cursor_next(BtreeCursor< K >& cursor, BtreeNodePtr& leaf, uint32_t idx,
+                                             uint32_t max_count, cursor_cb_t const& cb) const {
+    btree_status_t ret{btree_status_t::success};
+    bool const copy = !cursor.m_zero_copy;
+    bool yielded_in_leaf{false};
+    uint32_t count{0};
+
+    while (true) {
+        auto const next_id = leaf->next_bnode();
+        if (cursor.m_prefetch_next && (next_id != empty_bnodeid) && (idx < leaf->total_entries())) {
+            // Start reading the next leaf in the background, while the current leaf is being consumed
+            prefetch_nodes({next_id});
+        }
+
+        for (; idx < leaf->total_entries(); ++idx) {
+            K key = leaf->get_nth_key< K >(idx, copy);
+            auto const x = key.compare(cursor.m_range.end_key());
+            if ((x > 0) || ((x == 0) && !cursor.m_range.is_end_inclusive())) {
+                cursor.m_done = true;
+                goto done;
+            }
+            if (count == max_count) {
+                ret = btree_status_t::has_more;
+                goto done;
+            }
+
+            V val;
+            leaf->get_nth_value(idx, &val, copy);
+            ++count;
+            yielded_in_leaf = true;
+            if (!cb(key, val)) {
+                ++idx;
+                ret = btree_status_t::has_more;
+                goto done;
+            }
+        }
+
+        if (next_id == empty_bnodeid) {
+            cursor.m_done = true;
+            break;
+        }
+
+        if (yielded_in_leaf) { cursor.m_last_key = leaf->get_last_key< K >(); }
+        BtreeNodePtr next_node;
+        ret = read_and_lock_node(next_id, next_node, locktype_t::READ, locktype_t::READ, cursor.m_op_context);
+        if (ret != btree_status_t::success) { break; }
+        unlock_node(leaf, locktype_t::READ);
+        leaf = std::move(next_node);
+        idx = 0;
+        yielded_in_leaf = false;
+    }
+
+done:
+    if (yielded_in_leaf && (idx > 0)) { cursor.m_last_key = leaf->get_nth_key< K >(idx - 1, true); }
+    cursor.m_leaf_gen = leaf->node_gen();
+    cursor.m_next_idx = idx;
+    unlock_node(leaf, locktype_t::READ);
+    cursor.m_leaf = std::move(leaf);
+    return ret;
+}
+
 #ifdef SERIALIZABLE_QUERY_IMPLEMENTATION
 btree_status_t do_serialzable_query(const BtreeNodePtr& my_node, BtreeSerializableQueryRequest& qreq,
                                     std::vector< std::pair< K, V > >& out_values) {
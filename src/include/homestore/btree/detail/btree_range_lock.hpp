@@ -0,0 +1,168 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include <boost/fiber/condition_variable.hpp>
+#include <boost/fiber/mutex.hpp>
+#include <homestore/btree/btree_kv.hpp>
+
+namespace homestore {
+/*
+ * Key range locks, which isolate the serializable queries from the mutations of the keys in their ranges, while the
+ * node locks are held only for as long as each node is read or written.
+ *
+ * Query read locks its range across all of its pages and mutations write lock the range of keys they modify, for the
+ * duration of the op. Mutations are frequent and the queries are rare, so the write locks are spread across the shards
+ * by the thread taking them and a read lock waits for the overlapping writers in every shard. Writer registers itself
+ * in its shard before it looks for the read locks and a reader publishes its lock before it looks for the writers, so
+ * at least one of them sees the other. A writer which sees an overlapping read lock backs off and waits for it to be
+ * released, so neither of them waits on the other at the same time. Bounds of the ranges are taken as inclusive.
+ */
+template < typename K >
+class BtreeRangeLockTable {
+public:
+    static constexpr uint32_t s_num_shards{16};
+
+    // Read lock of the range held by a serializable query, till it is destroyed
+    class ReadLock {
+    public:
+        ReadLock(BtreeRangeLockTable& table, BtreeKeyRange< K > const& range) : m_table{table} {
+            m_it = m_table.lock_read(range);
+        }
+        ReadLock(ReadLock const&) = delete;
+        ReadLock& operator=(ReadLock const&) = delete;
+        ~ReadLock() { m_table.unlock_read(m_it); }
+
+    private:
+        BtreeRangeLockTable& m_table;
+        typename std::list< BtreeKeyRange< K > >::iterator m_it;
+    };
+
+    // Write lock of the keys [start_key, end_key] held by a mutation, till it is destroyed. Keys are expected to
+    // outlive the lock.
+    class WriteLock {
+    public:
+        WriteLock(BtreeRangeLockTable& table, BtreeKey const& start_key, BtreeKey const& end_key) :
+                m_table{table}, m_range{&start_key, &end_key} {
+            m_shard = m_table.lock_write(m_range);
+        }
+        WriteLock(WriteLock const&) = delete;
+        WriteLock& operator=(WriteLock const&) = delete;
+        ~WriteLock() { m_table.unlock_write(m_shard, m_range); }
+
+    private:
+        BtreeRangeLockTable& m_table;
+        std::pair< BtreeKey const*, BtreeKey const* > m_range;
+        uint32_t m_shard;
+    };
+
+private:
+    using write_range_t = std::pair< BtreeKey const*, BtreeKey const* >;
+
+    struct write_shard {
+        boost::fibers::mutex mtx;
+        boost::fibers::condition_variable cv;
+        std::vector< write_range_t > ranges;
+    };
+
+    static bool overlaps(BtreeKeyRange< K > const& r, write_range_t const& w) {
+        return (r.start_key().compare(*w.second) <= 0) && (r.end_key().compare(*w.first) >= 0);
+    }
+
+    bool read_locked(write_range_t const& w) const {
+        for (auto const& r : m_read_ranges) {
+            if (overlaps(r, w)) { return true; }
+        }
+        return false;
+    }
+
+    typename std::list< BtreeKeyRange< K > >::iterator lock_read(BtreeKeyRange< K > const& range) {
+        typename std::list< BtreeKeyRange< K > >::iterator it;
+        {
+            std::unique_lock lg{m_read_mtx};
+            it = m_read_ranges.insert(m_read_ranges.end(), range);
+            m_nread_locked.fetch_add(1, std::memory_order_seq_cst);
+        }
+
+        for (auto& s : m_write_shards) {
+            std::unique_lock lg{s.mtx};
+            s.cv.wait(lg, [&s, &range]() {
+                return std::none_of(s.ranges.cbegin(), s.ranges.cend(),
+                                    [&range](write_range_t const& w) { return overlaps(range, w); });
+            });
+        }
+        return it;
+    }
+
+    void unlock_read(typename std::list< BtreeKeyRange< K > >::iterator it) {
+        {
+            std::unique_lock lg{m_read_mtx};
+            m_read_ranges.erase(it);
+            m_nread_locked.fetch_sub(1, std::memory_order_seq_cst);
+        }
+        m_read_cv.notify_all();
+    }
+
+    uint32_t lock_write(write_range_t const& w) {
+        static std::atomic< uint32_t > s_next_shard{0};
+        static thread_local uint32_t const t_shard{s_next_shard.fetch_add(1, std::memory_order_relaxed) %
+                                                   s_num_shards};
+        auto& s = m_write_shards[t_shard];
+
+        while (true) {
+            {
+                std::unique_lock lg{s.mtx};
+                s.ranges.push_back(w);
+            }
+            if (m_nread_locked.load(std::memory_order_seq_cst) == 0) { break; }
+
+            std::unique_lock rlg{m_read_mtx};
+            if (!read_locked(w)) { break; }
+
+            // Back off, so that the reader waiting on this shard is not blocked, and wait for the read lock to go
+            unlock_write(t_shard, w);
+            m_read_cv.wait(rlg, [this, &w]() { return !read_locked(w); });
+        }
+        return t_shard;
+    }
+
+    void unlock_write(uint32_t shard, write_range_t const& w) {
+        auto& s = m_write_shards[shard];
+        {
+            std::unique_lock lg{s.mtx};
+            auto it = std::find(s.ranges.begin(), s.ranges.end(), w);
+            *it = s.ranges.back();
+            s.ranges.pop_back();
+        }
+        if (m_nread_locked.load(std::memory_order_seq_cst) != 0) { s.cv.notify_all(); }
+    }
+
+private:
+    std::array< write_shard, s_num_shards > m_write_shards;
+
+    boost::fibers::mutex m_read_mtx;
+    boost::fibers::condition_variable m_read_cv;
+    std::list< BtreeKeyRange< K > > m_read_ranges;
+    std::atomic< uint32_t > m_nread_locked{0};
+};
+} // namespace homestore
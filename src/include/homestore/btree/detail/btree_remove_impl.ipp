@@ -33,6 +33,8 @@ btree_status_t Btree< K, V >::do_remove(const BtreeNodePtr& my_node, locktype_t
 
         if constexpr (std::is_same_v< ReqT, BtreeSingleRemoveRequest >) {
             if ((modified = my_node->remove_one(req.key(), nullptr, req.m_outval))) { ++removed_count; }
+        } else if constexpr (std::is_same_v< ReqT, BtreeRebalanceRequest< K > >) {
+            // Rebalance is all about the interior nodes on its route, leaf is left untouched
         } else if constexpr (std::is_same_v< ReqT, BtreeRangeRemoveRequest< K > >) {
             removed_count = to_variant_node(my_node)->multi_remove(req.working_range(), req.m_filter_cb);
             modified = (removed_count != 0);
@@ -53,6 +55,9 @@ btree_status_t Btree< K, V >::do_remove(const BtreeNodePtr& my_node, locktype_t
         return modified ? btree_status_t::success : btree_status_t::not_found;
     }
 
+    // In lazy merge mode, only rebalance request merges the underfull child, rest of them just mark it
+    bool const merge_inline = !m_bt_cfg.m_lazy_merge || std::is_same_v< ReqT, BtreeRebalanceRequest< K > >;
+
 retry:
     locktype_t child_cur_lock = locktype_t::NONE;
     uint32_t curr_idx;
@@ -65,7 +70,8 @@ retry:
     };
 
     // Get the childPtr for given key.
-    if constexpr (std::is_same_v< ReqT, BtreeSingleRemoveRequest >) {
+    if constexpr (std::is_same_v< ReqT, BtreeSingleRemoveRequest > ||
+                  std::is_same_v< ReqT, BtreeRebalanceRequest< K > >) {
         auto const [found, idx] = my_node->find(req.key(), nullptr, false);
         ASSERT_IS_VALID_INTERIOR_CHILD_INDX(found, idx, my_node);
         end_idx = start_idx = idx;
@@ -86,6 +92,12 @@ retry:
     }
 
     if (req.route_tracing) { append_route_trace(req, my_node, btree_event_t::READ, start_idx, end_idx); }
+
+    // Leaves after the first one matched are read in the background, while the first one is being worked on
+    if (m_bt_cfg.m_descent_prefetch && (my_node->level() == 1) && (start_idx < end_idx)) {
+        readahead_children(my_node, start_idx + 1, end_idx + 1);
+    }
+
     curr_idx = start_idx;
     while (curr_idx <= end_idx) {
         BtreeLinkInfo child_info;
@@ -95,6 +107,13 @@ retry:
         if (ret != btree_status_t::success) { goto out_return; }
         child_cur_lock = child_node->is_leaf() ? locktype_t::WRITE : locktype_t::READ;
 
+        if (child_node->is_split_pending()) {
+            // Writers never go right past a B-link split, they install its separator in this node first
+            ret = complete_split(my_node, curlock, child_node, child_cur_lock, req.m_op_context);
+            if (ret != btree_status_t::success) { goto out_return; }
+            goto retry;
+        }
+
         if (child_node->is_merge_needed(m_bt_cfg)) {
             // If child node is minimal and can be merged
             uint32_t node_end_idx = my_node->total_entries();
@@ -103,7 +122,10 @@ retry:
                 node_end_idx = curr_idx + m_bt_cfg.m_max_merge_nodes - 1;
             }
 
-            if (node_end_idx > curr_idx) {
+            if ((node_end_idx > curr_idx) && !merge_inline) {
+                // Parent key of the child routes the rebalancer to this child later
+                mark_underfull(my_node->get_nth_key< K >(curr_idx, true));
+            } else if (node_end_idx > curr_idx) {
                 // If we are unable to upgrade the node, ask the caller to retry.
                 ret = upgrade_node_locks(my_node, child_node, curlock, child_cur_lock, req.m_op_context);
                 if (ret != btree_status_t::success) { goto out_return; }
@@ -174,6 +196,12 @@ out_return:
     return (at_least_one_child_modified) ? btree_status_t::success : ret;
 }
 
+template < typename K, typename V >
+void Btree< K, V >::mark_underfull(K&& key) {
+    std::unique_lock lg(m_underfull_mtx);
+    if (m_underfull_keys.insert(std::move(key)).second) { COUNTER_INCREMENT(m_metrics, btree_lazy_merge_marks, 1); }
+}
+
 template < typename K, typename V >
 template < typename ReqT >
 btree_status_t Btree< K, V >::check_collapse_root(ReqT& req) {
@@ -261,12 +289,17 @@ btree_status_t Btree< K, V >::merge_nodes(const BtreeNodePtr& parent_node, const
         BT_NODE_LOG_ASSERT_EQ(child->is_node_deleted(), false, child);
 
         old_nodes.push_back(child);
+        if (child->is_split_pending()) {
+            // Its right sibling is not under this parent yet, leave it to merge once the split is completed
+            ret = btree_status_t::merge_not_required;
+            goto out;
+        }
         total_size += child->occupied_size();
     }
 
     // Determine if packing the nodes would result in reducing the number of nodes, if so go with that. If else
     // we revert back to rebalancing the nodes.
-    num_nodes = (total_size == 0) ? 1 : (total_size - 1) / m_bt_cfg.ideal_fill_size() + 1;
+    num_nodes = (total_size == 0) ? 1 : (total_size - 1) / m_bt_cfg.ideal_fill_size(leftmost_node->is_leaf()) + 1;
     if (num_nodes >= (old_nodes.size() + 1)) {
         // Only option is to rebalance the nodes across. If we are asked not to do so, skip it.
         if (!m_bt_cfg.m_rebalance_turned_on) {
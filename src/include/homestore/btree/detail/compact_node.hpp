@@ -0,0 +1,459 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <sisl/logging/logging.h>
+#include <homestore/btree/detail/variant_node.hpp>
+#include <homestore/btree/btree_kv.hpp>
+#include "homestore/index/index_internal.hpp"
+
+SISL_LOGGING_DECL(btree)
+
+namespace homestore {
+#pragma pack(1)
+struct compact_node_header {
+    uint16_t m_data_end; // Offset right after the last packed object
+};
+#pragma pack()
+
+// Internal format of compact node:
+// [Persistent Header][compact node header][obj][obj]..[obj] ... free space ... [slot n-1]..[slot 1][slot 0]
+//
+// Each obj is [value len][key len][key][value], where lengths are encoded in 1 byte if it is less than 128 and 2 bytes
+// otherwise, and key len is not stored at all for fixed size keys. Objects are always kept packed without any holes,
+// so that every byte of the node is usable without compaction. The slot directory at the tail of the node holds the
+// 2 byte offset of each object in sorted key order. Compared to VariableNode, which spends 6 bytes of record per
+// entry, typical per entry overhead here is 3 bytes, which is meant for footprint sensitive MemBtree instances.
+template < typename K, typename V >
+class CompactNode : public VariantNode< K, V > {
+public:
+    using BtreeNode::get_nth_key_internal;
+    using BtreeNode::get_nth_key_size;
+    using BtreeNode::get_nth_obj_size;
+    using BtreeNode::get_nth_value;
+    using BtreeNode::get_nth_value_size;
+    using BtreeNode::to_string;
+    using VariantNode< K, V >::get_nth_value;
+
+    using slot_t = uint16_t;
+    static constexpr uint32_t max_len_in_byte = 0x80;
+    static constexpr uint32_t max_len = 0x7FFF;
+
+    CompactNode(uint8_t* node_buf, bnodeid_t id, bool init, bool is_leaf, const BtreeConfig& cfg) :
+            VariantNode< K, V >(node_buf, id, init, is_leaf, cfg) {
+        this->set_node_type(btree_node_type::COMPACT);
+        if (init) { get_compact_header()->m_data_end = sizeof(compact_node_header); }
+    }
+    virtual ~CompactNode() = default;
+
+    btree_status_t insert(uint32_t ind, const BtreeKey& key, const BtreeValue& val) override {
+        auto const sz = insert(ind, key.serialize(), val.serialize());
+        return (sz == 0) ? btree_status_t::space_not_avail : btree_status_t::success;
+    }
+
+    void update(uint32_t ind, const BtreeValue& val) override {
+        if (ind == this->total_entries()) {
+            DEBUG_ASSERT_EQ(this->is_leaf(), false);
+            this->set_edge_value(val);
+            this->inc_gen();
+        } else {
+            K key = BtreeNode::get_nth_key< K >(ind, true);
+            update(ind, key, val);
+        }
+    }
+
+    void update(uint32_t ind, const BtreeKey& key, const BtreeValue& val) override {
+        DEBUG_ASSERT_LE(ind, this->total_entries());
+        if (ind == this->total_entries()) {
+            DEBUG_ASSERT_EQ(this->is_leaf(), false);
+            this->set_edge_value(val);
+            this->inc_gen();
+            return;
+        }
+
+        sisl::blob const kb = key.serialize();
+        sisl::blob const vb = val.serialize();
+        if (packed_obj_size(kb.size(), vb.size()) == nth_obj_total_size(ind)) {
+            // Same footprint, overwrite in place, so that rest of the packed objects need not be moved
+            encode_obj(obj_ptr_mutable(ind), kb, vb);
+            this->inc_gen();
+        } else {
+            remove(ind, ind);
+            insert(ind, kb, vb);
+        }
+#ifndef NDEBUG
+        validate_sanity();
+#endif
+    }
+
+    // ind_s and ind_e are inclusive
+    void remove(uint32_t ind_s, uint32_t ind_e) override {
+        uint32_t const total_entries = this->total_entries();
+        DEBUG_ASSERT_GE(total_entries, ind_s, "node={}", to_string());
+        DEBUG_ASSERT_GE(total_entries, ind_e, "node={}", to_string());
+
+        if (ind_e == total_entries) { // edge entry
+            DEBUG_ASSERT((!this->is_leaf() && this->has_valid_edge()), "node={}", to_string());
+            V last_1_val;
+            get_nth_value(ind_s - 1, &last_1_val, false);
+            this->set_edge_value(last_1_val);
+            remove_objs(ind_s - 1, total_entries - 1);
+        } else {
+            remove_objs(ind_s, ind_e);
+        }
+        this->inc_gen();
+#ifndef NDEBUG
+        validate_sanity();
+#endif
+    }
+
+    void remove_all(const BtreeConfig&) override {
+        this->sub_entries(this->total_entries());
+        this->invalidate_edge();
+        this->inc_gen();
+        get_compact_header()->m_data_end = sizeof(compact_node_header);
+    }
+
+    uint32_t move_out_to_right_by_entries(const BtreeConfig& cfg, BtreeNode& o, uint32_t nentries) override {
+        auto& other = static_cast< CompactNode& >(o);
+        auto const this_gen = this->node_gen();
+        auto const other_gen = other.node_gen();
+
+        auto const this_nentries = this->total_entries();
+        nentries = std::min(nentries, this_nentries);
+        if (nentries == 0) { return 0; /* Nothing to move */ }
+
+        uint32_t nmoved{0};
+        while (nmoved < nentries) {
+            auto const ind = this_nentries - nmoved - 1;
+            if (other.insert(0, nth_key_blob(ind), nth_value_blob(ind)) == 0) { break; }
+            ++nmoved;
+        }
+
+        if (!this->is_leaf() && (other.total_entries() != 0)) {
+            // Incase this node is an edge node, move the stick to the right hand side node
+            other.set_edge_info(this->edge_info());
+            this->invalidate_edge();
+        }
+        if (nmoved) { remove_objs(this_nentries - nmoved, this_nentries - 1); }
+
+        this->set_gen(this_gen + 1);
+        other.set_gen(other_gen + 1);
+        return nmoved;
+    }
+
+    uint32_t move_out_to_right_by_size(const BtreeConfig& cfg, BtreeNode& o, uint32_t size_to_move) override {
+        auto& other = static_cast< CompactNode& >(o);
+        auto const this_gen = this->node_gen();
+        auto const other_gen = other.node_gen();
+        uint32_t nmoved{0};
+
+        uint32_t ind = this->total_entries() - 1;
+        while (ind > 0) {
+            auto const sz = nth_entry_size(ind);
+            if (sz > size_to_move) { break; } // We reached threshold of how much we could move
+            if (other.insert(0, nth_key_blob(ind), nth_value_blob(ind)) == 0) { break; }
+            --ind;
+            ++nmoved;
+            size_to_move -= sz;
+        }
+        if (nmoved) { remove_objs(ind + 1, this->total_entries() - 1); }
+
+        if (!this->is_leaf() && (other.total_entries() != 0)) {
+            // Incase this node is an edge node, move the stick to the right hand side node
+            other.set_edge_info(this->edge_info());
+            this->invalidate_edge();
+        }
+
+        this->set_gen(this_gen + 1);
+        other.set_gen(other_gen + 1);
+        return nmoved;
+    }
+
+    uint32_t num_entries_by_size(uint32_t start_idx, uint32_t size) const override {
+        auto idx = start_idx;
+        uint32_t cum_size{0};
+
+        while (idx < this->total_entries()) {
+            cum_size += nth_entry_size(idx);
+            if (cum_size > size) { break; }
+            ++idx;
+        }
+        return idx - start_idx;
+    }
+
+    uint32_t copy_by_size(const BtreeConfig& cfg, const BtreeNode& o, uint32_t start_idx, uint32_t copy_size) override {
+        auto& other = static_cast< const CompactNode& >(o);
+        auto const this_gen = this->node_gen();
+
+        auto idx = start_idx;
+        uint32_t n{0};
+        while (idx < other.total_entries()) {
+            // We reached threshold of how much we could move
+            if (other.nth_entry_size(idx) > copy_size) { break; }
+
+            auto const sz = insert(this->total_entries(), other.nth_key_blob(idx), other.nth_value_blob(idx));
+            if (sz == 0) { break; }
+            ++n;
+            ++idx;
+            copy_size -= sz;
+        }
+        this->set_gen(this_gen + 1);
+
+        // If we copied everything from start_idx till end and if its an edge node, need to copy the edge id as well.
+        if (other.has_valid_edge() && ((start_idx + n) == other.total_entries())) {
+            this->set_edge_info(other.edge_info());
+        }
+        return n;
+    }
+
+    uint32_t copy_by_entries(const BtreeConfig& cfg, const BtreeNode& o, uint32_t start_idx,
+                             uint32_t nentries) override {
+        auto& other = static_cast< const CompactNode& >(o);
+        auto const this_gen = this->node_gen();
+
+        nentries = std::min(nentries, other.total_entries() - start_idx);
+        auto idx = start_idx;
+        uint32_t n{0};
+        while (n < nentries) {
+            if (insert(this->total_entries(), other.nth_key_blob(idx), other.nth_value_blob(idx)) == 0) { break; }
+            ++n;
+            ++idx;
+        }
+        this->set_gen(this_gen + 1);
+
+        // If we copied everything from start_idx till end and if its an edge node, need to copy the edge id as well.
+        if (other.has_valid_edge() && ((start_idx + n) == other.total_entries())) {
+            this->set_edge_info(other.edge_info());
+        }
+        return n;
+    }
+
+    uint32_t available_size() const override {
+        return this->node_data_size() - get_compact_header_const()->m_data_end -
+            (this->total_entries() * sizeof(slot_t));
+    }
+
+    uint32_t occupied_size() const override {
+        return get_compact_header_const()->m_data_end - sizeof(compact_node_header) +
+            (this->total_entries() * sizeof(slot_t));
+    }
+
+    std::pair< uint32_t, uint32_t > used_data_extents() const override {
+        return std::pair{uint32_cast(get_compact_header_const()->m_data_end),
+                         uint32_cast(this->node_data_size() - (this->total_entries() * sizeof(slot_t)))};
+    }
+
+    bool has_room_for_put(btree_put_type put_type, uint32_t key_size, uint32_t value_size) const override {
+        auto needed_size = packed_obj_size(key_size, value_size);
+        if ((put_type == btree_put_type::UPSERT) || (put_type == btree_put_type::INSERT)) {
+            needed_size += sizeof(slot_t);
+        }
+        return (available_size() >= needed_size);
+    }
+
+    void get_nth_key_internal(uint32_t ind, BtreeKey& out_key, bool copy) const override {
+        DEBUG_ASSERT_LT(ind, this->total_entries(), "node={}", to_string());
+        out_key.deserialize(nth_key_blob(ind), copy);
+    }
+
+    uint32_t get_nth_key_size(uint32_t ind) const override { return decode_obj(obj_ptr(ind)).key_size; }
+
+    void get_nth_value(uint32_t ind, BtreeValue* out_val, bool copy) const override {
+        if (ind == this->total_entries()) {
+            DEBUG_ASSERT_EQ(this->is_leaf(), false, "get_nth_value out-of-bound");
+            DEBUG_ASSERT_EQ(this->has_valid_edge(), true, "get_nth_value out-of-bound");
+            *(r_cast< BtreeLinkInfo* >(out_val)) = this->get_edge_value();
+        } else {
+            out_val->deserialize(nth_value_blob(ind), copy);
+        }
+    }
+
+    uint32_t get_nth_value_size(uint32_t ind) const override { return decode_obj(obj_ptr(ind)).value_size; }
+
+    std::string to_string(bool print_friendly = false) const override {
+        auto str = fmt::format(
+            "{}id={} level={} nEntries={} {} free_space={}{} ",
+            (print_friendly ? "---------------------------------------------------------------------\n" : ""),
+            this->node_id(), this->level(), this->total_entries(), (this->is_leaf() ? "LEAF" : "INTERIOR"),
+            available_size(),
+            (this->next_bnode() == empty_bnodeid) ? "" : fmt::format(" next_node={}", this->next_bnode()));
+        if (!this->is_leaf() && (this->has_valid_edge())) {
+            fmt::format_to(std::back_inserter(str), "edge_id={}.{}", this->edge_info().m_bnodeid,
+                           this->edge_info().m_link_version);
+        }
+        for (uint32_t i{0}; i < this->total_entries(); ++i) {
+            V val;
+            get_nth_value(i, &val, false);
+            fmt::format_to(std::back_inserter(str), "{}Entry{} [Key={} Val={}]", (print_friendly ? "\n\t" : " "), i + 1,
+                           BtreeNode::get_nth_key< K >(i, false).to_string(), val.to_string());
+        }
+        return str;
+    }
+
+    std::string to_dot_keys() const override { return "NOT Supported"; }
+
+#ifndef NDEBUG
+    void validate_sanity() {
+        K prev_key;
+        for (uint32_t i{0}; i < this->total_entries(); ++i) {
+            K key = BtreeNode::get_nth_key< K >(i, false);
+            if ((i > 0) && (prev_key.compare(key) > 0)) {
+                DEBUG_ASSERT(false, "Found non sorted entry at idx={} node={}", i, to_string());
+            }
+            prev_key = key;
+        }
+    }
+#endif
+
+protected:
+    struct obj_info {
+        uint32_t value_size;
+        uint32_t key_size;
+        uint32_t hdr_size;
+        uint32_t total_size() const { return hdr_size + key_size + value_size; }
+    };
+
+    uint32_t insert(uint32_t ind, const sisl::blob& key_blob, const sisl::blob& val_blob) {
+        DEBUG_ASSERT_LE(ind, this->total_entries());
+        DEBUG_ASSERT_LE(key_blob.size(), max_len, "Key size is beyond what compact node supports");
+        DEBUG_ASSERT_LE(val_blob.size(), max_len, "Value size is beyond what compact node supports");
+
+        uint32_t const obj_size = packed_obj_size(key_blob.size(), val_blob.size());
+        if ((obj_size + sizeof(slot_t)) > available_size()) { return 0; }
+
+        // Objects are packed at the end of object area irrespective of its sorted position, only slot is sorted
+        auto const obj_offset = get_compact_header()->m_data_end;
+        encode_obj(offset_to_ptr_mutable(obj_offset), key_blob, val_blob);
+        get_compact_header()->m_data_end += obj_size;
+
+        for (uint32_t i{this->total_entries()}; i > ind; --i) {
+            set_slot(i, slot(i - 1));
+        }
+        set_slot(ind, obj_offset);
+
+        this->inc_entries();
+        this->inc_gen();
+        return obj_size + sizeof(slot_t);
+    }
+
+    // Remove the objects in [ind_s, ind_e] and close the holes left behind, so that object area is always packed
+    void remove_objs(uint32_t ind_s, uint32_t ind_e) {
+        uint32_t const nentries = this->total_entries();
+        for (uint32_t ind{ind_s}; ind <= ind_e; ++ind) {
+            slot_t const off = slot(ind);
+            uint32_t const sz = nth_obj_total_size(ind);
+            uint8_t* obj = offset_to_ptr_mutable(off);
+            std::memmove(obj, obj + sz, get_compact_header()->m_data_end - off - sz);
+            get_compact_header()->m_data_end -= sz;
+
+            for (uint32_t i{0}; i < nentries; ++i) {
+                if (slot(i) > off) { set_slot(i, slot(i) - sz); }
+            }
+        }
+
+        uint32_t const nremoved = ind_e - ind_s + 1;
+        for (uint32_t i{ind_e + 1}; i < nentries; ++i) {
+            set_slot(i - nremoved, slot(i));
+        }
+        this->sub_entries(nremoved);
+    }
+
+    static uint32_t len_size(uint32_t len) { return (len < max_len_in_byte) ? 1 : 2; }
+
+    static uint32_t packed_obj_size(uint32_t key_size, uint32_t value_size) {
+        return len_size(value_size) + (K::is_fixed_size() ? 0 : len_size(key_size)) + key_size + value_size;
+    }
+
+    static uint8_t* encode_len(uint8_t* p, uint32_t len) {
+        if (len < max_len_in_byte) {
+            *p = static_cast< uint8_t >(len);
+            return p + 1;
+        }
+        p[0] = static_cast< uint8_t >(max_len_in_byte | (len >> 8));
+        p[1] = static_cast< uint8_t >(len & 0xFF);
+        return p + 2;
+    }
+
+    static uint8_t const* decode_len(uint8_t const* p, uint32_t& len) {
+        if ((p[0] & max_len_in_byte) == 0) {
+            len = p[0];
+            return p + 1;
+        }
+        len = (uint32_cast(p[0] & ~max_len_in_byte) << 8) | p[1];
+        return p + 2;
+    }
+
+    static void encode_obj(uint8_t* p, sisl::blob const& key_blob, sisl::blob const& val_blob) {
+        p = encode_len(p, val_blob.size());
+        if (!K::is_fixed_size()) { p = encode_len(p, key_blob.size()); }
+        std::memmove(p, key_blob.cbytes(), key_blob.size());
+        std::memmove(p + key_blob.size(), val_blob.cbytes(), val_blob.size());
+    }
+
+    static obj_info decode_obj(uint8_t const* obj) {
+        obj_info info;
+        auto p = decode_len(obj, info.value_size);
+        if (K::is_fixed_size()) {
+            info.key_size = dummy_key< K >.serialized_size();
+        } else {
+            p = decode_len(p, info.key_size);
+        }
+        info.hdr_size = p - obj;
+        return info;
+    }
+
+    sisl::blob nth_key_blob(uint32_t ind) const {
+        auto const obj = obj_ptr(ind);
+        auto const info = decode_obj(obj);
+        return sisl::blob{const_cast< uint8_t* >(obj) + info.hdr_size, info.key_size};
+    }
+
+    sisl::blob nth_value_blob(uint32_t ind) const {
+        auto const obj = obj_ptr(ind);
+        auto const info = decode_obj(obj);
+        return sisl::blob{const_cast< uint8_t* >(obj) + info.hdr_size + info.key_size, info.value_size};
+    }
+
+    uint32_t nth_obj_total_size(uint32_t ind) const { return decode_obj(obj_ptr(ind)).total_size(); }
+    uint32_t nth_entry_size(uint32_t ind) const { return nth_obj_total_size(ind) + sizeof(slot_t); }
+
+    slot_t slot(uint32_t ind) const {
+        slot_t s;
+        std::memcpy(&s, slot_ptr(ind), sizeof(slot_t));
+        return s;
+    }
+    void set_slot(uint32_t ind, slot_t s) { std::memcpy(slot_ptr_mutable(ind), &s, sizeof(slot_t)); }
+
+    uint8_t const* slot_ptr(uint32_t ind) const {
+        return this->node_data_area_const() + this->node_data_size() - ((ind + 1) * sizeof(slot_t));
+    }
+    uint8_t* slot_ptr_mutable(uint32_t ind) {
+        return this->node_data_area() + this->node_data_size() - ((ind + 1) * sizeof(slot_t));
+    }
+
+    uint8_t const* obj_ptr(uint32_t ind) const { return offset_to_ptr(slot(ind)); }
+    uint8_t* obj_ptr_mutable(uint32_t ind) { return offset_to_ptr_mutable(slot(ind)); }
+
+    uint8_t* offset_to_ptr_mutable(uint16_t offset) { return this->node_data_area() + offset; }
+    const uint8_t* offset_to_ptr(uint16_t offset) const { return this->node_data_area_const() + offset; }
+
+    compact_node_header* get_compact_header() { return r_cast< compact_node_header* >(this->node_data_area()); }
+    const compact_node_header* get_compact_header_const() const {
+        return r_cast< const compact_node_header* >(this->node_data_area_const());
+    }
+};
+} // namespace homestore
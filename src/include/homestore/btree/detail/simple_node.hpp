@@ -182,6 +182,10 @@ public:
         return (this->node_data_size() - (this->total_entries() * get_nth_obj_size(0)));
     }
 
+    std::pair< uint32_t, uint32_t > used_data_extents() const override {
+        return std::pair{this->node_data_size() - available_size(), this->node_data_size()};
+    }
+
     void get_nth_key_internal(uint32_t ind, BtreeKey& out_key, bool copy) const override {
         DEBUG_ASSERT_LT(ind, this->total_entries(), "node={}", to_string());
         sisl::blob b{this->node_data_area_const() + (get_nth_obj_size(ind) * ind), get_nth_key_size(ind)};
@@ -354,6 +358,82 @@ public:
         return get_nth_key(ind, false).compare_range(range);
     }*/
 
+protected:
+    std::pair< bool, uint32_t > bsearch_node(const BtreeKey& key) const override {
+        if constexpr (BtreeIntegerKey< K >) {
+            if (get_nth_key_size(0) == sizeof(typename K::btree_int_key_t)) { return int_key_bsearch(key); }
+        }
+        return BtreeNode::bsearch_node(key);
+    }
+
+    // Lower bound search directly on the integer keys laid out in the node. It avoids a virtual compare and a key
+    // deserialization per probe and returns the same result as BtreeNode::bsearch_node(). If the node is configured
+    // for interpolation search, the range is first narrowed down by a few interpolation probes, before finishing it
+    // with a branchless binary search, so that a skewed key distribution costs only those few extra probes.
+    std::pair< bool, uint32_t > int_key_bsearch(const BtreeKey& key) const {
+        using int_key_t = typename K::btree_int_key_t;
+        static constexpr uint32_t max_interpolation_probes = 3;
+        static constexpr uint32_t min_interpolation_range = 16;
+        DEBUG_ASSERT_EQ(this->magic(), BTREE_NODE_MAGIC);
+
+        uint32_t const nentries = this->total_entries();
+        if (nentries == 0) { return std::make_pair(false, 0u); }
+
+        int_key_t search_key;
+        std::memcpy(&search_key, key.serialize().cbytes(), sizeof(int_key_t));
+
+        uint8_t const* keys = this->node_data_area_const();
+        uint32_t const stride = get_nth_obj_size(0);
+        auto const nth_int_key = [keys, stride](uint32_t ind) {
+            int_key_t k;
+            std::memcpy(&k, keys + (uint64_cast(ind) * stride), sizeof(int_key_t));
+            return k;
+        };
+
+        // Lower bound is always within [lo, hi]
+        uint32_t lo{0};
+        uint32_t hi{nentries};
+        if (this->is_interpolation_search()) {
+            for (uint32_t probe{0}; (probe < max_interpolation_probes) && ((hi - lo) > min_interpolation_range);
+                 ++probe) {
+                int_key_t const lo_key = nth_int_key(lo);
+                int_key_t const hi_key = nth_int_key(hi - 1);
+                if (search_key <= lo_key) {
+                    hi = lo;
+                    break;
+                } else if (search_key > hi_key) {
+                    lo = hi;
+                    break;
+                }
+
+                // lo_key < search_key <= hi_key here, so the position is always within [lo, hi - 1]
+                auto const ratio = (double(search_key) - double(lo_key)) / (double(hi_key) - double(lo_key));
+                auto const pos = std::min(lo + uint32_cast(ratio * double(hi - 1 - lo)), hi - 1);
+                if (nth_int_key(pos) < search_key) {
+                    lo = pos + 1;
+                } else {
+                    hi = pos;
+                }
+            }
+            if (lo == hi) { return std::make_pair((lo < nentries) && (nth_int_key(lo) == search_key), lo); }
+        }
+
+        uint32_t base{lo};
+        uint32_t len{hi - lo};
+        while (len > 1) {
+            uint32_t const half = len / 2;
+            base = (nth_int_key(base + half) < search_key) ? (base + half) : base;
+            len -= half;
+        }
+
+        int_key_t const k = nth_int_key(base);
+        uint32_t const idx = base + ((k < search_key) ? 1u : 0u);
+        if (idx == hi) { return std::make_pair((idx < nentries) && (nth_int_key(idx) == search_key), idx); }
+        return std::make_pair((k == search_key), idx);
+    }
+
+public:
+
     /////////////// Other Internal Methods /////////////
     void set_nth_obj(uint32_t ind, const BtreeKey& k, const BtreeValue& v) {
         if (ind > this->total_entries()) {
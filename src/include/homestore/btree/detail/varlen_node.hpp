@@ -452,6 +452,11 @@ public:
 
     uint32_t available_size() const override { return get_var_node_header_const()->m_available_space; }
 
+    std::pair< uint32_t, uint32_t > used_data_extents() const override {
+        return std::pair{uint32_cast(sizeof(var_node_header) + (this->total_entries() * get_record_size())),
+                         uint32_cast(get_var_node_header_const()->tail_offset())};
+    }
+
     void set_nth_key(uint32_t ind, const BtreeKey& key) {
         const auto kb = key.serialize();
         assert(ind < this->total_entries());
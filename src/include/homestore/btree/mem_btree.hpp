@@ -20,13 +20,86 @@
 
 #define StoreSpecificBtreeNode BtreeNode
 
+#include <array>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "btree.ipp"
 
 namespace homestore {
+// Epoch based reclamation of the nodes freed by writers, while lock free readers could still be traversing them.
+// Every reader publishes the global epoch it started in, in one of the reader slots, for the duration of its read.
+// A node freed by the writer is stamped with the epoch and the global epoch is advanced; it is released only
+// after every reader active at that time has exited, since all readers which start after, can no longer reach it.
+class MemBtreeEpochs {
+public:
+    static constexpr uint32_t max_reader_slots = 128;
+    using reclaim_cb_t = std::function< void(BtreeNode*) >;
+
+    MemBtreeEpochs() = default;
+    MemBtreeEpochs(MemBtreeEpochs const&) = delete;
+    MemBtreeEpochs& operator=(MemBtreeEpochs const&) = delete;
+
+    uint64_t enter() {
+        auto const epoch = m_global_epoch.load();
+        auto slot = std::hash< std::thread::id >{}(std::this_thread::get_id()) % max_reader_slots;
+        while (true) {
+            uint64_t expected{0};
+            if (m_reader_slots[slot].epoch.compare_exchange_strong(expected, epoch)) { return slot; }
+            slot = (slot + 1) % max_reader_slots;
+        }
+    }
+
+    void exit(uint64_t slot) { m_reader_slots[slot].epoch.store(0, std::memory_order_release); }
+
+    void retire(BtreeNode* node, reclaim_cb_t const& reclaim_cb) {
+        std::unique_lock lg(m_retire_mtx);
+        m_retired.emplace_back(m_global_epoch.fetch_add(1), node);
+        reclaim(reclaim_cb, false /* force */);
+    }
+
+    void reclaim_all(reclaim_cb_t const& reclaim_cb) {
+        std::unique_lock lg(m_retire_mtx);
+        reclaim(reclaim_cb, true /* force */);
+    }
+
+private:
+    void reclaim(reclaim_cb_t const& reclaim_cb, bool force) {
+        uint64_t min_active{std::numeric_limits< uint64_t >::max()};
+        if (!force) {
+            for (auto const& slot : m_reader_slots) {
+                auto const e = slot.epoch.load();
+                if (e != 0) { min_active = std::min(min_active, e); }
+            }
+        }
+
+        // Retired list is in the ascending order of epoch
+        auto it = m_retired.begin();
+        for (; (it != m_retired.end()) && (it->first < min_active); ++it) {
+            reclaim_cb(it->second);
+        }
+        m_retired.erase(m_retired.begin(), it);
+    }
+
+private:
+    struct alignas(64) reader_slot {
+        std::atomic< uint64_t > epoch{0};
+    };
+
+    std::atomic< uint64_t > m_global_epoch{1};
+    std::array< reader_slot, max_reader_slots > m_reader_slots;
+    std::mutex m_retire_mtx;
+    std::vector< std::pair< uint64_t, BtreeNode* > > m_retired;
+};
+
 template < typename K, typename V >
 class MemBtree : public Btree< K, V > {
 private:
     std::vector< std::shared_ptr< uint8_t[] > > node_buf_ptr_vec;
+    mutable MemBtreeEpochs m_epochs;
 
 public:
     MemBtree(const BtreeConfig& cfg) : Btree< K, V >(cfg) {
@@ -38,13 +111,14 @@ public:
     virtual ~MemBtree() {
         const auto [ret, free_node_cnt] = this->destroy_btree(nullptr);
         BT_LOG_ASSERT_EQ(ret, btree_status_t::success, "btree destroy failed");
+        m_epochs.reclaim_all([](BtreeNode* n) { intrusive_ptr_release(n); });
     }
 
     std::string btree_store_type() const override { return "MEM_BTREE"; }
 
 private:
     BtreeNodePtr alloc_node(bool is_leaf) override {
-        std::shared_ptr< uint8_t[] > ptr(new uint8_t[this->m_bt_cfg.node_size()]);
+        std::shared_ptr< uint8_t[] > ptr(new uint8_t[this->m_bt_cfg.node_size(is_leaf)]);
         node_buf_ptr_vec.emplace_back(ptr);
 
         auto new_node = this->init_node(ptr.get(), bnodeid_t{0}, true, is_leaf);
@@ -64,7 +138,17 @@ private:
         return btree_status_t::success;
     }
 
-    void free_node_impl(const BtreeNodePtr& node, void* context) override { intrusive_ptr_release(node.get()); }
+    void free_node_impl(const BtreeNodePtr& node, void* context) override {
+        if (this->m_bt_cfg.m_optimistic_reads) {
+            // Lock free readers hold raw node pointers, so release it only after all of them are done with it
+            m_epochs.retire(node.get(), [](BtreeNode* n) { intrusive_ptr_release(n); });
+        } else {
+            intrusive_ptr_release(node.get());
+        }
+    }
+
+    uint64_t enter_optimistic_read() const override { return m_epochs.enter(); }
+    void exit_optimistic_read(uint64_t token) const override { m_epochs.exit(token); }
 
     btree_status_t transact_nodes(const BtreeNodeList& new_nodes, const BtreeNodeList& freed_nodes,
                                   const BtreeNodePtr& left_child_node, const BtreeNodePtr& parent_node,
@@ -73,7 +157,7 @@ private:
             this->write_node(node, context);
         }
         this->write_node(left_child_node, context);
-        this->write_node(parent_node, context);
+        if (parent_node) { this->write_node(parent_node, context); }
 
         for (const auto& node : freed_nodes) {
             this->free_node(node, locktype_t::WRITE, context);
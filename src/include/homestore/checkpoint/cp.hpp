@@ -18,6 +18,7 @@
 #include <array>
 #include <memory>
 #include <mutex>
+#include <utility>
 
 #include <sisl/logging/logging.h>
 #include <sisl/utility/atomic_counter.hpp>
@@ -82,29 +83,84 @@ VENUM(cp_consumer_t, uint8_t,
       SENTINEL = 4         // Should always be the last in this list
 );
 
+/*
+ * Count of the ios in the critical section of a CP. While the CP is the current one, each thread counts on a slot of its
+ * own cache line, so that entering and exiting the CP from all the cores doesn't bounce a shared line between them. An
+ * io can exit on a thread other than the one it entered on, so only the sum of the slots is meaningful. Once the CP is
+ * switched over and no thread counts on the slots anymore, they are folded into the shared counter, which is biased
+ * till then so that it can't reach zero before, and the exit which brings it to zero is the last one.
+ */
+struct cp_enter_counter {
+    static constexpr size_t num_slots{64};
+    static constexpr int64_t bias{int64_t{1} << 62};
+
+    struct alignas(64) slot {
+        std::atomic< int64_t > count{0};
+    };
+
+    std::array< slot, num_slots > m_slots;
+    std::atomic< bool > m_sharded{true};
+    sisl::atomic_counter< int64_t > m_shared{bias};
+
+    static size_t this_slot() {
+        static std::atomic< size_t > s_next_slot{0};
+        static thread_local size_t t_slot{s_next_slot.fetch_add(1, std::memory_order_relaxed) % num_slots};
+        return t_slot;
+    }
+
+    int64_t get() const {
+        int64_t cnt = m_shared.get() - (m_sharded.load() ? bias : 0);
+        if (m_sharded.load()) {
+            for (auto const& s : m_slots) {
+                cnt += s.count.load(std::memory_order_relaxed);
+            }
+        }
+        return cnt;
+    }
+};
+
 struct CP {
     std::atomic< cp_status_t > m_cp_status{cp_status_t::cp_unknown};
-    sisl::atomic_counter< int64_t > m_enter_cnt;
+    cp_enter_counter m_enter_cnt;
     CPManager* m_cp_mgr;
     cp_id_t m_cp_id;
-    std::array< std::unique_ptr< CPContext >, (size_t)cp_consumer_t::SENTINEL > m_contexts;
+    // Contexts are owned by the cp. Context of a consumer which defers it, is created on its first access in the cp
+    mutable std::array< std::atomic< CPContext* >, (size_t)cp_consumer_t::SENTINEL > m_contexts{};
+    mutable std::mutex m_contexts_mtx;
     folly::SharedPromise< bool > m_comp_promise;
+
+    // Phase timings of the cp, recorded into the cp history once the cp is done. Flush span of each consumer is in us
+    // relative to the flush start
+    Clock::time_point m_trigger_time;
+    Clock::time_point m_flush_start_time;
+    uint64_t m_switchover_us{0};
+    std::array< std::pair< uint64_t, uint64_t >, (size_t)cp_consumer_t::SENTINEL > m_flush_span_us{};
 #ifdef _PRERELEASE
     std::atomic< bool > m_abrupt_cp{false};
 #endif
 
 public:
     CP(CPManager* mgr) : m_cp_mgr{mgr} {}
+    ~CP();
 
     cp_id_t id() const { return m_cp_id; }
     cp_status_t get_status() const { return m_cp_status.load(); }
-    CPContext* context(cp_consumer_t consumer) const { return m_contexts[(size_t)consumer].get(); }
-    void set_context(cp_consumer_t consumer, std::unique_ptr< CPContext > context) {
-        m_contexts[(size_t)consumer] = std::move(context);
+    CPContext* context(cp_consumer_t consumer) const {
+        auto ctx = m_contexts[(size_t)consumer].load(std::memory_order_acquire);
+        return ctx ? ctx : create_context(consumer);
     }
 
+    // Context of the consumer, only if it is already created in this cp
+    CPContext* created_context(cp_consumer_t consumer) const {
+        return m_contexts[(size_t)consumer].load(std::memory_order_acquire);
+    }
+    void set_context(cp_consumer_t consumer, std::unique_ptr< CPContext > context);
+
     std::string to_string() const {
         return fmt::format("CP={}: status={}, enter_count={}", m_cp_id, enum_name(get_status()), m_enter_cnt.get());
     }
+
+private:
+    CPContext* create_context(cp_consumer_t consumer) const;
 };
 } // namespace homestore
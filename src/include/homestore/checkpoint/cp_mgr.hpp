@@ -16,10 +16,14 @@
 #pragma once
 #include <atomic>
 #include <array>
+#include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <memory>
 #include <functional>
+#include <vector>
 
+#include <nlohmann/json.hpp>
 #include <iomgr/iomgr.hpp>
 #include <sisl/metrics/metrics.hpp>
 #include <sisl/utility/enum.hpp>
@@ -35,7 +39,21 @@ public:
     explicit CPMgrMetrics() : sisl::MetricsGroup("CPMgr") {
         REGISTER_COUNTER(back_to_back_cps, "back to back cp");
         REGISTER_COUNTER(cp_cnt, "cp cnt");
+        REGISTER_COUNTER(paced_cp_cnt, "cp cnt triggered by the cp pacer");
+        REGISTER_COUNTER(predicted_cp_cnt, "cp cnt triggered ahead of a resource limit predicted to be hit");
+        REGISTER_COUNTER(overlapped_cleanup_cnt, "cp cnt whose cleanup overlapped the flush of the next cp");
+        REGISTER_COUNTER(cp_flush_throttled_us, "time cp flush writes are delayed by the flush rate limit");
         REGISTER_HISTOGRAM(cp_latency, "cp latency (in us)");
+        REGISTER_HISTOGRAM(cp_switchover_latency, "cp switchover latency (in us)");
+        REGISTER_HISTOGRAM(cp_cleanup_latency, "cp cleanup latency (in us)");
+        REGISTER_HISTOGRAM(cp_flush_client_latency, "cp flush latency of hs client (in us)", "cp_flush_latency",
+                           {"consumer", "hs_client"});
+        REGISTER_HISTOGRAM(cp_flush_index_latency, "cp flush latency of index (in us)", "cp_flush_latency",
+                           {"consumer", "index"});
+        REGISTER_HISTOGRAM(cp_flush_data_latency, "cp flush latency of blk data (in us)", "cp_flush_latency",
+                           {"consumer", "blk_data"});
+        REGISTER_HISTOGRAM(cp_flush_repl_latency, "cp flush latency of replication (in us)", "cp_flush_latency",
+                           {"consumer", "replication"});
         register_me_to_farm();
     }
 
@@ -86,10 +104,27 @@ public:
     /// @param done_cb Callback after cp is done
     virtual folly::Future< bool > cp_flush(CP* cp) = 0;
 
+    /// @brief Creates the context of a consumer, whose on_switchover_cp returned nullptr, on its first access in the CP.
+    /// Consumers which are idle in most CPs can defer the context this way, so that the switchover doesn't pay for it
+    /// @param cp : CP the context is created for
+    /// @return Context of the consumer, nullptr if it doesn't need any
+    virtual std::unique_ptr< CPContext > create_cp_context(CP* cp) { return nullptr; }
+
+    /// @brief Consumers whose cp_flush has to be completed before the cp_flush of this consumer is called. Consumers
+    /// which don't depend on each other are flushed concurrently, each from its own CP fiber. SEALER need not be
+    /// listed, it is always flushed after all others. Dependencies must not form a cycle.
+    /// @return List of the consumers this consumer depends on for its flush
+    virtual std::vector< cp_consumer_t > cp_flush_dependencies() const { return {}; }
+
     /// @brief After all consumers flushed the CP, CPManager calls this method to clean up any CP related structures
     /// @param cp
     virtual void cp_cleanup(CP* cp) = 0;
 
+    /// @brief Consumers which return true here allow the flush of the next CP to start while cp_cleanup of this CP is
+    /// still running. cp_cleanup is then called concurrently with cp_flush of the next CP, but still in CP order.
+    /// @return true if cp_cleanup doesn't touch any state the flush of the next CP depends on
+    virtual bool cp_cleanup_can_overlap() const { return false; }
+
     /// @brief While CP is progressing, CPManager calls this method frequently to check its flush progress.
     /// @return Returns the progress percentage of flush.
     virtual int cp_progress_percent() = 0;
@@ -97,6 +132,11 @@ public:
     /// @brief In case CP is not progressing at all, CPManager calls this method to attempt the consumer to push harder
     /// to flush. Consumers are expected to increase any flow control to ensure flush goes faster.
     virtual void repair_slow_cp() {}
+
+    /// @brief Once all consumers flushed the CP, CPManager calls this method before cp_cleanup to record what the
+    /// consumer flushed for the CP, in the CP history.
+    /// @return Stats of the flush of this consumer, like number of nodes and bytes flushed
+    virtual nlohmann::json cp_flush_stats(CP* cp) const { return nlohmann::json{}; }
 };
 
 class CPWatchdog;
@@ -158,11 +198,28 @@ private:
     std::unique_ptr< CPWatchdog > m_wd_cp;
     superblk< cp_mgr_super_block > m_sb;
     std::vector< iomgr::io_fiber_t > m_cp_io_fibers;
-    iomgr::timer_handle_t m_cp_timer_hdl;
+    iomgr::timer_handle_t m_cp_timer_hdl{iomgr::null_timer_handle};
+    iomgr::timer_handle_t m_cp_pacer_timer_hdl{iomgr::null_timer_handle};
+    iomgr::timer_handle_t m_cp_predict_timer_hdl{iomgr::null_timer_handle};
     bool m_cp_shutdown_initiated{false};
     bool m_in_flush_phase{false};
+    std::condition_variable m_flush_phase_cv; // Notified under m_trigger_cp_mtx when the flush phase ends
     bool m_pending_trigger_cp{false}; // Is there is a waiter for a cp flush to start
     folly::SharedPromise< bool > m_pending_trigger_cp_comp;
+    std::atomic< uint64_t > m_cp_flush_start_ms{0}; // Time the flush of the CP being flushed is started
+    std::atomic< uint64_t > m_avg_cp_us{0};         // Smoothed duration of the CPs, from trigger to completion
+    iomgr::FiberManagerLib::mutex m_cp_cleanup_mtx; // Keeps the cleanups in cp order, when they overlap with flushes
+
+    // Token bucket of the cp flush rate limit, in bytes. Writes take the tokens right away and are delayed till the
+    // bucket is back from the debt they leave it in
+    std::mutex m_flush_rate_mtx;
+    double m_flush_tokens{0};
+    Clock::time_point m_flush_tokens_time{Clock::now()};
+
+    // Phase timings of the recently completed cps, latest one at the back
+    static constexpr size_t max_cp_history{16};
+    mutable std::mutex m_cp_history_mtx;
+    std::deque< nlohmann::json > m_cp_history;
 
 public:
     CPManager();
@@ -175,10 +232,11 @@ public:
     /// @brief Start the cp timer so that periodic cps are started
     void start_timer();
 
-    /// @brief Shutdown the checkpoint manager services. It will not trigger a flush, but cancels any existing
-    /// checkpoint session abruptly. If caller needs clean shutdown, then they explicitly needs to trigger cp flush
-    /// before calling shutdown.
-    void shutdown();
+    /// @brief Shutdown the checkpoint manager services. It flushes the current cp before stopping, unless it is a fast
+    /// shutdown, which only waits for the cp already in flush and leaves the dirty state of the current cp to be
+    /// recovered by the consumers from their logs at the next start, the same as after a crash.
+    /// @param fast : Skip the final cp flush
+    void shutdown(bool fast = false);
 
     /// @brief Register a CP consumer to the checkpoint manager. CP consumer provides the callback they are interested
     /// in the checkpoint process. Each consumer gets a CPContext, which consumer can put its own dirty buffer info
@@ -221,12 +279,30 @@ public:
 
     iomgr::io_fiber_t pick_blocking_io_fiber() const;
 
+    /// @brief Gets the delay a CP flush write of the given size is to be issued after, to keep the CP flush writes
+    /// within cp_flush_rate_limit_mbps. Caller is expected to issue the write after the delay, without calling again.
+    /// @param size : Size of the write
+    /// @return Delay in microseconds, 0 if it can be issued right away
+    uint64_t cp_flush_delay_us(uint64_t size);
+
+    /// @brief Blocks the calling fiber for the delay of a CP flush write of the given size, see cp_flush_delay_us()
+    void throttle_cp_flush(uint64_t size);
+
+    /// @brief Gets the status of the CPManager, which has the current cp and the phase timings of the recent cps
+    nlohmann::json get_status(int verbosity) const;
+
 private:
     void cp_ref(CP* cp);
     void create_first_cp();
     void cp_start_flush(CP* cp);
+    void pace_cp();
+    void predict_cp();
+    folly::Future< bool > flush_consumer(CP* cp, size_t svcid);
     void on_cp_flush_done(CP* cp);
     void cleanup_cp(CP* cp);
+    bool can_overlap_cleanup() const;
+    void observe_flush_latency(size_t svcid, uint64_t latency_us);
+    nlohmann::json cp_history_entry(CP* cp) const;
     void on_meta_blk_found(const sisl::byte_view& buf, void* meta_cookie);
     void start_cp_thread();
     folly::Future< bool > do_trigger_cp_flush(bool force, bool flush_on_shutdown);
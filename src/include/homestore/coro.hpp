@@ -0,0 +1,191 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <coroutine>
+#include <system_error>
+#include <utility>
+
+#include <homestore/coro_completion.hpp>
+#include <homestore/blkdata_service.hpp>
+#include <homestore/checkpoint/cp_mgr.hpp>
+#include <homestore/logstore/log_store.hpp>
+#include <homestore/replication/repl_dev.h>
+
+/*
+ * C++20 awaitables of the core async ops of the services, to compose them in a coroutine instead of chaining futures:
+ *
+ *     auto err = co_await homestore::coro::async_write(data_service(), buf, size, bid);
+ *     auto [seq_num, ld_key] = co_await homestore::coro::append(*log_store, blob);
+ *
+ * Awaitables work with any coroutine type, like folly::coro::Task. Op is submitted when it is awaited, and its state,
+ * including the io context of the data service, is in the awaitable, which lives in the frame of the coroutine, so
+ * the data and log ops allocate nothing beyond what their callback based variants do. Coroutine is resumed on the
+ * thread which completes the op, or on the given fiber of an iomgr reactor.
+ */
+namespace homestore::coro {
+
+// Awaitable of a data service io, submit_fn issues the io on the given io context
+template < typename SubmitFn >
+class data_io_awaitable {
+public:
+    data_io_awaitable(SubmitFn&& submit_fn, iomgr::io_fiber_t resume_fiber) :
+            m_submit{std::move(submit_fn)},
+            m_ctx{[this](std::error_condition ec) { m_comp.complete(ec); }},
+            m_resume_fiber{resume_fiber} {}
+    data_io_awaitable(data_io_awaitable const&) = delete;
+    data_io_awaitable& operator=(data_io_awaitable const&) = delete;
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h) {
+        m_comp.prepare(h, m_resume_fiber);
+        m_submit(m_ctx);
+        return m_comp.try_suspend();
+    }
+    std::error_condition await_resume() { return m_comp.result(); }
+
+private:
+    SubmitFn m_submit;
+    data_io_ctx m_ctx;
+    coro_completion< std::error_condition > m_comp;
+    iomgr::io_fiber_t m_resume_fiber;
+};
+
+inline auto async_read(BlkDataService& svc, MultiBlkId const& bid, uint8_t* buf, uint32_t size,
+                       iomgr::io_fiber_t resume_fiber = nullptr) {
+    auto fn = [&svc, bid, buf, size](data_io_ctx& ctx) { svc.async_read(bid, buf, size, ctx); };
+    return data_io_awaitable< decltype(fn) >{std::move(fn), resume_fiber};
+}
+
+inline auto async_read(BlkDataService& svc, MultiBlkId const& bid, sisl::sg_list const& sgs, uint32_t size,
+                       iomgr::io_fiber_t resume_fiber = nullptr) {
+    auto fn = [&svc, bid, &sgs, size](data_io_ctx& ctx) { svc.async_read(bid, sgs, size, ctx); };
+    return data_io_awaitable< decltype(fn) >{std::move(fn), resume_fiber};
+}
+
+inline auto async_write(BlkDataService& svc, const char* buf, uint32_t size, MultiBlkId const& bid,
+                        iomgr::io_fiber_t resume_fiber = nullptr) {
+    auto fn = [&svc, buf, size, bid](data_io_ctx& ctx) { svc.async_write(buf, size, bid, ctx); };
+    return data_io_awaitable< decltype(fn) >{std::move(fn), resume_fiber};
+}
+
+inline auto async_write(BlkDataService& svc, sisl::sg_list const& sgs, MultiBlkId const& bid,
+                        iomgr::io_fiber_t resume_fiber = nullptr) {
+    auto fn = [&svc, &sgs, bid](data_io_ctx& ctx) { svc.async_write(sgs, bid, ctx); };
+    return data_io_awaitable< decltype(fn) >{std::move(fn), resume_fiber};
+}
+
+struct log_append_result {
+    logstore_seq_num_t seq_num{-1};
+    logdev_key ld_key;
+};
+
+// Awaitable of an append to the log store, blob is to be valid till the append completes
+class log_append_awaitable {
+public:
+    log_append_awaitable(HomeLogStore& store, sisl::io_blob const& b, iomgr::io_fiber_t resume_fiber) :
+            m_store{store}, m_blob{b}, m_resume_fiber{resume_fiber} {}
+    log_append_awaitable(log_append_awaitable const&) = delete;
+    log_append_awaitable& operator=(log_append_awaitable const&) = delete;
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h) {
+        m_comp.prepare(h, m_resume_fiber);
+        m_store.append_async(m_blob, nullptr /* cookie */,
+                             [this](logstore_seq_num_t seq_num, sisl::io_blob&, logdev_key ld_key, void*) {
+                                 m_comp.complete(log_append_result{seq_num, ld_key});
+                             });
+        return m_comp.try_suspend();
+    }
+    log_append_result await_resume() { return m_comp.result(); }
+
+private:
+    HomeLogStore& m_store;
+    sisl::io_blob m_blob;
+    coro_completion< log_append_result > m_comp;
+    iomgr::io_fiber_t m_resume_fiber;
+};
+
+inline log_append_awaitable append(HomeLogStore& store, sisl::io_blob const& b,
+                                   iomgr::io_fiber_t resume_fiber = nullptr) {
+    return log_append_awaitable{store, b, resume_fiber};
+}
+
+// Awaitable of the replication of a write, which completes once the write is committed on this replica or has failed.
+// Request is completed by the repl dev after the on_commit or on_error of the listener is called for it.
+class repl_write_awaitable {
+public:
+    repl_write_awaitable(ReplDev& dev, sisl::blob const& header, sisl::blob const& key, sisl::sg_list const& value,
+                         repl_req_ptr_t rreq, iomgr::io_fiber_t resume_fiber) :
+            m_dev{dev},
+            m_header{header},
+            m_key{key},
+            m_value{value},
+            m_rreq{std::move(rreq)},
+            m_resume_fiber{resume_fiber} {}
+    repl_write_awaitable(repl_write_awaitable const&) = delete;
+    repl_write_awaitable& operator=(repl_write_awaitable const&) = delete;
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h) {
+        auto& comp = m_rreq->commit_completion();
+        comp.prepare(h, m_resume_fiber);
+        m_dev.async_alloc_write(m_header, m_key, m_value, m_rreq);
+        return comp.try_suspend();
+    }
+    ReplServiceError await_resume() { return m_rreq->commit_completion().result(); }
+
+private:
+    ReplDev& m_dev;
+    sisl::blob m_header;
+    sisl::blob m_key;
+    sisl::sg_list const& m_value;
+    repl_req_ptr_t m_rreq;
+    iomgr::io_fiber_t m_resume_fiber;
+};
+
+inline repl_write_awaitable async_alloc_write(ReplDev& dev, sisl::blob const& header, sisl::blob const& key,
+                                              sisl::sg_list const& value, repl_req_ptr_t rreq,
+                                              iomgr::io_fiber_t resume_fiber = nullptr) {
+    return repl_write_awaitable{dev, header, key, value, std::move(rreq), resume_fiber};
+}
+
+// Awaitable of a cp flush, which is true if the cp is flushed. It goes through the future of the cp manager, so unlike
+// the others, it allocates the continuation.
+class cp_flush_awaitable {
+public:
+    cp_flush_awaitable(CPManager& cp_mgr, bool force, iomgr::io_fiber_t resume_fiber) :
+            m_cp_mgr{cp_mgr}, m_force{force}, m_resume_fiber{resume_fiber} {}
+    cp_flush_awaitable(cp_flush_awaitable const&) = delete;
+    cp_flush_awaitable& operator=(cp_flush_awaitable const&) = delete;
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h) {
+        m_comp.prepare(h, m_resume_fiber);
+        m_cp_mgr.trigger_cp_flush(m_force).thenValue([this](bool success) { m_comp.complete(success); });
+        return m_comp.try_suspend();
+    }
+    bool await_resume() { return m_comp.result(); }
+
+private:
+    CPManager& m_cp_mgr;
+    bool m_force;
+    coro_completion< bool > m_comp;
+    iomgr::io_fiber_t m_resume_fiber;
+};
+
+inline cp_flush_awaitable cp_flush(CPManager& cp_mgr, bool force = false, iomgr::io_fiber_t resume_fiber = nullptr) {
+    return cp_flush_awaitable{cp_mgr, force, resume_fiber};
+}
+} // namespace homestore::coro
@@ -0,0 +1,62 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <utility>
+
+#include <iomgr/iomgr.hpp>
+
+namespace homestore {
+/*
+ * Hand off of the result of an async op from its completion to the coroutine awaiting it, without any allocation.
+ *
+ * Awaiter prepares it with its handle before submitting the op and then calls try_suspend. Whichever of the completion
+ * and try_suspend comes second resumes the coroutine: the completion resumes it, or if the op completed inline while
+ * it was being submitted, try_suspend returns false so that the coroutine is not suspended at all. Coroutine is resumed
+ * on the completion thread, or on the given fiber of an iomgr reactor.
+ */
+template < typename T >
+class coro_completion {
+public:
+    void prepare(std::coroutine_handle<> h, iomgr::io_fiber_t resume_fiber = nullptr) {
+        m_handle = h;
+        m_resume_fiber = resume_fiber;
+        m_done.store(false, std::memory_order_relaxed);
+    }
+
+    bool try_suspend() { return !m_done.exchange(true, std::memory_order_acq_rel); }
+
+    void complete(T result) {
+        m_result = std::move(result);
+        if (!m_done.exchange(true, std::memory_order_acq_rel) || !m_handle) { return; }
+
+        auto h = std::exchange(m_handle, nullptr);
+        if (m_resume_fiber) {
+            iomanager.run_on_forget(m_resume_fiber, [h]() { h.resume(); });
+        } else {
+            h.resume();
+        }
+    }
+
+    T& result() { return m_result; }
+
+private:
+    std::coroutine_handle<> m_handle{nullptr};
+    iomgr::io_fiber_t m_resume_fiber{nullptr};
+    std::atomic< bool > m_done{false};
+    T m_result{};
+};
+} // namespace homestore
@@ -0,0 +1,92 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include <nlohmann/json.hpp>
+#include <sisl/utility/enum.hpp>
+
+namespace homestore {
+ENUM(cpu_subsys_t, uint8_t, BTREE, WB_CACHE, BLKALLOC, LOGDEV, REPLICATION, CP);
+
+/*
+ * Sampled accounting of the cycles spent by each subsystem at its major entry points, to know how much CPU each of them
+ * takes per op in production, without attaching a profiler.
+ *
+ * Every sample_every'th entry of a thread into a subsystem is timed by the time stamp counter, from the entry till the
+ * return. Entries which are not sampled cost an increment of a thread local counter; the sampled ones are recorded into
+ * a histogram of cycles per op of the subsystem and into its totals, from which the get_status breakdown is derived.
+ * Cycles are of the call on its thread, so they include nested subsystems, like a blk alloc within a btree put, and
+ * any wait within the call.
+ */
+class CPUAccounting {
+public:
+    /// @brief Sets every how many entries of a thread are sampled, 0 to turn accounting off
+    static void set_sample_every(uint32_t n) { s_sample_every.store(n, std::memory_order_relaxed); }
+    static uint32_t sample_every() { return s_sample_every.load(std::memory_order_relaxed); }
+
+    static bool should_sample() {
+        static thread_local uint32_t t_count{0};
+        auto const every = sample_every();
+        return (every != 0) && ((++t_count % every) == 0);
+    }
+
+    // Same counter as TscClock of the lib, which is not visible to the btree headers
+    static uint64_t now_cycles() {
+#if defined(__x86_64__)
+        return __rdtsc();
+#else
+        return uint64_t(
+            std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now().time_since_epoch())
+                .count());
+#endif
+    }
+
+    static void record(cpu_subsys_t subsys, uint64_t cycles);
+
+    /// @brief Breakdown by subsystem of the sampled ops, estimated ops and average cycles and us per op
+    static nlohmann::json get_status(int verbosity);
+
+private:
+    static inline std::atomic< uint32_t > s_sample_every{64};
+};
+
+// Accounts the cycles from its construction till its destruction to the subsystem, if this entry is sampled
+class CPUScope {
+public:
+    explicit CPUScope(cpu_subsys_t subsys) :
+            m_subsys{subsys}, m_start{CPUAccounting::should_sample() ? CPUAccounting::now_cycles() : 0} {}
+    CPUScope(const CPUScope&) = delete;
+    CPUScope& operator=(const CPUScope&) = delete;
+    ~CPUScope() {
+        if (m_start != 0) { CPUAccounting::record(m_subsys, CPUAccounting::now_cycles() - m_start); }
+    }
+
+private:
+    cpu_subsys_t m_subsys;
+    uint64_t m_start;
+};
+
+#define HS_CPU_SCOPE_CONCAT_(a, b) a##b
+#define HS_CPU_SCOPE_CONCAT(a, b) HS_CPU_SCOPE_CONCAT_(a, b)
+#define HS_CPU_SCOPE(subsys)                                                                                           \
+    homestore::CPUScope HS_CPU_SCOPE_CONCAT(_hs_cpu_scope_, __LINE__) { homestore::cpu_subsys_t::subsys }
+} // namespace homestore
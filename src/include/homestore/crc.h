@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 
 // Only x86 and x86_64 supported by Intel Storage Acceleration library
 #ifndef NO_ISAL
@@ -14,3 +15,11 @@ uint16_t crc16_t10dif(uint16_t seed, const unsigned char* buf, uint64_t len);
 uint32_t crc32_ieee(uint32_t seed, const unsigned char* buf, uint64_t len);
 }
 #endif
+
+namespace homestore {
+// CRC32C (Castagnoli), with SSE4.2 or ARMv8 crc instructions if the cpu has them. Seed is the crc of preceding data.
+uint32_t crc32c(uint32_t seed, const uint8_t* buf, uint64_t len);
+
+// CRC32C of each of the buffers of len bytes, which are computed side by side to keep the crc unit busy
+void crc32c_multi(uint32_t seed, const uint8_t* const* bufs, uint32_t nbufs, uint64_t len, uint32_t* out_crcs);
+} // namespace homestore
@@ -151,12 +151,27 @@ public:
 
     bool start(const hs_input_params& input, hs_before_services_starting_cb_t svcs_starting_cb = nullptr);
     void format_and_start(std::map< uint32_t, hs_format_params >&& format_opts);
-    void shutdown();
+
+    /// @brief Stops all the services. A fast shutdown skips the flush of the final cp, which can take long with a
+    /// large dirty cache, so the state since the last flushed cp is recovered at the next start from the logs of the
+    /// consumers, as after a crash. It is only for the consumers which replay their logs from the last flushed cp, like
+    /// the replication service.
+    void shutdown(bool fast = false);
 
     // cap_attrs get_system_capacity() const; // Need to move this to homeblks/homeobj
     bool is_first_time_boot() const;
+
+    /// @brief Is HomeStore opened read only, as a replica serving reads from a copy of the devices of another one. No
+    /// cp is taken and nothing is written to the devices: writes of the data service fail, the index tables don't
+    /// allow puts or removes and the replication groups are not joined.
+    bool is_read_only() const;
     bool is_initializing() const { return !m_init_done; }
 
+    /// @brief Performance of all the services in one snapshot: throughput and p50/p99/p999 latencies of their ops, hit
+    /// ratios of their caches, queue depths of the devices, durations of the recent cps and usage of the journal. In
+    /// delta mode, ops and cache hits are the ones since the previous delta snapshot, instead of since the start.
+    nlohmann::json get_perf_snapshot(bool delta = false);
+
     // Getters
     bool has_index_service() const;
     bool has_data_service() const;
@@ -15,8 +15,10 @@
  *********************************************************************************/
 #pragma once
 
+#include <sys/uio.h>
 #include <string>
 #include <limits>
+#include <system_error>
 
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_io.hpp>
@@ -104,7 +106,9 @@ ENUM(chunk_selector_type_t, uint8_t, // What are the options to select chunk to
      CUSTOM,                         // Controlled by the upper layer
      RANDOM,                         // Pick any chunk in uniformly random fashion
      MOST_AVAILABLE_SPACE,           // Pick the most available space
-     ALWAYS_CALLER_CONTROLLED        // Expect the caller to always provide the specific chunkid
+     ALWAYS_CALLER_CONTROLLED,       // Expect the caller to always provide the specific chunkid
+     LOAD_AWARE,                     // Weigh chunks by free space and outstanding ios on their physical device
+     TENANT_AFFINE                   // Keep the blks of each tenant hinted on a group of chunks of its own
 );
 
 ENUM(vdev_size_type_t, uint8_t, VDEV_SIZE_STATIC, VDEV_SIZE_DYNAMIC);
@@ -119,6 +123,18 @@ struct dev_info {
     uint64_t dev_size{0};
 };
 
+/*
+ * State of a callback based async io on a device, which caller keeps alive from submission till done is called. It
+ * is completed by a plain function instead of a future, so that the io path need not allocate for it.
+ */
+struct dev_io_req {
+    using done_fn_t = void (*)(dev_io_req* req, std::error_code ec);
+
+    done_fn_t done{nullptr};
+    uint32_t size{0};
+    iovec iov{}; // Io on a single buffer is submitted as this iovec, which device could read after the submit returns
+};
+
 struct stream_info_t {
     uint32_t num_streams = 0;
     uint64_t stream_cur = 0;
@@ -157,6 +173,19 @@ struct hs_format_params {
     vdev_size_type_t vdev_size_type{vdev_size_type_t::VDEV_SIZE_STATIC};
     blk_allocator_type_t alloc_type{blk_allocator_type_t::varsize};
     chunk_selector_type_t chunk_sel_type{chunk_selector_type_t::ROUND_ROBIN};
+    bool integrity_offload{false}; // Data vdev checks integrity by drive protection info, if all its drives have it
+};
+
+// Cpus the threads of HomeStore doing its own work are bound to, as cpu lists like "0-3,8". Threads of a role with no
+// cpus given are bound to the cpus of the numa node less the io cpus, if either of those is given, else left unbound.
+struct hs_thread_placement {
+    std::string log_flush_cpus;  // Log flush threads
+    std::string cp_cpus;         // CP io and index cache flush threads
+    std::string background_cpus; // Slab sweeper, repl service reaper and the rest of the background threads
+    std::string io_cpus;         // Cpus of the reactors serving the ios, which the threads above are kept off
+    int32_t numa_node{-1};       // Numa node the threads are kept on, so that the memory they touch is local. -1 any
+
+    nlohmann::json to_json() const;
 };
 
 struct hs_input_params {
@@ -170,6 +199,9 @@ public:
     uint64_t hugepage_size{0};                            // memory available for the hugepage
     bool is_read_only{false};                             // Is read only
     bool auto_recovery{true};                             // Recovery of data is automatic or controlled by the caller
+    std::string journal_pmem_path; // DAX mapped persistent memory journal writes are staged in, empty to not use any
+    uint64_t journal_pmem_size{0}; // Size of the persistent memory, 0 to take the size of an existing file
+    hs_thread_placement thread_placement;
 
 #ifdef _PRERELEASE
     bool force_reinit{false};
@@ -0,0 +1,371 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <farmhash.h>
+#include <folly/futures/Future.h>
+#include <sisl/fds/buffer.hpp>
+#include <sisl/logging/logging.h>
+#include <homestore/blkdata_service.hpp>
+#include <homestore/btree/btree_kv.hpp>
+#include <homestore/index/index_table.hpp>
+
+namespace homestore {
+
+// Fingerprint of the data of a write, along with its size, by which the dedup index is keyed
+class DedupKey : public BtreeKey {
+public:
+    DedupKey() = default;
+    DedupKey(DedupKey const& other) = default;
+    DedupKey(sisl::blob const& b, bool copy) : BtreeKey() { deserialize(b, copy); }
+    DedupKey& operator=(DedupKey const& other) = default;
+    virtual ~DedupKey() = default;
+
+    /// @brief Fingerprint of the data of the sg list. Data is fingerprinted in chunks of a fixed size which are folded
+    /// in order, so that it doesn't depend on how the data is split across the iovs. Only a chunk spanning across the
+    /// iovs is copied.
+    static DedupKey of(sisl::sg_list const& sgs) {
+        DedupKey k;
+        k.m_fp.size = uint32_cast(sgs.size);
+
+        util::uint128_t acc{0, 0};
+        auto const fold = [&acc](const char* p, size_t len) {
+            auto const fp = util::Fingerprint128(p, len);
+            uint64_t const words[4]{util::Uint128Low64(acc), util::Uint128High64(acc), util::Uint128Low64(fp),
+                                    util::Uint128High64(fp)};
+            acc = util::Fingerprint128(r_cast< const char* >(words), sizeof(words));
+        };
+
+        std::array< char, s_chunk_size > partial;
+        size_t filled{0};
+        for (size_t i{0}; i < sgs.iovs.size(); ++i) {
+            auto p = r_cast< const char* >(sgs.iovs[i].iov_base);
+            auto len = sgs.iovs[i].iov_len;
+            if (filled != 0) {
+                // Complete the chunk which spans from the previous iovs
+                auto const n = std::min(len, s_chunk_size - filled);
+                std::memcpy(partial.data() + filled, p, n);
+                filled += n;
+                p += n;
+                len -= n;
+                if (filled < s_chunk_size) { continue; }
+                fold(partial.data(), s_chunk_size);
+                filled = 0;
+            }
+            for (; len >= s_chunk_size; p += s_chunk_size, len -= s_chunk_size) {
+                fold(p, s_chunk_size);
+            }
+            if (len == 0) { continue; }
+            if (i + 1 == sgs.iovs.size()) {
+                fold(p, len);
+            } else {
+                std::memcpy(partial.data(), p, len);
+                filled = len;
+            }
+        }
+        if (filled != 0) { fold(partial.data(), filled); }
+
+        k.m_fp.hi = util::Uint128High64(acc);
+        k.m_fp.lo = util::Uint128Low64(acc);
+        return k;
+    }
+
+    int compare(BtreeKey const& o) const override {
+        auto const& other = s_cast< DedupKey const& >(o);
+        if (m_fp.hi != other.m_fp.hi) { return (m_fp.hi < other.m_fp.hi) ? -1 : 1; }
+        if (m_fp.lo != other.m_fp.lo) { return (m_fp.lo < other.m_fp.lo) ? -1 : 1; }
+        if (m_fp.size != other.m_fp.size) { return (m_fp.size < other.m_fp.size) ? -1 : 1; }
+        return 0;
+    }
+
+    sisl::blob serialize() const override {
+        return sisl::blob{r_cast< const uint8_t* >(&m_fp), uint32_cast(sizeof(fingerprint))};
+    }
+    uint32_t serialized_size() const override { return get_fixed_size(); }
+    static bool is_fixed_size() { return true; }
+    static uint32_t get_fixed_size() { return sizeof(fingerprint); }
+    static uint32_t get_max_size() { return get_fixed_size(); }
+    void deserialize(sisl::blob const& b, bool) override { std::memcpy(&m_fp, b.cbytes(), sizeof(fingerprint)); }
+
+    std::string to_string() const override { return fmt::format("{:016x}{:016x}/{}", m_fp.hi, m_fp.lo, m_fp.size); }
+
+    bool operator==(DedupKey const& other) const { return (compare(other) == 0); }
+
+    // Size of the data fingerprinted
+    uint32_t data_size() const { return m_fp.size; }
+
+private:
+    static constexpr size_t s_chunk_size{4096};
+
+#pragma pack(1)
+    struct fingerprint {
+        uint64_t hi{0};
+        uint64_t lo{0};
+        uint32_t size{0};
+    };
+#pragma pack()
+
+    fingerprint m_fp;
+};
+
+// Blks holding the data of a fingerprint, with the number of writes sharing them
+class DedupValue : public BtreeValue {
+public:
+    DedupValue() = default;
+    DedupValue(MultiBlkId const& blkid, uint32_t ref_count) : BtreeValue() {
+        m_buf.resize(sizeof(uint32_t) + blkid.compact_serialized_size());
+        std::memcpy(m_buf.data(), &ref_count, sizeof(uint32_t));
+        blkid.serialize_compact(m_buf.data() + sizeof(uint32_t));
+    }
+    DedupValue(sisl::blob const& b, bool copy) : BtreeValue() { deserialize(b, copy); }
+    DedupValue(DedupValue const& other) : BtreeValue(), m_buf{other.m_buf} {}
+    DedupValue& operator=(DedupValue const& other) {
+        m_buf = other.m_buf;
+        return *this;
+    }
+    virtual ~DedupValue() = default;
+
+    uint32_t ref_count() const {
+        uint32_t cnt;
+        std::memcpy(&cnt, m_buf.data(), sizeof(uint32_t));
+        return cnt;
+    }
+
+    MultiBlkId blkid() const {
+        MultiBlkId bid;
+        bid.deserialize(sisl::blob{m_buf.data() + sizeof(uint32_t), uint32_cast(m_buf.size() - sizeof(uint32_t))},
+                        true);
+        return bid;
+    }
+
+    DedupValue with_ref_count(uint32_t ref_count) const {
+        DedupValue v{*this};
+        std::memcpy(v.m_buf.data(), &ref_count, sizeof(uint32_t));
+        return v;
+    }
+
+    sisl::blob serialize() const override { return sisl::blob{m_buf.data(), uint32_cast(m_buf.size())}; }
+    uint32_t serialized_size() const override { return uint32_cast(m_buf.size()); }
+    static uint32_t get_fixed_size() { return 0; }
+    void deserialize(sisl::blob const& b, bool) override { m_buf.assign(b.cbytes(), b.cbytes() + b.size()); }
+
+    std::string to_string() const override {
+        return m_buf.empty() ? "empty" : fmt::format("{} refs={}", blkid().to_string(), ref_count());
+    }
+
+    bool operator==(DedupValue const& other) const { return (m_buf == other.m_buf); }
+
+private:
+    std::vector< uint8_t > m_buf; // Ref count, followed by the compact encoding of the blkid
+};
+
+// Blks a write landed on, which the writer keeps to read them and to give them back to free()
+struct dedup_blk_ref {
+    DedupKey key;
+    MultiBlkId blkid;
+    bool in_index{true}; // False if the blks are owned by the writer alone, as on a fingerprint collision
+};
+
+struct dedup_stats {
+    std::atomic< uint64_t > num_writes{0};     // Writes which went through the dedup stage
+    std::atomic< uint64_t > num_deduped{0};    // Writes which shared the blks of a previous write
+    std::atomic< uint64_t > num_collisions{0}; // Writes whose fingerprint matched different data
+};
+
+/*
+ * Inline dedup of the writes of the data service. Data of a write is fingerprinted and looked up in the dedup index,
+ * an index table from the fingerprints to the blks holding their data along with a ref count. A write whose data is
+ * already in the index takes a ref on its blks instead of being written, otherwise it is written to new blks which are
+ * then added to the index. Refs are given back through free(), which frees the blks once their last ref is gone.
+ *
+ * Ref counts are updated only if the entry is still what it was when looked up, so that a write and a free racing on
+ * the same fingerprint don't lose either of their updates. With verify set, the data of a matching entry is read and
+ * compared before it is shared, and a write whose fingerprint collides is written to blks of its own outside the
+ * index. It is opt-in: writes which bypass it don't touch the index, but their blks can't be shared either.
+ */
+class IndexDedup {
+public:
+    using table_t = IndexTable< DedupKey, DedupValue >;
+
+    IndexDedup(BlkDataService& data_svc, table_t& table, bool verify = true, blk_alloc_hints hints = {}) :
+            m_data_svc{data_svc}, m_table{table}, m_verify{verify}, m_hints{std::move(hints)} {
+        m_hints.partial_alloc_ok = false;
+    }
+
+    /// @brief Writes the data of the sg list, unless the index already has blks with the same data, in which case
+    /// those blks are shared. Sg list is expected to stay valid till the future is completed, as with
+    /// async_alloc_write.
+    /// @return Blks holding the data of the write
+    folly::Future< dedup_blk_ref > write(sisl::sg_list const& sgs) {
+        m_stats.num_writes.fetch_add(1, std::memory_order_relaxed);
+        return dedup_write(DedupKey::of(sgs), sgs);
+    }
+
+    /// @brief Reads the data of the blks a write landed on
+    folly::Future< std::error_code > read(dedup_blk_ref const& ref, sisl::sg_list& sgs) {
+        return m_data_svc.async_read(ref.blkid, sgs, ref.key.data_size());
+    }
+
+    /// @brief Gives back the ref of a write on its blks, which are freed with the last ref
+    folly::Future< std::error_code > free(dedup_blk_ref const& ref) {
+        if (!ref.in_index) { return m_data_svc.async_free_blk(ref.blkid); }
+
+        while (true) {
+            DedupValue cur;
+            auto get_req = BtreeSingleGetRequest{&ref.key, &cur};
+            auto ret = m_table.get(get_req);
+            if (ret == btree_status_t::not_found) {
+                LOGERROR("Free of blkid={} found no dedup entry for fingerprint={}", ref.blkid.to_string(),
+                         ref.key.to_string());
+                return folly::makeFuture(std::make_error_code(std::errc::invalid_argument));
+            } else if (ret != btree_status_t::success) {
+                return folly::makeFuture(index_error("lookup", ref.key, ret));
+            }
+
+            if (cur.ref_count() > 1) {
+                ret = update_if_unchanged(ref.key, cur, cur.with_ref_count(cur.ref_count() - 1));
+                if (ret == btree_status_t::success) { return folly::makeFuture(std::error_code{}); }
+                if (ret != btree_status_t::put_failed) {
+                    return folly::makeFuture(index_error("update", ref.key, ret));
+                }
+                continue; // Entry changed since it was looked up
+            }
+
+            // Last ref, entry is removed before its blks are freed, so that a racing write either took its ref on the
+            // entry before or doesn't find it anymore
+            auto const filter = [&cur](BtreeKey const&, BtreeValue const& existing) {
+                return (s_cast< DedupValue const& >(existing) == cur);
+            };
+            BtreeRangeRemoveRequest< DedupKey > rreq{BtreeKeyRange< DedupKey >{ref.key, true, ref.key, true}, nullptr,
+                                                     std::numeric_limits< uint32_t >::max(), filter};
+            ret = m_table.remove(rreq);
+            if (ret == btree_status_t::success) { return m_data_svc.async_free_blk(cur.blkid()); }
+            if (ret != btree_status_t::not_found) { return folly::makeFuture(index_error("remove", ref.key, ret)); }
+        }
+    }
+
+    dedup_stats const& stats() const { return m_stats; }
+
+private:
+    folly::Future< dedup_blk_ref > dedup_write(DedupKey const& key, sisl::sg_list const& sgs) {
+        DedupValue cur;
+        auto get_req = BtreeSingleGetRequest{&key, &cur};
+        auto const ret = m_table.get(get_req);
+        if (ret == btree_status_t::not_found) { return write_new(key, sgs); }
+        if (ret != btree_status_t::success) {
+            return folly::makeFuture< dedup_blk_ref >(std::system_error(index_error("lookup", key, ret)));
+        }
+        if (!m_verify) { return add_ref(key, cur, sgs); }
+
+        return same_data(cur.blkid(), sgs).thenValue([this, key, cur, sgs](bool same) {
+            if (same) { return add_ref(key, cur, sgs); }
+            LOGWARN("Dedup fingerprint={} of blkid={} matched different data, writing it separately",
+                    key.to_string(), cur.blkid().to_string());
+            m_stats.num_collisions.fetch_add(1, std::memory_order_relaxed);
+            return write_blks(sgs).thenValue([key](MultiBlkId const& bid) {
+                return dedup_blk_ref{.key = key, .blkid = bid, .in_index = false};
+            });
+        });
+    }
+
+    folly::Future< dedup_blk_ref > add_ref(DedupKey const& key, DedupValue const& cur, sisl::sg_list const& sgs) {
+        auto const ret = update_if_unchanged(key, cur, cur.with_ref_count(cur.ref_count() + 1));
+        if (ret == btree_status_t::success) {
+            m_stats.num_deduped.fetch_add(1, std::memory_order_relaxed);
+            return folly::makeFuture(dedup_blk_ref{.key = key, .blkid = cur.blkid(), .in_index = true});
+        }
+        if (ret != btree_status_t::put_failed) {
+            return folly::makeFuture< dedup_blk_ref >(std::system_error(index_error("update", key, ret)));
+        }
+        // Entry changed since it was looked up by a racing write or free, look it up again
+        return dedup_write(key, sgs);
+    }
+
+    folly::Future< dedup_blk_ref > write_new(DedupKey const& key, sisl::sg_list const& sgs) {
+        return write_blks(sgs).thenValue([this, key, sgs](MultiBlkId const& bid) {
+            DedupValue const v{bid, 1};
+            auto req = BtreeSinglePutRequest{&key, &v, btree_put_type::INSERT};
+            auto const ret = m_table.put(req);
+            if (ret == btree_status_t::success) {
+                return folly::makeFuture(dedup_blk_ref{.key = key, .blkid = bid, .in_index = true});
+            }
+
+            // Insert fails only on a duplicate, when a racing write of the same data got into the index first, in
+            // which case its blks are shared instead. On any other failure, the blks written are freed.
+            auto const err = (ret == btree_status_t::put_failed) ? std::error_code{} : index_error("insert", key, ret);
+            return m_data_svc.async_free_blk(bid).thenValue([this, key, sgs, err](std::error_code) {
+                if (err) { throw std::system_error(err); }
+                return dedup_write(key, sgs);
+            });
+        });
+    }
+
+    folly::Future< MultiBlkId > write_blks(sisl::sg_list const& sgs) {
+        auto bid = std::make_shared< MultiBlkId >();
+        return m_data_svc.async_alloc_write(sgs, m_hints, *bid).thenValue([this, bid](std::error_code err) {
+            if (err) { throw std::system_error(err); }
+            m_data_svc.commit_blk(*bid);
+            return *bid;
+        });
+    }
+
+    // Puts the new value only if the entry still has the value it was looked up with, put_failed if it doesn't
+    btree_status_t update_if_unchanged(DedupKey const& key, DedupValue const& cur, DedupValue const& new_val) {
+        auto const filter = [&cur](BtreeKey const&, BtreeValue const& existing, BtreeValue const&) {
+            return (s_cast< DedupValue const& >(existing) == cur) ? put_filter_decision::replace
+                                                                  : put_filter_decision::keep;
+        };
+        auto req = BtreeSinglePutRequest{&key, &new_val, btree_put_type::UPDATE, nullptr, filter};
+        return m_table.put(req);
+    }
+
+    static std::error_code index_error(const char* op, DedupKey const& key, btree_status_t ret) {
+        LOGERROR("Dedup {} of fingerprint={} failed in the index, ret={}", op, key.to_string(), ret);
+        return std::make_error_code(std::errc::io_error);
+    }
+
+    folly::Future< bool > same_data(MultiBlkId const& bid, sisl::sg_list const& sgs) {
+        auto buf = std::make_shared< sisl::io_blob_safe >(bid.blk_count() * m_data_svc.get_blk_size(),
+                                                          m_data_svc.get_align_size());
+        if (buf->size() < sgs.size) { return folly::makeFuture(false); }
+        return m_data_svc.async_read(bid, buf->bytes(), buf->size()).thenValue([buf, sgs](std::error_code err) {
+            if (err) { throw std::system_error(err); }
+            uint64_t off{0};
+            for (auto const& iov : sgs.iovs) {
+                if (std::memcmp(buf->cbytes() + off, iov.iov_base, iov.iov_len) != 0) { return false; }
+                off += iov.iov_len;
+            }
+            return true;
+        });
+    }
+
+private:
+    BlkDataService& m_data_svc;
+    table_t& m_table;
+    bool m_verify;
+    blk_alloc_hints m_hints;
+    dedup_stats m_stats;
+};
+} // namespace homestore
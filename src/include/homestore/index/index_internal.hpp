@@ -57,6 +57,29 @@ struct index_table_sb {
     uint32_t user_sb_size; // Size of the user superblk
     uint8_t user_sb_bytes[0];
 };
+
+static constexpr uint64_t indx_destroy_sb_magic{0xdeadbedabb1e};
+static constexpr uint32_t indx_destroy_sb_version{0x1};
+
+// Marks the index table whose nodes are being freed in the background, so that its destroy resumes after a restart
+struct index_destroy_sb {
+    uint64_t magic{indx_destroy_sb_magic};
+    uint32_t version{indx_destroy_sb_version};
+    uuid_t uuid; // UUID of the index being destroyed
+};
+
+static constexpr uint64_t indx_scrub_sb_magic{0x5c2bbedabb1e};
+static constexpr uint32_t indx_scrub_sb_version{0x1};
+
+// Cursor of the scrub of an index table, which is resumed after its last key, across restarts too
+struct index_scrub_sb {
+    uint64_t magic{indx_scrub_sb_magic};
+    uint32_t version{indx_scrub_sb_version};
+    uuid_t uuid;            // UUID of the index being scrubbed
+    uint64_t num_passes{0}; // Passes over the whole table completed
+    uint32_t key_size{0};   // Size of the last key scrubbed, 0 if the current pass is yet to start
+    uint8_t key_bytes[0];   // Serialized last key scrubbed
+};
 #pragma pack()
 
 struct IndexBuffer;
@@ -72,7 +95,12 @@ public:
     virtual uint32_t ordinal() const = 0;
     virtual uint64_t used_size() const = 0;
     virtual void destroy() = 0;
+
+    // Frees a batch of the nodes of the table under the cp, and its superblk along with the last one. Returns has_more
+    // till all of them are freed.
+    virtual btree_status_t destroy_nodes(uint64_t& n_freed_nodes, void* cp_ctx) = 0;
     virtual void repair_node(IndexBufferPtr const& buf) = 0;
+    virtual void prefetch_nodes(std::vector< bnodeid_t > const& ids) const = 0;
 };
 
 enum class index_buf_state_t : uint8_t {
@@ -106,7 +134,12 @@ struct IndexBuffer : public sisl::ObjLifeCounter< IndexBuffer > {
     void set_crash_flag() { m_crash_flag_on = true; }
 #endif
 
-    uint32_t m_index_ordinal{0};  // Ordinal of the index table this buffer belongs to, used only during recovery
+    uint32_t m_index_ordinal{0};   // Ordinal of the index table this buffer belongs to, for recovery and warm up
+    uint32_t m_flush_partition{0}; // Partition of the cp flush this buffer is scheduled in
+
+    std::shared_ptr< uint8_t[] > m_persisted_image; // Node as it is on disk, while its updates are logged as deltas
+    uint32_t m_num_delta_cps{0};                    // Number of cps this node is logged as delta since its full write
+    bool m_delta_logged{false};                     // Is the update of this cp logged as delta instead of node write
     uint8_t m_is_meta_buf{false}; // Is the index buffer writing to metablk?
     bool m_node_freed{false};
 
@@ -137,7 +170,9 @@ struct MetaIndexBuffer : public IndexBuffer {
 
 struct IndexBtreeNode : public BtreeNode {
 public:
-    IndexBufferPtr m_idx_buf; // Buffer backing this node
+    IndexBufferPtr m_idx_buf;                // Buffer backing this node
+    std::atomic< bool > m_referenced{false}; // Accessed again after it was loaded, used by the cache eviction
+    std::atomic< bool > m_prefetched{false}; // Loaded by readahead, its first access is the actual load
 
 public:
     template < typename... Args >
@@ -0,0 +1,208 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <boost/uuid/uuid_io.hpp>
+#include <sisl/fds/buffer.hpp>
+#include <sisl/logging/logging.h>
+#include <homestore/blkdata_service.hpp>
+#include <homestore/homestore.hpp>
+#include <homestore/index_service.hpp>
+#include <homestore/index/index_table.hpp>
+
+namespace homestore {
+
+// Blks of the data service referred to by an index entry, with the crcs of its blks if the entry keeps them
+struct scrub_blk_ref {
+    MultiBlkId blkid;
+    std::vector< crc32_t > crcs; // Crcs of the blks of the blkid in order, data is not read if it is empty
+};
+
+struct scrub_stats {
+    uint64_t num_entries{0};      // Entries of the table scrubbed
+    uint64_t num_blks{0};         // Blkids referred to by the entries
+    uint64_t num_unallocated{0};  // Blkids which are not allocated in their allocator
+    uint64_t num_crc_mismatch{0}; // Blkids whose data doesn't match their crcs
+    uint64_t num_read_errors{0};  // Blkids whose data couldn't be read
+    uint64_t num_passes{0};       // Passes over the whole table completed
+
+    bool is_clean() const { return (num_unallocated == 0) && (num_crc_mismatch == 0) && (num_read_errors == 0); }
+};
+
+struct scrub_params {
+    uint32_t batch_entries{1000};        // Entries queried in a batch, after which the cursor is persisted
+    uint32_t max_entries_per_sec{10000}; // 0 to not limit the rate
+    uint32_t cpu_pct{10};                // Share of a cpu the scrub keeps busy, 100 to not limit it
+};
+
+/*
+ * Online consistency check of an index table and of the blks of the data service its entries refer to. Entries are
+ * walked in batches by sweep queries, which read lock a node only while it is read, so that the table stays in use.
+ * Blks referred to by an entry are checked to be allocated in their allocator and, if the entry keeps their crcs,
+ * their data is read and checked against them. Inconsistencies are logged and counted, they are not repaired.
+ *
+ * Scrub resumes after the last key of the previous batch, which is persisted in the index scrub superblk of the table,
+ * also across restarts, and starts a new pass once it reaches the end of the range. It runs synchronously on the thread
+ * of the caller and sleeps between the batches, to stay within the rate of entries and the share of cpu it is given.
+ */
+template < typename K, typename V >
+class IndexScrubber {
+public:
+    using refs_cb_t = std::function< std::vector< scrub_blk_ref >(K const&, V const&) >;
+
+    IndexScrubber(IndexTable< K, V >& table, BtreeKeyRange< K > range, refs_cb_t refs_cb, scrub_params params = {}) :
+            m_table{table},
+            m_range{std::move(range)},
+            m_refs_cb{std::move(refs_cb)},
+            m_params{params},
+            m_name{boost::uuids::to_string(table.uuid())},
+            m_cursor{hs()->index_service().scrub_cursor(table.uuid())} {}
+
+    /// @brief Scrubs upto max_entries from the cursor, or till stop() is called, and persists the cursor after every
+    /// batch. Returns early once a whole pass finds no entries, i.e. the range is empty.
+    /// @return Stats of the entries scrubbed by this call
+    scrub_stats scrub(uint64_t max_entries) {
+        scrub_stats stats;
+        m_stopped.store(false);
+        bool whole_pass = ((*m_cursor)->key_size == 0); // Whether this call started the current pass
+        uint64_t pass_entries{0};
+        while ((stats.num_entries < max_entries) && !m_stopped.load()) {
+            auto const start = std::chrono::steady_clock::now();
+            auto const nbatch =
+                std::min(uint64_cast(std::max(m_params.batch_entries, 1u)), max_entries - stats.num_entries);
+            std::vector< std::pair< K, V > > out;
+            auto const ret = query_batch(uint32_cast(nbatch), out);
+            if ((ret != btree_status_t::success) && (ret != btree_status_t::has_more)) {
+                LOGERROR("Scrub of index table={} failed to query, ret={}", m_name, ret);
+                break;
+            }
+
+            for (auto const& [k, v] : out) {
+                check_entry(k, v, stats);
+            }
+            stats.num_entries += out.size();
+            pass_entries += out.size();
+
+            if (ret == btree_status_t::success) {
+                // Reached the end of the range, next batch starts the next pass
+                ++stats.num_passes;
+                save_cursor(nullptr);
+                if (whole_pass && (pass_entries == 0)) { break; }
+                whole_pass = true;
+                pass_entries = 0;
+            } else if (!out.empty()) {
+                save_cursor(&out.back().first);
+            } else {
+                LOGERROR("Scrub of index table={} got no entries from a query which has more", m_name);
+                break;
+            }
+            throttle(out.size(), std::chrono::steady_clock::now() - start);
+        }
+        return stats;
+    }
+
+    /// @brief Stops the scrub in progress after its current batch
+    void stop() { m_stopped.store(true); }
+
+private:
+    btree_status_t query_batch(uint32_t nbatch, std::vector< std::pair< K, V > >& out) {
+        auto const& c = *m_cursor;
+        if (c->key_size == 0) {
+            BtreeQueryRequest< K > qreq{BtreeKeyRange< K >{m_range},
+                                        BtreeQueryType::SWEEP_NON_INTRUSIVE_PAGINATION_QUERY, nbatch};
+            return m_table.query(qreq, out);
+        }
+
+        K last_key;
+        last_key.deserialize(sisl::blob{c->key_bytes, c->key_size}, true /* copy */);
+        BtreeQueryRequest< K > qreq{BtreeKeyRange< K >{last_key, false, m_range.end_key(), m_range.is_end_inclusive()},
+                                    BtreeQueryType::SWEEP_NON_INTRUSIVE_PAGINATION_QUERY, nbatch};
+        return m_table.query(qreq, out);
+    }
+
+    void check_entry(K const& k, V const& v, scrub_stats& stats) {
+        for (auto const& ref : m_refs_cb(k, v)) {
+            ++stats.num_blks;
+            if (!m_data_svc.is_blk_alloced(ref.blkid)) {
+                LOGERROR("Scrub found key={} of index table={} referring to unallocated blkid={}", k.to_string(),
+                         m_name, ref.blkid.to_string());
+                ++stats.num_unallocated;
+                continue;
+            }
+            if (ref.crcs.empty()) { continue; }
+
+            auto const size = ref.blkid.blk_count() * m_data_svc.get_blk_size();
+            sisl::io_blob_safe buf{size, m_data_svc.get_align_size()};
+            auto const err = m_data_svc.async_read(ref.blkid, buf.bytes(), size, ref.crcs).get();
+            if (err == std::errc::bad_message) {
+                LOGERROR("Scrub found crc mismatch of blkid={} of key={} of index table={}", ref.blkid.to_string(),
+                         k.to_string(), m_name);
+                ++stats.num_crc_mismatch;
+            } else if (err) {
+                LOGERROR("Scrub failed to read blkid={} of key={} of index table={}, err={}", ref.blkid.to_string(),
+                         k.to_string(), m_name, err.message());
+                ++stats.num_read_errors;
+            }
+        }
+    }
+
+    void save_cursor(K const* last_key) {
+        auto& c = *m_cursor;
+        auto const kb = (last_key == nullptr) ? sisl::blob{} : last_key->serialize();
+        if (c.size() < sizeof(index_scrub_sb) + kb.size()) {
+            auto const hdr = *c.get();
+            c.resize(sizeof(index_scrub_sb) + kb.size());
+            *c.get() = hdr;
+        }
+        if (last_key == nullptr) { ++c->num_passes; }
+        c->key_size = kb.size();
+        if (kb.size() != 0) { std::memcpy(c->key_bytes, kb.cbytes(), kb.size()); }
+        c.write();
+    }
+
+    // Sleeps long enough for the batch to be within the rate of entries and within the share of cpu
+    void throttle(uint64_t nentries, std::chrono::steady_clock::duration busy) {
+        std::chrono::steady_clock::duration wait{0};
+        if (m_params.max_entries_per_sec != 0) {
+            wait = std::chrono::microseconds{nentries * 1000000 / m_params.max_entries_per_sec} - busy;
+        }
+        if ((m_params.cpu_pct != 0) && (m_params.cpu_pct < 100)) {
+            wait = std::max(wait, busy * (100 - m_params.cpu_pct) / m_params.cpu_pct);
+        }
+        if (wait > std::chrono::steady_clock::duration{0}) { std::this_thread::sleep_for(wait); }
+    }
+
+private:
+    IndexTable< K, V >& m_table;
+    BtreeKeyRange< K > m_range;
+    refs_cb_t m_refs_cb;
+    scrub_params m_params;
+    BlkDataService& m_data_svc{hs()->data_service()};
+    std::string m_name; // Uuid of the table, for the logs
+    shared< superblk< index_scrub_sb > > m_cursor;
+    std::atomic< bool > m_stopped{false};
+};
+} // namespace homestore
@@ -23,6 +23,7 @@
 #include <homestore/index_service.hpp>
 #include <homestore/checkpoint/cp_mgr.hpp>
 #include <homestore/index/wb_cache_base.hpp>
+#include <homestore/perf_stats.hpp>
 #include <homestore/btree/detail/btree_internal.hpp>
 #include <iomgr/iomgr_flip.hpp>
 
@@ -38,7 +39,11 @@ private:
 
 public:
     IndexTable(uuid_t uuid, uuid_t parent_uuid, uint32_t user_sb_size, const BtreeConfig& cfg) :
-            Btree< K, V >{cfg}, m_sb{"index"} {
+            Btree< K, V >{persistent_cfg(cfg)}, m_sb{"index"} {
+        if (hs()->is_read_only()) {
+            throw std::runtime_error(fmt::format("Index table={} can't be created by a read only open", cfg.name()));
+        }
+
         // Create a superblk for the index table and create MetaIndexBuffer corresponding to that
         m_sb.create(sizeof(index_table_sb));
         m_sb->uuid = uuid;
@@ -55,7 +60,8 @@ public:
         if (status != btree_status_t::success) { throw std::runtime_error(fmt::format("Unable to create root node")); }
     }
 
-    IndexTable(superblk< index_table_sb >&& sb, const BtreeConfig& cfg) : Btree< K, V >{cfg}, m_sb{std::move(sb)} {
+    IndexTable(superblk< index_table_sb >&& sb, const BtreeConfig& cfg) :
+            Btree< K, V >{persistent_cfg(cfg)}, m_sb{std::move(sb)} {
         m_sb_buffer = std::make_shared< MetaIndexBuffer >(m_sb);
 
         // After recovery, we see that root node is empty, which means that after btree is created, we crashed.
@@ -82,6 +88,12 @@ public:
         m_sb.destroy();
     }
 
+    btree_status_t destroy_nodes(uint64_t& n_freed_nodes, void* cp_ctx) override {
+        auto const ret = this->destroy_batch(n_freed_nodes, cp_ctx);
+        if (ret == btree_status_t::success) { m_sb.destroy(); }
+        return ret;
+    }
+
     uuid_t uuid() const override { return m_sb->uuid; }
     uint32_t ordinal() const override { return m_sb->ordinal; }
     uint64_t used_size() const override { return m_sb->index_size; }
@@ -91,6 +103,8 @@ public:
 
     template < typename ReqT >
     btree_status_t put(ReqT& put_req) {
+        HS_PERF_SCOPE(INDEX_PUT);
+        hs()->index_service().throttle_update(ordinal(), 1);
         auto ret = btree_status_t::success;
         do {
             auto cpg = cp_mgr().cp_guard();
@@ -101,8 +115,29 @@ public:
         return ret;
     }
 
+    // Upon cp mismatch, batch is resumed from the update which failed, since the ones before are already applied
+    btree_status_t put_batch(BtreeBatchRangePutRequest< K >& breq) {
+        HS_PERF_SCOPE(INDEX_PUT);
+        hs()->index_service().throttle_update(ordinal(), breq.num_updates());
+        auto ret = btree_status_t::success;
+        do {
+            auto cpg = cp_mgr().cp_guard();
+            breq.m_op_context = (void*)cpg.context(cp_consumer_t::INDEX_SVC);
+            ret = Btree< K, V >::put_batch(breq);
+            if (ret == btree_status_t::cp_mismatch) { LOGTRACEMOD(wbcache, "CP Mismatch, retrying batch put"); }
+        } while (ret == btree_status_t::cp_mismatch);
+        return ret;
+    }
+
+    template < typename ReqT >
+    btree_status_t get(ReqT& get_req) const {
+        HS_PERF_SCOPE(INDEX_GET);
+        return Btree< K, V >::get(get_req);
+    }
+
     template < typename ReqT >
     btree_status_t remove(ReqT& remove_req) {
+        HS_PERF_SCOPE(INDEX_REMOVE);
         auto ret = btree_status_t::success;
         do {
             auto cpg = cp_mgr().cp_guard();
@@ -113,6 +148,29 @@ public:
         return ret;
     }
 
+    btree_status_t rebalance_underfull_nodes(uint32_t max_nodes = std::numeric_limits< uint32_t >::max()) {
+        auto ret = btree_status_t::success;
+        do {
+            auto cpg = cp_mgr().cp_guard();
+            ret = Btree< K, V >::rebalance_underfull_nodes(max_nodes, (void*)cpg.context(cp_consumer_t::INDEX_SVC));
+            if (ret == btree_status_t::cp_mismatch) { LOGTRACEMOD(wbcache, "CP Mismatch, retrying rebalance"); }
+        } while (ret == btree_status_t::cp_mismatch);
+        return ret;
+    }
+
+    // Entire tree is built and the root is switched under a single cp, so that either the whole tree is persisted or
+    // none of it. Root switch is the last step of the load, so upon cp mismatch all the nodes built so far are
+    // released and the tree is still empty to retry on.
+    btree_status_t bulk_load(std::vector< std::pair< K, V > > const& sorted_kvs) {
+        auto ret = btree_status_t::success;
+        do {
+            auto cpg = cp_mgr().cp_guard();
+            ret = Btree< K, V >::bulk_load(sorted_kvs, (void*)cpg.context(cp_consumer_t::INDEX_SVC));
+            if (ret == btree_status_t::cp_mismatch) { LOGTRACEMOD(wbcache, "CP Mismatch, retrying bulk load"); }
+        } while (ret == btree_status_t::cp_mismatch);
+        return ret;
+    }
+
     void repair_node(IndexBufferPtr const& idx_buf) override {
         if (idx_buf->is_meta_buf()) {
             // We cannot repair the meta buf on its own, we need to repair the root node which modifies the
@@ -132,6 +190,7 @@ public:
 
         LOGTRACEMOD(wbcache, "repair_node cp={} buf={}", cpg->id(), idx_buf->to_string());
         repair_links(bn, (void*)cpg.context(cp_consumer_t::INDEX_SVC));
+        COUNTER_INCREMENT(this->m_metrics, btree_recovery_repaired_nodes, 1);
 
         if (idx_buf->m_up_buffer && idx_buf->m_up_buffer->is_meta_buf()) {
             // Our up buffer is a meta buffer, which means that we are the new root node, we need to update the
@@ -140,14 +199,43 @@ public:
         }
     }
 
+private:
+    // B-link splits leave the parent of a split leaf stale for a while, which the wb cache can't persist crash
+    // consistently, since it orders the writes of a split by the parent child dependency
+    static BtreeConfig persistent_cfg(BtreeConfig cfg) {
+        if (cfg.m_blink_splits) {
+            LOGWARNMOD(wbcache, "B-link splits are not supported by index table={}, disabling it", cfg.name());
+            cfg.m_blink_splits = false;
+        }
+
+        // Leaves take contiguous blks of the node size, which only the varsize allocator of the index vdev gives
+        if ((cfg.m_leaf_node_size != 0) && (cfg.m_leaf_node_size != cfg.node_size())) {
+            if (!hs()->index_service().multi_blk_nodes() || (cfg.m_leaf_node_size < cfg.node_size())) {
+                LOGWARNMOD(wbcache, "Leaf node size={} is not supported by index table={} on index vdev, using {}",
+                           cfg.m_leaf_node_size, cfg.name(), cfg.node_size());
+                cfg.m_leaf_node_size = 0;
+            } else {
+                cfg.m_leaf_node_size = sisl::round_up(cfg.m_leaf_node_size, cfg.node_size());
+            }
+        }
+
+        // Tables of a read only open are never mutated, so their readers need no node locks
+        cfg.m_read_only = hs()->is_read_only();
+        return cfg;
+    }
+
 protected:
     ////////////////// Override Implementation of underlying store requirements //////////////////
     BtreeNodePtr alloc_node(bool is_leaf) override {
-        return wb_cache().alloc_buf([this, is_leaf](const IndexBufferPtr& idx_buf) -> BtreeNodePtr {
-            BtreeNode* n = this->init_node(idx_buf->raw_buffer(), idx_buf->blkid().to_integer(), true, is_leaf);
-            static_cast< IndexBtreeNode* >(n)->attach_buf(idx_buf);
-            return BtreeNodePtr{n};
-        });
+        auto const nblks = blk_count_t(this->m_bt_cfg.node_size(is_leaf) / this->m_bt_cfg.node_size());
+        return wb_cache().alloc_buf(
+            [this, is_leaf](const IndexBufferPtr& idx_buf) -> BtreeNodePtr {
+                idx_buf->m_index_ordinal = ordinal();
+                BtreeNode* n = this->init_node(idx_buf->raw_buffer(), idx_buf->blkid().to_integer(), true, is_leaf);
+                static_cast< IndexBtreeNode* >(n)->attach_buf(idx_buf);
+                return BtreeNodePtr{n};
+            },
+            nblks);
     }
 
     btree_status_t write_node_impl(const BtreeNodePtr& node, void* context) override {
@@ -202,6 +290,7 @@ protected:
     btree_status_t read_node_impl(bnodeid_t id, BtreeNodePtr& node) const override {
         try {
             wb_cache().read_buf(id, node, [this](const IndexBufferPtr& idx_buf) mutable -> BtreeNodePtr {
+                idx_buf->m_index_ordinal = ordinal();
                 bool is_leaf = BtreeNode::identify_leaf_node(idx_buf->raw_buffer());
                 BtreeNode* n = this->init_node(idx_buf->raw_buffer(), idx_buf->blkid().to_integer(),
                                                false /* init_buf */, is_leaf);
@@ -212,6 +301,19 @@ protected:
         } catch (std::exception& e) { return btree_status_t::node_read_failed; }
     }
 
+    void prefetch_nodes(std::vector< bnodeid_t > const& ids) const override {
+        // Prefetch completes asynchronously, possibly after this table is gone, so initializer shouldn't refer to it
+        auto cfg = std::make_shared< BtreeConfig >(this->m_bt_cfg);
+        wb_cache().prefetch_bufs(ids, [cfg, ord = ordinal()](const IndexBufferPtr& idx_buf) -> BtreeNodePtr {
+            idx_buf->m_index_ordinal = ord;
+            bool is_leaf = BtreeNode::identify_leaf_node(idx_buf->raw_buffer());
+            BtreeNode* n = Btree< K, V >::create_btree_node(idx_buf->raw_buffer(), idx_buf->blkid().to_integer(),
+                                                            false /* init_buf */, is_leaf, *cfg);
+            static_cast< IndexBtreeNode* >(n)->attach_buf(idx_buf);
+            return BtreeNodePtr{n};
+        });
+    }
+
     btree_status_t refresh_node(const BtreeNodePtr& node, bool for_read_modify_write, void* context) const override {
         if (context == nullptr || !for_read_modify_write) { return btree_status_t::success; }
         return wb_cache().get_writable_buf(node, r_cast< CPContext* >(context)) ? btree_status_t::success
@@ -262,8 +364,8 @@ protected:
         }
 
         // Keep a copy of the node buffer, in case we need to revert back
-        uint8_t* tmp_buffer = new uint8_t[this->m_node_size];
-        std::memcpy(tmp_buffer, parent_node->m_phys_node_buf, this->m_node_size);
+        uint8_t* tmp_buffer = new uint8_t[parent_node->node_size()];
+        std::memcpy(tmp_buffer, parent_node->m_phys_node_buf, parent_node->node_size());
 
         // Remove all the entries in parent_node and let walk across child_nodes rebuild this node
         parent_node->remove_all(this->m_bt_cfg);
@@ -342,7 +444,7 @@ protected:
         if (ret != btree_status_t::success) {
             BT_LOG(ERROR, "An error occurred status={} during repair of parent_node={}, aborting the repair",
                    enum_name(ret), parent_node->node_id());
-            std::memcpy(parent_node->m_phys_node_buf, tmp_buffer, this->m_bt_cfg.node_size());
+            std::memcpy(parent_node->m_phys_node_buf, tmp_buffer, parent_node->node_size());
         }
 
         delete[] tmp_buffer;
@@ -0,0 +1,241 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <folly/futures/Future.h>
+#include <sisl/fds/buffer.hpp>
+#include <homestore/blkdata_service.hpp>
+#include <homestore/btree/btree_kv.hpp>
+#include <homestore/crc.h>
+#include <homestore/index/index_table.hpp>
+
+namespace homestore {
+
+/*
+ * Value of an index entry, whose bytes are kept in its leaf if they are small and in the value log otherwise, in which
+ * case the leaf keeps a pointer to them instead: their size, crc and the compact encoding of their blkid. Leaves of
+ * large values stay dense this way and an update of an entry doesn't rewrite the large values of its neighbours.
+ */
+class SeparatedValue : public BtreeValue {
+public:
+    SeparatedValue() = default;
+    SeparatedValue(sisl::blob const& b, bool copy) : BtreeValue() { deserialize(b, copy); }
+    SeparatedValue(SeparatedValue const& other) : BtreeValue(), m_buf{other.m_buf} {}
+    SeparatedValue& operator=(SeparatedValue const& other) {
+        m_buf = other.m_buf;
+        return *this;
+    }
+    virtual ~SeparatedValue() = default;
+
+    static SeparatedValue make_inline(sisl::blob const& bytes) {
+        SeparatedValue v;
+        v.m_buf.resize(1 + bytes.size());
+        v.m_buf[0] = s_inline_tag;
+        if (bytes.size() != 0) { std::memcpy(v.m_buf.data() + 1, bytes.cbytes(), bytes.size()); }
+        return v;
+    }
+
+    static SeparatedValue make_pointer(MultiBlkId const& blkid, uint32_t size, uint32_t crc) {
+        SeparatedValue v;
+        v.m_buf.resize(sizeof(pointer_hdr) + blkid.compact_serialized_size());
+        pointer_hdr const hdr{.tag = s_pointer_tag, .size = size, .crc = crc};
+        std::memcpy(v.m_buf.data(), &hdr, sizeof(pointer_hdr));
+        blkid.serialize_compact(v.m_buf.data() + sizeof(pointer_hdr));
+        return v;
+    }
+
+    bool is_pointer() const { return !m_buf.empty() && (m_buf[0] == s_pointer_tag); }
+
+    // Bytes of an inline value
+    sisl::blob inline_bytes() const {
+        return m_buf.empty() ? sisl::blob{} : sisl::blob{m_buf.data() + 1, uint32_cast(m_buf.size() - 1)};
+    }
+
+    // Size of the value, wherever it is kept
+    uint32_t value_size() const { return is_pointer() ? hdr().size : inline_bytes().size(); }
+    uint32_t crc() const { return hdr().crc; }
+
+    MultiBlkId blkid() const {
+        MultiBlkId bid;
+        bid.deserialize(sisl::blob{m_buf.data() + sizeof(pointer_hdr), uint32_cast(m_buf.size() - sizeof(pointer_hdr))},
+                        true);
+        return bid;
+    }
+
+    sisl::blob serialize() const override { return sisl::blob{m_buf.data(), uint32_cast(m_buf.size())}; }
+    uint32_t serialized_size() const override { return uint32_cast(m_buf.size()); }
+    static uint32_t get_fixed_size() { return 0; }
+    void deserialize(sisl::blob const& b, bool) override { m_buf.assign(b.cbytes(), b.cbytes() + b.size()); }
+
+    std::string to_string() const override {
+        return is_pointer() ? fmt::format("ptr[{} size={}]", blkid().to_string(), value_size())
+                            : fmt::format("inline[size={}]", value_size());
+    }
+
+    bool operator==(SeparatedValue const& other) const { return (m_buf == other.m_buf); }
+
+private:
+    static constexpr uint8_t s_inline_tag{0};
+    static constexpr uint8_t s_pointer_tag{1};
+
+#pragma pack(1)
+    struct pointer_hdr {
+        uint8_t tag;
+        uint32_t size;
+        uint32_t crc;
+    };
+#pragma pack()
+
+    pointer_hdr hdr() const {
+        pointer_hdr h;
+        std::memcpy(&h, m_buf.data(), sizeof(pointer_hdr));
+        return h;
+    }
+
+private:
+    std::vector< uint8_t > m_buf; // Tag, followed by the inline bytes or the rest of the pointer
+};
+
+/*
+ * Value log of the index tables of SeparatedValue values. Values larger than the threshold are written each to a
+ * contiguous blk of the data service, which is expected to be on append blk allocator chunks, and the table keeps a
+ * pointer to them. Blks of a value replaced or removed from the table are freed by the caller through free_value,
+ * once it has the previous value from the put or remove.
+ *
+ * Values no longer pointed to by the table are reclaimed by compact(), which runs the append chunk compaction of the
+ * data service with the table as its consumer: the live blks of a victim chunk are the pointers of the table into it,
+ * and a relocated value is repointed only if the entry still has the same pointer, so that a racing update wins.
+ */
+class IndexValueLog {
+public:
+    IndexValueLog(BlkDataService& data_svc, uint32_t threshold, blk_alloc_hints hints = {}) :
+            m_data_svc{data_svc}, m_threshold{threshold}, m_hints{std::move(hints)} {
+        m_hints.is_contiguous = true;
+        m_hints.partial_alloc_ok = false;
+    }
+
+    uint32_t threshold() const { return m_threshold; }
+
+    /// @brief Value of the bytes for the table, which are written to the value log first if they exceed the threshold.
+    /// Bytes are copied before it returns.
+    folly::Future< SeparatedValue > make_value(sisl::blob const& bytes) {
+        if (bytes.size() <= m_threshold) { return folly::makeFuture(SeparatedValue::make_inline(bytes)); }
+
+        auto const blk_size = m_data_svc.get_blk_size();
+        auto buf = std::make_shared< sisl::io_blob_safe >(sisl::round_up(bytes.size(), blk_size),
+                                                          m_data_svc.get_align_size());
+        std::memcpy(buf->bytes(), bytes.cbytes(), bytes.size());
+        std::memset(buf->bytes() + bytes.size(), 0, buf->size() - bytes.size());
+        auto const size = bytes.size();
+        auto const crc = crc32_ieee(init_crc32, bytes.cbytes(), size);
+
+        sisl::sg_list sgs;
+        sgs.size = buf->size();
+        sgs.iovs.emplace_back(iovec{.iov_base = buf->bytes(), .iov_len = buf->size()});
+        auto bid = std::make_shared< MultiBlkId >();
+        return m_data_svc.async_alloc_write(sgs, m_hints, *bid)
+            .thenValue([this, buf, bid, size, crc](std::error_code err) {
+                if (err) { throw std::system_error(err); }
+                m_data_svc.commit_blk(*bid);
+                return SeparatedValue::make_pointer(*bid, size, crc);
+            });
+    }
+
+    /// @brief Bytes of the value, read from the value log if the table has a pointer to them
+    folly::Future< std::string > read_value(SeparatedValue const& v) {
+        if (!v.is_pointer()) {
+            auto const b = v.inline_bytes();
+            return folly::makeFuture(std::string{r_cast< const char* >(b.cbytes()), b.size()});
+        }
+
+        auto const bid = v.blkid();
+        auto buf = std::make_shared< sisl::io_blob_safe >(bid.blk_count() * m_data_svc.get_blk_size(),
+                                                          m_data_svc.get_align_size());
+        return m_data_svc.async_read(bid, buf->bytes(), buf->size())
+            .thenValue([buf, size = v.value_size(), crc = v.crc(), bid](std::error_code err) {
+                if (err) { throw std::system_error(err); }
+                if (crc32_ieee(init_crc32, buf->cbytes(), size) != crc) {
+                    throw std::runtime_error(fmt::format("Crc mismatch of value at blkid={}", bid.to_string()));
+                }
+                return std::string{r_cast< const char* >(buf->cbytes()), size};
+            });
+    }
+
+    /// @brief Frees the blks of the value in the value log, if it has any
+    folly::Future< std::error_code > free_value(SeparatedValue const& v) {
+        if (!v.is_pointer()) { return folly::makeFuture(std::error_code{}); }
+        return m_data_svc.async_free_blk(v.blkid());
+    }
+
+    /// @brief Reclaims the blks of the values not pointed to by the table, which has all its entries in the range.
+    /// Runs synchronously, as the compaction of the data service does.
+    /// @return Number of blks reclaimed
+    template < typename K >
+    uint64_t compact(IndexTable< K, SeparatedValue >& table, BtreeKeyRange< K > const& range,
+                     uint32_t scan_batch_size = 1000) {
+        // Entries pointing into the victim chunk, by their blkid, from the latest scan
+        std::unordered_map< BlkId, std::pair< K, SeparatedValue > > live;
+
+        auto live_cb = [&table, &range, &live, scan_batch_size](chunk_num_t chunk) {
+            live.clear();
+            std::vector< BlkId > blkids;
+            BtreeQueryRequest< K > qreq{BtreeKeyRange< K >{range}, BtreeQueryType::SWEEP_NON_INTRUSIVE_PAGINATION_QUERY,
+                                        scan_batch_size};
+            std::vector< std::pair< K, SeparatedValue > > out;
+            btree_status_t ret;
+            do {
+                out.clear();
+                ret = table.query(qreq, out);
+                for (auto& [k, v] : out) {
+                    if (!v.is_pointer()) { continue; }
+                    auto const bid = v.blkid().to_single_blkid();
+                    if (bid.chunk_num() != chunk) { continue; }
+                    blkids.push_back(bid);
+                    live.emplace(bid, std::make_pair(std::move(k), std::move(v)));
+                }
+            } while (ret == btree_status_t::has_more);
+            return blkids;
+        };
+
+        auto relocate_cb = [&table, &live](BlkId const& from, MultiBlkId const& to) {
+            auto const it = live.find(from);
+            if (it == live.end()) { return; }
+            auto const& [key, old_val] = it->second;
+            auto const new_val = SeparatedValue::make_pointer(to, old_val.value_size(), old_val.crc());
+            auto const filter = [&old_val](BtreeKey const&, BtreeValue const& existing, BtreeValue const&) {
+                return (static_cast< SeparatedValue const& >(existing) == old_val) ? put_filter_decision::replace
+                                                                                   : put_filter_decision::keep;
+            };
+            auto req = BtreeSinglePutRequest{&key, &new_val, btree_put_type::UPDATE, nullptr, filter};
+            table.put(req);
+        };
+
+        return m_data_svc.compact(live_cb, relocate_cb);
+    }
+
+private:
+    BlkDataService& m_data_svc;
+    uint32_t m_threshold;
+    blk_alloc_hints m_hints;
+};
+} // namespace homestore
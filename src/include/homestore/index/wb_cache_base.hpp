@@ -16,7 +16,9 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 #include <boost/intrusive_ptr.hpp>
+#include <nlohmann/json.hpp>
 #include <sisl/utility/atomic_counter.hpp>
 #include <homestore/blk.h>
 #include <homestore/index/index_internal.hpp>
@@ -37,8 +39,9 @@ public:
     /// @brief Allocate the buffer and initialize the btree node. It adds the node to the wb cache.
     /// @tparam K Key type of the Index
     /// @param node_initializer Callback to be called upon which buffer is turned into btree node
+    /// @param nblks Number of contiguous blks of the node, each of the node size of the index vdev
     /// @return Node which was created by the node_initializer
-    virtual BtreeNodePtr alloc_buf(node_initializer_t&& node_initializer) = 0;
+    virtual BtreeNodePtr alloc_buf(node_initializer_t&& node_initializer, blk_count_t nblks) = 0;
 
     /// @brief Write buffer
     /// @param buf
@@ -47,6 +50,18 @@ public:
 
     virtual void read_buf(bnodeid_t id, BtreeNodePtr& node, node_initializer_t&& node_initializer) = 0;
 
+    /// @brief Issue asynchronous reads for the buffers which are not already in cache and add them to the cache upon
+    /// completion. It does not wait for the reads to complete.
+    /// @param ids List of node ids to prefetch
+    /// @param node_initializer Callback to be called upon which buffer is turned into btree node
+    virtual void prefetch_bufs(std::vector< bnodeid_t > const& ids, node_initializer_t const& node_initializer) = 0;
+
+    /// @brief Drop the node from the cache if it is clean and not in use by anyone, so that its next access reads it
+    /// from the device
+    /// @param id Node id of the buffer
+    /// @return true if it was in cache and is evicted
+    virtual bool evict_buf(bnodeid_t id) = 0;
+
     virtual bool get_writable_buf(const BtreeNodePtr& node, CPContext* context) = 0;
 
     virtual bool refresh_meta_buf(shared< MetaIndexBuffer >& meta_buf, CPContext* cp_ctx) = 0;
@@ -65,6 +80,24 @@ public:
     /// @return
     // virtual IndexBufferPtr copy_buffer(const IndexBufferPtr& cur_buf, const CPContext* context) const = 0;
     virtual void recover(sisl::byte_view sb) = 0;
+
+    /// @brief Prefetch the hot nodes persisted by the previous run into the cache, once the index tables are loaded.
+    /// It does not wait for the reads to complete, which stop_prefetches waits for at the shutdown.
+    virtual void warm_up() = 0;
+
+    /// @brief Persist the list of hot nodes in the cache, to be prefetched by warm_up at the next start
+    virtual void persist_hot_nodes() = 0;
+
+    /// @brief Stop taking any new prefetch, including the ones of warm_up, and wait for the prefetches in flight to
+    /// complete. It has to be called before the cache or the index tables are destroyed.
+    virtual void stop_prefetches() = 0;
+
+    /// @brief Set the share of the cache in percent, which the index table is assured of, overriding the
+    /// index_cache_table_quota_pct config for it. Table can borrow the capacity beyond it left idle by the others.
+    virtual void set_table_quota(uint32_t index_ordinal, uint32_t quota_pct) = 0;
+
+    /// @brief Resident nodes, quota, hit ratio and evictions of each index table in the cache
+    virtual nlohmann::json get_table_stats() const = 0;
 };
 
 } // namespace homestore
@@ -14,10 +14,14 @@
  *
  *********************************************************************************/
 #pragma once
+#include <atomic>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
+#include <folly/futures/Future.h>
 #include <iomgr/iomgr.hpp>
 #include <sisl/fds/id_reserver.hpp>
 #include <homestore/homestore_decl.hpp>
@@ -34,6 +38,7 @@ class VirtualDev;
 class IndexServiceCallbacks {
 public:
     virtual ~IndexServiceCallbacks() = default;
+    // Also called for the tables whose destroy was not done till the shutdown, which the service then resumes
     virtual std::shared_ptr< IndexTableBase > on_index_table_found(superblk< index_table_sb >&&) {
         assert(0);
         return nullptr;
@@ -47,13 +52,28 @@ private:
     std::shared_ptr< VirtualDev > m_vdev;
     std::pair< meta_blk*, sisl::byte_view > m_wbcache_sb{
         std::pair< meta_blk*, sisl::byte_view >{nullptr, sisl::byte_view{}}};
+    std::pair< meta_blk*, sisl::byte_view > m_wbcache_hot_sb{
+        std::pair< meta_blk*, sisl::byte_view >{nullptr, sisl::byte_view{}}};
+    std::pair< meta_blk*, sisl::byte_view > m_wbcache_txn_log_sb{
+        std::pair< meta_blk*, sisl::byte_view >{nullptr, sisl::byte_view{}}};
     std::vector< std::pair< meta_blk*, sisl::byte_view > > m_itable_sbs;
+    std::vector< std::pair< meta_blk*, sisl::byte_view > > m_itable_destroy_sbs;
+    std::vector< std::pair< meta_blk*, sisl::byte_view > > m_itable_scrub_sbs;
+    std::vector< std::pair< meta_blk*, sisl::byte_view > > m_wbcache_delta_sbs;
     std::unique_ptr< sisl::IDReserver > m_ordinal_reserver;
 
     mutable std::mutex m_index_map_mtx;
     std::map< uuid_t, std::shared_ptr< IndexTableBase > > m_index_map;
     std::unordered_map< uint32_t, std::shared_ptr< IndexTableBase > > m_ordinal_index_map;
 
+    // Scrub cursors of the tables
+    std::mutex m_scrub_mtx;
+    std::map< uuid_t, std::shared_ptr< superblk< index_scrub_sb > > > m_scrub_sbs;
+
+    // Background destroys of the tables
+    std::atomic< bool > m_destroy_stopped{false};
+    std::atomic< uint32_t > m_num_destroying{0};
+
 public:
     IndexService(std::unique_ptr< IndexServiceCallbacks > cbs);
 
@@ -75,17 +95,39 @@ public:
     std::shared_ptr< IndexTableBase > get_index_table(uuid_t uuid) const;
     std::shared_ptr< IndexTableBase > get_index_table(uint32_t ordinal) const;
 
+    // Removes the table right away and frees its nodes in the background, at most index_destroy_max_nodes_per_cp of
+    // them in a cp. Destroy is persisted, so that it is resumed at the next start if the shutdown comes first. Future
+    // is set to true once all the nodes of the table are freed.
+    folly::Future< bool > destroy_index_table_async(const std::shared_ptr< IndexTableBase >& tbl);
+
+    // Pauses the background destroys, before the cp manager is shutdown
+    void stop_destroys();
+
+    // Persisted cursor of the scrub of the index table, which is created if the table is not scrubbed yet. Cursor is
+    // destroyed along with the table.
+    std::shared_ptr< superblk< index_scrub_sb > > scrub_cursor(uuid_t uuid);
+
     // Reserve an ordinal for the index table
     uint32_t reserve_ordinal();
 
+    // Slows the updates of the index table down as the dirty buffers build up, consulted before entering the cp
+    void throttle_update(uint32_t ordinal, uint64_t num_entries);
+
     uint64_t used_size() const;
     uint32_t node_size() const;
+
+    // Can the nodes take more than one blk of the node size, which the leaves bigger than the interior nodes need
+    bool multi_blk_nodes() const;
     void repair_index_node(uint32_t ordinal, IndexBufferPtr const& node_buf);
 
     IndexWBCacheBase& wb_cache() {
         if (!m_wb_cache) { throw std::runtime_error("Attempted to access a null pointer wb_cache"); }
         return *m_wb_cache;
     }
+
+private:
+    folly::Future< bool > run_destroy(std::shared_ptr< IndexTableBase > tbl,
+                                      std::shared_ptr< superblk< index_destroy_sb > > dsb);
 };
 
 extern IndexService& index_service();
@@ -0,0 +1,125 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <folly/SharedMutex.h>
+#include <nlohmann/json.hpp>
+
+#include <homestore/logstore/log_store_internal.hpp>
+
+namespace homestore {
+
+struct log_record_status {
+    bool is_out_of_range{false}; // Truncated already
+    bool is_hole{false};         // Not written yet
+    bool is_active{false};       // Written, but not completed yet
+    bool is_completed{false};
+};
+
+/*
+ * In memory index of the logdev keys of the records of a log store, by lsn.
+ *
+ * Records are kept in chunks of s_chunk_slots consecutive lsns, in a slot of 16 bytes each: the dev offset of the log
+ * group of the record, with the state of the record in its top bits, its log idx as a delta from the first idx of the
+ * chunk and its truncation key, which is in the same log group unless the record is written out of order, as a delta
+ * from its log idx. Records whose keys do not fit these, like the filled gaps or the ones written out of order, are
+ * kept in a map on the side. Lookup is an indexing of the chunk and of the slot, truncation frees whole chunks.
+ *
+ * Slots are created and completed under the shared lock, chunks are added and freed under the exclusive lock.
+ */
+class LogRecordIndex {
+public:
+    static constexpr uint32_t s_chunk_slots{1024};
+
+    explicit LogRecordIndex(logstore_seq_num_t truncated_upto);
+    LogRecordIndex(const LogRecordIndex&) = delete;
+    LogRecordIndex& operator=(const LogRecordIndex&) = delete;
+    ~LogRecordIndex() = default;
+
+    void create(logstore_seq_num_t lsn);
+    void complete(logstore_seq_num_t lsn, const logstore_record& rec);
+    void create_and_complete(logstore_seq_num_t lsn, const logstore_record& rec);
+
+    log_record_status status(logstore_seq_num_t lsn) const;
+
+    /// @brief Record of the lsn, which has the invalid keys if the lsn is not completed
+    logstore_record at(logstore_seq_num_t lsn) const;
+
+    /// @brief Calls cb with the records of the contiguous completed lsns from start_lsn, till it returns false. cb is
+    /// called without holding the lock of the index.
+    void foreach_all_completed(logstore_seq_num_t start_lsn,
+                               const std::function< bool(logstore_seq_num_t, const logstore_record&) >& cb) const;
+
+    /// @brief Last of the contiguous written (or completed) lsns from the given lsn, one before it if it is not
+    logstore_seq_num_t active_upto(logstore_seq_num_t from = std::numeric_limits< logstore_seq_num_t >::min()) const;
+    logstore_seq_num_t completed_upto(logstore_seq_num_t from = std::numeric_limits< logstore_seq_num_t >::min()) const;
+
+    /// @brief Drops all the lsns upto and including upto_lsn
+    void truncate(logstore_seq_num_t upto_lsn);
+
+    /// @brief Turns all the lsns after to_lsn into holes
+    void rollback(logstore_seq_num_t to_lsn);
+
+    nlohmann::json get_status(int verbosity) const;
+
+private:
+    enum class slot_state : uint8_t { HOLE = 0, ACTIVE = 1, COMPLETED = 2, SPILLED = 3 };
+    static constexpr uint32_t s_state_shift{62};
+    static constexpr uint64_t s_offset_mask{(uint64_t{1} << s_state_shift) - 1};
+    static constexpr logid_t s_no_idx{std::numeric_limits< logid_t >::min()};
+
+    struct slot {
+        std::atomic< uint64_t > word{0}; // State in the top bits, dev offset in the rest
+        std::atomic< int32_t > idx_delta{0};
+        std::atomic< int32_t > trunc_idx_delta{0};
+    };
+
+    struct chunk {
+        std::atomic< logid_t > base_idx{s_no_idx};
+        std::atomic< uint32_t > nissued{0};    // Slots which are active or completed
+        std::atomic< uint32_t > ncompleted{0}; // Slots which are completed
+        std::array< slot, s_chunk_slots > slots;
+    };
+
+    static slot_state state_of(uint64_t word) { return slot_state(word >> s_state_shift); }
+    static bool is_completed(slot_state st) { return (st == slot_state::COMPLETED) || (st == slot_state::SPILLED); }
+
+    chunk* chunk_of(logstore_seq_num_t lsn) const;
+    std::pair< chunk*, slot* > slot_of(logstore_seq_num_t lsn);
+    void set_slot(logstore_seq_num_t lsn, const logstore_record* rec);
+    logstore_record record_of(logstore_seq_num_t lsn, const chunk& c, const slot& s) const;
+    logstore_seq_num_t scan_upto(logstore_seq_num_t from, bool completed) const;
+
+private:
+    mutable folly::SharedMutexWritePriority m_mtx;
+    logstore_seq_num_t m_origin;         // First lsn of the chunk number 0
+    logstore_seq_num_t m_truncated_upto; // Lsns upto and including this are dropped
+    int64_t m_first_chunk_num{0};        // Chunk number of the front of m_chunks
+    std::deque< std::unique_ptr< chunk > > m_chunks;
+
+    mutable std::mutex m_spill_mtx;
+    std::unordered_map< logstore_seq_num_t, logstore_record > m_spilled;
+};
+} // namespace homestore
@@ -23,15 +23,17 @@
 #include <memory>
 #include <mutex>
 #include <set>
+#include <span>
 #include <unordered_map>
 #include <vector>
 #include <tuple>
 
 #include <sisl/fds/buffer.hpp>
-#include <sisl/fds/stream_tracker.hpp>
 #include <folly/Synchronized.h>
+#include <folly/futures/Future.h>
 #include <nlohmann/json.hpp>
 
+#include <homestore/logstore/log_record_index.hpp>
 #include <homestore/logstore/log_store_internal.hpp>
 
 namespace homestore {
@@ -119,6 +121,39 @@ public:
      */
     logstore_seq_num_t append_async(const sisl::io_blob& b, void* cookie, const log_write_comp_cb_t& completion_cb);
 
+    /**
+     * @brief Appends the data without copying it into the log group. The buffer is written as is, as out of band data
+     * of the group, so the on-disk format is the same as that of any other append. Log store takes ownership of the
+     * buffer and frees it after the completion callback.
+     *
+     * @param buf Buffer with the data at its start, aligned to and sized in multiple of zero_copy_align_size(). Rest
+     * of the buffer after the data is zeroed and written as padding.
+     * @param size Size of the data in buf
+     * @param cookie Passed as is to the completion callback
+     * @param completion_cb Completion callback, same as that of append_async above
+     *
+     * @return internally generated sequence number
+     */
+    logstore_seq_num_t append_async(sisl::io_blob_safe&& buf, uint32_t size, void* cookie,
+                                    const log_write_comp_cb_t& completion_cb);
+
+    /**
+     * @brief Appends all the blobs into the log as consecutive seq numbers and makes a single callback once all of
+     * them are written. Seq numbers are reserved and the records are added to the logdev at once, so it is cheaper
+     * than an append_async per blob, with the batch not interleaved with the appends of other threads.
+     *
+     * @param blobs Blobs of data to append, which are expected to be valid till the completion callback
+     * @param cookie Passed as is to the completion callback
+     * @param completion_cb Completion callback, called once with the first and last seq number of the batch
+     *
+     * @return Sequence number of the first blob in the batch
+     */
+    logstore_seq_num_t append_batch(std::span< const sisl::io_blob > blobs, void* cookie,
+                                    const log_batch_comp_cb_t& completion_cb);
+
+    /// @brief Alignment and size multiple of the buffer of zero copy append
+    uint64_t zero_copy_align_size() const;
+
     /**
      * @brief Write the blob at the user specified seq number and flush, just like write_sync
      *
@@ -139,6 +174,20 @@ public:
      */
     log_buffer read_sync(logstore_seq_num_t seq_num);
 
+    /**
+     * @brief Read the logs of the range of sequence numbers asynchronously. Records which are adjacent on the device
+     * are read together with large sequential reads, instead of a read per record. Much like foreach, the range ends
+     * at the first record which is not completed yet.
+     *
+     * Returned future has std::out_of_range exception if start_lsn is already truncated or never inserted before
+     *
+     * @param start_lsn: First seq number to read
+     * @param end_lsn: Last seq number to read (inclusive)
+     * @return Future of log_buffers of the range, in the order of seq numbers
+     */
+    folly::Future< std::vector< log_buffer > > async_read_range(logstore_seq_num_t start_lsn,
+                                                                logstore_seq_num_t end_lsn);
+
     /**
      * @brief Truncate the logs for this log store upto the seq_num provided (inclusive). Once truncated, the reads
      * on seq_num <= upto_seq_num will return an error. The truncation in general is a 2 step process, where first
@@ -173,9 +222,19 @@ public:
 
     logdev_key get_trunc_ld_key() const { return m_trunc_ld_key; }
 
+    /**
+     * @brief Records that the log records upto the seq_num are applied durably by the consumer, so they need not be
+     * replayed upon restart. It is persisted along with the logstore meta right away. After a restart, the logstore
+     * starts after the checkpoint, as if the records upto it were truncated, and the logdev starts its recovery from
+     * the minimum checkpoint across all its logstores. Space of the records is still reclaimed only by truncate.
+     *
+     * @param upto_lsn: Seq_num upto which (including) the records are applied, it has to be completed already.
+     */
+    void set_replay_checkpoint(logstore_seq_num_t upto_lsn);
+
     std::tuple< logstore_seq_num_t, logdev_key, logstore_seq_num_t > truncate_info() const;
 
-    sisl::StreamTracker< logstore_record >& log_records() { return m_records; }
+    LogRecordIndex& log_records() { return m_records; }
 
     /**
      * @brief iterator to get all the log buffers;
@@ -269,7 +328,7 @@ public:
 private:
     logstore_id_t m_store_id;
     std::shared_ptr< LogDev > m_logdev;
-    sisl::StreamTracker< logstore_record > m_records;
+    LogRecordIndex m_records;
     bool m_append_mode{false};
     log_req_comp_cb_t m_comp_cb;
     log_found_cb_t m_found_cb;
@@ -46,6 +46,8 @@ typedef uint32_t logdev_id_t;
 
 typedef std::function< void(logstore_req*, logdev_key) > log_req_comp_cb_t;
 typedef std::function< void(logstore_seq_num_t, sisl::io_blob&, logdev_key, void*) > log_write_comp_cb_t;
+// Called with the first and last seq_num of the batch, key of the last record and the cookie
+typedef std::function< void(logstore_seq_num_t, logstore_seq_num_t, logdev_key, void*) > log_batch_comp_cb_t;
 typedef std::function< void(logstore_seq_num_t, log_buffer, void*) > log_found_cb_t;
 typedef std::function< void(std::shared_ptr< HomeLogStore >) > log_store_opened_cb_t;
 typedef std::function< void(std::shared_ptr< HomeLogStore >, logstore_seq_num_t) > log_replay_done_cb_t;
@@ -123,7 +125,9 @@ struct logstore_req {
     bool is_internal_req;       // If the req is created internally by HomeLogStore itself
     log_req_comp_cb_t cb;       // Callback upon completion of write (overridden than default)
     Clock::time_point start_time;
+    uint64_t append_tsc{0}; // Tsc of the append, to break down its latency into the stages of the flush
     bool flush_wait{false}; // Wait for the flush to happen
+    sisl::io_blob_safe zero_copy_buf; // Buffer owned by the request for zero copy append, data is at its start
 
     logstore_req(const logstore_req&) = delete;
     logstore_req& operator=(const logstore_req&) = delete;
@@ -167,8 +171,12 @@ struct logstore_superblk {
     static void init(logstore_superblk& m);
     static void clear(logstore_superblk& m);
     [[nodiscard]] static bool is_valid(const logstore_superblk& m);
+    bool has_replay_checkpoint() const { return m_replay_start_key.is_valid(); }
 
     logstore_seq_num_t m_first_seq_num{0};
+    // Replay checkpoint: records before this lsn are applied durably by the consumer, so they are not replayed
+    logstore_seq_num_t m_replay_start_lsn{-1};
+    logdev_key m_replay_start_key; // Logdev key of the log group from where replay of the store has to start
 };
 #pragma pack()
 } // namespace homestore
\ No newline at end of file
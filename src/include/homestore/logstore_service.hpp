@@ -20,6 +20,7 @@
 #include <condition_variable>
 #include <functional>
 #include <limits>
+#include <map>
 #include <memory>
 #include <mutex>
 
@@ -78,8 +79,11 @@ public:
      * method to be executed on log store.
      *
      * @param format If set to true, will not recover, but create a fresh log store set.
+     * @param lazy_recovery If set to true, existing logdevs are not replayed before returning. They are replayed one by
+     * one in the background, or on their first access if that comes earlier, and the futures of their log stores opened
+     * before start are fulfilled then.
      */
-    void start(bool format);
+    void start(bool format, bool lazy_recovery = false);
 
     /**
      * @brief Stop the LogStoreService. It resets all parameters and can be restarted with start method.
@@ -171,7 +175,43 @@ public:
 
     uint32_t used_size() const;
     uint32_t total_size() const;
-    iomgr::io_fiber_t flush_thread() { return m_flush_fiber; }
+    uint32_t num_flush_threads() const { return uint32_cast(m_flush_fibers.size()); }
+    iomgr::io_fiber_t flush_thread(logdev_id_t logdev_id) const {
+        return m_flush_fibers[logdev_id % m_flush_fibers.size()];
+    }
+
+    /**
+     * @brief Pin the flushes and flush timer of the logdev to the fiber provided, instead of the dedicated flush thread
+     * it is assigned to. Owner of the logdev can use it to keep all the log io of it on the reactor, which is doing the
+     * appends, avoiding a cross core wakeup for every flush. Pinning is not persisted and has to be redone on restart.
+     *
+     * @param logdev_id: Logdev ID
+     * @param fiber: Fiber to flush on, nullptr reverts it to the dedicated flush thread
+     */
+    void pin_logdev_flush(logdev_id_t logdev_id, iomgr::io_fiber_t fiber);
+
+    /**
+     * @brief Replay the logdev right away, if its recovery was deferred by the lazy recovery and is not done yet.
+     * Returns once it is replayed. Done implicitly by the methods accessing the logdev.
+     *
+     * @param logdev_id: Logdev ID
+     */
+    void recover_logdev(logdev_id_t logdev_id);
+
+    /**
+     * @brief Replay an existing logdev ahead of the start of the service, for a consumer which has to recover from its
+     * logs before the other logdevs are replayed. Its log stores are to be opened before. Start of the service skips
+     * the logdev afterwards.
+     *
+     * @param logdev_id: Logdev ID
+     */
+    void start_logdev(logdev_id_t logdev_id);
+
+    // Number of logdevs whose lazy recovery is not done yet
+    size_t num_pending_logdevs() const;
+
+    // Replays the logdevs whose lazy recovery is not done yet and waits for the background recovery to complete
+    void recover_all_logdevs();
 
     void delete_unopened_logdevs();
 
@@ -183,16 +223,26 @@ private:
     void rollback_super_blk_found(const sisl::byte_view& buf, void* meta_cookie);
     void start_threads();
     void flush();
+    void recover_pending_logdevs();
+    bool is_pending(logdev_id_t logdev_id) const;
 
 private:
     std::unordered_map< logdev_id_t, std::shared_ptr< LogDev > > m_id_logdev_map;
     folly::SharedMutexWritePriority m_logdev_map_mtx;
 
     std::shared_ptr< JournalVirtualDev > m_logdev_vdev;
-    iomgr::io_fiber_t m_flush_fiber;
+    std::vector< iomgr::io_fiber_t > m_flush_fibers;
+    bool m_threads_started{false};
+    std::unordered_set< logdev_id_t > m_started_logdevs; // Logdevs replayed by start_logdev, ahead of start
     LogStoreServiceMetrics m_metrics;
     std::unordered_set< logdev_id_t > m_unopened_logdev;
     superblk< logstore_service_super_block > m_sb;
+
+    // Logdevs not replayed yet by the lazy recovery. Accesses racing with the replay of a logdev wait on its flag
+    mutable std::mutex m_pending_mtx;
+    std::map< logdev_id_t, std::shared_ptr< std::once_flag > > m_pending_logdevs;
+    std::atomic< bool > m_lazy_recovery_running{false};
+    std::atomic< bool > m_stopping{false};
 };
 
 extern LogStoreService& logstore_service();
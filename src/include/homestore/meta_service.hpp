@@ -15,10 +15,13 @@
  *********************************************************************************/
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <functional>
+#include <list>
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -26,9 +29,12 @@
 #include <vector>
 #include <optional>
 
+#include <folly/futures/Future.h>
+#include <iomgr/iomgr.hpp>
 #include <sisl/fds/buffer.hpp>
 #include <sisl/metrics/metrics.hpp>
 #include <nlohmann/json.hpp>
+#include <homestore/blk.h>
 #include <homestore/homestore_decl.hpp>
 
 namespace homestore {
@@ -55,12 +61,33 @@ typedef std::map< uint64_t, meta_blk_ovf_hdr* > ovf_hdr_map_t;          // ovf_b
 typedef std::map< meta_sub_type, MetaSubRegInfo > client_info_map_t;    // client information map;
 typedef std::unordered_map< meta_sub_type, std::vector< meta_sub_type > > subtype_graph_t;
 
+// Codec used to compress the context data of a meta blk. The codec is recorded in the meta blk header, so a sub type
+// can switch codecs anytime; DEFAULT is 0 so meta blks written before the codec was recorded keep decoding.
+VENUM(meta_compress_codec_t, uint8_t, DEFAULT = 0, // sisl compressor, only tried for large buffers
+      LZ4 = 1,                                     // fast, also tried for medium size buffers
+      LZ4HC = 2                                    // denser lz4 stream, slower to compress but same decode speed
+);
+
 class MetablkMetrics : public sisl::MetricsGroupWrapper {
 public:
     explicit MetablkMetrics(const char* inst_name) : sisl::MetricsGroupWrapper{"MetaService", inst_name} {
         REGISTER_COUNTER(compress_success_cnt, "compression successful cnt");
         REGISTER_COUNTER(compress_backoff_memory_cnt, "compression back-off cnt because of exceending memory limit")
         REGISTER_COUNTER(compress_backoff_ratio_cnt, "compression back-off cnt because of exceeding ratio limit");
+        REGISTER_COUNTER(meta_scan_reads, "reads issued to scan the meta blk and ovf blk chains");
+        REGISTER_COUNTER(batch_commit_cnt, "meta blk batches committed");
+        REGISTER_COUNTER(batch_op_cnt, "sub sb operations committed in batches");
+        REGISTER_COUNTER(async_update_cnt, "async sub sb updates requested");
+        REGISTER_COUNTER(async_update_coalesced_cnt, "async sub sb updates superseded by a later update");
+        REGISTER_COUNTER(delta_update_cnt, "sub sb updates which rewrote only the changed pages");
+        REGISTER_COUNTER(delta_update_pages, "pages rewritten by the delta sub sb updates");
+        REGISTER_COUNTER(read_cache_hit_cnt, "meta blk contexts served from the read cache");
+        REGISTER_COUNTER(read_cache_miss_cnt, "meta blk contexts read from disk through the read cache");
+        REGISTER_COUNTER(journal_update_cnt, "sub sb updates appended to the update journal");
+        REGISTER_COUNTER(journal_compact_cnt, "update journal compactions into the meta blk chain");
+        REGISTER_COUNTER(deferred_update_cnt, "deferred sub sb updates requested");
+        REGISTER_COUNTER(deferred_update_coalesced_cnt, "deferred sub sb updates superseded before their flush");
+        REGISTER_COUNTER(deferred_flush_cnt, "flushes of the deferred sub sb updates");
 
         REGISTER_HISTOGRAM(compress_ratio_percent, "compression ration percentage");
         register_me_to_farm();
@@ -76,6 +103,49 @@ public:
 
 struct meta_vdev_context;
 
+/**
+ * @brief : Set of sub sb adds, updates and removes staged to be committed together by MetaBlkService::commit_batch,
+ * with the meta blks of all of them written in one batch. Context data and cookies are referred to, not copied, so
+ * they have to stay valid till the batch is committed.
+ */
+class MetaBlkBatch {
+    friend class MetaBlkService;
+
+public:
+    void add_sub_sb(meta_sub_type type, const uint8_t* context_data, uint64_t sz, void*& cookie) {
+        m_adds.push_back(add_op{std::move(type), context_data, sz, &cookie});
+    }
+    void update_sub_sb(const uint8_t* context_data, uint64_t sz, void* cookie) {
+        m_updates.push_back(update_op{context_data, sz, cookie});
+    }
+    void remove_sub_sb(void* cookie) { m_removes.push_back(cookie); }
+
+    size_t size() const { return m_adds.size() + m_updates.size() + m_removes.size(); }
+    bool empty() const { return (size() == 0); }
+    void clear() {
+        m_adds.clear();
+        m_updates.clear();
+        m_removes.clear();
+    }
+
+private:
+    struct add_op {
+        meta_sub_type type;
+        const uint8_t* context_data;
+        uint64_t sz;
+        void** cookie;
+    };
+    struct update_op {
+        const uint8_t* context_data;
+        uint64_t sz;
+        void* cookie;
+    };
+
+    std::vector< add_op > m_adds;
+    std::vector< update_op > m_updates;
+    std::vector< void* > m_removes;
+};
+
 class MetaBlkService {
 private:
     static bool s_self_recover;
@@ -93,6 +163,49 @@ private:
     std::unique_ptr< meta_vdev_context > m_meta_vdev_context;
     subtype_graph_t m_dep_topo_graph;
 
+    // Pending async updates of a meta blk. Only the latest content is kept, the writes it supersedes are completed
+    // once it is written
+    struct async_update_ctx {
+        sisl::byte_array buf;
+        std::vector< folly::Promise< bool > > promises;
+    };
+    std::mutex m_async_mtx;
+    std::unordered_map< void*, async_update_ctx > m_async_updates; // cookie to the pending update, while writing it
+
+    // Deferred updates, guarded by m_async_mtx too. Latest content of each meta blk is kept till the next flush, which
+    // commits all of them in one batch
+    std::unordered_map< void*, async_update_ctx > m_deferred_updates;
+    iomgr::timer_handle_t m_deferred_flush_timer_hdl{iomgr::null_timer_handle};
+    std::atomic< bool > m_deferred_flush_scheduled{false};
+
+    // Contexts of recently read meta blks keyed by their blk id, in lru order. An entry is dropped whenever its meta
+    // blk is written
+    struct read_cache_entry {
+        sisl::byte_array buf;
+        std::list< uint64_t >::iterator lru_it;
+    };
+    std::mutex m_read_cache_mtx;
+    std::unordered_map< uint64_t, read_cache_entry > m_read_cache;
+    std::list< uint64_t > m_read_cache_lru; // most recently used first
+    uint64_t m_read_cache_size{0};
+    uint64_t m_read_cache_gen{0}; // bumped on every invalidation, so a read racing with a write is not cached
+
+    // Update journal: updates of small sub sbs are appended as versioned records to a contiguous extent, instead of
+    // rewriting their meta blk and ovf chain, and are compacted into the chain once the extent is full
+    struct journal_entry {
+        uint64_t offset; // blk offset of the record in the journal extent
+        uint32_t nblks;
+        uint64_t gen_cnt;
+        uint64_t sz;
+        uint32_t crc;
+        bool crc32c; // crc is crc32c, else crc32 ieee
+    };
+    mutable std::mutex m_journal_mtx; // guards m_journal_index for the readers not holding m_meta_mtx
+    std::unordered_map< uint64_t, journal_entry > m_journal_index; // meta blk id to its latest record
+    std::unordered_set< uint64_t > m_journal_bids;                 // meta blks with records in the current epoch
+    uint64_t m_journal_offset{0};                                  // blk offset to append the next record at
+    uint64_t m_journal_seq{0};
+
 public:
     MetaBlkService(const char* name = "MetaBlkStore");
     MetaBlkService(const MetaBlkService&) = delete;
@@ -135,6 +248,15 @@ public:
      */
     void deregister_handler(const meta_sub_type type);
 
+    /**
+     * @brief : Select the codec used to compress the superblocks of this subsystem type from the next write on.
+     * Superblocks already on disk keep the codec they were written with.
+     *
+     * @param type : subsystem type
+     * @param codec : codec to compress with
+     */
+    void set_compress_codec(const meta_sub_type& type, meta_compress_codec_t codec);
+
     /**
      * @brief : add subsystem superblock to meta blk mgr
      *
@@ -166,6 +288,63 @@ public:
      */
     void update_sub_sb(const uint8_t* context_data, uint64_t sz, void* cookie);
 
+    /**
+     * @brief : update metablk in-place asynchronously. Context data is copied, so caller can reuse it once this
+     * returns. While a write of the meta blk is in progress, repeated updates are coalesced and only the latest content
+     * is written next. A sync update_sub_sb supersedes the pending async update; remove_sub_sb fails it.
+     *
+     * @param context_data : subsytem sb;
+     * @param sz : size of context_data
+     * @param cookie : handle to address the unique subsytem sb that is being updated;
+     * @return : future which is set to true once this content or a later one is persisted, false if the meta blk is
+     * removed before that
+     */
+    folly::Future< bool > async_update_sub_sb(const uint8_t* context_data, uint64_t sz, void* cookie);
+
+    /**
+     * @brief : update metablk, rewriting only the changed pages of its ovf data. Changed pages are written to new blks
+     * and a new ovf chain, which refers to the unchanged data blks of the old one, is committed by the meta blk write.
+     * Falls back to a full update_sub_sb if the size changed, the meta blk is inline or compressed, or too many pages
+     * changed.
+     *
+     * @param context_data : subsytem sb;
+     * @param sz : size of context_data
+     * @param cookie : handle to address the unique subsytem sb that is being updated;
+     * @param dirty_pages : sorted indices of the pages, of block_size() each, changed since the last write
+     */
+    void update_sub_sb_delta(const uint8_t* context_data, uint64_t sz, void* cookie,
+                             const std::vector< uint64_t >& dirty_pages);
+
+    /**
+     * @brief : update metablk at the next flush of the deferred updates, which commits the deferred updates of all the
+     * meta blks in one batch, every sb_coalesce_interval_ms. Context data is copied and only the latest content of
+     * each meta blk is kept till the flush. A sync update_sub_sb, a delta update or a batch update of the meta blk
+     * supersedes the deferred update; remove_sub_sb fails it. Updated right away if coalescing is disabled.
+     *
+     * @param context_data : subsytem sb;
+     * @param sz : size of context_data
+     * @param cookie : handle to address the unique subsytem sb that is being updated;
+     * @return : future which is set to true once this content or a later one is persisted, false if the meta blk is
+     * removed before that
+     */
+    folly::Future< bool > defer_update_sub_sb(const uint8_t* context_data, uint64_t sz, void* cookie);
+
+    /**
+     * @brief : commit all the deferred updates now in one batch, for the callers which need them durable before the
+     * next periodic flush. Returns once they are persisted.
+     */
+    void flush_deferred_updates();
+
+    /**
+     * @brief : commit all the adds, updates and removes staged in the batch, under a single hold of the meta lock.
+     * Meta blks of the adds and updates are written in one batch. The added meta blks are linked to the chain by a
+     * single write once they are all persisted, so after a crash either all or none of them are found. Each update is
+     * in-place and atomic on its own. Removes are done at the end, one after another.
+     *
+     * @param batch : staged operations, the batch is cleared once committed. Cookies of the adds are set on return.
+     */
+    void commit_batch(MetaBlkBatch& batch);
+
     // size_t read_sub_sb(const meta_sub_type type, sisl::byte_view& buf);
     void read_sub_sb(meta_sub_type type);
 
@@ -269,8 +448,18 @@ private:
      * @brief : Allocate meta BlkId
      *
      */
-    void alloc_meta_blk(BlkId& bid);
-    void alloc_meta_blks(uint64_t size, std::vector< BlkId >& bid);
+    void alloc_meta_blk(BlkId& bid, blk_temp_t temp = blk_temp::any);
+    void alloc_meta_blks(uint64_t size, std::vector< BlkId >& bid, blk_temp_t temp = blk_temp::any);
+
+    /**
+     * @brief : Count an update of the sub type and reclassify it as hot or cold at the end of each window.
+     */
+    void record_update(const meta_sub_type& type);
+
+    /**
+     * @brief : Blk temperature to allocate the ovf blks of this sub type with.
+     */
+    blk_temp_t alloc_temp(const meta_sub_type& type) const;
 
     void free_meta_blk(meta_blk* mblk);
 
@@ -293,6 +482,11 @@ private:
      */
     meta_blk* init_meta_blk(BlkId& bid, meta_sub_type type, const uint8_t* context_data, size_t sz);
 
+    /**
+     * @brief : allocate and fill the header of a new meta blk, without linking it to the chain
+     */
+    meta_blk* new_meta_blk(const BlkId& bid, const meta_sub_type& type) const;
+
     /**
      * @brief
      *
@@ -309,8 +503,25 @@ private:
      * @param mblk
      * @param context_data
      * @param sz
+     * @param persist : write the meta blk to disk, otherwise only its ovf blks are written and caller writes the meta
+     * blk
+     */
+    void write_meta_blk_internal(meta_blk* mblk, const uint8_t* context_data, uint64_t sz, bool persist = true);
+
+    /**
+     * @brief : write the meta blks in one async batch and wait for all of them to be persisted
      */
-    void write_meta_blk_internal(meta_blk* mblk, const uint8_t* context_data, uint64_t sz);
+    void write_meta_blks_to_disk(const std::vector< meta_blk* >& mblks);
+
+    std::error_condition do_remove_sub_sb(void* cookie);
+    void do_update_sub_sb(const uint8_t* context_data, uint64_t sz, void* cookie, bool use_journal = true);
+    bool do_update_sub_sb_delta(const uint8_t* context_data, uint64_t sz, meta_blk* mblk,
+                                const std::vector< uint64_t >& dirty_pages);
+    void write_ctx_data(const BlkId& bid, const uint8_t* data, uint64_t sz);
+    void write_async_updates(void* cookie);
+    std::vector< folly::Promise< bool > > take_async_update(void* cookie, bool removed);
+    void do_commit_batch(MetaBlkBatch& batch);
+    void schedule_deferred_flush();
 
     /**
      * @brief : sync read;
@@ -330,10 +541,50 @@ private:
      */
     sisl::byte_array read_sub_sb_internal(const meta_blk* mblk) const;
 
+    /**
+     * @brief : read_sub_sb_internal served from the read cache, which it populates on a miss.
+     */
+    sisl::byte_array read_sub_sb_cached(const meta_blk* mblk);
+
+    /**
+     * @brief : Append the update to the update journal instead of the meta blk chain, if the journal is enabled and
+     * the update is small enough. Compacts the journal first if it is full.
+     *
+     * @return : false if the update has to be written to the chain
+     */
+    bool journal_update(meta_blk* mblk, const uint8_t* context_data, uint64_t sz);
+    bool can_journal(uint64_t sz) const;
+
+    /**
+     * @brief : Drop the journaled content of the meta blk as the chain is about to be rewritten, carrying over its
+     * gen_cnt so the chain write supersedes the records.
+     */
+    void journal_drop(meta_blk* mblk);
+
+    /**
+     * @brief : Void the records of the meta blk being removed, so they don't apply to a new meta blk at the same blk.
+     */
+    void journal_remove(meta_blk* mblk);
+    journal_entry append_journal_rec(const BlkId& mblk_bid, uint64_t gen_cnt, const uint8_t* context_data, uint64_t sz,
+                                     bool tombstone);
+    void compact_journal();
+    void load_journal();
+    void reset_journal();
+    std::optional< journal_entry > journaled(const BlkId& mblk_bid) const;
+    sisl::byte_array read_journal_rec(const journal_entry& e) const;
+    uint32_t journal_rec_nblks(uint64_t sz) const;
+    sisl::byte_array copy_buf(const sisl::byte_array& buf) const;
+    void invalidate_read_cache(const BlkId& bid);
+    void clear_read_cache();
+
     void free_compress_buf();
     void alloc_compress_buf(size_t size);
 
-    uint64_t min_compress_size() const;
+    uint64_t min_compress_size(meta_compress_codec_t codec) const;
+    uint64_t max_compress_len(meta_compress_codec_t codec, uint64_t sz) const;
+    size_t compress(meta_compress_codec_t codec, const uint8_t* src, uint64_t sz, uint8_t* dst, uint64_t dst_sz) const;
+    bool decompress(meta_compress_codec_t codec, const uint8_t* src, uint64_t sz, uint8_t* dst,
+                    size_t& decompressed_sz) const;
     uint64_t max_compress_memory_size() const;
     uint64_t init_compress_memory_size() const;
 
@@ -362,8 +613,20 @@ private:
     bool scan_and_load_meta_blks(meta_blk_map_t& meta_blks, ovf_hdr_map_t& ovf_blk_hdrs, BlkId* last_mblk_id,
                                  client_info_map_t& sub_info);
 
+    /**
+     * @brief : Load the ovf blk chains of the meta blks, with the chains read concurrently to each other
+     *
+     * @param chains : meta blks with ovf chains, along with the context size read so far, which is updated with the
+     * context size of their ovf blks;
+     * @param ovf_blk_hdrs : ovf blk map the loaded ovf blk headers are added to;
+     */
+    void load_ovf_blk_chains(std::vector< std::pair< meta_blk*, uint64_t > >& chains, ovf_hdr_map_t& ovf_blk_hdrs);
+    void verify_context_sz(meta_blk* mblk, uint64_t read_sz) const;
+
     void recover_meta_block(meta_blk* meta_block);
+    void recover_meta_block(meta_blk* meta_block, const sisl::byte_array& buf);
     void recover_meta_sub_type(bool do_comp_cb, const meta_sub_type&);
+    void recover_meta_sub_types_parallel(bool do_comp_cb, const std::vector< meta_sub_type >& sub_types);
 
 public:
     bool verify_metablk_store();
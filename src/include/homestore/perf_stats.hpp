@@ -0,0 +1,62 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+#include <sisl/utility/enum.hpp>
+#include <homestore/cpu_accounting.hpp>
+
+namespace homestore {
+ENUM(perf_op_t, uint8_t, DATA_READ, DATA_WRITE, INDEX_GET, INDEX_PUT, INDEX_REMOVE, JOURNAL_APPEND, JOURNAL_READ);
+ENUM(perf_cache_t, uint8_t, DATA_READ_CACHE, INDEX_WB_CACHE, JOURNAL_TAIL_CACHE);
+
+/*
+ * Latencies of the ops of each service and hits of its caches, from which HomeStore::get_perf_snapshot reports the
+ * throughput, p50/p99/p999 latencies and hit ratios of all the services in one place.
+ *
+ * Latencies go into a log linear histogram per op, 8 buckets per power of two, so that any percentile is read with
+ * at most 12.5% error from the counts of the buckets, which sisl histograms do not expose. Counts are cumulative;
+ * a snapshot in delta mode reports the difference from the previous delta snapshot instead.
+ */
+class PerfStats {
+public:
+    static void observe(perf_op_t op, uint64_t latency_us);
+    static void observe_since(perf_op_t op, uint64_t start_ticks);
+    static void cache_lookup(perf_cache_t cache, bool hit);
+
+    // Same counter as TscClock of the lib, which is not visible to the index headers
+    static uint64_t now_ticks() { return CPUAccounting::now_cycles(); }
+
+    /// @brief Throughput, latency percentiles and cache hit ratios, since the start or since the previous delta
+    static nlohmann::json get_snapshot(bool delta);
+};
+
+// Notes the latency of the op from its construction till its destruction
+class PerfScope {
+public:
+    explicit PerfScope(perf_op_t op) : m_op{op}, m_start{PerfStats::now_ticks()} {}
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+    ~PerfScope() { PerfStats::observe_since(m_op, m_start); }
+
+private:
+    perf_op_t m_op;
+    uint64_t m_start;
+};
+
+#define HS_PERF_SCOPE(op)                                                                                              \
+    homestore::PerfScope HS_CPU_SCOPE_CONCAT(_hs_perf_scope_, __LINE__) { homestore::perf_op_t::op }
+} // namespace homestore
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <latch>
+#include <optional>
 #include <variant>
 
 #include <boost/intrusive_ptr.hpp>
@@ -11,6 +14,7 @@
 #include <sisl/grpc/generic_service.hpp>
 #include <sisl/grpc/rpc_client.hpp>
 #include <homestore/replication/repl_decls.h>
+#include <homestore/coro_completion.hpp>
 #include <libnuraft/snapshot.hxx>
 
 namespace nuraft {
@@ -46,15 +50,26 @@ VENUM(journal_type_t, uint16_t,
       HS_CTRL_REPLACE = 3, // Control message to replace a member
 )
 
+// Finalizer of murmur3, which spreads every bit of the input over all bits of the hash
+inline uint64_t hash_mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb3f99fd5ed53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
 struct repl_key {
     int32_t server_id{0}; // Server Id which this req is originated from
     uint64_t term;        // RAFT term number
     uint64_t dsn{0};      // Data sequence number to tie the data with the raft journal entry
 
     struct Hasher {
+        // Keys in flight differ mostly in the low bits of the dsn, so all the fields are mixed, for the maps to spread
+        // them on any bits of the hash they pick the shards and buckets with
         size_t operator()(repl_key const& rk) const {
-            return std::hash< int32_t >()(rk.server_id) ^ std::hash< uint64_t >()(rk.term) ^
-                std::hash< uint64_t >()(rk.dsn);
+            return hash_mix64(hash_mix64((uint64_cast(uint32_cast(rk.server_id)) << 32) ^ rk.term) ^ rk.dsn);
         }
     };
 
@@ -64,6 +79,36 @@ struct repl_key {
     }
 };
 
+// Stages of a request traced on each replica, in the order they are reached on the follower
+VENUM(repl_req_stage_t, uint8_t,
+      BLK_ALLOCATED = 0, // Local blks are allocated for the data
+      DATA_RECEIVED = 1, // Data is received by the follower, or its push to the followers completed on the leader
+      DATA_WRITTEN = 2,  // Data is written locally
+      PROPOSED = 3,      // Entry is proposed to raft by the leader
+      LOG_APPENDED = 4,  // Entry is appended to the raft log
+      LOG_FLUSHED = 5,   // Entry is flushed in the raft log
+      COMMITTED = 6      // Entry is committed to the listener
+)
+static constexpr size_t num_repl_req_stages{7};
+
+// Timeline of a sampled request on one replica. Requests are sampled by their dsn, so that the same requests are traced
+// on all the replicas, with the repl_key being the trace id which ties their timelines together
+struct repl_req_trace {
+    repl_key rkey;
+    int64_t lsn{-1};
+    bool is_proposer{false};
+    std::array< int64_t, num_repl_req_stages > stage_us; // Time in us since the request started to each stage, or -1
+
+    std::string to_string() const {
+        std::string str = fmt::format("trace=[{}] lsn={} proposer={}", rkey.to_string(), lsn, is_proposer);
+        for (size_t i{0}; i < num_repl_req_stages; ++i) {
+            if (stage_us[i] < 0) { continue; }
+            fmt::format_to(std::back_inserter(str), " {}={}us", enum_name(repl_req_stage_t(i)), stage_us[i]);
+        }
+        return str;
+    }
+};
+
 using repl_snapshot = nuraft::snapshot;
 using repl_snapshot_ptr = nuraft::ptr< nuraft::snapshot >;
 
@@ -118,16 +163,28 @@ struct snapshot_data {
     sisl::io_blob_safe blob;
     bool is_first_obj{false};
     bool is_last_obj{false};
+    int64_t next_offset{-1}; // Offset of the object after this one if the reader knows it, to read ahead from it
 };
 
 struct repl_journal_entry;
-struct repl_req_ctx : public boost::intrusive_ref_counter< repl_req_ctx, boost::thread_safe_counter >,
-                      sisl::ObjLifeCounter< repl_req_ctx > {
+struct repl_req_ctx : public sisl::ObjLifeCounter< repl_req_ctx > {
     friend class SoloReplDev;
 
 public:
     repl_req_ctx() {}
     virtual ~repl_req_ctx();
+
+    /// @brief Gets a request from the pool of the calling thread, or a new one if the pool is empty. Request goes back
+    /// to the pool of the thread dropping its last reference, up to consensus.repl_req_pool_size of them per thread,
+    /// reset for reuse but with its flatbuffer builder and journal buffer keeping their capacity.
+    static repl_req_ptr_t make_pooled();
+
+    uint32_t use_count() const { return m_ref_count.load(std::memory_order_relaxed); }
+    friend void intrusive_ptr_add_ref(repl_req_ctx const* rreq) {
+        rreq->m_ref_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    friend void intrusive_ptr_release(repl_req_ctx const* rreq);
+
     void init(repl_key rkey, journal_type_t op_code, bool is_proposer, sisl::blob const& user_header,
               sisl::blob const& key, uint32_t data_size);
 
@@ -151,6 +208,8 @@ public:
     bool is_localize_pending() const { return m_is_jentry_localize_pending; }
     bool is_data_inlined() const { return (m_op_code == journal_type_t::HS_DATA_INLINED); }
     bool has_linked_data() const { return (m_op_code == journal_type_t::HS_DATA_LINKED); }
+    bool is_traced() const { return m_traced; }
+    repl_req_trace trace() const;
 
     raft_buf_ptr_t& raft_journal_buf();
     uint8_t* raw_journal_buf();
@@ -208,9 +267,24 @@ public:
     void add_state(repl_req_state_t s);
     bool add_state_if_not_already(repl_req_state_t s);
     void set_lentry(nuraft::ptr< nuraft::log_entry > const& lentry) { m_lentry = lentry; }
+
+    /// @brief Records the time the request reached the stage, if the request is sampled for tracing
+    void trace_stage(repl_req_stage_t stage);
+
+    /// @brief Registers the countdown to be counted down once the data of this request is written. Returns false
+    /// without registering it if the data is written already.
+    bool add_data_written_countdown(std::shared_ptr< std::latch > countdown);
+
+    /// @brief Marks the data of this request as written, fulfilling the data written promise and counting down the
+    /// countdown registered, if any.
+    void notify_data_written();
+    std::unique_ptr< uint8_t[] >& hdr_key_buf() { return m_hdr_key_buf; }
     void clear();
     flatbuffers::FlatBufferBuilder& create_fb_builder() { return m_fb_builder; }
-    void release_fb_builder() { m_fb_builder.Release(); }
+    void release_fb_builder() { m_fb_builder.Clear(); } // Keeps the capacity of the builder for the next use
+
+    /// @brief Completion of the request on the proposer, once committed or errored, which a coroutine can await
+    coro_completion< ReplServiceError >& commit_completion() { return m_commit_completion; }
 
 public:
     // IMPORTANT: Avoid declaring variables public, since this structure carries various entries and try to work in
@@ -221,6 +295,10 @@ public:
     sisl::io_blob_list_t m_pkts;                           // Pkts used for sending data
     std::mutex m_state_mtx;
 
+private:
+    bool create_compressed_journal_entry(int32_t server_id, uint32_t val_size, bool compact);
+    void recycle();
+
 private:
     repl_key m_rkey;                                           // Unique key for the request
     sisl::blob m_header;                                       // User header
@@ -231,24 +309,38 @@ private:
     journal_type_t m_op_code{journal_type_t::HS_DATA_INLINED}; // Operation code for this request
 
     /////////////// Data related section /////////////////
-    MultiBlkId m_local_blkid;   // Local BlkId for the data
-    RemoteBlkId m_remote_blkid; // Corresponding remote blkid for the data
-    uint8_t const* m_data;      // Raw data pointer containing the actual data
+    MultiBlkId m_local_blkid;       // Local BlkId for the data
+    RemoteBlkId m_remote_blkid;     // Corresponding remote blkid for the data
+    uint8_t const* m_data{nullptr}; // Raw data pointer containing the actual data
 
     /////////////// Journal/Buf related section /////////////////
     std::variant< std::unique_ptr< uint8_t[] >, raft_buf_ptr_t > m_journal_buf; // Buf for the journal entry
     repl_journal_entry* m_journal_entry{nullptr};                               // pointer to the journal entry
     bool m_is_jentry_localize_pending{false}; // Is the journal entry needs to be localized from remote
     nuraft::ptr< nuraft::log_entry > m_lentry;
+    std::unique_ptr< uint8_t[] > m_hdr_key_buf; // Header and key uncompressed from a compressed journal entry
+    uint32_t m_raw_journal_buf_size{0};         // Capacity of the plain journal buffer, which is reused if big enough
 
     /////////////// Replication state related section /////////////////
     std::atomic< uint32_t > m_state{uint32_cast(repl_req_state_t::INIT)}; // State of the replication request
+    std::shared_ptr< std::latch > m_data_written_countdown; // Countdown of the batch waiting on the data written
+    coro_completion< ReplServiceError > m_commit_completion; // Completion of the commit awaited by the proposer
+
+    /////////////// Tracing section /////////////////
+    bool m_traced{false};            // Is the request sampled for tracing
+    Clock::time_point m_trace_start; // Start of the request on this replica, which the stages are timed from
+    std::array< std::atomic< int64_t >, num_repl_req_stages > m_stage_us; // Time to each stage, -1 if not reached
 
     /////////////// Communication packet/builder section /////////////////
     flatbuffers::FlatBufferBuilder m_fb_builder;
     sisl::io_blob_safe m_buf_for_unaligned_data;
     intrusive< sisl::GenericRpcData > m_pushed_data;
     sisl::GenericClientResponse m_fetched_data;
+    uint32_t m_data_mem_used{0}; // Size of the received data accounted against the memory budget of the repl reqs
+
+    /////////////// Lifetime section /////////////////
+    mutable std::atomic< uint32_t > m_ref_count{0};
+    bool m_pooled{false}; // Goes back to the pool once released, instead of being freed
 };
 
 //
@@ -269,12 +361,43 @@ public:
     /// @param lsn - The log sequence number
     /// @param header - Header originally passed with replica_set::write() api
     /// @param key - Key originally passed with replica_set::write() api
-    /// @param blkids - List of blkids where data is written to the storage engine.
+    /// @param blkids - List of blkids where data is written to the storage engine. It is invalid on a witness (see
+    /// ReplDev::is_witness()), which doesn't store the data. It stays invalid for the entries committed before the
+    /// witness was promoted, also when they are replayed on a restart after the promotion, since their data was never
+    /// written here. Listener is to fetch the data of such entries from the other members, before reading it.
     /// @param ctx - Context passed as part of the replica_set::write() api
     ///
     virtual void on_commit(int64_t lsn, sisl::blob const& header, sisl::blob const& key, MultiBlkId const& blkids,
                            cintrusive< repl_req_ctx >& ctx) = 0;
 
+    /// @brief Called when a batch of contiguous log entries have been committed in the replica set, in place of
+    /// on_commit() for each of them, when the batched commit is turned on with consensus.commit_batch_max_entries.
+    ///
+    /// It is called from the same commit thread as on_commit(), with the lsns monotonically increasing within and
+    /// across the batches, after the blks of all the entries in the batch are committed. Listener can override it to
+    /// apply the whole batch at once, it defaults to calling on_commit() for each entry in order.
+    ///
+    /// @param rreqs - Committed entries, in the order of their lsn
+    ///
+    virtual void on_batch_commit(std::vector< repl_req_ptr_t > const& rreqs) {
+        for (auto const& rreq : rreqs) {
+            on_commit(rreq->lsn(), rreq->header(), rreq->key(), rreq->local_blkid(), rreq);
+        }
+    }
+
+    /// @brief Called in the batched commit mode with consensus.commit_parallelism above 1, to get the key an entry
+    /// conflicts on with other entries, typically derived from its header or key.
+    ///
+    /// Entries of a batch on different keys are applied concurrently with on_batch_commit() from the worker threads,
+    /// while the ones on the same key are applied in the order of their lsn. An entry without a key conflicts with all
+    /// of them, the entries before it are applied before it and the ones after it only after it is applied. Batch is
+    /// applied in full before the next one is.
+    ///
+    /// @param rreq - Committed entry
+    /// @return Conflict key of the entry, or nullopt if it is to be applied in order with all other entries
+    ///
+    virtual std::optional< uint64_t > get_commit_conflict_key(repl_req_ptr_t const& rreq) { return std::nullopt; }
+
     /// @brief Called when the log entry has been received by the replica dev.
     ///
     /// On recovery, this is called from a random worker thread before the raft server is started. It is
@@ -365,6 +488,10 @@ public:
     /// times on the leader till all the data is transferred to the follower. is_last_obj in
     /// snapshot_data will be true once all the data has been trasnferred. After this the raft on
     /// the follower side can do the incremental resync.
+    ///
+    /// If the listener sets next_offset in snapshot_data to the offset of the object after the one it read, the
+    /// objects after it are read ahead upto consensus.snapshot_read_ahead_objs while the follower saves this one. Read
+    /// ahead is from a worker thread, but never concurrently with another read of the same snapshot.
     virtual int read_snapshot_data(shared< snapshot_context > context, shared< snapshot_data > snp_data) = 0;
 
     /// @brief Called on the follower when the leader sends the data during the baseline resyc.
@@ -417,6 +544,21 @@ public:
     virtual folly::Future< std::error_code > async_read(MultiBlkId const& blkid, sisl::sg_list& sgs, uint32_t size,
                                                         bool part_of_batch = false) = 0;
 
+    /// @brief Reads the data like async_read, hedging the read with the copy of the data on the replica which
+    /// originated its write, if the local read takes longer than usual. Copy of the peer is fetched through the fetch
+    /// data channel and whichever of the two completes first fills the sgs.
+    /// @param blkid Block id to read
+    /// @param peer_blkid Remote blkid of the request which wrote the data, as given by its repl_req_ctx. Caller has to
+    /// make sure the data is not freed on the peer while it is read. Data written by this replica is not hedged.
+    /// @param sgs Scatter gather buffer list to which blkids are to be read into
+    /// @param size Total size of the data read
+    /// @return A Future with std::error_code to notify if it has successfully read the data or any error code in case
+    /// of failure
+    virtual folly::Future< std::error_code > async_hedged_read(MultiBlkId const& blkid, RemoteBlkId const& peer_blkid,
+                                                               sisl::sg_list& sgs, uint32_t size) {
+        return async_read(blkid, sgs, size);
+    }
+
     /// @brief After data is replicated and on_commit to the listener is called. the blkids can be freed.
     ///
     /// @param lsn - LSN of the old blkids that is being freed
@@ -434,6 +576,26 @@ public:
     /// @brief get the leader replica_id of given group
     virtual replica_id_t get_leader_id() const = 0;
 
+    /// @brief Waits until this replica has committed every entry committed in the replica set before the call, so
+    /// that a read served locally after it is linearizable, on a follower as much as on the leader.
+    ///
+    /// On the leader it completes right away, relying on the leader stepping down once it can't reach the quorum for
+    /// leadership_expiry_ms. On a follower it asks the leader for its commit lsn and waits to commit upto it.
+    ///
+    /// @return A Future with the lsn the replica has committed upto, or NOT_LEADER if there is no leader to ask and
+    /// TIMEOUT if it is not committed upto the leader in consensus.read_index_timeout_ms
+    virtual AsyncReplResult< repl_lsn_t > read_index() = 0;
+
+    /// @brief Checks if this replica is a witness of the replica set, which replicates and votes on the log, but
+    /// does not store the data of the entries. Listener of a witness gets an invalid blkid on commit of the entries.
+    virtual bool is_witness() const { return false; }
+
+    /// @brief Promotes this witness replica to a full member, which stores the data of the entries from now on. Data
+    /// of the entries committed while it was a witness is not in this replica and is not fetched by the promotion,
+    /// the listener is to resync it as for a new member, since it got those entries with an invalid blkid.
+    /// @return OK if promoted, or NOT_IMPLEMENTED if the replica set does not support witnesses
+    virtual ReplServiceError promote_witness() { return ReplServiceError::NOT_IMPLEMENTED; }
+
     /// @brief get replication status. If called on follower member
     /// this API can return empty result.
     virtual std::vector< peer_info > get_replication_status() const = 0;
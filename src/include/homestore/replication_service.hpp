@@ -13,6 +13,7 @@ namespace homestore {
 class ReplDev;
 class ReplDevListener;
 struct hs_stats;
+struct repl_req_trace;
 
 VENUM(repl_impl_type, uint8_t,
       server_side,     // Completely homestore controlled replication
@@ -79,6 +80,14 @@ public:
 
     // Get the current application/server repl uuid
     virtual replica_id_t get_my_repl_id() const = 0;
+
+    // Is this replica to be a witness of the group, which has the raft log of the group and votes on it, but does not
+    // store its data and never stays as its leader. It is asked once, when the repl dev of the group is created here.
+    virtual bool is_witness(group_id_t group_id) const { return false; }
+
+    // Called on the commit of each request sampled with consensus.repl_req_trace_sample_rate, with the time it reached
+    // each stage on this replica. Its repl_key ties it with the trace of the same request on the other replicas.
+    virtual void on_repl_req_trace(group_id_t group_id, repl_req_trace const& trace) const {}
 };
 
 } // namespace homestore
@@ -14,8 +14,11 @@
  *
  *********************************************************************************/
 #pragma once
+#include <algorithm>
 #include <atomic>
+#include <cstring>
 #include <string>
+#include <vector>
 
 #include <nlohmann/json.hpp>
 #include <sisl/fds/buffer.hpp>
@@ -40,7 +43,9 @@ public:
             m_meta_blk(rhs.m_meta_blk),
             m_raw_buf(std::move(rhs.m_raw_buf)),
             m_sb(rhs.m_sb),
-            m_meta_sub_name(std::move(rhs.m_meta_sub_name)) {
+            m_meta_sub_name(std::move(rhs.m_meta_sub_name)),
+            m_delta_write(rhs.m_delta_write),
+            m_persisted_buf(std::move(rhs.m_persisted_buf)) {
         rhs.m_meta_blk = nullptr;
         rhs.m_sb = nullptr;
     }
@@ -51,6 +56,8 @@ public:
             m_raw_buf = std::move(rhs.m_raw_buf);
             m_sb = rhs.m_sb;
             m_meta_sub_name = std::move(rhs.m_meta_sub_name);
+            m_delta_write = rhs.m_delta_write;
+            m_persisted_buf = std::move(rhs.m_persisted_buf);
             rhs.m_meta_blk = nullptr;
             rhs.m_sb = nullptr;
         }
@@ -67,6 +74,7 @@ public:
 
     T* load(const sisl::byte_view& buf, void* meta_blk) {
         m_meta_blk = voidptr_cast(meta_blk);
+        m_persisted_buf.reset();
         m_raw_buf = meta_service().is_aligned_buf_needed(buf.size()) ? buf.extract(meta_service().align_size())
                                                                      : buf.extract(0);
         m_sb = r_cast< T* >(m_raw_buf->bytes());
@@ -101,18 +109,65 @@ public:
             m_meta_blk = nullptr;
         }
         m_raw_buf.reset();
+        m_persisted_buf.reset();
         m_sb = nullptr;
     }
 
     uint32_t size() const { return m_raw_buf->size(); }
     sisl::byte_array raw_buf() { return m_raw_buf; }
 
+    // In delta write mode, a copy of the content last written is kept, so that write() rewrites only the pages which
+    // changed since. Meant for large superblks which are updated a few bytes at a time.
+    void set_delta_write(bool delta_write) {
+        m_delta_write = delta_write;
+        m_persisted_buf.reset();
+    }
+
     void write() {
         if (m_meta_blk) {
-            meta_service().update_sub_sb(m_raw_buf->cbytes(), m_raw_buf->size(), m_meta_blk);
+            if (m_delta_write && m_persisted_buf && (m_persisted_buf->size() == m_raw_buf->size())) {
+                auto const dirty_pages = changed_pages();
+                if (dirty_pages.empty()) { return; }
+                meta_service().update_sub_sb_delta(m_raw_buf->cbytes(), m_raw_buf->size(), m_meta_blk, dirty_pages);
+            } else {
+                meta_service().update_sub_sb(m_raw_buf->cbytes(), m_raw_buf->size(), m_meta_blk);
+            }
         } else {
             meta_service().add_sub_sb(m_meta_sub_name, m_raw_buf->cbytes(), m_raw_buf->size(), m_meta_blk);
         }
+        save_persisted();
+    }
+
+    // Writes the superblk without blocking, content is copied before returning. Superblk which isn't added yet is
+    // added synchronously.
+    folly::Future< bool > async_write() {
+        m_persisted_buf.reset();
+        if (m_meta_blk) {
+            return meta_service().async_update_sub_sb(m_raw_buf->cbytes(), m_raw_buf->size(), m_meta_blk);
+        }
+        write();
+        return folly::makeFuture< bool >(true);
+    }
+
+    // Writes the superblk with the next flush of the deferred updates, together with the other superblks deferred in
+    // the meantime. Content is copied before returning. Superblk which isn't added yet is added synchronously.
+    folly::Future< bool > deferred_write() {
+        m_persisted_buf.reset();
+        if (m_meta_blk) {
+            return meta_service().defer_update_sub_sb(m_raw_buf->cbytes(), m_raw_buf->size(), m_meta_blk);
+        }
+        write();
+        return folly::makeFuture< bool >(true);
+    }
+
+    // Stages the write in the batch, superblk has to stay in place till the batch is committed
+    void write(MetaBlkBatch& batch) {
+        m_persisted_buf.reset();
+        if (m_meta_blk) {
+            batch.update_sub_sb(m_raw_buf->cbytes(), m_raw_buf->size(), m_meta_blk);
+        } else {
+            batch.add_sub_sb(m_meta_sub_name, m_raw_buf->cbytes(), m_raw_buf->size(), m_meta_blk);
+        }
     }
 
     bool is_empty() const { return (m_sb == nullptr); }
@@ -124,11 +179,34 @@ public:
     std::string name() const { return m_meta_sub_name; }
     void* meta_blk() const { return m_meta_blk; }
 
+private:
+    std::vector< uint64_t > changed_pages() const {
+        std::vector< uint64_t > pages;
+        auto const page_sz = meta_service().block_size();
+        for (uint64_t off{0}; off < m_raw_buf->size(); off += page_sz) {
+            auto const len = std::min(uint64_cast(page_sz), m_raw_buf->size() - off);
+            if (std::memcmp(m_raw_buf->cbytes() + off, m_persisted_buf->cbytes() + off, len) != 0) {
+                pages.push_back(off / page_sz);
+            }
+        }
+        return pages;
+    }
+
+    void save_persisted() {
+        if (!m_delta_write) { return; }
+        if (!m_persisted_buf || (m_persisted_buf->size() != m_raw_buf->size())) {
+            m_persisted_buf = sisl::make_byte_array(m_raw_buf->size(), 0, sisl::buftag::metablk);
+        }
+        std::memcpy(m_persisted_buf->bytes(), m_raw_buf->cbytes(), m_raw_buf->size());
+    }
+
 private:
     void* m_meta_blk{nullptr};
     sisl::byte_array m_raw_buf;
     T* m_sb{nullptr};
     std::string m_meta_sub_name;
+    bool m_delta_write{false};
+    sisl::byte_array m_persisted_buf; // Content last written, kept in delta write mode
 };
 
 class json_superblk {
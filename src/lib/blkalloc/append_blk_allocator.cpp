@@ -21,40 +21,67 @@
 
 namespace homestore {
 
-AppendBlkAllocator::AppendBlkAllocator(const BlkAllocConfig& cfg, bool need_format, allocator_id_t id) :
+AppendBlkAllocator::AppendBlkAllocator(const BlkAllocConfig& cfg, bool need_format, allocator_id_t id,
+                                       std::string const& vdev_sb_name) :
         BlkAllocator{cfg, id} {
-    // TODO: try to make all append_blk_allocator instances use same client type to reduce metablk's cache footprint;
+    // Allocators of older versions persisted their own superblk, keep the handler to recover and migrate them to the
+    // vdev superblk. Both are found if we crashed before the legacy one was removed, in which case the vdev superblk
+    // has to be recovered first, for the legacy one to be ignored.
     meta_service().register_handler(
         get_name(),
         [this](meta_blk* mblk, sisl::byte_view buf, size_t size) { on_meta_blk_found(std::move(buf), (void*)mblk); },
-        nullptr);
+        nullptr, true /* do_crc */,
+        vdev_sb_name.empty() ? std::nullopt : std::optional< meta_subtype_vec_t >{{vdev_sb_name}});
 
     if (need_format) {
         m_freeable_nblks = 0;
         m_last_append_offset = 0;
         m_commit_offset = 0;
     }
+    m_legacy_sb.set_name(get_name());
 
-    // for both fresh start and recovery, firstly init m_sb fields;
-    m_sb.create(sizeof(append_blk_sb_t));
-    m_sb.set_name(get_name());
-    m_sb->allocator_id = id;
-    m_sb->commit_offset = m_last_append_offset;
-    m_sb->freeable_nblks = m_freeable_nblks;
-
-    // for recovery boot, fields will also be recovered from metablks;
+    // for recovery boot, fields will be recovered from vdev superblk or legacy metablk;
 }
 
 void AppendBlkAllocator::on_meta_blk_found(const sisl::byte_view& buf, void* meta_cookie) {
-    m_sb.load(buf, meta_cookie);
+    m_legacy_sb.load(buf, meta_cookie);
+
+    HS_REL_ASSERT_EQ(m_legacy_sb->magic, append_blkalloc_sb_magic, "Invalid AppendBlkAlloc metablk, magic mismatch");
+    HS_REL_ASSERT_EQ(m_legacy_sb->version, append_blkalloc_sb_version,
+                     "Invalid version of AppendBlkAllocator metablk");
+
+    // If vdev superblk is already written, legacy one is stale and left only because we crashed before removing it
+    if (!m_recovered_from_vdev_sb) { recover_from(*m_legacy_sb); }
+
+    // Make sure next cp migrates this allocator to vdev superblk
+    m_is_dirty.store(true);
+}
 
-    HS_REL_ASSERT_EQ(m_sb->magic, append_blkalloc_sb_magic, "Invalid AppendBlkAlloc metablk, magic mismatch");
-    HS_REL_ASSERT_EQ(m_sb->version, append_blkalloc_sb_version, "Invalid version of AppendBlkAllocator metablk");
+void AppendBlkAllocator::load_sb(append_blk_sb_t const& sb) {
+    HS_REL_ASSERT_EQ(sb.magic, append_blkalloc_sb_magic, "Invalid AppendBlkAlloc superblk entry, magic mismatch");
+    HS_REL_ASSERT_EQ(sb.version, append_blkalloc_sb_version, "Invalid version of AppendBlkAllocator superblk entry");
+    recover_from(sb);
+    m_recovered_from_vdev_sb = true;
+}
 
+void AppendBlkAllocator::recover_from(append_blk_sb_t const& sb) {
     // recover in-memory counter/offset from metablk;
-    m_last_append_offset.store(m_sb->commit_offset);
-    m_commit_offset.store(m_sb->commit_offset);
-    m_freeable_nblks.store(m_sb->freeable_nblks);
+    m_last_append_offset.store(sb.commit_offset);
+    m_commit_offset.store(sb.commit_offset);
+    m_sb_commit_offset.store(sb.commit_offset);
+    m_freeable_nblks.store(sb.freeable_nblks);
+}
+
+void AppendBlkAllocator::fill_sb(append_blk_sb_t& sb) {
+    sb = append_blk_sb_t{};
+    sb.allocator_id = m_chunk_id;
+    sb.commit_offset = m_commit_offset.load();
+    sb.freeable_nblks = m_freeable_nblks.load();
+    m_sb_commit_offset.store(sb.commit_offset);
+}
+
+void AppendBlkAllocator::on_sb_persisted() {
+    if (!m_legacy_sb.is_empty()) { m_legacy_sb.destroy(); }
 }
 
 //
@@ -67,19 +94,28 @@ BlkAllocStatus AppendBlkAllocator::alloc_contiguous(BlkId& bid) { return alloc(1
 // If we want to change above design, we can open this api for vector allocation;
 //
 BlkAllocStatus AppendBlkAllocator::alloc(blk_count_t nblks, const blk_alloc_hints& hint, BlkId& out_bid) {
-    if (available_blks() < nblks) {
-        // COUNTER_INCREMENT(m_metrics, num_alloc_failure, 1);
-        LOGERROR("No space left to serve request nblks: {}, available_blks: {}", nblks, available_blks());
-        return BlkAllocStatus::SPACE_FULL;
-    } else if (nblks > max_blks_per_blkid()) {
+    if (nblks > max_blks_per_blkid()) {
         // consumer(vdev) already handles this case.
         // COUNTER_INCREMENT(m_metrics, num_alloc_failure, 1);
         LOGERROR("Can't serve request nblks: {} larger than max_blks_in_op: {}", nblks, max_blks_per_blkid());
         return BlkAllocStatus::FAILED;
     }
 
+    // Space check and the bump of offset has to be one atomic step, otherwise concurrent allocs could go past the end
+    if (is_sealed()) { return BlkAllocStatus::SPACE_FULL; }
+
+    auto cur_offset = m_last_append_offset.load(std::memory_order_relaxed);
+    do {
+        if (get_total_blks() - cur_offset < nblks) {
+            // COUNTER_INCREMENT(m_metrics, num_alloc_failure, 1);
+            LOGERROR("No space left to serve request nblks: {}, available_blks: {}", nblks,
+                     get_total_blks() - cur_offset);
+            return BlkAllocStatus::SPACE_FULL;
+        }
+    } while (!m_last_append_offset.compare_exchange_weak(cur_offset, cur_offset + nblks, std::memory_order_acq_rel));
+
     // Push 1 blk to the vector which has all the requested nblks;
-    out_bid = BlkId{m_last_append_offset.fetch_add(nblks), nblks, m_chunk_id};
+    out_bid = BlkId{cur_offset, nblks, m_chunk_id};
 
     // COUNTER_INCREMENT(m_metrics, num_alloc, 1);
 
@@ -116,17 +152,6 @@ BlkAllocStatus AppendBlkAllocator::reserve_on_cache(BlkId const& blkid) {
     return BlkAllocStatus::SUCCESS;
 }
 
-void AppendBlkAllocator::cp_flush(CP* cp) {
-    // check if current cp's context has dirty buffer already
-    if (m_is_dirty.exchange(false)) {
-        m_sb->commit_offset = m_commit_offset.load();
-        m_sb->freeable_nblks = m_freeable_nblks.load();
-
-        // write to metablk;
-        m_sb.write();
-    }
-}
-
 //
 // free operation does:
 // 1. book keeping "total freeable" space
@@ -152,18 +177,28 @@ void AppendBlkAllocator::free(const BlkId& bid) {
         // Freeing something in the middle, increment the count
         m_freeable_nblks.fetch_add(bid.blk_count());
     } else {
-        m_commit_offset.store(m_last_append_offset.load());
+        // Pull back the commit offset to the new end, unless it is already behind it
+        auto cur_commit_offset = m_commit_offset.load();
+        while ((cur_commit_offset > new_last_offset) &&
+               !m_commit_offset.compare_exchange_weak(cur_commit_offset, new_last_offset)) {}
     }
     m_is_dirty.store(true);
 }
 
+void AppendBlkAllocator::reset() {
+    m_last_append_offset.store(0);
+    m_commit_offset.store(0);
+    m_freeable_nblks.store(0);
+    m_is_dirty.store(true);
+}
+
 bool AppendBlkAllocator::is_blk_alloced(const BlkId& in_bid, bool) const {
     // blk_num starts from 0;
     return in_bid.blk_num() < get_used_blks();
 }
 
 bool AppendBlkAllocator::is_blk_alloced_on_disk(BlkId const& bid, bool) const {
-    return bid.blk_num() < m_sb->commit_offset;
+    return bid.blk_num() < m_sb_commit_offset.load(std::memory_order_relaxed);
 }
 
 std::string AppendBlkAllocator::get_name() const { return "AppendBlkAlloc_chunk_" + std::to_string(m_chunk_id); }
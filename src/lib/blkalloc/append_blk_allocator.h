@@ -28,6 +28,9 @@ namespace homestore {
 static constexpr uint64_t append_blkalloc_sb_magic{0xd0d0d02b};
 static constexpr uint64_t append_blkalloc_sb_version{0x1};
 
+static constexpr uint64_t append_blkalloc_vdev_sb_magic{0xd0d0d02c};
+static constexpr uint32_t append_blkalloc_vdev_sb_version{0x1};
+
 #pragma pack(1)
 struct append_blk_sb_t {
     uint64_t magic{append_blkalloc_sb_magic};
@@ -36,6 +39,18 @@ struct append_blk_sb_t {
     blk_num_t freeable_nblks;
     blk_num_t commit_offset;
 };
+
+// Single superblk for all append blk allocators of a vdev, written once per CP if any of them is dirty. Each
+// allocator used to have its own superblk, which is now only read on recovery and removed after migrating here.
+struct append_blk_vdev_sb_t {
+    uint64_t magic{append_blkalloc_vdev_sb_magic};
+    uint32_t version{append_blkalloc_vdev_sb_version};
+    uint32_t num_chunks{0};
+
+    static uint32_t size(uint32_t nchunks) { return sizeof(append_blk_vdev_sb_t) + nchunks * sizeof(append_blk_sb_t); }
+    append_blk_sb_t* chunk_sbs() { return r_cast< append_blk_sb_t* >(this + 1); }
+    append_blk_sb_t const* chunk_sbs() const { return r_cast< append_blk_sb_t const* >(this + 1); }
+};
 #pragma pack()
 
 //class AppendBlkAllocMetrics : public sisl::MetricsGroup {
@@ -66,7 +81,8 @@ struct append_blk_sb_t {
 //
 class AppendBlkAllocator : public BlkAllocator {
 public:
-    AppendBlkAllocator(const BlkAllocConfig& cfg, bool need_format, allocator_id_t id = 0);
+    AppendBlkAllocator(const BlkAllocConfig& cfg, bool need_format, allocator_id_t id = 0,
+                       std::string const& vdev_sb_name = "");
 
     AppendBlkAllocator(const AppendBlkAllocator&) = delete;
     AppendBlkAllocator(AppendBlkAllocator&&) noexcept = delete;
@@ -100,6 +116,20 @@ public:
      */
     blk_num_t get_defrag_nblks() const;
 
+    /**
+     * @brief : stops any new allocation on this allocator, as if it is full, till unseal() is called. Frees are still
+     * served. Used by compaction to keep the chunk from growing while its live data is moved out.
+     */
+    void seal() { m_is_sealed.store(true); }
+    void unseal() { m_is_sealed.store(false); }
+    bool is_sealed() const { return m_is_sealed.load(); }
+
+    /**
+     * @brief : drops all the blks of this allocator and starts appending from the beginning again. It is expected
+     * that none of the earlier allocated blks are referenced anymore.
+     */
+    void reset();
+
     /**
      * @brief : check if the input blk id is allocated or not.
      * @return : true if blkid is allocated, false if not;
@@ -108,21 +138,55 @@ public:
 
     std::string to_string() const override;
 
-    void cp_flush(CP* cp) override;
+    /**
+     * @brief : superblk of all append blk allocators of a vdev is persisted by VirtualDev in one meta write, through
+     * test_and_clear_dirty() and fill_sb(), so there is nothing to flush here.
+     */
+    void cp_flush(CP* cp) override {}
     void recovery_completed() override {}
     nlohmann::json get_status(int log_level) const override;
 
+    /**
+     * @brief : checks if the allocator state has changed since it was last captured and clears it, so that any change
+     * after this call is captured in the next cp.
+     */
+    bool test_and_clear_dirty() { return m_is_dirty.exchange(false); }
+
+    /**
+     * @brief : captures the current persistent state of this allocator to be written as part of the vdev superblk
+     */
+    void fill_sb(append_blk_sb_t& sb);
+
+    /**
+     * @brief : recovers the state of this allocator from its entry of the vdev superblk
+     */
+    void load_sb(append_blk_sb_t const& sb);
+
+    /**
+     * @brief : called once the vdev superblk including this allocator is written, to remove the legacy superblk
+     */
+    void on_sb_persisted();
+
+    /**
+     * @brief : whether the superblk of an older version is still around, till the vdev superblk replaces it
+     */
+    bool has_legacy_sb() const { return !m_legacy_sb.is_empty(); }
+
 private:
     std::string get_name() const;
     void on_meta_blk_found(const sisl::byte_view& buf, void* meta_cookie);
+    void recover_from(append_blk_sb_t const& sb);
 
 private:
     std::atomic< blk_num_t > m_last_append_offset{0}; // last appended offset in blocks in memory
     std::atomic< blk_num_t > m_freeable_nblks{0};     // count of blks fragmentedly freed (both on-disk and in-memory)
     std::atomic< blk_num_t > m_commit_offset{0};      // offset in on-disk version
+    std::atomic< blk_num_t > m_sb_commit_offset{0};   // commit offset as of last persisted superblk
     std::atomic< bool > m_is_dirty{false};
+    std::atomic< bool > m_is_sealed{false};
+    bool m_recovered_from_vdev_sb{false};
     //AppendBlkAllocMetrics m_metrics;
-    superblk< append_blk_sb_t > m_sb; // only cp will be writing to this disk
+    superblk< append_blk_sb_t > m_legacy_sb; // per allocator superblk of older versions, only read during recovery
 };
 
 } // namespace homestore
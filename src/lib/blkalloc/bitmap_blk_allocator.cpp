@@ -42,30 +42,185 @@ BitmapBlkAllocator::BitmapBlkAllocator(BlkAllocConfig const& cfg, bool is_fresh,
     for (blk_num_t index{0}; index < get_num_portions(); ++index) {
         m_blk_portions[index].set_portion_num(index);
     }
+
+    if (is_persistent()) {
+        // Segments are made of whole portions, so that a segment can be encoded under the locks of its portions
+        auto const seg_blks = sisl::round_up(
+            uint64_cast(std::max(HS_DYNAMIC_CONFIG(blkallocator.disk_bitmap_segment_size_kb), 1u)) * 1024 * 8,
+            uint64_cast(m_blks_per_portion));
+        m_blks_per_segment = s_cast< blk_num_t >(
+            std::min(seg_blks, sisl::round_up(uint64_cast(m_num_blks), uint64_cast(m_blks_per_portion))));
+        m_dirty_segments = std::make_unique< std::atomic< bool >[] >(get_num_segments());
+        m_segment_cookies.resize(get_num_segments(), nullptr);
+        if (is_fresh) { mark_all_segments_dirty(); }
+
+        // Meta service recovers the sub types in their name order, so legacy bitmap is always found before segments
+        meta_service().register_handler(
+            get_name() + "_bm_segment",
+            [this](meta_blk* mblk, sisl::byte_view buf, size_t size) {
+                on_segment_found(voidptr_cast(mblk), std::move(buf), size);
+            },
+            [this](bool success) {
+                if (success) { on_segments_recovered(); }
+            });
+    }
 }
 
 void BitmapBlkAllocator::on_meta_blk_found(void* mblk_cookie, sisl::byte_view const& buf, size_t size) {
+    // Bitmap persisted as a whole by an older version, which gets migrated to segments on the next cp
     m_meta_blk_cookie = mblk_cookie;
 
     m_disk_bm = std::unique_ptr< sisl::Bitset >{new sisl::Bitset{
         hs_utils::extract_byte_array(buf, meta_service().is_aligned_buf_needed(size), meta_service().align_size())}};
+    mark_all_segments_dirty();
+}
+
+void BitmapBlkAllocator::on_segment_found(void* mblk_cookie, sisl::byte_view const& buf, size_t size) {
+    auto const seg = r_cast< disk_bm_segment_t const* >(buf.bytes());
+    BLKALLOC_REL_ASSERT((size >= sizeof(disk_bm_segment_t)) && (seg->magic == disk_bm_segment_magic) &&
+                            (seg->version == disk_bm_segment_version),
+                        "Invalid disk bitmap segment of size={}", size);
+    BLKALLOC_REL_ASSERT((size >= disk_bm_segment_t::size(seg->payload_size)) && (seg->total_blks == m_num_blks) &&
+                            (seg->start_blk + seg->nblks <= m_num_blks),
+                        "Disk bitmap segment start_blk={} nblks={} of size={} doesn't match the allocator",
+                        seg->start_blk, seg->nblks, size);
+    m_found_segments.emplace_back(mblk_cookie, buf);
+}
+
+void BitmapBlkAllocator::on_segments_recovered() {
+    if (!m_meta_blk_cookie && m_found_segments.empty()) { return; }
+    if (!m_disk_bm) { m_disk_bm = std::make_unique< sisl::Bitset >(m_num_blks, m_chunk_id, m_align_size); }
+
+    // Segments could overlap only if the segment size has changed, in which case the latest persisted one wins
+    std::sort(m_found_segments.begin(), m_found_segments.end(), [](auto const& a, auto const& b) {
+        return r_cast< disk_bm_segment_t const* >(a.second.bytes())->cp_gen <
+            r_cast< disk_bm_segment_t const* >(b.second.bytes())->cp_gen;
+    });
+    for (auto const& [cookie, buf] : m_found_segments) {
+        apply_segment(cookie, r_cast< disk_bm_segment_t const* >(buf.bytes()));
+    }
+    BLKALLOC_LOG(INFO, "Recovered disk bitmap from {} segments, legacy bitmap={}, stale segments={}",
+                 m_found_segments.size(), (m_meta_blk_cookie != nullptr), m_stale_segment_cookies.size());
+    m_found_segments.clear();
 
     m_alloced_blk_count.store(m_disk_bm->get_set_count(), std::memory_order_relaxed);
     load();
 }
 
+void BitmapBlkAllocator::apply_segment(void* mblk_cookie, disk_bm_segment_t const* seg) {
+    // Segment holds the full state of its range, overriding whatever an older segment or the legacy bitmap had
+    m_disk_bm->reset_bits(seg->start_blk, seg->nblks);
+    auto const is_valid =
+        BitmapRunCodec::decode(seg->encoding, seg->payload(), seg->payload_size, seg->nblks,
+                               [this, seg](uint64_t offset, uint64_t count) {
+                                   m_disk_bm->set_bits(seg->start_blk + offset, count);
+                               });
+    BLKALLOC_REL_ASSERT(is_valid, "Corrupted disk bitmap segment start_blk={} nblks={} encoding={}", seg->start_blk,
+                        seg->nblks, s_cast< int >(seg->encoding));
+    m_cp_gen = std::max(m_cp_gen, seg->cp_gen);
+
+    auto const seg_num = s_cast< blk_num_t >(seg->start_blk / m_blks_per_segment);
+    if (((seg->start_blk % m_blks_per_segment) == 0) && (seg->nblks == segment_nblks(seg_num))) {
+        if (m_segment_cookies[seg_num]) { m_stale_segment_cookies.push_back(m_segment_cookies[seg_num]); }
+        m_segment_cookies[seg_num] = mblk_cookie;
+    } else {
+        // Persisted with a different segment size, the segments it overlaps are rewritten in current layout
+        m_stale_segment_cookies.push_back(mblk_cookie);
+        mark_segments_dirty(seg->start_blk, seg->nblks);
+    }
+}
+
 void BitmapBlkAllocator::cp_flush(CP*) {
     if (!is_persistent()) { return; }
 
     if (m_is_disk_bm_dirty.load()) {
-        sisl::byte_array bitmap_buf = acquire_underlying_buffer();
-        if (m_meta_blk_cookie) {
-            meta_service().update_sub_sb(bitmap_buf->cbytes(), bitmap_buf->size(), m_meta_blk_cookie);
-        } else {
-            meta_service().add_sub_sb(get_name(), bitmap_buf->cbytes(), bitmap_buf->size(), m_meta_blk_cookie);
-        }
+        acquire_underlying_buffer();
         m_is_disk_bm_dirty.store(false); // No longer dirty now, needs to be set before releasing the buffer
+        ++m_cp_gen;
+
+        std::vector< BitmapRunCodec::bit_run > runs;
+        std::vector< uint8_t > payload;
+        blk_num_t num_persisted{0};
+        for (blk_num_t seg_num{0}; seg_num < get_num_segments(); ++seg_num) {
+            if (m_dirty_segments[seg_num].exchange(false)) {
+                persist_segment(seg_num, runs, payload);
+                cp_mgr().throttle_cp_flush(payload.size());
+                ++num_persisted;
+            }
+        }
         release_underlying_buffer();
+
+        // All of the ranges they cover are persisted in current segments by now
+        if (m_meta_blk_cookie) {
+            meta_service().remove_sub_sb(m_meta_blk_cookie);
+            m_meta_blk_cookie = nullptr;
+        }
+        for (auto cookie : m_stale_segment_cookies) {
+            meta_service().remove_sub_sb(cookie);
+        }
+        m_stale_segment_cookies.clear();
+        BLKALLOC_LOG(DEBUG, "Persisted {} of {} disk bitmap segments on cp_gen={}", num_persisted,
+                     get_num_segments(), m_cp_gen);
+    }
+}
+
+void BitmapBlkAllocator::persist_segment(blk_num_t seg_num, std::vector< BitmapRunCodec::bit_run >& runs,
+                                         std::vector< uint8_t >& payload) {
+    auto const start_blk = uint64_cast(seg_num) * m_blks_per_segment;
+    auto const end_blk = start_blk + segment_nblks(seg_num);
+
+    // Frees are applied to the disk bitmap directly even during cp, so collect the runs under the portion locks.
+    // Bounds of each search are checked upfront, so that it doesn't scan past the portion.
+    runs.clear();
+    for (auto p_start = start_blk; p_start < end_blk; p_start += m_blks_per_portion) {
+        auto const p_end = std::min(p_start + m_blks_per_portion, end_blk);
+        BlkAllocPortion& portion = blknum_to_portion(s_cast< blk_num_t >(p_start));
+        auto lock{portion.portion_auto_lock()};
+
+        for (auto b = p_start; (b < p_end) && !m_disk_bm->is_bits_reset(b, p_end - b);) {
+            auto const run_start = m_disk_bm->get_next_set_bit(b);
+            auto const run_end =
+                m_disk_bm->is_bits_set(run_start, p_end - run_start) ? p_end : m_disk_bm->get_next_reset_bit(run_start);
+            auto const offset = run_start - start_blk;
+            if (!runs.empty() && (runs.back().offset + runs.back().count == offset)) {
+                runs.back().count += run_end - run_start;
+            } else {
+                runs.push_back(BitmapRunCodec::bit_run{offset, run_end - run_start});
+            }
+            b = run_end;
+        }
+    }
+
+    auto const encoding = BitmapRunCodec::encode(runs, end_blk - start_blk, payload);
+    auto const size = disk_bm_segment_t::size(payload.size());
+    auto buf = hs_utils::make_byte_array(size, meta_service().is_aligned_buf_needed(size), sisl::buftag::metablk,
+                                         meta_service().align_size());
+    auto seg = new (buf->bytes()) disk_bm_segment_t();
+    seg->encoding = encoding;
+    seg->cp_gen = m_cp_gen;
+    seg->total_blks = m_num_blks;
+    seg->start_blk = start_blk;
+    seg->nblks = end_blk - start_blk;
+    seg->payload_size = payload.size();
+    std::copy(payload.begin(), payload.end(), seg->payload());
+
+    if (m_segment_cookies[seg_num]) {
+        meta_service().update_sub_sb(buf->cbytes(), size, m_segment_cookies[seg_num]);
+    } else {
+        meta_service().add_sub_sb(get_name() + "_bm_segment", buf->cbytes(), size, m_segment_cookies[seg_num]);
+    }
+}
+
+void BitmapBlkAllocator::mark_segments_dirty(uint64_t start_blk, uint64_t nblks) {
+    auto const last_seg = (start_blk + nblks - 1) / m_blks_per_segment;
+    for (auto seg_num = start_blk / m_blks_per_segment; seg_num <= last_seg; ++seg_num) {
+        m_dirty_segments[seg_num].store(true, std::memory_order_relaxed);
+    }
+}
+
+void BitmapBlkAllocator::mark_all_segments_dirty() {
+    for (blk_num_t seg_num{0}; seg_num < get_num_segments(); ++seg_num) {
+        m_dirty_segments[seg_num].store(true, std::memory_order_relaxed);
     }
 }
 
@@ -105,6 +260,7 @@ BlkAllocStatus BitmapBlkAllocator::reserve_on_disk(BlkId const& bid) {
                                         "Expected disk blks to reset");
                 }
                 m_disk_bm->set_bits(b.blk_num(), b.blk_count());
+                mark_segments_dirty(b.blk_num(), b.blk_count());
                 BLKALLOC_LOG(DEBUG, "blks allocated {} chunk number {}", b.to_string(), m_chunk_id);
             }
         };
@@ -135,6 +291,7 @@ void BitmapBlkAllocator::free_on_disk(BlkId const& bid) {
         {
             auto lock{portion.portion_auto_lock()};
             m_disk_bm->reset_bits(b.blk_num(), b.blk_count());
+            mark_segments_dirty(b.blk_num(), b.blk_count());
         }
     };
 
@@ -147,9 +304,17 @@ void BitmapBlkAllocator::free_on_disk(BlkId const& bid) {
     } else {
         unset_on_disk_bm(bid);
     }
+    m_is_disk_bm_dirty.store(true);
+}
+
+void BitmapBlkAllocator::free_on_disk_locked(BlkId const& b) {
+    DEBUG_ASSERT_EQ(is_persistent(), true, "free_on_disk called for non-persistent blk allocator");
+    m_disk_bm->reset_bits(b.blk_num(), b.blk_count());
+    mark_segments_dirty(b.blk_num(), b.blk_count());
+    m_is_disk_bm_dirty.store(true);
 }
 
-sisl::byte_array BitmapBlkAllocator::acquire_underlying_buffer() {
+void BitmapBlkAllocator::acquire_underlying_buffer() {
     // prepare and temporary alloc list, where blkalloc is accumulated till underlying buffer is released.
     // RCU will wait for all I/Os that are still in critical section (allocating on disk bm) to complete and exit;
     auto alloc_list_ptr = new sisl::ThreadVector< MultiBlkId >();
@@ -157,7 +322,6 @@ sisl::byte_array BitmapBlkAllocator::acquire_underlying_buffer() {
     synchronize_rcu();
 
     BLKALLOC_REL_ASSERT(old_alloc_list_ptr == nullptr, "Multiple acquires concurrently?");
-    return (m_disk_bm->serialize(m_align_size));
 }
 
 void BitmapBlkAllocator::release_underlying_buffer() {
@@ -14,8 +14,11 @@
  *********************************************************************************/
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <sstream>
@@ -35,15 +38,41 @@
 #include "common/homestore_assert.hpp"
 
 #include "blk_allocator.h"
+#include "bitmap_run_codec.h"
 
 namespace homestore {
 
+static constexpr uint64_t disk_bm_segment_magic{0xd0d0b175e6};
+static constexpr uint32_t disk_bm_segment_version{0x1};
+
+// A range of blks of the on disk bitmap, persisted run length encoded in its own meta blk
+#pragma pack(1)
+struct disk_bm_segment_t {
+    uint64_t magic{disk_bm_segment_magic};
+    uint32_t version{disk_bm_segment_version};
+    BitmapRunCodec::encoding_t encoding{BitmapRunCodec::encoding_t::runs};
+    uint64_t cp_gen{0}; // Generation of the cp which persisted it, a later one overrides an overlapping older one
+    uint64_t total_blks{0};
+    uint64_t start_blk{0};
+    uint64_t nblks{0};
+    uint64_t payload_size{0};
+
+    static uint64_t size(uint64_t payload_size) { return sizeof(disk_bm_segment_t) + payload_size; }
+    uint8_t* payload() { return r_cast< uint8_t* >(this + 1); }
+    uint8_t const* payload() const { return r_cast< uint8_t const* >(this + 1); }
+};
+#pragma pack()
+
 class BlkAllocPortion {
 private:
     mutable std::mutex m_blk_lock;
     blk_num_t m_portion_num;
     blk_temp_t m_temperature;
 
+    // Upper bound of the longest free run in this portion. It is lowered only by a scan under the portion lock and
+    // raised on every free, so that a portion is skipped only when it can't possibly satisfy a request.
+    std::atomic< blk_num_t > m_max_free_run{std::numeric_limits< blk_num_t >::max()};
+
 public:
     BlkAllocPortion(blk_temp_t temp = default_temperature()) : m_temperature(temp) {}
     ~BlkAllocPortion() = default;
@@ -59,6 +88,18 @@ public:
     void set_portion_num(blk_num_t portion_num) { m_portion_num = portion_num; }
     void set_temperature(const blk_temp_t temp) { m_temperature = temp; }
     static constexpr blk_temp_t default_temperature() { return 1; }
+
+    blk_num_t max_free_run() const { return m_max_free_run.load(std::memory_order_relaxed); }
+    bool may_have_free_run(blk_num_t nblks) const { return m_max_free_run.load(std::memory_order_relaxed) >= nblks; }
+    void set_max_free_run(blk_num_t max_run) { m_max_free_run.store(max_run, std::memory_order_relaxed); }
+
+    // Freed blks could join the runs on either side of it, each of which is no longer than the current bound
+    void on_blks_freed(blk_count_t nblks) {
+        auto const cur = static_cast< uint64_t >(m_max_free_run.load(std::memory_order_relaxed));
+        m_max_free_run.store(static_cast< blk_num_t >(std::min< uint64_t >(
+                                 (2 * cur) + nblks, std::numeric_limits< blk_num_t >::max())),
+                             std::memory_order_relaxed);
+    }
 };
 
 class CP;
@@ -103,16 +144,31 @@ public:
 protected:
     void free_on_disk(BlkId const& b);
 
+    // Frees a single blk on disk, whose portion lock is held by the caller
+    void free_on_disk_locked(BlkId const& b);
+
 private:
     void do_init();
     sisl::ThreadVector< MultiBlkId >* get_alloc_blk_list();
     void on_meta_blk_found(void* mblk_cookie, sisl::byte_view const& buf, size_t size);
+    void on_segment_found(void* mblk_cookie, sisl::byte_view const& buf, size_t size);
+    void on_segments_recovered();
 
-    // Acquire the underlying bitmap buffer and while the caller has acquired, all the new allocations
-    // will be captured in a separate list and then pushes into buffer once released.
+    blk_num_t get_num_segments() const { return (m_num_blks - 1) / m_blks_per_segment + 1; }
+    blk_num_t segment_nblks(blk_num_t seg_num) const {
+        return std::min(m_blks_per_segment, m_num_blks - (seg_num * m_blks_per_segment));
+    }
+    void mark_segments_dirty(uint64_t start_blk, uint64_t nblks);
+    void mark_all_segments_dirty();
+    void apply_segment(void* mblk_cookie, disk_bm_segment_t const* seg);
+    void persist_segment(blk_num_t seg_num, std::vector< BitmapRunCodec::bit_run >& runs,
+                         std::vector< uint8_t >& payload);
+
+    // Acquire the underlying bitmap and while the caller has acquired, all the new allocations will be captured in a
+    // separate list and then pushed into the bitmap once released.
     // NOTE: THIS IS NON-THREAD SAFE METHOD. Caller is expected to ensure synchronization between multiple
     // acquires/releases
-    sisl::byte_array acquire_underlying_buffer();
+    void acquire_underlying_buffer();
     void release_underlying_buffer();
 
 protected:
@@ -123,7 +179,14 @@ private:
     std::unique_ptr< BlkAllocPortion[] > m_blk_portions;
     std::unique_ptr< sisl::Bitset > m_disk_bm{nullptr};
     std::atomic< bool > m_is_disk_bm_dirty{true}; // initially disk_bm treated as dirty
-    void* m_meta_blk_cookie{nullptr};
+    void* m_meta_blk_cookie{nullptr};             // Legacy meta blk holding the whole bitmap, removed once migrated
+
+    blk_num_t m_blks_per_segment{0};
+    std::unique_ptr< std::atomic< bool >[] > m_dirty_segments;
+    std::vector< void* > m_segment_cookies;
+    std::vector< void* > m_stale_segment_cookies; // Meta blks superseded by the current segment layout
+    std::vector< std::pair< void*, sisl::byte_view > > m_found_segments; // Applied in cp_gen order once all are found
+    uint64_t m_cp_gen{0};
     std::atomic< int64_t > m_alloced_blk_count{0};
 };
 } // namespace homestore
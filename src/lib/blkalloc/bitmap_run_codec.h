@@ -0,0 +1,137 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+namespace homestore {
+
+/*
+ * Codec for a range of bits of the on disk bitmap, represented as the list of its runs of set bits. Runs are encoded
+ * as varint (LEB128) pairs of gap from the end of previous run and the run length, which for the mostly contiguous
+ * allocations of a blk allocator is a fraction of the raw bitmap. When the bitmap is too fragmented for the runs to
+ * be any smaller, the raw words are stored instead, so encoded size never exceeds the raw size.
+ */
+class BitmapRunCodec {
+public:
+    enum class encoding_t : uint8_t { runs = 0, raw = 1 };
+
+    struct bit_run {
+        uint64_t offset;
+        uint64_t count;
+    };
+    using run_cb_t = std::function< void(uint64_t offset, uint64_t count) >;
+
+    static uint64_t raw_size(uint64_t nbits) { return ((nbits + 63) / 64) * sizeof(uint64_t); }
+
+    // Runs are expected to be sorted, non overlapping, non empty and within [0, nbits)
+    static encoding_t encode(std::vector< bit_run > const& runs, uint64_t nbits, std::vector< uint8_t >& out) {
+        out.clear();
+        auto const max_size = raw_size(nbits);
+
+        uint64_t prev_end{0};
+        for (auto const& r : runs) {
+            put_varint(r.offset - prev_end, out);
+            put_varint(r.count, out);
+            prev_end = r.offset + r.count;
+            if (out.size() >= max_size) { break; }
+        }
+        if (out.size() < max_size) { return encoding_t::runs; }
+
+        out.assign(max_size, 0);
+        auto words = reinterpret_cast< uint64_t* >(out.data());
+        for (auto const& r : runs) {
+            for (auto b = r.offset; b < r.offset + r.count;) {
+                auto const shift = b % 64;
+                auto const n = std::min< uint64_t >(64 - shift, r.offset + r.count - b);
+                auto const mask = (n == 64) ? ~0ull : (((1ull << n) - 1) << shift);
+                words[b / 64] |= mask;
+                b += n;
+            }
+        }
+        return encoding_t::raw;
+    }
+
+    // Calls back for every run of set bits in the encoded buffer. Returns false if the buffer is malformed.
+    static bool decode(encoding_t enc, uint8_t const* buf, uint64_t size, uint64_t nbits, run_cb_t const& cb) {
+        if (enc == encoding_t::runs) {
+            uint64_t pos{0};
+            uint64_t prev_end{0};
+            while (pos < size) {
+                uint64_t gap, count;
+                if (!get_varint(buf, size, pos, gap) || !get_varint(buf, size, pos, count)) { return false; }
+                auto const offset = prev_end + gap;
+                if ((count == 0) || (offset + count > nbits)) { return false; }
+                cb(offset, count);
+                prev_end = offset + count;
+            }
+            return true;
+        }
+
+        if ((enc != encoding_t::raw) || (size != raw_size(nbits))) { return false; }
+        uint64_t run_start{0};
+        uint64_t run_count{0};
+        for (uint64_t w{0}; w < size / sizeof(uint64_t); ++w) {
+            uint64_t word;
+            std::memcpy(&word, buf + (w * sizeof(uint64_t)), sizeof(uint64_t));
+            for (uint64_t bit{0}; bit < 64;) {
+                auto const rest = word >> bit;
+                if (rest == 0) { break; }
+                auto const zeros = static_cast< uint64_t >(__builtin_ctzll(rest));
+                auto const ones_word = rest >> zeros;
+                auto const ones = (~ones_word == 0) ? (64 - bit - zeros)
+                                                    : static_cast< uint64_t >(__builtin_ctzll(~ones_word));
+                auto const offset = (w * 64) + bit + zeros;
+                if (offset + ones > nbits) { return false; }
+                if ((run_count != 0) && (run_start + run_count == offset)) {
+                    run_count += ones;
+                } else {
+                    if (run_count != 0) { cb(run_start, run_count); }
+                    run_start = offset;
+                    run_count = ones;
+                }
+                bit += zeros + ones;
+            }
+        }
+        if (run_count != 0) { cb(run_start, run_count); }
+        return true;
+    }
+
+private:
+    static void put_varint(uint64_t v, std::vector< uint8_t >& out) {
+        while (v >= 0x80) {
+            out.push_back(static_cast< uint8_t >(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast< uint8_t >(v));
+    }
+
+    static bool get_varint(uint8_t const* buf, uint64_t size, uint64_t& pos, uint64_t& v) {
+        v = 0;
+        for (uint32_t shift{0}; (pos < size) && (shift < 64); shift += 7) {
+            auto const byte = buf[pos++];
+            v |= (static_cast< uint64_t >(byte & 0x7f) << shift);
+            if ((byte & 0x80) == 0) { return true; }
+        }
+        return false;
+    }
+};
+
+} // namespace homestore
@@ -13,6 +13,8 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <algorithm>
+
 #include <homestore/blk.h>
 #include "common/homestore_assert.hpp"
 
@@ -99,6 +101,10 @@ uint32_t MultiBlkId::serialized_size() const {
 }
 
 void MultiBlkId::deserialize(sisl::blob const& b, bool copy) {
+    if (is_compact(b)) {
+        deserialize_compact(b);
+        return;
+    }
     MultiBlkId* other = r_cast< MultiBlkId const* >(b.cbytes());
     s = other->s;
     if (b.size() == sizeof(BlkId)) {
@@ -110,6 +116,103 @@ void MultiBlkId::deserialize(sisl::blob const& b, bool copy) {
     }
 }
 
+static uint8_t bytes_needed(uint64_t v) {
+    uint8_t n{1};
+    while ((n < sizeof(uint64_t)) && (v >> (8 * n)) != 0) {
+        ++n;
+    }
+    return n;
+}
+
+static uint8_t* put_le(uint8_t* p, uint64_t v, uint8_t width) {
+    for (uint8_t i{0}; i < width; ++i) {
+        *p++ = uint8_t(v >> (8 * i));
+    }
+    return p;
+}
+
+static uint64_t get_le(uint8_t const*& p, uint8_t width) {
+    uint64_t v{0};
+    for (uint8_t i{0}; i < width; ++i) {
+        v |= uint64_t(*p++) << (8 * i);
+    }
+    return v;
+}
+
+// Layout is the tag with the version, a byte with the number of pieces and the widths, the chunk number and then the
+// blk number and count of each piece, all little endian.
+MultiBlkId::compact_widths MultiBlkId::needed_compact_widths() const {
+    compact_widths w{.chunk_num = bytes_needed(chunk_num()), .blk_num = 1, .nblks = 1};
+    auto it = iterate();
+    while (auto const b = it.next()) {
+        w.blk_num = std::max(w.blk_num, bytes_needed(b->blk_num()));
+        w.nblks = std::max(w.nblks, bytes_needed(b->blk_count()));
+    }
+    return w;
+}
+
+uint32_t MultiBlkId::compact_serialized_size(uint16_t num_pieces, compact_widths const& widths) {
+    return 2 + ((num_pieces == 0) ? 0 : widths.chunk_num + (num_pieces * (widths.blk_num + widths.nblks)));
+}
+
+uint32_t MultiBlkId::compact_serialized_size(compact_widths const& min_widths) const {
+    auto w = needed_compact_widths();
+    w.blk_num = std::max(w.blk_num, min_widths.blk_num);
+    w.nblks = std::max(w.nblks, min_widths.nblks);
+    w.chunk_num = std::max(w.chunk_num, min_widths.chunk_num);
+    return compact_serialized_size(num_pieces(), w);
+}
+
+uint32_t MultiBlkId::serialize_compact(uint8_t* buf, compact_widths const& min_widths) const {
+    auto w = needed_compact_widths();
+    w.blk_num = std::max(w.blk_num, min_widths.blk_num);
+    w.nblks = std::max(w.nblks, min_widths.nblks);
+    w.chunk_num = std::max(w.chunk_num, min_widths.chunk_num);
+    HS_DBG_ASSERT((w.chunk_num <= 2) && (w.blk_num <= 4) && (w.nblks <= 2), "Invalid compact widths of blkid");
+
+    uint8_t* p = buf;
+    *p++ = s_compact_tag_base | (compact_version << 1);
+    *p++ = uint8_t(num_pieces() | ((w.chunk_num - 1) << 3) | ((w.blk_num - 1) << 4) | ((w.nblks - 1) << 6));
+    if (num_pieces() != 0) {
+        p = put_le(p, chunk_num(), w.chunk_num);
+        auto it = iterate();
+        while (auto const b = it.next()) {
+            p = put_le(p, b->blk_num(), w.blk_num);
+            p = put_le(p, b->blk_count(), w.nblks);
+        }
+    }
+    return uint32_cast(p - buf);
+}
+
+bool MultiBlkId::is_compact(sisl::blob const& b) {
+    return (b.size() >= 2) && ((b.cbytes()[0] & 0xF1) == s_compact_tag_base);
+}
+
+void MultiBlkId::deserialize_compact(sisl::blob const& b) {
+    uint8_t const* p = b.cbytes();
+    auto const version = uint8_t((*p++ & 0x0E) >> 1);
+    HS_REL_ASSERT_EQ(version, compact_version, "Unknown version of compact blkid encoding");
+
+    auto const hdr = *p++;
+    uint16_t const npieces = hdr & 0x07;
+    compact_widths const w{.chunk_num = uint8_t(((hdr >> 3) & 0x1) + 1),
+                           .blk_num = uint8_t(((hdr >> 4) & 0x3) + 1),
+                           .nblks = uint8_t(((hdr >> 6) & 0x1) + 1)};
+    HS_REL_ASSERT_LE(compact_serialized_size(npieces, w), b.size(), "Compact blkid encoding is truncated");
+
+    s = BlkId::serialized{};
+    s.m_is_multi = 1;
+    n_addln_piece = 0;
+    if (npieces == 0) { return; }
+
+    auto const cnum = chunk_num_t(get_le(p, w.chunk_num));
+    for (uint16_t i{0}; i < npieces; ++i) {
+        auto const blk_num = blk_num_t(get_le(p, w.blk_num));
+        auto const nblks = blk_count_t(get_le(p, w.nblks));
+        add(blk_num, nblks, cnum);
+    }
+}
+
 uint32_t MultiBlkId::expected_serialized_size(uint16_t num_pieces) {
     uint32_t sz = BlkId::expected_serialized_size();
     if (num_pieces > 1) { sz += sizeof(uint16_t) + ((num_pieces - 1) * sizeof(chain_blkid)); }
@@ -300,6 +300,24 @@ public:
 
     [[nodiscard]] virtual blk_num_t total_free_blks() const = 0;
 
+    /**
+     * @brief Samples the consumption rate of every slab in the cache since the last call.
+     *
+     * @return Least of the time in ms the slabs are predicted to run dry at their current rate, max if none of them is
+     * being drained.
+     */
+    [[nodiscard]] virtual uint64_t sample_ms_to_empty() = 0;
+
+    /**
+     * @brief Copies up to max_entries of the entries in the cache, larger slabs first, leaving the cache as is.
+     *
+     * @param out_entries Vector to which the copied entries are appended
+     * @param max_entries Max number of entries to copy
+     * @param excess_blks Entries which could not be put back to the cache while copying, which caller has to free
+     */
+    virtual void snapshot(std::vector< blk_cache_entry >& out_entries, const size_t max_entries,
+                          std::vector< blk_cache_entry >& excess_blks) = 0;
+
     [[nodiscard]] static slab_idx_t find_slab(const blk_count_t nblks) {
         if (sisl_unlikely(nblks >= slab_tbl_size)) {
             return s_cast< slab_idx_t >((nblks > 1) ? sisl::logBase2(s_cast< blk_count_t >(nblks - 1)) + 1 : 0);
@@ -13,7 +13,12 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <algorithm>
+#include <limits>
+#include <thread>
+
 #include "common/homestore_assert.hpp"
+#include "common/homestore_config.hpp"
 #include "varsize_blk_allocator.h"
 #include "blk_cache_queue.h"
 
@@ -109,7 +114,9 @@ blk_count_t FreeBlkCacheQueue::try_free_blks(const blk_cache_entry& entry,
 #endif
 
         e.set_blk_count(m_slab_queues[slab_idx]->get_slab_size());
-        if (!push_slab(slab_idx, e, false /* only_this_level */)) {
+        if (push_slab(slab_idx, e, false /* only_this_level */)) {
+            m_slab_queues[slab_idx]->record_consumption(-1);
+        } else {
             excess_blks.push_back(e);
             num_zombied += e.blk_count();
         }
@@ -214,11 +221,15 @@ BlkAllocStatus FreeBlkCacheQueue::try_alloc_in_slab(const slab_idx_t slab_idx, c
     for (blk_num_t i{0}; i < nentries; ++i) {
         blk_cache_entry e;
         if (const auto popped_level{pop_slab(slab_idx, req.preferred_level, false /* only_this_level */, e)}) {
+            m_slab_queues[slab_idx]->record_consumption(1);
             resp.out_blks.push_back(e);
             num_allocated += m_slab_queues[slab_idx]->slab_size();
 
-            // If we didn't get the level we requested for, its time to refill this slab
-            if (popped_level.value() != req.preferred_level) { resp.need_refill = true; }
+            // If we didn't get the temperature we requested for, its time to refill this slab. Level 0 holds only
+            // the reused blks, which are never refilled.
+            if ((req.preferred_level != 0) && (popped_level.value() != req.preferred_level)) {
+                resp.need_refill = true;
+            }
         } else {
             free_excess(num_allocated);
             return ((i == 0) && (num_allocated == 0)) ? BlkAllocStatus::FAILED : BlkAllocStatus::PARTIAL;
@@ -270,6 +281,23 @@ std::shared_ptr< blk_cache_fill_session > FreeBlkCacheQueue::create_cache_fill_s
     return ptr;
 }
 
+uint64_t FreeBlkCacheQueue::sample_ms_to_empty() {
+    uint64_t min_ms{std::numeric_limits< uint64_t >::max()};
+    for (auto& sq : m_slab_queues) {
+        sq->sample_consumption();
+        min_ms = std::min(min_ms, sq->predicted_ms_to_empty());
+    }
+    return min_ms;
+}
+
+void FreeBlkCacheQueue::snapshot(std::vector< blk_cache_entry >& out_entries, const size_t max_entries,
+                                 std::vector< blk_cache_entry >& excess_blks) {
+    // Larger entries are worth more to have ready after restart, since they are the costliest to sweep for
+    for (auto it{m_slab_queues.rbegin()}; (it != m_slab_queues.rend()) && (out_entries.size() < max_entries); ++it) {
+        (*it)->snapshot(out_entries, max_entries, excess_blks);
+    }
+}
+
 void FreeBlkCacheQueue::close_cache_fill_session(blk_cache_fill_session& fill_session) {
     for (auto& sq : m_slab_queues) {
         sq->close_session(fill_session.session_id);
@@ -306,11 +334,101 @@ SlabCacheQueue::SlabCacheQueue(const blk_count_t slab_size, const std::vector< b
     }
     m_refill_threshold_limits = (static_cast< uint64_t >(m_total_capacity) * refill_pct) / 100;
     GAUGE_UPDATE(m_metrics, slab_total_entries, m_total_capacity);
+
+    // Magazines should not hoard more than a fraction of the slab, otherwise a thread could starve others of the
+    // entries, which are reachable to them only through stealing.
+    const uint32_t num_magazines{std::max(std::thread::hardware_concurrency(), 1u)};
+    m_magazine_size = std::min< uint32_t >(HS_DYNAMIC_CONFIG(blkallocator.free_blk_cache_magazine_size),
+                                           m_total_capacity / (num_magazines * 4));
+    if (m_magazine_size >= 2) {
+        m_magazines.reserve(num_magazines);
+        for (uint32_t i{0}; i < num_magazines; ++i) {
+            auto mag{std::make_unique< blk_magazine >()};
+            mag->entries.reserve(m_magazine_size);
+            m_magazines.push_back(std::move(mag));
+        }
+    } else {
+        m_magazine_size = 0;
+    }
+}
+
+SlabCacheQueue::blk_magazine* SlabCacheQueue::this_thread_magazine() {
+    static std::atomic< uint32_t > s_next_slot{0};
+    thread_local uint32_t t_slot{s_next_slot.fetch_add(1, std::memory_order_relaxed)};
+    return m_magazines.empty() ? nullptr : m_magazines[t_slot % m_magazines.size()].get();
 }
 
 std::optional< blk_temp_t > SlabCacheQueue::push(const blk_cache_entry& entry, const bool only_this_level) {
-    const blk_temp_t start_level{static_cast< blk_temp_t >(
-        (entry.get_temperature() >= m_level_queues.size()) ? m_level_queues.size() - 1 : entry.get_temperature())};
+    // Refill of a specific level has to land on the shared queues, so that its temperature is honored
+    auto mag{only_this_level ? nullptr : this_thread_magazine()};
+    if (mag == nullptr) { return push_global(entry, only_this_level); }
+
+    std::unique_lock lg{mag->mtx};
+    // Entry can be held locally only against a slot this magazine pulled from the shared queues, so that the cache
+    // as a whole never holds more than its capacity. Rest of them spill over to the shared queues.
+    std::optional< blk_temp_t > ret;
+    if (mag->entries.size() < mag->credits) {
+        mag->entries.push_back(entry);
+        ret = level_of(entry.get_temperature());
+    } else {
+        ret = push_global(entry, false /* only_this_level */);
+    }
+    mag->count.store(static_cast< uint32_t >(mag->entries.size()), std::memory_order_relaxed);
+    return ret;
+}
+
+std::optional< blk_temp_t > SlabCacheQueue::pop(const blk_temp_t input_level, const bool only_this_level,
+                                                blk_cache_entry& out_entry) {
+    const blk_temp_t start_level{level_of(input_level)};
+
+    auto mag{only_this_level ? nullptr : this_thread_magazine()};
+    if (mag == nullptr) {
+        if (only_this_level) {
+            return m_level_queues[start_level]->read(out_entry) ? std::optional< blk_temp_t >{start_level}
+                                                                : std::nullopt;
+        }
+        return pop_global(start_level, out_entry);
+    }
+
+    // Magazine holds entries of all temperatures freed on this thread, serve only the ones of asked temperature
+    std::unique_lock lg{mag->mtx};
+    auto it = std::find_if(mag->entries.rbegin(), mag->entries.rend(), [this, start_level](auto const& e) {
+        return level_of(e.get_temperature()) == start_level;
+    });
+    if ((it == mag->entries.rend()) && (mag->credits < m_magazine_size)) {
+        // Pull a batch from the shared queue of this level, so that subsequent allocs on this thread are served
+        // locally
+        const uint32_t nrefill{std::min(m_magazine_size / 2, m_magazine_size - mag->credits)};
+        uint32_t npulled{0};
+        blk_cache_entry e;
+        while ((npulled < nrefill) && m_level_queues[start_level]->read(e)) {
+            mag->entries.push_back(e);
+            ++mag->credits;
+            ++npulled;
+        }
+        COUNTER_INCREMENT(m_metrics, num_slab_magazine_refills, 1);
+        if (npulled > 0) { it = mag->entries.rbegin(); }
+    }
+
+    std::optional< blk_temp_t > ret;
+    if (it != mag->entries.rend()) {
+        // Slot is retained by the magazine, expecting the entry to be freed back on this thread
+        out_entry = *it;
+        mag->entries.erase(std::next(it).base());
+        ret = start_level;
+    }
+    mag->count.store(static_cast< uint32_t >(mag->entries.size()), std::memory_order_relaxed);
+    lg.unlock();
+
+    if (!ret) { ret = pop_global(start_level, out_entry); }
+
+    // Shared queues are dry, the only free entries left in the cache are held by other threads
+    if (!ret && steal_from_magazines(mag, out_entry)) { ret = level_of(out_entry.get_temperature()); }
+    return ret;
+}
+
+std::optional< blk_temp_t > SlabCacheQueue::push_global(const blk_cache_entry& entry, const bool only_this_level) {
+    const blk_temp_t start_level{level_of(entry.get_temperature())};
     blk_temp_t level{start_level};
     bool pushed{m_level_queues[start_level]->write(entry)};
 
@@ -324,21 +442,32 @@ std::optional< blk_temp_t > SlabCacheQueue::push(const blk_cache_entry& entry, c
     return pushed ? std::optional< blk_temp_t >{level} : std::nullopt;
 }
 
-std::optional< blk_temp_t > SlabCacheQueue::pop(const blk_temp_t input_level, const bool only_this_level,
-                                                blk_cache_entry& out_entry) {
-    const blk_temp_t start_level{
-        static_cast< blk_temp_t >((input_level >= m_level_queues.size()) ? m_level_queues.size() - 1 : input_level)};
+std::optional< blk_temp_t > SlabCacheQueue::pop_global(const blk_temp_t start_level, blk_cache_entry& out_entry) {
     blk_temp_t level{start_level};
     bool popped{m_level_queues[start_level]->read(out_entry)};
 
-    if (!popped && !only_this_level) {
-        do {
-            level = (level + 1) % m_level_queues.size();
-            if (level == start_level) break;
-            popped = m_level_queues[level]->read(out_entry);
-        } while (!popped);
+    while (!popped) {
+        level = (level + 1) % m_level_queues.size();
+        if (level == start_level) break;
+        popped = m_level_queues[level]->read(out_entry);
     }
-    return popped ? std::optional< blk_temp_t >{start_level} : std::nullopt;
+    return popped ? std::optional< blk_temp_t >{level} : std::nullopt;
+}
+
+bool SlabCacheQueue::steal_from_magazines(blk_magazine* const my_mag, blk_cache_entry& out_entry) {
+    for (auto& mag : m_magazines) {
+        if ((mag.get() == my_mag) || (mag->count.load(std::memory_order_relaxed) == 0)) { continue; }
+
+        std::unique_lock lg{mag->mtx};
+        if (mag->entries.empty()) { continue; }
+        out_entry = mag->entries.front();
+        mag->entries.erase(mag->entries.begin());
+        --mag->credits; // Slot goes along with the entry, so that a free on any thread can reclaim it
+        mag->count.store(static_cast< uint32_t >(mag->entries.size()), std::memory_order_relaxed);
+        COUNTER_INCREMENT(m_metrics, num_slab_magazine_steals, 1);
+        return true;
+    }
+    return false;
 }
 
 blk_num_t SlabCacheQueue::entry_count() const {
@@ -346,6 +475,9 @@ blk_num_t SlabCacheQueue::entry_count() const {
     for (size_t l{0}; l < m_level_queues.size(); ++l) {
         sz += num_level_entries(l);
     }
+    for (const auto& mag : m_magazines) {
+        sz += mag->count.load(std::memory_order_relaxed);
+    }
     return sz;
 }
 
@@ -360,14 +492,56 @@ blk_num_t SlabCacheQueue::open_session(const uint64_t session_id, const bool fil
     if (id == 0) {
         // If no running session, calculate how much we need to fill in this slab and try to start this session
         const auto nentries{entry_count()};
-        if (fill_entire_cache || (nentries < m_refill_threshold_limits)) {
+        const bool below_threshold{nentries < m_refill_threshold_limits};
+        const bool running_dry{predicted_ms_to_empty() <
+                               HS_DYNAMIC_CONFIG(blkallocator.free_blk_cache_refill_lead_time_ms)};
+        if (fill_entire_cache || below_threshold || running_dry) {
             count = (nentries > m_total_capacity) ? 0 : (m_total_capacity - nentries);
             if (!m_refill_session.compare_exchange_strong(id, session_id, std::memory_order_acq_rel)) { count = 0; }
+            if (count && !fill_entire_cache && !below_threshold) {
+                COUNTER_INCREMENT(m_metrics, num_slab_proactive_refill_sessions, 1);
+            }
         }
     }
     return count;
 }
 
+void SlabCacheQueue::sample_consumption() {
+    std::unique_lock lg{m_sample_mtx};
+    const auto now{std::chrono::steady_clock::now()};
+    const auto elapsed_us{std::chrono::duration_cast< std::chrono::microseconds >(now - m_last_sample_time).count()};
+    if (elapsed_us <= 0) { return; }
+
+    const int64_t consumed{m_net_consumed.load(std::memory_order_relaxed)};
+    const double cur_rate{(static_cast< double >(consumed - m_last_sampled_consumed) * 1000000.0) / elapsed_us};
+    m_last_sampled_consumed = consumed;
+    m_last_sample_time = now;
+
+    // Weigh the latest sample equal to the history, so that a burst is reacted upon within a sample or two. Periods
+    // where frees outpace allocs do not drain the slab, hence floored at 0.
+    const double rate{(m_consumption_rate.load(std::memory_order_relaxed) + std::max(cur_rate, 0.0)) / 2};
+    m_consumption_rate.store(rate, std::memory_order_relaxed);
+}
+
+uint64_t SlabCacheQueue::predicted_ms_to_empty() const {
+    const auto rate{consumption_rate()};
+    if (rate < 1.0) { return std::numeric_limits< uint64_t >::max(); }
+    return static_cast< uint64_t >((entry_count() * 1000.0) / rate);
+}
+
+void SlabCacheQueue::snapshot(std::vector< blk_cache_entry >& out_entries, const size_t max_entries,
+                              std::vector< blk_cache_entry >& excess_blks) {
+    // Rotate through the entries present in each level, putting every entry back right after reading it, so that
+    // allocs racing with the snapshot miss at most the one entry in hand. Entries in thread magazines are skipped.
+    for (auto& q : m_level_queues) {
+        blk_cache_entry e;
+        for (auto n{q->sizeGuess()}; (n > 0) && (out_entries.size() < max_entries) && q->read(e); --n) {
+            out_entries.push_back(e);
+            if (!q->write(e) && !push_global(e, false /* only_this_level */)) { excess_blks.push_back(e); }
+        }
+    }
+}
+
 void SlabCacheQueue::close_session(const uint64_t session_id) {
     uint64_t expected_session_id{session_id};
     m_refill_session.compare_exchange_strong(expected_session_id, 0, std::memory_order_acq_rel);
@@ -383,13 +557,27 @@ SlabMetrics::SlabMetrics(const blk_count_t slab_size, SlabCacheQueue* const slab
     REGISTER_COUNTER(num_slab_splits, "Number of split in this slab to serve lower slab alloc");
     REGISTER_COUNTER(num_slab_merges, "Number of merges in this slab to serve higher slab alloc");
     REGISTER_COUNTER(num_slab_refills, "Number of entries refilled in this slab");
+    REGISTER_COUNTER(num_slab_magazine_refills, "Number of batch refills of thread magazines from this slab");
+    REGISTER_COUNTER(num_slab_magazine_steals, "Number of entries stolen from other thread magazines");
+    REGISTER_COUNTER(num_slab_proactive_refill_sessions,
+                     "Number of refills started ahead, as the slab was predicted to run dry");
 
     REGISTER_GAUGE(slab_available_entries, "Available entries in the slab for allocation");
     REGISTER_GAUGE(slab_total_entries, "Total entries possible in the slab for allocation");
+    REGISTER_GAUGE(slab_consumption_rate, "Net entries consumed per second in the slab");
+    REGISTER_GAUGE(slab_predicted_ms_to_empty, "Time in ms the slab is predicted to run dry at its consumption rate");
 
     register_me_to_parent(parent);
     attach_gather_cb(std::bind(&SlabMetrics::on_gather, this));
 }
 
-void SlabMetrics::on_gather() { GAUGE_UPDATE(*this, slab_available_entries, m_slab_queue->entry_count()); }
+void SlabMetrics::on_gather() {
+    GAUGE_UPDATE(*this, slab_available_entries, m_slab_queue->entry_count());
+    GAUGE_UPDATE(*this, slab_consumption_rate, static_cast< int64_t >(m_slab_queue->consumption_rate()));
+
+    // Gauge can't hold max of uint64, report the slabs which are not being drained as -1
+    const auto ms_to_empty{m_slab_queue->predicted_ms_to_empty()};
+    GAUGE_UPDATE(*this, slab_predicted_ms_to_empty,
+                 (ms_to_empty == std::numeric_limits< uint64_t >::max()) ? -1 : static_cast< int64_t >(ms_to_empty));
+}
 } // namespace homestore
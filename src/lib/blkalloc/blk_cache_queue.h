@@ -16,8 +16,10 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <vector>
 
@@ -66,6 +68,15 @@ public:
     [[nodiscard]] blk_count_t slab_size() const { return m_slab_size; }
     void refilled();
 
+    // Alloc takes out entries (positive) and free gives them back (negative), fills are not counted
+    void record_consumption(const int64_t nentries) { m_net_consumed.fetch_add(nentries, std::memory_order_relaxed); }
+    void sample_consumption();
+    [[nodiscard]] double consumption_rate() const { return m_consumption_rate.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t predicted_ms_to_empty() const;
+
+    void snapshot(std::vector< blk_cache_entry >& out_entries, const size_t max_entries,
+                  std::vector< blk_cache_entry >& excess_blks);
+
     [[nodiscard]] blk_num_t open_session(const uint64_t session_id, const bool fill_entire_cache);
     void close_session(const uint64_t session_id);
 
@@ -73,12 +84,38 @@ public:
 
     blk_count_t get_slab_size() const { return m_slab_size; }
 
+private:
+    // Small stack of entries local to a thread, so that the fast path alloc and free does not touch the shared queues.
+    // Lock is practically uncontended, since it is taken by other threads only when stealing from each other.
+    struct alignas(64) blk_magazine {
+        std::mutex mtx;
+        std::vector< blk_cache_entry > entries;
+        uint32_t credits{0}; // Slots of the slab capacity this magazine holds, either as entries or allocated ones
+        std::atomic< uint32_t > count{0};
+    };
+
+    blk_magazine* this_thread_magazine();
+    [[nodiscard]] std::optional< blk_temp_t > push_global(const blk_cache_entry& entry, const bool only_this_level);
+    [[nodiscard]] std::optional< blk_temp_t > pop_global(const blk_temp_t start_level, blk_cache_entry& out_entry);
+    [[nodiscard]] blk_temp_t level_of(const blk_temp_t temp) const {
+        return static_cast< blk_temp_t >((temp >= m_level_queues.size()) ? m_level_queues.size() - 1 : temp);
+    }
+    [[nodiscard]] bool steal_from_magazines(blk_magazine* const my_mag, blk_cache_entry& out_entry);
+
 private:
     blk_count_t m_slab_size; // Slab size in-terms of number of pages
+    std::vector< std::unique_ptr< blk_magazine > > m_magazines;
+    uint32_t m_magazine_size{0};
     std::vector< std::unique_ptr< folly::MPMCQueue< blk_cache_entry > > > m_level_queues;
     std::atomic< uint64_t > m_refill_session{0}; // Is a refill pending for this slab
     blk_num_t m_total_capacity{0};
     blk_num_t m_refill_threshold_limits; // For every level whats their threshold limit size
+
+    std::atomic< int64_t > m_net_consumed{0};          // Entries allocated less entries freed, since creation
+    std::atomic< double > m_consumption_rate{0.0};     // Moving average of net entries consumed per second
+    std::mutex m_sample_mtx;                           // Serializes samplers of consumption rate
+    int64_t m_last_sampled_consumed{0};                // m_net_consumed as of last sample
+    std::chrono::steady_clock::time_point m_last_sample_time{std::chrono::steady_clock::now()};
     SlabMetrics m_metrics;
 };
 
@@ -97,6 +134,9 @@ public:
     blk_num_t try_fill_cache(const blk_cache_fill_req& fill_req, blk_cache_fill_session& fill_session) override;
 
     blk_num_t total_free_blks() const override;
+    uint64_t sample_ms_to_empty() override;
+    void snapshot(std::vector< blk_cache_entry >& out_entries, const size_t max_entries,
+                  std::vector< blk_cache_entry >& excess_blks) override;
 
     std::shared_ptr< blk_cache_fill_session > create_cache_fill_session(const bool fill_entire_cache);
     void close_cache_fill_session(blk_cache_fill_session& fill_session);
@@ -13,7 +13,9 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <algorithm>
 #include <cassert>
+#include <thread>
 #include <iomgr/iomgr_flip.hpp>
 
 #include "common/homestore_assert.hpp"
@@ -21,33 +23,156 @@
 
 namespace homestore {
 FixedBlkAllocator::FixedBlkAllocator(BlkAllocConfig const& cfg, bool is_fresh, chunk_num_t chunk_id) :
-        BitmapBlkAllocator(cfg, is_fresh, chunk_id), m_free_blk_q{get_total_blks()} {
+        BitmapBlkAllocator(cfg, is_fresh, chunk_id),
+        m_free_blk_q{get_total_blks()},
+        m_portion_states{std::make_unique< portion_state[] >(get_num_portions())},
+        m_next_portion{get_num_portions()} {
+    // Magazines should not hoard more than a fraction of the blks, otherwise a thread could starve others of them,
+    // which are reachable to them only through stealing.
+    const uint32_t num_magazines{std::max(std::thread::hardware_concurrency(), 1u)};
+    m_magazine_size = std::min< uint32_t >(HS_DYNAMIC_CONFIG(blkallocator.fixed_blk_magazine_size),
+                                           get_total_blks() / (num_magazines * 4));
+    if (m_magazine_size >= 2) {
+        m_magazines.reserve(num_magazines);
+        for (uint32_t i{0}; i < num_magazines; ++i) {
+            auto mag{std::make_unique< blk_magazine >()};
+            mag->blks.reserve(m_magazine_size + 1);
+            m_magazines.push_back(std::move(mag));
+        }
+    } else {
+        m_magazine_size = 0;
+    }
+
     if (is_fresh || !is_persistent()) { load(); }
 }
 
 void FixedBlkAllocator::load() {
-    blk_num_t blk_num{0};
-    while (blk_num < get_total_blks()) {
-        blk_num = init_portion(blknum_to_portion(blk_num), blk_num);
+    // Free blks of each portion are only counted here, they are pushed to the queue once it runs dry. Counting goes
+    // by the runs of set bits, which is much cheaper than pushing every free blk of the chunk.
+    int64_t nfree{0};
+    for (blk_num_t portion_num{0}; portion_num < get_num_portions(); ++portion_num) {
+        auto lock{get_blk_portion(portion_num).portion_auto_lock()};
+        auto const start = uint64_cast(portion_num) * get_blks_per_portion();
+        auto const end = std::min(start + get_blks_per_portion(), uint64_cast(get_total_blks()));
+        auto& ps = m_portion_states[portion_num];
+        ps.nfree = s_cast< blk_num_t >(end - start);
+        if (is_persistent()) {
+            auto const bm = get_disk_bitmap();
+            for (auto b = start; (b < end) && !bm->is_bits_reset(b, end - b);) {
+                auto const run_start = bm->get_next_set_bit(b);
+                auto const run_end =
+                    bm->is_bits_set(run_start, end - run_start) ? end : bm->get_next_reset_bit(run_start);
+                ps.nfree -= s_cast< blk_num_t >(run_end - run_start);
+                b = run_end;
+            }
+        }
+        nfree += ps.nfree;
     }
+    m_unloaded_free_blks.store(nfree, std::memory_order_relaxed);
+    m_next_portion.store(0, std::memory_order_release);
 }
 
-blk_num_t FixedBlkAllocator::init_portion(BlkAllocPortion& portion, blk_num_t start_blk_num) {
-    auto lock{portion.portion_auto_lock()};
+void FixedBlkAllocator::init_portion(blk_num_t portion_num) {
+    auto lock{get_blk_portion(portion_num).portion_auto_lock()};
+    auto const start = uint64_cast(portion_num) * get_blks_per_portion();
+    auto const end = std::min(start + get_blks_per_portion(), uint64_cast(get_total_blks()));
+    {
+        std::lock_guard lg(m_reserve_blk_mtx);
+        for (auto blk_num = s_cast< blk_num_t >(start); blk_num < end; ++blk_num) {
+            if (is_persistent() && !get_disk_bitmap()->is_bits_reset(blk_num, 1)) { continue; }
 
-    auto blk_num = start_blk_num;
-    while (blk_num < get_total_blks()) {
-        BlkAllocPortion& cur_portion = blknum_to_portion(blk_num);
-        if (portion.get_portion_num() != cur_portion.get_portion_num()) break;
+            // Blks reserved during recovery are allocated, even if their bits are not yet set on disk
+            if (!m_reserved_blks.empty() && (m_reserved_blks.erase(blk_num) != 0)) { continue; }
 
-        if (!is_persistent() || get_disk_bitmap()->is_bits_reset(blk_num, 1)) {
             const auto pushed = m_free_blk_q.write(blk_num);
             HS_DBG_ASSERT_EQ(pushed, true, "Expected to be able to push the blk on fixed capacity Q");
         }
-        ++blk_num;
     }
 
-    return blk_num;
+    auto& ps = m_portion_states[portion_num];
+    m_unloaded_free_blks.fetch_sub(ps.nfree, std::memory_order_relaxed);
+    ps.nfree = 0;
+    ps.loaded = true;
+}
+
+bool FixedBlkAllocator::load_next_portion() {
+    auto const num_portions = get_num_portions();
+    auto portion_num = m_next_portion.load(std::memory_order_acquire);
+    do {
+        if (portion_num >= num_portions) { return false; }
+    } while (!m_next_portion.compare_exchange_weak(portion_num, portion_num + 1, std::memory_order_acq_rel));
+
+    init_portion(portion_num);
+    return true;
+}
+
+bool FixedBlkAllocator::pop_free_blk(blk_num_t& blk_num) {
+    while (!m_free_blk_q.read(blk_num)) {
+        // Portion loaded could have all its blks allocated, so keep loading till the queue has any
+        if (!load_next_portion()) { return m_free_blk_q.read(blk_num); }
+    }
+    return true;
+}
+
+void FixedBlkAllocator::push_free_blk(blk_num_t blk_num) {
+    auto mag = (m_state == state_t::ACTIVE) ? this_thread_magazine() : nullptr;
+    if (mag == nullptr) {
+        const auto pushed = m_free_blk_q.write(blk_num);
+        HS_DBG_ASSERT_EQ(pushed, true, "Expected to be able to push the blk on fixed capacity Q");
+        return;
+    }
+
+    std::unique_lock lg{mag->mtx};
+    mag->blks.push_back(blk_num);
+    if (mag->blks.size() > m_magazine_size) {
+        // Spill the older half to the queue, keeping the recently freed ones for the allocs on this thread
+        auto const nspill = m_magazine_size / 2;
+        for (uint32_t i{0}; i < nspill; ++i) {
+            const auto pushed = m_free_blk_q.write(mag->blks[i]);
+            HS_DBG_ASSERT_EQ(pushed, true, "Expected to be able to push the blk on fixed capacity Q");
+        }
+        mag->blks.erase(mag->blks.begin(), mag->blks.begin() + nspill);
+    }
+    mag->count.store(uint32_cast(mag->blks.size()), std::memory_order_relaxed);
+}
+
+FixedBlkAllocator::blk_magazine* FixedBlkAllocator::this_thread_magazine() {
+    static std::atomic< uint32_t > s_next_slot{0};
+    thread_local uint32_t t_slot{s_next_slot.fetch_add(1, std::memory_order_relaxed)};
+    return m_magazines.empty() ? nullptr : m_magazines[t_slot % m_magazines.size()].get();
+}
+
+bool FixedBlkAllocator::alloc_from_magazine(blk_magazine* mag, blk_num_t& blk_num) {
+    std::unique_lock lg{mag->mtx};
+    if (mag->blks.empty()) {
+        // Pull a batch from the queue, so that subsequent allocs on this thread are served locally
+        blk_num_t b;
+        while ((mag->blks.size() < m_magazine_size / 2) && pop_free_blk(b)) {
+            mag->blks.push_back(b);
+        }
+    }
+
+    bool const found{!mag->blks.empty()};
+    if (found) {
+        blk_num = mag->blks.back();
+        mag->blks.pop_back();
+    }
+    mag->count.store(uint32_cast(mag->blks.size()), std::memory_order_relaxed);
+    return found;
+}
+
+bool FixedBlkAllocator::steal_from_magazines(blk_magazine* my_mag, blk_num_t& blk_num) {
+    for (auto& mag : m_magazines) {
+        if ((mag.get() == my_mag) || (mag->count.load(std::memory_order_relaxed) == 0)) { continue; }
+
+        std::unique_lock lg{mag->mtx};
+        if (mag->blks.empty()) { continue; }
+        blk_num = mag->blks.front();
+        mag->blks.erase(mag->blks.begin());
+        mag->count.store(uint32_cast(mag->blks.size()), std::memory_order_relaxed);
+        return true;
+    }
+    return false;
 }
 
 bool FixedBlkAllocator::is_blk_alloced(BlkId const& b, bool use_lock) const { return true; }
@@ -56,9 +181,19 @@ BlkAllocStatus FixedBlkAllocator::alloc([[maybe_unused]] blk_count_t nblks, blk_
 #ifdef _PRERELEASE
     if (iomgr_flip::instance()->test_flip("fixed_blkalloc_no_blks")) { return BlkAllocStatus::SPACE_FULL; }
 #endif
-retry:
     blk_num_t blk_num;
-    if (!m_free_blk_q.read(blk_num)) { return BlkAllocStatus::SPACE_FULL; }
+    if (m_state == state_t::ACTIVE) {
+        auto mag = this_thread_magazine();
+        if ((mag == nullptr) || !alloc_from_magazine(mag, blk_num)) {
+            // Queue is dry and all portions are loaded, the only free blks left are held by other threads
+            if (!pop_free_blk(blk_num) && !steal_from_magazines(mag, blk_num)) { return BlkAllocStatus::SPACE_FULL; }
+        }
+        out_blkid = BlkId{blk_num, 1, m_chunk_id};
+        return BlkAllocStatus::SUCCESS;
+    }
+
+retry:
+    if (!pop_free_blk(blk_num)) { return BlkAllocStatus::SPACE_FULL; }
 
     if (m_state != state_t::ACTIVE) {
         // We are not in active state, means we must be recovering. During recovery state, if any of the blks which are
@@ -77,25 +212,35 @@ retry:
 BlkAllocStatus FixedBlkAllocator::alloc_contiguous(BlkId& out_blkid) { return alloc(1, {}, out_blkid); }
 
 BlkAllocStatus FixedBlkAllocator::reserve_on_cache(BlkId const& b) {
+    auto const portion_num = blknum_to_portion_num(b.blk_num());
+    auto lock{get_blk_portion(portion_num).portion_auto_lock()};
     std::lock_guard lg(m_reserve_blk_mtx);
-    if (m_state == state_t::RECOVERING) { m_reserved_blks.insert(b.blk_num()); }
+    if (m_state == state_t::RECOVERING) {
+        auto const inserted = m_reserved_blks.insert(b.blk_num()).second;
+
+        // Blk counted as free of a portion not yet loaded, which is skipped when the portion is loaded
+        auto& ps = m_portion_states[portion_num];
+        if (inserted && !ps.loaded && (!is_persistent() || get_disk_bitmap()->is_bits_reset(b.blk_num(), 1))) {
+            --ps.nfree;
+            m_unloaded_free_blks.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
     return BlkAllocStatus::SUCCESS;
 }
 
 void FixedBlkAllocator::recovery_completed() {
     std::lock_guard lg(m_reserve_blk_mtx);
     if (!m_reserved_blks.empty()) {
-        auto const count = available_blks();
-        for (uint64_t i{0}; ((i < count) && !m_reserved_blks.empty()); ++i) {
+        auto const count = m_free_blk_q.sizeGuess();
+        for (int64_t i{0}; ((i < count) && !m_reserved_blks.empty()); ++i) {
             blk_num_t blk_num;
             if (!m_free_blk_q.read(blk_num)) { break; }
 
-            if (m_reserved_blks.find(blk_num) == m_reserved_blks.end()) {
+            if (m_reserved_blks.erase(blk_num) == 0) {
                 m_free_blk_q.write(blk_num); // This blk is not marked, put it back at the end of queue
             }
         }
-        // We no longer need any reserved blks, since all of them are now marked as allocated
-        m_reserved_blks.clear();
+        // Reserved blks still left are of the portions not yet loaded, which are skipped when they are loaded
     }
     m_state = state_t::ACTIVE;
 }
@@ -103,20 +248,36 @@ void FixedBlkAllocator::recovery_completed() {
 void FixedBlkAllocator::free(BlkId const& b) {
     HS_DBG_ASSERT_EQ(b.blk_count(), 1, "Multiple blk free for FixedBlkAllocator? allocated by different allocator?");
 
-    const auto pushed = m_free_blk_q.write(b.blk_num());
-    HS_DBG_ASSERT_EQ(pushed, true, "Expected to be able to push the blk on fixed capacity Q");
-
-    if (m_state != state_t::ACTIVE) {
-        std::lock_guard lg(m_reserve_blk_mtx);
-        if (m_state == state_t::RECOVERING) {
+    auto const portion_num = blknum_to_portion_num(b.blk_num());
+    bool loaded;
+    {
+        // Blk is reset on disk under the portion lock, so that a portion being loaded sees either the blk reset on
+        // disk or the portion as loaded here, but not both
+        auto lock{get_blk_portion(portion_num).portion_auto_lock()};
+        auto& ps = m_portion_states[portion_num];
+        loaded = ps.loaded;
+        if (!loaded) {
+            // Blk is pushed to the queue along with the rest of its portion, once the portion is loaded
+            ++ps.nfree;
+            m_unloaded_free_blks.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (!loaded || (m_state != state_t::ACTIVE)) {
             // If we are in recovering state and freeing blk would removed it from being reserved as well.
+            std::lock_guard lg(m_reserve_blk_mtx);
             m_reserved_blks.erase(b.blk_num());
         }
+        if (is_persistent()) { free_on_disk_locked(b); }
     }
-    if (is_persistent()) { free_on_disk(b); }
+    if (loaded) { push_free_blk(b.blk_num()); }
 }
 
-blk_num_t FixedBlkAllocator::available_blks() const { return m_free_blk_q.sizeGuess(); }
+blk_num_t FixedBlkAllocator::available_blks() const {
+    int64_t count = m_free_blk_q.sizeGuess() + m_unloaded_free_blks.load(std::memory_order_relaxed);
+    for (const auto& mag : m_magazines) {
+        count += mag->count.load(std::memory_order_relaxed);
+    }
+    return s_cast< blk_num_t >(std::max< int64_t >(count, 0));
+}
 
 blk_num_t FixedBlkAllocator::get_defrag_nblks() const {
     // TODO: implement this
@@ -127,6 +288,8 @@ blk_num_t FixedBlkAllocator::get_defrag_nblks() const {
 blk_num_t FixedBlkAllocator::get_used_blks() const { return get_total_blks() - available_blks(); }
 
 std::string FixedBlkAllocator::to_string() const {
-    return fmt::format("Total Blks={} Available_Blks={}", get_total_blks(), available_blks());
+    return fmt::format("Total Blks={} Available_Blks={} Loaded_Portions={}/{}", get_total_blks(), available_blks(),
+                       std::min(m_next_portion.load(std::memory_order_relaxed), get_num_portions()),
+                       get_num_portions());
 }
 } // namespace homestore
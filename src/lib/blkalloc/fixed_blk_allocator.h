@@ -14,12 +14,21 @@
  *********************************************************************************/
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include "bitmap_blk_allocator.h"
 
 namespace homestore {
 /* FixedBlkAllocator is a fast allocator where it allocates only 1 size block and ALL free blocks are cached instead
  * of selectively caching few blks which are free. Thus there is no sweeping of bitmap or other to refill the cache.
  * It does not support temperature of blocks and allocates simply on first come first serve basis
+ *
+ * Free blks of a portion are pushed to the free blk queue only when the queue runs dry, so that load() doesn't scan
+ * the entire bitmap upfront. Once active, each thread allocates from and frees to a small magazine of its own, which
+ * is refilled from and spilled to the lock free queue in batches.
  */
 class FixedBlkAllocator : public BitmapBlkAllocator {
 public:
@@ -45,7 +54,26 @@ public:
     std::string to_string() const override;
 
 private:
-    blk_num_t init_portion(BlkAllocPortion& portion, blk_num_t start_blk_num);
+    // Stack of free blks local to a thread. Lock is practically uncontended, since it is taken by other threads only
+    // when stealing from each other.
+    struct alignas(64) blk_magazine {
+        std::mutex mtx;
+        std::vector< blk_num_t > blks;
+        std::atomic< uint32_t > count{0};
+    };
+
+    struct portion_state {
+        bool loaded{false}; // Are the free blks of this portion pushed to the free blk queue
+        blk_num_t nfree{0}; // Free blks of a portion not yet loaded, as counted in available blks
+    };
+
+    void init_portion(blk_num_t portion_num);
+    bool load_next_portion();
+    bool pop_free_blk(blk_num_t& blk_num);
+    void push_free_blk(blk_num_t blk_num);
+    blk_magazine* this_thread_magazine();
+    bool alloc_from_magazine(blk_magazine* mag, blk_num_t& blk_num);
+    bool steal_from_magazines(blk_magazine* my_mag, blk_num_t& blk_num);
 
 private:
     enum class state_t : uint8_t { RECOVERING, ACTIVE };
@@ -54,5 +82,12 @@ private:
     std::unordered_set< blk_num_t > m_reserved_blks; // Keep track of all blks which are reserved as allocated
     std::mutex m_reserve_blk_mtx;                    // Mutex used while removing marked_blks from blk_q
     folly::MPMCQueue< blk_num_t > m_free_blk_q;
+
+    std::unique_ptr< portion_state[] > m_portion_states; // Guarded by the lock of each portion
+    std::atomic< blk_num_t > m_next_portion;             // Next portion to load, all of them are loaded past the last
+    std::atomic< int64_t > m_unloaded_free_blks{0};      // Free blks of the portions not yet loaded
+
+    std::vector< std::unique_ptr< blk_magazine > > m_magazines;
+    uint32_t m_magazine_size{0};
 };
 } // namespace homestore
@@ -0,0 +1,101 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include <homestore/blk.h>
+
+namespace homestore {
+
+/*
+ * Segment tree over the portions of a blk allocator, where every node holds the max of the free run upper bounds of
+ * the portions beneath it. It lets the allocator jump to the next portion which could satisfy a contiguous request
+ * in O(log n), instead of visiting every portion in between.
+ *
+ * Values are only hints (see BlkAllocPortion::m_max_free_run), so a candidate returned could still fail the actual
+ * bitmap search, but a portion which is skipped is guaranteed not to have a big enough run.
+ */
+class FreeRunTree {
+public:
+    static constexpr blk_num_t npos{std::numeric_limits< blk_num_t >::max()};
+
+    explicit FreeRunTree(blk_num_t num_portions) : m_num_portions{num_portions} {
+        while (m_num_leaves < num_portions) {
+            m_num_leaves *= 2;
+        }
+
+        // Every portion starts with an unknown free run, non existent portions at the tail never match
+        m_nodes.resize(2 * m_num_leaves, 0);
+        for (blk_num_t p{0}; p < num_portions; ++p) {
+            m_nodes[m_num_leaves + p] = npos;
+        }
+        for (auto i = m_num_leaves - 1; i > 0; --i) {
+            m_nodes[i] = std::max(m_nodes[2 * i], m_nodes[2 * i + 1]);
+        }
+    }
+
+    FreeRunTree(FreeRunTree const&) = delete;
+    FreeRunTree& operator=(FreeRunTree const&) = delete;
+
+    void update(blk_num_t portion_num, blk_num_t max_free_run) {
+        std::unique_lock lg{m_mtx};
+        auto i = m_num_leaves + portion_num;
+        if (m_nodes[i] == max_free_run) { return; }
+
+        m_nodes[i] = max_free_run;
+        for (i /= 2; i > 0; i /= 2) {
+            auto const m = std::max(m_nodes[2 * i], m_nodes[2 * i + 1]);
+            if (m_nodes[i] == m) { break; }
+            m_nodes[i] = m;
+        }
+    }
+
+    // Returns the first portion in [from, to) whose free run could be at least nblks, npos if there is none
+    blk_num_t find_first(blk_num_t from, blk_num_t to, blk_num_t nblks) const {
+        if (from >= to) { return npos; }
+        std::unique_lock lg{m_mtx};
+        return find_first(1, 0, m_num_leaves, from, std::min(to, m_num_portions), nblks);
+    }
+
+    blk_num_t max_free_run() const {
+        std::unique_lock lg{m_mtx};
+        return m_nodes[1];
+    }
+
+private:
+    blk_num_t find_first(size_t node, blk_num_t node_start, blk_num_t node_end, blk_num_t from, blk_num_t to,
+                         blk_num_t nblks) const {
+        if ((node_end <= from) || (node_start >= to) || (m_nodes[node] < nblks)) { return npos; }
+        if (node >= m_num_leaves) { return node_start; }
+
+        auto const mid = node_start + (node_end - node_start) / 2;
+        auto const found = find_first(2 * node, node_start, mid, from, to, nblks);
+        return (found != npos) ? found : find_first(2 * node + 1, mid, node_end, from, to, nblks);
+    }
+
+private:
+    mutable std::mutex m_mtx;
+    blk_num_t m_num_portions;
+    blk_num_t m_num_leaves{1};
+    std::vector< blk_num_t > m_nodes;
+};
+
+} // namespace homestore
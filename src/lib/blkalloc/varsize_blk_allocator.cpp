@@ -23,8 +23,12 @@
 #include <sisl/utility/thread_factory.hpp>
 #include <sisl/utility/thread_buffer.hpp>
 #include <iomgr/iomgr_flip.hpp>
+#include <homestore/homestore.hpp>
+#include <homestore/meta_service.hpp>
+#include <homestore/cpu_accounting.hpp>
 
 #include "blk_cache_queue.h"
+#include "common/thread_placement.hpp"
 
 #include "varsize_blk_allocator.h"
 
@@ -67,6 +71,14 @@ VarsizeBlkAllocator::VarsizeBlkAllocator(VarsizeBlkAllocConfig const& cfg, bool
     HS_REL_ASSERT_EQ(get_blks_per_portion() % m_cache_bm->word_size(), 0,
                      "Blocks per portion must be multiple of bitmap word size.")
 
+    m_free_run_tree = std::make_unique< FreeRunTree >(get_num_portions());
+
+    // Divide the portions into contiguous groups, one per temperature, so that data of same temperature is co-located
+    m_num_temperatures = std::max< blk_temp_t >(HS_DYNAMIC_CONFIG(blkallocator.num_blk_temperatures), 1);
+    for (blk_num_t p{0}; p < get_num_portions(); ++p) {
+        get_blk_portion(p).set_temperature(portion_temperature(p));
+    }
+
     // Create segments with as many blk groups as configured.
     m_blks_per_seg = get_total_blks() / cfg.m_nsegments;
     m_segments.reserve(cfg.m_nsegments);
@@ -84,6 +96,17 @@ VarsizeBlkAllocator::VarsizeBlkAllocator(VarsizeBlkAllocConfig const& cfg, bool
         LOGINFO("m_fb_cache total free blks: {}", m_fb_cache->total_free_blks());
     }
 
+    // Snapshot of the cache is used to warm it up after restart, which is meaningful only if bitmap is persisted
+    if (m_cfg.m_use_slabs && is_persistent()) {
+        m_snapshot_sb.set_name(get_name() + "_cache_snapshot");
+        meta_service().register_handler(
+            m_snapshot_sb.name(),
+            [this](meta_blk* mblk, sisl::byte_view buf, size_t size) {
+                on_snapshot_found(std::move(buf), voidptr_cast(mblk));
+            },
+            nullptr);
+    }
+
     if (is_fresh || !is_persistent()) { do_start(); }
 }
 
@@ -146,15 +169,20 @@ VarsizeBlkAllocator::~VarsizeBlkAllocator() {
 }
 
 void VarsizeBlkAllocator::sweeper_thread(size_t thread_num) {
+    ThreadPlacement::bind_self(hs_thread_role_t::BACKGROUND);
     const size_t num_sweeper_threads = HS_DYNAMIC_CONFIG(blkallocator.num_slab_sweeper_threads);
+    auto last_periodic_refill = std::chrono::steady_clock::now();
 
     while (!s_sweeper_threads_stop) {
         VarsizeBlkAllocator* allocator_ptr{nullptr};
         {
             std::unique_lock< std::mutex > lock{s_sweeper_mutex};
-            auto const woken{s_sweeper_cv.wait_for(
-                lock, std::chrono::milliseconds(HS_DYNAMIC_CONFIG(blkallocator.free_blk_cache_refill_frequency_ms)),
-                [&]() { return !s_sweeper_queue.empty() || s_sweeper_threads_stop; })};
+            auto const wait_ms =
+                std::min< uint64_t >(HS_DYNAMIC_CONFIG(blkallocator.free_blk_cache_refill_frequency_ms),
+                                     HS_DYNAMIC_CONFIG(blkallocator.free_blk_cache_rate_sample_ms));
+            auto const woken{s_sweeper_cv.wait_for(lock, std::chrono::milliseconds(wait_ms), [&]() {
+                return !s_sweeper_queue.empty() || s_sweeper_threads_stop;
+            })};
             if (s_sweeper_threads_stop) continue;
             if (woken) {
                 // pull allocator to process
@@ -169,8 +197,11 @@ void VarsizeBlkAllocator::sweeper_thread(size_t thread_num) {
                 std::unique_lock< std::mutex > alloc_lock{allocator_ptr->m_mutex};
                 switch (allocator_ptr->m_state) {
                 case BlkAllocatorState::INIT:
-                    // fill the cache
-                    allocator_ptr->request_more_blks(nullptr, true /* fill_entire_cache */);
+                    // fill the cache, unless it is going to be warmed up from the snapshot, in which case the refill
+                    // happens only for the slabs which are still short after that
+                    if (!allocator_ptr->m_snapshot_pending.load()) {
+                        allocator_ptr->request_more_blks(nullptr, true /* fill_entire_cache */);
+                    }
                     allocator_ptr->m_state = BlkAllocatorState::WAITING;
                     break;
                 case BlkAllocatorState::EXITING:
@@ -192,15 +223,40 @@ void VarsizeBlkAllocator::sweeper_thread(size_t thread_num) {
                 s_sweeper_cv.notify_one();
             }
         } else {
+            // timed out, sample the allocators this thread owns. All of them are processed once every refill
+            // frequency, in between only the one closest to run dry, if it would within the lead time. That way
+            // every sweeper thread has at most one proactive sweep in flight.
+            auto const now = std::chrono::steady_clock::now();
+            bool const periodic_refill =
+                (now - last_periodic_refill) >=
+                std::chrono::milliseconds(HS_DYNAMIC_CONFIG(blkallocator.free_blk_cache_refill_frequency_ms));
+            if (periodic_refill) { last_periodic_refill = now; }
+
+            bool queued{false};
             {
-                // timed out, so process all block allocators
                 std::unique_lock< std::mutex > lock{s_sweeper_mutex};
+                VarsizeBlkAllocator* most_urgent{nullptr};
+                uint64_t min_ms_to_empty{HS_DYNAMIC_CONFIG(blkallocator.free_blk_cache_refill_lead_time_ms)};
                 size_t pos = thread_num;
                 for (auto itr{std::cbegin(s_block_allocators)}; itr != std::cend(s_block_allocators); ++itr, ++pos) {
-                    if ((pos % num_sweeper_threads) == 0) { s_sweeper_queue.emplace(*itr); }
+                    if ((pos % num_sweeper_threads) != 0) { continue; }
+
+                    auto const ms_to_empty = (*itr)->m_fb_cache->sample_ms_to_empty();
+                    if (periodic_refill) {
+                        s_sweeper_queue.emplace(*itr);
+                        queued = true;
+                    } else if (ms_to_empty < min_ms_to_empty) {
+                        min_ms_to_empty = ms_to_empty;
+                        most_urgent = *itr;
+                    }
+                }
+                if (most_urgent) {
+                    COUNTER_INCREMENT(most_urgent->m_metrics, num_proactive_sweeps, 1);
+                    s_sweeper_queue.emplace(most_urgent);
+                    queued = true;
                 }
             }
-            s_sweeper_cv.notify_all();
+            if (queued) { s_sweeper_cv.notify_all(); }
         }
     }
 }
@@ -240,6 +296,101 @@ void VarsizeBlkAllocator::load() {
     do_start();
 }
 
+void VarsizeBlkAllocator::cp_flush(CP* cp) {
+    BitmapBlkAllocator::cp_flush(cp);
+    persist_cache_snapshot();
+}
+
+void VarsizeBlkAllocator::recovery_completed() { apply_cache_snapshot(); }
+
+void VarsizeBlkAllocator::on_snapshot_found(sisl::byte_view const& buf, void* meta_cookie) {
+    m_snapshot_sb.load(buf, meta_cookie);
+    if ((m_snapshot_sb->magic != blk_cache_snapshot_magic) || (m_snapshot_sb->version != blk_cache_snapshot_version)) {
+        BLKALLOC_LOG(ERROR, "Ignoring blk cache snapshot with invalid magic={} or version={}", m_snapshot_sb->magic,
+                     m_snapshot_sb->version);
+        return;
+    }
+
+    std::unique_lock lg{m_snapshot_mtx};
+    auto const entries = m_snapshot_sb->entries();
+    m_snapshot_entries.assign(entries, entries + m_snapshot_sb->num_entries);
+    m_snapshot_pending.store(!m_snapshot_entries.empty());
+    BLKALLOC_LOG(INFO, "Loaded blk cache snapshot of {} entries", m_snapshot_entries.size());
+}
+
+void VarsizeBlkAllocator::persist_cache_snapshot() {
+    if (!m_fb_cache || !is_persistent()) { return; }
+
+    auto const max_entries = HS_DYNAMIC_CONFIG(blkallocator.free_blk_cache_snapshot_max_entries);
+    if (max_entries == 0) {
+        // Snapshot is disabled, don't leave a stale one behind to be applied on a later restart
+        if (!m_snapshot_sb.is_empty()) { m_snapshot_sb.destroy(); }
+        return;
+    }
+
+    // Loaded snapshot is yet to be put in the cache, which is more complete than what the cache has now
+    if (m_snapshot_pending.load()) { return; }
+
+    std::vector< blk_cache_entry > entries;
+    std::vector< blk_cache_entry > excess_blks;
+    entries.reserve(max_entries);
+    m_fb_cache->snapshot(entries, max_entries, excess_blks);
+    for (auto const& e : excess_blks) {
+        free_blks_direct(MultiBlkId{blk_cache_entry_to_blkid(e)});
+    }
+
+    auto const sb_size = blk_cache_snapshot_t::size(s_cast< uint32_t >(entries.size()));
+    if (m_snapshot_sb.is_empty()) {
+        m_snapshot_sb.create(sb_size);
+    } else if (m_snapshot_sb.size() != sb_size) {
+        m_snapshot_sb.resize(sb_size);
+    }
+    m_snapshot_sb->num_entries = s_cast< uint32_t >(entries.size());
+    std::copy(entries.begin(), entries.end(), m_snapshot_sb->entries());
+    m_snapshot_sb.write();
+}
+
+// Snapshot is as of last cp, whatever was allocated since then is reserved on cache bitmap by the time recovery is
+// completed. So every entry is verified against the cache bitmap before use, which also makes it safe with sweep
+// filling the cache in parallel.
+void VarsizeBlkAllocator::apply_cache_snapshot() {
+    if (!m_snapshot_pending.load()) { return; }
+
+    std::unique_lock lg{m_snapshot_mtx};
+    if (!m_snapshot_pending.load() || hs()->is_initializing()) { return; }
+
+    blk_num_t nentries_applied{0};
+    std::vector< blk_cache_entry > excess_blks;
+    for (auto const& e : m_snapshot_entries) {
+        if ((e.blk_count() == 0) || (e.get_blk_num() + e.blk_count() > get_total_blks()) ||
+            (blknum_to_portion_num(e.get_blk_num()) != blknum_to_portion_num(e.get_blk_num() + e.blk_count() - 1))) {
+            continue;
+        }
+
+        BlkAllocPortion& portion = blknum_to_portion(e.get_blk_num());
+        {
+            auto lock{portion.portion_auto_lock()};
+            if (!m_cache_bm->is_bits_reset(e.get_blk_num(), e.blk_count())) { continue; }
+            m_cache_bm->set_bits(e.get_blk_num(), e.blk_count());
+        }
+        m_fb_cache->try_free_blks(e, excess_blks);
+        ++nentries_applied;
+    }
+    for (auto const& e : excess_blks) {
+        free_blks_direct(MultiBlkId{blk_cache_entry_to_blkid(e)});
+    }
+
+    BLKALLOC_LOG(INFO, "Warmed up blk cache with {} of {} entries from snapshot", nentries_applied,
+                 m_snapshot_entries.size());
+    m_snapshot_entries.clear();
+    m_snapshot_entries.shrink_to_fit();
+    m_snapshot_pending.store(false);
+
+    // Refill whatever slabs the snapshot couldn't fill enough
+    std::unique_lock alloc_lg{m_mutex};
+    request_more_blks(nullptr, false /* fill_entire_cache */);
+}
+
 void VarsizeBlkAllocator::do_start() {
     // if use slabs then add to sweeper threads queue
     if (m_cfg.m_use_slabs) {
@@ -342,15 +493,25 @@ void VarsizeBlkAllocator::fill_cache_in_portion(blk_num_t portion_num, blk_cache
                  fill_session.session_id, portion_num, cur_blk_id, end_blk_id);
 
     BlkAllocPortion& portion = get_blk_portion(portion_num);
+    if (!portion.may_have_free_run(1)) {
+        BLKALLOC_LOG(TRACE, "Allocator sweep session={} skipping fully allocated portion_num={}",
+                     fill_session.session_id, portion_num);
+        return;
+    }
+
     {
         auto lock{portion.portion_auto_lock()};
+        blk_num_t max_residue_run{0};
         while (!fill_session.overall_refill_done && (cur_blk_id <= end_blk_id)) {
             // Get next reset bits and insert to cache and then reset those bits
             auto const b{
                 m_cache_bm->get_next_contiguous_n_reset_bits(cur_blk_id, end_blk_id, 1, end_blk_id - cur_blk_id + 1)};
 
             // If there are no free blocks within the assigned portion
-            if (b.nbits == 0) { break; }
+            if (b.nbits == 0) {
+                cur_blk_id = end_blk_id + 1;
+                break;
+            }
 
             HS_DBG_ASSERT_GE(end_blk_id, b.start_bit, "Expected start bit to be smaller than portion end bit");
             HS_DBG_ASSERT_GE(end_blk_id, (b.start_bit + b.nbits - 1),
@@ -370,8 +531,15 @@ void VarsizeBlkAllocator::fill_cache_in_portion(blk_num_t portion_num, blk_cache
 
             // Set the bitmap indicating the blocks are allocated
             if (nblks_added > 0) { m_cache_bm->set_bits(b.start_bit, nblks_added); }
+            max_residue_run = std::max< blk_num_t >(max_residue_run, b.nbits - nblks_added);
             cur_blk_id = b.start_bit + b.nbits;
         }
+
+        // Whole portion is swept, what is left free are only the trailing parts of the runs, cache couldn't take
+        if (cur_blk_id > end_blk_id) {
+            portion.set_max_free_run(max_residue_run);
+            m_free_run_tree->update(portion_num, max_residue_run);
+        }
     }
     if (fill_session.need_notify()) {
         // If we have filled enough to satisfy notification, do so
@@ -396,6 +564,7 @@ BlkAllocStatus VarsizeBlkAllocator::alloc_contiguous(blk_count_t nblks, blk_allo
 }
 
 BlkAllocStatus VarsizeBlkAllocator::alloc(blk_count_t nblks, blk_alloc_hints const& hints, BlkId& out_blkid) {
+    HS_CPU_SCOPE(BLKALLOC);
     bool use_slabs = m_cfg.m_use_slabs;
 
 #ifdef _PRERELEASE
@@ -490,9 +659,12 @@ blk_count_t VarsizeBlkAllocator::alloc_blks_slab(blk_count_t nblks, blk_alloc_hi
                                                  MultiBlkId& out_blkid) {
     blk_count_t num_allocated{0};
 
+    // Warm up the cache with the snapshot on the first alloc after restart, if no one has done it yet
+    if (m_snapshot_pending.load(std::memory_order_relaxed)) { apply_cache_snapshot(); }
+
     // Allocate from blk cache
     static thread_local blk_cache_alloc_resp s_alloc_resp;
-    const blk_cache_alloc_req alloc_req{nblks, hints.desired_temp, hints.is_contiguous,
+    const blk_cache_alloc_req alloc_req{nblks, temp_to_level(hints.desired_temp), hints.is_contiguous,
                                         FreeBlkCache::find_slab(hints.min_blks_per_piece),
                                         s_cast< slab_idx_t >(m_cfg.get_slab_cnt() - 1)};
     COUNTER_INCREMENT(m_metrics, num_alloc, 1);
@@ -558,6 +730,13 @@ blk_count_t VarsizeBlkAllocator::alloc_blks_slab(blk_count_t nblks, blk_alloc_hi
 
         discard_current_allocation();
         if ((retry + 1) < max_retries) {
+            // Refill can only carve the contiguous run out of the bitmap, which direct allocation can find by itself
+            // from the free run summary, so don't wait for the sweep and let the caller fall back to it.
+            if (hints.is_contiguous && (m_free_run_tree->max_free_run() >= nblks)) {
+                request_more_blks(nullptr, false /* fill_entire_cache */);
+                break;
+            }
+
             COUNTER_INCREMENT(m_metrics, num_retries, 1);
             auto const min_nblks = std::max< blk_count_t >(m_cfg.highest_slab_blks_count() * 2, nblks);
             BLKALLOC_LOG(DEBUG,
@@ -581,6 +760,13 @@ blk_count_t VarsizeBlkAllocator::alloc_blks_direct(blk_count_t nblks, blk_alloc_
 
     if (m_start_portion_num == INVALID_PORTION_NUM) { m_start_portion_num = m_rand_portion_num_generator(re); }
 
+    // Start within the portions of desired temperature, if we are not there already, so that the other temperatures
+    // are searched only once all of them are exhausted.
+    auto const level = temp_to_level(hints.desired_temp);
+    if ((level != 0) && (portion_temperature(m_start_portion_num) != level)) {
+        m_start_portion_num = first_portion_of_temperature(level);
+    }
+
     auto portion_num = m_start_portion_num;
     // save m_start_portion_num to local variable as m_start_portion_num can be changed by other threads.
     auto start_portion_num = m_start_portion_num;
@@ -592,13 +778,20 @@ blk_count_t VarsizeBlkAllocator::alloc_blks_direct(blk_count_t nblks, blk_alloc_
         BlkAllocPortion& portion = get_blk_portion(portion_num);
         auto cur_blk_id = portion_num * get_blks_per_portion();
         auto const end_blk_id = cur_blk_id + get_blks_per_portion() - 1;
-        {
+        auto const portion_min_blks = std::min(min_blks, nblks_remain);
+        if (portion.may_have_free_run(portion_min_blks)) {
             auto lock{portion.portion_auto_lock()};
             while (nblks_remain && (cur_blk_id <= end_blk_id) && out_blkid.has_room()) {
                 // Get next reset bits and insert to cache and then reset those bits
                 auto const b = m_cache_bm->get_next_contiguous_n_reset_bits(
                     cur_blk_id, end_blk_id, std::min(min_blks, nblks_remain), nblks_remain);
-                if (b.nbits == 0) { break; }
+                if (b.nbits == 0) {
+                    // Every run skipped in this portion is shorter than what we started with, the ones found were
+                    // consumed from their start and their trailing parts are scanned after that.
+                    portion.set_max_free_run(portion_min_blks - 1);
+                    m_free_run_tree->update(portion_num, portion_min_blks - 1);
+                    break;
+                }
                 HS_DBG_ASSERT_GE(end_blk_id, b.start_bit, "Expected start bit to be smaller than end bit");
                 HS_DBG_ASSERT_LE(b.nbits, nblks_remain);
                 HS_DBG_ASSERT_GE(b.nbits, std::min(min_blks, nblks_remain));
@@ -618,7 +811,7 @@ blk_count_t VarsizeBlkAllocator::alloc_blks_direct(blk_count_t nblks, blk_alloc_
         }
         if (nblks_remain) {
             auto curr_portion = portion_num;
-            if (++portion_num == get_num_portions()) { portion_num = 0; }
+            portion_num = next_candidate_portion(portion_num, start_portion_num, std::min(min_blks, nblks_remain));
             BLKALLOC_LOG(
                 TRACE, "alloc direct unable to find in curr portion {}, will searching in portion={}, start_portion={},continue={}, out_blkid num_pieces={} , max_pieces={}",
                 curr_portion, portion_num, start_portion_num, hints.is_contiguous, out_blkid.num_pieces(), max_pieces);
@@ -632,6 +825,36 @@ blk_count_t VarsizeBlkAllocator::alloc_blks_direct(blk_count_t nblks, blk_alloc_
     return (nblks - nblks_remain);
 }
 
+blk_temp_t VarsizeBlkAllocator::temp_to_level(blk_temp_t desired_temp) const {
+    // Level 0 of the blk cache is for reuse of freed blks and is what callers who don't care about temperature get
+    return (desired_temp == 0) ? 0 : std::min(desired_temp, m_num_temperatures);
+}
+
+blk_temp_t VarsizeBlkAllocator::portion_temperature(blk_num_t portion_num) const {
+    auto const temp = s_cast< uint64_t >(portion_num) * m_num_temperatures / get_num_portions();
+    return s_cast< blk_temp_t >(temp + 1);
+}
+
+blk_num_t VarsizeBlkAllocator::first_portion_of_temperature(blk_temp_t temp) const {
+    // Inverse of portion_temperature(), rounded up to the first portion which maps to this temperature
+    auto const n = s_cast< uint64_t >(temp - 1) * get_num_portions();
+    return std::min(s_cast< blk_num_t >((n + m_num_temperatures - 1) / m_num_temperatures), get_num_portions() - 1);
+}
+
+// Jump to the next portion, in the circular order from start_portion, which could have a run of nblks. If there is
+// none, start_portion is returned to indicate the search is complete.
+blk_num_t VarsizeBlkAllocator::next_candidate_portion(blk_num_t cur_portion, blk_num_t start_portion,
+                                                      blk_num_t nblks) const {
+    blk_num_t next{FreeRunTree::npos};
+    if (cur_portion >= start_portion) {
+        next = m_free_run_tree->find_first(cur_portion + 1, get_num_portions(), nblks);
+        if (next == FreeRunTree::npos) { next = m_free_run_tree->find_first(0, start_portion, nblks); }
+    } else {
+        next = m_free_run_tree->find_first(cur_portion + 1, start_portion, nblks);
+    }
+    return (next == FreeRunTree::npos) ? start_portion : next;
+}
+
 // since this function will only be called during HS recovery, we can safe to update the cache bitmap directly without
 // touching the slab caches.
 BlkAllocStatus VarsizeBlkAllocator::reserve_on_cache(BlkId const& bid) {
@@ -654,6 +877,7 @@ BlkAllocStatus VarsizeBlkAllocator::reserve_on_cache(BlkId const& bid) {
 }
 
 void VarsizeBlkAllocator::free(BlkId const& bid) {
+    HS_CPU_SCOPE(BLKALLOC);
     blk_count_t n_freed = (m_cfg.m_use_slabs && (bid.blk_count() <= m_cfg.highest_slab_blks_count()))
         ? free_blks_slab(r_cast< MultiBlkId const& >(bid))
         : free_blks_direct(r_cast< MultiBlkId const& >(bid));
@@ -668,7 +892,9 @@ blk_count_t VarsizeBlkAllocator::free_blks_slab(MultiBlkId const& bid) {
     excess_blks.clear();
 
     auto const do_free = [this](BlkId const& b) {
-        m_fb_cache->try_free_blks(blkid_to_blk_cache_entry(b, 2), excess_blks);
+        // Freed blks go back to the temperature of their portion, so that the space stays with similar data
+        m_fb_cache->try_free_blks(blkid_to_blk_cache_entry(b, blknum_to_portion(b.blk_num()).temperature()),
+                                  excess_blks);
         return b.blk_count();
     };
 
@@ -702,6 +928,8 @@ blk_count_t VarsizeBlkAllocator::free_blks_direct(MultiBlkId const& bid) {
                              "Expected end bit to be smaller than portion end bit");
             BLKALLOC_REL_ASSERT(m_cache_bm->is_bits_set(b.blk_num(), b.blk_count()), "Expected bits to be set");
             m_cache_bm->reset_bits(b.blk_num(), b.blk_count());
+            portion.on_blks_freed(b.blk_count());
+            m_free_run_tree->update(portion.get_portion_num(), portion.max_free_run());
         }
         BLKALLOC_LOG(TRACE, "Freeing directly to portion={} blkid={} set_bits_count={}",
                      blknum_to_portion_num(b.blk_num()), b.to_string(), get_alloced_blk_count());
@@ -33,8 +33,10 @@
 #include <sisl/logging/logging.h>
 
 #include <homestore/blk.h>
+#include <homestore/superblk_handler.hpp>
 #include "bitmap_blk_allocator.h"
 #include "blk_cache.h"
+#include "free_run_tree.h"
 #include "common/homestore_assert.hpp"
 #include "common/homestore_config.hpp"
 
@@ -178,6 +180,7 @@ public:
         REGISTER_COUNTER(num_alloc_partial, "Number of blk alloc partial allocations");
         REGISTER_COUNTER(num_retries, "Number of times it retried because of empty cache");
         REGISTER_COUNTER(num_blks_alloc_direct, "Number of blks alloc attempt directly because of empty cache");
+        REGISTER_COUNTER(num_proactive_sweeps, "Number of sweeps scheduled as a slab was predicted to run dry");
 
         REGISTER_HISTOGRAM(frag_pct_distribution, "Distribution of fragmentation percentage",
                            HistogramBucketsType(LinearUpto64Buckets));
@@ -192,6 +195,21 @@ public:
     ~BlkAllocMetrics() { deregister_me_from_farm(); }
 };
 
+static constexpr uint64_t blk_cache_snapshot_magic{0xd0d0cac4e};
+static constexpr uint32_t blk_cache_snapshot_version{0x1};
+
+// Entries of the free blk cache as of the last CP, used to warm up the cache after restart without sweeping
+#pragma pack(1)
+struct blk_cache_snapshot_t {
+    uint64_t magic{blk_cache_snapshot_magic};
+    uint32_t version{blk_cache_snapshot_version};
+    uint32_t num_entries{0};
+
+    static uint32_t size(uint32_t n) { return sizeof(blk_cache_snapshot_t) + n * sizeof(blk_cache_entry); }
+    blk_cache_entry* entries() { return r_cast< blk_cache_entry* >(this + 1); }
+};
+#pragma pack()
+
 /* VarsizeBlkAllocator provides a flexibility in allocation. It provides following features:
  *
  * 1. Could allocate variable number of blks in single allocation
@@ -209,6 +227,8 @@ public:
     virtual ~VarsizeBlkAllocator();
 
     void load() override;
+    void cp_flush(CP* cp) override;
+    void recovery_completed() override;
 
     BlkAllocStatus alloc_contiguous(BlkId& bid) override;
     BlkAllocStatus alloc_contiguous(blk_count_t nblks, blk_alloc_hints const& hints, BlkId& out_blkid);
@@ -244,6 +264,7 @@ private:
 
     std::unique_ptr< sisl::Bitset > m_cache_bm; // Bitset representing entire blks in this allocator
     std::unique_ptr< FreeBlkCache > m_fb_cache; // Free Blks cache
+    std::unique_ptr< FreeRunTree > m_free_run_tree; // Summary of free run of all portions to find candidate portion
 
     VarsizeBlkAllocConfig m_cfg; // Config for Varsize
 
@@ -260,11 +281,20 @@ private:
 
     blk_num_t m_blks_per_seg{1};
     blk_num_t m_portions_per_seg{1};
+    blk_temp_t m_num_temperatures{1};
+
+    superblk< blk_cache_snapshot_t > m_snapshot_sb;   // Snapshot of the free blk cache persisted on cp
+    std::vector< blk_cache_entry > m_snapshot_entries; // Entries of the snapshot loaded, yet to be put in the cache
+    std::atomic< bool > m_snapshot_pending{false};     // Is there a loaded snapshot to be put in the cache
+    std::mutex m_snapshot_mtx;
 
 private:
     static void sweeper_thread(size_t thread_num);
     bool allocator_state_machine();
     void do_start();
+    void on_snapshot_found(sisl::byte_view const& buf, void* meta_cookie);
+    void persist_cache_snapshot();
+    void apply_cache_snapshot();
 
     blk_count_t alloc_blks_slab(blk_count_t nblks, blk_alloc_hints const& hints, MultiBlkId& out_blkid);
     blk_count_t alloc_blks_direct(blk_count_t nblks, blk_alloc_hints const& hints, MultiBlkId& out_blkids);
@@ -284,6 +314,10 @@ private:
     void fill_cache_in_portion(blk_num_t portion_num, blk_cache_fill_session& fill_session);
 
     void free_on_bitmap(BlkId const& b);
+    blk_temp_t temp_to_level(blk_temp_t desired_temp) const;
+    blk_temp_t portion_temperature(blk_num_t portion_num) const;
+    blk_num_t first_portion_of_temperature(blk_temp_t temp) const;
+    blk_num_t next_candidate_portion(blk_num_t cur_portion, blk_num_t start_portion, blk_num_t nblks) const;
 
     //////////////////////////////////////////// Convenience routines ///////////////////////////////////////////
     ///////////////////// Physical page related routines ////////////////////////
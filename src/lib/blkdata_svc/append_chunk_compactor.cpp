@@ -0,0 +1,197 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <thread>
+
+#include <homestore/homestore.hpp>
+#include <homestore/checkpoint/cp_mgr.hpp>
+
+#include "device/chunk.h"
+#include "device/virtual_dev.hpp"
+#include "blkalloc/append_blk_allocator.h"
+#include "common/homestore_config.hpp"
+#include "common/homestore_assert.hpp"
+#include "common/homestore_utils.hpp"
+#include "blk_read_cache.hpp"
+#include "append_chunk_compactor.hpp"
+
+namespace homestore {
+
+static AppendBlkAllocator* append_allocator(shared< Chunk > const& chunk) {
+    return static_cast< AppendBlkAllocator* >(chunk->blk_allocator_mutable());
+}
+
+AppendChunkCompactor::AppendChunkCompactor(BlkDataService& data_svc, shared< VirtualDev > vdev) :
+        m_data_svc{data_svc}, m_vdev{std::move(vdev)}, m_blk_size{m_vdev->block_size()} {}
+
+uint64_t AppendChunkCompactor::run(live_blks_cb_t const& live_cb, relocate_blk_cb_t const& relocate_cb) {
+    if (m_vdev->info().alloc_type != blk_allocator_type_t::append) {
+        LOGWARN("Compaction is supported only on append blk allocator, vdev={} uses {}", m_vdev->info().name,
+                enum_name(m_vdev->info().alloc_type));
+        return 0;
+    }
+
+    m_throttle_start = std::chrono::steady_clock::now();
+    m_throttled_bytes = 0;
+
+    uint64_t reclaimed_blks{0};
+    for (auto const& chunk : select_victims()) {
+        reclaimed_blks += compact_chunk(chunk, live_cb, relocate_cb);
+    }
+    return reclaimed_blks;
+}
+
+std::vector< shared< Chunk > > AppendChunkCompactor::select_victims() const {
+    auto const min_freeable_pct = HS_DYNAMIC_CONFIG(blkallocator.append_gc_min_freeable_pct);
+    auto const max_victims = HS_DYNAMIC_CONFIG(blkallocator.append_gc_max_victims_per_run);
+
+    std::vector< std::pair< double, shared< Chunk > > > candidates;
+    for (auto const& [_, chunk] : m_vdev->get_chunks()) {
+        auto const ba = append_allocator(chunk);
+        auto const used_blks = ba->get_used_blks();
+        if ((used_blks == 0) || ba->is_sealed()) { continue; }
+
+        auto const freeable_pct = (100.0 * ba->get_defrag_nblks()) / used_blks;
+        if (freeable_pct >= min_freeable_pct) { candidates.emplace_back(freeable_pct, chunk); }
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+              [](auto const& a, auto const& b) { return a.first > b.first; });
+
+    std::vector< shared< Chunk > > victims;
+    for (auto& [pct, chunk] : candidates) {
+        if (victims.size() >= max_victims) { break; }
+        LOGINFO("Picked chunk={} of vdev={} for compaction, freeable_pct={:.2f}", chunk->chunk_id(),
+                m_vdev->info().name, pct);
+        victims.emplace_back(std::move(chunk));
+    }
+    return victims;
+}
+
+uint64_t AppendChunkCompactor::compact_chunk(shared< Chunk > const& chunk, live_blks_cb_t const& live_cb,
+                                             relocate_blk_cb_t const& relocate_cb) {
+    auto ba = append_allocator(chunk);
+    ba->seal();
+
+    auto const live_blks = live_cb(chunk->chunk_id());
+    uint64_t live_nblks{0};
+    uint8_t* buf{nullptr};
+    uint32_t buf_size{0};
+    bool failed{false};
+
+    for (auto const& from : live_blks) {
+        HS_REL_ASSERT_EQ(from.chunk_num(), chunk->chunk_id(), "Live blkid={} is not part of the chunk compacted",
+                         from.to_string());
+        auto const size = from.blk_count() * m_blk_size;
+        if (size > buf_size) {
+            if (buf) { hs_utils::iobuf_free(buf, sisl::buftag::common); }
+            buf = hs_utils::iobuf_alloc(size, sisl::buftag::common, m_vdev->align_size());
+            buf_size = size;
+        }
+
+        MultiBlkId to;
+        if (auto const err = relocate_blk(from, buf, to); err) {
+            LOGERROR("Compaction of chunk={} aborted, failed to relocate blkid={}, error={}", chunk->chunk_id(),
+                     from.to_string(), err.message());
+            failed = true;
+            break;
+        }
+        relocate_cb(from, to);
+        live_nblks += from.blk_count();
+        throttle(size);
+    }
+    if (buf) { hs_utils::iobuf_free(buf, sisl::buftag::common); }
+
+    if (failed) {
+        // Whatever is relocated so far is still valid, chunk will get to be compacted again in next run
+        ba->unseal();
+        return 0;
+    }
+
+    // Relocated blks have to be committed and the consumer mapping to be persisted before the reset of the chunk is
+    // persisted, which the forced cp takes care of.
+    hs()->cp_mgr().trigger_cp_flush(true /* force */).get();
+
+    // Wait for any reads which were issued on the live blks before they got relocated
+    for (auto const& from : live_blks) {
+        folly::Promise< folly::Unit > p;
+        auto f = p.getFuture();
+        m_data_svc.wait_for_pending_reads(MultiBlkId{from}, [&p]() { p.setValue(); });
+        std::move(f).get();
+    }
+
+    // Zones of the chunk on a zoned drive have to be reset, for the chunk to be written from its start again
+    auto* pdev = chunk->physical_dev_mutable();
+    if (pdev->is_zoned()) {
+        if (auto const err = pdev->reset_zones(chunk->size(), chunk->start_offset()); err) {
+            LOGERROR("Compaction of chunk={} aborted, failed to reset its zones, error={}", chunk->chunk_id(),
+                     err.message());
+            ba->unseal();
+            return 0;
+        }
+    }
+
+    auto const used_blks = ba->get_used_blks();
+    m_data_svc.invalidate_read_cache(chunk->chunk_id());
+    ba->reset();
+    ba->unseal();
+
+    auto const reclaimed_blks = (used_blks > live_nblks) ? (used_blks - live_nblks) : 0;
+    LOGINFO("Compacted chunk={} of vdev={}, relocated live_blks={} reclaimed_blks={}", chunk->chunk_id(),
+            m_vdev->info().name, live_nblks, reclaimed_blks);
+    return reclaimed_blks;
+}
+
+std::error_code AppendChunkCompactor::relocate_blk(BlkId const& from, uint8_t* buf, MultiBlkId& to) {
+    auto const size = from.blk_count() * m_blk_size;
+    if (auto const err = m_vdev->sync_read(r_cast< char* >(buf), size, from); err) { return err; }
+
+    // Victim is sealed, so the allocation will land on some other chunk
+    blk_alloc_hints hints;
+    if (m_vdev->alloc_blks(from.blk_count(), hints, to) != BlkAllocStatus::SUCCESS) {
+        return std::make_error_code(std::errc::no_space_on_device);
+    }
+
+    auto it = to.iterate();
+    uint8_t* cur_buf = buf;
+    while (auto const bid = it.next()) {
+        auto const piece_size = bid->blk_count() * m_blk_size;
+        if (auto const err = m_vdev->sync_write(r_cast< char const* >(cur_buf), piece_size, *bid); err) {
+            m_vdev->free_blk(to);
+            return err;
+        }
+        // Prefetch could have cached what was in the blks before this write
+        if (auto* cache = m_data_svc.read_cache(); cache != nullptr) { cache->invalidate(*bid); }
+        cur_buf += piece_size;
+    }
+
+    m_data_svc.commit_blk(to);
+    return std::error_code{};
+}
+
+void AppendChunkCompactor::throttle(uint64_t bytes_copied) {
+    auto const max_mbps = HS_DYNAMIC_CONFIG(blkallocator.append_gc_max_bandwidth_mbps);
+    if (max_mbps == 0) { return; }
+
+    // Sleep off whatever time copying got ahead of the allowed bandwidth since the start of this run
+    m_throttled_bytes += bytes_copied;
+    auto const expected = std::chrono::microseconds{(m_throttled_bytes * 1'000'000) / (uint64_cast(max_mbps) << 20)};
+    auto const elapsed =
+        std::chrono::duration_cast< std::chrono::microseconds >(std::chrono::steady_clock::now() - m_throttle_start);
+    if (expected > elapsed) { std::this_thread::sleep_for(expected - elapsed); }
+}
+
+} // namespace homestore
@@ -0,0 +1,66 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <homestore/blkdata_service.hpp>
+#include <homestore/homestore_decl.hpp>
+
+namespace homestore {
+class VirtualDev;
+class Chunk;
+class AppendBlkAllocator;
+
+/*
+ * AppendChunkCompactor: reclaims the freed space of append blk allocator chunks, which otherwise is only reusable
+ * once the whole chunk is freed. The chunks with highest ratio of freed blks to used blks are picked as victims and
+ * for each victim
+ *
+ * 1. The chunk is sealed, so no new blks are allocated on it.
+ * 2. The live blks of the chunk, as identified by the consumer, are copied to blks allocated on other chunks at a
+ *    throttled rate and the consumer is notified of each relocation to repoint its mapping.
+ * 3. A CP is forced so that the relocated blks are committed on disk, then the chunk is reset and unsealed once all
+ *    reads of its blks are done.
+ *
+ * Consumer is expected to not issue any new reads or frees on a relocated blk and to persist its mapping on or before
+ * the CP forced in step 3. Runs synchronously and hence it should not be called on a reactor thread.
+ */
+class AppendChunkCompactor {
+public:
+    AppendChunkCompactor(BlkDataService& data_svc, shared< VirtualDev > vdev);
+
+    /// @brief Compacts the most fragmented chunks, as allowed by the blkallocator.append_gc_* settings.
+    /// @return Number of blks reclaimed
+    uint64_t run(live_blks_cb_t const& live_cb, relocate_blk_cb_t const& relocate_cb);
+
+private:
+    std::vector< shared< Chunk > > select_victims() const;
+    uint64_t compact_chunk(shared< Chunk > const& chunk, live_blks_cb_t const& live_cb,
+                           relocate_blk_cb_t const& relocate_cb);
+    std::error_code relocate_blk(BlkId const& from, uint8_t* buf, MultiBlkId& to);
+    void throttle(uint64_t bytes_copied);
+
+private:
+    BlkDataService& m_data_svc;
+    shared< VirtualDev > m_vdev;
+    uint32_t m_blk_size;
+    std::chrono::steady_clock::time_point m_throttle_start;
+    uint64_t m_throttled_bytes{0};
+};
+
+} // namespace homestore
@@ -0,0 +1,309 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <cstring>
+
+#include "blk_read_cache.hpp"
+
+namespace homestore {
+
+BlkReadCache::BlkReadCache(uint64_t capacity, uint32_t blk_size, uint32_t max_entry_size, mem_change_cb_t mem_cb) :
+        m_capacity{capacity},
+        m_shard_capacity{capacity / s_num_shards},
+        m_blk_size{blk_size},
+        m_max_entry_size{std::min(max_entry_size, s_cast< uint32_t >(capacity / s_num_shards))},
+        m_mem_cb{std::move(mem_cb)} {}
+
+BlkReadCache::~BlkReadCache() {
+    auto const sz = m_size.load(std::memory_order_relaxed);
+    if (m_mem_cb && (sz != 0)) { m_mem_cb(-int64_cast(sz)); }
+}
+
+BlkReadCache::shard& BlkReadCache::shard_of(chunk_num_t chunk_num, uint64_t range) {
+    return m_shards[((uint64_cast(chunk_num) * 0x9E3779B97F4A7C15ull) ^ range) % s_num_shards];
+}
+
+bool BlkReadCache::is_cacheable(BlkId const& bid, uint32_t size) const {
+    auto const nbytes = uint64_cast(bid.blk_count()) * m_blk_size;
+    return (bid.blk_count() != 0) && (size == nbytes) && (size <= m_max_entry_size) &&
+        (range_of(bid) == ((uint64_cast(bid.blk_num()) + bid.blk_count() - 1) / s_range_blks));
+}
+
+bool BlkReadCache::read(BlkId const& bid, uint8_t* buf, uint32_t size) {
+    if ((bid.blk_count() == 0) || (size > uint64_cast(bid.blk_count()) * m_blk_size)) { return false; }
+
+    auto& s = shard_of(bid.chunk_num(), range_of(bid));
+    {
+        std::unique_lock lg{s.mtx};
+        if (auto const e = lookup(s, bid); e != nullptr) {
+            auto const offset = uint64_cast(bid.blk_num() - s_cast< blk_num_t >(e->key)) * m_blk_size;
+            std::memcpy(buf, e->data.get() + offset, size);
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool BlkReadCache::read(BlkId const& bid, sisl::sg_iovs_t const& iovs, uint32_t size) {
+    if ((bid.blk_count() == 0) || (size > uint64_cast(bid.blk_count()) * m_blk_size)) { return false; }
+
+    auto& s = shard_of(bid.chunk_num(), range_of(bid));
+    {
+        std::unique_lock lg{s.mtx};
+        if (auto const e = lookup(s, bid); e != nullptr) {
+            uint8_t const* src = e->data.get() + uint64_cast(bid.blk_num() - s_cast< blk_num_t >(e->key)) * m_blk_size;
+            uint64_t remain{size};
+            for (auto const& iov : iovs) {
+                if (remain == 0) { break; }
+                auto const len = std::min(remain, uint64_cast(iov.iov_len));
+                std::memcpy(iov.iov_base, src, len);
+                src += len;
+                remain -= len;
+            }
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void BlkReadCache::insert(BlkId const& bid, uint8_t const* buf, uint32_t size) {
+    if (!is_cacheable(bid, size)) { return; }
+
+    auto& s = shard_of(bid.chunk_num(), range_of(bid));
+    std::unique_lock lg{s.mtx};
+    if (auto const e = add(s, bid); e != nullptr) {
+        std::memcpy(e->data.get(), buf, size);
+        evict(s);
+    }
+}
+
+void BlkReadCache::insert(BlkId const& bid, sisl::sg_iovs_t const& iovs, uint32_t size) {
+    if (!is_cacheable(bid, size)) { return; }
+
+    auto& s = shard_of(bid.chunk_num(), range_of(bid));
+    std::unique_lock lg{s.mtx};
+    if (auto const e = add(s, bid); e != nullptr) {
+        uint8_t* dst = e->data.get();
+        uint64_t remain{size};
+        for (auto const& iov : iovs) {
+            if (remain == 0) { break; }
+            auto const len = std::min(remain, uint64_cast(iov.iov_len));
+            std::memcpy(dst, iov.iov_base, len);
+            dst += len;
+            remain -= len;
+        }
+        evict(s);
+    }
+}
+
+bool BlkReadCache::begin_fill(BlkId const& bid) {
+    if (!is_cacheable(bid, bid.blk_count() * m_blk_size)) { return false; }
+
+    auto const start = to_key(bid.chunk_num(), bid.blk_num());
+    auto const end = start + bid.blk_count();
+    auto& s = shard_of(bid.chunk_num(), range_of(bid));
+    std::unique_lock lg{s.mtx};
+    if (find(s, bid) != nullptr) { return false; }
+
+    auto it = s.fills.lower_bound(start);
+    if ((it != s.fills.end()) && (it->first < end)) { return false; }
+    if ((it != s.fills.begin()) && (std::prev(it)->first + std::prev(it)->second.nblks > start)) { return false; }
+    s.fills.emplace_hint(it, start, fill{.nblks = bid.blk_count()});
+    return true;
+}
+
+void BlkReadCache::end_fill(BlkId const& bid, uint8_t const* buf) {
+    auto& s = shard_of(bid.chunk_num(), range_of(bid));
+    std::unique_lock lg{s.mtx};
+    auto it = s.fills.find(to_key(bid.chunk_num(), bid.blk_num()));
+    if (it == s.fills.end()) { return; }
+    bool const dropped = it->second.dropped;
+    s.fills.erase(it);
+    if (dropped || (buf == nullptr)) { return; }
+
+    if (auto const e = add(s, bid); e != nullptr) {
+        std::memcpy(e->data.get(), buf, entry_size(*e));
+        evict(s);
+    }
+}
+
+void BlkReadCache::invalidate(BlkId const& bid) {
+    if (bid.blk_count() == 0) { return; }
+
+    auto const start = to_key(bid.chunk_num(), bid.blk_num());
+    auto const end = start + bid.blk_count();
+    auto const last_range = (uint64_cast(bid.blk_num()) + bid.blk_count() - 1) / s_range_blks;
+    for (auto r = range_of(bid); r <= last_range; ++r) {
+        auto& s = shard_of(bid.chunk_num(), r);
+        std::unique_lock lg{s.mtx};
+
+        // Entry starting before the blkid could still extend into it
+        auto it = s.index.lower_bound(start);
+        if (it != s.index.begin()) {
+            auto const prev = std::prev(it);
+            if (prev->first + prev->second->nblks > start) { remove(s, prev); }
+        }
+        while ((it != s.index.end()) && (it->first < end)) {
+            auto const next = std::next(it);
+            remove(s, it);
+            it = next;
+        }
+        drop_fills(s, start, end);
+    }
+}
+
+void BlkReadCache::invalidate_chunk(chunk_num_t chunk_num) {
+    auto const start = to_key(chunk_num, 0);
+    auto const end = start + max_blks_per_chunk();
+    for (auto& s : m_shards) {
+        std::unique_lock lg{s.mtx};
+        auto it = s.index.lower_bound(start);
+        while ((it != s.index.end()) && (it->first < end)) {
+            auto const next = std::next(it);
+            remove(s, it);
+            it = next;
+        }
+        drop_fills(s, start, end);
+    }
+}
+
+void BlkReadCache::drop_fills(shard& s, uint64_t start, uint64_t end) {
+    auto it = s.fills.lower_bound(start);
+    if ((it != s.fills.begin()) && (std::prev(it)->first + std::prev(it)->second.nblks > start)) {
+        std::prev(it)->second.dropped = true;
+    }
+    for (; (it != s.fills.end()) && (it->first < end); ++it) {
+        it->second.dropped = true;
+    }
+}
+
+BlkReadCache::entry* BlkReadCache::find(shard& s, BlkId const& bid) {
+    auto const key = to_key(bid.chunk_num(), bid.blk_num());
+    auto it = s.index.upper_bound(key);
+    if (it == s.index.begin()) { return nullptr; }
+    --it;
+
+    auto& e = *(it->second);
+    if (((it->first >> 32) != bid.chunk_num()) || (it->first + e.nblks < key + bid.blk_count())) { return nullptr; }
+    return &e;
+}
+
+BlkReadCache::entry* BlkReadCache::lookup(shard& s, BlkId const& bid) {
+    auto const e = find(s, bid);
+    if ((e != nullptr) && (e->freq < s_max_freq)) { ++e->freq; }
+    return e;
+}
+
+BlkReadCache::entry* BlkReadCache::add(shard& s, BlkId const& bid) {
+    auto const key = to_key(bid.chunk_num(), bid.blk_num());
+    auto const end = key + bid.blk_count();
+
+    // Concurrent reads of the same blks might have already cached it, else drop whatever overlaps with it
+    auto it = s.index.lower_bound(key);
+    if ((it != s.index.end()) && (it->first == key) && (it->second->nblks == bid.blk_count())) { return nullptr; }
+    if (it != s.index.begin()) {
+        auto const prev = std::prev(it);
+        if (prev->first + prev->second->nblks > key) { remove(s, prev); }
+    }
+    while ((it != s.index.end()) && (it->first < end)) {
+        auto const next = std::next(it);
+        remove(s, it);
+        it = next;
+    }
+
+    // Recently evicted from small queue and read again, so it is likely hot
+    bool const to_main = (s.ghost.erase(key) != 0);
+    auto& q = to_main ? s.main : s.small;
+    q.push_front(entry{.key = key,
+                       .nblks = bid.blk_count(),
+                       .freq = 0,
+                       .in_main = to_main,
+                       .data = std::make_unique< uint8_t[] >(uint64_cast(bid.blk_count()) * m_blk_size)});
+    s.index.emplace(key, q.begin());
+
+    auto const sz = entry_size(q.front());
+    (to_main ? s.main_size : s.small_size) += sz;
+    account(int64_cast(sz));
+    return &q.front();
+}
+
+void BlkReadCache::remove(shard& s, std::map< uint64_t, entry_list_t::iterator >::iterator it) {
+    auto const lit = it->second;
+    auto const sz = entry_size(*lit);
+    if (lit->in_main) {
+        s.main_size -= sz;
+        s.main.erase(lit);
+    } else {
+        s.small_size -= sz;
+        s.small.erase(lit);
+    }
+    s.index.erase(it);
+    account(-int64_cast(sz));
+}
+
+void BlkReadCache::evict(shard& s) {
+    while ((s.small_size + s.main_size) > m_shard_capacity) {
+        if ((s.small_size > m_shard_capacity / 10) || s.main.empty()) {
+            if (s.small.empty()) { break; }
+            auto& e = s.small.back();
+            if (e.freq > 0) {
+                // Read again since it was inserted, promote it to main queue
+                auto const sz = entry_size(e);
+                e.freq = 0;
+                e.in_main = true;
+                s.main.splice(s.main.begin(), s.small, std::prev(s.small.end()));
+                s.small_size -= sz;
+                s.main_size += sz;
+            } else {
+                auto const key = e.key;
+                remove(s, s.index.find(key));
+                add_ghost(s, key);
+            }
+        } else {
+            auto& e = s.main.back();
+            if (e.freq > 0) {
+                --e.freq;
+                s.main.splice(s.main.begin(), s.main, std::prev(s.main.end()));
+            } else {
+                remove(s, s.index.find(e.key));
+            }
+        }
+    }
+}
+
+void BlkReadCache::add_ghost(shard& s, uint64_t key) {
+    if (!s.ghost.insert(key).second) { return; }
+    s.ghost_fifo.push_back(key);
+
+    // Remember as many evicted keys as there are entries cached. A key which is promoted from ghost stays in the fifo,
+    // which at worst makes its later ghost entry to be forgotten sooner.
+    auto const max_ghosts = std::max< size_t >(s.index.size(), 1);
+    while (s.ghost_fifo.size() > max_ghosts) {
+        s.ghost.erase(s.ghost_fifo.front());
+        s.ghost_fifo.pop_front();
+    }
+}
+
+void BlkReadCache::account(int64_t bytes) {
+    m_size.fetch_add(bytes, std::memory_order_relaxed);
+    if (m_mem_cb) { m_mem_cb(bytes); }
+}
+
+} // namespace homestore
@@ -0,0 +1,159 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+#include <sisl/fds/buffer.hpp>
+#include <homestore/blk.h>
+
+namespace homestore {
+
+/*
+ * Memory bounded cache of the data of recently read blkids, keyed by the chunk and blk num of each cached blkid. A
+ * read is served from the cache if a cached blkid covers all of its blks.
+ *
+ * Eviction is S3-FIFO: a new entry goes to a small fifo queue (10% of capacity) and is moved to the main fifo queue
+ * only if it is read again before it reaches the tail of the small queue, so that one time reads do not wash out the
+ * hot blks. Keys evicted from the small queue are remembered in a ghost queue and if read again soon after, they are
+ * directly inserted into the main queue. Entries in the main queue are reinserted at the head as long as they are
+ * read again, else they are evicted.
+ *
+ * Cache is split into shards by chunk and a range of blks, each shard with its own lock, queues and its share of the
+ * capacity. An entry never spans across two ranges, so every lookup goes to exactly one shard.
+ *
+ * Entries have to be invalidated before the blks are freed, there is no other check for staleness.
+ */
+class BlkReadCache {
+public:
+    // Called with the bytes added (positive) or released (negative) by the cache
+    using mem_change_cb_t = std::function< void(int64_t) >;
+
+    BlkReadCache(uint64_t capacity, uint32_t blk_size, uint32_t max_entry_size, mem_change_cb_t mem_cb = nullptr);
+    BlkReadCache(const BlkReadCache&) = delete;
+    BlkReadCache& operator=(const BlkReadCache&) = delete;
+    BlkReadCache(BlkReadCache&&) noexcept = delete;
+    BlkReadCache& operator=(BlkReadCache&&) noexcept = delete;
+    ~BlkReadCache();
+
+    /**
+     * @brief : Copies the first size bytes of the blkid from the cache, if all its blks are cached.
+     *
+     * @return : true if it is a hit, false if caller has to read it from the device.
+     */
+    bool read(BlkId const& bid, uint8_t* buf, uint32_t size);
+    bool read(BlkId const& bid, sisl::sg_iovs_t const& iovs, uint32_t size);
+
+    /**
+     * @brief : Caches a copy of the data of a completed read of the whole blkid. As with read, size is the number of
+     * bytes of the read, which if it is not all of the blkid, it is not cached.
+     */
+    void insert(BlkId const& bid, uint8_t const* buf, uint32_t size);
+    void insert(BlkId const& bid, sisl::sg_iovs_t const& iovs, uint32_t size);
+
+    /**
+     * @brief : Reserves the blkid to be cached by a prefetch of it. If any of its blks are invalidated before the
+     * end_fill, it is not cached, so that a prefetch which races with a write of the blks never caches stale data.
+     *
+     * @return : false if it is not cacheable, already cached or being prefetched.
+     */
+    bool begin_fill(BlkId const& bid);
+
+    /// @brief : Caches the prefetched data of the blkid reserved by begin_fill, unless it was invalidated since.
+    /// nullptr buf only releases the reservation.
+    void end_fill(BlkId const& bid, uint8_t const* buf);
+
+    // Drops all the cached entries which overlap with the given blks, along with the prefetches of them in flight
+    void invalidate(BlkId const& bid);
+    void invalidate_chunk(chunk_num_t chunk_num);
+
+    uint64_t size() const { return m_size.load(std::memory_order_relaxed); }
+    uint64_t capacity() const { return m_capacity; }
+    uint64_t hits() const { return m_hits.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return m_misses.load(std::memory_order_relaxed); }
+    uint32_t max_entry_size() const { return m_max_entry_size; }
+
+private:
+    static constexpr uint32_t s_num_shards = 64;
+    static constexpr uint64_t s_range_blks = 64 * 1024; // Range of blks of a chunk which map to the same shard
+    static constexpr uint8_t s_max_freq = 3;
+
+    struct entry {
+        uint64_t key;
+        blk_count_t nblks;
+        uint8_t freq{0};
+        bool in_main{false};
+        std::unique_ptr< uint8_t[] > data;
+    };
+    using entry_list_t = std::list< entry >;
+
+    // Prefetch in flight, which is not cached once dropped
+    struct fill {
+        blk_count_t nblks;
+        bool dropped{false};
+    };
+
+    struct alignas(64) shard {
+        std::mutex mtx;
+        std::map< uint64_t, entry_list_t::iterator > index; // Ordered, to find the entries overlapping a blk range
+        std::map< uint64_t, fill > fills;
+        entry_list_t small;                                  // Head is front, evicted from back
+        entry_list_t main;
+        std::unordered_set< uint64_t > ghost;
+        std::deque< uint64_t > ghost_fifo;
+        uint64_t small_size{0};
+        uint64_t main_size{0};
+    };
+
+    static uint64_t to_key(chunk_num_t chunk_num, blk_num_t blk_num) {
+        return (uint64_cast(chunk_num) << 32) | uint64_cast(blk_num);
+    }
+    static uint64_t range_of(BlkId const& bid) { return bid.blk_num() / s_range_blks; }
+    shard& shard_of(chunk_num_t chunk_num, uint64_t range);
+    bool is_cacheable(BlkId const& bid, uint32_t size) const;
+
+    // Returns the entry which has all the blks of bid, touching it as a hit. Caller is expected to hold shard lock.
+    entry* lookup(shard& s, BlkId const& bid);
+    entry* find(shard& s, BlkId const& bid); // Same as lookup, without touching the entry
+    void drop_fills(shard& s, uint64_t start, uint64_t end);
+    entry* add(shard& s, BlkId const& bid);
+    void remove(shard& s, std::map< uint64_t, entry_list_t::iterator >::iterator it);
+    void evict(shard& s);
+    void add_ghost(shard& s, uint64_t key);
+    uint64_t entry_size(entry const& e) const { return uint64_cast(e.nblks) * m_blk_size; }
+    void account(int64_t bytes);
+
+private:
+    uint64_t const m_capacity;
+    uint64_t const m_shard_capacity;
+    uint32_t const m_blk_size;
+    uint32_t const m_max_entry_size;
+    mem_change_cb_t m_mem_cb;
+    std::array< shard, s_num_shards > m_shards;
+    std::atomic< uint64_t > m_size{0};
+    std::atomic< uint64_t > m_hits{0};
+    std::atomic< uint64_t > m_misses{0};
+};
+
+} // namespace homestore
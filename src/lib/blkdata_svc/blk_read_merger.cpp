@@ -0,0 +1,181 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <limits.h>
+#include <algorithm>
+#include <cstring>
+
+#include <homestore/homestore.hpp>
+#include "device/virtual_dev.hpp"
+#include "common/homestore_config.hpp"
+#include "common/homestore_assert.hpp"
+#include "common/homestore_utils.hpp"
+#include "blk_read_merger.hpp"
+
+namespace homestore {
+
+BlkReadMerger::BlkReadMerger(shared< VirtualDev > vdev, uint32_t blk_size) :
+        m_vdev{std::move(vdev)}, m_blk_size{blk_size} {}
+
+BlkReadMerger::~BlkReadMerger() { stop(); }
+
+void BlkReadMerger::start() {
+    auto const window_us = HS_DYNAMIC_CONFIG(generic.data_read_merge_window_us);
+    m_timer_hdl = iomanager.schedule_global_timer(
+        std::max(window_us / 2, 1u) * 1000ul, true /* recurring */, nullptr /* cookie */,
+        iomgr::reactor_regex::all_worker, [this](void*) { issue_if_due(); }, true /* wait_to_schedule */);
+    LOGINFO("Merging of adjacent data reads is enabled, window_us={}", window_us);
+}
+
+void BlkReadMerger::stop() {
+    if (m_timer_hdl != iomgr::null_timer_handle) {
+        iomanager.cancel_timer(m_timer_hdl, true /* wait */);
+        m_timer_hdl = iomgr::null_timer_handle;
+    }
+
+    std::vector< std::vector< pending_read > > pending;
+    {
+        std::unique_lock lg{m_mtx};
+        m_stopped = true;
+        for (auto& [chunk_num, c] : m_chunk_reads) {
+            if (!c.reads.empty()) { pending.emplace_back(std::move(c.reads)); }
+        }
+        m_chunk_reads.clear();
+    }
+    for (auto& reads : pending) {
+        issue(std::move(reads));
+    }
+}
+
+folly::Future< std::error_code > BlkReadMerger::read(BlkId const& bid, sisl::sg_iovs_t iovs) {
+    std::vector< pending_read > due;
+    folly::Future< std::error_code > f = folly::Future< std::error_code >::makeEmpty();
+    {
+        std::unique_lock lg{m_mtx};
+        if (m_stopped) {
+            lg.unlock();
+            return m_vdev->async_readv(iovs.data(), iovs.size(), bid.blk_count() * m_blk_size, bid);
+        }
+
+        auto& c = m_chunk_reads[bid.chunk_num()];
+        if (c.reads.empty()) { c.first_time = Clock::now(); }
+        c.reads.push_back(pending_read{.bid = bid, .iovs = std::move(iovs), .promise = {}});
+        f = c.reads.back().promise.getFuture();
+
+        // No point in holding the reads of the chunk any longer, once they make up a full merged read
+        c.nblks += bid.blk_count();
+        if (c.nblks * m_blk_size >= uint64_cast(HS_DYNAMIC_CONFIG(generic.data_read_merge_max_kb)) * 1024) {
+            due = std::move(c.reads);
+            c.reads.clear();
+            c.nblks = 0;
+        }
+    }
+
+    if (!due.empty()) { issue(std::move(due)); }
+    return f;
+}
+
+void BlkReadMerger::issue(std::vector< pending_read >&& reads) {
+    std::sort(reads.begin(), reads.end(), [](pending_read const& a, pending_read const& b) {
+        return a.bid.blk_num() < b.bid.blk_num();
+    });
+    auto const max_blks =
+        std::min(uint64_cast(HS_DYNAMIC_CONFIG(generic.data_read_merge_max_kb)) * 1024 / m_blk_size,
+                 uint64_cast(max_blks_per_blkid()));
+
+    // Reads are merged as long as each starts within or right after the range of the previous ones
+    std::vector< pending_read > run;
+    blk_num_t start_blk{0};
+    blk_num_t end_blk{0};
+    for (auto& r : reads) {
+        auto const r_end = r.bid.blk_num() + r.bid.blk_count();
+        if (!run.empty() && (r.bid.blk_num() <= end_blk) && (std::max(end_blk, r_end) - start_blk <= max_blks)) {
+            end_blk = std::max(end_blk, r_end);
+        } else {
+            if (!run.empty()) {
+                issue_merged(std::move(run), start_blk, end_blk);
+                run.clear();
+            }
+            start_blk = r.bid.blk_num();
+            end_blk = r_end;
+        }
+        run.push_back(std::move(r));
+    }
+    if (!run.empty()) { issue_merged(std::move(run), start_blk, end_blk); }
+}
+
+void BlkReadMerger::issue_merged(std::vector< pending_read >&& run, blk_num_t start_blk, blk_num_t end_blk) {
+    BlkId const span{start_blk, blk_count_t(end_blk - start_blk), run.front().bid.chunk_num()};
+    uint32_t const size = (end_blk - start_blk) * m_blk_size;
+
+    bool adjacent{true};
+    size_t niovs{0};
+    for (blk_num_t next{start_blk}; auto const& r : run) {
+        if (r.bid.blk_num() != next) { adjacent = false; }
+        next = r.bid.blk_num() + r.bid.blk_count();
+        niovs += r.iovs.size();
+    }
+
+    if (adjacent && (niovs <= IOV_MAX)) {
+        sisl::sg_iovs_t iovs;
+        iovs.reserve(niovs);
+        for (auto const& r : run) {
+            iovs.insert(iovs.end(), r.iovs.begin(), r.iovs.end());
+        }
+        m_vdev->async_readv(iovs.data(), iovs.size(), size, span)
+            .thenValue([run = std::move(run)](std::error_code ec) mutable {
+                for (auto& r : run) {
+                    r.promise.setValue(ec);
+                }
+            });
+        return;
+    }
+
+    // Overlapping reads, or too many iovs for one readv, are read into a buffer of the whole range and copied out
+    auto* buf = hs_utils::iobuf_alloc(size, sisl::buftag::common, m_vdev->align_size());
+    m_vdev->async_read(r_cast< char* >(buf), size, span)
+        .thenValue([this, buf, start_blk, run = std::move(run)](std::error_code ec) mutable {
+            for (auto& r : run) {
+                if (!ec) {
+                    auto const* src = buf + uint64_cast(r.bid.blk_num() - start_blk) * m_blk_size;
+                    for (auto const& iov : r.iovs) {
+                        std::memcpy(iov.iov_base, src, iov.iov_len);
+                        src += iov.iov_len;
+                    }
+                }
+                r.promise.setValue(ec);
+            }
+            hs_utils::iobuf_free(buf, sisl::buftag::common);
+        });
+}
+
+void BlkReadMerger::issue_if_due() {
+    auto const window_us = HS_DYNAMIC_CONFIG(generic.data_read_merge_window_us);
+    std::vector< std::vector< pending_read > > due;
+    {
+        std::unique_lock lg{m_mtx};
+        for (auto& [chunk_num, c] : m_chunk_reads) {
+            if (c.reads.empty() || (get_elapsed_time_us(c.first_time) < window_us)) { continue; }
+            due.emplace_back(std::move(c.reads));
+            c.reads.clear();
+            c.nblks = 0;
+        }
+    }
+    for (auto& reads : due) {
+        issue(std::move(reads));
+    }
+}
+
+} // namespace homestore
@@ -0,0 +1,84 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/futures/Future.h>
+#include <iomgr/iomgr.hpp>
+#include <sisl/fds/buffer.hpp>
+#include <homestore/blk.h>
+#include <homestore/homestore_decl.hpp>
+
+namespace homestore {
+class VirtualDev;
+
+/*
+ * BlkReadMerger: holds the device reads of a chunk for a short window, generic.data_read_merge_window_us, so that the
+ * reads of adjacent or overlapping blks which arrive within it, like a sequential read split across requests, are
+ * issued as one larger device read.
+ *
+ * Adjacent reads are read straight into the iovs of the callers by one readv. Overlapping ones are read into a buffer
+ * of the merged range, from which the range of each read is copied out. Pending reads of a chunk are issued right
+ * away, once they add up to generic.data_read_merge_max_kb.
+ */
+class BlkReadMerger {
+public:
+    BlkReadMerger(shared< VirtualDev > vdev, uint32_t blk_size);
+    BlkReadMerger(const BlkReadMerger&) = delete;
+    BlkReadMerger& operator=(const BlkReadMerger&) = delete;
+    BlkReadMerger(BlkReadMerger&&) noexcept = delete;
+    BlkReadMerger& operator=(BlkReadMerger&&) noexcept = delete;
+    ~BlkReadMerger();
+
+    void start();
+
+    /// @brief Stops the window timer and issues the reads pending in it.
+    void stop();
+
+    /// @brief Reads all of the blks of bid into the iovs, which have to be valid till the returned future completes.
+    folly::Future< std::error_code > read(BlkId const& bid, sisl::sg_iovs_t iovs);
+
+private:
+    struct pending_read {
+        BlkId bid;
+        sisl::sg_iovs_t iovs;
+        folly::Promise< std::error_code > promise;
+    };
+
+    struct chunk_reads {
+        std::vector< pending_read > reads;
+        uint64_t nblks{0};
+        Clock::time_point first_time;
+    };
+
+    void issue(std::vector< pending_read >&& reads);
+    void issue_merged(std::vector< pending_read >&& run, blk_num_t start_blk, blk_num_t end_blk);
+    void issue_if_due();
+
+private:
+    shared< VirtualDev > m_vdev;
+    uint32_t m_blk_size;
+
+    std::mutex m_mtx;
+    std::unordered_map< chunk_num_t, chunk_reads > m_chunk_reads; // Reads pending in the window of each chunk
+    bool m_stopped{false};                                         // Reads are issued right away once stopped
+    iomgr::timer_handle_t m_timer_hdl{iomgr::null_timer_handle};
+};
+
+} // namespace homestore
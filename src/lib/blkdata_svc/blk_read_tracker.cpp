@@ -18,12 +18,26 @@
 namespace homestore {
 static BlkId extract_key(const BlkTrackRecord& rec) { return rec.m_key; }
 
-BlkReadTracker::BlkReadTracker() : m_pending_reads_map(s_expected_num_records, extract_key, nullptr /* access_cb */) {}
+BlkReadTracker::Shard::Shard() :
+        m_pending_reads_map(s_expected_records_per_shard, extract_key, nullptr /* access_cb */) {}
+
+BlkReadTracker::BlkReadTracker() {
+    m_shards.reserve(s_num_shards);
+    for (uint32_t i{0}; i < s_num_shards; ++i) {
+        m_shards.emplace_back(std::make_unique< Shard >());
+    }
+}
 
 BlkReadTracker::~BlkReadTracker() = default;
 
 // BlkReadTrackerMetrics& BlkReadTracker::get_metrics() { return m_metrics; }
 
+sisl::SimpleHashMap< BlkId, BlkTrackRecord >& BlkReadTracker::pending_reads_map(const BlkId& base_blkid) {
+    auto const range = uint64_cast(base_blkid.blk_num() / entries_per_record()) / s_records_per_range;
+    auto const h = (range * 0x9E3779B97F4A7C15ull) ^ (uint64_cast(base_blkid.chunk_num()) * 0xC2B2AE3D27D4EB4Full);
+    return m_shards[(h >> 32) % s_num_shards]->m_pending_reads_map;
+}
+
 void BlkReadTracker::merge(const BlkId& blkid, int64_t new_ref_count,
                            const std::shared_ptr< blk_track_waiter >& waiter) {
     HS_DBG_ASSERT(new_ref_count ? waiter == nullptr : waiter != nullptr, "Invalid waiter");
@@ -36,18 +50,19 @@ void BlkReadTracker::merge(const BlkId& blkid, int64_t new_ref_count,
     // everything is aligned after this point, so we don't need to handle sub_range in a base blkid;
     while (cur_base_blk_num <= last_base_blk_num) {
         BlkId base_blkid{cur_base_blk_num, entries_per_record(), blkid.chunk_num()};
+        auto& pending_reads = pending_reads_map(base_blkid);
 
         if (new_ref_count > 0) {
             // This is an insert operation
-            m_pending_reads_map.upsert_or_delete(base_blkid,
-                                                 [&base_blkid, new_ref_count](BlkTrackRecord& rec, bool existing) {
-                                                     if (!existing) { rec.m_key = base_blkid; }
-                                                     rec.m_ref_cnt += new_ref_count;
-                                                     return false;
-                                                 });
+            pending_reads.upsert_or_delete(base_blkid,
+                                           [&base_blkid, new_ref_count](BlkTrackRecord& rec, bool existing) {
+                                               if (!existing) { rec.m_key = base_blkid; }
+                                               rec.m_ref_cnt += new_ref_count;
+                                               return false;
+                                           });
         } else if (new_ref_count < 0) {
             // This is a remove operation
-            m_pending_reads_map.upsert_or_delete(
+            pending_reads.upsert_or_delete(
                 base_blkid, [new_ref_count, &base_blkid](BlkTrackRecord& rec, bool existing) {
                     HS_DBG_ASSERT_EQ(existing, true, "Decrement a ref count (blk: {}) which does not exist in map",
                                      base_blkid.to_string());
@@ -56,7 +71,7 @@ void BlkReadTracker::merge(const BlkId& blkid, int64_t new_ref_count,
                 });
         } else {
             // this is wait_on operation
-            m_pending_reads_map.update(base_blkid, [&waiter_rescheduled, &waiter](BlkTrackRecord& rec) {
+            pending_reads.update(base_blkid, [&waiter_rescheduled, &waiter](BlkTrackRecord& rec) {
                 rec.m_waiters.push_back(waiter);
                 waiter_rescheduled = true;
             });
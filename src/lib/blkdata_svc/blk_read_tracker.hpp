@@ -14,6 +14,8 @@
  *********************************************************************************/
 #pragma once
 #include <functional>
+#include <memory>
+#include <vector>
 
 #include <folly/small_vector.h>
 #include <sisl/cache/simple_hashmap.hpp>
@@ -109,11 +111,20 @@ public:
 };
 
 class BlkReadTracker {
-    static constexpr uint32_t s_expected_num_records = 1000;
+    static constexpr uint32_t s_num_shards = 64;
+    static constexpr uint32_t s_expected_records_per_shard = 64;
+    static constexpr uint32_t s_records_per_range = 64; // Consecutive records of a chunk which live in same shard
     static constexpr uint16_t s_entries_per_record = 8; // this number could be candidate to tune perf;
 
+    // Pending reads are sharded by chunk and by aligned range of records within the chunk, each shard on its own
+    // cache line, so that concurrent reads of different chunks or of far apart blks don't contend on same buckets.
+    struct alignas(64) Shard {
+        Shard();
+        sisl::SimpleHashMap< BlkId, BlkTrackRecord > m_pending_reads_map;
+    };
+
 private:
-    sisl::SimpleHashMap< BlkId, BlkTrackRecord > m_pending_reads_map;
+    std::vector< std::unique_ptr< Shard > > m_shards;
     BlkReadTrackerMetrics m_metrics;
     uint32_t m_entries_per_record{s_entries_per_record};
 
@@ -175,5 +186,6 @@ private:
      * @param waiters
      */
     void merge(const BlkId& blkid, int64_t new_ref_count, const std::shared_ptr< blk_track_waiter >& waiters);
+    sisl::SimpleHashMap< BlkId, BlkTrackRecord >& pending_reads_map(const BlkId& base_blkid);
 };
 } // namespace homestore
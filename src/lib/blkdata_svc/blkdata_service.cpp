@@ -13,9 +13,14 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <algorithm>
+#include <atomic>
+
 #include <homestore/blkdata_service.hpp>
 #include <homestore/homestore.hpp>
 #include <homestore/chunk_selector.h>
+#include <homestore/crc.h>
+#include <homestore/perf_stats.hpp>
 
 #include "device/chunk.h"
 #include "device/virtual_dev.hpp"
@@ -23,8 +28,16 @@
 #include "common/homestore_config.hpp" // is_data_drive_hdd
 #include "common/homestore_assert.hpp"
 #include "common/error.h"
+#include "common/resource_mgr.hpp"
+#include "common/tsc_clock.hpp"
 #include "blk_read_tracker.hpp"
+#include "read_epoch_tracker.hpp"
+#include "blk_read_cache.hpp"
+#include "small_write_packer.hpp"
+#include "blk_read_merger.hpp"
+#include "seq_read_prefetcher.hpp"
 #include "data_svc_cp.hpp"
+#include "append_chunk_compactor.hpp"
 
 namespace homestore {
 
@@ -33,12 +46,15 @@ BlkDataService& data_service() { return hs()->data_service(); }
 BlkDataService::BlkDataService(shared< ChunkSelector > chunk_selector) :
         m_custom_chunk_selector{std::move(chunk_selector)} {
     m_blk_read_tracker = std::make_unique< BlkReadTracker >();
+    if (HS_DYNAMIC_CONFIG(generic.data_read_epoch_tracking)) {
+        m_read_epoch_tracker = std::make_unique< ReadEpochTracker >();
+    }
 }
 BlkDataService::~BlkDataService() = default;
 
 // first-time boot path
 void BlkDataService::create_vdev(uint64_t size, HSDevType devType, uint32_t blk_size, blk_allocator_type_t alloc_type,
-                                 chunk_selector_type_t chunk_sel_type, uint32_t num_chunks) {
+                                 chunk_selector_type_t chunk_sel_type, uint32_t num_chunks, bool integrity_offload) {
     hs_vdev_context vdev_ctx;
     vdev_ctx.type = hs_vdev_type_t::DATA_VDEV;
 
@@ -52,7 +68,9 @@ void BlkDataService::create_vdev(uint64_t size, HSDevType devType, uint32_t blk_
                                                         .alloc_type = alloc_type,
                                                         .chunk_sel_type = chunk_sel_type,
                                                         .multi_pdev_opts = vdev_multi_pdev_opts_t::ALL_PDEV_STRIPED,
-                                                        .context_data = vdev_ctx.to_blob()});
+                                                        .context_data = vdev_ctx.to_blob(),
+                                                        .integrity_offload = integrity_offload,
+                                                        .placement = vdev_placement_t::DATA});
 }
 
 // both first_time_boot and recovery path will come here
@@ -61,6 +79,19 @@ shared< VirtualDev > BlkDataService::open_vdev(const vdev_info& vinfo, bool load
     m_vdev = std::make_shared< VirtualDev >(*(hs()->device_mgr()), vinfo, nullptr, true /* auto_recovery */,
                                             std::move(m_custom_chunk_selector));
     m_blk_size = vinfo.blk_size;
+    if (HS_DYNAMIC_CONFIG(device->data_vdev_uring)) { m_vdev->enable_uring(); }
+    if (auto const cache_size = resource_mgr().get_data_read_cache_size_limit(); cache_size != 0) {
+        m_read_cache = std::make_unique< BlkReadCache >(
+            cache_size, m_blk_size, HS_DYNAMIC_CONFIG(generic.data_read_cache_max_entry_kb) * 1024,
+            [](int64_t bytes) {
+                if (bytes > 0) {
+                    resource_mgr().inc_data_read_cache_size(uint64_cast(bytes));
+                } else {
+                    resource_mgr().dec_data_read_cache_size(uint64_cast(-bytes));
+                }
+            });
+        LOGINFO("Data read cache of size={} enabled for vdev={}", cache_size, vinfo.name);
+    }
     return m_vdev;
 }
 
@@ -76,19 +107,126 @@ static auto collect_all_futures(std::vector< folly::Future< std::error_code > >&
     });
 }
 
+// Notes the latency of the io from its start in the perf stats, once it completes
+static folly::Future< std::error_code > timed_io(folly::Future< std::error_code >&& f, perf_op_t op, uint64_t start) {
+    return std::move(f).thenValue([op, start](std::error_code ec) {
+        PerfStats::observe_since(op, start);
+        return ec;
+    });
+}
+
+namespace {
+// Completes one promise once all the pieces of a multi piece io are done, with the error of a failed piece if any
+struct pieces_completion {
+    std::atomic< uint32_t > m_pending;
+    std::atomic< bool > m_failed{false};
+    std::error_code m_ec; // Set only by the first failed piece, read by the last piece
+    folly::Promise< std::error_code > m_promise;
+
+    explicit pieces_completion(uint32_t npieces) : m_pending{npieces} {}
+
+    void piece_done(std::error_code const& ec) {
+        if (sisl_unlikely(ec) && !m_failed.exchange(true, std::memory_order_relaxed)) { m_ec = ec; }
+        if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            m_promise.setValue(m_ec);
+            delete this;
+        }
+    }
+};
+
+// CRC32C of each of the nblks blks of data in iovs. Blks which lie within an iov are computed together, the others are
+// chained across the iovs they span.
+void compute_blk_crcs(sisl::sg_iovs_t const& iovs, uint32_t blk_size, uint32_t nblks, crc32_t* out_crcs) {
+    static thread_local std::vector< const uint8_t* > s_bufs;
+    static thread_local std::vector< uint32_t > s_blk_idxs;
+    static thread_local std::vector< crc32_t > s_crcs;
+    s_bufs.clear();
+    s_blk_idxs.clear();
+
+    uint32_t blk{0};
+    uint32_t filled{0}; // Bytes of the current blk which are already in its crc
+    for (auto const& iov : iovs) {
+        auto const* p = r_cast< const uint8_t* >(iov.iov_base);
+        uint64_t left = iov.iov_len;
+        while ((left > 0) && (blk < nblks)) {
+            if ((filled == 0) && (left >= blk_size)) {
+                s_bufs.push_back(p);
+                s_blk_idxs.push_back(blk++);
+                p += blk_size;
+                left -= blk_size;
+                continue;
+            }
+            auto const n = std::min(left, uint64_cast(blk_size - filled));
+            out_crcs[blk] = crc32c((filled == 0) ? 0 : out_crcs[blk], p, n);
+            p += n;
+            left -= n;
+            filled += n;
+            if (filled == blk_size) {
+                ++blk;
+                filled = 0;
+            }
+        }
+    }
+
+    s_crcs.resize(s_bufs.size());
+    crc32c_multi(0, s_bufs.data(), uint32_cast(s_bufs.size()), blk_size, s_crcs.data());
+    for (size_t i{0}; i < s_crcs.size(); ++i) {
+        out_crcs[s_blk_idxs[i]] = s_crcs[i];
+    }
+}
+} // namespace
+
+// Device read of the blks, which goes through the read merger if it is enabled and the whole of the blks is read
+folly::Future< std::error_code > BlkDataService::vdev_read(BlkId const& bid, uint8_t* buf, uint32_t size,
+                                                           bool part_of_batch) {
+    if (m_read_merger && (size == bid.blk_count() * m_blk_size)) {
+        return m_read_merger->read(bid, sisl::sg_iovs_t{iovec{.iov_base = buf, .iov_len = size}});
+    }
+    return m_vdev->async_read(r_cast< char* >(buf), size, bid, part_of_batch);
+}
+
+folly::Future< std::error_code > BlkDataService::vdev_readv(BlkId const& bid, sisl::sg_iovs_t iovs, uint32_t size,
+                                                            bool part_of_batch) {
+    if (m_read_merger && (size == bid.blk_count() * m_blk_size)) { return m_read_merger->read(bid, std::move(iovs)); }
+    return m_vdev->async_readv(iovs.data(), iovs.size(), size, bid, part_of_batch);
+}
+
 folly::Future< std::error_code > BlkDataService::async_read(MultiBlkId const& blkid, uint8_t* buf, uint32_t size,
                                                             bool part_of_batch) {
+    auto const start = TscClock::now();
     auto do_read = [this](BlkId const& bid, uint8_t* buf, uint32_t size, bool part_of_batch) {
+        if (m_prefetcher) { m_prefetcher->on_read(bid); }
+        if (m_read_cache) {
+            bool const hit = m_read_cache->read(bid, buf, size);
+            PerfStats::cache_lookup(perf_cache_t::DATA_READ_CACHE, hit);
+            if (hit) { return folly::makeFuture< std::error_code >(std::error_code{}); }
+        }
+
+        // Read is cached before it is untracked, so a free waiting on this read is sure to invalidate it afterwards
+        auto cache_read = [this, bid, buf, size](std::error_code const& ec) {
+            if (m_read_cache && !ec) { m_read_cache->insert(bid, buf, size); }
+        };
+        if (m_read_epoch_tracker) {
+            auto const t = m_read_epoch_tracker->enter();
+            return vdev_read(bid, buf, size, part_of_batch)
+                .thenValue([this, t, cache_read](auto&& ec) {
+                    cache_read(ec);
+                    m_read_epoch_tracker->exit(t);
+                    return folly::makeFuture< std::error_code >(std::move(ec));
+                });
+        }
         m_blk_read_tracker->insert(bid);
 
-        return m_vdev->async_read(r_cast< char* >(buf), size, bid, part_of_batch).thenValue([this, bid](auto&& ec) {
-            m_blk_read_tracker->remove(bid);
-            return folly::makeFuture< std::error_code >(std::move(ec));
-        });
+        return vdev_read(bid, buf, size, part_of_batch)
+            .thenValue([this, bid, cache_read](auto&& ec) {
+                cache_read(ec);
+                m_blk_read_tracker->remove(bid);
+                return folly::makeFuture< std::error_code >(std::move(ec));
+            });
     };
 
     if (blkid.num_pieces() == 1) {
-        return do_read(blkid.to_single_blkid(), buf, size, part_of_batch);
+        return timed_io(do_read(blkid.to_single_blkid(), buf, size, part_of_batch), perf_op_t::DATA_READ, start);
     } else {
         static thread_local std::vector< folly::Future< std::error_code > > s_futs;
         s_futs.clear();
@@ -100,7 +238,7 @@ folly::Future< std::error_code > BlkDataService::async_read(MultiBlkId const& bl
             buf += sz;
         }
 
-        return collect_all_futures(s_futs);
+        return timed_io(collect_all_futures(s_futs), perf_op_t::DATA_READ, start);
     }
 }
 
@@ -109,18 +247,42 @@ folly::Future< std::error_code > BlkDataService::async_read(MultiBlkId const& bl
     // TODO: sg_iovs_t should not be passed by value. We need it pass it as const&, but that is failing because
     // iovs.data() will then return "const iovec*", but unfortunately all the way down to iomgr, we take iovec*
     // instead it can easily take "const iovec*". Until we change this is made as copy by value
+    auto const start = TscClock::now();
     auto do_read = [this](BlkId const& bid, sisl::sg_iovs_t iovs, uint32_t size, bool part_of_batch) {
+        if (m_prefetcher) { m_prefetcher->on_read(bid); }
+        if (m_read_cache) {
+            bool const hit = m_read_cache->read(bid, iovs, size);
+            PerfStats::cache_lookup(perf_cache_t::DATA_READ_CACHE, hit);
+            if (hit) { return folly::makeFuture< std::error_code >(std::error_code{}); }
+        }
+
+        // Read is cached before it is untracked, so a free waiting on this read is sure to invalidate it afterwards
+        auto cache_read = [this, bid, size, cache_iovs = m_read_cache ? iovs : sisl::sg_iovs_t{}](
+                              std::error_code const& ec) {
+            if (m_read_cache && !ec) { m_read_cache->insert(bid, cache_iovs, size); }
+        };
+        if (m_read_epoch_tracker) {
+            auto const t = m_read_epoch_tracker->enter();
+            return vdev_readv(bid, std::move(iovs), size, part_of_batch)
+                .thenValue([this, t, cache_read = std::move(cache_read)](auto&& ec) {
+                    cache_read(ec);
+                    m_read_epoch_tracker->exit(t);
+                    return folly::makeFuture< std::error_code >(std::move(ec));
+                });
+        }
         m_blk_read_tracker->insert(bid);
 
-        return m_vdev->async_readv(iovs.data(), iovs.size(), size, bid, part_of_batch)
-            .thenValue([this, bid](auto&& ec) {
+        return vdev_readv(bid, std::move(iovs), size, part_of_batch)
+            .thenValue([this, bid, cache_read = std::move(cache_read)](auto&& ec) {
+                cache_read(ec);
                 m_blk_read_tracker->remove(bid);
                 return folly::makeFuture< std::error_code >(std::move(ec));
             });
     };
 
     if (blkid.num_pieces() == 1) {
-        return do_read(blkid.to_single_blkid(), sgs.iovs, size, part_of_batch);
+        return timed_io(do_read(blkid.to_single_blkid(), sgs.iovs, size, part_of_batch), perf_op_t::DATA_READ,
+                        start);
     } else {
         static thread_local std::vector< folly::Future< std::error_code > > s_futs;
         s_futs.clear();
@@ -132,13 +294,25 @@ folly::Future< std::error_code > BlkDataService::async_read(MultiBlkId const& bl
             s_futs.emplace_back(do_read(*bid, sg_it.next_iovs(sz), sz, part_of_batch));
         }
 
-        return collect_all_futures(s_futs);
+        return timed_io(collect_all_futures(s_futs), perf_op_t::DATA_READ, start);
     }
 }
 
+bool BlkDataService::admit_write(uint64_t size) {
+    if (!resource_mgr().can_admit(admission_class_t::DATA)) { return false; }
+    resource_mgr().throttle_admission(size, admission_class_t::DATA);
+    return true;
+}
+
 folly::Future< std::error_code > BlkDataService::async_alloc_write(const sisl::sg_list& sgs,
                                                                    const blk_alloc_hints& hints, MultiBlkId& out_blkids,
                                                                    bool part_of_batch) {
+    if (hs()->is_read_only()) {
+        return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::read_only_file_system));
+    }
+    if (!admit_write(sgs.size)) {
+        return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::resource_unavailable_try_again));
+    }
     const auto status = alloc_blks(sgs.size, hints, out_blkids);
     if (status != BlkAllocStatus::SUCCESS) {
         return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::resource_unavailable_try_again));
@@ -146,23 +320,42 @@ folly::Future< std::error_code > BlkDataService::async_alloc_write(const sisl::s
     return async_write(sgs, out_blkids, part_of_batch);
 }
 
+// Prefetch reads blks which no one might be reading, even the ones being written. So once a write completes, whatever
+// is cached of its blks is dropped, which also keeps the prefetches in flight on them from caching what they read.
+folly::Future< std::error_code > BlkDataService::written(folly::Future< std::error_code >&& f,
+                                                         MultiBlkId const& blkid) {
+    if (!m_prefetcher) { return std::move(f); }
+    return std::move(f).thenValue([this, blkid](std::error_code ec) {
+        auto it = blkid.iterate();
+        while (auto const bid = it.next()) {
+            m_read_cache->invalidate(*bid);
+        }
+        return ec;
+    });
+}
+
 folly::Future< std::error_code > BlkDataService::async_write(const char* buf, uint32_t size, MultiBlkId const& blkid,
                                                              bool part_of_batch) {
+    auto const start = TscClock::now();
     if (blkid.num_pieces() == 1) {
         // Shortcut to most common case
-        return m_vdev->async_write(buf, size, blkid.to_single_blkid(), part_of_batch);
+        return timed_io(written(m_vdev->async_write(buf, size, blkid.to_single_blkid(), part_of_batch), blkid),
+                        perf_op_t::DATA_WRITE, start);
     } else {
-        static thread_local std::vector< folly::Future< std::error_code > > s_futs;
-        s_futs.clear();
+        // All pieces are queued and submitted together, unless caller is batching them further
+        auto* completion = new pieces_completion(blkid.num_pieces());
+        auto f = completion->m_promise.getFuture();
 
         const char* ptr = buf;
         auto blkid_it = blkid.iterate();
         while (auto const bid = blkid_it.next()) {
             uint32_t sz = bid->blk_count() * m_blk_size;
-            s_futs.emplace_back(m_vdev->async_write(ptr, sz, *bid, part_of_batch));
+            m_vdev->async_write(ptr, sz, *bid, true /* part_of_batch */)
+                .thenValue([completion](std::error_code ec) { completion->piece_done(ec); });
             ptr += sz;
         }
-        return collect_all_futures(s_futs);
+        if (!part_of_batch) { m_vdev->submit_batch(); }
+        return timed_io(written(std::move(f), blkid), perf_op_t::DATA_WRITE, start);
     }
 }
 
@@ -171,20 +364,297 @@ folly::Future< std::error_code > BlkDataService::async_write(sisl::sg_list const
     // TODO: Async write should pass this by value the sgs.size parameter as well, currently vdev write routine
     // walks through again all the iovs and then getting the len to pass it down to iomgr. This defeats the purpose of
     // taking size parameters (which was done exactly done to avoid this walk through)
+    auto const start = TscClock::now();
     if (blkid.num_pieces() == 1) {
         // Shortcut to most common case
-        return m_vdev->async_writev(sgs.iovs.data(), sgs.iovs.size(), blkid.to_single_blkid(), part_of_batch);
+        auto f = m_vdev->async_writev(sgs.iovs.data(), sgs.iovs.size(), blkid.to_single_blkid(), part_of_batch);
+        return timed_io(written(std::move(f), blkid), perf_op_t::DATA_WRITE, start);
     } else {
-        static thread_local std::vector< folly::Future< std::error_code > > s_futs;
-        s_futs.clear();
+        // All pieces are queued and submitted together, unless caller is batching them further
+        auto* completion = new pieces_completion(blkid.num_pieces());
+        auto f = completion->m_promise.getFuture();
         sisl::sg_iterator sg_it{sgs.iovs};
 
         auto blkid_it = blkid.iterate();
         while (auto const bid = blkid_it.next()) {
             const auto iovs = sg_it.next_iovs(bid->blk_count() * m_blk_size);
-            s_futs.emplace_back(m_vdev->async_writev(iovs.data(), iovs.size(), *bid, part_of_batch));
+            m_vdev->async_writev(iovs.data(), iovs.size(), *bid, true /* part_of_batch */)
+                .thenValue([completion](std::error_code ec) { completion->piece_done(ec); });
         }
-        return collect_all_futures(s_futs);
+        if (!part_of_batch) { m_vdev->submit_batch(); }
+        return timed_io(written(std::move(f), blkid), perf_op_t::DATA_WRITE, start);
+    }
+}
+
+////////////////////////////////// Checksummed io section //////////////////////////////////
+folly::Future< std::error_code > BlkDataService::async_alloc_write(sisl::sg_list const& sgs,
+                                                                   blk_alloc_hints const& hints, MultiBlkId& out_blkids,
+                                                                   std::vector< crc32_t >& out_crcs,
+                                                                   bool part_of_batch) {
+    if (hs()->is_read_only()) {
+        return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::read_only_file_system));
+    }
+    if (!admit_write(sgs.size)) {
+        return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::resource_unavailable_try_again));
+    }
+    const auto status = alloc_blks(sgs.size, hints, out_blkids);
+    if (status != BlkAllocStatus::SUCCESS) {
+        return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::resource_unavailable_try_again));
+    }
+    return async_write(sgs, out_blkids, out_crcs, part_of_batch);
+}
+
+folly::Future< std::error_code > BlkDataService::async_write(const char* buf, uint32_t size, MultiBlkId const& blkid,
+                                                             std::vector< crc32_t >& out_crcs, bool part_of_batch) {
+    if (m_vdev->is_integrity_offloaded()) {
+        out_crcs.clear();
+        return async_write(buf, size, blkid, part_of_batch);
+    }
+    out_crcs.resize(blkid.blk_count());
+    compute_blk_crcs(sisl::sg_iovs_t{iovec{.iov_base = const_cast< char* >(buf), .iov_len = size}}, m_blk_size,
+                     std::min(uint32_cast(out_crcs.size()), size / m_blk_size), out_crcs.data());
+    return async_write(buf, size, blkid, part_of_batch);
+}
+
+folly::Future< std::error_code > BlkDataService::async_write(sisl::sg_list const& sgs, MultiBlkId const& blkid,
+                                                             std::vector< crc32_t >& out_crcs, bool part_of_batch) {
+    if (m_vdev->is_integrity_offloaded()) {
+        out_crcs.clear();
+        return async_write(sgs, blkid, part_of_batch);
+    }
+    out_crcs.resize(blkid.blk_count());
+    compute_blk_crcs(sgs.iovs, m_blk_size, std::min(uint32_cast(out_crcs.size()), uint32_cast(sgs.size / m_blk_size)),
+                     out_crcs.data());
+    return async_write(sgs, blkid, part_of_batch);
+}
+
+folly::Future< std::error_code > BlkDataService::async_read(MultiBlkId const& blkid, uint8_t* buf, uint32_t size,
+                                                            std::vector< crc32_t > const& crcs, bool part_of_batch) {
+    return async_read(blkid, buf, size, part_of_batch)
+        .thenValue([this, blkid, buf, size, crcs](std::error_code ec) {
+            if (ec) { return ec; }
+            return verify_blk_crcs(blkid, sisl::sg_iovs_t{iovec{.iov_base = buf, .iov_len = size}}, size, crcs);
+        });
+}
+
+folly::Future< std::error_code > BlkDataService::async_read(MultiBlkId const& blkid, sisl::sg_list& sgs, uint32_t size,
+                                                            std::vector< crc32_t > const& crcs, bool part_of_batch) {
+    return async_read(blkid, sgs, size, part_of_batch)
+        .thenValue([this, blkid, iovs = sgs.iovs, size, crcs](std::error_code ec) {
+            if (ec) { return ec; }
+            return verify_blk_crcs(blkid, iovs, size, crcs);
+        });
+}
+
+std::error_code BlkDataService::verify_blk_crcs(MultiBlkId const& blkid, sisl::sg_iovs_t const& iovs, uint32_t size,
+                                                std::vector< crc32_t > const& crcs) {
+    // Partially read blk at the end is not verified. With integrity offload, there are no crcs and drive verifies it.
+    auto const nblks = std::min(uint32_cast(crcs.size()), size / m_blk_size);
+    static thread_local std::vector< crc32_t > s_read_crcs;
+    s_read_crcs.resize(nblks);
+    compute_blk_crcs(iovs, m_blk_size, nblks, s_read_crcs.data());
+
+    for (uint32_t i{0}; i < nblks; ++i) {
+        if (s_read_crcs[i] == crcs[i]) { continue; }
+        LOGERROR("Data crc mismatch on blk #{} of blkid={}, expected={:#x} read={:#x}", i, blkid.to_string(), crcs[i],
+                 s_read_crcs[i]);
+
+        // Corrupt data is not to be served from cache again
+        if (m_read_cache) {
+            auto it = blkid.iterate();
+            while (auto const bid = it.next()) {
+                m_read_cache->invalidate(*bid);
+            }
+        }
+        return std::make_error_code(std::errc::bad_message);
+    }
+    return std::error_code{};
+}
+
+////////////////////////////////// Callback based io section //////////////////////////////////
+void BlkDataService::async_read(MultiBlkId const& blkid, uint8_t* buf, uint32_t size, data_io_ctx& ctx,
+                                bool part_of_batch) {
+    if (blkid.num_pieces() == 1) {
+        start_io(ctx, 1, true /* is_read */);
+        auto& p = ctx.m_pieces[0];
+        p.bid = blkid.to_single_blkid();
+        p.buf = buf;
+        p.size = size;
+        submit_read(p, part_of_batch);
+        return;
+    }
+
+    // Blkid is not touched once its last piece is submitted, as the callback could be called by then
+    auto const npieces = blkid.num_pieces();
+    start_io(ctx, npieces, true /* is_read */);
+    auto it = blkid.iterate();
+    for (uint32_t i{0}; i < npieces; ++i) {
+        auto const bid = it.next();
+        auto& p = ctx.m_pieces[i];
+        p.bid = *bid;
+        p.buf = buf;
+        p.size = bid->blk_count() * m_blk_size;
+        buf += p.size;
+        submit_read(p, true /* part_of_batch */);
+    }
+    if (!part_of_batch) { m_vdev->submit_batch(); }
+}
+
+void BlkDataService::async_read(MultiBlkId const& blkid, sisl::sg_list const& sgs, uint32_t size, data_io_ctx& ctx,
+                                bool part_of_batch) {
+    if (blkid.num_pieces() == 1) {
+        start_io(ctx, 1, true /* is_read */);
+        auto& p = ctx.m_pieces[0];
+        p.bid = blkid.to_single_blkid();
+        p.buf = nullptr;
+        p.iovs = sgs.iovs;
+        p.size = size;
+        submit_read(p, part_of_batch);
+        return;
+    }
+
+    // Blkid is not touched once its last piece is submitted, as the callback could be called by then
+    auto const npieces = blkid.num_pieces();
+    start_io(ctx, npieces, true /* is_read */);
+    sisl::sg_iterator sg_it{sgs.iovs};
+    auto it = blkid.iterate();
+    for (uint32_t i{0}; i < npieces; ++i) {
+        auto const bid = it.next();
+        auto& p = ctx.m_pieces[i];
+        p.bid = *bid;
+        p.buf = nullptr;
+        p.size = bid->blk_count() * m_blk_size;
+        p.iovs = sg_it.next_iovs(p.size);
+        submit_read(p, true /* part_of_batch */);
+    }
+    if (!part_of_batch) { m_vdev->submit_batch(); }
+}
+
+void BlkDataService::async_write(const char* buf, uint32_t size, MultiBlkId const& blkid, data_io_ctx& ctx,
+                                 bool part_of_batch) {
+    if (blkid.num_pieces() == 1) {
+        start_io(ctx, 1, false /* is_read */);
+        auto& p = ctx.m_pieces[0];
+        p.bid = blkid.to_single_blkid();
+        m_vdev->async_write(buf, size, p.bid, &p, part_of_batch);
+        return;
+    }
+
+    // Blkid is not touched once its last piece is submitted, as the callback could be called by then
+    auto const npieces = blkid.num_pieces();
+    start_io(ctx, npieces, false /* is_read */);
+    auto it = blkid.iterate();
+    for (uint32_t i{0}; i < npieces; ++i) {
+        auto const bid = it.next();
+        auto& p = ctx.m_pieces[i];
+        p.bid = *bid;
+        uint32_t const sz = bid->blk_count() * m_blk_size;
+        m_vdev->async_write(buf, sz, p.bid, &p, true /* part_of_batch */);
+        buf += sz;
+    }
+    if (!part_of_batch) { m_vdev->submit_batch(); }
+}
+
+void BlkDataService::async_write(sisl::sg_list const& sgs, MultiBlkId const& blkid, data_io_ctx& ctx,
+                                 bool part_of_batch) {
+    if (blkid.num_pieces() == 1) {
+        start_io(ctx, 1, false /* is_read */);
+        auto& p = ctx.m_pieces[0];
+        p.bid = blkid.to_single_blkid();
+        p.iovs = sgs.iovs;
+        m_vdev->async_writev(p.iovs.data(), p.iovs.size(), sgs.size, p.bid, &p, part_of_batch);
+        return;
+    }
+
+    // Blkid is not touched once its last piece is submitted, as the callback could be called by then
+    auto const npieces = blkid.num_pieces();
+    start_io(ctx, npieces, false /* is_read */);
+    sisl::sg_iterator sg_it{sgs.iovs};
+    auto it = blkid.iterate();
+    for (uint32_t i{0}; i < npieces; ++i) {
+        auto const bid = it.next();
+        auto& p = ctx.m_pieces[i];
+        p.bid = *bid;
+        uint32_t const sz = bid->blk_count() * m_blk_size;
+        p.iovs = sg_it.next_iovs(sz);
+        m_vdev->async_writev(p.iovs.data(), p.iovs.size(), sz, p.bid, &p, true /* part_of_batch */);
+    }
+    if (!part_of_batch) { m_vdev->submit_batch(); }
+}
+
+void BlkDataService::start_io(data_io_ctx& ctx, uint32_t npieces, bool is_read) {
+    HS_DBG_ASSERT(ctx.m_cb, "Callback based io is submitted on a data_io_ctx without callback");
+    HS_DBG_ASSERT_EQ(ctx.m_pending.load(std::memory_order_acquire), 0,
+                     "data_io_ctx is reused while its previous io is in flight");
+    ctx.m_svc = this;
+    ctx.m_is_read = is_read;
+    ctx.m_start_ticks = TscClock::now();
+    ctx.m_failed.store(false, std::memory_order_relaxed);
+    ctx.m_ec = std::error_code{};
+    ctx.m_pending.store(npieces, std::memory_order_release);
+    for (uint32_t i{0}; i < npieces; ++i) {
+        ctx.m_pieces[i].ctx = &ctx;
+        ctx.m_pieces[i].done = on_piece_completion;
+    }
+}
+
+void BlkDataService::submit_read(data_io_ctx::piece_req& p, bool part_of_batch) {
+    if (m_prefetcher) { m_prefetcher->on_read(p.bid); }
+    if (m_read_cache) {
+        bool const hit = (p.buf != nullptr) ? m_read_cache->read(p.bid, p.buf, p.size)
+                                            : m_read_cache->read(p.bid, p.iovs, p.size);
+        PerfStats::cache_lookup(perf_cache_t::DATA_READ_CACHE, hit);
+        if (hit) {
+            complete_piece(*p.ctx, std::error_code{});
+            return;
+        }
+    }
+
+    if (m_read_epoch_tracker) {
+        p.read_ticket = m_read_epoch_tracker->enter().m_counter;
+    } else {
+        m_blk_read_tracker->insert(p.bid);
+    }
+    if (p.buf != nullptr) {
+        m_vdev->async_read(r_cast< char* >(p.buf), p.size, p.bid, &p, part_of_batch);
+    } else {
+        m_vdev->async_readv(p.iovs.data(), p.iovs.size(), p.size, p.bid, &p, part_of_batch);
+    }
+}
+
+void BlkDataService::read_done(data_io_ctx::piece_req& p, std::error_code const& ec) {
+    // Read is cached before it is untracked, so a free waiting on this read is sure to invalidate it afterwards
+    if (m_read_cache && !ec) {
+        if (p.buf != nullptr) {
+            m_read_cache->insert(p.bid, p.buf, p.size);
+        } else {
+            m_read_cache->insert(p.bid, p.iovs, p.size);
+        }
+    }
+    if (m_read_epoch_tracker) {
+        m_read_epoch_tracker->exit(ReadEpochTracker::ticket{s_cast< std::atomic< int64_t >* >(p.read_ticket)});
+    } else {
+        m_blk_read_tracker->remove(p.bid);
+    }
+}
+
+void BlkDataService::on_piece_completion(dev_io_req* req, std::error_code ec) {
+    auto& p = *s_cast< data_io_ctx::piece_req* >(req);
+    auto& ctx = *p.ctx;
+    if (ctx.m_is_read) {
+        ctx.m_svc->read_done(p, ec);
+    } else if (ctx.m_svc->m_prefetcher) {
+        ctx.m_svc->m_read_cache->invalidate(p.bid); // Same as written()
+    }
+    complete_piece(ctx, ec);
+}
+
+void BlkDataService::complete_piece(data_io_ctx& ctx, std::error_code const& ec) {
+    if (sisl_unlikely(ec) && !ctx.m_failed.exchange(true, std::memory_order_relaxed)) { ctx.m_ec = ec; }
+    if (ctx.m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        PerfStats::observe_since(ctx.m_is_read ? perf_op_t::DATA_READ : perf_op_t::DATA_WRITE, ctx.m_start_ticks);
+        // Context could be reused by the callback itself, so it is not touched after this
+        ctx.m_cb(ctx.m_ec.default_error_condition());
     }
 }
 
@@ -195,6 +665,17 @@ BlkAllocStatus BlkDataService::alloc_blks(uint32_t size, const blk_alloc_hints&
     return m_vdev->alloc_blks(nblks, hints, out_blkids);
 }
 
+BlkAllocStatus BlkDataService::alloc_blks(std::vector< uint32_t > const& sizes, blk_alloc_hints const& hints,
+                                          std::vector< MultiBlkId >& out_blkids) {
+    std::vector< blk_count_t > nblks_list;
+    nblks_list.reserve(sizes.size());
+    for (auto const size : sizes) {
+        HS_DBG_ASSERT_EQ(size % m_blk_size, 0, "Non aligned size requested");
+        nblks_list.push_back(static_cast< blk_count_t >(size / m_blk_size));
+    }
+    return m_vdev->alloc_blks(nblks_list, hints, out_blkids);
+}
+
 BlkAllocStatus BlkDataService::commit_blk(MultiBlkId const& blkid) {
     if (blkid.num_pieces() == 1) {
         // Shortcut to most common case
@@ -209,6 +690,10 @@ BlkAllocStatus BlkDataService::commit_blk(MultiBlkId const& blkid) {
 }
 
 folly::Future< std::error_code > BlkDataService::async_free_blk(MultiBlkId const& bids) {
+    if (hs()->is_read_only()) {
+        return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::read_only_file_system));
+    }
+
     // create blk read waiter instance;
     folly::Promise< std::error_code > promise;
     auto f = promise.getFuture();
@@ -216,7 +701,13 @@ folly::Future< std::error_code > BlkDataService::async_free_blk(MultiBlkId const
     if (!m_vdev->is_blk_exist(bids)) {
         promise.setValue(std::make_error_code(std::errc::resource_unavailable_try_again));
     } else {
-        m_blk_read_tracker->wait_on(bids, [this, bids, p = std::move(promise)]() mutable {
+        wait_for_pending_reads(bids, [this, bids, p = std::move(promise)]() mutable {
+            if (m_read_cache) {
+                auto it = bids.iterate();
+                while (auto const bid = it.next()) {
+                    m_read_cache->invalidate(*bid);
+                }
+            }
             {
                 auto cpg = hs()->cp_mgr().cp_guard();
                 m_vdev->free_blk(bids, s_cast< VDevCPContext* >(cpg.context(cp_consumer_t::BLK_DATA_SVC)));
@@ -228,10 +719,93 @@ folly::Future< std::error_code > BlkDataService::async_free_blk(MultiBlkId const
     return f;
 }
 
+folly::Future< std::error_code > BlkDataService::async_packed_write(sisl::sg_list const& sgs,
+                                                                    blk_alloc_hints const& hints,
+                                                                    packed_blk_loc& out_loc) {
+    HS_REL_ASSERT(m_packer, "Packed write is issued without enabling generic.data_packed_writes");
+    if (hs()->is_read_only()) {
+        return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::read_only_file_system));
+    }
+    return m_packer->write(sgs, hints, out_loc);
+}
+
+folly::Future< std::error_code > BlkDataService::async_packed_read(packed_blk_loc const& loc, uint8_t* buf) {
+    HS_REL_ASSERT(m_packer, "Packed read is issued without enabling generic.data_packed_writes");
+    return m_packer->read(loc, buf);
+}
+
+folly::Future< std::error_code > BlkDataService::async_packed_free(packed_blk_loc const& loc) {
+    HS_REL_ASSERT(m_packer, "Packed free is issued without enabling generic.data_packed_writes");
+    if (hs()->is_read_only()) {
+        return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::read_only_file_system));
+    }
+    return m_packer->free(loc);
+}
+
+void BlkDataService::commit_packed(packed_blk_loc const& loc) {
+    HS_REL_ASSERT(m_packer, "Packed commit is issued without enabling generic.data_packed_writes");
+    m_packer->commit(loc);
+}
+
+void BlkDataService::wait_for_pending_reads(MultiBlkId const& blkids, folly::Function< void(void) >&& cb) {
+    if (m_read_epoch_tracker) {
+        m_read_epoch_tracker->defer(std::move(cb));
+    } else {
+        m_blk_read_tracker->wait_on(blkids, std::move(cb));
+    }
+}
+
+void BlkDataService::invalidate_read_cache(chunk_num_t chunk_num) {
+    if (m_read_cache) { m_read_cache->invalidate_chunk(chunk_num); }
+}
+
 void BlkDataService::start() {
+    if (m_vdev->is_integrity_offloaded()) {
+        // Data of the vdev has no crcs of its own, so it is not served by a pdev which can't verify its protection
+        // info. Verification by the block layer is not persistent across reboots, so it is turned on again.
+        for (auto* pdev : m_vdev->get_pdevs()) {
+            HS_REL_ASSERT(PhysicalDev::enable_integrity(pdev->get_devname()),
+                          "Data vdev={} was formatted with integrity offload, but pdev={} no longer has protection "
+                          "info, refusing to start it",
+                          m_vdev->info().get_name(), pdev->get_devname());
+        }
+    }
+
+    blk_num_t max_blk_num{0};
+    chunk_num_t max_chunk_num{0};
+    for (auto const& [chunk_num, chunk] : m_vdev->get_chunks()) {
+        max_chunk_num = std::max(max_chunk_num, chunk_num_t(chunk_num));
+        max_blk_num = std::max(max_blk_num, blk_num_t(chunk->size() / m_blk_size - 1));
+    }
+    m_blkid_widths.chunk_num = MultiBlkId{0, 1, max_chunk_num}.needed_compact_widths().chunk_num;
+    m_blkid_widths.blk_num = MultiBlkId{max_blk_num, 1, 0}.needed_compact_widths().blk_num;
+
     // Register to CP for flush dirty buffers underlying virtual device layer;
     hs()->cp_mgr().register_consumer(cp_consumer_t::BLK_DATA_SVC,
                                      std::move(std::make_unique< DataSvcCPCallbacks >(m_vdev)));
+    if (HS_DYNAMIC_CONFIG(generic.data_packed_writes)) {
+        m_packer = std::make_unique< SmallWritePacker >(*this, m_vdev);
+        m_packer->start();
+    }
+    if (m_read_cache && (HS_DYNAMIC_CONFIG(generic.data_read_prefetch_max_reads) != 0)) {
+        m_prefetcher = std::make_unique< SeqReadPrefetcher >(m_vdev, *m_read_cache, m_blk_size);
+    }
+    if (HS_DYNAMIC_CONFIG(generic.data_read_merge_window_us) != 0) {
+        m_read_merger = std::make_unique< BlkReadMerger >(m_vdev, m_blk_size);
+        m_read_merger->start();
+    }
+}
+
+void BlkDataService::stop() {
+    if (m_packer) { m_packer->stop(); }
+    if (m_read_merger) { m_read_merger->stop(); }
+    if (m_prefetcher) { m_prefetcher->stop(); }
+}
+
+MultiBlkId::compact_widths BlkDataService::compact_blkid_widths(blk_count_t nblks) const {
+    auto w = m_blkid_widths;
+    w.nblks = MultiBlkId{0, nblks, 0}.needed_compact_widths().nblks;
+    return w;
 }
 
 uint64_t BlkDataService::get_total_capacity() const { return m_vdev->size(); }
@@ -240,4 +814,20 @@ uint64_t BlkDataService::get_used_capacity() const { return m_vdev->used_size();
 
 uint32_t BlkDataService::get_align_size() const { return m_vdev->align_size(); }
 
+uint32_t BlkDataService::health_score() const { return m_vdev->health_score(); }
+
+bool BlkDataService::is_blk_alloced(MultiBlkId const& blkid) const {
+    if (!m_vdev->is_blk_exist(blkid)) { return false; }
+    auto it = blkid.iterate();
+    while (auto const bid = it.next()) {
+        if (!m_vdev->is_blk_alloced(*bid)) { return false; }
+    }
+    return true;
+}
+
+uint64_t BlkDataService::compact(live_blks_cb_t const& live_cb, relocate_blk_cb_t const& relocate_cb) {
+    std::unique_lock lg{m_compact_mtx};
+    return AppendChunkCompactor{*this, m_vdev}.run(live_cb, relocate_cb);
+}
+
 } // namespace homestore
@@ -29,6 +29,7 @@ public:
     std::unique_ptr< CPContext > on_switchover_cp(CP* cur_cp, CP* new_cp) override;
     folly::Future< bool > cp_flush(CP* cp) override;
     void cp_cleanup(CP* cp) override;
+    bool cp_cleanup_can_overlap() const override { return true; }
     int cp_progress_percent() override;
 
 private:
@@ -0,0 +1,91 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <vector>
+
+#include "read_epoch_tracker.hpp"
+
+namespace homestore {
+
+ReadEpochTracker::slot& ReadEpochTracker::my_slot() {
+    static std::atomic< uint32_t > s_next_thread_idx{0};
+    static thread_local uint32_t t_thread_idx{s_next_thread_idx.fetch_add(1, std::memory_order_relaxed)};
+
+    // More threads than slots just share the counters, which stays correct as they are atomic
+    return m_slots[t_thread_idx % s_num_slots];
+}
+
+ReadEpochTracker::ticket ReadEpochTracker::enter() {
+    auto& s = my_slot();
+    while (true) {
+        auto const e = m_epoch.load(std::memory_order_acquire);
+        auto& counter = s.m_reads[e & 1];
+        counter.fetch_add(1, std::memory_order_seq_cst);
+
+        // Epoch could have advanced after it is read, by someone who might not have seen this read in the counter.
+        if (m_epoch.load(std::memory_order_seq_cst) == e) { return ticket{&counter}; }
+        counter.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void ReadEpochTracker::exit(ticket const& t) {
+    t.m_counter->fetch_sub(1, std::memory_order_release);
+    if (m_has_deferred.load(std::memory_order_acquire)) { process_deferred(); }
+}
+
+void ReadEpochTracker::defer(deferred_cb_t&& cb) {
+    {
+        std::unique_lock lg{m_mtx};
+        m_deferred.emplace_back(m_epoch.load(std::memory_order_acquire), std::move(cb));
+        m_has_deferred.store(true, std::memory_order_release);
+    }
+    process_deferred();
+}
+
+bool ReadEpochTracker::is_drained(uint64_t epoch) const {
+    int64_t reads{0};
+    for (auto const& s : m_slots) {
+        reads += s.m_reads[epoch & 1].load(std::memory_order_seq_cst);
+    }
+    return (reads == 0);
+}
+
+void ReadEpochTracker::process_deferred() {
+    // Whoever fails to get the lock asks the holder to check again, so the last read to drain is never missed
+    m_recheck.store(true, std::memory_order_seq_cst);
+    while (m_recheck.load(std::memory_order_seq_cst) && m_mtx.try_lock()) {
+        m_recheck.store(false, std::memory_order_seq_cst);
+
+        std::vector< deferred_cb_t > ready;
+        auto e = m_epoch.load(std::memory_order_acquire);
+        while (!m_deferred.empty() && (m_deferred.front().first + 2 > e)) {
+            // New reads are going to count in the parity of e + 1, which are the reads of e - 1
+            if (!is_drained(e + 1)) { break; }
+            m_epoch.store(++e, std::memory_order_seq_cst);
+        }
+        while (!m_deferred.empty() && (m_deferred.front().first + 2 <= e)) {
+            ready.emplace_back(std::move(m_deferred.front().second));
+            m_deferred.pop_front();
+        }
+        m_has_deferred.store(!m_deferred.empty(), std::memory_order_release);
+        m_mtx.unlock();
+
+        for (auto& cb : ready) {
+            cb();
+        }
+    }
+}
+
+} // namespace homestore
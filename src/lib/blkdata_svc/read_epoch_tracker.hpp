@@ -0,0 +1,88 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+#include <folly/Function.h>
+
+namespace homestore {
+
+/*
+ * Alternative to BlkReadTracker, which instead of recording the blks of every read, only counts the reads which are
+ * in flight in each epoch. A free is deferred until all the reads which started in or before the epoch it is
+ * requested in are completed, irrespective of the blks they read.
+ *
+ * Every thread counts its reads in its own cache line, one counter for each of the current and previous epoch, so a
+ * read costs an uncontended increment and decrement. Epoch advances only while frees are pending, when the counters
+ * of the epoch being retired are all drained. A free requested in epoch E is done once epoch reaches E + 2, i.e. once
+ * the reads of E are drained.
+ *
+ * A free could wait for reads of unrelated blks, which is fine as reads are short lived, but a read should never be
+ * outstanding indefinitely while in the tracker.
+ */
+class ReadEpochTracker {
+public:
+    using deferred_cb_t = folly::Function< void(void) >;
+
+    // Returned on enter, to be passed back on exit of the same read, possibly from another thread
+    struct ticket {
+        std::atomic< int64_t >* m_counter{nullptr};
+    };
+
+    ReadEpochTracker() = default;
+    ReadEpochTracker(const ReadEpochTracker&) = delete;
+    ReadEpochTracker& operator=(const ReadEpochTracker&) = delete;
+    ReadEpochTracker(ReadEpochTracker&&) noexcept = delete;
+    ReadEpochTracker& operator=(ReadEpochTracker&&) noexcept = delete;
+    ~ReadEpochTracker() = default;
+
+    ticket enter();
+    void exit(ticket const& t);
+
+    /**
+     * @brief : Calls back once every read that is in flight now is completed. Callback could be called inline if
+     * there are none, or else in the thread of the read which completes last.
+     */
+    void defer(deferred_cb_t&& cb);
+
+    uint64_t epoch() const { return m_epoch.load(std::memory_order_acquire); }
+
+private:
+    static constexpr uint32_t s_num_slots = 256;
+
+    struct alignas(64) slot {
+        std::array< std::atomic< int64_t >, 2 > m_reads{0, 0}; // Reads in flight, by parity of epoch they started in
+    };
+
+    slot& my_slot();
+    bool is_drained(uint64_t epoch) const;
+    void process_deferred();
+
+private:
+    std::atomic< uint64_t > m_epoch{2};
+    std::array< slot, s_num_slots > m_slots;
+    std::atomic< bool > m_has_deferred{false};
+    std::atomic< bool > m_recheck{false};
+    std::mutex m_mtx; // Serializes advancing epoch and access to deferred list
+    std::deque< std::pair< uint64_t, deferred_cb_t > > m_deferred;
+};
+
+} // namespace homestore
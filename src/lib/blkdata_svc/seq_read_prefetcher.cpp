@@ -0,0 +1,127 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <homestore/homestore.hpp>
+#include "device/chunk.h"
+#include "device/device.h"
+#include "device/virtual_dev.hpp"
+#include "common/homestore_config.hpp"
+#include "common/homestore_utils.hpp"
+#include "blk_read_cache.hpp"
+#include "seq_read_prefetcher.hpp"
+
+namespace homestore {
+
+SeqReadPrefetcher::SeqReadPrefetcher(shared< VirtualDev > vdev, BlkReadCache& cache, uint32_t blk_size) :
+        m_vdev{std::move(vdev)}, m_cache{cache}, m_blk_size{blk_size} {
+    LOGINFO("Prefetch of sequential data reads is enabled, max_reads={} max_inflight_kb={}",
+            HS_DYNAMIC_CONFIG(generic.data_read_prefetch_max_reads),
+            HS_DYNAMIC_CONFIG(generic.data_read_prefetch_max_inflight_kb));
+}
+
+SeqReadPrefetcher::~SeqReadPrefetcher() { stop(); }
+
+void SeqReadPrefetcher::stop() {
+    {
+        std::unique_lock lg{m_mtx};
+        m_stopped = true;
+    }
+    while (m_inflight_bytes.load(std::memory_order_acquire) != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void SeqReadPrefetcher::on_read(BlkId const& bid) {
+    // Reads which can not be cached as a whole would not be hits even if they are prefetched
+    auto const read_size = uint64_cast(bid.blk_count()) * m_blk_size;
+    if ((bid.blk_count() == 0) || (read_size > m_cache.max_entry_size())) { return; }
+
+    auto const max_inflight = uint64_cast(HS_DYNAMIC_CONFIG(generic.data_read_prefetch_max_inflight_kb)) * 1024;
+    auto const max_window = std::max(HS_DYNAMIC_CONFIG(generic.data_read_prefetch_max_reads), s_min_window);
+    auto const chunk_blks = hs()->device_mgr()->get_chunk(bid.chunk_num())->size() / m_blk_size;
+    blk_num_t const read_end = bid.blk_num() + bid.blk_count();
+
+    static thread_local std::vector< BlkId > s_to_fetch;
+    s_to_fetch.clear();
+    {
+        std::unique_lock lg{m_mtx};
+        if (m_stopped) { return; }
+
+        auto it = std::find_if(m_streams.begin(), m_streams.end(), [&bid](stream const& s) {
+            return s.valid && (s.chunk_num == bid.chunk_num()) && (s.next_blk == bid.blk_num());
+        });
+        if (it == m_streams.end()) {
+            auto victim = std::min_element(m_streams.begin(), m_streams.end(), [](stream const& a, stream const& b) {
+                return (a.valid ? a.last_read + 1 : 0) < (b.valid ? b.last_read + 1 : 0);
+            });
+            *victim = stream{.chunk_num = bid.chunk_num(),
+                             .next_blk = read_end,
+                             .prefetched_end = read_end,
+                             .nblks = bid.blk_count(),
+                             .window = 0,
+                             .last_read = ++m_nreads,
+                             .valid = true};
+            return;
+        }
+
+        auto& s = *it;
+        s.last_read = ++m_nreads;
+        s.next_blk = read_end;
+        if (s.nblks != bid.blk_count()) {
+            // Reads of the stream changed their size, prefetches of the old size would not be hits
+            s.nblks = bid.blk_count();
+            s.prefetched_end = read_end;
+        }
+        s.window = (s.window == 0) ? s_min_window : std::min(s.window * 2, max_window);
+        s.prefetched_end = std::max(s.prefetched_end, read_end);
+
+        auto const target = std::min(uint64_cast(read_end) + uint64_cast(s.window) * s.nblks, chunk_blks);
+        while (uint64_cast(s.prefetched_end) + s.nblks <= target) {
+            if (m_inflight_bytes.load(std::memory_order_relaxed) + read_size > max_inflight) {
+                s.window = std::max(s.window / 2, s_min_window);
+                break;
+            }
+            m_inflight_bytes.fetch_add(read_size, std::memory_order_relaxed);
+            s_to_fetch.emplace_back(s.prefetched_end, s.nblks, s.chunk_num);
+            s.prefetched_end += s.nblks;
+        }
+    }
+
+    for (auto const& fbid : s_to_fetch) {
+        prefetch(fbid);
+    }
+}
+
+void SeqReadPrefetcher::prefetch(BlkId const& bid) {
+    uint32_t const size = bid.blk_count() * m_blk_size;
+    if (!m_vdev->is_blk_alloced(bid) || !m_cache.begin_fill(bid)) {
+        m_inflight_bytes.fetch_sub(size, std::memory_order_release);
+        return;
+    }
+
+    auto* buf = hs_utils::iobuf_alloc(size, sisl::buftag::common, m_vdev->align_size());
+    m_num_prefetches.fetch_add(1, std::memory_order_relaxed);
+    m_vdev->async_read(r_cast< char* >(buf), size, bid).thenValue([this, bid, buf, size](std::error_code ec) {
+        m_cache.end_fill(bid, ec ? nullptr : buf);
+        hs_utils::iobuf_free(buf, sisl::buftag::common);
+        m_inflight_bytes.fetch_sub(size, std::memory_order_release);
+    });
+}
+
+} // namespace homestore
@@ -0,0 +1,89 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include <homestore/blk.h>
+#include <homestore/homestore_decl.hpp>
+
+namespace homestore {
+class VirtualDev;
+class BlkReadCache;
+
+/*
+ * SeqReadPrefetcher: detects the streams of sequential data reads, each read of a stream starting at the blk right
+ * after its previous read in the same chunk, and reads the next blks of the stream into the data read cache ahead of
+ * the reader.
+ *
+ * Prefetches are of the size of the reads of the stream, so that each of its reads is a hit on a single cache entry.
+ * A stream is prefetched 2 reads ahead once it is found sequential and the window doubles with every read which keeps
+ * it sequential, up to generic.data_read_prefetch_max_reads. Memory of the prefetches in flight is capped by
+ * generic.data_read_prefetch_max_inflight_kb, beyond which streams are not prefetched and their windows are halved.
+ * Blks which are not allocated are not prefetched.
+ *
+ * A fixed number of streams are tracked, least recently read one making way for a new stream.
+ */
+class SeqReadPrefetcher {
+public:
+    SeqReadPrefetcher(shared< VirtualDev > vdev, BlkReadCache& cache, uint32_t blk_size);
+    SeqReadPrefetcher(const SeqReadPrefetcher&) = delete;
+    SeqReadPrefetcher& operator=(const SeqReadPrefetcher&) = delete;
+    SeqReadPrefetcher(SeqReadPrefetcher&&) noexcept = delete;
+    SeqReadPrefetcher& operator=(SeqReadPrefetcher&&) noexcept = delete;
+    ~SeqReadPrefetcher();
+
+    /// @brief Notes a read of the blks by a consumer, prefetching the blks after it if it continues a stream
+    void on_read(BlkId const& bid);
+
+    /// @brief Stops prefetching and waits for the prefetches in flight.
+    void stop();
+
+    uint64_t num_prefetches() const { return m_num_prefetches.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr uint32_t s_max_streams{32};
+    static constexpr uint32_t s_min_window{2};
+
+    struct stream {
+        chunk_num_t chunk_num{0};
+        blk_num_t next_blk{0};       // Blk right after the last read of the stream
+        blk_num_t prefetched_end{0}; // Blk right after the last one prefetched
+        blk_count_t nblks{0};        // Blks of each read of the stream and of each of its prefetches
+        uint32_t window{0};          // Reads it is prefetched ahead by, 0 until it is found sequential
+        uint64_t last_read{0};
+        bool valid{false};
+    };
+
+    void prefetch(BlkId const& bid);
+
+private:
+    shared< VirtualDev > m_vdev;
+    BlkReadCache& m_cache;
+    uint32_t m_blk_size;
+
+    std::mutex m_mtx;
+    std::array< stream, s_max_streams > m_streams;
+    uint64_t m_nreads{0}; // Reads noted so far, to find the least recently read stream
+    bool m_stopped{false};
+
+    std::atomic< uint64_t > m_inflight_bytes{0};
+    std::atomic< uint64_t > m_num_prefetches{0};
+};
+
+} // namespace homestore
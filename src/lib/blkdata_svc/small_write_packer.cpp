@@ -0,0 +1,217 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include <homestore/homestore.hpp>
+#include "device/virtual_dev.hpp"
+#include "common/homestore_config.hpp"
+#include "common/homestore_assert.hpp"
+#include "common/homestore_utils.hpp"
+#include "small_write_packer.hpp"
+
+namespace homestore {
+
+SmallWritePacker::SmallWritePacker(BlkDataService& data_svc, shared< VirtualDev > vdev) :
+        m_data_svc{data_svc}, m_vdev{std::move(vdev)}, m_blk_size{data_svc.get_blk_size()} {}
+
+SmallWritePacker::~SmallWritePacker() { stop(); }
+
+void SmallWritePacker::start() {
+    auto const flush_us = HS_DYNAMIC_CONFIG(generic.data_packed_write_flush_us);
+    m_flush_timer_hdl = iomanager.schedule_global_timer(
+        std::max(flush_us / 2, 1u) * 1000ul, true /* recurring */, nullptr /* cookie */,
+        iomgr::reactor_regex::all_worker, [this](void*) { flush_if_due(); }, true /* wait_to_schedule */);
+    LOGINFO("Packing of small data writes is enabled, flush_us={}", flush_us);
+}
+
+void SmallWritePacker::stop() {
+    if (m_flush_timer_hdl != iomgr::null_timer_handle) {
+        iomanager.cancel_timer(m_flush_timer_hdl, true /* wait */);
+        m_flush_timer_hdl = iomgr::null_timer_handle;
+    }
+
+    std::optional< flush_job > job;
+    {
+        std::unique_lock lg{m_mtx};
+        job = close_open_blk();
+    }
+    if (job) {
+        auto const ec = m_vdev->sync_write(r_cast< const char* >(job->buf), m_blk_size, job->bid);
+        on_written(*job, ec);
+    }
+
+    while (true) {
+        {
+            std::unique_lock lg{m_mtx};
+            if (m_in_flight == 0) { break; }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+folly::Future< std::error_code > SmallWritePacker::write(sisl::sg_list const& sgs, blk_alloc_hints const& hints,
+                                                         packed_blk_loc& out_loc) {
+    auto const size = uint32_cast(sgs.size);
+    if ((size == 0) || (size > m_blk_size)) {
+        return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::invalid_argument));
+    }
+
+    std::optional< flush_job > full_job;
+    folly::Future< std::error_code > f = folly::Future< std::error_code >::makeEmpty();
+    {
+        std::unique_lock lg{m_mtx};
+        if ((m_open_key != 0) && (m_blks[m_open_key].used + size > m_blk_size)) { full_job = close_open_blk(); }
+
+        if (m_open_key == 0) {
+            MultiBlkId mbid;
+            if (m_data_svc.alloc_blks(m_blk_size, hints, mbid) != BlkAllocStatus::SUCCESS) {
+                lg.unlock();
+                if (full_job) { flush(std::move(*full_job)); }
+                return folly::makeFuture< std::error_code >(
+                    std::make_error_code(std::errc::resource_unavailable_try_again));
+            }
+            auto const bid = mbid.to_single_blkid();
+            auto& b = m_blks[bid.to_integer()];
+            b.bid = bid;
+            b.buf = hs_utils::iobuf_alloc(m_blk_size, sisl::buftag::common, m_vdev->align_size());
+            std::memset(b.buf, 0, m_blk_size);
+            b.open_time = Clock::now();
+            m_open_key = bid.to_integer();
+        }
+
+        auto& b = m_blks[m_open_key];
+        uint8_t* dst = b.buf + b.used;
+        for (auto const& iov : sgs.iovs) {
+            std::memcpy(dst, iov.iov_base, iov.iov_len);
+            dst += iov.iov_len;
+        }
+        out_loc = packed_blk_loc{.bid = b.bid, .offset = b.used, .size = size};
+        b.used += size;
+        ++b.live;
+        b.waiters.emplace_back();
+        f = b.waiters.back().getFuture();
+
+        if ((b.used == m_blk_size) && !full_job) { full_job = close_open_blk(); }
+    }
+
+    if (full_job) { flush(std::move(*full_job)); }
+    return f;
+}
+
+folly::Future< std::error_code > SmallWritePacker::read(packed_blk_loc const& loc, uint8_t* buf) {
+    {
+        std::unique_lock lg{m_mtx};
+        if (auto it = m_blks.find(loc.bid.to_integer()); (it != m_blks.end()) && (it->second.buf != nullptr)) {
+            std::memcpy(buf, it->second.buf + loc.offset, loc.size);
+            return folly::makeFuture< std::error_code >(std::error_code{});
+        }
+    }
+
+    // Direct io is of the whole blk, from which the entry is copied out
+    auto* blk_buf = hs_utils::iobuf_alloc(m_blk_size, sisl::buftag::common, m_vdev->align_size());
+    return m_data_svc.async_read(MultiBlkId{loc.bid}, blk_buf, m_blk_size)
+        .thenValue([blk_buf, buf, loc](std::error_code ec) {
+            if (!ec) { std::memcpy(buf, blk_buf + loc.offset, loc.size); }
+            hs_utils::iobuf_free(blk_buf, sisl::buftag::common);
+            return ec;
+        });
+}
+
+folly::Future< std::error_code > SmallWritePacker::free(packed_blk_loc const& loc) {
+    auto const key = loc.bid.to_integer();
+    bool free_blk{false};
+    {
+        std::unique_lock lg{m_mtx};
+        auto it = m_blks.find(key);
+        HS_REL_ASSERT(it != m_blks.end(), "Free of packed loc={} whose blk is not known", loc.to_string());
+        HS_DBG_ASSERT_GT(it->second.live, 0, "Free of packed loc={} on a blk with no live entries", loc.to_string());
+
+        // Blk which is open or in flight is freed once it is written
+        if ((--it->second.live == 0) && !it->second.in_flight && (key != m_open_key)) {
+            m_blks.erase(it);
+            free_blk = true;
+        }
+    }
+
+    if (free_blk) { return m_data_svc.async_free_blk(MultiBlkId{loc.bid}); }
+    return folly::makeFuture< std::error_code >(std::error_code{});
+}
+
+void SmallWritePacker::commit(packed_blk_loc const& loc) {
+    std::unique_lock lg{m_mtx};
+    auto& b = m_blks[loc.bid.to_integer()];
+    if (b.live++ == 0) {
+        b.bid = loc.bid;
+        m_data_svc.commit_blk(MultiBlkId{loc.bid});
+    }
+}
+
+std::optional< SmallWritePacker::flush_job > SmallWritePacker::close_open_blk() {
+    if (m_open_key == 0) { return std::nullopt; }
+
+    auto& b = m_blks[m_open_key];
+    b.in_flight = true;
+    ++m_in_flight;
+    m_open_key = 0;
+    return flush_job{.bid = b.bid, .buf = b.buf, .waiters = std::move(b.waiters)};
+}
+
+void SmallWritePacker::flush(flush_job&& job) {
+    auto const* buf = r_cast< const char* >(job.buf);
+    auto const bid = job.bid;
+    m_data_svc.async_write(buf, m_blk_size, MultiBlkId{bid})
+        .thenValue([this, job = std::move(job)](std::error_code ec) mutable { on_written(job, ec); });
+}
+
+void SmallWritePacker::on_written(flush_job& job, std::error_code ec) {
+    if (ec) { LOGERROR("Write of shared blk={} of packed writes failed, error={}", job.bid.to_string(), ec.message()); }
+
+    bool free_blk{false};
+    {
+        std::unique_lock lg{m_mtx};
+        auto it = m_blks.find(job.bid.to_integer());
+        it->second.buf = nullptr;
+        it->second.in_flight = false;
+        --m_in_flight;
+        if (it->second.live == 0) {
+            m_blks.erase(it);
+            free_blk = true;
+        }
+    }
+    hs_utils::iobuf_free(job.buf, sisl::buftag::common);
+
+    if (free_blk) { m_data_svc.async_free_blk(MultiBlkId{job.bid}); }
+    for (auto& p : job.waiters) {
+        p.setValue(ec);
+    }
+}
+
+void SmallWritePacker::flush_if_due() {
+    std::optional< flush_job > job;
+    {
+        std::unique_lock lg{m_mtx};
+        if (m_open_key == 0) { return; }
+        if (get_elapsed_time_us(m_blks[m_open_key].open_time) < HS_DYNAMIC_CONFIG(generic.data_packed_write_flush_us)) {
+            return;
+        }
+        job = close_open_blk();
+    }
+    flush(std::move(*job));
+}
+
+} // namespace homestore
@@ -0,0 +1,98 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/futures/Future.h>
+#include <iomgr/iomgr.hpp>
+#include <sisl/fds/buffer.hpp>
+#include <homestore/blkdata_service.hpp>
+#include <homestore/homestore_decl.hpp>
+
+namespace homestore {
+class VirtualDev;
+
+/*
+ * SmallWritePacker: packs writes smaller than a blk into shared blks, each write addressed by the blk and its offset
+ * and size within the blk. Writes are copied into the buffer of the open shared blk, which is written once it has no
+ * room for the next write or once generic.data_packed_write_flush_us has passed since its first write, at which point
+ * futures of all its writes are completed.
+ *
+ * A shared blk is freed once all of its entries are freed. The count of live entries of a blk is only kept in memory,
+ * consumer rebuilds it on recovery by committing every location still in use, before any packed write or free.
+ *
+ * Reads of a blk which is yet to be written are served from its buffer.
+ */
+class SmallWritePacker {
+public:
+    SmallWritePacker(BlkDataService& data_svc, shared< VirtualDev > vdev);
+    SmallWritePacker(const SmallWritePacker&) = delete;
+    SmallWritePacker& operator=(const SmallWritePacker&) = delete;
+    SmallWritePacker(SmallWritePacker&&) noexcept = delete;
+    SmallWritePacker& operator=(SmallWritePacker&&) noexcept = delete;
+    ~SmallWritePacker();
+
+    void start();
+
+    /// @brief Stops the flush timer and synchronously writes the open blk, after waiting for the blks in flight.
+    void stop();
+
+    folly::Future< std::error_code > write(sisl::sg_list const& sgs, blk_alloc_hints const& hints,
+                                           packed_blk_loc& out_loc);
+    folly::Future< std::error_code > read(packed_blk_loc const& loc, uint8_t* buf);
+    folly::Future< std::error_code > free(packed_blk_loc const& loc);
+    void commit(packed_blk_loc const& loc);
+
+private:
+    struct shared_blk {
+        BlkId bid;
+        uint8_t* buf{nullptr}; // Data of the blk while it is open or being written, nullptr once it is written
+        uint32_t used{0};
+        uint32_t live{0}; // Entries which are not freed yet
+        bool in_flight{false};
+        Clock::time_point open_time;
+        std::vector< folly::Promise< std::error_code > > waiters;
+    };
+
+    // Open blk taken out for writing, which is written without holding the lock
+    struct flush_job {
+        BlkId bid;
+        uint8_t* buf{nullptr};
+        std::vector< folly::Promise< std::error_code > > waiters;
+    };
+
+    std::optional< flush_job > close_open_blk(); // Expects the lock to be held
+    void flush(flush_job&& job);
+    void on_written(flush_job& job, std::error_code ec);
+    void flush_if_due();
+
+private:
+    BlkDataService& m_data_svc;
+    shared< VirtualDev > m_vdev;
+    uint32_t m_blk_size;
+
+    std::mutex m_mtx;
+    std::unordered_map< uint64_t, shared_blk > m_blks; // Blks which have live entries or are open or in flight
+    uint64_t m_open_key{0};                            // Key of the open blk in m_blks, 0 if there is none
+    uint32_t m_in_flight{0};
+    iomgr::timer_handle_t m_flush_timer_hdl{iomgr::null_timer_handle};
+};
+
+} // namespace homestore
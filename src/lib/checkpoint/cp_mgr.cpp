@@ -13,15 +13,20 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <optional>
+
 #include <urcu.h>
+#include <boost/fiber/operations.hpp>
 
 #include <homestore/homestore.hpp>
 #include <homestore/meta_service.hpp>
 #include <homestore/checkpoint/cp_mgr.hpp>
+#include <homestore/cpu_accounting.hpp>
 #include <homestore/homestore.hpp>
 #include "common/homestore_assert.hpp"
 #include "common/homestore_config.hpp"
 #include "common/resource_mgr.hpp"
+#include "common/thread_placement.hpp"
 #include "cp_internal.hpp"
 
 namespace homestore {
@@ -59,6 +64,47 @@ void CPManager::start_timer() {
     m_cp_timer_hdl = iomanager.schedule_global_timer(
         HS_DYNAMIC_CONFIG(generic.cp_timer_us) * 1000, true, nullptr /*cookie*/, iomgr::reactor_regex::all_worker,
         [this](void*) { trigger_cp_flush(false /* false */); }, true /* wait_to_schedule */);
+
+    if (auto const pacer_ms = HS_DYNAMIC_CONFIG(generic.cp_pacer_interval_ms); pacer_ms != 0) {
+        LOGINFO("cp pacer is set to {} ms", pacer_ms);
+        m_cp_pacer_timer_hdl = iomanager.schedule_global_timer(
+            uint64_cast(pacer_ms) * 1000 * 1000, true /* recurring */, nullptr /*cookie*/,
+            iomgr::reactor_regex::all_worker, [this](void*) { pace_cp(); }, true /* wait_to_schedule */);
+    }
+
+    if (auto const predict_ms = HS_DYNAMIC_CONFIG(generic.cp_predict_interval_ms); predict_ms != 0) {
+        LOGINFO("cp predict interval is set to {} ms", predict_ms);
+        m_cp_predict_timer_hdl = iomanager.schedule_global_timer(
+            uint64_cast(predict_ms) * 1000 * 1000, true /* recurring */, nullptr /*cookie*/,
+            iomgr::reactor_regex::all_worker, [this](void*) { predict_cp(); }, true /* wait_to_schedule */);
+    }
+}
+
+void CPManager::pace_cp() {
+    // Dirty state is flushed in small CPs as soon as it builds up, a CP in flush is left to finish before the next one
+    if (resource_mgr().get_cp_pressure_pct() < HS_DYNAMIC_CONFIG(generic.cp_pacer_trigger_percent)) { return; }
+    {
+        std::unique_lock< std::mutex > lk(m_trigger_cp_mtx);
+        if (m_in_flush_phase) { return; }
+    }
+    COUNTER_INCREMENT(*m_metrics, paced_cp_cnt, 1);
+    trigger_cp_flush(false /* force */);
+}
+
+void CPManager::predict_cp() {
+    // Resource growth is sampled even while a CP is in flush, so that the rates are current once it is done
+    auto const ms_to_limit = resource_mgr().predict_ms_to_cp_limit();
+    auto const lead_ms =
+        (m_avg_cp_us.load(std::memory_order_relaxed) * (100 + HS_DYNAMIC_CONFIG(generic.cp_predict_margin_percent))) /
+        (100 * 1000);
+    if (ms_to_limit > lead_ms) { return; }
+    {
+        std::unique_lock< std::mutex > lk(m_trigger_cp_mtx);
+        if (m_in_flush_phase) { return; }
+    }
+    HS_PERIODIC_LOG(DEBUG, cp, "Triggering cp as resource limit is predicted to be hit in {} ms", ms_to_limit);
+    COUNTER_INCREMENT(*m_metrics, predicted_cp_cnt, 1);
+    trigger_cp_flush(false /* force */);
 }
 
 void CPManager::on_meta_blk_found(const sisl::byte_view& buf, void* meta_cookie) {
@@ -74,20 +120,49 @@ void CPManager::create_first_cp() {
     m_cur_cp->m_cp_id = m_sb->m_last_flushed_cp + 1;
 }
 
-void CPManager::shutdown() {
+void CPManager::shutdown(bool fast) {
     LOGINFO("Stopping cp timer");
-    iomanager.cancel_timer(m_cp_timer_hdl, true);
-    m_cp_timer_hdl = iomgr::null_timer_handle;
+    if (m_cp_timer_hdl != iomgr::null_timer_handle) {
+        iomanager.cancel_timer(m_cp_timer_hdl, true);
+        m_cp_timer_hdl = iomgr::null_timer_handle;
+    }
+    if (m_cp_pacer_timer_hdl != iomgr::null_timer_handle) {
+        iomanager.cancel_timer(m_cp_pacer_timer_hdl, true);
+        m_cp_pacer_timer_hdl = iomgr::null_timer_handle;
+    }
+    if (m_cp_predict_timer_hdl != iomgr::null_timer_handle) {
+        iomanager.cancel_timer(m_cp_predict_timer_hdl, true);
+        m_cp_predict_timer_hdl = iomgr::null_timer_handle;
+    }
 
+    std::optional< folly::SharedPromise< bool > > dropped_trigger;
     {
         std::unique_lock< std::mutex > lk(m_trigger_cp_mtx);
         m_cp_shutdown_initiated = true;
+        if (fast && m_pending_trigger_cp) {
+            // Back to back cp asked for before the shutdown is not to be started either
+            dropped_trigger = std::move(m_pending_trigger_cp_comp);
+            m_pending_trigger_cp = false;
+        }
     }
+    if (dropped_trigger) { dropped_trigger->setValue(false); }
 
-    LOGINFO("Trigger cp flush at CP shutdown");
-    auto success = do_trigger_cp_flush(true /* force */, true /* flush_on_shutdown */).get();
-    HS_REL_ASSERT_EQ(success, true, "CP Flush failed");
-    LOGINFO("Trigger cp done");
+    if (fast) {
+        // A cp in flush has its index txn journal persisted already, so it is let to finish instead of leaving it to
+        // the repair at the next start. Its cleanup could still be on, after the end of its flush phase.
+        LOGINFO("Skipping cp flush at fast CP shutdown, waiting for the cp in flush to complete");
+        {
+            std::unique_lock< std::mutex > lk(m_trigger_cp_mtx);
+            m_flush_phase_cv.wait(lk, [this]() { return !m_in_flush_phase; });
+        }
+        std::unique_lock< iomgr::FiberManagerLib::mutex > cleanup_lg{m_cp_cleanup_mtx};
+        LOGINFO("CP shutdown without flush of cp={}, last flushed cp={}", m_cur_cp->id(), m_sb->m_last_flushed_cp);
+    } else {
+        LOGINFO("Trigger cp flush at CP shutdown");
+        auto success = do_trigger_cp_flush(true /* force */, true /* flush_on_shutdown */).get();
+        HS_REL_ASSERT_EQ(success, true, "CP Flush failed");
+        LOGINFO("Trigger cp done");
+    }
 
     delete (m_cur_cp);
     rcu_xchg_pointer(&m_cur_cp, nullptr);
@@ -103,7 +178,7 @@ void CPManager::register_consumer(cp_consumer_t consumer_id, std::unique_ptr< CP
     size_t idx = (size_t)consumer_id;
     m_cp_cb_table[idx] = std::move(callbacks);
     if (m_cp_cb_table[idx]) {
-        m_cur_cp->m_contexts[idx] = std::move(m_cp_cb_table[idx]->on_switchover_cp(nullptr, m_cur_cp));
+        m_cur_cp->set_context(consumer_id, m_cp_cb_table[idx]->on_switchover_cp(nullptr, m_cur_cp));
     }
 }
 
@@ -125,7 +200,14 @@ CP* CPManager::cp_io_enter() {
 }
 
 void CPManager::cp_ref(CP* cp) {
-    cp->m_enter_cnt.increment(1);
+    // Slots are counted on only within the rcu read section, so that the fold at switchover sees all the counts on them
+    rcu_read_lock();
+    if (cp->m_enter_cnt.m_sharded.load(std::memory_order_acquire)) {
+        cp->m_enter_cnt.m_slots[cp_enter_counter::this_slot()].count.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        cp->m_enter_cnt.m_shared.increment(1);
+    }
+    rcu_read_unlock();
 #ifndef NDEBUG
     auto status = cp->m_cp_status.load();
     HS_DBG_ASSERT((status == cp_status_t::cp_io_ready || status == cp_status_t::cp_trigger ||
@@ -136,7 +218,16 @@ void CPManager::cp_ref(CP* cp) {
 
 void CPManager::cp_io_exit(CP* cp) {
     HS_DBG_ASSERT_NE(cp->m_cp_status, cp_status_t::cp_flushing);
-    if (cp->m_enter_cnt.decrement_testz(1) && (cp->m_cp_status == cp_status_t::cp_flush_prepare)) {
+    rcu_read_lock();
+    if (cp->m_enter_cnt.m_sharded.load(std::memory_order_acquire)) {
+        // CP is not switched over yet, so this can't be the last exit of it
+        cp->m_enter_cnt.m_slots[cp_enter_counter::this_slot()].count.fetch_sub(1, std::memory_order_relaxed);
+        rcu_read_unlock();
+        return;
+    }
+    rcu_read_unlock();
+
+    if (cp->m_enter_cnt.m_shared.decrement_testz(1) && (cp->m_cp_status == cp_status_t::cp_flush_prepare)) {
         m_wd_cp->set_cp(cp);
         cp_start_flush(cp);
     }
@@ -152,6 +243,9 @@ folly::Future< bool > CPManager::trigger_cp_flush(bool force) {
 }
 
 folly::Future< bool > CPManager::do_trigger_cp_flush(bool force, bool flush_on_shutdown) {
+    // Nothing is dirtied by a read only open, whose cps would only write to the devices
+    if (hs()->is_read_only()) { return folly::makeFuture< bool >(true); }
+
     std::unique_lock< std::mutex > lk(m_trigger_cp_mtx);
 
     if (m_in_flush_phase) {
@@ -170,11 +264,16 @@ folly::Future< bool > CPManager::do_trigger_cp_flush(bool force, bool flush_on_s
             return folly::makeFuture< bool >(false);
         }
     }
+    if (m_cp_shutdown_initiated && !flush_on_shutdown && !m_pending_trigger_cp) {
+        // Only the final cp of the shutdown, or the back to back one it asked for, is started once shutdown is on
+        return folly::makeFuture< bool >(false);
+    }
     m_in_flush_phase = true;
 
     folly::Future< bool > ret_fut = folly::Future< bool >::makeEmpty();
     auto cur_cp = cp_guard();
     cur_cp->m_cp_status = cp_status_t::cp_trigger;
+    cur_cp->m_trigger_time = Clock::now();
     HS_PERIODIC_LOG(INFO, cp, "<<<<<<<<<<< Triggering flush of the CP {}", cur_cp->to_string());
     COUNTER_INCREMENT(*m_metrics, cp_cnt, 1);
     m_wd_cp->set_cp(cur_cp.get());
@@ -187,15 +286,18 @@ folly::Future< bool > CPManager::do_trigger_cp_flush(bool force, bool flush_on_s
     // sealer should be the first one to switch over
     auto& sealer_cp = m_cp_cb_table[(size_t)cp_consumer_t::SEALER];
     if (sealer_cp) {
-        new_cp->m_contexts[(size_t)cp_consumer_t::SEALER] = std::move(sealer_cp->on_switchover_cp(cur_cp.get(), new_cp));
+        new_cp->set_context(cp_consumer_t::SEALER, sealer_cp->on_switchover_cp(cur_cp.get(), new_cp));
     }
     // switch over other consumers
     for (size_t svcid = 0; svcid < (size_t)cp_consumer_t::SENTINEL; svcid++) {
         if (svcid == (size_t)cp_consumer_t::SEALER) { continue; }
         auto& consumer = m_cp_cb_table[svcid];
-        if (consumer) { new_cp->m_contexts[svcid] = std::move(consumer->on_switchover_cp(cur_cp.get(), new_cp)); }
+        if (consumer) { new_cp->set_context(cp_consumer_t(svcid), consumer->on_switchover_cp(cur_cp.get(), new_cp)); }
     }
 
+    cur_cp->m_switchover_us = get_elapsed_time_us(cur_cp->m_trigger_time);
+    HISTOGRAM_OBSERVE(*m_metrics, cp_switchover_latency, cur_cp->m_switchover_us);
+
     HS_PERIODIC_LOG(DEBUG, cp, "CP Attached completed, proceed to exit cp critical section");
     if (m_pending_trigger_cp) {
         // Triggered because of back-2-back CP, use the pending promise/future.
@@ -209,8 +311,17 @@ folly::Future< bool > CPManager::do_trigger_cp_flush(bool force, bool flush_on_s
     cur_cp->m_cp_status = cp_status_t::cp_flush_prepare;
     new_cp->m_cp_status = cp_status_t::cp_io_ready;
     rcu_xchg_pointer(&m_cur_cp, new_cp);
+    cur_cp->m_enter_cnt.m_sharded.store(false, std::memory_order_release);
     synchronize_rcu();
 
+    // No thread counts on the slots of the switched over cp anymore, so they are folded into its shared counter in
+    // place of the bias. Our own guard is still in, so the counter can't reach zero here
+    int64_t slots_cnt{0};
+    for (auto const& s : cur_cp->m_enter_cnt.m_slots) {
+        slots_cnt += s.count.load(std::memory_order_relaxed);
+    }
+    cur_cp->m_enter_cnt.m_shared.increment(slots_cnt - cp_enter_counter::bias);
+
     // At this point we are sure that there is no thread working on prev_cp without incrementing the cp_enter count
     // We need to unlock the trigger mtx section before cp_guard goes out of context, because exit cp critical section
     // might start cp flush and we don't want that to hold this mutex.
@@ -221,13 +332,38 @@ folly::Future< bool > CPManager::do_trigger_cp_flush(bool force, bool flush_on_s
 }
 
 void CPManager::cp_start_flush(CP* cp) {
+    HS_CPU_SCOPE(CP);
     std::vector< folly::Future< bool > > futs;
     HS_PERIODIC_LOG(INFO, cp, "Starting CP {} flush", cp->id());
     cp->m_cp_status = cp_status_t::cp_flushing;
+    m_cp_flush_start_ms.store(get_time_since_epoch_ms(), std::memory_order_relaxed);
+    cp->m_flush_start_time = Clock::now();
+
+    // Each consumer starts its flush as soon as the consumers it depends on are flushed, so the independent ones flush
+    // concurrently. Dependants wait on the shared promise of the consumer, fulfilled once its flush is completed
+    using flushed_promises_t = std::array< folly::SharedPromise< bool >, (size_t)cp_consumer_t::SENTINEL >;
+    auto flushed = std::make_shared< flushed_promises_t >();
     for (size_t svcid = 0; svcid < (size_t)cp_consumer_t::SENTINEL; svcid++) {
         if (svcid == (size_t)cp_consumer_t::SEALER) { continue; }
         auto& consumer = m_cp_cb_table[svcid];
-        if (consumer) { futs.emplace_back(std::move(consumer->cp_flush(cp))); }
+        if (!consumer) {
+            (*flushed)[svcid].setValue(true);
+            continue;
+        }
+
+        std::vector< folly::Future< bool > > dep_futs;
+        for (auto const dep : consumer->cp_flush_dependencies()) {
+            HS_DBG_ASSERT(((dep != cp_consumer_t::SEALER) && ((size_t)dep != svcid)),
+                          "CP consumer={} can't depend on itself or the sealer", svcid);
+            if (dep != cp_consumer_t::SEALER) { dep_futs.emplace_back((*flushed)[(size_t)dep].getFuture()); }
+        }
+
+        futs.emplace_back(folly::collectAllUnsafe(dep_futs)
+                              .thenValue([this, cp, svcid](auto) { return flush_consumer(cp, svcid); })
+                              .thenValue([flushed, svcid](bool success) {
+                                  (*flushed)[svcid].setValue(success);
+                                  return success;
+                              }));
     }
 
     folly::collectAllUnsafe(futs).thenValue([this, cp](auto) {
@@ -235,13 +371,55 @@ void CPManager::cp_start_flush(CP* cp) {
         // at last as the cp_lsn updated here. Other component should
         // at least flushed to cp_lsn.
         auto& sealer_cp = m_cp_cb_table[(size_t)cp_consumer_t::SEALER];
-        if (sealer_cp) { sealer_cp->cp_flush(cp).wait(); }
+        if (sealer_cp) {
+            auto& span = cp->m_flush_span_us[(size_t)cp_consumer_t::SEALER];
+            span.first = get_elapsed_time_us(cp->m_flush_start_time);
+            sealer_cp->cp_flush(cp).wait();
+            span.second = get_elapsed_time_us(cp->m_flush_start_time);
+            observe_flush_latency((size_t)cp_consumer_t::SEALER, span.second - span.first);
+        }
         // All consumers have flushed for the cp
         on_cp_flush_done(cp);
     });
 }
 
+folly::Future< bool > CPManager::flush_consumer(CP* cp, size_t svcid) {
+    // Consumers flush in blocking fashion, so each is flushed from a different fiber to not be serialized behind others
+    auto p = std::make_shared< folly::Promise< bool > >();
+    auto f = p->getFuture();
+    iomanager.run_on_forget(m_cp_io_fibers[svcid % m_cp_io_fibers.size()], [this, cp, svcid, p]() {
+        cp->m_flush_span_us[svcid].first = get_elapsed_time_us(cp->m_flush_start_time);
+        m_cp_cb_table[svcid]->cp_flush(cp).thenValue([this, cp, svcid, p](bool success) {
+            auto& span = cp->m_flush_span_us[svcid];
+            span.second = get_elapsed_time_us(cp->m_flush_start_time);
+            observe_flush_latency(svcid, span.second - span.first);
+            p->setValue(success);
+        });
+    });
+    return f;
+}
+
+void CPManager::observe_flush_latency(size_t svcid, uint64_t latency_us) {
+    switch (svcid) {
+    case (size_t)cp_consumer_t::HS_CLIENT:
+        HISTOGRAM_OBSERVE(*m_metrics, cp_flush_client_latency, latency_us);
+        break;
+    case (size_t)cp_consumer_t::INDEX_SVC:
+        HISTOGRAM_OBSERVE(*m_metrics, cp_flush_index_latency, latency_us);
+        break;
+    case (size_t)cp_consumer_t::BLK_DATA_SVC:
+        HISTOGRAM_OBSERVE(*m_metrics, cp_flush_data_latency, latency_us);
+        break;
+    case (size_t)cp_consumer_t::REPLICATION_SVC:
+        HISTOGRAM_OBSERVE(*m_metrics, cp_flush_repl_latency, latency_us);
+        break;
+    default:
+        break;
+    }
+}
+
 void CPManager::on_cp_flush_done(CP* cp) {
+    HS_CPU_SCOPE(CP);
     HS_DBG_ASSERT_EQ(cp->m_cp_status, cp_status_t::cp_flushing);
     cp->m_cp_status = cp_status_t::cp_flush_done;
 
@@ -250,27 +428,61 @@ void CPManager::on_cp_flush_done(CP* cp) {
         ++(m_sb->m_last_flushed_cp);
         m_sb.write();
 
+        // Taken before the flush phase is ended, so that the cleanup of the next cp can't get ahead of this one
+        std::unique_lock< iomgr::FiberManagerLib::mutex > cleanup_lg{m_cp_cleanup_mtx};
+        bool const overlap = can_overlap_cleanup();
+        bool trigger_back_2_back_cp{false};
+        auto const end_flush_phase = [this, &trigger_back_2_back_cp]() {
+            std::unique_lock< std::mutex > lk(m_trigger_cp_mtx);
+            m_in_flush_phase = false;
+            trigger_back_2_back_cp = m_pending_trigger_cp;
+            m_flush_phase_cv.notify_all();
+        };
+
+        if (overlap) {
+            // CP is persisted already, so the next cp can start flushing while this one is being cleaned up
+            m_wd_cp->reset_cp();
+            end_flush_phase();
+            COUNTER_INCREMENT(*m_metrics, overlapped_cleanup_cnt, 1);
+            if (trigger_back_2_back_cp) {
+                HS_PERIODIC_LOG(INFO, cp, "Triggering back to back CP, overlapping cleanup of cp={}", cp->id());
+                COUNTER_INCREMENT(*m_metrics, back_to_back_cps, 1);
+                trigger_cp_flush(false);
+            }
+        }
+
+        auto entry = cp_history_entry(cp);
+        auto const cleanup_start = Clock::now();
         cleanup_cp(cp);
+        auto const cleanup_us = get_elapsed_time_us(cleanup_start);
+        auto const cp_us = get_elapsed_time_us(cp->m_trigger_time);
+        HISTOGRAM_OBSERVE(*m_metrics, cp_cleanup_latency, cleanup_us);
+        HISTOGRAM_OBSERVE(*m_metrics, cp_latency, cp_us);
+        auto const avg_us = m_avg_cp_us.load(std::memory_order_relaxed);
+        m_avg_cp_us.store((avg_us == 0) ? cp_us : (avg_us * 3 + cp_us) / 4, std::memory_order_relaxed);
+        entry["cleanup_us"] = cleanup_us;
+        entry["total_us"] = cp_us;
+        entry["overlapped_cleanup"] = overlap;
+        {
+            std::unique_lock lg{m_cp_history_mtx};
+            m_cp_history.emplace_back(std::move(entry));
+            if (m_cp_history.size() > max_cp_history) { m_cp_history.pop_front(); }
+        }
 
         // Setting promise will cause the CP manager destructor to cleanup before getting a chance to do the
         // checking if shutdown has been initiated or not.
         auto promise = std::move(cp->m_comp_promise);
-        m_wd_cp->reset_cp();
+        if (!overlap) { m_wd_cp->reset_cp(); }
         delete cp;
 
-        bool trigger_back_2_back_cp{false};
-
-        {
-            std::unique_lock< std::mutex > lk(m_trigger_cp_mtx);
-            m_in_flush_phase = false;
-            trigger_back_2_back_cp = m_pending_trigger_cp;
-        }
+        if (!overlap) { end_flush_phase(); }
+        cleanup_lg.unlock();
 
         promise.setValue(true);
 
         // Dont access any cp state after this, in case trigger_back_2_back_cp is false, because its false on
         // cp_shutdown_initated and setting this promise could destruct the CPManager itself.
-        if (trigger_back_2_back_cp) {
+        if (!overlap && trigger_back_2_back_cp) {
             HS_PERIODIC_LOG(INFO, cp, "Triggering back to back CP");
             COUNTER_INCREMENT(*m_metrics, back_to_back_cps, 1);
             trigger_cp_flush(false);
@@ -285,6 +497,55 @@ void CPManager::cleanup_cp(CP* cp) {
     }
 }
 
+bool CPManager::can_overlap_cleanup() const {
+    if (!HS_DYNAMIC_CONFIG(generic.cp_overlap_cleanup)) { return false; }
+    for (auto const& consumer : m_cp_cb_table) {
+        if (consumer && !consumer->cp_cleanup_can_overlap()) { return false; }
+    }
+    return true;
+}
+
+static constexpr std::array< const char*, (size_t)cp_consumer_t::SENTINEL > cp_consumer_names{
+    "hs_client", "index", "blk_data", "replication"};
+
+nlohmann::json CPManager::cp_history_entry(CP* cp) const {
+    nlohmann::json entry;
+    entry["cp_id"] = cp->id();
+    entry["switchover_us"] = cp->m_switchover_us;
+    entry["flush_prepare_us"] =
+        std::chrono::duration_cast< std::chrono::microseconds >(cp->m_flush_start_time - cp->m_trigger_time).count() -
+        cp->m_switchover_us;
+    entry["flush_us"] = get_elapsed_time_us(cp->m_flush_start_time);
+    for (size_t svcid = 0; svcid < (size_t)cp_consumer_t::SENTINEL; svcid++) {
+        auto& consumer = m_cp_cb_table[svcid];
+        if (!consumer) { continue; }
+        auto& js = entry["consumers"][cp_consumer_names[svcid]];
+        js["flush_start_us"] = cp->m_flush_span_us[svcid].first;
+        js["flush_end_us"] = cp->m_flush_span_us[svcid].second;
+        auto stats = consumer->cp_flush_stats(cp);
+        if (!stats.is_null()) { js["stats"] = std::move(stats); }
+    }
+    return entry;
+}
+
+nlohmann::json CPManager::get_status(int verbosity) const {
+    nlohmann::json js;
+    js["last_flushed_cp"] = m_sb->m_last_flushed_cp;
+    rcu_read_lock();
+    if (auto cp = rcu_dereference(m_cur_cp); cp) { js["current_cp"] = cp->to_string(); }
+    rcu_read_unlock();
+    {
+        std::unique_lock lg{m_cp_history_mtx};
+        // Only the last cp unless asked to be verbose
+        js["recent_cps"] = nlohmann::json::array();
+        auto it = ((verbosity > 0) || m_cp_history.empty()) ? m_cp_history.cbegin() : std::prev(m_cp_history.cend());
+        for (; it != m_cp_history.cend(); ++it) {
+            js["recent_cps"].push_back(*it);
+        }
+    }
+    return js;
+}
+
 void CPManager::start_cp_thread() {
     // Start WBCache flush threads
     struct Context {
@@ -297,6 +558,7 @@ void CPManager::start_cp_thread() {
     // Start a reactor with 9 fibers (8 for sync io)
     iomanager.create_reactor("cp_io", iomgr::INTERRUPT_LOOP, 8u, [this, ctx](bool is_started) {
         if (is_started) {
+            ThreadPlacement::bind_self(hs_thread_role_t::CP);
             {
                 std::unique_lock< std::mutex > lk{ctx->mtx};
                 auto v = iomanager.sync_io_capable_fibers();
@@ -313,6 +575,39 @@ void CPManager::start_cp_thread() {
     }
 }
 
+uint64_t CPManager::cp_flush_delay_us(uint64_t size) {
+    auto const limit_mbps = HS_DYNAMIC_CONFIG(generic.cp_flush_rate_limit_mbps);
+    if (limit_mbps == 0) { return 0; }
+
+    // Rate goes up when the cp risks being flagged by the watchdog, or the foreground writes being throttled by the
+    // journal, because of the flush taking long
+    double rate = double(limit_mbps) * 1024 * 1024; // bytes per sec
+    auto const journal_pct = resource_mgr().get_journal_pressure_pct();
+    if (journal_pct >= 100) { return 0; }
+    if (journal_pct >= 75) { rate *= 2; }
+    auto const flush_ms = get_time_since_epoch_ms() - m_cp_flush_start_ms.load(std::memory_order_relaxed);
+    if (flush_ms * 2 >= uint64_cast(HS_DYNAMIC_CONFIG(generic.cp_watchdog_timer_sec)) * 1000) { rate *= 4; }
+
+    // Bucket holds upto 10ms worth of the rate, so that short bursts go through undelayed
+    std::unique_lock lg{m_flush_rate_mtx};
+    auto const now = Clock::now();
+    auto const elapsed_us = std::chrono::duration_cast< std::chrono::microseconds >(now - m_flush_tokens_time).count();
+    m_flush_tokens = std::min(m_flush_tokens + (rate * elapsed_us) / 1000000, rate / 100);
+    m_flush_tokens_time = now;
+    m_flush_tokens -= double(size);
+    if (m_flush_tokens >= 0) { return 0; }
+
+    auto const delay_us = uint64_cast((-m_flush_tokens * 1000000) / rate);
+    COUNTER_INCREMENT(*m_metrics, cp_flush_throttled_us, delay_us);
+    return delay_us;
+}
+
+void CPManager::throttle_cp_flush(uint64_t size) {
+    if (auto const delay_us = cp_flush_delay_us(size); delay_us != 0) {
+        boost::this_fiber::sleep_for(std::chrono::microseconds{delay_us});
+    }
+}
+
 iomgr::io_fiber_t CPManager::pick_blocking_io_fiber() const {
     static thread_local std::random_device s_rd{};
     static thread_local std::default_random_engine s_re{s_rd()};
@@ -405,47 +700,74 @@ void CPWatchdog::cp_watchdog_timer() {
     // check if any cp to track
     if (m_cp == nullptr) { return; }
     const auto status = m_cp->get_status();
-    if ((status != cp_status_t::cp_flush_prepare) || (status != cp_status_t::cp_flushing)) { return; }
+    if ((status != cp_status_t::cp_flush_prepare) && (status != cp_status_t::cp_flushing)) { return; }
+#ifdef _PRERELEASE
+    // Flush is deliberately left incomplete while the crash is being simulated
+    if (hs()->crash_simulator().is_crashed()) { return; }
+#endif
 
     uint32_t cum_pct{0};
     uint32_t count{0};
+    CPCallbacks* laggard{nullptr};
+    int laggard_pct{100};
     for (auto& consumer : m_cp_mgr->consumer_list()) {
         if (consumer) {
+            const auto pct = consumer->cp_progress_percent();
             ++count;
-            cum_pct += consumer->cp_progress_percent();
+            cum_pct += pct;
+            if (pct < laggard_pct) {
+                laggard_pct = pct;
+                laggard = consumer.get();
+            }
         }
     }
-    if (m_progress_pct > cum_pct / count) {
+    if ((count != 0) && (cum_pct / count > m_progress_pct)) {
         // We are making progress in flushing the data.
         m_progress_pct = cum_pct / count;
+        m_last_state_ch_time = Clock::now();
         return;
     }
 
-    if (get_elapsed_time_ms(m_last_state_ch_time) >= m_timer_sec * 1000) {
-        LOGINFO("cp progress percent {} is not changed. time elapsed {}, cp state={} ", m_progress_pct,
-                get_elapsed_time_ms(m_last_state_ch_time), m_cp->to_string());
+    // check if enough time passed since last progress
+    const auto elapsed_ms = get_elapsed_time_ms(m_last_state_ch_time);
+    if (elapsed_ms < m_timer_sec * 1000) { return; }
+    LOGINFO("cp progress percent {} is not changed. time elapsed {}, cp state={} ", m_progress_pct, elapsed_ms,
+            m_cp->to_string());
+
+    // Only the consumer which is farthest behind is pushed, rest of them are not holding up the cp
+    if (laggard) {
+        LOGINFO("Attempting to repair the slow cp on the consumer with progress percent {}", laggard_pct);
+        laggard->repair_slow_cp();
     }
 
-    // check if enough time passed since last state change
     uint32_t max_time_multiplier = 12;
-    if (get_elapsed_time_ms(m_last_state_ch_time) < max_time_multiplier * m_timer_sec * 1000) {
-        uint32_t repair_attempted{0};
-        for (auto& consumer : m_cp_mgr->consumer_list()) {
-            if (consumer) {
-                const auto pct = consumer->cp_progress_percent();
-                if (pct != 100) {
-                    consumer->repair_slow_cp();
-                    ++repair_attempted;
-                }
-            }
-            if (repair_attempted) { return; }
-        }
+    HS_REL_ASSERT_LT(elapsed_ms, max_time_multiplier * m_timer_sec * 1000,
+                     "cp seems to be stuck. CP State={} total time elapsed {}", m_cp->to_string(), elapsed_ms);
+}
+
+cp_id_t CPContext::id() const { return m_cp->id(); }
 
-        HS_REL_ASSERT(0, "cp seems to be stuck. CP State={} total time elapsed {}", m_cp->to_string(),
-                      get_elapsed_time_ms(m_last_state_ch_time));
+/////////////////////////////////////////// CP class ////////////////////////////////////////////
+CP::~CP() {
+    for (auto& ctx : m_contexts) {
+        delete ctx.load(std::memory_order_relaxed);
     }
 }
 
-cp_id_t CPContext::id() const { return m_cp->id(); }
+void CP::set_context(cp_consumer_t consumer, std::unique_ptr< CPContext > context) {
+    delete m_contexts[(size_t)consumer].exchange(context.release(), std::memory_order_acq_rel);
+}
+
+CPContext* CP::create_context(cp_consumer_t consumer) const {
+    std::unique_lock lg{m_contexts_mtx};
+    auto& ctx = m_contexts[(size_t)consumer];
+    if (auto const created = ctx.load(std::memory_order_acquire); created) { return created; }
+
+    auto const& cb = m_cp_mgr->consumer_list()[(size_t)consumer];
+    if (!cb) { return nullptr; }
+    auto new_ctx = cb->create_cp_context(const_cast< CP* >(this)).release();
+    ctx.store(new_ctx, std::memory_order_release);
+    return new_ctx;
+}
 
 } // namespace homestore
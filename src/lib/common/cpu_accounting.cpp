@@ -0,0 +1,109 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <array>
+
+#include <sisl/metrics/metrics.hpp>
+#include <homestore/cpu_accounting.hpp>
+#include "common/tsc_clock.hpp"
+
+namespace homestore {
+class CPUAccountingMetrics : public sisl::MetricsGroup {
+public:
+    CPUAccountingMetrics() : sisl::MetricsGroup("CPUAccounting") {
+        REGISTER_HISTOGRAM(btree_cycles, "Cycles of the sampled btree ops", "cpu_cycles_per_op", {"subsys", "btree"},
+                           HistogramBucketsType(ExponentialOfTwoBuckets));
+        REGISTER_HISTOGRAM(wb_cache_cycles, "Cycles of the sampled wb cache ops", "cpu_cycles_per_op",
+                           {"subsys", "wb_cache"}, HistogramBucketsType(ExponentialOfTwoBuckets));
+        REGISTER_HISTOGRAM(blkalloc_cycles, "Cycles of the sampled blk allocs and frees", "cpu_cycles_per_op",
+                           {"subsys", "blkalloc"}, HistogramBucketsType(ExponentialOfTwoBuckets));
+        REGISTER_HISTOGRAM(logdev_cycles, "Cycles of the sampled logdev flushes", "cpu_cycles_per_op",
+                           {"subsys", "logdev"}, HistogramBucketsType(ExponentialOfTwoBuckets));
+        REGISTER_HISTOGRAM(replication_cycles, "Cycles of the sampled replication commits", "cpu_cycles_per_op",
+                           {"subsys", "replication"}, HistogramBucketsType(ExponentialOfTwoBuckets));
+        REGISTER_HISTOGRAM(cp_cycles, "Cycles of the sampled cp flush steps", "cpu_cycles_per_op", {"subsys", "cp"},
+                           HistogramBucketsType(ExponentialOfTwoBuckets));
+        register_me_to_farm();
+    }
+
+    CPUAccountingMetrics(const CPUAccountingMetrics&) = delete;
+    CPUAccountingMetrics& operator=(const CPUAccountingMetrics&) = delete;
+    ~CPUAccountingMetrics() { deregister_me_from_farm(); }
+};
+
+static constexpr size_t s_num_subsys{6};
+
+struct subsys_totals {
+    std::atomic< uint64_t > sampled_ops{0};
+    std::atomic< uint64_t > cycles{0};
+};
+
+static CPUAccountingMetrics& metrics() {
+    static CPUAccountingMetrics s_metrics;
+    return s_metrics;
+}
+
+static std::array< subsys_totals, s_num_subsys >& totals() {
+    static std::array< subsys_totals, s_num_subsys > s_totals;
+    return s_totals;
+}
+
+void CPUAccounting::record(cpu_subsys_t subsys, uint64_t cycles) {
+    auto& t = totals()[enum_value(subsys)];
+    t.sampled_ops.fetch_add(1, std::memory_order_relaxed);
+    t.cycles.fetch_add(cycles, std::memory_order_relaxed);
+
+    auto& m = metrics();
+    switch (subsys) {
+    case cpu_subsys_t::BTREE:
+        HISTOGRAM_OBSERVE(m, btree_cycles, cycles);
+        break;
+    case cpu_subsys_t::WB_CACHE:
+        HISTOGRAM_OBSERVE(m, wb_cache_cycles, cycles);
+        break;
+    case cpu_subsys_t::BLKALLOC:
+        HISTOGRAM_OBSERVE(m, blkalloc_cycles, cycles);
+        break;
+    case cpu_subsys_t::LOGDEV:
+        HISTOGRAM_OBSERVE(m, logdev_cycles, cycles);
+        break;
+    case cpu_subsys_t::REPLICATION:
+        HISTOGRAM_OBSERVE(m, replication_cycles, cycles);
+        break;
+    case cpu_subsys_t::CP:
+        HISTOGRAM_OBSERVE(m, cp_cycles, cycles);
+        break;
+    }
+}
+
+nlohmann::json CPUAccounting::get_status(int verbosity) {
+    nlohmann::json js;
+    auto const every = sample_every();
+    js["sample_every"] = every;
+    for (size_t i{0}; i < s_num_subsys; ++i) {
+        auto const& t = totals()[i];
+        auto const nops = t.sampled_ops.load(std::memory_order_relaxed);
+        auto const cycles = t.cycles.load(std::memory_order_relaxed);
+
+        nlohmann::json sjs;
+        sjs["sampled_ops"] = nops;
+        sjs["estimated_ops"] = nops * every;
+        sjs["cycles_per_op"] = (nops == 0) ? 0 : (cycles / nops);
+        sjs["us_per_op"] = (nops == 0) ? 0.0 : (double(TscClock::to_us(cycles)) / nops);
+        if (verbosity > 0) { sjs["estimated_cycles"] = cycles * every; }
+        js[enum_name(cpu_subsys_t(i))] = std::move(sjs);
+    }
+    return js;
+}
+} // namespace homestore
@@ -16,11 +16,19 @@
 #include <boost/uuid/random_generator.hpp>
 #include "homestore_utils.hpp"
 #include "homestore_assert.hpp"
+#include "numa_buf_pool.hpp"
+#include "io_buf_pool.hpp"
 
 namespace homestore {
 uint8_t* hs_utils::iobuf_alloc(const size_t size, const sisl::buftag tag, const size_t alignment) {
     if (tag == sisl::buftag::btree_node) {
         HS_DBG_ASSERT_EQ(size, m_btree_mempool_size);
+        if (m_numa_buf_pool) { return m_numa_buf_pool->alloc(); }
+    }
+    if (m_io_buf_pool) {
+        if (auto buf = m_io_buf_pool->alloc(size, alignment); buf) { return buf; }
+    }
+    if (tag == sisl::buftag::btree_node) {
         auto buf = iomanager.iobuf_pool_alloc(alignment, size, tag);
         HS_REL_ASSERT_NOTNULL(buf, "io buf is null. probably going out of memory");
         return buf;
@@ -33,14 +41,47 @@ uint8_t* hs_utils::iobuf_alloc(const size_t size, const sisl::buftag tag, const
 uuid_t hs_utils::gen_random_uuid() { return boost::uuids::random_generator()(); }
 
 void hs_utils::iobuf_free(uint8_t* const ptr, const sisl::buftag tag) {
+    if (m_io_buf_pool && m_io_buf_pool->owns(ptr)) {
+        m_io_buf_pool->free(ptr);
+        return;
+    }
     if (tag == sisl::buftag::btree_node) {
+        if (m_numa_buf_pool) {
+            m_numa_buf_pool->free(ptr);
+            return;
+        }
         iomanager.iobuf_pool_free(ptr, m_btree_mempool_size, tag);
     } else {
         iomanager.iobuf_free(ptr, tag);
     }
 }
 
-void hs_utils::set_btree_mempool_size(const size_t size) { m_btree_mempool_size = size; }
+void hs_utils::set_btree_mempool_size(const size_t size) {
+    m_btree_mempool_size = size;
+
+    // Pool is set once for the lifetime of the process, since the buffers are to be freed where they came from. It
+    // is deliberately not destroyed, as the buffers can outlive the homestore instance.
+    if (m_numa_buf_pool) {
+        HS_REL_ASSERT_EQ(m_numa_buf_pool->buf_size(), size, "Btree node size changed across restarts of homestore");
+    } else if (HS_DYNAMIC_CONFIG(generic.index_numa_local_bufs) && !iomanager.is_spdk_mode()) {
+        // Under spdk, btree nodes are to be in the hugepage memory of iomgr, which the drive can dma to
+        m_numa_buf_pool = new NumaBufPool(size, size);
+    }
+}
+
+void hs_utils::init_io_buf_pool() {
+    // Same as the numa pool, it is set once for the lifetime of the process and never destroyed
+    if (m_io_buf_pool) { return; }
+    auto const size_mb = HS_DYNAMIC_CONFIG(generic.io_buf_pool_size_mb);
+    if ((size_mb == 0) || iomanager.is_spdk_mode()) {
+        // Under spdk, io buffers are to be in the hugepage memory of iomgr, which the drive can dma to
+        return;
+    }
+    m_io_buf_pool = new IoBufPool(uint64_cast(size_mb) * 1024 * 1024,
+                                  uint64_cast(HS_DYNAMIC_CONFIG(generic.io_buf_pool_huge_page_kb)) * 1024);
+    LOGINFO("Io buffers come from a pool of size_mb={} backed by {}", m_io_buf_pool->size() / (1024 * 1024),
+            m_io_buf_pool->is_hugetlb() ? "hugetlb pages" : "transparent huge pages");
+}
 
 uint64_t hs_utils::aligned_size(const size_t size, const size_t alignment) { return sisl::round_up(size, alignment); }
 
@@ -118,4 +159,6 @@ bool hs_utils::topological_sort(std::unordered_map< std::string, std::vector< st
 }
 
 size_t hs_utils::m_btree_mempool_size;
+NumaBufPool* hs_utils::m_numa_buf_pool{nullptr};
+IoBufPool* hs_utils::m_io_buf_pool{nullptr};
 } // namespace homestore
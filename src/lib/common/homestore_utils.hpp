@@ -24,13 +24,19 @@ std::string to_hex(T i) {
     return fmt::format("{0:x}", i);
 }
 
+class NumaBufPool;
+class IoBufPool;
+
 class hs_utils {
     static size_t m_btree_mempool_size;
+    static NumaBufPool* m_numa_buf_pool;
+    static IoBufPool* m_io_buf_pool;
 
 public:
     static uint8_t* iobuf_alloc(const size_t size, const sisl::buftag tag, const size_t alignment);
     static void iobuf_free(uint8_t* const ptr, const sisl::buftag tag);
     static void set_btree_mempool_size(const size_t size);
+    static void init_io_buf_pool();
     static void iobuf_free(uint8_t* const ptr, const sisl::buftag tag, const size_t size);
     static uint64_t aligned_size(const size_t size, const size_t alignment);
     static bool mod_aligned_sz(const size_t size_to_check, const size_t align_sz);
@@ -53,4 +59,18 @@ public:
     static bool topological_sort(std::unordered_map< std::string, std::vector< std::string > >& DAG,
                                  std::vector< std::string >& ordered_entries);
 };
+
+// Owner of a buffer from hs_utils::iobuf_alloc, which frees it back to where it came from
+template < sisl::buftag Tag >
+struct iobuf_deleter {
+    void operator()(uint8_t* buf) const { hs_utils::iobuf_free(buf, Tag); }
+};
+
+template < sisl::buftag Tag >
+using iobuf_unique_ptr = std::unique_ptr< uint8_t, iobuf_deleter< Tag > >;
+
+template < sisl::buftag Tag >
+iobuf_unique_ptr< Tag > make_iobuf(const size_t size, const size_t alignment) {
+    return iobuf_unique_ptr< Tag >{hs_utils::iobuf_alloc(size, Tag, alignment)};
+}
 } // namespace homestore
@@ -0,0 +1,149 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <sisl/fds/utils.hpp>
+#include "io_buf_pool.hpp"
+#include "homestore_assert.hpp"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+namespace homestore {
+// Bytes of free buffers of a class kept by a thread, beyond which half of them go back to the central list
+static constexpr size_t s_thread_cache_bytes{1024 * 1024};
+
+IoBufPool::IoBufPool(size_t size, size_t huge_page_size) {
+    HS_REL_ASSERT(std::has_single_bit(huge_page_size) && (huge_page_size >= slab_size),
+                  "Io buf pool needs a power of two huge page size of at least the slab size, huge_page_size={}",
+                  huge_page_size);
+    m_size = sisl::round_up(size, huge_page_size);
+
+    auto const page_shift = uint32_t(std::countr_zero(huge_page_size));
+    auto p = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (page_shift << MAP_HUGE_SHIFT), -1, 0);
+    if (p != MAP_FAILED) {
+        m_mapped = r_cast< uint8_t* >(p);
+        m_mapped_size = m_size;
+        m_base = m_mapped;
+        m_hugetlb = true;
+    } else {
+        LOGINFO("No hugetlb pages of size={} for the io buf pool of size={}, errno={}, using transparent huge pages",
+                huge_page_size, m_size, errno);
+
+        // Map one more slab to align the region to the slab size, so that each slab can be in one huge page
+        m_mapped_size = m_size + slab_size;
+        p = ::mmap(nullptr, m_mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1,
+                   0);
+        HS_REL_ASSERT(p != MAP_FAILED, "Failed to map the io buf pool of size={}, errno={}", m_mapped_size, errno);
+        m_mapped = r_cast< uint8_t* >(p);
+        m_base = r_cast< uint8_t* >(sisl::round_up(r_cast< uintptr_t >(m_mapped), slab_size));
+        ::madvise(m_base, m_size, MADV_HUGEPAGE);
+    }
+    m_slab_class.resize(m_size / slab_size);
+}
+
+IoBufPool::~IoBufPool() { ::munmap(m_mapped, m_mapped_size); }
+
+uint32_t IoBufPool::class_of(size_t size) {
+    auto const shift = uint32_t(std::bit_width(std::max(size, size_t{1} << min_class_shift) - 1));
+    return shift - min_class_shift;
+}
+
+size_t IoBufPool::cache_limit(uint32_t cls) { return std::max(s_thread_cache_bytes / class_size(cls), size_t{2}); }
+
+IoBufPool::thread_cache& IoBufPool::my_cache() {
+    // There is one pool in a process, which outlives the threads, so the cache of a thread needs no key by pool
+    static thread_local thread_cache t_cache;
+    if (t_cache.pool == nullptr) { t_cache.pool = this; }
+    return t_cache;
+}
+
+IoBufPool::thread_cache::~thread_cache() {
+    if (pool == nullptr) { return; }
+    for (uint32_t cls{0}; cls < num_classes; ++cls) {
+        pool->spill(cls, bufs[cls], bufs[cls].size());
+    }
+}
+
+uint8_t* IoBufPool::alloc(size_t size, size_t align_size) {
+    // Buffers of a class are aligned to its size, so an alignment larger than the size only moves it up the classes
+    auto const cls = class_of(std::max(size, align_size));
+    if (cls >= num_classes) { return nullptr; }
+
+    auto& bufs = my_cache().bufs[cls];
+    if (bufs.empty()) {
+        refill(cls, bufs);
+        if (bufs.empty()) { return nullptr; }
+    }
+    auto buf = bufs.back();
+    bufs.pop_back();
+    return buf;
+}
+
+void IoBufPool::free(uint8_t* buf) {
+    auto const cls = m_slab_class[size_t(buf - m_base) / slab_size];
+    auto& bufs = my_cache().bufs[cls];
+    bufs.push_back(buf);
+    if (bufs.size() > cache_limit(cls)) { spill(cls, bufs, bufs.size() / 2); }
+}
+
+void IoBufPool::refill(uint32_t cls, std::vector< uint8_t* >& bufs) {
+    auto const batch = std::max(cache_limit(cls) / 2, size_t{1});
+    auto& fl = m_classes[cls];
+    {
+        std::unique_lock lg{fl.mtx};
+        auto const n = std::min(batch, fl.free_bufs.size());
+        bufs.insert(bufs.end(), fl.free_bufs.end() - n, fl.free_bufs.end());
+        fl.free_bufs.resize(fl.free_bufs.size() - n);
+    }
+    if (!bufs.empty()) { return; }
+
+    auto const slab_num = m_next_slab.fetch_add(1, std::memory_order_relaxed);
+    if (slab_num >= m_slab_class.size()) { return; }
+    auto const slab = m_base + (slab_num * slab_size);
+    m_slab_class[slab_num] = uint8_t(cls);
+
+    // Touch the entire slab from this thread, so that its pages are placed in this thread's numa node
+    std::memset(slab, 0, slab_size);
+
+    // Keep a batch in this thread and give the rest of the slab to the central list
+    auto const bsize = class_size(cls);
+    auto const nbufs = slab_size / bsize;
+    auto const nkeep = std::min(batch, nbufs);
+    for (auto i = nbufs; i > nbufs - nkeep; --i) {
+        bufs.push_back(slab + ((i - 1) * bsize));
+    }
+    if (nkeep < nbufs) {
+        std::unique_lock lg{fl.mtx};
+        fl.free_bufs.reserve(fl.free_bufs.size() + nbufs - nkeep);
+        for (auto i = nbufs - nkeep; i > 0; --i) {
+            fl.free_bufs.push_back(slab + ((i - 1) * bsize));
+        }
+    }
+}
+
+void IoBufPool::spill(uint32_t cls, std::vector< uint8_t* >& bufs, size_t count) {
+    if (count == 0) { return; }
+    auto& fl = m_classes[cls];
+    std::unique_lock lg{fl.mtx};
+    fl.free_bufs.insert(fl.free_bufs.end(), bufs.end() - count, bufs.end());
+    bufs.resize(bufs.size() - count);
+}
+} // namespace homestore
@@ -0,0 +1,82 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace homestore {
+
+// Pool of aligned io buffers of power of two sizes from 4KB to 1MB, carved out of one region of huge pages, so that
+// the log group, index node and meta blk buffers do not each take their own TLB entries and allocator round trips.
+//
+// The region is mapped once with hugetlb pages of 2MB or 1GB, or with transparent huge pages if hugetlb pages are not
+// available, and cut into 2MB slabs on demand. Every slab holds the buffers of one size class, which are aligned to
+// their size. Each thread caches a few free buffers of every class and goes to the central free list of the class
+// only in batches. The region is never returned to the system until the pool is destroyed.
+class IoBufPool {
+public:
+    static constexpr size_t slab_size = 2 * 1024 * 1024;
+    static constexpr uint32_t min_class_shift = 12;
+    static constexpr uint32_t max_class_shift = 20;
+    static constexpr uint32_t num_classes = max_class_shift - min_class_shift + 1;
+
+    IoBufPool(size_t size, size_t huge_page_size);
+    ~IoBufPool();
+    IoBufPool(IoBufPool const&) = delete;
+    IoBufPool& operator=(IoBufPool const&) = delete;
+
+    // Returns nullptr if the buffer is larger than the largest class or the region is exhausted, so that the caller
+    // allocates it elsewhere
+    uint8_t* alloc(size_t size, size_t align_size);
+    void free(uint8_t* buf);
+
+    bool owns(uint8_t const* buf) const { return (buf >= m_base) && (buf < m_base + m_size); }
+    size_t size() const { return m_size; }
+    bool is_hugetlb() const { return m_hugetlb; }
+
+private:
+    struct alignas(64) class_free_list {
+        std::mutex mtx;
+        std::vector< uint8_t* > free_bufs;
+    };
+
+    struct thread_cache {
+        IoBufPool* pool{nullptr};
+        std::array< std::vector< uint8_t* >, num_classes > bufs;
+        ~thread_cache();
+    };
+
+    static uint32_t class_of(size_t size);
+    static size_t class_size(uint32_t cls) { return size_t{1} << (cls + min_class_shift); }
+    static size_t cache_limit(uint32_t cls);
+    thread_cache& my_cache();
+    void refill(uint32_t cls, std::vector< uint8_t* >& bufs);
+    void spill(uint32_t cls, std::vector< uint8_t* >& bufs, size_t count);
+
+private:
+    uint8_t* m_mapped{nullptr};
+    size_t m_mapped_size{0};
+    uint8_t* m_base{nullptr};
+    size_t m_size{0};
+    bool m_hugetlb{false};
+
+    std::atomic< size_t > m_next_slab{0};
+    std::vector< uint8_t > m_slab_class; // Size class of every carved slab, to find the class of a freed buffer
+    std::array< class_free_list, num_classes > m_classes;
+};
+} // namespace homestore
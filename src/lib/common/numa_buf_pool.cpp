@@ -0,0 +1,84 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iomgr/iomgr.hpp>
+#include "numa_buf_pool.hpp"
+#include "homestore_assert.hpp"
+
+namespace homestore {
+NumaBufPool::NumaBufPool(size_t buf_size, size_t align_size) : m_buf_size{buf_size}, m_align_size{align_size} {
+    HS_REL_ASSERT((slab_size % buf_size == 0) && (buf_size % align_size == 0),
+                  "Numa buf pool needs buf_size={} aligned to {} and dividing the slab size", buf_size, align_size);
+}
+
+NumaBufPool::~NumaBufPool() {
+    for (auto& fl : m_nodes) {
+        for (auto slab : fl.slabs) {
+            iomanager.iobuf_free(slab, sisl::buftag::btree_node);
+        }
+    }
+}
+
+uint32_t NumaBufPool::cur_numa_node() {
+    unsigned cpu{0};
+    unsigned node{0};
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 29)
+    if (::getcpu(&cpu, &node) != 0) { return 0; }
+#else
+    if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) { return 0; }
+#endif
+    return std::min(uint32_cast(node), max_numa_nodes - 1);
+}
+
+uint8_t* NumaBufPool::alloc() {
+    auto const node = cur_numa_node();
+    auto& fl = m_nodes[node];
+
+    std::unique_lock lg{fl.mtx};
+    if (fl.free_bufs.empty()) { add_slab(node, fl); }
+    auto buf = fl.free_bufs.back();
+    fl.free_bufs.pop_back();
+    return buf;
+}
+
+void NumaBufPool::free(uint8_t* buf) {
+    auto const slab = r_cast< uint8_t* >(r_cast< uintptr_t >(buf) & ~(uintptr_t(slab_size) - 1));
+    auto& fl = m_nodes[r_cast< slab_hdr const* >(slab)->numa_node];
+
+    std::unique_lock lg{fl.mtx};
+    fl.free_bufs.push_back(buf);
+}
+
+void NumaBufPool::add_slab(uint32_t node, numa_free_list& fl) {
+    auto slab = iomanager.iobuf_alloc(slab_size, slab_size, sisl::buftag::btree_node);
+    HS_REL_ASSERT_NOTNULL(slab, "numa slab is null. probably going out of memory");
+
+    // Touch the entire slab from this thread, so that its pages are placed in this thread's numa node
+    std::memset(slab, 0, slab_size);
+    new (slab) slab_hdr{node};
+    fl.slabs.push_back(slab);
+
+    auto const nbufs = slab_size / m_buf_size;
+    fl.free_bufs.reserve(fl.free_bufs.size() + nbufs - 1);
+    for (auto i = nbufs - 1; i > 0; --i) {
+        fl.free_bufs.push_back(slab + (i * m_buf_size));
+    }
+}
+} // namespace homestore
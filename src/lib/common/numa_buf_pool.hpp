@@ -0,0 +1,63 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace homestore {
+
+// Pool of fixed size io buffers with one free list per NUMA node. Buffers are carved out of large slabs which are
+// first touched by the allocating thread, so that the kernel places their pages on the NUMA node of that thread. A
+// freed buffer always goes back to the free list of the node its slab belongs to, so that it remains local to the
+// threads of that node. Slabs are never returned to the system until the pool is destroyed.
+class NumaBufPool {
+public:
+    static constexpr uint32_t max_numa_nodes = 8;
+    static constexpr size_t slab_size = 2 * 1024 * 1024;
+
+    NumaBufPool(size_t buf_size, size_t align_size);
+    ~NumaBufPool();
+    NumaBufPool(NumaBufPool const&) = delete;
+    NumaBufPool& operator=(NumaBufPool const&) = delete;
+
+    uint8_t* alloc();
+    void free(uint8_t* buf);
+    size_t buf_size() const { return m_buf_size; }
+
+    static uint32_t cur_numa_node();
+
+private:
+    struct alignas(64) numa_free_list {
+        std::mutex mtx;
+        std::vector< uint8_t* > free_bufs;
+        std::vector< uint8_t* > slabs;
+    };
+
+    // First buffer slot of every slab holds this header, so that a free can find the node of the buffer
+    struct slab_hdr {
+        uint32_t numa_node;
+    };
+
+    void add_slab(uint32_t node, numa_free_list& fl);
+
+private:
+    size_t m_buf_size;
+    size_t m_align_size;
+    std::array< numa_free_list, max_numa_nodes > m_nodes;
+};
+} // namespace homestore
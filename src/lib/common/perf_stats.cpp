@@ -0,0 +1,191 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <mutex>
+
+#include <homestore/perf_stats.hpp>
+#include "common/tsc_clock.hpp"
+
+namespace homestore {
+static constexpr size_t s_num_ops{7};
+static constexpr size_t s_num_caches{3};
+
+// Log linear buckets of latencies in us, values below 16 have a bucket each, the rest 8 buckets per power of two
+static constexpr uint32_t s_sub_bits{3};
+static constexpr uint32_t s_nsubs{1u << s_sub_bits};
+static constexpr uint32_t s_nbuckets{(64 - s_sub_bits + 1) * s_nsubs};
+
+static uint32_t bucket_of(uint64_t v) {
+    if (v < 2 * s_nsubs) { return uint32_t(v); }
+    auto const e = uint32_t(std::bit_width(v) - 1);
+    auto const sub = uint32_t(v >> (e - s_sub_bits)) & (s_nsubs - 1);
+    return (e - s_sub_bits + 1) * s_nsubs + sub;
+}
+
+// Highest value of the bucket, so that the percentiles reported are never below the actual ones
+static uint64_t bucket_upper(uint32_t b) {
+    if (b < 2 * s_nsubs) { return b; }
+    auto const e = b / s_nsubs + s_sub_bits - 1;
+    auto const low = uint64_t(s_nsubs + (b % s_nsubs)) << (e - s_sub_bits);
+    return low + (uint64_t{1} << (e - s_sub_bits)) - 1;
+}
+
+struct op_counts {
+    std::array< uint64_t, s_nbuckets > buckets{};
+    uint64_t sum_us{0};
+};
+
+struct op_stats {
+    std::array< std::atomic< uint64_t >, s_nbuckets > buckets{};
+    std::atomic< uint64_t > sum_us{0};
+
+    op_counts load() const {
+        op_counts c;
+        for (uint32_t b{0}; b < s_nbuckets; ++b) {
+            c.buckets[b] = buckets[b].load(std::memory_order_relaxed);
+        }
+        c.sum_us = sum_us.load(std::memory_order_relaxed);
+        return c;
+    }
+};
+
+struct cache_counts {
+    uint64_t lookups{0};
+    uint64_t hits{0};
+};
+
+struct cache_stats {
+    std::atomic< uint64_t > lookups{0};
+    std::atomic< uint64_t > hits{0};
+};
+
+struct perf_state {
+    std::array< op_stats, s_num_ops > ops;
+    std::array< cache_stats, s_num_caches > caches;
+
+    // Baseline of the delta snapshots
+    std::mutex mtx;
+    std::array< op_counts, s_num_ops > last_ops;
+    std::array< cache_counts, s_num_caches > last_caches;
+    uint64_t start_ticks{TscClock::now()};
+    uint64_t last_ticks{start_ticks};
+};
+
+static perf_state& state() {
+    static perf_state s_state;
+    return s_state;
+}
+
+void PerfStats::observe(perf_op_t op, uint64_t latency_us) {
+    auto& s = state().ops[enum_value(op)];
+    s.buckets[bucket_of(latency_us)].fetch_add(1, std::memory_order_relaxed);
+    s.sum_us.fetch_add(latency_us, std::memory_order_relaxed);
+}
+
+void PerfStats::observe_since(perf_op_t op, uint64_t start_ticks) { observe(op, TscClock::elapsed_us(start_ticks)); }
+
+void PerfStats::cache_lookup(perf_cache_t cache, bool hit) {
+    auto& s = state().caches[enum_value(cache)];
+    s.lookups.fetch_add(1, std::memory_order_relaxed);
+    if (hit) { s.hits.fetch_add(1, std::memory_order_relaxed); }
+}
+
+static nlohmann::json op_json(op_counts const& c, double secs) {
+    uint64_t nops{0};
+    for (auto const n : c.buckets) {
+        nops += n;
+    }
+
+    nlohmann::json js;
+    js["ops"] = nops;
+    js["ops_per_sec"] = (secs > 0) ? (double(nops) / secs) : 0.0;
+    js["avg_us"] = (nops == 0) ? 0.0 : (double(c.sum_us) / nops);
+
+    static constexpr std::array< std::pair< const char*, double >, 3 > pcts{
+        {{"p50_us", 0.5}, {"p99_us", 0.99}, {"p999_us", 0.999}}};
+    uint64_t seen{0};
+    uint32_t b{0};
+    for (auto const& [name, pct] : pcts) {
+        if (nops == 0) {
+            js[name] = 0;
+            continue;
+        }
+        // Rank of the percentile among the ops, rounded up so that p999 of less than 1000 ops is the highest
+        auto const rank = std::max(uint64_t(double(nops) * pct + 0.999), uint64_t{1});
+        while ((seen + c.buckets[b]) < rank) {
+            seen += c.buckets[b++];
+        }
+        js[name] = bucket_upper(b);
+    }
+    return js;
+}
+
+nlohmann::json PerfStats::get_snapshot(bool delta) {
+    auto& st = state();
+
+    // Delta snapshots load the counts under the lock, so that each is taken after the baseline it is diffed with
+    std::unique_lock lg{st.mtx, std::defer_lock};
+    if (delta) { lg.lock(); }
+    auto const now = TscClock::now();
+    std::array< op_counts, s_num_ops > ops;
+    std::array< cache_counts, s_num_caches > caches;
+    for (size_t i{0}; i < s_num_ops; ++i) {
+        ops[i] = st.ops[i].load();
+    }
+    for (size_t i{0}; i < s_num_caches; ++i) {
+        caches[i].lookups = st.caches[i].lookups.load(std::memory_order_relaxed);
+        caches[i].hits = st.caches[i].hits.load(std::memory_order_relaxed);
+    }
+
+    uint64_t since_ticks{st.start_ticks};
+    if (delta) {
+        since_ticks = st.last_ticks;
+        for (size_t i{0}; i < s_num_ops; ++i) {
+            auto const cur = ops[i];
+            for (uint32_t b{0}; b < s_nbuckets; ++b) {
+                ops[i].buckets[b] -= st.last_ops[i].buckets[b];
+            }
+            ops[i].sum_us -= st.last_ops[i].sum_us;
+            st.last_ops[i] = cur;
+        }
+        for (size_t i{0}; i < s_num_caches; ++i) {
+            auto const cur = caches[i];
+            caches[i].lookups -= st.last_caches[i].lookups;
+            caches[i].hits -= st.last_caches[i].hits;
+            st.last_caches[i] = cur;
+        }
+        st.last_ticks = now;
+        lg.unlock();
+    }
+
+    nlohmann::json js;
+    auto const secs = double(TscClock::elapsed_us(since_ticks, now)) / 1000000;
+    js["delta"] = delta;
+    js["interval_secs"] = secs;
+    for (size_t i{0}; i < s_num_ops; ++i) {
+        js["ops"][enum_name(perf_op_t(i))] = op_json(ops[i], secs);
+    }
+    for (size_t i{0}; i < s_num_caches; ++i) {
+        auto& cjs = js["caches"][enum_name(perf_cache_t(i))];
+        cjs["lookups"] = caches[i].lookups;
+        cjs["hits"] = caches[i].hits;
+        cjs["hit_ratio"] = (caches[i].lookups == 0) ? 0.0 : (double(caches[i].hits) / caches[i].lookups);
+    }
+    return js;
+}
+} // namespace homestore
@@ -17,6 +17,7 @@
 #include <homestore/logstore_service.hpp>
 #include <homestore/replication_service.hpp>
 #include <iomgr/iomgr_flip.hpp>
+#include <boost/fiber/operations.hpp>
 #include "resource_mgr.hpp"
 #include "homestore_assert.hpp"
 #include "replication/repl_dev/raft_repl_dev.h"
@@ -102,6 +103,57 @@ void ResourceMgr::dec_dirty_buf_size(const uint32_t size) {
 
 void ResourceMgr::register_dirty_buf_exceed_cb(exceed_limit_cb_t cb) { m_dirty_buf_exceed_cb = std::move(cb); }
 
+int64_t ResourceMgr::cur_dirty_buf_size() const { return m_hs_dirty_buf_cnt.load(std::memory_order_relaxed); }
+
+uint32_t ResourceMgr::get_cp_pressure_pct() const {
+    return std::max(get_dirty_buf_pressure_pct(), get_journal_pressure_pct());
+}
+
+uint32_t ResourceMgr::get_dirty_buf_pressure_pct() const {
+    uint64_t pct{0};
+    if (auto const limit = get_dirty_buf_limit(); limit > 0) {
+        pct = uint64_cast(std::max(cur_dirty_buf_size(), int64_t{0})) * 100 / uint64_cast(limit);
+    }
+    return uint32_cast(std::min(pct, uint64_t{std::numeric_limits< uint32_t >::max()}));
+}
+
+uint32_t ResourceMgr::get_journal_pressure_pct() const {
+    auto const high = (get_journal_vdev_capacity() * get_journal_vdev_size_limit()) / 100;
+    if (high == 0) { return 0; }
+    auto const pct = (cur_journal_space_reserved() * 100) / high;
+    return uint32_cast(std::min(pct, uint64_t{std::numeric_limits< uint32_t >::max()}));
+}
+
+uint64_t ResourceMgr::predict_ms_to_cp_limit() {
+    auto const journal_high = (get_journal_vdev_capacity() * get_journal_vdev_size_limit()) / 100;
+    std::array< int64_t, num_cp_limits > const cur{cur_dirty_buf_size(), int64_cast(cur_journal_space_reserved()),
+                                                   cur_free_blk_cnt(), cur_free_blk_size()};
+    std::array< int64_t, num_cp_limits > const limit{get_dirty_buf_limit(), int64_cast(journal_high),
+                                                     get_free_blk_cnt_limit(), get_free_blk_size_limit()};
+
+    uint64_t ms_to_limit{std::numeric_limits< uint64_t >::max()};
+    std::unique_lock lg{m_growth_mtx};
+    auto const now = Clock::now();
+    if (m_growth_sample_time) {
+        auto const elapsed_us =
+            std::chrono::duration_cast< std::chrono::microseconds >(now - *m_growth_sample_time).count();
+        if (elapsed_us <= 0) { return ms_to_limit; }
+
+        for (size_t i{0}; i < num_cp_limits; ++i) {
+            // Drops on cp completion pull the rate down, so that a limit is not predicted right after a cp
+            auto const rate = double(cur[i] - m_growth_sample[i]) * 1000 / elapsed_us;
+            m_growth_rate[i] = (m_growth_rate[i] + rate) / 2;
+            if ((limit[i] <= 0) || (m_growth_rate[i] <= 0)) { continue; }
+            auto const left = double(std::max(limit[i] - cur[i], int64_t{0}));
+            ms_to_limit = std::min(ms_to_limit, uint64_cast(left / m_growth_rate[i]));
+        }
+    }
+    m_growth_sample_time = now;
+    m_growth_sample = cur;
+    GAUGE_UPDATE(m_metrics, ms_to_cp_limit, std::min(ms_to_limit, uint64_cast(std::numeric_limits< int64_t >::max())));
+    return ms_to_limit;
+}
+
 /* monitor free blk cnt */
 void ResourceMgr::inc_free_blk(int size) {
     // trigger hs cp when either one of the limit is reached
@@ -167,6 +219,25 @@ uint64_t ResourceMgr::get_cache_size() const {
     return ((HS_STATIC_CONFIG(input.io_mem_size()) * HS_DYNAMIC_CONFIG(resource_limits.cache_size_percent)) / 100);
 }
 
+/* monitor memory used by data blk read cache */
+void ResourceMgr::inc_data_read_cache_size(uint64_t size) {
+    m_data_read_cache_size.fetch_add(int64_cast(size), std::memory_order_relaxed);
+    COUNTER_INCREMENT(m_metrics, data_read_cache_size, size);
+}
+
+void ResourceMgr::dec_data_read_cache_size(uint64_t size) {
+    m_data_read_cache_size.fetch_sub(int64_cast(size), std::memory_order_relaxed);
+    COUNTER_DECREMENT(m_metrics, data_read_cache_size, size);
+}
+
+int64_t ResourceMgr::cur_data_read_cache_size() const {
+    return m_data_read_cache_size.load(std::memory_order_relaxed);
+}
+
+uint64_t ResourceMgr::get_data_read_cache_size_limit() const {
+    return ((HS_STATIC_CONFIG(input.app_mem_size) * HS_DYNAMIC_CONFIG(resource_limits.data_read_cache_percent)) / 100);
+}
+
 bool ResourceMgr::check_journal_descriptor_size(const uint64_t used_size) const {
     return (used_size >= get_journal_descriptor_size_limit());
 }
@@ -199,6 +270,109 @@ uint32_t ResourceMgr::get_journal_vdev_size_limit() const {
     return HS_DYNAMIC_CONFIG(resource_limits.journal_vdev_size_percent);
 }
 
+/* journal space credits */
+void ResourceMgr::set_journal_vdev_capacity(uint64_t capacity) {
+    m_journal_vdev_capacity.store(capacity, std::memory_order_relaxed);
+}
+
+uint64_t ResourceMgr::get_journal_vdev_capacity() const {
+    auto const capacity_mb = HS_DYNAMIC_CONFIG(resource_limits.journal_vdev_capacity_mb);
+    return (capacity_mb != 0) ? (capacity_mb * 1024 * 1024) : m_journal_vdev_capacity.load(std::memory_order_relaxed);
+}
+
+void ResourceMgr::reserve_journal_space(uint64_t size) {
+    m_journal_space_reserved.fetch_add(size, std::memory_order_relaxed);
+    COUNTER_INCREMENT(m_metrics, journal_space_reserved, size);
+}
+
+void ResourceMgr::release_journal_space(uint64_t size) {
+    m_journal_space_reserved.fetch_sub(size, std::memory_order_relaxed);
+    COUNTER_DECREMENT(m_metrics, journal_space_reserved, size);
+}
+
+uint64_t ResourceMgr::cur_journal_space_reserved() const {
+    return m_journal_space_reserved.load(std::memory_order_relaxed);
+}
+
+uint64_t ResourceMgr::get_journal_append_delay_us(uint64_t size, bool& critical) {
+    critical = false;
+    auto const capacity = get_journal_vdev_capacity();
+    auto const max_delay_us = uint64_cast(HS_DYNAMIC_CONFIG(resource_limits.journal_throttle_max_delay_us));
+    if ((capacity == 0) || (max_delay_us == 0)) {
+        GAUGE_UPDATE(m_metrics, journal_throttle_pct, 0);
+        return 0;
+    }
+
+    auto const high = (capacity * get_journal_vdev_size_limit()) / 100;
+    auto const crit = std::max((capacity * get_journal_vdev_size_critical_limit()) / 100, high + 1);
+    auto const used = cur_journal_space_reserved() + size;
+
+    uint64_t throttle_pct{0};
+    if (used >= crit) {
+        critical = true;
+        throttle_pct = 100;
+    } else if (used > high) {
+        throttle_pct = ((used - high) * 100) / (crit - high);
+    }
+    GAUGE_UPDATE(m_metrics, journal_throttle_pct, throttle_pct);
+    if (throttle_pct == 0) { return 0; }
+
+    COUNTER_INCREMENT(m_metrics, journal_throttled_appends, 1);
+    return std::max((max_delay_us * throttle_pct * throttle_pct) / (100 * 100), uint64_t{1});
+}
+
+/* admission control */
+uint32_t ResourceMgr::get_admission_pressure_pct(admission_class_t cls) const {
+    auto const dirty_pct = (cls != admission_class_t::REPL) ? get_dirty_buf_pressure_pct() : 0u;
+    auto const journal_pct = (cls != admission_class_t::INDEX) ? get_journal_pressure_pct() : 0u;
+    return std::max(dirty_pct, journal_pct);
+}
+
+bool ResourceMgr::can_admit(admission_class_t cls) {
+    auto const reject_pct = HS_DYNAMIC_CONFIG(resource_limits.admission_reject_percent);
+    if ((reject_pct == 0) || (get_admission_pressure_pct(cls) < reject_pct)) { return true; }
+    COUNTER_INCREMENT(m_metrics, admission_rejected_cnt, 1);
+    return false;
+}
+
+uint64_t ResourceMgr::get_admission_delay_us(uint64_t size, admission_class_t cls, uint64_t tenant) {
+    auto const max_delay_us = uint64_cast(HS_DYNAMIC_CONFIG(resource_limits.admission_max_delay_us));
+    if (max_delay_us == 0) { return 0; }
+    auto const start_pct = std::min(HS_DYNAMIC_CONFIG(resource_limits.admission_throttle_percent), 99u);
+    auto const pct = get_admission_pressure_pct(cls);
+    if (pct <= start_pct) { return 0; }
+    auto delay_us = double(max_delay_us) * (std::min(pct, 100u) - start_pct) / (100 - start_pct);
+
+    // Tenants are accounted only under pressure, in windows of a second, so that the shares reflect the recent writes
+    {
+        std::unique_lock lg{m_admission_mtx};
+        if (get_elapsed_time_ms(m_admission_window_start) >= 1000) {
+            m_admitted_size.clear();
+            m_admitted_total = 0;
+            m_admission_window_start = Clock::now();
+        }
+        auto& admitted = m_admitted_size[tenant];
+        admitted += size;
+        m_admitted_total += size;
+
+        // A tenant with twice its fair share is delayed twice as long, one with half of it is delayed half as long
+        if (m_admitted_total != 0) {
+            auto const share = double(admitted) * m_admitted_size.size() / m_admitted_total;
+            delay_us *= std::clamp(share, 0.5, 4.0);
+        }
+    }
+
+    auto const ret = std::max(uint64_cast(delay_us), uint64_t{1});
+    COUNTER_INCREMENT(m_metrics, admission_throttled_us, ret);
+    return ret;
+}
+
+void ResourceMgr::throttle_admission(uint64_t size, admission_class_t cls, uint64_t tenant) {
+    if (auto const delay_us = get_admission_delay_us(size, cls, tenant); delay_us != 0) {
+        boost::this_fiber::sleep_for(std::chrono::microseconds{delay_us});
+    }
+}
+
 /* monitor chunk size */
 void ResourceMgr::check_chunk_free_size_and_trigger_cp(uint64_t free_size, uint64_t alloc_size) {}
 
@@ -216,8 +390,108 @@ void ResourceMgr::reset_dirty_buf_qd() {
     m_flush_dirty_buf_q_depth = HS_DYNAMIC_CONFIG(generic.cache_max_throttle_cnt);
 }
 
-int64_t ResourceMgr::get_dirty_buf_limit() const {
-    return int64_cast((HS_DYNAMIC_CONFIG(resource_limits.dirty_buf_percent) * HS_STATIC_CONFIG(input.io_mem_size())) /
-                      100);
+int64_t ResourceMgr::get_dirty_buf_limit() const { return int64_cast(get_mem_budget(mem_budget_t::INDEX_BUFS)); }
+
+/* memory budgets */
+void ResourceMgr::inc_mem_used(mem_budget_t budget, uint64_t size) {
+    switch (budget) {
+    case mem_budget_t::REPL_REQS:
+        m_repl_reqs_mem_used.fetch_add(int64_cast(size), std::memory_order_relaxed);
+        COUNTER_INCREMENT(m_metrics, mem_used_repl_reqs, size);
+        break;
+    case mem_budget_t::LOG_GROUPS:
+        m_log_groups_mem_used.fetch_add(int64_cast(size), std::memory_order_relaxed);
+        COUNTER_INCREMENT(m_metrics, mem_used_log_groups, size);
+        break;
+    default:
+        HS_DBG_ASSERT(false, "Memory of budget={} is accounted through its own methods", enum_name(budget));
+        break;
+    }
+}
+
+void ResourceMgr::dec_mem_used(mem_budget_t budget, uint64_t size) {
+    switch (budget) {
+    case mem_budget_t::REPL_REQS:
+        m_repl_reqs_mem_used.fetch_sub(int64_cast(size), std::memory_order_relaxed);
+        COUNTER_DECREMENT(m_metrics, mem_used_repl_reqs, size);
+        break;
+    case mem_budget_t::LOG_GROUPS:
+        m_log_groups_mem_used.fetch_sub(int64_cast(size), std::memory_order_relaxed);
+        COUNTER_DECREMENT(m_metrics, mem_used_log_groups, size);
+        break;
+    default:
+        HS_DBG_ASSERT(false, "Memory of budget={} is accounted through its own methods", enum_name(budget));
+        break;
+    }
+}
+
+bool ResourceMgr::can_use_mem(mem_budget_t budget, uint64_t size) {
+    auto const hard = (get_mem_budget(budget) * HS_DYNAMIC_CONFIG(resource_limits.mem_budget_hard_percent)) / 100;
+    if (uint64_cast(std::max(cur_mem_used(budget), int64_t{0})) + size <= hard) { return true; }
+    COUNTER_INCREMENT(m_metrics, mem_budget_refused_cnt, 1);
+    return false;
+}
+
+int64_t ResourceMgr::cur_mem_used(mem_budget_t budget) const {
+    switch (budget) {
+    case mem_budget_t::INDEX_BUFS:
+        return cur_dirty_buf_size();
+    case mem_budget_t::DATA_READ_CACHE:
+        return cur_data_read_cache_size();
+    case mem_budget_t::REPL_REQS:
+        return m_repl_reqs_mem_used.load(std::memory_order_relaxed);
+    case mem_budget_t::LOG_GROUPS:
+        return m_log_groups_mem_used.load(std::memory_order_relaxed);
+    default:
+        return 0;
+    }
+}
+
+uint64_t ResourceMgr::get_own_mem_budget(mem_budget_t budget) const {
+    auto const app_mem_size = uint64_cast(HS_STATIC_CONFIG(input.app_mem_size));
+    switch (budget) {
+    case mem_budget_t::INDEX_BUFS:
+        return (HS_DYNAMIC_CONFIG(resource_limits.dirty_buf_percent) * HS_STATIC_CONFIG(input.io_mem_size())) / 100;
+    case mem_budget_t::DATA_READ_CACHE:
+        return get_data_read_cache_size_limit();
+    case mem_budget_t::REPL_REQS:
+        return (HS_DYNAMIC_CONFIG(resource_limits.mem_budget_repl_reqs_percent) * app_mem_size) / 100;
+    case mem_budget_t::LOG_GROUPS:
+        return (HS_DYNAMIC_CONFIG(resource_limits.mem_budget_log_groups_percent) * app_mem_size) / 100;
+    default:
+        return 0;
+    }
+}
+
+uint64_t ResourceMgr::get_lendable_mem() const {
+    auto const lend_pct = HS_DYNAMIC_CONFIG(resource_limits.mem_budget_lend_percent);
+    if (lend_pct == 0) { return 0; }
+
+    uint64_t unused{0};
+    for (auto const b : {mem_budget_t::DATA_READ_CACHE, mem_budget_t::REPL_REQS, mem_budget_t::LOG_GROUPS}) {
+        auto const used = uint64_cast(std::max(cur_mem_used(b), int64_t{0}));
+        auto const own = get_own_mem_budget(b);
+        if (own > used) { unused += own - used; }
+    }
+    return (unused * lend_pct) / 100;
+}
+
+uint64_t ResourceMgr::get_mem_budget(mem_budget_t budget) const {
+    // Lent budget follows the usage of the lenders, so it is taken back as soon as they need it
+    auto const own = get_own_mem_budget(budget);
+    return (budget == mem_budget_t::INDEX_BUFS) ? (own + get_lendable_mem()) : own;
+}
+
+nlohmann::json ResourceMgr::get_mem_status() const {
+    nlohmann::json js;
+    for (auto const b : {mem_budget_t::INDEX_BUFS, mem_budget_t::DATA_READ_CACHE, mem_budget_t::REPL_REQS,
+                         mem_budget_t::LOG_GROUPS}) {
+        auto& bjs = js[enum_name(b)];
+        bjs["used"] = cur_mem_used(b);
+        bjs["budget"] = get_mem_budget(b);
+        bjs["own_budget"] = get_own_mem_budget(b);
+    }
+    js["lent_to_wb_cache"] = get_lendable_mem();
+    return js;
 }
 } // namespace homestore
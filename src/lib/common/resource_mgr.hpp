@@ -14,8 +14,14 @@
  *
  *********************************************************************************/
 #pragma once
+#include <array>
 #include <atomic>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 #include <sisl/metrics/metrics.hpp>
+#include <sisl/utility/enum.hpp>
+#include <nlohmann/json.hpp>
 #include "homestore_config.hpp"
 
 namespace homestore {
@@ -29,6 +35,20 @@ public:
                          sisl::_publish_as::publish_as_gauge);
         REGISTER_COUNTER(alloc_blk_cnt_in_cp, "Total alloc blks cnt accumulated in a cp",
                          sisl::_publish_as::publish_as_gauge);
+        REGISTER_COUNTER(data_read_cache_size, "Total memory used by data blk read cache",
+                         sisl::_publish_as::publish_as_gauge);
+        REGISTER_COUNTER(journal_space_reserved, "Total journal space reserved by appenders",
+                         sisl::_publish_as::publish_as_gauge);
+        REGISTER_COUNTER(journal_throttled_appends, "Total delays journal appends were throttled with");
+        REGISTER_GAUGE(journal_throttle_pct, "Journal append throttle, in percent of its max delay");
+        REGISTER_GAUGE(ms_to_cp_limit, "Predicted time till a resource limit forcing a cp is hit (in ms)");
+        REGISTER_COUNTER(admission_throttled_us, "Total delays writers were throttled with at submit");
+        REGISTER_COUNTER(admission_rejected_cnt, "Total writes rejected at submit");
+        REGISTER_COUNTER(mem_used_repl_reqs, "Total memory used by repl reqs", "mem_used", {"budget", "repl_reqs"},
+                         sisl::_publish_as::publish_as_gauge);
+        REGISTER_COUNTER(mem_used_log_groups, "Total memory used by log groups", "mem_used", {"budget", "log_groups"},
+                         sisl::_publish_as::publish_as_gauge);
+        REGISTER_COUNTER(mem_budget_refused_cnt, "Total memory usages refused for exceeding the hard budget");
         register_me_to_farm();
     }
 
@@ -40,6 +60,22 @@ public:
 };
 
 typedef std::function< void(int64_t /* dirty_buf_cnt */, bool /* critical */) > exceed_limit_cb_t;
+
+// Subsystems whose memory usage is accounted against their budget
+ENUM(mem_budget_t, uint8_t,
+     INDEX_BUFS,      // Dirty buffers of the wb cache, which can borrow the unused budget of the others
+     DATA_READ_CACHE, // Data blk read cache
+     REPL_REQS,       // Data held by the repl reqs till it is written
+     LOG_GROUPS       // Log group buffers of the logdevs
+);
+
+// Class of the writer consulting the admission control, which decides the resource its pressure is taken from
+ENUM(admission_class_t, uint8_t,
+     DATA,  // Data blk writes, which build up both the index and the journal
+     INDEX, // Index updates, which build up the dirty buffers
+     REPL   // Replicated writes, which build up the journal
+);
+
 const uint32_t max_qd_multiplier = 32;
 
 class ResourceMgr {
@@ -51,6 +87,27 @@ public:
     void inc_dirty_buf_size(const uint32_t size);
     void dec_dirty_buf_size(const uint32_t size);
     void register_dirty_buf_exceed_cb(exceed_limit_cb_t cb);
+    int64_t cur_dirty_buf_size() const;
+
+    /**
+     * @brief Gets how close the state to be flushed by a CP is to forcing one, as the larger of the dirty buffers in
+     * percent of their limit and the journal space reserved in percent of its high watermark.
+     *
+     * @return The CP pressure in percent, which can be above 100 once a limit is crossed.
+     */
+    uint32_t get_cp_pressure_pct() const;
+
+    /* journal space reserved in percent of its high watermark, 0 if its capacity is not known */
+    uint32_t get_journal_pressure_pct() const;
+
+    /**
+     * @brief Predicts the time till the first of the dirty buffers, journal space and free blks hits its limit, from
+     * their growth rates. Every call takes a sample, rates are smoothed across the samples, so it is expected to be
+     * called at a regular interval.
+     *
+     * @return The time in ms, max value if none of them is growing.
+     */
+    uint64_t predict_ms_to_cp_limit();
 
     /* monitor free blk cnt */
     void inc_free_blk(int size);
@@ -76,6 +133,12 @@ public:
     /* get cache size */
     uint64_t get_cache_size() const;
 
+    /* monitor memory used by data blk read cache */
+    void inc_data_read_cache_size(uint64_t size);
+    void dec_data_read_cache_size(uint64_t size);
+    int64_t cur_data_read_cache_size() const;
+    uint64_t get_data_read_cache_size_limit() const;
+
     /**
      * @brief Checks if the journal virtual device (vdev) size is within the specified limits.
      *
@@ -113,6 +176,63 @@ public:
     uint32_t get_journal_vdev_size_critical_limit() const;
     uint32_t get_journal_descriptor_size_limit() const;
 
+    /* journal space credits, reserved by appenders and returned by truncation */
+    void set_journal_vdev_capacity(uint64_t capacity);
+    uint64_t get_journal_vdev_capacity() const;
+    void reserve_journal_space(uint64_t size);
+    void release_journal_space(uint64_t size);
+    uint64_t cur_journal_space_reserved() const;
+
+    /**
+     * @brief Gets the delay an append of the given size to the journal is to be throttled with.
+     *
+     * The delay is 0 up to the high watermark and grows quadratically with the space reserved up to the max delay
+     * at the critical watermark, so appenders slow down progressively instead of running into a full journal.
+     *
+     * @param size The size the appender is about to reserve.
+     * @param critical Set if the reservation would reach the critical watermark.
+     * @return The delay in microseconds.
+     */
+    uint64_t get_journal_append_delay_us(uint64_t size, bool& critical);
+
+    /**
+     * @brief Memory budget manager. Subsystems account the memory they use against their budget, which is soft, and
+     * are refused any usage beyond the hard budget. The wb cache borrows a share of the budget the others leave unused.
+     * Dirty buffers and the data read cache are accounted through their own methods above.
+     */
+    void inc_mem_used(mem_budget_t budget, uint64_t size);
+    void dec_mem_used(mem_budget_t budget, uint64_t size);
+    bool can_use_mem(mem_budget_t budget, uint64_t size);
+    int64_t cur_mem_used(mem_budget_t budget) const;
+
+    /* budget of the subsystem, including what it borrows from the others */
+    uint64_t get_mem_budget(mem_budget_t budget) const;
+    nlohmann::json get_mem_status() const;
+
+    /**
+     * @brief Admission control, consulted by the writers at submit. Checks if a write can be admitted at all, which it
+     * can't once the pressure of its class reaches admission_reject_percent.
+     *
+     * @param cls The class of the writer.
+     * @return false if the caller is expected to fail the write with a retriable error.
+     */
+    bool can_admit(admission_class_t cls);
+
+    /**
+     * @brief Gets the delay an admitted write is to be submitted after. The delay grows with the pressure of its class,
+     * and is scaled by the share of the writes the tenant has been admitted under pressure, relative to its fair share,
+     * so that no tenant starves others by writing at full rate.
+     *
+     * @param size The size of the write, in bytes for data and repl writes and in entries for index updates.
+     * @param cls The class of the writer.
+     * @param tenant The tenant of the writer, like the repl dev or the index table.
+     * @return The delay in microseconds.
+     */
+    uint64_t get_admission_delay_us(uint64_t size, admission_class_t cls, uint64_t tenant = 0);
+
+    /* blocks the calling fiber for the admission delay of the write, see get_admission_delay_us() */
+    void throttle_admission(uint64_t size, admission_class_t cls, uint64_t tenant = 0);
+
     /* monitor chunk size */
     void check_chunk_free_size_and_trigger_cp(uint64_t free_size, uint64_t alloc_size);
 
@@ -130,6 +250,10 @@ public:
 
 private:
     int64_t get_dirty_buf_limit() const;
+    uint32_t get_dirty_buf_pressure_pct() const;
+    uint64_t get_own_mem_budget(mem_budget_t budget) const;
+    uint64_t get_lendable_mem() const;
+    uint32_t get_admission_pressure_pct(admission_class_t cls) const;
 
     /**
      * Starts resource manager resource audit timer.
@@ -142,9 +266,27 @@ private:
     std::atomic< int64_t > m_hs_fb_size; // free size
     std::atomic< int64_t > m_hs_ab_cnt;  // alloc count
     std::atomic< int64_t > m_memory_used_in_recovery;
+    std::atomic< int64_t > m_data_read_cache_size{0};
     std::atomic< uint32_t > m_flush_dirty_buf_q_depth{64};
+    std::atomic< uint64_t > m_journal_vdev_capacity{0};
+    std::atomic< uint64_t > m_journal_space_reserved{0};
+    std::atomic< int64_t > m_repl_reqs_mem_used{0};
+    std::atomic< int64_t > m_log_groups_mem_used{0};
     uint64_t m_total_cap;
 
+    // Last sample and smoothed growth rate (per ms) of dirty buf size, journal space, free blk cnt and free blk size
+    static constexpr size_t num_cp_limits{4};
+    std::mutex m_growth_mtx;
+    std::optional< Clock::time_point > m_growth_sample_time;
+    std::array< int64_t, num_cp_limits > m_growth_sample{};
+    std::array< double, num_cp_limits > m_growth_rate{};
+
+    // Size admitted to each tenant under pressure, in the current fairness window
+    std::mutex m_admission_mtx;
+    std::unordered_map< uint64_t, uint64_t > m_admitted_size;
+    uint64_t m_admitted_total{0};
+    Clock::time_point m_admission_window_start{Clock::now()};
+
     // TODO: make it event_cb
     exceed_limit_cb_t m_dirty_buf_exceed_cb;
     exceed_limit_cb_t m_free_blks_exceed_cb;
@@ -0,0 +1,98 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include <sisl/logging/logging.h>
+#include "common/homestore_config.hpp"
+#include "common/thread_placement.hpp"
+
+namespace homestore {
+static std::string read_cpu_list(std::string const& path) {
+    std::ifstream f{path};
+    std::string list;
+    if (f) { std::getline(f, list); }
+    return list;
+}
+
+std::vector< uint32_t > ThreadPlacement::parse_cpu_list(std::string const& list) {
+    std::vector< uint32_t > cpus;
+    std::stringstream ss{list};
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) { continue; }
+        try {
+            auto const dash = item.find('-');
+            auto const first = std::stoul(item.substr(0, dash));
+            auto const last = (dash == std::string::npos) ? first : std::stoul(item.substr(dash + 1));
+            for (auto c = first; c <= last; ++c) {
+                cpus.push_back(uint32_cast(c));
+            }
+        } catch (std::exception const&) { LOGWARN("Ignoring the invalid item={} of the cpu list={}", item, list); }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::vector< uint32_t > ThreadPlacement::cpus_of(hs_thread_role_t role) {
+    auto const& tp = HS_STATIC_CONFIG(input.thread_placement);
+    std::string const* role_cpus{nullptr};
+    switch (role) {
+    case hs_thread_role_t::LOG_FLUSH:
+        role_cpus = &tp.log_flush_cpus;
+        break;
+    case hs_thread_role_t::CP:
+        role_cpus = &tp.cp_cpus;
+        break;
+    default:
+        role_cpus = &tp.background_cpus;
+        break;
+    }
+    if (!role_cpus->empty()) { return parse_cpu_list(*role_cpus); }
+    if ((tp.numa_node < 0) && tp.io_cpus.empty()) { return {}; }
+
+    auto const base = parse_cpu_list(read_cpu_list(
+        (tp.numa_node < 0) ? std::string{"/sys/devices/system/cpu/online"}
+                           : fmt::format("/sys/devices/system/node/node{}/cpulist", tp.numa_node)));
+    auto const io_cpus = parse_cpu_list(tp.io_cpus);
+    std::vector< uint32_t > cpus;
+    std::set_difference(base.cbegin(), base.cend(), io_cpus.cbegin(), io_cpus.cend(), std::back_inserter(cpus));
+
+    // Io cpus taking all of the node, the threads are still kept on the node
+    return cpus.empty() ? base : cpus;
+}
+
+void ThreadPlacement::bind_self(hs_thread_role_t role) {
+    auto const cpus = cpus_of(role);
+    if (cpus.empty()) { return; }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto const c : cpus) {
+        if (c < CPU_SETSIZE) { CPU_SET(c, &set); }
+    }
+    if (auto const ret = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set); ret != 0) {
+        LOGWARN("Could not bind the {} thread to the cpus={}, error={}", enum_name(role), fmt::join(cpus, ","), ret);
+        return;
+    }
+    LOGINFO("Bound the {} thread to the cpus={}", enum_name(role), fmt::join(cpus, ","));
+}
+} // namespace homestore
@@ -0,0 +1,39 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sisl/utility/enum.hpp>
+
+namespace homestore {
+ENUM(hs_thread_role_t, uint8_t, LOG_FLUSH, CP, BACKGROUND);
+
+// Binds the threads HomeStore creates for its own work to the cpus of their role, as given by the thread placement of
+// the input params, so that they don't preempt the reactors serving the ios.
+class ThreadPlacement {
+public:
+    /// @brief Binds the calling thread to the cpus of the role. Thread is left as is, if the role has no cpus.
+    static void bind_self(hs_thread_role_t role);
+
+    /// @brief Cpus of the role: the cpus given for the role, or else the cpus of the numa node less the io cpus if
+    /// either of them is given. Empty if the threads of the role are not bound.
+    static std::vector< uint32_t > cpus_of(hs_thread_role_t role);
+
+    /// @brief Cpus of a cpu list like "0-3,8", the format of the cpu lists of sysfs
+    static std::vector< uint32_t > parse_cpu_list(std::string const& list);
+};
+} // namespace homestore
@@ -0,0 +1,73 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace homestore {
+
+/*
+ * Clock of the cpu timestamp counter, which is read in a few cycles without a syscall or a fence, for timing the
+ * stages of the hot paths. It assumes an invariant tsc, which is the case with any server cpu of the last decade, and
+ * calibrates its rate against the steady clock once on the first use. Falls back to the steady clock elsewhere.
+ */
+class TscClock {
+public:
+    static uint64_t now() {
+#if defined(__x86_64__)
+        return __rdtsc();
+#else
+        return uint64_t(
+            std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now().time_since_epoch())
+                .count());
+#endif
+    }
+
+    static uint64_t to_us(uint64_t ticks) { return uint64_t(double(ticks) / ticks_per_us()); }
+
+    static uint64_t elapsed_us(uint64_t start) { return elapsed_us(start, now()); }
+    static uint64_t elapsed_us(uint64_t start, uint64_t end) { return (end > start) ? to_us(end - start) : 0; }
+
+private:
+    static double ticks_per_us() {
+        static double const rate = calibrate();
+        return rate;
+    }
+
+    static double calibrate() {
+#if defined(__x86_64__)
+        auto const start_time = std::chrono::steady_clock::now();
+        auto const start = now();
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        auto const end = now();
+        auto const us = std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now() -
+                                                                               start_time)
+                            .count() /
+            1000.0;
+        return double(end - start) / us;
+#else
+        return 1000.0;
+#endif
+    }
+};
+
+} // namespace homestore
@@ -41,3 +41,182 @@ uint32_t crc32_ieee(uint32_t seed, const unsigned char* buf, uint64_t len) {
 }
 }
 #endif
+
+#include <cstring>
+#include <homestore/crc.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace homestore {
+namespace {
+constexpr uint32_t crc32c_poly{0x82F63B78}; // Castagnoli polynomial, bit reflected
+
+struct crc32c_table {
+    uint32_t t[256];
+    constexpr crc32c_table() : t{} {
+        for (uint32_t i{0}; i < 256; ++i) {
+            uint32_t c{i};
+            for (int j{0}; j < 8; ++j) {
+                c = (c & 1) ? ((c >> 1) ^ crc32c_poly) : (c >> 1);
+            }
+            t[i] = c;
+        }
+    }
+};
+constexpr crc32c_table s_crc32c_table;
+
+uint32_t crc32c_sw(uint32_t crc, const uint8_t* p, uint64_t len) {
+    while (len--) {
+        crc = s_crc32c_table.t[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+uint64_t load64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+#if defined(__x86_64__)
+bool has_hw_crc32c() {
+    static bool const has = __builtin_cpu_supports("sse4.2");
+    return has;
+}
+
+__attribute__((target("sse4.2"))) uint32_t crc32c_hw(uint32_t crc, const uint8_t* p, uint64_t len) {
+    uint64_t c{crc};
+    for (; len >= 8; p += 8, len -= 8) {
+        c = _mm_crc32_u64(c, load64(p));
+    }
+    crc = uint32_t(c);
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+
+// Crc instruction takes 3 cycles but a new one can be issued every cycle, so 3 independent streams keep it busy
+__attribute__((target("sse4.2"))) void crc32c_hw_x3(uint32_t* crcs, const uint8_t* a, const uint8_t* b,
+                                                      const uint8_t* c, uint64_t len) {
+    uint64_t ca{crcs[0]}, cb{crcs[1]}, cc{crcs[2]};
+    uint64_t off{0};
+    for (; off + 8 <= len; off += 8) {
+        ca = _mm_crc32_u64(ca, load64(a + off));
+        cb = _mm_crc32_u64(cb, load64(b + off));
+        cc = _mm_crc32_u64(cc, load64(c + off));
+    }
+    crcs[0] = crc32c_hw(uint32_t(ca), a + off, len - off);
+    crcs[1] = crc32c_hw(uint32_t(cb), b + off, len - off);
+    crcs[2] = crc32c_hw(uint32_t(cc), c + off, len - off);
+}
+#elif defined(__aarch64__)
+bool has_hw_crc32c() {
+    static bool const has = (::getauxval(AT_HWCAP) & HWCAP_CRC32);
+    return has;
+}
+
+__attribute__((target("+crc"))) uint32_t crc32c_hw(uint32_t crc, const uint8_t* p, uint64_t len) {
+    for (; len >= 8; p += 8, len -= 8) {
+        crc = __crc32cd(crc, load64(p));
+    }
+    while (len--) {
+        crc = __crc32cb(crc, *p++);
+    }
+    return crc;
+}
+
+__attribute__((target("+crc"))) void crc32c_hw_x3(uint32_t* crcs, const uint8_t* a, const uint8_t* b,
+                                                    const uint8_t* c, uint64_t len) {
+    uint32_t ca{crcs[0]}, cb{crcs[1]}, cc{crcs[2]};
+    uint64_t off{0};
+    for (; off + 8 <= len; off += 8) {
+        ca = __crc32cd(ca, load64(a + off));
+        cb = __crc32cd(cb, load64(b + off));
+        cc = __crc32cd(cc, load64(c + off));
+    }
+    crcs[0] = crc32c_hw(ca, a + off, len - off);
+    crcs[1] = crc32c_hw(cb, b + off, len - off);
+    crcs[2] = crc32c_hw(cc, c + off, len - off);
+}
+#else
+bool has_hw_crc32c() { return false; }
+uint32_t crc32c_hw(uint32_t crc, const uint8_t* p, uint64_t len) { return crc32c_sw(crc, p, len); }
+void crc32c_hw_x3(uint32_t* crcs, const uint8_t* a, const uint8_t* b, const uint8_t* c, uint64_t len) {
+    crcs[0] = crc32c_sw(crcs[0], a, len);
+    crcs[1] = crc32c_sw(crcs[1], b, len);
+    crcs[2] = crc32c_sw(crcs[2], c, len);
+}
+#endif
+
+// Long buffers are crc'ed a block of 3 lanes at a time, the lanes side by side, after which the crc of each lane is
+// carried over the lanes after it. Crc without the pre and post inversion is linear, so the crc of a lane followed by
+// n bytes is the crc of the lane multiplied by x^(8n) mod P, xor the crc of those n bytes from 0.
+constexpr uint64_t s_lane_len{4096};
+
+// Multiplication of a crc by x^(8 * s_lane_len) mod P, by the product of each byte of the crc looked up
+struct crc32c_lane_shift {
+    uint32_t t[4][256];
+
+    crc32c_lane_shift() {
+        uint32_t bit_shift[32];
+        for (uint32_t i{0}; i < 32; ++i) {
+            uint32_t c{1u << i};
+            for (uint64_t n{0}; n < s_lane_len; ++n) {
+                c = s_crc32c_table.t[c & 0xff] ^ (c >> 8);
+            }
+            bit_shift[i] = c;
+        }
+        for (uint32_t k{0}; k < 4; ++k) {
+            for (uint32_t v{0}; v < 256; ++v) {
+                uint32_t c{0};
+                for (uint32_t j{0}; j < 8; ++j) {
+                    if (v & (1u << j)) { c ^= bit_shift[k * 8 + j]; }
+                }
+                t[k][v] = c;
+            }
+        }
+    }
+
+    uint32_t operator()(uint32_t crc) const {
+        return t[0][crc & 0xff] ^ t[1][(crc >> 8) & 0xff] ^ t[2][(crc >> 16) & 0xff] ^ t[3][crc >> 24];
+    }
+};
+
+uint32_t crc32c_hw_long(uint32_t crc, const uint8_t* p, uint64_t len) {
+    static crc32c_lane_shift const s_shift;
+    for (; len >= 3 * s_lane_len; p += 3 * s_lane_len, len -= 3 * s_lane_len) {
+        uint32_t crcs[3]{crc, 0, 0};
+        crc32c_hw_x3(crcs, p, p + s_lane_len, p + 2 * s_lane_len, s_lane_len);
+        crc = s_shift(s_shift(crcs[0]) ^ crcs[1]) ^ crcs[2];
+    }
+    return crc32c_hw(crc, p, len);
+}
+} // namespace
+
+uint32_t crc32c(uint32_t seed, const uint8_t* buf, uint64_t len) {
+    return ~(has_hw_crc32c() ? crc32c_hw_long(~seed, buf, len) : crc32c_sw(~seed, buf, len));
+}
+
+void crc32c_multi(uint32_t seed, const uint8_t* const* bufs, uint32_t nbufs, uint64_t len, uint32_t* out_crcs) {
+    uint32_t i{0};
+    if (has_hw_crc32c()) {
+        for (; i + 3 <= nbufs; i += 3) {
+            out_crcs[i] = out_crcs[i + 1] = out_crcs[i + 2] = ~seed;
+            crc32c_hw_x3(&out_crcs[i], bufs[i], bufs[i + 1], bufs[i + 2], len);
+            out_crcs[i] = ~out_crcs[i];
+            out_crcs[i + 1] = ~out_crcs[i + 1];
+            out_crcs[i + 2] = ~out_crcs[i + 2];
+        }
+    }
+    for (; i < nbufs; ++i) {
+        out_crcs[i] = crc32c(seed, bufs[i], len);
+    }
+}
+} // namespace homestore
@@ -0,0 +1,167 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iterator>
+
+#include <sisl/logging/logging.h>
+
+#include "device/blk_discarder.hpp"
+#include "device/chunk.h"
+#include "device/device.h"
+#include "device/physical_dev.hpp"
+#include "device/virtual_dev.hpp"
+#include "blkalloc/blk_allocator.h"
+#include "common/homestore_assert.hpp"
+#include "common/homestore_config.hpp"
+
+namespace homestore {
+// Values of linux/ioprio.h, which is not shipped by older kernel headers
+static constexpr int IOPRIO_CLASS_SHIFT{13};
+static constexpr int IOPRIO_CLASS_IDLE{3};
+static constexpr int IOPRIO_WHO_PROCESS{1};
+
+BlkDiscarder::BlkDiscarder(DeviceManager& dmgr, const std::string& name, uint32_t blk_size,
+                           VirtualDevMetrics& metrics) :
+        m_dmgr{dmgr}, m_name{name}, m_blk_size{blk_size}, m_metrics{metrics} {
+    m_thread = std::thread([this]() { run(); });
+    LOGINFO("Discard of freed blks is enabled on vdev={}", m_name);
+}
+
+BlkDiscarder::~BlkDiscarder() {
+    {
+        std::unique_lock lg{m_mtx};
+        m_stopping = true;
+    }
+    m_cv.notify_all();
+    // Frees of the queued ranges are not persisted by any CP anymore, so they are just dropped
+    if (m_thread.joinable()) { m_thread.join(); }
+}
+
+void BlkDiscarder::submit(std::vector< BlkId >&& bids) {
+    std::sort(bids.begin(), bids.end(), [](const BlkId& a, const BlkId& b) {
+        return (a.chunk_num() != b.chunk_num()) ? (a.chunk_num() < b.chunk_num()) : (a.blk_num() < b.blk_num());
+    });
+
+    auto const min_blks = uint64_cast(HS_DYNAMIC_CONFIG(device->discard_min_size_kb)) * 1024 / m_blk_size;
+    auto const max_blks = uint64_cast(HS_DYNAMIC_CONFIG(device->discard_max_size_mb)) * 1024 * 1024 / m_blk_size;
+
+    std::vector< discard_range > ranges;
+    for (auto& b : bids) {
+        if (!ranges.empty()) {
+            auto& r = ranges.back();
+            if ((r.chunk_num == b.chunk_num()) && (r.start_blk + r.nblks == b.blk_num()) &&
+                (r.nblks + b.blk_count() <= max_blks)) {
+                r.nblks += b.blk_count();
+                r.bids.push_back(b);
+                continue;
+            }
+        }
+        ranges.push_back(discard_range{b.chunk_num(), b.blk_num(), b.blk_count(), {b}});
+    }
+
+    // Ranges on a drive which can't discard are not queued either
+    std::vector< discard_range > to_discard;
+    for (auto& r : ranges) {
+        auto chunk = m_dmgr.get_chunk_mutable(r.chunk_num);
+        HS_REL_ASSERT(chunk, "chunk={} is missing for freed blks of vdev={}", r.chunk_num, m_name);
+        if ((r.nblks < std::max(min_blks, uint64_cast(1))) || !chunk->physical_dev()->is_discard()) {
+            free_range(r);
+        } else {
+            to_discard.push_back(std::move(r));
+        }
+    }
+    if (to_discard.empty()) { return; }
+
+    {
+        std::unique_lock lg{m_mtx};
+        std::move(to_discard.begin(), to_discard.end(), std::back_inserter(m_pending));
+    }
+    m_cv.notify_all();
+}
+
+void BlkDiscarder::drain() {
+    std::deque< discard_range > ranges;
+    {
+        std::unique_lock lg{m_mtx};
+        m_cv.wait(lg, [this]() { return !m_in_flight; });
+        ranges.swap(m_pending);
+    }
+
+    for (auto const& r : ranges) {
+        free_range(r);
+    }
+    if (!ranges.empty()) {
+        COUNTER_INCREMENT(m_metrics, vdev_discard_skipped_count, ranges.size());
+        HS_LOG(DEBUG, device, "vdev={} freed {} ranges without discarding them, as discards are behind the CPs",
+               m_name, ranges.size());
+    }
+}
+
+void BlkDiscarder::free_range(const discard_range& r) {
+    auto chunk = m_dmgr.get_chunk_mutable(r.chunk_num);
+    HS_REL_ASSERT(chunk, "chunk={} is missing for freed blks of vdev={}", r.chunk_num, m_name);
+    for (auto const& b : r.bids) {
+        chunk->blk_allocator_mutable()->free(b);
+    }
+}
+
+void BlkDiscarder::run() {
+    // Discards are synchronous on this thread, so that they are issued at idle priority and don't compete with the ios
+    if (::syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) != 0) {
+        LOGWARN("Could not set idle io priority of discards of vdev={}, errno={}", m_name, errno);
+    }
+
+    std::unique_lock lg{m_mtx};
+    while (!m_stopping) {
+        if (m_pending.empty()) {
+            m_cv.wait(lg);
+            continue;
+        }
+        if (std::chrono::steady_clock::now() < m_next_issue) {
+            m_cv.wait_until(lg, m_next_issue);
+            continue;
+        }
+
+        auto r = std::move(m_pending.front());
+        m_pending.pop_front();
+        m_in_flight = true;
+        lg.unlock();
+
+        auto chunk = m_dmgr.get_chunk_mutable(r.chunk_num);
+        HS_REL_ASSERT(chunk, "chunk={} is missing for freed blks of vdev={}", r.chunk_num, m_name);
+        auto const size = r.nblks * m_blk_size;
+        auto const offset = chunk->start_offset() + uint64_cast(r.start_blk) * m_blk_size;
+        auto const ec = chunk->physical_dev_mutable()->sync_discard(size, offset);
+        if (ec) {
+            HS_LOG(DEBUG, device, "Discard of chunk={} blk={} nblks={} of vdev={} failed, error={}",
+                   r.chunk_num, r.start_blk, r.nblks, m_name, ec.message());
+        } else {
+            COUNTER_INCREMENT(m_metrics, vdev_discard_count, 1);
+        }
+        free_range(r);
+
+        // Limit the rate by spacing out the next discard by the time this one takes at the max rate
+        auto const rate_mb = HS_DYNAMIC_CONFIG(device->discard_max_mb_per_sec);
+        lg.lock();
+        m_in_flight = false;
+        m_next_issue = (rate_mb == 0) ? std::chrono::steady_clock::time_point{}
+                                      : std::chrono::steady_clock::now() +
+                std::chrono::microseconds{size * 1000000 / (uint64_cast(rate_mb) * 1024 * 1024)};
+        m_cv.notify_all();
+    }
+}
+} // namespace homestore
@@ -0,0 +1,82 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <homestore/blk.h>
+#include <homestore/homestore_decl.hpp>
+
+namespace homestore {
+class DeviceManager;
+class VirtualDevMetrics;
+
+/*
+ * Discards the blks freed by each CP of a vdev on the drive, so that an SSD can reclaim them.
+ *
+ * Blks freed in a CP are sorted and merged into contiguous ranges of a chunk, upto discard_max_size_mb. Ranges smaller
+ * than discard_min_size_kb are freed to the blk allocator right away; the rest are queued and discarded by a thread of
+ * this discarder at idle io priority, rate limited to discard_max_mb_per_sec, and are freed to the blk allocator only
+ * after the discard completes, so that a discard never races with the write of a reallocated blk.
+ *
+ * Frees of a CP are persisted by the next CP as before: drain() is called by the next CP flush before the allocators
+ * are flushed, which waits for the discard in progress and frees the queued ranges without discarding them.
+ */
+class BlkDiscarder {
+public:
+    BlkDiscarder(DeviceManager& dmgr, const std::string& name, uint32_t blk_size, VirtualDevMetrics& metrics);
+    BlkDiscarder(const BlkDiscarder&) = delete;
+    BlkDiscarder& operator=(const BlkDiscarder&) = delete;
+    ~BlkDiscarder();
+
+    /// @brief Merges the blks freed by a CP into ranges, frees the small ones and queues the rest to be discarded
+    void submit(std::vector< BlkId >&& bids);
+
+    /// @brief Waits for the discard in progress and frees the queued ranges, without discarding them
+    void drain();
+
+private:
+    struct discard_range {
+        chunk_num_t chunk_num;
+        blk_num_t start_blk;
+        uint64_t nblks{0};
+        std::vector< BlkId > bids;
+    };
+
+    void run();
+    void free_range(const discard_range& r);
+
+private:
+    DeviceManager& m_dmgr;
+    std::string m_name;
+    uint32_t m_blk_size;
+    VirtualDevMetrics& m_metrics;
+
+    std::mutex m_mtx;
+    std::condition_variable m_cv;
+    std::deque< discard_range > m_pending; // Ranges queued to be discarded
+    bool m_in_flight{false};               // A range is being discarded by the thread
+    bool m_stopping{false};
+    std::chrono::steady_clock::time_point m_next_issue; // Next discard is not issued before this, to limit the rate
+    std::thread m_thread;
+};
+} // namespace homestore
@@ -36,6 +36,21 @@ void Chunk::set_user_private(const sisl::blob& data) {
     write_chunk_info();
 }
 
+void Chunk::set_mirror_of(uint32_t primary_chunk_id) {
+    std::unique_lock lg{m_mgmt_mutex};
+    m_chunk_info.is_mirror = 0x01;
+    m_chunk_info.primary_chunk_id = primary_chunk_id;
+    m_chunk_info.compute_checksum();
+    write_chunk_info();
+}
+
+void Chunk::set_mirror_gen(uint32_t gen) {
+    std::unique_lock lg{m_mgmt_mutex};
+    m_chunk_info.mirror_gen = gen;
+    m_chunk_info.compute_checksum();
+    write_chunk_info();
+}
+
 void Chunk::write_chunk_info() {
     auto buf = hs_utils::iobuf_alloc(chunk_info::size, sisl::buftag::superblk, physical_dev()->align_size());
     auto cinfo = new (buf) chunk_info();
@@ -61,6 +61,9 @@ public:
     uint32_t stream_id() const { return m_stream_id; }
     uint32_t slot_number() const { return m_chunk_slot; }
     uint32_t vdev_ordinal() const { return m_vdev_ordinal; }
+    bool is_mirror() const { return (m_chunk_info.is_mirror != 0); }
+    uint16_t primary_chunk_id() const { return static_cast< uint16_t >(m_chunk_info.primary_chunk_id); }
+    uint32_t mirror_gen() const { return m_chunk_info.mirror_gen; }
 
     std::string to_string() const;
     nlohmann::json get_status([[maybe_unused]] int log_level) const;
@@ -71,6 +74,8 @@ public:
     void set_user_private(const sisl::blob& data);
     void set_block_allocator(cshared< BlkAllocator >& blkalloc) { m_blk_allocator = blkalloc; }
     void set_vdev_ordinal(uint32_t vdev_ordinal) { m_vdev_ordinal = vdev_ordinal; }
+    void set_mirror_of(uint32_t primary_chunk_id);
+    void set_mirror_gen(uint32_t gen);
 
 private:
     void write_chunk_info();
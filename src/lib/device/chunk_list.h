@@ -0,0 +1,75 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include <sisl/logging/logging.h>
+#include <homestore/homestore_decl.hpp>
+#include "device/hs_super_blk.h"
+
+namespace homestore {
+class Chunk;
+
+/*
+ * Append only list of the chunks of a chunk selector, which can be added to while chunks are being selected.
+ *
+ * Chunks are kept in segments which are allocated as the list grows and never move, so a chunk added is published by
+ * a single release store of the size and the readers neither lock nor copy the list. Chunks are never removed, as the
+ * chunk selectors don't remove them either.
+ */
+class ChunkList {
+public:
+    ChunkList() = default;
+    ChunkList(const ChunkList&) = delete;
+    ChunkList& operator=(const ChunkList&) = delete;
+
+    void push_back(cshared< Chunk >& chunk) {
+        std::unique_lock lg{m_add_mtx};
+        auto const n = m_size.load(std::memory_order_relaxed);
+        RELEASE_ASSERT_LT(n, max_chunks, "Chunk list is full");
+        auto& seg = m_segments[n / segment_size];
+        if (seg == nullptr) { seg = std::make_unique< shared< Chunk >[] >(segment_size); }
+        seg[n % segment_size] = chunk;
+        m_size.store(n + 1, std::memory_order_release);
+    }
+
+    uint32_t size() const { return m_size.load(std::memory_order_acquire); }
+    bool empty() const { return (size() == 0); }
+
+    /// @brief Chunk at the given index, which should be less than a size() read before
+    cshared< Chunk > operator[](uint32_t idx) const { return m_segments[idx / segment_size][idx % segment_size]; }
+
+    template < typename CB >
+    void for_each(CB&& cb) const {
+        auto const n = size();
+        for (uint32_t i{0}; i < n; ++i) {
+            cb((*this)[i]);
+        }
+    }
+
+private:
+    static constexpr uint32_t segment_size{256};
+    static constexpr uint32_t max_chunks{hs_super_blk::MAX_CHUNKS_IN_SYSTEM};
+
+    std::mutex m_add_mtx;
+    std::array< std::unique_ptr< shared< Chunk >[] >, max_chunks / segment_size > m_segments;
+    std::atomic< uint32_t > m_size{0};
+};
+} // namespace homestore
@@ -14,7 +14,10 @@
  *********************************************************************************/
 #pragma once
 
+#include <atomic>
+#include <limits>
 #include <map>
+#include <memory>
 #include <vector>
 
 #include <homestore/crc.h>
@@ -32,6 +35,14 @@ VENUM(vdev_multi_pdev_opts_t, uint8_t, // Indicates the style of vdev when multi
       SINGLE_ANY_PDEV = 3,             // vdev data is placed on only 1 pdev, but any of the pdev
 );
 
+VENUM(vdev_placement_t, uint8_t, // Class of the data of a vdev, by which its writes are placed on the drive
+      NONE = 0,                  // No placement, writes go to the default write stream
+      JOURNAL = 1,               // Short lived, sequentially overwritten data like logs
+      DATA = 2,                  // Data blks
+      INDEX = 3,                 // Index nodes, overwritten by every CP
+      META = 4,                  // Meta blks
+);
+
 #pragma pack(1)
 struct vdev_info {
     static constexpr size_t size = 512;
@@ -53,7 +64,9 @@ struct vdev_info {
     uint8_t alloc_type;                        // 98: Allocator type of this vdev
     uint8_t chunk_sel_type;                    // 99: Chunk Selector type of this vdev_id
     uint8_t use_slab_allocator{0};             // 100: Use slab allocator for this vdev
-    uint8_t padding[154]{};                    // 101: Padding to make it 256 bytes
+    uint8_t integrity_offload{0};              // 101: Integrity is checked by protection info of the drives
+    uint8_t placement{0};                      // 102: Class of the data of this vdev (vdev_placement_t)
+    uint8_t padding[152]{};                    // 103: Padding to make it 256 bytes
     uint8_t user_private[user_private_size]{}; // 128: User sepcific information
 
     uint32_t get_vdev_id() const { return vdev_id; }
@@ -110,6 +123,8 @@ struct vdev_parameters {
     vdev_multi_pdev_opts_t multi_pdev_opts; // How data to be placed on multiple vdevs
     sisl::blob context_data;                // Context data about this vdev
     bool use_slab_allocator{false};         // Use slab allocator for this vdev
+    bool integrity_offload{false};          // Use protection info of the drives, if they all support it
+    vdev_placement_t placement{vdev_placement_t::NONE}; // Class of the data, to place its writes on the drive
 };
 
 class VirtualDev;
@@ -132,9 +147,14 @@ private:
     uint32_t m_cur_pdev_id{0};
 
     std::map< uint16_t, shared< Chunk > > m_chunks;                 // Chunks organized as array (indexed on chunk id)
+    // Flat table of m_chunks for the io path, indexed on chunk id. It is published to under m_vdev_mutex along with
+    // m_chunks, and read without any lock, so that translating a blkid of an io takes a single load.
+    std::unique_ptr< std::atomic< Chunk* >[] > m_chunk_table{
+        std::make_unique< std::atomic< Chunk* >[] >(hs_super_blk::MAX_CHUNKS_IN_SYSTEM)};
     sisl::Bitset m_chunk_id_bm{hs_super_blk::MAX_CHUNKS_IN_SYSTEM}; // Bitmap to keep track of chunk ids available
 
     std::mutex m_vdev_mutex;                                      // Create/Remove operation of vdev synchronization
+    size_t m_next_chunk_pdev{0};                                  // Pdev to try first for the next chunk created
     sisl::sparse_vector< shared< VirtualDev > > m_vdevs;          // VDevs organized in array for quick lookup
     sisl::Bitset m_vdev_id_bm{hs_super_blk::MAX_VDEVS_IN_SYSTEM}; // Bitmap to keep track of vdev ids available
     vdev_create_cb_t m_vdev_create_cb;
@@ -156,6 +176,20 @@ public:
     void close_devices();
     bool is_boot_in_degraded_mode() const { return m_boot_in_degraded_mode; }
 
+    /// @brief Formats a new device into the running homestore, without a restart. Dynamic size vdevs of its type
+    /// create their chunks on it as well from now on, while static size vdevs use it only once expanded onto it. The
+    /// device should be among the devices homestore is started with from the next restart onwards.
+    /// @param dinfo Device to be added
+    /// @return Physical device of the added device
+    PhysicalDev* add_device(const dev_info& dinfo);
+
+    /// @brief Adds new chunks on the given pdev to a static size vdev, while it is in use. Allocations pick them up
+    /// right away, as per the chunk selector of the vdev. Blks already allocated stay on the chunks they are on.
+    /// @param vdev_id Id of the vdev to expand
+    /// @param pdev Physical device to create the chunks on, like the one returned by add_device
+    /// @param num_chunks Number of chunks, of the chunk size of the vdev, to add
+    void expand_vdev(uint32_t vdev_id, PhysicalDev* pdev, uint32_t num_chunks);
+
     /// @brief Create a VirtualDev based on input parameters
     /// @param vdev_param Parameters defining all the essential inputs to create virtual device
     /// @param event_cb Event handler in case of
@@ -165,16 +199,16 @@ public:
     const Chunk* get_chunk(uint16_t chunk_id) { return get_chunk_mutable(chunk_id); }
 
     Chunk* get_chunk_mutable(uint16_t chunk_id) {
-        std::unique_lock lg{m_vdev_mutex};
-        // if a pdev is misssing when restart, chunk_id from client might be larger than m_chunks.size()
-        if (!m_chunks.contains(chunk_id)) return nullptr;
-        return m_chunks[chunk_id].get();
+        // if a pdev is misssing when restart, chunk of the chunk_id from client is not in the table
+        static_assert(std::numeric_limits< uint16_t >::max() < hs_super_blk::MAX_CHUNKS_IN_SYSTEM);
+        return m_chunk_table[chunk_id].load(std::memory_order_acquire);
     }
 
     uint32_t atomic_page_size(HSDevType dtype) const;
     uint32_t optimal_page_size(HSDevType dtype) const;
     uint32_t align_size(HSDevType dtype) const;
 
+    std::vector< PhysicalDev* > get_pdevs() const;
     std::vector< PhysicalDev* > get_pdevs_by_dev_type(HSDevType dtype) const;
     std::vector< shared< VirtualDev > > get_vdevs() const;
     std::vector< shared< Chunk > > get_chunks() const;
@@ -188,6 +222,7 @@ public:
 
 private:
     void load_vdevs();
+    void add_chunk_locked(cshared< Chunk >& chunk);
     int device_open_flags(const std::string& devname) const;
 
     std::vector< vdev_info > read_vdev_infos(const std::vector< PhysicalDev* >& pdevs);
@@ -209,6 +244,8 @@ public:
         uint8_t hs_dev_type;
         uint32_t vdev_id;
         uint64_t chunk_size;
+        // Zero the chunks before they are added to the pool
+        bool zero_chunks{false};
     };
 
     ChunkPool(DeviceManager& dmgr, Params&& param);
@@ -225,6 +262,9 @@ public:
     // Get a chunk from the pool.
     shared< Chunk > dequeue();
 
+    // Get a chunk from the pool if there is one, without waiting for the producer.
+    shared< Chunk > try_dequeue();
+
     // Returns the capacity of the chunk pool.
     uint64_t capacity() { return m_params.pool_capacity; }
     uint64_t size() { return m_pool.size(); }
@@ -237,6 +277,7 @@ private:
     DeviceManager& m_dmgr;
     Params m_params;
     std::list< shared< Chunk > > m_pool;
+    std::list< shared< Chunk > > m_dirty_chunks; // Chunks released to pool, yet to be zeroed
     uint32_t m_pool_capacity;
     std::condition_variable m_pool_cv;
     std::mutex m_pool_mutex;
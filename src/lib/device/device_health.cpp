@@ -0,0 +1,63 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+
+#include <sisl/logging/logging.h>
+
+#include "device/device_health.hpp"
+#include "device/physical_dev.hpp"
+#include "common/homestore_config.hpp"
+
+namespace homestore {
+DeviceHealth::DeviceHealth(const std::string& name, PhysicalDevMetrics& metrics) :
+        m_name{name}, m_metrics{metrics} {
+    GAUGE_UPDATE(m_metrics, drive_health_score, int64_cast(max_score));
+}
+
+void DeviceHealth::on_io_done(bool is_write, uint64_t offset, uint32_t size, uint64_t latency_us, bool failed) {
+    if (is_write) {
+        HISTOGRAM_OBSERVE(m_metrics, drive_async_write_latency, latency_us);
+    } else {
+        HISTOGRAM_OBSERVE(m_metrics, drive_async_read_latency, latency_us);
+    }
+
+    auto const slow = (latency_us > HS_DYNAMIC_CONFIG(device->slow_io_threshold_us));
+    if (slow) {
+        COUNTER_INCREMENT(m_metrics, drive_slow_ios, 1);
+        auto const nslow = m_slow_ios.fetch_add(1, std::memory_order_relaxed);
+        if ((nslow % std::max(HS_DYNAMIC_CONFIG(device->slow_io_log_sample), 1u)) == 0) {
+            LOGWARN("Slow {} on device={} offset={} size={} latency={}us, slow ios so far={}",
+                    is_write ? "write" : "read", m_name, offset, size, latency_us, nslow + 1);
+        }
+    }
+    if (slow || failed) { m_win_bad.fetch_add(1, std::memory_order_relaxed); }
+
+    // Only the io which completes the window updates the score; ios racing with it are counted in the next window
+    auto const window = std::max(HS_DYNAMIC_CONFIG(device->health_window_ios), 1u);
+    if (m_win_ios.fetch_add(1, std::memory_order_relaxed) + 1 < window) { return; }
+    auto const ios = m_win_ios.exchange(0, std::memory_order_relaxed);
+    if (ios < window) { return; } // Window is completed by another io
+    auto const bad = std::min(m_win_bad.exchange(0, std::memory_order_relaxed), ios);
+
+    auto const win_score = (max_score * (ios - bad)) / ios;
+    auto const score = (m_score.load(std::memory_order_relaxed) + win_score) / 2;
+    m_score.store(score, std::memory_order_relaxed);
+    GAUGE_UPDATE(m_metrics, drive_health_score, int64_cast(score));
+    if (score < sick_score) {
+        LOGWARN("Device={} is unhealthy, {} of last {} ios were slow or failed, health score={}", m_name, bad, ios,
+                score);
+    }
+}
+} // namespace homestore
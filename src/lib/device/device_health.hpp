@@ -0,0 +1,57 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace homestore {
+class PhysicalDevMetrics;
+
+/*
+ * Latency and health tracking of the async ios of a physical device.
+ *
+ * Latency of every async io is observed per op type. An io taking longer than slow_io_threshold_us is counted as slow,
+ * and one out of slow_io_log_sample of them is logged with its offset and size, so that a drive dragging the tail can
+ * be told apart and the area of it which is slow can be looked at.
+ *
+ * Health score, from 0 (every io is slow or failing) to 100 (healthy), is updated once per window of health_window_ios
+ * ios, as the average of the previous score and the percent of the ios of the window which were neither slow nor
+ * failed. It is lock free and approximate, for the chunk selectors and the consumers to steer away from a sick device.
+ */
+class DeviceHealth {
+public:
+    static constexpr uint32_t max_score{100};
+    static constexpr uint32_t sick_score{50}; // Device with a score below this is avoided where there is a choice
+
+    DeviceHealth(const std::string& name, PhysicalDevMetrics& metrics);
+    DeviceHealth(const DeviceHealth&) = delete;
+    DeviceHealth& operator=(const DeviceHealth&) = delete;
+
+    /// @brief Notes the completion of an async io on the device
+    void on_io_done(bool is_write, uint64_t offset, uint32_t size, uint64_t latency_us, bool failed);
+
+    uint32_t score() const { return m_score.load(std::memory_order_relaxed); }
+
+private:
+    std::string m_name;
+    PhysicalDevMetrics& m_metrics;
+
+    std::atomic< uint32_t > m_score{max_score};
+    std::atomic< uint64_t > m_slow_ios{0};
+    std::atomic< uint32_t > m_win_ios{0}; // Ios of the current window
+    std::atomic< uint32_t > m_win_bad{0}; // Ios of the current window which were slow or failed
+};
+} // namespace homestore
@@ -12,6 +12,9 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <algorithm>
+#include <exception>
+#include <thread>
 #include <vector>
 
 #include <iomgr/iomgr.hpp>
@@ -87,10 +90,10 @@ DeviceManager::DeviceManager(const std::vector< dev_info >& devs, vdev_create_cb
     m_first_time_boot = true;
     for (const auto& d : devs) {
         first_block fblk = PhysicalDev::read_first_block(d.dev_name, device_open_flags(d.dev_name));
+        // Header with the latest gen number is the current one, as a device added later bumps it on all devices
         if (fblk.is_valid()) {
             if (fblk.hdr.gen_number > m_first_blk_hdr.gen_number) { m_first_blk_hdr = fblk.hdr; }
             m_first_time_boot = false;
-            break;
         }
     }
 }
@@ -105,6 +108,14 @@ void DeviceManager::format_devices() {
     m_first_blk_hdr.max_system_chunks = hs_super_blk::MAX_CHUNKS_IN_SYSTEM;
     m_first_blk_hdr.system_uuid = boost::uuids::random_generator()();
 
+    // Pdevs are populated one after another, their super blocks are written in parallel afterwards
+    struct pdev_format {
+        PhysicalDev* pdev;
+        uint8_t* buf;
+        uint32_t sb_size;
+    };
+    std::vector< pdev_format > formats;
+
     // Get common iomgr_attributes
     for (auto& dinfo : m_dev_infos) {
         auto attr = iomgr::DriveInterface::get_attributes(dinfo.dev_name);
@@ -125,7 +136,7 @@ void DeviceManager::format_devices() {
 
         LOGINFO("Formatting Homestore on Device={} with first block as: [{}] total_super_blk_size={}", dinfo.dev_name,
                 fblk->to_string(), sb_size);
-        pdev->write_super_block(buf, sb_size, hs_super_blk::first_block_offset());
+        formats.push_back(pdev_format{pdev.get(), buf, uint32_cast(sb_size)});
 
         auto it = m_pdevs_by_type.find(dinfo.dev_type);
         if (it == m_pdevs_by_type.end()) {
@@ -133,11 +144,22 @@ void DeviceManager::format_devices() {
             std::tie(it, happened) = m_pdevs_by_type.insert(std::pair{dinfo.dev_type, std::vector< PhysicalDev* >{}});
         }
         it->second.push_back(pdev.get());
-
-        pdev->format_chunks();
         m_all_pdevs[pdev_id] = std::move(pdev);
+    }
 
-        hs_utils::iobuf_free(buf, sisl::buftag::superblk);
+    std::vector< std::thread > threads;
+    threads.reserve(formats.size());
+    for (auto const& f : formats) {
+        threads.emplace_back([f]() {
+            f.pdev->write_super_block(f.buf, f.sb_size, hs_super_blk::first_block_offset());
+            f.pdev->format_chunks();
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    for (auto const& f : formats) {
+        hs_utils::iobuf_free(f.buf, sisl::buftag::superblk);
     }
 }
 
@@ -171,8 +193,11 @@ void DeviceManager::load_devices() {
         }
         it->second.push_back(pdev.get());
 
+        m_cur_pdev_id = std::max(m_cur_pdev_id, pinfo->pdev_id + 1);
         m_all_pdevs[pinfo->pdev_id] = std::move(pdev);
     }
+    // Ids of the missing pdevs are not reused either
+    m_cur_pdev_id = std::max(m_cur_pdev_id, m_first_blk_hdr.num_pdevs);
 
     load_vdevs();
 }
@@ -198,6 +223,136 @@ void DeviceManager::commit_formatting() {
     LOGINFO("HomeStore formatting is committed on all physical devices");
 }
 
+PhysicalDev* DeviceManager::add_device(const dev_info& new_dinfo) {
+    std::unique_lock lg{m_vdev_mutex};
+    for (auto const& d : m_dev_infos) {
+        RELEASE_ASSERT(d.dev_name != new_dinfo.dev_name, "Device={} is already part of homestore", d.dev_name);
+    }
+
+    dev_info dinfo = new_dinfo;
+    auto attr = iomgr::DriveInterface::get_attributes(dinfo.dev_name);
+    if (dinfo.dev_size == 0) { dinfo.dev_size = PhysicalDev::get_dev_size(dinfo.dev_name); }
+
+    ++m_first_blk_hdr.gen_number;
+    ++m_first_blk_hdr.num_pdevs;
+
+    auto sb_size = hs_super_blk::total_used_size(dinfo);
+    auto buf = hs_utils::iobuf_alloc(sb_size, sisl::buftag::superblk, attr.align_size);
+    std::memset(buf, 0, sb_size);
+
+    first_block* fblk = r_cast< first_block* >(buf);
+    fblk->magic = first_block::HOMESTORE_MAGIC;
+    fblk->checksum = 0;
+    fblk->formatting_done = 0x0; // Until the device is completely formatted below
+    fblk->hdr = m_first_blk_hdr;
+    auto pdev_id = populate_pdev_info(dinfo, attr, m_first_blk_hdr.system_uuid, fblk->this_pdev_hdr);
+    fblk->checksum = crc32_ieee(init_crc32, uintptr_cast(fblk), first_block::s_atomic_fb_size);
+
+    auto pdev = std::make_unique< PhysicalDev >(dinfo, device_open_flags(dinfo.dev_name), fblk->this_pdev_hdr);
+    LOGINFO("Adding Device={} to homestore with first block as: [{}] total_super_blk_size={}", dinfo.dev_name,
+            fblk->to_string(), sb_size);
+    pdev->write_super_block(buf, sb_size, hs_super_blk::first_block_offset());
+    pdev->format_chunks();
+
+    // Vdev infos are read from the first pdev of a type on load, so the new pdev gets a copy of them
+    auto& pdevs = m_pdevs_by_type[dinfo.dev_type];
+    if (!pdevs.empty()) {
+        auto vbuf = hs_utils::iobuf_alloc(hs_super_blk::vdev_super_block_size(), sisl::buftag::superblk,
+                                          std::max(pdevs[0]->align_size(), pdev->align_size()));
+        pdevs[0]->read_super_block(vbuf, hs_super_blk::vdev_super_block_size(), hs_super_blk::vdev_sb_offset());
+        pdev->write_super_block(vbuf, hs_super_blk::vdev_super_block_size(), hs_super_blk::vdev_sb_offset());
+        hs_utils::iobuf_free(vbuf, sisl::buftag::superblk);
+    }
+
+    fblk->formatting_done = 0x1;
+    fblk->checksum = 0;
+    fblk->checksum = crc32_ieee(init_crc32, uintptr_cast(fblk), first_block::s_atomic_fb_size);
+    pdev->write_super_block(buf, hs_super_blk::first_block_size(), hs_super_blk::first_block_offset());
+    hs_utils::iobuf_free(buf, sisl::buftag::superblk);
+
+    // Bump the header on the other pdevs, so that a restart with the new device included is not taken as degraded
+    auto hbuf = hs_utils::iobuf_alloc(hs_super_blk::first_block_size(), sisl::buftag::superblk, 512);
+    for (auto& p : m_all_pdevs) {
+        if (!p) { continue; }
+        auto err = p->read_super_block(hbuf, hs_super_blk::first_block_size(), hs_super_blk::first_block_offset());
+        if (err) {
+            LOGERROR("Failed to read first block from device={}, error={}", p->get_devname(), err.message());
+            continue;
+        }
+        first_block* pfblk = r_cast< first_block* >(hbuf);
+        pfblk->hdr = m_first_blk_hdr;
+        pfblk->checksum = 0;
+        pfblk->checksum = crc32_ieee(init_crc32, uintptr_cast(pfblk), first_block::s_atomic_fb_size);
+        p->write_super_block(hbuf, hs_super_blk::first_block_size(), hs_super_blk::first_block_offset());
+    }
+    hs_utils::iobuf_free(hbuf, sisl::buftag::superblk);
+
+    auto* ret = pdev.get();
+    pdevs.push_back(ret);
+    m_all_pdevs[pdev_id] = std::move(pdev);
+    m_dev_infos.push_back(dinfo);
+    LOGINFO("Device={} is added to homestore as pdev_id={}, num_pdevs={}", dinfo.dev_name, pdev_id,
+            m_first_blk_hdr.num_pdevs);
+    return ret;
+}
+
+void DeviceManager::expand_vdev(uint32_t vdev_id, PhysicalDev* pdev, uint32_t num_chunks) {
+    std::unique_lock lg{m_vdev_mutex};
+    auto vdev = m_vdevs[vdev_id];
+    RELEASE_ASSERT(vdev, "vdev_id={} to expand is not found", vdev_id);
+    auto vinfo = vdev->info();
+    auto const dev_type = static_cast< HSDevType >(vinfo.hs_dev_type);
+    auto const& pdevs = pdevs_by_type_internal(dev_type);
+    RELEASE_ASSERT(std::find(pdevs.begin(), pdevs.end(), pdev) != pdevs.end(),
+                   "pdev={} is not of the device type of vdev={}", pdev->get_devname(), vinfo.get_name());
+    RELEASE_ASSERT(vinfo.size_type == vdev_size_type_t::VDEV_SIZE_STATIC,
+                   "vdev={} is of dynamic size, which grows by creating chunks on demand", vinfo.get_name());
+    RELEASE_ASSERT(!vdev->is_mirrored(), "Mirrored vdev={} can't be expanded onto a single pdev", vinfo.get_name());
+    if (pdev->is_zoned()) {
+        RELEASE_ASSERT((vinfo.alloc_type == enum_value(blk_allocator_type_t::append)) &&
+                           (vinfo.chunk_size % pdev->zone_size() == 0),
+                       "vdev={} can't be expanded onto zoned pdev={}", vinfo.get_name(), pdev->get_devname());
+    }
+
+    std::vector< uint32_t > chunk_ids;
+    for (uint32_t c{0}; c < num_chunks; ++c) {
+        auto chunk_id = m_chunk_id_bm.get_next_reset_bit(0u);
+        if (chunk_id == sisl::Bitset::npos) { throw std::out_of_range("System has no room for additional chunks"); }
+        m_chunk_id_bm.set_bit(chunk_id);
+        chunk_ids.push_back(chunk_id);
+    }
+
+    std::vector< shared< Chunk > > chunks;
+    try {
+        chunks = pdev->create_chunks(chunk_ids, vdev_id, vinfo.chunk_size);
+    } catch (std::out_of_range const&) {
+        for (auto const id : chunk_ids) {
+            m_chunk_id_bm.reset_bit(id);
+        }
+        throw;
+    }
+
+    // Allocations of the vdev pick up the new chunks from here on
+    for (auto& chunk : chunks) {
+        vdev->add_chunk(chunk, true /* fresh_chunk */);
+        add_chunk_locked(chunk);
+    }
+
+    vinfo.vdev_size += uint64_cast(num_chunks) * vinfo.chunk_size;
+    vinfo.num_primary_chunks += num_chunks;
+    vinfo.compute_checksum();
+    vdev->update_info(vinfo);
+
+    auto buf = hs_utils::iobuf_alloc(vdev_info::size, sisl::buftag::superblk, pdev->align_size());
+    std::memcpy(buf, &vinfo, sizeof(vdev_info));
+    for (auto* p : pdevs) {
+        p->write_super_block(buf, vdev_info::size, hs_super_blk::vdev_sb_offset() + (vdev_id * vdev_info::size));
+    }
+    hs_utils::iobuf_free(buf, sisl::buftag::superblk);
+    LOGINFO("Virtual Dev={} is expanded by {} chunks on pdev={} to size={}", vinfo.get_name(), num_chunks,
+            pdev->get_devname(), in_bytes(vinfo.vdev_size));
+}
+
 void DeviceManager::close_devices() {
     for (auto& pdev : m_all_pdevs) {
         if (pdev) { pdev->close_device(); }
@@ -304,6 +459,55 @@ shared< VirtualDev > DeviceManager::create_vdev(vdev_parameters&& vparam) {
                     vparam.vdev_name, in_bytes(input_vdev_size), in_bytes(vparam.vdev_size));
         }
     }
+    // Chunks on zoned drives are made of whole zones, as a zone can only be written sequentially and reset as a whole.
+    // So only the vdevs which write their chunks sequentially, with append blk allocator or as journal, can be on them.
+    uint64_t zone_size{0};
+    uint32_t max_open_zones{0};
+    for (auto const* pdev : pdevs) {
+        zone_size = std::max(zone_size, pdev->zone_size());
+        if (pdev->max_open_zones()) {
+            max_open_zones = max_open_zones ? std::min(max_open_zones, pdev->max_open_zones()) : pdev->max_open_zones();
+        }
+    }
+    if (zone_size != 0) {
+        RELEASE_ASSERT((vparam.alloc_type == blk_allocator_type_t::append) ||
+                           (vparam.placement == vdev_placement_t::JOURNAL),
+                       "{} Virtual device writes randomly and can't be created on zoned drives", vparam.vdev_name);
+        RELEASE_ASSERT_LE(zone_size, Chunk::MAX_CHUNK_SIZE, "Zone size is larger than max chunk size");
+        auto const input_chunk_size = vparam.chunk_size;
+        if (vparam.size_type == vdev_size_type_t::VDEV_SIZE_STATIC) {
+            auto const chunk_size = std::max(sisl::round_down(uint64_cast(vparam.chunk_size), zone_size), zone_size);
+            vparam.chunk_size = uint32_cast(chunk_size);
+            vparam.num_chunks = std::max(uint32_cast(vparam.vdev_size / vparam.chunk_size), 1u);
+            vparam.vdev_size = uint64_cast(vparam.num_chunks) * vparam.chunk_size;
+        } else {
+            vparam.chunk_size = uint32_cast(sisl::round_up(uint64_cast(vparam.chunk_size), zone_size));
+        }
+        if (input_chunk_size != vparam.chunk_size) {
+            LOGINFO("{} Virtual device is on zoned drives with zone_size={}, chunk_size={} is adjusted to "
+                    "new_chunk_size={}",
+                    vparam.vdev_name, in_bytes(zone_size), in_bytes(input_chunk_size), in_bytes(vparam.chunk_size));
+        }
+
+        // Every chunk being written keeps a zone open, which the drive limits
+        auto const chunks_per_pdev = (vparam.num_chunks - 1) / pdevs.size() + 1;
+        if (max_open_zones && (vparam.alloc_type == blk_allocator_type_t::append) &&
+            (chunks_per_pdev > max_open_zones)) {
+            LOGWARN("{} Virtual device has {} chunks per zoned drive, beyond max_open_zones={}, writes to more chunks "
+                    "than that at a time would fail",
+                    vparam.vdev_name, chunks_per_pdev, max_open_zones);
+        }
+    }
+
+    // Every primary chunk of a mirrored vdev has a mirror copy of the same ordinal on each of the other pdevs
+    if (vparam.multi_pdev_opts == vdev_multi_pdev_opts_t::ALL_PDEV_MIRRORED) {
+        RELEASE_ASSERT(vparam.size_type == vdev_size_type_t::VDEV_SIZE_STATIC,
+                       "{} Virtual device can't be mirrored with dynamic size", vparam.vdev_name);
+        auto const npdevs = uint32_cast(pdevs.size());
+        vparam.num_chunks = std::max(sisl::round_down(vparam.num_chunks, npdevs), npdevs);
+        vparam.vdev_size = uint64_cast(vparam.num_chunks) * vparam.chunk_size;
+    }
+
     // sanity checks
     RELEASE_ASSERT(vparam.vdev_size % vparam.chunk_size == 0, "vdev_size should be multiple of chunk_size");
     RELEASE_ASSERT(vparam.chunk_size % vparam.blk_size == 0, "chunk_size should be multiple of blk_size");
@@ -311,6 +515,32 @@ shared< VirtualDev > DeviceManager::create_vdev(vdev_parameters&& vparam) {
 
     RELEASE_ASSERT(vparam.num_chunks <= max_num_chunks, "num_chunks should be less than or equal to max_num_chunks");
 
+    // Protection info is used only if every drive of the vdev has it and its verification could be turned on for all
+    // of them, else caller falls back to software checksums. Drives are all probed first, so that none is changed
+    // before a fallback.
+    if (vparam.integrity_offload) {
+        for (auto const* pdev : pdevs) {
+            if (!PhysicalDev::probe_integrity(pdev->get_devname())) {
+                LOGWARN("{} Virtual device is attempted to be created with integrity offload, but pdev={} has no "
+                        "protection info, falling back to software checksums",
+                        vparam.vdev_name, pdev->get_devname());
+                vparam.integrity_offload = false;
+                break;
+            }
+        }
+    }
+    if (vparam.integrity_offload) {
+        for (auto const* pdev : pdevs) {
+            if (!PhysicalDev::enable_integrity(pdev->get_devname())) {
+                LOGWARN("{} Virtual device is attempted to be created with integrity offload, but verification of "
+                        "pdev={} could not be turned on, falling back to software checksums",
+                        vparam.vdev_name, pdev->get_devname());
+                vparam.integrity_offload = false;
+                break;
+            }
+        }
+    }
+
     LOGINFO(
         "New Virtal Dev={} of size={} with id={} is attempted to be created with multi_pdev_opts={}. The params are "
         "adjusted as follows: VDev_Size={} Num_pdevs={} Total_chunks_across_all_pdevs={} Each_Chunk_Size={}",
@@ -336,6 +566,7 @@ shared< VirtualDev > DeviceManager::create_vdev(vdev_parameters&& vparam) {
     LOGINFO("total size of type {} in this homestore is  {}", vparam.dev_type, total_type_size)
 
     uint32_t total_created_chunks{0};
+    std::vector< std::pair< PhysicalDev*, std::vector< uint32_t > > > pdev_chunk_ids;
 
     for (auto& pdev : pdevs) {
         if (total_created_chunks >= vparam.num_chunks) break;
@@ -343,7 +574,9 @@ shared< VirtualDev > DeviceManager::create_vdev(vdev_parameters&& vparam) {
 
         // the total number of chunks will be created in this pdev
         auto total_chunk_num_in_pdev =
-            static_cast< uint32_t >(vparam.num_chunks * (pdev->data_size() / static_cast< float >(total_type_size)));
+            (vparam.multi_pdev_opts == vdev_multi_pdev_opts_t::ALL_PDEV_MIRRORED)
+            ? uint32_cast(vparam.num_chunks / pdevs.size())
+            : static_cast< uint32_t >(vparam.num_chunks * (pdev->data_size() / static_cast< float >(total_type_size)));
 
         RELEASE_ASSERT(vparam.num_chunks >= total_chunk_num_in_pdev,
                        "chunks in pdev {} is {},  larger than total chunks {} , which is expected to be created ",
@@ -360,14 +593,47 @@ shared< VirtualDev > DeviceManager::create_vdev(vdev_parameters&& vparam) {
             chunk_ids.push_back(chunk_id);
         }
 
-        // Create all chunks at one shot and add each one to the vdev
-        auto chunks = pdev->create_chunks(chunk_ids, vdev_id, vparam.chunk_size);
+        pdev_chunk_ids.emplace_back(pdev, std::move(chunk_ids));
+        total_created_chunks += total_chunk_num_in_pdev;
+    }
+
+    // Create all chunks of each pdev at one shot, pdevs in parallel, and add each one to the vdev
+    std::vector< std::vector< shared< Chunk > > > pdev_chunks(pdev_chunk_ids.size());
+    std::vector< std::exception_ptr > errors(pdev_chunk_ids.size());
+    std::vector< std::thread > threads;
+    threads.reserve(pdev_chunk_ids.size());
+    for (size_t i{0}; i < pdev_chunk_ids.size(); ++i) {
+        threads.emplace_back([&, i]() {
+            try {
+                auto& [pdev, chunk_ids] = pdev_chunk_ids[i];
+                pdev_chunks[i] = pdev->create_chunks(chunk_ids, vdev_id, vparam.chunk_size);
+            } catch (...) { errors[i] = std::current_exception(); }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    for (auto const& e : errors) {
+        if (e) { std::rethrow_exception(e); }
+    }
+
+    // Chunks of the first pdev are the primaries, which the blks are allocated from, and the chunks of same ordinal on
+    // the other pdevs are their mirrors. It is persisted in the mirrors, so that it doesn't depend on the pdevs found.
+    if (vparam.multi_pdev_opts == vdev_multi_pdev_opts_t::ALL_PDEV_MIRRORED) {
+        for (size_t i{1}; i < pdev_chunks.size(); ++i) {
+            RELEASE_ASSERT_EQ(pdev_chunks[i].size(), pdev_chunks[0].size(), "Mirrors of vdev={} are uneven",
+                              vparam.vdev_name);
+            for (size_t c{0}; c < pdev_chunks[i].size(); ++c) {
+                pdev_chunks[i][c]->set_mirror_of(pdev_chunks[0][c]->chunk_id());
+            }
+        }
+    }
+
+    for (auto& chunks : pdev_chunks) {
         for (auto& chunk : chunks) {
             vdev->add_chunk(chunk, true /* fresh_chunk */);
-            m_chunks[chunk->chunk_id()] = chunk;
+            add_chunk_locked(chunk);
         }
-
-        total_created_chunks += total_chunk_num_in_pdev;
     }
 
     LOGINFO("{} chunks is created for vdev {}, expected {}", total_created_chunks, vparam.vdev_name, vparam.num_chunks);
@@ -413,7 +679,7 @@ void DeviceManager::load_vdevs() {
                     return false;
                 }
                 m_chunk_id_bm.set_bit(chunk->chunk_id());
-                m_chunks[chunk->chunk_id()] = chunk;
+                add_chunk_locked(chunk);
                 HS_LOG(TRACE, device, "loaded chunks {} ", chunk->to_string())
                 m_vdevs[chunk->vdev_id()]->add_chunk(chunk, false /* fresh_chunk */);
                 return true;
@@ -437,8 +703,11 @@ shared< Chunk > DeviceManager::create_chunk(HSDevType dev_type, uint32_t vdev_id
 
     shared< Chunk > chunk;
     PhysicalDev* pdev = nullptr;
-    // Create a chunk on any pdev of device type.
-    for (const auto& dev : pdevs) {
+    // Create a chunk on any pdev of device type. Start from the pdev next to the one of the last chunk created, so that
+    // the chunks, the consecutive ones of a journal in particular, are spread over the pdevs.
+    for (size_t i{0}; i < pdevs.size(); ++i) {
+        auto const dev_idx = (m_next_chunk_pdev + i) % pdevs.size();
+        auto* dev = pdevs[dev_idx];
         // Ordinal added in add_chunk.
         try {
             chunk = dev->create_chunk(chunk_id, vdev_id, chunk_size, 0 /* ordinal */, data);
@@ -449,6 +718,7 @@ shared< Chunk > DeviceManager::create_chunk(HSDevType dev_type, uint32_t vdev_id
 
         if (chunk != nullptr) {
             pdev = dev;
+            m_next_chunk_pdev = dev_idx + 1;
             break;
         }
     }
@@ -457,7 +727,7 @@ shared< Chunk > DeviceManager::create_chunk(HSDevType dev_type, uint32_t vdev_id
 
     auto vdev = m_vdevs[vdev_id];
     vdev->add_chunk(chunk, true /* fresh_chunk */);
-    m_chunks[chunk->chunk_id()] = chunk;
+    add_chunk_locked(chunk);
 
     auto buf = hs_utils::iobuf_alloc(vdev_info::size, sisl::buftag::superblk, pdev->align_size());
     auto vdev_info = vdev->info();
@@ -498,6 +768,7 @@ void DeviceManager::remove_chunk_locked(shared< Chunk > chunk) {
     vdev->remove_chunk(chunk);
 
     m_chunks.erase(chunk_id);
+    m_chunk_table[chunk_id].store(nullptr, std::memory_order_release);
 
     // Update the vdev info.
     auto buf = hs_utils::iobuf_alloc(vdev_info::size, sisl::buftag::superblk, pdev->align_size());
@@ -568,6 +839,8 @@ static void populate_vdev_info(const vdev_parameters& vparam, uint32_t vdev_id,
     out_info->chunk_sel_type = s_cast< uint8_t >(vparam.chunk_sel_type);
     out_info->size_type = vparam.size_type;
     out_info->use_slab_allocator = vparam.use_slab_allocator ? 1 : 0;
+    out_info->integrity_offload = vparam.integrity_offload ? 1 : 0;
+    out_info->placement = enum_value(vparam.placement);
     out_info->compute_checksum();
 }
 
@@ -601,6 +874,14 @@ int DeviceManager::device_open_flags(const std::string& devname) const {
     return is_hdd(devname) ? m_hdd_open_flags : m_ssd_open_flags;
 }
 
+std::vector< PhysicalDev* > DeviceManager::get_pdevs() const {
+    std::vector< PhysicalDev* > pdevs;
+    for (auto const& [_, type_pdevs] : m_pdevs_by_type) {
+        pdevs.insert(pdevs.end(), type_pdevs.begin(), type_pdevs.end());
+    }
+    return pdevs;
+}
+
 std::vector< PhysicalDev* > DeviceManager::get_pdevs_by_dev_type(HSDevType dtype) const {
     return m_pdevs_by_type.at(dtype);
 }
@@ -628,6 +909,11 @@ std::vector< shared< VirtualDev > > DeviceManager::get_vdevs() const {
     return ret_v;
 }
 
+void DeviceManager::add_chunk_locked(cshared< Chunk >& chunk) {
+    m_chunks[chunk->chunk_id()] = chunk;
+    m_chunk_table[chunk->chunk_id()].store(chunk.get(), std::memory_order_release);
+}
+
 std::vector< shared< Chunk > > DeviceManager::get_chunks() const {
     std::unique_lock lg{m_vdev_mutex};
     std::vector< shared< Chunk > > res;
@@ -676,6 +962,7 @@ void ChunkPool::producer() {
         std::unique_lock< std::mutex > lk{m_pool_mutex};
         m_pool_cv.wait(lk, [this] {
             if (m_run_pool == false) return true;
+            if (!m_dirty_chunks.empty()) return true;
             if (m_pool.size() < (m_params.pool_capacity / 2)) return true;
             return false;
         });
@@ -685,10 +972,27 @@ void ChunkPool::producer() {
             return;
         }
 
-        auto private_data = m_params.init_private_data_cb();
-        auto chunk = m_dmgr.create_chunk(static_cast< HSDevType >(m_params.hs_dev_type), m_params.vdev_id,
-                                         m_params.chunk_size, std::move(private_data));
-        RELEASE_ASSERT(chunk, "Cannot create chunk");
+        shared< Chunk > chunk;
+        if (!m_dirty_chunks.empty()) {
+            // Recycled chunks are zeroed before they are added back to the pool
+            chunk = std::move(m_dirty_chunks.front());
+            m_dirty_chunks.pop_front();
+            lk.unlock();
+        } else {
+            lk.unlock();
+            auto private_data = m_params.init_private_data_cb();
+            chunk = m_dmgr.create_chunk(static_cast< HSDevType >(m_params.hs_dev_type), m_params.vdev_id,
+                                        m_params.chunk_size, std::move(private_data));
+            RELEASE_ASSERT(chunk, "Cannot create chunk");
+        }
+
+        // Zero the chunk without holding the lock, so that consumers are not waiting for it
+        if (m_params.zero_chunks) {
+            auto const err = chunk->physical_dev_mutable()->sync_write_zero(chunk->size(), chunk->start_offset());
+            RELEASE_ASSERT(!err, "Failed to zero chunk_id={} error={}", chunk->chunk_id(), err.message());
+        }
+
+        lk.lock();
         m_pool.push_back(chunk);
         HS_LOG(TRACE, device, "Produced chunk to pool chunk_id={} type={} vdev_id={} size {}", chunk->chunk_id(),
                m_params.hs_dev_type, m_params.vdev_id, m_params.chunk_size);
@@ -711,14 +1015,34 @@ shared< Chunk > ChunkPool::dequeue() {
     return chunk;
 }
 
+shared< Chunk > ChunkPool::try_dequeue() {
+    RELEASE_ASSERT(m_run_pool, "Pool not started");
+    shared< Chunk > chunk;
+    {
+        std::unique_lock< std::mutex > lk{m_pool_mutex};
+        if (!m_pool.empty()) {
+            chunk = m_pool.back();
+            m_pool.pop_back();
+        }
+    }
+    // Wake up the producer either way, to refill the pool
+    m_pool_cv.notify_all();
+    if (chunk) { HS_LOG(TRACE, device, "Dequeue chunk {} from pool", chunk->chunk_id()); }
+    return chunk;
+}
+
 bool ChunkPool::enqueue(shared< Chunk >& chunk) {
     RELEASE_ASSERT(chunk, "Chunk invalid");
     bool reuse = false;
     {
         std::unique_lock< std::mutex > lk{m_pool_mutex};
-        if (m_pool.size() < m_params.pool_capacity) {
+        if ((m_pool.size() + m_dirty_chunks.size()) < m_params.pool_capacity) {
             chunk->set_user_private(m_params.init_private_data_cb());
-            m_pool.push_back(chunk);
+            if (m_params.zero_chunks) {
+                m_dirty_chunks.push_back(chunk);
+            } else {
+                m_pool.push_back(chunk);
+            }
             reuse = true;
             HS_LOG(TRACE, device, "Enqueue chunk {} to pool", chunk->chunk_id());
         }
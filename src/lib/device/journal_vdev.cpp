@@ -13,6 +13,7 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <functional>
@@ -20,7 +21,9 @@
 #include <limits>
 #include <memory>
 
+#include <boost/fiber/operations.hpp>
 #include <sisl/logging/logging.h>
+#include <iomgr/iomgr.hpp>
 #include <iomgr/iomgr_flip.hpp>
 #include <homestore/homestore.hpp>
 #include <homestore/logstore_service.hpp>
@@ -44,6 +47,11 @@ JournalVirtualDev::JournalVirtualDev(DeviceManager& dmgr, const vdev_info& vinfo
 
     // Private data stored when chunks are created.
     m_init_private_data = std::make_shared< JournalChunkPrivate >();
+
+    // Chunks on zoned drives are always zeroed, which resets their zones, before they are written from the start again
+    for (auto* pdev : dmgr.get_pdevs_by_dev_type(static_cast< HSDevType >(m_vdev_info.hs_dev_type))) {
+        m_zoned = m_zoned || pdev->is_zoned();
+    }
     m_chunk_pool = std::make_unique< ChunkPool >(
         dmgr,
         ChunkPool::Params{
@@ -54,7 +62,21 @@ JournalVirtualDev::JournalVirtualDev(DeviceManager& dmgr, const vdev_info& vinfo
                 sisl::blob private_blob{r_cast< uint8_t* >(m_init_private_data.get()), sizeof(JournalChunkPrivate)};
                 return private_blob;
             },
-            m_vdev_info.hs_dev_type, m_vdev_info.vdev_id, m_vdev_info.chunk_size});
+            m_vdev_info.hs_dev_type, m_vdev_info.vdev_id, m_vdev_info.chunk_size,
+            HS_DYNAMIC_CONFIG(generic.journal_chunk_pool_zero_chunks) || m_zoned});
+
+    // Without a configured capacity, the journal can grow into all of the pdevs it creates its chunks on
+    uint64_t capacity{0};
+    for (auto* pdev : dmgr.get_pdevs_by_dev_type(static_cast< HSDevType >(m_vdev_info.hs_dev_type))) {
+        capacity += pdev->data_size();
+    }
+    resource_mgr().set_journal_vdev_capacity(capacity);
+
+    auto const& pmem_path = HS_STATIC_CONFIG(input.journal_pmem_path);
+    if (!pmem_path.empty()) {
+        m_pmem_tier = PmemJournalTier::make(pmem_path, HS_STATIC_CONFIG(input.journal_pmem_size), align_size());
+        if (!m_pmem_tier) { LOGWARN("Journal writes go to chunks directly, pmem tier={} is not usable", pmem_path); }
+    }
 
     resource_mgr().register_journal_vdev_exceed_cb([this]([[maybe_unused]] int64_t dirty_buf_count, bool critical) {
         // either it is critical or non-critical, call cp_flush;
@@ -104,6 +126,9 @@ void JournalVirtualDev::init() {
         // in order to the journal descriptor. next_chunk is stored in private_data.
         // Last chunk will have next_chunk as 0.
         auto chunk_num = head.chunk_num;
+        auto const* head_data = r_cast< JournalChunkPrivate const* >(chunk_map[chunk_num]->user_private());
+        journal_desc->m_stripe_width = std::max< uint32_t >(head_data->stripe_width, 1u);
+        journal_desc->m_stripe_unit = head_data->stripe_unit;
         while (chunk_num != 0) {
             auto& c = chunk_map[chunk_num];
             RELEASE_ASSERT(c, "Invalid chunk found log_dev={} chunk={}", logdev_id, c->to_string());
@@ -112,13 +137,26 @@ void JournalVirtualDev::init() {
             LOGINFOMOD(journalvdev, "Loading log_dev={} chunk={}", logdev_id, c->to_string());
 
             // Increase the the total size.
-            journal_desc->m_total_size += c->size();
+            journal_desc->m_total_size += journal_desc->segment_size();
 
             auto data = r_cast< JournalChunkPrivate* >(const_cast< uint8_t* >(c->user_private()));
+            if (journal_desc->m_stripe_width > 1) {
+                // Rest of the chunks of the segment are not in the list, but referred by its first chunk.
+                auto& rest = journal_desc->m_stripe_chunks[chunk_num];
+                for (uint32_t i{0}; i < journal_desc->m_stripe_width - 1; ++i) {
+                    auto& sc = chunk_map[data->stripe_chunks[i]];
+                    RELEASE_ASSERT(sc, "Invalid stripe chunk found log_dev={} chunk={} stripe={}", logdev_id,
+                                   chunk_num, data->stripe_chunks[i]);
+                    rest.push_back(sc);
+                    visited_chunks.insert(sc->chunk_id());
+                }
+            }
             chunk_num = data->next_chunk;
         }
     }
 
+    if (m_pmem_tier) { recover_pmem_tier(chunk_map); }
+
     // Chunks which are not in visited set are orphans and needs to be cleaned up.
     // Remove chunk will affect the m_all_chunks so keep a separate list.
     std::vector< shared< Chunk > > orphan_chunks;
@@ -137,6 +175,34 @@ void JournalVirtualDev::init() {
     LOGINFO("Journal vdev init done");
 }
 
+void JournalVirtualDev::recover_pmem_tier(const std::unordered_map< chunk_num_t, shared< Chunk > >& chunk_map) {
+    m_pmem_tier->recover([this, &chunk_map](logdev_id_t logdev_id, chunk_num_t chunk_num, uint64_t offset_in_segment,
+                                            const uint8_t* data, uint64_t size) {
+        // Write to a chunk which is not in the journal anymore was destaged before the chunk was truncated off
+        auto const jd_it = m_journal_descriptors.find(logdev_id);
+        auto const chunk_it = chunk_map.find(chunk_num);
+        if ((jd_it == m_journal_descriptors.end()) || (chunk_it == chunk_map.end())) { return; }
+        auto& jd = *jd_it->second;
+        auto const& chunk = chunk_it->second;
+        if (std::find(jd.m_journal_chunks.begin(), jd.m_journal_chunks.end(), chunk) == jd.m_journal_chunks.end()) {
+            return;
+        }
+
+        auto const* buf = r_cast< const char* >(data);
+        std::error_code err;
+        if (jd.m_stripe_width == 1) {
+            err = sync_write(buf, size, chunk, offset_in_segment);
+        } else {
+            for (auto const& p : jd.stripe_pieces(chunk, offset_in_segment, size)) {
+                err = sync_write(buf + p.buf_offset, p.size, p.chunk, p.offset_in_chunk);
+                if (err) { break; }
+            }
+        }
+        HS_REL_ASSERT(!err, "Destage of staged journal write failed on recovery, log_dev={} chunk={} error={}",
+                      logdev_id, chunk_num, err.message());
+    });
+}
+
 void JournalVirtualDev::remove_journal_chunks(std::vector< shared< Chunk > >& chunks) {
     for (auto& chunk : chunks) {
         auto* data = r_cast< JournalChunkPrivate* >(const_cast< uint8_t* >(chunk->user_private()));
@@ -199,23 +265,73 @@ void JournalVirtualDev::destroy(logdev_id_t logdev_id) {
         return;
     }
 
-    // Remove all the chunks.
+    it->second->wait_for_destage();
+
+    // Remove all the chunks, the prepared one is not part of the journal yet and can be reused.
+    for (auto& [_, rest] : it->second->m_stripe_chunks) {
+        remove_journal_chunks(rest);
+    }
     remove_journal_chunks(it->second->m_journal_chunks);
+    if (it->second->m_prepared_chunk) { release_chunk_to_pool(std::move(it->second->m_prepared_chunk)); }
+    resource_mgr().release_journal_space(it->second->m_space_credits);
     m_journal_descriptors.erase(it);
     LOGINFOMOD(journalvdev, "Journal vdev destroyed log_dev={}", logdev_id);
 }
 
+JournalVirtualDev::Descriptor::Descriptor(JournalVirtualDev& vdev, logdev_id_t id) : m_vdev(vdev), m_logdev_id(id) {
+    auto const width = std::clamp< uint32_t >(HS_DYNAMIC_CONFIG(generic.journal_stripe_width), 1u,
+                                              max_journal_stripe_width);
+    auto const unit = HS_DYNAMIC_CONFIG(generic.journal_stripe_unit_kb) * 1024;
+    if (width > 1) {
+        if ((unit == 0) || (m_vdev.info().chunk_size % unit != 0) || (unit % m_vdev.align_size() != 0)) {
+            LOGWARNMOD(journalvdev, "Invalid stripe unit={} for chunk_size={}, not striping log_dev={}", unit,
+                       m_vdev.info().chunk_size, id);
+        } else {
+            m_stripe_width = width;
+            m_stripe_unit = unit;
+        }
+    }
+}
+
+void JournalVirtualDev::Descriptor::prepare_next_chunk() {
+    if (m_prepared_chunk || m_journal_chunks.empty()) { return; }
+
+    auto const prepare_pct = HS_DYNAMIC_CONFIG(generic.journal_chunk_prepare_pct);
+    if (prepare_pct == 0) { return; }
+
+    auto const seg_size = segment_size();
+    if ((tail_offset() % seg_size) * 100 < seg_size * prepare_pct) { return; }
+
+    // Chunks in the pool have their private data persisted already and are zeroed if needed in its background thread.
+    // If pool is empty, producer is woken up to refill it and it is retried on the next allocation.
+    m_prepared_chunk = m_vdev.m_chunk_pool->try_dequeue();
+    if (m_prepared_chunk) {
+        LOGDEBUGMOD(journalvdev, "Prepared next chunk {} desc {}", m_prepared_chunk->to_string(), to_string());
+    }
+}
+
 void JournalVirtualDev::Descriptor::append_chunk() {
-    // Get a new chunk from the pool.
-    auto new_chunk = m_vdev.m_chunk_pool->dequeue();
-#if 0
-    auto* pdev = new_chunk->physical_dev_mutable();
-    pdev->sync_write_zero(new_chunk->size(), new_chunk->start_offset());
-#endif
+    // Get a new chunk, the one prepared ahead if there is one, else from the pool.
+    auto new_chunk = std::move(m_prepared_chunk);
+    if (!new_chunk) { new_chunk = m_vdev.m_chunk_pool->dequeue(); }
+    auto* new_chunk_private = r_cast< JournalChunkPrivate* >(const_cast< uint8_t* >(new_chunk->user_private()));
+
+    if (m_stripe_width > 1) {
+        // Rest of the segment, pool produces the chunks round robin over the pdevs and so they are on different ones,
+        // as long as there are as many pdevs. First chunk carries them, which is persisted when it is linked in below.
+        auto& rest = m_stripe_chunks[new_chunk->chunk_id()];
+        for (uint32_t i{0}; i < m_stripe_width - 1; ++i) {
+            rest.push_back(m_vdev.m_chunk_pool->dequeue());
+            new_chunk_private->stripe_chunks[i] = rest.back()->chunk_id();
+        }
+        new_chunk_private->stripe_width = m_stripe_width;
+        new_chunk_private->stripe_unit = m_stripe_unit;
+        new_chunk_private->end_of_chunk = segment_size();
+    }
 
     // Increase the right window and total size.
-    m_total_size += new_chunk->size();
-    m_end_offset += new_chunk->size();
+    m_total_size += segment_size();
+    m_end_offset += segment_size();
 
     if (!m_journal_chunks.empty()) {
         // If there are already chunks in the m_journal_chunks list, append this new chunk to the end of the list. Write
@@ -229,23 +345,23 @@ void JournalVirtualDev::Descriptor::append_chunk() {
 
         // Append the new chunk
         m_journal_chunks.push_back(new_chunk);
-        auto chunk_size = m_vdev.info().chunk_size;
-        auto offset_in_chunk = (tail_offset() % chunk_size);
+        auto seg_size = segment_size();
+        auto offset_in_chunk = (tail_offset() % seg_size);
         if (offset_in_chunk != 0) {
             // Update the overhead to total write size
-            m_write_sz_in_total.fetch_add(last_chunk->size() - offset_in_chunk, std::memory_order_relaxed);
+            m_write_sz_in_total.fetch_add(seg_size - offset_in_chunk, std::memory_order_relaxed);
             last_chunk_private->end_of_chunk = offset_in_chunk;
         }
+        if (m_stripe_width > 1) { m_vdev.update_chunk_private(new_chunk, new_chunk_private); }
         m_vdev.update_chunk_private(last_chunk, last_chunk_private);
         LOGINFOMOD(journalvdev, "Added chunk new {} last {} desc {}", new_chunk->to_string(), last_chunk->chunk_id(),
                    to_string());
 
     } else {
         // If the list is empty, update the new chunk as the head. Only head chunk contains the logdev_id.
-        auto* new_chunk_private = r_cast< JournalChunkPrivate* >(const_cast< uint8_t* >(new_chunk->user_private()));
         new_chunk_private->is_head = true;
         new_chunk_private->logdev_id = m_logdev_id;
-        new_chunk_private->end_of_chunk = m_vdev.info().chunk_size;
+        new_chunk_private->end_of_chunk = segment_size();
         // Append the new chunk
         m_journal_chunks.push_back(new_chunk);
         m_vdev.update_chunk_private(new_chunk, new_chunk_private);
@@ -255,8 +371,8 @@ void JournalVirtualDev::Descriptor::append_chunk() {
 
 off_t JournalVirtualDev::Descriptor::alloc_next_append_blk(size_t sz) {
     // We currently assume size requested is less than chunk_size.
-    auto chunk_size = m_vdev.info().chunk_size;
-    RELEASE_ASSERT_LT(sz, chunk_size, "Size requested greater than chunk size");
+    RELEASE_ASSERT_LT(sz, segment_size(), "Size requested greater than chunk size");
+    throttle_append(sz);
 
     if ((tail_offset() + static_cast< off_t >(sz)) >= m_end_offset) {
         // not enough space left, add a new chunk.
@@ -274,6 +390,8 @@ off_t JournalVirtualDev::Descriptor::alloc_next_append_blk(size_t sz) {
 #endif
 
         RELEASE_ASSERT((tail_offset() + static_cast< off_t >(sz)) < m_end_offset, "No space for append blk");
+    } else {
+        prepare_next_chunk();
     }
 
     // if we made a successful reserve, return the tail offset;
@@ -283,9 +401,8 @@ off_t JournalVirtualDev::Descriptor::alloc_next_append_blk(size_t sz) {
 
     // update reserved size;
     m_reserved_sz += sz;
-
-    // TODO enable after resource manager changes.
-    // high_watermark_check();
+    sync_space_credits();
+    high_watermark_check();
 
     // assert that returnning logical offset is in good range
     HS_DBG_ASSERT_LE(tail_off, m_end_offset);
@@ -294,6 +411,20 @@ off_t JournalVirtualDev::Descriptor::alloc_next_append_blk(size_t sz) {
     return tail_off;
 }
 
+bool JournalVirtualDev::Descriptor::rewind_tail(const size_t size, const size_t append_size) {
+    // Zoned drive rejects the rewrite of the bytes behind the write pointer of the zone
+    if ((m_vdev.pmem_tier() != nullptr) || m_vdev.is_zoned() || (m_reserved_sz != 0)) { return false; }
+
+    // Bytes rewritten have to be in the current chunk, and the append from there has to fit in it without a new chunk
+    auto const tail = tail_offset();
+    if ((uint64_cast(tail) % segment_size() < size) || (tail - data_start_offset() < static_cast< off_t >(size)) ||
+        ((tail - static_cast< off_t >(size) + static_cast< off_t >(append_size)) >= m_end_offset)) {
+        return false;
+    }
+    m_write_sz_in_total.fetch_sub(size, std::memory_order_relaxed);
+    return true;
+}
+
 bool JournalVirtualDev::Descriptor::validate_append_size(size_t req_sz) const {
     if (used_size() + req_sz > size()) {
         // not enough space left;
@@ -314,11 +445,11 @@ auto JournalVirtualDev::Descriptor::process_pwrite_offset(size_t len, off_t offs
     auto const [chunk, _, offset_in_chunk] = chunk_details;
 
     LOGTRACEMOD(journalvdev, "writing in chunk: {}, offset: 0x{} len: {} offset_in_chunk: 0x{} chunk_sz: {} desc {}",
-                chunk->chunk_id(), to_hex(offset), len, to_hex(offset_in_chunk), chunk->size(), to_string());
+                chunk->chunk_id(), to_hex(offset), len, to_hex(offset_in_chunk), segment_size(), to_string());
 
     // this assert only valid for pwrite/pwritev, which calls alloc_next_append_blk to get the offset to do the
     // write, which guarantees write will with the returned offset will not accross chunk boundary.
-    HS_REL_ASSERT_GE(chunk->size() - offset_in_chunk, len, "Writing size: {} crossing chunk is not allowed!", len);
+    HS_REL_ASSERT_GE(segment_size() - offset_in_chunk, len, "Writing size: {} crossing chunk is not allowed!", len);
     m_write_sz_in_total.fetch_add(len, std::memory_order_relaxed);
 
     return chunk_details;
@@ -329,9 +460,14 @@ folly::Future< std::error_code > JournalVirtualDev::Descriptor::async_append(con
     if (!validate_append_size(size)) {
         return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::no_space_on_device));
     } else {
-        auto const [chunk, _, offset_in_chunk] = process_pwrite_offset(size, m_seek_cursor);
+        auto const offset = m_seek_cursor;
+        auto const [chunk, _, offset_in_chunk] = process_pwrite_offset(size, offset);
         m_seek_cursor += size;
-        return m_vdev.async_write(r_cast< const char* >(buf), size, chunk, offset_in_chunk);
+        iovec iov{const_cast< uint8_t* >(buf), size};
+        if (stage_pwritev(&iov, 1, size, chunk, offset_in_chunk, offset)) {
+            return folly::makeFuture< std::error_code >(std::error_code{});
+        }
+        return striped_async_write(buf, size, chunk, offset_in_chunk);
     }
 }
 
@@ -352,9 +488,25 @@ folly::Future< std::error_code > JournalVirtualDev::Descriptor::async_pwrite(con
                                                                              off_t offset) {
     HS_REL_ASSERT_LE(size, m_reserved_sz, "Write size: larger then reserved size is not allowed!");
     m_reserved_sz -= size; // update reserved size
-
     auto const [chunk, _, offset_in_chunk] = process_pwrite_offset(size, offset);
-    return m_vdev.async_write(r_cast< const char* >(buf), size, chunk, offset_in_chunk);
+    iovec iov{const_cast< uint8_t* >(buf), size};
+    if (stage_pwritev(&iov, 1, size, chunk, offset_in_chunk, offset)) {
+        return folly::makeFuture< std::error_code >(std::error_code{});
+    }
+    return striped_async_write(buf, size, chunk, offset_in_chunk);
+}
+
+folly::Future< std::error_code > JournalVirtualDev::Descriptor::striped_async_write(const uint8_t* buf, size_t size,
+                                                                                   const shared< Chunk >& chunk,
+                                                                                   uint64_t offset_in_chunk) {
+    if (m_stripe_width == 1) { return m_vdev.async_write(r_cast< const char* >(buf), size, chunk, offset_in_chunk); }
+
+    std::vector< folly::Future< std::error_code > > futs;
+    for (auto const& p : stripe_pieces(chunk, offset_in_chunk, size)) {
+        futs.emplace_back(
+            m_vdev.async_write(r_cast< const char* >(buf) + p.buf_offset, p.size, p.chunk, p.offset_in_chunk));
+    }
+    return collect_stripe_futures(futs);
 }
 
 folly::Future< std::error_code > JournalVirtualDev::Descriptor::async_pwritev(const iovec* iov, int iovcnt,
@@ -367,7 +519,21 @@ folly::Future< std::error_code > JournalVirtualDev::Descriptor::async_pwritev(co
 
     m_reserved_sz -= size;
     auto const [chunk, _, offset_in_chunk] = process_pwrite_offset(size, offset);
-    return m_vdev.async_writev(iov, iovcnt, chunk, offset_in_chunk);
+    if (stage_pwritev(iov, iovcnt, size, chunk, offset_in_chunk, offset)) {
+        return folly::makeFuture< std::error_code >(std::error_code{});
+    }
+    if (m_stripe_width == 1) { return m_vdev.async_writev(iov, iovcnt, chunk, offset_in_chunk); }
+
+    // Iovs of the pieces have to stay valid till their writes complete
+    auto const pieces = stripe_pieces(chunk, offset_in_chunk, size);
+    auto piece_iovs = std::make_shared< std::vector< std::vector< iovec > > >(slice_iovs(iov, iovcnt, pieces));
+    std::vector< folly::Future< std::error_code > > futs;
+    for (size_t i{0}; i < pieces.size(); ++i) {
+        auto const& piovs = (*piece_iovs)[i];
+        futs.emplace_back(
+            m_vdev.async_writev(piovs.data(), int_cast(piovs.size()), pieces[i].chunk, pieces[i].offset_in_chunk));
+    }
+    return collect_stripe_futures(futs).thenValue([piece_iovs](std::error_code err) { return err; });
 }
 
 std::error_code JournalVirtualDev::Descriptor::sync_pwrite(const uint8_t* buf, size_t size, off_t offset) {
@@ -376,7 +542,15 @@ std::error_code JournalVirtualDev::Descriptor::sync_pwrite(const uint8_t* buf, s
     m_reserved_sz -= size; // update reserved size
 
     auto const [chunk, index, offset_in_chunk] = process_pwrite_offset(size, offset);
-    return m_vdev.sync_write(r_cast< const char* >(buf), size, chunk, offset_in_chunk);
+    iovec iov{const_cast< uint8_t* >(buf), size};
+    if (stage_pwritev(&iov, 1, size, chunk, offset_in_chunk, offset)) { return std::error_code{}; }
+    if (m_stripe_width == 1) { return m_vdev.sync_write(r_cast< const char* >(buf), size, chunk, offset_in_chunk); }
+
+    for (auto const& p : stripe_pieces(chunk, offset_in_chunk, size)) {
+        auto err = m_vdev.sync_write(r_cast< const char* >(buf) + p.buf_offset, p.size, p.chunk, p.offset_in_chunk);
+        if (err) { return err; }
+    }
+    return std::error_code{};
 }
 
 std::error_code JournalVirtualDev::Descriptor::sync_pwritev(const iovec* iov, int iovcnt, off_t offset) {
@@ -388,7 +562,70 @@ std::error_code JournalVirtualDev::Descriptor::sync_pwritev(const iovec* iov, in
 
     m_reserved_sz -= size;
     auto const [chunk, _, offset_in_chunk] = process_pwrite_offset(size, offset);
-    return m_vdev.sync_writev(iov, iovcnt, chunk, offset_in_chunk);
+    if (stage_pwritev(iov, iovcnt, size, chunk, offset_in_chunk, offset)) { return std::error_code{}; }
+    if (m_stripe_width == 1) { return m_vdev.sync_writev(iov, iovcnt, chunk, offset_in_chunk); }
+
+    auto const pieces = stripe_pieces(chunk, offset_in_chunk, size);
+    auto const piece_iovs = slice_iovs(iov, iovcnt, pieces);
+    for (size_t i{0}; i < pieces.size(); ++i) {
+        auto err = m_vdev.sync_writev(piece_iovs[i].data(), int_cast(piece_iovs[i].size()), pieces[i].chunk,
+                                      pieces[i].offset_in_chunk);
+        if (err) { return err; }
+    }
+    return std::error_code{};
+}
+
+bool JournalVirtualDev::Descriptor::stage_pwritev(const iovec* iov, int iovcnt, uint64_t size,
+                                                  const shared< Chunk >& chunk, uint64_t offset_in_chunk,
+                                                  off_t offset) {
+    auto* tier = m_vdev.pmem_tier();
+    if (tier == nullptr) { return false; }
+
+    auto const staged = tier->stage(m_logdev_id, chunk->chunk_id(), offset_in_chunk, iov, iovcnt, size);
+    if (!staged) {
+        HS_LOG_EVERY_N(WARN, device, 100, "pmem tier has no room, writing size={} to the chunks directly, tier {}",
+                       size, tier->to_string());
+        return false;
+    }
+    {
+        std::unique_lock lg{m_destage_mtx};
+        m_destaging.emplace(offset, size);
+    }
+
+    // Write is destaged from its copy in the tier, as the buffers of the caller are reused once it is completed
+    auto const* buf = r_cast< const char* >(staged->data);
+    std::vector< folly::Future< std::error_code > > futs;
+    if (m_stripe_width == 1) {
+        futs.emplace_back(m_vdev.async_write(buf, size, chunk, offset_in_chunk));
+    } else {
+        for (auto const& p : stripe_pieces(chunk, offset_in_chunk, size)) {
+            futs.emplace_back(m_vdev.async_write(buf + p.buf_offset, p.size, p.chunk, p.offset_in_chunk));
+        }
+    }
+    collect_stripe_futures(futs).thenValue([this, seq = staged->seq, offset](std::error_code err) {
+        // Write is still in the tier, from which it is destaged again on restart
+        HS_REL_ASSERT(!err, "Destage of journal write at offset={} failed, error={} desc {}", offset, err.message(),
+                      to_string());
+        m_vdev.pmem_tier()->destaged(seq);
+        std::unique_lock lg{m_destage_mtx};
+        m_destaging.erase(offset);
+        m_destage_cv.notify_all();
+    });
+    return true;
+}
+
+void JournalVirtualDev::Descriptor::wait_for_destage(off_t start, off_t end) {
+    if (m_vdev.pmem_tier() == nullptr) { return; }
+
+    std::unique_lock lg{m_destage_mtx};
+    m_destage_cv.wait(lg, [this, start, end] {
+        auto it = m_destaging.lower_bound(start);
+        if (it != m_destaging.begin()) {
+            auto const prev = std::prev(it);
+            if (prev->first + static_cast< off_t >(prev->second) > start) { return false; }
+        }
+        return (it == m_destaging.end()) || (it->first >= end);
+    });
 }
 
 /////////////////////////////// Read Section //////////////////////////////////
@@ -403,15 +640,15 @@ int64_t JournalVirtualDev::Descriptor::sync_next_read(uint8_t* buf, size_t size_
 
     auto [chunk, _, offset_in_chunk] = offset_to_chunk(m_seek_cursor);
     auto const end_of_chunk = m_vdev.get_end_of_chunk(chunk);
-    auto const chunk_size = std::min< uint64_t >(end_of_chunk, chunk->size());
+    auto const chunk_size = std::min< uint64_t >(end_of_chunk, segment_size());
     bool across_chunk{false};
 
     // LOGINFO("sync_next_read size_rd {} chunk {} seek_cursor {} end_of_chunk {} {}", size_rd, chunk->to_string(),
     //         m_seek_cursor, end_of_chunk, chunk_size);
 
-    HS_REL_ASSERT_LE((uint64_t)end_of_chunk, chunk->size(), "Invalid end of chunk: {} detected on chunk num: {}",
+    HS_REL_ASSERT_LE((uint64_t)end_of_chunk, segment_size(), "Invalid end of chunk: {} detected on chunk num: {}",
                      end_of_chunk, chunk->chunk_id());
-    HS_REL_ASSERT_LE((uint64_t)offset_in_chunk, chunk->size(),
+    HS_REL_ASSERT_LE((uint64_t)offset_in_chunk, segment_size(),
                      "Invalid m_seek_cursor: {} which falls in beyond end of chunk: {}!", m_seek_cursor, end_of_chunk);
 
     // if read size is larger then what's left in this chunk
@@ -421,7 +658,7 @@ int64_t JournalVirtualDev::Descriptor::sync_next_read(uint8_t* buf, size_t size_
         across_chunk = true;
         if (size_rd == 0) {
             // If there are no more data in the current chunk, move the seek_cursor to the next chunk.
-            m_seek_cursor += (chunk->size() - end_of_chunk);
+            m_seek_cursor += (segment_size() - end_of_chunk);
         }
     }
 
@@ -431,44 +668,77 @@ int64_t JournalVirtualDev::Descriptor::sync_next_read(uint8_t* buf, size_t size_
     // TODO: Check if we can have tolerate this error and somehow start homestore without replaying or in degraded mode?
     HS_REL_ASSERT(!ec, "Error in reading next stream of bytes, proceeding could cause some inconsistency, exiting");
 
+    advance_read_cursor(chunk, size_rd, end_of_chunk, across_chunk);
+    return size_rd;
+}
+
+int64_t JournalVirtualDev::Descriptor::next_read_extent(size_t size_rd, off_t& offset) {
+    auto const sz = sync_next_read(nullptr, size_rd);
+    if (sz <= 0) { return sz; }
+
+    auto [chunk, _, offset_in_chunk] = offset_to_chunk(m_seek_cursor);
+    auto const end_of_chunk = m_vdev.get_end_of_chunk(chunk);
+    offset = m_seek_cursor;
+    advance_read_cursor(chunk, sz, end_of_chunk, (uint64_cast(sz) >= (end_of_chunk - offset_in_chunk)));
+    return sz;
+}
+
+void JournalVirtualDev::Descriptor::advance_read_cursor(const shared< Chunk >& chunk, uint64_t size_rd,
+                                                        uint64_t end_of_chunk, bool across_chunk) {
     // Update seek cursor after read;
     m_seek_cursor += size_rd;
     if (across_chunk) {
-        m_seek_cursor += (chunk->size() - end_of_chunk);
+        m_seek_cursor += (segment_size() - end_of_chunk);
         LOGTRACEMOD(journalvdev, "Across size_rd {} chunk {} seek_cursor {} end_of_chunk {}", size_rd,
                     chunk->to_string(), m_seek_cursor, end_of_chunk);
     }
-    return size_rd;
 }
 
 std::error_code JournalVirtualDev::Descriptor::sync_pread(uint8_t* buf, size_t size, off_t offset) {
+    wait_for_destage(offset, offset + static_cast< off_t >(size));
     auto [chunk, index, offset_in_chunk] = offset_to_chunk(offset);
 
     // if the read count is acrossing chunk, only return what's left in this chunk
-    if (chunk->size() - offset_in_chunk < size) {
+    if (segment_size() - offset_in_chunk < size) {
         // truncate requsted read length to end of chunk;
-        size = chunk->size() - offset_in_chunk;
+        size = segment_size() - offset_in_chunk;
     }
 
     LOGTRACEMOD(journalvdev, "offset: 0x{} size: {} chunk: {} index: {} offset_in_chunk: 0x{} desc {}", to_hex(offset),
                 size, chunk->chunk_id(), index, to_hex(offset_in_chunk), to_string());
-    return m_vdev.sync_read(r_cast< char* >(buf), size, chunk, offset_in_chunk);
+    if (m_stripe_width == 1) { return m_vdev.sync_read(r_cast< char* >(buf), size, chunk, offset_in_chunk); }
+
+    for (auto const& p : stripe_pieces(chunk, offset_in_chunk, size)) {
+        auto err = m_vdev.sync_read(r_cast< char* >(buf) + p.buf_offset, p.size, p.chunk, p.offset_in_chunk);
+        if (err) { return err; }
+    }
+    return std::error_code{};
 }
 
 std::error_code JournalVirtualDev::Descriptor::sync_preadv(iovec* iov, int iovcnt, off_t offset) {
     uint64_t len = VirtualDev::get_len(iov, iovcnt);
+    wait_for_destage(offset, offset + static_cast< off_t >(len));
     auto [chunk, index, offset_in_chunk] = offset_to_chunk(offset);
 
-    if (chunk->size() - offset_in_chunk < len) {
+    if (segment_size() - offset_in_chunk < len) {
         if (iovcnt > 1) {
             throw std::out_of_range(
                 "iovector more than 1 element is not supported when requested read len is acrossing chunk boundary");
         }
 
         // truncate requsted read length to end of chunk;
-        len = chunk->size() - offset_in_chunk;
+        len = segment_size() - offset_in_chunk;
         iov[0].iov_len = len; // is this needed?
     }
+    if (m_stripe_width > 1) {
+        size_t done{0};
+        for (int i{0}; i < iovcnt; ++i) {
+            auto err = sync_pread(r_cast< uint8_t* >(iov[i].iov_base), iov[i].iov_len, offset + done);
+            if (err) { return err; }
+            done += iov[i].iov_len;
+        }
+        return std::error_code{};
+    }
 
     LOGTRACEMOD(journalvdev, "offset: 0x{} iov: {} len: {} chunk: {} index: {} offset_in_chunk: 0x{} desc {}",
                 to_hex(offset), iovcnt, len, chunk->chunk_id(), index, to_hex(offset_in_chunk), to_string());
@@ -504,7 +774,7 @@ off_t JournalVirtualDev::Descriptor::dev_offset(off_t nbytes) const {
     }
 
     off_t vdev_offset = data_start_offset();
-    auto chunk_size = m_vdev.info().chunk_size;
+    auto chunk_size = segment_size();
     uint64_t remaining = nbytes;
     auto start_offset = data_start_offset() % chunk_size;
 
@@ -527,18 +797,39 @@ off_t JournalVirtualDev::Descriptor::dev_offset(off_t nbytes) const {
     return vdev_offset;
 }
 
+off_t JournalVirtualDev::Descriptor::data_bytes_upto(off_t vdev_offset) const {
+    off_t chunk_vdev_offset = data_start_offset();
+    if (vdev_offset <= chunk_vdev_offset || m_journal_chunks.empty()) { return 0; }
+
+    auto chunk_size = segment_size();
+    off_t nbytes{0};
+    auto start_offset = data_start_offset() % chunk_size;
+    for (auto chunk : m_journal_chunks) {
+        if (vdev_offset < chunk_vdev_offset + off_t(chunk_size - start_offset)) {
+            nbytes += (vdev_offset - chunk_vdev_offset);
+            break;
+        }
+
+        uint64_t end_of_chunk = std::min< uint64_t >(m_vdev.get_end_of_chunk(chunk), chunk_size);
+        nbytes += (end_of_chunk - start_offset);
+        chunk_vdev_offset += (chunk_size - start_offset);
+        start_offset = 0;
+    }
+    return nbytes;
+}
+
 void JournalVirtualDev::Descriptor::update_data_start_offset(off_t offset) {
     // Refactor this code to truncate.
     if (!m_journal_chunks.empty()) {
         m_data_start_offset = offset;
-        auto data_start_offset_aligned = sisl::round_down(m_data_start_offset, m_vdev.info().chunk_size);
-        m_end_offset = data_start_offset_aligned + m_journal_chunks.size() * m_vdev.info().chunk_size;
+        auto data_start_offset_aligned = sisl::round_down(m_data_start_offset, segment_size());
+        m_end_offset = data_start_offset_aligned + m_journal_chunks.size() * segment_size();
         LOGINFOMOD(journalvdev, "Updated data start offset off 0x{} {}", to_hex(offset), to_string());
         RELEASE_ASSERT_EQ(m_end_offset - data_start_offset_aligned, m_total_size, "offset size mismatch {}",
                           to_string());
     } else {
         // If there are no chunks, we round up to the next chunk size.
-        m_data_start_offset = sisl::round_up(offset, m_vdev.info().chunk_size);
+        m_data_start_offset = sisl::round_up(offset, segment_size());
         m_end_offset = m_data_start_offset;
         LOGINFOMOD(journalvdev, "No chunks, updated data start offset off 0x{} {}", to_hex(offset), to_string());
     }
@@ -562,6 +853,7 @@ void JournalVirtualDev::Descriptor::update_tail_offset(off_t tail) {
         RELEASE_ASSERT(false, "Invalid tail offset");
     }
     lseek(tail);
+    sync_space_credits();
 
     LOGINFOMOD(journalvdev, "Updated tail offset arg 0x{} desc {} ", to_hex(tail), to_string());
 }
@@ -580,6 +872,9 @@ off_t JournalVirtualDev::Descriptor::truncate(off_t truncate_offset) {
         RELEASE_ASSERT(false, "Loop-back not supported");
     }
 
+    // Chunks released by the truncation could be reused right away, so no write to them can still be in flight
+    wait_for_destage(ds_off, sisl::round_up(truncate_offset, segment_size()));
+
     // Find the chunk which has the truncation offset. This will be the new
     // head chunk in the list. We first update the is_head to true for that new head chunk.
     // So if a crash happens after this, we could have two chunks which has is_head
@@ -598,7 +893,7 @@ off_t JournalVirtualDev::Descriptor::truncate(off_t truncate_offset) {
             // Go to the next chunk to make it the new head chunk.
             new_head_chunk = m_journal_chunks[index];
             update_truncate_offset = true;
-            size_to_truncate += (new_head_chunk->size() - end_new_head_chunk);
+            size_to_truncate += (segment_size() - end_new_head_chunk);
         }
     }
 
@@ -614,7 +909,7 @@ off_t JournalVirtualDev::Descriptor::truncate(off_t truncate_offset) {
     index = 0;
     off_t tail_off =
         static_cast< off_t >(data_start_offset() + m_write_sz_in_total.load(std::memory_order_relaxed)) + m_reserved_sz;
-    auto chunk_size = m_vdev.info().chunk_size;
+    auto chunk_size = segment_size();
     HS_PERIODIC_LOG(DEBUG, journalvdev, "Truncate begin truncate {} desc {}", to_hex(truncate_offset), to_string());
 
 #ifdef _PRERELEASE
@@ -647,7 +942,7 @@ off_t JournalVirtualDev::Descriptor::truncate(off_t truncate_offset) {
         // Check if the offset is inside the truncate offset. We also check if the truncate offset lies
         // between end_of_chunk - chunk_size. If either condition satifies, we release the chunks.
         if (cover_offset <= truncate_offset || ((cover_offset - chunk_hole) <= truncate_offset)) {
-            m_total_size -= chunk->size();
+            m_total_size -= segment_size();
             it = m_journal_chunks.erase(it);
 
             // Release the chunk back to pool.
@@ -656,6 +951,12 @@ off_t JournalVirtualDev::Descriptor::truncate(off_t truncate_offset) {
                        chunk->chunk_id(), m_logdev_id, to_hex(cover_offset), to_hex(truncate_offset), to_hex(tail_off),
                        m_vdev.get_end_of_chunk(chunk), to_string());
             m_vdev.release_chunk_to_pool(chunk);
+            if (auto const rest_it = m_stripe_chunks.find(chunk->chunk_id()); rest_it != m_stripe_chunks.end()) {
+                for (auto& sc : rest_it->second) {
+                    m_vdev.release_chunk_to_pool(sc);
+                }
+                m_stripe_chunks.erase(rest_it);
+            }
         } else {
             ++it;
         }
@@ -663,7 +964,7 @@ off_t JournalVirtualDev::Descriptor::truncate(off_t truncate_offset) {
 
     if (update_truncate_offset) {
         // Update the truncate offset to align with the chunk size.
-        truncate_offset = sisl::round_up(truncate_offset, m_vdev.info().chunk_size);
+        truncate_offset = sisl::round_up(truncate_offset, segment_size());
     }
 
     HS_REL_ASSERT_LE(truncate_offset, m_end_offset, "truncate offset less than end offset");
@@ -672,6 +973,7 @@ off_t JournalVirtualDev::Descriptor::truncate(off_t truncate_offset) {
     // update in-memory total write size counter;
     m_write_sz_in_total.fetch_sub(size_to_truncate, std::memory_order_relaxed);
     m_truncate_done = true;
+    sync_space_credits();
 
 #ifdef _PRERELEASE
     for (auto it = m_journal_chunks.begin(); it != m_journal_chunks.end(); ++it) {
@@ -724,12 +1026,12 @@ uint64_t JournalVirtualDev::Descriptor::logical_to_dev_offset(off_t log_offset,
 
 std::tuple< shared< Chunk >, uint32_t, off_t > JournalVirtualDev::Descriptor::offset_to_chunk(off_t log_offset,
                                                                                               bool check) const {
-    uint64_t chunk_aligned_offset = sisl::round_down(m_data_start_offset, m_vdev.info().chunk_size);
+    uint64_t chunk_aligned_offset = sisl::round_down(m_data_start_offset, segment_size());
     uint64_t off_l{static_cast< uint64_t >(log_offset) - chunk_aligned_offset};
     uint32_t index = 0;
     for (auto& chunk : m_journal_chunks) {
-        if (off_l >= chunk->size()) {
-            off_l -= chunk->size();
+        if (off_l >= segment_size()) {
+            off_l -= segment_size();
             index++;
         } else {
             return {chunk, index, off_l};
@@ -759,8 +1061,10 @@ void JournalVirtualDev::Descriptor::high_watermark_check() {
     }
 #endif
 
-    // high watermark check for the entire journal vdev;
-    if (resource_mgr().check_journal_vdev_size(m_vdev.used_size(), m_vdev.size())) {
+    // high watermark check for the entire journal vdev, against the space reserved out of its capacity;
+    auto const capacity = resource_mgr().get_journal_vdev_capacity();
+    if (capacity == 0) { return; }
+    if (resource_mgr().check_journal_vdev_size(resource_mgr().cur_journal_space_reserved(), capacity)) {
         COUNTER_INCREMENT(m_vdev.m_metrics, vdev_high_watermark_count, 1);
 
         if (m_vdev.m_event_cb && m_truncate_done) {
@@ -772,9 +1076,102 @@ void JournalVirtualDev::Descriptor::high_watermark_check() {
     }
 }
 
+void JournalVirtualDev::Descriptor::throttle_append(size_t size) {
+    // Between the watermarks a single delay growing with the fill slows the appender down. At the critical one it
+    // waits for truncation to return space, but no longer than the max wait, as the flush it holds up might be what
+    // the truncation is waiting for.
+    auto const max_wait_us = uint64_cast(HS_DYNAMIC_CONFIG(resource_limits.journal_throttle_max_wait_ms)) * 1000;
+    uint64_t waited_us{0};
+    bool critical{false};
+    for (auto delay_us = resource_mgr().get_journal_append_delay_us(size, critical); delay_us != 0;
+         delay_us = resource_mgr().get_journal_append_delay_us(size, critical)) {
+        if (critical && (waited_us >= max_wait_us)) {
+            HS_LOG_EVERY_N(WARN, device, 50, "Journal space critical, appending size={} after waiting {}us desc {}",
+                           size, waited_us, to_string());
+            break;
+        }
+        boost::this_fiber::sleep_for(std::chrono::microseconds{delay_us});
+        waited_us += delay_us;
+        if (!critical) { break; }
+    }
+}
+
+void JournalVirtualDev::Descriptor::sync_space_credits() {
+    auto const used = used_size();
+    if (used > m_space_credits) {
+        resource_mgr().reserve_journal_space(used - m_space_credits);
+    } else if (used < m_space_credits) {
+        resource_mgr().release_journal_space(m_space_credits - used);
+    }
+    m_space_credits = used;
+}
+
 bool JournalVirtualDev::Descriptor::is_alloc_accross_chunk(size_t size) const {
     auto [chunk, _, offset_in_chunk] = offset_to_chunk(tail_offset());
-    return (offset_in_chunk + size > chunk->size());
+    return (offset_in_chunk + size > segment_size());
+}
+
+std::vector< shared< Chunk > > JournalVirtualDev::Descriptor::segment_chunks(const shared< Chunk >& chunk) const {
+    std::vector< shared< Chunk > > chunks{chunk};
+    if (auto const it = m_stripe_chunks.find(chunk->chunk_id()); it != m_stripe_chunks.end()) {
+        chunks.insert(chunks.end(), it->second.begin(), it->second.end());
+    }
+    return chunks;
+}
+
+std::vector< JournalVirtualDev::Descriptor::stripe_piece >
+JournalVirtualDev::Descriptor::stripe_pieces(const shared< Chunk >& chunk, uint64_t offset_in_segment,
+                                             uint64_t size) const {
+    // Stripe units are laid out round robin over the chunks of the segment, unit u is at (u / width) unit of the
+    // chunk (u % width).
+    auto const chunks = segment_chunks(chunk);
+    HS_REL_ASSERT_EQ(chunks.size(), m_stripe_width, "Incomplete segment of chunk={} {}", chunk->chunk_id(),
+                     to_string());
+
+    std::vector< stripe_piece > pieces;
+    uint64_t done{0};
+    while (done < size) {
+        auto const off = offset_in_segment + done;
+        auto const unit = off / m_stripe_unit;
+        auto const off_in_unit = off % m_stripe_unit;
+        auto const piece_size = std::min< uint64_t >(size - done, m_stripe_unit - off_in_unit);
+        pieces.push_back(stripe_piece{chunks[unit % m_stripe_width],
+                                      (unit / m_stripe_width) * m_stripe_unit + off_in_unit, piece_size, done});
+        done += piece_size;
+    }
+    return pieces;
+}
+
+std::vector< std::vector< iovec > >
+JournalVirtualDev::Descriptor::slice_iovs(const iovec* iov, int iovcnt, const std::vector< stripe_piece >& pieces) {
+    std::vector< std::vector< iovec > > piece_iovs(pieces.size());
+    int cur{0};
+    uint64_t cur_off{0}; // Consumed bytes of the current iov
+    for (size_t p{0}; p < pieces.size(); ++p) {
+        auto remaining = pieces[p].size;
+        while (remaining > 0) {
+            HS_DBG_ASSERT_LT(cur, iovcnt, "Iovs are smaller than the pieces");
+            auto const len = std::min< uint64_t >(remaining, iov[cur].iov_len - cur_off);
+            piece_iovs[p].push_back(iovec{r_cast< uint8_t* >(iov[cur].iov_base) + cur_off, len});
+            remaining -= len;
+            cur_off += len;
+            if (cur_off == iov[cur].iov_len) {
+                ++cur;
+                cur_off = 0;
+            }
+        }
+    }
+    return piece_iovs;
+}
+
+folly::Future< std::error_code >
+JournalVirtualDev::Descriptor::collect_stripe_futures(std::vector< folly::Future< std::error_code > >& futs) {
+    return folly::collectAllUnsafe(futs).thenValue([](auto&& vf) {
+        for (auto const& err_c : vf) {
+            if (sisl_unlikely(err_c.value())) { return err_c.value(); }
+        }
+        return std::error_code{};
+    });
 }
 
 nlohmann::json JournalVirtualDev::Descriptor::get_status(int log_level) const {
@@ -788,6 +1185,9 @@ nlohmann::json JournalVirtualDev::Descriptor::get_status(int log_level) const {
     j["reserved_size"] = m_reserved_sz;
     j["num_chunks"] = m_journal_chunks.size();
     j["total_size"] = m_total_size;
+    j["prepared_chunk"] = m_prepared_chunk ? m_prepared_chunk->chunk_id() : 0;
+    j["stripe_width"] = m_stripe_width;
+    j["stripe_unit"] = m_stripe_unit;
     if (log_level >= 3) {
         nlohmann::json chunk_js = nlohmann::json::array();
         for (const auto& chunk : m_journal_chunks) {
@@ -798,6 +1198,13 @@ nlohmann::json JournalVirtualDev::Descriptor::get_status(int log_level) const {
             c["is_head"] = private_data->is_head;
             c["end_of_chunk"] = private_data->end_of_chunk;
             c["next_chunk"] = private_data->next_chunk;
+            if (m_stripe_width > 1) {
+                nlohmann::json stripe_js = nlohmann::json::array();
+                for (auto const& sc : segment_chunks(chunk)) {
+                    stripe_js.push_back(sc->chunk_id());
+                }
+                c["stripe_chunks"] = std::move(stripe_js);
+            }
             chunk_js.push_back(move(c));
         }
         j["chunks"] = std::move(chunk_js);
@@ -833,10 +1240,90 @@ nlohmann::json JournalVirtualDev::get_status(int log_level) const {
     std::lock_guard lock{m_mutex};
     nlohmann::json j;
     j["num_descriptors"] = std::to_string(m_journal_descriptors.size());
+    if (m_pmem_tier) { j["pmem_tier"] = m_pmem_tier->to_string(); }
     for (const auto& [logdev_id, descriptor] : m_journal_descriptors) {
         j["journalvdev_logdev_id_" + std::to_string(logdev_id)] = descriptor->get_status(log_level);
     }
     return j;
 }
 
+/////////////////////////////// JournalReadAhead Section //////////////////////////////////////
+JournalReadAhead::JournalReadAhead(shared< JournalVirtualDev::Descriptor > vdev_jd, uint64_t read_size,
+                                   uint32_t align_size) :
+        m_vdev_jd{std::move(vdev_jd)},
+        m_read_size{sisl::round_up(read_size, align_size)},
+        m_align_size{align_size} {}
+
+JournalReadAhead::~JournalReadAhead() {
+    // Read in flight refers to this object, wait for it before going away
+    std::unique_lock lg{m_mtx};
+    m_cv.wait(lg, [this] { return m_pending_done; });
+}
+
+void JournalReadAhead::issue_read() {
+    off_t offset{0};
+    auto const sz = m_vdev_jd->next_read_extent(m_read_size, offset);
+
+    std::unique_lock lg{m_mtx};
+    m_pending_size = sz;
+    if (sz <= 0) {
+        m_pending_buf = nullptr;
+        return;
+    }
+
+    // Data is read after the headroom, which is of the read size and so keeps the data aligned
+    m_pending_buf = hs_utils::make_byte_array(2 * m_read_size, true, sisl::buftag::logread, m_align_size);
+    m_pending_done = false;
+    iomanager.run_on_forget(iomgr::reactor_regex::random_worker, iomgr::fiber_regex::syncio_only,
+                            [this, buf = m_pending_buf, sz, offset]() {
+                                auto ec = m_vdev_jd->sync_pread(buf->bytes() + m_read_size, sz, offset);
+                                HS_REL_ASSERT(!ec, "Error in reading next stream of bytes, proceeding could cause "
+                                                   "some inconsistency, exiting");
+                                LOGTRACEMOD(journalvdev, "Read ahead {} bytes at offset {} log_dev={}", sz, offset,
+                                            m_vdev_jd->logdev_id());
+                                std::unique_lock lg{m_mtx};
+                                m_pending_done = true;
+                                m_cv.notify_all();
+                            });
+}
+
+sisl::byte_view JournalReadAhead::next(const sisl::byte_view& tail, bool& end_of_stream) {
+    if (!m_started) {
+        m_started = true;
+        issue_read();
+    }
+
+    sisl::byte_array buf;
+    int64_t sz;
+    {
+        std::unique_lock lg{m_mtx};
+        m_cv.wait(lg, [this] { return m_pending_done; });
+        buf = std::move(m_pending_buf);
+        sz = m_pending_size;
+    }
+
+    if (sz == -1) {
+        end_of_stream = true;
+        return tail;
+    }
+
+    // Issue the next read before handing out this one, so that it is read while this one is consumed
+    issue_read();
+    if (sz == 0) { return tail; }
+
+    auto const data_size = uint32_cast(sz);
+    if (tail.size() == 0) { return sisl::byte_view{buf, uint32_cast(m_read_size), data_size}; }
+    if (tail.size() <= m_read_size) {
+        auto const start = uint32_cast(m_read_size - tail.size());
+        std::memcpy(buf->bytes() + start, tail.bytes(), tail.size());
+        return sisl::byte_view{buf, start, tail.size() + data_size};
+    }
+
+    // Tail doesn't fit in the headroom, which happens only while accumulating a group bigger than the read size
+    auto out_buf = hs_utils::make_byte_array(tail.size() + data_size, true, sisl::buftag::logread, m_align_size);
+    std::memcpy(out_buf->bytes(), tail.bytes(), tail.size());
+    std::memcpy(out_buf->bytes() + tail.size(), buf->bytes() + m_read_size, data_size);
+    return sisl::byte_view{out_buf};
+}
+
 } // namespace homestore
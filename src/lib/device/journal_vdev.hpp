@@ -18,12 +18,18 @@
 #include <array>
 #include <atomic>
 #include <functional>
+#include <limits>
+#include <map>
 #include <memory>
 #include <vector>
 #include <condition_variable>
 
+#include <boost/fiber/condition_variable.hpp>
+#include <boost/fiber/mutex.hpp>
+
 #include "device.h"
 #include "physical_dev.hpp"
+#include "pmem_journal_tier.hpp"
 #include "virtual_dev.hpp"
 #include <homestore/logstore/log_store_internal.hpp>
 
@@ -31,15 +37,24 @@ namespace homestore {
 typedef std::function< void(const off_t ret_off) > alloc_next_blk_cb_t;
 using journal_id_t = uint64_t;
 
+static constexpr uint32_t max_journal_stripe_width = 8;
+
 // Chunks used for journal vdev has journal related info stored in chunk private data.
 // Each log device has a list of journal chunk data with next_chunk.
 // Journal vdev will arrange the chunks in order during recovery.
+// A striped journal has a list of segments instead, each of stripe_width chunks on different pdevs. Only the first
+// chunk of a segment is linked in the list, it carries the rest of the chunks of the segment in stripe_chunks and the
+// end of the segment in end_of_chunk.
 struct JournalChunkPrivate {
     logdev_id_t logdev_id{0};
     bool is_head{false};       // Is it the head element.
     uint64_t created_at{0};    // Creation timestamp
     uint64_t end_of_chunk{0};  // The offset indicates end of chunk.
     chunk_num_t next_chunk{0}; // Next chunk in the list.
+    // Below are past the padding of the fields above, which is not guaranteed to be zero in the chunks written before.
+    alignas(8) uint16_t stripe_width{0}; // Number of chunks in the segment of this chunk, 0 or 1 if not striped.
+    uint32_t stripe_unit{0};             // Size written to a chunk of the segment before moving to the next one.
+    chunk_num_t stripe_chunks[max_journal_stripe_width]{}; // Rest of the chunks of the segment, in stripe order.
 };
 
 static_assert(sizeof(JournalChunkPrivate) <= chunk_info::user_private_size, "Journal private area bigger");
@@ -69,15 +84,33 @@ public:
         uint64_t m_total_size{0};                        // Total size of all chunks.
         off_t m_end_offset{0};        // Offset right to window. Never reduced. Increased in multiple of chunk size.
         bool m_end_offset_set{false}; // Adjust the m_end_offset only once during init.
+        shared< Chunk > m_prepared_chunk; // Next chunk taken from the pool ahead of the append crossing the last one.
+        uint64_t m_space_credits{0};      // Journal space credits held in the resource manager, the used size.
+
+        // Striping of the journal, in which each entry of m_journal_chunks is the first chunk of a segment of
+        // m_stripe_width chunks, with the logical offsets of a segment laid out over them in m_stripe_unit pieces.
+        uint32_t m_stripe_width{1};
+        uint32_t m_stripe_unit{0};
+        std::unordered_map< chunk_num_t, std::vector< shared< Chunk > > > m_stripe_chunks; // Rest of the segment
+
+        // Writes staged in the pmem tier of the vdev and being destaged to the chunks, by their logical offset
+        boost::fibers::mutex m_destage_mtx;
+        boost::fibers::condition_variable m_destage_cv;
+        std::map< off_t, uint64_t > m_destaging;
         friend class JournalVirtualDev;
 
     public:
         // Descriptor is created via JournalVirtualDev::open similar to file descriptor.
-        Descriptor(JournalVirtualDev& vdev, logdev_id_t id) : m_vdev(vdev), m_logdev_id(id) {}
+        // Striping of a new descriptor is taken from config, a recovered one has it in its head chunk.
+        Descriptor(JournalVirtualDev& vdev, logdev_id_t id);
 
         // Create and append the chunk to m_journal_chunks.
         void append_chunk();
 
+        // Take the next chunk from the pool ahead of time, once the last chunk is filled upto
+        // journal_chunk_prepare_pct, so that append_chunk only needs to link it in.
+        void prepare_next_chunk();
+
         /**
          * @brief : allocate space specified by input size.
          * this API will always be called in single thread;
@@ -94,6 +127,18 @@ public:
          */
         off_t alloc_next_append_blk(const size_t size);
 
+        /**
+         * @brief : Moves the tail back by size bytes, which are the end of the last write, so that the next
+         * alloc_next_append_blk returns the offset of them and the next write rewrites them. Caller ensures no write is
+         * in flight. Writes staged in the pmem tier are destaged in the background, so they are not rewritten.
+         *
+         * @param size : size of the end of the last write, which is rewritten
+         * @param append_size : size of the next append, which has to fit in the current chunk from there
+         *
+         * @return : true if the tail is moved back
+         */
+        bool rewind_tail(const size_t size, const size_t append_size);
+
         /**
          * @brief : writes up to count bytes from the buffer starting at buf. append advances seek cursor;
          *
@@ -171,6 +216,19 @@ public:
          */
         int64_t sync_next_read(uint8_t* buf, size_t count_in);
 
+        /**
+         * @brief : same as sync_next_read, except that it does not read the bytes, but returns the offset to read
+         * them from and advances the cursor past them. Caller is expected to read them with sync_pread, which lets
+         * the reads of a stream be issued ahead of their consumption.
+         *
+         * @param count : the size to read;
+         * @param offset : the offset to read from, set only if the return value is positive;
+         *
+         * @return : number of bytes to be read at offset, which can be smaller than count at the end of a chunk.
+         * Returns -1 if there are no bytes available to read.
+         */
+        int64_t next_read_extent(size_t count_in, off_t& offset);
+
         /**
          * @brief : reads up to count bytes at offset into the buffer starting at buf.
          * The curosr is not updated.
@@ -197,6 +255,12 @@ public:
          */
         std::error_code sync_preadv(iovec* iov, int iovcnt, off_t offset);
 
+        /**
+         * @brief : waits for the writes staged in the pmem tier of the vdev, which overlap the range of logical
+         * offsets, to be destaged to the chunks. Returns right away if the vdev has no pmem tier.
+         */
+        void wait_for_destage(off_t start = 0, off_t end = std::numeric_limits< off_t >::max());
+
         /**
          * @brief : repositions the cusor of the device to the argument offset
          * according to the directive whence as follows:
@@ -228,6 +292,11 @@ public:
          */
         off_t dev_offset(off_t nbytes) const;
 
+        /**
+         * @brief :- inverse of dev_offset, it returns the number of bytes from start offset upto the vdev offset
+         */
+        off_t data_bytes_upto(off_t vdev_offset) const;
+
         /**
          * @brief : get the start logical offset where data starts;
          *
@@ -348,6 +417,11 @@ public:
          */
         auto process_pwrite_offset(size_t len, off_t offset);
 
+        // Stages the write in the pmem tier of the vdev, if it has one with room for it, and destages it to the chunks
+        // in the background. Returns false if the write is to be done on the chunks.
+        bool stage_pwritev(const iovec* iov, int iovcnt, uint64_t size, const shared< Chunk >& chunk,
+                           uint64_t offset_in_chunk, off_t offset);
+
         /**
          * @brief : convert logical offset in chunk to the physical device offset
          *
@@ -388,8 +462,47 @@ public:
 
         bool validate_append_size(size_t count) const;
 
+        // Logical size of a segment, which is a chunk if the journal is not striped
+        uint64_t segment_size() const { return m_vdev.info().chunk_size * m_stripe_width; }
+
+        // All the chunks of the segment starting with the given chunk, in stripe order
+        std::vector< shared< Chunk > > segment_chunks(const shared< Chunk >& chunk) const;
+
+        struct stripe_piece {
+            shared< Chunk > chunk;
+            uint64_t offset_in_chunk;
+            uint64_t size;
+            uint64_t buf_offset; // Offset of the piece in the io
+        };
+
+        // Pieces of an io of the given size at the offset in the segment, one per stripe unit it covers
+        std::vector< stripe_piece > stripe_pieces(const shared< Chunk >& chunk, uint64_t offset_in_segment,
+                                                  uint64_t size) const;
+
+        // Slices the iovs into the ones of each piece
+        static std::vector< std::vector< iovec > > slice_iovs(const iovec* iov, int iovcnt,
+                                                              const std::vector< stripe_piece >& pieces);
+
+        // Writes the buffer to the pieces of the stripes it covers, or to the chunk as is if not striped
+        folly::Future< std::error_code > striped_async_write(const uint8_t* buf, size_t size,
+                                                             const shared< Chunk >& chunk, uint64_t offset_in_chunk);
+
+        // Completes with the first error of the writes of the pieces, if any
+        static folly::Future< std::error_code >
+        collect_stripe_futures(std::vector< folly::Future< std::error_code > >& futs);
+
+        // Moves the read cursor past size_rd bytes read, and to the next chunk if they reached its end_of_chunk
+        void advance_read_cursor(const shared< Chunk >& chunk, uint64_t size_rd, uint64_t end_of_chunk,
+                                 bool across_chunk);
+
         void high_watermark_check();
 
+        // Delays the append of the given size as the journal space reserved approaches its critical watermark
+        void throttle_append(size_t size);
+
+        // Reserves or returns the journal space credits for the change of the used size since the last sync
+        void sync_space_credits();
+
         bool is_alloc_accross_chunk(size_t size) const;
 
         auto get_dev_details(size_t len, off_t offset);
@@ -429,6 +542,12 @@ public:
     void release_chunk_to_pool(shared< Chunk > chunk);
     void update_chunk_private(shared< Chunk >& chunk, JournalChunkPrivate* chunk_private);
     uint64_t get_end_of_chunk(shared< Chunk >& chunk) const;
+    PmemJournalTier* pmem_tier() const { return m_pmem_tier.get(); }
+    bool is_zoned() const { return m_zoned; }
+
+private:
+    // Writes which were staged in the pmem tier and not destaged before the restart are written to the chunks
+    void recover_pmem_tier(const std::unordered_map< chunk_num_t, shared< Chunk > >& chunk_map);
 
 private:
     // Mapping of logdev id to its journal descriptors.
@@ -439,6 +558,54 @@ private:
     // last chunk in the list to update its end_of_chunk and next_chunk.
     std::unique_ptr< ChunkPool > m_chunk_pool;
     std::shared_ptr< JournalChunkPrivate > m_init_private_data;
+
+    // Persistent memory journal writes are staged in, ahead of the chunks, if configured
+    std::unique_ptr< PmemJournalTier > m_pmem_tier;
+
+    // Chunks are on zoned drives, which take the writes of a zone only at its write pointer
+    bool m_zoned{false};
+};
+
+/**
+ * JournalReadAhead: Reads the journal of a descriptor sequentially from its cursor, keeping the next read in flight on
+ * a worker fiber while the data of the previous one is consumed, so that replaying a journal overlaps the device reads
+ * with the processing of the groups. Reads are of a fixed size and into buffers aligned to the device, which are handed
+ * out as is. Each buffer has a headroom in front of the data, to prepend the unconsumed tail of the previous buffer
+ * without copying the data read.
+ */
+class JournalReadAhead {
+public:
+    JournalReadAhead(shared< JournalVirtualDev::Descriptor > vdev_jd, uint64_t read_size, uint32_t align_size);
+    JournalReadAhead(const JournalReadAhead&) = delete;
+    JournalReadAhead& operator=(const JournalReadAhead&) = delete;
+    ~JournalReadAhead();
+
+    /**
+     * @brief Returns the bytes of the next read, prepended with the tail of the previous buffer. Waits for the read
+     * if it is still in flight and issues the one after it.
+     *
+     * @param tail : unconsumed bytes of the buffer returned previously
+     * @param end_of_stream : set if there are no more bytes to read, in which case the tail is returned as is
+     */
+    sisl::byte_view next(const sisl::byte_view& tail, bool& end_of_stream);
+
+    uint64_t read_size() const { return m_read_size; }
+
+private:
+    void issue_read();
+
+private:
+    shared< JournalVirtualDev::Descriptor > m_vdev_jd;
+    uint64_t m_read_size;
+    uint32_t m_align_size;
+
+    // The read in flight, or done and yet to be consumed
+    boost::fibers::mutex m_mtx;
+    boost::fibers::condition_variable m_cv;
+    sisl::byte_array m_pending_buf;
+    int64_t m_pending_size{0};
+    bool m_pending_done{true};
+    bool m_started{false};
 };
 
 } // namespace homestore
@@ -0,0 +1,71 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <random>
+
+#include "blkalloc/blk_allocator.h"
+#include "common/homestore_config.hpp"
+#include "load_aware_chunk_selector.h"
+
+namespace homestore {
+static const shared< Chunk > s_no_chunk{nullptr};
+
+LoadAwareChunkSelector::LoadAwareChunkSelector(bool dynamic_chunk_add) : m_dynamic_chunk_add{dynamic_chunk_add} {}
+
+void LoadAwareChunkSelector::add_chunk(cshared< Chunk >& chunk) { m_chunks.push_back(chunk); }
+
+double LoadAwareChunkSelector::score(Chunk const& chunk, double halving_ios) {
+    auto const ba = chunk.blk_allocator();
+    auto const free_ratio = static_cast< double >(ba->available_blks()) / std::max(ba->get_total_blks(), 1u);
+    auto const* pdev = chunk.physical_dev();
+    auto const ios = static_cast< double >(std::max(pdev->outstanding_ios(), int64_t{0}));
+    auto const health = static_cast< double >(pdev->health_score()) / DeviceHealth::max_score;
+    return health * free_ratio / (1.0 + (ios / halving_ios));
+}
+
+cshared< Chunk > LoadAwareChunkSelector::select_chunk(blk_count_t nblks, const blk_alloc_hints&) {
+    auto const n = m_chunks.size();
+    if (n == 0) { return s_no_chunk; }
+    if (n == 1) { return m_chunks[0]; }
+
+    auto const halving_ios =
+        static_cast< double >(std::max(HS_DYNAMIC_CONFIG(device->load_aware_selector_halving_ios), 1u));
+    static thread_local std::default_random_engine s_re{std::random_device{}()};
+    auto const a = std::uniform_int_distribution< uint32_t >{0, n - 1}(s_re);
+    auto const b = (a + std::uniform_int_distribution< uint32_t >{1, n - 1}(s_re)) % n;
+
+    auto const& picked = (score(*m_chunks[a], halving_ios) >= score(*m_chunks[b], halving_ios)) ? m_chunks[a]
+                                                                                                 : m_chunks[b];
+    if (picked->blk_allocator()->available_blks() >= nblks) { return picked; }
+
+    // Both choices are close to full, fall back to scoring all chunks which can take the request
+    shared< Chunk > const* best{&picked};
+    double best_score{-1.0};
+    for (uint32_t i{0}; i < n; ++i) {
+        auto const& chunk = m_chunks[i];
+        if (chunk->blk_allocator()->available_blks() < nblks) { continue; }
+        auto const s = score(*chunk, halving_ios);
+        if (s > best_score) {
+            best = &chunk;
+            best_score = s;
+        }
+    }
+    return *best;
+}
+
+void LoadAwareChunkSelector::foreach_chunks(std::function< void(cshared< Chunk >&) >&& cb) {
+    m_chunks.for_each(cb);
+}
+} // namespace homestore
@@ -0,0 +1,52 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <homestore/chunk_selector.h>
+
+#include <vector>
+#include <sisl/logging/logging.h>
+
+#include <homestore/vchunk.h>
+#include "device/chunk.h"
+#include "device/chunk_list.h"
+
+namespace homestore {
+// Picks the better of two random chunks (power of two choices), scored by their fraction of free blks and slowed down
+// by the outstanding ios on their physical device, so that a busy drive doesn't keep getting new writes. Selection is
+// O(1) and lock free, which spreads the load almost as well as scoring every chunk would. Score is scaled down by the
+// health score of the physical device as well, so that a device with slow or failing ios is steered around.
+class LoadAwareChunkSelector : public ChunkSelector {
+public:
+    LoadAwareChunkSelector(bool dynamic_chunk_add = false);
+    LoadAwareChunkSelector(const LoadAwareChunkSelector&) = delete;
+    LoadAwareChunkSelector(LoadAwareChunkSelector&&) noexcept = delete;
+    LoadAwareChunkSelector& operator=(const LoadAwareChunkSelector&) = delete;
+    LoadAwareChunkSelector& operator=(LoadAwareChunkSelector&&) noexcept = delete;
+    ~LoadAwareChunkSelector() = default;
+
+    void add_chunk(cshared< Chunk >&) override;
+    cshared< Chunk > select_chunk(blk_count_t nblks, const blk_alloc_hints& hints) override;
+    void foreach_chunks(std::function< void(cshared< Chunk >&) >&& cb) override;
+
+private:
+    static double score(Chunk const& chunk, double halving_ios);
+
+private:
+    ChunkList m_chunks;
+    bool m_dynamic_chunk_add; // Can we add chunk dynamically
+};
+
+} // namespace homestore
@@ -0,0 +1,44 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include "blkalloc/blk_allocator.h"
+#include "most_available_space_chunk_selector.h"
+
+namespace homestore {
+static const shared< Chunk > s_no_chunk{nullptr};
+
+MostAvailableSpaceChunkSelector::MostAvailableSpaceChunkSelector(bool dynamic_chunk_add) :
+        m_dynamic_chunk_add{dynamic_chunk_add} {}
+
+void MostAvailableSpaceChunkSelector::add_chunk(cshared< Chunk >& chunk) { m_chunks.push_back(chunk); }
+
+cshared< Chunk > MostAvailableSpaceChunkSelector::select_chunk(blk_count_t, const blk_alloc_hints&) {
+    shared< Chunk > const* best{&s_no_chunk};
+    blk_num_t best_avail{0};
+    auto const n = m_chunks.size();
+    for (uint32_t i{0}; i < n; ++i) {
+        auto const& chunk = m_chunks[i];
+        auto const avail = chunk->blk_allocator()->available_blks();
+        if (avail > best_avail) {
+            best = &chunk;
+            best_avail = avail;
+        }
+    }
+    return *best;
+}
+
+void MostAvailableSpaceChunkSelector::foreach_chunks(std::function< void(cshared< Chunk >&) >&& cb) {
+    m_chunks.for_each(cb);
+}
+} // namespace homestore
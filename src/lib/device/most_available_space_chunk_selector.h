@@ -0,0 +1,47 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <homestore/chunk_selector.h>
+
+#include <vector>
+#include <sisl/logging/logging.h>
+
+#include <homestore/vchunk.h>
+#include "device/chunk.h"
+#include "device/chunk_list.h"
+
+namespace homestore {
+// Picks the chunk with most available blks. Chunks of a vdev are only a few, so scanning all of them is cheap as it
+// just reads the used blk count of each allocator.
+class MostAvailableSpaceChunkSelector : public ChunkSelector {
+public:
+    MostAvailableSpaceChunkSelector(bool dynamic_chunk_add = false);
+    MostAvailableSpaceChunkSelector(const MostAvailableSpaceChunkSelector&) = delete;
+    MostAvailableSpaceChunkSelector(MostAvailableSpaceChunkSelector&&) noexcept = delete;
+    MostAvailableSpaceChunkSelector& operator=(const MostAvailableSpaceChunkSelector&) = delete;
+    MostAvailableSpaceChunkSelector& operator=(MostAvailableSpaceChunkSelector&&) noexcept = delete;
+    ~MostAvailableSpaceChunkSelector() = default;
+
+    void add_chunk(cshared< Chunk >&) override;
+    cshared< Chunk > select_chunk(blk_count_t nblks, const blk_alloc_hints& hints) override;
+    void foreach_chunks(std::function< void(cshared< Chunk >&) >&& cb) override;
+
+private:
+    ChunkList m_chunks;
+    bool m_dynamic_chunk_add; // Can we add chunk dynamically
+};
+
+} // namespace homestore
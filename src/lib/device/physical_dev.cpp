@@ -14,9 +14,22 @@
  *********************************************************************************/
 #include <cstring>
 #include <exception>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <optional>
 #include <stdexcept>
 #include <system_error>
+#include <thread>
+#include <tuple>
+
+#include <fcntl.h>
+#include <linux/blkzoned.h>
+#include <linux/falloc.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <folly/Exception.h>
 #include <iomgr/iomgr.hpp>
@@ -27,7 +40,9 @@
 #include "device/chunk.h"
 #include "device/physical_dev.hpp"
 #include "device/device.h"
+#include "device/uring_drive.hpp"
 #include "common/homestore_utils.hpp"
+#include "common/homestore_config.hpp"
 #include "common/homestore_assert.hpp"
 
 namespace homestore {
@@ -78,12 +93,111 @@ uint64_t PhysicalDev::get_dev_size(const std::string& devname) {
     return iomgr::DriveInterface::get_size(iodev.get());
 }
 
+static std::string read_sysfs_attr(std::filesystem::path const& path) {
+    std::ifstream f{path};
+    std::string val;
+    if (f) { std::getline(f, val); }
+    return val;
+}
+
+// Integrity profile is of the whole disk, which is the parent of a partition in sysfs
+static std::optional< std::filesystem::path > integrity_sysfs_dir(const std::string& devname) {
+    std::error_code ec;
+    auto const devpath = std::filesystem::canonical(devname, ec);
+    if (ec) { return std::nullopt; }
+    auto dir = std::filesystem::canonical(std::filesystem::path{"/sys/class/block"} / devpath.filename(), ec);
+    if (ec) { return std::nullopt; }
+    if (!std::filesystem::exists(dir / "integrity")) { dir = dir.parent_path(); }
+    return dir / "integrity";
+}
+
+bool PhysicalDev::probe_integrity(const std::string& devname) {
+    auto const integrity_dir = integrity_sysfs_dir(devname);
+    if (!integrity_dir) { return false; }
+    auto const format = read_sysfs_attr(*integrity_dir / "format");
+    return !format.empty() && (format != "none");
+}
+
+bool PhysicalDev::enable_integrity(const std::string& devname) {
+    if (!probe_integrity(devname)) { return false; }
+    auto const integrity_dir = *integrity_sysfs_dir(devname);
+    auto const format = read_sysfs_attr(integrity_dir / "format");
+    for (auto const* attr : {"write_generate", "read_verify"}) {
+        if (read_sysfs_attr(integrity_dir / attr) == "1") { continue; }
+        std::ofstream f{integrity_dir / attr};
+        f << "1";
+        if (!f.flush() || (read_sysfs_attr(integrity_dir / attr) != "1")) {
+            LOGWARN("Device={} has protection info format={}, but its {} could not be turned on", devname, format,
+                    attr);
+            return false;
+        }
+    }
+    LOGINFO("Device={} has protection info format={}", devname, format);
+    return true;
+}
+
+bool PhysicalDev::is_fast_zero_capable(const std::string& devname) {
+    std::error_code ec;
+    auto const devpath = std::filesystem::canonical(devname, ec);
+    if (ec) { return false; }
+    if (std::filesystem::is_regular_file(devpath, ec)) { return true; } // Holes punched in a file read as zeroes
+    if (!std::filesystem::is_block_file(devpath, ec)) { return false; }
+
+    // Write zeroes limit is of the whole disk, which is the parent of a partition in sysfs
+    auto dir = std::filesystem::canonical(std::filesystem::path{"/sys/class/block"} / devpath.filename(), ec);
+    if (ec) { return false; }
+    if (!std::filesystem::exists(dir / "queue")) { dir = dir.parent_path(); }
+    auto const max_bytes = read_sysfs_attr(dir / "queue" / "write_zeroes_max_bytes");
+    return !max_bytes.empty() && (std::stoull(max_bytes) > 0);
+}
+
+bool PhysicalDev::is_discard_capable(const std::string& devname) {
+    std::error_code ec;
+    auto const devpath = std::filesystem::canonical(devname, ec);
+    if (ec) { return false; }
+    if (std::filesystem::is_regular_file(devpath, ec)) { return true; }
+    if (!std::filesystem::is_block_file(devpath, ec)) { return false; }
+
+    auto dir = std::filesystem::canonical(std::filesystem::path{"/sys/class/block"} / devpath.filename(), ec);
+    if (ec) { return false; }
+    if (!std::filesystem::exists(dir / "queue")) { dir = dir.parent_path(); }
+    auto const max_bytes = read_sysfs_attr(dir / "queue" / "discard_max_bytes");
+    return !max_bytes.empty() && (std::stoull(max_bytes) > 0);
+}
+
+std::pair< uint64_t, uint32_t > PhysicalDev::zoned_info(const std::string& devname) {
+    std::error_code ec;
+    auto const devpath = std::filesystem::canonical(devname, ec);
+    if (ec || !std::filesystem::is_block_file(devpath, ec)) { return {0, 0}; }
+
+    // Zoned namespaces are exposed as separate block devices, with no partitions
+    auto const dir = std::filesystem::path{"/sys/class/block"} / devpath.filename() / "queue";
+    if (read_sysfs_attr(dir / "zoned") != "host-managed") { return {0, 0}; }
+    auto const sectors = read_sysfs_attr(dir / "chunk_sectors");
+    auto const max_open = read_sysfs_attr(dir / "max_open_zones");
+    return {sectors.empty() ? 0 : std::stoull(sectors) * 512, max_open.empty() ? 0 : uint32_cast(std::stoul(max_open))};
+}
+
+uint32_t PhysicalDev::max_write_streams(const std::string& devname) {
+    std::error_code ec;
+    auto const devpath = std::filesystem::canonical(devname, ec);
+    if (ec || !std::filesystem::is_block_file(devpath, ec)) { return 0; }
+
+    // Exposed by kernels which can tag the writes of io_uring with a write stream, like the placement handles of FDP
+    auto dir = std::filesystem::canonical(std::filesystem::path{"/sys/class/block"} / devpath.filename(), ec);
+    if (ec) { return 0; }
+    if (!std::filesystem::exists(dir / "queue")) { dir = dir.parent_path(); }
+    auto const streams = read_sysfs_attr(dir / "queue" / "max_write_streams");
+    return streams.empty() ? 0 : uint32_cast(std::stoul(streams));
+}
+
 PhysicalDev::PhysicalDev(const dev_info& dinfo, int oflags, const pdev_info_header& pinfo) :
         m_metrics{dinfo.dev_name},
         m_devname{dinfo.dev_name},
         m_dev_type{dinfo.dev_type},
         m_dev_info{dinfo},
-        m_pdev_info{pinfo} {
+        m_pdev_info{pinfo},
+        m_oflags{oflags} {
     LOGINFO("Opening device {} with {} mode.", m_devname, oflags & O_DIRECT ? "DIRECT_IO" : "BUFFERED_IO");
 
     m_iodev = open_and_cache_dev(m_devname, oflags);
@@ -112,9 +226,40 @@ PhysicalDev::PhysicalDev(const dev_info& dinfo, int oflags, const pdev_info_head
         m_streams.emplace_back(i);
     }
     m_super_blk_in_footer = m_pdev_info.mirror_super_block;
+
+    if (HS_DYNAMIC_CONFIG(device->qd_control)) { m_qd_ctl = std::make_unique< QueueDepthCtl >(m_devname, m_metrics); }
+    m_health = std::make_unique< DeviceHealth >(m_devname, m_metrics);
+
+    if (iomanager.is_spdk_mode()) {
+        // Drive is owned by the user space nvme driver, so none of the kernel block device features are available.
+        // Zeroes are written, freed blks are not discarded, and writes are not placed on streams.
+        LOGINFO("Device {} is driven by spdk, with completions polled on the reactors", m_devname);
+        return;
+    }
+
+    m_fast_zero = HS_DYNAMIC_CONFIG(device->fast_zero) && is_fast_zero_capable(m_devname);
+    if (m_fast_zero) { LOGINFO("Device {} zeroes ranges without writing zeroes to it", m_devname); }
+    m_discard = is_discard_capable(m_devname);
+
+    std::tie(m_zone_size, m_max_open_zones) = zoned_info(m_devname);
+    if (is_zoned()) {
+        LOGINFO("Device {} is zoned with zone_size={} max_open_zones={}", m_devname, in_bytes(m_zone_size),
+                m_max_open_zones);
+    }
+
+    if (HS_DYNAMIC_CONFIG(device->write_placement)) {
+        m_num_write_streams = s_cast< uint8_t >(std::min(max_write_streams(m_devname), uint32_cast(UINT8_MAX)));
+        if (m_num_write_streams) {
+            LOGINFO("Device {} places writes on {} write streams by the class of data", m_devname,
+                    m_num_write_streams);
+        }
+    }
 }
 
-PhysicalDev::~PhysicalDev() { close_device(); }
+PhysicalDev::~PhysicalDev() {
+    m_uring.reset();
+    close_device();
+}
 
 void PhysicalDev::write_super_block(uint8_t const* buf, uint32_t sb_size, uint64_t offset) {
     auto err_c = m_drive_iface->sync_write(m_iodev.get(), c_charptr_cast(buf), sb_size, offset);
@@ -134,32 +279,188 @@ std::error_code PhysicalDev::read_super_block(uint8_t* buf, uint32_t sb_size, ui
 
 void PhysicalDev::close_device() { close_and_uncache_dev(m_devname, m_iodev); }
 
+io_class_t PhysicalDev::write_class(uint8_t placement) {
+    switch (s_cast< vdev_placement_t >(placement)) {
+    case vdev_placement_t::JOURNAL:
+    case vdev_placement_t::META:
+        return io_class_t::HIGH;
+    case vdev_placement_t::INDEX: // Written by cp flush in background
+        return io_class_t::LOW;
+    default:
+        return io_class_t::NORMAL;
+    }
+}
+
+template < typename IoFn >
+folly::Future< std::error_code > PhysicalDev::tracked_io(io_class_t cls, bool is_write, uint32_t size, uint64_t offset,
+                                                         bool part_of_batch, IoFn&& io) {
+    auto done = [this, is_write, size, offset](Clock::time_point start_time, std::error_code ec) {
+        auto const latency_us = get_elapsed_time_us(start_time);
+        if (m_qd_ctl) { m_qd_ctl->on_complete(latency_us); }
+        m_health->on_io_done(is_write, offset, size, latency_us, bool(ec));
+        return ec;
+    };
+    if (!m_qd_ctl) {
+        auto const start_time = Clock::now();
+        return io(part_of_batch).thenValue([start_time, done](std::error_code ec) { return done(start_time, ec); });
+    }
+
+    folly::Promise< std::error_code > p;
+    auto f = p.getFuture();
+    m_qd_ctl->submit(cls, [part_of_batch, done, io = std::forward< IoFn >(io), p = std::move(p)](bool queued) mutable {
+        auto const start_time = Clock::now();
+        io(part_of_batch && !queued).thenValue([start_time, done, p = std::move(p)](std::error_code ec) mutable {
+            p.setValue(done(start_time, ec));
+        });
+    });
+    return f;
+}
+
+// Request of an async io, which notes its latency, and its completion to queue depth control if enabled, before
+// completing the caller's request
+struct tracked_io_req : public dev_io_req {
+    dev_io_req* orig_req;
+    PhysicalDev* pdev;
+    Clock::time_point start_time;
+    uint64_t offset;
+    uint32_t io_size;
+    bool is_write;
+};
+
+template < typename IoFn >
+void PhysicalDev::tracked_io(io_class_t cls, bool is_write, uint32_t size, uint64_t offset, dev_io_req* req,
+                             bool part_of_batch, IoFn&& io) {
+    auto* treq = new tracked_io_req{};
+    treq->orig_req = req;
+    treq->pdev = this;
+    treq->offset = offset;
+    treq->io_size = size;
+    treq->is_write = is_write;
+    treq->done = [](dev_io_req* r, std::error_code ec) {
+        auto* t = static_cast< tracked_io_req* >(r);
+        auto const latency_us = get_elapsed_time_us(t->start_time);
+        if (t->pdev->m_qd_ctl) { t->pdev->m_qd_ctl->on_complete(latency_us); }
+        t->pdev->m_health->on_io_done(t->is_write, t->offset, t->io_size, latency_us, bool(ec));
+        auto* orig = t->orig_req;
+        orig->size = t->size;
+        delete t;
+        orig->done(orig, ec);
+    };
+    if (!m_qd_ctl) {
+        treq->start_time = Clock::now();
+        io(treq, part_of_batch);
+        return;
+    }
+    m_qd_ctl->submit(cls, [treq, part_of_batch, io = std::forward< IoFn >(io)](bool queued) mutable {
+        treq->start_time = Clock::now();
+        io(treq, part_of_batch && !queued);
+    });
+}
+
 folly::Future< std::error_code > PhysicalDev::async_write(const char* data, uint32_t size, uint64_t offset,
-                                                          bool part_of_batch) {
+                                                          bool part_of_batch, bool via_uring, uint8_t placement) {
     HISTOGRAM_OBSERVE(m_metrics, write_io_sizes, (((size - 1) / 1024) + 1));
-    return m_drive_iface->async_write(m_iodev.get(), data, size, offset, part_of_batch);
+    auto io = [=, this](bool batch) {
+        if (via_uring && m_uring) { return m_uring->async_write(data, size, offset, batch, write_stream(placement)); }
+        return track_io(m_drive_iface->async_write(m_iodev.get(), data, size, offset, batch));
+    };
+    return tracked_io(write_class(placement), true /* is_write */, size, offset, part_of_batch, std::move(io));
 }
 
 folly::Future< std::error_code > PhysicalDev::async_writev(const iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
-                                                           bool part_of_batch) {
+                                                           bool part_of_batch, bool via_uring, uint8_t placement) {
     HISTOGRAM_OBSERVE(m_metrics, write_io_sizes, (((size - 1) / 1024) + 1));
-    return m_drive_iface->async_writev(m_iodev.get(), iov, iovcnt, size, offset, part_of_batch);
+    auto io = [=, this](bool batch) {
+        if (via_uring && m_uring) {
+            return m_uring->async_writev(iov, iovcnt, size, offset, batch, write_stream(placement));
+        }
+        return track_io(m_drive_iface->async_writev(m_iodev.get(), iov, iovcnt, size, offset, batch));
+    };
+    return tracked_io(write_class(placement), true /* is_write */, size, offset, part_of_batch, std::move(io));
 }
 
-folly::Future< std::error_code > PhysicalDev::async_read(char* data, uint32_t size, uint64_t offset,
-                                                         bool part_of_batch) {
+folly::Future< std::error_code > PhysicalDev::async_read(char* data, uint32_t size, uint64_t offset, bool part_of_batch,
+                                                         bool via_uring) {
     HISTOGRAM_OBSERVE(m_metrics, read_io_sizes, (((size - 1) / 1024) + 1));
-    return m_drive_iface->async_read(m_iodev.get(), data, size, offset, part_of_batch);
+    auto io = [=, this](bool batch) {
+        if (via_uring && m_uring) { return m_uring->async_read(data, size, offset, batch); }
+        return track_io(m_drive_iface->async_read(m_iodev.get(), data, size, offset, batch));
+    };
+    return tracked_io(io_class_t::NORMAL, false /* is_write */, size, offset, part_of_batch, std::move(io));
 }
 
 folly::Future< std::error_code > PhysicalDev::async_readv(iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
-                                                          bool part_of_batch) {
+                                                          bool part_of_batch, bool via_uring) {
+    HISTOGRAM_OBSERVE(m_metrics, read_io_sizes, (((size - 1) / 1024) + 1));
+    auto io = [=, this](bool batch) {
+        if (via_uring && m_uring) { return m_uring->async_readv(iov, iovcnt, size, offset, batch); }
+        return track_io(m_drive_iface->async_readv(m_iodev.get(), iov, iovcnt, size, offset, batch));
+    };
+    return tracked_io(io_class_t::NORMAL, false /* is_write */, size, offset, part_of_batch, std::move(io));
+}
+
+void PhysicalDev::async_write(const char* data, uint32_t size, uint64_t offset, dev_io_req* req, bool part_of_batch,
+                              bool via_uring, uint8_t placement) {
+    HISTOGRAM_OBSERVE(m_metrics, write_io_sizes, (((size - 1) / 1024) + 1));
+    auto io = [=, this](dev_io_req* r, bool batch) {
+        if (via_uring && m_uring) {
+            m_uring->async_write(data, size, offset, r, batch, write_stream(placement));
+        } else {
+            complete_on(m_drive_iface->async_write(m_iodev.get(), data, size, offset, batch), r);
+        }
+    };
+    tracked_io(write_class(placement), true /* is_write */, size, offset, req, part_of_batch, std::move(io));
+}
+
+void PhysicalDev::async_writev(const iovec* iov, int iovcnt, uint32_t size, uint64_t offset, dev_io_req* req,
+                               bool part_of_batch, bool via_uring, uint8_t placement) {
+    HISTOGRAM_OBSERVE(m_metrics, write_io_sizes, (((size - 1) / 1024) + 1));
+    auto io = [=, this](dev_io_req* r, bool batch) {
+        if (via_uring && m_uring) {
+            m_uring->async_writev(iov, iovcnt, size, offset, r, batch, write_stream(placement));
+        } else {
+            complete_on(m_drive_iface->async_writev(m_iodev.get(), iov, iovcnt, size, offset, batch), r);
+        }
+    };
+    tracked_io(write_class(placement), true /* is_write */, size, offset, req, part_of_batch, std::move(io));
+}
+
+void PhysicalDev::async_read(char* data, uint32_t size, uint64_t offset, dev_io_req* req, bool part_of_batch,
+                             bool via_uring) {
+    HISTOGRAM_OBSERVE(m_metrics, read_io_sizes, (((size - 1) / 1024) + 1));
+    auto io = [=, this](dev_io_req* r, bool batch) {
+        if (via_uring && m_uring) {
+            m_uring->async_read(data, size, offset, r, batch);
+        } else {
+            complete_on(m_drive_iface->async_read(m_iodev.get(), data, size, offset, batch), r);
+        }
+    };
+    tracked_io(io_class_t::NORMAL, false /* is_write */, size, offset, req, part_of_batch, std::move(io));
+}
+
+void PhysicalDev::async_readv(iovec* iov, int iovcnt, uint32_t size, uint64_t offset, dev_io_req* req,
+                              bool part_of_batch, bool via_uring) {
     HISTOGRAM_OBSERVE(m_metrics, read_io_sizes, (((size - 1) / 1024) + 1));
-    return m_drive_iface->async_readv(m_iodev.get(), iov, iovcnt, size, offset, part_of_batch);
+    auto io = [=, this](dev_io_req* r, bool batch) {
+        if (via_uring && m_uring) {
+            m_uring->async_readv(iov, iovcnt, size, offset, r, batch);
+        } else {
+            complete_on(m_drive_iface->async_readv(m_iodev.get(), iov, iovcnt, size, offset, batch), r);
+        }
+    };
+    tracked_io(io_class_t::NORMAL, false /* is_write */, size, offset, req, part_of_batch, std::move(io));
 }
 
 folly::Future< std::error_code > PhysicalDev::async_write_zero(uint64_t size, uint64_t offset) {
-    return m_drive_iface->async_write_zero(m_iodev.get(), size, offset);
+    if (!m_fast_zero && !is_zoned()) { return m_drive_iface->async_write_zero(m_iodev.get(), size, offset); }
+
+    // Offloaded zeroing is a blocking call, which is kept off the reactors. It is done mostly at format, once per chunk
+    folly::Promise< std::error_code > p;
+    auto f = p.getFuture();
+    std::thread([this, size, offset, p = std::move(p)]() mutable {
+        p.setValue(sync_write_zero(size, offset));
+    }).detach();
+    return f;
 }
 
 #if 0
@@ -172,6 +473,33 @@ folly::Future< std::error_code > PhysicalDev::async_write_zero(uint64_t size, ui
 }
 #endif
 
+folly::Future< std::error_code > PhysicalDev::track_io(folly::Future< std::error_code >&& f) {
+    m_outstanding_ios.fetch_add(1, std::memory_order_relaxed);
+    return std::move(f).ensure([this]() { m_outstanding_ios.fetch_sub(1, std::memory_order_relaxed); });
+}
+
+void PhysicalDev::complete_on(folly::Future< std::error_code >&& f, dev_io_req* req) {
+    track_io(std::move(f)).thenValue([req](std::error_code ec) { req->done(req, ec); });
+}
+
+int64_t PhysicalDev::outstanding_ios() const {
+    auto ios = m_outstanding_ios.load(std::memory_order_relaxed);
+    if (m_uring) { ios += m_uring->outstanding_ios(); }
+    return ios;
+}
+
+nlohmann::json PhysicalDev::get_io_status() const {
+    nlohmann::json js;
+    js["outstanding_ios"] = outstanding_ios();
+    if (m_qd_ctl) {
+        js["qd_limit"] = m_qd_ctl->qd_limit();
+        js["qd_inflight"] = m_qd_ctl->inflight();
+        js["qd_queued"] = m_qd_ctl->queued();
+    }
+    js["health_score"] = health_score();
+    return js;
+}
+
 folly::Future< std::error_code > PhysicalDev::queue_fsync() { return m_drive_iface->queue_fsync(m_iodev.get()); }
 
 __attribute__((no_sanitize_address)) static auto get_current_time() { return Clock::now(); }
@@ -213,10 +541,98 @@ std::error_code PhysicalDev::sync_readv(iovec* iov, int iovcnt, uint32_t size, u
 }
 
 std::error_code PhysicalDev::sync_write_zero(uint64_t size, uint64_t offset) {
+    // Zones can't be overwritten with zeroes, but read as zeroes once reset
+    if (is_zoned()) { return reset_zones(size, offset); }
+    if (m_fast_zero) {
+        auto const ec = deallocate(size, offset, true /* zero */);
+        if (!ec) {
+            COUNTER_INCREMENT(m_metrics, drive_fast_zero_count, 1);
+            return ec;
+        }
+        LOGWARN("Zeroing of size={} offset={} on device={} could not be offloaded, error={}, writing zeroes instead",
+                size, offset, m_devname, ec.message());
+    }
     return m_drive_iface->sync_write_zero(m_iodev.get(), size, offset);
 }
 
-void PhysicalDev::submit_batch() { m_drive_iface->submit_batch(); }
+std::error_code PhysicalDev::reset_zones(uint64_t size, uint64_t offset) {
+    HS_REL_ASSERT(is_zoned(), "Zone reset on device={} which is not zoned", m_devname);
+    HS_REL_ASSERT_EQ(offset % m_zone_size, 0, "Zone reset offset={} is not zone aligned on device={}", offset,
+                     m_devname);
+    HS_REL_ASSERT_EQ(size % m_zone_size, 0, "Zone reset size={} is not zone aligned on device={}", size, m_devname);
+
+    auto const fd = ::open(m_devname.c_str(), O_RDWR);
+    if (fd < 0) { return std::error_code{errno, std::system_category()}; }
+    blk_zone_range range{.sector = offset >> 9, .nr_sectors = size >> 9};
+    auto const ret = ::ioctl(fd, BLKRESETZONE, &range);
+    std::error_code ec = (ret == 0) ? std::error_code{} : std::error_code{errno, std::system_category()};
+    ::close(fd);
+    if (!ec) { COUNTER_INCREMENT(m_metrics, drive_zone_reset_count, 1); }
+    return ec;
+}
+
+uint8_t PhysicalDev::write_stream(uint8_t placement) const {
+    // Classes are numbered in the order they are to be kept apart, so the ones beyond the number of write streams of
+    // the drive share the last stream, which keeps the short lived journal apart from the rest even with 2 streams
+    return (m_num_write_streams == 0) ? 0 : std::min(placement, m_num_write_streams);
+}
+
+std::error_code PhysicalDev::sync_discard(uint64_t size, uint64_t offset) {
+    if (!m_discard) { return std::make_error_code(std::errc::operation_not_supported); }
+    auto const ec = deallocate(size, offset, false /* zero */);
+    if (!ec) { COUNTER_INCREMENT(m_metrics, drive_discard_count, 1); }
+    return ec;
+}
+
+std::error_code PhysicalDev::deallocate(uint64_t size, uint64_t offset, bool zero) {
+    auto const fd = ::open(m_devname.c_str(), O_RDWR);
+    if (fd < 0) { return std::error_code{errno, std::system_category()}; }
+
+    struct stat st;
+    int ret = ::fstat(fd, &st);
+    if (ret == 0) {
+        if (S_ISBLK(st.st_mode)) {
+            uint64_t range[2]{offset, size};
+            ret = ::ioctl(fd, zero ? BLKZEROOUT : BLKDISCARD, &range);
+        } else {
+            ret = ::fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, s_cast< off_t >(offset),
+                              s_cast< off_t >(size));
+        }
+    }
+    std::error_code ec = (ret == 0) ? std::error_code{} : std::error_code{errno, std::system_category()};
+    ::close(fd);
+    return ec;
+}
+
+void PhysicalDev::submit_batch(bool via_uring) {
+    if (via_uring && m_uring) {
+        m_uring->submit_batch();
+    } else {
+        m_drive_iface->submit_batch();
+    }
+}
+
+bool PhysicalDev::enable_uring() {
+    if (iomanager.is_spdk_mode()) {
+        LOGWARN("io_uring can't be enabled on device={} driven by spdk, its ios continue through iomgr", m_devname);
+        return false;
+    }
+
+    std::unique_lock lg{m_uring_mtx};
+    if (m_uring) { return true; }
+
+    UringDrive::params p;
+    p.queue_depth = HS_DYNAMIC_CONFIG(device->uring_queue_depth);
+    p.sqpoll = HS_DYNAMIC_CONFIG(device->uring_sqpoll);
+    p.fixed_buf_pool_size = uint64_cast(HS_DYNAMIC_CONFIG(device->uring_fixed_buf_pool_mb)) * 1024 * 1024;
+    p.buf_align = std::max(align_size(), 512u);
+    m_uring = UringDrive::make(m_devname, m_oflags, p);
+    if (!m_uring) {
+        LOGWARN("io_uring could not be enabled on device={}, its ios continue through iomgr", m_devname);
+        return false;
+    }
+    return true;
+}
 
 //////////////////////////// Chunk Creation/Load related methods /////////////////////////////////////////
 void PhysicalDev::format_chunks() {
@@ -442,10 +858,12 @@ void PhysicalDev::free_chunk_info(chunk_info* cinfo) {
 }
 
 ChunkInterval PhysicalDev::find_next_chunk_area(uint64_t size) const {
-    auto ins_ival = ChunkInterval::right_open(data_start_offset(), data_start_offset() + size);
+    // Chunks of a zoned device start on a zone, so that a chunk is reset and written sequentially as whole zones
+    auto const align = [this](uint64_t off) { return is_zoned() ? sisl::round_up(off, m_zone_size) : off; };
+    auto ins_ival = ChunkInterval::right_open(align(data_start_offset()), align(data_start_offset()) + size);
     for (auto& exist_ival : m_chunk_data_area) {
         if (ins_ival.upper() <= exist_ival.lower()) { break; }
-        ins_ival = ChunkInterval::right_open(exist_ival.upper(), exist_ival.upper() + size);
+        ins_ival = ChunkInterval::right_open(align(exist_ival.upper()), align(exist_ival.upper()) + size);
     }
 
     if (ins_ival.upper() > data_end_offset()) {
@@ -13,8 +13,12 @@
  *
  *********************************************************************************/
 #pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
+#include <utility>
 #include "hs_super_blk.h"
 
 #ifdef __linux__
@@ -31,6 +35,8 @@
 #include <homestore/homestore_decl.hpp>
 
 #include "hs_super_blk.h"
+#include "device/device_health.hpp"
+#include "device/queue_depth_ctl.hpp"
 SISL_LOGGING_DECL(device)
 
 namespace homestore {
@@ -39,6 +45,9 @@ public:
     explicit PhysicalDevMetrics(const std::string& devname) : sisl::MetricsGroupWrapper{"PhysicalDev", devname} {
         REGISTER_COUNTER(drive_sync_write_count, "Drive sync write count");
         REGISTER_COUNTER(drive_sync_read_count, "Drive sync read count");
+        REGISTER_COUNTER(drive_fast_zero_count, "Zeroing of ranges offloaded to the drive instead of writing zeroes");
+        REGISTER_COUNTER(drive_discard_count, "Ranges discarded on the drive");
+        REGISTER_COUNTER(drive_zone_reset_count, "Ranges of zones reset on the drive");
         REGISTER_COUNTER(drive_async_write_count, "Drive async write count");
         REGISTER_COUNTER(drive_async_read_count, "Drive async read count");
         REGISTER_COUNTER(drive_write_vector_count, "Total Count of buffer provided for write");
@@ -48,8 +57,19 @@ public:
         REGISTER_COUNTER(drive_spurios_events, "Total number of spurious events per drive");
         REGISTER_COUNTER(drive_skipped_chunk_bm_writes, "Total number of skipped writes for chunk bitmap");
 
+        REGISTER_GAUGE(drive_qd_limit, "Queue depth limit of async ios, under queue depth control");
+        REGISTER_GAUGE(drive_inflight_ios, "Async ios submitted to the drive, under queue depth control");
+        REGISTER_COUNTER(drive_queued_ios, "Async ios queued beyond the queue depth limit");
+
         REGISTER_HISTOGRAM(drive_write_latency, "BlkStore drive write latency in us");
+        REGISTER_HISTOGRAM(drive_async_latency, "Drive async io latency in us, under queue depth control");
         REGISTER_HISTOGRAM(drive_read_latency, "BlkStore drive read latency in us");
+        REGISTER_HISTOGRAM(drive_async_write_latency, "Drive async write latency in us", "drive_async_op_latency",
+                           {"op", "write"});
+        REGISTER_HISTOGRAM(drive_async_read_latency, "Drive async read latency in us", "drive_async_op_latency",
+                           {"op", "read"});
+        REGISTER_COUNTER(drive_slow_ios, "Async ios slower than slow_io_threshold_us");
+        REGISTER_GAUGE(drive_health_score, "Health score of the drive from 0 to 100, by its recent slow or failed ios");
 
         REGISTER_HISTOGRAM(write_io_sizes, "Write IO Sizes", "io_sizes", {"io_direction", "write"},
                            HistogramBucketsType(ExponentialOfTwoBuckets));
@@ -85,7 +105,10 @@ struct chunk_info {
     uint32_t chunk_ordinal{0};     // 32: Chunk ordinal within the vdev on this pdev
     uint8_t chunk_allocated{0x00}; // 36: Is chunk allocated or free
     uint16_t checksum{0};          // 37: checksum of this chunk info
-    uint8_t padding[25]{};         // 39: pad to make it 128 bytes total
+    uint8_t is_mirror{0};          // 39: Is a mirror copy of a primary chunk of a mirrored vdev
+    uint32_t primary_chunk_id{0};  // 40: Primary chunk this chunk is a mirror copy of, if is_mirror
+    uint32_t mirror_gen{0};        // 44: Generation of a copy of a mirrored vdev, lower than others if it missed writes
+    uint8_t padding[16]{};         // 48: pad to make it 128 bytes total
     uint8_t chunk_selector_private[selector_private_size]{}; // 64: Chunk selector private area
     uint8_t user_private[user_private_size]{};               // 128: Opaque user of the chunk information
 
@@ -120,6 +143,7 @@ struct Stream {
     Stream(uint32_t stream_id) : m_stream_id{stream_id} {}
 };
 
+class UringDrive;
 class PhysicalDev {
 private:
     iomgr::io_device_ptr m_iodev;
@@ -137,6 +161,17 @@ private:
     std::unique_ptr< sisl::Bitset > m_chunk_info_slots; // Slots to write the chunk info
     uint32_t m_chunk_sb_size{0};                        // Total size of the chunk sb at present
     std::unordered_set< uint64_t > m_chunk_start;       // Store and verify start offset of all chunks for debugging.
+    std::atomic< int64_t > m_outstanding_ios{0};        // Async ios submitted and yet to be completed
+    int m_oflags;                                       // Flags the device is opened with
+    std::mutex m_uring_mtx;
+    std::unique_ptr< UringDrive > m_uring;     // io_uring data path, for the vdevs which opt into it
+    bool m_fast_zero{false};                   // Ranges are zeroed by the drive, without writing zeroes to it
+    bool m_discard{false};                     // Ranges can be discarded, so that the drive can reclaim them
+    uint8_t m_num_write_streams{0};            // Write streams (NVMe FDP placement handles) used to place writes
+    uint64_t m_zone_size{0};                   // Size of a zone of a host managed zoned device, 0 if not zoned
+    uint32_t m_max_open_zones{0};              // Zones which can be open for writes at a time, 0 if no limit
+    std::unique_ptr< QueueDepthCtl > m_qd_ctl; // Adaptive queue depth control of async ios, if enabled
+    std::unique_ptr< DeviceHealth > m_health;  // Latency and health tracking of async ios
 
 public:
     PhysicalDev(const dev_info& dinfo, int oflags, const pdev_info_header& pinfo);
@@ -150,6 +185,32 @@ public:
     static first_block read_first_block(const std::string& devname, int oflags);
     static uint64_t get_dev_size(const std::string& devname);
 
+    /// @brief Probes whether the device is formatted with protection info (T10-DIF or NVMe PI), without changing it
+    static bool probe_integrity(const std::string& devname);
+
+    /// @brief Turns on the generation of protection info on writes and its verification on reads by the block layer,
+    /// which doesn't persist across reboots.
+    /// @return false if the device has no protection info or it couldn't be turned on
+    static bool enable_integrity(const std::string& devname);
+
+    /// @brief Probes whether ranges of the device can be zeroed without writing zeroes to it, with the deallocated
+    /// ranges guaranteed to read back as zeroes: block device which offloads write zeroes (NVMe write zeroes or
+    /// deallocate, SCSI write same), or a file on a filesystem which can punch holes.
+    static bool is_fast_zero_capable(const std::string& devname);
+
+    /// @brief Probes whether ranges of the device can be discarded: block device which supports discard (NVMe
+    /// deallocate, ATA trim, SCSI unmap), or a file on a filesystem which can punch holes.
+    static bool is_discard_capable(const std::string& devname);
+
+    /// @brief Number of write streams the device exposes to place the data of different lifetimes apart on the media,
+    /// like the placement handles of NVMe flexible data placement. 0 if it does not or the kernel can't tag writes.
+    static uint32_t max_write_streams(const std::string& devname);
+
+    /// @brief Probes whether the device is host managed zoned (like a ZNS SSD), on which each zone has to be written
+    /// sequentially and reset before it is written again. Returns the zone size and max open zones, zone size is 0
+    /// if the device is not zoned.
+    static std::pair< uint64_t, uint32_t > zoned_info(const std::string& devname);
+
     std::error_code read_super_block(uint8_t* buf, uint32_t sb_size, uint64_t offset);
     void write_super_block(uint8_t const* buf, uint32_t sb_size, uint64_t offset);
     void close_device();
@@ -199,13 +260,29 @@ public:
     const std::string& get_devname() const { return m_devname; }
 
     /////////////////////////////////////// IO Methods //////////////////////////////////////////
+    // Async ios go through io_uring drive if via_uring is set and it is enabled on this device, else through iomgr.
+    // Writes on io_uring drive are placed on the write stream of the placement class (vdev_placement_t) of the data.
     folly::Future< std::error_code > async_write(const char* data, uint32_t size, uint64_t offset,
-                                                 bool part_of_batch = false);
+                                                 bool part_of_batch = false, bool via_uring = false,
+                                                 uint8_t placement = 0);
     folly::Future< std::error_code > async_writev(const iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
-                                                  bool part_of_batch = false);
-    folly::Future< std::error_code > async_read(char* data, uint32_t size, uint64_t offset, bool part_of_batch = false);
+                                                  bool part_of_batch = false, bool via_uring = false,
+                                                  uint8_t placement = 0);
+    folly::Future< std::error_code > async_read(char* data, uint32_t size, uint64_t offset, bool part_of_batch = false,
+                                                bool via_uring = false);
     folly::Future< std::error_code > async_readv(iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
-                                                 bool part_of_batch = false);
+                                                 bool part_of_batch = false, bool via_uring = false);
+
+    // Callback based async ios, which on io_uring drive do not allocate and complete req on its reaper thread. Without
+    // io_uring, they go through iomgr and req is completed from the continuation of the io.
+    void async_write(const char* data, uint32_t size, uint64_t offset, dev_io_req* req, bool part_of_batch = false,
+                     bool via_uring = false, uint8_t placement = 0);
+    void async_writev(const iovec* iov, int iovcnt, uint32_t size, uint64_t offset, dev_io_req* req,
+                      bool part_of_batch = false, bool via_uring = false, uint8_t placement = 0);
+    void async_read(char* data, uint32_t size, uint64_t offset, dev_io_req* req, bool part_of_batch = false,
+                    bool via_uring = false);
+    void async_readv(iovec* iov, int iovcnt, uint32_t size, uint64_t offset, dev_io_req* req,
+                     bool part_of_batch = false, bool via_uring = false);
     folly::Future< std::error_code > async_write_zero(uint64_t size, uint64_t offset);
     folly::Future< std::error_code > queue_fsync();
 
@@ -214,7 +291,35 @@ public:
     std::error_code sync_read(char* data, uint32_t size, uint64_t offset);
     std::error_code sync_readv(iovec* iov, int iovcnt, uint32_t size, uint64_t offset);
     std::error_code sync_write_zero(uint64_t size, uint64_t offset);
-    void submit_batch();
+    void submit_batch(bool via_uring = false);
+    int64_t outstanding_ios() const;
+
+    /// @brief Outstanding ios, queue depth limit and queued ios of queue depth control if enabled, and health
+    nlohmann::json get_io_status() const;
+
+    /// @brief Health of the device from 0 to 100, by the async ios which are slow or failing. See DeviceHealth
+    uint32_t health_score() const { return m_health->score(); }
+    bool is_sick() const { return (health_score() < DeviceHealth::sick_score); }
+
+    /// @brief Sets up the io_uring drive of this device, if not already. Returns false if it could not be set up, in
+    /// which case ios continue to go through iomgr.
+    bool enable_uring();
+    UringDrive* uring() const { return m_uring.get(); }
+
+    bool is_fast_zero() const { return m_fast_zero; }
+    bool is_discard() const { return m_discard; }
+    uint8_t num_write_streams() const { return m_num_write_streams; }
+    bool is_zoned() const { return (m_zone_size != 0); }
+    uint64_t zone_size() const { return m_zone_size; }
+    uint32_t max_open_zones() const { return m_max_open_zones; }
+
+    /// @brief Resets the zones of the range, which have to be zone aligned, so that they read as zeroes and can be
+    /// written from their start again. It is what zeroing of a range does on a zoned device.
+    std::error_code reset_zones(uint64_t size, uint64_t offset);
+
+    /// @brief Discards the range on the drive, so that it can reclaim the space. Contents of a discarded range are
+    /// undefined till it is written again. It is synchronous and meant to be issued off the io path.
+    std::error_code sync_discard(uint64_t size, uint64_t offset);
 
     ///////////// Parameters Getters ///////////////////////
     uint32_t optimal_page_size() const { return m_pdev_info.dev_attr.phys_page_size; }
@@ -231,10 +336,21 @@ public:
     uint64_t chunk_info_offset_nth(uint32_t slot) const;
 
 private:
+    folly::Future< std::error_code > track_io(folly::Future< std::error_code >&& f);
+    void complete_on(folly::Future< std::error_code >&& f, dev_io_req* req);
     void do_remove_chunk(cshared< Chunk >& chunk);
     void populate_chunk_info(chunk_info* cinfo, uint32_t vdev_id, uint64_t size, uint32_t chunk_id, uint32_t ordinal,
                              const sisl::blob& private_data);
     void free_chunk_info(chunk_info* cinfo);
     ChunkInterval find_next_chunk_area(uint64_t size) const;
+    std::error_code deallocate(uint64_t size, uint64_t offset, bool zero);
+    uint8_t write_stream(uint8_t placement) const;
+    static io_class_t write_class(uint8_t placement);
+    template < typename IoFn >
+    folly::Future< std::error_code > tracked_io(io_class_t cls, bool is_write, uint32_t size, uint64_t offset,
+                                                bool part_of_batch, IoFn&& io);
+    template < typename IoFn >
+    void tracked_io(io_class_t cls, bool is_write, uint32_t size, uint64_t offset, dev_io_req* req, bool part_of_batch,
+                    IoFn&& io);
 };
 } // namespace homestore
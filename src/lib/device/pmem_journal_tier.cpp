@@ -0,0 +1,349 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#include <sisl/logging/logging.h>
+#include <homestore/homestore_decl.hpp>
+
+#include "device/pmem_journal_tier.hpp"
+#include "common/homestore_assert.hpp"
+
+namespace homestore {
+SISL_LOGGING_DECL(journalvdev)
+
+static constexpr uint64_t cache_line_size = 64;
+
+struct PmemJournalTier::header {
+    static constexpr uint64_t MAGIC = 0x4C4E524A4D454D50; // "PMEMJRNL"
+    static constexpr uint32_t VERSION = 1;
+
+    uint64_t magic{0};
+    uint32_t version{0};
+    uint32_t num_slots{0};
+    uint64_t region_size{0};
+    uint64_t destaged_seq{0}; // Writes staged before this seq are all on the chunks
+};
+
+struct alignas(cache_line_size) PmemJournalTier::slot {
+    static constexpr uint32_t MAGIC = 0x544F4C53; // "SLOT"
+
+    uint64_t seq{0};
+    uint64_t data_off{0}; // Offset of the data in the data ring
+    uint64_t size{0};
+    uint64_t offset_in_segment{0};
+    logdev_id_t logdev_id{0};
+    chunk_num_t chunk_num{0};
+    uint16_t pad{0};
+    uint32_t magic{0};
+    crc32_t crc{0};
+
+    crc32_t compute_crc() const {
+        return crc32_ieee(init_crc32, r_cast< const unsigned char* >(this), offsetof(slot, crc));
+    }
+    bool is_valid() const { return (magic == MAGIC) && (crc == compute_crc()); }
+};
+
+#if defined(__x86_64__)
+static bool cpu_has_clflushopt() {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) { return false; }
+    return (ebx & (1u << 23)) != 0;
+}
+
+__attribute__((target("clflushopt"))) static void flush_lines_opt(const uint8_t* p, const uint8_t* end) {
+    for (; p < end; p += cache_line_size) {
+        _mm_clflushopt(const_cast< uint8_t* >(p));
+    }
+}
+
+static void flush_lines(const uint8_t* p, const uint8_t* end) {
+    for (; p < end; p += cache_line_size) {
+        _mm_clflush(p);
+    }
+}
+#endif
+
+std::unique_ptr< PmemJournalTier > PmemJournalTier::make(std::string const& path, uint64_t size, uint32_t align) {
+    std::unique_ptr< PmemJournalTier > tier{new PmemJournalTier{align}};
+    if (!tier->setup(path, size)) { return nullptr; }
+    return tier;
+}
+
+PmemJournalTier::~PmemJournalTier() {
+    if (m_base != nullptr) { ::munmap(m_base, m_size); }
+    if (m_fd >= 0) { ::close(m_fd); }
+}
+
+bool PmemJournalTier::setup(std::string const& path, uint64_t size) {
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (m_fd < 0) {
+        LOGWARN("pmem tier could not open path={}, errno={}", path, errno);
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(m_fd, &st) != 0) {
+        LOGWARN("pmem tier could not stat path={}, errno={}", path, errno);
+        return false;
+    }
+    if (S_ISREG(st.st_mode)) {
+        if (size == 0) { size = st.st_size; }
+        if ((uint64_cast(st.st_size) < size) && (::posix_fallocate(m_fd, 0, size) != 0)) {
+            LOGWARN("pmem tier could not allocate size={} of path={}", size, path);
+            return false;
+        }
+    }
+
+    // Region has to fit the header and a fair number of slots and writes, all of which are in units of align
+    uint64_t const min_size = 64 * uint64_cast(m_align);
+    size = sisl::round_down(size, m_align);
+    if (size < min_size) {
+        LOGWARN("pmem tier size={} of path={} is less than the minimum size={}", size, path, min_size);
+        return false;
+    }
+    m_size = size;
+
+    void* base{MAP_FAILED};
+#if defined(__x86_64__) && defined(MAP_SYNC)
+    // MAP_SYNC is honoured only on DAX, where stores made persistent by cpu cache flushes are durable with no fsync
+    base = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED_VALIDATE | MAP_SYNC, m_fd, 0);
+    if (base != MAP_FAILED) { m_dax = true; }
+#endif
+    if (base == MAP_FAILED) {
+        base = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (base == MAP_FAILED) {
+            LOGWARN("pmem tier could not map size={} of path={}, errno={}", m_size, path, errno);
+            return false;
+        }
+        LOGWARN("pmem tier path={} is not DAX mapped, writes are made persistent with msync", path);
+    }
+    m_base = r_cast< uint8_t* >(base);
+#if defined(__x86_64__)
+    m_clflushopt = cpu_has_clflushopt();
+#endif
+
+    // A slot per 16KB of the region, which is about the average size of a log group
+    m_num_slots = uint32_cast(std::max< uint64_t >(m_size / (16 * 1024), 16));
+    m_data_start = sisl::round_up(sizeof(header), m_align) +
+        sisl::round_up(uint64_cast(m_num_slots) * sizeof(slot), m_align);
+    if (m_data_start + m_align > m_size) {
+        LOGWARN("pmem tier size={} of path={} has no room for data", m_size, path);
+        return false;
+    }
+    m_data_size = m_size - m_data_start;
+
+    auto const* h = hdr();
+    if ((h->magic != header::MAGIC) || (h->version != header::VERSION) || (h->num_slots != m_num_slots) ||
+        (h->region_size != m_size)) {
+        format();
+    }
+    m_next_seq = hdr()->destaged_seq;
+
+    LOGINFO("pmem tier of journal is set up {}", to_string());
+    return true;
+}
+
+void PmemJournalTier::format() {
+    std::memset(m_base + sizeof(header), 0, m_data_start - sizeof(header));
+    persist(m_base + sizeof(header), m_data_start - sizeof(header));
+
+    auto* h = new (m_base) header{};
+    h->version = header::VERSION;
+    h->num_slots = m_num_slots;
+    h->region_size = m_size;
+    h->destaged_seq = 0;
+    persist(h, sizeof(header));
+
+    // Magic is written last, so a partially formatted region is formatted again
+    h->magic = header::MAGIC;
+    persist(&h->magic, sizeof(h->magic));
+    LOGINFO("pmem tier of journal is formatted, size={} num_slots={}", m_size, m_num_slots);
+}
+
+PmemJournalTier::header* PmemJournalTier::hdr() const { return r_cast< header* >(m_base); }
+
+PmemJournalTier::slot* PmemJournalTier::slot_of(uint64_t seq) const {
+    static_assert(sizeof(slot) == cache_line_size, "Slot of pmem tier is expected to be a cache line");
+    return r_cast< slot* >(m_base + sisl::round_up(sizeof(header), m_align)) + (seq % m_num_slots);
+}
+
+void PmemJournalTier::persist(const void* addr, uint64_t len) const {
+    if (len == 0) { return; }
+    auto const start = r_cast< uintptr_t >(addr);
+    auto const end = start + len;
+#if defined(__x86_64__)
+    if (m_dax) {
+        auto const* p = r_cast< const uint8_t* >(start & ~(cache_line_size - 1));
+        if (m_clflushopt) {
+            flush_lines_opt(p, r_cast< const uint8_t* >(end));
+        } else {
+            flush_lines(p, r_cast< const uint8_t* >(end));
+        }
+        // Orders the flushes before the stores which follow, like the slot which validates the data flushed
+        _mm_sfence();
+        return;
+    }
+#endif
+    static uint64_t const page_size = uint64_cast(::sysconf(_SC_PAGESIZE));
+    auto const page_start = sisl::round_down(start, page_size);
+    [[maybe_unused]] auto const ret = ::msync(r_cast< void* >(page_start), end - page_start, MS_SYNC);
+    HS_DBG_ASSERT_EQ(ret, 0, "msync of pmem tier failed, errno={}", errno);
+}
+
+// Data is allocated in the order the writes are staged, from the tail of the ring up to the data of the oldest write
+// in flight. A write which does not fit before the end of the ring is placed at its start, leaving the rest unused
+// till the ring wraps around.
+std::optional< uint64_t > PmemJournalTier::alloc_data(uint64_t size) {
+    if ((size > m_data_size) || (m_inflight.size() >= m_num_slots)) { return std::nullopt; }
+    if (m_inflight.empty()) { return 0; }
+
+    auto const head = m_inflight.front().data_off;
+    if (m_data_tail > head) {
+        if (m_data_tail + size <= m_data_size) { return m_data_tail; }
+        if (size <= head) { return 0; }
+    } else if ((m_data_tail < head) && (m_data_tail + size <= head)) {
+        return m_data_tail;
+    }
+    return std::nullopt;
+}
+
+std::optional< PmemJournalTier::staged_io > PmemJournalTier::stage(logdev_id_t logdev_id, chunk_num_t chunk_num,
+                                                                   uint64_t offset_in_segment, const iovec* iov,
+                                                                   int iovcnt, uint64_t size) {
+    auto const alloc_size = sisl::round_up(size, m_align);
+    uint64_t seq;
+    uint64_t data_off;
+    {
+        std::unique_lock lg{m_mtx};
+        auto const off = alloc_data(alloc_size);
+        if (!off) { return std::nullopt; }
+        data_off = *off;
+        seq = m_next_seq++;
+        m_inflight.push_back(inflight{seq, data_off, alloc_size});
+        m_data_tail = data_off + alloc_size;
+    }
+    m_staged_size.fetch_add(alloc_size, std::memory_order_relaxed);
+
+    // Copies of concurrent writes go on in parallel, each in its own space
+    auto* data = m_base + m_data_start + data_off;
+    uint64_t copied{0};
+    for (int i{0}; i < iovcnt; ++i) {
+        std::memcpy(data + copied, iov[i].iov_base, iov[i].iov_len);
+        copied += iov[i].iov_len;
+    }
+    HS_DBG_ASSERT_EQ(copied, size, "Size of iovs mismatch");
+    persist(data, size);
+
+    // Slot is made valid only after the data it describes is persistent
+    auto* s = new (slot_of(seq)) slot{};
+    s->seq = seq;
+    s->data_off = data_off;
+    s->size = size;
+    s->offset_in_segment = offset_in_segment;
+    s->logdev_id = logdev_id;
+    s->chunk_num = chunk_num;
+    s->magic = slot::MAGIC;
+    s->crc = s->compute_crc();
+    persist(s, sizeof(slot));
+
+    LOGTRACEMOD(journalvdev, "Staged seq={} log_dev={} chunk={} offset_in_segment={} size={} data_off={}", seq,
+                logdev_id, chunk_num, offset_in_segment, size, data_off);
+    return staged_io{seq, data, size};
+}
+
+void PmemJournalTier::destaged(uint64_t seq) {
+    // Slot is invalidated right away, as the chunk it is on could be truncated off and reused, once the write is off
+    // the tier, while an older write still holds the destaged seq back
+    auto* s = slot_of(seq);
+    HS_DBG_ASSERT_EQ(s->seq, seq, "Slot of destaged write is reused");
+    s->magic = 0;
+    persist(&s->magic, sizeof(s->magic));
+
+    std::unique_lock lg{m_mtx};
+    HS_DBG_ASSERT(!m_inflight.empty() && (seq >= m_inflight.front().seq), "Destaged seq={} is not in flight", seq);
+    auto& io = m_inflight[seq - m_inflight.front().seq];
+    io.destaged = true;
+    m_staged_size.fetch_sub(io.size, std::memory_order_relaxed);
+
+    bool popped{false};
+    while (!m_inflight.empty() && m_inflight.front().destaged) {
+        m_inflight.pop_front();
+        popped = true;
+    }
+    if (popped) {
+        if (m_inflight.empty()) { m_data_tail = 0; }
+        persist_destaged_seq(m_inflight.empty() ? m_next_seq : m_inflight.front().seq);
+    }
+}
+
+void PmemJournalTier::persist_destaged_seq(uint64_t seq) {
+    // Aligned 8 byte store, which is failure atomic on persistent memory
+    hdr()->destaged_seq = seq;
+    persist(&hdr()->destaged_seq, sizeof(uint64_t));
+}
+
+void PmemJournalTier::recover(const recover_cb_t& cb) {
+    std::unique_lock lg{m_mtx};
+    auto const from = hdr()->destaged_seq;
+    std::vector< const slot* > staged;
+    for (uint32_t i{0}; i < m_num_slots; ++i) {
+        auto const* s = slot_of(i);
+        if (!s->is_valid() || (s->seq < from) || (s->data_off + s->size > m_data_size)) { continue; }
+        staged.push_back(s);
+    }
+    std::sort(staged.begin(), staged.end(), [](const slot* a, const slot* b) { return a->seq < b->seq; });
+
+    uint64_t recovered_size{0};
+    for (auto const* s : staged) {
+        LOGINFOMOD(journalvdev, "Recovering staged seq={} log_dev={} chunk={} offset_in_segment={} size={}", s->seq,
+                   s->logdev_id, s->chunk_num, s->offset_in_segment, s->size);
+        cb(s->logdev_id, s->chunk_num, s->offset_in_segment, m_base + m_data_start + s->data_off, s->size);
+        recovered_size += s->size;
+    }
+
+    // Everything in the tier is on the chunks now, which its seqs are moved past
+    m_next_seq = staged.empty() ? from : (staged.back()->seq + 1);
+    m_inflight.clear();
+    m_data_tail = 0;
+    m_staged_size.store(0, std::memory_order_relaxed);
+    persist_destaged_seq(m_next_seq);
+    LOGINFO("Recovered {} staged writes of size={} from pmem tier of journal, next seq={}", staged.size(),
+            recovered_size, m_next_seq);
+}
+
+uint64_t PmemJournalTier::num_staged() const {
+    std::unique_lock lg{m_mtx};
+    return m_inflight.size();
+}
+
+std::string PmemJournalTier::to_string() const {
+    return fmt::format("size={} dax={} clflushopt={} num_slots={} data_size={} staged_size={} num_staged={}", m_size,
+                       m_dax, m_clflushopt, m_num_slots, m_data_size, staged_size(), num_staged());
+}
+
+} // namespace homestore
@@ -0,0 +1,125 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <sys/uio.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include <homestore/blk.h>
+#include <homestore/logstore/log_store_internal.hpp>
+
+namespace homestore {
+
+/*
+ * Persistent memory tier of the journal, which is a region of NVDIMM or of an NVMe CMB/PMR mapped into the address
+ * space with DAX, in front of the journal chunks.
+ *
+ * A journal write is copied into the region and made persistent with cache line flushes followed by a store fence,
+ * after which it is as durable as on the journal chunks and is completed. Writes are destaged to the chunks in the
+ * background from their copy in the region, whose space is freed once they are written there. On restart, writes which
+ * were staged and not yet destaged are written to the chunks before the journal is read.
+ *
+ * Region has a header, followed by an array of slots describing the staged writes, followed by the data of the writes.
+ * Data is allocated as a ring, in the order the writes are staged, with each one aligned for direct io from it. A slot
+ * is written with a crc only after the data it describes is persistent, so a valid slot always has valid data.
+ *
+ * If the region could not be mapped with MAP_SYNC, as with a file not on a DAX filesystem, writes are made persistent
+ * with msync instead, which is correct but takes as long as a write to a fast device.
+ */
+class PmemJournalTier {
+public:
+    struct staged_io {
+        uint64_t seq;
+        uint8_t* data; // Copy of the write in the region, to destage from
+        uint64_t size;
+    };
+
+    using recover_cb_t = std::function< void(logdev_id_t logdev_id, chunk_num_t chunk_num, uint64_t offset_in_segment,
+                                             const uint8_t* data, uint64_t size) >;
+
+    /// @brief Maps the region at the path, a file on a DAX filesystem or a device DAX, creating the file with the size
+    /// if it does not exist. Returns nullptr on failure.
+    static std::unique_ptr< PmemJournalTier > make(std::string const& path, uint64_t size, uint32_t align);
+
+    PmemJournalTier(PmemJournalTier const&) = delete;
+    PmemJournalTier(PmemJournalTier&&) noexcept = delete;
+    PmemJournalTier& operator=(PmemJournalTier const&) = delete;
+    PmemJournalTier& operator=(PmemJournalTier&&) noexcept = delete;
+    ~PmemJournalTier();
+
+    /// @brief Copies the write into the region and makes it persistent. Returns nullopt if the region has no room
+    /// for it, in which case it is to be written to the chunks directly.
+    std::optional< staged_io > stage(logdev_id_t logdev_id, chunk_num_t chunk_num, uint64_t offset_in_segment,
+                                     const iovec* iov, int iovcnt, uint64_t size);
+
+    /// @brief Frees the space of a staged write, once it is written to the chunks. Writes could be destaged in any
+    /// order.
+    void destaged(uint64_t seq);
+
+    /// @brief Calls the cb, in order they were staged, for the writes which were staged and not destaged before the
+    /// restart, after which they are all treated as destaged.
+    void recover(const recover_cb_t& cb);
+
+    bool is_dax() const { return m_dax; }
+    uint64_t staged_size() const { return m_staged_size.load(std::memory_order_relaxed); }
+    uint64_t num_staged() const;
+    std::string to_string() const;
+
+private:
+    struct header;
+    struct slot;
+    struct inflight {
+        uint64_t seq;
+        uint64_t data_off;
+        uint64_t size;
+        bool destaged{false};
+    };
+
+    PmemJournalTier(uint32_t align) : m_align{align} {}
+    bool setup(std::string const& path, uint64_t size);
+    void format();
+    std::optional< uint64_t > alloc_data(uint64_t size);
+    void persist(const void* addr, uint64_t len) const;
+    header* hdr() const;
+    slot* slot_of(uint64_t seq) const;
+    void persist_destaged_seq(uint64_t seq);
+
+private:
+    uint32_t const m_align;
+    int m_fd{-1};
+    uint8_t* m_base{nullptr};
+    uint64_t m_size{0};
+    bool m_dax{false};        // Mapped with MAP_SYNC, persistent with cpu cache flushes
+    bool m_clflushopt{false}; // Cpu has clflushopt, which unlike clflush does not serialize the flushes
+
+    uint32_t m_num_slots{0};
+    uint64_t m_data_start{0}; // Offset of the data ring in the region
+    uint64_t m_data_size{0};
+
+    // Staged writes yet to be destaged in the order they were staged, with space allocation of the data ring
+    mutable std::mutex m_mtx;
+    std::deque< inflight > m_inflight;
+    uint64_t m_next_seq{0};
+    uint64_t m_data_tail{0}; // Where data of the next write is placed
+    std::atomic< uint64_t > m_staged_size{0};
+};
+
+} // namespace homestore
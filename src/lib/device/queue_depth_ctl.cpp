@@ -0,0 +1,122 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <memory>
+
+#include <iomgr/iomgr.hpp>
+#include <sisl/logging/logging.h>
+
+#include "device/queue_depth_ctl.hpp"
+#include "device/physical_dev.hpp"
+#include "common/homestore_config.hpp"
+
+namespace homestore {
+QueueDepthCtl::QueueDepthCtl(const std::string& name, PhysicalDevMetrics& metrics) :
+        m_name{name}, m_metrics{metrics}, m_limit{double(HS_DYNAMIC_CONFIG(device->qd_max))} {
+    GAUGE_UPDATE(m_metrics, drive_qd_limit, int64_cast(m_limit));
+    LOGINFO("Queue depth of device={} is controlled against latency target={}us, starting at qd={}", m_name,
+            HS_DYNAMIC_CONFIG(device->qd_latency_target_us), uint32_cast(m_limit));
+}
+
+void QueueDepthCtl::submit(io_class_t cls, io_fn_t&& io) {
+    {
+        std::unique_lock lg{m_mtx};
+        if (m_inflight >= uint32_cast(m_limit)) {
+            m_queued[enum_value(cls)].push_back(std::move(io));
+            COUNTER_INCREMENT(m_metrics, drive_queued_ios, 1);
+            return;
+        }
+        ++m_inflight;
+    }
+    io(false /* queued */);
+}
+
+void QueueDepthCtl::on_complete(uint64_t latency_us) {
+    HISTOGRAM_OBSERVE(m_metrics, drive_async_latency, latency_us);
+
+    std::deque< io_fn_t > ios;
+    {
+        std::unique_lock lg{m_mtx};
+        --m_inflight;
+        m_win_latency_us += latency_us;
+        if (++m_win_ios >= std::max(uint32_cast(m_limit), 1u)) {
+            auto const avg_us = m_win_latency_us / m_win_ios;
+            auto const min_qd = double(std::max(HS_DYNAMIC_CONFIG(device->qd_min), 1u));
+            auto const max_qd = double(std::max(HS_DYNAMIC_CONFIG(device->qd_max), 1u));
+            if (avg_us > HS_DYNAMIC_CONFIG(device->qd_latency_target_us)) {
+                m_limit *= (100.0 - std::min(HS_DYNAMIC_CONFIG(device->qd_decrease_pct), 99u)) / 100.0;
+            } else {
+                m_limit += 1.0;
+            }
+            m_limit = std::clamp(m_limit, min_qd, max_qd);
+            m_win_latency_us = 0;
+            m_win_ios = 0;
+            GAUGE_UPDATE(m_metrics, drive_qd_limit, int64_cast(m_limit));
+        }
+
+        while (m_inflight < uint32_cast(m_limit)) {
+            // Highest class first, except every so often the lowest one, so that it keeps moving under load
+            auto const low_turn = ((++m_ndispatched % dispatch_low_every) == 0);
+            std::deque< io_fn_t >* q{nullptr};
+            for (size_t i{0}; i < m_queued.size(); ++i) {
+                auto& cand = m_queued[low_turn ? (m_queued.size() - 1 - i) : i];
+                if (!cand.empty()) {
+                    q = &cand;
+                    break;
+                }
+            }
+            if (q == nullptr) { break; }
+            ios.push_back(std::move(q->front()));
+            q->pop_front();
+            ++m_inflight;
+        }
+        GAUGE_UPDATE(m_metrics, drive_inflight_ios, int64_cast(m_inflight));
+    }
+    if (!ios.empty()) { dispatch(ios); }
+}
+
+void QueueDepthCtl::dispatch(std::deque< io_fn_t >& ios) {
+    // Completions outside of io reactors, like on the reaper thread of io_uring drive, can't submit iomgr ios
+    if (iomanager.am_i_io_reactor()) {
+        for (auto& io : ios) {
+            io(true /* queued */);
+        }
+    } else {
+        for (auto& io : ios) {
+            iomanager.run_on_forget(iomgr::reactor_regex::random_worker,
+                                    [io = std::make_shared< io_fn_t >(std::move(io))]() { (*io)(true /* queued */); });
+        }
+    }
+}
+
+uint32_t QueueDepthCtl::qd_limit() const {
+    std::unique_lock lg{m_mtx};
+    return uint32_cast(m_limit);
+}
+
+uint32_t QueueDepthCtl::inflight() const {
+    std::unique_lock lg{m_mtx};
+    return m_inflight;
+}
+
+uint32_t QueueDepthCtl::queued() const {
+    std::unique_lock lg{m_mtx};
+    size_t n{0};
+    for (auto const& q : m_queued) {
+        n += q.size();
+    }
+    return uint32_cast(n);
+}
+} // namespace homestore
@@ -0,0 +1,78 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+
+#include <folly/Function.h>
+#include <sisl/utility/enum.hpp>
+
+namespace homestore {
+class PhysicalDevMetrics;
+
+ENUM(io_class_t, uint8_t, HIGH, NORMAL, LOW);
+
+/*
+ * Adaptive queue depth control of a physical device.
+ *
+ * Ios beyond the current queue depth limit are queued here by their class, instead of in the kernel or the drive, so
+ * that a latency sensitive io, like a journal write, is not stuck behind a burst of background ios. Queued ios are
+ * dispatched highest class first as ios complete, with every dispatch_low_every'th dispatch going to the lowest
+ * class which has any, so that no class starves.
+ *
+ * Limit is adjusted AIMD style once per window of as many completions as the limit: it is cut by qd_decrease_pct if
+ * the average latency of the window is above qd_latency_target_us, else raised by one, within [qd_min, qd_max].
+ */
+class QueueDepthCtl {
+public:
+    // Called with queued set if the io was queued, in which case it is not submitted as part of a batch anymore
+    using io_fn_t = folly::Function< void(bool queued) >;
+
+    QueueDepthCtl(const std::string& name, PhysicalDevMetrics& metrics);
+    QueueDepthCtl(const QueueDepthCtl&) = delete;
+    QueueDepthCtl& operator=(const QueueDepthCtl&) = delete;
+
+    /// @brief Submits the io right away if it is within the limit, else queues it by its class
+    void submit(io_class_t cls, io_fn_t&& io);
+
+    /// @brief Completion of an io submitted through this, with its latency from its submission to the drive
+    void on_complete(uint64_t latency_us);
+
+    uint32_t qd_limit() const;
+    uint32_t inflight() const;
+    uint32_t queued() const;
+
+private:
+    void dispatch(std::deque< io_fn_t >& ios);
+
+private:
+    static constexpr uint32_t dispatch_low_every{16};
+
+    std::string m_name;
+    PhysicalDevMetrics& m_metrics;
+
+    mutable std::mutex m_mtx;
+    std::array< std::deque< io_fn_t >, 3 > m_queued; // Queued ios by their class
+    uint32_t m_inflight{0};
+    double m_limit;
+    uint64_t m_ndispatched{0};
+
+    uint64_t m_win_latency_us{0}; // Sum of latencies of the completions of the current window
+    uint32_t m_win_ios{0};
+};
+} // namespace homestore
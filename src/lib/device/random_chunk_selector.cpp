@@ -0,0 +1,43 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <random>
+
+#include "blkalloc/blk_allocator.h"
+#include "random_chunk_selector.h"
+
+namespace homestore {
+static const shared< Chunk > s_no_chunk{nullptr};
+
+RandomChunkSelector::RandomChunkSelector(bool dynamic_chunk_add) : m_dynamic_chunk_add{dynamic_chunk_add} {}
+
+void RandomChunkSelector::add_chunk(cshared< Chunk >& chunk) { m_chunks.push_back(chunk); }
+
+cshared< Chunk > RandomChunkSelector::select_chunk(blk_count_t nblks, const blk_alloc_hints&) {
+    auto const n = m_chunks.size();
+    if (n == 0) { return s_no_chunk; }
+
+    static thread_local std::default_random_engine s_re{std::random_device{}()};
+    auto const start = std::uniform_int_distribution< uint32_t >{0, n - 1}(s_re);
+    for (uint32_t i{0}; i < n; ++i) {
+        auto const& chunk = m_chunks[(start + i) % n];
+        if (chunk->blk_allocator()->available_blks() >= nblks) { return chunk; }
+    }
+    return m_chunks[start];
+}
+
+void RandomChunkSelector::foreach_chunks(std::function< void(cshared< Chunk >&) >&& cb) {
+    m_chunks.for_each(cb);
+}
+} // namespace homestore
@@ -15,21 +15,20 @@
 #include "round_robin_chunk_selector.h"
 
 namespace homestore {
-RoundRobinChunkSelector::RoundRobinChunkSelector(bool dynamic_chunk_add) : m_dynamic_chunk_add{dynamic_chunk_add} {
-    RELEASE_ASSERT_EQ(dynamic_chunk_add, false,
-                      "Dynamically adding chunk to chunkselector is not supported, need RCU to make it thread safe");
-}
+static const shared< Chunk > s_no_chunk{nullptr};
+
+RoundRobinChunkSelector::RoundRobinChunkSelector(bool dynamic_chunk_add) : m_dynamic_chunk_add{dynamic_chunk_add} {}
 
-void RoundRobinChunkSelector::add_chunk(cshared< Chunk >& chunk) { m_chunks.emplace_back(std::move(chunk)); }
+void RoundRobinChunkSelector::add_chunk(cshared< Chunk >& chunk) { m_chunks.push_back(chunk); }
 
 cshared< Chunk > RoundRobinChunkSelector::select_chunk(blk_count_t, const blk_alloc_hints&) {
-    if (*m_next_chunk_index >= m_chunks.size()) { *m_next_chunk_index = 0; }
+    auto const n = m_chunks.size();
+    if (n == 0) { return s_no_chunk; }
+    if (*m_next_chunk_index >= n) { *m_next_chunk_index = 0; }
     return m_chunks[(*m_next_chunk_index)++];
 }
 
 void RoundRobinChunkSelector::foreach_chunks(std::function< void(cshared< Chunk >&) >&& cb) {
-    for (auto& chunk : m_chunks) {
-        cb(chunk);
-    }
+    m_chunks.for_each(cb);
 }
 } // namespace homestore
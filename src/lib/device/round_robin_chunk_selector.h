@@ -22,6 +22,7 @@
 
 #include <homestore/vchunk.h>
 #include "device/chunk.h"
+#include "device/chunk_list.h"
 
 namespace homestore {
 class RoundRobinChunkSelector : public ChunkSelector {
@@ -38,7 +39,7 @@ public:
     void foreach_chunks(std::function< void(cshared< Chunk >&) >&& cb) override;
 
 private:
-    std::vector< shared< Chunk > > m_chunks;
+    ChunkList m_chunks;
     folly::ThreadLocal< uint32_t > m_next_chunk_index;
     bool m_dynamic_chunk_add; // Can we add chunk dynamically
 };
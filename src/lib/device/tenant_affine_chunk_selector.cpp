@@ -0,0 +1,134 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <mutex>
+
+#include "blkalloc/blk_allocator.h"
+#include "common/homestore_config.hpp"
+#include "tenant_affine_chunk_selector.h"
+
+namespace homestore {
+static const shared< Chunk > s_no_chunk{nullptr};
+
+TenantAffineChunkSelector::TenantAffineChunkSelector(bool dynamic_chunk_add) :
+        m_dynamic_chunk_add{dynamic_chunk_add} {}
+
+void TenantAffineChunkSelector::add_chunk(cshared< Chunk >& chunk) {
+    std::unique_lock lg{m_mtx};
+    m_chunks.push_back(chunk);
+    m_ntenants.push_back(0);
+}
+
+bool TenantAffineChunkSelector::is_full(group_t const& group) const {
+    uint64_t total{0};
+    uint64_t avail{0};
+    for (auto const i : group) {
+        auto const ba = m_chunks[i]->blk_allocator();
+        total += ba->get_total_blks();
+        avail += ba->available_blks();
+    }
+    auto const full_pct = std::min(HS_DYNAMIC_CONFIG(device->tenant_group_full_pct), 100u);
+    return (total - avail) * 100 >= total * full_pct;
+}
+
+shared< Chunk > const* TenantAffineChunkSelector::pick(group_t const& group, blk_count_t nblks) const {
+    shared< Chunk > const* best{nullptr};
+    blk_num_t best_avail{0};
+    for (auto const i : group) {
+        auto const& chunk = m_chunks[i];
+        auto const avail = chunk->blk_allocator()->available_blks();
+        if ((avail >= nblks) && (avail > best_avail)) {
+            best = &chunk;
+            best_avail = avail;
+        }
+    }
+    return best;
+}
+
+std::optional< uint32_t > TenantAffineChunkSelector::spare_chunk(group_t const& group) const {
+    // Chunk shared by the fewest tenants, the one with most free blks among them
+    std::optional< uint32_t > best;
+    for (uint32_t i{0}; i < m_ntenants.size(); ++i) {
+        if (std::find(group.cbegin(), group.cend(), i) != group.cend()) { continue; }
+        if (!best || (m_ntenants[i] < m_ntenants[*best]) ||
+            ((m_ntenants[i] == m_ntenants[*best]) &&
+             (m_chunks[i]->blk_allocator()->available_blks() > m_chunks[*best]->blk_allocator()->available_blks()))) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+shared< Chunk > const* TenantAffineChunkSelector::pick_untenanted(blk_count_t nblks) const {
+    group_t untenanted;
+    group_t all;
+    for (uint32_t i{0}; i < m_ntenants.size(); ++i) {
+        if (m_ntenants[i] == 0) { untenanted.push_back(i); }
+        all.push_back(i);
+    }
+    auto const* c = pick(untenanted, nblks);
+    return (c != nullptr) ? c : pick(all, nblks);
+}
+
+cshared< Chunk > TenantAffineChunkSelector::select_chunk(blk_count_t nblks, const blk_alloc_hints& hints) {
+    if (!hints.tenant_id_hint) {
+        folly::SharedMutex::ReadHolder holder(m_mtx);
+        auto const* c = pick_untenanted(nblks);
+        return (c != nullptr) ? *c : s_no_chunk;
+    }
+
+    auto const tenant_id = *hints.tenant_id_hint;
+    {
+        folly::SharedMutex::ReadHolder holder(m_mtx);
+        auto const it = m_groups.find(tenant_id);
+        if ((it != m_groups.cend()) && !is_full(it->second)) {
+            if (auto const* c = pick(it->second, nblks)) { return *c; }
+        }
+    }
+
+    // Tenant has no group yet, or its group is filled up (unless another allocation has grown it meanwhile), so the
+    // spare chunks are assigned to it
+    folly::SharedMutex::WriteHolder holder(m_mtx);
+    auto& group = m_groups[tenant_id];
+    if (group.empty() || is_full(group) || (pick(group, nblks) == nullptr)) {
+        auto const nadd = group.empty() ? std::max(HS_DYNAMIC_CONFIG(device->tenant_chunks_per_group), 1u) : 1u;
+        for (uint32_t n{0}; n < nadd; ++n) {
+            auto const spare = spare_chunk(group);
+            if (!spare) { break; }
+            group.push_back(*spare);
+            ++m_ntenants[*spare];
+        }
+    }
+
+    if (auto const* c = pick(group, nblks)) { return *c; }
+    if (!hints.can_look_for_other_chunk) { return s_no_chunk; }
+    auto const* c = pick_untenanted(nblks);
+    return (c != nullptr) ? *c : s_no_chunk;
+}
+
+void TenantAffineChunkSelector::release_tenant(tenant_id_t tenant_id) {
+    folly::SharedMutex::WriteHolder holder(m_mtx);
+    auto const it = m_groups.find(tenant_id);
+    if (it == m_groups.end()) { return; }
+    for (auto const i : it->second) {
+        --m_ntenants[i];
+    }
+    m_groups.erase(it);
+}
+
+void TenantAffineChunkSelector::foreach_chunks(std::function< void(cshared< Chunk >&) >&& cb) {
+    m_chunks.for_each(cb);
+}
+} // namespace homestore
@@ -0,0 +1,70 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <homestore/chunk_selector.h>
+
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include <folly/SharedMutex.h>
+#include <sisl/logging/logging.h>
+
+#include <homestore/vchunk.h>
+#include "device/chunk.h"
+#include "device/chunk_list.h"
+
+namespace homestore {
+// Keeps the blks of each tenant, given by the tenant id hint of the allocation, on a group of chunks of its own. Group
+// of a tenant is assigned on its first allocation from the chunks no tenant has yet, and grows by another chunk once
+// its chunks are filled beyond a percent. Once every chunk is taken, chunks shared by the fewest tenants are assigned.
+// Allocations without a tenant go to the chunks of no tenant when there are any. Groups are kept in memory only, so
+// after a restart a tenant is assigned a group afresh.
+class TenantAffineChunkSelector : public ChunkSelector {
+public:
+    using tenant_id_t = uint64_t;
+
+    TenantAffineChunkSelector(bool dynamic_chunk_add = false);
+    TenantAffineChunkSelector(const TenantAffineChunkSelector&) = delete;
+    TenantAffineChunkSelector(TenantAffineChunkSelector&&) noexcept = delete;
+    TenantAffineChunkSelector& operator=(const TenantAffineChunkSelector&) = delete;
+    TenantAffineChunkSelector& operator=(TenantAffineChunkSelector&&) noexcept = delete;
+    ~TenantAffineChunkSelector() = default;
+
+    void add_chunk(cshared< Chunk >&) override;
+    cshared< Chunk > select_chunk(blk_count_t nblks, const blk_alloc_hints& hints) override;
+    void foreach_chunks(std::function< void(cshared< Chunk >&) >&& cb) override;
+
+    /// @brief Drops the group of the tenant, so that its chunks can be assigned to the other tenants
+    void release_tenant(tenant_id_t tenant_id);
+
+private:
+    using group_t = std::vector< uint32_t >; // Indices of the chunks of a tenant in m_chunks
+
+    bool is_full(group_t const& group) const;
+    shared< Chunk > const* pick(group_t const& group, blk_count_t nblks) const;
+    std::optional< uint32_t > spare_chunk(group_t const& group) const;
+    shared< Chunk > const* pick_untenanted(blk_count_t nblks) const;
+
+private:
+    ChunkList m_chunks;
+    bool m_dynamic_chunk_add; // Can we add chunk dynamically
+
+    mutable folly::SharedMutex m_mtx;
+    std::unordered_map< tenant_id_t, group_t > m_groups;
+    std::vector< uint32_t > m_ntenants; // Number of tenants each chunk is assigned to, by its index in m_chunks
+};
+
+} // namespace homestore
@@ -0,0 +1,444 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <folly/small_vector.h>
+#include <iomgr/iomgr.hpp>
+#include <homestore/homestore_decl.hpp>
+
+#include "device/uring_drive.hpp"
+#include "common/homestore_assert.hpp"
+
+namespace homestore {
+
+static int uring_setup(uint32_t entries, io_uring_params* p) {
+    return s_cast< int >(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int uring_enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+    return s_cast< int >(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+static int uring_register(int fd, uint32_t opcode, void const* arg, uint32_t nr_args) {
+    return s_cast< int >(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+// Indices shared with kernel, which are updated by one side and read by the other
+static uint32_t load_acquire(uint32_t const* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static void store_release(uint32_t* p, uint32_t v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+struct UringDrive::ring {
+    void* sq_ptr{MAP_FAILED};
+    size_t sq_sz{0};
+    void* cq_ptr{MAP_FAILED};
+    size_t cq_sz{0};
+    io_uring_sqe* sqes{r_cast< io_uring_sqe* >(MAP_FAILED)};
+    size_t sqes_sz{0};
+
+    uint32_t* sq_head{nullptr};
+    uint32_t* sq_tail{nullptr};
+    uint32_t* sq_flags{nullptr};
+    uint32_t* sq_array{nullptr};
+    uint32_t sq_mask{0};
+    uint32_t sq_entries{0};
+
+    uint32_t* cq_head{nullptr};
+    uint32_t* cq_tail{nullptr};
+    io_uring_cqe* cqes{nullptr};
+    uint32_t cq_mask{0};
+
+    ~ring() {
+        if (voidptr_cast(sqes) != MAP_FAILED) { ::munmap(sqes, sqes_sz); }
+        if ((cq_ptr != MAP_FAILED) && (cq_ptr != sq_ptr)) { ::munmap(cq_ptr, cq_sz); }
+        if (sq_ptr != MAP_FAILED) { ::munmap(sq_ptr, sq_sz); }
+    }
+};
+
+// Request of a future based io, which is allocated per io and delivers the completion on the submitting fiber
+struct UringDrive::request : public dev_io_req {
+    folly::Promise< std::error_code > promise;
+    folly::small_vector< iovec, 4 > iovs; // Copy of iovs, as kernel could read them after submit returns with sqpoll
+    bool on_fiber{false};
+    iomgr::io_fiber_t fiber;
+
+    static void on_done(dev_io_req* r, std::error_code ec) {
+        auto* req = s_cast< request* >(r);
+        if (req->on_fiber) {
+            iomanager.run_on_forget(req->fiber, [req, ec]() {
+                req->promise.setValue(ec);
+                delete req;
+            });
+        } else {
+            req->promise.setValue(ec);
+            delete req;
+        }
+    }
+};
+
+std::unique_ptr< UringDrive > UringDrive::make(std::string const& devname, int oflags, params const& p) {
+    std::unique_ptr< UringDrive > drive{new UringDrive{p}};
+    if (!drive->setup(devname, oflags)) { return nullptr; }
+    return drive;
+}
+
+UringDrive::UringDrive(params const& p) : m_params{p}, m_ring{std::make_unique< ring >()} {}
+
+UringDrive::~UringDrive() {
+    if (m_reaper.joinable()) {
+        // Reaper is woken up by a nop, after which it exits
+        {
+            std::unique_lock lg{m_sq_mtx};
+            m_stopping.store(true, std::memory_order_release);
+            auto* sqe = get_sqe(lg);
+            std::memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_NOP;
+            sqe->user_data = 0;
+            flush_sq();
+        }
+        m_reaper.join();
+    }
+
+    m_ring.reset();
+    if (m_ring_fd >= 0) { ::close(m_ring_fd); }
+    if (m_dev_fd >= 0) { ::close(m_dev_fd); }
+    if (m_fixed_bufs) { std::free(m_fixed_bufs); }
+}
+
+bool UringDrive::setup(std::string const& devname, int oflags) {
+    m_dev_fd = ::open(devname.c_str(), oflags & ~O_CREAT);
+    if (m_dev_fd < 0) {
+        LOGWARN("io_uring drive could not open device={}, errno={}", devname, errno);
+        return false;
+    }
+
+    io_uring_params up;
+    std::memset(&up, 0, sizeof(up));
+    if (m_params.sqpoll) {
+        up.flags |= IORING_SETUP_SQPOLL;
+        up.sq_thread_idle = m_params.sqpoll_idle_ms;
+    }
+    m_ring_fd = uring_setup(m_params.queue_depth, &up);
+    if (m_ring_fd < 0) {
+        LOGWARN("io_uring setup failed for device={} queue_depth={} sqpoll={}, errno={}", devname,
+                m_params.queue_depth, m_params.sqpoll, errno);
+        return false;
+    }
+
+    auto& r = *m_ring;
+    r.sq_sz = up.sq_off.array + (up.sq_entries * sizeof(uint32_t));
+    r.cq_sz = up.cq_off.cqes + (up.cq_entries * sizeof(io_uring_cqe));
+    bool const single_mmap = (up.features & IORING_FEAT_SINGLE_MMAP);
+    if (single_mmap) { r.sq_sz = r.cq_sz = std::max(r.sq_sz, r.cq_sz); }
+
+    r.sq_ptr = ::mmap(nullptr, r.sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd,
+                      IORING_OFF_SQ_RING);
+    if (r.sq_ptr == MAP_FAILED) {
+        LOGWARN("io_uring sq ring mmap failed for device={}, errno={}", devname, errno);
+        return false;
+    }
+    r.cq_ptr = single_mmap ? r.sq_ptr
+                           : ::mmap(nullptr, r.cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd,
+                                    IORING_OFF_CQ_RING);
+    if (r.cq_ptr == MAP_FAILED) {
+        LOGWARN("io_uring cq ring mmap failed for device={}, errno={}", devname, errno);
+        return false;
+    }
+    r.sqes_sz = up.sq_entries * sizeof(io_uring_sqe);
+    r.sqes = r_cast< io_uring_sqe* >(::mmap(nullptr, r.sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                            m_ring_fd, IORING_OFF_SQES));
+    if (voidptr_cast(r.sqes) == MAP_FAILED) {
+        LOGWARN("io_uring sqes mmap failed for device={}, errno={}", devname, errno);
+        return false;
+    }
+
+    auto* sq = r_cast< uint8_t* >(r.sq_ptr);
+    r.sq_head = r_cast< uint32_t* >(sq + up.sq_off.head);
+    r.sq_tail = r_cast< uint32_t* >(sq + up.sq_off.tail);
+    r.sq_flags = r_cast< uint32_t* >(sq + up.sq_off.flags);
+    r.sq_array = r_cast< uint32_t* >(sq + up.sq_off.array);
+    r.sq_mask = *r_cast< uint32_t* >(sq + up.sq_off.ring_mask);
+    r.sq_entries = *r_cast< uint32_t* >(sq + up.sq_off.ring_entries);
+
+    auto* cq = r_cast< uint8_t* >(r.cq_ptr);
+    r.cq_head = r_cast< uint32_t* >(cq + up.cq_off.head);
+    r.cq_tail = r_cast< uint32_t* >(cq + up.cq_off.tail);
+    r.cqes = r_cast< io_uring_cqe* >(cq + up.cq_off.cqes);
+    r.cq_mask = *r_cast< uint32_t* >(cq + up.cq_off.ring_mask);
+
+    if (uring_register(m_ring_fd, IORING_REGISTER_FILES, &m_dev_fd, 1) < 0) {
+        LOGWARN("io_uring register of device={} as fixed file failed, errno={}", devname, errno);
+        return false;
+    }
+    if (!setup_fixed_bufs()) {
+        LOGWARN("io_uring drive of device={} continues without fixed buffers, errno={}", devname, errno);
+    }
+
+    m_reaper = std::thread([this]() { reap_completions(); });
+    LOGINFO("io_uring drive opened for device={} queue_depth={} sqpoll={} fixed_buf_pool_size={}", devname,
+            r.sq_entries, m_params.sqpoll, m_fixed_bufs_size);
+    return true;
+}
+
+bool UringDrive::setup_fixed_bufs() {
+    auto const nslots = m_params.fixed_buf_pool_size / m_params.fixed_buf_size;
+    if (nslots == 0) { return true; }
+
+    auto const size = nslots * m_params.fixed_buf_size;
+    m_fixed_bufs = r_cast< uint8_t* >(std::aligned_alloc(m_params.buf_align, size));
+    if (m_fixed_bufs == nullptr) { return false; }
+
+    // Whole pool is registered as one buffer, any range within it could be used by a fixed op
+    iovec const iov{.iov_base = m_fixed_bufs, .iov_len = size};
+    if (uring_register(m_ring_fd, IORING_REGISTER_BUFFERS, &iov, 1) < 0) {
+        std::free(m_fixed_bufs);
+        m_fixed_bufs = nullptr;
+        return false;
+    }
+
+    m_fixed_bufs_size = size;
+    m_free_fixed_slots.reserve(nslots);
+    for (auto slot = nslots; slot > 0; --slot) {
+        m_free_fixed_slots.push_back(uint32_cast(slot - 1));
+    }
+    return true;
+}
+
+uint8_t* UringDrive::alloc_fixed_buf(uint32_t size) {
+    if ((m_fixed_bufs == nullptr) || (size > m_params.fixed_buf_size)) { return nullptr; }
+
+    std::unique_lock lg{m_fixed_buf_mtx};
+    if (m_free_fixed_slots.empty()) { return nullptr; }
+    auto const slot = m_free_fixed_slots.back();
+    m_free_fixed_slots.pop_back();
+    return m_fixed_bufs + (uint64_cast(slot) * m_params.fixed_buf_size);
+}
+
+void UringDrive::free_fixed_buf(uint8_t* buf) {
+    std::unique_lock lg{m_fixed_buf_mtx};
+    m_free_fixed_slots.push_back(uint32_cast((buf - m_fixed_bufs) / m_params.fixed_buf_size));
+}
+
+bool UringDrive::is_fixed_buf(void const* buf, uint64_t size) const {
+    auto const* p = r_cast< uint8_t const* >(buf);
+    return (m_fixed_bufs != nullptr) && (p >= m_fixed_bufs) && ((p + size) <= (m_fixed_bufs + m_fixed_bufs_size));
+}
+
+UringDrive::request* UringDrive::new_request() {
+    auto* req = new request();
+    req->done = request::on_done;
+    if (iomanager.am_i_io_reactor()) {
+        req->on_fiber = true;
+        req->fiber = iomanager.iofiber_self();
+    }
+    return req;
+}
+
+folly::Future< std::error_code > UringDrive::async_write(const char* data, uint32_t size, uint64_t offset,
+                                                         bool part_of_batch, uint8_t write_stream) {
+    auto* req = new_request();
+    auto f = req->promise.getFuture();
+    async_write(data, size, offset, req, part_of_batch, write_stream);
+    return f;
+}
+
+folly::Future< std::error_code > UringDrive::async_writev(const iovec* iov, int iovcnt, uint32_t size,
+                                                          uint64_t offset, bool part_of_batch, uint8_t write_stream) {
+    auto* req = new_request();
+    req->iovs.assign(iov, iov + iovcnt);
+    auto f = req->promise.getFuture();
+    async_writev(req->iovs.data(), iovcnt, size, offset, req, part_of_batch, write_stream);
+    return f;
+}
+
+folly::Future< std::error_code > UringDrive::async_read(char* data, uint32_t size, uint64_t offset,
+                                                        bool part_of_batch) {
+    auto* req = new_request();
+    auto f = req->promise.getFuture();
+    async_read(data, size, offset, req, part_of_batch);
+    return f;
+}
+
+folly::Future< std::error_code > UringDrive::async_readv(iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
+                                                         bool part_of_batch) {
+    auto* req = new_request();
+    req->iovs.assign(iov, iov + iovcnt);
+    auto f = req->promise.getFuture();
+    async_readv(req->iovs.data(), iovcnt, size, offset, req, part_of_batch);
+    return f;
+}
+
+void UringDrive::async_write(const char* data, uint32_t size, uint64_t offset, dev_io_req* req, bool part_of_batch,
+                             uint8_t write_stream) {
+    if (is_fixed_buf(data, size)) {
+        submit(IORING_OP_WRITE_FIXED, data, size, nullptr, 0, offset, req, part_of_batch, write_stream);
+        return;
+    }
+    req->iov = iovec{.iov_base = voidptr_cast(const_cast< char* >(data)), .iov_len = size};
+    submit(IORING_OP_WRITEV, nullptr, size, &req->iov, 1, offset, req, part_of_batch, write_stream);
+}
+
+void UringDrive::async_writev(const iovec* iov, int iovcnt, uint32_t size, uint64_t offset, dev_io_req* req,
+                              bool part_of_batch, uint8_t write_stream) {
+    if ((iovcnt == 1) && is_fixed_buf(iov[0].iov_base, iov[0].iov_len)) {
+        submit(IORING_OP_WRITE_FIXED, iov[0].iov_base, size, nullptr, 0, offset, req, part_of_batch, write_stream);
+        return;
+    }
+    submit(IORING_OP_WRITEV, nullptr, size, iov, iovcnt, offset, req, part_of_batch, write_stream);
+}
+
+void UringDrive::async_read(char* data, uint32_t size, uint64_t offset, dev_io_req* req, bool part_of_batch) {
+    if (is_fixed_buf(data, size)) {
+        submit(IORING_OP_READ_FIXED, data, size, nullptr, 0, offset, req, part_of_batch);
+        return;
+    }
+    req->iov = iovec{.iov_base = voidptr_cast(data), .iov_len = size};
+    submit(IORING_OP_READV, nullptr, size, &req->iov, 1, offset, req, part_of_batch);
+}
+
+void UringDrive::async_readv(iovec* iov, int iovcnt, uint32_t size, uint64_t offset, dev_io_req* req,
+                             bool part_of_batch) {
+    if ((iovcnt == 1) && is_fixed_buf(iov[0].iov_base, iov[0].iov_len)) {
+        submit(IORING_OP_READ_FIXED, iov[0].iov_base, size, nullptr, 0, offset, req, part_of_batch);
+        return;
+    }
+    submit(IORING_OP_READV, nullptr, size, iov, iovcnt, offset, req, part_of_batch);
+}
+
+void UringDrive::submit(uint8_t opcode, void const* buf, uint32_t size, iovec const* iov, int iovcnt, uint64_t offset,
+                        dev_io_req* req, bool part_of_batch, uint8_t write_stream) {
+    req->size = size;
+    m_outstanding_ios.fetch_add(1, std::memory_order_relaxed);
+
+    std::unique_lock lg{m_sq_mtx};
+    auto* sqe = get_sqe(lg);
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->fd = 0; // Index of the device in registered files
+    sqe->off = offset;
+    if (iovcnt > 0) {
+        sqe->addr = r_cast< uint64_t >(iov);
+        sqe->len = uint32_cast(iovcnt);
+    } else {
+        sqe->addr = r_cast< uint64_t >(buf);
+        sqe->len = size;
+        sqe->buf_index = 0;
+        m_fixed_ios.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Write stream is the first byte of the union at file_index, which is not named by older uapi headers
+    if (write_stream != 0) { r_cast< uint8_t* >(&sqe->file_index)[0] = write_stream; }
+    sqe->user_data = r_cast< uint64_t >(req);
+
+    if (!part_of_batch) { flush_sq(); }
+}
+
+io_uring_sqe* UringDrive::get_sqe(std::unique_lock< std::mutex >& lg) {
+    auto& r = *m_ring;
+    while (true) {
+        auto const tail = *r.sq_tail;
+        if ((tail - load_acquire(r.sq_head)) < r.sq_entries) {
+            auto const idx = tail & r.sq_mask;
+            r.sq_array[idx] = idx;
+            store_release(r.sq_tail, tail + 1);
+            ++m_unsubmitted;
+            return &r.sqes[idx];
+        }
+
+        // Queue is full of entries which are not yet consumed by kernel, push them and retry
+        flush_sq();
+        if ((*r.sq_tail - load_acquire(r.sq_head)) >= r.sq_entries) {
+            lg.unlock();
+            std::this_thread::yield();
+            lg.lock();
+        }
+    }
+}
+
+void UringDrive::flush_sq() {
+    if (m_unsubmitted == 0) { return; }
+
+    if (m_params.sqpoll) {
+        // Kernel thread picks up the entries by itself, unless it went idle
+        if (load_acquire(m_ring->sq_flags) & IORING_SQ_NEED_WAKEUP) {
+            uring_enter(m_ring_fd, 0, 0, IORING_ENTER_SQ_WAKEUP);
+        }
+        m_unsubmitted = 0;
+        return;
+    }
+
+    auto const ret = uring_enter(m_ring_fd, m_unsubmitted, 0, 0);
+    if (ret < 0) {
+        // Entries stay in the queue and are pushed along with next submit or once reaper frees up completions
+        HS_LOG_EVERY_N(WARN, device, 1000, "io_uring submit of {} entries failed, errno={}", m_unsubmitted, errno);
+        return;
+    }
+    m_unsubmitted -= std::min(m_unsubmitted, uint32_cast(ret));
+}
+
+void UringDrive::submit_batch() {
+    std::unique_lock lg{m_sq_mtx};
+    flush_sq();
+}
+
+void UringDrive::reap_completions() {
+    auto& r = *m_ring;
+    bool stop{false};
+    while (!stop) {
+        if ((uring_enter(m_ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0) && (errno != EINTR) && (errno != EAGAIN) &&
+            (errno != EBUSY)) {
+            LOGERROR("io_uring wait for completions failed, errno={}", errno);
+        }
+
+        auto head = *r.cq_head;
+        auto const tail = load_acquire(r.cq_tail);
+        while (head != tail) {
+            auto const& cqe = r.cqes[head & r.cq_mask];
+            auto const user_data = cqe.user_data;
+            auto const res = cqe.res;
+            store_release(r.cq_head, ++head);
+
+            if (user_data == 0) {
+                stop = m_stopping.load(std::memory_order_acquire);
+            } else {
+                complete(r_cast< dev_io_req* >(user_data), res);
+            }
+        }
+
+        // Push whatever is left in the queue, like the entries whose submit failed as completion queue was full
+        std::unique_lock lg{m_sq_mtx};
+        if (m_unsubmitted != 0) { flush_sq(); }
+    }
+}
+
+void UringDrive::complete(dev_io_req* req, int32_t res) {
+    std::error_code ec;
+    if (res < 0) {
+        ec = std::error_code{-res, std::system_category()};
+    } else if (uint32_cast(res) != req->size) {
+        ec = std::make_error_code(std::errc::io_error); // Short io on a block device is not expected with direct io
+    }
+    m_outstanding_ios.fetch_sub(1, std::memory_order_relaxed);
+    req->done(req, ec);
+}
+
+} // namespace homestore
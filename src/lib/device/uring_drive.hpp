@@ -0,0 +1,132 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+#include <sys/uio.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <folly/futures/Future.h>
+#include <homestore/homestore_decl.hpp>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace homestore {
+
+/*
+ * io_uring based data path of a physical device, owned by HomeStore instead of iomgr, for the vdevs which opt into it.
+ *
+ * Device is opened again and registered with the ring as a fixed file, so that the kernel does not have to look up and
+ * reference count the file on every IO. A pool of buffers owned by this drive is registered with the ring as well and
+ * IO on a buffer allocated from the pool uses the fixed buffer opcodes, which skip pinning the user pages per IO. IO
+ * on any other buffer is submitted as a regular vectored IO on the fixed file.
+ *
+ * Submissions are serialized by a lock, completions are reaped by a thread of the drive and delivered on the io fiber
+ * which submitted the IO, or on the reaper thread if IO was not submitted from an iomgr reactor. With sqpoll, a kernel
+ * thread polls the submission queue, saving the syscall on every submit at the cost of a core.
+ *
+ * IO could also be submitted with a caller owned dev_io_req instead of getting a future, in which case the drive does
+ * not allocate anything for it and the request is completed directly on the reaper thread.
+ */
+class UringDrive {
+public:
+    struct params {
+        uint32_t queue_depth{256};
+        bool sqpoll{false};
+        uint32_t sqpoll_idle_ms{10};
+        uint64_t fixed_buf_pool_size{0}; // 0 indicates no pool of fixed buffers
+        uint32_t fixed_buf_size{128 * 1024};
+        uint32_t buf_align{4096};
+    };
+
+    /// @brief Opens the device and sets up the ring. Returns nullptr on failure, like on kernels without io_uring.
+    static std::unique_ptr< UringDrive > make(std::string const& devname, int oflags, params const& p);
+
+    UringDrive(UringDrive const&) = delete;
+    UringDrive(UringDrive&&) noexcept = delete;
+    UringDrive& operator=(UringDrive const&) = delete;
+    UringDrive& operator=(UringDrive&&) noexcept = delete;
+    ~UringDrive();
+
+    // Writes are tagged with write_stream, if non zero, for the drive to place data of different lifetimes apart
+    folly::Future< std::error_code > async_write(const char* data, uint32_t size, uint64_t offset,
+                                                 bool part_of_batch = false, uint8_t write_stream = 0);
+    folly::Future< std::error_code > async_writev(const iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
+                                                  bool part_of_batch = false, uint8_t write_stream = 0);
+    folly::Future< std::error_code > async_read(char* data, uint32_t size, uint64_t offset, bool part_of_batch = false);
+    folly::Future< std::error_code > async_readv(iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
+                                                 bool part_of_batch = false);
+
+    // Callback based ios, on which only the iovec array of a vectored io, if any, has to stay valid till completion
+    void async_write(const char* data, uint32_t size, uint64_t offset, dev_io_req* req, bool part_of_batch = false,
+                     uint8_t write_stream = 0);
+    void async_writev(const iovec* iov, int iovcnt, uint32_t size, uint64_t offset, dev_io_req* req,
+                      bool part_of_batch = false, uint8_t write_stream = 0);
+    void async_read(char* data, uint32_t size, uint64_t offset, dev_io_req* req, bool part_of_batch = false);
+    void async_readv(iovec* iov, int iovcnt, uint32_t size, uint64_t offset, dev_io_req* req,
+                     bool part_of_batch = false);
+    void submit_batch();
+
+    /// @brief Allocates a buffer from the pool of fixed buffers, nullptr if pool is exhausted or size is larger than
+    /// params::fixed_buf_size, in which case caller is expected to fall back to its regular buffer.
+    uint8_t* alloc_fixed_buf(uint32_t size);
+    void free_fixed_buf(uint8_t* buf);
+    bool is_fixed_buf(void const* buf, uint64_t size) const;
+
+    bool is_sqpoll() const { return m_params.sqpoll; }
+    uint64_t fixed_ios() const { return m_fixed_ios.load(std::memory_order_relaxed); }
+    int64_t outstanding_ios() const { return m_outstanding_ios.load(std::memory_order_relaxed); }
+
+private:
+    struct ring;
+    struct request;
+
+    UringDrive(params const& p);
+    bool setup(std::string const& devname, int oflags);
+    bool setup_fixed_bufs();
+    static request* new_request();
+    void submit(uint8_t opcode, void const* buf, uint32_t size, iovec const* iov, int iovcnt, uint64_t offset,
+                dev_io_req* req, bool part_of_batch, uint8_t write_stream = 0);
+    io_uring_sqe* get_sqe(std::unique_lock< std::mutex >& lg);
+    void flush_sq();
+    void reap_completions();
+    void complete(dev_io_req* req, int32_t res);
+
+private:
+    params const m_params;
+    int m_dev_fd{-1};
+    int m_ring_fd{-1};
+    std::unique_ptr< ring > m_ring;
+
+    std::mutex m_sq_mtx;               // Serializes filling and submitting of submission queue entries
+    uint32_t m_unsubmitted{0};         // Enqueued by part_of_batch ios and yet to be submitted
+    std::atomic< bool > m_stopping{false};
+    std::atomic< int64_t > m_outstanding_ios{0};
+    std::thread m_reaper;
+
+    uint8_t* m_fixed_bufs{nullptr}; // Registered with the ring as a single fixed buffer and handed out in slots
+    uint64_t m_fixed_bufs_size{0};
+    std::mutex m_fixed_buf_mtx;
+    std::vector< uint32_t > m_free_fixed_slots;
+    std::atomic< uint64_t > m_fixed_ios{0};
+};
+
+} // namespace homestore
@@ -15,6 +15,7 @@
  *********************************************************************************/
 #include <array>
 #include <atomic>
+#include <bit>
 #include <chrono>
 #include <cstdint>
 #include <functional>
@@ -34,6 +35,8 @@
 #include <sisl/utility/atomic_counter.hpp>
 #include <iomgr/iomgr_flip.hpp>
 #include <homestore/homestore_decl.hpp>
+#include <homestore/homestore.hpp>
+#include <homestore/meta_service.hpp>
 
 #include "device/chunk.h"
 #include "device/physical_dev.hpp"
@@ -45,6 +48,10 @@
 #include "common/crash_simulator.hpp"
 #include "blkalloc/varsize_blk_allocator.h"
 #include "device/round_robin_chunk_selector.h"
+#include "device/random_chunk_selector.h"
+#include "device/most_available_space_chunk_selector.h"
+#include "device/load_aware_chunk_selector.h"
+#include "device/tenant_affine_chunk_selector.h"
 #include "blkalloc/append_blk_allocator.h"
 #include "blkalloc/fixed_blk_allocator.h"
 
@@ -55,7 +62,8 @@ namespace homestore {
 static std::shared_ptr< BlkAllocator > create_blk_allocator(blk_allocator_type_t btype, uint32_t vblock_size,
                                                             uint32_t ppage_sz, uint32_t align_sz, uint64_t size,
                                                             bool is_auto_recovery, uint32_t unique_id, bool is_init,
-                                                            bool use_slab_in_blk_allocator) {
+                                                            bool use_slab_in_blk_allocator,
+                                                            std::string const& vdev_sb_name) {
     switch (btype) {
     case blk_allocator_type_t::fixed: {
         BlkAllocConfig cfg{vblock_size, align_sz, size, is_auto_recovery,
@@ -76,7 +84,7 @@ static std::shared_ptr< BlkAllocator > create_blk_allocator(blk_allocator_type_t
     case blk_allocator_type_t::append: {
         BlkAllocConfig cfg{vblock_size, align_sz, size, false,
                            std::string("append_chunk_") + std::to_string(unique_id)};
-        return std::make_shared< AppendBlkAllocator >(cfg, is_init, unique_id);
+        return std::make_shared< AppendBlkAllocator >(cfg, is_init, unique_id, vdev_sb_name);
     }
     case blk_allocator_type_t::none:
     default:
@@ -94,12 +102,30 @@ VirtualDev::VirtualDev(DeviceManager& dmgr, vdev_info const& vinfo, vdev_event_c
         m_allocator_type{vinfo.alloc_type},
         m_chunk_selector_type{vinfo.chunk_sel_type},
         m_auto_recovery{is_auto_recovery},
-        m_use_slab_in_blk_allocator{vinfo.use_slab_allocator ? true : false} {
+        m_use_slab_in_blk_allocator{vinfo.use_slab_allocator ? true : false},
+        m_integrity_offload{vinfo.integrity_offload ? true : false},
+        m_read_only{hs()->is_read_only()} {
     switch (m_chunk_selector_type) {
     case chunk_selector_type_t::ROUND_ROBIN: {
         m_chunk_selector = std::make_shared< RoundRobinChunkSelector >(false /* dynamically add chunk */);
         break;
     }
+    case chunk_selector_type_t::RANDOM: {
+        m_chunk_selector = std::make_shared< RandomChunkSelector >(false /* dynamically add chunk */);
+        break;
+    }
+    case chunk_selector_type_t::MOST_AVAILABLE_SPACE: {
+        m_chunk_selector = std::make_shared< MostAvailableSpaceChunkSelector >(false /* dynamically add chunk */);
+        break;
+    }
+    case chunk_selector_type_t::LOAD_AWARE: {
+        m_chunk_selector = std::make_shared< LoadAwareChunkSelector >(false /* dynamically add chunk */);
+        break;
+    }
+    case chunk_selector_type_t::TENANT_AFFINE: {
+        m_chunk_selector = std::make_shared< TenantAffineChunkSelector >(false /* dynamically add chunk */);
+        break;
+    }
     case chunk_selector_type_t::CUSTOM: {
         HS_REL_ASSERT(custom_chunk_selector, "Expected custom chunk selector to be passed with selector_type=CUSTOM");
         m_chunk_selector = std::move(custom_chunk_selector);
@@ -111,19 +137,43 @@ VirtualDev::VirtualDev(DeviceManager& dmgr, vdev_info const& vinfo, vdev_event_c
     default:
         HS_DBG_ASSERT(false, "Chunk selector type {} not supported yet", m_chunk_selector_type);
     }
+
+    if (m_allocator_type == blk_allocator_type_t::append) {
+        // All append blk allocators of this vdev are persisted together in one superblk
+        m_append_sb.set_name("AppendBlkAllocVdev_" + m_name);
+        meta_service().register_handler(
+            m_append_sb.name(),
+            [this](meta_blk* mblk, sisl::byte_view buf, size_t size) {
+                on_append_sb_found(std::move(buf), (void*)mblk);
+            },
+            nullptr);
+    } else if ((m_allocator_type != blk_allocator_type_t::none) && HS_DYNAMIC_CONFIG(device->discard_freed_blks)) {
+        m_discarder = std::make_unique< BlkDiscarder >(m_dmgr, m_name, block_size(), m_metrics);
+    }
 }
 
-// TODO: Have an additional parameter for vdev to check if dynamic add chunk. If so, we need to take do an rcu for
-// m_all_chunks.
+// Chunks can be added while the vdev is in use, like when it is expanded onto a new pdev. The chunk selector takes them
+// without blocking its selections, and m_all_chunks is only read under m_mgmt_mutex outside of the startup.
 void VirtualDev::add_chunk(cshared< Chunk >& chunk, bool is_fresh_chunk) {
     std::unique_lock lg{m_mgmt_mutex};
+    if (is_mirrored()) { m_mirror_reads.try_emplace(chunk->physical_dev()); }
+    if (chunk->is_mirror()) {
+        // Mirror copies are written along with their primary chunk, so they have no blk allocator of their own
+        m_mirrors[chunk->primary_chunk_id()].push_back(chunk);
+        m_pdevs.insert(chunk->physical_dev_mutable());
+        if (m_use_uring) { chunk->physical_dev_mutable()->enable_uring(); }
+        return;
+    }
+
     auto ba = create_blk_allocator(m_allocator_type, block_size(), chunk->physical_dev()->optimal_page_size(),
                                    chunk->physical_dev()->align_size(), chunk->size(), m_auto_recovery,
-                                   chunk->chunk_id(), is_fresh_chunk, m_use_slab_in_blk_allocator);
+                                   chunk->chunk_id(), is_fresh_chunk, m_use_slab_in_blk_allocator,
+                                   m_append_sb.name());
     chunk->set_block_allocator(std::move(ba));
     // TODO: when vdev_ordinal is  used, revisit here to make sure it is set correctly;
     chunk->set_vdev_ordinal(m_total_chunk_num++);
     m_pdevs.insert(chunk->physical_dev_mutable());
+    if (m_use_uring) { chunk->physical_dev_mutable()->enable_uring(); }
     m_all_chunks[chunk->chunk_id()] = chunk;
     m_chunk_selector->add_chunk(chunk);
 }
@@ -139,11 +189,13 @@ folly::Future< std::error_code > VirtualDev::async_format() {
     static thread_local std::vector< folly::Future< std::error_code > > s_futs;
     s_futs.clear();
 
-    for (auto& [_, chunk] : m_all_chunks) {
-        auto* pdev = chunk->physical_dev_mutable();
-        LOGINFO("writing zero for chunk: {}, size: {}, offset: {}", chunk->chunk_id(), in_bytes(chunk->size()),
-                chunk->start_offset());
-        s_futs.emplace_back(pdev->async_write_zero(chunk->size(), chunk->start_offset()));
+    for (auto& [chunk_num, _] : m_all_chunks) {
+        for (auto* chunk : copies_of(chunk_num)) {
+            auto* pdev = chunk->physical_dev_mutable();
+            LOGINFO("writing zero for chunk: {}, size: {}, offset: {}", chunk->chunk_id(), in_bytes(chunk->size()),
+                    chunk->start_offset());
+            s_futs.emplace_back(pdev->async_write_zero(chunk->size(), chunk->start_offset()));
+        }
     }
     return folly::collectAllUnsafe(s_futs).thenTry([](auto&& t) {
         for (const auto& err_c : t.value()) {
@@ -272,6 +324,75 @@ BlkAllocStatus VirtualDev::alloc_blks(blk_count_t nblks, blk_alloc_hints const&
     return status;
 }
 
+BlkAllocStatus VirtualDev::alloc_blks(std::vector< blk_count_t > const& nblks_list, blk_alloc_hints const& hints,
+                                      std::vector< MultiBlkId >& out_blkids) {
+    auto const start_idx = out_blkids.size();
+    out_blkids.reserve(start_idx + nblks_list.size());
+
+    // Every request of the batch has to be satisfied in full, partial ones are discarded by alloc_blks_from_chunk
+    auto h = hints;
+    h.partial_alloc_ok = false;
+
+    uint64_t nblks_remain{0};
+    for (auto const nblks : nblks_list) {
+        nblks_remain += nblks;
+    }
+
+    BlkAllocStatus status{BlkAllocStatus::SUCCESS};
+    Chunk* chunk{nullptr};
+    if (hints.chunk_id_hint) {
+        chunk = m_dmgr.get_chunk_mutable(*(hints.chunk_id_hint));
+        if (!chunk) { return BlkAllocStatus::INVALID_DEV; }
+    }
+
+    try {
+        for (auto const nblks : nblks_list) {
+            auto& out_blkid = out_blkids.emplace_back();
+            size_t attempt{0};
+            do {
+                if (chunk == nullptr) {
+                    // Select chunk for what is remaining in the batch, so that it is likely to take rest of them too
+                    chunk = m_chunk_selector
+                                ->select_chunk(s_cast< blk_count_t >(std::min< uint64_t >(
+                                                   nblks_remain, std::numeric_limits< blk_count_t >::max())),
+                                               h)
+                                .get();
+                    if (chunk == nullptr) {
+                        status = BlkAllocStatus::SPACE_FULL;
+                        break;
+                    }
+                }
+
+                out_blkid = MultiBlkId{};
+                status = alloc_blks_from_chunk(nblks, h, out_blkid, chunk);
+                if ((status == BlkAllocStatus::SUCCESS) || hints.chunk_id_hint || !hints.can_look_for_other_chunk) {
+                    break;
+                }
+                chunk = nullptr; // This chunk can't serve the request, move the rest of the batch to another chunk
+            } while (++attempt < m_total_chunk_num);
+
+            if (status != BlkAllocStatus::SUCCESS) { break; }
+            nblks_remain -= nblks;
+        }
+    } catch (const std::exception& e) {
+        LOGERROR("exception happened {}", e.what());
+        assert(false);
+        status = BlkAllocStatus::FAILED;
+    }
+
+    if (status != BlkAllocStatus::SUCCESS) {
+        LOGERROR("batch of {} requests failed to alloc after {} of them are allocated, status={}", nblks_list.size(),
+                 out_blkids.size() - start_idx - 1, status);
+        COUNTER_INCREMENT(m_metrics, vdev_num_alloc_failure, 1);
+        // Last one is the failed request, which allocator has already released
+        for (auto i = start_idx; i + 1 < out_blkids.size(); ++i) {
+            free_blk(out_blkids[i]);
+        }
+        out_blkids.resize(start_idx);
+    }
+    return status;
+}
+
 BlkAllocStatus VirtualDev::alloc_blks_from_chunk(blk_count_t nblks, blk_alloc_hints const& hints, MultiBlkId& out_blkid,
                                                  Chunk* chunk) {
 #ifdef _PRERELEASE
@@ -323,8 +444,335 @@ uint64_t VirtualDev::get_len(const iovec* iov, int iovcnt) {
     return len;
 }
 
+////////////////////////// mirrored io section //////////////////////////////////
+VirtualDev::copies_t VirtualDev::copies_of(uint16_t chunk_num) const {
+    // Primary is missing if its pdev is, in which case the blks are still on its mirrors
+    copies_t copies;
+    if (auto* chunk = m_dmgr.get_chunk_mutable(chunk_num)) { copies.push_back(chunk); }
+    if (auto it = m_mirrors.find(chunk_num); it != m_mirrors.cend()) {
+        for (auto const& mirror : it->second) {
+            copies.push_back(mirror.get());
+        }
+    }
+    return copies;
+}
+
+uint32_t VirtualDev::latest_gen(const copies_t& copies) {
+    uint32_t gen{0};
+    for (auto const* chunk : copies) {
+        gen = std::max(gen, chunk->mirror_gen());
+    }
+    return gen;
+}
+
+size_t VirtualDev::pick_copy(const copies_t& copies, uint32_t tried_mask) const {
+    // Copies which missed writes are never read. Copies on a sick pdev are read only if all the copies not yet tried
+    // are on sick pdevs.
+    size_t picked{copies.size()};
+    bool picked_sick{true};
+    uint32_t min_reads{std::numeric_limits< uint32_t >::max()};
+    auto const gen = latest_gen(copies);
+    for (size_t i{0}; i < copies.size(); ++i) {
+        if ((tried_mask & (1u << i)) || (copies[i]->mirror_gen() < gen)) { continue; }
+        auto const* pdev = copies[i]->physical_dev();
+        auto it = m_mirror_reads.find(pdev);
+        auto const reads = (it == m_mirror_reads.cend()) ? 0u : it->second.load(std::memory_order_relaxed);
+        auto const sick = pdev->is_sick();
+        if ((picked_sick && !sick) || ((sick == picked_sick) && (reads < min_reads))) {
+            picked_sick = sick;
+            min_reads = reads;
+            picked = i;
+        }
+    }
+    return picked;
+}
+
+// Copies present are moved to a new generation ahead of the missing ones, before the first write which misses them
+void VirtualDev::mark_degraded_write(uint16_t chunk_num, const copies_t& copies) {
+    COUNTER_INCREMENT(m_metrics, vdev_mirror_degraded_write_count, 1);
+    std::unique_lock lg{m_mirror_gen_mutex};
+    if (m_degraded_chunks.contains(chunk_num)) { return; }
+
+    auto const gen = latest_gen(copies);
+    for (auto* chunk : copies) {
+        // Copies which are already stale stay behind
+        if (chunk->mirror_gen() == gen) { chunk->set_mirror_gen(gen + 1); }
+    }
+    m_degraded_chunks.insert(chunk_num);
+    HS_LOG(INFO, device, "Copies of chunk={} of vdev={} are written without {} of the mirrors, moved to gen={}",
+           chunk_num, m_name, num_mirrors() - copies.size(), gen + 1);
+}
+
+uint32_t VirtualDev::num_stale_mirrors() const {
+    if (!is_mirrored()) { return 0; }
+    uint32_t n{0};
+    std::unique_lock lg{m_mgmt_mutex};
+    for (auto const& [chunk_num, _] : m_mirrors) {
+        auto const copies = copies_of(chunk_num);
+        auto const gen = latest_gen(copies);
+        n += std::count_if(copies.begin(), copies.end(), [gen](Chunk const* c) { return c->mirror_gen() < gen; });
+    }
+    return n;
+}
+
+std::error_code VirtualDev::resync_mirrors() {
+    if (!is_mirrored()) { return std::error_code{}; }
+    static constexpr uint32_t resync_io_size{1024 * 1024};
+
+    std::error_code ret;
+    std::unique_lock lg{m_mgmt_mutex};
+    for (auto const& [chunk_num, _] : m_mirrors) {
+        auto const copies = copies_of(chunk_num);
+        auto const gen = latest_gen(copies);
+        auto const src =
+            std::find_if(copies.begin(), copies.end(), [gen](Chunk const* c) { return (c->mirror_gen() == gen); });
+        for (auto* chunk : copies) {
+            if (chunk->mirror_gen() == gen) { continue; }
+            HS_LOG(INFO, device, "Resyncing chunk={} of vdev={} on pdev={} from the copy on pdev={}", chunk_num,
+                   m_name, chunk->physical_dev()->get_devname(), (*src)->physical_dev()->get_devname());
+
+            auto* buf =
+                hs_utils::iobuf_alloc(resync_io_size, sisl::buftag::common, chunk->physical_dev()->align_size());
+            std::error_code ec;
+            for (uint64_t off{0}; !ec && (off < chunk->size()); off += resync_io_size) {
+                auto const size = uint32_cast(std::min(uint64_cast(resync_io_size), chunk->size() - off));
+                ec = (*src)->physical_dev_mutable()->sync_read(r_cast< char* >(buf), size,
+                                                               (*src)->start_offset() + off);
+                if (!ec) {
+                    ec = chunk->physical_dev_mutable()->sync_write(r_cast< const char* >(buf), size,
+                                                                   chunk->start_offset() + off);
+                }
+            }
+            hs_utils::iobuf_free(buf, sisl::buftag::common);
+
+            if (ec) {
+                LOGERROR("Resync of chunk={} of vdev={} on pdev={} failed with error={}", chunk_num, m_name,
+                         chunk->physical_dev()->get_devname(), ec.message());
+                if (!ret) { ret = ec; }
+                continue;
+            }
+            chunk->set_mirror_gen(gen);
+        }
+    }
+    return ret;
+}
+
+template < typename WriteFn >
+folly::Future< std::error_code > VirtualDev::mirrored_write(uint16_t chunk_num, uint64_t offset_in_chunk,
+                                                            WriteFn&& write_fn) {
+    auto const copies = copies_of(chunk_num);
+    if (sisl_unlikely(copies.empty())) {
+        return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::resource_unavailable_try_again));
+    }
+    COUNTER_INCREMENT(m_metrics, vdev_write_count, 1);
+    if (copies.size() < num_mirrors()) { mark_degraded_write(chunk_num, copies); }
+
+    std::vector< folly::Future< std::error_code > > futs;
+    futs.reserve(copies.size());
+    for (auto* chunk : copies) {
+        futs.emplace_back(write_fn(chunk->physical_dev_mutable(), chunk->start_offset() + offset_in_chunk));
+    }
+    return folly::collectAllUnsafe(futs).thenValue([](auto&& results) {
+        for (auto const& r : results) {
+            if (r.hasException()) { return std::make_error_code(std::errc::io_error); }
+            if (r.value()) { return r.value(); }
+        }
+        return std::error_code{};
+    });
+}
+
+namespace {
+struct mirror_write_ctx;
+
+// Write of one copy, which completes the caller's req once all copies are written, with the first error if any
+struct mirror_write_req : public dev_io_req {
+    mirror_write_ctx* ctx{nullptr};
+    static void on_done(dev_io_req* r, std::error_code ec);
+};
+
+// Reqs of the copies are allocated along with their context, which is freed by the completion of the last one
+struct mirror_write_ctx {
+    dev_io_req* orig_req{nullptr};
+    std::atomic< uint32_t > pending{0};
+    std::mutex mtx;
+    std::error_code ec;
+    folly::small_vector< mirror_write_req, 4 > reqs;
+};
+
+void mirror_write_req::on_done(dev_io_req* r, std::error_code ec) {
+    auto* ctx = static_cast< mirror_write_req* >(r)->ctx;
+    if (ec) {
+        std::unique_lock lg{ctx->mtx};
+        if (!ctx->ec) { ctx->ec = ec; }
+    }
+    if (ctx->pending.fetch_sub(1) == 1) {
+        auto* orig_req = ctx->orig_req;
+        auto const err = ctx->ec;
+        delete ctx;
+        orig_req->done(orig_req, err);
+    }
+}
+} // namespace
+
+template < typename WriteFn >
+void VirtualDev::mirrored_write(uint16_t chunk_num, uint64_t offset_in_chunk, dev_io_req* req, WriteFn&& write_fn) {
+    auto const copies = copies_of(chunk_num);
+    if (sisl_unlikely(copies.empty())) {
+        req->done(req, std::make_error_code(std::errc::resource_unavailable_try_again));
+        return;
+    }
+    COUNTER_INCREMENT(m_metrics, vdev_write_count, 1);
+    if (copies.size() < num_mirrors()) { mark_degraded_write(chunk_num, copies); }
+
+    auto* ctx = new mirror_write_ctx{};
+    ctx->orig_req = req;
+    ctx->pending.store(uint32_cast(copies.size()));
+    ctx->reqs.resize(copies.size());
+    for (size_t i{0}; i < copies.size(); ++i) {
+        auto& copy_req = ctx->reqs[i];
+        copy_req.done = mirror_write_req::on_done;
+        copy_req.size = req->size;
+        copy_req.ctx = ctx;
+    }
+    for (size_t i{0}; i < copies.size(); ++i) {
+        write_fn(copies[i]->physical_dev_mutable(), copies[i]->start_offset() + offset_in_chunk, &ctx->reqs[i]);
+    }
+}
+
+template < typename WriteFn >
+std::error_code VirtualDev::mirrored_sync_write(uint16_t chunk_num, uint64_t offset_in_chunk, WriteFn&& write_fn) {
+    auto const copies = copies_of(chunk_num);
+    if (sisl_unlikely(copies.empty())) { return std::make_error_code(std::errc::resource_unavailable_try_again); }
+    COUNTER_INCREMENT(m_metrics, vdev_write_count, 1);
+    if (copies.size() < num_mirrors()) { mark_degraded_write(chunk_num, copies); }
+
+    std::error_code ret;
+    for (auto* chunk : copies) {
+        auto const ec = write_fn(chunk->physical_dev_mutable(), chunk->start_offset() + offset_in_chunk);
+        if (ec && !ret) { ret = ec; }
+    }
+    return ret;
+}
+
+template < typename ReadFn >
+folly::Future< std::error_code > VirtualDev::mirrored_read(uint16_t chunk_num, uint64_t offset_in_chunk,
+                                                           ReadFn read_fn, bool part_of_batch, uint32_t tried_mask) {
+    auto const copies = copies_of(chunk_num);
+    auto const idx = pick_copy(copies, tried_mask);
+    if (sisl_unlikely(idx == copies.size())) {
+        return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::resource_unavailable_try_again));
+    }
+
+    auto* pdev = copies[idx]->physical_dev_mutable();
+    auto& reads = m_mirror_reads.find(pdev)->second;
+    reads.fetch_add(1, std::memory_order_relaxed);
+    return read_fn(pdev, copies[idx]->start_offset() + offset_in_chunk, part_of_batch)
+        .thenValue([this, &reads, chunk_num, offset_in_chunk, read_fn, tried_mask = tried_mask | (1u << idx),
+                    ncopies = copies.size()](std::error_code ec) mutable {
+            reads.fetch_sub(1, std::memory_order_relaxed);
+            if (!ec || (size_t(std::popcount(tried_mask)) >= ncopies)) {
+                return folly::makeFuture< std::error_code >(std::move(ec));
+            }
+            COUNTER_INCREMENT(m_metrics, vdev_mirror_read_failover_count, 1);
+            HS_LOG(DEBUG, device, "Read of chunk={} offset={} of vdev={} failed with error={}, trying another mirror",
+                   chunk_num, offset_in_chunk, m_name, ec.message());
+            return mirrored_read(chunk_num, offset_in_chunk, std::move(read_fn), false /* part_of_batch */,
+                                 tried_mask);
+        });
+}
+
+// Read of a copy, which is retried on the next copy on error, before completing the caller's req
+struct VirtualDev::mirror_read_req : public dev_io_req {
+    VirtualDev* vdev;
+    dev_io_req* orig_req;
+    uint16_t chunk_num;
+    uint64_t offset_in_chunk;
+    read_req_fn_t read_fn;
+    uint32_t tried_mask{0};
+    size_t ncopies{0};
+    std::atomic< uint32_t >* reads{nullptr}; // Outstanding reads of the pdev this is issued to
+};
+
+void VirtualDev::mirrored_read(uint16_t chunk_num, uint64_t offset_in_chunk, dev_io_req* req, read_req_fn_t&& read_fn,
+                               bool part_of_batch) {
+    auto* mreq = new mirror_read_req{};
+    mreq->done = on_mirror_read_done;
+    mreq->size = req->size;
+    mreq->vdev = this;
+    mreq->orig_req = req;
+    mreq->chunk_num = chunk_num;
+    mreq->offset_in_chunk = offset_in_chunk;
+    mreq->read_fn = std::move(read_fn);
+
+    auto const copies = copies_of(chunk_num);
+    auto const idx = pick_copy(copies, mreq->tried_mask);
+    if (sisl_unlikely(idx == copies.size())) {
+        delete mreq;
+        req->done(req, std::make_error_code(std::errc::resource_unavailable_try_again));
+        return;
+    }
+    auto* pdev = copies[idx]->physical_dev_mutable();
+    mreq->tried_mask |= (1u << idx);
+    mreq->ncopies = copies.size();
+    mreq->reads = &m_mirror_reads.find(pdev)->second;
+    mreq->reads->fetch_add(1, std::memory_order_relaxed);
+    mreq->read_fn(pdev, copies[idx]->start_offset() + offset_in_chunk, mreq, part_of_batch);
+}
+
+void VirtualDev::on_mirror_read_done(dev_io_req* req, std::error_code ec) {
+    auto* mreq = static_cast< mirror_read_req* >(req);
+    auto* vdev = mreq->vdev;
+    mreq->reads->fetch_sub(1, std::memory_order_relaxed);
+
+    if (ec && (size_t(std::popcount(mreq->tried_mask)) < mreq->ncopies)) {
+        auto const copies = vdev->copies_of(mreq->chunk_num);
+        auto const idx = vdev->pick_copy(copies, mreq->tried_mask);
+        if (idx != copies.size()) {
+            COUNTER_INCREMENT(vdev->m_metrics, vdev_mirror_read_failover_count, 1);
+            HS_LOG(DEBUG, device, "Read of chunk={} offset={} of vdev={} failed with error={}, trying another mirror",
+                   mreq->chunk_num, mreq->offset_in_chunk, vdev->m_name, ec.message());
+            auto* pdev = copies[idx]->physical_dev_mutable();
+            mreq->tried_mask |= (1u << idx);
+            mreq->reads = &vdev->m_mirror_reads.find(pdev)->second;
+            mreq->reads->fetch_add(1, std::memory_order_relaxed);
+            mreq->read_fn(pdev, copies[idx]->start_offset() + mreq->offset_in_chunk, mreq, false /* part_of_batch */);
+            return;
+        }
+    }
+
+    auto* orig_req = mreq->orig_req;
+    delete mreq;
+    orig_req->done(orig_req, ec);
+}
+
+template < typename ReadFn >
+std::error_code VirtualDev::mirrored_sync_read(uint16_t chunk_num, uint64_t offset_in_chunk, ReadFn&& read_fn) {
+    auto const copies = copies_of(chunk_num);
+    std::error_code ec = std::make_error_code(std::errc::resource_unavailable_try_again);
+    uint32_t tried_mask{0};
+    for (auto idx = pick_copy(copies, tried_mask); idx != copies.size(); idx = pick_copy(copies, tried_mask)) {
+        if (tried_mask) { COUNTER_INCREMENT(m_metrics, vdev_mirror_read_failover_count, 1); }
+        tried_mask |= (1u << idx);
+        auto* pdev = copies[idx]->physical_dev_mutable();
+        auto& reads = m_mirror_reads.find(pdev)->second;
+        reads.fetch_add(1, std::memory_order_relaxed);
+        ec = read_fn(pdev, copies[idx]->start_offset() + offset_in_chunk);
+        reads.fetch_sub(1, std::memory_order_relaxed);
+        if (!ec) { break; }
+    }
+    return ec;
+}
+
 // for all writes functions, we don't expect to get invalid dev_offset, since we will never allocate blkid from missing
 // chunk(missing pdev);
+// Writes of a read only open are completed without reaching the devices, as the writes of a crashed simulation are.
+// Services keep their writes off a read only open, except for the writes of their recovery, like the superblks.
+bool VirtualDev::drop_write() {
+    if (!m_read_only) { return false; }
+    COUNTER_INCREMENT(m_metrics, vdev_dropped_write_count, 1);
+    return true;
+}
+
 ////////////////////////// async write section //////////////////////////////////
 folly::Future< std::error_code > VirtualDev::async_write(const char* buf, uint32_t size, BlkId const& bid,
                                                          bool part_of_batch) {
@@ -333,6 +781,13 @@ folly::Future< std::error_code > VirtualDev::async_write(const char* buf, uint32
 #ifdef _PRERELEASE
     if (hs()->crash_simulator().is_crashed()) { return folly::makeFuture< std::error_code >(std::error_code()); }
 #endif
+    if (drop_write()) { return folly::makeFuture< std::error_code >(std::error_code()); }
+
+    if (is_mirrored()) {
+        return mirrored_write(bid.chunk_num(), to_chunk_offset(bid), [&](PhysicalDev* pdev, uint64_t dev_offset) {
+            return pdev->async_write(buf, size, dev_offset, part_of_batch, m_use_uring, m_vdev_info.placement);
+        });
+    }
 
     Chunk* chunk;
     uint64_t const dev_offset = to_dev_offset(bid, &chunk);
@@ -347,7 +802,7 @@ folly::Future< std::error_code > VirtualDev::async_write(const char* buf, uint32
     if (sisl_unlikely(!hs_utils::mod_aligned_sz(dev_offset, pdev->align_size()))) {
         COUNTER_INCREMENT(m_metrics, unalign_writes, 1);
     }
-    return pdev->async_write(buf, size, dev_offset, part_of_batch);
+    return pdev->async_write(buf, size, dev_offset, part_of_batch, m_use_uring, m_vdev_info.placement);
 }
 
 folly::Future< std::error_code > VirtualDev::async_write(const char* buf, uint32_t size, cshared< Chunk >& chunk,
@@ -355,6 +810,14 @@ folly::Future< std::error_code > VirtualDev::async_write(const char* buf, uint32
 #ifdef _PRERELEASE
     if (hs()->crash_simulator().is_crashed()) { return folly::makeFuture< std::error_code >(std::error_code()); }
 #endif
+    if (drop_write()) { return folly::makeFuture< std::error_code >(std::error_code()); }
+
+    if (is_mirrored()) {
+        return mirrored_write(chunk->chunk_id(), offset_in_chunk, [&](PhysicalDev* pdev, uint64_t dev_offset) {
+            return pdev->async_write(buf, size, dev_offset, false /* part_of_batch */, m_use_uring,
+                                     m_vdev_info.placement);
+        });
+    }
 
     if (sisl_unlikely(!is_chunk_available(chunk))) {
         return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::resource_unavailable_try_again));
@@ -367,7 +830,7 @@ folly::Future< std::error_code > VirtualDev::async_write(const char* buf, uint32
     if (sisl_unlikely(!hs_utils::mod_aligned_sz(dev_offset, pdev->align_size()))) {
         COUNTER_INCREMENT(m_metrics, unalign_writes, 1);
     }
-    return pdev->async_write(buf, size, dev_offset, false /* part_of_batch */);
+    return pdev->async_write(buf, size, dev_offset, false /* part_of_batch */, m_use_uring, m_vdev_info.placement);
 }
 
 folly::Future< std::error_code > VirtualDev::async_writev(const iovec* iov, const int iovcnt, BlkId const& bid,
@@ -376,6 +839,15 @@ folly::Future< std::error_code > VirtualDev::async_writev(const iovec* iov, cons
 #ifdef _PRERELEASE
     if (hs()->crash_simulator().is_crashed()) { return folly::makeFuture< std::error_code >(std::error_code()); }
 #endif
+    if (drop_write()) { return folly::makeFuture< std::error_code >(std::error_code()); }
+
+    if (is_mirrored()) {
+        auto const size = get_len(iov, iovcnt);
+        return mirrored_write(bid.chunk_num(), to_chunk_offset(bid), [&](PhysicalDev* pdev, uint64_t dev_offset) {
+            return pdev->async_writev(iov, iovcnt, size, dev_offset, part_of_batch, m_use_uring,
+                                      m_vdev_info.placement);
+        });
+    }
 
     Chunk* chunk;
     uint64_t const dev_offset = to_dev_offset(bid, &chunk);
@@ -390,7 +862,84 @@ folly::Future< std::error_code > VirtualDev::async_writev(const iovec* iov, cons
     if (sisl_unlikely(!hs_utils::mod_aligned_sz(dev_offset, pdev->align_size()))) {
         COUNTER_INCREMENT(m_metrics, unalign_writes, 1);
     }
-    return pdev->async_writev(iov, iovcnt, size, dev_offset, part_of_batch);
+    return pdev->async_writev(iov, iovcnt, size, dev_offset, part_of_batch, m_use_uring, m_vdev_info.placement);
+}
+
+void VirtualDev::async_write(const char* buf, uint32_t size, BlkId const& bid, dev_io_req* req, bool part_of_batch) {
+    HS_DBG_ASSERT_EQ(bid.is_multi(), false, "async_write needs individual pieces of blkid - not MultiBlkid");
+#ifdef _PRERELEASE
+    if (hs()->crash_simulator().is_crashed()) {
+        req->done(req, std::error_code{});
+        return;
+    }
+#endif
+    if (drop_write()) {
+        req->done(req, std::error_code{});
+        return;
+    }
+
+    if (is_mirrored()) {
+        mirrored_write(bid.chunk_num(), to_chunk_offset(bid), req,
+                       [&](PhysicalDev* pdev, uint64_t dev_offset, dev_io_req* r) {
+                           pdev->async_write(buf, size, dev_offset, r, part_of_batch, m_use_uring,
+                                             m_vdev_info.placement);
+                       });
+        return;
+    }
+
+    Chunk* chunk;
+    uint64_t const dev_offset = to_dev_offset(bid, &chunk);
+    if (sisl_unlikely(dev_offset == INVALID_DEV_OFFSET)) {
+        req->done(req, std::make_error_code(std::errc::resource_unavailable_try_again));
+        return;
+    }
+    auto* pdev = chunk->physical_dev_mutable();
+
+    HS_LOG(TRACE, device, "Writing in device: {}, offset = {}, size ={}", pdev->pdev_id(), dev_offset, size);
+    COUNTER_INCREMENT(m_metrics, vdev_write_count, 1);
+    if (sisl_unlikely(!hs_utils::mod_aligned_sz(dev_offset, pdev->align_size()))) {
+        COUNTER_INCREMENT(m_metrics, unalign_writes, 1);
+    }
+    pdev->async_write(buf, size, dev_offset, req, part_of_batch, m_use_uring, m_vdev_info.placement);
+}
+
+void VirtualDev::async_writev(const iovec* iov, int iovcnt, uint32_t size, BlkId const& bid, dev_io_req* req,
+                              bool part_of_batch) {
+    HS_DBG_ASSERT_EQ(bid.is_multi(), false, "async_writev needs individual pieces of blkid - not MultiBlkid");
+#ifdef _PRERELEASE
+    if (hs()->crash_simulator().is_crashed()) {
+        req->done(req, std::error_code{});
+        return;
+    }
+#endif
+    if (drop_write()) {
+        req->done(req, std::error_code{});
+        return;
+    }
+
+    if (is_mirrored()) {
+        mirrored_write(bid.chunk_num(), to_chunk_offset(bid), req,
+                       [&](PhysicalDev* pdev, uint64_t dev_offset, dev_io_req* r) {
+                           pdev->async_writev(iov, iovcnt, size, dev_offset, r, part_of_batch, m_use_uring,
+                                              m_vdev_info.placement);
+                       });
+        return;
+    }
+
+    Chunk* chunk;
+    uint64_t const dev_offset = to_dev_offset(bid, &chunk);
+    if (sisl_unlikely(dev_offset == INVALID_DEV_OFFSET)) {
+        req->done(req, std::make_error_code(std::errc::resource_unavailable_try_again));
+        return;
+    }
+    auto* pdev = chunk->physical_dev_mutable();
+
+    HS_LOG(TRACE, device, "Writing in device: {}, offset = {}, size ={}", pdev->pdev_id(), dev_offset, size);
+    COUNTER_INCREMENT(m_metrics, vdev_write_count, 1);
+    if (sisl_unlikely(!hs_utils::mod_aligned_sz(dev_offset, pdev->align_size()))) {
+        COUNTER_INCREMENT(m_metrics, unalign_writes, 1);
+    }
+    pdev->async_writev(iov, iovcnt, size, dev_offset, req, part_of_batch, m_use_uring, m_vdev_info.placement);
 }
 
 folly::Future< std::error_code > VirtualDev::async_writev(const iovec* iov, const int iovcnt, cshared< Chunk >& chunk,
@@ -398,6 +947,15 @@ folly::Future< std::error_code > VirtualDev::async_writev(const iovec* iov, cons
 #ifdef _PRERELEASE
     if (hs()->crash_simulator().is_crashed()) { return folly::makeFuture< std::error_code >(std::error_code()); }
 #endif
+    if (drop_write()) { return folly::makeFuture< std::error_code >(std::error_code()); }
+
+    if (is_mirrored()) {
+        auto const size = get_len(iov, iovcnt);
+        return mirrored_write(chunk->chunk_id(), offset_in_chunk, [&](PhysicalDev* pdev, uint64_t dev_offset) {
+            return pdev->async_writev(iov, iovcnt, size, dev_offset, false /* part_of_batch */, m_use_uring,
+                                      m_vdev_info.placement);
+        });
+    }
 
     if (sisl_unlikely(!is_chunk_available(chunk))) {
         return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::resource_unavailable_try_again));
@@ -411,7 +969,8 @@ folly::Future< std::error_code > VirtualDev::async_writev(const iovec* iov, cons
     if (sisl_unlikely(!hs_utils::mod_aligned_sz(dev_offset, pdev->align_size()))) {
         COUNTER_INCREMENT(m_metrics, unalign_writes, 1);
     }
-    return pdev->async_writev(iov, iovcnt, size, dev_offset, false /* part_of_batch */);
+    return pdev->async_writev(iov, iovcnt, size, dev_offset, false /* part_of_batch */, m_use_uring,
+                              m_vdev_info.placement);
 }
 
 ////////////////////////// sync write section //////////////////////////////////
@@ -419,9 +978,16 @@ std::error_code VirtualDev::sync_write(const char* buf, uint32_t size, BlkId con
 #ifdef _PRERELEASE
     if (hs()->crash_simulator().is_crashed()) { return std::error_code{}; }
 #endif
+    if (drop_write()) { return std::error_code{}; }
 
     HS_DBG_ASSERT_EQ(bid.is_multi(), false, "sync_write needs individual pieces of blkid - not MultiBlkid");
 
+    if (is_mirrored()) {
+        return mirrored_sync_write(bid.chunk_num(), to_chunk_offset(bid), [&](PhysicalDev* pdev, uint64_t dev_offset) {
+            return pdev->sync_write(buf, size, dev_offset);
+        });
+    }
+
     Chunk* chunk;
     uint64_t const dev_offset = to_dev_offset(bid, &chunk);
     if (sisl_unlikely(dev_offset == INVALID_DEV_OFFSET)) {
@@ -435,6 +1001,13 @@ std::error_code VirtualDev::sync_write(const char* buf, uint32_t size, cshared<
 #ifdef _PRERELEASE
     if (hs()->crash_simulator().is_crashed()) { return std::error_code{}; }
 #endif
+    if (drop_write()) { return std::error_code{}; }
+
+    if (is_mirrored()) {
+        return mirrored_sync_write(chunk->chunk_id(), offset_in_chunk, [&](PhysicalDev* pdev, uint64_t dev_offset) {
+            return pdev->sync_write(buf, size, dev_offset);
+        });
+    }
 
     if (sisl_unlikely(!is_chunk_available(chunk))) {
         return std::make_error_code(std::errc::resource_unavailable_try_again);
@@ -448,6 +1021,14 @@ std::error_code VirtualDev::sync_writev(const iovec* iov, int iovcnt, BlkId cons
 #ifdef _PRERELEASE
     if (hs()->crash_simulator().is_crashed()) { return std::error_code{}; }
 #endif
+    if (drop_write()) { return std::error_code{}; }
+
+    if (is_mirrored()) {
+        auto const size = get_len(iov, iovcnt);
+        return mirrored_sync_write(bid.chunk_num(), to_chunk_offset(bid), [&](PhysicalDev* pdev, uint64_t dev_offset) {
+            return pdev->sync_writev(iov, iovcnt, size, dev_offset);
+        });
+    }
 
     Chunk* chunk;
     uint64_t const dev_offset = to_dev_offset(bid, &chunk);
@@ -470,6 +1051,14 @@ std::error_code VirtualDev::sync_writev(const iovec* iov, int iovcnt, cshared< C
 #ifdef _PRERELEASE
     if (hs()->crash_simulator().is_crashed()) { return std::error_code{}; }
 #endif
+    if (drop_write()) { return std::error_code{}; }
+
+    if (is_mirrored()) {
+        auto const size = get_len(iov, iovcnt);
+        return mirrored_sync_write(chunk->chunk_id(), offset_in_chunk, [&](PhysicalDev* pdev, uint64_t dev_offset) {
+            return pdev->sync_writev(iov, iovcnt, size, dev_offset);
+        });
+    }
 
     if (sisl_unlikely(!is_chunk_available(chunk))) {
         return std::make_error_code(std::errc::resource_unavailable_try_again);
@@ -494,30 +1083,100 @@ folly::Future< std::error_code > VirtualDev::async_read(char* buf, uint64_t size
                                                         bool part_of_batch) {
     HS_DBG_ASSERT_EQ(bid.is_multi(), false, "async_read needs individual pieces of blkid - not MultiBlkid");
 
+    if (is_mirrored()) {
+        return mirrored_read(
+            bid.chunk_num(), to_chunk_offset(bid),
+            [this, buf, size](PhysicalDev* pdev, uint64_t dev_offset, bool batch) {
+                return pdev->async_read(buf, size, dev_offset, batch, m_use_uring);
+            },
+            part_of_batch);
+    }
+
     Chunk* pchunk;
     uint64_t const dev_offset = to_dev_offset(bid, &pchunk);
     if (sisl_unlikely(dev_offset == INVALID_DEV_OFFSET)) {
         return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::resource_unavailable_try_again));
     }
-    return pchunk->physical_dev_mutable()->async_read(buf, size, dev_offset, part_of_batch);
+    return pchunk->physical_dev_mutable()->async_read(buf, size, dev_offset, part_of_batch, m_use_uring);
 }
 
 folly::Future< std::error_code > VirtualDev::async_readv(iovec* iovs, int iovcnt, uint64_t size, BlkId const& bid,
                                                          bool part_of_batch) {
     HS_DBG_ASSERT_EQ(bid.is_multi(), false, "async_readv needs individual pieces of blkid - not MultiBlkid");
 
+    if (is_mirrored()) {
+        return mirrored_read(
+            bid.chunk_num(), to_chunk_offset(bid),
+            [this, iovs, iovcnt, size](PhysicalDev* pdev, uint64_t dev_offset, bool batch) {
+                return pdev->async_readv(iovs, iovcnt, size, dev_offset, batch, m_use_uring);
+            },
+            part_of_batch);
+    }
+
     Chunk* pchunk;
     uint64_t const dev_offset = to_dev_offset(bid, &pchunk);
     if (sisl_unlikely(dev_offset == INVALID_DEV_OFFSET)) {
         return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::resource_unavailable_try_again));
     }
-    return pchunk->physical_dev_mutable()->async_readv(iovs, iovcnt, size, dev_offset, part_of_batch);
+    return pchunk->physical_dev_mutable()->async_readv(iovs, iovcnt, size, dev_offset, part_of_batch,
+                                                       m_use_uring);
+}
+
+void VirtualDev::async_read(char* buf, uint32_t size, BlkId const& bid, dev_io_req* req, bool part_of_batch) {
+    HS_DBG_ASSERT_EQ(bid.is_multi(), false, "async_read needs individual pieces of blkid - not MultiBlkid");
+
+    if (is_mirrored()) {
+        mirrored_read(
+            bid.chunk_num(), to_chunk_offset(bid), req,
+            [this, buf, size](PhysicalDev* pdev, uint64_t dev_offset, dev_io_req* r, bool batch) {
+                pdev->async_read(buf, size, dev_offset, r, batch, m_use_uring);
+            },
+            part_of_batch);
+        return;
+    }
+
+    Chunk* pchunk;
+    uint64_t const dev_offset = to_dev_offset(bid, &pchunk);
+    if (sisl_unlikely(dev_offset == INVALID_DEV_OFFSET)) {
+        req->done(req, std::make_error_code(std::errc::resource_unavailable_try_again));
+        return;
+    }
+    pchunk->physical_dev_mutable()->async_read(buf, size, dev_offset, req, part_of_batch, m_use_uring);
+}
+
+void VirtualDev::async_readv(iovec* iovs, int iovcnt, uint32_t size, BlkId const& bid, dev_io_req* req,
+                             bool part_of_batch) {
+    HS_DBG_ASSERT_EQ(bid.is_multi(), false, "async_readv needs individual pieces of blkid - not MultiBlkid");
+
+    if (is_mirrored()) {
+        mirrored_read(
+            bid.chunk_num(), to_chunk_offset(bid), req,
+            [this, iovs, iovcnt, size](PhysicalDev* pdev, uint64_t dev_offset, dev_io_req* r, bool batch) {
+                pdev->async_readv(iovs, iovcnt, size, dev_offset, r, batch, m_use_uring);
+            },
+            part_of_batch);
+        return;
+    }
+
+    Chunk* pchunk;
+    uint64_t const dev_offset = to_dev_offset(bid, &pchunk);
+    if (sisl_unlikely(dev_offset == INVALID_DEV_OFFSET)) {
+        req->done(req, std::make_error_code(std::errc::resource_unavailable_try_again));
+        return;
+    }
+    pchunk->physical_dev_mutable()->async_readv(iovs, iovcnt, size, dev_offset, req, part_of_batch, m_use_uring);
 }
 
 ////////////////////////////////////////// sync read section ////////////////////////////////////////////
 std::error_code VirtualDev::sync_read(char* buf, uint32_t size, BlkId const& bid) {
     HS_DBG_ASSERT_EQ(bid.is_multi(), false, "sync_read needs individual pieces of blkid - not MultiBlkid");
 
+    if (is_mirrored()) {
+        return mirrored_sync_read(bid.chunk_num(), to_chunk_offset(bid), [&](PhysicalDev* pdev, uint64_t dev_offset) {
+            return pdev->sync_read(buf, size, dev_offset);
+        });
+    }
+
     Chunk* chunk;
     uint64_t const dev_offset = to_dev_offset(bid, &chunk);
     if (sisl_unlikely(dev_offset == INVALID_DEV_OFFSET)) {
@@ -527,6 +1186,12 @@ std::error_code VirtualDev::sync_read(char* buf, uint32_t size, BlkId const& bid
 }
 
 std::error_code VirtualDev::sync_read(char* buf, uint32_t size, cshared< Chunk >& chunk, uint64_t offset_in_chunk) {
+    if (is_mirrored()) {
+        return mirrored_sync_read(chunk->chunk_id(), offset_in_chunk, [&](PhysicalDev* pdev, uint64_t dev_offset) {
+            return pdev->sync_read(buf, size, dev_offset);
+        });
+    }
+
     if (sisl_unlikely(!is_chunk_available(chunk))) {
         return std::make_error_code(std::errc::resource_unavailable_try_again);
     }
@@ -536,6 +1201,13 @@ std::error_code VirtualDev::sync_read(char* buf, uint32_t size, cshared< Chunk >
 std::error_code VirtualDev::sync_readv(iovec* iov, int iovcnt, BlkId const& bid) {
     HS_DBG_ASSERT_EQ(bid.is_multi(), false, "sync_readv needs individual pieces of blkid - not MultiBlkid");
 
+    if (is_mirrored()) {
+        auto const size = get_len(iov, iovcnt);
+        return mirrored_sync_read(bid.chunk_num(), to_chunk_offset(bid), [&](PhysicalDev* pdev, uint64_t dev_offset) {
+            return pdev->sync_readv(iov, iovcnt, size, dev_offset);
+        });
+    }
+
     Chunk* chunk;
     uint64_t const dev_offset = to_dev_offset(bid, &chunk);
     if (sisl_unlikely(dev_offset == INVALID_DEV_OFFSET)) {
@@ -553,6 +1225,13 @@ std::error_code VirtualDev::sync_readv(iovec* iov, int iovcnt, BlkId const& bid)
 }
 
 std::error_code VirtualDev::sync_readv(iovec* iov, int iovcnt, cshared< Chunk >& chunk, uint64_t offset_in_chunk) {
+    if (is_mirrored()) {
+        auto const size = get_len(iov, iovcnt);
+        return mirrored_sync_read(chunk->chunk_id(), offset_in_chunk, [&](PhysicalDev* pdev, uint64_t dev_offset) {
+            return pdev->sync_readv(iov, iovcnt, size, dev_offset);
+        });
+    }
+
     if (sisl_unlikely(!is_chunk_available(chunk))) {
         return std::make_error_code(std::errc::resource_unavailable_try_again);
     }
@@ -593,12 +1272,30 @@ folly::Future< std::error_code > VirtualDev::queue_fsync_pdevs() {
 }
 
 void VirtualDev::submit_batch() {
+    if (m_use_uring) {
+        // Each pdev has a ring of its own
+        for (auto* pdev : m_pdevs) {
+            pdev->submit_batch(true /* via_uring */);
+        }
+        return;
+    }
+
     // It is enough to submit batch on first pdev, since all pdevs are expected to be under same drive interfaces
     auto* pdev = *(m_pdevs.begin());
     return pdev->submit_batch();
 }
 
+void VirtualDev::enable_uring() {
+    std::unique_lock lg{m_mgmt_mutex};
+    for (auto* pdev : m_pdevs) {
+        pdev->enable_uring();
+    }
+    m_use_uring = true;
+    LOGINFO("Async ios of vdev={} are routed through io_uring", m_name);
+}
+
 uint64_t VirtualDev::available_blks() const {
+    std::unique_lock lg{m_mgmt_mutex};
     uint64_t avl_blks{0};
     for (auto& [_, chunk] : m_all_chunks) {
         avl_blks += chunk->blk_allocator()->available_blks();
@@ -607,6 +1304,7 @@ uint64_t VirtualDev::available_blks() const {
 }
 
 uint64_t VirtualDev::used_size() const {
+    std::unique_lock lg{m_mgmt_mutex};
     uint64_t alloc_cnt{0};
     for (auto& [_, chunk] : m_all_chunks) {
         alloc_cnt += chunk->blk_allocator()->get_used_blks();
@@ -614,11 +1312,23 @@ uint64_t VirtualDev::used_size() const {
     return (alloc_cnt * block_size());
 }
 
-std::map< uint16_t, shared< Chunk > > VirtualDev::get_chunks() const { return m_all_chunks; }
+uint32_t VirtualDev::health_score() const {
+    std::unique_lock lg{m_mgmt_mutex};
+    uint32_t score{DeviceHealth::max_score};
+    for (auto const* pdev : m_pdevs) {
+        score = std::min(score, pdev->health_score());
+    }
+    return score;
+}
+
+std::map< uint16_t, shared< Chunk > > VirtualDev::get_chunks() const {
+    std::unique_lock lg{m_mgmt_mutex};
+    return m_all_chunks;
+}
 
 bool VirtualDev::is_blk_exist(MultiBlkId const& b) const {
-    auto chunk_num = b.chunk_num();
-    return m_all_chunks.contains(chunk_num);
+    auto const* chunk = m_dmgr.get_chunk(b.chunk_num());
+    return chunk && (chunk->vdev_id() == m_vdev_info.vdev_id) && !chunk->is_mirror();
 }
 
 /* Get status for all chunks */
@@ -626,6 +1336,7 @@ nlohmann::json VirtualDev::get_status(int log_level) const {
     nlohmann::json j;
 
     try {
+        std::unique_lock lg{m_mgmt_mutex};
         for (auto& [_, chunk] : m_all_chunks) {
             nlohmann::json chunk_j;
             chunk_j["ChunkInfo"] = chunk->get_status(log_level);
@@ -679,12 +1390,29 @@ std::unique_ptr< CPContext > VirtualDev::create_cp_context(CP* cp) { return std:
 void VirtualDev::cp_flush(VDevCPContext* v_cp_ctx) {
     CP* cp = v_cp_ctx->cp();
 
-    // pass down cp so that underlying components can get their customized CP context if needed;
-    m_chunk_selector->foreach_chunks(
-        [this, cp](cshared< Chunk >& chunk) { chunk->blk_allocator_mutable()->cp_flush(cp); });
+    if (m_allocator_type == blk_allocator_type_t::append) {
+        cp_flush_append_chunks();
+    } else {
+        // Blks freed by the previous CP and not yet discarded are freed now, so that this CP persists them
+        if (m_discarder) { m_discarder->drain(); }
+
+        // pass down cp so that underlying components can get their customized CP context if needed;
+        m_chunk_selector->foreach_chunks(
+            [this, cp](cshared< Chunk >& chunk) { chunk->blk_allocator_mutable()->cp_flush(cp); });
+    }
 
     // All of the blkids which were captured in the current vdev cp context will now be freed and hence available for
-    // allocation on the new CP dirty collection session which is ongoing
+    // allocation on the new CP dirty collection session which is ongoing. With discard, they are freed once discarded
+    // or at the latest by the next cp flush.
+    if (m_discarder) {
+        std::vector< BlkId > bids;
+        for (auto const& b : v_cp_ctx->m_free_blkid_list) {
+            bids.push_back(b);
+        }
+        m_discarder->submit(std::move(bids));
+        return;
+    }
+
     for (auto const& b : v_cp_ctx->m_free_blkid_list) {
         auto chunk = m_dmgr.get_chunk_mutable(b.chunk_num());
         // try to free a blk in a missing chunk, crash if it happens;
@@ -694,6 +1422,58 @@ void VirtualDev::cp_flush(VDevCPContext* v_cp_ctx) {
     }
 }
 
+void VirtualDev::cp_flush_append_chunks() {
+    std::vector< std::pair< AppendBlkAllocator*, bool > > allocators;
+    bool any_dirty{false};
+    {
+        std::unique_lock lg{m_mgmt_mutex};
+        allocators.reserve(m_all_chunks.size());
+        for (auto& [_, chunk] : m_all_chunks) {
+            auto ba = static_cast< AppendBlkAllocator* >(chunk->blk_allocator_mutable());
+            auto const dirty = ba->test_and_clear_dirty();
+            any_dirty = any_dirty || dirty;
+            allocators.emplace_back(ba, dirty);
+        }
+    }
+    if (!any_dirty) { return; }
+
+    // Write entries of all chunks, clean ones included, so that the superblk is always a complete image of the vdev
+    auto const sb_size = append_blk_vdev_sb_t::size(uint32_cast(allocators.size()));
+    if (m_append_sb.is_empty()) {
+        m_append_sb.create(sb_size);
+    } else if (m_append_sb.size() != sb_size) {
+        m_append_sb.resize(sb_size);
+    }
+    m_append_sb->num_chunks = uint32_cast(allocators.size());
+    auto entries = m_append_sb->chunk_sbs();
+    for (size_t i{0}; i < allocators.size(); ++i) {
+        allocators[i].first->fill_sb(entries[i]);
+    }
+    m_append_sb.write();
+
+    for (auto& [ba, dirty] : allocators) {
+        if (dirty) { ba->on_sb_persisted(); }
+    }
+}
+
+void VirtualDev::on_append_sb_found(sisl::byte_view const& buf, void* meta_cookie) {
+    m_append_sb.load(buf, meta_cookie);
+    HS_REL_ASSERT_EQ(m_append_sb->magic, append_blkalloc_vdev_sb_magic, "Invalid append blk vdev superblk magic");
+    HS_REL_ASSERT_EQ(m_append_sb->version, append_blkalloc_vdev_sb_version,
+                     "Invalid version of append blk vdev superblk");
+
+    auto const entries = m_append_sb->chunk_sbs();
+    for (uint32_t i{0}; i < m_append_sb->num_chunks; ++i) {
+        auto chunk = m_dmgr.get_chunk_mutable(entries[i].allocator_id);
+        if (!chunk) {
+            LOGWARN("vdev={} has append blk superblk entry for missing chunk={}, skipping it", m_name,
+                    entries[i].allocator_id);
+            continue;
+        }
+        static_cast< AppendBlkAllocator* >(chunk->blk_allocator_mutable())->load_sb(entries[i]);
+    }
+}
+
 // sync-ops during cp_flush, so return 100;
 int VirtualDev::cp_progress_percent() { return 100; }
 
@@ -705,6 +1485,8 @@ void VirtualDev::recovery_completed() {
 }
 
 ///////////////////////// VirtualDev Private Methods /////////////////////////////
+uint64_t VirtualDev::to_chunk_offset(BlkId const& b) const { return uint64_cast(b.blk_num()) * block_size(); }
+
 uint64_t VirtualDev::to_dev_offset(BlkId const& b, Chunk** chunk) const {
     *chunk = m_dmgr.get_chunk_mutable(b.chunk_num());
     if (!(*chunk)) return INVALID_DEV_OFFSET;
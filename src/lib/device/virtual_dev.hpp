@@ -14,17 +14,21 @@
  *********************************************************************************/
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <functional>
 #include <limits>
 #include <memory>
 #include <map>
 #include <mutex>
+#include <set>
 #include <string>
 #include <system_error>
 #include <type_traits>
 #include <vector>
 
+#include <folly/Function.h>
+#include <folly/small_vector.h>
 #include <sisl/metrics/metrics.hpp>
 #include <sisl/logging/logging.h>
 #include <sisl/utility/obj_life_counter.hpp>
@@ -34,13 +38,16 @@
 
 #include <homestore/checkpoint/cp_mgr.hpp>
 #include <homestore/homestore_decl.hpp>
+#include <homestore/superblk_handler.hpp>
 #include "device/device.h"
+#include "device/blk_discarder.hpp"
 #include <homestore/chunk_selector.h>
 
 namespace homestore {
 class PhysicalDev;
 class Chunk;
 class BlkAllocator;
+struct append_blk_vdev_sb_t;
 
 class VirtualDevMetrics : public sisl::MetricsGroupWrapper {
 public:
@@ -51,6 +58,11 @@ public:
         REGISTER_COUNTER(vdev_high_watermark_count, "vdev total high watermark cnt");
         REGISTER_COUNTER(vdev_num_alloc_failure, "vdev blk alloc failure cnt");
         REGISTER_COUNTER(unalign_writes, "unalign write cnt");
+        REGISTER_COUNTER(vdev_discard_count, "vdev freed ranges discarded on the drive");
+        REGISTER_COUNTER(vdev_discard_skipped_count, "vdev freed ranges not discarded before the next CP");
+        REGISTER_COUNTER(vdev_mirror_read_failover_count, "vdev reads retried on another mirror after an error");
+        REGISTER_COUNTER(vdev_mirror_degraded_write_count, "vdev writes done on fewer copies than the mirrors");
+        REGISTER_COUNTER(vdev_dropped_write_count, "vdev writes dropped as homestore is opened read only");
         REGISTER_COUNTER(default_chunk_allocation_cnt, "default chunk allocation count");
         REGISTER_COUNTER(random_chunk_allocation_cnt,
                          "random chunk allocation count"); // ideally it should be zero for hdd
@@ -70,6 +82,13 @@ public:
  * can be created across multiple physical devices. Unlike RAID, its io is not always in a bigger strip sizes. It
  * support n-mirrored writes.
  *
+ * A vdev created with ALL_PDEV_MIRRORED has a mirror copy of each of its primary chunks on every other pdev, with the
+ * same ordinal. Blks are allocated only from the primary chunks, writes go to all copies of a blk and reads are served
+ * by the copy on the pdev with the fewest outstanding reads of this vdev, failing over to the next copy on error.
+ *
+ * The first write to a chunk while some of its copies are missing bumps the generation persisted in the chunk info of
+ * the copies present. A copy of a lower generation than the other copies missed writes, so it is not read from once it
+ * is back, till resync_mirrors() copies the data onto it.
  */
 static constexpr uint32_t VIRDEV_BLKSIZE{512};
 static constexpr uint64_t CHUNK_EOF{0xabcdabcd};
@@ -91,7 +110,7 @@ protected:
     vdev_event_cb_t m_event_cb; // Callback registered for any events
     VirtualDevMetrics m_metrics;
 
-    std::mutex m_mgmt_mutex;          // Any mutex taken for management operations (like adding/removing chunks).
+    mutable std::mutex m_mgmt_mutex;  // Any mutex taken for management operations (like adding/removing chunks).
     std::set< PhysicalDev* > m_pdevs; // PDevs this vdev is working on
     std::map< uint16_t, shared< Chunk > > m_all_chunks; // All chunks part of this vdev
     uint64_t m_total_chunk_num{0};                      // Total number of chunks
@@ -100,6 +119,16 @@ protected:
     chunk_selector_type_t m_chunk_selector_type;
     bool m_auto_recovery;
     bool m_use_slab_in_blk_allocator;
+    bool m_use_uring{false}; // Async ios go through io_uring drive of the pdevs, where it could be enabled
+    bool m_integrity_offload; // Integrity is checked by protection info of the pdevs, as decided on format
+    bool m_read_only;         // Writes are dropped, so that the devices are left as they are by a read only open
+    superblk< append_blk_vdev_sb_t > m_append_sb; // Superblk of all append blk allocators of this vdev
+    std::unique_ptr< BlkDiscarder > m_discarder;  // Discards the blks freed by CPs, if enabled
+
+    std::map< uint16_t, std::vector< shared< Chunk > > > m_mirrors; // Mirror copies of each primary chunk, if mirrored
+    std::map< const PhysicalDev*, std::atomic< uint32_t > > m_mirror_reads; // Outstanding reads of this vdev by pdev
+    std::mutex m_mirror_gen_mutex;
+    std::set< uint16_t > m_degraded_chunks; // Primary chunks whose copies present are ahead of the missing ones
 
 public:
     VirtualDev(DeviceManager& dmgr, const vdev_info& vinfo, vdev_event_cb_t event_cb, bool is_auto_recovery,
@@ -149,6 +178,16 @@ public:
     virtual BlkAllocStatus alloc_blks(blk_count_t nblks, blk_alloc_hints const& hints,
                                       std::vector< BlkId >& out_blkids);
 
+    /// @brief This method allocates blocks for a batch of requests in one call. The chunk is selected once and used
+    /// for the subsequent requests of the batch, until it can't satisfy one of them.
+    /// @param nblks_list : Number of blocks to allocate for each request
+    /// @param hints : Hints about block allocation, applied to all requests of the batch
+    /// @param out_blkids : Vector to which one MultiBlkId per request is appended, in the order of nblks_list
+    /// @return BlkAllocStatus : SUCCESS if all requests are allocated, otherwise status of the failed request, in which
+    /// case none of the blks of this batch are left allocated and nothing is appended to out_blkids
+    virtual BlkAllocStatus alloc_blks(std::vector< blk_count_t > const& nblks_list, blk_alloc_hints const& hints,
+                                      std::vector< MultiBlkId >& out_blkids);
+
     /// @brief Checks if a given block id is allocated in the in-memory version of the blk allocator
     /// @param blkid : BlkId to check for allocation
     /// @return true or false
@@ -193,6 +232,16 @@ public:
     folly::Future< std::error_code > async_writev(const iovec* iov, const int iovcnt, cshared< Chunk >& chunk,
                                                   uint64_t offset_in_chunk);
 
+    /// @brief Callback based async write of the buffer, which does not allocate per io when the vdev goes through
+    /// io_uring. req and the buffer are to be kept alive by the caller till req->done is called, which could be inline
+    /// if the io could not be submitted.
+    void async_write(const char* buf, uint32_t size, BlkId const& bid, dev_io_req* req, bool part_of_batch = false);
+
+    /// @brief Callback based async write of the vector of buffers, on which the iovec array too has to stay valid till
+    /// req->done is called. Size is the total length of iovs, saving a walk through them.
+    void async_writev(const iovec* iov, int iovcnt, uint32_t size, BlkId const& bid, dev_io_req* req,
+                      bool part_of_batch = false);
+
     /// @brief Synchronously write the buffer to the blkid
     /// @param buf : Buffer to write data from
     /// @param size : Size of the buffer
@@ -235,6 +284,14 @@ public:
     folly::Future< std::error_code > async_readv(iovec* iovs, int iovcnt, uint64_t size, BlkId const& bid,
                                                  bool part_of_batch = false);
 
+    /// @brief Callback based async read to the buffer, with the same contract as the callback based async_write.
+    void async_read(char* buf, uint32_t size, BlkId const& bid, dev_io_req* req, bool part_of_batch = false);
+
+    /// @brief Callback based async read to the vector of buffers, with the same contract as the callback based
+    /// async_writev.
+    void async_readv(iovec* iovs, int iovcnt, uint32_t size, BlkId const& bid, dev_io_req* req,
+                     bool part_of_batch = false);
+
     /// @brief Synchronously read the data for a given BlkId.
     /// @param buf : Buffer to read data to
     /// @param size : Size of the buffer
@@ -264,6 +321,14 @@ public:
     /// @brief Submit the batch of IOs previously queued as part of async read/write APIs.
     void submit_batch();
 
+    /// @brief Routes the async ios of this vdev through the io_uring drive of its pdevs, including the pdevs of the
+    /// chunks added later. A pdev on which io_uring could not be set up continues to do ios through iomgr.
+    void enable_uring();
+    bool is_uring_enabled() const { return m_use_uring; }
+
+    /// @brief Whether data integrity of this vdev is checked by the protection info of its pdevs, instead of software
+    bool is_integrity_offloaded() const { return m_integrity_offload; }
+
     ////////////////////// Checkpointing related methods ///////////////////////////
     /// @brief
     ///
@@ -279,13 +344,18 @@ public:
 
     ////////////////////////// Standard Getters ///////////////////////////////
     virtual uint64_t available_blks() const;
-    virtual uint64_t size() const { return m_vdev_info.vdev_size; }
+    virtual uint64_t size() const { return m_vdev_info.vdev_size / std::max(m_vdev_info.num_mirrors, 1u); }
     virtual uint64_t used_size() const;
+
+    /// @brief Lowest health score among the pdevs of this vdev, from 0 to 100. See DeviceHealth
+    uint32_t health_score() const;
     virtual uint64_t num_chunks() const { return m_vdev_info.num_primary_chunks; }
     virtual uint32_t block_size() const { return m_vdev_info.blk_size; }
+    blk_allocator_type_t allocator_type() const { return m_allocator_type; }
     virtual vdev_info info() const { return m_vdev_info; }
     virtual void update_info(const vdev_info& info) { m_vdev_info = info; }
-    virtual uint32_t num_mirrors() const { return 0; }
+    virtual uint32_t num_mirrors() const { return m_vdev_info.num_mirrors; }
+    bool is_mirrored() const { return (m_vdev_info.num_mirrors > 1); }
     virtual std::string to_string() const;
     virtual nlohmann::json get_status(int log_level) const;
     virtual uint64_t get_total_chunk_num() const { return m_total_chunk_num; }
@@ -303,11 +373,45 @@ public:
     ///////////////////////// Meta operations on vdev ////////////////////////
     void update_vdev_private(const sisl::blob& data);
 
+    /// @brief Copies the data of each chunk of a mirrored vdev onto its copies which missed writes, after which they
+    /// serve reads again. Expected to be called before the vdev is written to, like right after it is loaded.
+    /// @return Error of the first copy which couldn't be resynced, the others are still resynced
+    std::error_code resync_mirrors();
+
+    /// @brief Number of copies of the chunks of the vdev which are present but missed writes
+    uint32_t num_stale_mirrors() const;
+
 private:
+    struct mirror_read_req;
+    using copies_t = folly::small_vector< Chunk*, 4 >;
+    using read_req_fn_t = folly::Function< void(PhysicalDev*, uint64_t, dev_io_req*, bool) >;
+
     uint64_t to_dev_offset(BlkId const& b, Chunk** chunk) const;
+    uint64_t to_chunk_offset(BlkId const& b) const;
+    copies_t copies_of(uint16_t chunk_num) const;
+    size_t pick_copy(const copies_t& copies, uint32_t tried_mask) const;
+    static uint32_t latest_gen(const copies_t& copies);
+    void mark_degraded_write(uint16_t chunk_num, const copies_t& copies);
+    template < typename WriteFn >
+    folly::Future< std::error_code > mirrored_write(uint16_t chunk_num, uint64_t offset_in_chunk, WriteFn&& write_fn);
+    template < typename WriteFn >
+    void mirrored_write(uint16_t chunk_num, uint64_t offset_in_chunk, dev_io_req* req, WriteFn&& write_fn);
+    template < typename WriteFn >
+    std::error_code mirrored_sync_write(uint16_t chunk_num, uint64_t offset_in_chunk, WriteFn&& write_fn);
+    template < typename ReadFn >
+    folly::Future< std::error_code > mirrored_read(uint16_t chunk_num, uint64_t offset_in_chunk, ReadFn read_fn,
+                                                   bool part_of_batch, uint32_t tried_mask = 0);
+    void mirrored_read(uint16_t chunk_num, uint64_t offset_in_chunk, dev_io_req* req, read_req_fn_t&& read_fn,
+                       bool part_of_batch);
+    static void on_mirror_read_done(dev_io_req* req, std::error_code ec);
+    template < typename ReadFn >
+    std::error_code mirrored_sync_read(uint16_t chunk_num, uint64_t offset_in_chunk, ReadFn&& read_fn);
     bool is_chunk_available(cshared< Chunk >& chunk) const;
     BlkAllocStatus alloc_blks_from_chunk(blk_count_t nblks, blk_alloc_hints const& hints, MultiBlkId& out_blkid,
                                          Chunk* chunk);
+    void on_append_sb_found(sisl::byte_view const& buf, void* meta_cookie);
+    void cp_flush_append_chunks();
+    bool drop_write();
 };
 
 // place holder for future needs in which components underlying virtualdev needs cp flush context;
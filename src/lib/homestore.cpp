@@ -13,6 +13,7 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <algorithm>
 #include <cstdint>
 #include <mutex>
 #include <stdexcept>
@@ -29,12 +30,15 @@
 #include <homestore/index_service.hpp>
 #include <homestore/homestore.hpp>
 #include <homestore/checkpoint/cp_mgr.hpp>
+#include <homestore/cpu_accounting.hpp>
+#include <homestore/perf_stats.hpp>
 
 #include "index/wb_cache.hpp"
 #include "common/homestore_utils.hpp"
 #include "common/homestore_config.hpp"
 #include "common/homestore_assert.hpp"
 #include "common/homestore_status_mgr.hpp"
+#include "common/thread_placement.hpp"
 #include "device/physical_dev.hpp"
 #include "device/device.h"
 #include "device/virtual_dev.hpp"
@@ -127,6 +131,12 @@ bool HomeStore::start(const hs_input_params& input, hs_before_services_starting_
     });
 
     HomeStoreDynamicConfig::init_settings_default();
+    CPUAccounting::set_sample_every(HS_DYNAMIC_CONFIG(generic.cpu_accounting_sample_every));
+    m_status_mgr->register_status_cb("CPUAccounting",
+                                     [](int verbosity) { return CPUAccounting::get_status(verbosity); });
+    hs_utils::init_io_buf_pool();
+    // Status reads do not move the baseline of the delta snapshots, which is left to the callers of get_perf_snapshot
+    m_status_mgr->register_status_cb("PerfSnapshot", [this](int) { return get_perf_snapshot(false /* delta */); });
 
 #ifdef _PRERELEASE
     // Start a default crash simulator which raises SIGKILL, in case user has not provided with_crash_simulator()
@@ -135,6 +145,14 @@ bool HomeStore::start(const hs_input_params& input, hs_before_services_starting_
 #endif
 
     LOGINFO("Homestore is loading with following services: {}", m_services.list());
+    if (iomanager.is_spdk_mode()) {
+        LOGINFO("Devices are driven by spdk, io buffers come from hugepage memory of size={}",
+                in_bytes(input.hugepage_size));
+        if (input.hugepage_size == 0) {
+            LOGWARN("hugepage_size is not set with spdk, caches are sized from app_mem_size instead, which may not fit "
+                    "in the hugepages reserved for iomgr");
+        }
+    }
     if (has_meta_service()) { m_meta_service = std::make_unique< MetaBlkService >(); }
     if (has_index_service()) { m_index_service = std::make_unique< IndexService >(std::move(s_index_cbs)); }
     if (has_repl_data_service()) {
@@ -159,6 +177,9 @@ bool HomeStore::start(const hs_input_params& input, hs_before_services_starting_
         }
         do_start();
         return false;
+    } else if (input.is_read_only) {
+        LOGERROR("HomeStore can't be opened read only on devices which are not formatted yet");
+        throw std::invalid_argument("read only open of unformatted devices");
     } else {
         return true;
     }
@@ -218,11 +239,11 @@ void HomeStore::format_and_start(std::map< uint32_t, hs_format_params >&& format
         } else if ((svc_type & HS_SERVICE::DATA) && has_data_service()) {
             m_data_service->create_vdev(pct_to_size(fparams.size_pct, fparams.dev_type), fparams.dev_type,
                                         fparams.block_size, fparams.alloc_type, fparams.chunk_sel_type,
-                                        fparams.num_chunks);
+                                        fparams.num_chunks, fparams.integrity_offload);
         } else if ((svc_type & HS_SERVICE::REPLICATION) && has_repl_data_service()) {
             m_data_service->create_vdev(pct_to_size(fparams.size_pct, fparams.dev_type), fparams.dev_type,
                                         fparams.block_size, fparams.alloc_type, fparams.chunk_sel_type,
-                                        fparams.num_chunks);
+                                        fparams.num_chunks, fparams.integrity_offload);
         }
     }
 
@@ -254,13 +275,19 @@ void HomeStore::do_start() {
     if (has_index_service()) { m_index_service->start(); }
 
     if (has_repl_data_service()) {
-        s_cast< GenericReplService* >(m_repl_service.get())->start(); // Replservice starts logstore & data service
+        if (is_read_only()) {
+            // Read only open doesn't join the replication groups nor replays their journals, which would write to the
+            // index and data of their consumers. Data is read by the blkids kept in the index of the consumer.
+            m_data_service->start();
+        } else {
+            s_cast< GenericReplService* >(m_repl_service.get())->start(); // Replservice starts logstore & data service
+        }
     } else {
         if (has_data_service()) { m_data_service->start(); }
         if (has_log_service() && inp_params.auto_recovery) {
             // In case of custom recovery, let consumer starts the recovery and it is consumer module's responsibilities
             // to start log store
-            m_log_service->start(is_first_time_boot() /* format */);
+            m_log_service->start(is_first_time_boot() /* format */, HS_DYNAMIC_CONFIG(logstore.lazy_recovery));
         }
     }
 
@@ -272,28 +299,31 @@ void HomeStore::do_start() {
         m_dev_mgr->commit_formatting();
     }
 
-    m_cp_mgr->start_timer();
+    if (!is_read_only()) { m_cp_mgr->start_timer(); }
     m_resource_mgr->start(m_dev_mgr->total_capacity());
 
     m_init_done = true;
 }
 
-void HomeStore::shutdown() {
+void HomeStore::shutdown(bool fast) {
     if (!m_init_done) {
         LOGWARN("Homestore shutdown is called before init is completed");
         return;
     }
 
-    LOGINFO("Homestore shutdown is started");
+    LOGINFO("Homestore {}shutdown is started", fast ? "fast " : "");
 
-    m_cp_mgr->shutdown();
+    // Pending data writes are written out while they can still be checkpointed
+    if (m_data_service) { m_data_service->stop(); }
+    if (has_index_service()) { m_index_service->stop_destroys(); }
+    m_cp_mgr->shutdown(fast);
     m_cp_mgr.reset();
 
     m_resource_mgr->stop();
 
     if (has_repl_data_service()) {
-        // Log and Data services are stopped by repl service
-        s_cast< GenericReplService* >(m_repl_service.get())->stop();
+        // Log and Data services are stopped by repl service, which is not started by a read only open
+        if (!is_read_only()) { s_cast< GenericReplService* >(m_repl_service.get())->stop(); }
         m_log_service.reset();
         m_data_service.reset();
         m_repl_service.reset();
@@ -350,7 +380,46 @@ cap_attrs HomeStore::get_system_capacity() const {
 }
 #endif
 
+nlohmann::json HomeStore::get_perf_snapshot(bool delta) {
+    auto js = PerfStats::get_snapshot(delta);
+    if (!m_init_done || !m_cp_mgr) { return js; }
+
+    js["devices"] = nlohmann::json::object();
+    for (auto const* pdev : m_dev_mgr->get_pdevs()) {
+        js["devices"][pdev->get_devname()] = pdev->get_io_status();
+    }
+
+    // Flush durations of the cps in the cp history
+    auto const cp_status = m_cp_mgr->get_status(1 /* verbosity */);
+    auto& cp_js = js["cp"];
+    cp_js["last_flushed_cp"] = cp_status["last_flushed_cp"];
+    uint64_t ncps{0};
+    uint64_t total_us{0};
+    uint64_t max_us{0};
+    uint64_t last_us{0};
+    for (auto const& entry : cp_status["recent_cps"]) {
+        last_us = entry["flush_us"].get< uint64_t >();
+        total_us += last_us;
+        max_us = std::max(max_us, last_us);
+        ++ncps;
+    }
+    cp_js["recent_cps"] = ncps;
+    cp_js["last_flush_us"] = last_us;
+    cp_js["avg_flush_us"] = (ncps == 0) ? 0 : (total_us / ncps);
+    cp_js["max_flush_us"] = max_us;
+
+    if (has_log_service() && m_log_service) {
+        auto const used = m_log_service->used_size();
+        auto const total = m_log_service->total_size();
+        js["journal"]["used_size"] = used;
+        js["journal"]["total_size"] = total;
+        js["journal"]["used_pct"] = (total == 0) ? 0.0 : (100.0 * used / total);
+    }
+    return js;
+}
+
 bool HomeStore::is_first_time_boot() const { return m_dev_mgr->is_first_time_boot(); }
+bool HomeStore::is_read_only() const { return HS_STATIC_CONFIG(input.is_read_only); }
 
 bool HomeStore::has_index_service() const { return m_services.svcs & HS_SERVICE::INDEX; }
 bool HomeStore::has_data_service() const { return m_services.svcs & HS_SERVICE::DATA; }
@@ -451,6 +520,24 @@ nlohmann::json hs_input_params::to_json() const {
     json["app_mem_size"] = in_bytes(app_mem_size);
     json["hugepage_size"] = in_bytes(hugepage_size);
     json["auto_recovery?"] = auto_recovery;
+    json["journal_pmem_path"] = journal_pmem_path;
+    json["journal_pmem_size"] = in_bytes(journal_pmem_size);
+    json["thread_placement"] = thread_placement.to_json();
+    return json;
+}
+
+nlohmann::json hs_thread_placement::to_json() const {
+    nlohmann::json json;
+    json["log_flush_cpus"] = log_flush_cpus;
+    json["cp_cpus"] = cp_cpus;
+    json["background_cpus"] = background_cpus;
+    json["io_cpus"] = io_cpus;
+    json["numa_node"] = numa_node;
+
+    // Cpus each role is bound to, as resolved from the above
+    for (auto const role : {hs_thread_role_t::LOG_FLUSH, hs_thread_role_t::CP, hs_thread_role_t::BACKGROUND}) {
+        json["bound_cpus"][enum_name(role)] = ThreadPlacement::cpus_of(role);
+    }
     return json;
 }
 
@@ -1,41 +1,115 @@
+#include <algorithm>
+#include <cstring>
 #include <stack>
 #include <unordered_map>
 
 #include <homestore/checkpoint/cp_mgr.hpp>
 #include "index/index_cp.hpp"
 #include "index/wb_cache.hpp"
+#include "logstore/log_dev.hpp"
 #include "common/homestore_assert.hpp"
 
 namespace homestore {
 IndexCPCallbacks::IndexCPCallbacks(IndexWBCache* wb_cache) : m_wb_cache{wb_cache} {}
 
-std::unique_ptr< CPContext > IndexCPCallbacks::on_switchover_cp(CP* cur_cp, CP* new_cp) {
-    return std::make_unique< IndexCPContext >(new_cp);
+// Context is created only once the cp is accessed by an index operation, CPs in which index is idle don't need any
+std::unique_ptr< CPContext > IndexCPCallbacks::on_switchover_cp(CP* cur_cp, CP* new_cp) { return nullptr; }
+
+std::unique_ptr< CPContext > IndexCPCallbacks::create_cp_context(CP* cp) {
+    std::unique_lock lg{m_spare_buf_mtx};
+    return std::make_unique< IndexCPContext >(cp, std::move(m_spare_journal_buf), m_wb_cache->txn_log());
 }
 
 folly::Future< bool > IndexCPCallbacks::cp_flush(CP* cp) {
+    // First cp still flushes the vdev, to create the cp information, even if index is idle
+    if ((cp->created_context(cp_consumer_t::INDEX_SVC) == nullptr) && (cp->id() != 0)) {
+        return folly::makeFuture< bool >(true);
+    }
     auto ctx = s_cast< IndexCPContext* >(cp->context(cp_consumer_t::INDEX_SVC));
+    m_flushing_ctx.store(ctx, std::memory_order_release);
     return m_wb_cache->async_cp_flush(ctx);
 }
 
-void IndexCPCallbacks::cp_cleanup(CP* cp) {}
+void IndexCPCallbacks::cp_cleanup(CP* cp) {
+    auto ctx = s_cast< IndexCPContext* >(cp->created_context(cp_consumer_t::INDEX_SVC));
+    // Flush of the next cp could have started already, if the cleanup overlaps with it
+    auto expected = ctx;
+    m_flushing_ctx.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+    if (ctx && ctx->m_txn_log && ctx->has_txn_journal()) { m_wb_cache->truncate_txn_log(ctx); }
+    if (ctx && (ctx->m_txn_journal_buf.bytes() != nullptr)) {
+        std::unique_lock lg{m_spare_buf_mtx};
+        if (m_spare_journal_buf.bytes() == nullptr) { m_spare_journal_buf = std::move(ctx->m_txn_journal_buf); }
+    }
+}
 
-int IndexCPCallbacks::cp_progress_percent() { return 100; }
+int IndexCPCallbacks::cp_progress_percent() {
+    // Context is alive till the cp is cleaned up, which waits for the watchdog calling this to be done
+    auto ctx = m_flushing_ctx.load(std::memory_order_acquire);
+    return ctx ? ctx->flush_progress_percent() : 100;
+}
+
+nlohmann::json IndexCPCallbacks::cp_flush_stats(CP* cp) const {
+    auto ctx = s_cast< IndexCPContext* >(cp->created_context(cp_consumer_t::INDEX_SVC));
+    if (ctx == nullptr) { return nlohmann::json{}; }
+    nlohmann::json js;
+    js["dirty_nodes"] = ctx->m_dirty_buf_list.size();
+    js["nodes_written"] = ctx->m_num_nodes_written.load(std::memory_order_relaxed);
+    js["bytes_written"] = ctx->m_num_bytes_written.load(std::memory_order_relaxed);
+    return js;
+}
 
 /////////////////////// IndexCPContext section ///////////////////////////
-IndexCPContext::IndexCPContext(CP* cp) : VDevCPContext(cp) {}
+IndexCPContext::IndexCPContext(CP* cp, sisl::io_blob_safe&& spare_journal_buf, shared< HomeLogStore > txn_log) :
+        VDevCPContext(cp), m_txn_journal_buf{std::move(spare_journal_buf)}, m_txn_log{std::move(txn_log)} {}
 
 void IndexCPContext::add_to_txn_journal(uint32_t index_ordinal, const IndexBufferPtr& parent_buf,
                                         const IndexBufferPtr& left_child_buf, const IndexBufferPtrList& created_bufs,
                                         const IndexBufferPtrList& freed_bufs) {
     auto record_size = txn_record::size_for_num_ids(created_bufs.size() + freed_bufs.size() + (left_child_buf ? 1 : 0) +
                                                     (parent_buf ? 1 : 0));
+    auto const fill_record = [&](txn_journal* tj) {
+        std::vector< BlkId > ids;
+        auto rec = tj->append_record(index_ordinal);
+        if (parent_buf) {
+            rec->append(op_t::parent_inplace, parent_buf->blkid(), ids);
+            if (parent_buf->is_meta_buf()) { rec->is_parent_meta = 0x1; }
+        }
+        if (left_child_buf && (left_child_buf != parent_buf)) {
+            rec->append(op_t::child_inplace, left_child_buf->blkid(), ids);
+        }
+        for (auto const& buf : created_bufs) {
+            rec->append(op_t::child_new, buf->blkid(), ids);
+        }
+        for (auto const& buf : freed_bufs) {
+            rec->append(op_t::child_freed, buf->blkid(), ids);
+        }
+        rec->encode_ids(ids);
+    };
+
     std::unique_lock< iomgr::FiberManagerLib::mutex > lg{m_txn_journal_mtx};
-    if (m_txn_journal_buf.bytes() == nullptr) {
-        m_txn_journal_buf =
-            std::move(sisl::io_blob_safe{std::max(sizeof(txn_journal), 512ul), 512, sisl::buftag::metablk});
+    if (!m_txn_journal_started) {
+        // Buffer is reused from an earlier cp if there is one
+        if (m_txn_journal_buf.bytes() == nullptr) {
+            m_txn_journal_buf =
+                std::move(sisl::io_blob_safe{std::max(sizeof(txn_journal), 512ul), 512, sisl::buftag::metablk});
+        }
         txn_journal* tj = new (m_txn_journal_buf.bytes()) txn_journal();
         tj->cp_id = id();
+        if (m_txn_log) {
+            new (m_txn_journal_buf.bytes() + sizeof(txn_journal)) txn_log_marker();
+            tj->size += sizeof(txn_log_marker);
+        }
+        m_txn_journal_started = true;
+    }
+
+    if (m_txn_log) {
+        // Record is appended as a journal of its own, the journal of the cp keeps only the range of the log
+        auto rbuf = std::make_shared< std::vector< uint8_t > >(sizeof(txn_journal) + record_size);
+        txn_journal* rj = new (rbuf->data()) txn_journal();
+        rj->cp_id = id();
+        fill_record(rj);
+        append_to_txn_log(std::move(rbuf));
+        return;
     }
 
     txn_journal* tj = r_cast< txn_journal* >(m_txn_journal_buf.bytes());
@@ -44,23 +118,36 @@ void IndexCPContext::add_to_txn_journal(uint32_t index_ordinal, const IndexBuffe
                                       sisl::buftag::metablk);
         tj = r_cast< txn_journal* >(m_txn_journal_buf.bytes());
     }
+    fill_record(tj);
+}
 
+// Called under the journal mutex, so that the range in the marker is updated in the order of the appends
+void IndexCPContext::append_to_txn_log(shared< std::vector< uint8_t > > rbuf) {
     {
-        auto rec = tj->append_record(index_ordinal);
-        if (parent_buf) {
-            rec->append(op_t::parent_inplace, parent_buf->blkid());
-            if (parent_buf->is_meta_buf()) { rec->is_parent_meta = 0x1; }
-        }
-        if (left_child_buf && (left_child_buf != parent_buf)) {
-            rec->append(op_t::child_inplace, left_child_buf->blkid());
-        }
-        for (auto const& buf : created_bufs) {
-            rec->append(op_t::child_new, buf->blkid());
-        }
-        for (auto const& buf : freed_bufs) {
-            rec->append(op_t::child_freed, buf->blkid());
-        }
+        std::unique_lock lg{m_txn_log_mtx};
+        ++m_txn_log_pending;
     }
+    auto const size = r_cast< txn_journal const* >(rbuf->data())->size;
+    auto const lsn = m_txn_log->append_async(
+        sisl::io_blob{rbuf->data(), size, false /* is_aligned */}, nullptr,
+        [this, rbuf](logstore_seq_num_t, sisl::io_blob&, logdev_key, void*) {
+            {
+                std::unique_lock lg{m_txn_log_mtx};
+                --m_txn_log_pending;
+            }
+            m_txn_log_cv.notify_all();
+        });
+
+    auto marker = r_cast< txn_log_marker* >(m_txn_journal_buf.bytes() + sizeof(txn_journal));
+    marker->start_lsn = (marker->start_lsn == -1) ? lsn : std::min(marker->start_lsn, lsn);
+    marker->end_lsn = std::max(marker->end_lsn, lsn);
+}
+
+void IndexCPContext::wait_for_txn_log() {
+    if (!m_txn_log) { return; }
+    if (m_txn_log->get_logdev()->allow_explicit_flush()) { m_txn_log->flush(); }
+    std::unique_lock lg{m_txn_log_mtx};
+    m_txn_log_cv.wait(lg, [this] { return (m_txn_log_pending == 0); });
 }
 
 void IndexCPContext::add_to_dirty_list(const IndexBufferPtr& buf) {
@@ -71,13 +158,81 @@ void IndexCPContext::add_to_dirty_list(const IndexBufferPtr& buf) {
 
 bool IndexCPContext::any_dirty_buffers() const { return !m_dirty_buf_count.testz(); }
 
-void IndexCPContext::prepare_flush_iteration() { m_dirty_buf_it = m_dirty_buf_list.begin(); }
+int IndexCPContext::flush_progress_percent() {
+    auto const total = int64_cast(m_dirty_buf_list.size());
+    if (total == 0) { return 100; }
+    auto const remaining = std::clamp(m_dirty_buf_count.get(), int64_t{0}, total);
+    return int_cast(((total - remaining) * 100) / total);
+}
+
+// Every buffer waits only on its up buffer, so the dirty buffers form a forest of DAGs, each of which has to be
+// flushed bottom up, but they are independent of each other. We partition the DAGs across the flushers, balancing the
+// number of buffers in each partition, so that they can be flushed concurrently without any coordination between them.
+// Only the buffers which are not waiting for any down buffer are put in the partition's list, rest of them are flushed
+// by the completion of its last down buffer.
+void IndexCPContext::prepare_flush_iteration(uint32_t num_partitions) {
+    num_partitions = std::max(num_partitions, 1u);
+    std::unordered_map< IndexBuffer*, IndexBuffer* > root_of;
+    std::unordered_map< IndexBuffer*, size_t > dag_size;
+    std::vector< std::pair< IndexBufferPtr, IndexBuffer* > > buf_roots;
+    buf_roots.reserve(m_dirty_buf_list.size());
+
+    auto find_root = [&root_of](IndexBuffer* buf) {
+        std::vector< IndexBuffer* > path;
+        IndexBuffer* root{buf};
+        while (true) {
+            if (auto it = root_of.find(root); it != root_of.end()) {
+                root = it->second;
+                break;
+            }
+            if (root->m_up_buffer == nullptr) {
+                root_of.emplace(root, root);
+                break;
+            }
+            path.push_back(root);
+            root = root->m_up_buffer.get();
+        }
+        for (auto b : path) {
+            root_of[b] = root;
+        }
+        return root;
+    };
+
+    m_dirty_buf_list.foreach_entry([&](IndexBufferPtr buf) {
+        auto root = find_root(buf.get());
+        ++dag_size[root];
+        buf_roots.emplace_back(std::move(buf), root);
+    });
+
+    // Assign the largest DAGs first, each to the least loaded partition
+    std::vector< std::pair< IndexBuffer*, size_t > > dags{dag_size.begin(), dag_size.end()};
+    std::sort(dags.begin(), dags.end(), [](auto const& a, auto const& b) { return a.second > b.second; });
 
-std::optional< IndexBufferPtr > IndexCPContext::next_dirty() {
-    if (m_dirty_buf_it == m_dirty_buf_list.end()) { return std::nullopt; }
-    IndexBufferPtr ret = *m_dirty_buf_it;
-    ++m_dirty_buf_it;
-    return ret;
+    std::vector< size_t > part_load(num_partitions, 0);
+    std::unordered_map< IndexBuffer*, uint32_t > root_part;
+    for (auto const& [root, size] : dags) {
+        auto const p = uint32_cast(std::min_element(part_load.begin(), part_load.end()) - part_load.begin());
+        part_load[p] += size;
+        root_part[root] = p;
+    }
+
+    m_flush_partitions.clear();
+    for (uint32_t p{0}; p < num_partitions; ++p) {
+        m_flush_partitions.emplace_back(std::make_unique< flush_partition >());
+    }
+    for (auto& [buf, root] : buf_roots) {
+        buf->m_flush_partition = root_part[root];
+        if (buf->m_wait_for_down_buffers.testz()) {
+            m_flush_partitions[buf->m_flush_partition]->ready_bufs.emplace_back(std::move(buf));
+        }
+    }
+}
+
+std::optional< IndexBufferPtr > IndexCPContext::next_dirty(uint32_t partition) {
+    auto& part = *m_flush_partitions[partition];
+    std::unique_lock lg{part.mtx};
+    if (part.next_idx == part.ready_bufs.size()) { return std::nullopt; }
+    return std::move(part.ready_bufs[part.next_idx++]);
 }
 
 std::string IndexCPContext::to_string() {
@@ -200,32 +355,93 @@ void IndexCPContext::log_dags() {
     sisl::logging::GetLogger()->flush();
 }
 
-std::map< BlkId, IndexBufferPtr > IndexCPContext::recover(sisl::byte_view sb) {
-    txn_journal const* tj = r_cast< txn_journal const* >(sb.bytes());
-    if (tj->cp_id != id()) {
+std::map< BlkId, IndexBufferPtr > IndexCPContext::recover(sisl::byte_view sb,
+                                                          std::map< logstore_seq_num_t, log_buffer > const& txn_logs) {
+    auto const journal = decode_journal(sb.bytes(), sb.size());
+    if (journal.cp_id != id()) {
         // On clean shutdown, cp_id would be lesser than the current cp_id, in that case ignore this sb
-        HS_DBG_ASSERT_LT(tj->cp_id, id(), "Persisted cp in wb txn journal is more than current cp");
+        HS_DBG_ASSERT_LT(journal.cp_id, id(), "Persisted cp in wb txn journal is more than current cp");
         return {};
     }
-    HS_DBG_ASSERT_GT(tj->num_txns, 0, "Invalid txn_journal, num_txns is zero");
-    HS_DBG_ASSERT_GT(tj->size, 0, "Invalid txn_journal, size of records is zero");
 
     std::map< BlkId, IndexBufferPtr > buf_map;
-    uint8_t const* cur_ptr = r_cast< uint8_t const* >(tj) + sizeof(txn_journal);
-
-    for (uint32_t t{0}; t < tj->num_txns; ++t) {
-        txn_record const* rec = r_cast< txn_record const* >(cur_ptr);
-        HS_DBG_ASSERT_GT(rec->total_ids(), 0, "Invalid txn_record, has no ids in it");
+    auto const process_journal = [this, &buf_map](decoded_journal const& j) {
+        for (auto const& txn : j.txns) {
+            HS_DBG_ASSERT_GT(txn.ids.size(), 0, "Invalid txn_record, has no ids in it");
+            process_txn_record(txn, buf_map);
+        }
+    };
 
-        process_txn_record(rec, buf_map);
-        cur_ptr += rec->size();
+    if (journal.log_marker) {
+        // Records are in the txn log, the range of which could also have records of the cps before and after
+        for (auto lsn = journal.log_marker->start_lsn; lsn <= journal.log_marker->end_lsn; ++lsn) {
+            auto const it = txn_logs.find(lsn);
+            HS_REL_ASSERT(it != txn_logs.cend(), "Record lsn={} of cp={} is missing in the index txn log", lsn,
+                          journal.cp_id);
+            auto const rj = decode_journal(it->second.bytes(), it->second.size());
+            if (rj.cp_id == journal.cp_id) { process_journal(rj); }
+        }
+        return buf_map;
     }
 
+    process_journal(journal);
     return buf_map;
 }
 
-void IndexCPContext::process_txn_record(txn_record const* rec, std::map< BlkId, IndexBufferPtr >& buf_map) {
+IndexCPContext::decoded_journal IndexCPContext::decode_journal(uint8_t const* buf, uint32_t size) {
+    decoded_journal dj;
+    auto const tj = r_cast< txn_journal const* >(buf);
+    if ((size >= sizeof(txn_journal)) && (tj->magic == txn_journal_magic)) {
+        HS_REL_ASSERT_LE(tj->version, txn_journal_version, "Index txn journal version={} is not supported",
+                         tj->version);
+        HS_REL_ASSERT_LE(tj->size, size, "Index txn journal of cp={} is truncated", tj->cp_id);
+        dj.cp_id = tj->cp_id;
+        uint8_t const* cur_ptr = buf + sizeof(txn_journal);
+        if (tj->num_txns == 0) {
+            // Journal of a cp whose records are in the txn log
+            HS_REL_ASSERT_GE(tj->size, sizeof(txn_journal) + sizeof(txn_log_marker), "Invalid txn_journal, no marker");
+            dj.log_marker = *r_cast< txn_log_marker const* >(cur_ptr);
+            return dj;
+        }
+        for (uint32_t t{0}; t < tj->num_txns; ++t) {
+            txn_record const* rec = r_cast< txn_record const* >(cur_ptr);
+            dj.txns.push_back(decoded_txn{*rec, rec->decode_ids()});
+            cur_ptr += rec->size();
+        }
+        return dj;
+    }
+
+    auto const tj0 = r_cast< txn_journal_v0 const* >(buf);
+    HS_REL_ASSERT_GE(size, sizeof(txn_journal_v0), "Invalid txn_journal of version 0, size={}", size);
+    HS_REL_ASSERT_LE(tj0->size, size, "Index txn journal of version 0 of cp={} is truncated", tj0->cp_id);
+    dj.cp_id = tj0->cp_id;
+    uint8_t const* cur_ptr = buf + sizeof(txn_journal_v0);
+    for (uint32_t t{0}; t < tj0->num_txns; ++t) {
+        txn_record_v0 const* rec = r_cast< txn_record_v0 const* >(cur_ptr);
+        decoded_txn txn{txn_record{rec->index_ordinal}, {}};
+        txn.hdr.has_inplace_parent = rec->has_inplace_parent;
+        txn.hdr.has_inplace_child = rec->has_inplace_child;
+        txn.hdr.is_parent_meta = rec->is_parent_meta;
+        txn.hdr.num_new_ids = rec->num_new_ids;
+        txn.hdr.num_freed_ids = rec->num_freed_ids;
+
+        uint8_t const* id_ptr = cur_ptr + sizeof(txn_record_v0);
+        for (uint32_t i{0}; i < rec->total_ids(); ++i, id_ptr += txn_record_v0::id_size) {
+            blk_num_t blk_num;
+            chunk_num_t chunk_num;
+            std::memcpy(&blk_num, id_ptr, sizeof(blk_num_t));
+            std::memcpy(&chunk_num, id_ptr + sizeof(blk_num_t), sizeof(chunk_num_t));
+            txn.ids.emplace_back(BlkId{blk_num, (blk_count_t)1u, chunk_num});
+        }
+        dj.txns.push_back(std::move(txn));
+        cur_ptr += rec->size();
+    }
+    return dj;
+}
+
+void IndexCPContext::process_txn_record(decoded_txn const& txn, std::map< BlkId, IndexBufferPtr >& buf_map) {
     auto cpg = cp_mgr().cp_guard();
+    txn_record const* rec = &txn.hdr;
 
     auto const rec_to_buf = [&buf_map, &cpg](txn_record const* rec, bool is_meta, BlkId const& bid,
                                              IndexBufferPtr const& up_buf) -> IndexBufferPtr {
@@ -274,23 +490,24 @@ void IndexCPContext::process_txn_record(txn_record const* rec, std::map< BlkId,
         return buf;
     };
 
+    auto const& ids = txn.ids;
     uint32_t cur_idx = 0;
     IndexBufferPtr parent_buf{nullptr};
-    if (rec->has_inplace_parent) { parent_buf = rec_to_buf(rec, rec->is_parent_meta, rec->blk_id(cur_idx++), nullptr); }
+    if (rec->has_inplace_parent) { parent_buf = rec_to_buf(rec, rec->is_parent_meta, ids[cur_idx++], nullptr); }
 
     IndexBufferPtr inplace_child_buf{nullptr};
     if (rec->has_inplace_child) {
-        inplace_child_buf = rec_to_buf(rec, false /* is_meta */, rec->blk_id(cur_idx++), parent_buf);
+        inplace_child_buf = rec_to_buf(rec, false /* is_meta */, ids[cur_idx++], parent_buf);
     }
 
     for (uint8_t idx{0}; idx < rec->num_new_ids; ++idx) {
-        auto new_buf = rec_to_buf(rec, false /* is_meta */, rec->blk_id(cur_idx++),
+        auto new_buf = rec_to_buf(rec, false /* is_meta */, ids[cur_idx++],
                                   inplace_child_buf ? inplace_child_buf : parent_buf);
         new_buf->m_created_cp_id = cpg->id();
     }
 
     for (uint8_t idx{0}; idx < rec->num_freed_ids; ++idx) {
-        auto freed_buf = rec_to_buf(rec, false /* is_meta */, rec->blk_id(cur_idx++),
+        auto freed_buf = rec_to_buf(rec, false /* is_meta */, ids[cur_idx++],
                                     inplace_child_buf ? inplace_child_buf : parent_buf);
         freed_buf->m_node_freed = true;
     }
@@ -309,22 +526,88 @@ std::string IndexCPContext::txn_journal::to_string() const {
     return str;
 }
 
+static void put_varint(uint8_t*& p, uint64_t v) {
+    while (v >= 0x80) {
+        *p++ = static_cast< uint8_t >(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = static_cast< uint8_t >(v);
+}
+
+static uint64_t get_varint(uint8_t const*& p) {
+    uint64_t v{0};
+    for (uint32_t shift{0};; shift += 7) {
+        auto const b = *p++;
+        v |= (uint64_t(b & 0x7f) << shift);
+        if ((b & 0x80) == 0) { break; }
+    }
+    return v;
+}
+
+void IndexCPContext::txn_record::encode_ids(std::vector< BlkId > const& ids) {
+    DEBUG_ASSERT_EQ(ids.size(), total_ids(), "Number of ids encoded doesn't match the ops appended");
+
+    std::vector< chunk_num_t > chunks;
+    for (auto const& id : ids) {
+        if (std::find(chunks.begin(), chunks.end(), id.chunk_num()) == chunks.end()) { chunks.push_back(id.chunk_num()); }
+    }
+    DEBUG_ASSERT_LE(chunks.size(), 0xff, "Too many chunks in txn record");
+    num_chunks = static_cast< uint8_t >(chunks.size());
+
+    uint8_t* p = uintptr_cast(this) + sizeof(txn_record);
+    std::memcpy(p, chunks.data(), chunks.size() * sizeof(chunk_num_t));
+    p += chunks.size() * sizeof(chunk_num_t);
+
+    uint8_t* const ids_start = p;
+    std::vector< int64_t > prev_blk(chunks.size(), 0);
+    for (auto const& id : ids) {
+        auto const cidx = std::find(chunks.begin(), chunks.end(), id.chunk_num()) - chunks.begin();
+        if (num_chunks > 1) { put_varint(p, uint64_cast(cidx)); }
+
+        auto const delta = int64_cast(id.blk_num()) - prev_blk[cidx];
+        put_varint(p, (uint64_cast(delta) << 1) ^ uint64_cast(delta >> 63));
+        prev_blk[cidx] = id.blk_num();
+    }
+    ids_size = static_cast< uint16_t >(p - ids_start);
+}
+
+std::vector< BlkId > IndexCPContext::txn_record::decode_ids() const {
+    auto const chunks = r_cast< chunk_num_t const* >(r_cast< uint8_t const* >(this) + sizeof(txn_record));
+    uint8_t const* p = r_cast< uint8_t const* >(chunks + num_chunks);
+
+    std::vector< BlkId > ids;
+    ids.reserve(total_ids());
+    std::vector< int64_t > prev_blk(num_chunks, 0);
+    for (uint32_t i{0}; i < total_ids(); ++i) {
+        auto const cidx = (num_chunks > 1) ? get_varint(p) : 0;
+        auto const zz = get_varint(p);
+        auto const blk = prev_blk[cidx] + (int64_cast(zz >> 1) ^ -int64_cast(zz & 0x1));
+        prev_blk[cidx] = blk;
+        ids.emplace_back(BlkId{static_cast< blk_num_t >(blk), (blk_count_t)1u, chunks[cidx]});
+    }
+    return ids;
+}
+
 std::string IndexCPContext::txn_record::to_string() const {
-    auto add_to_string = [this](std::string& str, uint8_t& idx, uint8_t id_count) {
+    auto const ids = decode_ids();
+    auto add_to_string = [&ids](std::string& str, uint32_t& idx, uint32_t id_count) {
         if (id_count == 0) {
             fmt::format_to(std::back_inserter(str), "empty]");
         } else {
-            for (uint8_t i{0}; i < id_count; ++i, ++idx) {
-                fmt::format_to(std::back_inserter(str), "[chunk={}, blk={}],", ids[idx].second, ids[idx].first);
+            for (uint32_t i{0}; i < id_count; ++i, ++idx) {
+                fmt::format_to(std::back_inserter(str), "[chunk={}, blk={}],", ids[idx].chunk_num(),
+                               ids[idx].blk_num());
             }
             fmt::format_to(std::back_inserter(str), "]");
         }
     };
 
-    std::string str = fmt::format("ordinal={}, parent=[{}], in_place_child=[{}]", index_ordinal, parent_id_string(),
-                                  child_id_string(), num_new_ids, num_freed_ids);
+    uint32_t idx{0};
+    std::string str = fmt::format("ordinal={}, parent=[", index_ordinal);
+    add_to_string(str, idx, has_inplace_parent);
+    fmt::format_to(std::back_inserter(str), ", in_place_child=[");
+    add_to_string(str, idx, has_inplace_child);
 
-    uint8_t idx = (has_inplace_parent == 0x1) ? 1 : 0 + (has_inplace_child == 0x1) ? 1 : 0;
     fmt::format_to(std::back_inserter(str), ", new_ids=[");
     add_to_string(str, idx, num_new_ids);
 
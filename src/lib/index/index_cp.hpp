@@ -15,12 +15,18 @@
  *********************************************************************************/
 #pragma once
 #include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <vector>
 #include <sisl/fds/concurrent_insert_vector.hpp>
 #include <homestore/blk.h>
 #include <homestore/index/index_internal.hpp>
 #include <homestore/index_service.hpp>
 #include <homestore/checkpoint/cp_mgr.hpp>
 #include <homestore/checkpoint/cp.hpp>
+#include <homestore/logstore/log_store.hpp>
 #include <homestore/btree/detail/btree_node.hpp>
 #include "device/virtual_dev.hpp"
 
@@ -31,8 +37,11 @@ class BtreeNode;
 struct IndexCPContext : public VDevCPContext {
 public:
 #pragma pack(1)
-    using compact_blkid_t = std::pair< blk_num_t, chunk_num_t >;
     enum class op_t : uint8_t { child_new, child_freed, parent_inplace, child_inplace };
+
+    // Ids of the record are encoded compactly, since most of the ids of a txn are from one or two chunks and their blk
+    // nums are close to each other. Record header is followed by a chunk dictionary of num_chunks entries and then for
+    // each id, [varint chunk index, only if num_chunks > 1][varint zigzag delta of blk_num from prev id of same chunk]
     struct txn_record {
         uint8_t has_inplace_parent : 1; // Do we have parent_id in the list of ids. It will be first
         uint8_t has_inplace_child : 1;  // Do we have child_id in the list of ids. It will be second
@@ -40,9 +49,11 @@ public:
         uint8_t reserved1 : 5;
         uint8_t num_new_ids;
         uint8_t num_freed_ids;
-        uint8_t reserved{0};
+        uint8_t num_chunks{0}; // Number of entries in the chunk dictionary
         uint32_t index_ordinal;
-        compact_blkid_t ids[1]; // C++ std probhits 0 size array
+        uint16_t ids_size{0}; // Size of the encoded ids, which follows the chunk dictionary
+
+        static constexpr uint32_t max_varint_size = 5; // Zigzag delta of 31 bit blk_num fits in 33 bits
 
         txn_record(uint32_t ordinal) :
                 has_inplace_parent{0x0},
@@ -57,17 +68,12 @@ public:
                     ((has_inplace_child == 0x1) ? 1 : 0));
         }
 
-        uint32_t size() const { return sizeof(txn_record) + (total_ids() - 1) * sizeof(compact_blkid_t); }
-        static uint32_t size_for_num_ids(uint8_t n) { return sizeof(txn_record) + (n - 1) * sizeof(compact_blkid_t); }
-
-        uint32_t next_slot() const {
-            return ((has_inplace_parent == 0x1) ? 1 : 0) + ((has_inplace_child == 0x1) ? 1 : 0) + num_new_ids +
-                num_freed_ids;
+        uint32_t size() const { return sizeof(txn_record) + (num_chunks * sizeof(chunk_num_t)) + ids_size; }
+        static uint32_t size_for_num_ids(uint32_t n) {
+            return sizeof(txn_record) + n * (sizeof(chunk_num_t) + (2 * max_varint_size));
         }
 
-        void append(op_t op, BlkId const& blk) {
-            auto const compact_blk = std::make_pair(blk.blk_num(), blk.chunk_num());
-            auto const slot = next_slot();
+        void append(op_t op, BlkId const& blk, std::vector< BlkId >& ids) {
             if (op == op_t::parent_inplace) {
                 DEBUG_ASSERT(has_inplace_parent == 0x0, "Duplicate inplace parent in same txn record");
                 DEBUG_ASSERT((has_inplace_child == 0x0) && (num_new_ids == 0) && (num_freed_ids == 0),
@@ -85,28 +91,23 @@ public:
             } else {
                 DEBUG_ASSERT(false, "Invalid op type");
             }
-            ids[slot] = compact_blk;
-        }
-
-        BlkId blk_id(uint8_t idx) const {
-            DEBUG_ASSERT_LT(idx, total_ids(), "Index out of bounds");
-            return BlkId{ids[idx].first, (blk_count_t)1u, ids[idx].second};
-        }
-
-        std::string parent_id_string() const {
-            return (has_inplace_parent == 0x1) ? fmt::format("chunk={}, blk={}", ids[0].second, ids[0].first) : "empty";
+            ids.push_back(blk);
         }
 
-        std::string child_id_string() const {
-            auto const idx = (has_inplace_parent == 0x1) ? 1 : 0;
-            return (has_inplace_child == 0x1) ? fmt::format("chunk={}, blk={}", ids[idx].second, ids[idx].first)
-                                              : "empty";
-        }
+        // Encode all the ids appended, right after the header. Buffer is expected to have size_for_num_ids() room
+        void encode_ids(std::vector< BlkId > const& ids);
+        std::vector< BlkId > decode_ids() const;
 
         std::string to_string() const;
     };
 
+    // Journals of no magic are of version 0, which had the ids of the records in plain and had no txn log
+    static constexpr uint64_t txn_journal_magic{0x7a2bedabb1e};
+    static constexpr uint32_t txn_journal_version{0x1};
+
     struct txn_journal {
+        uint64_t magic{txn_journal_magic};
+        uint32_t version{txn_journal_version};
         cp_id_t cp_id;
         uint32_t num_txns{0};
         uint32_t size{sizeof(txn_journal)}; // Total size including this header
@@ -131,35 +132,103 @@ public:
         std::string to_string() const;
         void log_records() const;
     };
+
+    // Journal of a cp whose records are appended to the txn log is only this marker, following a txn_journal header of
+    // no txns. Each record in the log is a txn_journal of a single txn_record.
+    struct txn_log_marker {
+        logstore_seq_num_t start_lsn{-1}; // Range of the log which has all the records of the cp
+        logstore_seq_num_t end_lsn{-1};
+    };
+
+    // Layout of version 0 of the journal, only decoded, for the journal of a cp interrupted before the upgrade
+    struct txn_journal_v0 {
+        cp_id_t cp_id;
+        uint32_t num_txns{0};
+        uint32_t size{sizeof(txn_journal_v0)};
+    };
+
+    struct txn_record_v0 {
+        uint8_t has_inplace_parent : 1;
+        uint8_t has_inplace_child : 1;
+        uint8_t is_parent_meta : 1;
+        uint8_t reserved1 : 5;
+        uint8_t num_new_ids;
+        uint8_t num_freed_ids;
+        uint8_t reserved;
+        uint32_t index_ordinal;
+        // Followed by the ids, each as a packed blk_num and chunk_num
+
+        static constexpr uint32_t id_size = sizeof(blk_num_t) + sizeof(chunk_num_t);
+        uint32_t total_ids() const { return (num_new_ids + num_freed_ids + has_inplace_parent + has_inplace_child); }
+        uint32_t size() const { return sizeof(txn_record_v0) + total_ids() * id_size; }
+    };
 #pragma pack()
 
+    // Record or journal decoded from any of the versions of the journal
+    struct decoded_txn {
+        txn_record hdr;
+        std::vector< BlkId > ids;
+    };
+
+    struct decoded_journal {
+        cp_id_t cp_id{-1};
+        std::vector< decoded_txn > txns;
+        std::optional< txn_log_marker > log_marker; // Set if the records of the cp are in the txn log
+    };
+    static decoded_journal decode_journal(uint8_t const* buf, uint32_t size);
+
 public:
     std::atomic< uint64_t > m_num_nodes_added{0};
     std::atomic< uint64_t > m_num_nodes_removed{0};
     sisl::ConcurrentInsertVector< IndexBufferPtr > m_dirty_buf_list;
     sisl::atomic_counter< int64_t > m_dirty_buf_count{0};
     std::mutex m_flush_buffer_mtx;
-    sisl::ConcurrentInsertVector< IndexBufferPtr >::iterator m_dirty_buf_it;
+
+    // Progress of the cp flush, dirty buffers which are freed or logged as delta are flushed without a node write
+    std::atomic< uint64_t > m_num_nodes_written{0};
+    std::atomic< uint64_t > m_num_bytes_written{0};
+
+    // Independent group of dirty buffers, flushed by one flusher, with its own cursor
+    struct flush_partition {
+        std::mutex mtx;
+        std::vector< IndexBufferPtr > ready_bufs; // Buffers which do not wait for any down buffers
+        size_t next_idx{0};
+    };
+    std::vector< std::unique_ptr< flush_partition > > m_flush_partitions;
 
     iomgr::FiberManagerLib::mutex m_txn_journal_mtx;
     sisl::io_blob_safe m_txn_journal_buf;
+    bool m_txn_journal_started{false};
+
+    // Txn log the records are appended to as they are created, if it was there by the time the cp started. Cp flush
+    // then waits only for the last of them to be written.
+    shared< HomeLogStore > m_txn_log;
+    std::mutex m_txn_log_mtx;
+    std::condition_variable m_txn_log_cv;
+    uint64_t m_txn_log_pending{0};
 
 public:
-    IndexCPContext(CP* cp);
+    IndexCPContext(CP* cp, sisl::io_blob_safe&& spare_journal_buf = sisl::io_blob_safe{},
+                   shared< HomeLogStore > txn_log = nullptr);
     virtual ~IndexCPContext() = default;
 
     // void track_new_blk(BlkId const& inplace_blkid, BlkId const& new_blkid);
     void add_to_txn_journal(uint32_t index_ordinal, const IndexBufferPtr& parent_buf,
                             const IndexBufferPtr& left_child_buf, const IndexBufferPtrList& created_bufs,
                             const IndexBufferPtrList& freed_buf);
-    std::map< BlkId, IndexBufferPtr > recover(sisl::byte_view sb);
+    std::map< BlkId, IndexBufferPtr > recover(sisl::byte_view sb,
+                                              std::map< logstore_seq_num_t, log_buffer > const& txn_logs = {});
+    void wait_for_txn_log();
 
     sisl::io_blob_safe const& journal_buf() const { return m_txn_journal_buf; }
+    bool has_txn_journal() const { return m_txn_journal_started; }
 
     void add_to_dirty_list(const IndexBufferPtr& buf);
     bool any_dirty_buffers() const;
-    void prepare_flush_iteration();
-    std::optional< IndexBufferPtr > next_dirty();
+    int flush_progress_percent();
+    void prepare_flush_iteration(uint32_t num_partitions);
+    uint32_t num_flush_partitions() const { return uint32_cast(m_flush_partitions.size()); }
+    std::optional< IndexBufferPtr > next_dirty(uint32_t partition);
     std::string to_string();
     std::string to_string_with_dags();
     void to_string_dot(const std::string& filename);
@@ -170,7 +239,8 @@ private:
     void check_wait_for_leaders();
     void log_dags();
 
-    void process_txn_record(txn_record const* rec, std::map< BlkId, IndexBufferPtr >& buf_map);
+    void process_txn_record(decoded_txn const& txn, std::map< BlkId, IndexBufferPtr >& buf_map);
+    void append_to_txn_log(shared< std::vector< uint8_t > > rbuf);
 };
 
 class IndexWBCache;
@@ -181,11 +251,19 @@ public:
 
 public:
     std::unique_ptr< CPContext > on_switchover_cp(CP* cur_cp, CP* new_cp) override;
+    std::unique_ptr< CPContext > create_cp_context(CP* cp) override;
     folly::Future< bool > cp_flush(CP* cp) override;
     void cp_cleanup(CP* cp) override;
+    bool cp_cleanup_can_overlap() const override { return true; }
     int cp_progress_percent() override;
+    nlohmann::json cp_flush_stats(CP* cp) const override;
 
 private:
     IndexWBCache* m_wb_cache;
+    std::atomic< IndexCPContext* > m_flushing_ctx{nullptr};
+
+    // Txn journal buffer of a cleaned up cp, reused by the next cp which journals any txn
+    std::mutex m_spare_buf_mtx;
+    sisl::io_blob_safe m_spare_journal_buf;
 };
 } // namespace homestore
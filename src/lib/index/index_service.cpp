@@ -13,6 +13,7 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <boost/fiber/operations.hpp>
 #include <homestore/homestore.hpp>
 #include <homestore/index_service.hpp>
 #include <homestore/index/index_internal.hpp>
@@ -21,6 +22,7 @@
 #include "index/index_cp.hpp"
 #include "common/homestore_utils.hpp"
 #include "common/homestore_assert.hpp"
+#include "common/resource_mgr.hpp"
 #include "device/virtual_dev.hpp"
 #include "device/physical_dev.hpp"
 #include "device/chunk.h"
@@ -37,26 +39,65 @@ IndexService::IndexService(std::unique_ptr< IndexServiceCallbacks > cbs) : m_svc
         },
         nullptr);
 
+    meta_service().register_handler(
+        "index_destroy",
+        [this](meta_blk* mblk, sisl::byte_view buf, size_t size) {
+            m_itable_destroy_sbs.emplace_back(std::pair{mblk, std::move(buf)});
+        },
+        nullptr);
+
+    meta_service().register_handler(
+        "index_scrub",
+        [this](meta_blk* mblk, sisl::byte_view buf, size_t size) {
+            m_itable_scrub_sbs.emplace_back(std::pair{mblk, std::move(buf)});
+        },
+        nullptr);
+
     meta_service().register_handler(
         "wb_cache",
         [this](meta_blk* mblk, sisl::byte_view buf, size_t size) { m_wbcache_sb = std::pair{mblk, std::move(buf)}; },
         nullptr);
+
+    meta_service().register_handler(
+        "wb_cache_delta",
+        [this](meta_blk* mblk, sisl::byte_view buf, size_t size) {
+            m_wbcache_delta_sbs.emplace_back(std::pair{mblk, std::move(buf)});
+        },
+        nullptr);
+
+    meta_service().register_handler(
+        "wb_cache_hot",
+        [this](meta_blk* mblk, sisl::byte_view buf, size_t size) {
+            m_wbcache_hot_sb = std::pair{mblk, std::move(buf)};
+        },
+        nullptr);
+
+    meta_service().register_handler(
+        "wb_cache_txn_log",
+        [this](meta_blk* mblk, sisl::byte_view buf, size_t size) {
+            m_wbcache_txn_log_sb = std::pair{mblk, std::move(buf)};
+        },
+        nullptr);
 }
 
 void IndexService::create_vdev(uint64_t size, HSDevType devType, uint32_t num_chunks) {
     auto const atomic_page_size = hs()->device_mgr()->atomic_page_size(devType);
     hs_vdev_context vdev_ctx;
     vdev_ctx.type = hs_vdev_type_t::INDEX_VDEV;
+    auto const multi_blk = HS_DYNAMIC_CONFIG(generic.index_multi_blk_nodes);
 
     hs()->device_mgr()->create_vdev(vdev_parameters{.vdev_name = "index",
                                                     .vdev_size = size,
                                                     .num_chunks = num_chunks,
                                                     .blk_size = atomic_page_size,
                                                     .dev_type = devType,
-                                                    .alloc_type = blk_allocator_type_t::fixed,
+                                                    .alloc_type = multi_blk ? blk_allocator_type_t::varsize
+                                                                            : blk_allocator_type_t::fixed,
                                                     .chunk_sel_type = chunk_selector_type_t::ROUND_ROBIN,
                                                     .multi_pdev_opts = vdev_multi_pdev_opts_t::ALL_PDEV_STRIPED,
-                                                    .context_data = vdev_ctx.to_blob()});
+                                                    .context_data = vdev_ctx.to_blob(),
+                                                    .use_slab_allocator = multi_blk,
+                                                    .placement = vdev_placement_t::INDEX});
 }
 
 shared< VirtualDev > IndexService::open_vdev(const vdev_info& vinfo, bool load_existing) {
@@ -67,10 +108,16 @@ shared< VirtualDev > IndexService::open_vdev(const vdev_info& vinfo, bool load_e
 
 uint32_t IndexService::reserve_ordinal() { return m_ordinal_reserver->reserve(); }
 
+void IndexService::throttle_update(uint32_t ordinal, uint64_t num_entries) {
+    resource_mgr().throttle_admission(num_entries, admission_class_t::INDEX, ordinal);
+}
+
 void IndexService::start() {
     // Start Writeback cache
-    m_wb_cache = std::make_unique< IndexWBCache >(m_vdev, m_wbcache_sb, hs()->evictor(),
-                                                  hs()->device_mgr()->atomic_page_size(HSDevType::Fast));
+    m_wb_cache =
+        std::make_unique< IndexWBCache >(m_vdev, m_wbcache_sb, std::move(m_wbcache_delta_sbs), m_wbcache_hot_sb,
+                                         m_wbcache_txn_log_sb, hs()->evictor(),
+                                         hs()->device_mgr()->atomic_page_size(HSDevType::Fast));
 
     // Load any index tables which are to loaded from meta blk
     for (auto const& [meta_cookie, buf] : m_itable_sbs) {
@@ -83,13 +130,55 @@ void IndexService::start() {
     m_wb_cache->recover(m_wbcache_sb.second);
 
     // Notify each table that we have completed recovery
-    std::unique_lock lg(m_index_map_mtx);
-    for (const auto& [_, tbl] : m_index_map) {
-        tbl->recovery_completed();
+    {
+        std::unique_lock lg(m_index_map_mtx);
+        for (const auto& [_, tbl] : m_index_map) {
+            tbl->recovery_completed();
+        }
     }
+
+    // Tables whose destroy was interrupted by the shutdown are recovered along with the rest, to resume it now. Read
+    // only open leaves them to the next writable open.
+    m_destroy_stopped.store(false);
+    if (hs()->is_read_only()) { m_itable_destroy_sbs.clear(); }
+    for (auto const& [meta_cookie, buf] : m_itable_destroy_sbs) {
+        auto dsb = std::make_shared< superblk< index_destroy_sb > >("index_destroy");
+        dsb->load(buf, meta_cookie);
+        auto tbl = get_index_table((*dsb)->uuid);
+        if (tbl == nullptr) {
+            // Table superblk is destroyed along with its last nodes, only this one was left
+            dsb->destroy();
+            continue;
+        }
+        LOGINFO("Resuming the destroy of index table uuid={}", boost::uuids::to_string(tbl->uuid()));
+        remove_index_table(tbl);
+        run_destroy(std::move(tbl), std::move(dsb));
+    }
+    m_itable_destroy_sbs.clear();
+
+    // Scrub cursors of the tables, which are gone along with the cursor if the table was destroyed in the meantime
+    for (auto const& [meta_cookie, buf] : m_itable_scrub_sbs) {
+        auto ssb = std::make_shared< superblk< index_scrub_sb > >("index_scrub");
+        ssb->load(buf, meta_cookie);
+        if (get_index_table((*ssb)->uuid) == nullptr) {
+            if (!hs()->is_read_only()) { ssb->destroy(); }
+            continue;
+        }
+        m_scrub_sbs.emplace((*ssb)->uuid, std::move(ssb));
+    }
+    m_itable_scrub_sbs.clear();
+
+    // Tables are ready to take the nodes hot in the previous run, which are read in the background
+    m_wb_cache->warm_up();
 }
 
-void IndexService::stop() { m_wb_cache.reset(); }
+void IndexService::stop() {
+    if (m_wb_cache) {
+        m_wb_cache->stop_prefetches();
+        m_wb_cache->persist_hot_nodes();
+    }
+    m_wb_cache.reset();
+}
 
 void IndexService::add_index_table(const std::shared_ptr< IndexTableBase >& tbl) {
     std::unique_lock lg(m_index_map_mtx);
@@ -103,6 +192,93 @@ void IndexService::remove_index_table(const std::shared_ptr< IndexTableBase >& t
     m_ordinal_index_map.erase(tbl->ordinal());
 }
 
+folly::Future< bool > IndexService::destroy_index_table_async(const std::shared_ptr< IndexTableBase >& tbl) {
+    remove_index_table(tbl);
+    {
+        std::unique_lock lg{m_scrub_mtx};
+        if (auto it = m_scrub_sbs.find(tbl->uuid()); it != m_scrub_sbs.end()) {
+            it->second->destroy();
+            m_scrub_sbs.erase(it);
+        }
+    }
+
+    auto dsb = std::make_shared< superblk< index_destroy_sb > >("index_destroy");
+    dsb->create(sizeof(index_destroy_sb));
+    (*dsb)->uuid = tbl->uuid();
+    dsb->write();
+    return run_destroy(tbl, std::move(dsb));
+}
+
+folly::Future< bool > IndexService::run_destroy(std::shared_ptr< IndexTableBase > tbl,
+                                                std::shared_ptr< superblk< index_destroy_sb > > dsb) {
+    auto promise = std::make_shared< folly::Promise< bool > >();
+    auto fut = promise->getFuture();
+    m_num_destroying.fetch_add(1);
+
+    iomanager.run_on_forget(
+        iomgr::reactor_regex::random_worker, iomgr::fiber_regex::syncio_only,
+        [this, tbl = std::move(tbl), dsb = std::move(dsb), promise]() {
+            uint64_t n_freed_nodes{0};
+            uint64_t n_cp_freed_nodes{0};
+            cp_id_t cp_id{-1};
+            auto ret = btree_status_t::has_more;
+            while (((ret == btree_status_t::has_more) || (ret == btree_status_t::cp_mismatch)) &&
+                   !m_destroy_stopped.load()) {
+                {
+                    auto cpg = hs()->cp_mgr().cp_guard();
+                    if (cpg->id() != cp_id) {
+                        cp_id = cpg->id();
+                        n_cp_freed_nodes = 0;
+                    }
+
+                    auto const max_nodes = HS_DYNAMIC_CONFIG(generic.index_destroy_max_nodes_per_cp);
+                    if ((max_nodes == 0) || (n_cp_freed_nodes < max_nodes)) {
+                        uint64_t n{0};
+                        ret = tbl->destroy_nodes(n, (void*)cpg.context(cp_consumer_t::INDEX_SVC));
+                        n_cp_freed_nodes += n;
+                        n_freed_nodes += n;
+                        continue;
+                    }
+                }
+                // Nodes of this cp are used up, rest of them are freed in the next cp
+                boost::this_fiber::sleep_for(std::chrono::milliseconds{10});
+            }
+
+            auto const uuid_str = boost::uuids::to_string(tbl->uuid());
+            if (ret == btree_status_t::success) {
+                dsb->destroy();
+                LOGINFO("Index table uuid={} is destroyed, freed {} nodes", uuid_str, n_freed_nodes);
+            } else if (m_destroy_stopped.load()) {
+                LOGINFO("Destroy of index table uuid={} is paused after freeing {} nodes, to resume at the next start",
+                        uuid_str, n_freed_nodes);
+            } else {
+                LOGERROR("Destroy of index table uuid={} failed after freeing {} nodes, ret={}", uuid_str,
+                         n_freed_nodes, ret);
+            }
+            m_num_destroying.fetch_sub(1);
+            promise->setValue(ret == btree_status_t::success);
+        });
+    return fut;
+}
+
+std::shared_ptr< superblk< index_scrub_sb > > IndexService::scrub_cursor(uuid_t uuid) {
+    std::unique_lock lg{m_scrub_mtx};
+    auto& ssb = m_scrub_sbs[uuid];
+    if (ssb == nullptr) {
+        ssb = std::make_shared< superblk< index_scrub_sb > >("index_scrub");
+        ssb->create(sizeof(index_scrub_sb));
+        (*ssb)->uuid = uuid;
+    }
+    return ssb;
+}
+
+void IndexService::stop_destroys() {
+    m_destroy_stopped.store(true);
+    while (m_num_destroying.load() != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
 std::shared_ptr< IndexTableBase > IndexService::get_index_table(uuid_t uuid) const {
     std::unique_lock lg(m_index_map_mtx);
     auto const it = m_index_map.find(uuid);
@@ -126,6 +302,8 @@ void IndexService::repair_index_node(uint32_t ordinal, IndexBufferPtr const& nod
 
 uint32_t IndexService::node_size() const { return m_vdev->atomic_page_size(); }
 
+bool IndexService::multi_blk_nodes() const { return m_vdev->allocator_type() == blk_allocator_type_t::varsize; }
+
 uint64_t IndexService::used_size() const {
     auto size{0};
     std::unique_lock lg{m_index_map_mtx};
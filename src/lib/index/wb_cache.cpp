@@ -13,13 +13,20 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <algorithm>
+#include <lz4.h>
+#include <boost/fiber/operations.hpp>
 #include <sisl/fds/thread_vector.hpp>
 #include <homestore/btree/detail/btree_node.hpp>
 #include <homestore/index_service.hpp>
 #include <homestore/homestore.hpp>
+#include <homestore/logstore_service.hpp>
+#include <homestore/cpu_accounting.hpp>
+#include <homestore/perf_stats.hpp>
 #include "device/chunk.h"
 #include "common/homestore_assert.hpp"
 #include "common/homestore_utils.hpp"
+#include "common/thread_placement.hpp"
 
 #include "wb_cache.hpp"
 #include "index_cp.hpp"
@@ -34,6 +41,70 @@ SISL_LOGGING_DECL(wbcache)
 
 namespace homestore {
 
+// Header of the compressed node on the device. Magic is at the same offset as that of the btree node and is different
+// from it, so that a read can tell whether the node is compressed or not.
+#pragma pack(1)
+struct compressed_node_hdr {
+    static constexpr uint8_t COMPRESSED_NODE_MAGIC = 0xcd;
+
+    uint8_t magic{COMPRESSED_NODE_MAGIC};
+    uint8_t reserved[3]{0, 0, 0};
+    uint32_t compressed_size{0};
+};
+#pragma pack()
+static_assert(compressed_node_hdr::COMPRESSED_NODE_MAGIC != BTREE_NODE_MAGIC);
+
+// Delta of a leaf against its on-disk image, followed by nranges of [offset][len][bytes]. It is applied only if the
+// on-disk node is still the base it was computed against.
+#pragma pack(1)
+struct node_delta_hdr {
+    uint64_t blkid;
+    int64_t base_cp_id;
+    uint64_t base_node_gen;
+    uint32_t size; // Including this header
+    uint16_t nranges;
+};
+
+struct node_delta_range {
+    uint16_t offset;
+    uint16_t len;
+};
+
+struct node_delta_journal {
+    static constexpr uint32_t NODE_DELTA_MAGIC = 0xde17a10c;
+
+    uint32_t magic{NODE_DELTA_MAGIC};
+    uint32_t num_deltas{0};
+    uint64_t size{sizeof(node_delta_journal)}; // Including this header
+    uint64_t seq{0};                           // Deltas of a higher seq supersede those of the lower ones
+};
+
+// List of the hot nodes, followed by num_nodes of hot_node_rec, sorted by level from the highest and by blkid within
+// the level, which is the order they are prefetched in
+struct hot_node_journal {
+    static constexpr uint32_t HOT_NODE_MAGIC = 0x407e0de5;
+
+    uint32_t magic{HOT_NODE_MAGIC};
+    uint32_t num_nodes{0};
+};
+
+struct hot_node_rec {
+    uint64_t blkid;
+    uint32_t index_ordinal;
+    uint16_t level;
+    uint16_t reserved{0};
+};
+
+// Log store the txn records of the cps are appended to, created on the first cp flush once it is enabled
+struct txn_log_sb {
+    static constexpr uint32_t TXN_LOG_MAGIC = 0x7a5104d6;
+
+    uint32_t magic{TXN_LOG_MAGIC};
+    logdev_id_t logdev_id;
+    logstore_id_t store_id;
+};
+#pragma pack()
+
 IndexWBCacheBase& wb_cache() {
     try {
         return index_service().wb_cache();
@@ -43,18 +114,35 @@ IndexWBCacheBase& wb_cache() {
 }
 
 IndexWBCache::IndexWBCache(const std::shared_ptr< VirtualDev >& vdev, std::pair< meta_blk*, sisl::byte_view > sb,
+                           std::vector< std::pair< meta_blk*, sisl::byte_view > > delta_sbs,
+                           std::pair< meta_blk*, sisl::byte_view > hot_sb,
+                           std::pair< meta_blk*, sisl::byte_view > txn_log_sb,
                            const std::shared_ptr< sisl::Evictor >& evictor, uint32_t node_size) :
         m_vdev{vdev},
         m_cache{evictor, 100000, node_size,
                 [](const BtreeNodePtr& node) -> BlkId {
                     return static_cast< IndexBtreeNode* >(node.get())->m_idx_buf->m_blkid;
                 },
-                [](const sisl::CacheRecord& rec) -> bool {
+                [this](const sisl::CacheRecord& rec) -> bool {
                     const auto& hnode = (sisl::SingleEntryHashNode< BtreeNodePtr >&)rec;
-                    return (hnode.m_value->m_refcount.test_le(1));
+                    if (!can_evict(hnode.m_value)) { return false; }
+                    auto const& idx_buf = static_cast< IndexBtreeNode* >(hnode.m_value.get())->m_idx_buf;
+                    untrack_hot_node(idx_buf->m_blkid);
+                    table_state(idx_buf->m_index_ordinal).evictions.fetch_add(1, std::memory_order_relaxed);
+                    add_resident_nodes(idx_buf->m_index_ordinal, -1);
+                    return true;
                 }},
         m_node_size{node_size},
-        m_meta_blk{sb.first} {
+        m_meta_blk{sb.first},
+        m_hot_meta_blk{hot_sb.first},
+        m_hot_sb{std::move(hot_sb.second)},
+        m_txn_log_meta_blk{txn_log_sb.first},
+        m_txn_log_sb{std::move(txn_log_sb.second)},
+        m_capacity_nodes{resource_mgr().get_cache_size() / node_size} {
+    for (auto& [mblk, buf] : delta_sbs) {
+        m_delta_meta_blks.push_back(mblk);
+        m_delta_sbs.push_back(std::move(buf));
+    }
     start_flush_threads();
 
     // We need to register the consumer first before recovery, so that recovery can use the cp_ctx created to add/track
@@ -62,6 +150,77 @@ IndexWBCache::IndexWBCache(const std::shared_ptr< VirtualDev >& vdev, std::pair<
     cp_mgr().register_consumer(cp_consumer_t::INDEX_SVC, std::move(std::make_unique< IndexCPCallbacks >(this)));
 }
 
+// Upper levels of the tree are touched by every operation and are a tiny fraction of the nodes, so they are pinned.
+// Rest of the nodes get a second chance if they were accessed after their load, so that a large scan which touches
+// each leaf only once gets evicted ahead of the hot leaves, instead of flushing them out. Tables sharing the cache are
+// evicted from within their quota only once none of them is over its quota.
+bool IndexWBCache::can_evict(BtreeNodePtr const& node) {
+    if (!node->m_refcount.test_le(1)) { return false; }
+
+    auto const pinned_level = HS_DYNAMIC_CONFIG(generic.index_pinned_node_level);
+    if ((pinned_level != 0) && (node->level() >= pinned_level)) { return false; }
+
+    // Node in delta mode has its latest copy only in memory
+    auto inode = static_cast< IndexBtreeNode* >(node.get());
+    if (inode->m_idx_buf->m_persisted_image) { return false; }
+
+    auto const& st = table_state(inode->m_idx_buf->m_index_ordinal);
+    if (!st.over_quota.load(std::memory_order_relaxed) && (quota_nodes(st) != 0) &&
+        (m_num_over_quota.load(std::memory_order_relaxed) > 0)) {
+        return false;
+    }
+
+    return !inode->m_referenced.exchange(false, std::memory_order_relaxed);
+}
+
+IndexWBCache::table_cache_state& IndexWBCache::table_state(uint32_t index_ordinal) {
+    auto it = m_table_states.find(index_ordinal);
+    if (it == m_table_states.cend()) {
+        it = m_table_states.insert(index_ordinal, std::make_shared< table_cache_state >()).first;
+    }
+    return *(it->second);
+}
+
+int64_t IndexWBCache::quota_nodes(table_cache_state const& st) const {
+    auto pct = st.quota_pct.load(std::memory_order_relaxed);
+    if (pct < 0) { pct = static_cast< int32_t >(HS_DYNAMIC_CONFIG(generic.index_cache_table_quota_pct)); }
+    return int64_cast((m_capacity_nodes * pct) / 100);
+}
+
+void IndexWBCache::add_resident_nodes(uint32_t index_ordinal, int64_t n) {
+    auto& st = table_state(index_ordinal);
+    auto const resident = st.resident_nodes.fetch_add(n, std::memory_order_relaxed) + n;
+    auto const quota = quota_nodes(st);
+    bool const over = (quota != 0) && (resident > quota);
+    if (st.over_quota.exchange(over, std::memory_order_relaxed) != over) {
+        m_num_over_quota.fetch_add(over ? 1 : -1, std::memory_order_relaxed);
+    }
+}
+
+void IndexWBCache::set_table_quota(uint32_t index_ordinal, uint32_t quota_pct) {
+    auto const pct = static_cast< int32_t >(std::min(quota_pct, 100u));
+    table_state(index_ordinal).quota_pct.store(pct, std::memory_order_relaxed);
+    add_resident_nodes(index_ordinal, 0); // Reevaluate whether it is over the new quota
+}
+
+nlohmann::json IndexWBCache::get_table_stats() const {
+    nlohmann::json js;
+    for (auto const& [ordinal, st] : m_table_states) {
+        auto const lookups = st->lookups.load(std::memory_order_relaxed);
+        auto const hits = st->hits.load(std::memory_order_relaxed);
+
+        nlohmann::json tjs;
+        tjs["resident_nodes"] = st->resident_nodes.load(std::memory_order_relaxed);
+        tjs["quota_nodes"] = quota_nodes(*st);
+        tjs["over_quota"] = st->over_quota.load(std::memory_order_relaxed);
+        tjs["lookups"] = lookups;
+        tjs["hit_ratio"] = (lookups == 0) ? 0.0 : (double(hits) / lookups);
+        tjs["evictions"] = st->evictions.load(std::memory_order_relaxed);
+        js[std::to_string(ordinal)] = std::move(tjs);
+    }
+    return js;
+}
+
 void IndexWBCache::start_flush_threads() {
     // Start WBCache flush threads
     struct Context {
@@ -76,6 +235,7 @@ void IndexWBCache::start_flush_threads() {
         iomanager.create_reactor("index_cp_flush" + std::to_string(i), iomgr::INTERRUPT_LOOP, 1u,
                                  [this, ctx](bool is_started) {
                                      if (is_started) {
+                                         ThreadPlacement::bind_self(hs_thread_role_t::CP);
                                          {
                                              std::unique_lock< std::mutex > lk{ctx->mtx};
                                              m_cp_flush_fibers.push_back(iomanager.iofiber_self());
@@ -92,17 +252,17 @@ void IndexWBCache::start_flush_threads() {
     }
 }
 
-BtreeNodePtr IndexWBCache::alloc_buf(node_initializer_t&& node_initializer) {
+BtreeNodePtr IndexWBCache::alloc_buf(node_initializer_t&& node_initializer, blk_count_t nblks) {
     auto cpg = cp_mgr().cp_guard();
     auto cp_ctx = r_cast< IndexCPContext* >(cpg.context(cp_consumer_t::INDEX_SVC));
 
     // Alloc a block of data from underlying vdev
     BlkId blkid;
-    auto ret = m_vdev->alloc_contiguous_blks(1, blk_alloc_hints{}, blkid);
+    auto ret = m_vdev->alloc_contiguous_blks(nblks, blk_alloc_hints{}, blkid);
     if (ret != BlkAllocStatus::SUCCESS) { return nullptr; }
 
     // Alloc buffer and initialize the node
-    auto idx_buf = std::make_shared< IndexBuffer >(blkid, m_node_size, m_vdev->align_size());
+    auto idx_buf = std::make_shared< IndexBuffer >(blkid, node_size_of(blkid), m_vdev->align_size());
     idx_buf->m_created_cp_id = cpg->id();
     idx_buf->m_dirtied_cp_id = cpg->id();
     auto node = node_initializer(idx_buf);
@@ -111,6 +271,9 @@ BtreeNodePtr IndexWBCache::alloc_buf(node_initializer_t&& node_initializer) {
         // Add the node to the cache. Skip if we are in recovery mode.
         bool done = m_cache.insert(node);
         HS_REL_ASSERT_EQ(done, true, "Unable to add alloc'd node to cache, low memory or duplicate inserts?");
+        invalidate_prefetch(blkid);
+        add_resident_nodes(idx_buf->m_index_ordinal, 1);
+        track_hot_node(node);
     }
 
     // The entire index is updated in the commit path, so we alloc the blk and commit them right away
@@ -121,32 +284,56 @@ BtreeNodePtr IndexWBCache::alloc_buf(node_initializer_t&& node_initializer) {
 }
 
 void IndexWBCache::write_buf(const BtreeNodePtr& node, const IndexBufferPtr& buf, CPContext* cp_ctx) {
+    HS_CPU_SCOPE(WB_CACHE);
     // TODO upsert always returns false even if it succeeds.
     if (m_in_recovery) {
         if (buf->is_meta_buf()) {
             auto const& sb = r_cast< MetaIndexBuffer* >(buf.get())->m_sb;
             meta_service().update_sub_sb(buf->m_bytes, sb.size(), sb.meta_blk());
         } else {
-            m_vdev->sync_write(r_cast< const char* >(buf->raw_buffer()), m_node_size, buf->m_blkid);
+            m_vdev->sync_write(r_cast< const char* >(buf->raw_buffer()), node_size_of(buf->m_blkid), buf->m_blkid);
         }
     } else {
-        if (node != nullptr) { m_cache.upsert(node); }
+        if (node != nullptr) {
+            static_cast< IndexBtreeNode* >(node.get())->m_referenced.store(true, std::memory_order_relaxed);
+            m_cache.upsert(node);
+        }
+        invalidate_prefetch(buf->m_blkid);
         LOGTRACEMOD(wbcache, "add to dirty list cp {} {}", cp_ctx->id(), buf->to_string());
         r_cast< IndexCPContext* >(cp_ctx)->add_to_dirty_list(buf);
-        resource_mgr().inc_dirty_buf_size(m_node_size);
+        resource_mgr().inc_dirty_buf_size(buf_size(buf));
     }
 }
 
 void IndexWBCache::read_buf(bnodeid_t id, BtreeNodePtr& node, node_initializer_t&& node_initializer) {
+    HS_CPU_SCOPE(WB_CACHE);
     auto const blkid = BlkId{id};
 
 retry:
     // Check if the blkid is already in cache, if not load and put it into the cache
-    if (!m_in_recovery && m_cache.get(blkid, node)) { return; }
+    if (!m_in_recovery && m_cache.get(blkid, node)) {
+        auto inode = static_cast< IndexBtreeNode* >(node.get());
+        if (!inode->m_prefetched.exchange(false, std::memory_order_relaxed)) {
+            inode->m_referenced.store(true, std::memory_order_relaxed);
+        }
+        PerfStats::cache_lookup(perf_cache_t::INDEX_WB_CACHE, true);
+        auto& st = table_state(inode->m_idx_buf->m_index_ordinal);
+        st.lookups.fetch_add(1, std::memory_order_relaxed);
+        st.hits.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
 
-    // Read the buffer from virtual device
-    auto idx_buf = std::make_shared< IndexBuffer >(blkid, m_node_size, m_vdev->align_size());
-    m_vdev->sync_read(r_cast< char* >(idx_buf->raw_buffer()), m_node_size, blkid);
+    // Read the buffer from virtual device, unless a delta was applied on it by a read only open
+    auto idx_buf = std::make_shared< IndexBuffer >(blkid, node_size_of(blkid), m_vdev->align_size());
+    if (auto const it = m_delta_applied_bufs.find(blkid); it != m_delta_applied_bufs.cend()) {
+        std::memcpy(idx_buf->raw_buffer(), it->second->raw_buffer(), node_size_of(blkid));
+    } else {
+        m_vdev->sync_read(r_cast< char* >(idx_buf->raw_buffer()), node_size_of(blkid), blkid);
+        // Caller of the read fails the btree op with node_read_failed on a node which can't be decompressed
+        if (!decompress_buf(idx_buf->raw_buffer(), node_size_of(blkid))) {
+            throw std::runtime_error(fmt::format("Unable to decompress the index node blkid={}", blkid.to_string()));
+        }
+    }
 
     // Create the btree node out of buffer
     node = node_initializer(idx_buf);
@@ -158,7 +345,118 @@ retry:
             // There is a race between 2 concurrent reads from vdev and other party won the race. Re-read from cache
             goto retry;
         }
+        invalidate_prefetch(blkid);
+        PerfStats::cache_lookup(perf_cache_t::INDEX_WB_CACHE, false);
+        table_state(idx_buf->m_index_ordinal).lookups.fetch_add(1, std::memory_order_relaxed);
+        add_resident_nodes(idx_buf->m_index_ordinal, 1);
+        track_hot_node(node);
+    }
+}
+
+void IndexWBCache::prefetch_bufs(std::vector< bnodeid_t > const& ids, node_initializer_t const& node_initializer) {
+    if (m_in_recovery) { return; }
+
+    bool submitted{false};
+    for (auto const id : ids) {
+        auto const blkid = BlkId{id};
+        if (m_delta_applied_bufs.contains(blkid)) { continue; }
+
+        // Prefetch is registered before the cache is looked up, so that a load racing with it either is found in the
+        // cache or marks the prefetch
+        {
+            std::unique_lock lg{m_prefetch_mtx};
+            if (m_prefetch_stopped) { break; }
+            if (!m_inflight_prefetches.emplace(blkid, false).second) { continue; }
+            m_num_inflight_prefetches.fetch_add(1);
+        }
+        BtreeNodePtr node;
+        if (m_cache.get(blkid, node)) {
+            complete_prefetch(blkid, nullptr, node_initializer);
+            continue;
+        }
+
+        auto idx_buf = std::make_shared< IndexBuffer >(blkid, node_size_of(blkid), m_vdev->align_size());
+        m_vdev->async_read(r_cast< char* >(idx_buf->raw_buffer()), node_size_of(blkid), blkid, true /* part_of_batch */)
+            .thenValue([this, blkid, idx_buf, node_initializer](std::error_code err) {
+                if (err) {
+                    LOGDEBUGMOD(wbcache, "Prefetch of buf={} failed err={}, ignoring it", idx_buf->to_string(),
+                                err.message());
+                    complete_prefetch(blkid, nullptr, node_initializer);
+                    return;
+                }
+#ifdef _PRERELEASE
+                if (iomgr_flip::instance()->delay_flip("simulate_index_prefetch_delay",
+                                                       [this, blkid, idx_buf, node_initializer]() {
+                                                           complete_prefetch(blkid, idx_buf, node_initializer);
+                                                       })) {
+                    return;
+                }
+#endif
+                complete_prefetch(blkid, idx_buf, node_initializer);
+            });
+        submitted = true;
     }
+    if (submitted) { m_vdev->submit_batch(); }
+}
+
+// Prefetched node is added to the cache under the prefetch lock, so that a load which marks it after the check below
+// finds the node in the cache instead, or its own insert beats this one
+void IndexWBCache::complete_prefetch(BlkId const& blkid, IndexBufferPtr const& idx_buf,
+                                     node_initializer_t const& node_initializer) {
+    std::unique_lock lg{m_prefetch_mtx};
+    auto const it = m_inflight_prefetches.find(blkid);
+    HS_DBG_ASSERT(it != m_inflight_prefetches.end(), "Prefetch of blkid={} completed without being in flight",
+                  blkid.to_string());
+    bool const stale = it->second;
+    m_inflight_prefetches.erase(it);
+    if (m_num_inflight_prefetches.fetch_sub(1) == 1) { m_prefetch_cv.notify_all(); }
+    if ((idx_buf == nullptr) || m_prefetch_stopped) { return; }
+
+    if (stale) {
+        LOGDEBUGMOD(wbcache, "Dropping the prefetch of buf={}, node was loaded or modified while it was in flight",
+                    idx_buf->to_string());
+        return;
+    }
+    // Let the regular read deal with a corrupted node
+    if (!decompress_buf(idx_buf->raw_buffer(), node_size_of(blkid))) { return; }
+
+    // If a regular read has raced and loaded the node already, insert fails and we drop ours
+    auto node = node_initializer(idx_buf);
+    static_cast< IndexBtreeNode* >(node.get())->m_prefetched.store(true, std::memory_order_relaxed);
+    if (m_cache.insert(node)) { add_resident_nodes(idx_buf->m_index_ordinal, 1); }
+}
+
+void IndexWBCache::stop_prefetches() {
+    std::unique_lock lg{m_prefetch_mtx};
+    m_prefetch_stopped = true;
+    if (m_num_inflight_prefetches.load() != 0) {
+        LOGINFOMOD(wbcache, "Waiting for {} prefetches in flight to complete", m_num_inflight_prefetches.load());
+    }
+    m_prefetch_cv.wait(lg, [this]() { return m_num_inflight_prefetches.load() == 0; });
+}
+
+void IndexWBCache::invalidate_prefetch(BlkId const& blkid) {
+    if (m_num_inflight_prefetches.load() == 0) { return; }
+    std::unique_lock lg{m_prefetch_mtx};
+    if (auto it = m_inflight_prefetches.find(blkid); it != m_inflight_prefetches.end()) { it->second = true; }
+}
+
+bool IndexWBCache::evict_buf(bnodeid_t id) {
+    if (m_in_recovery) { return false; }
+    auto const blkid = BlkId{id};
+    BtreeNodePtr node;
+    if (!m_cache.get(blkid, node)) { return false; }
+
+    // Besides the cache, only we hold the node
+    auto const& idx_buf = static_cast< IndexBtreeNode* >(node.get())->m_idx_buf;
+    if (!node->m_refcount.test_le(2) || !idx_buf->is_clean() || idx_buf->m_persisted_image) { return false; }
+
+    auto const ordinal = idx_buf->m_index_ordinal;
+    if (!m_cache.remove(blkid, node)) { return false; }
+    untrack_hot_node(blkid);
+    table_state(ordinal).evictions.fetch_add(1, std::memory_order_relaxed);
+    add_resident_nodes(ordinal, -1);
+    return true;
 }
 
 bool IndexWBCache::get_writable_buf(const BtreeNodePtr& node, CPContext* context) {
@@ -176,16 +474,25 @@ bool IndexWBCache::get_writable_buf(const BtreeNodePtr& node, CPContext* context
         HS_DBG_ASSERT_EQ(idx_buf->m_dirtied_cp_id, icp_ctx->id() - 1,
                          "Buffer is dirty, but its dirtied_cp_id is neither current nor previous cp id");
 
-        // If its not clean, we do deep copy.
-        auto new_buf = std::make_shared< IndexBuffer >(idx_buf->m_blkid, m_node_size, m_vdev->align_size());
+        // If its not clean, we do deep copy of the header and the bytes of the node in use. Free gap in between is
+        // never read by the node, so it is left as is in the new buffer.
+        auto const node_size = node_size_of(idx_buf->m_blkid);
+        auto new_buf = std::make_shared< IndexBuffer >(idx_buf->m_blkid, node_size, m_vdev->align_size());
         new_buf->m_created_cp_id = idx_buf->m_created_cp_id;
-        std::memcpy(new_buf->raw_buffer(), idx_buf->raw_buffer(), m_node_size);
+        new_buf->m_index_ordinal = idx_buf->m_index_ordinal;
+        auto const [head, tail] = node->used_data_extents();
+        auto const head_end = sizeof(persistent_hdr_t) + head;
+        auto const tail_start = std::max(sizeof(persistent_hdr_t) + tail, head_end);
+        std::memcpy(new_buf->raw_buffer(), idx_buf->raw_buffer(), head_end);
+        std::memcpy(new_buf->raw_buffer() + tail_start, idx_buf->raw_buffer() + tail_start, node_size - tail_start);
 
         node->update_phys_buf(new_buf->raw_buffer());
         LOGTRACEMOD(wbcache, "cp={} cur_buf={} for node={} is dirtied by cp={} copying new_buf={}", icp_ctx->id(),
                     static_cast< void* >(idx_buf.get()), node->node_id(), idx_buf->m_dirtied_cp_id,
                     static_cast< void* >(new_buf.get()));
         idx_buf = std::move(new_buf);
+    } else if (idx_buf->m_persisted_image == nullptr) {
+        capture_persisted_image(node, idx_buf, icp_ctx);
     }
     idx_buf->m_dirtied_cp_id = icp_ctx->id();
     return true;
@@ -383,27 +690,43 @@ void IndexWBCache::free_buf(const IndexBufferPtr& buf, CPContext* cp_ctx) {
     if (!m_in_recovery) {
         bool done = m_cache.remove(buf->m_blkid, node);
         HS_REL_ASSERT_EQ(done, true, "Race on cache removal of btree blkid?");
+        invalidate_prefetch(buf->m_blkid);
+        add_resident_nodes(buf->m_index_ordinal, -1);
+        untrack_hot_node(buf->m_blkid);
     }
 
-    resource_mgr().inc_free_blk(m_node_size);
+    resource_mgr().inc_free_blk(node_size_of(buf->m_blkid));
     m_vdev->free_blk(buf->m_blkid, s_cast< VDevCPContext* >(cp_ctx));
 }
 
 //////////////////// Recovery Related section /////////////////////////////////
 void IndexWBCache::recover(sisl::byte_view sb) {
+    // Deltas are applied ahead of everything, so that the repair of nodes starts from their latest update
+    recover_node_deltas();
+    open_txn_log();
+    auto const txn_logs = std::move(m_recovered_txn_logs);
+    m_recovered_txn_logs.clear();
+
     // If sb is empty, its possible a first time boot.
     if ((sb.bytes() == nullptr) || (sb.size() == 0)) {
         m_vdev->recovery_completed();
         return;
     }
 
+    // Repair would write the nodes, so a read only open serves the nodes as they were written by the interrupted cp
+    if (hs()->is_read_only()) {
+        LOGWARNMOD(wbcache, "Unclean shutdown is not repaired by a read only open, nodes of last cp could be stale");
+        m_vdev->recovery_completed();
+        return;
+    }
+
     m_in_recovery = true; // For entirity of this call, we should mark it as being recovered.
 
     // Recover the CP Context with the buf_map of all the buffers that were dirtied in the last cp with its
     // relationship (up/down buf links) as it was by the cp that was flushing the buffers prior to unclean shutdown.
     auto cpg = cp_mgr().cp_guard();
     auto icp_ctx = r_cast< IndexCPContext* >(cpg.context(cp_consumer_t::INDEX_SVC));
-    std::map< BlkId, IndexBufferPtr > bufs = icp_ctx->recover(std::move(sb));
+    std::map< BlkId, IndexBufferPtr > bufs = icp_ctx->recover(std::move(sb), txn_logs);
 
     LOGINFOMOD(wbcache, "Detected unclean shutdown, prior cp={} had to flush {} nodes, recovering... ", icp_ctx->id(),
                bufs.size());
@@ -461,13 +784,54 @@ void IndexWBCache::recover(sisl::byte_view sb) {
     // Second iteration we start from the lowest levels (which are all new_bufs) and check if up_buffers need to be
     // repaired. All L1 buffers are not needed to repair, because they are sibling nodes and so we pass false in
     // do_repair flag.
-    for (auto const& buf : l0_bufs) {
-        recover_buf(buf->m_up_buffer);
-    }
+    recover_index_tables(l0_bufs);
     m_in_recovery = false;
     m_vdev->recovery_completed();
 }
 
+// Buffers of an index table are linked only to buffers of the same table, so each table is repaired independently on
+// the cp flush fibers, which are otherwise idle during recovery.
+void IndexWBCache::recover_index_tables(std::vector< IndexBufferPtr > const& l0_bufs) {
+    std::map< uint32_t, std::vector< IndexBufferPtr > > table_bufs;
+    for (auto const& buf : l0_bufs) {
+        table_bufs[buf->m_index_ordinal].push_back(buf);
+    }
+    if (table_bufs.empty()) { return; }
+
+    struct Context {
+        std::condition_variable cv;
+        std::mutex mtx;
+        size_t tables_done{0};
+        std::atomic< size_t > next_table{0};
+        std::vector< std::pair< uint32_t, std::vector< IndexBufferPtr > > > tables;
+    };
+    auto ctx = std::make_shared< Context >();
+    ctx->tables.assign(std::make_move_iterator(table_bufs.begin()), std::make_move_iterator(table_bufs.end()));
+
+    auto const nfibers = std::min(m_cp_flush_fibers.size(), ctx->tables.size());
+    for (size_t f{0}; f < nfibers; ++f) {
+        iomanager.run_on_forget(m_cp_flush_fibers[f], [this, ctx]() {
+            size_t t;
+            while ((t = ctx->next_table.fetch_add(1)) < ctx->tables.size()) {
+                auto const& [ordinal, bufs] = ctx->tables[t];
+                for (auto const& buf : bufs) {
+                    recover_buf(buf->m_up_buffer);
+                }
+                LOGINFOMOD(wbcache, "Index Recovery of index ordinal={} completed, walked through {} new/freed nodes",
+                           ordinal, bufs.size());
+                {
+                    std::unique_lock< std::mutex > lk{ctx->mtx};
+                    ++(ctx->tables_done);
+                }
+                ctx->cv.notify_one();
+            }
+        });
+    }
+
+    std::unique_lock< std::mutex > lk{ctx->mtx};
+    ctx->cv.wait(lk, [ctx] { return (ctx->tables_done == ctx->tables.size()); });
+}
+
 void IndexWBCache::recover_buf(IndexBufferPtr const& buf) {
     if (!buf->m_wait_for_down_buffers.decrement_testz()) { return; }
 
@@ -497,9 +861,13 @@ bool IndexWBCache::was_node_committed(IndexBufferPtr const& buf) {
     // All down_buf has indicated that they have seen this up buffer, now its time to repair them.
     if (buf->m_bytes == nullptr) {
         // Read the btree node and get its modified cp_id
-        buf->m_bytes = hs_utils::iobuf_alloc(m_node_size, sisl::buftag::btree_node, m_vdev->align_size());
-        m_vdev->sync_read(r_cast< char* >(buf->m_bytes), m_node_size, buf->blkid());
-        if (!BtreeNode::is_valid_node(sisl::blob{buf->m_bytes, m_node_size})) { return false; }
+        auto const node_size = node_size_of(buf->blkid());
+        buf->m_bytes = hs_utils::iobuf_alloc(node_size, sisl::buftag::btree_node, m_vdev->align_size());
+        m_vdev->sync_read(r_cast< char* >(buf->m_bytes), node_size, buf->blkid());
+        if (!decompress_buf(buf->m_bytes, node_size) ||
+            !BtreeNode::is_valid_node(sisl::blob{buf->m_bytes, node_size})) {
+            return false;
+        }
 
         buf->m_dirtied_cp_id = BtreeNode::get_modified_cp_id(buf->m_bytes);
     }
@@ -507,9 +875,88 @@ bool IndexWBCache::was_node_committed(IndexBufferPtr const& buf) {
     return (buf->m_dirtied_cp_id == cpg->id());
 }
 
+// Txn log is replayed ahead of the rest of the log service, since the repair of the index needs its records before
+// the log stores of the consumers are replayed, which could update the index.
+void IndexWBCache::open_txn_log() {
+    if ((m_txn_log_sb.bytes() == nullptr) || (m_txn_log_sb.size() < sizeof(txn_log_sb)) || hs()->is_read_only()) {
+        return;
+    }
+    auto const tsb = *r_cast< txn_log_sb const* >(m_txn_log_sb.bytes());
+    HS_REL_ASSERT_EQ(tsb.magic, txn_log_sb::TXN_LOG_MAGIC, "Invalid index txn log superblk, magic mismatch");
+    HS_REL_ASSERT(hs()->has_log_service(), "Index txn log logdev={} is present, but log service is not",
+                  tsb.logdev_id);
+
+    logstore_service().open_logdev(tsb.logdev_id);
+    logstore_service()
+        .open_log_store(tsb.logdev_id, tsb.store_id, true /* append_mode */)
+        .thenValue([this](auto log_store) {
+            log_store->register_log_found_cb([this](logstore_seq_num_t lsn, log_buffer buf, void*) {
+                m_recovered_txn_logs.emplace(lsn, std::move(buf));
+            });
+            std::unique_lock lg{m_txn_log_mtx};
+            m_txn_log = std::move(log_store);
+        });
+    logstore_service().start_logdev(tsb.logdev_id);
+    HS_REL_ASSERT(m_txn_log, "Index txn log store={} of logdev={} is not found", tsb.store_id, tsb.logdev_id);
+    LOGINFOMOD(wbcache, "Replayed {} records of index txn log logdev={} store={}", m_recovered_txn_logs.size(),
+               tsb.logdev_id, tsb.store_id);
+}
+
+void IndexWBCache::create_txn_log_if_needed() {
+    if (!HS_DYNAMIC_CONFIG(generic.index_txn_log) || !hs()->has_log_service()) { return; }
+    {
+        std::unique_lock lg{m_txn_log_mtx};
+        if (m_txn_log) { return; }
+    }
+    // Log service of a consumer doing its own recovery could be started later, its logdevs are created after
+    if (logstore_service().num_flush_threads() == 0) { return; }
+
+    auto const logdev_id = logstore_service().create_new_logdev();
+    auto log_store = logstore_service().create_new_log_store(logdev_id, true /* append_mode */);
+
+    txn_log_sb tsb;
+    tsb.logdev_id = logdev_id;
+    tsb.store_id = log_store->get_store_id();
+    sisl::io_blob_safe buf{512, 512, sisl::buftag::metablk};
+    std::memcpy(buf.bytes(), &tsb, sizeof(tsb));
+    meta_service().add_sub_sb("wb_cache_txn_log", buf.cbytes(), sizeof(tsb), m_txn_log_meta_blk);
+    LOGINFOMOD(wbcache, "Created index txn log logdev={} store={}", tsb.logdev_id, tsb.store_id);
+
+    // Cps created from now on append their records to it
+    std::unique_lock lg{m_txn_log_mtx};
+    m_txn_log = std::move(log_store);
+}
+
+shared< HomeLogStore > IndexWBCache::txn_log() {
+    if (!HS_DYNAMIC_CONFIG(generic.index_txn_log)) { return nullptr; }
+    std::unique_lock lg{m_txn_log_mtx};
+    return m_txn_log;
+}
+
+// Records of a cp could be interleaved in the log with those of the cp before it, but not with those of the cp after
+// that, which is started only once the cp before is flushed. So records upto the last of the previous cp are of the
+// completed cps and are truncated, while those of this cp are kept till the next one completes.
+void IndexWBCache::truncate_txn_log(IndexCPContext* cp_ctx) {
+    auto const marker = r_cast< IndexCPContext::txn_log_marker const* >(cp_ctx->journal_buf().cbytes() +
+                                                                          sizeof(IndexCPContext::txn_journal));
+    logstore_seq_num_t upto;
+    {
+        std::unique_lock lg{m_txn_log_mtx};
+        upto = m_txn_log_truncate_lsn;
+        m_txn_log_truncate_lsn = std::max(m_txn_log_truncate_lsn, marker->end_lsn);
+    }
+    if (upto <= cp_ctx->m_txn_log->truncated_upto()) { return; }
+
+    cp_ctx->m_txn_log->truncate(upto);
+    cp_ctx->m_txn_log->get_logdev()->truncate();
+}
+
 //////////////////// CP Related API section /////////////////////////////////
 folly::Future< bool > IndexWBCache::async_cp_flush(IndexCPContext* cp_ctx) {
+    HS_CPU_SCOPE(WB_CACHE);
     LOGTRACEMOD(wbcache, "Starting Index CP Flush with cp context={}", cp_ctx->to_string_with_dags());
+    persist_hot_nodes_if_due();
+    create_txn_log_if_needed();
     if (!cp_ctx->any_dirty_buffers()) {
         if (cp_ctx->id() == 0) {
             // For the first CP, we need to flush the journal buffer to the meta blk
@@ -528,9 +975,14 @@ folly::Future< bool > IndexWBCache::async_cp_flush(IndexCPContext* cp_ctx) {
     }
 #endif
 
-    // First thing is to flush the new_blks created as part of the CP.
+    // Log the deltas of the leaves which need not be written in full, before any of the node writes
+    log_node_deltas(cp_ctx);
+
+    // First thing is to flush the new_blks created as part of the CP. Records appended to the txn log have to be
+    // written before the marker of them is.
     auto const& journal_buf = cp_ctx->journal_buf();
-    if (journal_buf.size() != 0) {
+    if (cp_ctx->has_txn_journal()) {
+        cp_ctx->wait_for_txn_log();
         if (m_meta_blk) {
             meta_service().update_sub_sb(journal_buf.cbytes(), journal_buf.size(), m_meta_blk);
         } else {
@@ -538,19 +990,25 @@ folly::Future< bool > IndexWBCache::async_cp_flush(IndexCPContext* cp_ctx) {
         }
     }
 
-    cp_ctx->prepare_flush_iteration();
-
-    for (auto& fiber : m_cp_flush_fibers) {
-        iomanager.run_on_forget(fiber, [this, cp_ctx]() {
-            IndexBufferPtrList buf_list;
-            get_next_bufs(cp_ctx, resource_mgr().get_dirty_buf_qd(), buf_list);
+    cp_ctx->prepare_flush_iteration(uint32_cast(m_cp_flush_fibers.size()));
 
-            for (auto& buf : buf_list) {
-                do_flush_one_buf(cp_ctx, buf, true);
-            }
-            m_vdev->submit_batch();
-        });
+    auto const start_flush = [this, cp_ctx]() {
+        for (uint32_t i{0}; i < m_cp_flush_fibers.size(); ++i) {
+            iomanager.run_on_forget(m_cp_flush_fibers[i], [this, cp_ctx, i]() {
+                IndexBufferPtrList buf_list;
+                get_next_bufs(cp_ctx, resource_mgr().get_dirty_buf_qd(), i, nullptr, buf_list);
+                do_flush_bufs(cp_ctx, buf_list);
+            });
+        }
+    };
+#ifdef _PRERELEASE
+    // Keeps the bufs of this cp dirty for a while, so that the next cp has to take copies of them
+    if (iomgr_flip::instance()->delay_flip("simulate_index_cp_flush_delay", start_flush)) {
+        LOGINFOMOD(wbcache, "Delaying the flush of cp={}", cp_ctx->id());
+        return std::move(cp_ctx->get_future());
     }
+#endif
+    start_flush();
     return std::move(cp_ctx->get_future());
 }
 
@@ -583,11 +1041,22 @@ void IndexWBCache::do_flush_one_buf(IndexCPContext* cp_ctx, IndexBufferPtr const
         LOGTRACEMOD(wbcache, "Not flushing buf {} as it was freed, its here for merely dependency", cp_ctx->id(),
                     buf->to_string());
         process_write_completion(cp_ctx, buf);
+    } else if (buf->m_delta_logged) {
+        LOGTRACEMOD(wbcache, "Not flushing cp {} buf {} as its update is logged as delta", cp_ctx->id(),
+                    buf->to_string());
+        process_write_completion(cp_ctx, buf);
     } else {
         LOGTRACEMOD(wbcache, "flushing cp {} buf {} info: {}", cp_ctx->id(), buf->to_string(),
                     BtreeNode::to_string_buf(buf->raw_buffer()));
-        m_vdev->async_write(r_cast< const char* >(buf->raw_buffer()), m_node_size, buf->m_blkid, part_of_batch)
-            .thenValue([buf, cp_ctx](auto) {
+        uint32_t write_size{node_size_of(buf->m_blkid)};
+        uint8_t* cbuf = compress_buf(buf, write_size);
+        cp_ctx->m_num_nodes_written.fetch_add(1, std::memory_order_relaxed);
+        cp_ctx->m_num_bytes_written.fetch_add(write_size, std::memory_order_relaxed);
+        m_vdev
+            ->async_write(r_cast< const char* >(cbuf ? cbuf : buf->raw_buffer()), write_size, buf->m_blkid,
+                          part_of_batch)
+            .thenValue([buf, cp_ctx, cbuf](auto) {
+                if (cbuf) { hs_utils::iobuf_free(cbuf, sisl::buftag::btree_node); }
                 try {
                     auto& pthis = s_cast< IndexWBCache& >(wb_cache());
                     pthis.process_write_completion(cp_ctx, buf);
@@ -600,6 +1069,497 @@ void IndexWBCache::do_flush_one_buf(IndexCPContext* cp_ctx, IndexBufferPtr const
     }
 }
 
+// Writes of the cp are paced by the cp flush rate limit, the delayed ones are issued from the flush fiber of their
+// partition once their delay is over, so that the completion path isn't held up
+void IndexWBCache::do_flush_bufs(IndexCPContext* cp_ctx, IndexBufferPtrList& bufs) {
+    if (!bufs.empty()) {
+        uint64_t nbytes{0};
+        for (auto const& buf : bufs) {
+            nbytes += buf_size(buf);
+        }
+        if (auto const delay_us = cp_mgr().cp_flush_delay_us(nbytes); delay_us != 0) {
+            auto const fiber = m_cp_flush_fibers[bufs[0]->m_flush_partition % m_cp_flush_fibers.size()];
+            iomanager.run_on_forget(fiber, [this, cp_ctx, delay_us, bufs = std::move(bufs)]() mutable {
+                boost::this_fiber::sleep_for(std::chrono::microseconds{delay_us});
+                issue_flush_bufs(cp_ctx, bufs);
+            });
+            return;
+        }
+    }
+    issue_flush_bufs(cp_ctx, bufs);
+}
+
+// Flush all the buffers as one batch. Node buffers which sit on physically contiguous blks of the same chunk are merged
+// into a single vectored write, so that a large cp issues fewer and larger ios.
+void IndexWBCache::issue_flush_bufs(IndexCPContext* cp_ctx, IndexBufferPtrList& bufs) {
+    auto const max_coalesce = HS_DYNAMIC_CONFIG(generic.index_flush_max_coalesce_nodes);
+    if ((bufs.size() <= 1) || (max_coalesce <= 1) || HS_DYNAMIC_CONFIG(generic.index_node_compression)) {
+        // Compressed nodes are of variable size, so they can't be laid contiguously
+        for (auto& buf : bufs) {
+            do_flush_one_buf(cp_ctx, buf, true);
+        }
+        m_vdev->submit_batch();
+        return;
+    }
+
+    auto can_coalesce = [](IndexBufferPtr const& buf) {
+#ifdef _PRERELEASE
+        if (buf->m_crash_flag_on || hs()->crash_simulator().is_crashed()) { return false; }
+#endif
+        return !buf->is_meta_buf() && !buf->m_node_freed && !buf->m_delta_logged;
+    };
+
+    // Move all the coalescable buffers to the front, sorted by their physical location
+    auto const coalesce_end = std::stable_partition(bufs.begin(), bufs.end(), can_coalesce);
+    std::sort(bufs.begin(), coalesce_end, [](IndexBufferPtr const& a, IndexBufferPtr const& b) {
+        return (a->m_blkid.chunk_num() != b->m_blkid.chunk_num()) ? (a->m_blkid.chunk_num() < b->m_blkid.chunk_num())
+                                                                  : (a->m_blkid.blk_num() < b->m_blkid.blk_num());
+    });
+
+    auto it = bufs.begin();
+    while (it != coalesce_end) {
+        auto run_end = it + 1;
+        while ((run_end != coalesce_end) && (uint32_cast(run_end - it) < max_coalesce) &&
+               ((*run_end)->m_blkid.chunk_num() == (*it)->m_blkid.chunk_num()) &&
+               ((*run_end)->m_blkid.blk_num() ==
+                (*(run_end - 1))->m_blkid.blk_num() + (*(run_end - 1))->m_blkid.blk_count())) {
+            ++run_end;
+        }
+
+        if (run_end - it == 1) {
+            do_flush_one_buf(cp_ctx, *it, true);
+        } else {
+            do_flush_contiguous_bufs(cp_ctx, IndexBufferPtrList(it, run_end));
+        }
+        it = run_end;
+    }
+
+    for (; it != bufs.end(); ++it) {
+        do_flush_one_buf(cp_ctx, *it, true);
+    }
+    m_vdev->submit_batch();
+}
+
+void IndexWBCache::do_flush_contiguous_bufs(IndexCPContext* cp_ctx, IndexBufferPtrList&& bufs) {
+    auto iovs = std::make_shared< std::vector< iovec > >();
+    iovs->reserve(bufs.size());
+    uint64_t nbytes{0};
+    blk_count_t nblks{0};
+    for (auto const& buf : bufs) {
+        LOGTRACEMOD(wbcache, "flushing cp {} buf {} as part of coalesced write of {} bufs", cp_ctx->id(),
+                    buf->to_string(), bufs.size());
+        buf->set_state(index_buf_state_t::FLUSHING);
+        iovs->emplace_back(iovec{buf->raw_buffer(), node_size_of(buf->m_blkid)});
+        nbytes += node_size_of(buf->m_blkid);
+        nblks += buf->m_blkid.blk_count();
+    }
+
+    cp_ctx->m_num_nodes_written.fetch_add(bufs.size(), std::memory_order_relaxed);
+    cp_ctx->m_num_bytes_written.fetch_add(nbytes, std::memory_order_relaxed);
+
+    auto const& first_blkid = bufs[0]->m_blkid;
+    m_vdev
+        ->async_writev(iovs->data(), int_cast(iovs->size()),
+                       BlkId{first_blkid.blk_num(), nblks, first_blkid.chunk_num()},
+                       true /* part_of_batch */)
+        .thenValue([bufs = std::move(bufs), cp_ctx, iovs](auto) {
+            try {
+                auto& pthis = s_cast< IndexWBCache& >(wb_cache());
+                pthis.process_write_completion(cp_ctx, bufs);
+            } catch (const std::runtime_error& e) {
+                LOGERROR("Failed to access write-back cache: {}", e.what());
+            }
+        });
+}
+
+//////////////////////////////////// Node Delta Section ////////////////////////////////////
+// A leaf which is going to be modified in place, gets a copy of its on-disk image, so that at cp flush we can log only
+// the modified bytes. Until the node is written in full, the node is not evicted, since the disk copy is stale.
+void IndexWBCache::capture_persisted_image(BtreeNodePtr const& node, IndexBufferPtr const& buf,
+                                           IndexCPContext* cp_ctx) {
+    if ((HS_DYNAMIC_CONFIG(generic.index_delta_max_bytes) == 0) || !node->is_leaf() ||
+        (buf->m_created_cp_id == cp_ctx->id())) {
+        return;
+    }
+    if (m_num_delta_images->load(std::memory_order_relaxed) >= HS_DYNAMIC_CONFIG(generic.index_delta_max_nodes)) {
+        return;
+    }
+
+    m_num_delta_images->fetch_add(1, std::memory_order_relaxed);
+    buf->m_persisted_image = std::shared_ptr< uint8_t[] >(new uint8_t[node_size_of(buf->m_blkid)],
+                                                          [cnt = m_num_delta_images](uint8_t* p) {
+                                                              delete[] p;
+                                                              cnt->fetch_sub(1, std::memory_order_relaxed);
+                                                          });
+    std::memcpy(buf->m_persisted_image.get(), buf->raw_buffer(), node_size_of(buf->m_blkid));
+    buf->m_num_delta_cps = 0;
+}
+
+// Only the in-place updates, which are not part of any structural change in this cp, are logged as deltas, everything
+// else is written in full. Deltas logged by this cp are persisted in a new meta blk before any node of this cp is
+// written, so that a cp writes only its own deltas. Deltas superseded by the later cps or released on a full write of
+// the node pile up in the older meta blks, so they are compacted into a single one of the latest deltas once there are
+// too many of them or they are more than twice the size of the latest deltas.
+void IndexWBCache::log_node_deltas(IndexCPContext* cp_ctx) {
+    static constexpr size_t max_delta_records = 16;
+    auto const max_bytes = HS_DYNAMIC_CONFIG(generic.index_delta_max_bytes);
+    auto const max_cps = HS_DYNAMIC_CONFIG(generic.index_delta_max_cps);
+
+    std::unique_lock lg{m_delta_mtx};
+    std::vector< BlkId > logged_ids;
+    cp_ctx->m_dirty_buf_list.foreach_entry([&](IndexBufferPtr buf) {
+        if ((buf->m_persisted_image == nullptr) || (max_bytes == 0) || (buf->m_num_delta_cps >= max_cps) ||
+            buf->is_meta_buf() || buf->m_node_freed || (buf->m_up_buffer != nullptr) ||
+            !buf->m_wait_for_down_buffers.testz() || (buf->m_created_cp_id == cp_ctx->id())) {
+            return;
+        }
+
+        auto delta = build_node_delta(buf, max_bytes);
+        if (delta.empty()) { return; } // Delta is too big, better to write the node
+        m_node_deltas[buf->m_blkid] = std::move(delta);
+        logged_ids.push_back(buf->m_blkid);
+        buf->m_delta_logged = true;
+        ++buf->m_num_delta_cps;
+    });
+
+    if (m_node_deltas.empty()) {
+        // All the deltas are released, the nodes are written in full
+        remove_delta_records(m_delta_meta_blks.size());
+        return;
+    }
+    if (logged_ids.empty()) { return; } // Released deltas are stale on their own, as the node is no longer their base
+
+    uint64_t live_bytes{0};
+    for (auto const& [_, delta] : m_node_deltas) {
+        live_bytes += delta.size();
+    }
+
+    std::vector< std::vector< uint8_t > const* > deltas;
+    uint64_t cp_bytes{0};
+    for (auto const& id : logged_ids) {
+        deltas.push_back(&m_node_deltas[id]);
+        cp_bytes += deltas.back()->size();
+    }
+
+    if (m_delta_meta_blks.empty() || (m_delta_meta_blks.size() >= max_delta_records) ||
+        (m_delta_log_bytes + cp_bytes > 2 * live_bytes)) {
+        deltas.clear();
+        for (auto const& [_, delta] : m_node_deltas) {
+            deltas.push_back(&delta);
+        }
+        append_delta_record(deltas, true /* compact */);
+    } else {
+        append_delta_record(deltas, false /* compact */);
+    }
+    LOGTRACEMOD(wbcache, "cp={} logged deltas of {} nodes, {} meta blks of {} bytes in the delta log", cp_ctx->id(),
+                logged_ids.size(), m_delta_meta_blks.size(), m_delta_log_bytes);
+}
+
+// Compacted record is persisted before the older ones are removed, so a crash in between leaves the older records,
+// whose deltas are either superseded by the compacted record by seq or stale by the base of the node.
+void IndexWBCache::append_delta_record(std::vector< std::vector< uint8_t > const* > const& deltas, bool compact) {
+    node_delta_journal jhdr;
+    jhdr.seq = m_delta_seq++;
+    jhdr.num_deltas = uint32_cast(deltas.size());
+    for (auto const delta : deltas) {
+        jhdr.size += delta->size();
+    }
+
+    sisl::io_blob_safe jbuf{uint32_cast(sisl::round_up(jhdr.size, 512ul)), 512, sisl::buftag::metablk};
+    std::memcpy(jbuf.bytes(), &jhdr, sizeof(jhdr));
+    auto cur = jbuf.bytes() + sizeof(jhdr);
+    for (auto const delta : deltas) {
+        std::memcpy(cur, delta->data(), delta->size());
+        cur += delta->size();
+    }
+
+    void* mblk{nullptr};
+    meta_service().add_sub_sb("wb_cache_delta", jbuf.cbytes(), jhdr.size, mblk);
+    if (compact) { remove_delta_records(m_delta_meta_blks.size()); }
+    m_delta_meta_blks.push_back(mblk);
+    m_delta_log_bytes += jhdr.size - sizeof(node_delta_journal);
+}
+
+void IndexWBCache::remove_delta_records(size_t count) {
+    for (size_t i{0}; i < count; ++i) {
+        meta_service().remove_sub_sb(m_delta_meta_blks[i]);
+    }
+    m_delta_meta_blks.erase(m_delta_meta_blks.begin(), m_delta_meta_blks.begin() + count);
+    if (m_delta_meta_blks.empty()) { m_delta_log_bytes = 0; }
+}
+
+// Diff is done on 8 byte words, the differing words which are separated by no more than one word are merged into a
+// single range. Returns empty if the delta exceeds max_bytes.
+std::vector< uint8_t > IndexWBCache::build_node_delta(IndexBufferPtr const& buf, uint32_t max_bytes) const {
+    static constexpr uint32_t word_size = sizeof(uint64_t);
+    uint8_t const* cur = buf->raw_buffer();
+    uint8_t const* base = buf->m_persisted_image.get();
+
+    std::vector< std::pair< uint32_t, uint32_t > > ranges;
+    uint32_t size{sizeof(node_delta_hdr)};
+    for (uint32_t off{0}, node_size{node_size_of(buf->m_blkid)}; off < node_size; off += word_size) {
+        if (std::memcmp(cur + off, base + off, word_size) == 0) { continue; }
+        if (!ranges.empty() && (ranges.back().first + ranges.back().second + word_size >= off)) {
+            size += off + word_size - (ranges.back().first + ranges.back().second);
+            ranges.back().second = off + word_size - ranges.back().first;
+        } else {
+            ranges.emplace_back(off, word_size);
+            size += sizeof(node_delta_range) + word_size;
+        }
+        if (size > max_bytes) { return {}; }
+    }
+
+    std::vector< uint8_t > delta(size);
+    auto hdr = r_cast< node_delta_hdr* >(delta.data());
+    hdr->blkid = buf->m_blkid.to_integer();
+    hdr->base_cp_id = BtreeNode::get_modified_cp_id(buf->m_persisted_image.get());
+    hdr->base_node_gen = r_cast< persistent_hdr_t const* >(base)->node_gen;
+    hdr->size = size;
+    hdr->nranges = static_cast< uint16_t >(ranges.size());
+
+    auto p = delta.data() + sizeof(node_delta_hdr);
+    for (auto const& [off, len] : ranges) {
+        node_delta_range const r{static_cast< uint16_t >(off), static_cast< uint16_t >(len)};
+        std::memcpy(p, &r, sizeof(r));
+        std::memcpy(p + sizeof(r), cur + off, len);
+        p += sizeof(r) + len;
+    }
+    return delta;
+}
+
+void IndexWBCache::release_node_delta(IndexBufferPtr const& buf) {
+    {
+        std::unique_lock lg{m_delta_mtx};
+        m_node_deltas.erase(buf->m_blkid);
+    }
+    buf->m_persisted_image.reset();
+    buf->m_num_delta_cps = 0;
+}
+
+// Apply the logged deltas on the nodes and write them in full, so that the rest of the recovery and the later cps see
+// the node up to date. Records are replayed in the order of their seq, so the latest delta of a node is applied. A node
+// which was written in full after its delta was logged, is no longer the base of the delta and it is skipped. Read
+// only open keeps the applied nodes in memory instead, along with their journal.
+void IndexWBCache::recover_node_deltas() {
+    std::vector< node_delta_journal const* > records;
+    for (auto const& sb : m_delta_sbs) {
+        if ((sb.bytes() == nullptr) || (sb.size() < sizeof(node_delta_journal))) { continue; }
+        auto const jhdr = r_cast< node_delta_journal const* >(sb.bytes());
+        if ((jhdr->magic != node_delta_journal::NODE_DELTA_MAGIC) || (jhdr->size > sb.size())) {
+            LOGERRORMOD(wbcache, "Node delta journal is corrupted, magic={} size={}, ignoring it", jhdr->magic,
+                        jhdr->size);
+            continue;
+        }
+        records.push_back(jhdr);
+    }
+    std::sort(records.begin(), records.end(),
+              [](node_delta_journal const* a, node_delta_journal const* b) { return a->seq < b->seq; });
+
+    std::map< BlkId, node_delta_hdr const* > latest;
+    for (auto const jhdr : records) {
+        auto cur = r_cast< uint8_t const* >(jhdr) + sizeof(node_delta_journal);
+        for (uint32_t i{0}; i < jhdr->num_deltas; ++i) {
+            auto const rec = r_cast< node_delta_hdr const* >(cur);
+            cur += rec->size;
+            latest[BlkId{rec->blkid}] = rec;
+        }
+        m_delta_seq = std::max(m_delta_seq, jhdr->seq + 1);
+    }
+
+    uint32_t num_applied{0};
+    for (auto const& [blkid, rec] : latest) {
+        auto const node_size = node_size_of(blkid);
+        auto idx_buf = std::make_shared< IndexBuffer >(blkid, node_size, m_vdev->align_size());
+        m_vdev->sync_read(r_cast< char* >(idx_buf->raw_buffer()), node_size, blkid);
+        if (!decompress_buf(idx_buf->raw_buffer(), node_size)) { continue; }
+
+        auto const phdr = r_cast< persistent_hdr_t const* >(idx_buf->raw_buffer());
+        if ((phdr->modified_cp_id != rec->base_cp_id) || (phdr->node_gen != rec->base_node_gen)) {
+            LOGDEBUGMOD(wbcache, "Node blkid={} is modified after its delta, skipping the delta", blkid.to_string());
+            continue;
+        }
+
+        auto p = r_cast< uint8_t const* >(rec) + sizeof(node_delta_hdr);
+        for (uint16_t r{0}; r < rec->nranges; ++r) {
+            auto const range = r_cast< node_delta_range const* >(p);
+            std::memcpy(idx_buf->raw_buffer() + range->offset, p + sizeof(node_delta_range), range->len);
+            p += sizeof(node_delta_range) + range->len;
+        }
+
+        if (!BtreeNode::is_valid_node(sisl::blob{idx_buf->raw_buffer(), node_size})) {
+            LOGERRORMOD(wbcache, "Node blkid={} is not valid after applying its delta, skipping it", blkid.to_string());
+            continue;
+        }
+        if (hs()->is_read_only()) {
+            m_delta_applied_bufs[blkid] = std::move(idx_buf);
+        } else {
+            m_vdev->sync_write(r_cast< const char* >(idx_buf->raw_buffer()), node_size, blkid);
+        }
+        ++num_applied;
+    }
+    if (!records.empty()) {
+        LOGINFOMOD(wbcache, "Applied deltas on {} out of {} nodes from {} delta records", num_applied, latest.size(),
+                   records.size());
+    }
+
+    if (!hs()->is_read_only()) { remove_delta_records(m_delta_meta_blks.size()); }
+    m_delta_sbs.clear();
+}
+
+//////////////////// Warm up Related section /////////////////////////////////
+// Interior nodes are few and are on the path of every op, so they are always tracked. Leaves are tracked as long as
+// there is room, and make room as they are evicted.
+void IndexWBCache::track_hot_node(BtreeNodePtr const& node) {
+    auto const max_nodes = HS_DYNAMIC_CONFIG(generic.index_warmup_max_nodes);
+    if (max_nodes == 0) { return; }
+
+    auto const& buf = static_cast< IndexBtreeNode* >(node.get())->m_idx_buf;
+    std::unique_lock lg{m_hot_mtx};
+    if ((node->level() == 0) && (m_hot_nodes.size() >= max_nodes)) { return; }
+    m_hot_nodes.insert_or_assign(buf->m_blkid.to_integer(),
+                                 hot_node{buf->m_index_ordinal, static_cast< uint16_t >(node->level())});
+    m_hot_changed = true;
+}
+
+void IndexWBCache::untrack_hot_node(BlkId const& blkid) {
+    std::unique_lock lg{m_hot_mtx};
+    if (m_hot_nodes.erase(blkid.to_integer())) { m_hot_changed = true; }
+}
+
+void IndexWBCache::persist_hot_nodes_if_due() {
+    auto const interval_ms = uint64_cast(HS_DYNAMIC_CONFIG(generic.index_warmup_persist_secs)) * 1000;
+    {
+        std::unique_lock lg{m_hot_mtx};
+        if (!m_hot_changed || (get_time_since_epoch_ms() < m_hot_persisted_ms + interval_ms)) { return; }
+    }
+    persist_hot_nodes();
+}
+
+void IndexWBCache::persist_hot_nodes() {
+    std::vector< hot_node_rec > recs;
+    {
+        std::unique_lock lg{m_hot_mtx};
+        if (!m_hot_changed) { return; }
+        recs.reserve(m_hot_nodes.size());
+        for (auto const& [id, hn] : m_hot_nodes) {
+            recs.push_back(hot_node_rec{id, hn.index_ordinal, hn.level});
+        }
+        m_hot_changed = false;
+        m_hot_persisted_ms = get_time_since_epoch_ms();
+    }
+    std::sort(recs.begin(), recs.end(), [](hot_node_rec const& a, hot_node_rec const& b) {
+        return (a.level != b.level) ? (a.level > b.level) : (a.blkid < b.blkid);
+    });
+
+    hot_node_journal jhdr;
+    jhdr.num_nodes = uint32_cast(recs.size());
+    auto const size = sizeof(hot_node_journal) + (recs.size() * sizeof(hot_node_rec));
+    sisl::io_blob_safe jbuf{uint32_cast(sisl::round_up(size, 512ul)), 512, sisl::buftag::metablk};
+    std::memcpy(jbuf.bytes(), &jhdr, sizeof(jhdr));
+    if (!recs.empty()) { std::memcpy(jbuf.bytes() + sizeof(jhdr), recs.data(), recs.size() * sizeof(hot_node_rec)); }
+
+    if (m_hot_meta_blk) {
+        meta_service().update_sub_sb(jbuf.cbytes(), size, m_hot_meta_blk);
+    } else {
+        meta_service().add_sub_sb("wb_cache_hot", jbuf.cbytes(), size, m_hot_meta_blk);
+    }
+    LOGDEBUGMOD(wbcache, "Persisted {} hot nodes for the warm up", jhdr.num_nodes);
+}
+
+// Nodes of a level are read in batches of adjacent blkids per index table, so that the device gets large sequential
+// batches, and the levels from the root down, so that the interior nodes are in cache ahead of the leaves.
+void IndexWBCache::warm_up() {
+    auto const sb = std::move(m_hot_sb);
+    if ((sb.bytes() == nullptr) || (sb.size() < sizeof(hot_node_journal))) { return; }
+
+    auto const jhdr = r_cast< hot_node_journal const* >(sb.bytes());
+    if ((jhdr->magic != hot_node_journal::HOT_NODE_MAGIC) ||
+        (sizeof(hot_node_journal) + (uint64_cast(jhdr->num_nodes) * sizeof(hot_node_rec)) > sb.size())) {
+        LOGERRORMOD(wbcache, "Hot node list is corrupted, magic={} num_nodes={}, skipping the warm up", jhdr->magic,
+                    jhdr->num_nodes);
+        return;
+    }
+    if (HS_DYNAMIC_CONFIG(generic.index_warmup_max_nodes) == 0) { return; }
+
+    auto const recs = r_cast< hot_node_rec const* >(sb.bytes() + sizeof(hot_node_journal));
+    auto const batch_nodes = std::max(HS_DYNAMIC_CONFIG(generic.index_warmup_batch_nodes), 1u);
+    std::map< uint32_t, std::vector< bnodeid_t > > table_ids;
+    auto const issue = [&table_ids, batch_nodes](bool all) {
+        for (auto& [ordinal, ids] : table_ids) {
+            if (ids.empty() || (!all && (ids.size() < batch_nodes))) { continue; }
+            auto tbl = index_service().get_index_table(ordinal);
+            if (tbl) { tbl->prefetch_nodes(ids); }
+            ids.clear();
+        }
+    };
+
+    {
+        // Prefetched nodes are not loaded by a miss, so they are tracked here to remain in the list
+        std::unique_lock lg{m_hot_mtx};
+        for (uint32_t i{0}; i < jhdr->num_nodes; ++i) {
+            m_hot_nodes.insert_or_assign(recs[i].blkid, hot_node{recs[i].index_ordinal, recs[i].level});
+        }
+    }
+
+    for (uint32_t i{0}; i < jhdr->num_nodes; ++i) {
+        if ((i > 0) && (recs[i].level != recs[i - 1].level)) { issue(true /* all */); }
+        table_ids[recs[i].index_ordinal].push_back(recs[i].blkid);
+        issue(false /* all */);
+    }
+    issue(true /* all */);
+    LOGINFOMOD(wbcache, "Warming up the cache with {} hot nodes of the previous run", jhdr->num_nodes);
+}
+
+// Compress the node into a new io buffer, which the caller has to free after the write. Node is written compressed only
+// if it saves at least one io unit, otherwise it returns nullptr and the node is written as is.
+uint8_t* IndexWBCache::compress_buf(IndexBufferPtr const& buf, uint32_t& out_size) const {
+    if (!HS_DYNAMIC_CONFIG(generic.index_node_compression)) { return nullptr; }
+
+    auto const align_size = m_vdev->align_size();
+    auto const node_size = node_size_of(buf->m_blkid);
+    if (node_size <= sizeof(compressed_node_hdr) + align_size) { return nullptr; }
+    auto const max_csize = int_cast(node_size - sizeof(compressed_node_hdr) - align_size);
+
+    uint8_t* cbuf = hs_utils::iobuf_alloc(node_size, sisl::buftag::btree_node, align_size);
+    auto const csize =
+        LZ4_compress_default(r_cast< const char* >(buf->raw_buffer()), r_cast< char* >(cbuf + sizeof(compressed_node_hdr)),
+                             int_cast(node_size), max_csize);
+    if (csize <= 0) {
+        hs_utils::iobuf_free(cbuf, sisl::buftag::btree_node);
+        return nullptr;
+    }
+
+    new (cbuf) compressed_node_hdr{};
+    r_cast< compressed_node_hdr* >(cbuf)->compressed_size = uint32_cast(csize);
+    out_size = sisl::round_up(sizeof(compressed_node_hdr) + csize, align_size);
+    std::memset(cbuf + sizeof(compressed_node_hdr) + csize, 0, out_size - sizeof(compressed_node_hdr) - csize);
+    return cbuf;
+}
+
+// Decompress the node in place, if it was written compressed. Returns false if the compressed node is corrupted.
+bool IndexWBCache::decompress_buf(uint8_t* raw_buf, uint32_t node_size) const {
+    auto const hdr = r_cast< compressed_node_hdr const* >(raw_buf);
+    if (hdr->magic != compressed_node_hdr::COMPRESSED_NODE_MAGIC) { return true; }
+
+    auto const csize = hdr->compressed_size;
+    if (csize > node_size - sizeof(compressed_node_hdr)) {
+        LOGERRORMOD(wbcache, "Compressed node has invalid compressed size={}", csize);
+        return false;
+    }
+
+    // Compressed data is moved out to a per thread scratch buffer, so that it can be decompressed in place
+    static thread_local std::vector< char > s_cdata;
+    if (s_cdata.size() < csize) { s_cdata.resize(csize); }
+    std::memcpy(s_cdata.data(), raw_buf + sizeof(compressed_node_hdr), csize);
+    auto const dsize =
+        LZ4_decompress_safe(s_cdata.data(), r_cast< char* >(raw_buf), int_cast(csize), int_cast(node_size));
+    if (dsize != int_cast(node_size)) {
+        LOGERRORMOD(wbcache, "Decompression of node failed, ret={} expected_size={}", dsize, node_size);
+        return false;
+    }
+    return true;
+}
+
 void IndexWBCache::process_write_completion(IndexCPContext* cp_ctx, IndexBufferPtr const& buf) {
 #ifdef _PRERELEASE
     if (hs()->crash_simulator().is_crashed()) {
@@ -609,57 +1569,80 @@ void IndexWBCache::process_write_completion(IndexCPContext* cp_ctx, IndexBufferP
 #endif
 
     LOGTRACEMOD(wbcache, "cp {} buf {}", cp_ctx->id(), buf->to_string());
-    resource_mgr().dec_dirty_buf_size(m_node_size);
+    resource_mgr().dec_dirty_buf_size(buf_size(buf));
     auto [next_buf, has_more] = on_buf_flush_done(cp_ctx, buf);
     if (next_buf) {
-        do_flush_one_buf(cp_ctx, next_buf, false);
+        IndexBufferPtrList next_bufs{std::move(next_buf)};
+        do_flush_bufs(cp_ctx, next_bufs);
     } else if (!has_more) {
-        // We are done flushing the buffers, We flush the vdev to persist the vdev bitmaps and free blks
-        // Pick a CP Manager blocking IO fiber to execute the cp flush of vdev
-        iomanager.run_on_forget(cp_mgr().pick_blocking_io_fiber(), [this, cp_ctx]() {
-            LOGTRACEMOD(wbcache, "Initiating CP flush");
-            m_vdev->cp_flush(cp_ctx); // This is a blocking io call
-            cp_ctx->complete(true);
-        });
+        complete_cp_flush(cp_ctx);
     }
 }
 
-std::pair< IndexBufferPtr, bool > IndexWBCache::on_buf_flush_done(IndexCPContext* cp_ctx, IndexBufferPtr const& buf) {
-    if (m_cp_flush_fibers.size() > 1) {
-        std::unique_lock lg(m_flush_mtx);
-        return on_buf_flush_done_internal(cp_ctx, buf);
-    } else {
-        return on_buf_flush_done_internal(cp_ctx, buf);
+void IndexWBCache::process_write_completion(IndexCPContext* cp_ctx, IndexBufferPtrList const& bufs) {
+#ifdef _PRERELEASE
+    if (hs()->crash_simulator().is_crashed()) {
+        LOGINFOMOD(wbcache, "Crash simulation is ongoing, ignore all process_write_completion");
+        return;
+    }
+#endif
+
+    // Followers of all the buffers of the coalesced write are flushed as a batch, so they get coalesced as well
+    IndexBufferPtrList next_bufs;
+    bool all_done{false};
+    for (auto const& buf : bufs) {
+        LOGTRACEMOD(wbcache, "cp {} buf {}", cp_ctx->id(), buf->to_string());
+        resource_mgr().dec_dirty_buf_size(buf_size(buf));
+        auto [next_buf, has_more] = on_buf_flush_done(cp_ctx, buf);
+        if (next_buf) {
+            next_bufs.emplace_back(std::move(next_buf));
+        } else if (!has_more) {
+            all_done = true;
+        }
+    }
+
+    if (!next_bufs.empty()) {
+        do_flush_bufs(cp_ctx, next_bufs);
+    } else if (all_done) {
+        complete_cp_flush(cp_ctx);
     }
 }
 
-std::pair< IndexBufferPtr, bool > IndexWBCache::on_buf_flush_done_internal(IndexCPContext* cp_ctx,
-                                                                           IndexBufferPtr const& buf) {
+void IndexWBCache::complete_cp_flush(IndexCPContext* cp_ctx) {
+    // We are done flushing the buffers, We flush the vdev to persist the vdev bitmaps and free blks
+    // Pick a CP Manager blocking IO fiber to execute the cp flush of vdev
+    iomanager.run_on_forget(cp_mgr().pick_blocking_io_fiber(), [this, cp_ctx]() {
+        LOGTRACEMOD(wbcache, "Initiating CP flush");
+        m_vdev->cp_flush(cp_ctx); // This is a blocking io call
+        cp_ctx->complete(true);
+    });
+}
+
+std::pair< IndexBufferPtr, bool > IndexWBCache::on_buf_flush_done(IndexCPContext* cp_ctx, IndexBufferPtr const& buf) {
     IndexBufferPtrList buf_list;
 #ifndef NDEBUG
     buf->m_down_buffers.clear();
 #endif
+    if (buf->m_delta_logged) {
+        buf->m_delta_logged = false;
+    } else if (buf->m_persisted_image) {
+        release_node_delta(buf); // Node is written in full, its older deltas are not needed anymore
+    }
     buf->set_state(index_buf_state_t::CLEAN);
 
     if (cp_ctx->m_dirty_buf_count.decrement_testz()) {
         return std::make_pair(nullptr, false);
     } else {
-        get_next_bufs_internal(cp_ctx, 1u, buf, buf_list);
+        get_next_bufs(cp_ctx, 1u, buf->m_flush_partition, buf, buf_list);
         return std::make_pair((buf_list.size() ? buf_list[0] : nullptr), true);
     }
 }
 
-void IndexWBCache::get_next_bufs(IndexCPContext* cp_ctx, uint32_t max_count, IndexBufferPtrList& bufs) {
-    if (m_cp_flush_fibers.size() > 1) {
-        std::unique_lock lg(m_flush_mtx);
-        get_next_bufs_internal(cp_ctx, max_count, nullptr, bufs);
-    } else {
-        get_next_bufs_internal(cp_ctx, max_count, nullptr, bufs);
-    }
-}
-
-void IndexWBCache::get_next_bufs_internal(IndexCPContext* cp_ctx, uint32_t max_count,
-                                          IndexBufferPtr const& prev_flushed_buf, IndexBufferPtrList& bufs) {
+// Up buffer of a flushed buffer always belongs to the same partition, so the partitions never wait on each other. Once
+// a partition runs out of buffers, its flusher picks from the other partitions, so that the queue depth is retained
+// till the entire cp is flushed.
+void IndexWBCache::get_next_bufs(IndexCPContext* cp_ctx, uint32_t max_count, uint32_t partition,
+                                 IndexBufferPtr const& prev_flushed_buf, IndexBufferPtrList& bufs) {
     uint32_t count{0};
 
     // First attempt to execute any follower buffer flush
@@ -680,16 +1663,16 @@ void IndexWBCache::get_next_bufs_internal(IndexCPContext* cp_ctx, uint32_t max_c
         prev_flushed_buf->m_up_buffer.reset();
     }
 
-    // If we still have room to push the next buffer, take it from the main list
-    while (count < max_count) {
-        std::optional< IndexBufferPtr > buf = cp_ctx->next_dirty();
-        if (!buf) { break; } // End of list
-
-        if ((*buf)->m_wait_for_down_buffers.testz()) {
+    // If we still have room to push the next buffer, take it from the partition's list and then from others. Only
+    // the buffers which are not waiting for any leader are in the list, rest are flushed by its leader's completion.
+    auto const nparts = cp_ctx->num_flush_partitions();
+    for (uint32_t i{0}; (i < nparts) && (count < max_count); ++i) {
+        auto const p = (partition + i) % nparts;
+        while (count < max_count) {
+            std::optional< IndexBufferPtr > buf = cp_ctx->next_dirty(p);
+            if (!buf) { break; } // End of list
             bufs.emplace_back(std::move(*buf));
             ++count;
-        } else {
-            // There is some leader buffer still flushing, once done its completion will flush this buffer
         }
     }
 }
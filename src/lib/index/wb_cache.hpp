@@ -14,8 +14,15 @@
  *
  *********************************************************************************/
 #pragma once
+#include <atomic>
+#include <condition_variable>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
+#include <folly/concurrency/ConcurrentHashMap.h>
 #include <iomgr/iomgr.hpp>
 #include <homestore/index/wb_cache_base.hpp>
 #include <homestore/index/index_internal.hpp>
@@ -38,17 +45,75 @@ private:
     sisl::SimpleCache< BlkId, BtreeNodePtr > m_cache;
     uint32_t m_node_size;
     std::vector< iomgr::io_fiber_t > m_cp_flush_fibers;
-    std::mutex m_flush_mtx;
     void* m_meta_blk;
     bool m_in_recovery{false};
 
+    // Latest delta of every leaf whose in-place updates are logged instead of writing the node. Each cp appends the
+    // deltas it logged as a new meta blk, and they are compacted into one of the latest deltas once they pile up.
+    std::mutex m_delta_mtx;
+    std::map< BlkId, std::vector< uint8_t > > m_node_deltas;
+    std::vector< void* > m_delta_meta_blks;
+    uint64_t m_delta_log_bytes{0}; // Size of all the deltas in m_delta_meta_blks
+    uint64_t m_delta_seq{0};
+    std::vector< sisl::byte_view > m_delta_sbs;
+    std::unordered_map< BlkId, IndexBufferPtr > m_delta_applied_bufs; // Nodes patched in memory by a read only open
+    std::shared_ptr< std::atomic< int64_t > > m_num_delta_images{std::make_shared< std::atomic< int64_t > >(0)};
+
+    // Prefetches in flight, by blkid, marked once the node is loaded, dirtied or freed meanwhile. Image read by such a
+    // prefetch can be older than the node by the time it completes, so it is dropped instead of being cached.
+    // Completion of a prefetch refers to the cache, so the cache stops taking new ones and waits for the ones in flight
+    // before it is destroyed.
+    std::mutex m_prefetch_mtx;
+    std::condition_variable m_prefetch_cv;
+    std::unordered_map< BlkId, bool > m_inflight_prefetches;
+    std::atomic< uint32_t > m_num_inflight_prefetches{0};
+    bool m_prefetch_stopped{false};
+
+    // Nodes in the cache which are persisted at cp and shutdown, to be prefetched at the next start
+    struct hot_node {
+        uint32_t index_ordinal;
+        uint16_t level;
+    };
+    std::mutex m_hot_mtx;
+    std::unordered_map< bnodeid_t, hot_node > m_hot_nodes;
+    bool m_hot_changed{false};
+    uint64_t m_hot_persisted_ms{0};
+    void* m_hot_meta_blk{nullptr};
+    sisl::byte_view m_hot_sb;
+
+    // Log store of the txn records of the cps, replayed records are kept only till the recovery is done
+    std::mutex m_txn_log_mtx;
+    shared< HomeLogStore > m_txn_log;
+    logstore_seq_num_t m_txn_log_truncate_lsn{-1}; // Last record of the latest cp cleaned up
+    void* m_txn_log_meta_blk{nullptr};
+    sisl::byte_view m_txn_log_sb;
+    std::map< logstore_seq_num_t, log_buffer > m_recovered_txn_logs;
+
+    // Use of the cache by each index table. Nodes of a table within its quota are not evicted, as long as any other
+    // table is over its quota.
+    struct table_cache_state {
+        std::atomic< int64_t > resident_nodes{0};
+        std::atomic< uint64_t > lookups{0};
+        std::atomic< uint64_t > hits{0};
+        std::atomic< uint64_t > evictions{0};
+        std::atomic< int32_t > quota_pct{-1}; // -1 to follow the config
+        std::atomic< bool > over_quota{false};
+    };
+    folly::ConcurrentHashMap< uint32_t, std::shared_ptr< table_cache_state > > m_table_states;
+    std::atomic< int32_t > m_num_over_quota{0};
+    uint64_t m_capacity_nodes;
+
 public:
     IndexWBCache(const std::shared_ptr< VirtualDev >& vdev, std::pair< meta_blk*, sisl::byte_view > sb,
+                 std::vector< std::pair< meta_blk*, sisl::byte_view > > delta_sbs,
+                 std::pair< meta_blk*, sisl::byte_view > hot_sb, std::pair< meta_blk*, sisl::byte_view > txn_log_sb,
                  const std::shared_ptr< sisl::Evictor >& evictor, uint32_t node_size);
 
-    BtreeNodePtr alloc_buf(node_initializer_t&& node_initializer) override;
+    BtreeNodePtr alloc_buf(node_initializer_t&& node_initializer, blk_count_t nblks) override;
     void write_buf(const BtreeNodePtr& node, const IndexBufferPtr& buf, CPContext* cp_ctx) override;
     void read_buf(bnodeid_t id, BtreeNodePtr& node, node_initializer_t&& node_initializer) override;
+    void prefetch_bufs(std::vector< bnodeid_t > const& ids, node_initializer_t const& node_initializer) override;
+    bool evict_buf(bnodeid_t id) override;
 
     bool get_writable_buf(const BtreeNodePtr& node, CPContext* context) override;
     void transact_bufs(uint32_t index_ordinal, IndexBufferPtr const& parent_buf, IndexBufferPtr const& child_buf,
@@ -61,22 +126,65 @@ public:
     folly::Future< bool > async_cp_flush(IndexCPContext* context);
     IndexBufferPtr copy_buffer(const IndexBufferPtr& cur_buf, const CPContext* cp_ctx) const;
     void recover(sisl::byte_view sb) override;
+    void warm_up() override;
+    void persist_hot_nodes() override;
+    void stop_prefetches() override;
+    void set_table_quota(uint32_t index_ordinal, uint32_t quota_pct) override;
+    nlohmann::json get_table_stats() const override;
+
+    // Txn log the records of a cp starting now are to be appended to, nullptr to journal them in meta blk
+    shared< HomeLogStore > txn_log();
+    void truncate_txn_log(IndexCPContext* cp_ctx);
 
 private:
+    bool can_evict(BtreeNodePtr const& node);
+    table_cache_state& table_state(uint32_t index_ordinal);
+    int64_t quota_nodes(table_cache_state const& st) const;
+    void add_resident_nodes(uint32_t index_ordinal, int64_t n);
+    void complete_prefetch(BlkId const& blkid, IndexBufferPtr const& idx_buf,
+                           node_initializer_t const& node_initializer);
+    void invalidate_prefetch(BlkId const& blkid);
     void start_flush_threads();
     void recover_new_nodes(sisl::byte_view sb);
     void process_write_completion(IndexCPContext* cp_ctx, IndexBufferPtr const& pbuf);
+    void process_write_completion(IndexCPContext* cp_ctx, IndexBufferPtrList const& bufs);
+    void complete_cp_flush(IndexCPContext* cp_ctx);
     void do_flush_one_buf(IndexCPContext* cp_ctx, IndexBufferPtr const& buf, bool part_of_batch);
+    void do_flush_bufs(IndexCPContext* cp_ctx, IndexBufferPtrList& bufs);
+    void issue_flush_bufs(IndexCPContext* cp_ctx, IndexBufferPtrList& bufs);
+    void do_flush_contiguous_bufs(IndexCPContext* cp_ctx, IndexBufferPtrList&& bufs);
     void link_buf(IndexBufferPtr const& up, IndexBufferPtr const& down, bool is_sibling_link, CPContext* cp_ctx);
 
     std::pair< IndexBufferPtr, bool > on_buf_flush_done(IndexCPContext* cp_ctx, IndexBufferPtr const& buf);
-    std::pair< IndexBufferPtr, bool > on_buf_flush_done_internal(IndexCPContext* cp_ctx, IndexBufferPtr const& buf);
-
-    void get_next_bufs(IndexCPContext* cp_ctx, uint32_t max_count, IndexBufferPtrList& bufs);
-    void get_next_bufs_internal(IndexCPContext* cp_ctx, uint32_t max_count, IndexBufferPtr const& prev_flushed_buf,
-                                IndexBufferPtrList& bufs);
+    void get_next_bufs(IndexCPContext* cp_ctx, uint32_t max_count, uint32_t partition,
+                       IndexBufferPtr const& prev_flushed_buf, IndexBufferPtrList& bufs);
 
+    void recover_index_tables(std::vector< IndexBufferPtr > const& l0_bufs);
     void recover_buf(IndexBufferPtr const& buf);
     bool was_node_committed(IndexBufferPtr const& buf);
+
+    void capture_persisted_image(BtreeNodePtr const& node, IndexBufferPtr const& buf, IndexCPContext* cp_ctx);
+    void log_node_deltas(IndexCPContext* cp_ctx);
+    void append_delta_record(std::vector< std::vector< uint8_t > const* > const& deltas, bool compact);
+    void remove_delta_records(size_t count);
+    std::vector< uint8_t > build_node_delta(IndexBufferPtr const& buf, uint32_t max_bytes) const;
+    void release_node_delta(IndexBufferPtr const& buf);
+    void recover_node_deltas();
+
+    void open_txn_log();
+    void create_txn_log_if_needed();
+
+    void track_hot_node(BtreeNodePtr const& node);
+    void untrack_hot_node(BlkId const& blkid);
+    void persist_hot_nodes_if_due();
+
+    uint8_t* compress_buf(IndexBufferPtr const& buf, uint32_t& out_size) const;
+    bool decompress_buf(uint8_t* raw_buf, uint32_t node_size) const;
+
+    // Nodes take as many blks of the node size as their blkid has, which is more than one for the bigger leaves
+    uint32_t node_size_of(BlkId const& blkid) const { return blkid.blk_count() * m_node_size; }
+    uint32_t buf_size(IndexBufferPtr const& buf) const {
+        return buf->is_meta_buf() ? m_node_size : node_size_of(buf->m_blkid);
+    }
 };
 } // namespace homestore
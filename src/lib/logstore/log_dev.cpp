@@ -14,16 +14,21 @@
  *
  *********************************************************************************/
 #include <algorithm>
+#include <bit>
+#include <cmath>
 #include <condition_variable>
 #include <cstring>
 #include <iterator>
 
+#include <lz4.h>
 #include <sisl/fds/vector_pool.hpp>
 #include <iomgr/iomgr_flip.hpp>
 
 #include <homestore/logstore_service.hpp>
 #include <homestore/meta_service.hpp>
 #include <homestore/homestore.hpp>
+#include <homestore/cpu_accounting.hpp>
+#include <homestore/perf_stats.hpp>
 
 #include "log_dev.hpp"
 #include "device/journal_vdev.hpp"
@@ -31,6 +36,7 @@
 #include "common/homestore_config.hpp"
 #include "common/homestore_utils.hpp"
 #include "common/crash_simulator.hpp"
+#include "common/tsc_clock.hpp"
 
 namespace homestore {
 
@@ -43,6 +49,18 @@ SISL_LOGGING_DECL(logstore)
 static bool has_data_service() { return HomeStore::instance()->has_data_service(); }
 // static BlkDataService& data_service() { return HomeStore::instance()->data_service(); }
 
+// Returns the record as it was appended, from the data of a record which was compressed in the log group
+static log_buffer uncompress_record(const sisl::byte_view& b) {
+    HS_REL_ASSERT_GT(b.size(), sizeof(compressed_log_record_hdr), "Compressed log record is too small");
+    auto const raw_size = r_cast< const compressed_log_record_hdr* >(b.bytes())->raw_size;
+    auto raw_buf = sisl::make_byte_array(raw_size, 0, sisl::buftag::logread);
+    auto const dsize = LZ4_decompress_safe(r_cast< const char* >(b.bytes() + sizeof(compressed_log_record_hdr)),
+                                           r_cast< char* >(raw_buf->bytes()),
+                                           int_cast(b.size() - sizeof(compressed_log_record_hdr)), int_cast(raw_size));
+    HS_REL_ASSERT_EQ(dsize, int_cast(raw_size), "Compressed log record is corrupted");
+    return sisl::byte_view{raw_buf};
+}
+
 LogDev::LogDev(logdev_id_t id, flush_mode_t flush_mode) : m_logdev_id{id}, m_flush_mode{flush_mode} {
     m_flush_size_multiple = HS_DYNAMIC_CONFIG(logstore->flush_size_multiple_logdev);
 }
@@ -58,10 +76,13 @@ void LogDev::start(bool format, std::shared_ptr< JournalVirtualDev > vdev) {
     if (m_flush_size_multiple == 0) { m_flush_size_multiple = m_vdev->optimal_page_size(); }
     THIS_LOGDEV_LOG(INFO, "Initializing logdev with flush size multiple={}", m_flush_size_multiple);
 
-    for (uint32_t i = 0; i < max_log_group; ++i) {
+    m_num_log_groups = std::clamp(HS_DYNAMIC_CONFIG(logstore.max_inflight_log_groups), 1u, max_log_group);
+    m_free_log_groups.clear();
+    for (uint32_t i = 0; i < m_num_log_groups; ++i) {
         m_log_group_pool[i].start(m_flush_size_multiple, m_vdev->align_size());
+        m_free_log_groups.push_back(&m_log_group_pool[i]);
     }
-    m_log_records = std::make_unique< sisl::StreamTracker< log_record > >();
+    m_log_records = std::make_unique< LogRecordRing >(HS_DYNAMIC_CONFIG(logstore.inflight_records_ring_size));
     m_stopped = false;
 
     // First read the info block
@@ -81,12 +102,24 @@ void LogDev::start(bool format, std::shared_ptr< JournalVirtualDev > vdev) {
         THIS_LOGDEV_LOG(INFO, "get start vdev offset during recovery {} log indx {} ",
                         m_logdev_meta.get_start_dev_offset(), m_logdev_meta.get_start_log_idx());
 
-        m_vdev_jd->update_data_start_offset(m_logdev_meta.get_start_dev_offset());
-        m_log_idx = m_logdev_meta.get_start_log_idx();
-        do_load(m_logdev_meta.get_start_dev_offset());
+        // Start offset is that of the first group, which could be packed in the middle of a page
+        m_vdev_jd->update_data_start_offset(
+            off_t(sisl::round_down(uint64_cast(m_logdev_meta.get_start_dev_offset()), m_flush_size_multiple)));
+        auto const replay_key = replay_start_key(store_list);
+        if (replay_key.idx > m_logdev_meta.get_start_log_idx()) {
+            // Every store has applied the records before the replay key, skip reading them altogether. They are
+            // still on the device until truncated, so truncation starts from the actual start.
+            THIS_LOGDEV_LOG(INFO, "Skipping replay of log idx in range of [{} - {}] as per replay checkpoints",
+                            m_logdev_meta.get_start_log_idx(), replay_key.idx - 1);
+            m_last_truncate_idx = m_logdev_meta.get_start_log_idx();
+        }
+        m_log_idx = replay_key.idx;
+        do_load(replay_key.dev_offset);
         m_log_records->reinit(m_log_idx);
         m_last_flush_idx = m_log_idx - 1;
     }
+    m_last_prepared_idx = m_last_flush_idx;
+    m_last_prepared_crc = m_last_crc;
 
     if (allow_timer_flush()) start_timer();
     handle_unopened_log_stores(format);
@@ -114,6 +147,8 @@ void LogDev::stop() {
         std::unique_lock lg = flush_guard();
         m_stopped = true;
         // waiting under lock to make sure no new flush is started
+        wait_for_inflight_log_groups();
+        m_vdev_jd->wait_for_destage();
         while (m_pending_callback.load() > 0) {
             THIS_LOGDEV_LOG(INFO, "Waiting for pending callbacks to complete, pending callbacks {}",
                             m_pending_callback.load());
@@ -131,14 +166,17 @@ void LogDev::stop() {
     }
 
     m_log_records = nullptr;
+    m_tail_cache.clear();
     m_logdev_meta.reset();
     m_log_idx.store(0);
     m_pending_flush_size.store(0);
     m_last_flush_idx = -1;
     m_last_truncate_idx = -1;
     m_last_crc = INVALID_CRC32_VALUE;
+    m_last_prepared_idx = -1;
+    m_last_prepared_crc = INVALID_CRC32_VALUE;
 
-    for (size_t i{0}; i < max_log_group; ++i) {
+    for (size_t i{0}; i < m_num_log_groups; ++i) {
         m_log_group_pool[i].stop();
     }
 
@@ -159,7 +197,7 @@ void LogDev::destroy() {
 void LogDev::start_timer() {
     // Currently only tests set it to 0.
     if (HS_DYNAMIC_CONFIG(logstore.flush_timer_frequency_us))
-        iomanager.run_on_wait(logstore_service().flush_thread(), [this]() {
+        iomanager.run_on_wait(flush_fiber(), [this]() {
             m_flush_timer_hdl = iomanager.schedule_thread_timer(
                 HS_DYNAMIC_CONFIG(logstore.flush_timer_frequency_us) * 1000, true /* recurring */, nullptr /* cookie */,
                 [this](void*) { flush_if_necessary(); });
@@ -169,16 +207,56 @@ void LogDev::start_timer() {
 void LogDev::stop_timer() {
     if (m_flush_timer_hdl != iomgr::null_timer_handle) {
         // cancel the timer
-        iomanager.run_on_wait(logstore_service().flush_thread(),
+        iomanager.run_on_wait(flush_fiber(),
                               [this]() { iomanager.cancel_timer(m_flush_timer_hdl, true); });
     }
 }
 
+iomgr::io_fiber_t LogDev::flush_fiber() const {
+    auto const fiber = m_pinned_flush_fiber.load(std::memory_order_acquire);
+    return fiber ? fiber : logstore_service().flush_thread(m_logdev_id);
+}
+
+void LogDev::set_flush_fiber(iomgr::io_fiber_t fiber) {
+    // Timer is rescheduled on the new fiber, flushes which were already redirected to the old one would get redirected
+    // again, once they run there
+    bool const restart_timer = allow_timer_flush() && !is_stopped();
+    if (restart_timer) { stop_timer(); }
+    m_pinned_flush_fiber.store(fiber, std::memory_order_release);
+    if (restart_timer) { start_timer(); }
+}
+
 void LogDev::do_load(off_t device_cursor) {
-    log_stream_reader lstream{device_cursor, m_vdev, m_vdev_jd, m_flush_size_multiple};
+    auto const nfibers = HS_DYNAMIC_CONFIG(logstore.replay_parallelism);
+    log_stream_reader lstream{device_cursor, m_vdev, m_vdev_jd, m_flush_size_multiple, (nfibers == 0) /* verify_crc */};
     logid_t loaded_from{-1};
     off_t group_dev_offset = 0;
 
+    // With parallel replay, groups read are handed over in batches to a replay fiber, which validates and replays
+    // them while the next batch is being read. Only one batch is replayed at a time, so that records of a logstore
+    // are replayed in order across the batches as well.
+    auto const batch_size = HS_DYNAMIC_CONFIG(logstore.bulk_read_size);
+    std::vector< log_replay_group > batch;
+    uint64_t batch_bytes{0};
+    boost::fibers::mutex replay_mtx;
+    boost::fibers::condition_variable replay_cv;
+    bool replaying{false};
+    auto const submit_batch = [&]() {
+        if (batch.empty()) { return; }
+        std::unique_lock lg{replay_mtx};
+        replay_cv.wait(lg, [&replaying] { return !replaying; });
+        replaying = true;
+        iomanager.run_on_forget(iomgr::reactor_regex::random_worker, iomgr::fiber_regex::syncio_only,
+                                [this, &replay_mtx, &replay_cv, &replaying, nfibers, groups = std::move(batch)]() {
+                                    replay_log_groups(groups, nfibers);
+                                    std::unique_lock lg{replay_mtx};
+                                    replaying = false;
+                                    replay_cv.notify_all();
+                                });
+        batch = std::vector< log_replay_group >{};
+        batch_bytes = 0;
+    };
+
     THIS_LOGDEV_LOG(TRACE, "LogDev::do_load start log_dev={} offset = {} ", m_logdev_id, device_cursor);
 
     do {
@@ -199,43 +277,138 @@ void LogDev::do_load(off_t device_cursor) {
 
         THIS_LOGDEV_LOG(DEBUG, "Found log group header offset=0x{} header {}", to_hex(group_dev_offset), *header);
         HS_REL_ASSERT_EQ(header->start_idx(), m_log_idx.load(), "log indx is not the expected one");
+        HS_REL_ASSERT_GT(header->nrecords(), 0, "nrecords greater then zero");
         if (loaded_from == -1) { loaded_from = header->start_idx(); }
+        if (m_last_truncate_idx == -1) { m_last_truncate_idx = header->start_idx(); }
+
+        if (nfibers == 0) {
+            replay_log_group(buf, group_dev_offset);
+        } else {
+            batch.push_back(log_replay_group{buf, group_dev_offset});
+            batch_bytes += header->total_size();
+            if (batch_bytes >= batch_size) { submit_batch(); }
+        }
 
-        // Loop through each record within the log group and do a callback
-        decltype(header->nrecords()) i{0};
-        HS_REL_ASSERT_GT(header->nrecords(), 0, "nrecords greater then zero");
+        m_log_idx.store(header->start_idx() + header->nrecords(), std::memory_order_release);
+        m_last_crc = header->cur_grp_crc;
+    } while (true);
+
+    if (nfibers != 0) {
+        submit_batch();
+        std::unique_lock lg{replay_mtx};
+        replay_cv.wait(lg, [&replaying] { return !replaying; });
+    }
+
+    // Update the tail offset with where we finally end up loading, so that new append entries can be written from
+    // here. Loading could end in the middle of the last page of a packed group, which is not packed after though.
+    m_vdev_jd->update_tail_offset(off_t(sisl::round_up(uint64_cast(group_dev_offset), m_flush_size_multiple)));
+    m_tail_bytes.clear();
+    THIS_LOGDEV_LOG(TRACE, "LogDev::do_load end {} ", m_logdev_id);
+}
+
+void LogDev::replay_log_group(const sisl::byte_view& buf, off_t group_dev_offset) {
+    auto* header = r_cast< const log_group_header* >(buf.bytes());
+    const auto flush_ld_key =
+        logdev_key{header->start_idx() + header->nrecords(), group_dev_offset + header->total_size()};
+
+    // Loop through each record within the log group and do a callback
+    for (decltype(header->nrecords()) i{0}; i < header->nrecords(); ++i) {
+        const auto* rec = header->nth_record(i);
+        const uint32_t data_offset = (rec->offset + (rec->get_inlined() ? 0 : header->oob_data_offset));
+        // Do a callback on the found log entry
+        sisl::byte_view b = buf;
+        b.move_forward(data_offset);
+        b.set_size(rec->size);
+        if (rec->get_compressed()) { b = uncompress_record(b); }
+        // Validate if the id is present in rollback info
+        if (m_logdev_meta.is_rolled_back(rec->store_id, header->start_idx() + i)) {
+            THIS_LOGDEV_LOG(DEBUG, "logstore_id[{}] log_idx={}, lsn={} has been rolledback, not notifying the logstore",
+                            rec->store_id, (header->start_idx() + i), rec->store_seq_num);
+        } else {
+            THIS_LOGDEV_LOG(TRACE, "seq num {}, log indx {}, group dev offset {} size {}", rec->store_seq_num,
+                            (header->start_idx() + i), group_dev_offset, rec->size);
+            on_logfound(rec->store_id, rec->store_seq_num, {header->start_idx() + i, group_dev_offset}, flush_ld_key,
+                        b, (header->nrecords() - (i + 1)));
+        }
+    }
+}
+
+namespace {
+struct log_replay_record {
+    HomeLogStore* log_store;
+    logstore_seq_num_t seq_num;
+    logdev_key ld_key;
+    logdev_key flush_ld_key;
+    sisl::byte_view buf;
+    bool compressed;
+};
+
+// Runs fn(i) for each i in [0, n) on a syncio capable worker fiber and waits for all of them to complete. It waits on
+// fiber primitives, so calling fiber can yield to the ones it spawned, if they land on the same reactor.
+void run_on_workers_and_wait(uint32_t n, const std::function< void(uint32_t) >& fn) {
+    boost::fibers::mutex mtx;
+    boost::fibers::condition_variable cv;
+    uint32_t pending{n};
+    for (uint32_t i{0}; i < n; ++i) {
+        iomanager.run_on_forget(iomgr::reactor_regex::random_worker, iomgr::fiber_regex::syncio_only,
+                                [&mtx, &cv, &pending, &fn, i]() {
+                                    fn(i);
+                                    std::unique_lock lg{mtx};
+                                    if (--pending == 0) { cv.notify_all(); }
+                                });
+    }
+    std::unique_lock lg{mtx};
+    cv.wait(lg, [&pending] { return pending == 0; });
+}
+} // namespace
+
+void LogDev::replay_log_groups(const std::vector< log_replay_group >& groups, uint32_t nfibers) {
+    // Stage 1: Validate the crc of the groups, which reader has skipped, in parallel
+    auto const ncrc_fibers = std::min(nfibers, uint32_cast(groups.size()));
+    run_on_workers_and_wait(ncrc_fibers, [this, &groups, ncrc_fibers](uint32_t f) {
+        for (size_t g{f}; g < groups.size(); g += ncrc_fibers) {
+            HS_REL_ASSERT(log_stream_reader::is_group_crc_valid(groups[g].buf),
+                          "data is corrupted, crc doesn't match for group at offset {} log_dev={}",
+                          groups[g].dev_offset, m_logdev_id);
+        }
+    });
+
+    // Stage 2: Split the records by their logstore, so that all the records of a store are replayed by same fiber in
+    // the order they are found.
+    std::vector< std::vector< log_replay_record > > fiber_records(nfibers);
+    for (auto const& group : groups) {
+        auto* header = r_cast< const log_group_header* >(group.buf.bytes());
         const auto flush_ld_key =
-            logdev_key{header->start_idx() + header->nrecords(), group_dev_offset + header->total_size()};
-        while (i < header->nrecords()) {
+            logdev_key{header->start_idx() + header->nrecords(), group.dev_offset + header->total_size()};
+        for (decltype(header->nrecords()) i{0}; i < header->nrecords(); ++i) {
             const auto* rec = header->nth_record(i);
-            const uint32_t data_offset = (rec->offset + (rec->get_inlined() ? 0 : header->oob_data_offset));
-            // Do a callback on the found log entry
-            sisl::byte_view b = buf;
-            b.move_forward(data_offset);
-            b.set_size(rec->size);
-            if (m_last_truncate_idx == -1) { m_last_truncate_idx = header->start_idx() + i; }
-            // Validate if the id is present in rollback info
-            if (m_logdev_meta.is_rolled_back(rec->store_id, header->start_idx() + i)) {
+            const auto log_idx = header->start_idx() + i;
+            if (m_logdev_meta.is_rolled_back(rec->store_id, log_idx)) {
                 THIS_LOGDEV_LOG(DEBUG,
                                 "logstore_id[{}] log_idx={}, lsn={} has been rolledback, not notifying the logstore",
-                                rec->store_id, (header->start_idx() + i), rec->store_seq_num);
-            } else {
-                THIS_LOGDEV_LOG(TRACE, "seq num {}, log indx {}, group dev offset {} size {}", rec->store_seq_num,
-                                (header->start_idx() + i), group_dev_offset, rec->size);
-                on_logfound(rec->store_id, rec->store_seq_num, {header->start_idx() + i, group_dev_offset},
-                            flush_ld_key, b, (header->nrecords() - (i + 1)));
+                                rec->store_id, log_idx, rec->store_seq_num);
+                continue;
             }
-            ++i;
-        }
 
-        m_log_idx.store(header->start_idx() + i, std::memory_order_release);
-        m_last_crc = header->cur_grp_crc;
-    } while (true);
+            auto* log_store = replay_log_store(rec->store_id);
+            if (log_store == nullptr) { continue; }
 
-    // Update the tail offset with where we finally end up loading, so that new append entries can be written from
-    // here.
-    m_vdev_jd->update_tail_offset(group_dev_offset);
-    THIS_LOGDEV_LOG(TRACE, "LogDev::do_load end {} ", m_logdev_id);
+            sisl::byte_view b = group.buf;
+            b.move_forward(rec->offset + (rec->get_inlined() ? 0 : header->oob_data_offset));
+            b.set_size(rec->size);
+            fiber_records[rec->store_id % nfibers].push_back(
+                log_replay_record{log_store, rec->store_seq_num, logdev_key{log_idx, group.dev_offset}, flush_ld_key,
+                                  std::move(b), rec->get_compressed()});
+        }
+    }
+
+    // Stage 3: Replay the records of different logstores concurrently
+    run_on_workers_and_wait(nfibers, [&fiber_records](uint32_t f) {
+        for (auto& r : fiber_records[f]) {
+            r.log_store->on_log_found(r.seq_num, r.ld_key, r.flush_ld_key,
+                                      r.compressed ? uncompress_record(r.buf) : r.buf);
+        }
+    });
 }
 
 void LogDev::assert_next_pages(log_stream_reader& lstream) {
@@ -255,60 +428,149 @@ void LogDev::assert_next_pages(log_stream_reader& lstream) {
 }
 
 int64_t LogDev::append_async(logstore_id_t store_id, logstore_seq_num_t seq_num, const sisl::io_blob& data,
-                             void* cb_context) {
+                             void* cb_context, uint32_t zero_copy_size) {
     const auto idx = m_log_idx.fetch_add(1, std::memory_order_acq_rel);
     m_pending_flush_size.fetch_add(data.size(), std::memory_order_relaxed);
-    m_log_records->create(idx, store_id, seq_num, data, cb_context);
+    m_log_records->create(idx, store_id, seq_num, data, cb_context, zero_copy_size);
     if (allow_inline_flush()) flush_if_necessary();
     return idx;
 }
 
+int64_t LogDev::append_batch(logstore_id_t store_id, std::span< logstore_req* const > reqs) {
+    const auto start_idx = m_log_idx.fetch_add(int64_cast(reqs.size()), std::memory_order_acq_rel);
+    uint64_t total_size{0};
+    auto idx = start_idx;
+    for (auto* req : reqs) {
+        m_log_records->create(idx++, store_id, req->seq_num, req->data, s_cast< void* >(req), 0u);
+        total_size += req->data.size();
+    }
+    m_pending_flush_size.fetch_add(total_size, std::memory_order_relaxed);
+    if (allow_inline_flush()) flush_if_necessary();
+    return start_idx;
+}
+
 log_buffer LogDev::read(const logdev_key& key) {
-    auto buf = sisl::make_byte_array(initial_read_size, m_flush_size_multiple, sisl::buftag::logread);
-    auto ec = m_vdev_jd->sync_pread(buf->bytes(), initial_read_size, key.dev_offset);
+    if (auto cached = m_tail_cache.read(key)) {
+        COUNTER_INCREMENT(logstore_service().m_metrics, logdev_tail_cache_hit_count, 1);
+        PerfStats::cache_lookup(perf_cache_t::JOURNAL_TAIL_CACHE, true);
+        return std::move(*cached);
+    }
+    PerfStats::cache_lookup(perf_cache_t::JOURNAL_TAIL_CACHE, false);
+
+    // Group could be packed in the middle of a page, in which case it is read from the start of its page
+    auto const skew = uint32_cast(uint64_cast(key.dev_offset) % m_flush_size_multiple);
+    auto const read_size = uint32_cast(sisl::round_up(uint64_cast(skew) + initial_read_size, m_flush_size_multiple));
+    auto buf = sisl::make_byte_array(read_size, m_flush_size_multiple, sisl::buftag::logread);
+    auto ec = m_vdev_jd->sync_pread(buf->bytes(), read_size, key.dev_offset - skew);
     if (ec) {
         LOGERROR("Failed to read from Journal vdev log_dev={} {} {}", m_logdev_id, ec.value(), ec.message());
         return {};
     }
 
-    auto* header = r_cast< const log_group_header* >(buf->cbytes());
-    verify_log_group_header(key.idx, header);
+    auto* header = r_cast< const log_group_header* >(buf->cbytes() + skew);
+    verify_log_group_header(key.idx, header, read_size - skew);
     auto record_header = header->nth_record(key.idx - header->start_log_idx);
-    uint32_t const data_offset = (record_header->offset + (record_header->get_inlined() ? 0 : header->oob_data_offset));
+    uint32_t const data_offset =
+        skew + record_header->offset + (record_header->get_inlined() ? 0 : header->oob_data_offset);
 
     sisl::byte_view ret_view;
-    if ((data_offset + record_header->size) < initial_read_size) {
+    if ((data_offset + record_header->size) < read_size) {
         ret_view = sisl::byte_view{buf, data_offset, record_header->size};
     } else {
         auto const rounded_data_offset = sisl::round_down(data_offset, m_vdev->align_size());
         auto const rounded_size =
             sisl::round_up(record_header->size + data_offset - rounded_data_offset, m_vdev->align_size());
         auto new_buf = sisl::make_byte_array(rounded_size, m_vdev->align_size(), sisl::buftag::logread);
-        m_vdev_jd->sync_pread(new_buf->bytes(), rounded_size, key.dev_offset + rounded_data_offset);
+        m_vdev_jd->sync_pread(new_buf->bytes(), rounded_size, key.dev_offset - skew + rounded_data_offset);
         ret_view = sisl::byte_view{new_buf, s_cast< uint32_t >(data_offset - rounded_data_offset), record_header->size};
     }
 
-    return ret_view;
+    return record_header->get_compressed() ? uncompress_record(ret_view) : ret_view;
+}
+
+std::vector< log_buffer > LogDev::read_range(const std::vector< logdev_key >& keys) {
+    std::vector< log_buffer > bufs(keys.size());
+    uint64_t const chunk_size = m_vdev->info().chunk_size;
+    uint64_t const max_read_size =
+        sisl::round_up(HS_DYNAMIC_CONFIG(logstore.bulk_read_size), uint64_cast(m_flush_size_multiple));
+
+    size_t i{0};
+    while (i < keys.size()) {
+        if (auto cached = m_tail_cache.read(keys[i])) {
+            COUNTER_INCREMENT(logstore_service().m_metrics, logdev_tail_cache_hit_count, 1);
+            PerfStats::cache_lookup(perf_cache_t::JOURNAL_TAIL_CACHE, true);
+            bufs[i++] = std::move(*cached);
+            continue;
+        }
+
+        // Extend the read to all the following keys, whose groups start within the same chunk and read size. Groups
+        // never span chunks, so the read never needs to go past the end of the chunk.
+        off_t const start_offset = keys[i].dev_offset;
+        off_t const read_limit = std::min(off_t(sisl::round_down(uint64_cast(start_offset), chunk_size) + chunk_size),
+                                          off_t(start_offset + max_read_size));
+        size_t j{i};
+        while ((j + 1 < keys.size()) && (keys[j + 1].dev_offset >= keys[j].dev_offset) &&
+               (keys[j + 1].dev_offset + initial_read_size <= read_limit)) {
+            ++j;
+        }
+        if (j == i) {
+            bufs[i] = read(keys[i]);
+            ++i;
+            continue;
+        }
+        PerfStats::cache_lookup(perf_cache_t::JOURNAL_TAIL_CACHE, false);
+
+        // First group could be packed in the middle of a page, read starts from the start of its page
+        off_t const read_offset = off_t(sisl::round_down(uint64_cast(start_offset), m_flush_size_multiple));
+        auto const span_size = uint64_cast(keys[j].dev_offset - read_offset) + initial_read_size;
+        auto const read_size = uint32_cast(sisl::round_up(span_size, uint64_cast(m_flush_size_multiple)));
+        auto buf = sisl::make_byte_array(read_size, m_flush_size_multiple, sisl::buftag::logread);
+        auto ec = m_vdev_jd->sync_pread(buf->bytes(), read_size, read_offset);
+        if (ec) {
+            LOGERROR("Failed to read from Journal vdev log_dev={} {} {}", m_logdev_id, ec.value(), ec.message());
+            return {};
+        }
+        COUNTER_INCREMENT(logstore_service().m_metrics, logdev_range_read_count, 1);
+
+        for (; i <= j; ++i) {
+            auto const grp_pos = uint32_cast(keys[i].dev_offset - read_offset);
+            auto* header = r_cast< const log_group_header* >(buf->cbytes() + grp_pos);
+            verify_log_group_header(keys[i].idx, header);
+            auto const* rec = header->nth_record(keys[i].idx - header->start_log_idx);
+            uint32_t const data_offset = grp_pos + rec->offset + (rec->get_inlined() ? 0 : header->oob_data_offset);
+            if (data_offset + rec->size > read_size) {
+                // Record is beyond what is read for the range, read it individually
+                bufs[i] = read(keys[i]);
+                continue;
+            }
+            sisl::byte_view b{buf, data_offset, rec->size};
+            bufs[i] = rec->get_compressed() ? uncompress_record(b) : b;
+        }
+    }
+    return bufs;
 }
 
 void LogDev::read_record_header(const logdev_key& key, serialized_log_record& return_record_header) {
-    auto buf = sisl::make_byte_array(initial_read_size, m_flush_size_multiple, sisl::buftag::logread);
-    auto ec = m_vdev_jd->sync_pread(buf->bytes(), initial_read_size, key.dev_offset);
+    auto const skew = uint32_cast(uint64_cast(key.dev_offset) % m_flush_size_multiple);
+    auto const read_size = uint32_cast(sisl::round_up(uint64_cast(skew) + initial_read_size, m_flush_size_multiple));
+    auto buf = sisl::make_byte_array(read_size, m_flush_size_multiple, sisl::buftag::logread);
+    auto ec = m_vdev_jd->sync_pread(buf->bytes(), read_size, key.dev_offset - skew);
     if (ec) LOGERROR("Failed to read from Journal vdev log_dev={} {} {}", m_logdev_id, ec.value(), ec.message());
 
-    auto* header = r_cast< const log_group_header* >(buf->cbytes());
-    verify_log_group_header(key.idx, header);
+    auto* header = r_cast< const log_group_header* >(buf->cbytes() + skew);
+    verify_log_group_header(key.idx, header, read_size - skew);
 
     auto record_header = header->nth_record(key.idx - header->start_log_idx);
     return_record_header =
         serialized_log_record(record_header->size, record_header->offset, record_header->get_inlined(),
                               record_header->store_seq_num, record_header->store_id);
+    return_record_header.set_compressed(record_header->get_compressed());
 }
 
-void LogDev::verify_log_group_header(const logid_t idx, const log_group_header* header) {
+void LogDev::verify_log_group_header(const logid_t idx, const log_group_header* header, uint32_t avail_size) {
     HS_REL_ASSERT_EQ(header->magic_word(), LOG_GROUP_HDR_MAGIC, "Log header corrupted with magic mismatch! {} {}",
                      m_logdev_id, *header);
-    HS_REL_ASSERT_EQ(header->get_version(), log_group_header::header_version, "Log header version mismatch!  {} {}",
+    HS_REL_ASSERT_LE(header->get_version(), log_group_header::header_version, "Log header version mismatch!  {} {}",
                      m_logdev_id, *header);
     HS_REL_ASSERT_LE(header->start_idx(), idx, "log key offset does not match with log_idx {} }{}", m_logdev_id,
                      *header);
@@ -319,9 +581,10 @@ void LogDev::verify_log_group_header(const logid_t idx, const log_group_header*
 
     // We can only do crc match in read if we have read all the blocks. We don't want to aggressively read more data
     // than we need to just to compare CRC for read operation. It can be done during recovery.
-    if (header->total_size() <= initial_read_size) {
-        crc32_t const crc = crc32_ieee(init_crc32, (r_cast< const uint8_t* >(header) + sizeof(log_group_header)),
-                                       header->total_size() - sizeof(log_group_header));
+    if (header->total_size() <= avail_size) {
+        crc32_t const crc = log_group_header::data_crc(
+            header->get_version(), init_crc32, (r_cast< const uint8_t* >(header) + sizeof(log_group_header)),
+            header->total_size() - sizeof(log_group_header));
         HS_REL_ASSERT_EQ(header->this_group_crc(), crc, "CRC mismatch on read data");
     }
 }
@@ -359,21 +622,31 @@ LogGroup* LogDev::prepare_flush(int32_t estimated_records) {
     int64_t flushing_upto_idx{-1};
 
     assert(estimated_records > 0);
+    auto const prepare_tsc = TscClock::now();
     auto* lg = make_log_group(static_cast< uint32_t >(estimated_records));
-    m_log_records->foreach_contiguous_active(m_last_flush_idx + 1,
-                                             [&](int64_t idx, int64_t, log_record& record) -> bool {
-                                                 if (lg->add_record(record, idx)) {
-                                                     flushing_upto_idx = idx;
-                                                     return true;
-                                                 } else {
-                                                     return false;
-                                                 }
-                                             });
-
-    lg->finish(m_logdev_id, m_last_crc);
-    if (sisl_unlikely(flushing_upto_idx == -1)) { return nullptr; }
-    lg->m_flush_log_idx_from = m_last_flush_idx + 1;
+    if (lg == nullptr) {
+        THIS_LOGDEV_LOG(TRACE, "All log groups are in flight, flush continues once the oldest of them completes");
+        return nullptr;
+    }
+    lg->m_prepare_tsc = prepare_tsc;
+    m_log_records->foreach_contiguous_active(m_last_prepared_idx + 1, [&](logid_t idx, log_record& record) -> bool {
+        if (lg->add_record(record, idx)) {
+            flushing_upto_idx = idx;
+            return true;
+        } else {
+            return false;
+        }
+    });
+
+    lg->finish(m_logdev_id, m_last_prepared_crc);
+    if (sisl_unlikely(flushing_upto_idx == -1)) {
+        free_log_group(lg);
+        return nullptr;
+    }
+    lg->m_flush_log_idx_from = m_last_prepared_idx + 1;
     lg->m_flush_log_idx_upto = flushing_upto_idx;
+    m_last_prepared_idx = flushing_upto_idx;
+    m_last_prepared_crc = lg->header()->cur_grp_crc;
     HS_DBG_ASSERT_GE(lg->m_flush_log_idx_upto, lg->m_flush_log_idx_from, "log indx upto is smaller then log indx from");
 
     HS_DBG_ASSERT_GT(lg->header()->oob_data_offset, 0);
@@ -382,31 +655,67 @@ LogGroup* LogDev::prepare_flush(int32_t estimated_records) {
 }
 
 bool LogDev::can_flush_in_this_thread() {
-    if (iomanager.am_i_io_reactor() && (iomanager.iofiber_self() == logstore_service().flush_thread())) { return true; }
-    return (!HS_DYNAMIC_CONFIG(logstore.flush_only_in_dedicated_thread) && iomanager.am_i_worker_reactor());
+    if (iomanager.am_i_io_reactor() && (iomanager.iofiber_self() == flush_fiber())) { return true; }
+    return ((!HS_DYNAMIC_CONFIG(logstore.flush_only_in_dedicated_thread) ||
+             HS_DYNAMIC_CONFIG(logstore.flush_leader_follower)) &&
+            iomanager.am_i_worker_reactor());
+}
+
+bool LogDev::has_inflight_log_groups() const {
+    std::unique_lock lk{m_inflight_mtx};
+    return !m_inflight_log_groups.empty() || m_completing_log_groups;
 }
 
 bool LogDev::flush_if_necessary(int64_t threshold_size) {
     if (!can_flush_in_this_thread()) {
-        iomanager.run_on_forget(logstore_service().flush_thread(),
+        iomanager.run_on_forget(flush_fiber(),
                                 [this, threshold_size]() { flush_if_necessary(threshold_size); });
         return false;
     }
 
+    // Only an appender which finds the previous log group completed leads the flush. Completion of the group flushes
+    // what its followers have appended meanwhile, with the timer as the backstop for what is below the threshold.
+    bool const leader_follower =
+        HS_DYNAMIC_CONFIG(logstore.flush_leader_follower) && (iomanager.iofiber_self() != flush_fiber());
+    if (leader_follower && is_pipelined() && has_inflight_log_groups()) {
+        COUNTER_INCREMENT(logstore_service().m_metrics, logdev_flush_follower_count, 1);
+        return false;
+    }
+
     // If after adding the record size, if we have enough to flush or if its been too much time before we actually
     // flushed, attempt to flush by setting the atomic bool variable.
-    if (threshold_size < 0) { threshold_size = LogDev::flush_data_threshold_size(); }
+    bool const adaptive = (threshold_size < 0) && HS_DYNAMIC_CONFIG(logstore.flush_adaptive);
+    if (threshold_size < 0) {
+        threshold_size = adaptive ? m_group_commit.batch_size() : LogDev::flush_data_threshold_size();
+    }
+    auto const max_flush_gap_us =
+        adaptive ? m_group_commit.linger_us() : HS_DYNAMIC_CONFIG(logstore.max_time_between_flush_us);
 
     const auto elapsed_time = get_elapsed_time_us(m_last_flush_time);
     auto const pending_sz = m_pending_flush_size.load(std::memory_order_relaxed);
     bool const flush_by_size = (pending_sz >= threshold_size);
-    bool const flush_by_time =
-        !flush_by_size && pending_sz && (elapsed_time > HS_DYNAMIC_CONFIG(logstore.max_time_between_flush_us));
+    bool const flush_by_time = !flush_by_size && pending_sz && (elapsed_time > max_flush_gap_us);
     if (flush_by_size || flush_by_time) {
         std::unique_lock lck(m_flush_mtx, std::try_to_lock);
         if (lck.owns_lock()) {
             if (m_stopped) return false;
-            return flush();
+            if (!leader_follower) { return flush(); }
+
+            COUNTER_INCREMENT(logstore_service().m_metrics, logdev_flush_leader_count, 1);
+            bool flushed = flush();
+            if (!is_pipelined()) {
+                // Synchronous flush completes the group before returning, so the leader goes on to flush for the
+                // followers which arrived meanwhile, as long as they have enough to flush
+                auto const max_iterations = HS_DYNAMIC_CONFIG(logstore.try_flush_iteration);
+                for (uint64_t i{0}; i < max_iterations && !m_stopped &&
+                     (m_pending_flush_size.load(std::memory_order_relaxed) >= threshold_size);
+                     ++i) {
+                    flushed = flush() || flushed;
+                }
+            }
+            return flushed;
+        } else if (leader_follower) {
+            COUNTER_INCREMENT(logstore_service().m_metrics, logdev_flush_follower_count, 1);
         }
     }
     return false;
@@ -423,14 +732,19 @@ bool LogDev::flush_under_guard() {
     }
 #endif
 
-    return flush();
+    bool const flushed = flush();
+    // Caller expects the logs to be durable once this returns
+    wait_for_inflight_log_groups();
+    return flushed;
 }
 
 bool LogDev::flush() {
+    HS_CPU_SCOPE(LOGDEV);
+    auto const prev_flush_time = m_last_flush_time;
     m_last_flush_time = Clock::now();
     // We were able to win the flushing competition and now we gather all the flush data and reserve a slot.
     auto new_idx = m_log_idx.load(std::memory_order_acquire) - 1;
-    if (m_last_flush_idx >= new_idx) {
+    if (m_last_prepared_idx >= new_idx) {
         THIS_LOGDEV_LOG(TRACE, "Log idx {} is just flushed", new_idx);
         return false;
     }
@@ -438,45 +752,187 @@ bool LogDev::flush() {
     // the amount of logs which one logGroup can flush has a upper limit. here we want to make sure all the logs that
     // need to be flushed will definitely be flushed to physical dev, so we need this loop to create multiple log groups
     // if necessary
-    for (; m_last_flush_idx < new_idx;) {
+    uint64_t flushed_bytes{0};
+    uint64_t write_us{0};
+    bool submitted{false};
+    for (; m_last_prepared_idx < new_idx;) {
         LogGroup* lg =
-            prepare_flush(new_idx - m_last_flush_idx + 4); // Estimate 4 more extra in case of parallel writes
+            prepare_flush(new_idx - m_last_prepared_idx + 4); // Estimate 4 more extra in case of parallel writes
         if (sisl_unlikely(!lg)) {
-            THIS_LOGDEV_LOG(TRACE, "Log idx {} last_flush_idx {} prepare flush failed", new_idx, m_last_flush_idx);
-            return false;
+            THIS_LOGDEV_LOG(TRACE, "Log idx {} last_prepared_idx {} prepare flush failed", new_idx,
+                            m_last_prepared_idx);
+            return submitted;
         }
         auto sz = m_pending_flush_size.fetch_sub(lg->actual_data_size(), std::memory_order_relaxed);
         HS_REL_ASSERT_GE((sz - lg->actual_data_size()), 0, "size {} lg size {}", sz, lg->actual_data_size());
-        off_t offset = m_vdev_jd->alloc_next_append_blk(lg->header()->total_size());
-        lg->m_log_dev_offset = offset;
 
-        HS_REL_ASSERT_NE(lg->m_log_dev_offset, INVALID_OFFSET, "log dev is full");
+        // Group is packed after the previous one, by rewriting its last page, only once nothing is in flight, as two
+        // writes of the same page in flight could land in any order
+        auto const packed_size = m_tail_bytes.empty() ? 0 : lg->packed_size(uint32_cast(m_tail_bytes.size()));
+        if ((packed_size != 0) && !has_inflight_log_groups() &&
+            m_vdev_jd->rewind_tail(m_flush_size_multiple, packed_size)) {
+            lg->pack_after(sisl::blob{m_tail_bytes.data(), uint32_cast(m_tail_bytes.size())});
+            COUNTER_INCREMENT(logstore_service().m_metrics, logdev_packed_group_count, 1);
+        }
+        off_t offset = m_vdev_jd->alloc_next_append_blk(lg->write_size());
+        HS_REL_ASSERT_NE(offset, INVALID_OFFSET, "log dev is full");
+        lg->m_log_dev_offset = offset + lg->head_room();
+        auto const tail = lg->tail_bytes();
+        m_tail_bytes.assign(tail.cbytes(), tail.cbytes() + tail.size());
         THIS_LOGDEV_LOG(TRACE, "Flushing log group data size={} at offset={} log_group={}", lg->actual_data_size(),
                         offset, *lg);
 
         HISTOGRAM_OBSERVE(logstore_service().m_metrics, logdev_flush_records_distribution, lg->nrecords());
         HISTOGRAM_OBSERVE(logstore_service().m_metrics, logdev_flush_size_distribution, lg->actual_data_size());
 
+        if (is_pipelined()) {
+            submit_log_group(lg);
+            submitted = true;
+            continue;
+        }
+
         // TODO:: add logic to handle this error in upper layer
-        auto error = m_vdev_jd->sync_pwritev(lg->iovecs().data(), int_cast(lg->iovecs().size()), lg->m_log_dev_offset);
+        auto const write_start = Clock::now();
+        lg->m_submit_tsc = TscClock::now();
+        auto error = m_vdev_jd->sync_pwritev(lg->iovecs().data(), int_cast(lg->iovecs().size()), lg->write_offset());
+        lg->m_written_tsc = TscClock::now();
+        write_us += get_elapsed_time_us(write_start);
+        flushed_bytes += lg->actual_data_size();
         if (error) {
             THIS_LOGDEV_LOG(ERROR, "Fail to sync write to journal vde , error code {} : {}", error.value(),
                             error.message());
+            // Logs of the group are prepared again by the next flush
+            m_pending_flush_size.fetch_add(lg->actual_data_size(), std::memory_order_relaxed);
+            m_last_prepared_idx = m_last_flush_idx;
+            m_last_prepared_crc = m_last_crc;
+            m_tail_bytes.clear();
+            free_log_group(lg);
             return false;
         }
 
         on_flush_completion(lg);
     }
 
+    if (is_pipelined()) { return submitted; }
+    if (HS_DYNAMIC_CONFIG(logstore.flush_adaptive)) {
+        m_group_commit.on_flush(flushed_bytes, get_elapsed_time_us(prev_flush_time, m_last_flush_time), write_us);
+        HISTOGRAM_OBSERVE(logstore_service().m_metrics, logdev_adaptive_batch_size, m_group_commit.batch_size());
+        HISTOGRAM_OBSERVE(logstore_service().m_metrics, logdev_adaptive_linger_us, m_group_commit.linger_us());
+    }
     return true;
 }
 
+LogGroup* LogDev::make_log_group(uint32_t estimated_records) {
+    LogGroup* lg{nullptr};
+    {
+        std::unique_lock lk{m_inflight_mtx};
+        if (m_free_log_groups.empty()) { return nullptr; }
+        lg = m_free_log_groups.back();
+        m_free_log_groups.pop_back();
+    }
+    lg->reset(estimated_records);
+    return lg;
+}
+
+void LogDev::free_log_group(LogGroup* lg) {
+    std::unique_lock lk{m_inflight_mtx};
+    m_free_log_groups.push_back(lg);
+}
+
+void LogDev::submit_log_group(LogGroup* lg) {
+    {
+        std::unique_lock lk{m_inflight_mtx};
+        lg->m_write_done = false;
+        lg->m_submit_time = Clock::now();
+        lg->m_submit_tsc = TscClock::now();
+        m_inflight_log_groups.push_back(lg);
+    }
+    m_vdev_jd->async_pwritev(lg->iovecs().data(), int_cast(lg->iovecs().size()), lg->write_offset())
+        .thenValue([this, lg](std::error_code ec) { on_log_group_written(lg, ec); });
+}
+
+void LogDev::on_log_group_written(LogGroup* lg, std::error_code const& ec) {
+    // Groups after this one are already chained to its crc, so it can't be prepared and written again
+    HS_REL_ASSERT(!ec, "Fail to write log group to journal vdev, log_dev={} error={}", m_logdev_id, ec.message());
+
+    auto const written_tsc = TscClock::now();
+    {
+        std::unique_lock lk{m_inflight_mtx};
+        lg->m_written_tsc = written_tsc;
+        lg->m_write_done = true;
+        if (m_completing_log_groups) { return; } // Whoever is completing picks this one up in its turn
+        m_completing_log_groups = true;
+
+        while (!m_inflight_log_groups.empty() && m_inflight_log_groups.front()->m_write_done) {
+            auto* done_lg = m_inflight_log_groups.front();
+            m_inflight_log_groups.pop_front();
+            lk.unlock();
+
+            if (HS_DYNAMIC_CONFIG(logstore.flush_adaptive)) {
+                m_group_commit.on_flush(done_lg->actual_data_size(),
+                                        get_elapsed_time_us(m_last_completed_submit_time, done_lg->m_submit_time),
+                                        get_elapsed_time_us(done_lg->m_submit_time));
+                HISTOGRAM_OBSERVE(logstore_service().m_metrics, logdev_adaptive_batch_size,
+                                  m_group_commit.batch_size());
+                HISTOGRAM_OBSERVE(logstore_service().m_metrics, logdev_adaptive_linger_us, m_group_commit.linger_us());
+            }
+            m_last_completed_submit_time = done_lg->m_submit_time;
+            on_flush_completion(done_lg);
+            lk.lock();
+        }
+        m_completing_log_groups = false;
+        m_inflight_cv.notify_all();
+    }
+
+    // Logs which could not get a log group while all of them were in flight
+    if (m_pending_flush_size.load(std::memory_order_relaxed) > 0) { flush_if_necessary(); }
+}
+
+void LogDev::wait_for_inflight_log_groups() {
+    if (!is_pipelined()) { return; }
+    std::unique_lock lk{m_inflight_mtx};
+    m_inflight_cv.wait(lk, [this]() { return m_inflight_log_groups.empty() && !m_completing_log_groups; });
+}
+
+void GroupCommitController::on_flush(uint64_t bytes, uint64_t interval_us, uint64_t write_us) {
+    // Same gains as TCP rtt estimation
+    static constexpr double alpha{0.125};
+    static constexpr double beta{0.25};
+
+    double const rate = double(bytes) / std::max(interval_us, uint64_t{1});
+    double const lat = double(write_us);
+    if (!m_has_sample) {
+        m_arrival_rate = rate;
+        m_write_lat_us = lat;
+        m_write_lat_dev_us = lat / 2;
+        m_has_sample = true;
+    } else {
+        m_arrival_rate += alpha * (rate - m_arrival_rate);
+        m_write_lat_dev_us += beta * (std::abs(lat - m_write_lat_us) - m_write_lat_dev_us);
+        m_write_lat_us += alpha * (lat - m_write_lat_us);
+    }
+
+    double const p99_write_us = m_write_lat_us + 4 * m_write_lat_dev_us;
+    double const linger_us =
+        std::max(double(HS_DYNAMIC_CONFIG(logstore.flush_target_p99_latency_us)) - p99_write_us, 0.0);
+    auto const batch_size = std::min(int64_cast(m_arrival_rate * linger_us),
+                                     int64_cast(HS_DYNAMIC_CONFIG(logstore.flush_adaptive_max_batch_size)));
+    m_linger_us.store(uint64_cast(linger_us), std::memory_order_relaxed);
+    m_batch_size.store(std::max(batch_size, int64_t{1}), std::memory_order_relaxed);
+}
+
 void LogDev::on_flush_completion(LogGroup* lg) {
     auto done_time = Clock::now();
     THIS_LOGDEV_LOG(TRACE, "Flush completed for logid[{} - {}]", lg->m_flush_log_idx_from, lg->m_flush_log_idx_upto);
 
     m_log_records->complete(lg->m_flush_log_idx_from, lg->m_flush_log_idx_upto);
     m_last_crc = lg->header()->cur_grp_crc;
+    HISTOGRAM_OBSERVE(logstore_service().m_metrics, logdev_group_prepare_us,
+                      TscClock::elapsed_us(lg->m_prepare_tsc, lg->m_submit_tsc));
+    HISTOGRAM_OBSERVE(logstore_service().m_metrics, logdev_group_write_us,
+                      TscClock::elapsed_us(lg->m_submit_tsc, lg->m_written_tsc));
+    // Cache it before the completions let anyone read these records and the group buffer is reused
+    m_tail_cache.insert(*lg);
     std::unordered_map< logid_t, logstore_req* > req_map;
 
     auto from_indx = lg->m_flush_log_idx_from;
@@ -488,7 +944,11 @@ void LogDev::on_flush_completion(LogGroup* lg) {
         HomeLogStore* log_store = req->log_store;
         HS_LOG_ASSERT_EQ(log_store->get_store_id(), record.store_id,
                          "Expecting store id in log store and flush completion to match");
-        HISTOGRAM_OBSERVE(logstore_service().m_metrics, logstore_append_latency, get_elapsed_time_us(req->start_time));
+        auto const append_us = get_elapsed_time_us(req->start_time);
+        HISTOGRAM_OBSERVE(logstore_service().m_metrics, logstore_append_latency, append_us);
+        PerfStats::observe(perf_op_t::JOURNAL_APPEND, append_us);
+        HISTOGRAM_OBSERVE(logstore_service().m_metrics, logdev_append_wait_flush_us,
+                          TscClock::elapsed_us(req->append_tsc, lg->m_prepare_tsc));
         log_store->on_write_completion(req, logdev_key{idx, dev_offset}, logdev_key{from_indx, dev_offset});
         req_map[idx] = req;
     }
@@ -496,6 +956,7 @@ void LogDev::on_flush_completion(LogGroup* lg) {
                       get_elapsed_time_us(m_last_flush_time, done_time));
     HISTOGRAM_OBSERVE(logstore_service().m_metrics, logdev_post_flush_processing_latency,
                       get_elapsed_time_us(done_time));
+    auto const written_tsc = lg->m_written_tsc;
     free_log_group(lg);
     m_log_records->truncate(upto_indx);
     m_last_flush_idx = upto_indx;
@@ -504,7 +965,9 @@ void LogDev::on_flush_completion(LogGroup* lg) {
     for (auto const& [idx, req] : req_map) {
         m_pending_callback++;
         iomanager.run_on_forget(iomgr::reactor_regex::random_worker, iomgr::fiber_regex::syncio_only,
-                                [this, dev_offset, idx, req]() {
+                                [this, dev_offset, idx, req, written_tsc]() {
+                                    HISTOGRAM_OBSERVE(logstore_service().m_metrics, logdev_completion_cb_us,
+                                                      TscClock::elapsed_us(written_tsc));
                                     auto ld_key = logdev_key{idx, dev_offset};
                                     auto comp_cb = req->log_store->get_comp_cb();
                                     (req->cb) ? req->cb(req, ld_key) : comp_cb(req, ld_key);
@@ -514,42 +977,74 @@ void LogDev::on_flush_completion(LogGroup* lg) {
 }
 
 uint64_t LogDev::truncate() {
-    // Order of this lock has to be preserved. We take externally visible lock which is flush lock first. This
-    // prevents any further update to tail_lsn and also flushes conurrently with truncation. Then we take the store
-    // map lock, which is contained in this class and then meta_mutex. Reason for this is, we take meta_mutex under
-    // other store_map lock, so reversing could cause deadlock
-    std::unique_lock fg = flush_guard();
-    folly::SharedMutexWritePriority::ReadHolder holder(m_store_map_mtx);
-    std::unique_lock mg{m_meta_mutex};
+    // Truncations are serialized among themselves, but only the truncation of the journal itself is done under the
+    // flush guard, so that walking through the stores and persisting their truncation points doesn't hold up the
+    // flushes. Order of the locks has to be preserved, we take meta_mutex under store_map lock and under flush guard,
+    // so reversing could cause deadlock
+    std::unique_lock tg{m_truncate_mtx};
 
     logdev_key min_safe_ld_key = logdev_key::out_of_bound_ld_key();
-    // Walk through all the stores and find the least logdev_key that we can truncate
-    for (auto& [store_id, store] : m_id_logstore_map) {
-        auto lstore = store.log_store;
-        if (lstore == nullptr) { continue; }
-        auto const [trunc_lsn, trunc_ld_key, tail_lsn] = lstore->truncate_info();
-        if (trunc_lsn == tail_lsn) {
-            THIS_LOGDEV_LOG(DEBUG, "Store_id={} didn't have any writes since last truncation, skipping ", store_id);
-            m_logdev_meta.remove_all_rollback_records(store_id, m_stopped /* persist_now */);
-            continue;
-        }
-        HS_DBG_ASSERT_GE(trunc_ld_key.idx, m_last_truncate_idx, "Trying to truncate logid which is already truncated");
-        m_logdev_meta.update_store_superblk(store_id, logstore_superblk(trunc_lsn + 1), m_stopped /* persist_now */);
+    bool meta_dirty{false};
+    uint32_t n_stores_updated{0};
+    {
+        folly::SharedMutexWritePriority::ReadHolder holder(m_store_map_mtx);
+        std::unique_lock mg{m_meta_mutex};
+
+        // Walk through all the stores and find the least logdev_key that we can truncate. Only the stores whose
+        // truncation point moved since the last truncation are updated in the superblk, which is persisted once
+        for (auto& [store_id, store] : m_id_logstore_map) {
+            auto lstore = store.log_store;
+            if (lstore == nullptr) { continue; }
+            auto const [trunc_lsn, trunc_ld_key, tail_lsn] = lstore->truncate_info();
+            if (trunc_lsn == tail_lsn) {
+                THIS_LOGDEV_LOG(DEBUG, "Store_id={} didn't have any writes since last truncation, skipping ", store_id);
+                if (m_logdev_meta.num_rollback_records(store_id) != 0) {
+                    m_logdev_meta.remove_all_rollback_records(store_id, m_stopped /* persist_now */);
+                    meta_dirty = true;
+                }
+                continue;
+            }
+            HS_DBG_ASSERT_GE(trunc_ld_key.idx, m_last_truncate_idx,
+                             "Trying to truncate logid which is already truncated");
+            auto store_sb = m_logdev_meta.store_superblk(store_id);
+            if (store_sb.m_first_seq_num != trunc_lsn + 1) {
+                store_sb.m_first_seq_num = trunc_lsn + 1;
+                if ((store_sb.m_replay_start_lsn < store_sb.m_first_seq_num) && (trunc_ld_key.idx > 0)) {
+                    // Truncated records are not replayed either, so the truncation point is its replay checkpoint
+                    store_sb.m_replay_start_lsn = store_sb.m_first_seq_num;
+                    store_sb.m_replay_start_key = trunc_ld_key;
+                }
+                m_logdev_meta.update_store_superblk(store_id, store_sb, m_stopped /* persist_now */);
+                meta_dirty = true;
+                ++n_stores_updated;
+            }
 
-        // We found a new minimum logdev_key that we can truncate to
-        if (trunc_ld_key.idx > 0 && trunc_ld_key.idx < min_safe_ld_key.idx) { min_safe_ld_key = trunc_ld_key; }
+            // We found a new minimum logdev_key that we can truncate to
+            if (trunc_ld_key.idx > 0 && trunc_ld_key.idx < min_safe_ld_key.idx) { min_safe_ld_key = trunc_ld_key; }
+        }
     }
+    THIS_LOGDEV_LOG(DEBUG, "LogDev::truncate updated the truncation point of {} stores", n_stores_updated);
 
     // There are no writes or no truncation called for any of the store, so we can't truncate anything
-    if (min_safe_ld_key == logdev_key::out_of_bound_ld_key() || min_safe_ld_key.idx <= m_last_truncate_idx) return 0;
+    if (min_safe_ld_key == logdev_key::out_of_bound_ld_key() || min_safe_ld_key.idx <= m_last_truncate_idx) {
+        if (meta_dirty) {
+            std::unique_lock mg{m_meta_mutex};
+            m_logdev_meta.persist();
+        }
+        return 0;
+    }
 
     uint64_t const num_records_to_truncate = uint64_cast(min_safe_ld_key.idx - m_last_truncate_idx);
-
-    // Truncate them in vdev
-    m_vdev_jd->truncate(min_safe_ld_key.dev_offset);
+    {
+        // Truncate them in vdev
+        std::unique_lock fg = flush_guard();
+        m_vdev_jd->truncate(off_t(sisl::round_down(uint64_cast(min_safe_ld_key.dev_offset), m_flush_size_multiple)));
+        m_tail_cache.truncate(min_safe_ld_key.idx);
+        m_last_truncate_idx = min_safe_ld_key.idx;
+    }
 
     // Update the start offset to be read upon restart
-    m_last_truncate_idx = min_safe_ld_key.idx;
+    std::unique_lock mg{m_meta_mutex};
     m_logdev_meta.set_start_dev_offset(min_safe_ld_key.dev_offset, min_safe_ld_key.idx, m_stopped /* persist_now */);
 
     // When a logstore is removed, it unregisteres the store and keeps the store id in garbage list. We can capture
@@ -578,6 +1073,30 @@ void LogDev::rollback(logstore_id_t store_id, logid_range_t id_range) {
     m_logdev_meta.add_rollback_record(store_id, id_range, true);
 }
 
+void LogDev::update_replay_checkpoint(logstore_id_t store_id, logstore_seq_num_t replay_start_lsn,
+                                      const logdev_key& replay_start_key) {
+    std::unique_lock lg{m_meta_mutex};
+    auto store_sb = m_logdev_meta.store_superblk(store_id);
+    if (replay_start_lsn <= store_sb.m_replay_start_lsn) { return; }
+    store_sb.m_replay_start_lsn = replay_start_lsn;
+    store_sb.m_replay_start_key = replay_start_key;
+    m_logdev_meta.update_store_superblk(store_id, store_sb, true /* persist_now */);
+}
+
+logdev_key
+LogDev::replay_start_key(const std::vector< std::pair< logstore_id_t, logstore_superblk > >& store_list) const {
+    logdev_key const start_key{m_logdev_meta.get_start_log_idx(), m_logdev_meta.get_start_dev_offset()};
+    if (store_list.empty()) { return start_key; }
+
+    // Any store without a checkpoint beyond the start needs the replay from the start
+    logdev_key min_key = logdev_key::out_of_bound_ld_key();
+    for (auto const& [store_id, sb] : store_list) {
+        if (!sb.has_replay_checkpoint() || (sb.m_replay_start_key.idx <= start_key.idx)) { return start_key; }
+        if (sb.m_replay_start_key.idx < min_key.idx) { min_key = sb.m_replay_start_key; }
+    }
+    return min_key;
+}
+
 /////////////////////////////// LogStore Section ///////////////////////////////////////
 void LogDev::handle_unopened_log_stores(bool format) {
     for (auto it{std::begin(m_unopened_store_io)}; it != std::end(m_unopened_store_io); ++it) {
@@ -656,29 +1175,31 @@ void LogDev::on_log_store_found(logstore_id_t store_id, const logstore_superblk&
     LOGDEBUG("Found a logstore log_dev={} log_store={} with start lsn={}, Creating a new HomeLogStore instance",
              m_logdev_id, store_id, sb.m_first_seq_num);
     logstore_info& info = it->second;
-    info.log_store =
-        std::make_shared< HomeLogStore >(shared_from_this(), store_id, info.append_mode, sb.m_first_seq_num);
+    // Records before the replay checkpoint are not replayed, so the store starts after them
+    info.log_store = std::make_shared< HomeLogStore >(shared_from_this(), store_id, info.append_mode,
+                                                      std::max(sb.m_first_seq_num, sb.m_replay_start_lsn));
     info.promise.setValue(info.log_store);
 }
 
 void LogDev::on_logfound(logstore_id_t id, logstore_seq_num_t lsn, logdev_key ld_key, logdev_key flush_ld_key,
                          log_buffer buf, uint32_t nremaining_in_batch) {
-    HomeLogStore* log_store{nullptr};
-    {
-        folly::SharedMutexWritePriority::ReadHolder holder(m_store_map_mtx);
-        auto const it = m_id_logstore_map.find(id);
-        if (it == m_id_logstore_map.end()) {
-            auto [unopened_it, inserted] = m_unopened_store_io.insert(std::make_pair<>(id, 0));
-            ++unopened_it->second;
-            return;
-        }
-        log_store = it->second.log_store.get();
-    }
+    auto* log_store = replay_log_store(id);
     if (!log_store) return;
 
     log_store->on_log_found(lsn, ld_key, flush_ld_key, buf);
 }
 
+HomeLogStore* LogDev::replay_log_store(logstore_id_t id) {
+    folly::SharedMutexWritePriority::ReadHolder holder(m_store_map_mtx);
+    auto const it = m_id_logstore_map.find(id);
+    if (it == m_id_logstore_map.end()) {
+        auto [unopened_it, inserted] = m_unopened_store_io.insert(std::make_pair<>(id, 0));
+        ++unopened_it->second;
+        return nullptr;
+    }
+    return it->second.log_store.get();
+}
+
 nlohmann::json LogDev::dump_log_store(const log_dump_req& dump_req) {
     nlohmann::json json_dump{}; // create root object
     if (dump_req.log_store == nullptr) {
@@ -712,6 +1233,9 @@ nlohmann::json LogDev::get_status(int verbosity) const {
     js["last_flush_log_idx"] = m_last_flush_idx;
     js["last_truncate_log_idx"] = m_last_truncate_idx;
     js["time_since_last_log_flush_ns"] = get_elapsed_time_ns(m_last_flush_time);
+    js["flush_thread"] = m_pinned_flush_fiber.load(std::memory_order_relaxed)
+        ? std::string{"pinned"}
+        : "log_flush_thread" + std::to_string(m_logdev_id % logstore_service().num_flush_threads());
     if (verbosity == 2) {
         js["logdev_stopped?"] = m_stopped;
         js["logdev_sb_start_offset"] = m_logdev_meta.get_start_dev_offset();
@@ -728,8 +1252,148 @@ nlohmann::json LogDev::get_status(int verbosity) const {
     return js;
 }
 
+/////////////////////////////// LogRecordRing Section ///////////////////////////////////////
+LogRecordRing::LogRecordRing(uint32_t nslots) {
+    auto const n = std::bit_ceil(std::max(nslots, 2u));
+    m_slots = std::make_unique< slot[] >(n);
+    m_mask = n - 1;
+}
+
+LogRecordRing::~LogRecordRing() { reinit(-1); }
+
+void LogRecordRing::reinit(logid_t start_idx) {
+    for (uint64_t i{0}; i <= m_mask; ++i) {
+        auto& s = m_slots[i];
+        if (s.state.load(std::memory_order_acquire) == slot_state::ACTIVE) {
+            s.rec()->~log_record();
+            s.state.store(slot_state::FREE, std::memory_order_release);
+        }
+    }
+    {
+        std::unique_lock lg{m_overflow_mtx};
+        m_overflow.clear();
+        m_overflow_count.store(0, std::memory_order_release);
+    }
+    m_completed_upto.store(start_idx - 1, std::memory_order_release);
+    m_truncated_upto = start_idx - 1;
+}
+
+log_record* LogRecordRing::find(logid_t idx) {
+    auto& s = m_slots[uint64_cast(idx) & m_mask];
+    if ((s.state.load(std::memory_order_acquire) == slot_state::ACTIVE) && (s.idx == idx)) { return s.rec(); }
+    if (m_overflow_count.load(std::memory_order_acquire) == 0) { return nullptr; }
+
+    std::unique_lock lg{m_overflow_mtx};
+    auto const it = m_overflow.find(idx);
+    return (it == m_overflow.end()) ? nullptr : it->second.get();
+}
+
+log_record& LogRecordRing::at(logid_t idx) {
+    auto* rec = find(idx);
+    HS_REL_ASSERT(rec != nullptr, "log idx={} is not in the in-memory log records", idx);
+    return *rec;
+}
+
+void LogRecordRing::foreach_contiguous_active(logid_t from_idx,
+                                              const std::function< bool(logid_t, log_record&) >& cb) {
+    for (auto idx = std::max(from_idx, completed_upto() + 1);; ++idx) {
+        auto* rec = find(idx);
+        if ((rec == nullptr) || !cb(idx, *rec)) { break; }
+    }
+}
+
+void LogRecordRing::complete(logid_t from_idx, logid_t upto_idx) {
+    HS_DBG_ASSERT_EQ(from_idx, completed_upto() + 1, "Log records are expected to be completed in order");
+    m_completed_upto.store(upto_idx, std::memory_order_release);
+}
+
+void LogRecordRing::release(logid_t idx) {
+    auto& s = m_slots[uint64_cast(idx) & m_mask];
+    if ((s.state.load(std::memory_order_acquire) == slot_state::ACTIVE) && (s.idx == idx)) {
+        s.rec()->~log_record();
+        s.state.store(slot_state::FREE, std::memory_order_release);
+        return;
+    }
+
+    std::unique_lock lg{m_overflow_mtx};
+    if (m_overflow.erase(idx) != 0) { m_overflow_count.fetch_sub(1, std::memory_order_release); }
+}
+
+void LogRecordRing::truncate(logid_t upto_idx) {
+    upto_idx = std::min(upto_idx, completed_upto());
+    for (auto idx = m_truncated_upto + 1; idx <= upto_idx; ++idx) {
+        release(idx);
+    }
+    m_truncated_upto = std::max(m_truncated_upto, upto_idx);
+}
+
+/////////////////////////////// LogTailCache Section ///////////////////////////////////////
+void LogTailCache::insert(const LogGroup& lg) {
+    uint64_t const max_size = uint64_cast(HS_DYNAMIC_CONFIG(logstore.tail_cache_size_mb)) * 1024 * 1024;
+    auto const* header = lg.header();
+    if (max_size < header->total_size()) {
+        if (m_size != 0) { clear(); }
+        return;
+    }
+
+    auto buf = sisl::make_byte_array(header->total_size(), 0, sisl::buftag::logread);
+    // Write of a packed group starts with the tail of the previous group, which is not part of this group
+    uint32_t pos{0};
+    uint32_t skip{lg.head_room()};
+    for (auto const& iov : lg.iovecs()) {
+        auto const len = std::min(uint32_cast(iov.iov_len) - skip, header->total_size() - pos);
+        std::memcpy(buf->bytes() + pos, r_cast< const uint8_t* >(iov.iov_base) + skip, len);
+        pos += len;
+        skip = 0;
+    }
+
+    folly::SharedMutexWritePriority::WriteHolder holder(m_mtx);
+    m_size += buf->size();
+    m_groups.emplace(header->start_idx(), std::move(buf));
+    while (m_size > max_size) {
+        m_size -= m_groups.begin()->second->size();
+        m_groups.erase(m_groups.begin());
+    }
+}
+
+std::optional< log_buffer > LogTailCache::read(const logdev_key& key) const {
+    folly::SharedMutexWritePriority::ReadHolder holder(m_mtx);
+    auto it = m_groups.upper_bound(key.idx);
+    if (it == m_groups.begin()) { return std::nullopt; }
+    --it;
+
+    auto const& buf = it->second;
+    auto const* header = r_cast< const log_group_header* >(buf->cbytes());
+    if (key.idx >= header->start_idx() + header->nrecords()) { return std::nullopt; }
+
+    auto const* rec = header->nth_record(key.idx - header->start_idx());
+    uint32_t const data_offset = rec->offset + (rec->get_inlined() ? 0 : header->oob_data_offset);
+    sisl::byte_view b{buf, data_offset, rec->size};
+    return rec->get_compressed() ? uncompress_record(b) : b;
+}
+
+void LogTailCache::truncate(logid_t upto_idx) {
+    folly::SharedMutexWritePriority::WriteHolder holder(m_mtx);
+    while (!m_groups.empty()) {
+        auto const* header = r_cast< const log_group_header* >(m_groups.begin()->second->cbytes());
+        if (header->start_idx() + header->nrecords() > upto_idx) { break; }
+        m_size -= m_groups.begin()->second->size();
+        m_groups.erase(m_groups.begin());
+    }
+}
+
+void LogTailCache::clear() {
+    folly::SharedMutexWritePriority::WriteHolder holder(m_mtx);
+    m_groups.clear();
+    m_size = 0;
+}
+
 /////////////////////////////// LogDevMetadata Section ///////////////////////////////////////
-LogDevMetadata::LogDevMetadata() : m_sb{logdev_sb_meta_name}, m_rollback_sb{logdev_rollback_sb_meta_name} {}
+LogDevMetadata::LogDevMetadata() : m_sb{logdev_sb_meta_name}, m_rollback_sb{logdev_rollback_sb_meta_name} {
+    // Both grow with the number of stores and records, while each update changes only a few bytes of them
+    m_sb.set_delta_write(true);
+    m_rollback_sb.set_delta_write(true);
+}
 
 logdev_superblk* LogDevMetadata::create(logdev_id_t id) {
     logdev_superblk* sb = m_sb.create(logdev_sb_size_needed(0));
@@ -740,10 +1404,12 @@ logdev_superblk* LogDevMetadata::create(logdev_id_t id) {
 
     m_id_reserver = std::make_unique< sisl::IDReserver >();
     m_sb->logdev_id = id;
-    m_sb.write();
-
     m_rollback_sb->logdev_id = id;
-    m_rollback_sb.write();
+
+    MetaBlkBatch batch;
+    m_sb.write(batch);
+    m_rollback_sb.write(batch);
+    meta_service().commit_batch(batch);
     return sb;
 }
 
@@ -755,9 +1421,31 @@ void LogDevMetadata::reset() {
 void LogDevMetadata::logdev_super_blk_found(const sisl::byte_view& buf, void* meta_cookie) {
     m_sb.load(buf, meta_cookie);
     HS_REL_ASSERT_EQ(m_sb->get_magic(), logdev_superblk::LOGDEV_SB_MAGIC, "Invalid logdev metablk, magic mismatch");
+    if (m_sb->get_version() == 1) { upgrade_logdev_sb_from_v1(); }
     HS_REL_ASSERT_EQ(m_sb->get_version(), logdev_superblk::LOGDEV_SB_VERSION, "Invalid version of logdev metablk");
 }
 
+void LogDevMetadata::upgrade_logdev_sb_from_v1() {
+    // Version 1 logstore_superblk has only the first seq_num, expand each of them without a replay checkpoint. It is
+    // persisted in the new format upon the next update of the meta.
+    auto const old_buf = m_sb.raw_buf();
+    auto const nstores = uint32_cast((old_buf->size() - sizeof(logdev_superblk)) / sizeof(logstore_seq_num_t));
+    auto const* old_area = r_cast< const logstore_seq_num_t* >(old_buf->cbytes() + sizeof(logdev_superblk));
+
+    m_sb.create(logdev_sb_size_needed(nstores));
+    std::memcpy(voidptr_cast(m_sb.raw_buf()->bytes()), static_cast< const void* >(old_buf->cbytes()),
+                sizeof(logdev_superblk));
+    m_sb->version = logdev_superblk::LOGDEV_SB_VERSION;
+
+    logstore_superblk* sb_area = m_sb->get_logstore_superblk();
+    std::fill_n(sb_area, store_capacity(), logstore_superblk::default_value());
+    for (uint32_t i{0}; i < nstores; ++i) {
+        sb_area[i] = logstore_superblk{old_area[i]};
+    }
+    LOGINFOMOD(logstore, "Upgraded logdev superblk of log_dev={} with {} store slots from version 1", m_sb->logdev_id,
+               nstores);
+}
+
 void LogDevMetadata::rollback_super_blk_found(const sisl::byte_view& buf, void* meta_cookie) {
     m_rollback_sb.load(buf, meta_cookie);
     HS_REL_ASSERT_EQ(m_rollback_sb->get_magic(), rollback_superblk::ROLLBACK_SB_MAGIC, "Rollback sb magic mismatch");
@@ -793,8 +1481,10 @@ std::vector< std::pair< logstore_id_t, logstore_superblk > > LogDevMetadata::loa
 
     for (uint32_t i{0}; i < m_rollback_sb->num_records; ++i) {
         const auto& rec = m_rollback_sb->at(i);
-        m_rollback_info.insert({rec.store_id, rec.idx_range});
+        merge_rollback_range(rec.store_id, rec.idx_range);
     }
+    // Records written before the ranges were merged are compacted on the next persist
+    if (num_rollback_ranges() != m_rollback_sb->num_records) { write_rollback_records(false /* persist_now */); }
 
     return ret_list;
 }
@@ -815,11 +1505,19 @@ logstore_id_t LogDevMetadata::reserve_store(bool persist_now) {
 }
 
 void LogDevMetadata::persist() {
-    m_sb.write();
+    // Delta write of the logdev superblk alone rewrites only the pages changed, which a batch would rewrite entirely
+    if (!m_rollback_info_dirty) {
+        m_sb.write();
+        return;
+    }
+
+    MetaBlkBatch batch;
+    m_sb.write(batch);
     if (m_rollback_info_dirty) {
-        m_rollback_sb.write();
+        m_rollback_sb.write(batch);
         m_rollback_info_dirty = false;
     }
+    meta_service().commit_batch(batch);
 }
 
 void LogDevMetadata::unreserve_store(logstore_id_t store_id, bool persist_now) {
@@ -892,75 +1590,83 @@ uint32_t LogDevMetadata::store_capacity() const {
     return (m_sb.size() - sizeof(logdev_superblk)) / sizeof(logstore_superblk);
 }
 
-void LogDevMetadata::add_rollback_record(logstore_id_t store_id, logid_range_t id_range, bool persist_now) {
-    m_rollback_info.insert({store_id, id_range});
+void LogDevMetadata::merge_rollback_range(logstore_id_t store_id, logid_range_t id_range) {
+    auto& ranges = m_rollback_info[store_id];
+    auto [first, last] = id_range;
+    auto it = ranges.upper_bound(first);
+    if ((it != ranges.begin()) && (std::prev(it)->second + 1 >= first)) { --it; }
+    while ((it != ranges.end()) && (it->first <= last + 1)) {
+        first = std::min(first, it->first);
+        last = std::max(last, it->second);
+        it = ranges.erase(it);
+    }
+    ranges.emplace(first, last);
+}
+
+void LogDevMetadata::write_rollback_records(bool persist_now) {
     resize_rollback_sb_if_needed();
-    m_rollback_sb->add_record(store_id, id_range);
+    m_rollback_sb->num_records = 0;
+    for (auto const& [store_id, ranges] : m_rollback_info) {
+        for (auto const& [first, last] : ranges) {
+            m_rollback_sb->add_record(store_id, std::make_pair(first, last));
+        }
+    }
 
     if (persist_now) { m_rollback_sb.write(); }
     m_rollback_info_dirty = !persist_now;
 }
 
+size_t LogDevMetadata::num_rollback_ranges() const {
+    size_t n{0};
+    for (auto const& [_, ranges] : m_rollback_info) {
+        n += ranges.size();
+    }
+    return n;
+}
+
+void LogDevMetadata::add_rollback_record(logstore_id_t store_id, logid_range_t id_range, bool persist_now) {
+    merge_rollback_range(store_id, id_range);
+    write_rollback_records(persist_now);
+}
+
 void LogDevMetadata::remove_rollback_record_upto(logid_t upto_id, bool persist_now) {
-    uint32_t n_removed{0};
-    for (auto i = m_rollback_sb->num_records; i > 0; --i) {
-        auto& rec = m_rollback_sb->at(i - 1);
-        HS_LOG(TRACE, logstore, "Removing record sb {} {}", rec.idx_range.second, upto_id);
-        if (rec.idx_range.second <= upto_id) {
-            m_rollback_sb->remove_ith_record(i - 1);
-            ++n_removed;
-        }
-    }
-
-    if (n_removed) {
-        for (auto it = m_rollback_info.begin(); it != m_rollback_info.end();) {
-            HS_LOG(TRACE, logstore, "Removing info {} {}", it->second.second, upto_id);
-            if (it->second.second <= upto_id) {
-                it = m_rollback_info.erase(it);
-            } else {
-                ++it;
-            }
+    // Ranges which are truncated entirely are removed and the one truncated partly is trimmed
+    bool changed{false};
+    for (auto s = m_rollback_info.begin(); s != m_rollback_info.end();) {
+        auto& ranges = s->second;
+        while (!ranges.empty() && (ranges.begin()->first <= upto_id)) {
+            auto const [first, last] = *ranges.begin();
+            HS_LOG(TRACE, logstore, "Removing rollback range [{}, {}] of store={} upto={}", first, last, s->first,
+                   upto_id);
+            ranges.erase(ranges.begin());
+            if (last > upto_id) { ranges.emplace(upto_id + 1, last); }
+            changed = true;
         }
-        resize_rollback_sb_if_needed();
-        if (persist_now) { m_rollback_sb.write(); }
-        m_rollback_info_dirty = !persist_now;
+        s = ranges.empty() ? m_rollback_info.erase(s) : std::next(s);
     }
+    if (changed) { write_rollback_records(persist_now); }
 }
 
 void LogDevMetadata::remove_all_rollback_records(logstore_id_t store_id, bool persist_now) {
-    uint32_t n_removed{0};
-    for (auto i = m_rollback_sb->num_records; i > 0; --i) {
-        auto& rec = m_rollback_sb->at(i - 1);
-        if (rec.store_id == store_id) {
-            m_rollback_sb->remove_ith_record(i - 1);
-            ++n_removed;
-        }
-    }
-    if (n_removed) {
-        m_rollback_info.erase(store_id);
-        resize_rollback_sb_if_needed();
-        if (persist_now) { m_rollback_sb.write(); }
-        m_rollback_info_dirty = !persist_now;
-    }
+    if (m_rollback_info.erase(store_id) != 0) { write_rollback_records(persist_now); }
 }
 
 uint32_t LogDevMetadata::num_rollback_records(logstore_id_t store_id) const {
-    HS_DBG_ASSERT_EQ(m_rollback_sb->num_records, m_rollback_info.size(),
+    HS_DBG_ASSERT_EQ(m_rollback_sb->num_records, num_rollback_ranges(),
                      "Rollback record count mismatch between sb and in-memory");
-    return m_rollback_info.count(store_id);
+    auto const it = m_rollback_info.find(store_id);
+    return (it == m_rollback_info.cend()) ? 0 : uint32_cast(it->second.size());
 }
 
 bool LogDevMetadata::is_rolled_back(logstore_id_t store_id, logid_t logid) const {
-    auto it_pair = m_rollback_info.equal_range(store_id);
-    for (auto it = it_pair.first; it != it_pair.second; ++it) {
-        const logid_range_t& log_id_range = it->second;
-        if ((logid >= log_id_range.first) && (logid <= log_id_range.second)) { return true; }
-    }
-    return false;
+    auto const s = m_rollback_info.find(store_id);
+    if (s == m_rollback_info.cend()) { return false; }
+    auto const it = s->second.upper_bound(logid);
+    return (it != s->second.cbegin()) && (std::prev(it)->second >= logid);
 }
 
 bool LogDevMetadata::resize_rollback_sb_if_needed() {
-    auto req_sz = rollback_superblk::size_needed(m_rollback_info.size());
+    auto req_sz = rollback_superblk::size_needed(num_rollback_ranges());
     if (meta_service().is_aligned_buf_needed(req_sz)) { req_sz = sisl::round_up(req_sz, meta_service().align_size()); }
 
     if (req_sz != m_rollback_sb.size()) {
@@ -22,21 +22,29 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <new>
+#include <optional>
 #include <ostream>
 #include <set>
+#include <span>
+#include <unordered_map>
 #include <vector>
 
+#include <deque>
+#include <boost/fiber/condition_variable.hpp>
+#include <boost/fiber/mutex.hpp>
 #include <boost/intrusive_ptr.hpp>
 #include <sisl/fds/id_reserver.hpp>
-#include <sisl/fds/stream_tracker.hpp>
 #include <sisl/fds/buffer.hpp>
 #include <folly/futures/SharedPromise.h>
 #include <fmt/format.h>
 #include <sisl/logging/logging.h>
 
+#include <homestore/crc.h>
 #include <homestore/logstore/log_store_internal.hpp>
 #include <homestore/superblk_handler.hpp>
 #include "common/homestore_config.hpp"
+#include "common/homestore_utils.hpp"
 #include "device/chunk.h"
 #include "device/journal_vdev.hpp"
 
@@ -46,8 +54,8 @@ static constexpr uint32_t LOG_GROUP_HDR_MAGIC{0xF00D1E};
 static constexpr uint32_t LOG_GROUP_FOOTER_MAGIC{0xB00D1E};
 static constexpr uint32_t dma_address_boundary{512}; // Mininum size the dma/writes to be aligned with
 static constexpr uint32_t initial_read_size{4096};
-// logdev doesn't support concurrent writes. There can only be 2 active log groups.
-static constexpr uint32_t max_log_group{2};
+// Log groups which can be in flight at once, upto which logstore.max_inflight_log_groups is capped
+static constexpr uint32_t max_log_group{16};
 
 // clang-format off
 /*
@@ -70,17 +78,20 @@ static constexpr uint32_t max_log_group{2};
 #pragma pack(1)
 struct serialized_log_record {
     uint32_t size;                    // Size of this log record
-    uint32_t offset : 31;             // Offset within the log_group where data is residing
+    uint32_t offset : 30;             // Offset within the log_group where data is residing
+    uint32_t is_compressed : 1;       // Is the log data compressed, prefixed with compressed_log_record_hdr
     uint32_t is_inlined : 1;          // Is the log data is inlined or out-of-band area
     logstore_seq_num_t store_seq_num; // Seqnum by the log store
     logstore_id_t store_id;           // ID of the store this log is associated with
 
     void set_inlined(bool inlined) { is_inlined = static_cast< uint32_t >(inlined ? 0x1 : 0x0); }
     bool get_inlined() const { return ((is_inlined == static_cast< uint32_t >(0x1)) ? true : false); }
+    void set_compressed(bool compressed) { is_compressed = static_cast< uint32_t >(compressed ? 0x1 : 0x0); }
+    bool get_compressed() const { return (is_compressed == static_cast< uint32_t >(0x1)); }
 
     serialized_log_record() = default;
     serialized_log_record(uint32_t s, uint32_t o, bool inlined, logstore_seq_num_t sq, logstore_id_t id) :
-            size{s}, offset{o}, store_seq_num{sq}, store_id{id} {
+            size{s}, offset{o}, is_compressed{0}, store_seq_num{sq}, store_id{id} {
         set_inlined(inlined);
     }
     serialized_log_record(const serialized_log_record&) = default;
@@ -91,15 +102,24 @@ struct serialized_log_record {
 };
 #pragma pack()
 
+/* Compressed log record data starts with this header, size in serialized_log_record is the compressed size */
+#pragma pack(1)
+struct compressed_log_record_hdr {
+    uint32_t raw_size; // Size of the record before compression
+};
+#pragma pack()
+
 /* This structure represents the in-memory representation of a log record */
 struct log_record {
     sisl::io_blob data;
     void* context;
     logstore_id_t store_id;
     logstore_seq_num_t seq_num;
+    uint32_t zero_copy_size{0}; // If non zero, data is written from its own buffer out of band, padded to this size
 
-    log_record(const logstore_id_t& sid, const logstore_seq_num_t snum, const sisl::io_blob& d, void* const ctx) :
-            data{d}, context{ctx}, store_id{sid}, seq_num{snum} {}
+    log_record(const logstore_id_t& sid, const logstore_seq_num_t snum, const sisl::io_blob& d, void* const ctx,
+               uint32_t zc_size = 0) :
+            data{d}, context{ctx}, store_id{sid}, seq_num{snum}, zero_copy_size{zc_size} {}
     log_record(const log_record&) = delete;
     log_record& operator=(const log_record&) = delete;
     log_record(log_record&&) noexcept = delete;
@@ -120,11 +140,83 @@ struct log_record {
     static size_t serialized_size(const uint32_t sz) { return sizeof(serialized_log_record) + sz; }
 };
 
+/*
+ * LogRecordRing: Holds the records of a logdev from they are appended till they are flushed, indexed by log idx, in a
+ * ring of slots. Appends take a free slot with a single compare and swap, so they never lock each other or the
+ * flush. Flushes complete the records in the order of log idx, so completion is an atomic watermark and
+ * truncation walks only the slots being freed. Record, whose slot is still held by a record which is yet to be
+ * truncated (more records outstanding than the ring size), is kept in an overflow map under a mutex.
+ *
+ * Appends can run concurrently with each other and with a flush, but preparing a flush, completing and truncating,
+ * which are all done under the flush, are not expected to run concurrently with each other.
+ */
+class LogRecordRing {
+public:
+    explicit LogRecordRing(uint32_t nslots);
+    LogRecordRing(const LogRecordRing&) = delete;
+    LogRecordRing& operator=(const LogRecordRing&) = delete;
+    ~LogRecordRing();
+
+    void reinit(logid_t start_idx);
+
+    template < typename... Args >
+    void create(logid_t idx, Args&&... args) {
+        auto& s = m_slots[uint64_cast(idx) & m_mask];
+        slot_state expected{slot_state::FREE};
+        if (s.state.compare_exchange_strong(expected, slot_state::FILLING, std::memory_order_acquire)) {
+            s.idx = idx;
+            new (s.buf) log_record(std::forward< Args >(args)...);
+            s.state.store(slot_state::ACTIVE, std::memory_order_release);
+        } else {
+            std::unique_lock lg{m_overflow_mtx};
+            m_overflow.emplace(idx, std::make_unique< log_record >(std::forward< Args >(args)...));
+            m_overflow_count.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    log_record& at(logid_t idx);
+
+    // Calls cb for each record from from_idx onwards, till it returns false or the next record is not appended yet
+    void foreach_contiguous_active(logid_t from_idx, const std::function< bool(logid_t, log_record&) >& cb);
+    void complete(logid_t from_idx, logid_t upto_idx);
+    void truncate(logid_t upto_idx);
+    logid_t completed_upto() const { return m_completed_upto.load(std::memory_order_acquire); }
+
+private:
+    enum class slot_state : uint8_t { FREE, FILLING, ACTIVE };
+    struct slot {
+        std::atomic< slot_state > state{slot_state::FREE};
+        logid_t idx{-1};
+        alignas(log_record) uint8_t buf[sizeof(log_record)];
+
+        log_record* rec() { return std::launder(r_cast< log_record* >(buf)); }
+    };
+
+    log_record* find(logid_t idx);
+    void release(logid_t idx);
+
+private:
+    std::unique_ptr< slot[] > m_slots;
+    uint64_t m_mask;
+    std::atomic< logid_t > m_completed_upto{-1};
+    logid_t m_truncated_upto{-1};
+
+    std::mutex m_overflow_mtx;
+    std::map< logid_t, std::unique_ptr< log_record > > m_overflow;
+    std::atomic< uint32_t > m_overflow_count{0};
+};
+
 /************************************* Log Group Section ************************************/
 /* This structure represents a group commit log header */
 #pragma pack(1)
 struct log_group_header {
-    static constexpr uint8_t header_version{0};
+    static constexpr uint8_t header_version{1};
+    static constexpr uint8_t crc32c_version{1}; // Groups of older versions are crc'ed with crc32 ieee
+
+    // Crc of len bytes of the group past its header, chained on the crc of the bytes before them
+    static crc32_t data_crc(uint8_t version, crc32_t crc, const uint8_t* data, uint64_t len) {
+        return (version >= crc32c_version) ? crc32c(crc, data, len) : crc32_ieee(crc, data, len);
+    }
 
     uint32_t magic;
     uint32_t version;
@@ -238,6 +330,7 @@ public:
     static constexpr size_t inline_log_buf_size{512 * optimal_num_records};
     static constexpr uint32_t max_records_in_a_batch{(initial_read_size - sizeof(log_group_header)) /
                                                      sizeof(serialized_log_record)};
+    static constexpr uint32_t packed_group_align{8}; // Groups sized to their actual end are rounded to it
 
     friend class LogDev;
 
@@ -252,15 +345,29 @@ public:
     void stop();
     void reset(const uint32_t max_records);
     void create_overflow_buf(const uint32_t min_needed);
+    void release_overflow_buf();
     bool add_record(log_record& record, const int64_t log_idx);
+    bool compress_inline(const log_record& record, serialized_log_record& slot);
     bool can_accomodate(const log_record& record) const { return (m_nrecords <= m_max_records); }
 
     const iovec_array& finish(logdev_id_t logdev_id, const crc32_t prev_crc);
     crc32_t compute_crc();
 
-    log_group_header* header() { return reinterpret_cast< log_group_header* >(m_cur_log_buf); }
-    const log_group_header* header() const { return reinterpret_cast< const log_group_header* >(m_cur_log_buf); }
+    // Places the group right after the tail of the previous group, in the partially filled last page of it, which is
+    // then rewritten along with the group. packed_size() is the size of such write, 0 if the group can't be packed.
+    uint64_t packed_size(uint32_t prev_tail_size) const;
+    void pack_after(sisl::blob const& prev_tail);
+
+    // Bytes of this group in its last page, if it ends in the middle of the page
+    sisl::blob tail_bytes() const;
+
+    log_group_header* header() { return reinterpret_cast< log_group_header* >(m_cur_log_buf + m_head_room); }
+    const log_group_header* header() const {
+        return reinterpret_cast< const log_group_header* >(m_cur_log_buf + m_head_room);
+    }
     iovec_array const& iovecs() const { return m_iovecs; }
+    uint32_t head_room() const { return m_head_room; }
+    uint64_t write_size() const;
     uint32_t actual_data_size() const { return m_actual_data_size; }
     uint32_t nrecords() const { return m_nrecords; }
 
@@ -268,14 +375,17 @@ public:
     auto flush_log_idx_from() const { return m_flush_log_idx_from; }
     auto flush_log_idx_upto() const { return m_flush_log_idx_upto; }
     auto log_dev_offset() const { return m_log_dev_offset; }
+    off_t write_offset() const { return m_log_dev_offset - m_head_room; }
 
-    sisl::aligned_unique_ptr< uint8_t, sisl::buftag::logwrite > m_log_buf;
-    sisl::aligned_unique_ptr< uint8_t, sisl::buftag::logwrite > m_footer_buf;
-    sisl::aligned_unique_ptr< uint8_t, sisl::buftag::logwrite > m_overflow_log_buf;
+    iobuf_unique_ptr< sisl::buftag::logwrite > m_log_buf;
+    iobuf_unique_ptr< sisl::buftag::logwrite > m_footer_buf;
+    iobuf_unique_ptr< sisl::buftag::logwrite > m_overflow_log_buf;
 
     uint8_t* m_cur_log_buf;
     uint32_t m_cur_buf_len;
     uint32_t m_footer_buf_len;
+    uint32_t m_mem_used{0};          // Size of the buffers accounted against the memory budget of the log groups
+    uint32_t m_overflow_mem_used{0}; // Part of it used by the overflow buffer
 
     serialized_log_record* m_record_slots;
     uint32_t m_inline_data_pos;
@@ -284,6 +394,9 @@ public:
     uint32_t m_nrecords{0};
     uint32_t m_max_records{0};
     uint32_t m_actual_data_size{0};
+    uint32_t m_compress_min_size{0}; // Inlined records of atleast this size are compressed, 0 if disabled
+    bool m_pack_tail{false};         // Group is sized to its actual end, so that the next group can be packed after it
+    uint32_t m_head_room{0};         // Bytes of the previous group the write starts with, when packed after it
 
     // Info about the final data
     iovec_array m_iovecs;
@@ -293,6 +406,15 @@ public:
 
     uint64_t m_flush_multiple_size{0};
 
+    // State of the write while it is in flight, when log groups are written asynchronously
+    Clock::time_point m_submit_time;
+    bool m_write_done{false};
+
+    // Tsc at the stages of the flush of the group, for the latency breakdown of the appends
+    uint64_t m_prepare_tsc{0};
+    uint64_t m_submit_tsc{0};
+    uint64_t m_written_tsc{0};
+
 private:
     log_group_footer* add_and_get_footer();
     bool new_iovec_for_footer() const;
@@ -396,7 +518,7 @@ struct logstore_superblk;
 #pragma pack(1)
 struct logdev_superblk {
     static constexpr uint32_t LOGDEV_SB_MAGIC{0xDABAF00D};
-    static constexpr uint32_t LOGDEV_SB_VERSION{1};
+    static constexpr uint32_t LOGDEV_SB_VERSION{2}; // Version 2 added replay checkpoint to logstore_superblk
 
     uint32_t magic{LOGDEV_SB_MAGIC};
     uint32_t version{LOGDEV_SB_VERSION};
@@ -514,7 +636,11 @@ public:
 
 private:
     bool resize_logdev_sb_if_needed();
+    void upgrade_logdev_sb_from_v1();
     bool resize_rollback_sb_if_needed();
+    void merge_rollback_range(logstore_id_t store_id, logid_range_t id_range);
+    void write_rollback_records(bool persist_now);
+    size_t num_rollback_ranges() const;
 
     uint32_t logdev_sb_size_needed(uint32_t nstores) const {
         return sizeof(logdev_superblk) + (nstores * sizeof(logstore_superblk));
@@ -527,7 +653,10 @@ private:
     superblk< rollback_superblk > m_rollback_sb;
     std::unique_ptr< sisl::IDReserver > m_id_reserver;
     std::set< logstore_id_t > m_store_info;
-    std::multimap< logstore_id_t, logid_range_t > m_rollback_info;
+
+    // Rolled back log ids of each store, as disjoint ranges keyed by their first log id, so that a replayed record is
+    // looked up in log time. Overlapping and adjacent rollbacks are merged into one range, which the superblk mirrors.
+    std::unordered_map< logstore_id_t, std::map< logid_t, logid_t > > m_rollback_info;
     bool m_rollback_info_dirty{false};
 };
 
@@ -538,7 +667,8 @@ class JournalVirtualDev;
 class log_stream_reader {
 public:
     log_stream_reader(off_t device_cursor, std::shared_ptr< JournalVirtualDev > vdev,
-                      shared< JournalVirtualDev::Descriptor > vdev_jd, uint64_t min_read_size);
+                      shared< JournalVirtualDev::Descriptor > vdev_jd, uint64_t min_read_size,
+                      bool verify_crc = true);
     log_stream_reader(const log_stream_reader&) = delete;
     log_stream_reader& operator=(const log_stream_reader&) = delete;
     log_stream_reader(log_stream_reader&&) noexcept = delete;
@@ -548,8 +678,11 @@ public:
     sisl::byte_view next_group(off_t* out_dev_offset);
     sisl::byte_view group_in_next_page();
 
+    // Validates the crc of the data of the group returned by next_group, if the reader is not verifying it itself
+    static bool is_group_crc_valid(const sisl::byte_view& group_buf);
+
 private:
-    sisl::byte_view read_next_bytes(uint64_t nbytes, bool& end_of_stream);
+    sisl::byte_view read_next_bytes(bool& end_of_stream);
 
 private:
     std::shared_ptr< JournalVirtualDev > m_vdev;
@@ -559,6 +692,14 @@ private:
     off_t m_cur_read_bytes{0};
     crc32_t m_prev_crc{0};
     uint64_t m_read_size_multiple;
+    bool m_verify_crc;
+    JournalReadAhead m_read_ahead; // Keeps the next read of the journal in flight while the groups are consumed
+    uint64_t m_skip_bytes{0};      // Bytes of the next read to skip, upto the next group within its page
+};
+
+struct log_replay_group {
+    sisl::byte_view buf;
+    off_t dev_offset;
 };
 
 struct logstore_info {
@@ -567,6 +708,48 @@ struct logstore_info {
     folly::SharedPromise< std::shared_ptr< HomeLogStore > > promise{};
 };
 
+/*
+ * GroupCommitController: Decides the group size and linger time of a logdev in adaptive flush mode
+ * (logstore.flush_adaptive). It tracks the arrival rate of log data and the write latency of the journal, latter as
+ * smoothed mean and deviation like the rtt estimation of TCP, with mean + 4 * deviation taken as its p99. The time
+ * left within logstore.flush_target_p99_latency_us after the p99 write latency is the linger time, and the data
+ * expected to arrive within it is the group size. So at low load it flushes right away and at high load, it groups as
+ * much as the latency target allows. Updated only by the flusher, read by the appenders.
+ */
+class GroupCommitController {
+public:
+    void on_flush(uint64_t bytes, uint64_t interval_us, uint64_t write_us);
+    int64_t batch_size() const { return m_batch_size.load(std::memory_order_relaxed); }
+    uint64_t linger_us() const { return m_linger_us.load(std::memory_order_relaxed); }
+
+private:
+    bool m_has_sample{false};
+    double m_arrival_rate{0.0}; // Bytes per us
+    double m_write_lat_us{0.0};
+    double m_write_lat_dev_us{0.0};
+    std::atomic< int64_t > m_batch_size{1};
+    std::atomic< uint64_t > m_linger_us{0};
+};
+
+/*
+ * LogTailCache: Holds the most recently flushed log groups of a logdev, upto logstore.tail_cache_size_mb, so that the
+ * reads of recent records, which lagging raft followers do repeatedly, are served from memory. Each group is held in a
+ * single refcounted buffer of the same layout as on the device, so records are handed out as views of it, without a
+ * copy. Oldest groups are evicted once it is full and all the groups before the truncation point upon truncation.
+ */
+class LogTailCache {
+public:
+    void insert(const LogGroup& lg);
+    std::optional< log_buffer > read(const logdev_key& key) const;
+    void truncate(logid_t upto_idx);
+    void clear();
+
+private:
+    mutable folly::SharedMutexWritePriority m_mtx;
+    std::map< logid_t, sisl::byte_array > m_groups; // Start log idx of the group to its buffer
+    uint64_t m_size{0};
+};
+
 static std::string const logdev_sb_meta_name{"Logdev_sb"};
 static std::string const logdev_rollback_sb_meta_name{"Logdev_rollback_sb"};
 
@@ -629,11 +812,25 @@ public:
      * structure which could be 8K
      * @param cb_context Context to put upon a callback once append is. Upon completion the registered callback is
      * called.
+     * @param zero_copy_size If non zero, data is not copied into the log group, but its buffer is written as is, upto
+     * this size which is a multiple of flush size. Buffer is expected to be aligned and sized accordingly.
      *
      * @return logid_t : log_idx of the log of the data.
      */
     logid_t append_async(logstore_id_t store_id, logstore_seq_num_t seq_num, const sisl::io_blob& data,
-                         void* cb_context);
+                         void* cb_context, uint32_t zero_copy_size = 0);
+
+    /**
+     * @brief Append the data of all the requests to the log device asynchronously, with consecutive log_idx reserved
+     * for them at once and a single check for flush at the end. Each request's data is expected to be valid, till its
+     * append callback is done.
+     *
+     * @param store_id: The upper layer store id for these log records
+     * @param reqs: Requests to append, which are also the context put upon their callbacks
+     *
+     * @return logid_t : log_idx of the first request.
+     */
+    logid_t append_batch(logstore_id_t store_id, std::span< logstore_req* const > reqs);
 
     /**
      * @brief Read the log id from the device offset
@@ -645,6 +842,17 @@ public:
      */
     log_buffer read(const logdev_key& key);
 
+    /**
+     * @brief Read the logs of all the keys provided. Keys within the same chunk, which are close to each other on the
+     * device, are read with a single device read of upto logstore.bulk_read_size, which makes reading a range of
+     * records mostly sequential reads instead of one read per record.
+     *
+     * @param keys : log_id and dev_offset pairs to read, expected to be in the order of the log_id
+     *
+     * @return std::vector< log_buffer > : Data blob of each key, in the order of the keys
+     */
+    std::vector< log_buffer > read_range(const std::vector< logdev_key >& keys);
+
     /**
      * @brief Read the log id from the device offset
      *
@@ -678,6 +886,17 @@ public:
      */
     void rollback(logstore_id_t store_id, logid_range_t id_range);
 
+    /**
+     * @brief Persist the replay checkpoint of the given store synchronously. Upon restart, replay of the logdev starts
+     * from the minimum of the replay keys across its stores, and records of the store before the lsn are not replayed.
+     *
+     * @param store_id : Store id whose checkpoint is to be updated
+     * @param replay_start_lsn : Lsn of the store from where replay starts
+     * @param replay_start_key : Logdev key of the log group from where replay of the store starts
+     */
+    void update_replay_checkpoint(logstore_id_t store_id, logstore_seq_num_t replay_start_lsn,
+                                  const logdev_key& replay_start_key);
+
     /**
      * @brief This method get all the store ids that are registered already and out of them which are being garbaged
      * and waiting to be garbage collected. Predominant use of this method is for validation and testing
@@ -725,6 +944,10 @@ public:
     logdev_id_t get_id() const { return m_logdev_id; }
     uint64_t get_flush_size_multiple() const { return m_flush_size_multiple; }
 
+    // Fiber on which the flushes and the flush timer of this logdev run, its flush thread unless it is pinned
+    iomgr::io_fiber_t flush_fiber() const;
+    void set_flush_fiber(iomgr::io_fiber_t fiber);
+
 private:
     void start_timer();
     void stop_timer();
@@ -733,7 +956,8 @@ private:
     bool allow_timer_flush() const { return uint32_cast(m_flush_mode) & uint32_cast(flush_mode_t::TIMER); }
     bool allow_explicit_flush() const { return uint32_cast(m_flush_mode) & uint32_cast(flush_mode_t::EXPLICIT); }
 
-    void verify_log_group_header(const logid_t idx, const log_group_header* header);
+    void verify_log_group_header(const logid_t idx, const log_group_header* header,
+                                 uint32_t avail_size = initial_read_size);
 
     /**
      * @brief Reserve logstore id and persist if needed. It persists the entire map about the logstore id inside the
@@ -752,19 +976,23 @@ private:
 
     void on_flush_completion(LogGroup* lg);
     void on_log_store_found(logstore_id_t store_id, const logstore_superblk& sb);
+    logdev_key replay_start_key(const std::vector< std::pair< logstore_id_t, logstore_superblk > >& store_list) const;
     void handle_unopened_log_stores(bool format);
     void on_logfound(logstore_id_t id, logstore_seq_num_t seq_num, logdev_key ld_key, logdev_key flush_ld_key,
                      log_buffer buf, uint32_t nremaining_in_batch);
 
-    LogGroup* make_log_group(uint32_t estimated_records) {
-        m_log_group_pool[m_log_group_idx].reset(estimated_records);
-        return &m_log_group_pool[m_log_group_idx];
-    }
-
-    void free_log_group(LogGroup* lg) { m_log_group_idx = !m_log_group_idx; }
+    LogGroup* make_log_group(uint32_t estimated_records);
+    void free_log_group(LogGroup* lg);
+    bool is_pipelined() const { return m_num_log_groups > 1; }
+    void submit_log_group(LogGroup* lg);
+    void on_log_group_written(LogGroup* lg, std::error_code const& ec);
+    void wait_for_inflight_log_groups();
 
     LogGroup* prepare_flush(int32_t estimated_record);
     void do_load(off_t offset);
+    void replay_log_group(const sisl::byte_view& buf, off_t group_dev_offset);
+    void replay_log_groups(const std::vector< log_replay_group >& groups, uint32_t nfibers);
+    HomeLogStore* replay_log_store(logstore_id_t id);
     void assert_next_pages(log_stream_reader& lstream);
 
     /// @brief force to flush the log device
@@ -773,8 +1001,11 @@ private:
 
     bool can_flush_in_this_thread();
 
+    // Whether a log group of the logdev is still being written or completed, with pipelined flushes
+    bool has_inflight_log_groups() const;
+
 private:
-    std::unique_ptr< sisl::StreamTracker< log_record > > m_log_records; // Container stores all in-memory log records
+    std::unique_ptr< LogRecordRing > m_log_records; // Container stores all in-memory log records
     std::atomic< logid_t > m_log_idx{0};                                // Generator of log idx
     std::atomic< int64_t > m_pending_flush_size{0};                     // How much flushable logs are pending
     bool m_stopped{false}; // Is Logdev stopped. We don't need lock here, because it is updated under flush lock
@@ -789,22 +1020,35 @@ private:
     std::unordered_map< logstore_id_t, uint64_t > m_unopened_store_io;
     std::unordered_set< logstore_id_t > m_unopened_store_id;
     std::multimap< logid_t, logstore_id_t > m_garbage_store_ids;
+    std::mutex m_truncate_mtx; // Serializes the truncations, which otherwise don't hold the flush guard throughout
     Clock::time_point m_last_flush_time;
 
     logid_t m_last_flush_idx{-1}; // Track last flushed, last device offset and truncated log idx
     logid_t m_last_truncate_idx{std::numeric_limits< logid_t >::min()}; // logdev truncate up to this idx
     crc32_t m_last_crc{INVALID_CRC32_VALUE};
+    logid_t m_last_prepared_idx{-1}; // Last log idx put in a log group, ahead of flushed one while groups are in flight
+    crc32_t m_last_prepared_crc{INVALID_CRC32_VALUE}; // Crc of the last prepared group, which the next one chains to
+    std::vector< uint8_t > m_tail_bytes; // Last group in its last page, if it ends in the middle of it, to pack after
 
     // LogDev Info block related fields
     std::mutex m_meta_mutex;
     LogDevMetadata m_logdev_meta;
     uint64_t m_flush_size_multiple{0};
 
-    // Pool for creating log group
+    // Pool for creating log group. Groups in flight are completed in the order they are submitted, by one at a time
     LogGroup m_log_group_pool[max_log_group];
-    uint32_t m_log_group_idx{0};
+    uint32_t m_num_log_groups{1};
+    mutable boost::fibers::mutex m_inflight_mtx;
+    boost::fibers::condition_variable m_inflight_cv;
+    std::vector< LogGroup* > m_free_log_groups;
+    std::deque< LogGroup* > m_inflight_log_groups;
+    bool m_completing_log_groups{false};
+    Clock::time_point m_last_completed_submit_time; // Used by adaptive flush to track the rate of log groups
     // Timer handle
     iomgr::timer_handle_t m_flush_timer_hdl{iomgr::null_timer_handle};
+    std::atomic< iomgr::io_fiber_t > m_pinned_flush_fiber{nullptr}; // Set if flushes are pinned to a fiber of the owner
+    GroupCommitController m_group_commit; // Sizes the log groups, if adaptive flush is on
+    LogTailCache m_tail_cache;            // Recently flushed log groups, served to the reads
 
     // if we support inline flush mode, we might schedule flush operation in the same thread(for exampel, in the
     // callback of the append_async we schedule another flush.), so we need the lock to be locked for multitimes in the
@@ -14,9 +14,11 @@
  *
  *********************************************************************************/
 #include <cstring>
+#include <lz4.h>
 
 #include <homestore/logstore/log_store.hpp>
 #include "common/homestore_assert.hpp"
+#include "common/resource_mgr.hpp"
 #include "log_dev.hpp"
 
 namespace homestore {
@@ -29,17 +31,32 @@ void LogGroup::start(const uint64_t flush_multiple_size, const uint32_t align_si
 
     // TO DO: Might need to differentiate based on data or fast type
     m_cur_buf_len = sisl::round_up(inline_log_buf_size, flush_multiple_size);
-    m_log_buf = sisl::aligned_unique_ptr< uint8_t, sisl::buftag::logwrite >::make_sized(align_size, m_cur_buf_len);
+    m_log_buf = make_iobuf< sisl::buftag::logwrite >(m_cur_buf_len, align_size);
 
     m_footer_buf_len = sisl::round_up(sizeof(log_group_footer), flush_multiple_size);
-    m_footer_buf =
-        sisl::aligned_unique_ptr< uint8_t, sisl::buftag::logwrite >::make_sized(align_size, m_footer_buf_len);
+    m_footer_buf = make_iobuf< sisl::buftag::logwrite >(m_footer_buf_len, align_size);
+    m_mem_used = m_cur_buf_len + m_footer_buf_len;
+    resource_mgr().inc_mem_used(mem_budget_t::LOG_GROUPS, m_mem_used);
 }
 
 void LogGroup::stop() {
     m_log_buf.reset();
     m_overflow_log_buf.reset();
     m_footer_buf.reset();
+    if (m_mem_used) {
+        resource_mgr().dec_mem_used(mem_budget_t::LOG_GROUPS, m_mem_used);
+        m_mem_used = 0;
+        m_overflow_mem_used = 0;
+    }
+}
+
+void LogGroup::release_overflow_buf() {
+    m_overflow_log_buf = nullptr;
+    if (m_overflow_mem_used) {
+        resource_mgr().dec_mem_used(mem_budget_t::LOG_GROUPS, m_overflow_mem_used);
+        m_mem_used -= m_overflow_mem_used;
+        m_overflow_mem_used = 0;
+    }
 }
 
 void LogGroup::reset(const uint32_t max_records) {
@@ -49,10 +66,13 @@ void LogGroup::reset(const uint32_t max_records) {
     m_inline_data_pos = sizeof(log_group_header) + (sizeof(serialized_log_record) * max_records);
     m_oob_data_pos = 0;
 
-    m_overflow_log_buf = nullptr;
+    release_overflow_buf();
     m_nrecords = 0;
     m_max_records = std::min(max_records, max_records_in_a_batch);
     m_actual_data_size = 0;
+    m_compress_min_size = HS_DYNAMIC_CONFIG(logstore.record_compression_min_size);
+    m_pack_tail = HS_DYNAMIC_CONFIG(logstore.pack_log_group_tail);
+    m_head_room = 0;
 
     m_iovecs.clear();
     m_iovecs.emplace_back(static_cast< void* >(m_cur_log_buf), m_inline_data_pos);
@@ -60,11 +80,14 @@ void LogGroup::reset(const uint32_t max_records) {
 
 void LogGroup::create_overflow_buf(const uint32_t min_needed) {
     auto const new_len = sisl::round_up(std::max(min_needed, m_cur_buf_len * 2), m_flush_multiple_size);
-    auto new_buf =
-        sisl::aligned_unique_ptr< uint8_t, sisl::buftag::logwrite >::make_sized(m_flush_multiple_size, new_len);
+    auto new_buf = make_iobuf< sisl::buftag::logwrite >(new_len, m_flush_multiple_size);
     std::memcpy(s_cast< void* >(new_buf.get()), s_cast< const void* >(m_cur_log_buf), m_cur_buf_len);
 
+    release_overflow_buf();
     m_overflow_log_buf = std::move(new_buf);
+    m_overflow_mem_used = new_len;
+    m_mem_used += new_len;
+    resource_mgr().inc_mem_used(mem_budget_t::LOG_GROUPS, new_len);
     m_cur_log_buf = m_overflow_log_buf.get();
     m_cur_buf_len = new_len;
     m_record_slots = r_cast< serialized_log_record* >(m_cur_log_buf + sizeof(log_group_header));
@@ -81,7 +104,7 @@ bool LogGroup::add_record(log_record& record, const int64_t log_idx) {
     }
 
     m_actual_data_size += record.data.size();
-    if ((m_inline_data_pos + record.data.size()) >= m_cur_buf_len) {
+    if ((record.zero_copy_size == 0) && ((m_inline_data_pos + record.data.size()) >= m_cur_buf_len)) {
         create_overflow_buf(m_inline_data_pos + record.data.size());
     }
 
@@ -94,12 +117,21 @@ bool LogGroup::add_record(log_record& record, const int64_t log_idx) {
     m_record_slots[m_nrecords].size = record.data.size();
     m_record_slots[m_nrecords].store_id = record.store_id;
     m_record_slots[m_nrecords].store_seq_num = record.seq_num;
-    if (record.is_inlineable(m_flush_multiple_size)) {
+    m_record_slots[m_nrecords].set_compressed(false);
+    if (record.zero_copy_size != 0) {
+        // Buffer is written as is along with its padding, slot still carries the actual size of the data
+        m_record_slots[m_nrecords].offset = m_oob_data_pos;
+        m_record_slots[m_nrecords].set_inlined(false);
+        m_iovecs.emplace_back(s_cast< void* >(record.data.bytes()), record.zero_copy_size);
+        m_oob_data_pos += record.zero_copy_size;
+    } else if (record.is_inlineable(m_flush_multiple_size)) {
         m_record_slots[m_nrecords].offset = m_inline_data_pos;
         m_record_slots[m_nrecords].set_inlined(true);
-        std::memcpy(s_cast< void* >(m_cur_log_buf + m_inline_data_pos), s_cast< const void* >(record.data.cbytes()),
-                    record.data.size());
-        m_inline_data_pos += record.data.size();
+        if (!compress_inline(record, m_record_slots[m_nrecords])) {
+            std::memcpy(s_cast< void* >(m_cur_log_buf + m_inline_data_pos),
+                        s_cast< const void* >(record.data.cbytes()), record.data.size());
+        }
+        m_inline_data_pos += m_record_slots[m_nrecords].size;
         m_iovecs[0].iov_len = m_inline_data_pos;
     } else {
         // We do not round it now, it will be rounded during finish
@@ -113,6 +145,25 @@ bool LogGroup::add_record(log_record& record, const int64_t log_idx) {
     return true;
 }
 
+bool LogGroup::compress_inline(const log_record& record, serialized_log_record& slot) {
+    if ((m_compress_min_size == 0) || (record.data.size() < m_compress_min_size)) { return false; }
+
+    // Compress only if it saves space, which is also why it never needs more buffer than the uncompressed record
+    auto const max_csize = int_cast(record.data.size()) - int_cast(sizeof(compressed_log_record_hdr)) - 1;
+    if (max_csize <= 0) { return false; }
+
+    auto* dst = m_cur_log_buf + m_inline_data_pos;
+    auto const csize = LZ4_compress_default(r_cast< const char* >(record.data.cbytes()),
+                                            r_cast< char* >(dst + sizeof(compressed_log_record_hdr)),
+                                            int_cast(record.data.size()), max_csize);
+    if (csize <= 0) { return false; }
+
+    r_cast< compressed_log_record_hdr* >(dst)->raw_size = uint32_cast(record.data.size());
+    slot.size = uint32_cast(sizeof(compressed_log_record_hdr) + csize);
+    slot.set_compressed(true);
+    return true;
+}
+
 bool LogGroup::new_iovec_for_footer() const {
     return ((m_inline_data_pos + sizeof(log_group_footer)) >= m_cur_buf_len || m_oob_data_pos != 0);
 }
@@ -121,14 +172,19 @@ const iovec_array& LogGroup::finish(logdev_id_t logdev_id, const crc32_t prev_cr
     // add footer
     auto footer = add_and_get_footer();
 
+    // Group which is all in the inline buffer ends where its footer ends, instead of at the end of its last page, so
+    // that the next group can be packed right after it. Rest of the page is zeroed, which the readers skip over.
+    bool const sized_to_end = m_pack_tail && (m_iovecs.size() == 1);
+    auto const end = sisl::round_up(uint32_cast(m_iovecs[0].iov_len), packed_group_align);
     m_iovecs[0].iov_len = sisl::round_up(m_iovecs[0].iov_len, m_flush_multiple_size);
+    if (sized_to_end) { std::memset(m_cur_log_buf + end, 0, m_iovecs[0].iov_len - end); }
 
     log_group_header* hdr = new (header()) log_group_header{};
     hdr->logdev_id = logdev_id;
     hdr->n_log_records = m_nrecords;
     hdr->prev_grp_crc = prev_crc;
     hdr->inline_data_offset = sizeof(log_group_header) + (m_max_records * sizeof(serialized_log_record));
-    hdr->oob_data_offset = m_iovecs[0].iov_len;
+    hdr->oob_data_offset = sized_to_end ? end : m_iovecs[0].iov_len;
     if (new_iovec_for_footer()) {
         hdr->footer_offset = hdr->oob_data_offset + m_oob_data_pos;
         hdr->group_size = hdr->footer_offset + m_footer_buf_len;
@@ -143,7 +199,7 @@ const iovec_array& LogGroup::finish(logdev_id_t logdev_id, const crc32_t prev_cr
     for (auto const& iv : m_iovecs) {
         len += iv.iov_len;
     }
-    HS_DBG_ASSERT_EQ(hdr->group_size, len, "length is not same");
+    HS_DBG_ASSERT_EQ(hdr->group_size, sized_to_end ? uint64_cast(end) : len, "length is not same");
 #endif
 
     footer->start_log_idx = hdr->start_log_idx;
@@ -166,14 +222,50 @@ log_group_footer* LogGroup::add_and_get_footer() {
 }
 
 crc32_t LogGroup::compute_crc() {
-    crc32_t crc =
-        crc32_ieee(init_crc32, static_cast< const unsigned char* >(m_iovecs[0].iov_base) + sizeof(log_group_header),
-                   m_iovecs[0].iov_len - sizeof(log_group_header));
+    // Inline buffer is covered upto where the oob data starts, which is the end of the group if it is sized to its end
+    auto const version = log_group_header::header_version;
+    crc32_t crc = log_group_header::data_crc(version, init_crc32,
+                                             r_cast< const uint8_t* >(header()) + sizeof(log_group_header),
+                                             header()->oob_data_offset - sizeof(log_group_header));
     for (size_t i{1}; i < m_iovecs.size(); ++i) {
-        crc = crc32_ieee(crc, static_cast< const unsigned char* >(m_iovecs[i].iov_base), m_iovecs[i].iov_len);
+        crc = log_group_header::data_crc(version, crc, static_cast< const uint8_t* >(m_iovecs[i].iov_base),
+                                         m_iovecs[i].iov_len);
     }
 
     return crc;
 }
 
+uint64_t LogGroup::packed_size(uint32_t prev_tail_size) const {
+    auto const len = sisl::round_up(uint64_cast(prev_tail_size) + header()->total_size(), m_flush_multiple_size);
+    return ((m_iovecs.size() == 1) && (m_head_room == 0) && (len <= m_cur_buf_len)) ? len : 0;
+}
+
+void LogGroup::pack_after(sisl::blob const& prev_tail) {
+    auto const len = packed_size(prev_tail.size());
+    HS_DBG_ASSERT_NE(len, 0, "Log group can't be packed after the previous group");
+
+    auto const group_size = header()->total_size();
+    std::memmove(m_cur_log_buf + prev_tail.size(), m_cur_log_buf, group_size);
+    std::memcpy(m_cur_log_buf, prev_tail.cbytes(), prev_tail.size());
+    std::memset(m_cur_log_buf + prev_tail.size() + group_size, 0, len - prev_tail.size() - group_size);
+    m_head_room = prev_tail.size();
+    m_record_slots = r_cast< serialized_log_record* >(m_cur_log_buf + m_head_room + sizeof(log_group_header));
+    m_iovecs[0].iov_len = len;
+}
+
+sisl::blob LogGroup::tail_bytes() const {
+    if (m_iovecs.size() != 1) { return sisl::blob{}; }
+    auto const end = m_head_room + header()->total_size();
+    auto const start = sisl::round_down(end, m_flush_multiple_size);
+    return sisl::blob{m_cur_log_buf + start, uint32_cast(end - start)};
+}
+
+uint64_t LogGroup::write_size() const {
+    uint64_t len{0};
+    for (auto const& iv : m_iovecs) {
+        len += iv.iov_len;
+    }
+    return len;
+}
+
 } // namespace homestore
@@ -0,0 +1,241 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <homestore/logstore/log_record_index.hpp>
+#include "common/homestore_assert.hpp"
+
+namespace homestore {
+static constexpr size_t s_foreach_batch{64};
+
+LogRecordIndex::LogRecordIndex(logstore_seq_num_t truncated_upto) :
+        m_origin{truncated_upto + 1}, m_truncated_upto{truncated_upto} {}
+
+LogRecordIndex::chunk* LogRecordIndex::chunk_of(logstore_seq_num_t lsn) const {
+    auto const i = ((lsn - m_origin) / s_chunk_slots) - m_first_chunk_num;
+    return ((i >= 0) && (uint64_cast(i) < m_chunks.size())) ? m_chunks[i].get() : nullptr;
+}
+
+void LogRecordIndex::set_slot(logstore_seq_num_t lsn, const logstore_record* rec) {
+    while (true) {
+        {
+            folly::SharedMutexWritePriority::ReadHolder holder(m_mtx);
+            if (lsn <= m_truncated_upto) { return; }
+            if (auto* c = chunk_of(lsn)) {
+                auto& s = c->slots[(lsn - m_origin) % s_chunk_slots];
+                uint64_t word{uint64_t(slot_state::ACTIVE) << s_state_shift};
+                if (rec != nullptr) {
+                    auto const& k = rec->m_dev_key;
+                    auto const& t = rec->m_trunc_key;
+                    logid_t base{s_no_idx};
+                    c->base_idx.compare_exchange_strong(base, k.idx, std::memory_order_acq_rel);
+                    base = c->base_idx.load(std::memory_order_acquire);
+
+                    auto const fits = [](int64_t d) {
+                        return (d >= std::numeric_limits< int32_t >::min()) &&
+                            (d <= std::numeric_limits< int32_t >::max());
+                    };
+                    if (k.is_valid() && (k.dev_offset >= 0) && (uint64_cast(k.dev_offset) <= s_offset_mask) &&
+                        (t.dev_offset == k.dev_offset) && fits(k.idx - base) && fits(t.idx - k.idx)) {
+                        s.idx_delta.store(int32_t(k.idx - base), std::memory_order_relaxed);
+                        s.trunc_idx_delta.store(int32_t(t.idx - k.idx), std::memory_order_relaxed);
+                        word = (uint64_t(slot_state::COMPLETED) << s_state_shift) | uint64_cast(k.dev_offset);
+                    } else {
+                        std::unique_lock lg{m_spill_mtx};
+                        m_spilled[lsn] = *rec;
+                        word = uint64_t(slot_state::SPILLED) << s_state_shift;
+                    }
+                }
+
+                auto const old = state_of(s.word.exchange(word, std::memory_order_acq_rel));
+                if (old == slot_state::HOLE) { c->nissued.fetch_add(1, std::memory_order_relaxed); }
+                if (!is_completed(old) && is_completed(state_of(word))) {
+                    c->ncompleted.fetch_add(1, std::memory_order_relaxed);
+                }
+                return;
+            }
+        }
+
+        folly::SharedMutexWritePriority::WriteHolder holder(m_mtx);
+        auto const num = (lsn - m_origin) / s_chunk_slots;
+        while ((m_first_chunk_num + int64_cast(m_chunks.size())) <= num) {
+            m_chunks.emplace_back(std::make_unique< chunk >());
+        }
+    }
+}
+
+void LogRecordIndex::create(logstore_seq_num_t lsn) { set_slot(lsn, nullptr); }
+
+void LogRecordIndex::complete(logstore_seq_num_t lsn, const logstore_record& rec) { set_slot(lsn, &rec); }
+
+void LogRecordIndex::create_and_complete(logstore_seq_num_t lsn, const logstore_record& rec) { set_slot(lsn, &rec); }
+
+log_record_status LogRecordIndex::status(logstore_seq_num_t lsn) const {
+    log_record_status st;
+    folly::SharedMutexWritePriority::ReadHolder holder(m_mtx);
+    if (lsn <= m_truncated_upto) {
+        st.is_out_of_range = true;
+        return st;
+    }
+
+    auto const* c = chunk_of(lsn);
+    auto const state = (c == nullptr)
+        ? slot_state::HOLE
+        : state_of(c->slots[(lsn - m_origin) % s_chunk_slots].word.load(std::memory_order_acquire));
+    st.is_hole = (state == slot_state::HOLE);
+    st.is_active = (state == slot_state::ACTIVE);
+    st.is_completed = is_completed(state);
+    return st;
+}
+
+logstore_record LogRecordIndex::record_of(logstore_seq_num_t lsn, const chunk& c, const slot& s) const {
+    auto const word = s.word.load(std::memory_order_acquire);
+    switch (state_of(word)) {
+    case slot_state::COMPLETED: {
+        auto const off = off_t(word & s_offset_mask);
+        auto const idx = c.base_idx.load(std::memory_order_relaxed) + s.idx_delta.load(std::memory_order_relaxed);
+        return logstore_record{logdev_key{idx, off},
+                               logdev_key{idx + s.trunc_idx_delta.load(std::memory_order_relaxed), off}};
+    }
+    case slot_state::SPILLED: {
+        std::unique_lock lg{m_spill_mtx};
+        auto const it = m_spilled.find(lsn);
+        return (it == m_spilled.cend()) ? logstore_record{} : it->second;
+    }
+    default:
+        return logstore_record{};
+    }
+}
+
+logstore_record LogRecordIndex::at(logstore_seq_num_t lsn) const {
+    folly::SharedMutexWritePriority::ReadHolder holder(m_mtx);
+    if (lsn <= m_truncated_upto) { return logstore_record{}; }
+    auto const* c = chunk_of(lsn);
+    return (c == nullptr) ? logstore_record{} : record_of(lsn, *c, c->slots[(lsn - m_origin) % s_chunk_slots]);
+}
+
+void LogRecordIndex::foreach_all_completed(
+    logstore_seq_num_t start_lsn, const std::function< bool(logstore_seq_num_t, const logstore_record&) >& cb) const {
+    // Records are picked in batches under the lock and handed over outside of it, as cb could read the logdev
+    std::vector< std::pair< logstore_seq_num_t, logstore_record > > batch;
+    batch.reserve(s_foreach_batch);
+    auto lsn = start_lsn;
+    while (true) {
+        batch.clear();
+        {
+            folly::SharedMutexWritePriority::ReadHolder holder(m_mtx);
+            lsn = std::max(lsn, m_truncated_upto + 1);
+            while (batch.size() < s_foreach_batch) {
+                auto const* c = chunk_of(lsn);
+                if (c == nullptr) { break; }
+                auto const& s = c->slots[(lsn - m_origin) % s_chunk_slots];
+                if (!is_completed(state_of(s.word.load(std::memory_order_acquire)))) { break; }
+                batch.emplace_back(lsn, record_of(lsn, *c, s));
+                ++lsn;
+            }
+        }
+
+        for (auto const& [l, rec] : batch) {
+            if (!cb(l, rec)) { return; }
+        }
+        if (batch.size() < s_foreach_batch) { return; }
+    }
+}
+
+logstore_seq_num_t LogRecordIndex::scan_upto(logstore_seq_num_t from, bool completed) const {
+    folly::SharedMutexWritePriority::ReadHolder holder(m_mtx);
+    auto lsn = std::max(from, m_truncated_upto + 1);
+    while (auto const* c = chunk_of(lsn)) {
+        // Chunks whose slots are all written, or completed, are skipped as a whole
+        auto const n = completed ? c->ncompleted.load(std::memory_order_relaxed)
+                                 : c->nissued.load(std::memory_order_relaxed);
+        auto const slot_idx = (lsn - m_origin) % s_chunk_slots;
+        if (n == s_chunk_slots) {
+            lsn += s_chunk_slots - slot_idx;
+            continue;
+        }
+
+        auto const state = state_of(c->slots[slot_idx].word.load(std::memory_order_acquire));
+        if (completed ? !is_completed(state) : (state == slot_state::HOLE)) { break; }
+        ++lsn;
+    }
+    return lsn - 1;
+}
+
+logstore_seq_num_t LogRecordIndex::active_upto(logstore_seq_num_t from) const { return scan_upto(from, false); }
+
+logstore_seq_num_t LogRecordIndex::completed_upto(logstore_seq_num_t from) const { return scan_upto(from, true); }
+
+void LogRecordIndex::truncate(logstore_seq_num_t upto_lsn) {
+    folly::SharedMutexWritePriority::WriteHolder holder(m_mtx);
+    if (upto_lsn <= m_truncated_upto) { return; }
+    m_truncated_upto = upto_lsn;
+
+    auto const first_num = (upto_lsn + 1 - m_origin) / s_chunk_slots;
+    while (!m_chunks.empty() && (m_first_chunk_num < first_num)) {
+        m_chunks.pop_front();
+        ++m_first_chunk_num;
+    }
+    if (m_chunks.empty()) { m_first_chunk_num = first_num; }
+
+    std::unique_lock lg{m_spill_mtx};
+    std::erase_if(m_spilled, [upto_lsn](auto const& it) { return it.first <= upto_lsn; });
+}
+
+void LogRecordIndex::rollback(logstore_seq_num_t to_lsn) {
+    folly::SharedMutexWritePriority::WriteHolder holder(m_mtx);
+    to_lsn = std::max(to_lsn, m_truncated_upto);
+
+    // Chunks which are all after to_lsn are freed and the slots after it in its own chunk turned into holes
+    if (to_lsn < m_origin) {
+        m_chunks.clear();
+    } else {
+        auto const last_num = (to_lsn - m_origin) / s_chunk_slots;
+        while (!m_chunks.empty() && ((m_first_chunk_num + int64_cast(m_chunks.size()) - 1) > last_num)) {
+            m_chunks.pop_back();
+        }
+    }
+    if (auto* c = (to_lsn < m_origin) ? nullptr : chunk_of(to_lsn)) {
+        for (auto i = ((to_lsn - m_origin) % s_chunk_slots) + 1; i < s_chunk_slots; ++i) {
+            auto const old = state_of(c->slots[i].word.exchange(0, std::memory_order_acq_rel));
+            if (old != slot_state::HOLE) { c->nissued.fetch_sub(1, std::memory_order_relaxed); }
+            if (is_completed(old)) { c->ncompleted.fetch_sub(1, std::memory_order_relaxed); }
+        }
+    }
+
+    std::unique_lock lg{m_spill_mtx};
+    std::erase_if(m_spilled, [to_lsn](auto const& it) { return it.first > to_lsn; });
+}
+
+nlohmann::json LogRecordIndex::get_status(int verbosity) const {
+    nlohmann::json js;
+    {
+        folly::SharedMutexWritePriority::ReadHolder holder(m_mtx);
+        std::unique_lock lg{m_spill_mtx};
+        js["truncated_upto"] = m_truncated_upto;
+        js["num_chunks"] = m_chunks.size();
+        js["num_spilled"] = m_spilled.size();
+        js["mem_bytes"] = (m_chunks.size() * sizeof(chunk)) +
+            (m_spilled.size() * (sizeof(logstore_seq_num_t) + sizeof(logstore_record)));
+    }
+    if (verbosity > 0) {
+        js["active_upto"] = active_upto();
+        js["completed_upto"] = completed_upto();
+    }
+    return js;
+}
+} // namespace homestore
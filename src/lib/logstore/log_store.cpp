@@ -22,7 +22,9 @@
 
 #include <homestore/homestore.hpp>
 #include <homestore/logstore_service.hpp>
+#include <homestore/perf_stats.hpp>
 #include "common/homestore_assert.hpp"
+#include "common/tsc_clock.hpp"
 #include "log_dev.hpp"
 
 namespace homestore {
@@ -36,7 +38,7 @@ HomeLogStore::HomeLogStore(std::shared_ptr< LogDev > logdev, logstore_id_t id, b
                            logstore_seq_num_t start_lsn) :
         m_store_id{id},
         m_logdev{logdev},
-        m_records{"HomeLogStoreRecords", start_lsn - 1},
+        m_records{start_lsn - 1},
         m_append_mode{append_mode},
         m_start_lsn{start_lsn},
         m_next_lsn{start_lsn},
@@ -46,8 +48,10 @@ HomeLogStore::HomeLogStore(std::shared_ptr< LogDev > logdev, logstore_id_t id, b
 
 void HomeLogStore::write_async(logstore_req* req, const log_req_comp_cb_t& cb) {
     HS_LOG_ASSERT((cb || m_comp_cb), "Expected either cb is not null or default cb registered");
+    HS_REL_ASSERT(!hs()->is_read_only(), "Log store={} is appended to by a read only open", m_store_id);
     req->cb = (cb ? cb : m_comp_cb);
     req->start_time = Clock::now();
+    req->append_tsc = TscClock::now();
 
 #ifndef NDEBUG
     if (req->seq_num < start_lsn()) {
@@ -58,7 +62,8 @@ void HomeLogStore::write_async(logstore_req* req, const log_req_comp_cb_t& cb) {
     m_records.create(req->seq_num);
     COUNTER_INCREMENT(m_metrics, logstore_append_count, 1);
     HISTOGRAM_OBSERVE(m_metrics, logstore_record_size, req->data.size());
-    m_logdev->append_async(m_store_id, req->seq_num, req->data, static_cast< void* >(req));
+    m_logdev->append_async(m_store_id, req->seq_num, req->data, static_cast< void* >(req),
+                           uint32_cast(req->zero_copy_buf.size()));
 }
 
 void HomeLogStore::write_async(logstore_seq_num_t seq_num, const sisl::io_blob& b, void* cookie,
@@ -80,6 +85,78 @@ logstore_seq_num_t HomeLogStore::append_async(const sisl::io_blob& b, void* cook
     return seq_num;
 }
 
+logstore_seq_num_t HomeLogStore::append_async(sisl::io_blob_safe&& buf, uint32_t size, void* cookie,
+                                             const log_write_comp_cb_t& cb) {
+    HS_DBG_ASSERT_EQ(m_append_mode, true, "append_async can be called only on append only mode");
+    auto const align = zero_copy_align_size();
+    HS_REL_ASSERT(((r_cast< uintptr_t >(buf.cbytes()) % align) == 0) && ((buf.size() % align) == 0) &&
+                      (size <= buf.size()),
+                  "Zero copy append buffer of size={} is not aligned to {} or is smaller than data size={}", buf.size(),
+                  align, size);
+    std::memset(buf.bytes() + size, 0, buf.size() - size);
+
+    const auto seq_num = m_next_lsn.fetch_add(1, std::memory_order_acq_rel);
+    auto* req = logstore_req::make(this, seq_num, sisl::io_blob{buf.bytes(), size, true /* is_aligned */});
+    req->cookie = cookie;
+    req->zero_copy_buf = std::move(buf);
+
+    write_async(req, [cb](logstore_req* req, logdev_key written_lkey) {
+        if (cb) { cb(req->seq_num, req->data, written_lkey, req->cookie); }
+        logstore_req::free(req);
+    });
+    return seq_num;
+}
+
+logstore_seq_num_t HomeLogStore::append_batch(std::span< const sisl::io_blob > blobs, void* cookie,
+                                              const log_batch_comp_cb_t& cb) {
+    HS_DBG_ASSERT_EQ(m_append_mode, true, "append_batch can be called only on append only mode");
+    HS_DBG_ASSERT(!blobs.empty(), "append_batch called with no blobs to append");
+
+    struct batch_context {
+        std::atomic< int64_t > pending;
+        logdev_key last_key;
+        log_batch_comp_cb_t cb;
+        void* cookie;
+    };
+
+    auto const n = int64_cast(blobs.size());
+    auto const start_lsn = m_next_lsn.fetch_add(n, std::memory_order_acq_rel);
+    auto const end_lsn = start_lsn + n - 1;
+    auto ctx = std::make_shared< batch_context >();
+    ctx->pending.store(n, std::memory_order_relaxed);
+    ctx->cb = cb;
+    ctx->cookie = cookie;
+
+    // Records could complete in any order, last one to complete makes the callback with the key of the last record
+    log_req_comp_cb_t const req_cb = [ctx, start_lsn, end_lsn](logstore_req* req, logdev_key ld_key) {
+        if (req->seq_num == end_lsn) { ctx->last_key = ld_key; }
+        logstore_req::free(req);
+        if (ctx->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            if (ctx->cb) { ctx->cb(start_lsn, end_lsn, ctx->last_key, ctx->cookie); }
+        }
+    };
+
+    std::vector< logstore_req* > reqs;
+    reqs.reserve(blobs.size());
+    auto const start_time = Clock::now();
+    auto const append_tsc = TscClock::now();
+    for (auto const& b : blobs) {
+        auto* req = logstore_req::make(this, start_lsn + int64_cast(reqs.size()), b);
+        req->cookie = cookie;
+        req->cb = req_cb;
+        req->start_time = start_time;
+        req->append_tsc = append_tsc;
+        m_records.create(req->seq_num);
+        HISTOGRAM_OBSERVE(m_metrics, logstore_record_size, b.size());
+        reqs.push_back(req);
+    }
+    COUNTER_INCREMENT(m_metrics, logstore_append_count, n);
+    m_logdev->append_batch(m_store_id, reqs);
+    return start_lsn;
+}
+
+uint64_t HomeLogStore::zero_copy_align_size() const { return m_logdev->get_flush_size_multiple(); }
+
 void HomeLogStore::write_and_flush(logstore_seq_num_t seq_num, const sisl::io_blob& b) {
     HS_LOG_ASSERT(iomanager.am_i_sync_io_capable(),
                   "Write and flush is a blocking IO, which can't run in this thread, please reschedule to a fiber");
@@ -111,10 +188,49 @@ log_buffer HomeLogStore::read_sync(logstore_seq_num_t seq_num) {
     const auto start_time = Clock::now();
     COUNTER_INCREMENT(m_metrics, logstore_read_count, 1);
     const auto b = m_logdev->read(ld_key);
-    HISTOGRAM_OBSERVE(m_metrics, logstore_read_latency, get_elapsed_time_us(start_time));
+    auto const read_us = get_elapsed_time_us(start_time);
+    HISTOGRAM_OBSERVE(m_metrics, logstore_read_latency, read_us);
+    PerfStats::observe(perf_op_t::JOURNAL_READ, read_us);
     return b;
 }
 
+folly::Future< std::vector< log_buffer > > HomeLogStore::async_read_range(logstore_seq_num_t start_lsn,
+                                                                          logstore_seq_num_t end_lsn) {
+    auto const s = m_records.status(start_lsn);
+    if (s.is_out_of_range || s.is_hole) {
+        return folly::makeFuture< std::vector< log_buffer > >(
+            std::out_of_range("key not valid since it has been truncated"));
+    }
+
+    std::vector< logdev_key > keys;
+    keys.reserve(end_lsn - start_lsn + 1);
+    m_records.foreach_all_completed(start_lsn, [&](int64_t cur_idx, const logstore_record& record) -> bool {
+        keys.emplace_back(record.m_dev_key);
+        return (cur_idx < end_lsn);
+    });
+
+    auto do_read = [this](const std::vector< logdev_key >& keys) {
+        auto const start_time = Clock::now();
+        COUNTER_INCREMENT(m_metrics, logstore_read_count, keys.size());
+        auto bufs = m_logdev->read_range(keys);
+        auto const read_us = get_elapsed_time_us(start_time);
+        HISTOGRAM_OBSERVE(m_metrics, logstore_read_latency, read_us);
+        PerfStats::observe(perf_op_t::JOURNAL_READ, read_us);
+        return bufs;
+    };
+
+    // Read right away if we can block here, which also lets the callers on a sync io fiber wait on the future
+    if (iomanager.am_i_sync_io_capable()) { return folly::makeFuture(do_read(keys)); }
+
+    auto p = std::make_shared< folly::Promise< std::vector< log_buffer > > >();
+    auto f = p->getFuture();
+    iomanager.run_on_forget(iomgr::reactor_regex::random_worker, iomgr::fiber_regex::syncio_only,
+                            [self = shared_from_this(), do_read, keys = std::move(keys), p]() {
+                                p->setValue(do_read(keys));
+                            });
+    return f;
+}
+
 void HomeLogStore::on_write_completion(logstore_req* req, const logdev_key& ld_key, const logdev_key& flush_ld_key) {
     // Logstore supports out-of-order lsn writes, in that case we need to mark the truncation key for this lsn as the
     // one which is being written by the higher lsn. This is to ensure that we don't truncate higher lsn's logdev_key
@@ -148,11 +264,7 @@ void HomeLogStore::on_write_completion(logstore_req* req, const logdev_key& ld_k
 
     atomic_update_max(m_next_lsn, req->seq_num + 1, std::memory_order_acq_rel);
     // Upon completion, create the mapping between seq_num and log dev key
-    m_records.update(req->seq_num, [&ld_key, &trunc_key](logstore_record& rec) -> bool {
-        rec.m_dev_key = ld_key;
-        rec.m_trunc_key = trunc_key;
-        return true;
-    });
+    m_records.complete(req->seq_num, logstore_record(ld_key, trunc_key));
 }
 
 void HomeLogStore::on_log_found(logstore_seq_num_t seq_num, const logdev_key& ld_key, const logdev_key& flush_ld_key,
@@ -205,6 +317,19 @@ void HomeLogStore::truncate(logstore_seq_num_t upto_lsn, bool in_memory_truncate
     if (!in_memory_truncate_only) { m_logdev->truncate(); }
 }
 
+void HomeLogStore::set_replay_checkpoint(logstore_seq_num_t upto_lsn) {
+    if (upto_lsn < m_start_lsn) { return; }
+    auto const s = m_records.status(upto_lsn);
+    HS_REL_ASSERT(s.is_completed && !s.is_hole, "Replay checkpoint lsn={} is not completed yet", upto_lsn);
+
+    // Replay has to start from where truncation upto this lsn would leave the logdev, so that any of the later lsns
+    // which are written before it, in case of out-of-order writes, are still replayed.
+    auto const replay_key = m_records.at(upto_lsn).m_trunc_key;
+    THIS_LOGSTORE_LOG(DEBUG, "Setting replay checkpoint upto lsn={}, replay starts from log_idx={} offset={}", upto_lsn,
+                      replay_key.idx, replay_key.dev_offset);
+    m_logdev->update_replay_checkpoint(m_store_id, upto_lsn + 1, replay_key);
+}
+
 std::tuple< logstore_seq_num_t, logdev_key, logstore_seq_num_t > HomeLogStore::truncate_info() const {
     auto const trunc_lsn = m_start_lsn.load(std::memory_order_relaxed) - 1;
     return std::make_tuple(trunc_lsn, m_trunc_ld_key, m_tail_lsn.load(std::memory_order_relaxed));
@@ -227,7 +352,7 @@ nlohmann::json HomeLogStore::dump_log_store(const log_dump_req& dump_req) {
     // must use move operator= operation instead of move copy constructor
     nlohmann::json json_records = nlohmann::json::array();
     m_records.foreach_all_completed(
-        start_idx, [this, &dump_req, &json_records](int64_t, homestore::logstore_record const& rec) -> bool {
+        start_idx, [this, &dump_req, &json_records](int64_t, const homestore::logstore_record& rec) -> bool {
             nlohmann::json json_val = nlohmann::json::object();
             serialized_log_record record_header;
 
@@ -237,6 +362,7 @@ nlohmann::json HomeLogStore::dump_log_store(const log_dump_req& dump_req) {
                 json_val["size"] = uint32_cast(record_header.size);
                 json_val["offset"] = uint32_cast(record_header.offset);
                 json_val["is_inlined"] = uint32_cast(record_header.get_inlined());
+                json_val["is_compressed"] = uint32_cast(record_header.get_compressed());
                 json_val["lsn"] = uint64_cast(record_header.store_seq_num);
                 json_val["store_id"] = s_cast< logstore_id_t >(record_header.store_id);
             } catch (const std::exception& ex) { THIS_LOGSTORE_LOG(ERROR, "Exception in json dump- {}", ex.what()); }
@@ -256,7 +382,7 @@ nlohmann::json HomeLogStore::dump_log_store(const log_dump_req& dump_req) {
 }
 
 void HomeLogStore::foreach (int64_t start_idx, const std::function< bool(logstore_seq_num_t, log_buffer) >& cb) {
-    m_records.foreach_all_completed(start_idx, [&](int64_t cur_idx, homestore::logstore_record& record) -> bool {
+    m_records.foreach_all_completed(start_idx, [&](int64_t cur_idx, const logstore_record& record) -> bool {
         auto log_buf = m_logdev->read(record.m_dev_key);
         return cb(cur_idx, log_buf);
     });
@@ -280,7 +406,7 @@ void HomeLogStore::flush(logstore_seq_num_t upto_lsn) {
     if (upto_lsn == invalid_lsn()) { upto_lsn = m_records.active_upto(); }
 
     // if we have flushed already, we are done, else issue a flush
-    if (m_records.status(upto_lsn).is_active) m_logdev->flush_under_guard();
+    if (m_records.completed_upto() < upto_lsn) m_logdev->flush_under_guard();
 }
 
 bool HomeLogStore::rollback(logstore_seq_num_t to_lsn) {
@@ -337,12 +463,13 @@ nlohmann::json HomeLogStore::get_status(int verbosity) const {
     js["tail_lsn"] = m_tail_lsn.load(std::memory_order_relaxed);
     js["logstore_records"] = m_records.get_status(verbosity);
     js["logstore_sb_first_lsn"] = m_logdev->log_dev_meta().store_superblk(m_store_id).m_first_seq_num;
+    js["logstore_sb_replay_start_lsn"] = m_logdev->log_dev_meta().store_superblk(m_store_id).m_replay_start_lsn;
     return js;
 }
 
 logstore_superblk logstore_superblk::default_value() { return logstore_superblk{-1}; }
-void logstore_superblk::init(logstore_superblk& meta) { meta.m_first_seq_num = 0; }
-void logstore_superblk::clear(logstore_superblk& meta) { meta.m_first_seq_num = -1; }
+void logstore_superblk::init(logstore_superblk& meta) { meta = logstore_superblk{0}; }
+void logstore_superblk::clear(logstore_superblk& meta) { meta = logstore_superblk{-1}; }
 bool logstore_superblk::is_valid(const logstore_superblk& meta) { return meta.m_first_seq_num >= 0; }
 
 } // namespace homestore
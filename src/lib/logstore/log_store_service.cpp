@@ -13,8 +13,10 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <chrono>
 #include <iterator>
 #include <string>
+#include <thread>
 
 #include <fmt/format.h>
 #include <iomgr/iomgr.hpp>
@@ -26,7 +28,9 @@
 #include "device/chunk.h"
 
 #include "common/homestore_assert.hpp"
+#include "common/homestore_config.hpp"
 #include "common/homestore_status_mgr.hpp"
+#include "common/thread_placement.hpp"
 #include "device/journal_vdev.hpp"
 #include "device/physical_dev.hpp"
 #include "log_dev.hpp"
@@ -92,7 +96,8 @@ folly::Future< std::error_code > LogStoreService::create_vdev(uint64_t size, HSD
                                                         .alloc_type = blk_allocator_type_t::none,
                                                         .chunk_sel_type = chunk_selector_type_t::ROUND_ROBIN,
                                                         .multi_pdev_opts = vdev_multi_pdev_opts_t::ALL_PDEV_STRIPED,
-                                                        .context_data = hs_ctx.to_blob()});
+                                                        .context_data = hs_ctx.to_blob(),
+                                                        .placement = vdev_placement_t::JOURNAL});
 
     return vdev->async_format();
 }
@@ -101,10 +106,11 @@ std::shared_ptr< VirtualDev > LogStoreService::open_vdev(const vdev_info& vinfo,
     RELEASE_ASSERT(m_logdev_vdev == nullptr, "Duplicate journal vdev");
     auto vdev = std::make_shared< JournalVirtualDev >(*(hs()->device_mgr()), vinfo, nullptr);
     m_logdev_vdev = std::dynamic_pointer_cast< JournalVirtualDev >(vdev);
+    if (HS_DYNAMIC_CONFIG(device->journal_vdev_uring)) { m_logdev_vdev->enable_uring(); }
     return vdev;
 }
 
-void LogStoreService::start(bool format) {
+void LogStoreService::start(bool format, bool lazy_recovery) {
     // hs()->status_mgr()->register_status_cb("LogStore", bind_this(LogStoreService::get_status, 1));
     if (format) {
         m_sb.create(sizeof(logstore_service_super_block));
@@ -112,22 +118,135 @@ void LogStoreService::start(bool format) {
     }
 
     // Create an truncate thread loop which handles truncation which does sync IO
-    start_threads();
+    if (!m_threads_started) { start_threads(); }
+
+    if (lazy_recovery && !format) {
+        size_t npending{0};
+        {
+            std::lock_guard lg{m_pending_mtx};
+            for (auto& [logdev_id, logdev] : m_id_logdev_map) {
+                if (m_started_logdevs.contains(logdev_id)) { continue; }
+                m_pending_logdevs.emplace(logdev_id, std::make_shared< std::once_flag >());
+            }
+            npending = m_pending_logdevs.size();
+        }
+        if (npending != 0) {
+            HS_LOG(INFO, logstore, "Deferring the recovery of {} log_devs to the background or their first access",
+                   npending);
+            m_lazy_recovery_running = true;
+            iomanager.run_on_forget(iomgr::reactor_regex::random_worker, iomgr::fiber_regex::syncio_only,
+                                    [this]() { recover_pending_logdevs(); });
+        }
+        return;
+    }
 
     for (auto& [logdev_id, logdev] : m_id_logdev_map) {
+        if (m_started_logdevs.contains(logdev_id)) { continue; }
         logdev->start(format, m_logdev_vdev);
     }
 }
 
+void LogStoreService::start_logdev(logdev_id_t logdev_id) {
+    // Logdev needs the flush threads right away, start of the service reuses them
+    if (!m_threads_started) { start_threads(); }
+
+    std::shared_ptr< LogDev > logdev;
+    {
+        folly::SharedMutexWritePriority::WriteHolder holder(m_logdev_map_mtx);
+        logdev = m_id_logdev_map.at(logdev_id);
+        if (!m_started_logdevs.insert(logdev_id).second) { return; }
+    }
+    auto const start_time = Clock::now();
+    logdev->start(false /* format */, m_logdev_vdev);
+    HS_LOG(INFO, logstore, "Started log_dev={} ahead of the service in {} ms", logdev_id,
+           get_elapsed_time_ms(start_time));
+}
+
 void LogStoreService::stop() {
+    // Logdev being replayed by the lazy recovery is let to complete, the rest are never started
+    m_stopping = true;
+    while (m_lazy_recovery_running.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
     // device_truncate(nullptr, true, false);
     for (auto& [id, logdev] : m_id_logdev_map) {
+        if (is_pending(id)) { continue; }
         logdev->stop();
     }
     {
         folly::SharedMutexWritePriority::WriteHolder holder(m_logdev_map_mtx);
         m_id_logdev_map.clear();
     }
+    {
+        std::lock_guard lg{m_pending_mtx};
+        m_pending_logdevs.clear();
+    }
+    m_started_logdevs.clear();
+    m_threads_started = false;
+    m_stopping = false;
+}
+
+void LogStoreService::recover_pending_logdevs() {
+    while (!m_stopping.load()) {
+        logdev_id_t logdev_id;
+        {
+            std::lock_guard lg{m_pending_mtx};
+            if (m_pending_logdevs.empty()) { break; }
+            logdev_id = m_pending_logdevs.begin()->first;
+        }
+        recover_logdev(logdev_id);
+    }
+    m_lazy_recovery_running = false;
+}
+
+void LogStoreService::recover_logdev(logdev_id_t logdev_id) {
+    std::shared_ptr< std::once_flag > flag;
+    {
+        std::lock_guard lg{m_pending_mtx};
+        auto const it = m_pending_logdevs.find(logdev_id);
+        if (it == m_pending_logdevs.end()) { return; }
+        flag = it->second;
+    }
+
+    std::call_once(*flag, [this, logdev_id]() {
+        std::shared_ptr< LogDev > logdev;
+        {
+            folly::SharedMutexWritePriority::ReadHolder holder(m_logdev_map_mtx);
+            logdev = m_id_logdev_map.at(logdev_id);
+        }
+        auto const start_time = Clock::now();
+        logdev->start(false /* format */, m_logdev_vdev);
+        HS_LOG(INFO, logstore, "Lazily recovered log_dev={} in {} ms", logdev_id, get_elapsed_time_ms(start_time));
+    });
+
+    std::lock_guard lg{m_pending_mtx};
+    m_pending_logdevs.erase(logdev_id);
+}
+
+void LogStoreService::recover_all_logdevs() {
+    while (true) {
+        logdev_id_t logdev_id;
+        {
+            std::lock_guard lg{m_pending_mtx};
+            if (m_pending_logdevs.empty()) { break; }
+            logdev_id = m_pending_logdevs.begin()->first;
+        }
+        recover_logdev(logdev_id);
+    }
+    while (m_lazy_recovery_running.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+bool LogStoreService::is_pending(logdev_id_t logdev_id) const {
+    std::lock_guard lg{m_pending_mtx};
+    return m_pending_logdevs.find(logdev_id) != m_pending_logdevs.end();
+}
+
+size_t LogStoreService::num_pending_logdevs() const {
+    std::lock_guard lg{m_pending_mtx};
+    return m_pending_logdevs.size();
 }
 
 logdev_id_t LogStoreService::get_next_logdev_id() {
@@ -147,6 +266,7 @@ logdev_id_t LogStoreService::create_new_logdev() {
 }
 
 void LogStoreService::destroy_log_dev(logdev_id_t logdev_id) {
+    recover_logdev(logdev_id);
     folly::SharedMutexWritePriority::WriteHolder holder(m_logdev_map_mtx);
     const auto it = m_id_logdev_map.find(logdev_id);
     if (it == m_id_logdev_map.end()) {
@@ -200,16 +320,19 @@ void LogStoreService::open_logdev(logdev_id_t logdev_id) {
     HS_LOG(INFO, logstore, "Opened log_dev={}", logdev_id);
 }
 
+// Logdevs pending lazy recovery are not included
 std::vector< std::shared_ptr< LogDev > > LogStoreService::get_all_logdevs() {
     folly::SharedMutexWritePriority::ReadHolder holder(m_logdev_map_mtx);
     std::vector< std::shared_ptr< LogDev > > res;
     for (auto& [id, logdev] : m_id_logdev_map) {
+        if (is_pending(id)) { continue; }
         res.push_back(logdev);
     }
     return res;
 }
 
 std::shared_ptr< LogDev > LogStoreService::get_logdev(logdev_id_t id) {
+    recover_logdev(id);
     folly::SharedMutexWritePriority::ReadHolder holder(m_logdev_map_mtx);
     const auto it = m_id_logdev_map.find(id);
     HS_REL_ASSERT((it != m_id_logdev_map.end()), "logdev id {} doesnt exists", id);
@@ -265,6 +388,7 @@ void LogStoreService::rollback_super_blk_found(const sisl::byte_view& buf, void*
 }
 
 std::shared_ptr< HomeLogStore > LogStoreService::create_new_log_store(logdev_id_t logdev_id, bool append_mode) {
+    recover_logdev(logdev_id);
     folly::SharedMutexWritePriority::WriteHolder holder(m_logdev_map_mtx);
     COUNTER_INCREMENT(m_metrics, logstores_count, 1);
     const auto it = m_id_logdev_map.find(logdev_id);
@@ -274,14 +398,23 @@ std::shared_ptr< HomeLogStore > LogStoreService::create_new_log_store(logdev_id_
 
 folly::Future< shared< HomeLogStore > > LogStoreService::open_log_store(logdev_id_t logdev_id, logstore_id_t store_id,
                                                                         bool append_mode) {
-    folly::SharedMutexWritePriority::ReadHolder holder(m_logdev_map_mtx);
-    const auto it = m_id_logdev_map.find(logdev_id);
-    HS_REL_ASSERT((it != m_id_logdev_map.end()), "logdev id {} doesnt exist", logdev_id);
+    std::shared_ptr< LogDev > logdev;
+    {
+        folly::SharedMutexWritePriority::ReadHolder holder(m_logdev_map_mtx);
+        const auto it = m_id_logdev_map.find(logdev_id);
+        HS_REL_ASSERT((it != m_id_logdev_map.end()), "logdev id {} doesnt exist", logdev_id);
+        logdev = it->second;
+    }
     COUNTER_INCREMENT(m_metrics, logstores_count, 1);
-    return it->second->open_log_store(store_id, append_mode);
+    auto f = logdev->open_log_store(store_id, append_mode);
+
+    // Opening a store of a logdev pending lazy recovery is an access to it, so it is replayed right away
+    recover_logdev(logdev_id);
+    return f;
 }
 
 void LogStoreService::remove_log_store(logdev_id_t logdev_id, logstore_id_t store_id) {
+    recover_logdev(logdev_id);
     folly::SharedMutexWritePriority::WriteHolder holder(m_logdev_map_mtx);
     COUNTER_INCREMENT(m_metrics, logstores_count, 1);
     const auto it = m_id_logdev_map.find(logdev_id);
@@ -292,12 +425,15 @@ void LogStoreService::remove_log_store(logdev_id_t logdev_id, logstore_id_t stor
 
 void LogStoreService::device_truncate() {
     // TODO: make device_truncate_under_lock return future and do collectAllFutures;
-    for (auto& [id, logdev] : m_id_logdev_map)
+    for (auto& [id, logdev] : m_id_logdev_map) {
+        if (is_pending(id)) { continue; }
         logdev->truncate();
+    }
 }
 
 void LogStoreService::flush() {
     for (auto& [id, logdev] : m_id_logdev_map) {
+        if (is_pending(id)) { continue; }
         logdev->flush_under_guard();
     }
 }
@@ -310,28 +446,39 @@ void LogStoreService::start_threads() {
     };
     auto ctx = std::make_shared< Context >();
 
-    m_flush_fiber = nullptr;
-    iomanager.create_reactor("log_flush_thread", iomgr::TIGHT_LOOP | iomgr::ADAPTIVE_LOOP, 1 /* num_fibers */,
-                             [this, ctx](bool is_started) {
-                                 if (is_started) {
-                                     m_flush_fiber = iomanager.iofiber_self();
-                                     {
-                                         std::unique_lock< std::mutex > lk{ctx->mtx};
-                                         ++(ctx->thread_cnt);
+    m_threads_started = true;
+    auto const nthreads = std::max(HS_DYNAMIC_CONFIG(logstore.flush_threads), 1u);
+    m_flush_fibers.assign(nthreads, nullptr);
+    for (uint32_t i{0}; i < nthreads; ++i) {
+        iomanager.create_reactor("log_flush_thread" + std::to_string(i), iomgr::TIGHT_LOOP | iomgr::ADAPTIVE_LOOP,
+                                 1 /* num_fibers */, [this, ctx, i](bool is_started) {
+                                     if (is_started) {
+                                         ThreadPlacement::bind_self(hs_thread_role_t::LOG_FLUSH);
+                                         m_flush_fibers[i] = iomanager.iofiber_self();
+                                         {
+                                             std::unique_lock< std::mutex > lk{ctx->mtx};
+                                             ++(ctx->thread_cnt);
+                                         }
+                                         ctx->cv.notify_one();
                                      }
-                                     ctx->cv.notify_one();
-                                 }
-                             });
+                                 });
+    }
     {
         std::unique_lock< std::mutex > lk{ctx->mtx};
-        ctx->cv.wait(lk, [ctx] { return (ctx->thread_cnt == 1); });
+        ctx->cv.wait(lk, [ctx, nthreads] { return (ctx->thread_cnt == nthreads); });
     }
 }
 
+void LogStoreService::pin_logdev_flush(logdev_id_t logdev_id, iomgr::io_fiber_t fiber) {
+    get_logdev(logdev_id)->set_flush_fiber(fiber);
+    HS_LOG(INFO, logstore, "Flushes of log_dev={} are {}", logdev_id, fiber ? "pinned" : "unpinned");
+}
+
 nlohmann::json LogStoreService::dump_log_store(const log_dump_req& dump_req) {
     nlohmann::json json_dump{}; // create root object
     if (dump_req.log_store == nullptr) {
         for (auto& [id, logdev] : m_id_logdev_map) {
+            if (is_pending(id)) { continue; }
             json_dump[logdev->get_id()] = logdev->dump_log_store(dump_req);
         }
     } else {
@@ -345,7 +492,10 @@ nlohmann::json LogStoreService::dump_log_store(const log_dump_req& dump_req) {
 
 nlohmann::json LogStoreService::get_status(const int verbosity) const {
     nlohmann::json js;
+    js["num_flush_threads"] = m_flush_fibers.size();
+    js["num_pending_logdevs"] = num_pending_logdevs();
     for (auto& [id, logdev] : m_id_logdev_map) {
+        if (is_pending(id)) { continue; }
         js[logdev->get_id()] = logdev->get_status(verbosity);
     }
     return js;
@@ -362,6 +512,13 @@ LogStoreServiceMetrics::LogStoreServiceMetrics() : sisl::MetricsGroup("LogStores
                      {"op", "write"});
     REGISTER_COUNTER(logstore_read_count, "Total number of read requests to log stores", "logstore_op_count",
                      {"op", "read"});
+    REGISTER_COUNTER(logdev_range_read_count, "Total number of device reads done to read ranges of log records");
+    REGISTER_COUNTER(logdev_packed_group_count, "Total number of log groups packed after the previous group");
+    REGISTER_COUNTER(logdev_tail_cache_hit_count, "Total number of log reads served by the tail cache of logdevs");
+    REGISTER_COUNTER(logdev_flush_leader_count, "Total number of flushes led by appenders", "logdev_group_commit_count",
+                     {"role", "leader"});
+    REGISTER_COUNTER(logdev_flush_follower_count, "Total number of appenders which followed an inflight flush",
+                     "logdev_group_commit_count", {"role", "follower"});
     REGISTER_HISTOGRAM(logstore_append_latency, "Logstore append latency", "logstore_op_latency", {"op", "write"});
     REGISTER_HISTOGRAM(logstore_read_latency, "Logstore read latency", "logstore_op_latency", {"op", "read"});
     REGISTER_HISTOGRAM(logdev_flush_size_distribution, "Distribution of flush data size",
@@ -375,6 +532,17 @@ LogStoreServiceMetrics::LogStoreServiceMetrics() : sisl::MetricsGroup("LogStores
                        "Logdev post flush processing (including callbacks) latency");
     REGISTER_HISTOGRAM(logdev_flush_time_us, "time elapsed since last flush time in us");
     REGISTER_HISTOGRAM(logdev_fsync_time_us, "Logdev fsync completion time in us");
+    REGISTER_HISTOGRAM(logdev_adaptive_batch_size, "Log group size chosen by adaptive flush",
+                       HistogramBucketsType(ExponentialOfTwoBuckets));
+    REGISTER_HISTOGRAM(logdev_append_wait_flush_us, "Time from the append of a record till its log group is prepared",
+                       "logdev_append_stage_latency", {"stage", "wait_flush"});
+    REGISTER_HISTOGRAM(logdev_group_prepare_us, "Time from the start of prepare of a log group till its write submit",
+                       "logdev_append_stage_latency", {"stage", "prepare"});
+    REGISTER_HISTOGRAM(logdev_group_write_us, "Time from the submit of the write of a log group till it is written",
+                       "logdev_append_stage_latency", {"stage", "write"});
+    REGISTER_HISTOGRAM(logdev_completion_cb_us, "Time from the completion of the write of a record till its callback",
+                       "logdev_append_stage_latency", {"stage", "callback"});
+    REGISTER_HISTOGRAM(logdev_adaptive_linger_us, "Time to wait for more logs chosen by adaptive flush in us");
 
     register_me_to_farm();
 }
@@ -24,19 +24,27 @@ namespace homestore {
 SISL_LOGGING_DECL(logstore)
 
 log_stream_reader::log_stream_reader(off_t device_cursor, shared< JournalVirtualDev > vdev,
-                                     shared< JournalVirtualDev::Descriptor > vdev_jd, uint64_t read_size_multiple) :
+                                     shared< JournalVirtualDev::Descriptor > vdev_jd, uint64_t read_size_multiple,
+                                     bool verify_crc) :
         m_vdev{vdev},
         m_vdev_jd{std::move(vdev_jd)},
         m_first_group_cursor{device_cursor},
-        m_read_size_multiple{read_size_multiple} {
-    // We set the journal descriptor seek_cursor here so that
-    // sync_next_read reads from the seek_cursor.
-    m_vdev_jd->lseek(m_first_group_cursor);
+        m_read_size_multiple{read_size_multiple},
+        m_verify_crc{verify_crc},
+        m_read_ahead{m_vdev_jd,
+                     uint64_cast(sisl::round_up(HS_DYNAMIC_CONFIG(logstore.bulk_read_size), read_size_multiple)),
+                     vdev->align_size()} {
+    // We set the journal descriptor seek_cursor here so that sync_next_read reads from the seek_cursor. First group
+    // could be packed in the middle of a page, in which case reads start from the start of its page.
+    auto const page_start = off_t(sisl::round_down(uint64_cast(m_first_group_cursor), m_read_size_multiple));
+    m_skip_bytes = uint64_cast(m_first_group_cursor - page_start);
+    m_vdev_jd->lseek(page_start);
+
+    // Cursor could be ahead of the start offset, if the replay is resumed from a checkpoint
+    m_cur_read_bytes = m_vdev_jd->data_bytes_upto(m_first_group_cursor);
 }
 
 sisl::byte_view log_stream_reader::next_group(off_t* out_dev_offset) {
-    const uint64_t bulk_read_size =
-        uint64_cast(sisl::round_up(HS_DYNAMIC_CONFIG(logstore.bulk_read_size), m_read_size_multiple));
     uint64_t min_needed{m_read_size_multiple};
     sisl::byte_view ret_buf;
     *out_dev_offset = m_vdev_jd->dev_offset(m_cur_read_bytes);
@@ -45,11 +53,16 @@ read_again:
     if (m_cur_log_buf.size() < min_needed) {
         do {
             bool end_of_stream{false};
-            m_cur_log_buf = read_next_bytes(std::max(min_needed, bulk_read_size), end_of_stream);
+            m_cur_log_buf = read_next_bytes(end_of_stream);
             if (end_of_stream) {
                 LOGDEBUGMOD(logstore, "Logdev reached end of stream {} {}", m_vdev_jd->to_string(), m_cur_read_bytes);
                 return ret_buf;
             }
+            if (m_skip_bytes != 0) {
+                auto const n = std::min(m_skip_bytes, uint64_cast(m_cur_log_buf.size()));
+                m_cur_log_buf.move_forward(n);
+                m_skip_bytes -= n;
+            }
             if (m_cur_log_buf.size() == 0) {
                 LOGDEBUGMOD(logstore, "Logdev data empty {}", m_vdev_jd->logdev_id());
                 continue;
@@ -58,9 +71,20 @@ read_again:
         min_needed = 0;
     }
 
-    HS_REL_ASSERT_GE(m_cur_log_buf.size(), m_read_size_multiple);
+    HS_REL_ASSERT_GE(m_cur_log_buf.size(), sizeof(log_group_header));
     const auto* header = r_cast< log_group_header const* >(m_cur_log_buf.bytes());
     if (header->magic_word() != LOG_GROUP_HDR_MAGIC) {
+        auto const skew = uint64_cast(m_vdev_jd->dev_offset(m_cur_read_bytes)) % m_read_size_multiple;
+        if (skew != 0) {
+            // Group before is packed and followed by zeros upto the end of its page, next group is in the next page
+            auto const pad = m_read_size_multiple - skew;
+            auto const n = std::min(pad, uint64_cast(m_cur_log_buf.size()));
+            m_cur_log_buf.move_forward(n);
+            m_skip_bytes = pad - n;
+            m_cur_read_bytes += pad;
+            min_needed = m_read_size_multiple;
+            goto read_again;
+        }
         LOGDEBUGMOD(logstore, "Logdev data not seeing magic at pos {}, must have come to end of log_dev={}",
                     m_vdev_jd->dev_offset(m_cur_read_bytes), m_vdev_jd->logdev_id());
         *out_dev_offset = m_vdev_jd->dev_offset(m_cur_read_bytes);
@@ -131,11 +155,9 @@ read_again:
 
     HS_DBG_ASSERT_EQ(footer->version, log_group_footer::footer_version, "Log footer version mismatch");
 
-    // verify crc with data
-    const crc32_t cur_crc =
-        crc32_ieee(init_crc32, s_cast< const uint8_t* >(m_cur_log_buf.bytes()) + sizeof(log_group_header),
-                   (header->total_size() - sizeof(log_group_header)));
-    if (cur_crc != header->cur_grp_crc) {
+    // verify crc with data, unless the caller validates it later. Chaining of the groups is still validated with the
+    // crc in the header, which is what the next group carries anyways
+    if (m_verify_crc && !is_group_crc_valid(m_cur_log_buf)) {
         /* This is a valid entry so crc should match */
         LOGERROR("crc doesn't match {} log_dev={}", m_vdev_jd->dev_offset(m_cur_read_bytes), m_vdev_jd->logdev_id());
         HS_REL_ASSERT(0, "data is corrupted {}", m_vdev_jd->logdev_id());
@@ -148,7 +170,7 @@ read_again:
     }
 
     // store cur crc in prev crc
-    m_prev_crc = cur_crc;
+    m_prev_crc = header->cur_grp_crc;
 
     ret_buf = m_cur_log_buf;
     *out_dev_offset = m_vdev_jd->dev_offset(m_cur_read_bytes);
@@ -158,33 +180,27 @@ read_again:
     return ret_buf;
 }
 
+bool log_stream_reader::is_group_crc_valid(const sisl::byte_view& group_buf) {
+    const auto* header = r_cast< log_group_header const* >(group_buf.bytes());
+    const crc32_t cur_crc = log_group_header::data_crc(
+        header->get_version(), init_crc32, s_cast< const uint8_t* >(group_buf.bytes()) + sizeof(log_group_header),
+        (header->total_size() - sizeof(log_group_header)));
+    return (cur_crc == header->cur_grp_crc);
+}
+
 sisl::byte_view log_stream_reader::group_in_next_page() {
     off_t dev_offset;
     if (m_cur_log_buf.size() > m_read_size_multiple) { m_cur_log_buf.move_forward(m_read_size_multiple); }
     return next_group(&dev_offset);
 }
 
-sisl::byte_view log_stream_reader::read_next_bytes(uint64_t nbytes, bool& end_of_stream) {
-    // TODO: Might need to address alignment based on data or fast type
+sisl::byte_view log_stream_reader::read_next_bytes(bool& end_of_stream) {
+    // Bytes are read ahead of their consumption, a group bigger than the read size accumulates over multiple calls
     const auto prev_pos = m_vdev_jd->seeked_pos();
-    auto sz_to_read = m_vdev_jd->sync_next_read(nullptr, nbytes);
-    if (sz_to_read == -1) {
-        end_of_stream = true;
-        return sisl::byte_view{m_cur_log_buf};
-    }
-
-    if (sz_to_read == 0) { return sisl::byte_view{m_cur_log_buf}; }
-
-    auto out_buf =
-        hs_utils::make_byte_array(sz_to_read + m_cur_log_buf.size(), true, sisl::buftag::logread, m_vdev->align_size());
-    if (m_cur_log_buf.size()) { memcpy(out_buf->bytes(), m_cur_log_buf.bytes(), m_cur_log_buf.size()); }
-
-    auto sz_read = m_vdev_jd->sync_next_read(out_buf->bytes() + m_cur_log_buf.size(), sz_to_read);
-    assert(sz_read == sz_to_read);
+    auto out_buf = m_read_ahead.next(m_cur_log_buf, end_of_stream);
 
-    LOGTRACEMOD(logstore,
-                "LogStream read {} bytes req bytes {} from vdev prev offset {} and vdev cur offset {} log_dev={}",
-                sz_read, nbytes, prev_pos, m_vdev_jd->seeked_pos(), m_vdev_jd->logdev_id());
-    return sisl::byte_view{out_buf};
+    LOGTRACEMOD(logstore, "LogStream read {} bytes from vdev prev offset {} and vdev cur offset {} log_dev={}",
+                out_buf.size() - m_cur_log_buf.size(), prev_pos, m_vdev_jd->seeked_pos(), m_vdev_jd->logdev_id());
+    return out_buf;
 }
 } // namespace homestore
@@ -13,14 +13,21 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <iterator>
 #include <filesystem>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <numeric>
 #include <system_error>
+#include <thread>
+#include <lz4.h>
+#include <lz4hc.h>
 
 #include <sisl/fds/compress.hpp>
 #include <sisl/fds/utils.hpp>
@@ -61,7 +68,8 @@ void MetaBlkService::create_vdev(uint64_t size, HSDevType devType, uint32_t num_
                                                     .alloc_type = blk_allocator_type_t::varsize,
                                                     .chunk_sel_type = chunk_selector_type_t::ROUND_ROBIN,
                                                     .multi_pdev_opts = vdev_multi_pdev_opts_t::ALL_PDEV_STRIPED,
-                                                    .context_data = meta_ctx.to_blob()});
+                                                    .context_data = meta_ctx.to_blob(),
+                                                    .placement = vdev_placement_t::META});
 }
 
 shared< VirtualDev > MetaBlkService::open_vdev(const vdev_info& vinfo, bool load_existing) {
@@ -100,11 +108,37 @@ void MetaBlkService::start(bool need_format) {
     } else {
         load_ssb();
         scan_meta_blks();
+        load_journal();
     }
     recover();
+
+    auto const coalesce_ms = HS_DYNAMIC_CONFIG(metablk.sb_coalesce_interval_ms);
+    if (coalesce_ms != 0) {
+        m_deferred_flush_timer_hdl = iomanager.schedule_global_timer(
+            coalesce_ms * 1000ul * 1000ul, true /* recurring */, nullptr /* cookie */, iomgr::reactor_regex::all_worker,
+            [this](void*) { schedule_deferred_flush(); }, true /* wait_to_schedule */);
+    }
 }
 
 void MetaBlkService::stop() {
+    if (m_deferred_flush_timer_hdl != iomgr::null_timer_handle) {
+        iomanager.cancel_timer(m_deferred_flush_timer_hdl, true /* wait */);
+        m_deferred_flush_timer_hdl = iomgr::null_timer_handle;
+    }
+    while (m_deferred_flush_scheduled.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    flush_deferred_updates();
+
+    // Async updates in progress refer to the cached meta blks, so let them complete first
+    while (true) {
+        {
+            std::lock_guard lg{m_async_mtx};
+            if (m_async_updates.empty()) { break; }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
     {
         std::lock_guard< decltype(m_shutdown_mtx) > lg_shutdown{m_shutdown_mtx};
         cache_clear();
@@ -131,6 +165,8 @@ void MetaBlkService::cache_clear() {
 
     m_meta_blks.clear();
     m_ovf_blk_hdrs.clear();
+    clear_read_cache();
+    reset_journal();
 }
 
 void MetaBlkService::read(const BlkId& bid, uint8_t* dest, size_t sz) const {
@@ -229,14 +265,37 @@ bool MetaBlkService::scan_and_load_meta_blks(meta_blk_map_t& meta_blks, ovf_hdr_
     auto bid = m_ssb->next_bid;
     auto prev_meta_bid = m_ssb->bid;
     auto self_recover{false};
+    auto const scan_start = Clock::now();
+
+    // Meta blks are mostly allocated next to each other, so the chain is read in windows of contiguous blks, to not
+    // pay a sync read for each meta blk
+    auto const readahead_blks = std::clamp(HS_DYNAMIC_CONFIG(metablk.scan_readahead_blks), 1u,
+                                           uint32_cast(std::numeric_limits< blk_count_t >::max()));
+    auto* window = hs_utils::iobuf_alloc(readahead_blks * block_size(), sisl::buftag::metablk, align_size());
+    BlkId window_bid;
+    auto const chunks = m_sb_vdev->get_chunks();
+
+    // Overflow chains of the meta blks are loaded once the meta blk chain is walked, all chains concurrently
+    std::vector< std::pair< meta_blk*, uint64_t /* read_sz */ > > ovf_chains;
 
     while (bid.is_valid()) {
         *last_mblk_id = bid;
 
+        if (!window_bid.is_valid() || (bid.chunk_num() != window_bid.chunk_num()) ||
+            (bid.blk_num() < window_bid.blk_num()) ||
+            (bid.blk_num() >= window_bid.blk_num() + window_bid.blk_count())) {
+            auto const chunk_blks = chunks.at(bid.chunk_num())->size() / block_size();
+            auto const nblks = std::min(uint64_cast(readahead_blks), chunk_blks - bid.blk_num());
+            window_bid = BlkId{bid.blk_num(), static_cast< blk_count_t >(nblks), bid.chunk_num()};
+            read(window_bid, window, nblks * block_size());
+            COUNTER_INCREMENT(m_metrics, meta_scan_reads, 1);
+        }
+
         // TODO: add a new API in blkstore read to by pass cache;
         // e.g. take caller's read buf to avoid this extra memory copy;
         auto* mblk = r_cast< meta_blk* >(hs_utils::iobuf_alloc(block_size(), sisl::buftag::metablk, align_size()));
-        read(bid, uintptr_cast(mblk), block_size());
+        std::memcpy(uintptr_cast(mblk), window + (bid.blk_num() - window_bid.blk_num()) * block_size(),
+                    block_size());
 
         // add meta blk to cache;
         meta_blks[bid.to_integer()] = mblk;
@@ -275,7 +334,7 @@ bool MetaBlkService::scan_and_load_meta_blks(meta_blk_map_t& meta_blks, ovf_hdr_
                          META_BLK_MAGIC);
 
         // verify version
-        HS_REL_ASSERT_EQ(uint32_cast(mblk->hdr.h.version), META_BLK_VERSION,
+        HS_REL_ASSERT_LE(uint32_cast(mblk->hdr.h.version), META_BLK_VERSION,
                          "[type={}], version mismatch: found: {}, expected: {}", mblk->hdr.h.type, mblk->hdr.h.version,
                          META_BLK_VERSION);
 
@@ -291,71 +350,131 @@ bool MetaBlkService::scan_and_load_meta_blks(meta_blk_map_t& meta_blks, ovf_hdr_
         }
 #endif
 
-        while (obid.is_valid()) {
-            // ovf blk header occupies whole blk;
-            auto* ovf_hdr =
-                r_cast< meta_blk_ovf_hdr* >(hs_utils::iobuf_alloc(block_size(), sisl::buftag::metablk, align_size()));
-            read(obid, uintptr_cast(ovf_hdr), block_size());
+        if (obid.is_valid()) {
+            ovf_chains.emplace_back(mblk, read_sz);
+        } else {
+            verify_context_sz(mblk, read_sz);
+        }
 
-            // verify self bid
-            HS_REL_ASSERT_EQ(ovf_hdr->h.bid.to_integer(), obid.to_integer(), "Corrupted self-bid: {}/{}",
-                             ovf_hdr->h.bid.to_string(), obid.to_string());
-            // verify magic
-            HS_REL_ASSERT_EQ(ovf_hdr->h.magic, META_BLK_OVF_MAGIC, "Ovf blk magic corrupted: {}, expected: {}",
-                             ovf_hdr->h.magic, META_BLK_OVF_MAGIC);
+        // move on to next meta blk;
+        bid = mblk->hdr.h.next_bid;
+    }
+    hs_utils::iobuf_free(window, sisl::buftag::metablk);
 
-            read_sz += ovf_hdr->h.context_sz;
+    load_ovf_blk_chains(ovf_chains, ovf_blk_hdrs);
+    for (auto const& [mblk, read_sz] : ovf_chains) {
+        verify_context_sz(mblk, read_sz);
+    }
 
-            // add to ovf blk cache
-            ovf_blk_hdrs[obid.to_integer()] = ovf_hdr;
+    HS_LOG(INFO, metablk, "Scanned {} meta blks with {} overflow chains in {} ms", meta_blks.size(), ovf_chains.size(),
+           get_elapsed_time_ms(scan_start));
+    return self_recover;
+}
 
-            // allocate overflow bid;
-            auto alloc_status = m_sb_vdev->commit_blk(obid);
-            if (alloc_status != BlkAllocStatus::SUCCESS) HS_REL_ASSERT(0, "Failed to commit blk: {}", bid.to_string());
+void MetaBlkService::load_ovf_blk_chains(std::vector< std::pair< meta_blk*, uint64_t > >& chains,
+                                         ovf_hdr_map_t& ovf_blk_hdrs) {
+    // Chains are walked in lock step, reading the next ovf blk of up to scan_ovf_concurrency chains in each batch
+    auto const concurrency = std::max(HS_DYNAMIC_CONFIG(metablk.scan_ovf_concurrency), 1u);
+    std::vector< BlkId > obids;
+    obids.reserve(chains.size());
+    for (auto const& [mblk, _] : chains) {
+        obids.push_back(mblk->hdr.h.ovf_bid);
+    }
 
-            // allocate data bid
-            auto* data_bid = ovf_hdr->get_data_bid();
-            for (decltype(ovf_hdr->h.nbids) i{0}; i < ovf_hdr->h.nbids; ++i) {
-                auto alloc_status = m_sb_vdev->commit_blk(data_bid[i]);
-                if (alloc_status != BlkAllocStatus::SUCCESS)
-                    HS_REL_ASSERT(0, "Failed to commit blk: {}", bid.to_string());
+    std::vector< size_t > active(chains.size());
+    std::iota(active.begin(), active.end(), 0);
+    while (!active.empty()) {
+        std::vector< size_t > next_active;
+        for (size_t start{0}; start < active.size(); start += concurrency) {
+            auto const end = std::min(start + concurrency, active.size());
+            std::vector< meta_blk_ovf_hdr* > hdrs;
+            std::vector< folly::Future< std::error_code > > futs;
+            for (auto i = start; i < end; ++i) {
+                auto* ovf_hdr = r_cast< meta_blk_ovf_hdr* >(
+                    hs_utils::iobuf_alloc(block_size(), sisl::buftag::metablk, align_size()));
+                hdrs.push_back(ovf_hdr);
+                futs.emplace_back(m_sb_vdev->async_read(r_cast< char* >(ovf_hdr), block_size(), obids[active[i]],
+                                                        true /* part_of_batch */));
             }
+            m_sb_vdev->submit_batch();
+            auto const results = folly::collectAllUnsafe(futs).get();
+            COUNTER_INCREMENT(m_metrics, meta_scan_reads, futs.size());
+
+            for (auto i = start; i < end; ++i) {
+                auto const idx = active[i];
+                auto const& obid = obids[idx];
+                auto* ovf_hdr = hdrs[i - start];
+                auto const& err = results[i - start].value();
+                HS_REL_ASSERT(!err, "Failed to read ovf blk: {}, error={}", obid.to_string(), err.message());
+
+                // verify self bid
+                HS_REL_ASSERT_EQ(ovf_hdr->h.bid.to_integer(), obid.to_integer(), "Corrupted self-bid: {}/{}",
+                                 ovf_hdr->h.bid.to_string(), obid.to_string());
+                // verify magic
+                HS_REL_ASSERT_EQ(ovf_hdr->h.magic, META_BLK_OVF_MAGIC, "Ovf blk magic corrupted: {}, expected: {}",
+                                 ovf_hdr->h.magic, META_BLK_OVF_MAGIC);
+
+                chains[idx].second += ovf_hdr->h.context_sz;
+
+                // add to ovf blk cache
+                ovf_blk_hdrs[obid.to_integer()] = ovf_hdr;
+
+                // allocate overflow bid;
+                auto alloc_status = m_sb_vdev->commit_blk(obid);
+                if (alloc_status != BlkAllocStatus::SUCCESS) {
+                    HS_REL_ASSERT(0, "Failed to commit blk: {}", obid.to_string());
+                }
 
-            // move on to next overflow blk
-            obid = ovf_hdr->h.next_bid;
-        }
-
-        if (read_sz != static_cast< uint64_t >(mblk->hdr.h.context_sz)) {
-            LOGERROR("[type={}], total size read: {} mismatch from meta blk context_sz: {}", mblk->hdr.h.type, read_sz,
-                     mblk->hdr.h.context_sz);
-            // we are here because we write uncompressed data, but left compressed field as true and context_sz still
-            // setting to compressed size;
+                // allocate data bid
+                auto* data_bid = ovf_hdr->get_data_bid();
+                for (decltype(ovf_hdr->h.nbids) j{0}; j < ovf_hdr->h.nbids; ++j) {
+                    alloc_status = m_sb_vdev->commit_blk(data_bid[j]);
+                    if (alloc_status != BlkAllocStatus::SUCCESS) {
+                        HS_REL_ASSERT(0, "Failed to commit blk: {}", data_bid[j].to_string());
+                    }
+                }
 
-            if (!(HS_DYNAMIC_CONFIG(metablk.skip_header_size_check))) {
-                HS_REL_ASSERT_EQ(read_sz, static_cast< uint64_t >(mblk->hdr.h.context_sz),
-                                 "[type={}], total size read: {} mismatch from meta blk context_sz: {}",
-                                 mblk->hdr.h.type, read_sz, mblk->hdr.h.context_sz);
+                // move on to next overflow blk
+                obids[idx] = ovf_hdr->h.next_bid;
+                if (obids[idx].is_valid()) { next_active.push_back(idx); }
             }
+        }
+        active = std::move(next_active);
+    }
+}
 
-            LOGINFO("[type={}], fixing mblk's context_sz from {} to read_sz: {}", mblk->hdr.h.type,
-                    mblk->hdr.h.context_sz, read_sz);
-
-            // upgrade fix: needed for fixing bad data during upgrade;
-            mblk->hdr.h.compressed = 0;
-            mblk->hdr.h.context_sz = read_sz;
-        } else {
-            LOGDEBUG("[type={}], meta blk size check passed!", mblk->hdr.h.type);
+void MetaBlkService::verify_context_sz(meta_blk* mblk, uint64_t read_sz) const {
+    if (read_sz != static_cast< uint64_t >(mblk->hdr.h.context_sz)) {
+        LOGERROR("[type={}], total size read: {} mismatch from meta blk context_sz: {}", mblk->hdr.h.type, read_sz,
+                 mblk->hdr.h.context_sz);
+        // we are here because we write uncompressed data, but left compressed field as true and context_sz still
+        // setting to compressed size;
+
+        if (!(HS_DYNAMIC_CONFIG(metablk.skip_header_size_check))) {
+            HS_REL_ASSERT_EQ(read_sz, static_cast< uint64_t >(mblk->hdr.h.context_sz),
+                             "[type={}], total size read: {} mismatch from meta blk context_sz: {}", mblk->hdr.h.type,
+                             read_sz, mblk->hdr.h.context_sz);
         }
 
-        // move on to next meta blk;
-        bid = mblk->hdr.h.next_bid;
-    }
+        LOGINFO("[type={}], fixing mblk's context_sz from {} to read_sz: {}", mblk->hdr.h.type, mblk->hdr.h.context_sz,
+                read_sz);
 
-    return self_recover;
+        // upgrade fix: needed for fixing bad data during upgrade;
+        mblk->hdr.h.compressed = 0;
+        mblk->hdr.h.context_sz = read_sz;
+    } else {
+        LOGDEBUG("[type={}], meta blk size check passed!", mblk->hdr.h.type);
+    }
 }
 
 bool MetaBlkService::is_sub_type_valid(meta_sub_type type) { return m_sub_info.find(type) != m_sub_info.end(); }
 
+void MetaBlkService::set_compress_codec(const meta_sub_type& type, meta_compress_codec_t codec) {
+    std::lock_guard< decltype(m_meta_mtx) > lk(m_meta_mtx);
+    m_sub_info[type].codec = codec;
+    HS_LOG(INFO, metablk, "[type={}] compress codec set to {}", type, enum_name(codec));
+}
+
 void MetaBlkService::deregister_handler(meta_sub_type type) {
     std::lock_guard< decltype(m_meta_mtx) > lk{m_meta_mtx};
 
@@ -413,7 +532,7 @@ void MetaBlkService::add_sub_sb(meta_sub_type type, const uint8_t* context_data,
 
 #ifdef _PRERELEASE
     uint32_t crc{0};
-    if (m_sub_info[type].do_crc) { crc = crc32_ieee(init_crc32, s_cast< const uint8_t* >(context_data), sz); }
+    if (m_sub_info[type].do_crc) { crc = meta_crc(true /* crc32c */, s_cast< const uint8_t* >(context_data), sz); }
 #endif
 
     HS_LOG(DEBUG, metablk, "[type={}], adding meta bid: {}, sz: {}", type, meta_bid.to_string(), sz);
@@ -538,6 +657,7 @@ void MetaBlkService::write_meta_blk_to_disk(meta_blk* mblk) {
         HS_REL_ASSERT(false, "error happens happen during write_meta_blk_to_disk: {}, buf address: {}", error.value(),
                       (const char*)mblk);
     }
+    invalidate_read_cache(mblk->hdr.h.bid);
 }
 
 //
@@ -547,7 +667,7 @@ void MetaBlkService::write_meta_blk_to_disk(meta_blk* mblk) {
 //    update in-memory m_ssb and write to disk;
 // 3. update in-memory meta blks map;
 //
-meta_blk* MetaBlkService::init_meta_blk(BlkId& bid, meta_sub_type type, const uint8_t* context_data, size_t sz) {
+meta_blk* MetaBlkService::new_meta_blk(const BlkId& bid, const meta_sub_type& type) const {
     meta_blk* mblk{r_cast< meta_blk* >(hs_utils::iobuf_alloc(block_size(), sisl::buftag::metablk, align_size()))};
     mblk->hdr.h.compressed = 0;
     mblk->hdr.h.bid = bid;
@@ -557,6 +677,11 @@ meta_blk* MetaBlkService::init_meta_blk(BlkId& bid, meta_sub_type type, const ui
     mblk->hdr.h.magic = META_BLK_MAGIC;
     mblk->hdr.h.version = META_BLK_VERSION;
     mblk->hdr.h.gen_cnt = 0;
+    return mblk;
+}
+
+meta_blk* MetaBlkService::init_meta_blk(BlkId& bid, meta_sub_type type, const uint8_t* context_data, size_t sz) {
+    meta_blk* mblk = new_meta_blk(bid, type);
 
     // handle prev/next pointer linkage;
     if (m_last_mblk_id->is_valid()) {
@@ -613,14 +738,15 @@ void MetaBlkService::write_meta_blk_ovf(BlkId& out_obid, const uint8_t* context_
     // allocate data blocks
     static thread_local std::vector< BlkId > context_data_blkids{};
     context_data_blkids.clear();
-    alloc_meta_blks(sisl::round_up(sz, block_size()), context_data_blkids);
+    auto const temp = alloc_temp(type);
+    alloc_meta_blks(sisl::round_up(sz, block_size()), context_data_blkids, temp);
 
     HS_LOG(DEBUG, metablk,
            "Context data size {}, rounded up to {}, block_size {},  allocated {} blkIDs, mstore used size: {}", sz,
            sisl::round_up(sz, block_size()), block_size(), context_data_blkids.size(), m_sb_vdev->used_size());
 
     // return the 1st ovf header blk id to caller;
-    alloc_meta_blk(out_obid);
+    alloc_meta_blk(out_obid, temp);
     BlkId next_bid = out_obid;
     uint64_t offset_in_ctx{0};
     uint32_t data_blkid_indx{0};
@@ -635,7 +761,7 @@ void MetaBlkService::write_meta_blk_ovf(BlkId& out_obid, const uint8_t* context_
         if ((context_data_blkids.size() - (data_blkid_indx + 1)) <= ovf_blk_max_num_data_blk()) {
             ovf_hdr->h.next_bid.invalidate();
         } else {
-            alloc_meta_blk(ovf_hdr->h.next_bid);
+            alloc_meta_blk(ovf_hdr->h.next_bid, temp);
         }
         next_bid = ovf_hdr->h.next_bid;
 
@@ -664,12 +790,13 @@ void MetaBlkService::write_meta_blk_ovf(BlkId& out_obid, const uint8_t* context_
     HS_REL_ASSERT_EQ(offset_in_ctx, sz);
 }
 
-void MetaBlkService::write_meta_blk_internal(meta_blk* mblk, const uint8_t* context_data, uint64_t sz) {
+void MetaBlkService::write_meta_blk_internal(meta_blk* mblk, const uint8_t* context_data, uint64_t sz, bool persist) {
     auto data_sz = sz;
     // start compression
-    if (HS_DYNAMIC_CONFIG(metablk.compress_feature_on) && (sz >= min_compress_size())) {
-        // TO DO: Might need to differentiate based on data or fast type
-        const uint64_t max_dst_size = sisl::round_up(sisl::Compress::max_compress_len(sz), align_size());
+    const auto it = m_sub_info.find(mblk->hdr.h.type);
+    const auto codec = (it != m_sub_info.end()) ? it->second.codec : meta_compress_codec_t::DEFAULT;
+    if (HS_DYNAMIC_CONFIG(metablk.compress_feature_on) && (sz >= min_compress_size(codec))) {
+        const uint64_t max_dst_size = sisl::round_up(max_compress_len(codec, sz), align_size());
         if (max_dst_size <= max_compress_memory_size()) {
             if (max_dst_size > m_compress_info.size()) {
                 free_compress_buf();
@@ -678,18 +805,15 @@ void MetaBlkService::write_meta_blk_internal(meta_blk* mblk, const uint8_t* cont
 
             std::memset(voidptr_cast(m_compress_info.bytes()), 0, max_dst_size);
 
-            size_t compressed_size = max_dst_size;
-            const auto ret = sisl::Compress::compress(r_cast< const char* >(context_data),
-                                                      r_cast< char* >(m_compress_info.bytes()), sz, &compressed_size);
-            if (ret != 0) {
-                LOGERROR("hs_compress_default indicates a failure trying to compress the data, ret: {}", ret);
-                HS_REL_ASSERT(false, "failed to compress");
-            }
+            const size_t compressed_size = compress(codec, context_data, sz, m_compress_info.bytes(), max_dst_size);
+            HS_REL_ASSERT_GT(compressed_size, 0, "[type={}] failed to compress with codec: {}", mblk->hdr.h.type,
+                             enum_name(codec));
             const uint32_t ratio_percent = uint32_cast(uint64_cast(compressed_size) * 100 / sz);
             if (ratio_percent <= HS_DYNAMIC_CONFIG(metablk.compress_ratio_limit)) {
                 COUNTER_INCREMENT(m_metrics, compress_success_cnt, 1);
                 HISTOGRAM_OBSERVE(m_metrics, compress_ratio_percent, ratio_percent);
                 mblk->hdr.h.compressed = 1;
+                mblk->hdr.h.codec = static_cast< uint8_t >(codec);
                 mblk->hdr.h.src_context_sz = sz;
                 // TO DO: Might need to differentiate based on data or fast type
                 mblk->hdr.h.context_sz = sisl::round_up(compressed_size, align_size());
@@ -744,17 +868,39 @@ void MetaBlkService::write_meta_blk_internal(meta_blk* mblk, const uint8_t* cont
 #endif
     }
 
-    // for both in-band and ovf buffer, we store crc in meta blk header;
+    // for both in-band and ovf buffer, we store crc in meta blk header; blks of older versions are rewritten with the
+    // crc of the current version
+    mblk->hdr.h.version = META_BLK_VERSION;
     if (m_sub_info[mblk->hdr.h.type].do_crc) {
-        mblk->hdr.h.crc = crc32_ieee(init_crc32, s_cast< const uint8_t* >(context_data), data_sz);
+        mblk->hdr.h.crc = meta_crc(true /* crc32c */, s_cast< const uint8_t* >(context_data), data_sz);
     }
 
     // write meta blk;
-    write_meta_blk_to_disk(mblk);
+    if (persist) {
+        write_meta_blk_to_disk(mblk);
 
 #ifdef _PRERELEASE
-    if (hs()->crash_simulator().crash_if_flip_set("write_sb_abort")) { return; }
+        if (hs()->crash_simulator().crash_if_flip_set("write_sb_abort")) { return; }
 #endif
+    }
+}
+
+void MetaBlkService::write_meta_blks_to_disk(const std::vector< meta_blk* >& mblks) {
+    std::vector< folly::Future< std::error_code > > futs;
+    futs.reserve(mblks.size());
+    for (auto* mblk : mblks) {
+        futs.emplace_back(m_sb_vdev->async_write(r_cast< const char* >(mblk), block_size(), mblk->hdr.h.bid,
+                                                 true /* part_of_batch */));
+    }
+    m_sb_vdev->submit_batch();
+
+    auto const results = folly::collectAllUnsafe(futs).get();
+    for (size_t i{0}; i < results.size(); ++i) {
+        auto const& error = results[i].value();
+        HS_REL_ASSERT(!error, "error happens during write_meta_blks_to_disk: {}, [type={}], bid: {}", error.message(),
+                      mblks[i]->hdr.h.type, mblks[i]->hdr.h.bid.to_string());
+        invalidate_read_cache(mblks[i]->hdr.h.bid);
+    }
 }
 
 //
@@ -765,7 +911,7 @@ void MetaBlkService::_cookie_sanity_check(const void* cookie) const {
     auto mblk = s_cast< const meta_blk* >(cookie);
 
     HS_REL_ASSERT_EQ(cookie != nullptr, true, "null cookie!");
-    HS_REL_ASSERT_EQ(mblk->hdr.h.version == META_BLK_VERSION && mblk->hdr.h.magic == META_BLK_MAGIC, true,
+    HS_REL_ASSERT_EQ(mblk->hdr.h.version <= META_BLK_VERSION && mblk->hdr.h.magic == META_BLK_MAGIC, true,
                      "Corrupted version/magic: {}", mblk->to_string());
 
     HS_REL_ASSERT_EQ(mblk->hdr.h.prev_bid.is_valid() && mblk->hdr.h.bid.is_valid(), true,
@@ -802,25 +948,344 @@ void MetaBlkService::_cookie_sanity_check(const void* cookie) const {
 // 3. free old ovf_bid if there is any
 //
 void MetaBlkService::update_sub_sb(const uint8_t* context_data, uint64_t sz, void* cookie) {
-    std::lock_guard< decltype(m_meta_mtx) > lg{m_meta_mtx};
+    std::vector< folly::Promise< bool > > superseded;
+    {
+        std::lock_guard< decltype(m_meta_mtx) > lg{m_meta_mtx};
+        do_update_sub_sb(context_data, sz, cookie);
+        superseded = take_async_update(cookie, false /* removed */);
+    }
+    for (auto& p : superseded) {
+        p.setValue(true);
+    }
+}
+
+folly::Future< bool > MetaBlkService::async_update_sub_sb(const uint8_t* context_data, uint64_t sz, void* cookie) {
+    HS_REL_ASSERT_EQ(m_inited, true, "accessing metablk store before init is not allowed.");
+    COUNTER_INCREMENT(m_metrics, async_update_cnt, 1);
+
+    auto buf = hs_utils::make_byte_array(sz, is_aligned_buf_needed(sz), sisl::buftag::metablk, align_size());
+    std::memcpy(buf->bytes(), context_data, sz);
+
+    folly::Promise< bool > p;
+    auto f = p.getFuture();
+    bool start_writer{false};
+    {
+        std::lock_guard lg{m_async_mtx};
+        auto [it, inserted] = m_async_updates.try_emplace(cookie);
+        if (it->second.buf) { COUNTER_INCREMENT(m_metrics, async_update_coalesced_cnt, 1); }
+        it->second.buf = std::move(buf);
+        it->second.promises.push_back(std::move(p));
+        start_writer = inserted;
+    }
+
+    // Entry of the cookie stays till its writer finds nothing more to write, so there is one writer per meta blk
+    if (start_writer) {
+        iomanager.run_on_forget(iomgr::reactor_regex::random_worker, iomgr::fiber_regex::syncio_only,
+                                [this, cookie]() { write_async_updates(cookie); });
+    }
+    return f;
+}
+
+void MetaBlkService::write_async_updates(void* cookie) {
+    while (true) {
+        std::vector< folly::Promise< bool > > promises;
+        {
+            // Pending content is taken under the meta lock, so that a sync update can't get in between and be
+            // overwritten by an older content
+            std::lock_guard< decltype(m_meta_mtx) > lg{m_meta_mtx};
+            sisl::byte_array buf;
+            {
+                std::lock_guard alg{m_async_mtx};
+                auto it = m_async_updates.find(cookie);
+                if (it == m_async_updates.end()) { return; } // meta blk is removed in the meantime
+                if (!it->second.buf) {
+                    m_async_updates.erase(it);
+                    return;
+                }
+                buf = std::move(it->second.buf);
+                promises.swap(it->second.promises);
+            }
+            do_update_sub_sb(buf->cbytes(), buf->size(), cookie);
+        }
+
+        for (auto& p : promises) {
+            p.setValue(true);
+        }
+    }
+}
+
+void MetaBlkService::update_sub_sb_delta(const uint8_t* context_data, uint64_t sz, void* cookie,
+                                         const std::vector< uint64_t >& dirty_pages) {
+    std::vector< folly::Promise< bool > > superseded;
+    {
+        std::lock_guard< decltype(m_meta_mtx) > lg{m_meta_mtx};
+        HS_REL_ASSERT_EQ(m_inited, true, "accessing metablk store before init is not allowed.");
+#ifdef _PRERELEASE
+        _cookie_sanity_check(cookie);
+#endif
+        if (!do_update_sub_sb_delta(context_data, sz, s_cast< meta_blk* >(cookie), dirty_pages)) {
+            do_update_sub_sb(context_data, sz, cookie);
+        }
+        superseded = take_async_update(cookie, false /* removed */);
+    }
+    for (auto& p : superseded) {
+        p.setValue(true);
+    }
+}
+
+//
+// Copy-on-write of the changed pages:
+// 1. write the changed pages to newly allocated data blks;
+// 2. write a new ovf chain, referring to the old data blks for the unchanged pages and to the new ones for the rest;
+// 3. write the meta blk pointing to the new ovf chain, which commits the update;
+// 4. free the old ovf header blks and the data blks of the changed pages;
+//
+// If we crash before 3, the new blks are not referred to by any meta blk and are treated as free after reboot.
+//
+bool MetaBlkService::do_update_sub_sb_delta(const uint8_t* context_data, uint64_t sz, meta_blk* mblk,
+                                            const std::vector< uint64_t >& dirty_pages) {
+    auto const bs = block_size();
+    auto const npages = sisl::round_up(sz, bs) / bs;
+    if (mblk->hdr.h.compressed || !mblk->hdr.h.ovf_bid.is_valid() || (sz <= meta_blk_context_sz()) ||
+        (sz != mblk->hdr.h.context_sz) || can_journal(sz) || journaled(mblk->hdr.h.bid) ||
+        (dirty_pages.size() * 100 > npages * HS_DYNAMIC_CONFIG(metablk.delta_update_max_dirty_percent))) {
+        return false;
+    }
+    record_update(mblk->hdr.h.type);
+    auto const temp = alloc_temp(mblk->hdr.h.type);
+
+    // Flatten the data blks of the old ovf chain, each followed by the index of its first page
+    std::vector< BlkId > old_hdr_bids;
+    std::vector< BlkId > old_data_bids;
+    for (auto obid = mblk->hdr.h.ovf_bid; obid.is_valid();) {
+        auto const* ovf_hdr = m_ovf_blk_hdrs.at(obid.to_integer());
+        old_hdr_bids.push_back(obid);
+        auto const* data_bid = ovf_hdr->get_data_bid();
+        old_data_bids.insert(old_data_bids.end(), data_bid, data_bid + ovf_hdr->h.nbids);
+        obid = ovf_hdr->h.next_bid;
+    }
+
+    // Split the old data blks into the runs of clean and dirty pages, with the dirty runs moved to new blks
+    std::vector< BlkId > new_data_bids;
+    std::vector< BlkId > bids_to_free;
+    auto dirty_it = dirty_pages.cbegin();
+    uint64_t page{0};
+    for (auto const& bid : old_data_bids) {
+        blk_count_t off{0};
+        while (off < bid.blk_count()) {
+            while ((dirty_it != dirty_pages.cend()) && (*dirty_it < page + off)) {
+                ++dirty_it;
+            }
+            bool const dirty = (dirty_it != dirty_pages.cend()) && (*dirty_it == page + off);
+            blk_count_t run{1};
+            while ((off + run < bid.blk_count()) &&
+                   (std::binary_search(dirty_it, dirty_pages.cend(), page + off + run) == dirty)) {
+                ++run;
+            }
+
+            BlkId const run_bid{bid.blk_num() + off, run, bid.chunk_num()};
+            if (!dirty) {
+                new_data_bids.push_back(run_bid);
+            } else {
+                std::vector< BlkId > bids;
+                alloc_meta_blks(uint64_cast(run) * bs, bids, temp);
+                uint64_t ctx_off = (page + off) * bs;
+                for (auto const& b : bids) {
+                    auto const len = std::min(uint64_cast(b.blk_count()) * bs, sz - ctx_off);
+                    write_ctx_data(b, context_data + ctx_off, len);
+                    ctx_off += len;
+                    new_data_bids.push_back(b);
+                }
+                bids_to_free.push_back(run_bid);
+            }
+            off += run;
+        }
+        page += bid.blk_count();
+    }
+    HS_DBG_ASSERT_EQ(page, npages, "pages of ovf chain mismatch with the context size");
+
+    // Build and write the new ovf chain
+    std::vector< BlkId > hdr_bids((new_data_bids.size() + ovf_blk_max_num_data_blk() - 1) / ovf_blk_max_num_data_blk());
+    for (auto& hbid : hdr_bids) {
+        alloc_meta_blk(hbid, temp);
+    }
+    uint64_t offset_in_ctx{0};
+    size_t data_idx{0};
+    for (size_t h{0}; h < hdr_bids.size(); ++h) {
+        auto* ovf_hdr =
+            r_cast< meta_blk_ovf_hdr* >(hs_utils::iobuf_alloc(block_size(), sisl::buftag::metablk, align_size()));
+        ovf_hdr->h.magic = META_BLK_OVF_MAGIC;
+        ovf_hdr->h.bid = hdr_bids[h];
+        if (h + 1 < hdr_bids.size()) {
+            ovf_hdr->h.next_bid = hdr_bids[h + 1];
+        } else {
+            ovf_hdr->h.next_bid.invalidate();
+        }
+
+        decltype(ovf_hdr->h.nbids) j{0};
+        uint64_t data_size{0};
+        auto* data_bid = ovf_hdr->get_data_bid_mutable();
+        for (; (j < ovf_blk_max_num_data_blk()) && (data_idx < new_data_bids.size()); ++j) {
+            data_size += new_data_bids[data_idx].blk_count() * bs;
+            data_bid[j] = new_data_bids[data_idx++];
+        }
+        ovf_hdr->h.nbids = j;
+        ovf_hdr->h.context_sz = (data_idx < new_data_bids.size()) ? data_size : (sz - offset_in_ctx);
+        offset_in_ctx += ovf_hdr->h.context_sz;
+
+        m_ovf_blk_hdrs[hdr_bids[h].to_integer()] = ovf_hdr;
+        auto error = m_sb_vdev->sync_write(r_cast< const char* >(ovf_hdr), block_size(), ovf_hdr->h.bid);
+        HS_REL_ASSERT(!error, "error happens during write of ovf blk: {}, bid: {}", error.message(),
+                      ovf_hdr->h.bid.to_string());
+    }
+    HS_REL_ASSERT_EQ(offset_in_ctx, sz);
+
+    mblk->hdr.h.ovf_bid = hdr_bids.front();
+    mblk->hdr.h.gen_cnt += 1;
+    mblk->hdr.h.version = META_BLK_VERSION;
+    if (m_sub_info[mblk->hdr.h.type].do_crc) { mblk->hdr.h.crc = meta_crc(true /* crc32c */, context_data, sz); }
+    write_meta_blk_to_disk(mblk);
+
+#ifdef _PRERELEASE
+    if (hs()->crash_simulator().crash_if_flip_set("update_sb_abort")) { return true; }
+#endif
+
+    for (auto const& obid : old_hdr_bids) {
+        m_sb_vdev->free_blk(obid);
+        auto it = m_ovf_blk_hdrs.find(obid.to_integer());
+        hs_utils::iobuf_free(uintptr_cast(it->second), sisl::buftag::metablk);
+        m_ovf_blk_hdrs.erase(it);
+    }
+    for (auto const& bid : bids_to_free) {
+        m_sb_vdev->free_blk(bid);
+    }
+
+    COUNTER_INCREMENT(m_metrics, delta_update_cnt, 1);
+    COUNTER_INCREMENT(m_metrics, delta_update_pages, dirty_pages.size());
+    HS_LOG(DEBUG, metablk, "[type={}], delta update rewrote {} of {} pages, mstore used size: {}", mblk->hdr.h.type,
+           dirty_pages.size(), npages, m_sb_vdev->used_size());
+    return true;
+}
+
+void MetaBlkService::write_ctx_data(const BlkId& bid, const uint8_t* data, uint64_t sz) {
+    // Written from an aligned copy, padded to the dma boundary
+    auto const write_sz = sisl::round_up(sz, align_size());
+    auto* buf = hs_utils::iobuf_alloc(write_sz, sisl::buftag::metablk, align_size());
+    std::memcpy(buf, data, sz);
+    std::memset(buf + sz, 0, write_sz - sz);
+    auto error = m_sb_vdev->sync_write(r_cast< const char* >(buf), write_sz, bid);
+    HS_REL_ASSERT(!error, "error happens during write of context data: {}, bid: {}", error.message(), bid.to_string());
+    hs_utils::iobuf_free(buf, sisl::buftag::metablk);
+}
+
+std::vector< folly::Promise< bool > > MetaBlkService::take_async_update(void* cookie, bool removed) {
+    std::vector< folly::Promise< bool > > promises;
+    std::lock_guard lg{m_async_mtx};
+    if (auto it = m_deferred_updates.find(cookie); it != m_deferred_updates.end()) {
+        promises.swap(it->second.promises);
+        m_deferred_updates.erase(it);
+    }
+
+    auto it = m_async_updates.find(cookie);
+    if (it == m_async_updates.end()) { return promises; }
+
+    for (auto& p : it->second.promises) {
+        promises.push_back(std::move(p));
+    }
+    if (removed) {
+        m_async_updates.erase(it);
+    } else {
+        it->second.buf.reset();
+        it->second.promises.clear();
+    }
+    return promises;
+}
+
+folly::Future< bool > MetaBlkService::defer_update_sub_sb(const uint8_t* context_data, uint64_t sz, void* cookie) {
+    HS_REL_ASSERT_EQ(m_inited, true, "accessing metablk store before init is not allowed.");
+    if (m_deferred_flush_timer_hdl == iomgr::null_timer_handle) {
+        update_sub_sb(context_data, sz, cookie);
+        return folly::makeFuture< bool >(true);
+    }
+    COUNTER_INCREMENT(m_metrics, deferred_update_cnt, 1);
+
+    auto buf = hs_utils::make_byte_array(sz, is_aligned_buf_needed(sz), sisl::buftag::metablk, align_size());
+    std::memcpy(buf->bytes(), context_data, sz);
+
+    folly::Promise< bool > p;
+    auto f = p.getFuture();
+    {
+        std::lock_guard lg{m_async_mtx};
+        auto& ctx = m_deferred_updates[cookie];
+        if (ctx.buf) { COUNTER_INCREMENT(m_metrics, deferred_update_coalesced_cnt, 1); }
+        ctx.buf = std::move(buf);
+        ctx.promises.push_back(std::move(p));
+    }
+    return f;
+}
+
+void MetaBlkService::schedule_deferred_flush() {
+    // A flush still in progress takes the updates deferred since, so there is no point in queueing another one
+    if (m_deferred_flush_scheduled.exchange(true)) { return; }
+    iomanager.run_on_forget(iomgr::reactor_regex::random_worker, iomgr::fiber_regex::syncio_only, [this]() {
+        flush_deferred_updates();
+        m_deferred_flush_scheduled.store(false);
+    });
+}
+
+void MetaBlkService::flush_deferred_updates() {
+    std::unordered_map< void*, async_update_ctx > updates;
+    {
+        // Deferred updates are taken under the meta lock, so that a sync update can't get in between and be
+        // overwritten by an older content
+        std::lock_guard< decltype(m_meta_mtx) > lg{m_meta_mtx};
+        {
+            std::lock_guard alg{m_async_mtx};
+            updates.swap(m_deferred_updates);
+        }
+        if (updates.empty()) { return; }
+
+        MetaBlkBatch batch;
+        for (auto const& [cookie, ctx] : updates) {
+            batch.update_sub_sb(ctx.buf->cbytes(), ctx.buf->size(), cookie);
+        }
+        do_commit_batch(batch);
+    }
+    HS_LOG(DEBUG, metablk, "Flushed deferred updates of {} meta blks", updates.size());
+    COUNTER_INCREMENT(m_metrics, deferred_flush_cnt, 1);
+
+    for (auto& [cookie, ctx] : updates) {
+        for (auto& p : ctx.promises) {
+            p.setValue(true);
+        }
+    }
+}
+
+void MetaBlkService::do_update_sub_sb(const uint8_t* context_data, uint64_t sz, void* cookie, bool use_journal) {
     HS_REL_ASSERT_EQ(m_inited, true, "accessing metablk store before init is not allowed.");
 
 #ifdef _PRERELEASE
     _cookie_sanity_check(cookie);
 #endif
     meta_blk* mblk = s_cast< meta_blk* >(cookie);
+    if (use_journal && journal_update(mblk, context_data, sz)) {
+        record_update(mblk->hdr.h.type);
+        return;
+    }
+    journal_drop(mblk);
 
     HS_LOG(DEBUG, metablk, "[type={}], update_sub_sb old sb: context_sz: {}, ovf_bid: {}, mstore used size: {}",
            mblk->hdr.h.type, (unsigned long)(mblk->hdr.h.context_sz), mblk->hdr.h.ovf_bid.to_string(),
            m_sb_vdev->used_size());
 
     const auto ovf_bid_to_free = mblk->hdr.h.ovf_bid;
+    record_update(mblk->hdr.h.type);
 
 #ifdef _PRERELEASE
     uint32_t crc{0};
     const auto it = m_sub_info.find(mblk->hdr.h.type);
     HS_DBG_ASSERT(it != std::end(m_sub_info), "[type={}] not registered yet!", mblk->hdr.h.type);
-    if (it->second.do_crc) { crc = crc32_ieee(init_crc32, s_cast< const uint8_t* >(context_data), sz); }
+    if (it->second.do_crc) { crc = meta_crc(true /* crc32c */, s_cast< const uint8_t* >(context_data), sz); }
 #endif
 
 #ifdef _PRERELEASE
@@ -868,8 +1333,144 @@ void MetaBlkService::update_sub_sb(const uint8_t* context_data, uint64_t sz, voi
 #endif
 }
 
+//
+// Commit the staged operations in below order:
+// 1. write the ovf blks of the updates and adds, then all their meta blks in one batch;
+// 2. link the new meta blks, which are already linked to each other, to the last mblk or ssb with a single write;
+// 3. free the old ovf blks of the updates;
+// 4. remove the meta blks to be removed;
+//
+void MetaBlkService::commit_batch(MetaBlkBatch& batch) {
+    if (batch.empty()) { return; }
+
+    std::unique_lock< decltype(m_meta_mtx) > lg{m_meta_mtx};
+    do_commit_batch(batch);
+
+    // Pending async and deferred updates are superseded by the updates and failed by the removes of the batch
+    std::vector< folly::Promise< bool > > superseded;
+    std::vector< folly::Promise< bool > > failed;
+    for (auto const& op : batch.m_updates) {
+        for (auto& p : take_async_update(op.cookie, false /* removed */)) {
+            superseded.push_back(std::move(p));
+        }
+    }
+    for (auto* cookie : batch.m_removes) {
+        for (auto& p : take_async_update(cookie, true /* removed */)) {
+            failed.push_back(std::move(p));
+        }
+    }
+    batch.clear();
+
+    lg.unlock();
+    for (auto& p : superseded) {
+        p.setValue(true);
+    }
+    for (auto& p : failed) {
+        p.setValue(false);
+    }
+}
+
+void MetaBlkService::do_commit_batch(MetaBlkBatch& batch) {
+    HS_REL_ASSERT_EQ(m_inited, true, "accessing metablk store before init is not allowed.");
+
+    std::vector< meta_blk* > mblks_to_write;
+    std::vector< BlkId > ovf_bids_to_free;
+    mblks_to_write.reserve(batch.m_updates.size() + batch.m_adds.size());
+
+    for (auto const& op : batch.m_updates) {
+#ifdef _PRERELEASE
+        _cookie_sanity_check(op.cookie);
+#endif
+        meta_blk* mblk = s_cast< meta_blk* >(op.cookie);
+        ovf_bids_to_free.push_back(mblk->hdr.h.ovf_bid);
+
+        record_update(mblk->hdr.h.type);
+        journal_drop(mblk);
+        mblk->hdr.h.compressed = 0;
+        mblk->hdr.h.ovf_bid.invalidate();
+        mblk->hdr.h.gen_cnt += 1;
+        write_meta_blk_internal(mblk, op.context_data, op.sz, false /* persist */);
+        mblks_to_write.push_back(mblk);
+    }
+
+    // Blks of all new meta blks are allocated upfront, so that each one is written already pointing to the next
+    std::vector< BlkId > new_bids(batch.m_adds.size());
+    for (auto& bid : new_bids) {
+        alloc_meta_blk(bid);
+    }
+
+    BlkId prev_bid = m_last_mblk_id->is_valid() ? *m_last_mblk_id : m_ssb->bid;
+    for (size_t i{0}; i < batch.m_adds.size(); ++i) {
+        auto const& op = batch.m_adds[i];
+        HS_REL_ASSERT_LT(op.type.length(), MAX_SUBSYS_TYPE_LEN, "type len: {} should not exceed len: {}",
+                         op.type.length(), MAX_SUBSYS_TYPE_LEN);
+        HS_REL_ASSERT(m_sub_info.find(op.type) != m_sub_info.end(), "[type={}] not registered yet!", op.type);
+
+        meta_blk* mblk = new_meta_blk(new_bids[i], op.type);
+        mblk->hdr.h.prev_bid = prev_bid;
+        if (i + 1 < new_bids.size()) {
+            mblk->hdr.h.next_bid = new_bids[i + 1];
+        } else {
+            mblk->hdr.h.next_bid.invalidate();
+        }
+        write_meta_blk_internal(mblk, op.context_data, op.sz, false /* persist */);
+        mblks_to_write.push_back(mblk);
+
+        HS_DBG_ASSERT(m_meta_blks.find(new_bids[i].to_integer()) == m_meta_blks.end(),
+                      "{}, memory corruption, bid: {} already added to cache.", op.type, new_bids[i].to_string());
+        m_meta_blks[new_bids[i].to_integer()] = mblk;
+        m_sub_info[op.type].meta_bids.insert(new_bids[i].to_integer());
+        *op.cookie = voidptr_cast(mblk);
+        prev_bid = new_bids[i];
+    }
+
+    write_meta_blks_to_disk(mblks_to_write);
+
+    // New meta blks are reachable only after this write, so none of them is found if we crash before it
+    if (!new_bids.empty()) {
+        if (m_last_mblk_id->is_valid()) {
+            auto* last_mblk = m_meta_blks[m_last_mblk_id->to_integer()];
+            last_mblk->hdr.h.next_bid = new_bids.front();
+            write_meta_blk_to_disk(last_mblk);
+        } else {
+            HS_DBG_ASSERT_EQ(m_ssb->next_bid.is_valid(), false);
+            HS_LOG(INFO, metablk, "Changing meta ssb bid: {}'s next_bid to {}", m_ssb->bid,
+                   new_bids.front().to_string());
+            m_ssb->next_bid = new_bids.front();
+            write_ssb();
+        }
+        *m_last_mblk_id = new_bids.back();
+    }
+
+    for (auto const& obid : ovf_bids_to_free) {
+        free_ovf_blk_chain(obid);
+    }
+
+    for (auto* cookie : batch.m_removes) {
+        do_remove_sub_sb(cookie);
+    }
+
+    HS_LOG(DEBUG, metablk, "Committed batch of adds: {}, updates: {}, removes: {}, mstore used size: {}",
+           batch.m_adds.size(), batch.m_updates.size(), batch.m_removes.size(), m_sb_vdev->used_size());
+    COUNTER_INCREMENT(m_metrics, batch_commit_cnt, 1);
+    COUNTER_INCREMENT(m_metrics, batch_op_cnt, batch.size());
+}
+
 std::error_condition MetaBlkService::remove_sub_sb(void* cookie) {
-    std::lock_guard< decltype(m_meta_mtx) > lg{m_meta_mtx};
+    std::vector< folly::Promise< bool > > failed;
+    std::error_condition ret;
+    {
+        std::lock_guard< decltype(m_meta_mtx) > lg{m_meta_mtx};
+        ret = do_remove_sub_sb(cookie);
+        failed = take_async_update(cookie, true /* removed */);
+    }
+    for (auto& p : failed) {
+        p.setValue(false);
+    }
+    return ret;
+}
+
+std::error_condition MetaBlkService::do_remove_sub_sb(void* cookie) {
 #ifdef _PRERELEASE
     _cookie_sanity_check(cookie);
 #endif
@@ -877,6 +1478,8 @@ std::error_condition MetaBlkService::remove_sub_sb(void* cookie) {
     meta_blk* rm_blk = s_cast< meta_blk* >(cookie);
     const BlkId rm_bid = rm_blk->hdr.h.bid;
     const auto type = rm_blk->hdr.h.type;
+    invalidate_read_cache(rm_bid);
+    journal_remove(rm_blk);
 
     // this record must exist in-memory copy
     HS_DBG_ASSERT(m_meta_blks.find(rm_bid.to_integer()) != m_meta_blks.end(), "{}, id: {} not found!", type,
@@ -1016,11 +1619,37 @@ void MetaBlkService::free_meta_blk(meta_blk* mblk) {
     hs_utils::iobuf_free(uintptr_cast(mblk), sisl::buftag::metablk);
 }
 
-void MetaBlkService::alloc_meta_blks(uint64_t size, std::vector< BlkId >& bids) {
+void MetaBlkService::record_update(const meta_sub_type& type) {
+    auto it = m_sub_info.find(type);
+    if (it == m_sub_info.end()) { return; }
+
+    auto& info = it->second;
+    ++info.window_updates;
+    if (get_elapsed_time_ms(info.window_start) < HS_DYNAMIC_CONFIG(metablk.hot_update_window_ms)) { return; }
+
+    auto const threshold = HS_DYNAMIC_CONFIG(metablk.hot_update_threshold);
+    bool const hot = (threshold != 0) && (info.window_updates >= threshold);
+    if (hot != info.hot) {
+        HS_LOG(INFO, metablk, "[type={}] classified as {} after {} updates in the last window", type,
+               hot ? "hot" : "cold", info.window_updates);
+        info.hot = hot;
+    }
+    info.window_updates = 0;
+    info.window_start = Clock::now();
+}
+
+blk_temp_t MetaBlkService::alloc_temp(const meta_sub_type& type) const {
+    auto const it = m_sub_info.find(type);
+    return ((it != m_sub_info.end()) && it->second.hot) ? blk_temp::hot : blk_temp::any;
+}
+
+void MetaBlkService::alloc_meta_blks(uint64_t size, std::vector< BlkId >& bids, blk_temp_t temp) {
     auto const nblks = uint32_cast(size / m_sb_vdev->block_size());
+    blk_alloc_hints hints;
+    hints.desired_temp = temp;
 
     try {
-        const auto ret = m_sb_vdev->alloc_blks(nblks, blk_alloc_hints{}, bids);
+        const auto ret = m_sb_vdev->alloc_blks(nblks, hints, bids);
         HS_REL_ASSERT_EQ(ret, BlkAllocStatus::SUCCESS);
 #ifndef NDEBUG
         uint64_t debug_size{0};
@@ -1035,9 +1664,10 @@ void MetaBlkService::alloc_meta_blks(uint64_t size, std::vector< BlkId >& bids)
     }
 }
 
-void MetaBlkService::alloc_meta_blk(BlkId& bid) {
+void MetaBlkService::alloc_meta_blk(BlkId& bid, blk_temp_t temp) {
     blk_alloc_hints hints;
     hints.is_contiguous = true;
+    hints.desired_temp = temp;
 
     try {
         const auto ret = m_sb_vdev->alloc_contiguous_blks(1, hints, bid);
@@ -1048,6 +1678,7 @@ void MetaBlkService::alloc_meta_blk(BlkId& bid) {
 sisl::byte_array MetaBlkService::read_sub_sb_internal(const meta_blk* mblk) const {
     sisl::byte_array buf;
     HS_DBG_ASSERT_EQ(mblk != nullptr, true);
+    if (auto const e = journaled(mblk->hdr.h.bid); e) { return read_journal_rec(*e); }
     if (mblk->hdr.h.context_sz <= meta_blk_context_sz()) {
         // data can be compressed
         // TO DO: Might need to address alignment based on data or fast type
@@ -1130,11 +1761,82 @@ void MetaBlkService::recover(bool do_comp_cb) {
         recover_meta_sub_type(do_comp_cb, subtype);
     }
 
-    // TODO: for independent subsystems, we can use concurrent recovery if necessary.
+    std::vector< meta_sub_type > independent_subtypes;
     for (auto const& x : m_sub_info) {
-        auto& reg_info = x.second;
-        if (!reg_info.has_deps) { recover_meta_sub_type(do_comp_cb, x.first); }
+        if (!x.second.has_deps) { independent_subtypes.push_back(x.first); }
+    }
+
+    if (HS_DYNAMIC_CONFIG(metablk.parallel_recovery) && (independent_subtypes.size() > 1)) {
+        recover_meta_sub_types_parallel(do_comp_cb, independent_subtypes);
+    } else {
+        for (auto const& subtype : independent_subtypes) {
+            recover_meta_sub_type(do_comp_cb, subtype);
+        }
+    }
+}
+
+// Runs each of the tasks on a sync io fiber of a worker and waits for all of them to complete
+static void run_on_workers(std::vector< std::function< void() > >&& tasks) {
+    std::vector< folly::Future< folly::Unit > > futs;
+    futs.reserve(tasks.size());
+    for (auto& task : tasks) {
+        auto p = std::make_shared< folly::Promise< folly::Unit > >();
+        futs.emplace_back(p->getFuture());
+        iomanager.run_on_forget(iomgr::reactor_regex::random_worker, iomgr::fiber_regex::syncio_only,
+                                [p, task = std::move(task)]() {
+                                    task();
+                                    p->setValue();
+                                });
+    }
+    folly::collectAllUnsafe(futs).wait();
+}
+
+void MetaBlkService::recover_meta_sub_types_parallel(bool do_comp_cb, const std::vector< meta_sub_type >& sub_types) {
+    auto const recovery_start = Clock::now();
+
+    // Meta blks of each subtype are looked up before any callback is sent, as the callbacks can add or remove meta
+    // blks of their own while the others are still being recovered
+    std::vector< std::vector< meta_blk* > > mblks(sub_types.size());
+    std::vector< std::vector< sisl::byte_array > > bufs(sub_types.size());
+    size_t num_mblks{0};
+    for (size_t i{0}; i < sub_types.size(); ++i) {
+        for (const auto& m : m_sub_info[sub_types[i]].meta_bids) {
+            mblks[i].push_back(m_meta_blks[m]);
+        }
+        num_mblks += mblks[i].size();
+    }
+
+    // Contexts are read before any callback is sent, so that reading the ovf blks doesn't race with the updates of
+    // the callbacks
+    std::vector< std::function< void() > > tasks;
+    for (size_t i{0}; i < sub_types.size(); ++i) {
+        tasks.emplace_back([this, &mblks, &bufs, i]() {
+            bufs[i].reserve(mblks[i].size());
+            for (auto* mblk : mblks[i]) {
+                bufs[i].push_back(read_sub_sb_internal(mblk));
+            }
+        });
     }
+    run_on_workers(std::move(tasks));
+
+    tasks.clear();
+    for (size_t i{0}; i < sub_types.size(); ++i) {
+        auto it = m_sub_info.find(sub_types[i]);
+        tasks.emplace_back([this, &mblks, &bufs, do_comp_cb, i, &reg_info = it->second, sub_type = sub_types[i]]() {
+            for (size_t j{0}; j < mblks[i].size(); ++j) {
+                recover_meta_block(mblks[i][j], bufs[i][j]);
+                bufs[i][j].reset();
+            }
+            if (do_comp_cb && reg_info.comp_cb) {
+                reg_info.comp_cb(true);
+                HS_LOG(DEBUG, metablk, "[type={}] completion callback sent.", sub_type);
+            }
+        });
+    }
+    run_on_workers(std::move(tasks));
+
+    HS_LOG(INFO, metablk, "Recovered {} meta blks of {} independent subtypes in parallel in {} ms", num_mblks,
+           sub_types.size(), get_elapsed_time_ms(recovery_start));
 }
 
 void MetaBlkService::recover_meta_sub_type(bool do_comp_cb, const meta_sub_type& sub_type) {
@@ -1149,16 +1851,26 @@ void MetaBlkService::recover_meta_sub_type(bool do_comp_cb, const meta_sub_type&
     }
 }
 
-void MetaBlkService::recover_meta_block(meta_blk* mblk) {
-    auto buf = read_sub_sb_internal(mblk);
+void MetaBlkService::recover_meta_block(meta_blk* mblk) { recover_meta_block(mblk, read_sub_sb_cached(mblk)); }
+
+void MetaBlkService::recover_meta_block(meta_blk* mblk, const sisl::byte_array& buf) {
     // found a meta blk and callback to sub system;
     const auto itr = m_sub_info.find(mblk->hdr.h.type);
     if (itr != std::end(m_sub_info)) {
+        // journaled content is read from its record, the meta blk hdr describes the content in the chain
+        auto const jentry = journaled(mblk->hdr.h.bid);
+        if (jentry) {
+            HS_REL_ASSERT_EQ(buf->size(), jentry->sz, "[type={}] journaled size mismatch", mblk->hdr.h.type);
+        }
+        auto const context_sz = jentry ? jentry->sz : uint64_cast(mblk->hdr.h.context_sz);
+        auto const expected_crc = jentry ? jentry->crc : uint32_cast(mblk->hdr.h.crc);
+        auto const is_crc32c = jentry ? jentry->crc32c : (mblk->hdr.h.version >= META_BLK_CRC32C_VERSION);
+
         // if subsystem registered crc protection, verify crc before sending to subsystem;
         if (itr->second.do_crc) {
-            const auto crc = crc32_ieee(init_crc32, buf->cbytes(), mblk->hdr.h.context_sz);
-            HS_REL_ASSERT_EQ(crc, uint32_cast(mblk->hdr.h.crc), "CRC mismatch: {}/{}, meta_blk details: {}", crc,
-                             uint32_cast(mblk->hdr.h.crc), mblk->hdr.h.to_string());
+            const auto crc = meta_crc(is_crc32c, buf->cbytes(), context_sz);
+            HS_REL_ASSERT_EQ(crc, expected_crc, "CRC mismatch: {}/{}, meta_blk details: {}", crc, expected_crc,
+                             mblk->hdr.h.to_string());
         } else {
             HS_LOG(DEBUG, metablk, "[type={}] meta blk found with bypassing crc.", mblk->hdr.h.type);
         }
@@ -1167,19 +1879,17 @@ void MetaBlkService::recover_meta_block(meta_blk* mblk) {
         auto& cb = itr->second.cb;
         if (cb) { // cb could be nullptr because client want to get its superblock via read api;
             // decompress if necessary
-            if (mblk->hdr.h.compressed) {
+            if (!jentry && mblk->hdr.h.compressed) {
                 // HS_DBG_ASSERT_GE(mblk->hdr.h.context_sz, META_BLK_CONTEXT_SZ);
                 // TO DO: Might need to address alignment based on data or fast type
                 auto decompressed_buf{hs_utils::make_byte_array(mblk->hdr.h.src_context_sz, true /* aligned */,
                                                                 sisl::buftag::compression, align_size())};
                 size_t decompressed_size = mblk->hdr.h.src_context_sz;
-                const auto ret{sisl::Compress::decompress(r_cast< const char* >(buf->cbytes()),
-                                                          r_cast< char* >(decompressed_buf->bytes()),
-                                                          mblk->hdr.h.compressed_sz, &decompressed_size)};
-                if (ret != 0) {
-                    LOGERROR("[type={}], negative result: {} from decompress trying to decompress the "
-                             "data. compressed_sz: {}, src_context_sz: {}",
-                             mblk->hdr.h.type, ret, uint64_cast(mblk->hdr.h.compressed_sz),
+                if (!decompress(s_cast< meta_compress_codec_t >(mblk->hdr.h.codec), buf->cbytes(),
+                                mblk->hdr.h.compressed_sz, decompressed_buf->bytes(), decompressed_size)) {
+                    LOGERROR("[type={}], failed to decompress the data with codec: {}, compressed_sz: {}, "
+                             "src_context_sz: {}",
+                             mblk->hdr.h.type, uint32_cast(mblk->hdr.h.codec), uint64_cast(mblk->hdr.h.compressed_sz),
                              uint64_cast(mblk->hdr.h.src_context_sz));
                     HS_REL_ASSERT(false, "failed to decompress");
                 } else {
@@ -1198,11 +1908,10 @@ void MetaBlkService::recover_meta_block(meta_blk* mblk) {
             } else {
                 // There is use case that cb could be nullptr because client want to get its superblock via
                 // read api;
-                cb(mblk, buf, mblk->hdr.h.context_sz);
+                cb(mblk, buf, context_sz);
             }
 
-            HS_LOG(DEBUG, metablk, "[type={}] meta blk sent with size: {}.", mblk->hdr.h.type,
-                   uint64_cast(mblk->hdr.h.context_sz));
+            HS_LOG(DEBUG, metablk, "[type={}] meta blk sent with size: {}.", mblk->hdr.h.type, context_sz);
         }
     } else {
         HS_LOG(DEBUG, metablk, "[type={}], unregistered client found. ");
@@ -1236,11 +1945,11 @@ void MetaBlkService::read_sub_sb(meta_sub_type type) {
         // This assert can be removed if any client writes compressed data who calls read_sub_sb to read it
         // back;
         //
-        sisl::byte_array buf = read_sub_sb_internal(mblk);
+        sisl::byte_array buf = read_sub_sb_cached(mblk);
 
         // if consumer is reading its sbs with this api, the blk found cb should already be registered;
         HS_REL_ASSERT_EQ(it_s->second.cb.operator bool(), true);
-        it_s->second.cb(mblk, buf, mblk->hdr.h.context_sz);
+        it_s->second.cb(mblk, buf, journaled(mblk->hdr.h.bid) ? buf->size() : uint64_cast(mblk->hdr.h.context_sz));
     }
 
     // if is allowed if consumer doesn't care about complete cb, e.g. consumer knows how many mblks it is
@@ -1268,8 +1977,145 @@ uint64_t MetaBlkService::meta_size(const void* cookie) const {
 
 bool MetaBlkService::get_skip_hdr_check() const { return HS_DYNAMIC_CONFIG(metablk.skip_header_size_check); }
 
-uint64_t MetaBlkService::min_compress_size() const {
-    return HS_DYNAMIC_CONFIG(metablk.min_compress_size_mb) * uint64_cast(1024) * 1024;
+// Callers get a buffer of their own, as the consumers can keep the buffer as their superblock and modify it in place
+sisl::byte_array MetaBlkService::copy_buf(const sisl::byte_array& buf) const {
+    auto copy = hs_utils::make_byte_array(buf->size(), is_aligned_buf_needed(buf->size()), sisl::buftag::metablk,
+                                          align_size());
+    std::memcpy(copy->bytes(), buf->cbytes(), buf->size());
+    return copy;
+}
+
+sisl::byte_array MetaBlkService::read_sub_sb_cached(const meta_blk* mblk) {
+    auto const cache_limit = HS_DYNAMIC_CONFIG(metablk.read_cache_size_kb) * uint64_cast(1024);
+    if (cache_limit == 0) { return read_sub_sb_internal(mblk); }
+
+    auto const key = mblk->hdr.h.bid.to_integer();
+    uint64_t gen;
+    {
+        std::lock_guard< std::mutex > lg{m_read_cache_mtx};
+        if (auto it = m_read_cache.find(key); it != m_read_cache.end()) {
+            m_read_cache_lru.splice(m_read_cache_lru.begin(), m_read_cache_lru, it->second.lru_it);
+            COUNTER_INCREMENT(m_metrics, read_cache_hit_cnt, 1);
+            return copy_buf(it->second.buf);
+        }
+        gen = m_read_cache_gen;
+    }
+
+    COUNTER_INCREMENT(m_metrics, read_cache_miss_cnt, 1);
+    auto buf = read_sub_sb_internal(mblk);
+    if (buf->size() > cache_limit) { return buf; }
+
+    std::lock_guard< std::mutex > lg{m_read_cache_mtx};
+    // skip caching if any meta blk was written meanwhile, the read could be of the content it replaced
+    if ((gen != m_read_cache_gen) || m_read_cache.contains(key)) { return buf; }
+
+    m_read_cache_lru.push_front(key);
+    m_read_cache.emplace(key, read_cache_entry{copy_buf(buf), m_read_cache_lru.begin()});
+    m_read_cache_size += buf->size();
+    while (m_read_cache_size > cache_limit) {
+        auto it = m_read_cache.find(m_read_cache_lru.back());
+        m_read_cache_size -= it->second.buf->size();
+        m_read_cache.erase(it);
+        m_read_cache_lru.pop_back();
+    }
+    return buf;
+}
+
+void MetaBlkService::invalidate_read_cache(const BlkId& bid) {
+    std::lock_guard< std::mutex > lg{m_read_cache_mtx};
+    ++m_read_cache_gen;
+    if (auto it = m_read_cache.find(bid.to_integer()); it != m_read_cache.end()) {
+        m_read_cache_size -= it->second.buf->size();
+        m_read_cache_lru.erase(it->second.lru_it);
+        m_read_cache.erase(it);
+    }
+}
+
+void MetaBlkService::clear_read_cache() {
+    std::lock_guard< std::mutex > lg{m_read_cache_mtx};
+    ++m_read_cache_gen;
+    m_read_cache.clear();
+    m_read_cache_lru.clear();
+    m_read_cache_size = 0;
+}
+
+uint64_t MetaBlkService::min_compress_size(meta_compress_codec_t codec) const {
+    if (codec == meta_compress_codec_t::DEFAULT) {
+        return HS_DYNAMIC_CONFIG(metablk.min_compress_size_mb) * uint64_cast(1024) * 1024;
+    }
+    return HS_DYNAMIC_CONFIG(metablk.min_lz4_compress_size_kb) * uint64_cast(1024);
+}
+
+uint64_t MetaBlkService::max_compress_len(meta_compress_codec_t codec, uint64_t sz) const {
+    if (codec == meta_compress_codec_t::DEFAULT) { return sisl::Compress::max_compress_len(sz); }
+    return uint64_cast(LZ4_compressBound(int_cast(sz)));
+}
+
+// The lz4 codecs compress with a state that is allocated once per thread and reused, instead of letting lz4 set up a
+// new one on every call; the HC state is a few hundred KB, so it is only created on the threads that need it.
+static LZ4_stream_t* lz4_fast_state() {
+    thread_local std::unique_ptr< LZ4_stream_t > s_state{std::make_unique< LZ4_stream_t >()};
+    return s_state.get();
+}
+
+static LZ4_streamHC_t* lz4_hc_state() {
+    thread_local std::unique_ptr< LZ4_streamHC_t > s_state{std::make_unique< LZ4_streamHC_t >()};
+    return s_state.get();
+}
+
+// returns the compressed size, 0 on failure
+size_t MetaBlkService::compress(meta_compress_codec_t codec, const uint8_t* src, uint64_t sz, uint8_t* dst,
+                                uint64_t dst_sz) const {
+    switch (codec) {
+    case meta_compress_codec_t::LZ4:
+        return std::max(LZ4_compress_fast_extState(lz4_fast_state(), r_cast< const char* >(src), r_cast< char* >(dst),
+                                                   int_cast(sz), int_cast(dst_sz), 1 /* acceleration */),
+                        0);
+    case meta_compress_codec_t::LZ4HC:
+        return std::max(LZ4_compress_HC_extStateHC(lz4_hc_state(), r_cast< const char* >(src), r_cast< char* >(dst),
+                                                   int_cast(sz), int_cast(dst_sz), LZ4HC_CLEVEL_DEFAULT),
+                        0);
+    default: {
+        size_t compressed_size = dst_sz;
+        const auto ret =
+            sisl::Compress::compress(r_cast< const char* >(src), r_cast< char* >(dst), sz, &compressed_size);
+        if (ret != 0) {
+            LOGERROR("hs_compress_default indicates a failure trying to compress the data, ret: {}", ret);
+            return 0;
+        }
+        return compressed_size;
+    }
+    }
+}
+
+bool MetaBlkService::decompress(meta_compress_codec_t codec, const uint8_t* src, uint64_t sz, uint8_t* dst,
+                                size_t& decompressed_sz) const {
+    switch (codec) {
+    case meta_compress_codec_t::LZ4:
+    case meta_compress_codec_t::LZ4HC: {
+        // both lz4 codecs produce the same block format
+        const auto ret = LZ4_decompress_safe(r_cast< const char* >(src), r_cast< char* >(dst), int_cast(sz),
+                                             int_cast(decompressed_sz));
+        if (ret < 0) {
+            LOGERROR("negative result: {} from lz4 trying to decompress the data", ret);
+            return false;
+        }
+        decompressed_sz = s_cast< size_t >(ret);
+        return true;
+    }
+    case meta_compress_codec_t::DEFAULT: {
+        const auto ret = sisl::Compress::decompress(r_cast< const char* >(src), r_cast< char* >(dst), sz,
+                                                    &decompressed_sz);
+        if (ret != 0) {
+            LOGERROR("negative result: {} from sisl trying to decompress the data", ret);
+            return false;
+        }
+        return true;
+    }
+    default:
+        LOGERROR("unknown compress codec: {}", uint32_cast(codec));
+        return false;
+    }
 }
 
 uint64_t MetaBlkService::max_compress_memory_size() const {
@@ -1538,7 +2384,7 @@ nlohmann::json MetaBlkService::populate_json(int log_level, meta_blk_map_t& meta
                             continue;
                         }
 
-                        sisl::byte_array buf = read_sub_sb_internal(it->second);
+                        sisl::byte_array buf = read_sub_sb_cached(it->second);
                         if (free_space < buf->size()) {
                             j[x.first]["meta_bids"][std::to_string(bid_cnt)] =
                                 "Not_able_to_dump_to_file_exceeding_allowed_space";
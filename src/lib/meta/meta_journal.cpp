@@ -0,0 +1,277 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include <sisl/fds/utils.hpp>
+#include <homestore/crc.h>
+#include <homestore/meta_service.hpp>
+#include <homestore/homestore.hpp>
+#include "common/homestore_assert.hpp"
+#include "common/homestore_config.hpp"
+#include "common/homestore_utils.hpp"
+#include "device/virtual_dev.hpp"
+#include "meta_sb.hpp"
+
+SISL_LOGGING_DECL(metablk)
+
+namespace homestore {
+
+//
+// Update journal
+//
+// Updates of sub sbs upto metablk.journal_max_record_kb are appended as records to a contiguous extent of the meta
+// vdev, instead of rewriting the meta blk and its ovf chain in place, so they are sequential writes of a single io.
+// The in-memory index points each journaled meta blk to its latest record, which is what it is read from. Once the
+// extent is full, the latest content of every journaled meta blk is written to the chain and the journal epoch is
+// bumped in the ssb, which voids all the records appended so far. On recovery, the extent is read with one
+// sequential read after the chain is loaded, and the records of the current epoch with a higher gen_cnt than their
+// meta blk in the chain take over.
+//
+// Adds and removes still go through the chain, so the chain remains the source of truth for which meta blks exist.
+//
+
+uint32_t MetaBlkService::journal_rec_nblks(uint64_t sz) const {
+    return uint32_cast(sisl::round_up(sizeof(meta_journal_rec_hdr) + sz, block_size()) / block_size());
+}
+
+bool MetaBlkService::can_journal(uint64_t sz) const {
+    auto const journal_blks = m_ssb->journal_bid.is_valid()
+        ? uint64_cast(m_ssb->journal_bid.blk_count())
+        : HS_DYNAMIC_CONFIG(metablk.journal_size_mb) * uint64_cast(1024) * 1024 / block_size();
+    return (HS_DYNAMIC_CONFIG(metablk.journal_size_mb) != 0) &&
+        (sz <= HS_DYNAMIC_CONFIG(metablk.journal_max_record_kb) * uint64_cast(1024)) &&
+        (journal_rec_nblks(sz) <= journal_blks);
+}
+
+std::optional< MetaBlkService::journal_entry > MetaBlkService::journaled(const BlkId& mblk_bid) const {
+    std::lock_guard< std::mutex > lg{m_journal_mtx};
+    auto const it = m_journal_index.find(mblk_bid.to_integer());
+    if (it == m_journal_index.end()) { return std::nullopt; }
+    return it->second;
+}
+
+bool MetaBlkService::journal_update(meta_blk* mblk, const uint8_t* context_data, uint64_t sz) {
+    HS_DBG_ASSERT(m_meta_mtx.try_lock() == false, "mutex should be already be locked");
+    if (!can_journal(sz)) { return false; }
+
+    if (!m_ssb->journal_bid.is_valid()) {
+        auto const nblks = std::min(HS_DYNAMIC_CONFIG(metablk.journal_size_mb) * uint64_cast(1024) * 1024 /
+                                        block_size(),
+                                    uint64_cast(max_blks_per_blkid()));
+        BlkId bid;
+        blk_alloc_hints hints;
+        hints.is_contiguous = true;
+        if (m_sb_vdev->alloc_contiguous_blks(blk_count_t(nblks), hints, bid) != BlkAllocStatus::SUCCESS) {
+            HS_LOG_EVERY_N(WARN, metablk, 100, "Failed to allocate {} contiguous blks for the update journal", nblks);
+            return false;
+        }
+        m_ssb->journal_bid = bid;
+        m_ssb->journal_epoch = 1;
+        write_ssb();
+        reset_journal();
+        HS_LOG(INFO, metablk, "Update journal created at {}", bid.to_string());
+    }
+
+    auto const nblks = journal_rec_nblks(sz);
+    if (m_journal_offset + nblks > m_ssb->journal_bid.blk_count()) {
+        compact_journal();
+        if (nblks > m_ssb->journal_bid.blk_count()) { return false; }
+    }
+
+    uint64_t gen_cnt = mblk->hdr.h.gen_cnt;
+    if (auto const e = journaled(mblk->hdr.h.bid); e) { gen_cnt = std::max(gen_cnt, e->gen_cnt); }
+    auto const entry = append_journal_rec(mblk->hdr.h.bid, gen_cnt + 1, context_data, sz, false /* tombstone */);
+    {
+        std::lock_guard< std::mutex > lg{m_journal_mtx};
+        m_journal_index[mblk->hdr.h.bid.to_integer()] = entry;
+    }
+    invalidate_read_cache(mblk->hdr.h.bid);
+    COUNTER_INCREMENT(m_metrics, journal_update_cnt, 1);
+    return true;
+}
+
+MetaBlkService::journal_entry MetaBlkService::append_journal_rec(const BlkId& mblk_bid, uint64_t gen_cnt,
+                                                                 const uint8_t* context_data, uint64_t sz,
+                                                                 bool tombstone) {
+    auto const nblks = journal_rec_nblks(sz);
+    HS_REL_ASSERT_LE(m_journal_offset + nblks, m_ssb->journal_bid.blk_count(), "update journal overflow");
+
+    auto const buf_sz = uint64_cast(nblks) * block_size();
+    auto* buf = hs_utils::iobuf_alloc(buf_sz, sisl::buftag::metablk, align_size());
+    std::memset(buf, 0, sizeof(meta_journal_rec_hdr));
+    auto* hdr = r_cast< meta_journal_rec_hdr* >(buf);
+    hdr->magic = META_JOURNAL_REC_MAGIC;
+    hdr->epoch = m_ssb->journal_epoch;
+    hdr->seq_num = m_journal_seq++;
+    hdr->mblk_bid = mblk_bid.to_integer();
+    hdr->gen_cnt = gen_cnt;
+    hdr->context_sz = sz;
+    hdr->tombstone = tombstone ? 1 : 0;
+    hdr->crc32c = 1;
+    if (sz) {
+        std::memcpy(buf + sizeof(meta_journal_rec_hdr), context_data, sz);
+        hdr->crc = meta_crc(true /* crc32c */, context_data, sz);
+    }
+    hdr->hdr_crc = meta_crc(true /* crc32c */, buf, sizeof(meta_journal_rec_hdr));
+
+    BlkId const rec_bid{m_ssb->journal_bid.blk_num() + blk_num_t(m_journal_offset), blk_count_t(nblks),
+                        m_ssb->journal_bid.chunk_num()};
+    auto error = m_sb_vdev->sync_write(r_cast< const char* >(buf), buf_sz, rec_bid);
+    HS_REL_ASSERT(!error, "error happens during write of journal record: {}, bid: {}", error.message(),
+                  rec_bid.to_string());
+    hs_utils::iobuf_free(buf, sisl::buftag::metablk);
+
+    journal_entry const entry{m_journal_offset, nblks, gen_cnt, sz, hdr->crc, true /* crc32c */};
+    m_journal_offset += nblks;
+    m_journal_bids.insert(mblk_bid.to_integer());
+    return entry;
+}
+
+sisl::byte_array MetaBlkService::read_journal_rec(const journal_entry& e) const {
+    auto const buf_sz = uint64_cast(e.nblks) * block_size();
+    auto* rec = hs_utils::iobuf_alloc(buf_sz, sisl::buftag::metablk, align_size());
+    BlkId const rec_bid{m_ssb->journal_bid.blk_num() + blk_num_t(e.offset), blk_count_t(e.nblks),
+                        m_ssb->journal_bid.chunk_num()};
+    read(rec_bid, rec, buf_sz);
+
+    auto buf = hs_utils::make_byte_array(e.sz, is_aligned_buf_needed(e.sz), sisl::buftag::metablk, align_size());
+    std::memcpy(buf->bytes(), rec + sizeof(meta_journal_rec_hdr), e.sz);
+    hs_utils::iobuf_free(rec, sisl::buftag::metablk);
+    return buf;
+}
+
+void MetaBlkService::journal_drop(meta_blk* mblk) {
+    std::lock_guard< std::mutex > lg{m_journal_mtx};
+    auto const it = m_journal_index.find(mblk->hdr.h.bid.to_integer());
+    if (it == m_journal_index.end()) { return; }
+    mblk->hdr.h.gen_cnt = std::max(uint64_cast(mblk->hdr.h.gen_cnt), it->second.gen_cnt);
+    m_journal_index.erase(it);
+}
+
+void MetaBlkService::journal_remove(meta_blk* mblk) {
+    {
+        std::lock_guard< std::mutex > lg{m_journal_mtx};
+        m_journal_index.erase(mblk->hdr.h.bid.to_integer());
+    }
+    if (!m_journal_bids.contains(mblk->hdr.h.bid.to_integer())) { return; }
+
+    if (m_journal_offset + journal_rec_nblks(0) > m_ssb->journal_bid.blk_count()) {
+        // compaction voids all the records, so no tombstone is needed anymore
+        compact_journal();
+        return;
+    }
+    append_journal_rec(mblk->hdr.h.bid, mblk->hdr.h.gen_cnt, nullptr, 0, true /* tombstone */);
+}
+
+//
+// Crash at any point of the compaction is safe: the chain writes bump gen_cnt past the records they compact, and the
+// records are voided only once the ssb with the new epoch is written.
+//
+void MetaBlkService::compact_journal() {
+    auto const compact_start = Clock::now();
+    std::unordered_map< uint64_t, journal_entry > index;
+    {
+        std::lock_guard< std::mutex > lg{m_journal_mtx};
+        index = m_journal_index;
+    }
+
+    for (auto const& [bid, e] : index) {
+        auto* mblk = m_meta_blks.at(bid);
+        auto const buf = read_journal_rec(e);
+        do_update_sub_sb(buf->cbytes(), buf->size(), mblk, false /* use_journal */);
+    }
+
+    m_ssb->journal_epoch += 1;
+    write_ssb();
+    reset_journal();
+
+    COUNTER_INCREMENT(m_metrics, journal_compact_cnt, 1);
+    HS_LOG(INFO, metablk, "Compacted {} journaled meta blks into the chain in {} ms, journal epoch: {}", index.size(),
+           get_elapsed_time_ms(compact_start), m_ssb->journal_epoch);
+}
+
+void MetaBlkService::reset_journal() {
+    std::lock_guard< std::mutex > lg{m_journal_mtx};
+    m_journal_index.clear();
+    m_journal_bids.clear();
+    m_journal_offset = 0;
+    m_journal_seq = 0;
+}
+
+void MetaBlkService::load_journal() {
+    std::lock_guard< decltype(m_meta_mtx) > lg{m_meta_mtx};
+    reset_journal();
+    if (!m_ssb->journal_bid.is_valid()) { return; }
+
+    auto const jbid = m_ssb->journal_bid;
+    auto const alloc_status = m_sb_vdev->commit_blk(jbid);
+    HS_REL_ASSERT_EQ(alloc_status, BlkAllocStatus::SUCCESS, "Failed to commit journal blk: {}", jbid.to_string());
+
+    auto const nblks = uint64_cast(jbid.blk_count());
+    auto const bs = block_size();
+    auto* jbuf = hs_utils::iobuf_alloc(nblks * bs, sisl::buftag::metablk, align_size());
+    read(jbid, jbuf, nblks * bs);
+
+    // Records of the current epoch in the order they were appended
+    std::map< uint64_t, std::pair< const meta_journal_rec_hdr*, uint64_t /* offset */ > > recs;
+    uint64_t off{0};
+    while (off < nblks) {
+        auto* hdr = r_cast< meta_journal_rec_hdr* >(jbuf + off * bs);
+        meta_journal_rec_hdr h = *hdr;
+        h.hdr_crc = 0;
+        auto const rec_nblks = (hdr->magic == META_JOURNAL_REC_MAGIC) ? journal_rec_nblks(hdr->context_sz) : 0;
+        if ((rec_nblks == 0) || (off + rec_nblks > nblks) ||
+            (meta_crc(hdr->crc32c, r_cast< const uint8_t* >(&h), sizeof(h)) != hdr->hdr_crc)) {
+            ++off;
+            continue;
+        }
+        if ((hdr->epoch == m_ssb->journal_epoch) &&
+            ((hdr->context_sz == 0) ||
+             (meta_crc(hdr->crc32c, jbuf + off * bs + sizeof(meta_journal_rec_hdr), hdr->context_sz) == hdr->crc))) {
+            recs.emplace(hdr->seq_num, std::make_pair(hdr, off));
+        }
+        off += rec_nblks;
+    }
+
+    for (auto const& [seq, rec] : recs) {
+        auto const* hdr = rec.first;
+        auto const rec_nblks = journal_rec_nblks(hdr->context_sz);
+        m_journal_bids.insert(hdr->mblk_bid);
+        m_journal_seq = seq + 1;
+        m_journal_offset = std::max(m_journal_offset, rec.second + rec_nblks);
+
+        if (hdr->tombstone) {
+            m_journal_index.erase(hdr->mblk_bid);
+            continue;
+        }
+        auto const it = m_meta_blks.find(hdr->mblk_bid);
+        if ((it == m_meta_blks.end()) || (hdr->gen_cnt <= it->second->hdr.h.gen_cnt)) {
+            // meta blk is gone, or the chain was rewritten after this record
+            continue;
+        }
+        m_journal_index[hdr->mblk_bid] =
+            journal_entry{rec.second, rec_nblks, hdr->gen_cnt, hdr->context_sz, hdr->crc, bool(hdr->crc32c)};
+    }
+    hs_utils::iobuf_free(jbuf, sisl::buftag::metablk);
+
+    HS_LOG(INFO, metablk, "Loaded update journal {}, epoch: {}, records: {}, journaled meta blks: {}, next offset: {}",
+           jbid.to_string(), m_ssb->journal_epoch, recs.size(), m_journal_index.size(), m_journal_offset);
+}
+
+} // namespace homestore
@@ -24,15 +24,19 @@
 #include <string>
 
 #include <homestore/blk.h>
+#include <homestore/crc.h>
 #include <homestore/homestore.hpp>
+#include <homestore/meta_service.hpp>
 
 namespace homestore {
 static constexpr uint32_t META_BLK_HDR_MAX_SZ{512}; // max meta_blk_hdr size
 static constexpr uint32_t META_BLK_MAGIC{0xCEEDBEED};
 static constexpr uint32_t META_BLK_OVF_MAGIC{0xDEADBEEF};
 static constexpr uint32_t META_BLK_SB_MAGIC{0xABCDCEED};
+static constexpr uint32_t META_JOURNAL_REC_MAGIC{0xCEEDFEED};
 static constexpr uint32_t META_BLK_SB_VERSION{0x1};
-static constexpr uint32_t META_BLK_VERSION{0x1};
+static constexpr uint32_t META_BLK_VERSION{0x2};
+static constexpr uint32_t META_BLK_CRC32C_VERSION{0x2}; // meta blks of older versions are crc'ed with crc32 ieee
 static constexpr uint32_t MAX_SUBSYS_TYPE_LEN{64};
 static constexpr uint32_t CONTEXT_DATA_OFFSET_ALIGNMENT{64};
 
@@ -92,6 +96,10 @@ struct MetaSubRegInfo {
     meta_blk_found_cb_t cb{nullptr};
     meta_blk_recover_comp_cb_t comp_cb{nullptr};
     bool has_deps{false};
+    meta_compress_codec_t codec{meta_compress_codec_t::DEFAULT}; // codec for new writes of this client
+    bool hot{false};                  // frequently updated, its ovf blks are allocated as hot blks
+    uint32_t window_updates{0};       // updates in the current classification window
+    Clock::time_point window_start{}; // start of the current classification window
 };
 
 // meta blk super block put as 1st block in the block chain;
@@ -103,13 +111,42 @@ struct meta_blk_sb {
     BlkId bid;
     uint8_t migrated;
     uint8_t pad[7];
+    BlkId journal_bid;      // extent of the update journal, invalid until the journal is first used
+    uint64_t journal_epoch; // journal records of older epochs are already compacted into the meta blk chain
     std::string to_string() const {
-        return fmt::format("magic: {}, version: {}, next_bid: {}, self_bid: {}", magic, version, next_bid.to_string(),
-                           bid.to_string());
+        return fmt::format("magic: {}, version: {}, next_bid: {}, self_bid: {}, journal_bid: {}, journal_epoch: {}",
+                           magic, version, next_bid.to_string(), bid.to_string(), journal_bid.to_string(),
+                           journal_epoch);
     }
 };
 #pragma pack()
 
+//
+// Record of the update journal. Records are appended back to back into the journal extent from its start, each one
+// starting at a blk boundary with the context data right after the header. A record supersedes the content of its
+// meta blk in the chain, if its gen_cnt is higher than the one of the meta blk;
+//
+#pragma pack(1)
+struct meta_journal_rec_hdr {
+    uint32_t magic;
+    uint32_t hdr_crc;    // crc of this header, computed with hdr_crc as 0
+    uint64_t epoch;      // journal epoch the record is appended in
+    uint64_t seq_num;    // order of the record within the epoch
+    uint64_t mblk_bid;   // meta blk the record belongs to
+    uint64_t gen_cnt;    // gen_cnt of the meta blk with this content
+    uint64_t context_sz; // size of the context data following the header
+    uint32_t crc;        // crc of the context data
+    uint8_t tombstone;   // meta blk is removed, earlier records of it are void
+    uint8_t crc32c;      // both crcs are crc32c, else crc32 ieee as by the older records
+    uint8_t pad[2];
+};
+#pragma pack()
+
+// Crc of the context data of a meta blk or of a journal record, or of a journal record header
+inline crc32_t meta_crc(bool is_crc32c, const uint8_t* data, uint64_t sz) {
+    return is_crc32c ? crc32c(init_crc32, data, sz) : crc32_ieee(init_crc32, data, sz);
+}
+
 //
 // 1. If overflow blkid is invalid, meaning context_sz is not larger than context_data_size(),
 //    context data is stored in context_data field;
@@ -131,14 +168,16 @@ struct meta_blk_hdr_s {
     uint64_t src_context_sz;        // context_sz before compression, this field only valid when compressed is true;
     char type[MAX_SUBSYS_TYPE_LEN]; // sub system type;
     uint8_t compressed;             // context data compression bitword
-    uint8_t pad[7];
+    uint8_t codec;                  // meta_compress_codec_t of the context data, only valid when compressed is true;
+    uint8_t pad[6];
 
     std::string to_string() const {
         return fmt::format(
             "magic: {}, type: {}, version: {}, gen_cnt: {}, crc: {}, next_bid: {}, prev_bid: {}, "
-            "ovf_bid: {}, self_bid: {}, context_sz: {}, compressed_sz: {}, src_context_sz : {}, compressed: {} ",
+            "ovf_bid: {}, self_bid: {}, context_sz: {}, compressed_sz: {}, src_context_sz : {}, compressed: {}, "
+            "codec: {} ",
             magic, type, version, gen_cnt, crc, next_bid.to_string(), prev_bid.to_string(), ovf_bid.to_string(),
-            bid.to_string(), context_sz, compressed_sz, src_context_sz, compressed);
+            bid.to_string(), context_sz, compressed_sz, src_context_sz, compressed, codec);
     }
 };
 #pragma pack()
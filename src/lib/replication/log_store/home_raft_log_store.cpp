@@ -88,7 +88,8 @@ HomeRaftLogStore::HomeRaftLogStore(logdev_id_t logdev_id, logstore_id_t logstore
     m_dummy_log_entry = nuraft::cs_new< nuraft::log_entry >(0, nuraft::buffer::alloc(0), nuraft::log_val_type::app_log);
 
     if (logstore_id == UINT32_MAX) {
-        m_logdev_id = logstore_service().create_new_logdev();
+        // A new logstore is created in the logdev passed, which could be shared with other logstores, or in a new one
+        m_logdev_id = (logdev_id == UINT32_MAX) ? logstore_service().create_new_logdev() : logdev_id;
         m_log_store = logstore_service().create_new_log_store(m_logdev_id, true);
         if (!m_log_store) { throw std::runtime_error("Failed to create log store"); }
         m_logstore_id = m_log_store->get_store_id();
@@ -195,14 +196,13 @@ void HomeRaftLogStore::end_of_append_batch(ulong start, ulong cnt) {
 
 nuraft::ptr< std::vector< nuraft::ptr< nuraft::log_entry > > > HomeRaftLogStore::log_entries(ulong start, ulong end) {
     auto out_vec = std::make_shared< std::vector< nuraft::ptr< nuraft::log_entry > > >();
-    m_log_store->foreach (to_store_lsn(start), [end, &out_vec](store_lsn_t cur, const log_buffer& entry) -> bool {
-        bool ret = (cur < to_store_lsn(end) - 1);
-        if (cur < to_store_lsn(end)) {
-            // REPL_STORE_LOG(TRACE, "log_entries lsn={}", cur + 1);
-            out_vec->emplace_back(to_nuraft_log_entry(entry));
-        }
-        return ret;
-    });
+    if (end <= start) { return out_vec; }
+
+    auto const entries = m_log_store->async_read_range(to_store_lsn(start), to_store_lsn(end) - 1).get();
+    out_vec->reserve(entries.size());
+    for (auto const& entry : entries) {
+        out_vec->emplace_back(to_nuraft_log_entry(entry));
+    }
     REPL_STORE_LOG(TRACE, "Num log entries start={} end={} num_entries={}", start, end, out_vec->size());
     return out_vec;
 }
@@ -258,24 +258,21 @@ raft_buf_ptr_t HomeRaftLogStore::pack(ulong index, int32_t cnt) {
     raft_buf_ptr_t out_buf = nuraft::buffer::alloc(estimated_size);
     out_buf->put(cnt);
 
-    int32_t remain_cnt = cnt;
-    m_log_store->foreach (
-        to_store_lsn(index),
-        [this, &out_buf, &remain_cnt]([[maybe_unused]] store_lsn_t cur, const log_buffer& entry) mutable -> bool {
-            size_t const total_entry_size = entry.size() + sizeof(uint32_t);
-            if (remain_cnt-- > 0) {
-                size_t avail_size = out_buf->size() - out_buf->pos();
-                // available size of packing buffer should be able to hold entry.size() and the length of this entry
-                if (avail_size < total_entry_size) {
-                    avail_size += std::max(out_buf->size() * 2, total_entry_size);
-                    out_buf = nuraft::buffer::expand(*out_buf, avail_size);
-                }
-                REPL_STORE_LOG(TRACE, "packing lsn={} of size={}, avail_size in buffer={}", to_repl_lsn(cur),
-                               entry.size(), avail_size);
-                out_buf->put(entry.bytes(), entry.size());
-            }
-            return (remain_cnt > 0);
-        });
+    auto const start_lsn = to_store_lsn(index);
+    auto const entries = m_log_store->async_read_range(start_lsn, start_lsn + cnt - 1).get();
+    store_lsn_t cur = start_lsn;
+    for (auto const& entry : entries) {
+        size_t const total_entry_size = entry.size() + sizeof(uint32_t);
+        size_t avail_size = out_buf->size() - out_buf->pos();
+        // available size of packing buffer should be able to hold entry.size() and the length of this entry
+        if (avail_size < total_entry_size) {
+            avail_size += std::max(out_buf->size() * 2, total_entry_size);
+            out_buf = nuraft::buffer::expand(*out_buf, avail_size);
+        }
+        REPL_STORE_LOG(TRACE, "packing lsn={} of size={}, avail_size in buffer={}", to_repl_lsn(cur++), entry.size(),
+                       avail_size);
+        out_buf->put(entry.bytes(), entry.size());
+    }
     return out_buf;
 }
 
@@ -63,26 +63,25 @@ void ReplLogStore::end_of_append_batch(ulong start_lsn, ulong count) {
     // All requests are from proposer for data write, so as mentioned above we can skip the flush for now
     if (!reqs->empty()) {
         // Check the map if data corresponding to all of these requsts have been received and written. If not, schedule
-        // a fetch and write. Once all requests are completed and written, these requests are poped out of the map and
-        // the future will be ready.
-        auto fut = m_rd.notify_after_data_written(reqs);
-        // Wait for the fetch and write to be completed successfully.
+        // a fetch and write. Each request counts down as its data is written, waking this up on the last of them.
         // It is essential to complete the data write before appending to the log. If the logs are flushed
         // before the data is written, a restart and subsequent log replay occurs, as the in-memory state is lost,
         // it leaves us uncertain about whether the data was actually written, potentially leading to data inconsistency.
-        std::move(fut).wait();
+        auto cur_time = std::chrono::steady_clock::now();
+        m_rd.wait_for_data_written(*reqs);
+        HISTOGRAM_OBSERVE(m_rd.metrics(), data_channel_wait_latency_us, get_elapsed_time_us(cur_time));
 
         // Flushing log now.
-        auto cur_time = std::chrono::steady_clock::now();
+        cur_time = std::chrono::steady_clock::now();
         HomeRaftLogStore::end_of_append_batch(start_lsn, count);
         HISTOGRAM_OBSERVE(m_rd.metrics(), raft_end_of_append_batch_latency_us, get_elapsed_time_us(cur_time));
 
-        cur_time = std::chrono::steady_clock::now();
-        HISTOGRAM_OBSERVE(m_rd.metrics(), data_channel_wait_latency_us, get_elapsed_time_us(cur_time));
-
         // Mark all the reqs also completely written
         for (auto const& rreq : *reqs) {
-            if (rreq) { rreq->add_state(repl_req_state_t::LOG_FLUSHED); }
+            if (rreq) {
+                rreq->add_state(repl_req_state_t::LOG_FLUSHED);
+                rreq->trace_stage(repl_req_stage_t::LOG_FLUSHED);
+            }
         }
     } else if (!proposer_reqs->empty()) {
         RD_LOGT("Raft Channel: end_of_append_batch, I am proposer, only flush log s from {} , count {}", start_lsn,
@@ -90,7 +89,10 @@ void ReplLogStore::end_of_append_batch(ulong start_lsn, ulong count) {
         // Mark all the reqs also completely written
         HomeRaftLogStore::end_of_append_batch(start_lsn, count);
         for (auto const& rreq : *proposer_reqs) {
-            if (rreq) { rreq->add_state(repl_req_state_t::LOG_FLUSHED); }
+            if (rreq) {
+                rreq->add_state(repl_req_state_t::LOG_FLUSHED);
+                rreq->trace_stage(repl_req_stage_t::LOG_FLUSHED);
+            }
         }
     }
     sisl::VectorPool< repl_req_ptr_t >::free(reqs);
@@ -1,9 +1,11 @@
 #include <boost/smart_ptr/intrusive_ref_counter.hpp>
+#include <lz4.h>
 #include <sisl/grpc/generic_service.hpp>
 #include <sisl/grpc/rpc_call.hpp>
 #include <homestore/blkdata_service.hpp>
 #include <homestore/replication/repl_dev.h>
 #include <common/homestore_config.hpp>
+#include <common/resource_mgr.hpp>
 #include "replication/repl_dev/common.h"
 #include <libnuraft/nuraft.hxx>
 
@@ -15,7 +17,8 @@ void repl_req_ctx::init(repl_key rkey, journal_type_t op_code, bool is_proposer,
 #ifndef NDEBUG
     if (data_size > 0) {
         DEBUG_ASSERT_EQ(op_code, journal_type_t::HS_DATA_LINKED, "Calling wrong init method");
-    } else {
+    } else if (is_proposer) {
+        // Only the entries replayed on a witness are linked with no data, as it never had the blks of their data
         DEBUG_ASSERT_NE(op_code, journal_type_t::HS_DATA_LINKED, "Calling wrong init method");
     }
 #endif
@@ -24,21 +27,173 @@ void repl_req_ctx::init(repl_key rkey, journal_type_t op_code, bool is_proposer,
     m_header = user_header;
     m_key = key;
     m_is_jentry_localize_pending = (!is_proposer && (data_size > 0)); // Pending on the applier and with linked data
+
+    // Sampled by the dsn, so that all the replicas trace the same requests. Request initialized again keeps its trace.
+    if (auto const rate = HS_DYNAMIC_CONFIG(consensus.repl_req_trace_sample_rate);
+        !m_traced && (rate != 0) && ((m_rkey.dsn % rate) == 0)) {
+        m_traced = true;
+        m_trace_start = Clock::now();
+        for (auto& us : m_stage_us) {
+            us.store(-1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void repl_req_ctx::trace_stage(repl_req_stage_t stage) {
+    if (!m_traced) { return; }
+    m_stage_us[s_cast< size_t >(stage)].store(get_elapsed_time_us(m_trace_start), std::memory_order_relaxed);
+}
+
+repl_req_trace repl_req_ctx::trace() const {
+    repl_req_trace t{.rkey = m_rkey, .lsn = m_lsn, .is_proposer = m_is_proposer};
+    for (size_t i{0}; i < num_repl_req_stages; ++i) {
+        t.stage_us[i] = m_stage_us[i].load(std::memory_order_relaxed);
+    }
+    return t;
 }
 
 repl_req_ctx::~repl_req_ctx() {
     if (m_journal_entry) { m_journal_entry->~repl_journal_entry(); }
+    if (m_data_mem_used) { resource_mgr().dec_mem_used(mem_budget_t::REPL_REQS, m_data_mem_used); }
+}
+
+namespace {
+// Released requests of a thread, which are reused by the next requests created on it
+struct repl_req_pool {
+    std::vector< repl_req_ctx* > free_reqs;
+
+    ~repl_req_pool();
+};
+thread_local repl_req_pool s_repl_req_pool;
+thread_local bool s_repl_req_pool_destroyed{false}; // Requests released after it on thread exit are freed
+
+repl_req_pool::~repl_req_pool() {
+    s_repl_req_pool_destroyed = true;
+    for (auto* rreq : free_reqs) {
+        delete rreq;
+    }
+}
+} // namespace
+
+repl_req_ptr_t repl_req_ctx::make_pooled() {
+    if (s_repl_req_pool_destroyed || s_repl_req_pool.free_reqs.empty()) {
+        auto* rreq = new repl_req_ctx{};
+        rreq->m_pooled = true;
+        return repl_req_ptr_t{rreq};
+    }
+    auto* rreq = s_repl_req_pool.free_reqs.back();
+    s_repl_req_pool.free_reqs.pop_back();
+    return repl_req_ptr_t{rreq};
+}
+
+void intrusive_ptr_release(repl_req_ctx const* rreq) {
+    if (rreq->m_ref_count.fetch_sub(1, std::memory_order_acq_rel) != 1) { return; }
+
+    auto* req = const_cast< repl_req_ctx* >(rreq);
+    if (req->m_pooled && !s_repl_req_pool_destroyed &&
+        (s_repl_req_pool.free_reqs.size() < HS_DYNAMIC_CONFIG(consensus.repl_req_pool_size))) {
+        req->recycle();
+        s_repl_req_pool.free_reqs.push_back(req);
+        return;
+    }
+    delete req;
+}
+
+void repl_req_ctx::recycle() {
+    clear();
+    m_rkey = repl_key{};
+    m_lsn = -1;
+    m_is_proposer = false;
+    m_start_time = Clock::time_point{};
+    m_op_code = journal_type_t::HS_DATA_INLINED;
+    m_local_blkid = MultiBlkId{};
+    m_remote_blkid = RemoteBlkId{};
+    m_data = nullptr;
+
+    if (m_journal_entry) {
+        m_journal_entry->~repl_journal_entry();
+        m_journal_entry = nullptr;
+    }
+    // Raft journal buffer is shared with the raft log entry, so only the plain buffer is kept for reuse
+    if (!std::holds_alternative< std::unique_ptr< uint8_t[] > >(m_journal_buf)) {
+        m_journal_buf = std::unique_ptr< uint8_t[] >{};
+        m_raw_journal_buf_size = 0;
+    }
+    m_is_jentry_localize_pending = false;
+    m_lentry.reset();
+    m_state.store(uint32_cast(repl_req_state_t::INIT));
+    m_data_written_countdown.reset();
+    m_traced = false;
+
+    m_fb_builder.Clear();
+    m_buf_for_unaligned_data = sisl::io_blob_safe{};
+    m_data_received_promise = folly::Promise< folly::Unit >{};
+    m_data_written_promise = folly::Promise< folly::Unit >{};
+}
+
+std::pair< sisl::blob, sisl::blob > journal_entry_header_key(repl_journal_entry const* jentry,
+                                                             std::unique_ptr< uint8_t[] >& buf) {
+    auto const* start = uintptr_cast(const_cast< repl_journal_entry* >(jentry)) + sizeof(repl_journal_entry);
+    if (!jentry->is_compressed()) {
+        return {sisl::blob{start, jentry->user_header_size},
+                sisl::blob{start + jentry->user_header_size, jentry->key_size}};
+    }
+
+    auto const* chdr = r_cast< repl_journal_compressed_hdr const* >(start);
+    auto const raw_size = jentry->user_header_size + jentry->key_size;
+    buf = std::unique_ptr< uint8_t[] >(new uint8_t[raw_size]);
+    auto const dsize = LZ4_decompress_safe(r_cast< const char* >(start + sizeof(repl_journal_compressed_hdr)),
+                                           r_cast< char* >(buf.get()), int_cast(chdr->compressed_size),
+                                           int_cast(raw_size));
+    RELEASE_ASSERT_EQ(dsize, int_cast(raw_size), "Corrupted compressed journal entry=[{}]", jentry->to_string());
+    return {sisl::blob{buf.get(), jentry->user_header_size},
+            sisl::blob{buf.get() + jentry->user_header_size, jentry->key_size}};
+}
+
+sisl::blob journal_entry_value(repl_journal_entry const* jentry) {
+    auto* start = uintptr_cast(const_cast< repl_journal_entry* >(jentry)) + sizeof(repl_journal_entry);
+    auto const hdr_key_size = jentry->is_compressed()
+        ? sizeof(repl_journal_compressed_hdr) + r_cast< repl_journal_compressed_hdr const* >(start)->compressed_size
+        : jentry->user_header_size + jentry->key_size;
+    return sisl::blob{start + hdr_key_size, jentry->value_size};
+}
+
+uint32_t journal_blkid_size(MultiBlkId const& blkid, bool compact) {
+    return compact ? blkid.compact_serialized_size(data_service().compact_blkid_widths(blkid.blk_count()))
+                   : blkid.serialized_size();
+}
+
+void write_journal_blkid(MultiBlkId const& blkid, bool compact, uint8_t* buf) {
+    if (compact) {
+        blkid.serialize_compact(buf, data_service().compact_blkid_widths(blkid.blk_count()));
+    } else {
+        auto const b = blkid.serialize();
+        std::memcpy(buf, b.cbytes(), b.size());
+    }
 }
 
 void repl_req_ctx::create_journal_entry(bool is_raft_buf, int32_t server_id) {
-    uint32_t val_size = has_linked_data() ? m_local_blkid.serialized_size() : 0;
+    auto const compact = HS_DYNAMIC_CONFIG(consensus.journal_compact_blkid);
+    uint32_t val_size = has_linked_data() ? journal_blkid_size(m_local_blkid, compact) : 0;
     uint32_t entry_size = sizeof(repl_journal_entry) + m_header.size() + m_key.size() + val_size;
 
     if (is_raft_buf) {
+        // Raft entries are shipped to the followers and stored in their journal as is, so the header and the key are
+        // compressed once here when it saves space
+        auto const min_size = HS_DYNAMIC_CONFIG(consensus.journal_entry_compression_min_size);
+        auto const hdr_key_size = m_header.size() + m_key.size();
+        if ((min_size != 0) && (hdr_key_size >= min_size) &&
+            create_compressed_journal_entry(server_id, val_size, compact)) {
+            return;
+        }
         m_journal_buf = nuraft::buffer::alloc(entry_size);
         m_journal_entry = new (raft_journal_buf()->data_begin()) repl_journal_entry();
     } else {
-        m_journal_buf = std::unique_ptr< uint8_t[] >(new uint8_t[entry_size]);
+        if (!std::holds_alternative< std::unique_ptr< uint8_t[] > >(m_journal_buf) ||
+            (m_raw_journal_buf_size < entry_size)) {
+            m_journal_buf = std::unique_ptr< uint8_t[] >(new uint8_t[entry_size]);
+            m_raw_journal_buf_size = entry_size;
+        }
         m_journal_entry = new (raw_journal_buf()) repl_journal_entry();
     }
 
@@ -60,28 +215,56 @@ void repl_req_ctx::create_journal_entry(bool is_raft_buf, int32_t server_id) {
         raw_ptr += m_key.size();
     }
 
-    if (has_linked_data()) {
-        auto const b = m_local_blkid.serialize();
-        std::memcpy(raw_ptr, b.cbytes(), b.size());
-    }
+    if (has_linked_data()) { write_journal_blkid(m_local_blkid, compact, raw_ptr); }
+}
+
+bool repl_req_ctx::create_compressed_journal_entry(int32_t server_id, uint32_t val_size, bool compact) {
+    auto const hdr_key_size = m_header.size() + m_key.size();
+    thread_local std::vector< uint8_t > s_raw;
+    thread_local std::vector< char > s_compressed;
+    s_raw.resize(hdr_key_size);
+    if (m_header.size()) { std::memcpy(s_raw.data(), m_header.cbytes(), m_header.size()); }
+    if (m_key.size()) { std::memcpy(s_raw.data() + m_header.size(), m_key.cbytes(), m_key.size()); }
+
+    // Compress only if it saves space
+    auto const max_csize = int_cast(hdr_key_size) - int_cast(sizeof(repl_journal_compressed_hdr)) - 1;
+    if (max_csize <= 0) { return false; }
+    s_compressed.resize(max_csize);
+    auto const csize = LZ4_compress_default(r_cast< const char* >(s_raw.data()), s_compressed.data(),
+                                            int_cast(hdr_key_size), max_csize);
+    if (csize <= 0) { return false; }
+
+    m_journal_buf =
+        nuraft::buffer::alloc(sizeof(repl_journal_entry) + sizeof(repl_journal_compressed_hdr) + csize + val_size);
+    m_journal_entry = new (raft_journal_buf()->data_begin()) repl_journal_entry();
+    m_journal_entry->minor_version = repl_journal_entry::JOURNAL_ENTRY_MINOR_COMPRESSED;
+    m_journal_entry->code = m_op_code;
+    m_journal_entry->server_id = server_id;
+    m_journal_entry->dsn = m_rkey.dsn;
+    m_journal_entry->user_header_size = m_header.size();
+    m_journal_entry->key_size = m_key.size();
+    m_journal_entry->value_size = val_size;
+
+    uint8_t* raw_ptr = uintptr_cast(m_journal_entry) + sizeof(repl_journal_entry);
+    r_cast< repl_journal_compressed_hdr* >(raw_ptr)->compressed_size = uint32_cast(csize);
+    raw_ptr += sizeof(repl_journal_compressed_hdr);
+    std::memcpy(raw_ptr, s_compressed.data(), csize);
+    raw_ptr += csize;
+
+    if (has_linked_data()) { write_journal_blkid(m_local_blkid, compact, raw_ptr); }
+    return true;
 }
 
 uint32_t repl_req_ctx::journal_entry_size() const {
     return sizeof(repl_journal_entry) + m_header.size() + m_key.size() +
-        (has_linked_data() ? m_local_blkid.serialized_size() : 0);
+        (has_linked_data() ? m_journal_entry->value_size : 0);
 }
 
 void repl_req_ctx::change_raft_journal_buf(raft_buf_ptr_t new_buf, bool adjust_hdr_key) {
     m_journal_buf = std::move(new_buf);
     m_journal_entry = r_cast< repl_journal_entry* >(raft_journal_buf()->data_begin());
 
-    if (adjust_hdr_key) {
-        m_header =
-            sisl::blob{uintptr_cast(m_journal_entry) + sizeof(repl_journal_entry), m_journal_entry->user_header_size};
-        m_key =
-            sisl::blob{uintptr_cast(m_journal_entry) + sizeof(repl_journal_entry) + m_journal_entry->user_header_size,
-                       m_journal_entry->key_size};
-    }
+    if (adjust_hdr_key) { std::tie(m_header, m_key) = journal_entry_header_key(m_journal_entry, m_hdr_key_buf); }
     m_is_jentry_localize_pending = false;
 }
 
@@ -98,6 +281,7 @@ ReplServiceError repl_req_ctx::alloc_local_blks(cshared< ReplDevListener >& list
         return ReplServiceError::NO_SPACE_LEFT;
     }
     add_state(repl_req_state_t::BLK_ALLOCATED);
+    trace_stage(repl_req_stage_t::BLK_ALLOCATED);
     return ReplServiceError::OK;
 }
 
@@ -125,6 +309,9 @@ bool repl_req_ctx::save_pushed_data(intrusive< sisl::GenericRpcData > const& pus
 
     m_pushed_data = pushed_data;
     m_data = data;
+    m_data_mem_used = data_size;
+    resource_mgr().inc_mem_used(mem_budget_t::REPL_REQS, data_size);
+    trace_stage(repl_req_stage_t::DATA_RECEIVED);
     m_data_received_promise.setValue();
     return true;
 }
@@ -142,6 +329,9 @@ bool repl_req_ctx::save_fetched_data(sisl::GenericClientResponse const& fetched_
 
     m_fetched_data = fetched_data;
     m_data = data;
+    m_data_mem_used = data_size;
+    resource_mgr().inc_mem_used(mem_budget_t::REPL_REQS, data_size);
+    trace_stage(repl_req_stage_t::DATA_RECEIVED);
     m_data_received_promise.setValue();
     return true;
 }
@@ -161,15 +351,39 @@ bool repl_req_ctx::add_state_if_not_already(repl_req_state_t s) {
     return changed;
 }
 
+bool repl_req_ctx::add_data_written_countdown(std::shared_ptr< std::latch > countdown) {
+    std::unique_lock< std::mutex > lg(m_state_mtx);
+    if (has_state(repl_req_state_t::DATA_WRITTEN)) { return false; }
+    m_data_written_countdown = std::move(countdown);
+    return true;
+}
+
+void repl_req_ctx::notify_data_written() {
+    std::shared_ptr< std::latch > countdown;
+    {
+        std::unique_lock< std::mutex > lg(m_state_mtx);
+        add_state(repl_req_state_t::DATA_WRITTEN);
+        countdown = std::move(m_data_written_countdown);
+    }
+    trace_stage(repl_req_stage_t::DATA_WRITTEN);
+    m_data_written_promise.setValue();
+    if (countdown) { countdown->count_down(); }
+}
+
 void repl_req_ctx::clear() {
     m_header = sisl::blob{};
     m_key = sisl::blob{};
+    m_hdr_key_buf.reset();
     if (m_pushed_data) {
         m_pushed_data->send_response();
         m_pushed_data = nullptr;
     }
     m_fetched_data = sisl::GenericClientResponse{};
     m_pkts.clear();
+    if (m_data_mem_used) {
+        resource_mgr().dec_mem_used(mem_budget_t::REPL_REQS, m_data_mem_used);
+        m_data_mem_used = 0;
+    }
 }
 
 static std::string req_state_name(uint32_t state) {
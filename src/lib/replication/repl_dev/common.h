@@ -28,9 +28,14 @@ namespace homestore {
 struct repl_journal_entry {
     static constexpr uint16_t JOURNAL_ENTRY_MAJOR = 1;
     static constexpr uint16_t JOURNAL_ENTRY_MINOR = 1;
+    // Header and key of the entry are compressed with lz4, prefixed with repl_journal_compressed_hdr. Sizes in the
+    // entry are of them uncompressed. Value is not compressed, so that it can be localized in place. Unlike the other
+    // minor versions, it changes the layout, which the versions before it can't detect, so the compression has to be
+    // off while any of the replicas runs such a version (see consensus.journal_entry_compression_min_size).
+    static constexpr uint16_t JOURNAL_ENTRY_MINOR_COMPRESSED = 2;
 
     // Major and minor version. For each major version underlying structures could change. Minor versions can only add
-    // fields, not change any existing fields.
+    // fields, not change any existing fields, except for JOURNAL_ENTRY_MINOR_COMPRESSED.
     uint16_t major_version{JOURNAL_ENTRY_MAJOR};
     uint16_t minor_version{JOURNAL_ENTRY_MINOR};
 
@@ -42,6 +47,8 @@ struct repl_journal_entry {
     uint32_t value_size;
     // Followed by user_header, then key, then MultiBlkId/value
 
+    bool is_compressed() const { return (minor_version == JOURNAL_ENTRY_MINOR_COMPRESSED); }
+
     std::string to_string() const {
         return fmt::format("version={}.{}, code={}, server_id={}, dsn={}, header_size={}, key_size={}, value_size={}",
                            major_version, minor_version, enum_name(code), server_id, dsn, user_header_size, key_size,
@@ -71,8 +78,25 @@ struct repl_dev_superblk {
     uint64_t get_magic() const { return magic; }
     uint32_t get_version() const { return version; }
 };
+struct repl_journal_compressed_hdr {
+    uint32_t compressed_size; // Size of the header and key compressed
+    // Followed by the compressed header and key
+};
 #pragma pack()
 
+/// @brief Returns the header and key of the journal entry. If they are compressed, they are uncompressed into the buf,
+/// which is to be kept as long as they are used.
+std::pair< sisl::blob, sisl::blob > journal_entry_header_key(repl_journal_entry const* jentry,
+                                                             std::unique_ptr< uint8_t[] >& buf);
+
+/// @brief Returns the value of the journal entry, which follows its header and key whether they are compressed or not
+sisl::blob journal_entry_value(repl_journal_entry const* jentry);
+
+/// @brief Size of the blkid in the journal entry value, compact or not. Compact blkids take atleast the widths of the
+/// data service, so that the blkid of a follower fits in place of that of the leader.
+uint32_t journal_blkid_size(MultiBlkId const& blkid, bool compact);
+void write_journal_blkid(MultiBlkId const& blkid, bool compact, uint8_t* buf);
+
 template < class V = folly::Unit >
 auto make_async_error(ReplServiceError err) {
     return folly::makeSemiFuture< ReplResult< V > >(folly::makeUnexpected(err));
@@ -1,3 +1,4 @@
+#include <latch>
 #include <flatbuffers/idl.h>
 #include <flatbuffers/minireflect.h>
 #include <folly/executors/InlineExecutor.h>
@@ -12,9 +13,11 @@
 #include <homestore/blkdata_service.hpp>
 #include <homestore/logstore_service.hpp>
 #include <homestore/superblk_handler.hpp>
+#include <homestore/cpu_accounting.hpp>
 
 #include "common/homestore_assert.hpp"
 #include "common/homestore_config.hpp"
+#include "common/resource_mgr.hpp"
 // #include "common/homestore_flip.hpp"
 #include "replication/service/raft_repl_service.h"
 #include "replication/repl_dev/raft_repl_dev.h"
@@ -25,6 +28,22 @@
 namespace homestore {
 std::atomic< uint64_t > RaftReplDev::s_next_group_ordinal{1};
 
+// Alignment at which the data of a push is laid out in the rpc payload, 0 if it is not padded
+static uint32_t push_data_align(uint64_t data_size) {
+    auto const min_size = uint64_cast(HS_DYNAMIC_CONFIG(consensus.push_data_align_min_size_kb)) * 1024;
+    return ((min_size != 0) && (data_size >= min_size)) ? data_service().get_align_size() : 0;
+}
+
+static uint64_t push_data_pad_size(uint64_t offset, uint32_t data_align) {
+    return (data_align == 0) ? 0 : (sisl::round_up(offset, data_align) - offset);
+}
+
+static sisl::io_blob push_data_pad_blob(uint64_t pad_size) {
+    static std::vector< uint8_t > s_zeros(data_service().get_align_size(), 0);
+    HS_DBG_ASSERT_LT(pad_size, s_zeros.size(), "Padding of push data is beyond the alignment");
+    return sisl::io_blob{s_zeros.data(), uint32_cast(pad_size), false};
+}
+
 RaftReplDev::RaftReplDev(RaftReplService& svc, superblk< raft_repl_dev_superblk >&& rd_sb, bool load_existing) :
         m_repl_svc{svc},
         m_msg_mgr{svc.msg_manager()},
@@ -40,8 +59,10 @@ RaftReplDev::RaftReplDev(RaftReplService& svc, superblk< raft_repl_dev_superblk
             *this, *m_state_machine, m_rd_sb->logdev_id, m_rd_sb->logstore_id,
             [this](logstore_seq_num_t lsn, log_buffer buf, void* key) { on_log_found(lsn, buf, key); },
             [this](std::shared_ptr< HomeLogStore > hs, logstore_seq_num_t lsn) { m_log_store_replay_done = true; });
+        m_repl_svc.acquire_logdev(m_rd_sb->logdev_id);
         m_next_dsn = m_rd_sb->last_applied_dsn + 1;
         m_commit_upto_lsn = m_rd_sb->durable_commit_lsn;
+        m_persisted_durable_lsn = m_rd_sb->durable_commit_lsn;
         m_last_flushed_commit_lsn = m_commit_upto_lsn;
         m_compact_lsn = m_rd_sb->compact_lsn;
 
@@ -61,7 +82,7 @@ RaftReplDev::RaftReplDev(RaftReplService& svc, superblk< raft_repl_dev_superblk
                 });
         }
     } else {
-        m_data_journal = std::make_shared< ReplLogStore >(*this, *m_state_machine);
+        m_data_journal = std::make_shared< ReplLogStore >(*this, *m_state_machine, m_repl_svc.acquire_logdev());
         m_rd_sb->logdev_id = m_data_journal->logdev_id();
         m_rd_sb->logstore_id = m_data_journal->logstore_id();
         m_rd_sb->last_applied_dsn = 0;
@@ -107,11 +128,22 @@ bool RaftReplDev::bind_data_service() {
         RD_LOGE("Failed to bind data service request for PUSH_DATA");
 	return false;
     }
+    success = m_msg_mgr.bind_data_service_request(PUSH_DATA_BATCH, m_group_id,
+                                                  bind_this(RaftReplDev::on_push_data_batch_received, 1));
+    if (!success) {
+        RD_LOGE("Failed to bind data service request for PUSH_DATA_BATCH");
+        return false;
+    }
     success = m_msg_mgr.bind_data_service_request(FETCH_DATA, m_group_id, bind_this(RaftReplDev::on_fetch_data_received, 1));
     if (!success) {
         RD_LOGE("Failed to bind data service request for FETCH_DATA");
 	return false;
     }
+    success = m_msg_mgr.bind_data_service_request(READ_INDEX, m_group_id, bind_this(RaftReplDev::on_read_index_received, 1));
+    if (!success) {
+        RD_LOGE("Failed to bind data service request for READ_INDEX");
+        return false;
+    }
     return true;
 }
 
@@ -174,7 +206,7 @@ AsyncReplResult<> RaftReplDev::replace_member(replica_id_t member_out_uuid, repl
             RD_LOGI("Replace member added member={} to group_id={}", member_in, group_id_str());
 
             // Step 3. Append log entry to mark the old member is out and new member is added.
-            auto rreq = repl_req_ptr_t(new repl_req_ctx{});
+            auto rreq = repl_req_ctx::make_pooled();
             replace_members_ctx members;
             std::copy(member_in_uuid.begin(), member_in_uuid.end(), members.in_replica_id.begin());
             std::copy(member_out_uuid.begin(), member_out_uuid.end(), members.out_replica_id.begin());
@@ -222,6 +254,97 @@ AsyncReplResult<> RaftReplDev::replace_member(replica_id_t member_out_uuid, repl
         });
 }
 
+void RaftReplDev::check_quiesce() {
+    if (is_destroy_pending() || is_destroyed() || (m_repl_svc_ctx == nullptr) ||
+        (raft_server() == nullptr)) {
+        return;
+    }
+
+    auto const idle_ms = HS_DYNAMIC_CONFIG(consensus.quiesce_idle_ms);
+    if (idle_ms == 0) {
+        if (m_quiesced.load()) { set_quiesced(false); }
+        return;
+    }
+
+    // Followers quiesce earlier than the leader, so that their election timeout is stretched before the heartbeats
+    // slow down
+    auto const threshold = is_leader() ? idle_ms : idle_ms / 2;
+    auto const last_activity_ms = m_last_activity_ms.load(std::memory_order_relaxed);
+    if (!m_quiesced.load() && (get_time_since_epoch_ms() >= last_activity_ms + threshold)) { set_quiesced(true); }
+}
+
+void RaftReplDev::set_quiesced(bool quiesced) {
+    std::unique_lock lg{m_quiesce_mtx};
+    if (m_quiesced.load() == quiesced) { return; }
+
+    auto const factor = quiesced ? std::max(HS_DYNAMIC_CONFIG(consensus.quiesce_factor), 1u) : 1u;
+    nuraft::raft_params params = raft_server()->get_current_params();
+    params.with_hb_interval(HS_DYNAMIC_CONFIG(consensus.heartbeat_period_ms) * factor);
+    params.with_election_timeout_lower(HS_DYNAMIC_CONFIG(consensus.elect_to_low_ms) * factor);
+    params.with_election_timeout_upper(HS_DYNAMIC_CONFIG(consensus.elect_to_high_ms) * factor);
+    auto const expiry_ms = HS_DYNAMIC_CONFIG(consensus.leadership_expiry_ms);
+    if (expiry_ms > 0) { params.with_leadership_expiry(expiry_ms * s_cast< int32_t >(factor)); }
+    raft_server()->update_params(params);
+    m_quiesced.store(quiesced);
+
+    if (quiesced) { COUNTER_INCREMENT(m_metrics, quiesce_cnt, 1); }
+    RD_LOGI("Raft group is {} with heartbeat period={} ms", quiesced ? "quiesced" : "woken up",
+            HS_DYNAMIC_CONFIG(consensus.heartbeat_period_ms) * factor);
+}
+
+void RaftReplDev::tune_append_batch() {
+    if (is_destroy_pending() || is_destroyed() || (m_repl_svc_ctx == nullptr) || (raft_server() == nullptr)) {
+        return;
+    }
+
+    auto const base_size = HS_DYNAMIC_CONFIG(consensus.max_append_batch_size);
+    auto const max_size = HS_DYNAMIC_CONFIG(consensus.adaptive_append_batch_max_size);
+
+    std::unique_lock lg{m_quiesce_mtx};
+    if (m_append_batch_size == 0) { m_append_batch_size = base_size; }
+
+    int32_t size{base_size};
+    if ((max_size > base_size) && is_leader()) {
+        auto const lo_gap = int64_cast(HS_DYNAMIC_CONFIG(consensus.stale_log_gap_lo_threshold));
+        auto const hi_gap = std::max(int64_cast(HS_DYNAMIC_CONFIG(consensus.stale_log_gap_hi_threshold)), lo_gap + 1);
+        auto const resp_timeout_us = uint64_cast(HS_DYNAMIC_CONFIG(consensus.elect_to_low_ms)) * 1000;
+        auto const last_idx = int64_cast(raft_server()->get_last_log_idx());
+
+        int64_t max_lag{0};
+        for (auto const& pinfo : get_replication_status()) {
+            if (pinfo.id_ == m_my_repl_id) { continue; }
+            auto& acked_idx = m_peer_acked_idx[pinfo.id_];
+            bool const is_acking = (pinfo.replication_idx_ > acked_idx);
+            acked_idx = pinfo.replication_idx_;
+
+            // Larger batches only speed up the followers which keep up with the batches they are sent
+            if (!is_acking || (pinfo.last_succ_resp_us_ > resp_timeout_us)) { continue; }
+            max_lag = std::max(max_lag, last_idx - int64_cast(pinfo.replication_idx_));
+        }
+
+        if (max_lag >= hi_gap) {
+            size = max_size;
+        } else if (max_lag > lo_gap) {
+            size = base_size + s_cast< int32_t >((max_size - base_size) * (max_lag - lo_gap) / (hi_gap - lo_gap));
+        }
+    } else {
+        m_peer_acked_idx.clear();
+    }
+
+    if (size == m_append_batch_size) { return; }
+
+    auto const sync_size =
+        s_cast< int32_t >(int64_cast(HS_DYNAMIC_CONFIG(consensus.log_sync_batch_size)) * size / std::max(base_size, 1));
+    nuraft::raft_params params = raft_server()->get_current_params();
+    params.with_max_append_size(size);
+    params.with_log_sync_batch_size(sync_size);
+    raft_server()->update_params(params);
+
+    RD_LOGD("Append batch size resized from {} to {}, log sync batch size={}", m_append_batch_size, size, sync_size);
+    m_append_batch_size = size;
+    COUNTER_INCREMENT(m_metrics, append_batch_resize_cnt, 1);
+}
+
 void RaftReplDev::reset_quorum_size(uint32_t commit_quorum) {
     RD_LOGI("Reset raft quorum size={}", commit_quorum);
     nuraft::raft_params params = raft_server()->get_current_params();
@@ -235,7 +358,7 @@ folly::SemiFuture< ReplServiceError > RaftReplDev::destroy_group() {
     m_stage.update([](auto* stage) { *stage = repl_dev_stage_t::DESTROYING; });
 
     // Propose to the group to destroy
-    auto rreq = repl_req_ptr_t(new repl_req_ctx{});
+    auto rreq = repl_req_ctx::make_pooled();
 
     // if we have a rreq {originator=1, term=1, dsn=0, lsn=7} in follower and a baseline resync is triggerd before the
     // rreq is committed in the follower, then the on_commit of the rreq will not be called and as a result this rreq
@@ -276,7 +399,7 @@ void RaftReplDev::on_create_snapshot(nuraft::snapshot& s, nuraft::async_result<
 
 void RaftReplDev::async_alloc_write(sisl::blob const& header, sisl::blob const& key, sisl::sg_list const& data,
                                     repl_req_ptr_t rreq) {
-    if (!rreq) { auto rreq = repl_req_ptr_t(new repl_req_ctx{}); }
+    if (!rreq) { rreq = repl_req_ctx::make_pooled(); }
 
     {
         auto const guard = m_stage.access();
@@ -289,12 +412,29 @@ void RaftReplDev::async_alloc_write(sisl::blob const& header, sisl::blob const&
         }
     }
 
+    if (is_witness()) {
+        // Witness has no data of the entries to serve, so it never originates one, even if it is leader for a while
+        RD_LOGW("Raft channel: Witness does not accept writes, leader={}", boost::uuids::to_string(get_leader_id()));
+        handle_error(rreq, ReplServiceError::NOT_LEADER);
+        return;
+    }
+
+    // Writes of the repl devs are slowed down as the journal fills up, each by its share of the writes, and rejected
+    // once it is too full, to be retried by the caller
+    if (!resource_mgr().can_admit(admission_class_t::REPL)) {
+        RD_LOGD("Rejecting write of size={} as the journal is too full", data.size);
+        handle_error(rreq, ReplServiceError::RETRY_REQUEST);
+        return;
+    }
+    resource_mgr().throttle_admission(header.size() + key.size() + data.size, admission_class_t::REPL,
+                                      boost::uuids::hash_value(group_id()));
+
     rreq->init(repl_key{.server_id = server_id(), .term = raft_server()->get_term(), .dsn = m_next_dsn.fetch_add(1)},
                data.size ? journal_type_t::HS_DATA_LINKED : journal_type_t::HS_DATA_INLINED, true /* is_proposer */,
                header, key, data.size);
 
     // Add the request to the repl_dev_rreq map, it will be accessed throughout the life cycle of this request
-    auto const [it, happened] = m_repl_key_req_map.emplace(rreq->rkey(), rreq);
+    [[maybe_unused]] auto const happened = m_repl_key_req_map.insert(rreq->rkey(), rreq);
     RD_DBG_ASSERT(happened, "Duplicate repl_key={} found in the map", rreq->rkey().to_string());
 
     // If it is header only entry, directly propose to the raft
@@ -312,15 +452,30 @@ void RaftReplDev::async_alloc_write(sisl::blob const& header, sisl::blob const&
         COUNTER_INCREMENT(m_metrics, total_write_cnt, 1);
         COUNTER_INCREMENT(m_metrics, outstanding_data_write_cnt, 1);
 
+        // In parallel mode, the entry is replicated while the data is written here, and the commit of the entry waits
+        // for the write only on this replica
+        bool const parallel_write = HS_DYNAMIC_CONFIG(consensus.leader_parallel_data_write);
+        if (parallel_write) {
+            auto raft_status = m_state_machine->propose_to_raft(rreq);
+            if (raft_status != ReplServiceError::OK) {
+                COUNTER_DECREMENT(m_metrics, outstanding_data_write_cnt, 1);
+                handle_error(rreq, raft_status);
+                return;
+            }
+        }
+
         auto const data_write_start_time = Clock::now();
         // Write the data
         data_service()
             .async_write(data, rreq->local_blkid())
-            .thenValue([this, rreq, data_write_start_time](auto&& err) {
+            .thenValue([this, rreq, data_write_start_time, parallel_write](auto&& err) {
                 // update outstanding no matter error or not;
                 COUNTER_DECREMENT(m_metrics, outstanding_data_write_cnt, 1);
 
                 if (err) {
+                    // Entry already proposed can't be withdrawn, so there is no recourse but to fail here
+                    RD_REL_ASSERT(!parallel_write, "Error in writing data of proposed rreq=[{}], err_code={}",
+                                  rreq->to_string(), err.value());
                     HS_DBG_ASSERT(false, "Error in writing data, err_code={}", err.value());
                     handle_error(rreq, ReplServiceError::DRIVE_WRITE_ERROR);
                 } else {
@@ -332,8 +487,11 @@ void RaftReplDev::async_alloc_write(sisl::blob const& header, sisl::blob const&
                     HISTOGRAM_OBSERVE(m_metrics, rreq_total_data_write_latency_us,
                                       get_elapsed_time_us(rreq->created_time()));
 
-                    auto raft_status = m_state_machine->propose_to_raft(rreq);
-                    if (raft_status != ReplServiceError::OK) { handle_error(rreq, raft_status); }
+                    rreq->notify_data_written();
+                    if (!parallel_write) {
+                        auto raft_status = m_state_machine->propose_to_raft(rreq);
+                        if (raft_status != ReplServiceError::OK) { handle_error(rreq, raft_status); }
+                    }
                 }
             });
     } else {
@@ -345,15 +503,38 @@ void RaftReplDev::async_alloc_write(sisl::blob const& header, sisl::blob const&
 }
 
 void RaftReplDev::push_data_to_all_followers(repl_req_ptr_t rreq, sisl::sg_list const& data) {
+    if (auto const batch_size = uint64_cast(HS_DYNAMIC_CONFIG(consensus.push_data_batch_size_kb)) * 1024;
+        batch_size != 0) {
+        std::optional< push_data_batch > full_batch;
+        {
+            std::unique_lock lg{m_push_batch_mtx};
+            if (m_push_batch.rreqs.empty()) { m_push_batch.start_time = Clock::now(); }
+            m_push_batch.rreqs.push_back(std::move(rreq));
+            m_push_batch.data.push_back(data);
+            m_push_batch.size += data.size;
+            if ((m_push_batch.size >= batch_size) ||
+                (m_push_batch.rreqs.size() >= HS_DYNAMIC_CONFIG(consensus.push_data_batch_max_entries))) {
+                full_batch = std::exchange(m_push_batch, push_data_batch{});
+            }
+        }
+        if (full_batch) { push_data_batch_to_all_followers(std::move(*full_batch)); }
+        return;
+    }
+
     auto& builder = rreq->create_fb_builder();
+    auto const data_align = push_data_align(data.size);
 
     // Prepare the rpc request packet with all repl_reqs details
     builder.FinishSizePrefixed(CreatePushDataRequest(
         builder, server_id(), rreq->term(), rreq->dsn(),
         builder.CreateVector(rreq->header().cbytes(), rreq->header().size()),
-        builder.CreateVector(rreq->key().cbytes(), rreq->key().size()), data.size, get_time_since_epoch_ms()));
+        builder.CreateVector(rreq->key().cbytes(), rreq->key().size()), data.size, get_time_since_epoch_ms(),
+        data_align));
 
     rreq->m_pkts = sisl::io_blob::sg_list_to_ioblob_list(data);
+    if (auto const pad_size = push_data_pad_size(builder.GetSize(), data_align); pad_size != 0) {
+        rreq->m_pkts.insert(rreq->m_pkts.begin(), push_data_pad_blob(pad_size));
+    }
     rreq->m_pkts.insert(rreq->m_pkts.begin(), sisl::io_blob{builder.GetBufferPointer(), builder.GetSize(), false});
 
     /*RD_LOGI("Data Channel: Pushing data to all followers: rreq=[{}] data=[{}]", rreq->to_string(),
@@ -374,11 +555,81 @@ void RaftReplDev::push_data_to_all_followers(repl_req_ptr_t rreq, sisl::sg_list
             }
             // Release the buffer which holds the packets
             RD_LOGD("Data Channel: Data push completed for rreq=[{}]", rreq->to_string());
+            rreq->trace_stage(repl_req_stage_t::DATA_RECEIVED);
             rreq->release_fb_builder();
             rreq->m_pkts.clear();
         });
 }
 
+void RaftReplDev::flush_push_data_batch(bool force) {
+    push_data_batch batch;
+    {
+        std::unique_lock lg{m_push_batch_mtx};
+        if (m_push_batch.rreqs.empty()) { return; }
+        if (!force &&
+            (get_elapsed_time_us(m_push_batch.start_time) < HS_DYNAMIC_CONFIG(consensus.push_data_batch_deadline_us))) {
+            return;
+        }
+        batch = std::exchange(m_push_batch, push_data_batch{});
+    }
+    push_data_batch_to_all_followers(std::move(batch));
+}
+
+void RaftReplDev::push_data_batch_to_all_followers(push_data_batch batch) {
+    // Builder and the packets have to stay valid till the rpc completes, as they are shared by all the requests
+    auto builder = std::make_shared< flatbuffers::FlatBufferBuilder >();
+    std::vector< flatbuffers::Offset< PushDataRequest > > entries;
+    std::vector< uint32_t > data_aligns;
+    entries.reserve(batch.rreqs.size());
+    data_aligns.reserve(batch.rreqs.size());
+    for (size_t i{0}; i < batch.rreqs.size(); ++i) {
+        auto const& rreq = batch.rreqs[i];
+        data_aligns.push_back(push_data_align(batch.data[i].size));
+        entries.push_back(CreatePushDataRequest(
+            *builder, server_id(), rreq->term(), rreq->dsn(),
+            builder->CreateVector(rreq->header().cbytes(), rreq->header().size()),
+            builder->CreateVector(rreq->key().cbytes(), rreq->key().size()), batch.data[i].size, 0 /* time_ms */,
+            data_aligns.back()));
+    }
+    builder->FinishSizePrefixed(CreatePushDataBatchRequest(*builder, server_id(), builder->CreateVector(entries),
+                                                           get_time_since_epoch_ms()));
+
+    auto pkts = std::make_shared< sisl::io_blob_list_t >();
+    pkts->emplace_back(builder->GetBufferPointer(), builder->GetSize(), false);
+    uint64_t offset = builder->GetSize();
+    for (size_t i{0}; i < batch.data.size(); ++i) {
+        if (auto const pad_size = push_data_pad_size(offset, data_aligns[i]); pad_size != 0) {
+            pkts->push_back(push_data_pad_blob(pad_size));
+            offset += pad_size;
+        }
+        auto const data_pkts = sisl::io_blob::sg_list_to_ioblob_list(batch.data[i]);
+        pkts->insert(pkts->end(), data_pkts.begin(), data_pkts.end());
+        offset += batch.data[i].size;
+    }
+
+    RD_LOGD("Data Channel: Pushing batch of {} requests of size={} to all followers", batch.rreqs.size(), batch.size);
+    COUNTER_INCREMENT(m_metrics, push_data_batch_cnt, 1);
+    HISTOGRAM_OBSERVE(m_metrics, push_data_batch_entries, batch.rreqs.size());
+
+    group_msg_service()
+        ->data_service_request_unidirectional(nuraft_mesg::role_regex::ALL, PUSH_DATA_BATCH, *pkts)
+        .via(&folly::InlineExecutor::instance())
+        .thenValue([this, rreqs = std::move(batch.rreqs), builder, pkts](auto e) {
+            if (e.hasError()) {
+                RD_LOGE("Data Channel: Error in pushing batch of {} requests to all followers, error={}", rreqs.size(),
+                        e.error());
+                for (auto const& rreq : rreqs) {
+                    handle_error(rreq, RaftReplService::to_repl_error(e.error()));
+                }
+                return;
+            }
+            RD_LOGD("Data Channel: Data push completed for batch of {} requests", rreqs.size());
+            for (auto const& rreq : rreqs) {
+                rreq->trace_stage(repl_req_stage_t::DATA_RECEIVED);
+            }
+        });
+}
+
 void RaftReplDev::on_push_data_received(intrusive< sisl::GenericRpcData >& rpc_data) {
     auto const push_data_rcv_time = Clock::now();
     auto const& incoming_buf = rpc_data->request_blob();
@@ -387,18 +638,61 @@ void RaftReplDev::on_push_data_received(intrusive< sisl::GenericRpcData >& rpc_d
         rpc_data->send_response();
         return;
     }
+    if (is_witness()) {
+        RD_LOGT("Data Channel: PushData received on witness, ignoring this call");
+        rpc_data->send_response();
+        return;
+    }
 
     auto const fb_size =
         flatbuffers::ReadScalar< flatbuffers::uoffset_t >(incoming_buf.cbytes()) + sizeof(flatbuffers::uoffset_t);
     auto push_req = GetSizePrefixedPushDataRequest(incoming_buf.cbytes());
-    HS_DBG_ASSERT_EQ(fb_size + push_req->data_size(), incoming_buf.size(), "Size mismatch of data size vs buffer size");
+    auto const data_offset = fb_size + push_data_pad_size(fb_size, push_req->data_align());
+    HS_DBG_ASSERT_EQ(data_offset + push_req->data_size(), incoming_buf.size(),
+                     "Size mismatch of data size vs buffer size");
+
+    RD_LOGD("Data Channel: PushData received: time diff={} ms.", get_elapsed_time_ms(push_req->time_ms()));
+    on_pushed_entry(rpc_data, push_req, incoming_buf.cbytes() + data_offset, push_data_rcv_time);
+}
+
+void RaftReplDev::on_push_data_batch_received(intrusive< sisl::GenericRpcData >& rpc_data) {
+    auto const push_data_rcv_time = Clock::now();
+    auto const& incoming_buf = rpc_data->request_blob();
+    if (!incoming_buf.cbytes()) {
+        RD_LOGW("Data Channel: PushDataBatch received with empty buffer, ignoring this call");
+        rpc_data->send_response();
+        return;
+    }
+    if (is_witness()) {
+        RD_LOGT("Data Channel: PushDataBatch received on witness, ignoring this call");
+        rpc_data->send_response();
+        return;
+    }
+
+    auto const fb_size =
+        flatbuffers::ReadScalar< flatbuffers::uoffset_t >(incoming_buf.cbytes()) + sizeof(flatbuffers::uoffset_t);
+    auto batch_req = flatbuffers::GetSizePrefixedRoot< PushDataBatchRequest >(incoming_buf.cbytes());
+    RD_LOGD("Data Channel: PushDataBatch of {} requests received: time diff={} ms.", batch_req->entries()->size(),
+            get_elapsed_time_ms(batch_req->time_ms()));
+
+    // Entries of the batch share the rpc buffer, which each of them holds on to till its data is written
+    uint8_t const* data = incoming_buf.cbytes() + fb_size;
+    for (auto const* push_req : *batch_req->entries()) {
+        data += push_data_pad_size(uint64_cast(data - incoming_buf.cbytes()), push_req->data_align());
+        HS_DBG_ASSERT_LE(uint64_cast(data - incoming_buf.cbytes()) + push_req->data_size(), incoming_buf.size(),
+                         "Size mismatch of data size vs buffer size");
+        on_pushed_entry(rpc_data, push_req, data, push_data_rcv_time);
+        data += push_req->data_size();
+    }
+    HS_DBG_ASSERT_EQ(uint64_cast(data - incoming_buf.cbytes()), incoming_buf.size(),
+                     "Size mismatch of data size vs buffer size");
+}
 
+void RaftReplDev::on_pushed_entry(intrusive< sisl::GenericRpcData >& rpc_data, PushDataRequest const* push_req,
+                                  uint8_t const* data, Clock::time_point push_data_rcv_time) {
     sisl::blob header = sisl::blob{push_req->user_header()->Data(), push_req->user_header()->size()};
     sisl::blob key = sisl::blob{push_req->user_key()->Data(), push_req->user_key()->size()};
     repl_key rkey{.server_id = push_req->issuer_replica_id(), .term = push_req->raft_term(), .dsn = push_req->dsn()};
-    auto const req_orig_time_ms = push_req->time_ms();
-
-    RD_LOGD("Data Channel: PushData received: time diff={} ms.", get_elapsed_time_ms(req_orig_time_ms));
 
 #ifdef _PRERELEASE
     if (iomgr_flip::instance()->test_flip("drop_push_data_request")) {
@@ -409,6 +703,14 @@ void RaftReplDev::on_push_data_received(intrusive< sisl::GenericRpcData >& rpc_d
     }
 #endif
 
+    // Pushed data beyond the memory budget of the reqs is dropped, it is fetched from the leader once its log arrives
+    if (!resource_mgr().can_use_mem(mem_budget_t::REPL_REQS, push_req->data_size())) {
+        RD_LOGD("Data Channel: Dropping pushed data of rkey={} size={} as repl reqs are over their memory budget",
+                rkey.to_string(), push_req->data_size());
+        COUNTER_INCREMENT(m_metrics, push_data_dropped_cnt, 1);
+        return;
+    }
+
     auto rreq = applier_create_req(rkey, journal_type_t::HS_DATA_LINKED, header, key, push_req->data_size(),
                                    true /* is_data_channel */);
     if (rreq == nullptr) {
@@ -419,7 +721,10 @@ void RaftReplDev::on_push_data_received(intrusive< sisl::GenericRpcData >& rpc_d
         return;
     }
 
-    if (!rreq->save_pushed_data(rpc_data, incoming_buf.cbytes() + fb_size, push_req->data_size())) {
+    if ((r_cast< uintptr_t >(data) % data_service().get_align_size()) != 0) {
+        COUNTER_INCREMENT(m_metrics, push_data_copy_cnt, 1);
+    }
+    if (!rreq->save_pushed_data(rpc_data, data, push_req->data_size())) {
         RD_LOGD("Data Channel: Data already received for rreq=[{}], ignoring this data", rreq->to_string());
         return;
     }
@@ -439,8 +744,7 @@ void RaftReplDev::on_push_data_received(intrusive< sisl::GenericRpcData >& rpc_d
                 RD_DBG_ASSERT(false, "Error in writing data, error_code={}", err.value());
                 handle_error(rreq, ReplServiceError::DRIVE_WRITE_ERROR);
             } else {
-                rreq->add_state(repl_req_state_t::DATA_WRITTEN);
-                rreq->m_data_written_promise.setValue();
+                rreq->notify_data_written();
                 const auto data_log_diff_us =
                     push_data_rcv_time.time_since_epoch().count() > rreq->created_time().time_since_epoch().count()
                     ? get_elapsed_time_us(rreq->created_time(), push_data_rcv_time)
@@ -466,9 +770,8 @@ void RaftReplDev::on_push_data_received(intrusive< sisl::GenericRpcData >& rpc_d
 repl_req_ptr_t RaftReplDev::applier_create_req(repl_key const& rkey, journal_type_t code, sisl::blob const& user_header,
                                                sisl::blob const& key, uint32_t data_size,
                                                [[maybe_unused]] bool is_data_channel) {
-    auto const [it, happened] = m_repl_key_req_map.try_emplace(rkey, repl_req_ptr_t(new repl_req_ctx()));
-    RD_DBG_ASSERT((it != m_repl_key_req_map.end()), "Unexpected error in map_repl_key_to_req");
-    auto rreq = it->second;
+    auto [rreq, happened] = m_repl_key_req_map.try_emplace(rkey, repl_req_ctx::make_pooled());
+    RD_DBG_ASSERT(rreq != nullptr, "Unexpected error in map_repl_key_to_req");
 
     if (!happened) {
         // We already have the entry in the map, check if we are already allocated the blk by previous caller, in
@@ -492,6 +795,13 @@ repl_req_ptr_t RaftReplDev::applier_create_req(repl_key const& rkey, journal_typ
     if (!rreq->has_linked_data()) { return rreq; }
     if (rreq->has_state(repl_req_state_t::BLK_ALLOCATED)) { return rreq; }
 
+    // Witness keeps only the log of the entry, with an invalid blkid in place of the data it does not store
+    if (is_witness()) {
+        rreq->add_state(repl_req_state_t::DATA_RECEIVED);
+        rreq->add_state(repl_req_state_t::DATA_WRITTEN);
+        return rreq;
+    }
+
     auto alloc_status = rreq->alloc_local_blks(m_listener, data_size);
 #ifdef _PRERELEASE
     if (is_data_channel) {
@@ -518,29 +828,20 @@ repl_req_ptr_t RaftReplDev::applier_create_req(repl_key const& rkey, journal_typ
     return rreq;
 }
 
-folly::Future< folly::Unit > RaftReplDev::notify_after_data_written(std::vector< repl_req_ptr_t >* rreqs) {
-    std::vector< folly::Future< folly::Unit > > futs;
-    futs.reserve(rreqs->size());
+void RaftReplDev::wait_for_data_written(std::vector< repl_req_ptr_t > const& rreqs) {
     std::vector< repl_req_ptr_t > unreceived_data_reqs;
-
-    // Walk through the list of requests and wait for the data to be received and written
-    for (auto const& rreq : *rreqs) {
+    for (auto const& rreq : rreqs) {
         if (!rreq->has_linked_data()) { continue; }
         auto const status = uint32_cast(rreq->state());
-        if (status & uint32_cast(repl_req_state_t::DATA_WRITTEN)) {
-            RD_LOGD("Raft Channel: Data write completed and blkid mapped: rreq=[{}]", rreq->to_string());
-            continue;
-        }
-
-        if (!(status & uint32_cast(repl_req_state_t::DATA_RECEIVED))) {
+        // Proposer has the data on its own and only waits for its local write
+        if (!rreq->is_proposer() && !(status & uint32_cast(repl_req_state_t::DATA_WRITTEN)) &&
+            !(status & uint32_cast(repl_req_state_t::DATA_RECEIVED))) {
             // This is a relatively rare scenario which can happen, where the data is not received or localized yet,
             // because it was called as part of pack/unpack i.e bulk data transfer for a new replica. For these
             // cases, the first step of localization doesn't happen (because raft isn't going to give us
             // append_entry handler callback). Hence we do that step of receiving data now. The same scenario can
             // happen in case of leader is not the propose (i.e raft forwarding is enabled)
             unreceived_data_reqs.emplace_back(rreq);
-        } else {
-            futs.emplace_back(rreq->m_data_written_promise.getFuture());
         }
     }
 
@@ -556,27 +857,35 @@ folly::Future< folly::Unit > RaftReplDev::notify_after_data_written(std::vector<
         if (!wait_for_data_receive(unreceived_data_reqs, HS_DYNAMIC_CONFIG(consensus.data_receive_timeout_ms) * 10)) {
             HS_REL_ASSERT(false, "Data fetch timeout, should not happen");
         }
-        for (auto const& rreq : unreceived_data_reqs) {
-            futs.emplace_back(rreq->m_data_written_promise.getFuture());
-        }
     }
 
-    // All the entries are done already, no need to wait
-    if (futs.size() == 0) { return folly::makeFuture< folly::Unit >(folly::Unit{}); }
+    // Each request counts down as its data is written, so the batch wakes up on the write of the last of them
+    auto countdown = std::make_shared< std::latch >(std::ptrdiff_t(rreqs.size()));
+    for (auto const& rreq : rreqs) {
+        if (!rreq->has_linked_data() || !rreq->add_data_written_countdown(countdown)) { countdown->count_down(); }
+    }
+    countdown->wait();
 
-    return folly::collectAllUnsafe(futs).thenValue([this, rreqs](auto&& e) {
 #ifndef NDEBUG
-        for (auto const& rreq : *rreqs) {
-            if ((rreq == nullptr) || (!rreq->has_linked_data())) { continue; }
-            HS_DBG_ASSERT(rreq->has_state(repl_req_state_t::DATA_WRITTEN),
-                          "Data written promise raised without updating DATA_WRITTEN state for rkey={}",
-                          rreq->rkey().to_string());
-            RD_LOGD("Raft Channel: Data write completed and blkid mapped: rreq=[{}]", rreq->to_string());
-        }
+    for (auto const& rreq : rreqs) {
+        if (!rreq->has_linked_data()) { continue; }
+        HS_DBG_ASSERT(rreq->has_state(repl_req_state_t::DATA_WRITTEN),
+                      "Data written countdown raised without updating DATA_WRITTEN state for rkey={}",
+                      rreq->rkey().to_string());
+    }
 #endif
-        RD_LOGT("Data Channel: {} pending reqs's data are written", rreqs->size());
-        return folly::makeFuture< folly::Unit >(folly::Unit{});
+    RD_LOGT("Data Channel: {} pending reqs's data are written", rreqs.size());
+}
+
+void RaftReplDev::wait_for_proposer_data_written(std::vector< repl_req_ptr_t > const& rreqs) {
+    auto const pending = std::any_of(rreqs.cbegin(), rreqs.cend(), [](repl_req_ptr_t const& rreq) {
+        return rreq->is_proposer() && rreq->has_linked_data() && !rreq->has_state(repl_req_state_t::DATA_WRITTEN);
     });
+    if (!pending) { return; }
+
+    auto const start_time = Clock::now();
+    wait_for_data_written(rreqs);
+    HISTOGRAM_OBSERVE(m_metrics, leader_data_write_wait_latency_us, get_elapsed_time_us(start_time));
 }
 
 bool RaftReplDev::wait_for_data_receive(std::vector< repl_req_ptr_t > const& rreqs, uint64_t timeout_ms) {
@@ -596,23 +905,30 @@ bool RaftReplDev::wait_for_data_receive(std::vector< repl_req_ptr_t > const& rre
     // All the data has been received already, no need to wait
     if (futs.size() == 0) { return true; }
 
-    // If we are currently in resync mode, we can fetch the data immediately. Otherwise, stage it and wait for
-    // sometime before do an explicit fetch. This is so that, it is possible raft channel has come ahead of data
-    // channel and waiting for sometime avoid expensive fetch. On steady state, after a little bit of wait data
-    // would be reached automatically.
+    // If we are currently in resync mode, we can fetch the data immediately. Otherwise, wait for the data to be
+    // pushed for sometime before do an explicit fetch. This is so that, it is possible raft channel has come ahead of
+    // data channel and waiting for sometime avoid expensive fetch. On steady state, after a little bit of wait data
+    // would be reached automatically, which wakes up the wait right away.
     RD_LOG(DEBUG,
            "We haven't received data for {} out {} in reqs batch, will fetch and wait for {} ms, in_resync_mode()={} ",
            only_wait_reqs.size(), rreqs.size(), timeout_ms, is_resync_mode());
 
-    // We are yet to support reactive fetch from remote.
-    if (is_resync_mode()) {
-        check_and_fetch_remote_data(std::move(only_wait_reqs));
-    } else {
-        m_repl_svc.add_to_fetch_queue(shared_from_this(), std::move(only_wait_reqs));
+    auto all_futs = folly::collectAllUnsafe(futs);
+    auto const start_time = Clock::now();
+    if (!is_resync_mode()) {
+        auto const push_wait_ms = std::min(HS_DYNAMIC_CONFIG(consensus.wait_data_write_timer_ms), timeout_ms);
+        all_futs.wait(std::chrono::milliseconds(push_wait_ms));
+        if (all_futs.isReady()) { return true; }
+
+        // Fetch only the ones which are still not pushed
+        std::erase_if(only_wait_reqs,
+                      [](repl_req_ptr_t const& rreq) { return rreq->has_state(repl_req_state_t::DATA_RECEIVED); });
     }
+    if (!only_wait_reqs.empty()) { check_and_fetch_remote_data(std::move(only_wait_reqs)); }
 
     // block waiting here until all the futs are ready (data channel filled in and promises are made);
-    auto all_futs = folly::collectAllUnsafe(futs).wait(std::chrono::milliseconds(timeout_ms));
+    auto const elapsed_ms = get_elapsed_time_ms(start_time);
+    if (elapsed_ms < timeout_ms) { all_futs.wait(std::chrono::milliseconds(timeout_ms - elapsed_ms)); }
     return (all_futs.isReady());
 }
 
@@ -654,18 +970,53 @@ void RaftReplDev::check_and_fetch_remote_data(std::vector< repl_req_ptr_t > rreq
 void RaftReplDev::fetch_data_from_remote(std::vector< repl_req_ptr_t > rreqs) {
     if (rreqs.size() == 0) { return; }
 
+    // Fetches are pipelined to the originator, with upto the max of them outstanding at once
+    auto const originator = rreqs.front()->remote_blkid().server_id;
+    auto const max_outstanding = HS_DYNAMIC_CONFIG(consensus.data_fetch_max_outstanding);
+    {
+        std::unique_lock lg{m_fetch_mtx};
+        auto& outstanding = m_outstanding_fetches[originator];
+        if ((max_outstanding != 0) && (outstanding >= max_outstanding)) {
+            RD_LOGD("Data Channel: {} fetches outstanding to originator={}, queueing fetch of {} rreqs", outstanding,
+                    originator, rreqs.size());
+            m_queued_fetches[originator].push_back(std::move(rreqs));
+            COUNTER_INCREMENT(m_metrics, fetch_queued_cnt, 1);
+            return;
+        }
+        ++outstanding;
+    }
+    issue_fetch_data(std::move(rreqs));
+}
+
+void RaftReplDev::on_fetch_data_done(int32_t originator) {
+    std::vector< repl_req_ptr_t > next_rreqs;
+    {
+        std::unique_lock lg{m_fetch_mtx};
+        auto it = m_queued_fetches.find(originator);
+        if ((it == m_queued_fetches.end()) || it->second.empty()) {
+            --m_outstanding_fetches[originator];
+            return;
+        }
+        // Slot of the completed fetch is handed over to the next one in the queue
+        next_rreqs = std::move(it->second.front());
+        it->second.pop_front();
+    }
+    issue_fetch_data(std::move(next_rreqs));
+}
+
+void RaftReplDev::issue_fetch_data(std::vector< repl_req_ptr_t > rreqs) {
     std::vector< ::flatbuffers::Offset< RequestEntry > > entries;
     entries.reserve(rreqs.size());
 
     shared< flatbuffers::FlatBufferBuilder > builder = std::make_shared< flatbuffers::FlatBufferBuilder >();
     RD_LOGD("Data Channel : FetchData from remote: rreq.size={}, my server_id={}", rreqs.size(), server_id());
-    auto const& originator = rreqs.front()->remote_blkid().server_id;
+    auto const originator = rreqs.front()->remote_blkid().server_id;
 
+    // Originator reads the data by the blkid alone, so the header and the key, which could be as large as the data
+    // for small writes, are not serialized into the request
     for (auto const& rreq : rreqs) {
-        entries.push_back(CreateRequestEntry(*builder, rreq->lsn(), rreq->term(), rreq->dsn(),
-                                             builder->CreateVector(rreq->header().cbytes(), rreq->header().size()),
-                                             builder->CreateVector(rreq->key().cbytes(), rreq->key().size()),
-                                             rreq->remote_blkid().server_id /* blkid_originator */,
+        entries.push_back(CreateRequestEntry(*builder, rreq->lsn(), rreq->term(), rreq->dsn(), 0 /* user_header */,
+                                             0 /* user_key */, rreq->remote_blkid().server_id /* blkid_originator */,
                                              builder->CreateVector(rreq->remote_blkid().blkid.serialize().cbytes(),
                                                                    rreq->remote_blkid().blkid.serialized_size())));
         // relax this assert if there is a case in same batch originator can be different (can't think of one now)
@@ -694,8 +1045,9 @@ void RaftReplDev::fetch_data_from_remote(std::vector< repl_req_ptr_t > rreqs) {
             sisl::io_blob_list_t{
                 sisl::io_blob{builder->GetBufferPointer(), builder->GetSize(), false /* is_aligned */}})
         .via(&folly::InlineExecutor::instance())
-        .thenValue([this, builder, rreqs = std::move(rreqs), fetch_start_time](auto response) {
+        .thenValue([this, builder, rreqs = std::move(rreqs), fetch_start_time, originator](auto response) {
             COUNTER_DECREMENT(m_metrics, outstanding_data_fetch_cnt, 1);
+            on_fetch_data_done(originator);
             auto const fetch_latency_us = get_elapsed_time_us(fetch_start_time);
             HISTOGRAM_OBSERVE(m_metrics, rreq_data_fetch_latency_us, fetch_latency_us);
 
@@ -743,10 +1095,32 @@ void RaftReplDev::on_fetch_data_received(intrusive< sisl::GenericRpcData >& rpc_
 
     RD_LOGD("Data Channel: FetchData received: fetch_req.size={}", fetch_req->request()->entries()->size());
 
-    std::vector< sisl::sg_list > sgs_vec;
-    std::vector< folly::Future< bool > > futs;
-    sgs_vec.reserve(fetch_req->request()->entries()->size());
-    futs.reserve(fetch_req->request()->entries()->size());
+    // Blks of the entries are read in their order, with the contiguous ones of consecutive entries coalesced into range
+    // reads, each one of upto the max pieces of a blkid on the same chunk. Data of the reads, one after the other, is
+    // the data of the entries in the order they are requested.
+    struct range_read {
+        std::vector< BlkId > extents;
+        uint32_t size{0};
+    };
+    std::vector< range_read > reads;
+    auto const add_extent = [&reads, this](BlkId const& b) {
+        auto const size = b.blk_count() * get_blk_size();
+        if (!reads.empty() && (reads.back().extents.back().chunk_num() == b.chunk_num())) {
+            auto& r = reads.back();
+            auto& last = r.extents.back();
+            if ((last.blk_num() + last.blk_count() == b.blk_num()) &&
+                (uint32_cast(last.blk_count()) + b.blk_count() <= std::numeric_limits< blk_count_t >::max())) {
+                last = BlkId{last.blk_num(), blk_count_t(last.blk_count() + b.blk_count()), last.chunk_num()};
+                r.size += size;
+                return;
+            } else if (r.extents.size() < MultiBlkId::max_pieces) {
+                r.extents.push_back(b);
+                r.size += size;
+                return;
+            }
+        }
+        reads.push_back(range_read{.extents = {b}, .size = size});
+    };
 
     for (auto const& req : *(fetch_req->request()->entries())) {
         auto const& lsn = req->lsn();
@@ -768,18 +1142,35 @@ void RaftReplDev::on_fetch_data_received(intrusive< sisl::GenericRpcData >& rpc_
             RD_LOGD("Data Channel: FetchData received: dsn={} lsn={} my_blkid={}", req->dsn(), lsn,
                     local_blkid.to_string());
 
-            // prepare the sgs data buffer to read into;
-            auto const total_size = local_blkid.blk_count() * get_blk_size();
-            sisl::sg_list sgs;
-            sgs.size = total_size;
-            sgs.iovs.emplace_back(
-                iovec{.iov_base = iomanager.iobuf_alloc(get_blk_size(), total_size), .iov_len = total_size});
+            auto it = local_blkid.iterate();
+            while (auto const b = it.next()) {
+                add_extent(*b);
+            }
+        }
+    }
 
-            // accumulate the sgs for later use (send back to the requester));
-            sgs_vec.push_back(sgs);
-            futs.emplace_back(async_read(local_blkid, sgs, total_size));
+    std::vector< sisl::sg_list > sgs_vec;
+    std::vector< folly::Future< std::error_code > > futs;
+    sgs_vec.reserve(reads.size());
+    futs.reserve(reads.size());
+    for (auto const& r : reads) {
+        MultiBlkId read_blkid{r.extents.front()};
+        for (size_t i{1}; i < r.extents.size(); ++i) {
+            read_blkid.add(r.extents[i]);
         }
+
+        // prepare the sgs data buffer to read into;
+        sisl::sg_list sgs;
+        sgs.size = r.size;
+        sgs.iovs.emplace_back(iovec{.iov_base = iomanager.iobuf_alloc(get_blk_size(), r.size), .iov_len = r.size});
+
+        // accumulate the sgs for later use (send back to the requester));
+        sgs_vec.push_back(sgs);
+        futs.emplace_back(async_read(read_blkid, sgs, r.size));
     }
+    RD_LOGD("Data Channel: FetchData of {} entries is read with {} range reads",
+            fetch_req->request()->entries()->size(), reads.size());
+    COUNTER_INCREMENT(m_metrics, fetch_range_read_cnt, reads.size());
 
     folly::collectAllUnsafe(futs).thenValue(
         [this, rpc_data = std::move(rpc_data), sgs_vec = std::move(sgs_vec)](auto&& vf) {
@@ -830,6 +1221,9 @@ void RaftReplDev::handle_fetch_data_response(sisl::GenericClientResponse respons
     for (auto const& rreq : rreqs) {
         auto const data_size = rreq->remote_blkid().blkid.blk_count() * get_blk_size();
 
+        if ((r_cast< uintptr_t >(raw_data) % data_service().get_align_size()) != 0) {
+            COUNTER_INCREMENT(m_metrics, fetch_data_copy_cnt, 1);
+        }
         if (!rreq->save_fetched_data(response, raw_data, data_size)) {
             RD_DBG_ASSERT(rreq->local_blkid().is_valid(), "Invalid blkid for rreq={}", rreq->to_string());
             auto const local_size = rreq->local_blkid().blk_count() * get_blk_size();
@@ -857,8 +1251,7 @@ void RaftReplDev::handle_fetch_data_response(sisl::GenericClientResponse respons
 
                     RD_REL_ASSERT(!err,
                                   "Error in writing data"); // TODO: Find a way to return error to the Listener
-                    rreq->add_state(repl_req_state_t::DATA_WRITTEN);
-                    rreq->m_data_written_promise.setValue();
+                    rreq->notify_data_written();
 
                     RD_LOGD("Data Channel: Data Write completed rreq=[{}], data_write_latency_us={}, "
                             "total_write_latency_us={}, write_num_pieces={}",
@@ -886,9 +1279,7 @@ void RaftReplDev::commit_blk(repl_req_ptr_t rreq) {
     }
 }
 
-void RaftReplDev::handle_commit(repl_req_ptr_t rreq, bool recovery) {
-    commit_blk(rreq);
-
+void RaftReplDev::unlink_committed_req(repl_req_ptr_t const& rreq) {
     // Remove the request from repl_key map.
     m_repl_key_req_map.erase(rreq->rkey());
     // Remove the request from lsn map.
@@ -898,6 +1289,134 @@ void RaftReplDev::handle_commit(repl_req_ptr_t rreq, bool recovery) {
     while (cur_dsn <= rreq->dsn()) {
         m_next_dsn.compare_exchange_strong(cur_dsn, rreq->dsn() + 1);
     }
+}
+
+void RaftReplDev::handle_commit_batch(std::vector< repl_req_ptr_t > const& rreqs) {
+    wait_for_proposer_data_written(rreqs);
+
+    // Blks of the whole batch are committed in one pass, before any of the entries is handed over to the listener
+    for (auto const& rreq : rreqs) {
+        commit_blk(rreq);
+    }
+
+    // Control entries are applied by themselves, so the batches of the listener are the entries in between them
+    std::vector< repl_req_ptr_t > listener_rreqs;
+    listener_rreqs.reserve(rreqs.size());
+    auto const dispatch = [this, &listener_rreqs]() {
+        if (listener_rreqs.empty()) { return; }
+        apply_commit_batch(listener_rreqs);
+        listener_rreqs.clear();
+    };
+
+    for (auto const& rreq : rreqs) {
+        unlink_committed_req(rreq);
+        RD_LOGD("Raft channel: Commit rreq=[{}] in batch of {}", rreq->to_string(), rreqs.size());
+        if (rreq->op_code() == journal_type_t::HS_CTRL_DESTROY) {
+            dispatch();
+            leave();
+        } else if (rreq->op_code() == journal_type_t::HS_CTRL_REPLACE) {
+            dispatch();
+            replace_member(rreq);
+        } else {
+            listener_rreqs.push_back(rreq);
+        }
+    }
+    dispatch();
+    HISTOGRAM_OBSERVE(m_metrics, commit_batch_entries, rreqs.size());
+
+    auto prev_lsn = m_commit_upto_lsn.exchange(rreqs.back()->lsn());
+    RD_DBG_ASSERT_GT(rreqs.front()->lsn(), prev_lsn,
+                     "Out of order commit of lsns, it is not expected in RaftReplDev. cur_lsns={}, prev_lsns={}",
+                     rreqs.front()->lsn(), prev_lsn);
+    notify_read_index_waits(rreqs.back()->lsn());
+    note_activity();
+    for (auto const& rreq : rreqs) {
+        if (rreq->is_traced()) { publish_trace(rreq); }
+        if (rreq->is_proposer()) {
+            rreq->commit_completion().complete(ReplServiceError::OK);
+        } else {
+            rreq->clear();
+        }
+    }
+}
+
+void RaftReplDev::publish_trace(repl_req_ptr_t const& rreq) {
+    rreq->trace_stage(repl_req_stage_t::COMMITTED);
+    auto const trace = rreq->trace();
+    auto const stage_us = [&trace](repl_req_stage_t stage) { return trace.stage_us[s_cast< size_t >(stage)]; };
+    if (auto const us = stage_us(repl_req_stage_t::BLK_ALLOCATED); us >= 0) {
+        HISTOGRAM_OBSERVE(m_metrics, rreq_stage_blk_allocated_us, us);
+    }
+    if (auto const us = stage_us(repl_req_stage_t::DATA_RECEIVED); us >= 0) {
+        HISTOGRAM_OBSERVE(m_metrics, rreq_stage_data_received_us, us);
+    }
+    if (auto const us = stage_us(repl_req_stage_t::DATA_WRITTEN); us >= 0) {
+        HISTOGRAM_OBSERVE(m_metrics, rreq_stage_data_written_us, us);
+    }
+    if (auto const us = stage_us(repl_req_stage_t::PROPOSED); us >= 0) {
+        HISTOGRAM_OBSERVE(m_metrics, rreq_stage_proposed_us, us);
+    }
+    if (auto const us = stage_us(repl_req_stage_t::LOG_APPENDED); us >= 0) {
+        HISTOGRAM_OBSERVE(m_metrics, rreq_stage_log_appended_us, us);
+    }
+    if (auto const us = stage_us(repl_req_stage_t::LOG_FLUSHED); us >= 0) {
+        HISTOGRAM_OBSERVE(m_metrics, rreq_stage_log_flushed_us, us);
+    }
+    HISTOGRAM_OBSERVE(m_metrics, rreq_stage_committed_us, stage_us(repl_req_stage_t::COMMITTED));
+
+    RD_LOGD("Raft channel: Committed {}", trace.to_string());
+    m_repl_svc.repl_app()->on_repl_req_trace(m_group_id, trace);
+}
+
+void RaftReplDev::apply_commit_batch(std::vector< repl_req_ptr_t > const& rreqs) {
+    auto const parallelism = HS_DYNAMIC_CONFIG(consensus.commit_parallelism);
+    if ((parallelism <= 1) || (rreqs.size() <= 1)) {
+        m_listener->on_batch_commit(rreqs);
+        return;
+    }
+
+    // Entries are partitioned by their conflict key keeping their order in each partition, and the partitions are
+    // applied concurrently on the workers. An entry without a key is a barrier, applied by itself after the entries
+    // before it are applied.
+    std::vector< std::vector< repl_req_ptr_t > > parts(parallelism);
+    auto const apply_parts = [this, &parts]() {
+        auto const nparts = std::count_if(parts.cbegin(), parts.cend(), [](auto const& p) { return !p.empty(); });
+        if (nparts == 0) { return; }
+
+        std::latch done{nparts};
+        for (auto& part : parts) {
+            if (part.empty()) { continue; }
+            iomanager.run_on_forget(iomgr::reactor_regex::random_worker, iomgr::fiber_regex::syncio_only,
+                                    [this, &part, &done]() {
+                                        m_listener->on_batch_commit(part);
+                                        done.count_down();
+                                    });
+        }
+        done.wait();
+        COUNTER_INCREMENT(m_metrics, commit_parallel_apply_cnt, 1);
+        HISTOGRAM_OBSERVE(m_metrics, commit_parallel_parts, nparts);
+        for (auto& part : parts) {
+            part.clear();
+        }
+    };
+
+    for (auto const& rreq : rreqs) {
+        auto const key = m_listener->get_commit_conflict_key(rreq);
+        if (!key) {
+            apply_parts();
+            m_listener->on_batch_commit({rreq});
+        } else {
+            parts[*key % parallelism].push_back(rreq);
+        }
+    }
+    apply_parts();
+}
+
+void RaftReplDev::handle_commit(repl_req_ptr_t rreq, bool recovery) {
+    HS_CPU_SCOPE(REPLICATION);
+    if (!recovery) { wait_for_proposer_data_written({rreq}); }
+    commit_blk(rreq);
+    unlink_committed_req(rreq);
 
     RD_LOGD("Raft channel: Commit rreq=[{}]", rreq->to_string());
     if (rreq->op_code() == journal_type_t::HS_CTRL_DESTROY) {
@@ -913,8 +1432,15 @@ void RaftReplDev::handle_commit(repl_req_ptr_t rreq, bool recovery) {
         RD_DBG_ASSERT_GT(rreq->lsn(), prev_lsn,
                          "Out of order commit of lsns, it is not expected in RaftReplDev. cur_lsns={}, prev_lsns={}",
                          rreq->lsn(), prev_lsn);
+        notify_read_index_waits(rreq->lsn());
+        note_activity();
+        if (rreq->is_traced()) { publish_trace(rreq); }
+    }
+    if (rreq->is_proposer()) {
+        rreq->commit_completion().complete(ReplServiceError::OK);
+    } else {
+        rreq->clear();
     }
-    if (!rreq->is_proposer()) { rreq->clear(); }
 }
 
 void RaftReplDev::handle_error(repl_req_ptr_t const& rreq, ReplServiceError err) {
@@ -951,6 +1477,7 @@ void RaftReplDev::handle_error(repl_req_ptr_t const& rreq, ReplServiceError err)
     if (rreq->is_proposer()) {
         // Notify the proposer about the error
         m_listener->on_error(err, rreq->header(), rreq->key(), rreq);
+        rreq->commit_completion().complete(err);
     }
     rreq->clear();
 }
@@ -972,9 +1499,7 @@ static bool blob_equals(sisl::blob const& a, sisl::blob const& b) {
 }
 
 repl_req_ptr_t RaftReplDev::repl_key_to_req(repl_key const& rkey) const {
-    auto const it = m_repl_key_req_map.find(rkey);
-    if (it == m_repl_key_req_map.cend()) { return nullptr; }
-    return it->second;
+    return m_repl_key_req_map.find(rkey);
 }
 
 folly::Future< std::error_code > RaftReplDev::async_read(MultiBlkId const& bid, sisl::sg_list& sgs, uint32_t size,
@@ -982,6 +1507,147 @@ folly::Future< std::error_code > RaftReplDev::async_read(MultiBlkId const& bid,
     return data_service().async_read(bid, sgs, size, part_of_batch);
 }
 
+folly::Future< std::error_code > RaftReplDev::async_hedged_read(MultiBlkId const& blkid, RemoteBlkId const& peer_blkid,
+                                                                sisl::sg_list& sgs, uint32_t size) {
+    // Only the originator of the data can serve it by its blkid
+    auto const budget_pct = int64_cast(HS_DYNAMIC_CONFIG(consensus.hedged_read_budget_pct));
+    if ((budget_pct == 0) || (peer_blkid.server_id == server_id()) || !peer_blkid.blkid.is_valid()) {
+        return async_read(blkid, sgs, size);
+    }
+
+    // Each read accrues its share of a fetch, upto a burst of a few fetches
+    static constexpr int64_t max_budget{16 * 1000};
+    auto budget = m_hedge_budget.load(std::memory_order_relaxed);
+    while ((budget < max_budget) &&
+           !m_hedge_budget.compare_exchange_weak(budget, std::min(budget + (budget_pct * 10), max_budget),
+                                                 std::memory_order_relaxed)) {}
+
+    auto hr = std::make_shared< hedged_read >();
+    hr->peer_blkid = peer_blkid;
+    hr->sgs = sgs;
+    hr->size = size;
+    hr->local_sgs.size = size;
+    hr->local_sgs.iovs.emplace_back(iovec{.iov_base = iomanager.iobuf_alloc(get_blk_size(), size), .iov_len = size});
+    hr->start_time = Clock::now();
+    auto fut = hr->promise.getFuture();
+    {
+        std::unique_lock lg{m_hedged_read_mtx};
+        m_hedged_reads.push_back(hr);
+    }
+
+    data_service().async_read(blkid, hr->local_sgs, size).thenValue([this, hr](std::error_code err) {
+        // Same gains as TCP rtt estimation. Updates racing with each other only lose some of the samples.
+        auto const lat = int64_cast(get_elapsed_time_us(hr->start_time));
+        auto mean = m_read_lat_us.load(std::memory_order_relaxed);
+        auto dev = m_read_lat_dev_us.load(std::memory_order_relaxed);
+        if (mean == 0) {
+            mean = lat;
+            dev = lat / 2;
+        } else {
+            dev += (std::abs(lat - mean) - dev) / 4;
+            mean += (lat - mean) / 8;
+        }
+        m_read_lat_us.store(mean, std::memory_order_relaxed);
+        m_read_lat_dev_us.store(dev, std::memory_order_relaxed);
+
+        auto const buf = r_cast< uint8_t* >(hr->local_sgs.iovs[0].iov_base);
+        if (err) {
+            COUNTER_INCREMENT(m_metrics, read_err_cnt, 1);
+            if (!hr->done.exchange(true)) { hr->promise.setValue(err); }
+        } else {
+            complete_hedged_read(*hr, buf, hr->size);
+        }
+        iomanager.iobuf_free(buf);
+    });
+    return fut;
+}
+
+bool RaftReplDev::complete_hedged_read(hedged_read& hr, uint8_t const* data, uint32_t size) {
+    if (hr.done.exchange(true)) { return false; }
+
+    uint32_t offset{0};
+    for (auto const& iov : hr.sgs.iovs) {
+        if (offset >= size) { break; }
+        auto const n = std::min(uint32_cast(iov.iov_len), size - offset);
+        std::memcpy(iov.iov_base, data + offset, n);
+        offset += n;
+    }
+    hr.promise.setValue(std::error_code{});
+    return true;
+}
+
+void RaftReplDev::hedge_overdue_reads() {
+    auto const delay_us =
+        std::max(m_read_lat_us.load(std::memory_order_relaxed) + 2 * m_read_lat_dev_us.load(std::memory_order_relaxed),
+                 int64_cast(HS_DYNAMIC_CONFIG(consensus.hedged_read_min_delay_us)));
+
+    std::vector< shared< hedged_read > > overdue;
+    {
+        std::unique_lock lg{m_hedged_read_mtx};
+        while (!m_hedged_reads.empty()) {
+            auto& hr = m_hedged_reads.front();
+            if (!hr->done.load()) {
+                if (int64_cast(get_elapsed_time_us(hr->start_time)) < delay_us) { break; }
+                overdue.push_back(std::move(hr));
+            }
+            m_hedged_reads.pop_front();
+        }
+    }
+
+    for (auto& hr : overdue) {
+        // Without a fetch left in the budget, the read just waits for its local read
+        if (m_hedge_budget.fetch_sub(1000, std::memory_order_relaxed) < 1000) {
+            m_hedge_budget.fetch_add(1000, std::memory_order_relaxed);
+            continue;
+        }
+        fetch_hedged_read(std::move(hr));
+    }
+}
+
+void RaftReplDev::fetch_hedged_read(shared< hedged_read > hr) {
+    auto const& rbid = hr->peer_blkid;
+    shared< flatbuffers::FlatBufferBuilder > builder = std::make_shared< flatbuffers::FlatBufferBuilder >();
+    std::vector< ::flatbuffers::Offset< RequestEntry > > entries;
+    entries.push_back(CreateRequestEntry(*builder, -1 /* lsn */, 0 /* raft_term */, 0 /* dsn */, 0 /* user_header */,
+                                         0 /* user_key */, rbid.server_id /* blkid_originator */,
+                                         builder->CreateVector(rbid.blkid.serialize().cbytes(),
+                                                               rbid.blkid.serialized_size())));
+    builder->FinishSizePrefixed(
+        CreateFetchData(*builder, CreateFetchDataRequest(*builder, builder->CreateVector(entries))));
+
+    COUNTER_INCREMENT(m_metrics, hedged_read_cnt, 1);
+    RD_LOGD("Hedging local read of {} us with a fetch of blkid={} from originator={}",
+            get_elapsed_time_us(hr->start_time), rbid.blkid.to_string(), rbid.server_id);
+
+    auto const originator = rbid.server_id;
+    group_msg_service()
+        ->data_service_request_bidirectional(
+            originator, FETCH_DATA,
+            sisl::io_blob_list_t{
+                sisl::io_blob{builder->GetBufferPointer(), builder->GetSize(), false /* is_aligned */}})
+        .via(&folly::InlineExecutor::instance())
+        .thenValue([this, builder, hr = std::move(hr), originator](auto response) {
+            if (!response) {
+                // Local read is still in flight, which completes the read
+                RD_LOGD("Hedged fetch from originator={} failed, error={}", originator, response.error());
+                COUNTER_INCREMENT(m_metrics, hedged_read_err_cnt, 1);
+                return;
+            }
+            builder->Release();
+
+            auto const resp_blob = response.value().response_blob();
+            if (resp_blob.size() < hr->size) {
+                RD_LOGD("Hedged fetch from originator={} returned size={}, expected={}", originator, resp_blob.size(),
+                        hr->size);
+                COUNTER_INCREMENT(m_metrics, hedged_read_err_cnt, 1);
+                return;
+            }
+            if (complete_hedged_read(*hr, resp_blob.cbytes(), hr->size)) {
+                COUNTER_INCREMENT(m_metrics, hedged_read_win_cnt, 1);
+            }
+        });
+}
+
 void RaftReplDev::async_free_blks(int64_t, MultiBlkId const& bid) {
     // TODO: For timeline consistency required, we should retain the blkid that is changed and write that to another
     // journal.
@@ -1000,12 +1666,127 @@ AsyncReplResult<> RaftReplDev::become_leader() {
 
 bool RaftReplDev::is_leader() const { return m_repl_svc_ctx->is_raft_leader(); }
 
+bool RaftReplDev::yield_leadership_to(replica_id_t successor) {
+    if (!is_leader()) { return false; }
+    RD_LOGI("Yielding leadership to replica={}", boost::uuids::to_string(successor));
+    raft_server()->yield_leadership(false /* immediate */, nuraft_mesg::to_server_id(successor));
+    return true;
+}
+
+ReplServiceError RaftReplDev::promote_witness() {
+    if (!is_witness()) { return ReplServiceError::OK; }
+    {
+        std::unique_lock lg{m_sb_mtx};
+        m_rd_sb->is_witness = 0x0;
+        m_rd_sb.write();
+    }
+    RD_LOGI("Witness promoted to a full member, data of the entries upto lsn={} is to be resynced",
+            m_commit_upto_lsn.load());
+    return ReplServiceError::OK;
+}
+
 replica_id_t RaftReplDev::get_leader_id() const {
     static replica_id_t empty_uuid = boost::uuids::nil_uuid();
     auto leader = m_repl_svc_ctx->raft_leader_id();
     return leader.empty() ? empty_uuid : boost::lexical_cast< replica_id_t >(leader);
 }
 
+AsyncReplResult< repl_lsn_t > RaftReplDev::read_index() {
+    if (is_leader()) { return make_async_success< repl_lsn_t >(m_commit_upto_lsn.load()); }
+
+    auto const leader = raft_server()->get_leader();
+    if (leader < 0) { return make_async_error< repl_lsn_t >(ReplServiceError::NOT_LEADER); }
+
+    COUNTER_INCREMENT(m_metrics, read_index_cnt, 1);
+    return group_msg_service()
+        ->data_service_request_bidirectional(leader, READ_INDEX, sisl::io_blob_list_t{})
+        .via(&folly::InlineExecutor::instance())
+        .thenValue([this](auto response) {
+            if (response.hasError()) {
+                RD_LOGD("Read index request to the leader failed, error={}", response.error());
+                return make_async_error< repl_lsn_t >(RaftReplService::to_repl_error(response.error()));
+            }
+
+            // Leader responds with nothing if it is not the leader anymore
+            auto const blob = response.value().response_blob();
+            if (blob.size() != sizeof(repl_lsn_t)) {
+                return make_async_error< repl_lsn_t >(ReplServiceError::NOT_LEADER);
+            }
+            return wait_for_commit_lsn(*r_cast< repl_lsn_t const* >(blob.cbytes()));
+        });
+}
+
+void RaftReplDev::on_read_index_received(intrusive< sisl::GenericRpcData >& rpc_data) {
+    if (!is_leader()) {
+        rpc_data->send_response();
+        return;
+    }
+
+    auto lsn = std::make_unique< repl_lsn_t >(m_commit_upto_lsn.load());
+    nuraft_mesg::io_blob_list_t pkts = sisl::io_blob_list_t{
+        sisl::io_blob{uintptr_cast(lsn.get()), sizeof(repl_lsn_t), false /* is_aligned */}};
+    rpc_data->set_comp_cb([lsn = std::move(lsn)](boost::intrusive_ptr< sisl::GenericRpcData >&) {});
+    rpc_data->send_response(pkts);
+}
+
+AsyncReplResult< repl_lsn_t > RaftReplDev::wait_for_commit_lsn(repl_lsn_t lsn) {
+    if (m_commit_upto_lsn.load() >= lsn) { return make_async_success< repl_lsn_t >(m_commit_upto_lsn.load()); }
+
+    std::unique_lock lg{m_read_index_mtx};
+    m_num_read_index_waits.fetch_add(1);
+
+    // Checked again after the wait is counted, for a commit which didn't see it
+    auto const commit_lsn = m_commit_upto_lsn.load();
+    if (commit_lsn >= lsn) {
+        m_num_read_index_waits.fetch_sub(1);
+        return make_async_success< repl_lsn_t >(commit_lsn);
+    }
+
+    auto [p, sf] = folly::makePromiseContract< ReplResult< repl_lsn_t > >();
+    m_read_index_waits.emplace(lsn, read_index_wait{.promise = std::move(p), .start_time = Clock::now()});
+    return std::move(sf);
+}
+
+void RaftReplDev::notify_read_index_waits(repl_lsn_t lsn) {
+    if (m_num_read_index_waits.load() == 0) { return; }
+
+    std::vector< folly::Promise< ReplResult< repl_lsn_t > > > ready;
+    {
+        std::unique_lock lg{m_read_index_mtx};
+        for (auto it = m_read_index_waits.begin(); (it != m_read_index_waits.end()) && (it->first <= lsn);) {
+            ready.push_back(std::move(it->second.promise));
+            it = m_read_index_waits.erase(it);
+        }
+        m_num_read_index_waits.fetch_sub(ready.size());
+    }
+    for (auto& p : ready) {
+        p.setValue(lsn);
+    }
+}
+
+void RaftReplDev::expire_read_index_waits() {
+    if (m_num_read_index_waits.load() == 0) { return; }
+
+    auto const timeout_ms = HS_DYNAMIC_CONFIG(consensus.read_index_timeout_ms);
+    std::vector< folly::Promise< ReplResult< repl_lsn_t > > > expired;
+    {
+        std::unique_lock lg{m_read_index_mtx};
+        for (auto it = m_read_index_waits.begin(); it != m_read_index_waits.end();) {
+            if (get_elapsed_time_ms(it->second.start_time) >= timeout_ms) {
+                expired.push_back(std::move(it->second.promise));
+                it = m_read_index_waits.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        m_num_read_index_waits.fetch_sub(expired.size());
+    }
+    if (!expired.empty()) { RD_LOGW("{} read indexes timed out waiting for the commit lsn", expired.size()); }
+    for (auto& p : expired) {
+        p.setValue(folly::makeUnexpected(ReplServiceError::TIMEOUT));
+    }
+}
+
 std::vector< peer_info > RaftReplDev::get_replication_status() const {
     std::vector< peer_info > pi;
     auto rep_status = m_repl_svc_ctx->get_raft_status();
@@ -1149,7 +1930,13 @@ void RaftReplDev::permanent_destroy() {
     m_rd_sb.destroy();
     m_raft_config_sb.destroy();
     m_data_journal->remove_store();
-    logstore_service().destroy_log_dev(m_data_journal->logdev_id());
+    if (m_repl_svc.release_logdev(m_data_journal->logdev_id())) {
+        logstore_service().destroy_log_dev(m_data_journal->logdev_id());
+    } else if (m_free_blks_journal) {
+        // Logdev is shared with other repl devs, so only the logstores of this one are removed from it
+        logstore_service().remove_log_store(m_data_journal->logdev_id(), m_free_blks_journal->get_store_id());
+        m_free_blks_journal.reset();
+    }
     m_stage.update([](auto* stage) { *stage = repl_dev_stage_t::PERMANENT_DESTROYED; });
 }
 
@@ -1211,6 +1998,13 @@ std::pair< bool, nuraft::cb_func::ReturnCode > RaftReplDev::handle_raft_event(nu
             sisl::VectorPool< repl_req_ptr_t >::free(reqs);
         }
         return {true, ret};
+    } else if ((type == nuraft::cb_func::Type::BecomeLeader) && is_witness()) {
+        // Witness can't serve the data to the followers, so it hands over the leadership to a full member right away
+        RD_LOGI("Raft channel: Witness became leader, yielding the leadership");
+        iomanager.run_on_forget(iomgr::reactor_regex::random_worker, [this]() {
+            raft_server()->yield_leadership(true /* immediate */, -1 /* successor */);
+        });
+        return {true, ret};
     } else {
         return {false, ret};
     }
@@ -1220,7 +2014,26 @@ void RaftReplDev::flush_durable_commit_lsn() {
     auto const lsn = m_commit_upto_lsn.load();
     std::unique_lock lg{m_sb_mtx};
     m_rd_sb->durable_commit_lsn = lsn;
-    m_rd_sb.write();
+
+    // Written in the background with the superblks of the other repl devs, by the next flush of the deferred meta
+    // updates. Log is compacted only upto the durable lsn that is known to be persisted.
+    m_rd_sb.deferred_write().thenValue([wp = weak_from_this(), lsn](bool persisted) {
+        auto rdev = wp.lock();
+        if (persisted && rdev) { rdev->update_persisted_durable_lsn(lsn); }
+    });
+}
+
+void RaftReplDev::update_persisted_durable_lsn(repl_lsn_t lsn) {
+    auto cur = m_persisted_durable_lsn.load(std::memory_order_relaxed);
+    while ((cur < lsn) && !m_persisted_durable_lsn.compare_exchange_weak(cur, lsn, std::memory_order_relaxed)) {}
+}
+
+void RaftReplDev::compact_log(uint32_t num_reserved_entries) {
+    auto const durable_lsn = m_persisted_durable_lsn.load(std::memory_order_relaxed);
+    auto const upto_lsn = std::min(m_compact_lsn.load(), durable_lsn);
+    RD_LOGT("Compacting log upto lsn={}, compact_lsn={} durable_commit_lsn={}", upto_lsn, m_compact_lsn.load(),
+            durable_lsn);
+    m_data_journal->truncate(num_reserved_entries, upto_lsn);
 }
 
 ///////////////////////////////////  Private metohds ////////////////////////////////////
@@ -1242,6 +2055,7 @@ void RaftReplDev::cp_flush(CP* cp, cshared<ReplDevCPContext> ctx) {
     m_rd_sb->checkpoint_lsn = lsn;
     m_rd_sb->last_applied_dsn = dsn;
     m_rd_sb.write();
+    update_persisted_durable_lsn(m_rd_sb->durable_commit_lsn);
     m_last_flushed_commit_lsn = lsn;
     RD_LOGD("cp flush in raft repl dev, lsn={}, clsn={}, next_dsn={}, cp string:{}", lsn, clsn, m_next_dsn.load(),
             cp->to_string());
@@ -1265,7 +2079,9 @@ void RaftReplDev::cp_cleanup(CP*) {}
 
 void RaftReplDev::gc_repl_reqs() {
     std::vector< int64_t > expired_keys;
-    m_state_machine->iterate_repl_reqs([this, &expired_keys](auto key, auto rreq) {
+    // Only a part of the requests are swept each time, to not hold up the reaper on a large map
+    auto const max_shards = HS_DYNAMIC_CONFIG(consensus.gc_repl_req_shards_per_pass);
+    m_state_machine->sweep_repl_reqs(max_shards, [this, &expired_keys](auto key, auto rreq) {
         if (rreq->is_proposer()) {
             // don't clean up proposer's request
             return;
@@ -1289,9 +2105,7 @@ void RaftReplDev::gc_repl_reqs() {
 
             // 2. remove from the m_repl_key_req_map
             // handle_error during fetch data response might have already removed the rreq from the this map
-            if (m_repl_key_req_map.find(rreq->rkey()) != m_repl_key_req_map.end()) {
-                m_repl_key_req_map.erase(rreq->rkey());
-            }
+            m_repl_key_req_map.erase_if_equal(rreq->rkey(), rreq);
         }
     });
 
@@ -1318,32 +2132,17 @@ void RaftReplDev::on_log_found(logstore_seq_num_t lsn, log_buffer buf, void* ctx
     RD_LOGT("Raft Channel: Applying Raft log_entry upon recovery: server_id={}, term={}, journal_entry=[{}] ",
             jentry->server_id, lentry->get_term(), jentry->to_string());
 
-    auto entry_to_hdr = [](repl_journal_entry* jentry) {
-        return sisl::blob{uintptr_cast(jentry) + sizeof(repl_journal_entry), jentry->user_header_size};
-    };
-
-    auto entry_to_key = [](repl_journal_entry* jentry) {
-        return sisl::blob{uintptr_cast(jentry) + sizeof(repl_journal_entry) + jentry->user_header_size,
-                          jentry->key_size};
-    };
-
-    auto entry_to_val = [](repl_journal_entry* jentry) {
-        return sisl::blob{uintptr_cast(jentry) + sizeof(repl_journal_entry) + jentry->user_header_size +
-                              jentry->key_size,
-                          jentry->value_size};
-    };
-
     repl_key const rkey{.server_id = jentry->server_id, .term = lentry->get_term(), .dsn = jentry->dsn};
 
-    auto const [it, happened] = m_repl_key_req_map.try_emplace(rkey, repl_req_ptr_t(new repl_req_ctx()));
-    RD_DBG_ASSERT((it != m_repl_key_req_map.end()), "Unexpected error in map_repl_key_to_req");
-    auto rreq = it->second;
+    auto [rreq, happened] = m_repl_key_req_map.try_emplace(rkey, repl_req_ctx::make_pooled());
+    RD_DBG_ASSERT(rreq != nullptr, "Unexpected error in map_repl_key_to_req");
     RD_DBG_ASSERT(happened, "rreq already exists for rkey={}", rkey.to_string());
     uint32_t data_size{0u};
 
     if ((jentry->code == journal_type_t::HS_DATA_LINKED) && (jentry->value_size > 0)) {
         MultiBlkId entry_blkid;
-        entry_blkid.deserialize(entry_to_val(jentry), true /* copy */);
+        entry_blkid.deserialize(journal_entry_value(jentry), true /* copy */);
+        // Entries logged while this replica was a witness have an invalid blkid, since their data is not stored here
         data_size = entry_blkid.blk_count() * get_blk_size();
         rreq->set_local_blkid(entry_blkid);
     }
@@ -1351,7 +2150,8 @@ void RaftReplDev::on_log_found(logstore_seq_num_t lsn, log_buffer buf, void* ctx
     rreq->set_lsn(repl_lsn);
     // keep lentry in scope for the lyfe cycle of the rreq
     rreq->set_lentry(lentry);
-    rreq->init(rkey, jentry->code, false /* is_proposer */, entry_to_hdr(jentry), entry_to_key(jentry), data_size);
+    auto const [header, key] = journal_entry_header_key(jentry, rreq->hdr_key_buf());
+    rreq->init(rkey, jentry->code, false /* is_proposer */, header, key, data_size);
     // we load the log from log device, implies log flushed.  We only flush log after data is written to data device.
     rreq->add_state(repl_req_state_t::BLK_ALLOCATED);
     rreq->add_state(repl_req_state_t::DATA_RECEIVED);
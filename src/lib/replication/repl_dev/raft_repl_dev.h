@@ -1,5 +1,7 @@
 #pragma once
 
+#include <deque>
+#include <map>
 #include <string>
 
 #include <libnuraft/ptr.hxx>
@@ -18,13 +20,14 @@ namespace homestore {
 
 #pragma pack(1)
 struct raft_repl_dev_superblk : public repl_dev_superblk {
-    static constexpr uint32_t RAFT_REPL_DEV_SB_VERSION = 1;
+    static constexpr uint32_t RAFT_REPL_DEV_SB_VERSION = 2; // Version 2 added is_witness
 
     uint32_t raft_sb_version{RAFT_REPL_DEV_SB_VERSION};
     logstore_id_t free_blks_journal_id; // Logstore id for storing free blkid records
     uint8_t is_timeline_consistent; // Flag to indicate whether the recovery of followers need to be timeline consistent
     uint64_t last_applied_dsn;      // Last applied data sequence number
     uint8_t destroy_pending;        // Flag to indicate whether the group is in destroy pending state
+    uint8_t is_witness;             // Flag to indicate whether this replica stores only the log and not the data
 
     uint32_t get_raft_sb_version() const { return raft_sb_version; }
 };
@@ -51,6 +54,16 @@ public:
         REGISTER_COUNTER(fetch_total_blk_size, "total fetch data blocks size", "fetch_total_blk_size", {"op", "fetch"});
         REGISTER_COUNTER(fetch_total_entries_cnt, "total fetch total entries count", "fetch_total_entries_cnt",
                          {"op", "fetch"});
+        REGISTER_COUNTER(fetch_queued_cnt, "total fetch data queued behind the outstanding ones", "fetch_queued_cnt",
+                         {"op", "fetch"});
+        REGISTER_COUNTER(fetch_range_read_cnt, "total range reads serving the fetch data requests",
+                         "fetch_range_read_cnt", {"op", "fetch"});
+        REGISTER_COUNTER(hedged_read_cnt, "total local reads hedged by fetching the data from the peer",
+                         "hedged_read_cnt", {"op", "read"});
+        REGISTER_COUNTER(hedged_read_win_cnt, "total hedged reads served by the peer before the local read",
+                         "hedged_read_win_cnt", {"op", "read"});
+        REGISTER_COUNTER(hedged_read_err_cnt, "total hedged fetches from the peer which failed", "hedged_read_err_cnt",
+                         {"op", "read"});
 
         // TODO: do we want to put this under _PRERELEASE only?
         REGISTER_COUNTER(total_read_cnt, "total write count", "total_write_cnt", {"op", "read"}); // placeholder
@@ -89,11 +102,52 @@ public:
         REGISTER_HISTOGRAM(rreq_pieces_per_write, "Number of individual pieces per write",
                            HistogramBucketsType(LinearUpto64Buckets));
 
+        // Data channel batching of pushes
+        REGISTER_COUNTER(push_data_batch_cnt, "total push data batch rpcs", "push_data_batch_cnt", {"op", "push"});
+        REGISTER_HISTOGRAM(push_data_batch_entries, "Number of requests per push data batch",
+                           HistogramBucketsType(LinearUpto64Buckets));
+        REGISTER_COUNTER(push_data_copy_cnt, "total pushed data copied into an aligned buffer before the write",
+                         "push_data_copy_cnt", {"op", "push"});
+        REGISTER_COUNTER(push_data_dropped_cnt, "total pushed data dropped for exceeding the memory budget",
+                         "push_data_dropped_cnt", {"op", "push"});
+        REGISTER_COUNTER(fetch_data_copy_cnt, "total fetched data copied into an aligned buffer before the write",
+                         "fetch_data_copy_cnt", {"op", "fetch"});
+
         // Raft channel metrics
+        REGISTER_COUNTER(quiesce_cnt, "total times the group is quiesced while idle", "quiesce_cnt", {"op", "raft"});
+        REGISTER_COUNTER(append_batch_resize_cnt, "total times the append batch is resized by the follower lag",
+                         "append_batch_resize_cnt", {"op", "raft"});
+        REGISTER_COUNTER(read_index_cnt, "total read indexes asked of the leader", "read_index_cnt", {"op", "read"});
+        REGISTER_COUNTER(snapshot_read_ahead_hit_cnt, "total snapshot objects sent from the ones read ahead",
+                         "snapshot_read_ahead_hit_cnt", {"op", "snapshot"});
+        REGISTER_HISTOGRAM(commit_batch_entries, "Number of entries per batch of the batched commit",
+                           HistogramBucketsType(LinearUpto64Buckets));
+        REGISTER_COUNTER(commit_parallel_apply_cnt, "total batches of committed entries applied concurrently",
+                         "commit_parallel_apply_cnt", {"op", "commit"});
+        REGISTER_HISTOGRAM(commit_parallel_parts, "Number of partitions of a batch applied concurrently",
+                           HistogramBucketsType(LinearUpto64Buckets));
         REGISTER_HISTOGRAM(raft_end_of_append_batch_latency_us, "Raft end_of_append_batch latency in us",
                            "raft_logstore_append_latency", {"op", "end_of_append_batch"});
         REGISTER_HISTOGRAM(data_channel_wait_latency_us, "Data channel wait latency in us",
                            "raft_logstore_append_latency", {"op", "wait_for_data"});
+        REGISTER_HISTOGRAM(leader_data_write_wait_latency_us,
+                           "Wait in us for the leader's local data write of the committed entries");
+
+        // Time since the start of the sampled requests on this replica to each stage of them
+        REGISTER_HISTOGRAM(rreq_stage_blk_allocated_us, "Traced rreq time to blk allocated in us",
+                           "rreq_stage_latency", {"stage", "blk_allocated"});
+        REGISTER_HISTOGRAM(rreq_stage_data_received_us, "Traced rreq time to data received in us",
+                           "rreq_stage_latency", {"stage", "data_received"});
+        REGISTER_HISTOGRAM(rreq_stage_data_written_us, "Traced rreq time to data written in us",
+                           "rreq_stage_latency", {"stage", "data_written"});
+        REGISTER_HISTOGRAM(rreq_stage_proposed_us, "Traced rreq time to proposed in us", "rreq_stage_latency",
+                           {"stage", "proposed"});
+        REGISTER_HISTOGRAM(rreq_stage_log_appended_us, "Traced rreq time to log appended in us",
+                           "rreq_stage_latency", {"stage", "log_appended"});
+        REGISTER_HISTOGRAM(rreq_stage_log_flushed_us, "Traced rreq time to log flushed in us", "rreq_stage_latency",
+                           {"stage", "log_flushed"});
+        REGISTER_HISTOGRAM(rreq_stage_committed_us, "Traced rreq time to committed in us", "rreq_stage_latency",
+                           {"stage", "committed"});
 
         register_me_to_farm();
     }
@@ -107,6 +161,7 @@ public:
 
 class RaftReplService;
 class CP;
+struct PushDataRequest;
 struct ReplDevCPContext {
     repl_lsn_t cp_lsn;
     repl_lsn_t compacted_to_lsn;
@@ -119,7 +174,7 @@ class RaftReplDev : public ReplDev,
 private:
     shared< RaftStateMachine > m_state_machine;
     RaftReplService& m_repl_svc;
-    folly::ConcurrentHashMap< repl_key, repl_req_ptr_t, repl_key::Hasher > m_repl_key_req_map;
+    ShardedReqMap< repl_key, repl_req_ptr_t, repl_key::Hasher > m_repl_key_req_map;
     nuraft_mesg::Manager& m_msg_mgr;
     group_id_t m_group_id;     // Replication Group id
     std::string m_rdev_name;   // Short name for the group for easy debugging
@@ -141,6 +196,7 @@ private:
     std::mutex m_sb_mtx; // Lock to protect the repl dev superblock
 
     repl_lsn_t m_last_flushed_commit_lsn{0}; // LSN upto which it was flushed to persistent store
+    std::atomic< repl_lsn_t > m_persisted_durable_lsn{0}; // durable_commit_lsn known to be persisted in superblk
     iomgr::timer_handle_t m_sb_flush_timer_hdl;
 
     std::atomic< uint64_t > m_next_dsn{0}; // Data Sequence Number that will keep incrementing for each data entry
@@ -151,6 +207,56 @@ private:
     folly::Promise< ReplServiceError > m_destroy_promise;
     RaftReplDevMetrics m_metrics;
 
+    // Pushes of data waiting to be sent to the followers as a batch
+    struct push_data_batch {
+        std::vector< repl_req_ptr_t > rreqs;
+        std::vector< sisl::sg_list > data;
+        uint64_t size{0};
+        Clock::time_point start_time;
+    };
+    std::mutex m_push_batch_mtx;
+    push_data_batch m_push_batch;
+
+    // Fetches of data outstanding to each originator, and the ones queued behind them
+    std::mutex m_fetch_mtx;
+    std::map< int32_t, uint32_t > m_outstanding_fetches;
+    std::map< int32_t, std::deque< std::vector< repl_req_ptr_t > > > m_queued_fetches;
+
+    // Hedged reads whose local read is in flight, in the order they are issued. Local read goes to a buffer of its own,
+    // so that the sgs of the caller are filled only by the read which completes first.
+    struct hedged_read {
+        RemoteBlkId peer_blkid;
+        sisl::sg_list sgs;       // Sgs of the caller
+        sisl::sg_list local_sgs; // Buffer of the local read
+        uint32_t size;
+        Clock::time_point start_time;
+        std::atomic< bool > done{false};
+        folly::Promise< std::error_code > promise;
+    };
+    std::mutex m_hedged_read_mtx;
+    std::deque< shared< hedged_read > > m_hedged_reads;
+    std::atomic< int64_t > m_hedge_budget{0};    // Fetches the reads have accrued, in thousandths of a fetch
+    std::atomic< int64_t > m_read_lat_us{0};     // Smoothed mean of the local read latency
+    std::atomic< int64_t > m_read_lat_dev_us{0}; // Smoothed mean deviation of the local read latency
+
+    // Read indexes waiting for the commit lsn to reach them, by the lsn
+    struct read_index_wait {
+        folly::Promise< ReplResult< repl_lsn_t > > promise;
+        Clock::time_point start_time;
+    };
+    std::mutex m_read_index_mtx;
+    std::multimap< repl_lsn_t, read_index_wait > m_read_index_waits;
+    std::atomic< uint64_t > m_num_read_index_waits{0};
+
+    // Quiescing of the group while it is idle
+    std::atomic< uint64_t > m_last_activity_ms{0}; // Time an entry was lastly proposed or committed
+    std::atomic< bool > m_quiesced{false};
+    std::mutex m_quiesce_mtx; // Serializes the updates of the raft params, by quiescing and append batch tuning
+
+    // Append batch size currently set, tuned by the lag of the followers, and the last acked idx of each of them
+    int32_t m_append_batch_size{0};
+    std::map< replica_id_t, uint64_t > m_peer_acked_idx;
+
     static std::atomic< uint64_t > s_next_group_ordinal;
     bool m_log_store_replay_done{false};
 
@@ -170,16 +276,26 @@ public:
                            repl_req_ptr_t ctx) override;
     folly::Future< std::error_code > async_read(MultiBlkId const& blkid, sisl::sg_list& sgs, uint32_t size,
                                                 bool part_of_batch = false) override;
+    folly::Future< std::error_code > async_hedged_read(MultiBlkId const& blkid, RemoteBlkId const& peer_blkid,
+                                                       sisl::sg_list& sgs, uint32_t size) override;
     void async_free_blks(int64_t lsn, MultiBlkId const& blkid) override;
     AsyncReplResult<> become_leader() override;
     bool is_leader() const override;
+    bool is_witness() const override { return m_rd_sb->is_witness == 0x1; }
+    ReplServiceError promote_witness() override;
     replica_id_t get_leader_id() const override;
+
+    /// @brief Hands the leadership over to the given member, once it has caught up with the log. Returns false if this
+    /// replica is not the leader.
+    bool yield_leadership_to(replica_id_t successor);
+    AsyncReplResult< repl_lsn_t > read_index() override;
     std::vector< peer_info > get_replication_status() const override;
     group_id_t group_id() const override { return m_group_id; }
     std::string group_id_str() const { return boost::uuids::to_string(m_group_id); }
     std::string rdev_name() const { return m_rdev_name; }
     std::string my_replica_id_str() const { return boost::uuids::to_string(m_my_repl_id); }
     uint32_t get_blk_size() const override;
+    logdev_id_t get_logdev_id() const { return m_rd_sb->logdev_id; }
     repl_lsn_t get_last_commit_lsn() const { return m_commit_upto_lsn.load(); }
     void set_last_commit_lsn(repl_lsn_t lsn) { m_commit_upto_lsn.store(lsn); }
     bool is_destroy_pending() const;
@@ -194,10 +310,20 @@ public:
     //////////////// Methods needed for other Raft classes to access /////////////////
     void use_config(json_superblk raft_config_sb);
     void handle_commit(repl_req_ptr_t rreq, bool recovery = false);
+    void handle_commit_batch(std::vector< repl_req_ptr_t > const& rreqs);
+    void apply_commit_batch(std::vector< repl_req_ptr_t > const& rreqs);
     repl_req_ptr_t repl_key_to_req(repl_key const& rkey) const;
     repl_req_ptr_t applier_create_req(repl_key const& rkey, journal_type_t code, sisl::blob const& user_header,
                                       sisl::blob const& key, uint32_t data_size, bool is_data_channel);
-    folly::Future< folly::Unit > notify_after_data_written(std::vector< repl_req_ptr_t >* rreqs);
+    /// @brief Blocks until the data of all the requests with linked data is written, fetching the data not yet
+    /// received.
+    void wait_for_data_written(std::vector< repl_req_ptr_t > const& rreqs);
+    /// @brief Blocks until the local data write of the proposed requests is done, which the leader commits them
+    /// without in the parallel data write mode.
+    void wait_for_proposer_data_written(std::vector< repl_req_ptr_t > const& rreqs);
+    /// @brief Publishes the timeline of the sampled request on its commit, to the stage histograms and to the
+    /// ReplApplication.
+    void publish_trace(repl_req_ptr_t const& rreq);
     void check_and_fetch_remote_data(std::vector< repl_req_ptr_t > rreqs);
     void cp_flush(CP* cp, cshared<ReplDevCPContext> ctx);
     cshared<ReplDevCPContext> get_cp_ctx(CP* cp);
@@ -230,6 +356,14 @@ public:
         m_data_journal->truncate(num_reserved_entries, m_compact_lsn.load());
     }
 
+    /**
+     * Truncates the replication log upto the lsn compacted by raft, but not beyond the durable commit lsn persisted in
+     * the superblock, so that it does not wait for a CP to reclaim the journal space of the committed entries.
+     *
+     * @param num_reserved_entries The number of reserved entries of the replication log.
+     */
+    void compact_log(uint32_t num_reserved_entries);
+
     void wait_for_logstore_ready() { m_data_journal->wait_for_log_store_ready(); }
 
     void gc_repl_reqs();
@@ -238,6 +372,42 @@ public:
      * Flush the durable commit LSN to the superblock
      */
     void flush_durable_commit_lsn();
+    void update_persisted_durable_lsn(repl_lsn_t lsn);
+
+    /**
+     * Push the batch of pushes of data to the followers, if its oldest push has waited for push_data_batch_deadline_us
+     * or if forced
+     */
+    void flush_push_data_batch(bool force = false);
+
+    /**
+     * Fetch the data of the hedged reads whose local read is overdue from their peers, within the budget
+     */
+    void hedge_overdue_reads();
+
+    /**
+     * Fail the read indexes which have waited for the commit lsn to reach them for read_index_timeout_ms
+     */
+    void expire_read_index_waits();
+
+    /**
+     * Quiesce the group if it has been idle for quiesce_idle_ms, or wake it up if quiescing is turned off
+     */
+    void check_quiesce();
+
+    /**
+     * Note an entry being proposed or committed, waking up the group if it is quiesced
+     */
+    void note_activity() {
+        m_last_activity_ms.store(get_time_since_epoch_ms(), std::memory_order_relaxed);
+        if (m_quiesced.load(std::memory_order_relaxed)) { set_quiesced(false); }
+    }
+    bool is_quiesced() const { return m_quiesced.load(); }
+
+    /**
+     * Resize the append batch of the group by the lag of the followers, if adaptive_append_batch_max_size is set
+     */
+    void tune_append_batch();
 
     /**
      * \brief This method is called during restart to notify the upper layer
@@ -273,15 +443,28 @@ protected:
 private:
     shared< nuraft::log_store > data_journal() { return m_data_journal; }
     void push_data_to_all_followers(repl_req_ptr_t rreq, sisl::sg_list const& data);
+    void push_data_batch_to_all_followers(push_data_batch batch);
     void on_push_data_received(intrusive< sisl::GenericRpcData >& rpc_data);
+    void on_push_data_batch_received(intrusive< sisl::GenericRpcData >& rpc_data);
+    void on_pushed_entry(intrusive< sisl::GenericRpcData >& rpc_data, PushDataRequest const* push_req,
+                         uint8_t const* data, Clock::time_point push_data_rcv_time);
     void on_fetch_data_received(intrusive< sisl::GenericRpcData >& rpc_data);
     void fetch_data_from_remote(std::vector< repl_req_ptr_t > rreqs);
+    void issue_fetch_data(std::vector< repl_req_ptr_t > rreqs);
+    void fetch_hedged_read(shared< hedged_read > hr);
+    bool complete_hedged_read(hedged_read& hr, uint8_t const* data, uint32_t size);
+    void on_read_index_received(intrusive< sisl::GenericRpcData >& rpc_data);
+    AsyncReplResult< repl_lsn_t > wait_for_commit_lsn(repl_lsn_t lsn);
+    void notify_read_index_waits(repl_lsn_t lsn);
+    void set_quiesced(bool quiesced);
+    void on_fetch_data_done(int32_t originator);
     void handle_fetch_data_response(sisl::GenericClientResponse response, std::vector< repl_req_ptr_t > rreqs);
     bool is_resync_mode();
     void handle_error(repl_req_ptr_t const& rreq, ReplServiceError err);
     bool wait_for_data_receive(std::vector< repl_req_ptr_t > const& rreqs, uint64_t timeout_ms);
     void on_log_found(logstore_seq_num_t lsn, log_buffer buf, void* ctx);
     void commit_blk(repl_req_ptr_t rreq);
+    void unlink_committed_req(repl_req_ptr_t const& rreq);
     void replace_member(repl_req_ptr_t rreq);
     void reset_quorum_size(uint32_t commit_quorum);
 };
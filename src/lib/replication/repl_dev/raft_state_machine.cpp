@@ -31,6 +31,8 @@ static std::pair< sisl::blob, sisl::blob > header_only_extract(nuraft::buffer& b
 }
 
 ReplServiceError RaftStateMachine::propose_to_raft(repl_req_ptr_t rreq) {
+    m_rd.note_activity(); // Heartbeats are back to the normal rate before the entry is appended
+    rreq->trace_stage(repl_req_stage_t::PROPOSED);
     rreq->create_journal_entry(true /* raft_buf */, m_rd.server_id());
     RD_LOGT("Raft Channel: propose journal_entry=[{}] ", rreq->journal_entry()->to_string());
 
@@ -57,20 +59,9 @@ repl_req_ptr_t RaftStateMachine::localize_journal_entry_prepare(nuraft::log_entr
     RD_LOGT("Raft Channel: Localizing Raft log_entry: server_id={}, term={}, journal_entry=[{}] ", jentry->server_id,
             lentry.get_term(), jentry->to_string());
 
-    auto entry_to_hdr = [](repl_journal_entry* jentry) {
-        return sisl::blob{uintptr_cast(jentry) + sizeof(repl_journal_entry), jentry->user_header_size};
-    };
-
-    auto entry_to_key = [](repl_journal_entry* jentry) {
-        return sisl::blob{uintptr_cast(jentry) + sizeof(repl_journal_entry) + jentry->user_header_size,
-                          jentry->key_size};
-    };
-
-    auto entry_to_val = [](repl_journal_entry* jentry) {
-        return sisl::blob{uintptr_cast(jentry) + sizeof(repl_journal_entry) + jentry->user_header_size +
-                              jentry->key_size,
-                          jentry->value_size};
-    };
+    // Header and key are only uncompressed here for the rreq to be created, which keeps them uncompressed by itself
+    std::unique_ptr< uint8_t[] > hdr_key_buf;
+    auto const [header, key] = journal_entry_header_key(jentry, hdr_key_buf);
 
     repl_key const rkey{.server_id = jentry->server_id, .term = lentry.get_term(), .dsn = jentry->dsn};
 
@@ -80,16 +71,24 @@ repl_req_ptr_t RaftStateMachine::localize_journal_entry_prepare(nuraft::log_entr
     repl_req_ptr_t rreq;
     if ((jentry->code == journal_type_t::HS_DATA_LINKED) && (jentry->value_size > 0)) {
         MultiBlkId entry_blkid;
-        entry_blkid.deserialize(entry_to_val(jentry), true /* copy */);
+        entry_blkid.deserialize(journal_entry_value(jentry), true /* copy */);
 
-        rreq = m_rd.applier_create_req(rkey, jentry->code, entry_to_hdr(jentry), entry_to_key(jentry),
-                                       (entry_blkid.blk_count() * m_rd.get_blk_size()), false /* is_data_channel */);
+        rreq = m_rd.applier_create_req(rkey, jentry->code, header, key, (entry_blkid.blk_count() * m_rd.get_blk_size()),
+                                       false /* is_data_channel */);
         if (rreq == nullptr) { goto out; }
 
         rreq->set_remote_blkid(RemoteBlkId{jentry->server_id, entry_blkid});
 
-        auto const local_size = rreq->local_blkid().serialized_size();
-        auto const remote_size = entry_blkid.serialized_size();
+        // Local blkid is written in the encoding of the remote one, unless it does not fit in its place, like when the
+        // chunks of this replica need wider compact blk numbers, in which case the full encoding is tried instead
+        auto const remote_size = jentry->value_size;
+        bool compact = MultiBlkId::is_compact(journal_entry_value(jentry));
+        auto local_size = journal_blkid_size(rreq->local_blkid(), compact);
+        if (compact && (local_size > remote_size) &&
+            (journal_blkid_size(rreq->local_blkid(), false /* compact */) <= remote_size)) {
+            compact = false;
+            local_size = journal_blkid_size(rreq->local_blkid(), compact);
+        }
         auto const size_before_value = lentry.get_buf().size() - jentry->value_size;
 
         // It is possible that serialized size of the blkid allocated could be different (even though it
@@ -105,10 +104,12 @@ repl_req_ptr_t RaftStateMachine::localize_journal_entry_prepare(nuraft::log_entr
         }
 
         uint8_t* blkid_location = uintptr_cast(lentry.get_buf().data_begin()) + size_before_value;
-        std::memcpy(blkid_location, rreq->local_blkid().serialize().cbytes(), local_size);
+        write_journal_blkid(rreq->local_blkid(), compact, blkid_location);
+        // Clear the rest of the remote blkid (witness has an invalid one) so that no piece of it is read back later
+        if (local_size < remote_size) { std::memset(blkid_location + local_size, 0, remote_size - local_size); }
     } else {
-        rreq = m_rd.applier_create_req(rkey, jentry->code, entry_to_hdr(jentry), entry_to_key(jentry),
-                                       jentry->value_size, false /* is_data_channel */);
+        rreq = m_rd.applier_create_req(rkey, jentry->code, header, key, jentry->value_size,
+                                       false /* is_data_channel */);
     }
 
     // We might have localized the journal entry with new blkid. We need to also update the header/key pointers pointing
@@ -194,22 +195,46 @@ raft_buf_ptr_t RaftStateMachine::commit_ext(nuraft::state_machine::ext_op_params
     if (rreq->is_proposer()) {
         // This is the time to ensure flushing of journal happens in the proposer
         rreq->add_state(repl_req_state_t::LOG_FLUSHED);
+        rreq->trace_stage(repl_req_stage_t::LOG_FLUSHED);
     }
 
-    m_rd.handle_commit(rreq);
+    auto const max_batch = HS_DYNAMIC_CONFIG(consensus.commit_batch_max_entries);
+    if (max_batch <= 1) {
+        flush_commit_batch(); // In case it is switched off while there is a batch
+        m_rd.handle_commit(rreq);
+        return m_success_ptr;
+    }
 
+    // Raft commits the entries upto its target one after the other in this thread, so they are batched until the
+    // last of them, such that the batch is applied before raft waits for the next ones to be committed.
+    m_commit_batch.push_back(std::move(rreq));
+    if ((m_commit_batch.size() >= max_batch) ||
+        (uint64_cast(lsn) >= m_rd.raft_server()->get_target_committed_log_idx())) {
+        flush_commit_batch();
+    }
     return m_success_ptr;
 }
 
+void RaftStateMachine::flush_commit_batch() {
+    if (m_commit_batch.empty()) { return; }
+    m_rd.handle_commit_batch(m_commit_batch);
+    m_commit_batch.clear();
+}
+
 void RaftStateMachine::commit_config(const ulong log_idx, raft_cluster_config_ptr_t& new_conf) {
     RD_LOGD("Raft channel: Commit new cluster conf , log_idx = {}", log_idx);
+    flush_commit_batch(); // Entries before the config are applied before it
     // TODO:add more logic here if necessary
 }
 
 void RaftStateMachine::iterate_repl_reqs(std::function< void(int64_t, repl_req_ptr_t rreq) > const& cb) {
-    for (auto [key, rreq] : m_lsn_req_map) {
-        cb(key, rreq);
-    }
+    m_lsn_req_map.for_each([&cb](int64_t const& lsn, repl_req_ptr_t const& rreq) { cb(lsn, rreq); });
+}
+
+void RaftStateMachine::sweep_repl_reqs(uint32_t max_shards,
+                                       std::function< void(int64_t, repl_req_ptr_t rreq) > const& cb) {
+    m_gc_shard_cursor = m_lsn_req_map.for_each_in_shards(
+        m_gc_shard_cursor, max_shards, [&cb](int64_t const& lsn, repl_req_ptr_t const& rreq) { cb(lsn, rreq); });
 }
 
 uint64_t RaftStateMachine::last_commit_index() {
@@ -220,9 +245,8 @@ uint64_t RaftStateMachine::last_commit_index() {
 void RaftStateMachine::become_ready() { m_rd.become_ready(); }
 
 void RaftStateMachine::unlink_lsn_to_req(int64_t lsn) {
-    auto const it = m_lsn_req_map.find(lsn);
-    if (it != m_lsn_req_map.cend()) {
-        RD_LOG(DEBUG, "Raft channel: erase lsn {},  rreq {}", lsn, it->second->to_string());
+    if (auto const rreq = m_lsn_req_map.find(lsn); rreq) {
+        RD_LOG(DEBUG, "Raft channel: erase lsn {},  rreq {}", lsn, rreq->to_string());
         m_lsn_req_map.erase(lsn);
     }
 }
@@ -230,19 +254,19 @@ void RaftStateMachine::unlink_lsn_to_req(int64_t lsn) {
 void RaftStateMachine::link_lsn_to_req(repl_req_ptr_t rreq, int64_t lsn) {
     rreq->set_lsn(lsn);
     rreq->add_state(repl_req_state_t::LOG_RECEIVED);
+    rreq->trace_stage(repl_req_stage_t::LOG_APPENDED);
     // reset the rreq created_at time to now https://github.com/eBay/HomeStore/issues/506
     rreq->set_created_time();
-    [[maybe_unused]] auto r = m_lsn_req_map.insert(lsn, std::move(rreq));
-    RD_DBG_ASSERT_EQ(r.second, true, "lsn={} already in precommit list", lsn);
+    [[maybe_unused]] auto const inserted = m_lsn_req_map.insert(lsn, std::move(rreq));
+    RD_DBG_ASSERT_EQ(inserted, true, "lsn={} already in precommit list", lsn);
 }
 
 repl_req_ptr_t RaftStateMachine::lsn_to_req(int64_t lsn) {
     // Pull the req from the lsn
-    auto const it = m_lsn_req_map.find(lsn);
-    // RD_DBG_ASSERT(it != m_lsn_req_map.cend(), "lsn req map missing lsn={}", lsn);
-    if (it == m_lsn_req_map.cend()) { return nullptr; }
+    repl_req_ptr_t rreq = m_lsn_req_map.find(lsn);
+    // RD_DBG_ASSERT(rreq != nullptr, "lsn req map missing lsn={}", lsn);
+    if (rreq == nullptr) { return nullptr; }
 
-    repl_req_ptr_t rreq = it->second;
     RD_DBG_ASSERT_EQ(lsn, rreq->lsn(), "lsn req map mismatch");
     return rreq;
 }
@@ -250,20 +274,41 @@ repl_req_ptr_t RaftStateMachine::lsn_to_req(int64_t lsn) {
 nuraft_mesg::repl_service_ctx* RaftStateMachine::group_msg_service() { return m_rd.group_msg_service(); }
 
 void RaftStateMachine::create_snapshot(nuraft::snapshot& s, nuraft::async_result< bool >::handler_type& when_done) {
+    flush_commit_batch(); // Snapshot is upto the entries applied
     m_rd.on_create_snapshot(s, when_done);
 }
 
 int RaftStateMachine::read_logical_snp_obj(nuraft::snapshot& s, void*& user_ctx, ulong obj_id, raft_buf_ptr_t& data_out,
                                            bool& is_last_obj) {
     auto snp_ctx = std::make_shared< nuraft_snapshot_context >(s);
-    auto snp_data = std::make_shared< snapshot_data >();
-    snp_data->user_ctx = user_ctx;
-    snp_data->offset = obj_id;
-    snp_data->is_last_obj = is_last_obj;
+    shared< snapshot_data > snp_data;
+    int ret{0};
+    {
+        // Wait for the read ahead in flight, which uses the same user ctx, and take the object if it is read ahead
+        std::unique_lock lg{m_snp_ra_mtx};
+        m_snp_ra_cv.wait(lg, [this]() { return !m_snp_ra_inflight; });
+        if ((m_snp_ra_lsn == snp_ctx->get_lsn()) && !m_snp_ra_objs.empty() &&
+            (m_snp_ra_objs.front()->offset == s_cast< int64_t >(obj_id))) {
+            snp_data = std::move(m_snp_ra_objs.front());
+            m_snp_ra_objs.pop_front();
+            COUNTER_INCREMENT(m_rd.m_metrics, snapshot_read_ahead_hit_cnt, 1);
+        } else {
+            // Follower asked for an object other than the ones read ahead, as after it is retried
+            m_snp_ra_objs.clear();
+        }
+        m_snp_ra_lsn = snp_ctx->get_lsn();
+    }
 
-    // Listener will read the snapshot data and we pass through the same.
-    int ret = m_rd.m_listener->read_snapshot_data(snp_ctx, snp_data);
-    if (ret < 0) return ret;
+    if (snp_data == nullptr) {
+        snp_data = std::make_shared< snapshot_data >();
+        snp_data->user_ctx = user_ctx;
+        snp_data->offset = obj_id;
+        snp_data->is_last_obj = is_last_obj;
+
+        // Listener will read the snapshot data and we pass through the same.
+        ret = m_rd.m_listener->read_snapshot_data(snp_ctx, snp_data);
+        if (ret < 0) return ret;
+    }
 
     // Update user_ctx and whether is_last_obj
     user_ctx = snp_data->user_ctx;
@@ -273,9 +318,46 @@ int RaftStateMachine::read_logical_snp_obj(nuraft::snapshot& s, void*& user_ctx,
     data_out = nuraft::buffer::alloc(snp_data->blob.size());
     nuraft::buffer_serializer bs(data_out);
     bs.put_raw(snp_data->blob.cbytes(), snp_data->blob.size());
+
+    if (!is_last_obj && (snp_data->next_offset >= 0)) { read_ahead_snp_obj(std::move(snp_ctx), std::move(snp_data)); }
     return ret;
 }
 
+void RaftStateMachine::read_ahead_snp_obj(shared< nuraft_snapshot_context > snp_ctx, shared< snapshot_data > sent) {
+    auto next = std::make_shared< snapshot_data >();
+    {
+        std::unique_lock lg{m_snp_ra_mtx};
+        auto const max_objs = HS_DYNAMIC_CONFIG(consensus.snapshot_read_ahead_objs);
+        if (m_snp_ra_inflight || (m_snp_ra_lsn != snp_ctx->get_lsn()) || (m_snp_ra_objs.size() >= max_objs)) {
+            return;
+        }
+
+        // Next object is after the last one read ahead, or after the one sent if there is none
+        auto const& prev = m_snp_ra_objs.empty() ? sent : m_snp_ra_objs.back();
+        if (prev->is_last_obj || (prev->next_offset < 0)) { return; }
+        next->offset = prev->next_offset;
+        next->user_ctx = prev->user_ctx;
+        m_snp_ra_inflight = true;
+    }
+
+    iomanager.run_on_forget(iomgr::reactor_regex::random_worker, iomgr::fiber_regex::syncio_only,
+                            [this, snp_ctx = std::move(snp_ctx), next = std::move(next)]() mutable {
+                                auto const ret = m_rd.m_listener->read_snapshot_data(snp_ctx, next);
+                                bool more{false};
+                                {
+                                    // Object is dropped on an error, to be read again when the follower asks for it
+                                    std::unique_lock lg{m_snp_ra_mtx};
+                                    m_snp_ra_inflight = false;
+                                    if ((ret >= 0) && (m_snp_ra_lsn == snp_ctx->get_lsn())) {
+                                        m_snp_ra_objs.push_back(next);
+                                        more = true;
+                                    }
+                                }
+                                m_snp_ra_cv.notify_all();
+                                if (more) { read_ahead_snp_obj(std::move(snp_ctx), std::move(next)); }
+                            });
+}
+
 void RaftStateMachine::save_logical_snp_obj(nuraft::snapshot& s, ulong& obj_id, nuraft::buffer& data, bool is_first_obj,
                                             bool is_last_obj) {
     auto snp_ctx = std::make_shared< nuraft_snapshot_context >(s);
@@ -308,7 +390,16 @@ nuraft::ptr< nuraft::snapshot > RaftStateMachine::last_snapshot() {
     return s->nuraft_snapshot();
 }
 
-void RaftStateMachine::free_user_snp_ctx(void*& user_snp_ctx) { m_rd.m_listener->free_user_snp_ctx(user_snp_ctx); }
+void RaftStateMachine::free_user_snp_ctx(void*& user_snp_ctx) {
+    {
+        // Objects read ahead are of the user ctx, which is not to be used after it is freed
+        std::unique_lock lg{m_snp_ra_mtx};
+        m_snp_ra_cv.wait(lg, [this]() { return !m_snp_ra_inflight; });
+        m_snp_ra_objs.clear();
+        m_snp_ra_lsn = -1;
+    }
+    m_rd.m_listener->free_user_snp_ctx(user_snp_ctx);
+}
 
 std::string RaftStateMachine::rdev_name() const { return m_rd.rdev_name(); }
 
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <vector>
 #include <functional>
 #include <iomgr/iomgr.hpp>
@@ -9,6 +12,7 @@
 #include <homestore/replication/repl_decls.h>
 
 #include "replication/repl_dev/common.h"
+#include "replication/repl_dev/sharded_req_map.h"
 
 #if defined __clang__ or defined __GNUC__
 #pragma GCC diagnostic push
@@ -92,11 +96,21 @@ using AsyncNotifier = folly::Promise< folly::Unit >;
 class RaftReplDev;
 class RaftStateMachine : public nuraft::state_machine {
 private:
-    folly::ConcurrentHashMap< int64_t /*lsn*/, repl_req_ptr_t > m_lsn_req_map;
+    ShardedReqMap< int64_t /*lsn*/, repl_req_ptr_t > m_lsn_req_map;
+    uint32_t m_gc_shard_cursor{0}; // Shard of the lsn map the next gc pass sweeps from
     RaftReplDev& m_rd;
     nuraft::ptr< nuraft::buffer > m_success_ptr; // Preallocate the success return to raft
     // iomgr::timer_handle_t m_wait_blkid_write_timer_hdl{iomgr::null_timer_handle};
     bool m_resync_mode{false};
+    std::vector< repl_req_ptr_t > m_commit_batch; // Committed entries yet to be applied in the batched commit mode
+
+    // Snapshot objects read ahead of the ones the follower asks for, in the order of their offset. Only one read of
+    // the snapshot is in flight at a time, since they all share the user ctx of the listener
+    std::mutex m_snp_ra_mtx;
+    std::condition_variable m_snp_ra_cv;
+    std::deque< shared< snapshot_data > > m_snp_ra_objs;
+    int64_t m_snp_ra_lsn{-1}; // Lsn of the snapshot the objects are read ahead of, -1 if there is none
+    bool m_snp_ra_inflight{false};
 
 public:
     RaftStateMachine(RaftReplDev& rd);
@@ -132,10 +146,16 @@ public:
 
     void iterate_repl_reqs(std::function< void(int64_t, repl_req_ptr_t rreq) > const& cb);
 
+    /// @brief Calls the cb for the requests of the next max_shards shards of the lsn map, so the whole map is swept
+    /// over successive calls. 0 sweeps all of them at once.
+    void sweep_repl_reqs(uint32_t max_shards, std::function< void(int64_t, repl_req_ptr_t rreq) > const& cb);
+
     std::string rdev_name() const;
 
 private:
     void after_precommit_in_leader(const nuraft::raft_server::req_ext_cb_params& params);
+    void flush_commit_batch();
+    void read_ahead_snp_obj(shared< nuraft_snapshot_context > snp_ctx, shared< snapshot_data > sent);
 };
 
 } // namespace homestore
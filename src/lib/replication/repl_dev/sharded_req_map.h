@@ -0,0 +1,91 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#include <folly/concurrency/ConcurrentHashMap.h>
+#include <homestore/replication/repl_dev.h>
+
+namespace homestore {
+
+/*
+ * Map of the outstanding repl requests, split into a fixed number of shards, each a lock free folly concurrent map.
+ *
+ * Shard of a key is picked from the high bits of its mixed hash, while the folly map picks its own segments from the
+ * low bits, so keys of a shard are still spread across all of its segments. Shards let the expired requests be swept
+ * a few shards at a time, instead of the whole map in one go.
+ */
+template < typename K, typename V, typename Hash = std::hash< K > >
+class ShardedReqMap {
+public:
+    static constexpr uint32_t num_shards = 16;
+
+    /// @brief Inserts the value if the key is not in the map. Returns the value in the map for the key and whether
+    /// it was inserted.
+    std::pair< V, bool > try_emplace(K const& key, V value) {
+        auto const [it, happened] = shard(key).try_emplace(key, std::move(value));
+        return {it->second, happened};
+    }
+
+    bool insert(K const& key, V value) { return shard(key).insert(key, std::move(value)).second; }
+
+    /// @brief Returns the value for the key, or an empty value if the key is not in the map.
+    V find(K const& key) const {
+        auto const& m = shard(key);
+        auto const it = m.find(key);
+        return (it == m.cend()) ? V{} : it->second;
+    }
+
+    bool erase(K const& key) { return (shard(key).erase(key) != 0); }
+
+    /// @brief Erases the key only if it still maps to the value, so that a newer value for the key is retained.
+    bool erase_if_equal(K const& key, V const& value) { return (shard(key).erase_if_equal(key, value) != 0); }
+
+    /// @brief Calls the cb for the entries of count shards starting at the shard start, wrapping around. Returns the
+    /// shard to start from next, to sweep the whole map over a few calls.
+    uint32_t for_each_in_shards(uint32_t start, uint32_t count, std::function< void(K const&, V const&) > const& cb) {
+        count = ((count == 0) || (count > num_shards)) ? num_shards : count;
+        for (uint32_t i{0}; i < count; ++i) {
+            for (auto const& [key, value] : m_shards[(start + i) % num_shards]) {
+                cb(key, value);
+            }
+        }
+        return (start + count) % num_shards;
+    }
+
+    void for_each(std::function< void(K const&, V const&) > const& cb) { for_each_in_shards(0, num_shards, cb); }
+
+    size_t size() const {
+        size_t sz{0};
+        for (auto const& m : m_shards) {
+            sz += m.size();
+        }
+        return sz;
+    }
+
+private:
+    static uint32_t shard_of(K const& key) { return uint32_cast(hash_mix64(Hash{}(key)) >> 60); }
+    folly::ConcurrentHashMap< K, V, Hash >& shard(K const& key) { return m_shards[shard_of(key)]; }
+    folly::ConcurrentHashMap< K, V, Hash > const& shard(K const& key) const { return m_shards[shard_of(key)]; }
+
+private:
+    std::array< folly::ConcurrentHashMap< K, V, Hash >, num_shards > m_shards;
+};
+
+} // namespace homestore
@@ -5,6 +5,8 @@
 #include <homestore/logstore_service.hpp>
 #include <homestore/superblk_handler.hpp>
 #include "common/homestore_assert.hpp"
+#include "common/homestore_config.hpp"
+#include "common/resource_mgr.hpp"
 
 namespace homestore {
 SoloReplDev::SoloReplDev(superblk< repl_dev_superblk >&& rd_sb, bool load_existing) :
@@ -29,7 +31,11 @@ SoloReplDev::SoloReplDev(superblk< repl_dev_superblk >&& rd_sb, bool load_existi
 
 void SoloReplDev::async_alloc_write(sisl::blob const& header, sisl::blob const& key, sisl::sg_list const& value,
                                     repl_req_ptr_t rreq) {
-    if (!rreq) { auto rreq = repl_req_ptr_t(new repl_req_ctx{}); }
+    if (!rreq) { rreq = repl_req_ctx::make_pooled(); }
+
+    // There is no way to fail the write back to the listener, so it is only slowed down as the journal fills up
+    resource_mgr().throttle_admission(header.size() + key.size() + value.size, admission_class_t::REPL,
+                                      boost::uuids::hash_value(group_id()));
     rreq->init(repl_key{.server_id = 0, .term = 1, .dsn = 1},
                value.size ? journal_type_t::HS_DATA_LINKED : journal_type_t::HS_DATA_INLINED, true, header, key,
                value.size);
@@ -53,6 +59,18 @@ void SoloReplDev::async_alloc_write(sisl::blob const& header, sisl::blob const&
 void SoloReplDev::write_journal(repl_req_ptr_t rreq) {
     rreq->create_journal_entry(false /* raft_buf */, 1);
 
+    if (HS_DYNAMIC_CONFIG(consensus.solo_journal_batch_max_entries) > 1) {
+        // Group commit: Only one batch is written at a time, requests arriving meanwhile queue up for the next one
+        {
+            std::unique_lock lg{m_pending_mtx};
+            m_pending_rreqs.push_back(std::move(rreq));
+            if (m_batch_in_flight) { return; }
+            m_batch_in_flight = true;
+        }
+        write_journal_batch(next_journal_batch());
+        return;
+    }
+
     m_data_journal->append_async(
         sisl::io_blob{rreq->raw_journal_buf(), rreq->journal_entry_size(), false /* is_aligned */},
         nullptr /* cookie */, [this, rreq](int64_t lsn, sisl::io_blob&, homestore::logdev_key, void*) mutable {
@@ -64,9 +82,75 @@ void SoloReplDev::write_journal(repl_req_ptr_t rreq) {
 
             data_service().commit_blk(rreq->local_blkid());
             m_listener->on_commit(rreq->lsn(), rreq->header(), rreq->key(), rreq->local_blkid(), rreq);
+            rreq->commit_completion().complete(ReplServiceError::OK);
         });
 }
 
+std::vector< repl_req_ptr_t > SoloReplDev::next_journal_batch() {
+    auto const max_entries = std::max(HS_DYNAMIC_CONFIG(consensus.solo_journal_batch_max_entries), 1u);
+
+    std::unique_lock lg{m_pending_mtx};
+    if (m_pending_rreqs.empty()) {
+        m_batch_in_flight = false;
+        return {};
+    }
+
+    std::vector< repl_req_ptr_t > rreqs;
+    if (m_pending_rreqs.size() <= max_entries) {
+        rreqs.swap(m_pending_rreqs);
+    } else {
+        rreqs.assign(std::make_move_iterator(m_pending_rreqs.begin()),
+                     std::make_move_iterator(m_pending_rreqs.begin() + max_entries));
+        m_pending_rreqs.erase(m_pending_rreqs.begin(), m_pending_rreqs.begin() + max_entries);
+    }
+    return rreqs;
+}
+
+void SoloReplDev::write_journal_batch(std::vector< repl_req_ptr_t > rreqs) {
+    if (rreqs.empty()) { return; }
+
+    // Journal buffers are owned by the rreqs, which the completion holds till the batch is written
+    std::vector< sisl::io_blob > blobs;
+    blobs.reserve(rreqs.size());
+    for (auto const& rreq : rreqs) {
+        blobs.emplace_back(rreq->raw_journal_buf(), rreq->journal_entry_size(), false /* is_aligned */);
+    }
+
+    m_data_journal->append_batch(
+        blobs, nullptr /* cookie */,
+        [this, rreqs = std::move(rreqs)](int64_t start_lsn, int64_t end_lsn, homestore::logdev_key, void*) mutable {
+            HS_DBG_ASSERT_EQ(end_lsn - start_lsn + 1, int64_cast(rreqs.size()), "Mismatch in lsns of journal batch");
+            auto lsn = start_lsn;
+            for (auto& rreq : rreqs) {
+                rreq->set_lsn(lsn++);
+            }
+            commit_journal_batch(rreqs);
+            rreqs.clear();
+
+            write_journal_batch(next_journal_batch());
+        });
+}
+
+void SoloReplDev::commit_journal_batch(std::vector< repl_req_ptr_t > const& rreqs) {
+    for (auto const& rreq : rreqs) {
+        m_listener->on_pre_commit(rreq->lsn(), rreq->header(), rreq->key(), rreq);
+    }
+
+    // Blks of the whole batch are committed in one pass, before any of the entries is handed over to the listener
+    for (auto const& rreq : rreqs) {
+        if (rreq->has_linked_data()) { data_service().commit_blk(rreq->local_blkid()); }
+    }
+
+    auto const last_lsn = rreqs.back()->lsn();
+    auto cur_lsn = m_commit_upto.load();
+    while ((cur_lsn < last_lsn) && !m_commit_upto.compare_exchange_weak(cur_lsn, last_lsn)) {}
+
+    m_listener->on_batch_commit(rreqs);
+    for (auto const& rreq : rreqs) {
+        rreq->commit_completion().complete(ReplServiceError::OK);
+    }
+}
+
 void SoloReplDev::on_log_found(logstore_seq_num_t lsn, log_buffer buf, void* ctx) {
     repl_journal_entry const* entry = r_cast< repl_journal_entry const* >(buf.bytes());
     uint32_t remain_size = buf.size() - sizeof(repl_journal_entry);
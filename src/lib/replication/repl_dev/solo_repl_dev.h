@@ -14,6 +14,8 @@
  *********************************************************************************/
 #pragma once
 
+#include <mutex>
+#include <vector>
 #include <boost/smart_ptr/intrusive_ref_counter.hpp>
 #include <boost/intrusive_ptr.hpp>
 
@@ -35,6 +37,10 @@ private:
     uuid_t m_group_id;
     std::atomic< logstore_seq_num_t > m_commit_upto{-1};
 
+    std::mutex m_pending_mtx;
+    std::vector< repl_req_ptr_t > m_pending_rreqs; // Requests waiting for the batch in flight to be flushed
+    bool m_batch_in_flight{false};
+
 public:
     SoloReplDev(superblk< repl_dev_superblk >&& rd_sb, bool load_existing);
     virtual ~SoloReplDev() = default;
@@ -50,6 +56,7 @@ public:
     AsyncReplResult<> become_leader() override { return make_async_error(ReplServiceError::OK); }
     bool is_leader() const override { return true; }
     replica_id_t get_leader_id() const override { return m_group_id; }
+    AsyncReplResult< repl_lsn_t > read_index() override { return make_async_success< repl_lsn_t >(m_commit_upto); }
     std::vector< peer_info > get_replication_status() const override {
         return std::vector< peer_info >{peer_info{.id_ = m_group_id, .replication_idx_ = 0, .last_succ_resp_us_ = 0}};
     }
@@ -63,6 +70,9 @@ public:
 
 private:
     void write_journal(repl_req_ptr_t rreq);
+    void write_journal_batch(std::vector< repl_req_ptr_t > rreqs);
+    void commit_journal_batch(std::vector< repl_req_ptr_t > const& rreqs);
+    std::vector< repl_req_ptr_t > next_journal_batch();
     void on_log_found(logstore_seq_num_t lsn, log_buffer buf, void* ctx);
 };
 
@@ -32,7 +32,9 @@
 namespace homestore {
 
 static std::string const PUSH_DATA{"push_data"};
+static std::string const PUSH_DATA_BATCH{"push_data_batch"};
 static std::string const FETCH_DATA{"fetch_data"};
+static std::string const READ_INDEX{"read_index"};
 
 struct repl_dev_superblk;
 class GenericReplService : public ReplicationService {
@@ -56,6 +58,7 @@ public:
 
     hs_stats get_cap_stats() const override;
     replica_id_t get_my_repl_uuid() const { return m_my_uuid; }
+    cshared< ReplApplication >& repl_app() const { return m_repl_app; }
     // void resource_audit() override;
 
 protected:
@@ -85,6 +88,7 @@ public:
     std::unique_ptr< CPContext > on_switchover_cp(CP* cur_cp, CP* new_cp) override;
     folly::Future< bool > cp_flush(CP* cp) override;
     void cp_cleanup(CP* cp) override;
+    bool cp_cleanup_can_overlap() const override { return true; }
     int cp_progress_percent() override;
 };
 
@@ -14,13 +14,20 @@
  *********************************************************************************/
 #include <sisl/logging/logging.h>
 #include <iomgr/io_environment.hpp>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <vector>
 
 #include <boost/uuid/string_generator.hpp>
 #include <homestore/blkdata_service.hpp>
 #include <homestore/logstore_service.hpp>
 #include "common/homestore_config.hpp"
 #include "common/homestore_assert.hpp"
+#include "common/thread_placement.hpp"
 #include "replication/service/raft_repl_service.h"
 #include "replication/repl_dev/raft_repl_dev.h"
 
@@ -139,22 +146,38 @@ void RaftReplService::start() {
     // leading to data corruption by overwriting the data associated with LSN 100.
     // Now the data channel is started in join_group().
 
-    LOGINFO("Starting LogStore service, fist_boot = {}", hs()->is_first_time_boot());
-    hs()->logstore_service().start(hs()->is_first_time_boot());
+    // With the parallel recovery, the logdevs are replayed by a pool of fibers, each one replaying the journal of a
+    // repl dev after another. Groups are still joined only after all of them are replayed, as the allocator is not
+    // aware of the blks of the journals not replayed yet, and joined in the order their replay completed.
+    auto const nfibers = HS_DYNAMIC_CONFIG(consensus.recovery_parallelism);
+    bool const parallel = !hs()->is_first_time_boot() && (nfibers > 1) && (m_rd_map.size() > 1);
+    LOGINFO("Starting LogStore service, fist_boot = {} parallel_recovery = {}", hs()->is_first_time_boot(), parallel);
+    hs()->logstore_service().start(hs()->is_first_time_boot(), parallel /* lazy_recovery */);
+    std::vector< shared< RaftReplDev > > replayed;
+    if (parallel) { replayed = recover_repl_devs(nfibers); }
     LOGINFO("Started LogStore service, log replay should already done till this point");
     // all log stores are replayed, time to start data service.
     LOGINFO("Starting DataService");
     hs()->data_service().start();
 
     // Step 6: Iterate all the repl dev and ask each one of the join the raft group.
-    for (auto it = m_rd_map.begin(); it != m_rd_map.end();) {
-        auto rdev = std::dynamic_pointer_cast< RaftReplDev >(it->second);
-        rdev->wait_for_logstore_ready();
-        if (!rdev->join_group()) {
-	    HS_REL_ASSERT(false, "FAILED TO JOIN GROUP, PANIC HERE");
-            it = m_rd_map.erase(it);
-        } else {
-            ++it;
+    if (parallel) {
+        for (auto const& rdev : replayed) {
+            if (!rdev->join_group()) {
+                HS_REL_ASSERT(false, "FAILED TO JOIN GROUP, PANIC HERE");
+                m_rd_map.erase(rdev->group_id());
+            }
+        }
+    } else {
+        for (auto it = m_rd_map.begin(); it != m_rd_map.end();) {
+            auto rdev = std::dynamic_pointer_cast< RaftReplDev >(it->second);
+            rdev->wait_for_logstore_ready();
+            if (!rdev->join_group()) {
+                HS_REL_ASSERT(false, "FAILED TO JOIN GROUP, PANIC HERE");
+                it = m_rd_map.erase(it);
+            } else {
+                ++it;
+            }
         }
     }
 
@@ -168,6 +191,44 @@ void RaftReplService::start() {
     hs()->logstore_service().delete_unopened_logdevs();
 }
 
+std::vector< shared< RaftReplDev > > RaftReplService::recover_repl_devs(uint32_t nfibers) {
+    std::vector< shared< RaftReplDev > > rdevs;
+    rdevs.reserve(m_rd_map.size());
+    for (auto const& [_, rd] : m_rd_map) {
+        rdevs.push_back(std::dynamic_pointer_cast< RaftReplDev >(rd));
+    }
+
+    // Each fiber picks the next repl dev not picked yet, so that a long replay doesn't hold up the others
+    auto const start_time = Clock::now();
+    std::atomic< size_t > next{0};
+    std::mutex mtx;
+    std::vector< shared< RaftReplDev > > replayed;
+    replayed.reserve(rdevs.size());
+    std::vector< folly::Future< folly::Unit > > futs;
+    for (uint32_t f{0}; f < std::min(nfibers, uint32_cast(rdevs.size())); ++f) {
+        auto p = std::make_shared< folly::Promise< folly::Unit > >();
+        futs.emplace_back(p->getFuture());
+        iomanager.run_on_forget(iomgr::reactor_regex::random_worker, iomgr::fiber_regex::syncio_only,
+                                [p, &rdevs, &next, &mtx, &replayed]() {
+                                    for (auto i = next.fetch_add(1); i < rdevs.size(); i = next.fetch_add(1)) {
+                                        auto const& rdev = rdevs[i];
+                                        hs()->logstore_service().recover_logdev(rdev->get_logdev_id());
+                                        rdev->wait_for_logstore_ready();
+                                        std::unique_lock lg{mtx};
+                                        replayed.push_back(rdev);
+                                    }
+                                    p->setValue();
+                                });
+    }
+    folly::collectAllUnsafe(futs).wait();
+
+    // Logdevs of no repl dev are replayed too, before the allocator is handed over to the data service
+    hs()->logstore_service().recover_all_logdevs();
+    LOGINFO("Replayed the journals of {} repl devs with {} fibers in {} ms", rdevs.size(), nfibers,
+            get_elapsed_time_ms(start_time));
+    return replayed;
+}
+
 void RaftReplService::stop() {
     stop_reaper_thread();
     GenericReplService::stop();
@@ -223,6 +284,7 @@ shared< nuraft_mesg::mesg_state_mgr > RaftReplService::create_state_mgr(int32_t
     rd_sb.create();
     rd_sb->group_id = group_id;
     rd_sb->is_timeline_consistent = m_repl_app->need_timeline_consistency();
+    rd_sb->is_witness = m_repl_app->is_witness(group_id) ? 0x1 : 0x0;
 
     // Create a new instance of Raft ReplDev (which is the state manager this method is looking for)
     auto rdev = std::make_shared< RaftReplDev >(*this, std::move(rd_sb), false /* load_existing */);
@@ -322,6 +384,18 @@ void RaftReplService::load_repl_dev(sisl::byte_view const& buf, void* meta_cooki
     superblk< raft_repl_dev_superblk > rd_sb{get_meta_blk_name()};
     rd_sb.load(buf, meta_cookie);
     HS_DBG_ASSERT_EQ(rd_sb->get_magic(), repl_dev_superblk::REPL_DEV_SB_MAGIC, "Invalid rdev metablk, magic mismatch");
+    if (rd_sb->get_raft_sb_version() == 1) {
+        // Version 1 superblk ends before is_witness, as it was written before the witnesses, so the replica is a full
+        // member. It is persisted in the new format upon the next write of the superblk.
+        auto const old_buf = rd_sb.raw_buf();
+        auto const v1_size = sizeof(raft_repl_dev_superblk) - sizeof(raft_repl_dev_superblk::is_witness);
+        auto const old_size = std::min< size_t >(old_buf->size(), v1_size);
+        rd_sb.create(sizeof(raft_repl_dev_superblk));
+        std::memcpy(voidptr_cast(rd_sb.raw_buf()->bytes()), static_cast< const void* >(old_buf->cbytes()), old_size);
+        rd_sb->is_witness = 0x0;
+        rd_sb->raft_sb_version = raft_repl_dev_superblk::RAFT_REPL_DEV_SB_VERSION;
+        LOGINFOMOD(replication, "Upgraded raft repl dev superblk of group_id={} from version 1", rd_sb->group_id);
+    }
     HS_DBG_ASSERT_EQ(rd_sb->get_raft_sb_version(), raft_repl_dev_superblk::RAFT_REPL_DEV_SB_VERSION,
                      "Invalid version of raft rdev metablk");
     group_id_t group_id = rd_sb->group_id;
@@ -366,6 +440,7 @@ void RaftReplService::start_reaper_thread() {
     auto f = p.getFuture();
     iomanager.create_reactor("repl_svc_reaper", iomgr::INTERRUPT_LOOP, 1u, [this, &p](bool is_started) mutable {
         if (is_started) {
+            ThreadPlacement::bind_self(hs_thread_role_t::BACKGROUND);
             m_reaper_fiber = iomanager.iofiber_self();
 
             // Schedule the rdev garbage collector timer
@@ -379,11 +454,9 @@ void RaftReplService::start_reaper_thread() {
                     gc_repl_devs();
                 });
 
-            // Check for queued fetches at the minimum every second
-            uint64_t interval_ns =
-                std::min(HS_DYNAMIC_CONFIG(consensus.wait_data_write_timer_ms) * 1000 * 1000, 1ul * 1000 * 1000 * 1000);
-            m_rdev_fetch_timer_hdl = iomanager.schedule_thread_timer(interval_ns, true /* recurring */, nullptr,
-                                                                     [this](void*) { fetch_pending_data(); });
+            // Check for expired read indexes every second
+            m_read_index_timer_hdl = iomanager.schedule_thread_timer(
+                1ul * 1000 * 1000 * 1000, true /* recurring */, nullptr, [this](void*) { expire_read_index_waits(); });
 
             // Flush durable commit lsns to superblock
             // FIXUP: what is the best value for flush_durable_commit_interval_ms?
@@ -391,12 +464,55 @@ void RaftReplService::start_reaper_thread() {
                 HS_DYNAMIC_CONFIG(consensus.flush_durable_commit_interval_ms) * 1000 * 1000, true /* recurring */,
                 nullptr, [this](void*) { flush_durable_commit_lsn(); });
 
+            // Push the batches of data pushes which are not filled up in time
+            m_push_data_batch_timer_hdl = iomanager.schedule_thread_timer(
+                HS_DYNAMIC_CONFIG(consensus.push_data_batch_deadline_us) * 1000, true /* recurring */, nullptr,
+                [this](void*) { flush_push_data_batches(); });
+
+            // Quiesce the groups which have been idle, and resize the append batches by the lag of the followers
+            m_quiesce_timer_hdl =
+                iomanager.schedule_thread_timer(1ul * 1000 * 1000 * 1000, true /* recurring */, nullptr, [this](void*) {
+                    check_quiesce();
+                    tune_append_batches();
+                });
+
+            // Truncate the raft logs as they are committed, without waiting for the resource audit
+            if (auto const interval_ms = HS_DYNAMIC_CONFIG(consensus.log_compaction_interval_ms); interval_ms != 0) {
+                m_log_compaction_timer_hdl = iomanager.schedule_thread_timer(
+                    interval_ms * 1000 * 1000, true /* recurring */, nullptr, [this](void*) { compact_logs(); });
+            }
+
+            // Even out the leaders of the groups across the nodes
+            if (auto const interval_sec = HS_DYNAMIC_CONFIG(consensus.leader_balance_interval_sec); interval_sec != 0) {
+                m_leader_balance_timer_hdl = iomanager.schedule_thread_timer(
+                    interval_sec * 1000ul * 1000 * 1000, true /* recurring */, nullptr,
+                    [this](void*) { balance_leaders(); });
+            }
+
+            // Hedge the reads whose local read is overdue
+            if (HS_DYNAMIC_CONFIG(consensus.hedged_read_budget_pct) != 0) {
+                auto const interval_us = std::max(HS_DYNAMIC_CONFIG(consensus.hedged_read_min_delay_us) / 2, 1ul);
+                m_hedged_read_timer_hdl = iomanager.schedule_thread_timer(
+                    interval_us * 1000, true /* recurring */, nullptr, [this](void*) { hedge_overdue_reads(); });
+            }
+
             p.setValue();
         } else {
             // Cancel all recurring timers started
             iomanager.cancel_timer(m_rdev_gc_timer_hdl, true /* wait */);
-            iomanager.cancel_timer(m_rdev_fetch_timer_hdl, true /* wait */);
+            iomanager.cancel_timer(m_read_index_timer_hdl, true /* wait */);
             iomanager.cancel_timer(m_flush_durable_commit_timer_hdl, true /* wait */);
+            iomanager.cancel_timer(m_push_data_batch_timer_hdl, true /* wait */);
+            iomanager.cancel_timer(m_quiesce_timer_hdl, true /* wait */);
+            if (m_log_compaction_timer_hdl != iomgr::null_timer_handle) {
+                iomanager.cancel_timer(m_log_compaction_timer_hdl, true /* wait */);
+            }
+            if (m_leader_balance_timer_hdl != iomgr::null_timer_handle) {
+                iomanager.cancel_timer(m_leader_balance_timer_hdl, true /* wait */);
+            }
+            if (m_hedged_read_timer_hdl != iomgr::null_timer_handle) {
+                iomanager.cancel_timer(m_hedged_read_timer_hdl, true /* wait */);
+            }
         }
     });
     std::move(f).get();
@@ -406,28 +522,6 @@ void RaftReplService::stop_reaper_thread() {
     iomanager.run_on_wait(m_reaper_fiber, [] { iomanager.stop_io_loop(); });
 }
 
-void RaftReplService::add_to_fetch_queue(cshared< RaftReplDev >& rdev, std::vector< repl_req_ptr_t > rreqs) {
-    std::unique_lock lg(m_pending_fetch_mtx);
-    m_pending_fetch_batches.push(std::make_pair(rdev, std::move(rreqs)));
-}
-
-void RaftReplService::fetch_pending_data() {
-    std::unique_lock lg(m_pending_fetch_mtx);
-    while (!m_pending_fetch_batches.empty()) {
-        auto const& [d, rreqs] = m_pending_fetch_batches.front();
-        if (get_elapsed_time_ms(rreqs.at(0)->created_time()) < HS_DYNAMIC_CONFIG(consensus.wait_data_write_timer_ms)) {
-            break;
-        }
-        auto const next_batch = std::move(rreqs);
-        auto rdev = d;
-        m_pending_fetch_batches.pop();
-        lg.unlock();
-
-        rdev->check_and_fetch_remote_data(std::move(next_batch));
-        lg.lock();
-    }
-}
-
 void RaftReplService::gc_repl_reqs() {
     std::shared_lock lg(m_rd_map_mtx);
     for (auto it = m_rd_map.begin(); it != m_rd_map.end(); ++it) {
@@ -463,6 +557,161 @@ void RaftReplService::flush_durable_commit_lsn() {
     }
 }
 
+void RaftReplService::flush_push_data_batches() {
+    std::unique_lock lg(m_rd_map_mtx);
+    for (auto& rdev_parent : m_rd_map) {
+        auto rdev = std::dynamic_pointer_cast< RaftReplDev >(rdev_parent.second);
+        rdev->flush_push_data_batch();
+    }
+}
+
+void RaftReplService::hedge_overdue_reads() {
+    std::shared_lock lg(m_rd_map_mtx);
+    for (auto& rdev_parent : m_rd_map) {
+        auto rdev = std::dynamic_pointer_cast< RaftReplDev >(rdev_parent.second);
+        rdev->hedge_overdue_reads();
+    }
+}
+
+void RaftReplService::expire_read_index_waits() {
+    std::unique_lock lg(m_rd_map_mtx);
+    for (auto& rdev_parent : m_rd_map) {
+        auto rdev = std::dynamic_pointer_cast< RaftReplDev >(rdev_parent.second);
+        rdev->expire_read_index_waits();
+    }
+}
+
+logdev_id_t RaftReplService::acquire_logdev() {
+    auto const per_logdev = std::max(HS_DYNAMIC_CONFIG(consensus.repl_devs_per_logdev), 1u);
+    std::unique_lock lg(m_logdev_mtx);
+    if (m_shared_logdev != UINT32_MAX) {
+        auto it = m_logdev_users.find(m_shared_logdev);
+        if ((it != m_logdev_users.end()) && (it->second < per_logdev)) {
+            ++it->second;
+            return m_shared_logdev;
+        }
+    }
+
+    m_shared_logdev = logstore_service().create_new_logdev();
+    m_logdev_users[m_shared_logdev] = 1;
+    return m_shared_logdev;
+}
+
+void RaftReplService::acquire_logdev(logdev_id_t logdev_id) {
+    std::unique_lock lg(m_logdev_mtx);
+    ++m_logdev_users[logdev_id];
+}
+
+bool RaftReplService::release_logdev(logdev_id_t logdev_id) {
+    std::unique_lock lg(m_logdev_mtx);
+    auto it = m_logdev_users.find(logdev_id);
+    if ((it == m_logdev_users.end()) || (--it->second == 0)) {
+        if (it != m_logdev_users.end()) { m_logdev_users.erase(it); }
+        if (m_shared_logdev == logdev_id) { m_shared_logdev = UINT32_MAX; }
+        return true;
+    }
+    LOGINFOMOD(replication, "log_dev={} is still used by {} repl devs, not destroying it", logdev_id, it->second);
+    return false;
+}
+
+void RaftReplService::compact_logs() {
+    {
+        std::unique_lock lg(m_rd_map_mtx);
+        for (auto& rdev_parent : m_rd_map) {
+            auto rdev = std::dynamic_pointer_cast< RaftReplDev >(rdev_parent.second);
+            rdev->compact_log(HS_DYNAMIC_CONFIG(resource_limits.raft_logstore_reserve_threshold));
+        }
+    }
+
+    // Truncations above are only in memory, the space is reclaimed from the journal by the device truncation
+    logstore_service().device_truncate();
+}
+
+void RaftReplService::balance_leaders() {
+    auto const now = Clock::now();
+    auto const my_id = get_my_repl_uuid();
+
+    // Leaders per node as seen by the groups of this node, and the groups it leads
+    std::map< replica_id_t, uint32_t > nleaders;
+    std::vector< shared< RaftReplDev > > led;
+    {
+        std::shared_lock lg(m_rd_map_mtx);
+        for (auto it = m_leader_tenure.begin(); it != m_leader_tenure.end();) {
+            it = m_rd_map.contains(it->first) ? std::next(it) : m_leader_tenure.erase(it);
+        }
+        for (auto& [group_id, rd] : m_rd_map) {
+            auto rdev = std::dynamic_pointer_cast< RaftReplDev >(rd);
+            if (rdev->is_destroy_pending() || rdev->is_destroyed()) { continue; }
+            auto const leader = rdev->get_leader_id();
+            if (leader.is_nil()) { continue; }
+
+            ++nleaders[leader];
+            auto& tenure = m_leader_tenure[group_id];
+            if (tenure.first != leader) { tenure = {leader, now}; }
+            if (leader == my_id) { led.push_back(std::move(rdev)); }
+        }
+    }
+
+    auto const max_transfers = HS_DYNAMIC_CONFIG(consensus.leader_balance_max_transfers);
+    auto const min_tenure_sec = HS_DYNAMIC_CONFIG(consensus.leader_balance_min_tenure_sec);
+    auto const resp_timeout_us = uint64_cast(HS_DYNAMIC_CONFIG(consensus.elect_to_low_ms)) * 1000;
+    auto const stale_gap = uint64_cast(std::max(HS_DYNAMIC_CONFIG(consensus.stale_log_gap_lo_threshold), 0));
+    uint32_t ntransfers{0};
+    for (auto& rdev : led) {
+        if (ntransfers >= max_transfers) { break; }
+        auto& tenure = m_leader_tenure[rdev->group_id()];
+        if (get_elapsed_time_sec(tenure.second) < min_tenure_sec) { continue; }
+
+        // Member leading the fewest groups among the ones which are responsive and caught up with the log
+        auto const peers = rdev->get_replication_status();
+        uint64_t last_idx{0};
+        for (auto const& p : peers) {
+            last_idx = std::max(last_idx, p.replication_idx_);
+        }
+        std::optional< replica_id_t > successor;
+        uint32_t successor_nleaders{UINT32_MAX};
+        for (auto const& p : peers) {
+            if ((p.id_ == my_id) || (p.last_succ_resp_us_ > resp_timeout_us) ||
+                ((p.replication_idx_ + stale_gap) < last_idx)) {
+                continue;
+            }
+            auto const n = nleaders[p.id_];
+            if (n < successor_nleaders) {
+                successor = p.id_;
+                successor_nleaders = n;
+            }
+        }
+
+        // A difference of one can not be evened out, moving the leadership would only swap the counts
+        if (!successor || ((successor_nleaders + 2) > nleaders[my_id])) { continue; }
+        LOGINFOMOD(replication, "Balancing leaders: group_id={} led by this node with {} leaders, moving to {} with {}",
+                   boost::uuids::to_string(rdev->group_id()), nleaders[my_id], boost::uuids::to_string(*successor),
+                   successor_nleaders);
+        if (rdev->yield_leadership_to(*successor)) {
+            --nleaders[my_id];
+            ++nleaders[*successor];
+            tenure = {*successor, now};
+            ++ntransfers;
+        }
+    }
+}
+
+void RaftReplService::tune_append_batches() {
+    std::unique_lock lg(m_rd_map_mtx);
+    for (auto& rdev_parent : m_rd_map) {
+        auto rdev = std::dynamic_pointer_cast< RaftReplDev >(rdev_parent.second);
+        rdev->tune_append_batch();
+    }
+}
+
+void RaftReplService::check_quiesce() {
+    std::unique_lock lg(m_rd_map_mtx);
+    for (auto& rdev_parent : m_rd_map) {
+        auto rdev = std::dynamic_pointer_cast< RaftReplDev >(rdev_parent.second);
+        rdev->check_quiesce();
+    }
+}
+
 ///////////////////// RaftReplService CP Callbacks /////////////////////////////
 int ReplSvcCPContext::add_repl_dev_ctx(ReplDev* dev, cshared< ReplDevCPContext > dev_ctx) {
     m_cp_ctx_map.emplace(dev, dev_ctx);
@@ -41,13 +41,24 @@ private:
     shared< nuraft_mesg::Manager > m_msg_mgr;
     json_superblk m_config_sb;
     std::vector< std::pair< sisl::byte_view, void* > > m_config_sb_bufs;
-    std::mutex m_pending_fetch_mtx;
-    std::queue< std::pair< shared< RaftReplDev >, std::vector< repl_req_ptr_t > > > m_pending_fetch_batches;
-    iomgr::timer_handle_t m_rdev_fetch_timer_hdl;
+    iomgr::timer_handle_t m_read_index_timer_hdl;
     iomgr::timer_handle_t m_rdev_gc_timer_hdl;
     iomgr::timer_handle_t m_flush_durable_commit_timer_hdl;
+    iomgr::timer_handle_t m_push_data_batch_timer_hdl{iomgr::null_timer_handle};
+    iomgr::timer_handle_t m_quiesce_timer_hdl{iomgr::null_timer_handle};
+    iomgr::timer_handle_t m_log_compaction_timer_hdl{iomgr::null_timer_handle};
+    iomgr::timer_handle_t m_leader_balance_timer_hdl{iomgr::null_timer_handle};
+    iomgr::timer_handle_t m_hedged_read_timer_hdl{iomgr::null_timer_handle};
     iomgr::io_fiber_t m_reaper_fiber;
 
+    // Repl devs using each logdev, to share one logdev among them and destroy it only with the last of them
+    std::mutex m_logdev_mtx;
+    std::map< logdev_id_t, uint32_t > m_logdev_users;
+    logdev_id_t m_shared_logdev{UINT32_MAX}; // Logdev new repl devs are assigned to, until it is full
+
+    // Leader of each group as last seen by the balancer and since when, accessed only on the reaper thread
+    std::map< group_id_t, std::pair< replica_id_t, Clock::time_point > > m_leader_tenure;
+
 public:
     RaftReplService(cshared< ReplApplication >& repl_app);
 
@@ -58,7 +69,17 @@ public:
     std::shared_ptr< nuraft_mesg::mesg_state_mgr > create_state_mgr(int32_t srv_id,
                                                                     nuraft_mesg::group_id_t const& group_id) override;
     nuraft_mesg::Manager& msg_manager() { return *m_msg_mgr; }
-    void add_to_fetch_queue(cshared< RaftReplDev >& rdev, std::vector< repl_req_ptr_t > rreqs);
+
+    /// @brief Assigns a logdev to a new repl dev, the shared one if it has room for it as per repl_devs_per_logdev,
+    /// otherwise a newly created one.
+    logdev_id_t acquire_logdev();
+
+    /// @brief Registers an existing repl dev as a user of its logdev on load.
+    void acquire_logdev(logdev_id_t logdev_id);
+
+    /// @brief Unregisters a repl dev from its logdev. Returns true if it was the last one using it, in which case the
+    /// logdev is to be destroyed.
+    bool release_logdev(logdev_id_t logdev_id);
 
 protected:
     ///////////////////// Overrides of GenericReplService ////////////////////
@@ -74,12 +95,19 @@ protected:
 
 private:
     RaftReplDev* raft_group_config_found(sisl::byte_view const& buf, void* meta_cookie);
+    std::vector< shared< RaftReplDev > > recover_repl_devs(uint32_t nfibers);
     void start_reaper_thread();
     void stop_reaper_thread();
-    void fetch_pending_data();
     void gc_repl_devs();
     void gc_repl_reqs();
     void flush_durable_commit_lsn();
+    void flush_push_data_batches();
+    void hedge_overdue_reads();
+    void expire_read_index_waits();
+    void check_quiesce();
+    void tune_append_batches();
+    void compact_logs();
+    void balance_leaders();
 };
 
 // cp context for repl_dev, repl_dev cp_lsn is critical cursor in the system,
@@ -108,6 +136,7 @@ public:
     std::unique_ptr< CPContext > on_switchover_cp(CP* cur_cp, CP* new_cp) override;
     folly::Future< bool > cp_flush(CP* cp) override;
     void cp_cleanup(CP* cp) override;
+    bool cp_cleanup_can_overlap() const override { return true; }
     int cp_progress_percent() override;
 };
 
@@ -0,0 +1,305 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <iomgr/io_environment.hpp>
+#include <sisl/logging/logging.h>
+#include <sisl/options/options.h>
+#include <sisl/utility/enum.hpp>
+#include <homestore/homestore.hpp>
+#include "blkalloc/append_blk_allocator.h"
+#include "blkalloc/fixed_blk_allocator.h"
+#include "blkalloc/varsize_blk_allocator.h"
+#include "common/homestore_config.hpp"
+#include "test_common/homestore_test_common.hpp"
+
+/*
+ * Benchmark matrix of the blk allocators:
+ *  - ops: latency percentiles and throughput of alloc and free of FixedBlkAllocator, VarsizeBlkAllocator and
+ *         AppendBlkAllocator, by number of threads, by distribution of the request sizes (single blk, uniform 1-64,
+ *         power of 2 upto 64 and mostly small with some 64-256 blks), and by fragmentation, which is the percentage of
+ *         blks left allocated at random before the run
+ *  - cache_refill: latency of single blk allocs of a VarsizeBlkAllocator while its free blk cache is drained a few
+ *                  times over, so that the tail is the wait for the cache to be refilled by a sweep of the bitmap
+ *
+ * Results are emitted as json of google benchmark, into the file given by --json_out, so that the allocators can be
+ * compared on the workload of a vdev before picking its allocator type.
+ */
+using namespace homestore;
+SISL_LOGGING_INIT(HOMESTORE_LOG_MODS)
+
+SISL_OPTIONS_ENABLE(logging, blk_alloc_benchmark, iomgr, test_common_setup)
+SISL_OPTION_GROUP(blk_alloc_benchmark,
+                  (num_blks, "", "num_blks", "number of blks of the allocator of each run",
+                   ::cxxopts::value< uint32_t >()->default_value("8388608"), "number"),
+                  (num_ops, "", "num_ops", "number of allocs and frees of each run, spread across the threads",
+                   ::cxxopts::value< uint64_t >()->default_value("200000"), "number"),
+                  (json_out, "", "json_out", "file to write the results as json, none if empty",
+                   ::cxxopts::value< std::string >()->default_value("blk_alloc_benchmark.json"), "path"),
+                  (seed, "", "seed", "seed of the random engines, for the runs to be comparable. Random if 0",
+                   ::cxxopts::value< uint64_t >()->default_value("0"), "number"),
+                  (commit, "", "commit", "commit id recorded in the context of the results",
+                   ::cxxopts::value< std::string >()->default_value(""), "string"));
+
+static test_common::HSTestHelper s_helper;
+static constexpr uint32_t s_blk_size{4096};
+static std::atomic< chunk_num_t > s_next_id{0}; // Every allocator gets its own id, so their names don't clash
+
+ENUM(size_dist_t, uint8_t, SINGLE, UNIFORM, POW2, SKEWED);
+
+static blk_count_t gen_nblks(size_dist_t dist, std::default_random_engine& re) {
+    switch (dist) {
+    case size_dist_t::SINGLE:
+        return 1;
+    case size_dist_t::UNIFORM:
+        return std::uniform_int_distribution< blk_count_t >{1, 64}(re);
+    case size_dist_t::POW2:
+        return blk_count_t(1) << std::uniform_int_distribution< uint32_t >{0, 6}(re);
+    case size_dist_t::SKEWED:
+        return (std::uniform_int_distribution< uint32_t >{0, 9}(re) == 0)
+            ? std::uniform_int_distribution< blk_count_t >{64, 256}(re)
+            : std::uniform_int_distribution< blk_count_t >{1, 8}(re);
+    }
+    return 1;
+}
+
+static void report_latencies(benchmark::State& state, const std::string& op, std::vector< uint64_t >& lat_ns) {
+    if (lat_ns.empty()) { return; }
+    std::sort(lat_ns.begin(), lat_ns.end());
+    auto const pct = [&lat_ns](double p) {
+        return double(lat_ns[std::min(size_t(p * lat_ns.size()), lat_ns.size() - 1)]) / 1000;
+    };
+    state.counters[op + "_p50_us"] = pct(0.50);
+    state.counters[op + "_p99_us"] = pct(0.99);
+    state.counters[op + "_p999_us"] = pct(0.999);
+    state.counters[op + "_max_us"] = double(lat_ns.back()) / 1000;
+}
+
+template < typename AllocatorT >
+static std::unique_ptr< AllocatorT > create_allocator(uint64_t nblks) {
+    auto const id = s_next_id.fetch_add(1);
+    auto const name = fmt::format("blk_alloc_bench_{}", id);
+    if constexpr (std::is_same_v< AllocatorT, VarsizeBlkAllocator >) {
+        VarsizeBlkAllocConfig cfg{s_blk_size, s_blk_size, s_blk_size, nblks * s_blk_size, false /* persistent */, name};
+        return std::make_unique< VarsizeBlkAllocator >(cfg, true /* init */, id);
+    } else {
+        BlkAllocConfig cfg{s_blk_size, s_blk_size, nblks * s_blk_size, false /* persistent */, name};
+        return std::make_unique< AllocatorT >(cfg, true /* is_fresh */, id);
+    }
+}
+
+template < typename AllocatorT >
+static BlkAllocStatus do_alloc(AllocatorT& allocator, blk_count_t nblks, std::vector< BlkId >& out_bids) {
+    blk_alloc_hints hints;
+    hints.is_contiguous = false;
+    if constexpr (std::is_same_v< AllocatorT, VarsizeBlkAllocator >) {
+        return allocator.alloc(nblks, hints, out_bids);
+    } else {
+        BlkId bid;
+        auto const status = allocator.alloc(nblks, hints, bid);
+        if (status == BlkAllocStatus::SUCCESS) { out_bids.push_back(bid); }
+        return status;
+    }
+}
+
+// Allocates all the blks one by one and frees all but frag_pct of them at random, so that the free space is scattered
+template < typename AllocatorT >
+static void fragment(AllocatorT& allocator, uint32_t frag_pct) {
+    if (frag_pct == 0) { return; }
+    std::vector< BlkId > bids;
+    while (allocator.available_blks() > 0) {
+        if (do_alloc(allocator, 1, bids) != BlkAllocStatus::SUCCESS) { break; }
+    }
+
+    std::default_random_engine re{test_common::bench_seed(SISL_OPTIONS["seed"].as< uint64_t >())};
+    std::shuffle(bids.begin(), bids.end(), re);
+    bids.resize(bids.size() * (100 - frag_pct) / 100);
+    for (auto const& bid : bids) {
+        allocator.free(bid);
+    }
+}
+
+// Args: number of threads, request size distribution, fragmentation pct
+template < typename AllocatorT >
+static void BM_AllocFree(benchmark::State& state) {
+    auto const nthreads = uint32_cast(state.range(0));
+    auto const dist = size_dist_t(state.range(1));
+    auto const frag_pct = uint32_cast(state.range(2));
+
+    auto allocator = create_allocator< AllocatorT >(SISL_OPTIONS["num_blks"].as< uint32_t >());
+    fragment(*allocator, frag_pct);
+
+    // Every thread keeps upto its share of half of the free space allocated, so that allocs don't run out of space
+    auto const quota = uint64_cast(allocator->available_blks()) / 2 / nthreads;
+    auto const nops = SISL_OPTIONS["num_ops"].as< uint64_t >() / nthreads;
+
+    std::mutex mtx;
+    std::vector< uint64_t > alloc_ns, free_ns;
+    std::atomic< uint64_t > alloc_failures{0};
+    for (auto _ : state) {
+        std::vector< std::thread > threads;
+        for (uint32_t t{0}; t < nthreads; ++t) {
+            threads.emplace_back([&, t]() {
+                std::default_random_engine re{test_common::bench_seed(SISL_OPTIONS["seed"].as< uint64_t >(), t + 1)};
+                std::vector< BlkId > owned;
+                std::vector< uint64_t > my_alloc_ns, my_free_ns;
+                uint64_t owned_blks{0};
+                for (uint64_t i{0}; i < nops; ++i) {
+                    auto const nblks = gen_nblks(dist, re);
+                    bool const do_free = !owned.empty() &&
+                        ((owned_blks + nblks > quota) || (std::uniform_int_distribution< uint32_t >{0, 1}(re) == 0));
+                    if (do_free) {
+                        auto const idx = std::uniform_int_distribution< size_t >{0, owned.size() - 1}(re);
+                        auto const bid = owned[idx];
+                        owned[idx] = owned.back();
+                        owned.pop_back();
+                        auto const start = Clock::now();
+                        allocator->free(bid);
+                        my_free_ns.push_back(get_elapsed_time_ns(start));
+                        owned_blks -= bid.blk_count();
+                    } else {
+                        auto const prev = owned.size();
+                        auto const start = Clock::now();
+                        auto const status = do_alloc(*allocator, nblks, owned);
+                        my_alloc_ns.push_back(get_elapsed_time_ns(start));
+                        if (status != BlkAllocStatus::SUCCESS) {
+                            alloc_failures.fetch_add(1);
+                            // Append allocator doesn't reuse the freed blks, nothing more can be allocated once full
+                            if (status == BlkAllocStatus::SPACE_FULL) { break; }
+                            continue;
+                        }
+                        for (auto j{prev}; j < owned.size(); ++j) {
+                            owned_blks += owned[j].blk_count();
+                        }
+                    }
+                }
+
+                std::unique_lock lg{mtx};
+                alloc_ns.insert(alloc_ns.end(), my_alloc_ns.begin(), my_alloc_ns.end());
+                free_ns.insert(free_ns.end(), my_free_ns.begin(), my_free_ns.end());
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+
+    state.SetItemsProcessed(int64_cast(alloc_ns.size() + free_ns.size()));
+    state.counters["alloc_rate"] = benchmark::Counter(double(alloc_ns.size()), benchmark::Counter::kIsRate);
+    state.counters["free_rate"] = benchmark::Counter(double(free_ns.size()), benchmark::Counter::kIsRate);
+    state.counters["alloc_failures"] = double(alloc_failures.load());
+    report_latencies(state, "alloc", alloc_ns);
+    report_latencies(state, "free", free_ns);
+}
+
+// Args: fragmentation pct
+static void BM_CacheRefill(benchmark::State& state) {
+    static constexpr uint32_t drain_times{4};
+    auto const frag_pct = uint32_cast(state.range(0));
+    auto const nblks = SISL_OPTIONS["num_blks"].as< uint32_t >();
+
+    auto allocator = create_allocator< VarsizeBlkAllocator >(nblks);
+    fragment(*allocator, frag_pct);
+    VarsizeBlkAllocConfig const cfg{s_blk_size, s_blk_size, s_blk_size, uint64_cast(nblks) * s_blk_size, false, ""};
+    auto const nallocs = std::min(uint64_cast(cfg.get_max_cache_blks()) * drain_times,
+                                  uint64_cast(allocator->available_blks()));
+
+    std::vector< uint64_t > alloc_ns;
+    std::vector< BlkId > bids;
+    for (auto _ : state) {
+        alloc_ns.clear();
+        for (uint64_t i{0}; i < nallocs; ++i) {
+            auto const start = Clock::now();
+            if (do_alloc(*allocator, 1, bids) != BlkAllocStatus::SUCCESS) { break; }
+            alloc_ns.push_back(get_elapsed_time_ns(start));
+        }
+    }
+
+    state.counters["max_cache_blks"] = double(cfg.get_max_cache_blks());
+    state.counters["num_allocs"] = double(alloc_ns.size());
+    report_latencies(state, "alloc", alloc_ns);
+    LOGINFO("Metrics of the allocator: {}", allocator->get_metrics_in_json().dump(2));
+}
+
+BENCHMARK(BM_AllocFree< FixedBlkAllocator >)
+    ->ArgNames({"threads", "size_dist", "frag_pct"})
+    ->ArgsProduct({{1, 2, 4, 8}, {int64_t(size_dist_t::SINGLE)}, {0, 50, 90}})
+    ->Iterations(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_AllocFree< VarsizeBlkAllocator >)
+    ->ArgNames({"threads", "size_dist", "frag_pct"})
+    ->ArgsProduct({{1, 2, 4, 8}, benchmark::CreateDenseRange(0, 3, 1), {0, 50, 90}})
+    ->Iterations(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Append allocator doesn't reuse freed blks, so it is never fragmented
+BENCHMARK(BM_AllocFree< AppendBlkAllocator >)
+    ->ArgNames({"threads", "size_dist", "frag_pct"})
+    ->ArgsProduct({{1, 2, 4, 8}, benchmark::CreateDenseRange(0, 3, 1), {0}})
+    ->Iterations(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_CacheRefill)
+    ->ArgName("frag_pct")
+    ->Arg(0)
+    ->Arg(50)
+    ->Arg(90)
+    ->Iterations(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Append allocator registers with the meta service, so homestore is started even though no vdev is used
+static void setup() { s_helper.start_homestore("blk_alloc_benchmark", {{HS_SERVICE::META, {.size_pct = 85.0}}}); }
+
+static void teardown() { s_helper.shutdown_homestore(); }
+
+int main(int argc, char** argv) {
+    SISL_OPTIONS_LOAD(argc, argv, logging, blk_alloc_benchmark, iomgr, test_common_setup)
+    sisl::logging::SetLogger("blk_alloc_benchmark");
+    spdlog::set_pattern("[%D %T%z] [%^%l%$] [%n] [%t] %v");
+
+    // Json output goes to the file, in addition to the report on the console
+    std::vector< char* > bm_argv{argv, argv + argc};
+    auto const json_out = SISL_OPTIONS["json_out"].as< std::string >();
+    std::string out_arg{"--benchmark_out=" + json_out};
+    std::string format_arg{"--benchmark_out_format=json"};
+    if (!json_out.empty()) {
+        bm_argv.push_back(out_arg.data());
+        bm_argv.push_back(format_arg.data());
+    }
+    int bm_argc = int_cast(bm_argv.size());
+
+    setup();
+    ::benchmark::Initialize(&bm_argc, bm_argv.data());
+    ::benchmark::AddCustomContext("commit", SISL_OPTIONS["commit"].as< std::string >());
+    ::benchmark::AddCustomContext("seed", std::to_string(SISL_OPTIONS["seed"].as< uint64_t >()));
+    ::benchmark::AddCustomContext("num_blks", std::to_string(SISL_OPTIONS["num_blks"].as< uint32_t >()));
+    ::benchmark::RunSpecifiedBenchmarks();
+    teardown();
+}
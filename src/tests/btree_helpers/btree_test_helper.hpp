@@ -73,6 +73,7 @@ protected:
     uint32_t m_max_range_input{1000};
     bool m_is_multi_threaded{false};
     uint32_t m_run_time{0};
+    BtreeQueryType m_query_type{BtreeQueryType::SWEEP_NON_INTRUSIVE_PAGINATION_QUERY};
 
     std::map< std::string, op_func_t > m_operations;
     std::vector< iomgr::io_fiber_t > m_fibers;
@@ -186,6 +187,19 @@ public:
         m_shadow_map.force_put(k, value);
     }
 
+    void bulk_load(uint32_t start_k, uint32_t end_k, uint32_t stride = 1) {
+        std::vector< std::pair< K, V > > kvs;
+        for (uint64_t k{start_k}; k <= end_k; k += stride) {
+            kvs.emplace_back(K{k}, V::generate_rand());
+        }
+
+        auto const ret = m_bt->bulk_load(kvs);
+        ASSERT_EQ(ret, btree_status_t::success) << "Bulk load of " << kvs.size() << " keys failed";
+        for (auto const& [k, v] : kvs) {
+            m_shadow_map.force_put(k, v);
+        }
+    }
+
     void range_put(uint32_t start_k, uint32_t end_k, V const& value, bool update) {
         K start_key = K{start_k};
         K end_key = K{end_k};
@@ -203,6 +217,27 @@ public:
         }
     }
 
+    // Update every range_len keys in [start_k, end_k] skipping gap keys in between, as a single sorted batch
+    void range_update_batch(uint32_t start_k, uint32_t end_k, uint32_t range_len, uint32_t gap) {
+        std::vector< typename BtreeBatchRangePutRequest< K >::update_t > updates;
+        std::vector< std::unique_ptr< V > > values;
+        for (uint32_t k{start_k}; k <= end_k; k += range_len + gap) {
+            auto const last_k = std::min(k + range_len - 1, end_k);
+            values.emplace_back(std::make_unique< V >(V::generate_rand()));
+            updates.emplace_back(BtreeKeyRange< K >{K{k}, true, K{last_k}, true}, values.back().get());
+        }
+
+        BtreeBatchRangePutRequest< K > breq{std::move(updates), btree_put_type::UPDATE};
+        ASSERT_EQ(m_bt->put_batch(breq), btree_status_t::success)
+            << "batch range update failed for " << start_k << "-" << end_k;
+        ASSERT_LT(breq.m_num_descents, breq.num_updates()) << "Batch did not apply multiple updates in single descent";
+
+        for (auto const& [range, value] : breq.m_updates) {
+            m_shadow_map.range_update(range.start_key(), range.end_key().key() - range.start_key().key() + 1,
+                                      *static_cast< V const* >(value));
+        }
+    }
+
     void range_put_random() {
         bool is_update{true};
         if constexpr (std::is_same_v< V, TestIntervalValue >) { is_update = false; }
@@ -273,8 +308,7 @@ public:
         uint32_t remaining = m_shadow_map.num_elems_in_range(start_k, end_k);
         auto it = m_shadow_map.map_const().lower_bound(K{start_k});
 
-        BtreeQueryRequest< K > qreq{BtreeKeyRange< K >{K{start_k}, true, K{end_k}, true},
-                                    BtreeQueryType::SWEEP_NON_INTRUSIVE_PAGINATION_QUERY, batch_size};
+        BtreeQueryRequest< K > qreq{BtreeKeyRange< K >{K{start_k}, true, K{end_k}, true}, m_query_type, batch_size};
         while (remaining > 0) {
             out_vector.clear();
             qreq.enable_route_tracing();
@@ -311,6 +345,32 @@ public:
         }
     }
 
+    void cursor_scan(uint32_t start_k, uint32_t end_k, uint32_t batch_size, bool zero_copy = false) {
+        std::lock_guard lg{m_shadow_map.guard()};
+        auto it = m_shadow_map.map_const().lower_bound(K{start_k});
+        auto const end_it = m_shadow_map.map_const().upper_bound(K{end_k});
+
+        BtreeCursor< K > cursor{BtreeKeyRange< K >{K{start_k}, true, K{end_k}, true}, zero_copy, true /* prefetch */};
+        auto ret = btree_status_t::has_more;
+        while (ret == btree_status_t::has_more) {
+            uint32_t count{0};
+            ret = m_bt->cursor_next(cursor, batch_size, [&](BtreeKey const& k, BtreeValue const& v) {
+                if (it == end_it) {
+                    ADD_FAILURE() << "Cursor yielded more keys than expected, key=" << k.to_string();
+                    return false;
+                }
+                EXPECT_EQ(s_cast< K const& >(k).compare(it->first), 0) << "Cursor yielded incorrect key";
+                EXPECT_EQ(s_cast< V const& >(v), it->second) << "Cursor yielded incorrect data for key=" << it->first;
+                ++it;
+                ++count;
+                return true;
+            });
+            ASSERT_LE(count, batch_size) << "Cursor yielded more than batch size";
+        }
+        ASSERT_EQ(ret, btree_status_t::success) << "Expected success at the end of cursor";
+        ASSERT_TRUE(it == end_it) << "Cursor is done without yielding all keys in range";
+    }
+
     void query_random() {
         static thread_local std::uniform_int_distribution< uint32_t > s_rand_range_generator{1, 100};
 
@@ -346,6 +406,32 @@ public:
         }
     }
 
+    void multi_get(uint32_t start_k, uint32_t end_k, uint32_t stride = 1) const {
+        std::vector< K > keys;
+        std::vector< std::unique_ptr< V > > vals;
+        std::vector< BtreeValue* > out_vals;
+        for (uint32_t k{start_k}; k <= end_k; k += stride) {
+            keys.emplace_back(K{k});
+            vals.emplace_back(std::make_unique< V >());
+            out_vals.push_back(vals.back().get());
+        }
+
+        auto req = BtreeMultiGetRequest< K >{std::move(keys), std::move(out_vals)};
+        req.enable_route_tracing();
+        const auto status = m_bt->get(req);
+        ASSERT_EQ(status == btree_status_t::success, req.num_found() == req.num_keys())
+            << "Multi get status=" << enum_name(status) << " doesn't match the number of keys found";
+
+        for (uint32_t i{0}; i < req.num_keys(); ++i) {
+            if (req.is_found(i)) {
+                m_shadow_map.validate_data(req.key(i), *vals[i]);
+            } else {
+                ASSERT_EQ(m_shadow_map.exists(req.key(i)), false)
+                    << "Node key " << req.key(i) << " is missing in multi get but present in shadow map";
+            }
+        }
+    }
+
     void get_any(uint32_t start_k, uint32_t end_k) const {
         auto out_k = std::make_unique< K >();
         auto out_v = std::make_unique< V >();
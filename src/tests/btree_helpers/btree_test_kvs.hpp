@@ -20,6 +20,7 @@
 #include <map>
 #include <memory>
 #include <array>
+#include <algorithm>
 
 #include <homestore/btree/btree_kv.hpp>
 #include <homestore/btree/detail/simple_node.hpp>
@@ -68,6 +69,8 @@ private:
     uint64_t m_key{0};
 
 public:
+    using btree_int_key_t = uint64_t;
+
     TestFixedKey() = default;
     TestFixedKey(uint64_t k) : m_key{k} {}
     TestFixedKey(const TestFixedKey& other) : TestFixedKey(other.serialize(), true) {}
@@ -145,7 +148,10 @@ public:
 
 class TestVarLenKey : public BtreeKey {
 private:
+    static constexpr uint32_t s_preamble_size{8}; // Hex of the key index, which every key string starts with
+
     uint64_t m_key{0};
+    bool m_separator{false}; // Key truncated to its preamble, which only separates the keys in interior nodes
 
     static uint64_t rand_key_size() {
         return (uint64_cast(std::abs(std::round(g_randkeysize_generator(g_re)))) % g_max_keysize) + 1;
@@ -178,10 +184,13 @@ public:
 
     sisl::blob serialize() const override {
         const auto& data = idx_to_key(m_key);
-        return sisl::blob{(uint8_t*)(data->c_str()), (uint32_t)data->size()};
+        return sisl::blob{(uint8_t*)(data->c_str()), serialized_size()};
     }
 
-    uint32_t serialized_size() const override { return idx_to_key(m_key)->size(); }
+    uint32_t serialized_size() const override {
+        auto const size = uint32_cast(idx_to_key(m_key)->size());
+        return m_separator ? std::min(size, s_preamble_size) : size;
+    }
     static bool is_fixed_size() { return false; }
     static uint32_t get_fixed_size() {
         assert(0);
@@ -191,9 +200,18 @@ public:
     void deserialize(const sisl::blob& b, bool copy) {
         std::string data{r_cast< const char* >(b.cbytes()), b.size()};
         std::stringstream ss;
-        ss << std::hex << data.substr(0, 8);
+        ss << std::hex << data.substr(0, s_preamble_size);
         ss >> m_key;
-        assert(data == *idx_to_key(m_key));
+        m_separator = (data.size() < idx_to_key(m_key)->size());
+        assert(data == idx_to_key(m_key)->substr(0, data.size()));
+    }
+
+    // Keys are ordered by their index, so the left key truncated to its preamble still compares equal to the left key
+    // and less than the right key, while it is shorter than most of the keys
+    static TestVarLenKey shortest_separator(TestVarLenKey const& left, TestVarLenKey const&) {
+        TestVarLenKey sep{left.m_key};
+        sep.m_separator = true;
+        return sep;
     }
 
     // Add 8 bytes for preamble.
@@ -0,0 +1,312 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <iomgr/io_environment.hpp>
+#include <iomgr/drive_interface.hpp>
+#include <sisl/logging/logging.h>
+#include <sisl/options/options.h>
+#include <homestore/homestore.hpp>
+#include <homestore/blkdata_service.hpp>
+#include "test_common/homestore_test_common.hpp"
+
+/*
+ * Load generator of the data service, like fio but through BlkDataService:
+ *  - data_svc: random reads of the blks written by preload, and writes by async_alloc_write which free the blks they
+ *              replace by async_free_blk, by io size, queue depth and percentage of reads
+ *  - raw_dev: same mix of reads and writes at random offsets straight to a device or file through iomgr, which is the
+ *             baseline the data service runs are compared against
+ * Ios are spread across all the io reactors, whose number is given by --num_threads.
+ *
+ * IOPS, bandwidth and p50/p99/p999 latencies of each run are emitted as json of google benchmark, into the file given
+ * by --json_out, so that the overhead of homestore over the raw device can be read off the runs of same args.
+ */
+using namespace homestore;
+SISL_LOGGING_INIT(HOMESTORE_LOG_MODS)
+
+SISL_OPTIONS_ENABLE(logging, data_svc_benchmark, iomgr, test_common_setup)
+SISL_OPTION_GROUP(data_svc_benchmark,
+                  (num_ios, "", "num_ios", "number of ios of each run",
+                   ::cxxopts::value< uint64_t >()->default_value("100000"), "number"),
+                  (working_set_mb, "", "working_set_mb", "size of the data written by preload and read by each run",
+                   ::cxxopts::value< uint64_t >()->default_value("512"), "number"),
+                  (raw_dev, "", "raw_dev", "device or file for the raw runs, a file of working_set_mb in /tmp if empty",
+                   ::cxxopts::value< std::string >()->default_value(""), "path"),
+                  (json_out, "", "json_out", "file to write the results as json, none if empty",
+                   ::cxxopts::value< std::string >()->default_value("data_svc_benchmark.json"), "path"),
+                  (seed, "", "seed", "seed of the random engines, for the runs to be comparable. Random if 0",
+                   ::cxxopts::value< uint64_t >()->default_value("0"), "number"),
+                  (commit, "", "commit", "commit id recorded in the context of the results",
+                   ::cxxopts::value< std::string >()->default_value(""), "string"));
+
+static test_common::HSTestHelper s_helper;
+static const std::string s_raw_file{"/tmp/data_svc_benchmark_raw"};
+
+// Latencies of the reads and writes of a run, from the threads the ios complete on
+struct io_stats {
+    std::mutex mtx;
+    std::vector< uint64_t > read_ns;
+    std::vector< uint64_t > write_ns;
+    uint64_t nerrors{0};
+
+    void add(bool is_read, uint64_t lat_ns, bool failed) {
+        std::unique_lock lg{mtx};
+        (is_read ? read_ns : write_ns).push_back(lat_ns);
+        if (failed) { ++nerrors; }
+    }
+};
+
+static void report_latencies(benchmark::State& state, const std::string& op, std::vector< uint64_t >& lat_ns) {
+    if (lat_ns.empty()) { return; }
+    std::sort(lat_ns.begin(), lat_ns.end());
+    auto const pct = [&lat_ns](double p) {
+        return double(lat_ns[std::min(size_t(p * lat_ns.size()), lat_ns.size() - 1)]) / 1000;
+    };
+    state.counters[op + "_p50_us"] = pct(0.50);
+    state.counters[op + "_p99_us"] = pct(0.99);
+    state.counters[op + "_p999_us"] = pct(0.999);
+}
+
+static void report(benchmark::State& state, io_stats& stats, uint64_t io_size) {
+    auto const nios = stats.read_ns.size() + stats.write_ns.size();
+    state.SetItemsProcessed(int64_cast(nios));
+    state.SetBytesProcessed(int64_cast(nios * io_size));
+    state.counters["iops"] = benchmark::Counter(double(nios), benchmark::Counter::kIsRate);
+    state.counters["errors"] = double(stats.nerrors);
+    report_latencies(state, "read", stats.read_ns);
+    report_latencies(state, "write", stats.write_ns);
+}
+
+// Seed of the engine of each thread issuing the ios
+static uint64_t next_seed() {
+    static std::atomic< uint64_t > s_salt{0};
+    return test_common::bench_seed(SISL_OPTIONS["seed"].as< uint64_t >(), s_salt.fetch_add(1));
+}
+
+// Runs num_ios ios at the queue depth across all reactors, io_fn being called with whether it is a read and the
+// callback to call once the io completes
+template < typename IOFn >
+static void run_ios(uint32_t qdepth, uint32_t read_pct, io_stats& stats, IOFn&& io_fn) {
+    test_common::Runner runner{SISL_OPTIONS["num_ios"].as< uint64_t >(), qdepth};
+    runner.set_task([&]() {
+        static thread_local std::default_random_engine s_re{next_seed()};
+        bool const is_read = (std::uniform_int_distribution< uint32_t >{0, 99}(s_re) < read_pct);
+        auto const start = Clock::now();
+        io_fn(is_read, [&stats, &runner, is_read, start](bool failed) {
+            stats.add(is_read, get_elapsed_time_ns(start), failed);
+            runner.next_task();
+        });
+    });
+    runner.execute().get();
+}
+
+static uint8_t* alloc_buf(uint64_t size) {
+    auto buf = iomanager.iobuf_alloc(512, size);
+    test_common::HSTestHelper::fill_data_buf(buf, size);
+    return buf;
+}
+
+// Blks of the working set of the data service, which the writes keep replacing
+class WorkingSet {
+public:
+    WorkingSet(uint64_t io_size) : m_io_size{io_size} {
+        auto const nios = SISL_OPTIONS["working_set_mb"].as< uint64_t >() * 1024 * 1024 / io_size;
+        m_bids.resize(nios);
+        std::atomic< uint64_t > next{0};
+        test_common::Runner runner{nios, uint32_cast(std::min(nios, uint64_cast(64)))};
+        runner.set_task([&]() {
+            auto const idx = next.fetch_add(1);
+            write(idx, [&runner](bool) { runner.next_task(); });
+        });
+        runner.execute().get();
+        LOGINFO("Preloaded {} blks of size={} into the data service", nios, m_io_size);
+    }
+
+    ~WorkingSet() {
+        for (auto const& bid : m_bids) {
+            if (bid.is_valid()) { data_service().async_free_blk(bid).get(); }
+        }
+    }
+
+    template < typename CB >
+    void write(uint64_t idx, CB&& cb) {
+        sisl::sg_list sgs;
+        sgs.size = m_io_size;
+        sgs.iovs.emplace_back(iovec{.iov_base = alloc_buf(m_io_size), .iov_len = m_io_size});
+        auto out_bid = std::make_shared< MultiBlkId >();
+        data_service()
+            .async_alloc_write(sgs, blk_alloc_hints{}, *out_bid)
+            .thenValue([this, sgs, idx, out_bid, cb = std::move(cb)](auto&& err) {
+                iomanager.iobuf_free(uintptr_cast(sgs.iovs[0].iov_base));
+                if (!err) {
+                    MultiBlkId old_bid;
+                    {
+                        std::unique_lock lg{m_mtx};
+                        old_bid = std::exchange(m_bids[idx], *out_bid);
+                    }
+                    if (old_bid.is_valid()) { data_service().async_free_blk(old_bid); }
+                }
+                cb(bool(err));
+            });
+    }
+
+    template < typename CB >
+    void read(uint64_t idx, CB&& cb) {
+        MultiBlkId bid;
+        {
+            std::unique_lock lg{m_mtx};
+            bid = m_bids[idx];
+        }
+        auto buf = iomanager.iobuf_alloc(512, m_io_size);
+        data_service().async_read(bid, buf, uint32_cast(m_io_size)).thenValue([buf, cb = std::move(cb)](auto&& err) {
+            iomanager.iobuf_free(buf);
+            cb(bool(err));
+        });
+    }
+
+    uint64_t size() const { return m_bids.size(); }
+
+private:
+    uint64_t m_io_size;
+    std::mutex m_mtx;
+    std::vector< MultiBlkId > m_bids;
+};
+
+// Args: io size in KB, queue depth, percentage of reads
+static void BM_DataSvc(benchmark::State& state) {
+    auto const io_size = uint64_cast(state.range(0)) * 1024;
+    auto const qdepth = uint32_cast(state.range(1));
+    auto const read_pct = uint32_cast(state.range(2));
+
+    WorkingSet ws{io_size};
+    io_stats stats;
+    for (auto _ : state) {
+        run_ios(qdepth, read_pct, stats, [&ws](bool is_read, auto&& done) {
+            static thread_local std::default_random_engine s_re{next_seed()};
+            auto const idx = std::uniform_int_distribution< uint64_t >{0, ws.size() - 1}(s_re);
+            if (is_read) {
+                ws.read(idx, std::move(done));
+            } else {
+                ws.write(idx, std::move(done));
+            }
+        });
+    }
+    report(state, stats, io_size);
+}
+
+// Args: io size in KB, queue depth, percentage of reads
+static void BM_RawDev(benchmark::State& state) {
+    auto const io_size = uint64_cast(state.range(0)) * 1024;
+    auto const qdepth = uint32_cast(state.range(1));
+    auto const read_pct = uint32_cast(state.range(2));
+
+    auto dev = SISL_OPTIONS["raw_dev"].as< std::string >();
+    if (dev.empty()) { dev = s_raw_file; }
+    auto iodev = iomgr::DriveInterface::open_dev(dev, O_RDWR | O_DIRECT);
+    RELEASE_ASSERT(iodev, "Could not open the raw device={}, errno={}", dev, errno);
+    auto* drive = iodev->drive_interface();
+    auto const nios = SISL_OPTIONS["working_set_mb"].as< uint64_t >() * 1024 * 1024 / io_size;
+
+    io_stats stats;
+    for (auto _ : state) {
+        run_ios(qdepth, read_pct, stats, [&](bool is_read, auto&& done) {
+            static thread_local std::default_random_engine s_re{next_seed()};
+            auto const offset = std::uniform_int_distribution< uint64_t >{0, nios - 1}(s_re) * io_size;
+            auto buf = is_read ? iomanager.iobuf_alloc(512, io_size) : alloc_buf(io_size);
+            auto fut = is_read ? drive->async_read(iodev.get(), r_cast< char* >(buf), uint32_cast(io_size), offset)
+                               : drive->async_write(iodev.get(), r_cast< const char* >(buf), uint32_cast(io_size),
+                                                    offset);
+            std::move(fut).thenValue([buf, done = std::move(done)](auto&& err) {
+                iomanager.iobuf_free(buf);
+                done(bool(err));
+            });
+        });
+    }
+    drive->close_dev(iodev);
+    report(state, stats, io_size);
+}
+
+BENCHMARK(BM_DataSvc)
+    ->ArgNames({"io_kb", "qdepth", "read_pct"})
+    ->ArgsProduct({{4, 16, 64, 256}, {1, 8, 32, 128}, {0, 70, 100}})
+    ->Iterations(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_RawDev)
+    ->ArgNames({"io_kb", "qdepth", "read_pct"})
+    ->ArgsProduct({{4, 16, 64, 256}, {1, 8, 32, 128}, {0, 70, 100}})
+    ->Iterations(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+static void setup() {
+    s_helper.start_homestore("data_svc_benchmark",
+                             {{HS_SERVICE::META, {.size_pct = 5.0}}, {HS_SERVICE::DATA, {.size_pct = 80.0}}});
+
+    // Raw file is written once in full, so that the reads of the raw runs are not of holes
+    if (!SISL_OPTIONS["raw_dev"].as< std::string >().empty()) { return; }
+    static constexpr uint64_t chunk_size{1024 * 1024};
+    auto const fd = ::open(s_raw_file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    RELEASE_ASSERT_GE(fd, 0, "Could not create the raw file={}, errno={}", s_raw_file, errno);
+    std::vector< char > buf(chunk_size, 'r');
+    for (uint64_t i{0}; i < SISL_OPTIONS["working_set_mb"].as< uint64_t >(); ++i) {
+        RELEASE_ASSERT_EQ(::write(fd, buf.data(), chunk_size), ssize_t(chunk_size), "Write to raw file failed");
+    }
+    ::fsync(fd);
+    ::close(fd);
+}
+
+static void teardown() {
+    s_helper.shutdown_homestore();
+    if (SISL_OPTIONS["raw_dev"].as< std::string >().empty()) { ::unlink(s_raw_file.c_str()); }
+}
+
+int main(int argc, char** argv) {
+    SISL_OPTIONS_LOAD(argc, argv, logging, data_svc_benchmark, iomgr, test_common_setup)
+    sisl::logging::SetLogger("data_svc_benchmark");
+    spdlog::set_pattern("[%D %T%z] [%^%l%$] [%n] [%t] %v");
+
+    // Json output goes to the file, in addition to the report on the console
+    std::vector< char* > bm_argv{argv, argv + argc};
+    auto const json_out = SISL_OPTIONS["json_out"].as< std::string >();
+    std::string out_arg{"--benchmark_out=" + json_out};
+    std::string format_arg{"--benchmark_out_format=json"};
+    if (!json_out.empty()) {
+        bm_argv.push_back(out_arg.data());
+        bm_argv.push_back(format_arg.data());
+    }
+    int bm_argc = int_cast(bm_argv.size());
+
+    setup();
+    ::benchmark::Initialize(&bm_argc, bm_argv.data());
+    ::benchmark::AddCustomContext("commit", SISL_OPTIONS["commit"].as< std::string >());
+    ::benchmark::AddCustomContext("seed", std::to_string(SISL_OPTIONS["seed"].as< uint64_t >()));
+    ::benchmark::AddCustomContext("num_reactors", std::to_string(SISL_OPTIONS["num_threads"].as< uint32_t >()));
+    ::benchmark::AddCustomContext("blk_size", std::to_string(data_service().get_blk_size()));
+    ::benchmark::RunSpecifiedBenchmarks();
+    teardown();
+}
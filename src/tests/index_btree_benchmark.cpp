@@ -13,129 +13,505 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <benchmark/benchmark.h>
+#include <boost/algorithm/string.hpp>
 #include <boost/uuid/random_generator.hpp>
-#include <stdint.h>
 
 #include <iomgr/io_environment.hpp>
 #include <sisl/options/options.h>
+#include <sisl/utility/enum.hpp>
+#include <homestore/btree/mem_btree.hpp>
 #include <homestore/btree/detail/btree_internal.hpp>
+#include <homestore/btree/detail/simple_node.hpp>
+#include <homestore/btree/detail/varlen_node.hpp>
+#include <homestore/btree/detail/prefix_node.hpp>
 #include "test_common/homestore_test_common.hpp"
 #include "btree_helpers/btree_test_kvs.hpp"
-#include "test_common/range_scheduler.hpp"
-#include "btree_helpers/btree_test_helper.hpp"
 #include "btree_helpers/btree_decls.h"
 
+/*
+ * Benchmark matrix of the btree, run for every node type (FIXED, VAR_KEY, VAR_VALUE, VAR_OBJECT, PREFIX) on both a
+ * MemBtree and an IndexTable, with CPs being flushed every cp_flush_ms while the ops run:
+ *  - get, put, update: single key ops
+ *  - range_query, sweep: paginated query of query_len keys, and of the whole tree
+ *  - range_put: update of range_len keys in one op
+ *  - range_remove: remove of range_len keys, mixed with putting them back
+ *  - ycsb_a, ycsb_b, ycsb_e, ycsb_f: read/update 50/50, read/update 95/5, scan/insert 95/5 and read/rmw 50/50
+ * each with keys picked uniformly and by a scrambled zipfian distribution, so that hot keys are spread over the tree.
+ *
+ * Tree is preloaded with num_entries keys before each run and destroyed after it. Ops are spread over the sync io
+ * capable fibers of all io threads, are not validated, and their latencies are reported as p50/p99/p999 user counters
+ * by op, into the json file given by --json_out, so that they can be compared across commits.
+ */
 using namespace homestore;
+SISL_LOGGING_INIT(HOMESTORE_LOG_MODS)
 
-#define INDEX_BTREE_BENCHMARK(BTREE_TYPE)                                                                              \
-    BENCHMARK(run_benchmark< BTREE_TYPE >)                                                                             \
-        ->Setup(BM_Setup< BTREE_TYPE >)                                                                                \
-        ->Teardown(BM_Teardown< BTREE_TYPE >)                                                                          \
-        ->UseRealTime()                                                                                                \
-        ->Iterations(1)                                                                                                \
-        ->Name(#BTREE_TYPE);
+SISL_OPTIONS_ENABLE(logging, index_btree_benchmark, iomgr, test_common_setup)
+SISL_OPTION_GROUP(index_btree_benchmark,
+                  (num_entries, "", "num_entries", "number of keys preloaded into the tree before each run",
+                   ::cxxopts::value< uint32_t >()->default_value("100000"), "number"),
+                  (num_ops, "", "num_ops", "number of ops of each run, spread across all fibers",
+                   ::cxxopts::value< uint32_t >()->default_value("100000"), "number"),
+                  (run_time, "", "run_time", "max run time of each run",
+                   ::cxxopts::value< uint32_t >()->default_value("60"), "seconds"),
+                  (range_len, "", "range_len", "number of keys of each range put and range remove",
+                   ::cxxopts::value< uint32_t >()->default_value("16"), "number"),
+                  (query_len, "", "query_len", "number of keys of each range query",
+                   ::cxxopts::value< uint32_t >()->default_value("50"), "number"),
+                  (sweep_batch, "", "sweep_batch", "number of keys of each page of a sweep of the whole tree",
+                   ::cxxopts::value< uint32_t >()->default_value("1000"), "number"),
+                  (zipf_theta, "", "zipf_theta", "skew of the zipfian key distribution",
+                   ::cxxopts::value< double >()->default_value("0.99"), "number"),
+                  (cp_flush_ms, "", "cp_flush_ms", "interval of the CP flushes triggered while ops run, 0 for none",
+                   ::cxxopts::value< uint32_t >()->default_value("1000"), "ms"),
+                  (json_out, "", "json_out", "file to write the results as json, none if empty",
+                   ::cxxopts::value< std::string >()->default_value("index_btree_benchmark.json"), "path"),
+                  (seed, "", "seed", "seed of the random engines, for the runs to be comparable. Random if 0",
+                   ::cxxopts::value< uint64_t >()->default_value("0"), "number"),
+                  (commit, "", "commit", "commit id recorded in the context of the results",
+                   ::cxxopts::value< std::string >()->default_value(""), "string"));
 
-// this is used to splite the setup and teardown from the benchmark to get a more accurate result
-void* g_btree_helper{nullptr};
+ENUM(bench_op_t, uint8_t, GET, INSERT, UPDATE, UPSERT, RMW, QUERY, SWEEP, RANGE_UPDATE, RANGE_UPSERT, RANGE_REMOVE);
+static constexpr size_t s_num_op_types{10};
 
-SISL_LOGGING_INIT(HOMESTORE_LOG_MODS)
-SISL_OPTIONS_ENABLE(logging, index_btree_benchmark, iomgr, test_common_setup)
+struct workload {
+    std::string name;
+    std::vector< std::pair< bench_op_t, uint32_t > > ops; // Ops and their weights
+};
 
-SISL_OPTION_GROUP(index_btree_benchmark,
-                  (num_iters, "", "num_iters", "number of iterations for rand ops",
-                   ::cxxopts::value< uint32_t >()->default_value("500"), "number"),
-                  (num_entries, "", "num_entries", "number of entries to test with",
-                   ::cxxopts::value< uint32_t >()->default_value("5000"), "number"),
-                  (run_time, "", "run_time", "run time for io", ::cxxopts::value< uint32_t >()->default_value("30"),
-                   "seconds"),
-                  (operation_list, "", "operation_list",
-                   "operation list instead of default created following by percentage",
-                   ::cxxopts::value< std::vector< std::string > >()->default_value({"put:100"}), "operations [...]"),
-                  (preload_size, "", "preload_size", "number of entries to preload tree with",
-                   ::cxxopts::value< uint32_t >()->default_value("1000"), "number"))
+static const std::vector< workload > s_workloads{
+    {"get", {{bench_op_t::GET, 100}}},
+    {"put", {{bench_op_t::UPSERT, 100}}},
+    {"update", {{bench_op_t::UPDATE, 100}}},
+    {"range_query", {{bench_op_t::QUERY, 100}}},
+    {"sweep", {{bench_op_t::SWEEP, 100}}},
+    {"range_put", {{bench_op_t::RANGE_UPDATE, 100}}},
+    {"range_remove", {{bench_op_t::RANGE_REMOVE, 50}, {bench_op_t::RANGE_UPSERT, 50}}},
+    {"ycsb_a", {{bench_op_t::GET, 50}, {bench_op_t::UPDATE, 50}}},
+    {"ycsb_b", {{bench_op_t::GET, 95}, {bench_op_t::UPDATE, 5}}},
+    {"ycsb_e", {{bench_op_t::QUERY, 95}, {bench_op_t::INSERT, 5}}},
+    {"ycsb_f", {{bench_op_t::GET, 50}, {bench_op_t::RMW, 50}}},
+};
 
-template < typename TestType >
-struct IndexBtreeBenchmark : public BtreeTestHelper< TestType > {
-    using T = TestType;
-    using K = typename TestType::KeyType;
-    using V = typename TestType::ValueType;
-    IndexBtreeBenchmark() { SetUp(); }
+/*
+ * Zipfian distribution over [0, n) of Gray et al, "Quickly Generating Billion-Record Synthetic Databases", as used by
+ * YCSB. Ranks are scrambled by a hash, so that the hot keys are not all next to each other in the tree.
+ */
+class KeyGenerator {
+public:
+    KeyGenerator(uint64_t n, bool zipf, double theta) : m_n{n}, m_zipf{zipf}, m_theta{theta} {
+        if (!m_zipf) { return; }
+        for (uint64_t i{1}; i <= m_n; ++i) {
+            m_zetan += 1.0 / std::pow(double(i), m_theta);
+        }
+        auto const zeta2 = 1.0 + 1.0 / std::pow(2.0, m_theta);
+        m_alpha = 1.0 / (1.0 - m_theta);
+        m_eta = (1.0 - std::pow(2.0 / double(m_n), 1.0 - m_theta)) / (1.0 - zeta2 / m_zetan);
+    }
+
+    uint64_t next(std::default_random_engine& re) const {
+        std::uniform_real_distribution< double > dist{0.0, 1.0};
+        if (!m_zipf) { return uint64_cast(dist(re) * double(m_n)) % m_n; }
 
-    ~IndexBtreeBenchmark() { TearDown(); }
+        auto const u = dist(re);
+        auto const uz = u * m_zetan;
+        uint64_t rank;
+        if (uz < 1.0) {
+            rank = 0;
+        } else if (uz < 1.0 + std::pow(0.5, m_theta)) {
+            rank = 1;
+        } else {
+            rank = uint64_cast(double(m_n) * std::pow(m_eta * u - m_eta + 1.0, m_alpha));
+        }
+        return fnv_hash(std::min(rank, m_n - 1)) % m_n;
+    }
 
-    void SetUp() {
-        m_helper.start_homestore("index_btree_benchmark",
-                                 {{HS_SERVICE::META, {.size_pct = 10.0}}, {HS_SERVICE::INDEX, {.size_pct = 70.0}}});
+private:
+    static uint64_t fnv_hash(uint64_t v) {
+        uint64_t h{0xcbf29ce484222325ULL};
+        for (uint32_t i{0}; i < sizeof(v); ++i) {
+            h = (h ^ (v & 0xff)) * 0x100000001b3ULL;
+            v >>= 8;
+        }
+        return h;
+    }
 
-        this->m_cfg = BtreeConfig(hs()->index_service().node_size());
-        this->m_is_multi_threaded = true;
+private:
+    uint64_t m_n;
+    bool m_zipf;
+    double m_theta;
+    double m_zetan{0.0};
+    double m_alpha{0.0};
+    double m_eta{0.0};
+};
 
-        auto uuid = boost::uuids::random_generator()();
-        auto parent_uuid = boost::uuids::random_generator()();
+struct FixedLenMemBtree {
+    using BtreeType = MemBtree< TestFixedKey, TestFixedValue >;
+    using KeyType = TestFixedKey;
+    using ValueType = TestFixedValue;
+    static constexpr btree_node_type leaf_node_type = btree_node_type::FIXED;
+    static constexpr btree_node_type interior_node_type = btree_node_type::FIXED;
+};
 
-        BtreeTestHelper< TestType >::SetUp();
-        this->m_bt = std::make_shared< typename T::BtreeType >(uuid, parent_uuid, 0, this->m_cfg);
-        hs()->index_service().add_index_table(this->m_bt);
-        auto input_ops = SISL_OPTIONS["operation_list"].as< std::vector< std::string > >();
-        m_op_list = this->build_op_list(input_ops);
+struct VarKeySizeMemBtree {
+    using BtreeType = MemBtree< TestVarLenKey, TestFixedValue >;
+    using KeyType = TestVarLenKey;
+    using ValueType = TestFixedValue;
+    static constexpr btree_node_type leaf_node_type = btree_node_type::VAR_KEY;
+    static constexpr btree_node_type interior_node_type = btree_node_type::VAR_KEY;
+};
+
+struct VarValueSizeMemBtree {
+    using BtreeType = MemBtree< TestFixedKey, TestVarLenValue >;
+    using KeyType = TestFixedKey;
+    using ValueType = TestVarLenValue;
+    static constexpr btree_node_type leaf_node_type = btree_node_type::VAR_VALUE;
+    static constexpr btree_node_type interior_node_type = btree_node_type::FIXED;
+};
+
+struct VarObjSizeMemBtree {
+    using BtreeType = MemBtree< TestVarLenKey, TestVarLenValue >;
+    using KeyType = TestVarLenKey;
+    using ValueType = TestVarLenValue;
+    static constexpr btree_node_type leaf_node_type = btree_node_type::VAR_OBJECT;
+    static constexpr btree_node_type interior_node_type = btree_node_type::VAR_OBJECT;
+};
+
+struct PrefixIntervalMemBtree {
+    using BtreeType = MemBtree< TestIntervalKey, TestIntervalValue >;
+    using KeyType = TestIntervalKey;
+    using ValueType = TestIntervalValue;
+    static constexpr btree_node_type leaf_node_type = btree_node_type::PREFIX;
+    static constexpr btree_node_type interior_node_type = btree_node_type::FIXED;
+};
+
+static test_common::HSTestHelper s_helper;
+static std::vector< iomgr::io_fiber_t > s_fibers;
+
+template < typename T >
+class BtreeBench {
+public:
+    using K = typename T::KeyType;
+    using V = typename T::ValueType;
+    static constexpr bool is_index_table = std::is_same_v< typename T::BtreeType, IndexTable< K, V > >;
+    static constexpr bool is_interval = std::is_same_v< V, TestIntervalValue >;
+
+    BtreeBench() {
+        BtreeConfig cfg{hs()->index_service().node_size()};
+        cfg.m_leaf_node_type = T::leaf_node_type;
+        cfg.m_int_node_type = T::interior_node_type;
+        if constexpr (is_index_table) {
+            auto const uuid = boost::uuids::random_generator()();
+            auto const parent_uuid = boost::uuids::random_generator()();
+            m_bt = std::make_shared< typename T::BtreeType >(uuid, parent_uuid, 0, cfg);
+            hs()->index_service().add_index_table(m_bt);
+        } else {
+            m_bt = std::make_shared< typename T::BtreeType >(cfg);
+        }
+        m_next_insert_key.store(SISL_OPTIONS["num_entries"].as< uint32_t >());
+    }
+
+    ~BtreeBench() {
+        if constexpr (is_index_table) {
+            {
+                auto cpg = hs()->cp_mgr().cp_guard();
+                m_bt->destroy_btree((void*)cpg.context(cp_consumer_t::INDEX_SVC));
+            }
+            hs()->index_service().remove_index_table(m_bt);
+        }
+        m_bt.reset();
     }
 
-    void TearDown() {
-        BtreeTestHelper< TestType >::TearDown();
-        m_helper.shutdown_homestore();
+    void preload() {
+        auto const nkeys = SISL_OPTIONS["num_entries"].as< uint32_t >();
+        run_on_fibers([this, nkeys](uint32_t fiber_id, uint32_t nfibers) {
+            for (uint64_t k{fiber_id}; k < nkeys; k += nfibers) {
+                put(k, btree_put_type::UPSERT);
+            }
+        });
     }
 
-    void run_benchmark() { this->run_in_parallel(m_op_list); }
+    // Latencies in ns of every op of the run, by op
+    using latencies_t = std::array< std::vector< uint64_t >, s_num_op_types >;
+
+    latencies_t run(const workload& wl, const KeyGenerator& keygen) {
+        auto const num_ops = SISL_OPTIONS["num_ops"].as< uint32_t >();
+        auto const run_time = SISL_OPTIONS["run_time"].as< uint32_t >();
+
+        std::mutex mtx;
+        latencies_t all_lat;
+        run_on_fibers([&](uint32_t fiber_id, uint32_t nfibers) {
+            std::default_random_engine re{test_common::bench_seed(SISL_OPTIONS["seed"].as< uint64_t >(), fiber_id)};
+            std::vector< uint32_t > weights;
+            for (auto const& [op, w] : wl.ops) {
+                weights.push_back(w);
+            }
+            std::discrete_distribution< uint32_t > pick_op{weights.begin(), weights.end()};
+
+            latencies_t lat;
+            auto const start_time = Clock::now();
+            auto const nops = num_ops / nfibers + ((fiber_id < num_ops % nfibers) ? 1 : 0);
+            for (uint32_t i{0}; (i < nops) && (get_elapsed_time_sec(start_time) < run_time); ++i) {
+                auto const op = wl.ops[pick_op(re)].first;
+                auto const k = keygen.next(re);
+                auto const op_start = Clock::now();
+                do_op(op, k);
+                lat[enum_value(op)].push_back(get_elapsed_time_ns(op_start));
+            }
+
+            std::unique_lock lg{mtx};
+            for (size_t i{0}; i < s_num_op_types; ++i) {
+                all_lat[i].insert(all_lat[i].end(), lat[i].begin(), lat[i].end());
+            }
+        });
+        return all_lat;
+    }
+
+private:
+    void do_op(bench_op_t op, uint64_t k) {
+        auto const range_len = SISL_OPTIONS["range_len"].as< uint32_t >();
+        switch (op) {
+        case bench_op_t::GET:
+            get(k);
+            break;
+        case bench_op_t::INSERT:
+            put(m_next_insert_key.fetch_add(1), btree_put_type::INSERT);
+            break;
+        case bench_op_t::UPDATE:
+            // Interval values can't be updated in place, as their value depends on the key
+            put(k, is_interval ? btree_put_type::UPSERT : btree_put_type::UPDATE);
+            break;
+        case bench_op_t::UPSERT:
+            put(k, btree_put_type::UPSERT);
+            break;
+        case bench_op_t::RMW:
+            get(k);
+            put(k, is_interval ? btree_put_type::UPSERT : btree_put_type::UPDATE);
+            break;
+        case bench_op_t::QUERY: {
+            auto const len = SISL_OPTIONS["query_len"].as< uint32_t >();
+            query(k, k + len - 1, len);
+            break;
+        }
+        case bench_op_t::SWEEP:
+            query(0, m_next_insert_key.load() - 1, SISL_OPTIONS["sweep_batch"].as< uint32_t >());
+            break;
+        case bench_op_t::RANGE_UPDATE:
+            range_put(k, k + range_len - 1, is_interval ? btree_put_type::UPSERT : btree_put_type::UPDATE);
+            break;
+        case bench_op_t::RANGE_UPSERT:
+            // Only interval keys can be created by a range put, the others are put back one by one
+            if constexpr (is_interval) {
+                range_put(k, k + range_len - 1, btree_put_type::UPSERT);
+            } else {
+                for (uint64_t i{k}; i < k + range_len; ++i) {
+                    put(i, btree_put_type::UPSERT);
+                }
+            }
+            break;
+        case bench_op_t::RANGE_REMOVE: {
+            auto rreq = BtreeRangeRemoveRequest< K >{BtreeKeyRange< K >{K{k}, true, K{k + range_len - 1}, true}};
+            m_bt->remove(rreq);
+            break;
+        }
+        }
+    }
+
+    void get(uint64_t k) {
+        auto key = std::make_unique< K >(k);
+        auto out_v = std::make_unique< V >();
+        auto req = BtreeSingleGetRequest{key.get(), out_v.get()};
+        m_bt->get(req);
+    }
+
+    void put(uint64_t k, btree_put_type put_type) {
+        K key{k};
+        V value = V::generate_rand();
+        auto existing_v = std::make_unique< V >();
+        auto sreq = BtreeSinglePutRequest{&key, &value, put_type, existing_v.get()};
+        m_bt->put(sreq);
+    }
+
+    void range_put(uint64_t start_k, uint64_t end_k, btree_put_type put_type) {
+        V value = V::generate_rand();
+        auto preq = BtreeRangePutRequest< K >{BtreeKeyRange< K >{K{start_k}, true, K{end_k}, true}, put_type, &value};
+        m_bt->put(preq);
+    }
+
+    void query(uint64_t start_k, uint64_t end_k, uint32_t batch_size) {
+        std::vector< std::pair< K, V > > out_vector;
+        BtreeQueryRequest< K > qreq{BtreeKeyRange< K >{K{start_k}, true, K{end_k}, true},
+                                    BtreeQueryType::SWEEP_NON_INTRUSIVE_PAGINATION_QUERY, batch_size};
+        while (m_bt->query(qreq, out_vector) == btree_status_t::has_more) {
+            out_vector.clear();
+        }
+    }
+
+    template < typename CB >
+    static void run_on_fibers(CB&& cb) {
+        auto const nfibers = uint32_cast(s_fibers.size());
+        std::mutex mtx;
+        std::condition_variable cv;
+        auto remaining = nfibers;
+        for (uint32_t i{0}; i < nfibers; ++i) {
+            iomanager.run_on_forget(s_fibers[i], [&, i]() {
+                cb(i, nfibers);
+                std::unique_lock lg{mtx};
+                if (--remaining == 0) { cv.notify_one(); }
+            });
+        }
+        std::unique_lock lg{mtx};
+        cv.wait(lg, [&remaining]() { return remaining == 0; });
+    }
 
 private:
-    test_common::HSTestHelper m_helper;
-    std::vector< std::pair< std::string, int > > m_op_list;
+    std::shared_ptr< typename T::BtreeType > m_bt;
+    std::atomic< uint64_t > m_next_insert_key{0}; // Keys from num_entries on are inserted by the INSERT ops
 };
 
-template < class BenchmarkType >
-void BM_Setup(const benchmark::State& state) {
-    g_btree_helper = new IndexBtreeBenchmark< BenchmarkType >();
-    auto helper = s_cast< IndexBtreeBenchmark< BenchmarkType >* >(g_btree_helper);
-    helper->preload(SISL_OPTIONS["preload_size"].as< uint32_t >());
-}
+// Triggers a CP flush every cp_flush_ms while it is alive, so that the ops run against the flushes as in production
+class CPFlusher {
+public:
+    CPFlusher() {
+        auto const interval = std::chrono::milliseconds{SISL_OPTIONS["cp_flush_ms"].as< uint32_t >()};
+        if (interval.count() == 0) { return; }
+        m_thread = std::thread([this, interval]() {
+            std::unique_lock lg{m_mtx};
+            while (!m_cv.wait_for(lg, interval, [this]() { return m_stopping; })) {
+                lg.unlock();
+                hs()->cp_mgr().trigger_cp_flush(false /* force */).wait();
+                lg.lock();
+            }
+        });
+    }
 
-template < class BenchmarkType >
-void BM_Teardown(const benchmark::State& state) {
-    auto helper = s_cast< IndexBtreeBenchmark< BenchmarkType >* >(g_btree_helper);
-    delete helper;
-}
+    ~CPFlusher() {
+        {
+            std::unique_lock lg{m_mtx};
+            m_stopping = true;
+        }
+        m_cv.notify_all();
+        if (m_thread.joinable()) { m_thread.join(); }
+    }
+
+private:
+    std::mutex m_mtx;
+    std::condition_variable m_cv;
+    bool m_stopping{false};
+    std::thread m_thread;
+};
 
-template < class BenchmarkType >
-void add_custom_counter(benchmark::State& state) {
-    auto helper = s_cast< IndexBtreeBenchmark< BenchmarkType >* >(g_btree_helper);
-    auto totol_ops = helper->get_op_num();
-    state.counters["thread_num"] = SISL_OPTIONS["num_threads"].as< uint32_t >();
-    state.counters["fiber_num"] = SISL_OPTIONS["num_fibers"].as< uint32_t >();
-    state.counters["total_ops"] = totol_ops;
-    state.counters["rate"] = benchmark::Counter(totol_ops, benchmark::Counter::kIsRate);
-    state.counters["InvRate"] =
-        benchmark::Counter(totol_ops, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+static void report_latencies(benchmark::State& state, bench_op_t op, std::vector< uint64_t >& lat_ns) {
+    if (lat_ns.empty()) { return; }
+    std::sort(lat_ns.begin(), lat_ns.end());
+    auto const pct = [&lat_ns](double p) {
+        return double(lat_ns[std::min(size_t(p * lat_ns.size()), lat_ns.size() - 1)]) / 1000;
+    };
+    auto const name = boost::algorithm::to_lower_copy(std::string{enum_name(op)});
+    state.counters[name + "_ops"] = double(lat_ns.size());
+    state.counters[name + "_p50_us"] = pct(0.50);
+    state.counters[name + "_p99_us"] = pct(0.99);
+    state.counters[name + "_p999_us"] = pct(0.999);
 }
 
-template < class BenchmarkType >
-void run_benchmark(benchmark::State& state) {
-    auto helper = s_cast< IndexBtreeBenchmark< BenchmarkType >* >(g_btree_helper);
+template < typename T >
+static void BM_Workload(benchmark::State& state, const workload& wl, bool zipf) {
+    KeyGenerator const keygen{SISL_OPTIONS["num_entries"].as< uint32_t >(), zipf,
+                              SISL_OPTIONS["zipf_theta"].as< double >()};
+    BtreeBench< T > bench;
+    bench.preload();
+
+    uint64_t total_ops{0};
     for (auto _ : state) {
-        helper->run_benchmark();
+        typename BtreeBench< T >::latencies_t lat;
+        {
+            CPFlusher flusher;
+            lat = bench.run(wl, keygen);
+        }
+        for (size_t i{0}; i < s_num_op_types; ++i) {
+            total_ops += lat[i].size();
+            report_latencies(state, bench_op_t(i), lat[i]);
+        }
+    }
+    state.counters["total_ops"] = double(total_ops);
+    state.counters["rate"] = benchmark::Counter(double(total_ops), benchmark::Counter::kIsRate);
+}
+
+template < typename T >
+static void register_benchmarks(const std::string& tree_name) {
+    for (auto const& wl : s_workloads) {
+        for (bool zipf : {false, true}) {
+            auto const name = tree_name + "/" + wl.name + (zipf ? "/zipfian" : "/uniform");
+            benchmark::RegisterBenchmark(name.c_str(), BM_Workload< T >, wl, zipf)
+                ->Iterations(1)
+                ->UseRealTime()
+                ->Unit(benchmark::kMillisecond);
+        }
     }
-    add_custom_counter< BenchmarkType >(state);
 }
 
-INDEX_BTREE_BENCHMARK(FixedLenBtree)
-INDEX_BTREE_BENCHMARK(VarKeySizeBtree)
-INDEX_BTREE_BENCHMARK(VarValueSizeBtree)
-INDEX_BTREE_BENCHMARK(VarObjSizeBtree)
-// INDEX_BTREE_BENCHMARK(PrefixIntervalBtree)
+static void setup() {
+    s_helper.start_homestore("index_btree_benchmark",
+                             {{HS_SERVICE::META, {.size_pct = 10.0}}, {HS_SERVICE::INDEX, {.size_pct = 70.0}}});
+    std::mutex mtx;
+    iomanager.run_on_wait(iomgr::reactor_regex::all_worker, [&mtx]() {
+        auto fv = iomanager.sync_io_capable_fibers();
+        std::unique_lock lg(mtx);
+        s_fibers.insert(s_fibers.end(), fv.begin(), fv.end());
+    });
+}
+
+static void teardown() {
+    s_fibers.clear();
+    s_helper.shutdown_homestore();
+}
 
 int main(int argc, char** argv) {
-    SISL_OPTIONS_LOAD(argc, argv, logging, index_btree_benchmark, iomgr, test_common_setup);
-    ::benchmark::Initialize(&argc, argv);
+    SISL_OPTIONS_LOAD(argc, argv, logging, index_btree_benchmark, iomgr, test_common_setup)
+    sisl::logging::SetLogger("index_btree_benchmark");
+    spdlog::set_pattern("[%D %T%z] [%^%l%$] [%n] [%t] %v");
+
+    // Json output goes to the file, in addition to the report on the console
+    std::vector< char* > bm_argv{argv, argv + argc};
+    auto const json_out = SISL_OPTIONS["json_out"].as< std::string >();
+    std::string out_arg{"--benchmark_out=" + json_out};
+    std::string format_arg{"--benchmark_out_format=json"};
+    if (!json_out.empty()) {
+        bm_argv.push_back(out_arg.data());
+        bm_argv.push_back(format_arg.data());
+    }
+    int bm_argc = int_cast(bm_argv.size());
+
+    register_benchmarks< FixedLenMemBtree >("MemBtree/FIXED");
+    register_benchmarks< VarKeySizeMemBtree >("MemBtree/VAR_KEY");
+    register_benchmarks< VarValueSizeMemBtree >("MemBtree/VAR_VALUE");
+    register_benchmarks< VarObjSizeMemBtree >("MemBtree/VAR_OBJECT");
+    register_benchmarks< PrefixIntervalMemBtree >("MemBtree/PREFIX");
+    register_benchmarks< FixedLenBtree >("IndexTable/FIXED");
+    register_benchmarks< VarKeySizeBtree >("IndexTable/VAR_KEY");
+    register_benchmarks< VarValueSizeBtree >("IndexTable/VAR_VALUE");
+    register_benchmarks< VarObjSizeBtree >("IndexTable/VAR_OBJECT");
+    register_benchmarks< PrefixIntervalBtree >("IndexTable/PREFIX");
+
+    setup();
+    ::benchmark::Initialize(&bm_argc, bm_argv.data());
+    ::benchmark::AddCustomContext("commit", SISL_OPTIONS["commit"].as< std::string >());
+    ::benchmark::AddCustomContext("seed", std::to_string(SISL_OPTIONS["seed"].as< uint64_t >()));
+    ::benchmark::AddCustomContext("num_entries", std::to_string(SISL_OPTIONS["num_entries"].as< uint32_t >()));
+    ::benchmark::AddCustomContext("num_fibers", std::to_string(s_fibers.size()));
     ::benchmark::RunSpecifiedBenchmarks();
+    teardown();
 }
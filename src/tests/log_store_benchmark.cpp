@@ -13,16 +13,20 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstdint>
 #include <cstring>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <mutex>
 #include <random>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <benchmark/benchmark.h>
@@ -32,141 +36,313 @@
 #include <homestore/homestore.hpp>
 #include <homestore/homestore_decl.hpp>
 #include <homestore/logstore_service.hpp>
+#include "common/homestore_config.hpp"
 #include "test_common/homestore_test_common.hpp"
 
+/*
+ * Benchmark matrix of the log store:
+ *  - append: append latency percentiles and throughput by record size and number of outstanding appends
+ *  - flush_mode: same, across inline, timer, inline + timer and explicit flushes of the logdev
+ *  - recovery: time taken by the restart to load and replay a logdev, by the size of its journal
+ *  - truncate: time taken to truncate all the log stores of a logdev and the device, by the number of log stores
+ *  - read_sync: throughput of the reads of flushed records, by record size
+ *
+ * Results are emitted as json of google benchmark, into the file given by --json_out, with latencies as user
+ * counters of each run, so that they can be compared across commits.
+ */
 using namespace homestore;
 SISL_LOGGING_INIT(HOMESTORE_LOG_MODS)
 
 SISL_OPTIONS_ENABLE(logging, log_store_benchmark, iomgr, test_common_setup)
 SISL_OPTION_GROUP(log_store_benchmark,
-                  (num_logstores, "", "num_logstores", "number of log stores",
-                   ::cxxopts::value< uint32_t >()->default_value("1"), "number"),
-                  (num_entries, "", "num_entries", "number of log records",
+                  (num_entries, "", "num_entries", "number of log records appended by each run",
                    ::cxxopts::value< uint64_t >()->default_value("100000"), "number"),
-                  (qdepth, "", "qdepth", "qdepth per thread", ::cxxopts::value< uint32_t >()->default_value("32"),
-                   "number"),
-                  (max_record_size, "", "max_record_size", "max record size",
-                   ::cxxopts::value< uint32_t >()->default_value("1024"), "number"));
+                  (json_out, "", "json_out", "file to write the results as json, none if empty",
+                   ::cxxopts::value< std::string >()->default_value("log_store_benchmark.json"), "path"),
+                  (seed, "", "seed", "seed of the random engines, for the runs to be comparable. Random if 0",
+                   ::cxxopts::value< uint64_t >()->default_value("0"), "number"),
+                  (commit, "", "commit", "commit id recorded in the context of the results",
+                   ::cxxopts::value< std::string >()->default_value(""), "string"));
 
-static constexpr size_t ITERATIONS{100000};
 static test_common::HSTestHelper s_helper;
 
-class BenchLogStore {
+// Flush modes of the logdev, as in logstore.flush_mode
+static constexpr int64_t FLUSH_INLINE{1};
+static constexpr int64_t FLUSH_TIMER{2};
+static constexpr int64_t FLUSH_EXPLICIT{4};
+
+static void set_flush_mode(int64_t mode) {
+    HS_SETTINGS_FACTORY().modifiable_settings([mode](auto& s) { s.logstore.flush_mode = uint32_cast(mode); });
+    HS_SETTINGS_FACTORY().save();
+}
+
+static void report_latencies(benchmark::State& state, std::vector< uint64_t >& lat_us) {
+    if (lat_us.empty()) { return; }
+    std::sort(lat_us.begin(), lat_us.end());
+    auto const pct = [&lat_us](double p) {
+        return double(lat_us[std::min(size_t(p * lat_us.size()), lat_us.size() - 1)]);
+    };
+    state.counters["p50_us"] = pct(0.50);
+    state.counters["p90_us"] = pct(0.90);
+    state.counters["p99_us"] = pct(0.99);
+    state.counters["p999_us"] = pct(0.999);
+    state.counters["max_us"] = double(lat_us.back());
+}
+
+/*
+ * Appends records of a fixed size to a log store of its own logdev, keeping qdepth of them outstanding, and records
+ * the latency of each of them from the append till its completion.
+ */
+class AppendDriver {
 public:
-    friend class SampleDB;
-    BenchLogStore() {
+    AppendDriver(uint32_t record_size, uint32_t qdepth, bool explicit_flush) :
+            m_data(record_size, 'a'), m_qdepth{qdepth}, m_explicit_flush{explicit_flush} {
         m_logdev_id = logstore_service().create_new_logdev();
         m_log_store = logstore_service().create_new_log_store(m_logdev_id, true /* append_mode */);
-        m_log_store->register_log_found_cb(bind_this(BenchLogStore::on_log_found, 3));
-        m_nth_entry.store(0);
-        generate_rand_data();
     }
 
-    BenchLogStore(const BenchLogStore&) = delete;
-    BenchLogStore& operator=(const BenchLogStore&) = delete;
-    BenchLogStore(BenchLogStore&&) noexcept = delete;
-    BenchLogStore& operator=(BenchLogStore&&) noexcept = delete;
-    ~BenchLogStore() = default;
+    AppendDriver(const AppendDriver&) = delete;
+    AppendDriver& operator=(const AppendDriver&) = delete;
+    AppendDriver(AppendDriver&&) noexcept = delete;
+    AppendDriver& operator=(AppendDriver&&) noexcept = delete;
+
+    ~AppendDriver() { logstore_service().destroy_log_dev(m_logdev_id); }
 
-    void kickstart_io() {
+    // Returns the latencies of the appends in us
+    std::vector< uint64_t > run(uint64_t nentries) {
+        m_nentries = nentries;
+        m_issued.store(0);
+        m_completed.store(0);
+        m_start_times.assign(nentries, Clock::time_point{});
+        m_lat_us.assign(nentries, 0);
         m_done = false;
-        iomanager.run_on_forget(iomgr::reactor_regex::all_io, [this]() {
-            for (uint32_t i{0}; i < m_q_depth; ++i) {
-                issue_io();
-            };
-        });
-    }
 
-    void wait_for_appends() {
-        {
-            std::unique_lock< std::mutex > lk{m_pending_mtx};
-            m_pending_cv.wait(lk, [&] { return (m_done); });
+        for (uint32_t i{0}; i < m_qdepth; ++i) {
+            iomanager.run_on_forget(iomgr::reactor_regex::random_worker, [this]() { issue(); });
         }
-        DLOGDEBUG("All appends completed for iteration={} and waiting is done, outstanding = {}", m_iteration,
-                  m_outstanding.load());
-        m_done = false;
-        ++m_iteration;
+
+        std::unique_lock lk{m_done_mtx};
+        if (m_explicit_flush) {
+            // Application which flushes on its own cadence
+            while (!m_done) {
+                lk.unlock();
+                m_log_store->flush();
+                lk.lock();
+                m_done_cv.wait_for(lk, std::chrono::microseconds{100}, [this] { return m_done; });
+            }
+        } else {
+            m_done_cv.wait(lk, [this] { return m_done; });
+        }
+        return std::move(m_lat_us);
     }
 
+    uint64_t bytes_appended() const { return m_nentries * m_data.size(); }
+
 private:
-    void issue_io() {
-        m_outstanding.fetch_add(1, std::memory_order_acq_rel);
-        if (!do_append()) {
-            DLOGDEBUG("Notify that append has reached limit outstanding = {}", m_outstanding.load());
-            bool notify{false};
-            {
-                std::unique_lock< std::mutex > lk{m_pending_mtx};
-                notify = m_done = (m_outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1);
-            }
+    void issue() {
+        auto const idx = m_issued.fetch_add(1, std::memory_order_acq_rel);
+        if (idx >= m_nentries) { return; }
 
-            if (notify) {
-                DLOGDEBUG("Notify that append has completed, outstanding = {}", m_outstanding.load());
-                m_pending_cv.notify_all();
+        m_start_times[idx] = Clock::now();
+        m_log_store->append_async(sisl::io_blob(uintptr_cast(m_data.data()), uint32_cast(m_data.size()), false),
+                                  r_cast< void* >(idx),
+                                  [this](logstore_seq_num_t, sisl::io_blob&, logdev_key, void* cookie) {
+                                      on_completion(r_cast< uint64_t >(cookie));
+                                  });
+    }
+
+    void on_completion(uint64_t idx) {
+        m_lat_us[idx] = get_elapsed_time_us(m_start_times[idx]);
+        if (m_completed.fetch_add(1, std::memory_order_acq_rel) + 1 == m_nentries) {
+            {
+                std::unique_lock lk{m_done_mtx};
+                m_done = true;
             }
+            m_done_cv.notify_all();
+            return;
         }
+        issue();
     }
 
-    bool do_append() {
-        auto const ind = m_nth_entry.fetch_add(1, std::memory_order_acq_rel);
-        auto const iter_ind = (ind - 1) / m_iteration + 1;
-        if (iter_ind >= int64_cast(m_nentries)) { return false; }
-
-        DLOGDEBUG("Appending log entry for iteration_ind={} ind={}", iter_ind, ind);
-        m_log_store->append_async(
-            sisl::io_blob(uintptr_cast(m_data[iter_ind].data()), uint32_cast(m_data[iter_ind].size()), false), nullptr,
-            [this](logstore_seq_num_t, sisl::io_blob&, bool, void*) {
-                if (m_outstanding.fetch_sub(1, std::memory_order_acq_rel) < int_cast(m_q_depth)) { issue_io(); };
-            });
-        return true;
+private:
+    std::string m_data;
+    uint32_t const m_qdepth;
+    bool const m_explicit_flush;
+    logdev_id_t m_logdev_id;
+    std::shared_ptr< HomeLogStore > m_log_store;
+
+    uint64_t m_nentries{0};
+    std::atomic< uint64_t > m_issued{0};
+    std::atomic< uint64_t > m_completed{0};
+    std::vector< Clock::time_point > m_start_times;
+    std::vector< uint64_t > m_lat_us;
+
+    std::mutex m_done_mtx;
+    std::condition_variable m_done_cv;
+    bool m_done{false};
+};
+
+static void run_appends(benchmark::State& state, uint32_t record_size, uint32_t qdepth, int64_t flush_mode) {
+    auto const nentries = SISL_OPTIONS["num_entries"].as< uint64_t >();
+    set_flush_mode(flush_mode);
+    AppendDriver driver{record_size, qdepth, (flush_mode == FLUSH_EXPLICIT)};
+
+    std::vector< uint64_t > lat_us;
+    for (auto _ : state) {
+        lat_us = driver.run(nentries);
     }
+    state.SetItemsProcessed(int64_cast(state.iterations() * nentries));
+    state.SetBytesProcessed(int64_cast(state.iterations() * driver.bytes_appended()));
+    report_latencies(state, lat_us);
+}
 
-    void read(logstore_seq_num_t lsn) { m_log_store->read_sync(lsn); }
+// Args: record size, outstanding appends
+static void BM_Append(benchmark::State& state) {
+    run_appends(state, uint32_cast(state.range(0)), uint32_cast(state.range(1)), FLUSH_INLINE | FLUSH_TIMER);
+}
 
-    void on_log_found(logstore_seq_num_t lsn, log_buffer buf, void* ctx) {
-        // LOGDEBUG("Recovered lsn {}:{} with log data of size {}", m_log_store->get_store_id(), lsn, buf.size())
+// Args: flush mode
+static void BM_FlushMode(benchmark::State& state) { run_appends(state, 512, 32, state.range(0)); }
+
+// Args: journal size in MB
+static void BM_Recovery(benchmark::State& state) {
+    static constexpr uint32_t record_size{4096};
+    uint64_t const nentries = uint64_cast(state.range(0)) * 1024 * 1024 / record_size;
+    set_flush_mode(FLUSH_INLINE | FLUSH_TIMER);
+
+    auto const logdev_id = logstore_service().create_new_logdev();
+    auto log_store = logstore_service().create_new_log_store(logdev_id, true /* append_mode */);
+    auto const store_id = log_store->get_store_id();
+    std::string data(record_size, 'r');
+    for (uint64_t i{0}; i < nentries; ++i) {
+        log_store->append_async(sisl::io_blob(uintptr_cast(data.data()), record_size, false), nullptr,
+                                nullptr);
     }
+    log_store->flush();
 
-    void generate_rand_data() {
-        static thread_local std::random_device rd{};
-        static thread_local std::default_random_engine re{rd()};
-        std::uniform_int_distribution< uint32_t > data_size{0, m_max_data_size - 1};
+    // Only the start of homestore is timed, not the shutdown before it
+    std::atomic< uint64_t > recovered{0};
+    Clock::time_point start_time;
+    uint64_t recovery_us{0};
+    for (auto _ : state) {
+        recovered.store(0);
+        s_helper.change_start_cb([&]() {
+            start_time = Clock::now();
+            logstore_service().open_logdev(logdev_id);
+            logstore_service()
+                .open_log_store(logdev_id, store_id, true /* append_mode */)
+                .thenValue([&recovered](auto store) {
+                    store->register_log_found_cb([&recovered](logstore_seq_num_t, log_buffer, void*) {
+                        recovered.fetch_add(1, std::memory_order_relaxed);
+                    });
+                });
+        });
+        s_helper.restart_homestore(0 /* shutdown_delay_sec */);
+        recovery_us = get_elapsed_time_us(start_time);
+        state.SetIterationTime(double(recovery_us) / 1000000);
+    }
+    s_helper.change_start_cb(nullptr);
 
-        static unsigned char ch{0};
-        m_data.reserve(m_nentries);
+    state.counters["journal_mb"] = double(state.range(0));
+    state.counters["recovered_records"] = double(recovered.load());
+    state.counters["recovery_us"] = double(recovery_us);
+    state.SetBytesProcessed(int64_cast(state.iterations() * nentries * record_size));
+    logstore_service().destroy_log_dev(logdev_id);
+}
 
-        for (uint64_t i{0}; i < m_nentries; ++i) {
-            const auto sz{data_size(re)};
-            m_data.emplace_back(std::string(sz, ++ch));
-        }
+// Args: number of log stores on the logdev
+static void BM_Truncate(benchmark::State& state) {
+    static constexpr uint32_t records_per_store{200};
+    auto const num_stores = uint32_cast(state.range(0));
+    set_flush_mode(FLUSH_INLINE | FLUSH_TIMER);
+
+    auto const logdev_id = logstore_service().create_new_logdev();
+    std::vector< std::shared_ptr< HomeLogStore > > stores;
+    for (uint32_t i{0}; i < num_stores; ++i) {
+        stores.push_back(logstore_service().create_new_log_store(logdev_id, true /* append_mode */));
     }
+    std::string data(512, 't');
 
-private:
-    logdev_id_t m_logdev_id;
-    std::shared_ptr< HomeLogStore > m_log_store;
-    std::atomic< int32_t > m_outstanding{0};
-    std::atomic< int64_t > m_nth_entry{0};
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (auto& store : stores) {
+            for (uint32_t i{0}; i < records_per_store; ++i) {
+                store->append_async(sisl::io_blob(uintptr_cast(data.data()), uint32_cast(data.size()),
+                                                  false),
+                                    nullptr, nullptr);
+            }
+            store->flush();
+        }
+        state.ResumeTiming();
 
-    const uint64_t m_nentries{SISL_OPTIONS["num_entries"].as< uint64_t >()};
-    const uint32_t m_q_depth{SISL_OPTIONS["qdepth"].as< uint32_t >()};
-    const uint32_t m_max_data_size{SISL_OPTIONS["max_record_size"].as< uint32_t >()};
+        for (auto& store : stores) {
+            store->truncate(store->get_contiguous_completed_seq_num(-1));
+        }
+        logstore_service().device_truncate();
+    }
+    state.counters["num_logstores"] = double(num_stores);
+    state.SetItemsProcessed(int64_cast(state.iterations() * num_stores));
+    logstore_service().destroy_log_dev(logdev_id);
+}
 
-    std::mutex m_pending_mtx;
-    std::condition_variable m_pending_cv;
-    bool m_done{false};
-    uint32_t m_iteration{1};
+// Args: record size
+static void BM_ReadSync(benchmark::State& state) {
+    static constexpr uint64_t num_records{10000};
+    auto const record_size = uint32_cast(state.range(0));
+    set_flush_mode(FLUSH_INLINE | FLUSH_TIMER);
 
-    std::vector< std::string > m_data;
-    logstore_id_t m_store_id;
-};
+    auto const logdev_id = logstore_service().create_new_logdev();
+    auto log_store = logstore_service().create_new_log_store(logdev_id, true /* append_mode */);
+    std::string data(record_size, 's');
+    for (uint64_t i{0}; i < num_records; ++i) {
+        log_store->append_async(sisl::io_blob(uintptr_cast(data.data()), record_size, false), nullptr,
+                                nullptr);
+    }
+    log_store->flush();
 
-static void test_append(benchmark::State& state) {
-    auto bls = std::make_unique< BenchLogStore >();
-    for (auto _ : state) { // Loops upto iteration count
-        bls->kickstart_io();
-        bls->wait_for_appends();
+    std::default_random_engine re{test_common::bench_seed(SISL_OPTIONS["seed"].as< uint64_t >())};
+    std::uniform_int_distribution< logstore_seq_num_t > gen_lsn{0, int64_cast(num_records) - 1};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(log_store->read_sync(gen_lsn(re)));
     }
+    state.SetItemsProcessed(int64_cast(state.iterations()));
+    state.SetBytesProcessed(int64_cast(state.iterations() * record_size));
+    logstore_service().destroy_log_dev(logdev_id);
 }
 
+BENCHMARK(BM_Append)
+    ->ArgNames({"record_size", "qdepth"})
+    ->ArgsProduct({{64, 512, 4096, 16384}, {1, 8, 32, 128}})
+    ->Iterations(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_FlushMode)
+    ->ArgName("flush_mode")
+    ->Arg(FLUSH_INLINE)
+    ->Arg(FLUSH_TIMER)
+    ->Arg(FLUSH_INLINE | FLUSH_TIMER)
+    ->Arg(FLUSH_EXPLICIT)
+    ->Iterations(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Recovery)
+    ->ArgName("journal_mb")
+    ->Arg(16)
+    ->Arg(64)
+    ->Arg(256)
+    ->Iterations(1)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Truncate)
+    ->ArgName("num_logstores")
+    ->Arg(1)
+    ->Arg(16)
+    ->Arg(128)
+    ->Iterations(10)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ReadSync)->ArgName("record_size")->Arg(64)->Arg(4096)->Arg(16384)->UseRealTime();
+
 static void setup() {
     s_helper.start_homestore("test_log_store_bench",
                              {{HS_SERVICE::META, {.size_pct = 5.0}}, {HS_SERVICE::LOG, {.size_pct = 87.0}}});
@@ -174,16 +350,28 @@ static void setup() {
 
 static void teardown() { s_helper.shutdown_homestore(); }
 
-// BENCHMARK(test_append)->Iterations(10)->Threads(SISL_OPTIONS["num_threads"].as< uint32_t >());
-BENCHMARK(test_append)->Iterations(1);
-
 int main(int argc, char** argv) {
     SISL_OPTIONS_LOAD(argc, argv, logging, log_store_benchmark, iomgr, test_common_setup)
     sisl::logging::SetLogger("log_store_benchmark");
     spdlog::set_pattern("[%D %T%z] [%^%l%$] [%n] [%t] %v");
 
+    // Json output goes to the file, in addition to the report on the console
+    std::vector< char* > bm_argv{argv, argv + argc};
+    auto const json_out = SISL_OPTIONS["json_out"].as< std::string >();
+    std::string out_arg{"--benchmark_out=" + json_out};
+    std::string format_arg{"--benchmark_out_format=json"};
+    if (!json_out.empty()) {
+        bm_argv.push_back(out_arg.data());
+        bm_argv.push_back(format_arg.data());
+    }
+    int bm_argc = int_cast(bm_argv.size());
+
     setup();
-    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::Initialize(&bm_argc, bm_argv.data());
+    ::benchmark::AddCustomContext("commit", SISL_OPTIONS["commit"].as< std::string >());
+    ::benchmark::AddCustomContext("seed", std::to_string(SISL_OPTIONS["seed"].as< uint64_t >()));
+    ::benchmark::AddCustomContext("max_inflight_log_groups",
+                                  std::to_string(HS_DYNAMIC_CONFIG(logstore.max_inflight_log_groups)));
     ::benchmark::RunSpecifiedBenchmarks();
     LOGINFO("Metrics: {}", sisl::MetricsFarm::getInstance().get_result_in_json()["LogStores"].dump(4));
     teardown();
@@ -0,0 +1,238 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <iomgr/io_environment.hpp>
+#include <sisl/logging/logging.h>
+#include <sisl/options/options.h>
+#include <homestore/homestore.hpp>
+#include <homestore/homestore_decl.hpp>
+#include <homestore/meta_service.hpp>
+#include "common/homestore_config.hpp"
+#include "test_common/homestore_test_common.hpp"
+
+/*
+ * Benchmark matrix of the meta service:
+ *  - ops: latency percentiles and throughput of add_sub_sb, update_sub_sb and remove_sub_sb, by sub sb size from 512B
+ *         to 64MB, with and without compression
+ *  - recovery: time taken by the restart to scan the meta blks and call back their subsystem, by the number of meta
+ *              blks
+ *
+ * Results are emitted as json of google benchmark, into the file given by --json_out, with latencies and the used size
+ * of the meta vdev as user counters of each run, so that they can be used to size the meta vdev and compared across
+ * commits.
+ */
+using namespace homestore;
+SISL_LOGGING_INIT(HOMESTORE_LOG_MODS)
+
+SISL_OPTIONS_ENABLE(logging, meta_blk_benchmark, iomgr, test_common_setup)
+SISL_OPTION_GROUP(meta_blk_benchmark,
+                  (num_ops, "", "num_ops", "max number of sub sbs added, updated and removed by each run",
+                   ::cxxopts::value< uint64_t >()->default_value("1000"), "number"),
+                  (max_run_mb, "", "max_run_mb", "max size of the sub sbs added by each run, fewer ops for large sbs",
+                   ::cxxopts::value< uint64_t >()->default_value("512"), "number"),
+                  (json_out, "", "json_out", "file to write the results as json, none if empty",
+                   ::cxxopts::value< std::string >()->default_value("meta_blk_benchmark.json"), "path"),
+                  (seed, "", "seed", "seed of the random engines, for the runs to be comparable. Random if 0",
+                   ::cxxopts::value< uint64_t >()->default_value("0"), "number"),
+                  (commit, "", "commit", "commit id recorded in the context of the results",
+                   ::cxxopts::value< std::string >()->default_value(""), "string"));
+
+static test_common::HSTestHelper s_helper;
+static const meta_sub_type s_bench_type{"MetaBlkBench"};
+
+static void set_compression(bool on) {
+    HS_SETTINGS_FACTORY().modifiable_settings([on](auto& s) { s.metablk.compress_feature_on = on; });
+    HS_SETTINGS_FACTORY().save();
+}
+
+static void register_bench_handler(std::function< void(bool) > comp_cb = nullptr) {
+    meta_service().deregister_handler(s_bench_type);
+    meta_service().register_handler(
+        s_bench_type, [](meta_blk*, sisl::byte_view, size_t) {},
+        [comp_cb = std::move(comp_cb)](bool success) {
+            if (comp_cb) { comp_cb(success); }
+        });
+}
+
+static void report_latencies(benchmark::State& state, const std::string& op, std::vector< uint64_t >& lat_us) {
+    if (lat_us.empty()) { return; }
+    std::sort(lat_us.begin(), lat_us.end());
+    auto const pct = [&lat_us](double p) {
+        return double(lat_us[std::min(size_t(p * lat_us.size()), lat_us.size() - 1)]);
+    };
+    state.counters[op + "_p50_us"] = pct(0.50);
+    state.counters[op + "_p99_us"] = pct(0.99);
+    state.counters[op + "_max_us"] = double(lat_us.back());
+}
+
+// Half of the buffer is random and the other half repeats it, so that compression has something to save
+static std::vector< uint8_t > gen_buf(uint64_t size) {
+    std::vector< uint8_t > buf(size);
+    std::default_random_engine re{test_common::bench_seed(SISL_OPTIONS["seed"].as< uint64_t >(), size)};
+    std::uniform_int_distribution< uint32_t > gen_byte{0, 255};
+    auto const half = std::max(size / 2, uint64_cast(1));
+    for (uint64_t i{0}; i < half; ++i) {
+        buf[i] = static_cast< uint8_t >(gen_byte(re));
+    }
+    for (uint64_t i{half}; i < size; ++i) {
+        buf[i] = buf[i - half];
+    }
+    return buf;
+}
+
+// Args: sub sb size, compression on or off
+static void BM_Ops(benchmark::State& state) {
+    auto const size = uint64_cast(state.range(0));
+    set_compression(state.range(1) != 0);
+    register_bench_handler();
+
+    auto const nops = std::clamp(SISL_OPTIONS["max_run_mb"].as< uint64_t >() * 1024 * 1024 / size, uint64_cast(1),
+                                 SISL_OPTIONS["num_ops"].as< uint64_t >());
+    auto const buf = gen_buf(size);
+    auto const used_before = meta_service().used_size();
+
+    std::vector< uint64_t > add_us, update_us, remove_us;
+    std::vector< void* > cookies(nops, nullptr);
+    uint64_t used_size{0};
+    for (auto _ : state) {
+        add_us.clear();
+        update_us.clear();
+        remove_us.clear();
+        for (auto& cookie : cookies) {
+            auto const start = Clock::now();
+            meta_service().add_sub_sb(s_bench_type, buf.data(), size, cookie);
+            add_us.push_back(get_elapsed_time_us(start));
+        }
+        used_size = meta_service().used_size() - used_before;
+
+        for (auto* cookie : cookies) {
+            auto const start = Clock::now();
+            meta_service().update_sub_sb(buf.data(), size, cookie);
+            update_us.push_back(get_elapsed_time_us(start));
+        }
+
+        for (auto* cookie : cookies) {
+            auto const start = Clock::now();
+            meta_service().remove_sub_sb(cookie);
+            remove_us.push_back(get_elapsed_time_us(start));
+        }
+    }
+
+    state.SetItemsProcessed(int64_cast(state.iterations() * nops * 3));
+    state.SetBytesProcessed(int64_cast(state.iterations() * nops * size * 2));
+    state.counters["num_ops"] = double(nops);
+    state.counters["used_bytes_per_sb"] = double(used_size) / nops;
+    report_latencies(state, "add", add_us);
+    report_latencies(state, "update", update_us);
+    report_latencies(state, "remove", remove_us);
+    set_compression(true);
+}
+
+// Args: number of meta blks
+static void BM_Recovery(benchmark::State& state) {
+    static constexpr uint64_t sb_size{512};
+    auto const nblks = uint64_cast(state.range(0));
+    register_bench_handler();
+
+    auto const buf = gen_buf(sb_size);
+    std::vector< void* > cookies(nblks, nullptr);
+    for (auto& cookie : cookies) {
+        meta_service().add_sub_sb(s_bench_type, buf.data(), sb_size, cookie);
+    }
+
+    // Timed from the registration of the handler on start, which is before the meta blks are scanned, till the
+    // completion callback of the recovery
+    std::atomic< uint64_t > recovery_us{0};
+    for (auto _ : state) {
+        Clock::time_point start_time;
+        s_helper.change_start_cb([&]() {
+            start_time = Clock::now();
+            register_bench_handler([&](bool) { recovery_us.store(get_elapsed_time_us(start_time)); });
+        });
+        s_helper.restart_homestore(0 /* shutdown_delay_sec */);
+        state.SetIterationTime(double(recovery_us.load()) / 1000000);
+    }
+    s_helper.change_start_cb(nullptr);
+    state.counters["num_meta_blks"] = double(nblks);
+    state.counters["recovery_us"] = double(recovery_us.load());
+    state.counters["used_bytes"] = double(meta_service().used_size());
+
+    // meta blks are reloaded by the restart, so the cookies of the ones added above are gone
+    std::vector< void* > recovered;
+    meta_service().deregister_handler(s_bench_type);
+    meta_service().register_handler(
+        s_bench_type, [&recovered](meta_blk* mblk, sisl::byte_view, size_t) { recovered.push_back(mblk); }, nullptr);
+    meta_service().read_sub_sb(s_bench_type);
+    for (auto* cookie : recovered) {
+        meta_service().remove_sub_sb(cookie);
+    }
+}
+
+BENCHMARK(BM_Ops)
+    ->ArgNames({"sb_size", "compress"})
+    ->ArgsProduct({{512, 4096, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024, 64 * 1024 * 1024}, {0, 1}})
+    ->Iterations(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_Recovery)
+    ->ArgName("num_meta_blks")
+    ->Arg(100)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Iterations(1)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+static void setup() { s_helper.start_homestore("test_meta_blk_bench", {{HS_SERVICE::META, {.size_pct = 85.0}}}); }
+
+static void teardown() { s_helper.shutdown_homestore(); }
+
+int main(int argc, char** argv) {
+    SISL_OPTIONS_LOAD(argc, argv, logging, meta_blk_benchmark, iomgr, test_common_setup)
+    sisl::logging::SetLogger("meta_blk_benchmark");
+    spdlog::set_pattern("[%D %T%z] [%^%l%$] [%n] [%t] %v");
+
+    // Json output goes to the file, in addition to the report on the console
+    std::vector< char* > bm_argv{argv, argv + argc};
+    auto const json_out = SISL_OPTIONS["json_out"].as< std::string >();
+    std::string out_arg{"--benchmark_out=" + json_out};
+    std::string format_arg{"--benchmark_out_format=json"};
+    if (!json_out.empty()) {
+        bm_argv.push_back(out_arg.data());
+        bm_argv.push_back(format_arg.data());
+    }
+    int bm_argc = int_cast(bm_argv.size());
+
+    setup();
+    ::benchmark::Initialize(&bm_argc, bm_argv.data());
+    ::benchmark::AddCustomContext("commit", SISL_OPTIONS["commit"].as< std::string >());
+    ::benchmark::AddCustomContext("seed", std::to_string(SISL_OPTIONS["seed"].as< uint64_t >()));
+    ::benchmark::AddCustomContext("min_compress_size_mb",
+                                  std::to_string(HS_DYNAMIC_CONFIG(metablk.min_compress_size_mb)));
+    ::benchmark::RunSpecifiedBenchmarks();
+    LOGINFO("Metrics: {}", sisl::MetricsFarm::getInstance().get_result_in_json()["MetaService"].dump(4));
+    teardown();
+}
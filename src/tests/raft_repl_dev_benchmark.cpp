@@ -0,0 +1,493 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include <iomgr/io_environment.hpp>
+#include <sisl/logging/logging.h>
+#include <sisl/options/options.h>
+#include <homestore/homestore.hpp>
+#include <homestore/homestore_decl.hpp>
+#include <homestore/blkdata_service.hpp>
+#include <homestore/replication_service.hpp>
+#include <homestore/replication/repl_dev.h>
+#include "common/homestore_config.hpp"
+#include "test_common/hs_repl_test_common.hpp"
+#include "replication/repl_dev/raft_repl_dev.h"
+
+/*
+ * Benchmark of the replicated writes of RaftReplDev, with the replicas as processes talking over loopback:
+ *  - write: leader keeps qdepth writes of io_size_kb outstanding on each of num_groups groups for run_time_secs, and
+ *    reports the IOPS, bandwidth and percentiles of the latency from the write till its commit on the leader
+ *  - resync: with resync_entries, the last replica is down while that many entries are written on each group, and
+ *    the time it takes to catch up after it is up is reported. With resync_by_snapshot, the leader snapshots and
+ *    truncates its log before that, so that the catch up is by the snapshot transfer instead of the log
+ *
+ * Results are reported by the replica which measures them, and written as json into the file given by --json_out.
+ */
+using namespace homestore;
+SISL_LOGGING_INIT(HOMESTORE_LOG_MODS, nuraft_mesg)
+
+SISL_OPTION_GROUP(raft_repl_dev_benchmark,
+                  (io_size_kb, "", "io_size_kb", "size of each write",
+                   ::cxxopts::value< uint32_t >()->default_value("4"), "number"),
+                  (qdepth, "", "qdepth", "writes outstanding on each group",
+                   ::cxxopts::value< uint32_t >()->default_value("32"), "number"),
+                  (num_groups, "", "num_groups", "number of raft groups",
+                   ::cxxopts::value< uint32_t >()->default_value("1"), "number"),
+                  (run_time_secs, "", "run_time_secs", "duration of the write phase",
+                   ::cxxopts::value< uint32_t >()->default_value("30"), "seconds"),
+                  (resync_entries, "", "resync_entries",
+                   "entries written on each group while a follower is down, to measure its resync. 0 skips it",
+                   ::cxxopts::value< uint32_t >()->default_value("0"), "number"),
+                  (resync_by_snapshot, "", "resync_by_snapshot",
+                   "leader truncates its log before the follower is up, for it to resync by the snapshot",
+                   ::cxxopts::value< bool >()->default_value("false"), "true or false"),
+                  (json_out, "", "json_out", "file to write the results as json, none if empty",
+                   ::cxxopts::value< std::string >()->default_value("raft_repl_dev_benchmark.json"), "path"));
+
+SISL_OPTIONS_ENABLE(logging, raft_repl_dev_benchmark, iomgr, config, test_common_setup, test_repl_common_setup)
+
+static std::unique_ptr< test_common::HSReplTestHelper > g_helper;
+
+/*
+ * Listener which only keeps the lsn and size of the committed entries, enough to transfer them in a snapshot. On the
+ * leader, it drives the writes of its group, keeping qdepth of them outstanding.
+ */
+class BenchReplicatedDB : public ReplDevListener {
+public:
+    struct bench_req : public repl_req_ctx {
+        uint64_t data_size{0};
+        Clock::time_point submit_time;
+
+        sisl::blob header_blob() { return sisl::blob{uintptr_cast(&data_size), sizeof(uint64_t)}; }
+    };
+
+    struct snapshot_entry {
+        int64_t lsn;
+        uint64_t data_size;
+    };
+
+    BenchReplicatedDB() = default;
+    ~BenchReplicatedDB() override {
+        if (m_buf) { iomanager.iobuf_free(m_buf); }
+    }
+
+    void on_commit(int64_t lsn, sisl::blob const& header, sisl::blob const& key, MultiBlkId const& blkids,
+                   cintrusive< repl_req_ctx >& ctx) override {
+        auto const data_size = *(r_cast< uint64_t const* >(header.cbytes()));
+        {
+            std::unique_lock lk{m_db_mtx};
+            m_entries.emplace(lsn, data_size);
+            m_last_committed_lsn = std::max(m_last_committed_lsn, lsn); // Commits could be in parallel
+        }
+        m_committed_entries.fetch_add(1);
+        m_committed_bytes.fetch_add(data_size);
+
+        if (ctx->is_proposer()) {
+            auto const lat_us = get_elapsed_time_us(static_cast< bench_req const* >(ctx.get())->submit_time);
+            {
+                std::unique_lock lk{m_lat_mtx};
+                m_lat_us.push_back(lat_us);
+            }
+            on_write_done();
+        }
+    }
+
+    bool on_pre_commit(int64_t lsn, sisl::blob const& header, sisl::blob const& key,
+                       cintrusive< repl_req_ctx >& ctx) override {
+        return true;
+    }
+
+    void on_rollback(int64_t lsn, sisl::blob const& header, sisl::blob const& key,
+                     cintrusive< repl_req_ctx >& ctx) override {}
+
+    void on_restart() override {}
+
+    void on_error(ReplServiceError error, sisl::blob const& header, sisl::blob const& key,
+                  cintrusive< repl_req_ctx >& ctx) override {
+        LOGWARN("Write on group={} failed with error={}", boost::uuids::to_string(repl_dev()->group_id()),
+                enum_name(error));
+        m_write_errors.fetch_add(1);
+        if (ctx && ctx->is_proposer()) { on_write_done(); }
+    }
+
+    AsyncReplResult<> create_snapshot(shared< snapshot_context > context) override {
+        std::lock_guard lk{m_snapshot_mtx};
+        m_last_snapshot = context;
+        return make_async_success<>();
+    }
+
+    int read_snapshot_data(shared< snapshot_context > context, shared< snapshot_data > snp_data) override {
+        if (snp_data->offset == 0) {
+            snp_data->is_last_obj = false;
+            snp_data->blob = sisl::io_blob_safe(sizeof(ulong));
+            return 0;
+        }
+
+        std::vector< snapshot_entry > entries;
+        {
+            std::shared_lock lk{m_db_mtx};
+            for (auto it = m_entries.lower_bound(snp_data->offset); it != m_entries.end(); ++it) {
+                entries.push_back(snapshot_entry{.lsn = it->first, .data_size = it->second});
+                if (entries.size() >= 1000) { break; }
+            }
+        }
+
+        if (entries.empty()) {
+            snp_data->is_last_obj = true;
+            return 0;
+        }
+
+        auto const size = entries.size() * sizeof(snapshot_entry);
+        snp_data->blob = sisl::io_blob_safe{uint32_cast(size)};
+        std::memcpy(snp_data->blob.bytes(), entries.data(), size);
+        snp_data->is_last_obj = false;
+        snp_data->next_offset = entries.back().lsn + 1;
+        return 0;
+    }
+
+    void write_snapshot_data(shared< snapshot_context > context, shared< snapshot_data > snp_data) override {
+        if (snp_data->offset == 0) {
+            std::shared_lock lk{m_db_mtx};
+            snp_data->offset = m_last_committed_lsn + 1;
+            return;
+        }
+
+        // Data of each entry is written as the follower would have received it, which is what the transfer costs
+        auto const* entry = r_cast< snapshot_entry const* >(snp_data->blob.cbytes());
+        auto const nentries = snp_data->blob.size() / sizeof(snapshot_entry);
+        for (size_t i{0}; i < nentries; ++i, ++entry) {
+            if (entry->data_size != 0) {
+                auto sgs = test_common::HSTestHelper::create_sgs(entry->data_size, entry->data_size);
+                MultiBlkId blkid;
+                data_service().async_alloc_write(sgs, blk_alloc_hints{}, blkid).get();
+                for (auto const& iov : sgs.iovs) {
+                    iomanager.iobuf_free(uintptr_cast(iov.iov_base));
+                }
+            }
+
+            std::unique_lock lk{m_db_mtx};
+            m_entries.emplace(entry->lsn, entry->data_size);
+            m_last_committed_lsn = entry->lsn;
+            m_committed_entries.fetch_add(1);
+            m_committed_bytes.fetch_add(entry->data_size);
+        }
+
+        std::shared_lock lk{m_db_mtx};
+        snp_data->offset = m_last_committed_lsn + 1;
+    }
+
+    bool apply_snapshot(shared< snapshot_context > context) override {
+        std::lock_guard lk{m_snapshot_mtx};
+        m_last_snapshot = context;
+        return true;
+    }
+
+    shared< snapshot_context > last_snapshot() override {
+        std::lock_guard lk{m_snapshot_mtx};
+        return m_last_snapshot;
+    }
+
+    void free_user_snp_ctx(void*& user_snp_ctx) override {}
+
+    ReplResult< blk_alloc_hints > get_blk_alloc_hints(sisl::blob const& header, uint32_t data_size) override {
+        return blk_alloc_hints{};
+    }
+
+    void replace_member(replica_id_t member_out, replica_id_t member_in) override {}
+
+    void on_destroy() override { g_helper->unregister_listener(repl_dev()->group_id()); }
+
+    // Writes upto max_entries, or till the end_time, with qdepth of them outstanding. Returns once all are completed.
+    void run_writes(uint32_t qdepth, Clock::time_point end_time, uint64_t max_entries) {
+        auto const io_size = uint64_cast(SISL_OPTIONS["io_size_kb"].as< uint32_t >()) * 1024;
+        if (m_buf == nullptr) {
+            // All writes share the same data, which only the followers and the device see
+            m_buf = iomanager.iobuf_alloc(data_service().get_align_size(), io_size);
+            std::memset(m_buf, 0xab, io_size);
+        }
+        m_io_size = io_size;
+        m_end_time = end_time;
+        m_max_entries = max_entries;
+        m_issued.store(0);
+        m_outstanding.store(0);
+
+        for (uint32_t i{0}; i < qdepth; ++i) {
+            iomanager.run_on_forget(iomgr::reactor_regex::random_worker, [this]() { issue(); });
+        }
+        while ((m_outstanding.load() != 0) || !is_write_phase_over()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        }
+    }
+
+    std::vector< uint64_t > take_latencies() {
+        std::unique_lock lk{m_lat_mtx};
+        return std::exchange(m_lat_us, {});
+    }
+
+    int64_t last_committed_lsn() const {
+        std::shared_lock lk{m_db_mtx};
+        return m_last_committed_lsn;
+    }
+    uint64_t committed_entries() const { return m_committed_entries.load(); }
+    uint64_t committed_bytes() const { return m_committed_bytes.load(); }
+    uint64_t write_errors() const { return m_write_errors.load(); }
+
+    void snapshot_and_truncate() {
+        auto rdev = std::dynamic_pointer_cast< RaftReplDev >(repl_dev());
+        rdev->raft_server()->create_snapshot();
+        rdev->truncate(0);
+    }
+
+private:
+    bool is_write_phase_over() const {
+        return (m_issued.load() >= m_max_entries) || (Clock::now() >= m_end_time);
+    }
+
+    void issue() {
+        if (m_issued.fetch_add(1) >= m_max_entries || (Clock::now() >= m_end_time)) { return; }
+        m_outstanding.fetch_add(1);
+
+        auto req = intrusive< bench_req >(new bench_req());
+        req->data_size = m_io_size;
+        req->submit_time = Clock::now();
+        sisl::sg_list sgs;
+        sgs.size = m_io_size;
+        sgs.iovs.emplace_back(iovec{.iov_base = m_buf, .iov_len = m_io_size});
+        repl_dev()->async_alloc_write(req->header_blob(), sisl::blob{}, sgs, req);
+    }
+
+    void on_write_done() {
+        m_outstanding.fetch_sub(1);
+        iomanager.run_on_forget(iomgr::reactor_regex::random_worker, [this]() { issue(); });
+    }
+
+private:
+    mutable std::shared_mutex m_db_mtx;
+    std::map< int64_t, uint64_t > m_entries; // lsn -> data size of the committed entries
+    int64_t m_last_committed_lsn{0};
+    std::atomic< uint64_t > m_committed_entries{0};
+    std::atomic< uint64_t > m_committed_bytes{0};
+    std::atomic< uint64_t > m_write_errors{0};
+
+    std::mutex m_snapshot_mtx;
+    shared< snapshot_context > m_last_snapshot;
+
+    uint8_t* m_buf{nullptr};
+    uint64_t m_io_size{0};
+    Clock::time_point m_end_time;
+    uint64_t m_max_entries{0};
+    std::atomic< uint64_t > m_issued{0};
+    std::atomic< uint64_t > m_outstanding{0};
+
+    std::mutex m_lat_mtx;
+    std::vector< uint64_t > m_lat_us;
+};
+
+static std::vector< std::shared_ptr< BenchReplicatedDB > > s_dbs;
+
+static nlohmann::json latency_percentiles(std::vector< uint64_t >& lat_us) {
+    nlohmann::json j;
+    if (lat_us.empty()) { return j; }
+    std::sort(lat_us.begin(), lat_us.end());
+    auto const pct = [&lat_us](double p) { return lat_us[std::min(size_t(p * lat_us.size()), lat_us.size() - 1)]; };
+    j["p50_us"] = pct(0.50);
+    j["p90_us"] = pct(0.90);
+    j["p99_us"] = pct(0.99);
+    j["p999_us"] = pct(0.999);
+    j["max_us"] = lat_us.back();
+    return j;
+}
+
+static void make_leader(uint16_t replica) {
+    for (auto const& db : s_dbs) {
+        if (g_helper->replica_num() == replica) {
+            while (db->repl_dev()->become_leader().get().hasError()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds{500});
+            }
+        } else {
+            while (g_helper->member_id(db->repl_dev()->get_leader_id()) != replica) {
+                std::this_thread::sleep_for(std::chrono::milliseconds{500});
+            }
+        }
+    }
+}
+
+// Runs the writes on all the groups at once, upto max_entries on each or till the run time is over
+static void write_on_all_groups(std::chrono::seconds run_time, uint64_t max_entries) {
+    auto const qdepth = SISL_OPTIONS["qdepth"].as< uint32_t >();
+    auto const end_time = Clock::now() + run_time;
+    std::vector< std::thread > writers;
+    for (auto const& db : s_dbs) {
+        writers.emplace_back([db, qdepth, end_time, max_entries]() { db->run_writes(qdepth, end_time, max_entries); });
+    }
+    for (auto& t : writers) {
+        t.join();
+    }
+}
+
+static nlohmann::json run_write_phase() {
+    nlohmann::json j;
+    g_helper->sync_for_test_start();
+    if (g_helper->replica_num() == 0) {
+        auto const start_time = Clock::now();
+        write_on_all_groups(std::chrono::seconds{SISL_OPTIONS["run_time_secs"].as< uint32_t >()},
+                            std::numeric_limits< uint64_t >::max());
+        auto const elapsed_us = get_elapsed_time_us(start_time);
+
+        uint64_t entries{0}, bytes{0}, errors{0};
+        std::vector< uint64_t > lat_us;
+        for (auto const& db : s_dbs) {
+            entries += db->committed_entries();
+            bytes += db->committed_bytes();
+            errors += db->write_errors();
+            auto l = db->take_latencies();
+            lat_us.insert(lat_us.end(), l.begin(), l.end());
+        }
+        j["entries"] = entries;
+        j["errors"] = errors;
+        j["iops"] = double(entries) * 1000000 / elapsed_us;
+        j["bandwidth_mbps"] = double(bytes) / elapsed_us; // Bytes per us is MB per second
+        j["commit_latency"] = latency_percentiles(lat_us);
+        LOGINFO("Write phase: {}", j.dump());
+    }
+    g_helper->sync_for_verify_start();
+    return j;
+}
+
+static nlohmann::json run_resync_phase() {
+    nlohmann::json j;
+    auto const lagging = uint16_cast(SISL_OPTIONS["replicas"].as< uint32_t >() - 1);
+    if (g_helper->replica_num() == lagging) {
+        g_helper->shutdown();
+    } else {
+        std::this_thread::sleep_for(std::chrono::seconds{5}); // Till it is down and out of the alive raft groups
+    }
+
+    g_helper->sync_for_test_start();
+    if (g_helper->replica_num() == 0) {
+        write_on_all_groups(std::chrono::hours{24}, SISL_OPTIONS["resync_entries"].as< uint32_t >());
+        int64_t target_lsns{0};
+        for (auto const& db : s_dbs) {
+            if (SISL_OPTIONS["resync_by_snapshot"].as< bool >()) { db->snapshot_and_truncate(); }
+            target_lsns += db->last_committed_lsn();
+        }
+        g_helper->sync_dataset_size(uint64_cast(target_lsns));
+    }
+    g_helper->sync_for_verify_start();
+
+    if (g_helper->replica_num() == lagging) {
+        auto const start_time = Clock::now();
+        g_helper->start();
+
+        uint64_t entries_before{0}, bytes_before{0};
+        for (auto const& db : s_dbs) {
+            entries_before += db->committed_entries();
+            bytes_before += db->committed_bytes();
+        }
+
+        auto const target_lsns = int64_cast(g_helper->dataset_size());
+        while (true) {
+            int64_t lsns{0};
+            for (auto const& db : s_dbs) {
+                lsns += db->last_committed_lsn();
+            }
+            if (lsns >= target_lsns) { break; }
+            std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        }
+        auto const elapsed_us = get_elapsed_time_us(start_time);
+
+        uint64_t entries{0}, bytes{0};
+        for (auto const& db : s_dbs) {
+            entries += db->committed_entries();
+            bytes += db->committed_bytes();
+        }
+        entries -= entries_before;
+        bytes -= bytes_before;
+        j["by_snapshot"] = SISL_OPTIONS["resync_by_snapshot"].as< bool >();
+        j["entries"] = entries;
+        j["time_ms"] = elapsed_us / 1000;
+        j["entries_per_sec"] = double(entries) * 1000000 / elapsed_us;
+        j["bandwidth_mbps"] = double(bytes) / elapsed_us;
+        LOGINFO("Resync phase: {}", j.dump());
+    }
+    g_helper->sync_for_cleanup_start();
+    return j;
+}
+
+int main(int argc, char* argv[]) {
+    int parsed_argc = argc;
+    char** orig_argv = argv;
+
+    // Save the args for replica use
+    std::vector< std::string > args;
+    for (int i = 0; i < argc; ++i) {
+        args.emplace_back(argv[i]);
+    }
+
+    SISL_OPTIONS_LOAD(parsed_argc, argv, logging, config, raft_repl_dev_benchmark, iomgr, test_common_setup,
+                      test_repl_common_setup);
+
+    // Leader stays as it is assigned, so that the writes are driven from the same replica throughout
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.consensus.leadership_expiry_ms = -1;
+        s.generic.repl_dev_cleanup_interval_sec = 1;
+    });
+    HS_SETTINGS_FACTORY().save();
+
+    FLAGS_folly_global_cpu_executor_threads = 4;
+    g_helper = std::make_unique< test_common::HSReplTestHelper >("raft_repl_dev_benchmark", args, orig_argv);
+    g_helper->setup(SISL_OPTIONS["replicas"].as< uint32_t >());
+
+    for (uint32_t i{0}; i < SISL_OPTIONS["num_groups"].as< uint32_t >(); ++i) {
+        auto db = std::make_shared< BenchReplicatedDB >();
+        g_helper->register_listener(db);
+        s_dbs.emplace_back(std::move(db));
+    }
+    make_leader(0);
+
+    nlohmann::json results;
+    results["io_size_kb"] = SISL_OPTIONS["io_size_kb"].as< uint32_t >();
+    results["qdepth"] = SISL_OPTIONS["qdepth"].as< uint32_t >();
+    results["num_groups"] = SISL_OPTIONS["num_groups"].as< uint32_t >();
+    results["write"] = run_write_phase();
+    if (SISL_OPTIONS["resync_entries"].as< uint32_t >() != 0) { results["resync"] = run_resync_phase(); }
+
+    // Each of the results is measured on one replica, which writes them out
+    auto const json_out = SISL_OPTIONS["json_out"].as< std::string >();
+    if (!json_out.empty() && ((g_helper->replica_num() == 0) || results.contains("resync"))) {
+        std::ofstream out{fmt::format("{}.replica{}", json_out, g_helper->replica_num())};
+        out << results.dump(4) << std::endl;
+    }
+
+    s_dbs.clear();
+    g_helper->teardown();
+    return 0;
+}
@@ -19,23 +19,31 @@
 #include <cstdint>
 #include <functional>
 #include <iostream>
+#include <cstring>
 #include <limits>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <random>
 #include <thread>
 #include <vector>
 
+#include <boost/uuid/random_generator.hpp>
 #include <gtest/gtest.h>
 #include <sisl/logging/logging.h>
 #include <sisl/options/options.h>
 #include <iomgr/iomgr_flip.hpp>
 #include <iomgr/io_environment.hpp>
 #include "blkalloc/append_blk_allocator.h"
+#include "device/chunk.h"
+#include "device/device.h"
 #include "common/homestore_assert.hpp"
 #include "common/homestore_config.hpp"
 #include "test_common/homestore_test_common.hpp"
+#include "btree_helpers/btree_test_kvs.hpp"
 #include <homestore/blkdata_service.hpp>
+#include <homestore/index_service.hpp>
+#include <homestore/index/index_value_log.hpp>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //                                                                                                //
@@ -183,6 +191,48 @@ private:
     }
 
 protected:
+    AppendBlkAllocator* allocator_of(chunk_num_t chunk_num) {
+        return static_cast< AppendBlkAllocator* >(
+            hs()->device_mgr()->get_chunk_mutable(chunk_num)->blk_allocator_mutable());
+    }
+
+    // Write and commit the blks one by one on the same chunk
+    std::vector< BlkId > commit_blks(uint32_t num_blks) {
+        auto const blk_size = inst().get_blk_size();
+        auto data_buf = iomanager.iobuf_alloc(512, blk_size);
+        std::vector< BlkId > blkids;
+        blk_alloc_hints hints;
+        for (auto i = 0u; i < num_blks; ++i) {
+            MultiBlkId mbid;
+            RELEASE_ASSERT_EQ(inst().alloc_blks(blk_size, hints, mbid), BlkAllocStatus::SUCCESS, "Alloc failed");
+            hints.chunk_id_hint = mbid.chunk_num();
+            test_common::HSTestHelper::fill_data_buf(data_buf, blk_size, i);
+            RELEASE_ASSERT(!inst().async_write(r_cast< const char* >(data_buf), blk_size, mbid).get(), "Write failed");
+            inst().commit_blk(mbid);
+            blkids.push_back(mbid.to_single_blkid());
+        }
+        iomanager.iobuf_free(data_buf);
+        return blkids;
+    }
+
+    // Superblk which an allocator of an older version persisted on its own, instead of the one of the vdev
+    void write_legacy_sb(chunk_num_t chunk_num, blk_num_t commit_offset, blk_num_t freeable_nblks) {
+        superblk< append_blk_sb_t > sb{"AppendBlkAlloc_chunk_" + std::to_string(chunk_num)};
+        sb.create(sizeof(append_blk_sb_t));
+        sb->allocator_id = chunk_num;
+        sb->commit_offset = commit_offset;
+        sb->freeable_nblks = freeable_nblks;
+        sb.write();
+    }
+
+    void validate_allocator(chunk_num_t chunk_num, blk_num_t commit_offset, blk_num_t freeable_nblks) {
+        auto ba = allocator_of(chunk_num);
+        ASSERT_EQ(ba->get_used_blks(), commit_offset) << ba->to_string();
+        ASSERT_EQ(ba->get_defrag_nblks(), freeable_nblks) << ba->to_string();
+        ASSERT_TRUE(ba->is_blk_alloced_on_disk(BlkId{commit_offset - 1, 1, chunk_num})) << ba->to_string();
+        ASSERT_FALSE(ba->is_blk_alloced_on_disk(BlkId{commit_offset, 1, chunk_num})) << ba->to_string();
+    }
+
     std::mutex m_mtx;
     std::condition_variable m_cv;
     bool m_io_job_done{false};
@@ -273,6 +323,236 @@ TEST_F(AppendBlkAllocatorTest, TestWriteThenRecovey) {
     LOGINFO("Step 9: do shutdown. ");
 }
 
+TEST_F(AppendBlkAllocatorTest, TestCompactChunk) {
+    auto const blk_size = inst().get_blk_size();
+    auto const num_blks = 10u;
+    auto data_buf = iomanager.iobuf_alloc(512, blk_size);
+    auto read_buf = iomanager.iobuf_alloc(512, blk_size);
+
+    LOGINFO("Step 1: write {} blks on the same chunk", num_blks);
+    std::vector< BlkId > blkids;
+    blk_alloc_hints hints;
+    for (auto i = 0u; i < num_blks; ++i) {
+        MultiBlkId mbid;
+        ASSERT_EQ(inst().alloc_blks(blk_size, hints, mbid), BlkAllocStatus::SUCCESS);
+        hints.chunk_id_hint = mbid.chunk_num();
+
+        test_common::HSTestHelper::fill_data_buf(data_buf, blk_size, i);
+        ASSERT_FALSE(inst().async_write(r_cast< const char* >(data_buf), blk_size, mbid).get());
+        inst().commit_blk(mbid);
+        blkids.push_back(mbid.to_single_blkid());
+    }
+
+    LOGINFO("Step 2: free all but every third blk, last blk included, and compact the chunk");
+    std::vector< BlkId > live_blks;
+    for (auto i = 0u; i < num_blks; ++i) {
+        if ((i % 3 == 0) || (i == num_blks - 1)) {
+            live_blks.push_back(blkids[i]);
+        } else {
+            ASSERT_FALSE(inst().async_free_blk(MultiBlkId{blkids[i]}).get());
+        }
+    }
+
+    std::map< uint32_t, MultiBlkId > relocated; // data pattern of a blk -> its new location
+    auto const reclaimed = inst().compact(
+        [&](chunk_num_t chunk_num) {
+            EXPECT_EQ(chunk_num, *hints.chunk_id_hint);
+            return live_blks;
+        },
+        [&](BlkId const& from, MultiBlkId const& to) {
+            EXPECT_NE(to.chunk_num(), from.chunk_num());
+            for (auto i = 0u; i < num_blks; ++i) {
+                if (blkids[i] == from) { relocated.emplace(i, to); }
+            }
+        });
+    ASSERT_EQ(reclaimed, num_blks - live_blks.size());
+    ASSERT_EQ(relocated.size(), live_blks.size());
+
+    LOGINFO("Step 3: verify data of relocated blks");
+    for (auto const& [pattern, to] : relocated) {
+        test_common::HSTestHelper::fill_data_buf(data_buf, blk_size, pattern);
+        ASSERT_FALSE(inst().async_read(to, read_buf, blk_size).get());
+        ASSERT_EQ(std::memcmp(data_buf, read_buf, blk_size), 0) << "Data mismatch after relocating blk " << pattern;
+    }
+
+    iomanager.iobuf_free(data_buf);
+    iomanager.iobuf_free(read_buf);
+}
+
+TEST_F(AppendBlkAllocatorTest, TestRecoverFromVdevSb) {
+    LOGINFO("Step 1: commit blks on a chunk, free one in the middle of them and persist them");
+    auto const blkids = commit_blks(10);
+    auto const chunk_num = blkids[0].chunk_num();
+    ASSERT_FALSE(inst().async_free_blk(MultiBlkId{blkids[4]}).get());
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+    validate_allocator(chunk_num, 10, 1);
+
+    LOGINFO("Step 2: restart, allocator is recovered from the vdev superblk");
+    m_helper.restart_homestore();
+    ASSERT_FALSE(allocator_of(chunk_num)->has_legacy_sb());
+    validate_allocator(chunk_num, 10, 1);
+
+    LOGINFO("Step 3: next blk of the chunk is appended after the recovered ones");
+    MultiBlkId mbid;
+    blk_alloc_hints hints;
+    hints.chunk_id_hint = chunk_num;
+    ASSERT_EQ(inst().alloc_blks(inst().get_blk_size(), hints, mbid), BlkAllocStatus::SUCCESS);
+    ASSERT_EQ(mbid.chunk_num(), chunk_num);
+    ASSERT_EQ(mbid.blk_num(), 10u);
+}
+
+TEST_F(AppendBlkAllocatorTest, TestMigrateLegacySb) {
+    LOGINFO("Step 1: pick a chunk and persist its allocator in the superblk of an older version");
+    MultiBlkId mbid;
+    ASSERT_EQ(inst().alloc_blks(inst().get_blk_size(), blk_alloc_hints{}, mbid), BlkAllocStatus::SUCCESS);
+    auto const chunk_num = mbid.chunk_num();
+    write_legacy_sb(chunk_num, 8, 3);
+
+    LOGINFO("Step 2: restart, allocator is recovered from the legacy superblk");
+    m_helper.restart_homestore();
+    ASSERT_TRUE(allocator_of(chunk_num)->has_legacy_sb());
+    validate_allocator(chunk_num, 8, 3);
+
+    LOGINFO("Step 3: cp migrates the allocator to the vdev superblk and removes the legacy one");
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+    ASSERT_FALSE(allocator_of(chunk_num)->has_legacy_sb());
+
+    LOGINFO("Step 4: restart, allocator is recovered from the vdev superblk");
+    m_helper.restart_homestore();
+    ASSERT_FALSE(allocator_of(chunk_num)->has_legacy_sb());
+    validate_allocator(chunk_num, 8, 3);
+}
+
+TEST_F(AppendBlkAllocatorTest, TestStaleLegacySb) {
+    LOGINFO("Step 1: commit blks on a chunk and persist them in the vdev superblk");
+    auto const blkids = commit_blks(10);
+    auto const chunk_num = blkids[0].chunk_num();
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+
+    LOGINFO("Step 2: leave an older legacy superblk behind, as a crash right after the vdev superblk write would");
+    write_legacy_sb(chunk_num, 4, 2);
+
+    LOGINFO("Step 3: restart, allocator is recovered from the vdev superblk and the legacy one is ignored");
+    m_helper.restart_homestore();
+    ASSERT_TRUE(allocator_of(chunk_num)->has_legacy_sb());
+    validate_allocator(chunk_num, 10, 0);
+
+    LOGINFO("Step 4: cp removes the legacy superblk, and the allocator stays as recovered across a restart");
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+    ASSERT_FALSE(allocator_of(chunk_num)->has_legacy_sb());
+    m_helper.restart_homestore();
+    ASSERT_FALSE(allocator_of(chunk_num)->has_legacy_sb());
+    validate_allocator(chunk_num, 10, 0);
+}
+
+using ValueLogTable = IndexTable< TestFixedKey, SeparatedValue >;
+
+class ValueLogTableCallbacks : public IndexServiceCallbacks {
+public:
+    ValueLogTableCallbacks(BtreeConfig const& cfg, shared< ValueLogTable >& table) : m_cfg{cfg}, m_table{table} {}
+    std::shared_ptr< IndexTableBase > on_index_table_found(superblk< index_table_sb >&& sb) override {
+        m_table = std::make_shared< ValueLogTable >(std::move(sb), m_cfg);
+        return m_table;
+    }
+
+private:
+    BtreeConfig const& m_cfg;
+    shared< ValueLogTable >& m_table;
+};
+
+TEST_F(AppendBlkAllocatorTest, TestIndexValueLog) {
+    LOGINFO("Step 0: Restart with an index service, for the table of the values in the value log");
+    shared< ValueLogTable > table;
+    BtreeConfig cfg{4096};
+    m_helper.shutdown_homestore();
+    m_helper.start_homestore(
+        "test_append_blkalloc",
+        {{HS_SERVICE::META, {.size_pct = 5.0}},
+         {HS_SERVICE::DATA,
+          {.size_pct = 70.0, .blkalloc_type = homestore::blk_allocator_type_t::append, .num_chunks = 64}},
+         {HS_SERVICE::INDEX, {.size_pct = 10.0, .index_svc_cbs = new ValueLogTableCallbacks(cfg, table)}}});
+
+    cfg = BtreeConfig{hs()->index_service().node_size()};
+    cfg.m_leaf_node_type = btree_node_type::VAR_VALUE;
+    cfg.m_int_node_type = btree_node_type::FIXED;
+    table = std::make_shared< ValueLogTable >(boost::uuids::random_generator()(), boost::uuids::random_generator()(),
+                                              0, cfg);
+    hs()->index_service().add_index_table(table);
+
+    auto const blk_size = inst().get_blk_size();
+    uint64_t const num_keys = 32;
+    IndexValueLog vlog{inst(), 512 /* threshold */};
+    std::map< uint64_t, std::string > expected;
+    std::mt19937 re{std::random_device{}()};
+
+    // Puts a value of the size for the key and returns the value it replaced, whose blks the caller frees
+    auto const put_value = [&](uint64_t k, uint32_t size) {
+        std::string bytes(size, '\0');
+        std::generate(bytes.begin(), bytes.end(), [&re]() { return static_cast< char >(re()); });
+        auto const v = vlog.make_value(sisl::blob{r_cast< const uint8_t* >(bytes.data()), size}).get();
+
+        TestFixedKey const key{k};
+        SeparatedValue prev;
+        auto req = BtreeSinglePutRequest{&key, &v, btree_put_type::UPSERT, &prev};
+        EXPECT_EQ(table->put(req), btree_status_t::success) << "Put of key " << k << " failed";
+        expected[k] = std::move(bytes);
+        return prev;
+    };
+    auto const validate = [&]() {
+        for (auto const& [k, bytes] : expected) {
+            TestFixedKey const key{k};
+            SeparatedValue v;
+            auto req = BtreeSingleGetRequest{&key, &v};
+            ASSERT_EQ(table->get(req), btree_status_t::success) << "Key " << k << " is missing";
+            ASSERT_EQ(v.is_pointer(), bytes.size() > vlog.threshold()) << "Value of key " << k << " is misplaced";
+            ASSERT_EQ(vlog.read_value(v).get(), bytes) << "Value of key " << k << " mismatch";
+        }
+    };
+
+    LOGINFO("Step 1: Put {} values, every other of which is large enough to be in the value log", num_keys);
+    for (uint64_t k{0}; k < num_keys; ++k) {
+        put_value(k, (k % 2 == 0) ? 100 : (2 * blk_size + 100));
+    }
+    validate();
+
+    LOGINFO("Step 2: Replace the large values and remove one of them, freeing their blks in the value log");
+    for (uint64_t k{1}; k < num_keys; k += 2) {
+        auto const prev = put_value(k, 2 * blk_size + 200);
+        ASSERT_TRUE(prev.is_pointer()) << "Replaced value of key " << k << " is inline";
+        ASSERT_FALSE(vlog.free_value(prev).get());
+    }
+    {
+        TestFixedKey const key{num_keys - 1};
+        SeparatedValue prev;
+        auto req = BtreeSingleRemoveRequest{&key, &prev};
+        ASSERT_EQ(table->remove(req), btree_status_t::success);
+        ASSERT_FALSE(vlog.free_value(prev).get());
+        expected.erase(num_keys - 1);
+    }
+    validate();
+
+    LOGINFO("Step 3: Compact the value log, which repoints the entries of the relocated values");
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.blkallocator.append_gc_min_freeable_pct = 10.0;
+        HS_SETTINGS_FACTORY().save();
+    });
+    auto const reclaimed =
+        vlog.compact(*table, BtreeKeyRange< TestFixedKey >{TestFixedKey{0}, true, TestFixedKey{num_keys}, true});
+    ASSERT_GT(reclaimed, 0u) << "Compaction didn't reclaim the blks of the freed values";
+    validate();
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.blkallocator.append_gc_min_freeable_pct = 50.0;
+        HS_SETTINGS_FACTORY().save();
+    });
+
+    LOGINFO("Step 4: Restart and validate the values through the pointers recovered with the table");
+    m_helper.params(HS_SERVICE::INDEX).index_svc_cbs = new ValueLogTableCallbacks(cfg, table);
+    m_helper.restart_homestore();
+    ASSERT_NE(table, nullptr) << "Table is not recovered";
+    validate();
+}
+
 SISL_OPTION_GROUP(test_append_blkalloc,
                   (run_time, "", "run_time", "running time in seconds",
                    ::cxxopts::value< uint64_t >()->default_value("30"), "number"));
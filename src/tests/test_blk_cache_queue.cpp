@@ -13,10 +13,13 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <chrono>
 #include <cmath>
 #include <cstdint>
+#include <limits>
 #include <memory>
 #include <random>
+#include <thread>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -27,6 +30,7 @@
 #include <homestore/homestore_decl.hpp>
 #include "blkalloc/varsize_blk_allocator.h"
 #include "blkalloc/blk_cache_queue.h"
+#include "common/homestore_config.hpp"
 
 SISL_LOGGING_INIT(HOMESTORE_LOG_MODS)
 
@@ -277,6 +281,51 @@ TEST_F(BlkCacheQueueTest, join_from_multiple_levels) {
     validate_alloc(1 /* count */, 0 /* slab */, last_blk_num_at_slab(0), 1);
 }
 
+TEST_F(BlkCacheQueueTest, refill_ahead_of_exhaustion) {
+    constexpr slab_idx_t num_slabs{2};
+    SetUp(num_slabs, 64);
+
+    LOGINFO("Step 1: Sample without any alloc, no slab should be predicted to run dry");
+    ASSERT_EQ(m_fb_cache->sample_ms_to_empty(), std::numeric_limits< uint64_t >::max());
+
+    LOGINFO("Step 2: Allocate a quarter of slab=0 and sample, it should be predicted to run dry soon");
+    validate_alloc(16, 0, first_blk_num_at_slab(0), 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    const auto ms_to_empty{m_fb_cache->sample_ms_to_empty()};
+    ASSERT_LT(ms_to_empty, HS_DYNAMIC_CONFIG(blkallocator.free_blk_cache_refill_lead_time_ms))
+        << "Expected slab=0 to be predicted to run dry within lead time";
+
+    LOGINFO("Step 3: Refill session should pick only slab=0, though it is still above refill threshold");
+    const auto fill_session{m_fb_cache->create_cache_fill_session(false /* fill_entire_cache */)};
+    ASSERT_EQ(fill_session->slab_requirements.size(), 1u) << "Expected only the drained slab to be refilled";
+    m_fb_cache->close_cache_fill_session(*fill_session);
+}
+
+TEST_F(BlkCacheQueueTest, snapshot_leaves_cache_intact) {
+    constexpr slab_idx_t num_slabs{3};
+    std::vector< blk_cache_entry > entries;
+    std::vector< blk_cache_entry > excess_blks;
+
+    // 4 entries for each of the 3 slabs
+    SetUp(num_slabs, 4);
+    const auto free_blks{m_fb_cache->total_free_blks()};
+
+    LOGINFO("Step 1: Snapshot only part of the cache, it should pick entries of the largest slab first");
+    m_fb_cache->snapshot(entries, 4, excess_blks);
+    ASSERT_EQ(entries.size(), 4u);
+    ASSERT_TRUE(excess_blks.empty()) << "Expected all entries to be put back to cache";
+    for (const auto& e : entries) {
+        ASSERT_EQ(e.blk_count(), m_cfg.m_per_slab_cfg[num_slabs - 1].slab_size) << "Entry not from largest slab";
+    }
+
+    LOGINFO("Step 2: Snapshot entire cache and validate cache is still intact");
+    entries.clear();
+    m_fb_cache->snapshot(entries, 1000, excess_blks);
+    ASSERT_EQ(entries.size(), num_slabs * 4u);
+    ASSERT_EQ(m_fb_cache->total_free_blks(), free_blks);
+    validate_alloc(4, 2, first_blk_num_at_slab(2), 1);
+}
+
 SISL_OPTIONS_ENABLE(logging)
 int main(int argc, char* argv[]) {
     ::testing::InitGoogleTest(&argc, argv);
@@ -13,15 +13,19 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <random>
 #include <string>
+#include <thread>
 #include <vector>
 #include <list>
 #include <gtest/gtest.h>
 
 #include "blkdata_svc/blk_read_tracker.hpp"
+#include "blkdata_svc/read_epoch_tracker.hpp"
+#include "blkdata_svc/blk_read_cache.hpp"
 
 using namespace homestore;
 
@@ -176,6 +180,33 @@ TEST_F(BlkReadTrackerTest, TestInsRmWithWaiterOnSameBid) {
     assert(called);
 }
 
+/*
+ * Same blks on different chunks and far apart blks of a read are tracked in different shards;
+ * free on one of them should be called only after the read on that chunk completes;
+ * */
+TEST_F(BlkReadTrackerTest, TestInsRmWithWaiterAcrossShards) {
+    get_inst()->set_entries_per_record(16);
+    BlkId b1{16, 20, 1};
+    BlkId b2{16, 20, 2};
+    BlkId far{1 << 20, 8, 1};
+    get_inst()->insert(b1);
+    get_inst()->insert(b2);
+    get_inst()->insert(far);
+
+    bool called{false};
+    get_inst()->wait_on(b2, [&called]() {
+        LOGMSG_ASSERT_EQ(called, false, "not expecting wait_on callback to be called more than once!");
+        called = true;
+    });
+
+    get_inst()->remove(b1);
+    get_inst()->remove(far);
+    ASSERT_FALSE(called) << "Read on other chunk or other blks should not complete the free";
+
+    get_inst()->remove(b2);
+    ASSERT_TRUE(called) << "Free is expected to complete once read on same blks completes";
+}
+
 /*
  * Alignment:16
  * 1. read-1: {16, 40, 0} // read on two base ids: {16, 16, 0}, {32, 16, 0}, {48, 16, 0}
@@ -550,6 +581,156 @@ TEST_F(BlkReadTrackerTest, TestThreadedInsertRemoveAndWait2) {
     LOGINFO("Step 4: Test Passed.");
 }
 
+/*
+ * Free deferred on read epoch waits only for the reads which are in flight when it is deferred;
+ * */
+TEST(ReadEpochTrackerTest, TestDeferWaitsForInflightReads) {
+    ReadEpochTracker tracker;
+
+    bool called{false};
+    tracker.defer([&called]() { called = true; });
+    ASSERT_TRUE(called) << "Expected deferred callback to be called inline without any reads in flight";
+
+    called = false;
+    auto const t1 = tracker.enter();
+    tracker.defer([&called]() { called = true; });
+    ASSERT_FALSE(called) << "Deferred callback called while read is in flight";
+
+    auto const t2 = tracker.enter();
+    tracker.exit(t1);
+    ASSERT_TRUE(called) << "Deferred callback should not wait for reads started after it";
+
+    called = false;
+    tracker.defer([&called]() { called = true; });
+    ASSERT_FALSE(called);
+    tracker.exit(t2);
+    ASSERT_TRUE(called);
+}
+
+TEST(ReadEpochTrackerTest, TestThreadedReadsAndDefer) {
+    ReadEpochTracker tracker;
+    std::atomic< uint64_t > outstanding_defers{0};
+    std::atomic< bool > stop{false};
+
+    std::vector< std::thread > readers;
+    for (uint32_t i{0}; i < SISL_OPTIONS["num_threads"].as< uint32_t >(); ++i) {
+        readers.emplace_back([&tracker, &stop]() {
+            while (!stop.load()) {
+                auto const t = tracker.enter();
+                std::this_thread::yield();
+                tracker.exit(t);
+            }
+        });
+    }
+
+    for (uint32_t i{0}; i < 10000; ++i) {
+        outstanding_defers.fetch_add(1);
+        tracker.defer([&outstanding_defers]() { outstanding_defers.fetch_sub(1); });
+    }
+    stop.store(true);
+    for (auto& t : readers) {
+        t.join();
+    }
+
+    // Reads which completed last might have released most of them, the rest are due as nothing is in flight
+    tracker.defer([]() {});
+    ASSERT_EQ(outstanding_defers.load(), 0u) << "Expected all deferred callbacks to be called once reads are done";
+}
+
+/*
+ * Read cache serves reads covered by a cached blkid and drops whatever overlaps with an invalidated blkid;
+ * */
+TEST(BlkReadCacheTest, TestReadInsertInvalidate) {
+    static constexpr uint32_t blk_size{512};
+    int64_t accounted{0};
+    BlkReadCache cache{64 * 64 * blk_size, blk_size, 8 * blk_size, [&accounted](int64_t bytes) { accounted += bytes; }};
+
+    std::vector< uint8_t > data(4 * blk_size);
+    for (size_t i{0}; i < data.size(); ++i) {
+        data[i] = static_cast< uint8_t >(i / blk_size + 1);
+    }
+    std::vector< uint8_t > out(4 * blk_size);
+
+    BlkId const bid{100, 4, 1};
+    ASSERT_FALSE(cache.read(bid, out.data(), 4 * blk_size)) << "Expected miss on empty cache";
+    cache.insert(bid, data.data(), 4 * blk_size);
+    ASSERT_EQ(cache.size(), 4 * blk_size);
+    ASSERT_EQ(accounted, int64_t(cache.size())) << "Memory accounted does not match the cache size";
+
+    ASSERT_TRUE(cache.read(bid, out.data(), 4 * blk_size));
+    ASSERT_EQ(out, data);
+
+    // Blks within the cached blkid are hits, others are not, irrespective of chunk
+    ASSERT_TRUE(cache.read(BlkId{102, 1, 1}, out.data(), blk_size));
+    ASSERT_EQ(out[0], 3);
+    ASSERT_FALSE(cache.read(BlkId{102, 4, 1}, out.data(), 4 * blk_size));
+    ASSERT_FALSE(cache.read(BlkId{100, 4, 2}, out.data(), 4 * blk_size));
+
+    // Partial read is not cached
+    cache.insert(BlkId{200, 4, 1}, data.data(), 2 * blk_size);
+    ASSERT_FALSE(cache.read(BlkId{200, 1, 1}, out.data(), blk_size));
+
+    cache.invalidate(BlkId{103, 2, 1});
+    ASSERT_FALSE(cache.read(BlkId{100, 1, 1}, out.data(), blk_size)) << "Overlapping blkid is not invalidated";
+    ASSERT_EQ(cache.size(), 0u);
+
+    cache.insert(BlkId{10, 1, 3}, data.data(), blk_size);
+    cache.insert(BlkId{100000, 1, 3}, data.data(), blk_size);
+    cache.invalidate_chunk(3);
+    ASSERT_EQ(cache.size(), 0u);
+    ASSERT_EQ(accounted, 0);
+}
+
+/*
+ * Blkids read repeatedly stay cached while the ones read only once get evicted;
+ * */
+TEST(BlkReadCacheTest, TestHotBlksSurviveScan) {
+    static constexpr uint32_t blk_size{512};
+    static constexpr uint32_t blks_per_shard{16};
+    int64_t accounted{0};
+    BlkReadCache cache{64 * blks_per_shard * blk_size, blk_size, blk_size,
+                       [&accounted](int64_t bytes) { accounted += bytes; }};
+
+    std::vector< uint8_t > buf(blk_size, 0xab);
+    BlkId const hot{0, 1, 0};
+    cache.insert(hot, buf.data(), blk_size);
+
+    // All of them land in the same shard as they are in the same chunk and range of blks
+    for (blk_num_t b{1}; b <= 100 * blks_per_shard; ++b) {
+        cache.insert(BlkId{b, 1, 0}, buf.data(), blk_size);
+        ASSERT_TRUE(cache.read(hot, buf.data(), blk_size)) << "Hot blkid is evicted after " << b << " inserts";
+        ASSERT_LE(cache.size(), blks_per_shard * blk_size) << "Cache grew beyond the capacity of shard";
+    }
+    ASSERT_FALSE(cache.read(BlkId{1, 1, 0}, buf.data(), blk_size)) << "Expected blkid read only once to be evicted";
+    ASSERT_EQ(accounted, int64_t(cache.size()));
+}
+
+/*
+ * Prefetch fill is cached only if none of its blks are invalidated while it is in flight;
+ * */
+TEST(BlkReadCacheTest, TestFillDroppedOnInvalidate) {
+    static constexpr uint32_t blk_size{512};
+    BlkReadCache cache{64 * 64 * blk_size, blk_size, 8 * blk_size};
+    std::vector< uint8_t > data(4 * blk_size, 0xcd);
+    std::vector< uint8_t > out(4 * blk_size);
+
+    BlkId const bid{100, 4, 1};
+    ASSERT_TRUE(cache.begin_fill(bid));
+    ASSERT_FALSE(cache.begin_fill(BlkId{102, 4, 1})) << "Overlapping fill is expected to be refused";
+    cache.end_fill(bid, data.data());
+    ASSERT_TRUE(cache.read(bid, out.data(), 4 * blk_size));
+    ASSERT_EQ(out, data);
+    ASSERT_FALSE(cache.begin_fill(bid)) << "Fill of a cached blkid is expected to be refused";
+
+    BlkId const bid2{200, 4, 1};
+    ASSERT_TRUE(cache.begin_fill(bid2));
+    cache.invalidate(BlkId{203, 1, 1});
+    cache.end_fill(bid2, data.data());
+    ASSERT_FALSE(cache.read(bid2, out.data(), 4 * blk_size)) << "Fill invalidated in flight is cached";
+    ASSERT_TRUE(cache.begin_fill(bid2)) << "Dropped fill is not released";
+    cache.end_fill(bid2, nullptr);
+}
+
 SISL_OPTION_GROUP(test_blk_read_tracker,
                   (num_threads, "", "num_threads", "number of threads",
                    ::cxxopts::value< uint32_t >()->default_value("2"), "number"));
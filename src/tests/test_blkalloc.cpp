@@ -39,6 +39,8 @@
 #include "common/homestore_assert.hpp"
 #include "common/homestore_config.hpp"
 #include "blkalloc/fixed_blk_allocator.h"
+#include "blkalloc/bitmap_run_codec.h"
+#include "blkalloc/free_run_tree.h"
 #include "blkalloc/varsize_blk_allocator.h"
 
 SISL_LOGGING_INIT(HOMESTORE_LOG_MODS)
@@ -635,6 +637,43 @@ TEST_F(FixedBlkAllocatorTest, alloc_free_fixed_size) {
     validate_count();
 }
 
+TEST_F(FixedBlkAllocatorTest, alloc_free_active) {
+    const auto nthreads{
+        std::clamp< uint32_t >(std::thread::hardware_concurrency(), 2, SISL_OPTIONS["num_threads"].as< uint32_t >())};
+
+    // Once recovered, allocs and frees go through the thread magazines
+    m_allocator->recovery_completed();
+
+    LOGINFO("Step 1: Allocate all {} blks in {} threads", m_total_count, nthreads);
+    run_parallel(nthreads, m_total_count, [&](const uint64_t count_per_thread, std::atomic< bool >& terminate_flag) {
+        for (uint64_t i{0}; (i < count_per_thread) && !terminate_flag; ++i) {
+            BlkId bid;
+            if (!alloc_blk(BlkAllocStatus::SUCCESS, bid, false)) { terminate_flag = true; }
+        }
+    });
+    validate_count();
+
+    BlkId bid;
+    LOGINFO("Step 2: Validate if further allocation result in space full error");
+    ASSERT_TRUE(alloc_blk(BlkAllocStatus::SPACE_FULL, bid, false));
+
+    LOGINFO("Step 3: Free {} blks randomly in {} threads", m_total_count / 2, nthreads);
+    run_parallel(nthreads, m_total_count / 2,
+                 [&](const uint64_t count_per_thread, std::atomic< bool >& terminate_flag) {
+                     for (uint64_t i{0}; (i < count_per_thread) && !terminate_flag; ++i) {
+                         [[maybe_unused]] const BlkId blkId{free_random_alloced_blk(false)};
+                     }
+                 });
+    validate_count();
+
+    LOGINFO("Step 4: Allocate the freed blks from a single thread, stealing the ones held by other threads");
+    for (uint64_t i{0}; i < m_total_count / 2; ++i) {
+        ASSERT_TRUE(alloc_blk(BlkAllocStatus::SUCCESS, bid, false));
+    }
+    ASSERT_TRUE(alloc_blk(BlkAllocStatus::SPACE_FULL, bid, false));
+    validate_count();
+}
+
 namespace {
 void alloc_free_var_contiguous_unirandsize(VarsizeBlkAllocatorTest* const block_test_pointer, uint64_t capacity) {
     const auto nthreads{
@@ -885,6 +924,67 @@ TEST_F(VarsizeBlkAllocatorTest, alloc_var_scatter_direct_unirandsize_without_sla
     alloc_var_scatter_direct_unirandsize(this);
 }
 #endif
+
+TEST(FreeRunTreeTest, find_candidate_portions) {
+    constexpr blk_num_t num_portions{1000};
+    FreeRunTree tree{num_portions};
+    ASSERT_EQ(tree.find_first(0, num_portions, 64), 0u) << "Unknown portions are expected to be candidates";
+
+    for (blk_num_t p{0}; p < num_portions; ++p) {
+        tree.update(p, 0);
+    }
+    ASSERT_EQ(tree.max_free_run(), 0u);
+    ASSERT_EQ(tree.find_first(0, num_portions, 1), FreeRunTree::npos);
+
+    tree.update(300, 16);
+    tree.update(700, 128);
+    ASSERT_EQ(tree.max_free_run(), 128u);
+    ASSERT_EQ(tree.find_first(0, num_portions, 8), 300u);
+    ASSERT_EQ(tree.find_first(301, num_portions, 8), 700u);
+    ASSERT_EQ(tree.find_first(0, num_portions, 64), 700u);
+    ASSERT_EQ(tree.find_first(0, 700, 64), FreeRunTree::npos);
+    ASSERT_EQ(tree.find_first(701, num_portions, 1), FreeRunTree::npos);
+
+    tree.update(700, 0);
+    ASSERT_EQ(tree.max_free_run(), 16u);
+    ASSERT_EQ(tree.find_first(0, num_portions, 64), FreeRunTree::npos);
+}
+
+TEST(BitmapRunCodecTest, encode_decode) {
+    constexpr uint64_t nbits{64 * 1024};
+    auto const round_trip = [](std::vector< BitmapRunCodec::bit_run > const& runs, BitmapRunCodec::encoding_t exp_enc) {
+        std::vector< uint8_t > buf;
+        auto const enc = BitmapRunCodec::encode(runs, nbits, buf);
+        ASSERT_EQ(enc, exp_enc);
+        ASSERT_LE(buf.size(), BitmapRunCodec::raw_size(nbits));
+
+        std::vector< BitmapRunCodec::bit_run > decoded;
+        ASSERT_TRUE(BitmapRunCodec::decode(enc, buf.data(), buf.size(), nbits, [&decoded](uint64_t o, uint64_t c) {
+            decoded.push_back(BitmapRunCodec::bit_run{o, c});
+        }));
+        ASSERT_EQ(decoded.size(), runs.size());
+        for (size_t i{0}; i < runs.size(); ++i) {
+            ASSERT_EQ(decoded[i].offset, runs[i].offset) << "Mismatch in run=" << i;
+            ASSERT_EQ(decoded[i].count, runs[i].count) << "Mismatch in run=" << i;
+        }
+    };
+
+    round_trip({}, BitmapRunCodec::encoding_t::runs);
+    round_trip({{0, 63}, {64, 64}, {1000, 5000}, {nbits - 1, 1}}, BitmapRunCodec::encoding_t::runs);
+    round_trip({{0, nbits}}, BitmapRunCodec::encoding_t::runs);
+
+    // Every other bit set is best stored raw
+    std::vector< BitmapRunCodec::bit_run > fragmented;
+    for (uint64_t b{1}; b < nbits; b += 2) {
+        fragmented.push_back(BitmapRunCodec::bit_run{b, 1});
+    }
+    round_trip(fragmented, BitmapRunCodec::encoding_t::raw);
+
+    uint8_t const truncated[] = {0x05, 0x80};
+    ASSERT_FALSE(BitmapRunCodec::decode(BitmapRunCodec::encoding_t::runs, truncated, sizeof(truncated), nbits,
+                                        [](uint64_t, uint64_t) {}));
+}
+
 template < typename T >
 std::shared_ptr< cxxopts::Value > opt_default(const char* val) {
     return ::cxxopts::value< T >()->default_value(val);
@@ -1,5 +1,6 @@
 #include <map>
 #include <unordered_map>
+#include <vector>
 
 #include <sisl/logging/logging.h>
 #include <sisl/options/options.h>
@@ -103,6 +104,38 @@ TEST(BlkIdTest, MultiBlkIdTest) {
     ASSERT_EQ(mb1, mb2);
 }
 
+TEST(BlkIdTest, MultiBlkIdCompact) {
+    MultiBlkId mb1{10, 5, 300};
+    mb1.add(70000, 300, 300);
+    mb1.add(20, 1, 300);
+    ASSERT_EQ(mb1.num_pieces(), 3);
+
+    auto const w = mb1.needed_compact_widths();
+    ASSERT_EQ(w.chunk_num, 2);
+    ASSERT_EQ(w.blk_num, 3);
+    ASSERT_EQ(w.nblks, 2);
+    ASSERT_LT(mb1.compact_serialized_size(), mb1.serialized_size());
+
+    std::vector< uint8_t > buf(mb1.compact_serialized_size());
+    ASSERT_EQ(mb1.serialize_compact(buf.data()), buf.size());
+    ASSERT_TRUE(MultiBlkId::is_compact(sisl::blob{buf.data(), uint32_cast(buf.size())}));
+    ASSERT_FALSE(MultiBlkId::is_compact(mb1.serialize()));
+
+    MultiBlkId mb2{5, 6, 2};
+    mb2.deserialize(sisl::blob{buf.data(), uint32_cast(buf.size())}, true);
+    ASSERT_EQ(mb1, mb2);
+
+    // Raised widths give the same size for smaller values, which still read back alike
+    MultiBlkId const mb3{1, 1, 1};
+    MultiBlkId::compact_widths const min_w{.chunk_num = 2, .blk_num = 4, .nblks = 2};
+    ASSERT_EQ(mb3.compact_serialized_size(min_w), MultiBlkId::compact_serialized_size(1, min_w));
+    buf.assign(mb3.compact_serialized_size(min_w) + 4, 0); // Zero padded, like a localized journal entry
+    mb3.serialize_compact(buf.data(), min_w);
+    MultiBlkId mb4;
+    mb4.deserialize(sisl::blob{buf.data(), uint32_cast(buf.size())}, true);
+    ASSERT_EQ(mb3, mb4);
+}
+
 TEST(BlkIdTest, MultiBlkIdInMap) {
     std::map< MultiBlkId, int > m1;
     std::unordered_map< MultiBlkId, int > m2;
@@ -23,6 +23,7 @@
 #include <homestore/btree/detail/simple_node.hpp>
 #include <homestore/btree/detail/varlen_node.hpp>
 #include <homestore/btree/detail/prefix_node.hpp>
+#include <homestore/btree/detail/compact_node.hpp>
 #include "btree_helpers/btree_test_kvs.hpp"
 
 static constexpr uint32_t g_node_size{4096};
@@ -57,6 +58,12 @@ struct VarObjSizeNodeTest {
     using ValueType = TestVarLenValue;
 };
 
+struct CompactNodeTest {
+    using NodeType = CompactNode< TestVarLenKey, TestVarLenValue >;
+    using KeyType = TestVarLenKey;
+    using ValueType = TestVarLenValue;
+};
+
 struct PrefixIntervalBtreeTest {
     using NodeType = FixedPrefixNode< TestIntervalKey, TestIntervalValue >;
     using KeyType = TestIntervalKey;
@@ -327,7 +334,7 @@ private:
 };
 
 using NodeTypes = testing::Types< FixedLenNodeTest, VarKeySizeNodeTest, VarValueSizeNodeTest, VarObjSizeNodeTest,
-                                  PrefixIntervalBtreeTest >;
+                                  CompactNodeTest, PrefixIntervalBtreeTest >;
 TYPED_TEST_SUITE(NodeTest, NodeTypes);
 
 TYPED_TEST(NodeTest, SequentialInsert) {
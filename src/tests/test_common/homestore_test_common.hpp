@@ -83,6 +83,12 @@ inline static uint32_t generate_random_http_port() {
     return http_port;
 }
 
+// Seed of a random engine of the benchmarks, derived from their --seed so that the runs of the same args issue the
+// same ops, and random if it is 0. Engines of a benchmark are told apart by their salt.
+inline static uint64_t bench_seed(uint64_t seed, uint64_t salt = 0) {
+    return (seed == 0) ? uint64_t{std::random_device{}()} : (seed + salt);
+}
+
 struct Runner {
     uint64_t total_tasks_{0};
     uint32_t qdepth_{8};
@@ -170,6 +176,8 @@ public:
         std::map< uint32_t, test_params > svc_params_;
         hs_before_services_starting_cb_t cb_{nullptr};
         std::vector< homestore::dev_info > devs_;
+        std::string journal_pmem_path_;
+        uint64_t journal_pmem_size_{0};
 
         test_params& params(uint32_t svc) { return svc_params_[svc]; }
         hs_before_services_starting_cb_t& cb() { return cb_; }
@@ -183,6 +191,12 @@ public:
         do_start_homestore(false /* fake_restart */, init_device);
     }
 
+    // Journal writes are staged in the persistent memory at the path from the next start of homestore, none if empty
+    void set_journal_pmem(std::string const& path, uint64_t size) {
+        m_token.journal_pmem_path_ = path;
+        m_token.journal_pmem_size_ = size;
+    }
+
     virtual void restart_homestore(uint32_t shutdown_delay_sec = 5) {
         do_start_homestore(true /* fake_restart*/, false /* init_device */, shutdown_delay_sec);
     }
@@ -191,13 +205,13 @@ public:
         do_start_homestore(true /* fake_restart*/, false /* init_device */, 1 /* shutdown_delay_sec */);
     }
 
-    virtual void shutdown_homestore(bool cleanup = true) {
+    virtual void shutdown_homestore(bool cleanup = true, bool fast = false) {
         if (homestore::HomeStore::safe_instance() == nullptr) {
             /* Already shutdown */
             return;
         }
 
-        homestore::HomeStore::instance()->shutdown();
+        homestore::HomeStore::instance()->shutdown(fast);
         homestore::HomeStore::reset_instance();
         iomanager.stop();
 
@@ -441,7 +455,12 @@ private:
 #endif
 
         bool need_format =
-            hsi->start(hs_input_params{.devices = m_token.devs_, .app_mem_size = app_mem_size}, m_token.cb_);
+            hsi->start(hs_input_params{.devices = m_token.devs_,
+                                       .app_mem_size = app_mem_size,
+                                       .hugepage_size = is_spdk ? app_mem_size : 0,
+                                       .journal_pmem_path = m_token.journal_pmem_path_,
+                                       .journal_pmem_size = m_token.journal_pmem_size_},
+                       m_token.cb_);
 
         // We need to set the min chunk size before homestore format
         if (m_token.svc_params_.contains(HS_SERVICE::LOG) && m_token.svc_params_[HS_SERVICE::LOG].min_chunk_size != 0) {
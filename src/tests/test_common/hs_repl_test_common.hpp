@@ -21,6 +21,7 @@
 #include <condition_variable>
 #include <map>
 #include <set>
+#include <optional>
 #include <boost/process.hpp>
 #include <boost/asio.hpp>
 #include <boost/interprocess/shared_memory_object.hpp>
@@ -128,6 +129,8 @@ public:
         }
 
         homestore::replica_id_t get_my_repl_id() const override { return helper_.my_replica_id_; }
+
+        bool is_witness(homestore::group_id_t) const override { return helper_.is_witness_replica(); }
     };
 
 public:
@@ -269,6 +272,10 @@ public:
 
     Runner& runner() { return io_runner_; }
 
+    // Replica which joins the groups created hereafter as a witness, keeping only the log of their entries
+    void set_witness_replica(std::optional< uint16_t > replica) { witness_replica_ = replica; }
+    bool is_witness_replica() const { return witness_replica_ && (*witness_replica_ == replica_num_); }
+
     void register_listener(std::shared_ptr< ReplDevListener > listener) {
         if (replica_num_ != 0) { pending_listeners_.emplace_back(std::move(listener)); }
 
@@ -370,6 +377,7 @@ private:
     std::map< homestore::replica_id_t, uint32_t > members_;
     std::set< uint32_t > up_members_;
     homestore::replica_id_t my_replica_id_;
+    std::optional< uint16_t > witness_replica_;
 
     std::mutex wakeup_mtx_;
     uint32_t wokenup_replicas_{0};
@@ -14,6 +14,7 @@
  *********************************************************************************/
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <iostream>
 #include <filesystem>
@@ -83,6 +84,7 @@ public:
         uint64_t data_pattern_;
         MultiBlkId blkid_;
         uint64_t id_;
+        RemoteBlkId peer_blkid_; // Blkid of the data on the replica which originated its write
     };
 
     struct KeyValuePair {
@@ -100,9 +102,31 @@ public:
         uint64_t key_id;
         sisl::sg_list write_sgs;
         sisl::sg_list read_sgs;
+        std::vector< uint8_t > padded_header; // Header and key followed by their pad, if they are padded
+        std::vector< uint8_t > padded_key;
 
-        sisl::blob header_blob() { return sisl::blob(uintptr_cast(&jheader), sizeof(journal_header)); }
-        sisl::blob key_blob() { return sisl::blob{uintptr_cast(&key_id), sizeof(uint64_t)}; }
+        sisl::blob header_blob() {
+            if (!padded_header.empty()) { return sisl::blob{padded_header.data(), uint32_cast(padded_header.size())}; }
+            return sisl::blob(uintptr_cast(&jheader), sizeof(journal_header));
+        }
+        sisl::blob key_blob() {
+            if (!padded_key.empty()) { return sisl::blob{padded_key.data(), uint32_cast(padded_key.size())}; }
+            return sisl::blob{uintptr_cast(&key_id), sizeof(uint64_t)};
+        }
+
+        // Pad the header and the key with the low byte of the key, so that they are large and compressible
+        void pad(uint32_t pad_size) {
+            padded_header.assign(sizeof(journal_header) + pad_size, pad_byte(key_id));
+            std::memcpy(padded_header.data(), &jheader, sizeof(journal_header));
+            padded_key.assign(sizeof(uint64_t) + pad_size, pad_byte(key_id));
+            std::memcpy(padded_key.data(), &key_id, sizeof(uint64_t));
+        }
+
+        static uint8_t pad_byte(uint64_t key_id) { return static_cast< uint8_t >(key_id & 0xFF); }
+        static bool is_pad_valid(sisl::blob const& b, uint32_t offset, uint64_t key_id) {
+            return std::all_of(b.cbytes() + offset, b.cbytes() + b.size(),
+                               [key_id](uint8_t c) { return c == pad_byte(key_id); });
+        }
 
         test_req() {
             write_sgs.size = 0;
@@ -126,15 +150,19 @@ public:
 
     void on_commit(int64_t lsn, sisl::blob const& header, sisl::blob const& key, MultiBlkId const& blkids,
                    cintrusive< repl_req_ctx >& ctx) override {
-        ASSERT_EQ(header.size(), sizeof(test_req::journal_header));
+        ASSERT_GE(header.size(), sizeof(test_req::journal_header));
+        ASSERT_GE(key.size(), sizeof(uint64_t));
 
         auto jheader = r_cast< test_req::journal_header const* >(header.cbytes());
         Key k{.id_ = *(r_cast< uint64_t const* >(key.cbytes()))};
+        ASSERT_TRUE(test_req::is_pad_valid(header, sizeof(test_req::journal_header), k.id_)) << "Header pad mismatch";
+        ASSERT_TRUE(test_req::is_pad_valid(key, sizeof(uint64_t), k.id_)) << "Key pad mismatch";
         Value v{.lsn_ = lsn,
                 .data_size_ = jheader->data_size,
                 .data_pattern_ = jheader->data_pattern,
                 .blkid_ = blkids,
-                .id_ = k.id_};
+                .id_ = k.id_,
+                .peer_blkid_ = ctx->remote_blkid()};
 
         LOGINFOMOD(replication, "[Replica={}] Received commit on lsn={} dsn={} key={} value[blkid={} pattern={}]",
                    g_helper->replica_num(), lsn, ctx->dsn(), k.id_, v.blkid_.to_string(), v.data_pattern_);
@@ -143,13 +171,26 @@ public:
             std::unique_lock lk(db_mtx_);
             inmem_db_.insert_or_assign(k, v);
             lsn_index_.emplace(lsn, v);
-            last_committed_lsn = lsn;
+            last_committed_lsn = std::max(last_committed_lsn, uint64_cast(lsn)); // Commits could be in parallel
             ++commit_count_;
         }
 
         if (ctx->is_proposer()) { g_helper->runner().next_task(); }
     }
 
+    void on_batch_commit(std::vector< repl_req_ptr_t > const& rreqs) override {
+        for (size_t i{1}; i < rreqs.size(); ++i) {
+            ASSERT_LT(rreqs[i - 1]->lsn(), rreqs[i]->lsn()) << "Batch of commits is not in order";
+        }
+        batch_commit_count_.fetch_add(1);
+        ReplDevListener::on_batch_commit(rreqs);
+    }
+
+    std::optional< uint64_t > get_commit_conflict_key(repl_req_ptr_t const& rreq) override {
+        if (rreq->key().size() < sizeof(uint64_t)) { return std::nullopt; }
+        return *(r_cast< uint64_t const* >(rreq->key().cbytes()));
+    }
+
     bool on_pre_commit(int64_t lsn, const sisl::blob& header, const sisl::blob& key,
                        cintrusive< repl_req_ctx >& ctx) override {
         LOGINFOMOD(replication, "[Replica={}] Received pre-commit on lsn={} dsn={}", g_helper->replica_num(), lsn,
@@ -196,6 +237,7 @@ public:
 
         int64_t next_lsn = snp_data->offset;
         std::vector< KeyValuePair > kv_snapshot_data;
+        std::shared_lock lk(db_mtx_); // Objects could be read ahead while the entries are committed
         // we can not use find to get the next element, since if the next lsn is a config lsn , it will not be put into
         // lsn_index_ and as a result, the find will return the end of the map. so here we use lower_bound to get the
         // first element to be read and transfered.
@@ -218,6 +260,7 @@ public:
         std::memcpy(blob.bytes(), kv_snapshot_data.data(), kv_snapshot_data_size);
         snp_data->blob = std::move(blob);
         snp_data->is_last_obj = false;
+        snp_data->next_offset = kv_snapshot_data.back().value.lsn_ + 1; // Follower asks for the lsn after the last
         LOGINFOMOD(replication, "[Replica={}] Read logical snapshot callback obj_id={} term={} idx={} num_items={}",
                    g_helper->replica_num(), snp_data->offset, s->get_last_log_term(), s->get_last_log_idx(),
                    kv_snapshot_data.size());
@@ -323,17 +366,18 @@ public:
             req->write_sgs =
                 test_common::HSTestHelper::create_sgs(data_size, max_size_per_iov, req->jheader.data_pattern);
         }
+        if (journal_pad_size_ != 0) { req->pad(journal_pad_size_); }
 
         repl_dev()->async_alloc_write(req->header_blob(), req->key_blob(), req->write_sgs, req);
     }
 
-    void validate_db_data() {
+    void validate_db_data(bool hedged = false) {
         g_helper->runner().set_num_tasks(inmem_db_.size());
 
         LOGINFOMOD(replication, "[{}]: Total {} keys committed, validating them",
                    boost::uuids::to_string(repl_dev()->group_id()), inmem_db_.size());
         auto it = inmem_db_.begin();
-        g_helper->runner().set_task([this, &it]() {
+        g_helper->runner().set_task([this, &it, hedged]() {
             Key k;
             Value v;
             {
@@ -342,11 +386,14 @@ public:
                 ++it;
             }
 
-            if (v.data_size_ != 0) {
+            // Witness has no data of the entries it committed as one, not even after its promotion
+            if ((v.data_size_ != 0) && (v.blkid_.is_valid() || !g_helper->is_witness_replica())) {
                 auto block_size = SISL_OPTIONS["block_size"].as< uint32_t >();
                 auto read_sgs = test_common::HSTestHelper::create_sgs(v.data_size_, block_size);
 
-                repl_dev()->async_read(v.blkid_, read_sgs, v.data_size_).thenValue([read_sgs, k, v](auto const ec) {
+                auto fut = hedged ? repl_dev()->async_hedged_read(v.blkid_, v.peer_blkid_, read_sgs, v.data_size_)
+                                  : repl_dev()->async_read(v.blkid_, read_sgs, v.data_size_);
+                std::move(fut).thenValue([read_sgs, k, v](auto const ec) {
                     LOGINFOMOD(replication, "Validating key={} value[blkid={} pattern={}]", k.id_, v.blkid_.to_string(),
                                v.data_pattern_);
                     RELEASE_ASSERT(!ec, "Read of blkid={} for key={} error={}", v.blkid_.to_string(), k.id_,
@@ -370,6 +417,21 @@ public:
         return commit_count_;
     }
 
+    uint64_t db_batch_commit_count() const { return batch_commit_count_.load(); }
+
+    // Number of the committed entries with data, and of those whose data is not stored locally
+    std::pair< uint64_t, uint64_t > db_data_count() const {
+        std::shared_lock lk(db_mtx_);
+        uint64_t with_data{0};
+        uint64_t no_local_data{0};
+        for (auto const& [k, v] : inmem_db_) {
+            if (v.data_size_ == 0) { continue; }
+            ++with_data;
+            if (!v.blkid_.is_valid()) { ++no_local_data; }
+        }
+        return {with_data, no_local_data};
+    }
+
     uint64_t db_size() const {
         std::shared_lock lk(db_mtx_);
         return inmem_db_.size();
@@ -387,6 +449,9 @@ public:
         LOGINFO("Manually truncated");
     }
 
+    // Size of the pad the header and the key of the entries written hereafter are extended with
+    void set_journal_pad_size(uint32_t pad_size) { journal_pad_size_ = pad_size; }
+
     void set_zombie() { zombie_ = true; }
     bool is_zombie() {
         // Wether a group is zombie(non recoverable)
@@ -397,11 +462,13 @@ private:
     std::map< Key, Value > inmem_db_;
     std::map< int64_t, Value > lsn_index_;
     uint64_t commit_count_{0};
+    std::atomic< uint64_t > batch_commit_count_{0};
     std::shared_mutex db_mtx_;
     uint64_t last_committed_lsn{0};
     std::shared_ptr< snapshot_context > m_last_snapshot{nullptr};
     std::mutex m_snapshot_lock;
     bool zombie_{false};
+    uint32_t journal_pad_size_{0};
 };
 
 class RaftReplDevTestBase : public testing::Test {
@@ -472,9 +539,9 @@ public:
         LOGINFO("Replica={} has received {} commits as expected", g_helper->replica_num(), total_writes);
     }
 
-    void validate_data() {
+    void validate_data(bool hedged = false) {
         for (auto const& db : dbs_) {
-            db->validate_db_data();
+            db->validate_db_data(hedged);
         }
     }
 
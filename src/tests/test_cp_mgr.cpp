@@ -91,6 +91,16 @@ public:
 
     void TearDown() override { m_helper.shutdown_homestore(); }
 
+    void fast_restart() {
+        m_helper.shutdown_homestore(false /* cleanup */, true /* fast */);
+        m_helper.start_homestore();
+        hs()->cp_mgr().register_consumer(cp_consumer_t::HS_CLIENT, std::move(std::make_unique< TestCPCallbacks >()));
+    }
+
+    int64_t last_flushed_cp() const {
+        return homestore::hs()->cp_mgr().get_status(0)["last_flushed_cp"].get< int64_t >();
+    }
+
     void simulate_io() {
         iomanager.run_on_forget(iomgr::reactor_regex::least_busy_worker, [this]() {
             auto cur_cp = homestore::hs()->cp_mgr().cp_guard();
@@ -174,6 +184,37 @@ TEST_F(TestCPMgr, cp_start_and_flush) {
 
     LOGINFO("Step 6: Trigger a cp to validate");
     this->trigger_cp(true /* wait */);
+
+    LOGINFO("Step 7: Validate the phase timings of the recent cps");
+    auto const js = homestore::hs()->cp_mgr().get_status(1);
+    ASSERT_FALSE(js["recent_cps"].empty()) << "No cp is recorded in the cp history";
+    auto const& last_cp = js["recent_cps"].back();
+    ASSERT_TRUE(last_cp["consumers"].contains("hs_client")) << "Flush of the consumer is not recorded";
+    ASSERT_LE(last_cp["consumers"]["hs_client"]["flush_start_us"].get< uint64_t >(),
+              last_cp["consumers"]["hs_client"]["flush_end_us"].get< uint64_t >());
+    ASSERT_LE(last_cp["flush_us"].get< uint64_t >(), last_cp["total_us"].get< uint64_t >());
+}
+
+TEST_F(TestCPMgr, fast_shutdown_and_restart) {
+    auto nrecords = SISL_OPTIONS["num_records"].as< uint32_t >();
+    LOGINFO("Step 1: Flush a cp and then simulate IO on the next cp session for {} records", nrecords);
+    for (uint32_t i{0}; i < nrecords; ++i) {
+        this->simulate_io();
+    }
+    this->trigger_cp(true /* wait */);
+    auto const flushed_cp = this->last_flushed_cp();
+    for (uint32_t i{0}; i < nrecords; ++i) {
+        this->simulate_io();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{1000});
+
+    LOGINFO("Step 2: Fast shutdown and restart, which are not to flush the cp session with the IO");
+    this->fast_restart();
+    ASSERT_EQ(this->last_flushed_cp(), flushed_cp) << "Fast shutdown flushed a cp";
+
+    LOGINFO("Step 3: Trigger a cp after the restart to validate");
+    this->trigger_cp(true /* wait */);
+    ASSERT_EQ(this->last_flushed_cp(), flushed_cp + 1);
 }
 
 int main(int argc, char* argv[]) {
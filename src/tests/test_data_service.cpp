@@ -17,7 +17,11 @@
 #include <iostream>
 #include <filesystem>
 #include <random>
+#include <map>
+#include <set>
 #include <unordered_set>
+#include <cstring>
+#include <future>
 #include <farmhash.h>
 
 #include <gtest/gtest.h>
@@ -43,6 +47,11 @@
 #include "test_common/homestore_test_common.hpp"
 
 #include <homestore/blkdata_service.hpp>
+#include <homestore/coro.hpp>
+#include <homestore/index_service.hpp>
+#include <homestore/index/index_dedup.hpp>
+#include <homestore/index/index_scrubber.hpp>
+#include <boost/uuid/random_generator.hpp>
 
 ////////////////////////////////////////////////////////////////////////////
 //                                                                        //
@@ -869,6 +878,485 @@ TEST_F(BlkDataServiceTest, TestWriteMultiplePagesMultiIovs) {
     LOGINFO("Step 3: I/O completed, do shutdown.");
 }
 
+TEST_F(BlkDataServiceTest, TestBatchAllocThenFree) {
+    auto const blk_size = inst().get_blk_size();
+    std::vector< uint32_t > sizes;
+    uint64_t total_nblks{0};
+    for (uint32_t i{1}; i <= 64; ++i) {
+        sizes.push_back(blk_size * i);
+        total_nblks += i;
+    }
+
+    LOGINFO("Step 1: Allocate a batch of {} requests for total {} blks.", sizes.size(), total_nblks);
+    std::vector< MultiBlkId > out_bids;
+    ASSERT_EQ(inst().alloc_blks(sizes, blk_alloc_hints{}, out_bids), BlkAllocStatus::SUCCESS);
+    ASSERT_EQ(out_bids.size(), sizes.size());
+
+    std::set< std::pair< chunk_num_t, blk_num_t > > seen_blks;
+    for (size_t i{0}; i < out_bids.size(); ++i) {
+        ASSERT_EQ(out_bids[i].blk_count() * blk_size, sizes[i]) << "Mismatch in blks allocated for request=" << i;
+        auto it = out_bids[i].iterate();
+        while (auto const b = it.next()) {
+            for (blk_num_t n{b->blk_num()}; n < b->blk_num() + b->blk_count(); ++n) {
+                ASSERT_TRUE(seen_blks.insert({b->chunk_num(), n}).second) << "Blk allocated twice in the batch";
+            }
+        }
+    }
+
+    LOGINFO("Step 2: Free all the blks allocated by the batch.");
+    for (auto const& bid : out_bids) {
+        inst().async_free_blk(bid).get();
+    }
+}
+
+TEST_F(BlkDataServiceTest, TestCallbackWriteReadReuseCtx) {
+    auto const io_size = 64 * Ki;
+    MultiBlkId bid;
+    ASSERT_EQ(inst().alloc_blks(io_size, blk_alloc_hints{}, bid), BlkAllocStatus::SUCCESS);
+    inst().commit_blk(bid);
+
+    auto* wbuf = iomanager.iobuf_alloc(512, io_size);
+    auto* rbuf = iomanager.iobuf_alloc(512, io_size);
+
+    // Callback is set once, every io on the context completes the promise of the current io
+    std::promise< std::error_condition >* cur_io{nullptr};
+    data_io_ctx ctx{[&cur_io](std::error_condition ec) { cur_io->set_value(ec); }};
+    auto run_io = [&cur_io](auto&& submit) {
+        std::promise< std::error_condition > p;
+        auto f = p.get_future();
+        cur_io = &p;
+        iomanager.run_on_forget(iomgr::reactor_regex::random_worker, [&submit]() { submit(); });
+        return f.get();
+    };
+
+    LOGINFO("Step 1: Write and read back {} bytes a few times, reusing the same io context.", io_size);
+    for (uint32_t i{0}; i < 4; ++i) {
+        test_common::HSTestHelper::fill_data_buf(wbuf, io_size);
+        std::memset(rbuf, 0, io_size);
+        ASSERT_FALSE(run_io([&]() { inst().async_write(r_cast< const char* >(wbuf), io_size, bid, ctx); }));
+        ASSERT_FALSE(run_io([&]() { inst().async_read(bid, rbuf, io_size, ctx); }));
+        ASSERT_EQ(std::memcmp(wbuf, rbuf, io_size), 0) << "Data read back mismatch on iteration=" << i;
+    }
+
+    LOGINFO("Step 2: Read with a sg list on the same io context.");
+    sisl::sg_list sg;
+    sg.size = io_size;
+    sg.iovs.push_back(iovec{.iov_base = rbuf, .iov_len = io_size / 2});
+    sg.iovs.push_back(iovec{.iov_base = rbuf + io_size / 2, .iov_len = io_size / 2});
+    std::memset(rbuf, 0, io_size);
+    ASSERT_FALSE(run_io([&]() { inst().async_read(bid, sg, io_size, ctx); }));
+    ASSERT_EQ(std::memcmp(wbuf, rbuf, io_size), 0) << "Data read back with sg list mismatch";
+
+    iomanager.iobuf_free(wbuf);
+    iomanager.iobuf_free(rbuf);
+    inst().async_free_blk(bid).get();
+}
+
+// Coroutine which runs eagerly and is not awaited by anyone, enough to drive the awaitables in a test
+struct detached_coro {
+    struct promise_type {
+        detached_coro get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+static detached_coro coro_write_read(BlkDataService& svc, MultiBlkId bid, uint8_t* wbuf, uint8_t* rbuf,
+                                     uint32_t size, std::promise< bool >& done) {
+    auto err = co_await coro::async_write(svc, r_cast< const char* >(wbuf), size, bid);
+    if (!err) { err = co_await coro::async_read(svc, bid, rbuf, size); }
+    done.set_value(!err && (std::memcmp(wbuf, rbuf, size) == 0));
+}
+
+TEST_F(BlkDataServiceTest, TestCoroWriteRead) {
+    auto const io_size = 64 * Ki;
+    MultiBlkId bid;
+    ASSERT_EQ(inst().alloc_blks(io_size, blk_alloc_hints{}, bid), BlkAllocStatus::SUCCESS);
+    inst().commit_blk(bid);
+
+    auto* wbuf = iomanager.iobuf_alloc(512, io_size);
+    auto* rbuf = iomanager.iobuf_alloc(512, io_size);
+
+    LOGINFO("Step 1: Write and read back {} bytes a few times from a coroutine.", io_size);
+    for (uint32_t i{0}; i < 4; ++i) {
+        test_common::HSTestHelper::fill_data_buf(wbuf, io_size);
+        std::memset(rbuf, 0, io_size);
+        std::promise< bool > done;
+        auto f = done.get_future();
+        iomanager.run_on_forget(iomgr::reactor_regex::random_worker,
+                                [&]() { coro_write_read(inst(), bid, wbuf, rbuf, io_size, done); });
+        ASSERT_TRUE(f.get()) << "Coroutine write and read back failed on iteration=" << i;
+    }
+
+    iomanager.iobuf_free(wbuf);
+    iomanager.iobuf_free(rbuf);
+    inst().async_free_blk(bid).get();
+}
+
+TEST_F(BlkDataServiceTest, TestChecksummedWriteRead) {
+    auto const io_size = 64 * Ki;
+    auto* wbuf = iomanager.iobuf_alloc(512, io_size);
+    auto* rbuf = iomanager.iobuf_alloc(512, io_size);
+    test_common::HSTestHelper::fill_data_buf(wbuf, io_size);
+
+    LOGINFO("Step 1: Write {} bytes, with a crc for each blk.", io_size);
+    sisl::sg_list sg;
+    sg.size = io_size;
+    sg.iovs.push_back(iovec{.iov_base = wbuf, .iov_len = io_size});
+    MultiBlkId bid;
+    std::vector< crc32_t > crcs;
+    folly::Future< std::error_code > f = folly::Future< std::error_code >::makeEmpty();
+    iomanager.run_on_wait(iomgr::reactor_regex::random_worker,
+                          [&]() { f = inst().async_alloc_write(sg, blk_alloc_hints{}, bid, crcs); });
+    ASSERT_FALSE(std::move(f).get());
+    inst().commit_blk(bid);
+    ASSERT_EQ(crcs.size(), io_size / inst().get_blk_size());
+
+    LOGINFO("Step 2: Read it back with a sg list whose iovs split the blks, verifying the crcs.");
+    sisl::sg_list rsg;
+    rsg.size = io_size;
+    auto const split = inst().get_blk_size() + 512;
+    rsg.iovs.push_back(iovec{.iov_base = rbuf, .iov_len = split});
+    rsg.iovs.push_back(iovec{.iov_base = rbuf + split, .iov_len = io_size - split});
+    iomanager.run_on_wait(iomgr::reactor_regex::random_worker,
+                          [&]() { f = inst().async_read(bid, rsg, io_size, crcs); });
+    ASSERT_FALSE(std::move(f).get());
+    ASSERT_EQ(std::memcmp(wbuf, rbuf, io_size), 0) << "Data read back mismatch";
+
+    LOGINFO("Step 3: Read with a wrong crc, which is expected to fail.");
+    auto bad_crcs = crcs;
+    bad_crcs.back() ^= 0x1;
+    iomanager.run_on_wait(iomgr::reactor_regex::random_worker,
+                          [&]() { f = inst().async_read(bid, rbuf, io_size, bad_crcs); });
+    ASSERT_EQ(std::move(f).get(), std::make_error_code(std::errc::bad_message));
+
+    iomanager.iobuf_free(wbuf);
+    iomanager.iobuf_free(rbuf);
+    inst().async_free_blk(bid).get();
+}
+
+TEST_F(BlkDataServiceTest, TestPackedWriteReadFree) {
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.generic.data_packed_writes = true;
+        HS_SETTINGS_FACTORY().save();
+    });
+    m_helper.restart_homestore();
+
+    auto const entry_size = 512u;
+    auto const nentries = (2 * inst().get_blk_size() / entry_size) + 1; // Spills over to a third shared blk
+    std::vector< packed_blk_loc > locs(nentries);
+    std::vector< uint8_t* > bufs;
+    std::vector< folly::Future< std::error_code > > futs;
+
+    LOGINFO("Step 1: Pack {} writes of {} bytes each.", nentries, entry_size);
+    iomanager.run_on_wait(iomgr::reactor_regex::random_worker, [&]() {
+        for (uint32_t i{0}; i < nentries; ++i) {
+            auto* buf = iomanager.iobuf_alloc(512, entry_size);
+            test_common::HSTestHelper::fill_data_buf(buf, entry_size);
+            bufs.push_back(buf);
+
+            sisl::sg_list sg;
+            sg.size = entry_size;
+            sg.iovs.push_back(iovec{.iov_base = buf, .iov_len = entry_size});
+            futs.emplace_back(inst().async_packed_write(sg, blk_alloc_hints{}, locs[i]));
+        }
+    });
+    ASSERT_EQ(locs[0].bid, locs[1].bid) << "Small writes are expected to share the blk";
+    ASSERT_EQ(locs[1].offset, entry_size);
+
+    auto verify = [&]() {
+        auto* rbuf = iomanager.iobuf_alloc(512, entry_size);
+        for (uint32_t i{0}; i < nentries; ++i) {
+            folly::Future< std::error_code > f = folly::Future< std::error_code >::makeEmpty();
+            iomanager.run_on_wait(iomgr::reactor_regex::random_worker,
+                                  [&]() { f = inst().async_packed_read(locs[i], rbuf); });
+            ASSERT_FALSE(std::move(f).get());
+            ASSERT_EQ(std::memcmp(rbuf, bufs[i], entry_size), 0)
+                << "Packed data mismatch for loc=" << locs[i].to_string();
+        }
+        iomanager.iobuf_free(rbuf);
+    };
+
+    LOGINFO("Step 2: Read the packed writes before and after their shared blks are written.");
+    verify();
+    for (auto& f : futs) {
+        ASSERT_FALSE(std::move(f).get()); // Last shared blk which is not full is written by flush timer
+    }
+    verify();
+
+    LOGINFO("Step 3: Free all the packed writes.");
+    for (auto const& loc : locs) {
+        ASSERT_FALSE(inst().async_packed_free(loc).get());
+    }
+    for (auto* buf : bufs) {
+        iomanager.iobuf_free(buf);
+    }
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.generic.data_packed_writes = false;
+        HS_SETTINGS_FACTORY().save();
+    });
+}
+
+TEST_F(BlkDataServiceTest, TestMergedReads) {
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.generic.data_read_merge_window_us = 1000;
+        HS_SETTINGS_FACTORY().save();
+    });
+    m_helper.restart_homestore();
+
+    auto const io_size = 64 * Ki;
+    auto const blk_size = inst().get_blk_size();
+    auto* wbuf = iomanager.iobuf_alloc(512, io_size);
+    auto* rbuf = iomanager.iobuf_alloc(512, io_size);
+    auto* obuf = iomanager.iobuf_alloc(512, 2 * blk_size);
+    test_common::HSTestHelper::fill_data_buf(wbuf, io_size);
+
+    LOGINFO("Step 1: Write {} bytes.", io_size);
+    sisl::sg_list sg;
+    sg.size = io_size;
+    sg.iovs.push_back(iovec{.iov_base = wbuf, .iov_len = io_size});
+    MultiBlkId bid;
+    folly::Future< std::error_code > f = folly::Future< std::error_code >::makeEmpty();
+    iomanager.run_on_wait(iomgr::reactor_regex::random_worker,
+                          [&]() { f = inst().async_alloc_write(sg, blk_alloc_hints{}, bid); });
+    ASSERT_FALSE(std::move(f).get());
+    inst().commit_blk(bid);
+    ASSERT_EQ(bid.num_pieces(), 1u);
+    auto const wbid = bid.to_single_blkid();
+
+    LOGINFO("Step 2: Read each blk by a separate read, along with a read overlapping two of them.");
+    std::vector< folly::Future< std::error_code > > futs;
+    iomanager.run_on_wait(iomgr::reactor_regex::random_worker, [&]() {
+        for (blk_num_t i{0}; i < wbid.blk_count(); ++i) {
+            futs.emplace_back(inst().async_read(MultiBlkId{wbid.blk_num() + i, 1, wbid.chunk_num()},
+                                                rbuf + i * blk_size, blk_size));
+        }
+        futs.emplace_back(
+            inst().async_read(MultiBlkId{wbid.blk_num() + 1, 2, wbid.chunk_num()}, obuf, 2 * blk_size));
+    });
+    for (auto& rf : futs) {
+        ASSERT_FALSE(std::move(rf).get());
+    }
+    ASSERT_EQ(std::memcmp(wbuf, rbuf, io_size), 0) << "Data of the merged reads mismatch";
+    ASSERT_EQ(std::memcmp(wbuf + blk_size, obuf, 2 * blk_size), 0) << "Data of the overlapping read mismatch";
+
+    iomanager.iobuf_free(wbuf);
+    iomanager.iobuf_free(rbuf);
+    iomanager.iobuf_free(obuf);
+    inst().async_free_blk(bid).get();
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.generic.data_read_merge_window_us = 0;
+        HS_SETTINGS_FACTORY().save();
+    });
+}
+
+TEST_F(BlkDataServiceTest, TestDedupWrites) {
+    LOGINFO("Step 0: Restart with an index service, for the dedup index.");
+    m_helper.shutdown_homestore();
+    m_helper.start_homestore("test_data_service",
+                             {{HS_SERVICE::META, {.size_pct = 5.0}},
+                              {HS_SERVICE::DATA, {.size_pct = 70.0}},
+                              {HS_SERVICE::INDEX, {.size_pct = 10.0, .index_svc_cbs = new IndexServiceCallbacks()}}});
+
+    BtreeConfig cfg{hs()->index_service().node_size()};
+    cfg.m_leaf_node_type = btree_node_type::VAR_VALUE;
+    cfg.m_int_node_type = btree_node_type::FIXED;
+    auto table = std::make_shared< IndexDedup::table_t >(boost::uuids::random_generator()(),
+                                                         boost::uuids::random_generator()(), 0, cfg);
+    hs()->index_service().add_index_table(table);
+    IndexDedup dedup{inst(), *table};
+
+    auto const io_size = 16 * Ki;
+    auto* abuf = iomanager.iobuf_alloc(512, io_size);
+    auto* bbuf = iomanager.iobuf_alloc(512, io_size);
+    auto* rbuf = iomanager.iobuf_alloc(512, io_size);
+    test_common::HSTestHelper::fill_data_buf(abuf, io_size, 0xa);
+    test_common::HSTestHelper::fill_data_buf(bbuf, io_size, 0xb);
+
+    // Splits the buf into two iovs which don't end at a blk or chunk of the fingerprint, if asked to
+    auto const sg_of = [io_size](uint8_t* buf, bool split) {
+        sisl::sg_list sg;
+        sg.size = io_size;
+        auto const first = split ? (io_size / 2 + 512) : io_size;
+        sg.iovs.push_back(iovec{.iov_base = buf, .iov_len = first});
+        if (split) { sg.iovs.push_back(iovec{.iov_base = buf + first, .iov_len = io_size - first}); }
+        return sg;
+    };
+    auto const write = [&dedup](sisl::sg_list const& sg) {
+        folly::Future< dedup_blk_ref > f = folly::Future< dedup_blk_ref >::makeEmpty();
+        iomanager.run_on_wait(iomgr::reactor_regex::random_worker, [&]() { f = dedup.write(sg); });
+        return std::move(f).get();
+    };
+    auto const ref_count = [&table](DedupKey const& key) -> uint32_t {
+        DedupValue v;
+        auto req = BtreeSingleGetRequest{&key, &v};
+        return (table->get(req) == btree_status_t::success) ? v.ref_count() : 0;
+    };
+    auto const verify = [&](dedup_blk_ref const& ref, uint8_t* expected) {
+        auto sg = sg_of(rbuf, false);
+        folly::Future< std::error_code > f = folly::Future< std::error_code >::makeEmpty();
+        iomanager.run_on_wait(iomgr::reactor_regex::random_worker, [&]() { f = dedup.read(ref, sg); });
+        ASSERT_FALSE(std::move(f).get());
+        ASSERT_EQ(std::memcmp(rbuf, expected, io_size), 0) << "Data read back mismatch of blkid=" << ref.blkid;
+    };
+
+    LOGINFO("Step 1: Write data which is not in the index, which is written to new blks.");
+    auto const a1 = write(sg_of(abuf, false));
+    ASSERT_TRUE(a1.in_index);
+    ASSERT_EQ(ref_count(a1.key), 1);
+    ASSERT_EQ(dedup.stats().num_deduped.load(), 0);
+    verify(a1, abuf);
+
+    LOGINFO("Step 2: Write the same data split across iovs, which shares the blks of the previous write.");
+    auto const a2 = write(sg_of(abuf, true));
+    ASSERT_EQ(a2.key, a1.key) << "Fingerprint depends on the iovs the data is split across";
+    ASSERT_EQ(a2.blkid, a1.blkid) << "Duplicate write is not deduped";
+    ASSERT_EQ(ref_count(a1.key), 2);
+    ASSERT_EQ(dedup.stats().num_deduped.load(), 1);
+    verify(a2, abuf);
+
+    LOGINFO("Step 3: Overwrite the second copy with different data and give back its ref of the previous data.");
+    auto const b = write(sg_of(bbuf, true));
+    ASSERT_FALSE(b.key == a1.key);
+    ASSERT_NE(b.blkid, a1.blkid);
+    ASSERT_EQ(ref_count(b.key), 1);
+    ASSERT_FALSE(dedup.free(a2).get());
+    ASSERT_EQ(ref_count(a1.key), 1) << "Free of a shared copy is expected to only drop its ref";
+    verify(a1, abuf);
+    verify(b, bbuf);
+
+    LOGINFO("Step 4: Free the last refs, which removes the entries and frees the blks.");
+    ASSERT_FALSE(dedup.free(a1).get());
+    ASSERT_EQ(ref_count(a1.key), 0);
+    ASSERT_FALSE(dedup.free(b).get());
+    ASSERT_EQ(ref_count(b.key), 0);
+    ASSERT_EQ(dedup.free(a1).get(), std::make_error_code(std::errc::invalid_argument))
+        << "Free of a ref which is already given back is expected to fail";
+
+    LOGINFO("Step 5: Write the data again, which is a miss now that its entry is gone.");
+    auto const a3 = write(sg_of(abuf, false));
+    ASSERT_EQ(ref_count(a3.key), 1);
+    verify(a3, abuf);
+    ASSERT_FALSE(dedup.free(a3).get());
+    ASSERT_EQ(dedup.stats().num_writes.load(), 4);
+    ASSERT_EQ(dedup.stats().num_collisions.load(), 0);
+
+    iomanager.iobuf_free(abuf);
+    iomanager.iobuf_free(bbuf);
+    iomanager.iobuf_free(rbuf);
+}
+
+// Recovers the table of the index service as a dedup table, on a restart
+class DedupTableCallbacks : public IndexServiceCallbacks {
+public:
+    DedupTableCallbacks(BtreeConfig const& cfg, shared< IndexDedup::table_t >& table) : m_cfg{cfg}, m_table{table} {}
+    std::shared_ptr< IndexTableBase > on_index_table_found(superblk< index_table_sb >&& sb) override {
+        m_table = std::make_shared< IndexDedup::table_t >(std::move(sb), m_cfg);
+        return m_table;
+    }
+
+private:
+    BtreeConfig const& m_cfg;
+    shared< IndexDedup::table_t >& m_table;
+};
+
+TEST_F(BlkDataServiceTest, TestIndexScrub) {
+    LOGINFO("Step 0: Restart with an index service, for the table to scrub.");
+    shared< IndexDedup::table_t > table;
+    BtreeConfig cfg{4096};
+    m_helper.shutdown_homestore();
+    m_helper.start_homestore(
+        "test_data_service",
+        {{HS_SERVICE::META, {.size_pct = 5.0}},
+         {HS_SERVICE::DATA, {.size_pct = 70.0}},
+         {HS_SERVICE::INDEX, {.size_pct = 10.0, .index_svc_cbs = new DedupTableCallbacks(cfg, table)}}});
+
+    cfg = BtreeConfig{hs()->index_service().node_size()};
+    cfg.m_leaf_node_type = btree_node_type::VAR_VALUE;
+    cfg.m_int_node_type = btree_node_type::FIXED;
+    table = std::make_shared< IndexDedup::table_t >(boost::uuids::random_generator()(),
+                                                    boost::uuids::random_generator()(), 0, cfg);
+    hs()->index_service().add_index_table(table);
+
+    std::vector< uint8_t > const min_bytes(DedupKey::get_fixed_size(), 0x00);
+    std::vector< uint8_t > const max_bytes(DedupKey::get_fixed_size(), 0xff);
+    BtreeKeyRange< DedupKey > const range{DedupKey{sisl::blob{min_bytes.data(), uint32_cast(min_bytes.size())}, true},
+                                          DedupKey{sisl::blob{max_bytes.data(), uint32_cast(max_bytes.size())}, true}};
+    std::map< std::string, std::vector< crc32_t > > crcs_of;
+    auto const refs_cb = [&crcs_of](DedupKey const& k, DedupValue const& v) {
+        return std::vector< scrub_blk_ref >{scrub_blk_ref{v.blkid(), crcs_of[k.to_string()]}};
+    };
+    scrub_params const params{.batch_entries = 2, .max_entries_per_sec = 0, .cpu_pct = 100};
+
+    LOGINFO("Step 1: Scrub the empty table, which returns after a pass without entries.");
+    {
+        IndexScrubber< DedupKey, DedupValue > scrubber{*table, range, refs_cb, params};
+        auto const stats = scrubber.scrub(1000);
+        ASSERT_EQ(stats.num_entries, 0);
+        ASSERT_EQ(stats.num_passes, 1) << "Scrub of an empty table is expected to stop after a pass";
+    }
+
+    LOGINFO("Step 2: Write the data of the entries, one of which is freed and one of which has a bad crc.");
+    uint64_t const num_entries = 6;
+    auto const io_size = 8 * Ki;
+    auto* buf = iomanager.iobuf_alloc(512, io_size);
+    std::vector< MultiBlkId > blkids;
+    for (uint64_t i = 0; i < num_entries; ++i) {
+        test_common::HSTestHelper::fill_data_buf(buf, io_size, i + 1);
+        sisl::sg_list sg;
+        sg.size = io_size;
+        sg.iovs.push_back(iovec{.iov_base = buf, .iov_len = io_size});
+
+        MultiBlkId blkid;
+        std::vector< crc32_t > crcs;
+        folly::Future< std::error_code > f = folly::Future< std::error_code >::makeEmpty();
+        iomanager.run_on_wait(iomgr::reactor_regex::random_worker,
+                              [&]() { f = inst().async_alloc_write(sg, blk_alloc_hints{}, blkid, crcs); });
+        ASSERT_FALSE(std::move(f).get());
+        ASSERT_FALSE(crcs.empty()) << "Write didn't return the crcs of its blks";
+
+        auto const key = DedupKey::of(sg);
+        DedupValue value{blkid, 1};
+        auto req = BtreeSinglePutRequest{&key, &value, btree_put_type::INSERT};
+        ASSERT_EQ(table->put(req), btree_status_t::success);
+        if (i == 0) { crcs[0] = ~crcs[0]; }
+        crcs_of[key.to_string()] = std::move(crcs);
+        blkids.push_back(blkid);
+    }
+    iomanager.iobuf_free(buf);
+    ASSERT_FALSE(inst().async_free_blk(blkids[1]).get());
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+
+    LOGINFO("Step 3: Scrub part of the table and restart, after which the scrub resumes from where it stopped.");
+    scrub_stats first;
+    {
+        IndexScrubber< DedupKey, DedupValue > scrubber{*table, range, refs_cb, params};
+        first = scrubber.scrub(params.batch_entries);
+        ASSERT_EQ(first.num_entries, params.batch_entries);
+    }
+    m_helper.params(HS_SERVICE::INDEX).index_svc_cbs = new DedupTableCallbacks(cfg, table);
+    m_helper.restart_homestore();
+    ASSERT_NE(table, nullptr) << "Table is not recovered";
+
+    IndexScrubber< DedupKey, DedupValue > scrubber{*table, range, refs_cb, params};
+    auto const rest = scrubber.scrub(num_entries - params.batch_entries);
+    ASSERT_EQ(rest.num_entries, num_entries - params.batch_entries);
+    ASSERT_EQ(first.num_unallocated + rest.num_unallocated, 1) << "Freed blkid is not reported once by the pass";
+    ASSERT_EQ(first.num_crc_mismatch + rest.num_crc_mismatch, 1) << "Bad crc is not reported once by the pass";
+    ASSERT_EQ(first.num_read_errors + rest.num_read_errors, 0);
+
+    LOGINFO("Step 4: Scrub a whole pass, which starts over after the end of the previous one.");
+    auto const full = scrubber.scrub(num_entries);
+    ASSERT_EQ(full.num_entries, num_entries);
+    ASSERT_EQ(full.num_unallocated, 1);
+    ASSERT_EQ(full.num_crc_mismatch, 1);
+    ASSERT_FALSE(full.is_clean());
+}
+
 TEST_F(BlkDataServiceTest, TestWriteThenReadVerify) {
     // start io in worker thread;
     auto io_size = 4 * Ki;
@@ -16,6 +16,7 @@
 #include <chrono>
 #include <condition_variable>
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <map>
@@ -260,6 +261,215 @@ TEST_F(DeviceMgrTest, CreateChunk) {
     vdev.reset();
 }
 
+TEST_F(DeviceMgrTest, MirroredVDevCreation) {
+    if (m_pdevs.size() < 2) { GTEST_SKIP() << "Mirrored vdev needs atleast 2 pdevs"; }
+    uint64_t avail_size{0};
+    for (auto& pdev : m_pdevs) {
+        avail_size += pdev->data_size();
+    }
+
+    LOGINFO("Step 1: Creating mirrored vdev with size={}", in_bytes(avail_size / 4));
+    auto vdev =
+        m_dmgr->create_vdev(homestore::vdev_parameters{.vdev_name = "test_vdev_mirrored",
+                                                       .vdev_size = avail_size / 4,
+                                                       .num_chunks = 2,
+                                                       .blk_size = 4096,
+                                                       .dev_type = HSDevType::Data,
+                                                       .alloc_type = blk_allocator_type_t::none,
+                                                       .chunk_sel_type = chunk_selector_type_t::NONE,
+                                                       .multi_pdev_opts = vdev_multi_pdev_opts_t::ALL_PDEV_MIRRORED,
+                                                       .context_data = sisl::blob{}});
+    auto const vdev_id = vdev->info().vdev_id;
+    auto const primaries = vdev->get_chunks();
+    ASSERT_EQ(vdev->num_mirrors(), m_pdevs.size()) << "Expected a copy of the vdev on every pdev";
+
+    LOGINFO("Step 2: Writing a blk on each primary chunk through the vdev");
+    static constexpr uint32_t io_size{4096};
+    auto wbuf = iomanager.iobuf_alloc(512, io_size);
+    for (auto const& [chunk_num, _] : primaries) {
+        std::memset(wbuf, chunk_num + 1, io_size);
+        ASSERT_FALSE(vdev->sync_write(r_cast< const char* >(wbuf), io_size, BlkId{1, 1, chunk_num}));
+    }
+    iomanager.iobuf_free(wbuf);
+
+    auto validate = [&]() {
+        auto rbuf = iomanager.iobuf_alloc(512, io_size);
+        std::map< uint16_t, uint32_t > copies; // Number of mirrors of each primary chunk
+        for (auto const& chunk : m_dmgr->get_chunks()) {
+            if (chunk->vdev_id() != vdev_id) { continue; }
+            if (!chunk->is_mirror()) {
+                ASSERT_EQ(primaries.contains(chunk->chunk_id()), true) << "Primary chunk is not part of the vdev";
+                continue;
+            }
+            ASSERT_EQ(primaries.contains(chunk->primary_chunk_id()), true) << "Mirror of unknown primary chunk";
+            ++copies[chunk->primary_chunk_id()];
+
+            // Every mirror has the blk written to its primary
+            auto* pdev = chunk->physical_dev_mutable();
+            ASSERT_FALSE(pdev->sync_read(r_cast< char* >(rbuf), io_size, chunk->start_offset() + io_size));
+            ASSERT_EQ(rbuf[0], chunk->primary_chunk_id() + 1) << "Mirror has different data than its primary";
+        }
+        for (auto const& [chunk_num, _] : primaries) {
+            ASSERT_EQ(copies[chunk_num], m_pdevs.size() - 1) << "Expected a mirror of the chunk on every other pdev";
+        }
+        iomanager.iobuf_free(rbuf);
+    };
+    LOGINFO("Step 3: Validating the mirrors have the data written");
+    validate();
+
+    LOGINFO("Step 4: Restarting homestore and validating the mirrors are loaded");
+    vdev.reset();
+    this->restart();
+    validate();
+    auto rbuf = iomanager.iobuf_alloc(512, io_size);
+    for (auto& v : m_vdevs) {
+        if (v->info().vdev_id != vdev_id) { continue; }
+        ASSERT_EQ(v->get_chunks().size(), primaries.size()) << "Mirrors are expected to be loaded as mirrors";
+        for (auto const& [chunk_num, _] : primaries) {
+            ASSERT_FALSE(v->sync_read(r_cast< char* >(rbuf), io_size, BlkId{1, 1, chunk_num}));
+            ASSERT_EQ(rbuf[0], chunk_num + 1) << "Read through the mirrored vdev has different data";
+        }
+    }
+    iomanager.iobuf_free(rbuf);
+}
+
+TEST_F(DeviceMgrTest, MirroredVDevDegradedWrite) {
+    if (m_pdevs.size() < 3) { GTEST_SKIP() << "Degraded mirrored vdev needs atleast 3 pdevs"; }
+    uint64_t avail_size{0};
+    for (auto& pdev : m_pdevs) {
+        avail_size += pdev->data_size();
+    }
+
+    LOGINFO("Step 1: Creating mirrored vdev and writing a blk on each primary chunk");
+    auto vdev =
+        m_dmgr->create_vdev(homestore::vdev_parameters{.vdev_name = "test_vdev_mirrored",
+                                                       .vdev_size = avail_size / 4,
+                                                       .num_chunks = 2,
+                                                       .blk_size = 4096,
+                                                       .dev_type = HSDevType::Data,
+                                                       .alloc_type = blk_allocator_type_t::none,
+                                                       .chunk_sel_type = chunk_selector_type_t::NONE,
+                                                       .multi_pdev_opts = vdev_multi_pdev_opts_t::ALL_PDEV_MIRRORED,
+                                                       .context_data = sisl::blob{}});
+    auto const vdev_id = vdev->info().vdev_id;
+    auto const primaries = vdev->get_chunks();
+    static constexpr uint32_t io_size{4096};
+    auto buf = iomanager.iobuf_alloc(512, io_size);
+    auto const write_all = [&](shared< VirtualDev > const& v, uint8_t pattern) {
+        for (auto const& [chunk_num, _] : primaries) {
+            std::memset(buf, pattern, io_size);
+            ASSERT_FALSE(v->sync_write(r_cast< const char* >(buf), io_size, BlkId{1, 1, chunk_num}));
+        }
+    };
+    auto const read_all = [&](shared< VirtualDev > const& v, uint8_t pattern) {
+        for (auto const& [chunk_num, _] : primaries) {
+            ASSERT_FALSE(v->sync_read(r_cast< char* >(buf), io_size, BlkId{1, 1, chunk_num}));
+            ASSERT_EQ(buf[0], pattern) << "Read through the mirrored vdev has stale data of chunk=" << chunk_num;
+        }
+    };
+    auto const find_vdev = [&]() {
+        for (auto& v : m_vdevs) {
+            if (v->info().vdev_id == vdev_id) { return v; }
+        }
+        return shared< VirtualDev >{};
+    };
+    write_all(vdev, 0xa);
+    vdev.reset();
+
+    LOGINFO("Step 2: Restarting without the pdev of the primaries and writing the blks again");
+    auto const all_devs = m_dev_infos;
+    m_dev_infos.erase(m_dev_infos.begin());
+    this->restart();
+    vdev = find_vdev();
+    ASSERT_NE(vdev, nullptr);
+    ASSERT_EQ(vdev->num_stale_mirrors(), 0);
+    write_all(vdev, 0xb);
+    read_all(vdev, 0xb);
+    vdev.reset();
+
+    LOGINFO("Step 3: Restarting with all the pdevs, the primaries which missed the write are not read from");
+    m_dev_infos = all_devs;
+    this->restart();
+    vdev = find_vdev();
+    ASSERT_NE(vdev, nullptr);
+    ASSERT_EQ(vdev->num_stale_mirrors(), primaries.size()) << "Primaries which missed the write are not stale";
+    for (uint32_t i{0}; i < 4; ++i) {
+        read_all(vdev, 0xb);
+    }
+    for (auto const& [chunk_num, _] : primaries) {
+        auto* chunk = m_dmgr->get_chunk_mutable(chunk_num);
+        ASSERT_FALSE(chunk->physical_dev_mutable()->sync_read(r_cast< char* >(buf), io_size,
+                                                               chunk->start_offset() + io_size));
+        ASSERT_EQ(buf[0], 0xa) << "Primary is expected to still have the data before the degraded write";
+    }
+
+    LOGINFO("Step 4: Resyncing the stale primaries, which are read from again across restarts");
+    ASSERT_FALSE(vdev->resync_mirrors());
+    ASSERT_EQ(vdev->num_stale_mirrors(), 0);
+    for (auto const& [chunk_num, _] : primaries) {
+        auto* chunk = m_dmgr->get_chunk_mutable(chunk_num);
+        ASSERT_FALSE(chunk->physical_dev_mutable()->sync_read(r_cast< char* >(buf), io_size,
+                                                               chunk->start_offset() + io_size));
+        ASSERT_EQ(buf[0], 0xb) << "Primary is not resynced";
+    }
+    vdev.reset();
+    this->restart();
+    vdev = find_vdev();
+    ASSERT_EQ(vdev->num_stale_mirrors(), 0);
+    read_all(vdev, 0xb);
+    iomanager.iobuf_free(buf);
+}
+
+TEST_F(DeviceMgrTest, OnlineVDevExpansion) {
+    auto const chunk_size = hs_super_blk::min_chunk_size(homestore::HSDevType::Data);
+    auto const num_chunks = uint32_cast(m_pdevs.size() * 2);
+    LOGINFO("Step 1: Creating vdev with {} chunks", num_chunks);
+    auto vdev =
+        m_dmgr->create_vdev(homestore::vdev_parameters{.vdev_name = "test_vdev_expand",
+                                                       .vdev_size = uint64_cast(num_chunks) * chunk_size,
+                                                       .num_chunks = num_chunks,
+                                                       .blk_size = 4096,
+                                                       .dev_type = HSDevType::Data,
+                                                       .alloc_type = blk_allocator_type_t::none,
+                                                       .chunk_sel_type = chunk_selector_type_t::NONE,
+                                                       .multi_pdev_opts = vdev_multi_pdev_opts_t::ALL_PDEV_STRIPED,
+                                                       .context_data = sisl::blob{}});
+    auto const vdev_id = vdev->info().vdev_id;
+    auto const size_before = vdev->size();
+    auto const nchunks_before = vdev->get_chunks().size();
+
+    LOGINFO("Step 2: Adding a new device and expanding the vdev onto it");
+    auto fname = std::string{"/tmp/test_devmgr_data_" + std::to_string(m_data_dev_names.size() + 1)};
+    init_file(fname, SISL_OPTIONS["data_dev_size_mb"].as< uint64_t >() * 1024 * 1024);
+    m_data_dev_names.emplace_back(fname);
+    m_dev_infos.emplace_back(std::filesystem::canonical(fname).string(), homestore::HSDevType::Data);
+    auto* new_pdev = m_dmgr->add_device(m_dev_infos.back());
+    ASSERT_NE(new_pdev, nullptr);
+    ASSERT_EQ(m_dmgr->get_pdevs_by_dev_type(HSDevType::Data).size(), m_pdevs.size() + 1);
+
+    m_dmgr->expand_vdev(vdev_id, new_pdev, 2);
+    auto const validate = [&](shared< VirtualDev > const& v) {
+        auto chunks = v->get_chunks();
+        ASSERT_EQ(chunks.size(), nchunks_before + 2) << "Vdev is expected to have the chunks added";
+        ASSERT_EQ(v->size(), size_before + 2 * chunk_size) << "Vdev size is expected to grow by the chunks added";
+        uint32_t on_new_pdev{0};
+        for (auto const& [_, chunk] : chunks) {
+            if (chunk->physical_dev()->get_devname() == m_dev_infos.back().dev_name) { ++on_new_pdev; }
+        }
+        ASSERT_EQ(on_new_pdev, 2) << "Added chunks are expected to be on the new device";
+    };
+    validate(vdev);
+
+    LOGINFO("Step 3: Restarting homestore with the new device and validating the expanded vdev is loaded");
+    vdev.reset();
+    this->restart();
+    ASSERT_FALSE(m_dmgr->is_boot_in_degraded_mode()) << "Restart with the added device is not expected to be degraded";
+    ASSERT_EQ(m_pdevs.size(), m_dev_infos.size());
+    for (auto& v : m_vdevs) {
+        if (v->info().vdev_id == vdev_id) { validate(v); }
+    }
+}
+
 int main(int argc, char* argv[]) {
     SISL_OPTIONS_LOAD(argc, argv, logging, test_device_manager, iomgr);
     ::testing::InitGoogleTest(&argc, argv);
@@ -246,6 +246,57 @@ TYPED_TEST(BtreeTest, RandomRemove) {
     this->get_all();
 }
 
+TYPED_TEST(BtreeTest, ShortSeparatorOnSplit) {
+    using K = typename TestFixture::K;
+    using V = typename TestFixture::V;
+    if constexpr (!BtreeSeparatorKey< K > || (TestFixture::T::interior_node_type == btree_node_type::FIXED)) {
+        GTEST_SKIP() << "Interior nodes of the tree don't store the short separators";
+    } else {
+        // Table which exposes the keys of its root, to inspect the separators the splits put into it
+        struct SeparatorTable : public IndexTable< K, V > {
+            using IndexTable< K, V >::IndexTable;
+            std::vector< K > root_keys() const {
+                BtreeNodePtr root;
+                EXPECT_EQ(this->read_node_impl(this->root_node_id(), root), btree_status_t::success);
+                std::vector< K > keys;
+                for (uint32_t i{0}; !root->is_leaf() && (i < root->total_entries()); ++i) {
+                    keys.push_back(root->template get_nth_key< K >(i, true /* copy */));
+                }
+                return keys;
+            }
+        };
+        auto table = std::make_shared< SeparatorTable >(boost::uuids::random_generator()(),
+                                                        boost::uuids::random_generator()(), 0, this->m_cfg);
+        hs()->index_service().add_index_table(table);
+        this->m_bt = table;
+
+        const auto num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+        for (uint32_t i = 0; i < num_entries; ++i) {
+            this->put(i, btree_put_type::INSERT);
+        }
+
+        LOGINFO("Validate that the splits put the separators shorter than the keys into the root");
+        auto const keys = table->root_keys();
+        ASSERT_FALSE(keys.empty()) << "Tree is expected to have split";
+        uint32_t num_shorter{0};
+        for (auto const& k : keys) {
+            auto const key_size = K{k.key()}.serialized_size();
+            ASSERT_LE(k.serialized_size(), key_size) << "Separator " << k.to_string() << " is longer than its key";
+            if (k.serialized_size() < key_size) { ++num_shorter; }
+        }
+        ASSERT_GT(num_shorter, 0u) << "None of the separators in the root is shorter than its key";
+
+        LOGINFO("Validate that the lookups are routed by the separators, also once they are read back from disk");
+        this->get_all();
+        this->do_query(0, num_entries - 1, 75);
+        test_common::HSTestHelper::trigger_cp(true /* wait */);
+        auto& cache = hs()->index_service().wb_cache();
+        ASSERT_TRUE(cache.evict_buf(table->root_node_id())) << "Flushed root is not evicted";
+        this->get_all();
+        this->do_query(0, num_entries - 1, 75);
+    }
+}
+
 TYPED_TEST(BtreeTest, RangeUpdate) {
     LOGINFO("RangeUpdate test start");
     // Forward sequential insert
@@ -307,6 +358,260 @@ TYPED_TEST(BtreeTest, CpFlush) {
     LOGINFO("CpFlush test end");
 }
 
+TYPED_TEST(BtreeTest, CompressedNodeFlush) {
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.generic.index_node_compression = true;
+        HS_SETTINGS_FACTORY().save();
+    });
+
+    const auto num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        this->put(i, btree_put_type::INSERT);
+    }
+    for (uint32_t i = 0; i < num_entries; i += 10) {
+        this->remove_one(i);
+    }
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+
+    LOGINFO("Restart homestore, so that all the nodes are read back from their compressed copy on disk");
+    this->dump_to_file(std::string("before.txt"));
+    this->destroy_btree();
+    this->restart_homestore();
+    this->dump_to_file(std::string("after.txt"));
+    this->compare_files("before.txt", "after.txt");
+    this->do_query(0, num_entries - 1, 75);
+
+    LOGINFO("Modify the nodes read from the compressed copy, write them again and restart");
+    for (uint32_t i = 0; i < num_entries; i += 10) {
+        this->put(i, btree_put_type::INSERT);
+    }
+    for (uint32_t i = 1; i < num_entries; i += 10) {
+        this->put(i, btree_put_type::UPDATE);
+    }
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+    this->dump_to_file(std::string("before.txt"));
+    this->destroy_btree();
+    this->restart_homestore();
+    this->dump_to_file(std::string("after.txt"));
+    this->compare_files("before.txt", "after.txt");
+    this->do_query(0, num_entries - 1, 75);
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.generic.index_node_compression = false;
+        HS_SETTINGS_FACTORY().save();
+    });
+}
+
+TYPED_TEST(BtreeTest, CoalescedNodeFlush) {
+    // Runs of physically adjacent nodes are written a few nodes at a time, so a run spans many coalesced writes
+    uint32_t prev_max_coalesce{32};
+    HS_SETTINGS_FACTORY().modifiable_settings([&prev_max_coalesce](auto& s) {
+        prev_max_coalesce = s.generic.index_flush_max_coalesce_nodes;
+        s.generic.index_flush_max_coalesce_nodes = 4;
+        HS_SETTINGS_FACTORY().save();
+    });
+
+    LOGINFO("Insert the entries, whose nodes are allocated next to each other and flushed as coalesced writes");
+    const auto num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        this->put(i, btree_put_type::INSERT);
+    }
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+
+    LOGINFO("Dirty a range of adjacent nodes and few far apart nodes in the same cp");
+    for (uint32_t i = 0; i < num_entries / 4; ++i) {
+        this->put(i, btree_put_type::UPDATE);
+    }
+    for (uint32_t i = num_entries / 2; i < num_entries; i += 97) {
+        this->remove_one(i);
+    }
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+
+    LOGINFO("Restart homestore, so that all the nodes are read back from disk");
+    this->dump_to_file(std::string("before.txt"));
+    this->destroy_btree();
+    this->restart_homestore();
+    this->dump_to_file(std::string("after.txt"));
+    this->compare_files("before.txt", "after.txt");
+    this->get_all();
+    this->do_query(0, num_entries - 1, 75);
+
+    HS_SETTINGS_FACTORY().modifiable_settings([prev_max_coalesce](auto& s) {
+        s.generic.index_flush_max_coalesce_nodes = prev_max_coalesce;
+        HS_SETTINGS_FACTORY().save();
+    });
+}
+
+TYPED_TEST(BtreeTest, AsyncDestroy) {
+    const auto num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        this->put(i, btree_put_type::INSERT);
+    }
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+
+    // Few nodes are freed in a cp, so that the destroy spans across many cps
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.generic.index_destroy_max_nodes_per_cp = 16;
+        HS_SETTINGS_FACTORY().save();
+    });
+
+    auto const uuid = this->m_bt->uuid();
+    auto fut = hs()->index_service().destroy_index_table_async(this->m_bt);
+    ASSERT_EQ(hs()->index_service().get_index_table(uuid), nullptr) << "Destroyed table is not removed right away";
+    while (!fut.isReady()) {
+        test_common::HSTestHelper::trigger_cp(true /* wait */);
+    }
+    ASSERT_TRUE(std::move(fut).get()) << "Async destroy of the table failed";
+    this->m_bt.reset();
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.generic.index_destroy_max_nodes_per_cp = 8192;
+        HS_SETTINGS_FACTORY().save();
+    });
+}
+
+TYPED_TEST(BtreeTest, CacheTableStats) {
+    const auto num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        this->put(i, btree_put_type::INSERT);
+    }
+    this->do_query(0, num_entries - 1, 1000);
+
+    auto& cache = hs()->index_service().wb_cache();
+    auto const ordinal = std::to_string(this->m_bt->ordinal());
+    cache.set_table_quota(this->m_bt->ordinal(), 50);
+    auto const js = cache.get_table_stats();
+    ASSERT_TRUE(js.contains(ordinal)) << "No stats of the table in the cache";
+    ASSERT_GT(js[ordinal]["resident_nodes"].get< int64_t >(), 0) << "No nodes of the table resident in the cache";
+    ASSERT_GT(js[ordinal]["quota_nodes"].get< int64_t >(), 0) << "Quota set for the table is not reported";
+    ASSERT_GT(js[ordinal]["lookups"].get< uint64_t >(), 0) << "Lookups of the table are not counted";
+    LOGINFO("Cache stats of the table {}", js[ordinal].dump());
+}
+
+#ifdef _PRERELEASE
+TYPED_TEST(BtreeTest, CacheTableStatsAcrossCps) {
+    using K = typename TestFixture::K;
+    using V = typename TestFixture::V;
+
+    auto other = std::make_shared< typename TestFixture::T::BtreeType >(
+        boost::uuids::random_generator()(), boost::uuids::random_generator()(), 0, this->m_cfg);
+    hs()->index_service().add_index_table(other);
+    auto const put_other = [&other](uint64_t k, btree_put_type put_type) {
+        K key{k};
+        V value = V::generate_rand();
+        auto req = BtreeSinglePutRequest{&key, &value, put_type};
+        ASSERT_EQ(other->put(req), btree_status_t::success) << "Put to the other table failed for key " << k;
+    };
+
+    // Few entries, so that the root is the only node of both the tables
+    for (uint64_t i = 0; i < 10; ++i) {
+        this->put(i, btree_put_type::INSERT);
+        put_other(i, btree_put_type::INSERT);
+    }
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+
+    LOGINFO("Modify both the tables in back to back cps, while the flush of the first cp is held back");
+    this->m_helper.set_delay_flip("simulate_index_cp_flush_delay", 1000000 /* 1 sec */);
+    for (uint64_t i = 0; i < 10; ++i) {
+        this->put(i, btree_put_type::UPSERT);
+        put_other(i, btree_put_type::UPSERT);
+    }
+    test_common::HSTestHelper::trigger_cp(false /* wait */);
+    for (uint64_t i = 0; i < 10; ++i) {
+        this->put(i, btree_put_type::UPSERT);
+        put_other(i, btree_put_type::UPSERT);
+    }
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+
+    auto& cache = hs()->index_service().wb_cache();
+    auto const resident_nodes = [&cache](uint32_t ordinal) {
+        auto const js = cache.get_table_stats();
+        auto const key = std::to_string(ordinal);
+        return js.contains(key) ? js[key]["resident_nodes"].template get< int64_t >() : int64_t{0};
+    };
+
+    LOGINFO("Evicting the root of a table has to be accounted against that table only");
+    auto const evict_root = [&](bnodeid_t root_id, uint32_t evicted_ordinal, uint32_t untouched_ordinal) {
+        auto const evicted_before = resident_nodes(evicted_ordinal);
+        auto const untouched_before = resident_nodes(untouched_ordinal);
+        ASSERT_TRUE(cache.evict_buf(root_id)) << "Flushed root is not evicted";
+        ASSERT_EQ(resident_nodes(evicted_ordinal), evicted_before - 1) << "Eviction is not accounted against its table";
+        ASSERT_EQ(resident_nodes(untouched_ordinal), untouched_before) << "Eviction is accounted against another table";
+    };
+    evict_root(this->m_bt->root_node_id(), this->m_bt->ordinal(), other->ordinal());
+    evict_root(other->root_node_id(), other->ordinal(), this->m_bt->ordinal());
+    this->get_all();
+}
+#endif
+
+#ifdef _PRERELEASE
+TYPED_TEST(BtreeTest, PrefetchRacingWithFlush) {
+    // Few entries, so that the root is the only node of the tree
+    for (uint32_t i = 0; i < 10; ++i) {
+        this->put(i, btree_put_type::INSERT);
+    }
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+
+    auto& cache = hs()->index_service().wb_cache();
+    auto const root_id = this->m_bt->root_node_id();
+    ASSERT_TRUE(cache.evict_buf(root_id)) << "Clean root is not evicted";
+
+    LOGINFO("Prefetch the root and delay its completion past a load, modify, flush and evict of the root");
+    this->m_helper.set_delay_flip("simulate_index_prefetch_delay", 2000000 /* 2 secs */);
+    this->m_bt->prefetch_nodes({root_id});
+    this->put(10, btree_put_type::INSERT);
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+    ASSERT_TRUE(cache.evict_buf(root_id)) << "Flushed root is not evicted";
+
+    std::this_thread::sleep_for(std::chrono::seconds{3});
+    LOGINFO("Validate that the image read by the prefetch is not the one cached");
+    this->get_all();
+    this->do_query(0, 10, 5);
+}
+
+TYPED_TEST(BtreeTest, ShutdownWithPrefetchInFlight) {
+    const auto num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        this->put(i, btree_put_type::INSERT);
+    }
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+
+    auto const root_id = this->m_bt->root_node_id();
+    ASSERT_TRUE(hs()->index_service().wb_cache().evict_buf(root_id)) << "Clean root is not evicted";
+
+    LOGINFO("Prefetch the root and delay its completion past the shutdown, which has to wait for it");
+    this->m_helper.set_delay_flip("simulate_index_prefetch_delay", 2000000 /* 2 secs */);
+    this->m_bt->prefetch_nodes({root_id});
+    this->dump_to_file(std::string("before.txt"));
+    this->destroy_btree();
+    this->restart_homestore();
+    this->dump_to_file(std::string("after.txt"));
+    this->compare_files("before.txt", "after.txt");
+    this->do_query(0, num_entries - 1, 75);
+}
+
+TYPED_TEST(BtreeTest, ShutdownRightAfterWarmUp) {
+    const auto num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        this->put(i, btree_put_type::INSERT);
+    }
+    test_common::HSTestHelper::trigger_cp(true /* wait */);
+    this->dump_to_file(std::string("before.txt"));
+
+    LOGINFO("Restart with the hot nodes persisted at shutdown, whose reads by the warm up are delayed");
+    this->m_helper.set_delay_flip("simulate_index_prefetch_delay", 500000 /* 500 ms */, 16 /* count */);
+    this->destroy_btree();
+    this->restart_homestore();
+
+    LOGINFO("Shut down at once, while the reads of the warm up are in flight");
+    this->destroy_btree();
+    this->restart_homestore();
+    this->dump_to_file(std::string("after.txt"));
+    this->compare_files("before.txt", "after.txt");
+    this->do_query(0, num_entries - 1, 75);
+}
+#endif
+
 TYPED_TEST(BtreeTest, MultipleCpFlush) {
     LOGINFO("MultipleCpFlush test start");
 
@@ -24,6 +24,7 @@
 #include "btree_helpers/btree_test_helper.hpp"
 #include "btree_helpers/btree_test_kvs.hpp"
 #include "btree_helpers/btree_decls.h"
+#include "index/index_cp.hpp"
 
 using namespace homestore;
 
@@ -187,6 +188,89 @@ private:
         return keys;
     }
 };
+
+TEST(IndexTxnJournal, EncodeDecode) {
+    using ctx_t = IndexCPContext;
+    // Ids spread across two chunks, with blk nums going both up and down within a chunk
+    std::vector< BlkId > const ids{BlkId{100, 1, 2}, BlkId{5, 1, 2}, BlkId{(1u << 30), 1, 7}, BlkId{101, 1, 2},
+                                   BlkId{0, 1, 7}};
+    auto const validate = [&ids](ctx_t::decoded_txn const& txn, uint32_t ordinal) {
+        ASSERT_EQ(txn.hdr.index_ordinal, ordinal);
+        ASSERT_EQ(txn.hdr.has_inplace_parent, 1);
+        ASSERT_EQ(txn.hdr.is_parent_meta, 1);
+        ASSERT_EQ(txn.hdr.num_new_ids, 3);
+        ASSERT_EQ(txn.hdr.num_freed_ids, 1);
+        ASSERT_EQ(txn.ids.size(), ids.size());
+        for (size_t i{0}; i < ids.size(); ++i) {
+            ASSERT_EQ(txn.ids[i].blk_num(), ids[i].blk_num()) << "Mismatch of blk_num of id " << i;
+            ASSERT_EQ(txn.ids[i].chunk_num(), ids[i].chunk_num()) << "Mismatch of chunk_num of id " << i;
+        }
+    };
+
+    LOGINFO("Decode a journal of the current version, as encoded by the cp");
+    std::vector< uint8_t > buf(sizeof(ctx_t::txn_journal) + 2 * ctx_t::txn_record::size_for_num_ids(ids.size()));
+    auto tj = new (buf.data()) ctx_t::txn_journal();
+    tj->cp_id = 5;
+    for (uint32_t ordinal : {3u, 4u}) {
+        std::vector< BlkId > appended;
+        auto rec = tj->append_record(ordinal);
+        rec->append(ctx_t::op_t::parent_inplace, ids[0], appended);
+        rec->is_parent_meta = 0x1;
+        for (size_t i{1}; i < 4; ++i) {
+            rec->append(ctx_t::op_t::child_new, ids[i], appended);
+        }
+        rec->append(ctx_t::op_t::child_freed, ids[4], appended);
+        rec->encode_ids(appended);
+    }
+    auto dj = ctx_t::decode_journal(buf.data(), tj->size);
+    ASSERT_EQ(dj.cp_id, 5);
+    ASSERT_FALSE(dj.log_marker.has_value());
+    ASSERT_EQ(dj.txns.size(), 2);
+    validate(dj.txns[0], 3);
+    validate(dj.txns[1], 4);
+
+    LOGINFO("Decode a journal of version 0, of the ids in plain, as written before the upgrade");
+    std::vector< uint8_t > buf0(sizeof(ctx_t::txn_journal_v0) + sizeof(ctx_t::txn_record_v0) +
+                                ids.size() * ctx_t::txn_record_v0::id_size);
+    auto tj0 = new (buf0.data()) ctx_t::txn_journal_v0();
+    tj0->cp_id = 6;
+    tj0->num_txns = 1;
+    tj0->size = uint32_cast(buf0.size());
+    auto rec0 = new (buf0.data() + sizeof(ctx_t::txn_journal_v0)) ctx_t::txn_record_v0{};
+    rec0->has_inplace_parent = 0x1;
+    rec0->is_parent_meta = 0x1;
+    rec0->num_new_ids = 3;
+    rec0->num_freed_ids = 1;
+    rec0->index_ordinal = 9;
+    auto id_ptr = buf0.data() + sizeof(ctx_t::txn_journal_v0) + sizeof(ctx_t::txn_record_v0);
+    for (auto const& id : ids) {
+        blk_num_t const blk_num = id.blk_num();
+        chunk_num_t const chunk_num = id.chunk_num();
+        std::memcpy(id_ptr, &blk_num, sizeof(blk_num_t));
+        std::memcpy(id_ptr + sizeof(blk_num_t), &chunk_num, sizeof(chunk_num_t));
+        id_ptr += ctx_t::txn_record_v0::id_size;
+    }
+    dj = ctx_t::decode_journal(buf0.data(), uint32_cast(buf0.size()));
+    ASSERT_EQ(dj.cp_id, 6);
+    ASSERT_EQ(dj.txns.size(), 1);
+    validate(dj.txns[0], 9);
+
+    LOGINFO("Decode a journal of the records in the txn log, which has only the marker");
+    std::vector< uint8_t > mbuf(sizeof(ctx_t::txn_journal) + sizeof(ctx_t::txn_log_marker));
+    auto mj = new (mbuf.data()) ctx_t::txn_journal();
+    mj->cp_id = 7;
+    auto marker = new (mbuf.data() + sizeof(ctx_t::txn_journal)) ctx_t::txn_log_marker();
+    marker->start_lsn = 10;
+    marker->end_lsn = 20;
+    mj->size += sizeof(ctx_t::txn_log_marker);
+    dj = ctx_t::decode_journal(mbuf.data(), mj->size);
+    ASSERT_EQ(dj.cp_id, 7);
+    ASSERT_TRUE(dj.log_marker.has_value());
+    ASSERT_EQ(dj.log_marker->start_lsn, 10);
+    ASSERT_EQ(dj.log_marker->end_lsn, 20);
+    ASSERT_TRUE(dj.txns.empty());
+}
+
 #ifdef _PRERELEASE
 template < typename TestType >
 struct IndexCrashTest : public test_common::HSTestHelper, BtreeTestHelper< TestType >, public ::testing::Test {
@@ -226,6 +310,7 @@ struct IndexCrashTest : public test_common::HSTestHelper, BtreeTestHelper< TestT
         this->start_homestore(
             "test_index_crash_recovery",
             {{HS_SERVICE::META, {.size_pct = 10.0}},
+             {HS_SERVICE::LOG, {.size_pct = 10.0}},
              {HS_SERVICE::INDEX, {.size_pct = 70.0, .index_svc_cbs = new TestIndexServiceCallbacks(this)}}},
             nullptr, {}, SISL_OPTIONS["init_device"].as< bool >());
 
@@ -541,6 +626,82 @@ TYPED_TEST(IndexCrashTest, SplitCrash1) {
     }
 }
 
+TYPED_TEST(IndexCrashTest, SplitCrashTxnLog) {
+    // Txn records of the cps are appended to the txn log, from which the recovery repairs the splits
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.generic.index_txn_log = true; });
+    HS_SETTINGS_FACTORY().save();
+
+    // Txn log is created by the flush of a cp, cps created after it append to it
+    test_common::HSTestHelper::trigger_cp(true);
+    test_common::HSTestHelper::trigger_cp(true);
+
+    auto const num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+    SequenceGenerator generator(100 /*putFreq*/, 0 /* removeFreq*/, 0 /*start_range*/, num_entries - 1 /*end_range*/);
+    vector< std::string > flips = {"crash_flush_on_split_at_parent", "crash_flush_on_split_at_left_child",
+                                   "crash_flush_on_split_at_right_child"};
+    for (size_t i = 0; i < flips.size(); ++i) {
+        this->reset_btree();
+        LOGINFO("Step 1-{}: Set flag {}", i + 1, flips[i]);
+        this->set_basic_flip(flips[i]);
+        auto operations = generator.generateOperations(num_entries - 1, true /* reset */);
+        for (auto [k, _] : operations) {
+            this->put(k, btree_put_type::INSERT, true /* expect_success */);
+        }
+        this->crash_and_recover(operations, fmt::format("recover_tree_txn_log_crash_{}.dot", i + 1));
+    }
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.generic.index_txn_log = false; });
+    HS_SETTINGS_FACTORY().save();
+}
+
+TYPED_TEST(IndexCrashTest, SplitCrashWithNodeDeltas) {
+    // In-place updates of the leaves are logged as deltas instead of writing the leaves, so the leaves on disk are
+    // older than the tree and only the deltas, spread across the delta records of several cps, have the updates
+    auto const node_size = hs()->index_service().node_size();
+    HS_SETTINGS_FACTORY().modifiable_settings([node_size](auto& s) { s.generic.index_delta_max_bytes = node_size; });
+    HS_SETTINGS_FACTORY().save();
+
+    auto const num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+    vector< std::string > flips = {"crash_flush_on_split_at_parent", "crash_flush_on_split_at_left_child",
+                                   "crash_flush_on_split_at_right_child"};
+    for (size_t i = 0; i < flips.size(); ++i) {
+        this->reset_btree();
+        LOGINFO("Step {}-1: Fill the first half of the tree and flush it, so that the leaves are written in full",
+                i + 1);
+        for (auto k = 0u; k < num_entries / 2; ++k) {
+            this->put(k, btree_put_type::INSERT, true /* expect_success */);
+        }
+        test_common::HSTestHelper::trigger_cp(true);
+
+        LOGINFO("Step {}-2: Update the entries in place over two cps, so that the leaves are in delta mode", i + 1);
+        for (auto k = 0u; k < num_entries / 2; ++k) {
+            this->put(k, btree_put_type::UPDATE, true /* expect_success */);
+        }
+        test_common::HSTestHelper::trigger_cp(true);
+        for (auto k = 0u; k < num_entries / 4; ++k) {
+            this->put(k, btree_put_type::UPDATE, true /* expect_success */);
+        }
+        test_common::HSTestHelper::trigger_cp(true);
+        this->get_all();
+        this->m_shadow_map.save(this->m_shadow_filename);
+
+        LOGINFO("Step {}-3: Fill the second half with flip {} set, crash and validate the updated values", i + 1,
+                flips[i]);
+        this->set_basic_flip(flips[i]);
+        for (auto k = num_entries / 2; k < num_entries; ++k) {
+            this->put(k, btree_put_type::INSERT, true /* expect_success */);
+        }
+        this->crash_and_recover(num_entries / 2, num_entries);
+
+        LOGINFO("Step {}-4: Restart cleanly after the recovery and validate again", i + 1);
+        this->restart_homestore();
+        this->get_all();
+    }
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.generic.index_delta_max_bytes = 0; });
+    HS_SETTINGS_FACTORY().save();
+}
+
 TYPED_TEST(IndexCrashTest, long_running_put_crash) {
     // Define the lambda function
     auto const num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
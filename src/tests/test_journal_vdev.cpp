@@ -36,6 +36,8 @@
 #include "device/journal_vdev.hpp"
 #include "common/homestore_utils.hpp"
 #include "common/homestore_assert.hpp"
+#include "common/homestore_config.hpp"
+#include "common/resource_mgr.hpp"
 #include "test_common/homestore_test_common.hpp"
 
 using namespace homestore;
@@ -595,6 +597,178 @@ TEST_F(VDevJournalIOTest, MultipleChunkTest) {
     // clang-format on
 }
 
+TEST_F(VDevJournalIOTest, PreparedChunkTest) {
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.generic.journal_chunk_prepare_pct = 25; });
+    HS_SETTINGS_FACTORY().save();
+
+    uint64_t chunk_size = hs()->logstore_service().get_vdev()->info().chunk_size;
+    uint64_t data_size = chunk_size * 3 / 8;
+    JournalDescriptorTest test(1);
+    auto log_dev_jd = test.vdev_jd();
+
+    // First write creates the head chunk which is below the prepare percent, so nothing is prepared yet.
+    LOGINFO("Inserting first entry");
+    test.fixed_write(data_size);
+    ASSERT_EQ(log_dev_jd->get_status(0)["prepared_chunk"], 0);
+
+    // Second write takes the next chunk from the pool, ahead of the write crossing the chunk.
+    LOGINFO("Inserting second entry");
+    test.fixed_write(data_size);
+    auto const prepared = log_dev_jd->get_status(0)["prepared_chunk"].get< uint64_t >();
+    ASSERT_NE(prepared, 0);
+
+    // Third write crosses the chunk, which links the prepared chunk in.
+    LOGINFO("Inserting third entry");
+    test.fixed_write(data_size);
+    auto status = log_dev_jd->get_status(3);
+    ASSERT_EQ(status["num_chunks"], 2);
+    ASSERT_EQ(status["chunks"][1]["chunk_id"].get< uint64_t >(), prepared);
+    test.read_all();
+
+    LOGINFO("Restart homestore");
+    test.save();
+    m_helper.restart_homestore();
+    test.restore();
+    test.read_all();
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.generic.journal_chunk_prepare_pct = 50; });
+    HS_SETTINGS_FACTORY().save();
+}
+
+TEST_F(VDevJournalIOTest, StripedJournalTest) {
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.generic.journal_stripe_width = 3;
+        s.generic.journal_stripe_unit_kb = 64;
+    });
+    HS_SETTINGS_FACTORY().save();
+
+    uint64_t chunk_size = hs()->logstore_service().get_vdev()->info().chunk_size;
+    uint64_t data_size = chunk_size / 2;
+    JournalDescriptorTest test(1);
+    auto log_dev_jd = test.vdev_jd();
+    ASSERT_EQ(log_dev_jd->get_status(0)["stripe_width"], 3);
+
+    // Segment is of 3 chunks and fits 5 entries, rest go to the second segment.
+    LOGINFO("Inserting entries over two segments");
+    for (int i = 0; i < 7; i++) {
+        test.fixed_write(data_size);
+    }
+    for (int i = 0; i < 100; i++) {
+        test.random_write();
+    }
+    auto status = log_dev_jd->get_status(3);
+    ASSERT_EQ(status["num_chunks"], 2);
+    ASSERT_EQ(status["chunks"][0]["stripe_chunks"].size(), 3);
+    ASSERT_EQ(log_dev_jd->size(), 6 * chunk_size);
+    test.read_all();
+
+    // Striping of the journal is persisted with it, regardless of the config
+    LOGINFO("Restart homestore with striping turned off for new journals");
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.generic.journal_stripe_width = 1; });
+    HS_SETTINGS_FACTORY().save();
+    test.save();
+    m_helper.restart_homestore();
+    test.restore();
+    log_dev_jd = test.vdev_jd();
+    ASSERT_EQ(log_dev_jd->get_status(0)["stripe_width"], 3);
+    ASSERT_EQ(log_dev_jd->num_chunks_used(), 2);
+    test.read_all();
+
+    LOGINFO("Truncating the entries of the first segment");
+    test.truncate(5 * data_size);
+    ASSERT_EQ(log_dev_jd->num_chunks_used(), 1);
+    ASSERT_EQ(log_dev_jd->size(), 3 * chunk_size);
+    test.read_all();
+}
+
+TEST_F(VDevJournalIOTest, SpaceThrottleTest) {
+    uint64_t chunk_size = hs()->logstore_service().get_vdev()->info().chunk_size;
+    uint64_t capacity = 4 * chunk_size;
+    HS_SETTINGS_FACTORY().modifiable_settings([capacity](auto& s) {
+        s.resource_limits.journal_vdev_capacity_mb = capacity / (1024 * 1024);
+        s.resource_limits.journal_throttle_max_wait_ms = 10;
+    });
+    HS_SETTINGS_FACTORY().save();
+
+    uint64_t data_size = chunk_size * 3 / 8;
+    JournalDescriptorTest test(1);
+    auto log_dev_jd = test.vdev_jd();
+    bool critical{false};
+
+    // Below the high watermark appends reserve credits without being throttled.
+    LOGINFO("Inserting entries below the high watermark");
+    test.fixed_write(data_size);
+    ASSERT_EQ(resource_mgr().cur_journal_space_reserved(), log_dev_jd->used_size());
+    ASSERT_EQ(resource_mgr().get_journal_append_delay_us(0, critical), 0);
+
+    LOGINFO("Inserting entries past the high watermark");
+    while (log_dev_jd->used_size() <= capacity / 2) {
+        test.fixed_write(data_size);
+    }
+    ASSERT_GT(resource_mgr().get_journal_append_delay_us(0, critical), 0);
+    ASSERT_FALSE(critical);
+    ASSERT_EQ(resource_mgr().cur_journal_space_reserved(), log_dev_jd->used_size());
+
+    // At the critical watermark appends wait for truncation, but still go ahead after the max wait.
+    LOGINFO("Inserting entries past the critical watermark");
+    while (log_dev_jd->used_size() < capacity * 9 / 10) {
+        test.fixed_write(data_size);
+    }
+    resource_mgr().get_journal_append_delay_us(0, critical);
+    ASSERT_TRUE(critical);
+    auto const start = Clock::now();
+    test.fixed_write(data_size);
+    ASSERT_GE(get_elapsed_time_us(start), 10 * 1000);
+    test.read_all();
+
+    // Truncation returns the credits, which lifts the throttle.
+    LOGINFO("Truncating all entries");
+    test.truncate(log_dev_jd->tail_offset());
+    ASSERT_EQ(resource_mgr().cur_journal_space_reserved(), log_dev_jd->used_size());
+    ASSERT_EQ(resource_mgr().get_journal_append_delay_us(0, critical), 0);
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.resource_limits.journal_vdev_capacity_mb = 0;
+        s.resource_limits.journal_throttle_max_wait_ms = 1000;
+    });
+    HS_SETTINGS_FACTORY().save();
+}
+
+TEST_F(VDevJournalIOTest, PmemTierTest) {
+    // A regular file stands in for the persistent memory, which makes the tier persist with msync
+    std::string const pmem_path{"/tmp/test_journal_vdev_pmem"};
+    std::filesystem::remove(pmem_path);
+    m_helper.set_journal_pmem(pmem_path, 64 * 1024 * 1024);
+    m_helper.restart_homestore();
+    ASSERT_TRUE(hs()->logstore_service().get_vdev()->get_status(0).contains("pmem_tier"));
+
+    uint64_t chunk_size = hs()->logstore_service().get_vdev()->info().chunk_size;
+    JournalDescriptorTest test(1);
+    auto log_dev_jd = test.vdev_jd();
+
+    // Writes are completed once staged and read back after they are destaged to the chunks
+    LOGINFO("Inserting entries through the pmem tier");
+    for (int i = 0; i < 200; i++) {
+        test.random_write();
+    }
+    test.fixed_write(chunk_size / 2);
+    test.fixed_write(chunk_size / 2);
+    test.read_all();
+
+    LOGINFO("Truncating half the entries");
+    test.truncate(log_dev_jd->tail_offset() / 2);
+    test.read_all();
+
+    LOGINFO("Restart homestore");
+    test.save();
+    m_helper.restart_homestore();
+    test.restore();
+    test.read_all();
+
+    m_helper.set_journal_pmem("", 0);
+    std::filesystem::remove(pmem_path);
+}
+
 SISL_OPTION_GROUP(test_journal_vdev,
                   (truncate_watermark_percentage, "", "truncate_watermark_percentage",
                    "percentage of space usage to trigger truncate", ::cxxopts::value< uint32_t >()->default_value("80"),
@@ -14,6 +14,7 @@
  *
  *********************************************************************************/
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <cstdint>
@@ -23,6 +24,8 @@
 #include <memory>
 #include <mutex>
 #include <random>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -238,6 +241,557 @@ TEST_F(LogDevTest, WriteSyncThenRead) {
     }
 }
 
+TEST_F(LogDevTest, ZeroCopyAppend) {
+    auto logdev_id = logstore_service().create_new_logdev();
+    s_max_flush_multiple = logstore_service().get_logdev(logdev_id)->get_flush_size_multiple();
+    auto log_store = logstore_service().create_new_log_store(logdev_id, true /* append_mode */);
+    auto store_id = log_store->get_store_id();
+    const auto align = uint32_cast(log_store->zero_copy_align_size());
+    ASSERT_EQ(align, s_max_flush_multiple);
+
+    auto restart = [&]() {
+        std::promise< bool > p;
+        auto starting_cb = [&]() {
+            logstore_service().open_logdev(logdev_id);
+            logstore_service().open_log_store(logdev_id, store_id, true /* append_mode */).thenValue([&](auto store) {
+                log_store = store;
+                p.set_value(true);
+            });
+        };
+        start_homestore(true /* restart */, starting_cb);
+        p.get_future().get();
+    };
+
+    const unsigned count{100};
+    std::atomic< unsigned > completed{0};
+    std::uniform_int_distribution< uint32_t > gen_data_size{1, 4 * align};
+    std::default_random_engine re{std::random_device{}()};
+    for (unsigned i{0}; i < count; ++i) {
+        // Data sizes are deliberately not a multiple of alignment, rest of the buffer is written as padding
+        const uint32_t sz = gen_data_size(re);
+        const uint32_t total_sz = sz + sizeof(test_log_data);
+        sisl::io_blob_safe buf{sisl::round_up(total_sz, align), align};
+        auto* d = new (buf.bytes()) test_log_data();
+        d->size = sz;
+        std::memset(voidptr_cast(d->get_data()), static_cast< char >((i % 94) + 33), sz);
+
+        log_store->append_async(std::move(buf), total_sz, nullptr,
+                                [&completed](logstore_seq_num_t, const sisl::io_blob& b, logdev_key, void*) {
+                                    ASSERT_EQ(r_cast< test_log_data const* >(b.cbytes())->total_size(), b.size());
+                                    completed.fetch_add(1);
+                                });
+    }
+    log_store->flush();
+    ASSERT_EQ(completed.load(), count) << "All zero copy appends are expected to be completed after flush";
+
+    for (unsigned i{0}; i < count; ++i) {
+        read_verify(log_store, i);
+    }
+
+    LOGINFO("Restart and validate zero copy records are recovered just like the others");
+    restart();
+    for (unsigned i{0}; i < count; ++i) {
+        read_verify(log_store, i);
+    }
+}
+
+TEST_F(LogDevTest, AppendBatch) {
+    auto logdev_id = logstore_service().create_new_logdev();
+    s_max_flush_multiple = logstore_service().get_logdev(logdev_id)->get_flush_size_multiple();
+    auto log_store = logstore_service().create_new_log_store(logdev_id, true /* append_mode */);
+
+    LOGINFO("Append batches of varied sizes and validate there is one callback per batch with its lsn range");
+    logstore_seq_num_t cur_lsn = 0;
+    for (auto const batch_size : {1, 10, 100, 250}) {
+        std::vector< test_log_data* > datas;
+        std::vector< bool > io_memories;
+        std::vector< sisl::io_blob > blobs;
+        for (int i{0}; i < batch_size; ++i) {
+            bool io_memory{false};
+            auto* d = prepare_data(cur_lsn + i, io_memory);
+            datas.push_back(d);
+            io_memories.push_back(io_memory);
+            blobs.emplace_back(uintptr_cast(d), d->total_size(), false);
+        }
+
+        std::promise< std::pair< logstore_seq_num_t, logstore_seq_num_t > > p;
+        auto const start_lsn =
+            log_store->append_batch(blobs, nullptr, [&p](logstore_seq_num_t start, logstore_seq_num_t end, logdev_key,
+                                                         void*) { p.set_value(std::make_pair(start, end)); });
+        log_store->flush();
+        auto const [start, end] = p.get_future().get();
+        ASSERT_EQ(start_lsn, cur_lsn);
+        ASSERT_EQ(start, cur_lsn);
+        ASSERT_EQ(end, cur_lsn + batch_size - 1);
+        cur_lsn += batch_size;
+
+        for (size_t i{0}; i < datas.size(); ++i) {
+            if (io_memories[i]) {
+                iomanager.iobuf_free(uintptr_cast(datas[i]));
+            } else {
+                std::free(voidptr_cast(datas[i]));
+            }
+        }
+    }
+
+    for (logstore_seq_num_t lsn{0}; lsn < cur_lsn; ++lsn) {
+        read_verify(log_store, lsn);
+    }
+}
+
+TEST_F(LogDevTest, RecordRingOverflow) {
+    LOGINFO("Step 1: Create a logdev with a tiny ring of in-memory records, so that appends overflow it");
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.logstore.inflight_records_ring_size = 4; });
+    HS_SETTINGS_FACTORY().save();
+
+    auto logdev_id = logstore_service().create_new_logdev();
+    s_max_flush_multiple = logstore_service().get_logdev(logdev_id)->get_flush_size_multiple();
+    auto log_store = logstore_service().create_new_log_store(logdev_id, true /* append_mode */);
+
+    LOGINFO("Step 2: Append records from multiple threads before flushing and validate they are all written");
+    const unsigned count_per_thread{200};
+    const unsigned nthreads{4};
+    std::atomic< unsigned > completed{0};
+    std::vector< std::thread > threads;
+    for (unsigned t{0}; t < nthreads; ++t) {
+        threads.emplace_back([&]() {
+            for (unsigned i{0}; i < count_per_thread; ++i) {
+                auto* buf = new std::string(16, 'x');
+                log_store->append_async(sisl::io_blob{r_cast< uint8_t* >(buf->data()), uint32_cast(buf->size()), false},
+                                        buf, [&completed](logstore_seq_num_t, sisl::io_blob&, logdev_key, void* ctx) {
+                                            delete r_cast< std::string* >(ctx);
+                                            completed.fetch_add(1);
+                                        });
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    log_store->flush();
+    while (completed.load() != count_per_thread * nthreads) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+
+    for (logstore_seq_num_t lsn{0}; lsn < count_per_thread * nthreads; ++lsn) {
+        auto b = log_store->read_sync(lsn);
+        ASSERT_EQ(std::string(r_cast< const char* >(b.bytes()), b.size()), std::string(16, 'x'));
+    }
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.logstore.inflight_records_ring_size = 8192; });
+    HS_SETTINGS_FACTORY().save();
+}
+
+TEST_F(LogDevTest, TruncateManyStores) {
+    LOGINFO("Step 1: Create many logstores in a logdev and insert records into all of them");
+    auto logdev_id = logstore_service().create_new_logdev();
+    s_max_flush_multiple = logstore_service().get_logdev(logdev_id)->get_flush_size_multiple();
+    const unsigned nstores{32};
+    const logstore_seq_num_t nrecords{60};
+    std::vector< std::shared_ptr< HomeLogStore > > stores;
+    for (unsigned i{0}; i < nstores; ++i) {
+        stores.push_back(logstore_service().create_new_log_store(logdev_id, false));
+        logstore_seq_num_t lsn{0};
+        kickstart_inserts(stores.back(), lsn, nrecords);
+    }
+
+    auto restart = [&]() {
+        std::promise< bool > p;
+        std::vector< logstore_id_t > ids;
+        for (auto const& s : stores) {
+            ids.push_back(s->get_store_id());
+        }
+        auto starting_cb = [&]() {
+            logstore_service().open_logdev(logdev_id);
+            for (size_t i{0}; i < ids.size(); ++i) {
+                logstore_service().open_log_store(logdev_id, ids[i], false).thenValue([&stores, i](auto store) {
+                    stores[i] = store;
+                });
+            }
+            p.set_value(true);
+        };
+        start_homestore(true /* restart */, starting_cb);
+        p.get_future().get();
+    };
+
+    LOGINFO("Step 2: Truncate only every 4th store and device truncate repeatedly, with rest unchanged");
+    for (logstore_seq_num_t upto{9}; upto < nrecords - 10; upto += 10) {
+        for (unsigned i{0}; i < nstores; i += 4) {
+            stores[i]->truncate(upto);
+        }
+        logstore_service().device_truncate();
+    }
+
+    LOGINFO("Step 3: Restart and validate the truncation points of all the stores are as expected");
+    restart();
+    for (unsigned i{0}; i < nstores; ++i) {
+        auto const expected_trunc = (i % 4 == 0) ? nrecords - 11 : logstore_seq_num_t{-1};
+        ASSERT_EQ(stores[i]->truncated_upto(), expected_trunc) << "Truncation point mismatch for store " << i;
+        for (auto lsn = expected_trunc + 1; lsn < nrecords; ++lsn) {
+            read_verify(stores[i], lsn);
+        }
+    }
+}
+
+TEST_F(LogDevTest, ReplayCheckpoint) {
+    LOGINFO("Step 1: Create a single logstore to start replay checkpoint test");
+    auto logdev_id = logstore_service().create_new_logdev();
+    s_max_flush_multiple = logstore_service().get_logdev(logdev_id)->get_flush_size_multiple();
+    auto log_store = logstore_service().create_new_log_store(logdev_id, false);
+    auto store_id = log_store->get_store_id();
+    std::atomic< uint32_t > nfound{0};
+
+    auto restart = [&]() {
+        std::promise< bool > p;
+        nfound = 0;
+        auto starting_cb = [&]() {
+            logstore_service().open_logdev(logdev_id);
+            logstore_service().open_log_store(logdev_id, store_id, false /* append_mode */).thenValue([&](auto store) {
+                log_store = store;
+                log_store->register_log_found_cb(
+                    [&nfound](logstore_seq_num_t, log_buffer, void*) { nfound.fetch_add(1); });
+                p.set_value(true);
+            });
+        };
+        start_homestore(true /* restart */, starting_cb);
+        p.get_future().get();
+    };
+
+    LOGINFO("Step 2: Issue 200 inserts and checkpoint the replay at lsn 149");
+    logstore_seq_num_t cur_lsn = 0;
+    kickstart_inserts(log_store, cur_lsn, 200);
+    log_store->set_replay_checkpoint(149);
+
+    LOGINFO("Step 3: Restart and validate only the records after the checkpoint are replayed");
+    restart();
+    ASSERT_EQ(nfound.load(), 50u) << "Records upto the replay checkpoint are not expected to be replayed";
+    ASSERT_EQ(log_store->truncated_upto(), 149);
+    ASSERT_THROW(log_store->read_sync(149), std::out_of_range);
+    for (logstore_seq_num_t lsn{150}; lsn < cur_lsn; ++lsn) {
+        read_verify(log_store, lsn);
+    }
+
+    LOGINFO("Step 4: Insert more on the recovered store and validate they are recovered along with the rest");
+    kickstart_inserts(log_store, cur_lsn, 100);
+    restart();
+    ASSERT_EQ(nfound.load(), 150u);
+    for (logstore_seq_num_t lsn{150}; lsn < cur_lsn; ++lsn) {
+        read_verify(log_store, lsn);
+    }
+
+    LOGINFO("Step 5: Truncate beyond the checkpoint and validate the replay starts from the truncation point");
+    log_store->truncate(249);
+    logstore_service().device_truncate();
+    restart();
+    ASSERT_EQ(nfound.load(), 50u);
+    for (logstore_seq_num_t lsn{250}; lsn < cur_lsn; ++lsn) {
+        read_verify(log_store, lsn);
+    }
+}
+
+TEST_F(LogDevTest, CompressedRecords) {
+    LOGINFO("Step 1: Turn on compression of the records of atleast 64 bytes");
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.logstore.record_compression_min_size = 64; });
+    HS_SETTINGS_FACTORY().save();
+
+    auto logdev_id = logstore_service().create_new_logdev();
+    s_max_flush_multiple = logstore_service().get_logdev(logdev_id)->get_flush_size_multiple();
+    auto log_store = logstore_service().create_new_log_store(logdev_id, false);
+    auto store_id = log_store->get_store_id();
+
+    auto restart = [&]() {
+        std::promise< bool > p;
+        auto starting_cb = [&]() {
+            logstore_service().open_logdev(logdev_id);
+            logstore_service().open_log_store(logdev_id, store_id, false /* append_mode */).thenValue([&](auto store) {
+                log_store = store;
+                p.set_value(true);
+            });
+        };
+        start_homestore(true /* restart */, starting_cb);
+        p.get_future().get();
+    };
+
+    LOGINFO("Step 2: Insert records, which are filled with same byte and so compress well, and read them back");
+    logstore_seq_num_t cur_lsn = 0;
+    kickstart_inserts(log_store, cur_lsn, 200);
+    for (logstore_seq_num_t lsn{0}; lsn < cur_lsn; ++lsn) {
+        read_verify(log_store, lsn);
+    }
+
+    LOGINFO("Step 3: Turn off compression, insert more and validate both are recovered after restart");
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.logstore.record_compression_min_size = 0; });
+    HS_SETTINGS_FACTORY().save();
+    kickstart_inserts(log_store, cur_lsn, 100);
+    restart();
+    for (logstore_seq_num_t lsn{0}; lsn < cur_lsn; ++lsn) {
+        read_verify(log_store, lsn);
+    }
+}
+
+TEST_F(LogDevTest, TailCache) {
+    LOGINFO("Step 1: Turn on the tail cache of 1MB, which is small enough to evict the groups");
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.logstore.tail_cache_size_mb = 1; });
+    HS_SETTINGS_FACTORY().save();
+
+    auto logdev_id = logstore_service().create_new_logdev();
+    s_max_flush_multiple = logstore_service().get_logdev(logdev_id)->get_flush_size_multiple();
+    auto log_store = logstore_service().create_new_log_store(logdev_id, false);
+    auto store_id = log_store->get_store_id();
+
+    auto restart = [&]() {
+        std::promise< bool > p;
+        auto starting_cb = [&]() {
+            logstore_service().open_logdev(logdev_id);
+            logstore_service().open_log_store(logdev_id, store_id, false /* append_mode */).thenValue([&](auto store) {
+                log_store = store;
+                p.set_value(true);
+            });
+        };
+        start_homestore(true /* restart */, starting_cb);
+        p.get_future().get();
+    };
+
+    LOGINFO("Step 2: Insert records and read all of them back, both the cached and the evicted ones");
+    logstore_seq_num_t cur_lsn = 0;
+    kickstart_inserts(log_store, cur_lsn, 1000);
+    for (logstore_seq_num_t lsn{0}; lsn < cur_lsn; ++lsn) {
+        read_verify(log_store, lsn);
+    }
+
+    LOGINFO("Step 3: Truncate half of them and validate the rest are still read correctly");
+    log_store->truncate(499);
+    logstore_service().device_truncate();
+    for (logstore_seq_num_t lsn{500}; lsn < cur_lsn; ++lsn) {
+        read_verify(log_store, lsn);
+    }
+
+    LOGINFO("Step 4: Restart, which starts with an empty cache, insert more and validate all of them");
+    restart();
+    kickstart_inserts(log_store, cur_lsn, 200);
+    for (logstore_seq_num_t lsn{500}; lsn < cur_lsn; ++lsn) {
+        read_verify(log_store, lsn);
+    }
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.logstore.tail_cache_size_mb = 0; });
+    HS_SETTINGS_FACTORY().save();
+}
+
+TEST_F(LogDevTest, PackedGroupTail) {
+    LOGINFO("Step 1: Turn on packing of the log groups after the partially filled last page of the previous group");
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.logstore.pack_log_group_tail = true; });
+    HS_SETTINGS_FACTORY().save();
+
+    auto logdev_id = logstore_service().create_new_logdev();
+    s_max_flush_multiple = logstore_service().get_logdev(logdev_id)->get_flush_size_multiple();
+    auto log_store = logstore_service().create_new_log_store(logdev_id, false);
+    auto store_id = log_store->get_store_id();
+
+    auto restart = [&]() {
+        std::promise< bool > p;
+        auto starting_cb = [&]() {
+            logstore_service().open_logdev(logdev_id);
+            logstore_service().open_log_store(logdev_id, store_id, false /* append_mode */).thenValue([&](auto store) {
+                log_store = store;
+                p.set_value(true);
+            });
+        };
+        start_homestore(true /* restart */, starting_cb);
+        p.get_future().get();
+    };
+
+    LOGINFO("Step 2: Flush small records one at a time, so that many groups share a page, and read them back");
+    logstore_seq_num_t cur_lsn = 0;
+    kickstart_inserts(log_store, cur_lsn, 200, 64 /* fixed_size */);
+    for (logstore_seq_num_t lsn{0}; lsn < cur_lsn; ++lsn) {
+        read_verify(log_store, lsn);
+    }
+
+    LOGINFO("Step 3: Mix in records of random sizes, which are not packed, and validate all of them after restart");
+    kickstart_inserts(log_store, cur_lsn, 100);
+    kickstart_inserts(log_store, cur_lsn, 100, 64 /* fixed_size */);
+    restart();
+    for (logstore_seq_num_t lsn{0}; lsn < cur_lsn; ++lsn) {
+        read_verify(log_store, lsn);
+    }
+
+    LOGINFO("Step 4: Truncate in the middle of the packed groups, turn off packing and validate the replay after it");
+    log_store->truncate(349);
+    logstore_service().device_truncate();
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.logstore.pack_log_group_tail = false; });
+    HS_SETTINGS_FACTORY().save();
+    kickstart_inserts(log_store, cur_lsn, 50, 64 /* fixed_size */);
+    restart();
+    for (logstore_seq_num_t lsn{350}; lsn < cur_lsn; ++lsn) {
+        read_verify(log_store, lsn);
+    }
+}
+
+TEST_F(LogDevTest, ReplayReadAhead) {
+    LOGINFO("Step 1: Shrink the read ahead size, so that replay reads in many steps and groups span over the reads");
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.logstore.bulk_read_size = 8192; });
+    HS_SETTINGS_FACTORY().save();
+
+    auto logdev_id = logstore_service().create_new_logdev();
+    s_max_flush_multiple = logstore_service().get_logdev(logdev_id)->get_flush_size_multiple();
+    auto log_store = logstore_service().create_new_log_store(logdev_id, false);
+    auto store_id = log_store->get_store_id();
+
+    auto restart = [&]() {
+        std::promise< bool > p;
+        auto starting_cb = [&]() {
+            logstore_service().open_logdev(logdev_id);
+            logstore_service().open_log_store(logdev_id, store_id, false /* append_mode */).thenValue([&](auto store) {
+                log_store = store;
+                p.set_value(true);
+            });
+        };
+        start_homestore(true /* restart */, starting_cb);
+        p.get_future().get();
+    };
+
+    LOGINFO("Step 2: Insert small records and records bigger than the read size, enough to span over chunks");
+    logstore_seq_num_t cur_lsn = 0;
+    kickstart_inserts(log_store, cur_lsn, 200);
+    kickstart_inserts(log_store, cur_lsn, 500, 20000 /* fixed_size */);
+    kickstart_inserts(log_store, cur_lsn, 200);
+
+    LOGINFO("Step 3: Restart and validate all of them are replayed");
+    restart();
+    for (logstore_seq_num_t lsn{0}; lsn < cur_lsn; ++lsn) {
+        read_verify(log_store, lsn);
+    }
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.logstore.bulk_read_size = 524288; });
+    HS_SETTINGS_FACTORY().save();
+}
+
+TEST_F(LogDevTest, PinFlush) {
+    LOGINFO("Step 1: Create a logdev and validate it is on one of the flush threads");
+    auto logdev_id = logstore_service().create_new_logdev();
+    auto logdev = logstore_service().get_logdev(logdev_id);
+    s_max_flush_multiple = logdev->get_flush_size_multiple();
+    auto log_store = logstore_service().create_new_log_store(logdev_id, false);
+    ASSERT_EQ(logdev->flush_fiber(), logstore_service().flush_thread(logdev_id));
+    ASSERT_NE(logdev->get_status(0)["flush_thread"].get< std::string >(), "pinned");
+
+    LOGINFO("Step 2: Pin the flushes to a worker fiber and insert records and read them back");
+    iomgr::io_fiber_t worker_fiber{nullptr};
+    iomanager.run_on_wait(iomgr::reactor_regex::random_worker, [&worker_fiber]() {
+        worker_fiber = iomanager.iofiber_self();
+    });
+    logstore_service().pin_logdev_flush(logdev_id, worker_fiber);
+    ASSERT_EQ(logdev->flush_fiber(), worker_fiber);
+    ASSERT_EQ(logdev->get_status(0)["flush_thread"].get< std::string >(), "pinned");
+
+    logstore_seq_num_t cur_lsn = 0;
+    kickstart_inserts(log_store, cur_lsn, 100);
+    for (logstore_seq_num_t lsn{0}; lsn < cur_lsn; ++lsn) {
+        read_verify(log_store, lsn);
+    }
+
+    LOGINFO("Step 3: Unpin it and validate it is back on its flush thread");
+    logstore_service().pin_logdev_flush(logdev_id, nullptr);
+    ASSERT_EQ(logdev->flush_fiber(), logstore_service().flush_thread(logdev_id));
+    kickstart_inserts(log_store, cur_lsn, 100);
+    for (logstore_seq_num_t lsn{0}; lsn < cur_lsn; ++lsn) {
+        read_verify(log_store, lsn);
+    }
+}
+
+TEST_F(LogDevTest, LeaderFollowerFlush) {
+    LOGINFO("Step 1: Turn on inline and timer flushes with leader/follower group commit");
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.logstore.flush_mode = 3;
+        s.logstore.flush_leader_follower = true;
+    });
+    HS_SETTINGS_FACTORY().save();
+
+    for (auto const inflight_groups : {1u, 4u}) {
+        LOGINFO("Step 2: Append from worker fibers, with {} log groups in flight, and wait for all of them to complete "
+                "with neither an explicit flush nor a wakeup of the flush thread from the appenders",
+                inflight_groups);
+        HS_SETTINGS_FACTORY().modifiable_settings(
+            [inflight_groups](auto& s) { s.logstore.max_inflight_log_groups = inflight_groups; });
+        HS_SETTINGS_FACTORY().save();
+
+        auto logdev_id = logstore_service().create_new_logdev();
+        s_max_flush_multiple = logstore_service().get_logdev(logdev_id)->get_flush_size_multiple();
+        auto log_store = logstore_service().create_new_log_store(logdev_id, false);
+
+        const logstore_seq_num_t count{1000};
+        std::vector< test_log_data* > datas(count);
+        std::vector< bool > io_memories(count);
+        std::atomic< logstore_seq_num_t > completed{0};
+        std::promise< bool > p;
+        for (logstore_seq_num_t lsn{0}; lsn < count; ++lsn) {
+            bool io_memory{false};
+            datas[lsn] = prepare_data(lsn, io_memory, 64 /* fixed_size */);
+            io_memories[lsn] = io_memory;
+        }
+        for (logstore_seq_num_t lsn{0}; lsn < count; ++lsn) {
+            iomanager.run_on_forget(iomgr::reactor_regex::random_worker, [&, lsn]() {
+                auto* d = datas[lsn];
+                log_store->write_async(lsn, {uintptr_cast(d), d->total_size(), false}, nullptr,
+                                       [&](logstore_seq_num_t, const sisl::io_blob&, logdev_key, void*) {
+                                           if (completed.fetch_add(1) + 1 == count) { p.set_value(true); }
+                                       });
+            });
+        }
+        p.get_future().get();
+
+        for (logstore_seq_num_t lsn{0}; lsn < count; ++lsn) {
+            read_verify(log_store, lsn);
+        }
+        for (logstore_seq_num_t lsn{0}; lsn < count; ++lsn) {
+            if (io_memories[lsn]) {
+                iomanager.iobuf_free(uintptr_cast(datas[lsn]));
+            } else {
+                std::free(voidptr_cast(datas[lsn]));
+            }
+        }
+    }
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.logstore.flush_mode = 4;
+        s.logstore.flush_leader_follower = false;
+        s.logstore.max_inflight_log_groups = 1;
+    });
+    HS_SETTINGS_FACTORY().save();
+}
+
+TEST_F(LogDevTest, ReadRange) {
+    LOGINFO("Step 1: Create a single logstore and insert records");
+    auto logdev_id = logstore_service().create_new_logdev();
+    s_max_flush_multiple = logstore_service().get_logdev(logdev_id)->get_flush_size_multiple();
+    auto log_store = logstore_service().create_new_log_store(logdev_id, false);
+
+    logstore_seq_num_t cur_lsn = 0;
+    kickstart_inserts(log_store, cur_lsn, 500);
+
+    auto range_verify = [&](logstore_seq_num_t start, logstore_seq_num_t end, size_t expected_count) {
+        auto const bufs = log_store->async_read_range(start, end).get();
+        ASSERT_EQ(bufs.size(), expected_count) << "Range read count mismatch for " << start << "-" << end;
+        for (size_t i{0}; i < bufs.size(); ++i) {
+            auto const lsn = start + int64_cast(i);
+            auto* d = r_cast< test_log_data const* >(bufs[i].bytes());
+            ASSERT_EQ(d->total_size(), bufs[i].size()) << "Size Mismatch for lsn=" << lsn;
+            validate_data(log_store, d, lsn);
+        }
+    };
+
+    LOGINFO("Step 2: Read the whole range, a range in the middle and a range going beyond what is written");
+    range_verify(0, cur_lsn - 1, 500);
+    range_verify(123, 321, 199);
+    range_verify(450, 600, 50);
+
+    LOGINFO("Step 3: Truncate and validate range reads of truncated and remaining records");
+    log_store->truncate(199);
+    logstore_service().device_truncate();
+    ASSERT_THROW(log_store->async_read_range(100, 300).get(), std::out_of_range);
+    range_verify(200, cur_lsn - 1, 300);
+}
+
 TEST_F(LogDevTest, Rollback) {
     LOGINFO("Step 1: Create a single logstore to start rollback test");
     auto logdev_id = logstore_service().create_new_logdev();
@@ -273,6 +827,7 @@ TEST_F(LogDevTest, Rollback) {
 
     LOGINFO("Step 5: Rollback again for 75 entries even before previous rollback entry");
     rollback_validate(log_store, cur_lsn, 75); // Last entry = 400
+    rollback_records_validate(log_store, 1 /* expected_count */); // Covers the first rollback, so both are merged
 
     LOGINFO("Step 6: Append 25 entries after second rollback is completed");
     kickstart_inserts(log_store, cur_lsn, 25); // Last entry = 425
@@ -358,6 +913,63 @@ TEST_F(LogDevTest, CreateRemoveLogDev) {
     ASSERT_EQ(logstore_service().used_size(), 0);
 }
 
+TEST_F(LogDevTest, LazyRecovery) {
+    auto const num_logdev = SISL_OPTIONS["num_logdevs"].as< uint32_t >();
+    std::vector< logdev_id_t > logdev_ids;
+    std::vector< logstore_id_t > store_ids;
+    std::vector< std::shared_ptr< HomeLogStore > > log_stores;
+    for (uint32_t i{0}; i < num_logdev; ++i) {
+        auto id = logstore_service().create_new_logdev();
+        s_max_flush_multiple = logstore_service().get_logdev(id)->get_flush_size_multiple();
+        auto store = logstore_service().create_new_log_store(id, false);
+        logdev_ids.push_back(id);
+        store_ids.push_back(store->get_store_id());
+        log_stores.push_back(store);
+    }
+
+    LOGINFO("Step 1: Insert 100 records to each log store");
+    for (auto& log_store : log_stores) {
+        logstore_seq_num_t cur_lsn = 0;
+        kickstart_inserts(log_store, cur_lsn, 100);
+    }
+
+    LOGINFO("Step 2: Restart with the lazy recovery, log stores are opened before start as usual");
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.logstore.lazy_recovery = true; });
+    HS_SETTINGS_FACTORY().save();
+    std::vector< std::promise< std::shared_ptr< HomeLogStore > > > opened(num_logdev);
+    auto starting_cb = [&]() {
+        for (uint32_t i{0}; i < num_logdev; ++i) {
+            logstore_service().open_logdev(logdev_ids[i]);
+            logstore_service()
+                .open_log_store(logdev_ids[i], store_ids[i], false /* append_mode */)
+                .thenValue([&opened, i](auto store) { opened[i].set_value(store); });
+        }
+    };
+    start_homestore(true /* restart */, starting_cb);
+
+    LOGINFO("Step 3: Access the last logdev, which is replayed right away if it is still pending");
+    logstore_service().recover_logdev(logdev_ids.back());
+    auto last_store = opened.back().get_future().get();
+    for (logstore_seq_num_t lsn{0}; lsn < 100; ++lsn) {
+        read_verify(last_store, lsn);
+    }
+
+    LOGINFO("Step 4: Validate the rest are replayed in the background");
+    for (uint32_t i{0}; i + 1 < num_logdev; ++i) {
+        auto store = opened[i].get_future().get();
+        for (logstore_seq_num_t lsn{0}; lsn < 100; ++lsn) {
+            read_verify(store, lsn);
+        }
+    }
+    while (logstore_service().num_pending_logdevs() != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(logstore_service().get_all_logdevs().size(), num_logdev);
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.logstore.lazy_recovery = false; });
+    HS_SETTINGS_FACTORY().save();
+}
+
 TEST_F(LogDevTest, DeleteUnopenedLogDev) {
     auto num_logdev = SISL_OPTIONS["num_logdevs"].as< uint32_t >();
     std::vector< std::shared_ptr< HomeLogStore > > log_stores;
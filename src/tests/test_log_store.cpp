@@ -1127,6 +1127,85 @@ TEST_F(LogStoreTest, ThrottleSeqInsertThenRecover) {
     }
 }
 
+TEST_F(LogStoreTest, AdaptiveFlush) {
+    LOGINFO("Step 1: Turn on adaptive flush, which sizes log groups by the rate of inserts")
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.logstore.flush_adaptive = true; });
+    HS_SETTINGS_FACTORY().save();
+
+    LOGINFO("Step 2: Reinit the 1000 records to start sequential write test");
+    this->init(1000);
+
+    LOGINFO("Step 3: Issue sequential inserts with q depth of 1 and then of 30");
+    this->kickstart_inserts(1, 1);
+    this->wait_for_inserts();
+    this->init(1000);
+    this->kickstart_inserts(1, 30);
+    this->wait_for_inserts();
+
+    LOGINFO("Step 4: Read all the inserts one by one for each log store to validate if what is written is valid");
+    this->read_validate(true);
+
+    LOGINFO("Step 5: Reset the settings back")
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.logstore.flush_adaptive = false; });
+    HS_SETTINGS_FACTORY().save();
+}
+
+TEST_F(LogStoreTest, PipelinedFlush) {
+    LOGINFO("Step 1: Restart with 4 log groups which can be in flight at once");
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.logstore.max_inflight_log_groups = 4; });
+    HS_SETTINGS_FACTORY().save();
+    SampleDB::instance().start_homestore(true);
+    this->recovery_validate();
+
+    LOGINFO("Step 2: Issue sequential inserts with q depth of 30");
+    this->init(2000);
+    this->kickstart_inserts(1, 30);
+    this->wait_for_inserts();
+
+    LOGINFO("Step 3: Read all the inserts one by one for each log store to validate if what is written is valid");
+    this->read_validate(true);
+
+    LOGINFO("Step 4: Restart to validate recovery of the log groups written in parallel");
+    SampleDB::instance().start_homestore(true);
+    this->recovery_validate();
+    this->init(2000);
+
+    LOGINFO("Step 5: Reset the settings back and restart")
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.logstore.max_inflight_log_groups = 1; });
+    HS_SETTINGS_FACTORY().save();
+    SampleDB::instance().start_homestore(true);
+    this->recovery_validate();
+}
+
+TEST_F(LogStoreTest, ParallelReplay) {
+    LOGINFO("Step 1: Issue sequential inserts with q depth of 30 across all the log stores");
+    this->init(5000);
+    this->kickstart_inserts(1, 30);
+    this->wait_for_inserts();
+
+    LOGINFO("Step 2: Restart with 4 replay fibers and validate if all the records are recovered in order");
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.logstore.replay_parallelism = 4;
+        s.logstore.bulk_read_size = 65536; // Smaller batches so that reads and replays overlap
+    });
+    HS_SETTINGS_FACTORY().save();
+    SampleDB::instance().start_homestore(true);
+    this->recovery_validate();
+    this->init(5000);
+
+    LOGINFO("Step 3: Read all the inserts one by one for each log store to validate if what is replayed is valid");
+    this->read_validate(true);
+
+    LOGINFO("Step 4: Reset the settings back and restart")
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.logstore.replay_parallelism = 0;
+        s.logstore.bulk_read_size = 524288;
+    });
+    HS_SETTINGS_FACTORY().save();
+    SampleDB::instance().start_homestore(true);
+    this->recovery_validate();
+}
+
 TEST_F(LogStoreTest, FlushSync) {
     LOGINFO("Step 1: Delay the flush threshold and flush timer to very high value to ensure flush works fine")
     HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
@@ -1258,6 +1337,51 @@ TEST_F(LogStoreTest, WriteSyncThenRead) {
     }
 }
 
+TEST(LogRecordIndexTest, CreateCompleteTruncate) {
+    LogRecordIndex idx{-1};
+    auto const nrecs = int64_cast(LogRecordIndex::s_chunk_slots * 3 + 10);
+    for (int64_t lsn{0}; lsn < nrecs; ++lsn) {
+        idx.create(lsn);
+    }
+    ASSERT_EQ(idx.active_upto(), nrecs - 1);
+    ASSERT_EQ(idx.completed_upto(), -1);
+    ASSERT_TRUE(idx.status(5).is_active);
+    ASSERT_TRUE(idx.status(nrecs).is_hole);
+
+    // Complete all but one, some with keys which are kept on the side
+    for (int64_t lsn{0}; lsn < nrecs; ++lsn) {
+        if (lsn == 2000) { continue; }
+        logdev_key const key{1000 + lsn, 4096 * (lsn / 16)};
+        logdev_key const trunc_key =
+            (lsn % 100 == 0) ? logdev_key{lsn, 7} : logdev_key{1000 + (lsn / 16) * 16, key.dev_offset};
+        idx.complete(lsn, logstore_record{key, trunc_key});
+    }
+    ASSERT_EQ(idx.completed_upto(), 1999);
+    ASSERT_EQ(idx.completed_upto(2001), nrecs - 1);
+    ASSERT_EQ(idx.at(1234).m_dev_key.idx, 2234);
+    ASSERT_EQ(idx.at(1234).m_dev_key.dev_offset, 4096 * (1234 / 16));
+    ASSERT_EQ(idx.at(1234).m_trunc_key.idx, 1000 + 1232);
+    ASSERT_EQ(idx.at(1300).m_trunc_key.dev_offset, 7);
+    ASSERT_FALSE(idx.at(2000).m_dev_key.is_valid());
+
+    int64_t n{0};
+    idx.foreach_all_completed(100, [&n](int64_t lsn, const logstore_record& rec) -> bool {
+        EXPECT_EQ(rec.m_dev_key.idx, 1000 + lsn);
+        ++n;
+        return true;
+    });
+    ASSERT_EQ(n, 1900);
+
+    idx.truncate(LogRecordIndex::s_chunk_slots * 2 + 5);
+    ASSERT_TRUE(idx.status(LogRecordIndex::s_chunk_slots).is_out_of_range);
+    ASSERT_EQ(idx.get_status(0)["num_chunks"], 2);
+    ASSERT_EQ(idx.at(nrecs - 1).m_dev_key.idx, 1000 + nrecs - 1);
+
+    idx.rollback(nrecs - 5);
+    ASSERT_TRUE(idx.status(nrecs - 4).is_hole);
+    ASSERT_EQ(idx.completed_upto(), nrecs - 5);
+}
+
 SISL_OPTIONS_ENABLE(logging, test_log_store, iomgr, test_common_setup)
 SISL_OPTION_GROUP(test_log_store,
                   (num_logdevs, "", "num_logdevs", "number of log devs",
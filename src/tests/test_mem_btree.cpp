@@ -84,6 +84,14 @@ struct VarObjSizeBtreeTest {
     static constexpr btree_node_type interior_node_type = btree_node_type::VAR_OBJECT;
 };
 
+struct CompactBtreeTest {
+    using BtreeType = MemBtree< TestVarLenKey, TestVarLenValue >;
+    using KeyType = TestVarLenKey;
+    using ValueType = TestVarLenValue;
+    static constexpr btree_node_type leaf_node_type = btree_node_type::COMPACT;
+    static constexpr btree_node_type interior_node_type = btree_node_type::COMPACT;
+};
+
 struct PrefixIntervalBtreeTest {
     using BtreeType = MemBtree< TestIntervalKey, TestIntervalValue >;
     using KeyType = TestIntervalKey;
@@ -108,7 +116,7 @@ struct BtreeTest : public BtreeTestHelper< TestType >, public ::testing::Test {
 
 // TODO Enable PrefixIntervalBtreeTest later
 using BtreeTypes = testing::Types< /* PrefixIntervalBtreeTest, */ FixedLenBtreeTest, VarKeySizeBtreeTest,
-                                   VarValueSizeBtreeTest, VarObjSizeBtreeTest >;
+                                   VarValueSizeBtreeTest, VarObjSizeBtreeTest, CompactBtreeTest >;
 TYPED_TEST_SUITE(BtreeTest, BtreeTypes);
 
 TYPED_TEST(BtreeTest, SequentialInsert) {
@@ -137,10 +145,14 @@ TYPED_TEST(BtreeTest, SequentialInsert) {
 
     LOGINFO("Step 6: Query all entries and validate with pagination of 80 entries");
     this->query_all_paginate(80);
+    this->cursor_scan(0, num_entries - 1, 80);
+    this->cursor_scan(num_entries / 3, num_entries + 10, 33, true /* zero_copy */);
 
     LOGINFO("Step 7: Get all entries 1-by-1 and validate them");
     this->get_all();
     this->get_any(num_entries - 3, num_entries + 1);
+    this->multi_get(0, num_entries - 1);
+    this->multi_get(0, num_entries + 10, 7);
 
     // Negative cases
     LOGINFO("Step 8: Do incorrect input and validate errors");
@@ -148,6 +160,98 @@ TYPED_TEST(BtreeTest, SequentialInsert) {
     this->get_any(num_entries + 1, num_entries + 2);
 }
 
+TYPED_TEST(BtreeTest, BulkLoad) {
+    const auto num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+    LOGINFO("Step 1: Bulk load {} entries with every other key", num_entries / 2);
+    this->bulk_load(0, num_entries - 1, 2);
+
+    LOGINFO("Step 2: Query all entries and validate with pagination of 80 entries");
+    this->query_all_paginate(80);
+    this->get_all();
+    this->multi_get(0, num_entries - 1, 3);
+
+    LOGINFO("Step 3: Insert the missing keys on top of bulk loaded tree and validate");
+    for (uint32_t i{1}; i < num_entries; i += 2) {
+        this->put(i, btree_put_type::INSERT);
+    }
+    this->query_all();
+}
+
+TYPED_TEST(BtreeTest, OptimisticGet) {
+    // Optimistic reads are silently turned off by btree for anything other than fixed nodes
+    this->m_cfg.m_optimistic_reads = true;
+    this->m_bt = std::make_shared< typename TypeParam::BtreeType >(this->m_cfg);
+
+    const auto num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+    for (uint32_t i{0}; i < num_entries; i += 2) {
+        this->put(i, btree_put_type::INSERT);
+    }
+    this->get_all();
+    for (uint32_t i{1}; i < num_entries; i += 2) {
+        this->get_specific(i);
+    }
+
+    // Removes merge and free the nodes, which are reclaimed only after no optimistic reader can reach them
+    for (uint32_t i{0}; i < num_entries / 2; i += 2) {
+        this->remove_one(i);
+    }
+    this->get_all();
+}
+
+TYPED_TEST(BtreeTest, InterpolationSearch) {
+    // Only nodes with integer keys use interpolation, rest of them silently continue with binary search
+    this->m_cfg.m_interpolation_search = true;
+    this->m_bt = std::make_shared< typename TypeParam::BtreeType >(this->m_cfg);
+
+    // Mix of evenly spread and clustered keys, so that both interpolation and its fallback are exercised
+    const auto num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+    for (uint32_t i{0}; i < num_entries / 2; i += 3) {
+        this->put(i, btree_put_type::INSERT);
+    }
+    for (uint32_t i{num_entries / 2}; i < num_entries; i += 97) {
+        for (uint32_t j{i}; (j < i + 5) && (j < num_entries); ++j) {
+            this->put(j, btree_put_type::INSERT);
+        }
+    }
+    this->get_all();
+    for (uint32_t i{1}; i < num_entries; i += 7) {
+        this->get_specific(i);
+    }
+    this->do_query(0, num_entries - 1, 79);
+}
+
+TYPED_TEST(BtreeTest, LargerLeafNodes) {
+    this->m_cfg.m_leaf_node_size = 4 * this->m_cfg.node_size();
+    this->m_bt = std::make_shared< typename TypeParam::BtreeType >(this->m_cfg);
+
+    const auto num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+    for (uint32_t i{0}; i < num_entries; ++i) {
+        this->put(i, btree_put_type::INSERT);
+    }
+    this->get_all();
+    for (uint32_t i{0}; i < num_entries; i += 2) {
+        this->remove_one(i);
+    }
+    this->do_query(0, num_entries - 1, 75);
+}
+
+TYPED_TEST(BtreeTest, DescentPrefetch) {
+    this->m_cfg.m_descent_prefetch = true;
+    this->m_bt = std::make_shared< typename TypeParam::BtreeType >(this->m_cfg);
+
+    const auto num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+    for (uint32_t i{0}; i < num_entries; ++i) {
+        this->put(i, btree_put_type::INSERT);
+    }
+    // Ranges spanning several leaves, so that the rest of the leaves of the range are read ahead
+    for (uint32_t i{0}; i < 100; ++i) {
+        this->range_put_random();
+    }
+    this->range_remove_existing(num_entries / 4, num_entries / 4);
+    this->get_all();
+    this->do_query(0, num_entries - 1, 75);
+}
+
 TYPED_TEST(BtreeTest, SequentialRemove) {
     // Forward sequential insert
     const auto num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
@@ -210,6 +314,84 @@ TYPED_TEST(BtreeTest, RangeUpdate) {
     this->do_query(0, num_entries - 1, 75);
 }
 
+TYPED_TEST(BtreeTest, BatchRangeUpdate) {
+    const auto num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+    LOGINFO("Step 1: Do forward sequential insert for {} entries", num_entries);
+    for (uint32_t i{0}; i < num_entries; ++i) {
+        this->put(i, btree_put_type::INSERT);
+    }
+
+    LOGINFO("Step 2: Do batched range updates of many small adjacent ranges");
+    this->range_update_batch(0, num_entries - 1, 3, 1);
+    this->range_update_batch(num_entries / 4, num_entries / 2, 7, 0);
+
+    LOGINFO("Step 3: Query {} entries and validate with pagination of 75 entries", num_entries);
+    this->do_query(0, num_entries - 1, 75);
+}
+
+TYPED_TEST(BtreeTest, LazyMergeRemove) {
+    this->m_cfg.m_lazy_merge = true;
+    this->m_bt = std::make_shared< typename TypeParam::BtreeType >(this->m_cfg);
+
+    const auto num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+    LOGINFO("Step 1: Do forward sequential insert for {} entries", num_entries);
+    for (uint32_t i{0}; i < num_entries; ++i) {
+        this->put(i, btree_put_type::INSERT);
+    }
+
+    LOGINFO("Step 2: Remove most of the entries without merging any nodes inline");
+    for (uint32_t i{0}; i < num_entries; ++i) {
+        if (i % 8 != 0) { this->remove_one(i); }
+    }
+    this->get_all();
+
+    LOGINFO("Step 3: Merge all the marked underfull nodes in batches and validate");
+    btree_status_t ret;
+    do {
+        ret = this->m_bt->rebalance_underfull_nodes(4);
+        ASSERT_TRUE((ret == btree_status_t::success) || (ret == btree_status_t::has_more))
+            << "Rebalance of underfull nodes failed with ret=" << enum_name(ret);
+    } while (ret == btree_status_t::has_more);
+    this->get_all();
+    this->do_query(0, num_entries - 1, 75);
+}
+
+TYPED_TEST(BtreeTest, CursorAcrossMerge) {
+    using K = typename TestFixture::K;
+    const auto num_entries = SISL_OPTIONS["num_entries"].as< uint32_t >();
+    for (uint32_t i{0}; i < num_entries; ++i) {
+        this->put(i, btree_put_type::INSERT);
+    }
+
+    std::vector< K > yielded;
+    auto const collect = [&yielded](BtreeKey const& k, BtreeValue const&) {
+        yielded.emplace_back(s_cast< K const& >(k));
+        return true;
+    };
+
+    LOGINFO("Step 1: Yield the first few entries and leave the cursor on the first leaf");
+    BtreeCursor< K > cursor{BtreeKeyRange< K >{K{0u}, true, K{num_entries - 1}, true}};
+    ASSERT_EQ(this->m_bt->cursor_next(cursor, 5, collect), btree_status_t::has_more);
+
+    LOGINFO("Step 2: Remove the entries after them, so that the leaf of the cursor is merged away");
+    for (uint32_t i{5}; i < num_entries / 2; ++i) {
+        this->remove_one(i);
+    }
+
+    LOGINFO("Step 3: Resume the cursor and validate that it continues from the last entry it yielded");
+    btree_status_t ret;
+    do {
+        ret = this->m_bt->cursor_next(cursor, 50, collect);
+    } while (ret == btree_status_t::has_more);
+    ASSERT_EQ(ret, btree_status_t::success);
+
+    ASSERT_EQ(yielded.size(), 5 + num_entries - num_entries / 2) << "Cursor yielded unexpected number of entries";
+    for (uint32_t i{0}; i < yielded.size(); ++i) {
+        uint32_t const expected = (i < 5) ? i : (num_entries / 2 + i - 5);
+        ASSERT_EQ(yielded[i].compare(K{expected}), 0) << "Cursor yielded key=" << yielded[i].to_string() << " at " << i;
+    }
+}
+
 TYPED_TEST(BtreeTest, SimpleRemoveRange) {
     // Forward sequential insert
     const auto num_entries = 20;
@@ -322,6 +504,27 @@ TYPED_TEST(BtreeConcurrentTest, ConcurrentAllOps) {
     this->multi_op_execute(ops);
 }
 
+TYPED_TEST(BtreeConcurrentTest, ConcurrentBlinkSplits) {
+    // Leaves split without the parent write lock, so concurrent ops race with the splits pending in the parents
+    this->m_cfg.m_blink_splits = true;
+    this->m_bt = std::make_shared< typename TypeParam::BtreeType >(this->m_cfg);
+
+    auto ops = this->build_op_list({"put:40", "remove:10", "range_put:20", "query:30"});
+    this->multi_op_execute(ops);
+    this->get_all();
+}
+
+TYPED_TEST(BtreeConcurrentTest, ConcurrentSerializableQuery) {
+    // Queries hold the range locks across their pages, while the puts and removes write lock their keys
+    this->m_cfg.m_range_locks = true;
+    this->m_bt = std::make_shared< typename TypeParam::BtreeType >(this->m_cfg);
+    this->m_query_type = BtreeQueryType::SERIALIZABLE_QUERY;
+
+    auto ops = this->build_op_list({"put:40", "remove:20", "range_put:10", "query:30"});
+    this->multi_op_execute(ops);
+    this->get_all();
+}
+
 int main(int argc, char* argv[]) {
     ::testing::InitGoogleTest(&argc, argv);
     SISL_OPTIONS_LOAD(argc, argv, logging, test_mem_btree)
@@ -25,6 +25,7 @@
 #include <memory>
 #include <mutex>
 #include <random>
+#include <set>
 #include <string>
 #include <vector>
 #include <iomgr/io_environment.hpp>
@@ -112,6 +113,7 @@ public:
     std::vector< meta_sub_type > actual_on_complete_cb_order;
     std::vector< void* > cookies;
     bool enable_dependency_chain{false};
+    bool compressible_buf{false}; // repeat a short random pattern in generated buffers
     test_common::HSTestHelper m_helper;
 
     VMetaBlkMgrTest() = default;
@@ -165,7 +167,7 @@ public:
             std::default_random_engine re{rd()};
             std::uniform_int_distribution< size_t > alphanum_rand{0, alphanum.size() - 1};
             for (size_t i{0}; i < len - 1; ++i) {
-                s[i] = alphanum[alphanum_rand(re)];
+                s[i] = (compressible_buf && (i >= 64)) ? s[i % 64] : alphanum[alphanum_rand(re)];
             }
             s[len - 1] = 0;
         }
@@ -275,6 +277,147 @@ public:
         return ret_size_written;
     }
 
+    // Adds nadds sbs, updates the first existing sb and removes the last one, all committed in one batch
+    void do_sb_batch(uint32_t nadds) {
+        std::vector< uint8_t* > bufs;
+        std::vector< size_t > szs;
+        std::vector< void* > cookies(nadds, nullptr);
+        MetaBlkBatch batch;
+        for (uint32_t i{0}; i < nadds; ++i) {
+            ++m_wrt_cnt;
+            szs.push_back(rand_size(do_overflow()));
+            bufs.push_back(iomanager.iobuf_alloc(512, szs.back()));
+            gen_rand_buf(bufs.back(), szs.back());
+            batch.add_sub_sb(mtype, bufs.back(), szs.back(), cookies[i]);
+        }
+
+        void* upd_cookie{nullptr};
+        void* rm_cookie{nullptr};
+        uint8_t* upd_buf{nullptr};
+        size_t upd_sz{0};
+        {
+            std::unique_lock< std::mutex > lg{m_mtx};
+            if (m_write_sbs.size() >= 2) {
+                ++m_update_cnt;
+                ++m_rm_cnt;
+                upd_cookie = m_write_sbs.begin()->second.cookie;
+                rm_cookie = m_write_sbs.rbegin()->second.cookie;
+                m_total_wrt_sz -= total_size_written(upd_cookie) + total_size_written(rm_cookie);
+                m_write_sbs.erase(m_write_sbs.begin());
+                m_write_sbs.erase(std::prev(m_write_sbs.end()));
+
+                upd_sz = rand_size(do_overflow());
+                upd_buf = iomanager.iobuf_alloc(512, upd_sz);
+                gen_rand_buf(upd_buf, upd_sz);
+                batch.update_sub_sb(upd_buf, upd_sz, upd_cookie);
+                batch.remove_sub_sb(rm_cookie);
+            }
+        }
+
+        m_mbm->commit_batch(batch);
+        HS_DBG_ASSERT_EQ(batch.empty(), true);
+
+        std::unique_lock< std::mutex > lg{m_mtx};
+        auto const save = [this](void* cookie, const uint8_t* buf, size_t sz) {
+            HS_DBG_ASSERT_NE(cookie, nullptr);
+            const auto bid = s_cast< const meta_blk* >(cookie)->hdr.h.bid.to_integer();
+            HS_DBG_ASSERT(m_write_sbs.find(bid) == m_write_sbs.end(), "cookie already in the map.");
+            m_write_sbs[bid].cookie = cookie;
+            m_write_sbs[bid].str = md5_sum(r_cast< const char* >(buf), sz);
+            m_total_wrt_sz += total_size_written(cookie);
+        };
+        for (uint32_t i{0}; i < nadds; ++i) {
+            save(cookies[i], bufs[i], szs[i]);
+            iomanager.iobuf_free(bufs[i]);
+        }
+        if (upd_cookie) {
+            save(upd_cookie, upd_buf, upd_sz);
+            iomanager.iobuf_free(upd_buf);
+        }
+        HS_DBG_ASSERT(m_total_wrt_sz == m_mbm->used_size(), "Used size mismatch: {}/{}", m_total_wrt_sz,
+                      m_mbm->used_size());
+    }
+
+    // Issues nupdates async updates back to back to the same sb, only the last content is expected to be persisted
+    void do_sb_async_updates(uint32_t nupdates) {
+        void* cookie{nullptr};
+        {
+            std::unique_lock< std::mutex > lg{m_mtx};
+            auto it = m_write_sbs.begin();
+            cookie = it->second.cookie;
+            m_total_wrt_sz -= total_size_written(cookie);
+            m_write_sbs.erase(it);
+        }
+
+        std::vector< folly::Future< bool > > futs;
+        std::string last_str;
+        for (uint32_t i{0}; i < nupdates; ++i) {
+            ++m_update_cnt;
+            auto const sz = rand_size(do_overflow());
+            uint8_t* buf = iomanager.iobuf_alloc(512, sz);
+            gen_rand_buf(buf, sz);
+            futs.emplace_back(m_mbm->async_update_sub_sb(buf, sz, cookie));
+            last_str = md5_sum(r_cast< const char* >(buf), sz);
+            // content is copied by the async update, so the buffer can be freed right away
+            iomanager.iobuf_free(buf);
+        }
+
+        for (auto& t : folly::collectAllUnsafe(futs).get()) {
+            HS_REL_ASSERT_EQ(t.value(), true, "async update failed");
+        }
+
+        std::unique_lock< std::mutex > lg{m_mtx};
+        const auto bid = s_cast< const meta_blk* >(cookie)->hdr.h.bid.to_integer();
+        m_write_sbs[bid].cookie = cookie;
+        m_write_sbs[bid].str = last_str;
+        m_total_wrt_sz += total_size_written(cookie);
+        HS_DBG_ASSERT(m_total_wrt_sz == m_mbm->used_size(), "Used size mismatch: {}/{}", m_total_wrt_sz,
+                      m_mbm->used_size());
+    }
+
+    // Defers nupdates updates to each of nsbs sbs, which are expected to be flushed together with only the last
+    // content of each sb persisted. Flushed explicitly if flush_now, else by the periodic flush.
+    void do_sb_deferred_updates(uint32_t nsbs, uint32_t nupdates, bool flush_now) {
+        std::vector< void* > cookies;
+        {
+            std::unique_lock< std::mutex > lg{m_mtx};
+            for (auto it = m_write_sbs.begin(); (it != m_write_sbs.end()) && (cookies.size() < nsbs);) {
+                cookies.push_back(it->second.cookie);
+                m_total_wrt_sz -= total_size_written(it->second.cookie);
+                it = m_write_sbs.erase(it);
+            }
+        }
+
+        std::vector< folly::Future< bool > > futs;
+        std::vector< std::string > last_strs(cookies.size());
+        for (uint32_t u{0}; u < nupdates; ++u) {
+            for (size_t i{0}; i < cookies.size(); ++i) {
+                ++m_update_cnt;
+                auto const sz = rand_size(do_overflow());
+                uint8_t* buf = iomanager.iobuf_alloc(512, sz);
+                gen_rand_buf(buf, sz);
+                futs.emplace_back(m_mbm->defer_update_sub_sb(buf, sz, cookies[i]));
+                last_strs[i] = md5_sum(r_cast< const char* >(buf), sz);
+                iomanager.iobuf_free(buf);
+            }
+        }
+        if (flush_now) { m_mbm->flush_deferred_updates(); }
+
+        for (auto& t : folly::collectAllUnsafe(futs).get()) {
+            HS_REL_ASSERT_EQ(t.value(), true, "deferred update failed");
+        }
+
+        std::unique_lock< std::mutex > lg{m_mtx};
+        for (size_t i{0}; i < cookies.size(); ++i) {
+            const auto bid = s_cast< const meta_blk* >(cookies[i])->hdr.h.bid.to_integer();
+            m_write_sbs[bid].cookie = cookies[i];
+            m_write_sbs[bid].str = last_strs[i];
+            m_total_wrt_sz += total_size_written(cookies[i]);
+        }
+        HS_DBG_ASSERT(m_total_wrt_sz == m_mbm->used_size(), "Used size mismatch: {}/{}", m_total_wrt_sz,
+                      m_mbm->used_size());
+    }
+
     void do_sb_remove() {
         void* cookie{nullptr};
         size_t sz{0};
@@ -758,6 +901,25 @@ TEST_F(VMetaBlkMgrTest, single_read_test) {
     this->shutdown();
 }
 
+TEST_F(VMetaBlkMgrTest, read_cache_test) {
+    mtype = "Test_Read_Cache";
+    reset_counters();
+    m_start_time = Clock::now();
+    this->register_client();
+
+    EXPECT_GT(this->do_sb_write(true /* overflow */), uint64_cast(0));
+
+    // the 2nd read is served from the read cache
+    this->do_single_sb_read();
+    this->do_single_sb_read();
+
+    // the update drops the cached content, so the read after it must see the updated one
+    this->do_sb_update(true /* aligned */);
+    this->do_single_sb_read();
+
+    this->shutdown();
+}
+
 TEST_F(VMetaBlkMgrTest, random_dependency_test) {
     reset_counters();
     m_start_time = Clock::now();
@@ -870,6 +1032,209 @@ TEST_F(VMetaBlkMgrTest, random_load_test) {
     this->shutdown();
 }
 
+// 1. write sbs, then update them with back to back async updates which get coalesced;
+// 2. recovery test and verify only the latest content of each sb is found;
+TEST_F(VMetaBlkMgrTest, random_async_update_test) {
+    mtype = "Test_Rand_Async_Update";
+    reset_counters();
+    m_start_time = Clock::now();
+    register_client();
+
+    for (uint32_t i{0}; i < 10; ++i) {
+        EXPECT_GT(this->do_sb_write(do_overflow()), uint64_cast(0));
+    }
+    for (uint32_t i{0}; i < 20; ++i) {
+        this->do_sb_async_updates(1 + (i % 5));
+    }
+
+    this->recover_with_on_complete();
+
+    this->validate();
+
+    this->shutdown();
+}
+
+// 1. write sbs, then defer updates to them which are flushed together, explicitly or by the periodic flush;
+// 2. recovery test and verify only the latest content of each sb is found;
+TEST_F(VMetaBlkMgrTest, random_deferred_update_test) {
+    mtype = "Test_Rand_Deferred_Update";
+    reset_counters();
+    m_start_time = Clock::now();
+    register_client();
+
+    for (uint32_t i{0}; i < 20; ++i) {
+        EXPECT_GT(this->do_sb_write(do_overflow()), uint64_cast(0));
+    }
+    for (uint32_t i{0}; i < 10; ++i) {
+        this->do_sb_deferred_updates(1 + (i % 8), 1 + (i % 3), (i % 2) == 0 /* flush_now */);
+    }
+
+    this->recover_with_on_complete();
+
+    this->validate();
+
+    this->shutdown();
+}
+
+// 1. write a large sb, then change a few bytes of it at a time and update it rewriting only the changed pages;
+// 2. recovery test and verify the latest content is found;
+TEST_F(VMetaBlkMgrTest, random_delta_update_test) {
+    mtype = "Test_Rand_Delta_Update";
+    reset_counters();
+    m_start_time = Clock::now();
+    register_client();
+
+    static constexpr uint64_t sz{512 * Ki};
+    uint8_t* buf = iomanager.iobuf_alloc(512, sz);
+    gen_rand_buf(buf, sz);
+    void* cookie{nullptr};
+    m_mbm->add_sub_sb(mtype, buf, sz, cookie);
+    m_total_wrt_sz += total_size_written(cookie);
+
+    std::random_device rd;
+    std::default_random_engine re{rd()};
+    std::uniform_int_distribution< uint64_t > off_rand{0, sz - 2};
+    auto const page_sz = m_mbm->block_size();
+    for (uint32_t i{0}; i < 20; ++i) {
+        std::set< uint64_t > pages;
+        for (uint32_t j{0}; j < 3; ++j) {
+            auto const off = off_rand(re);
+            buf[off] = buf[off] + 1;
+            pages.insert(off / page_sz);
+        }
+        m_total_wrt_sz -= total_size_written(cookie);
+        m_mbm->update_sub_sb_delta(buf, sz, cookie, std::vector< uint64_t >(pages.begin(), pages.end()));
+        m_total_wrt_sz += total_size_written(cookie);
+        HS_DBG_ASSERT(m_total_wrt_sz == m_mbm->used_size(), "Used size mismatch: {}/{}", m_total_wrt_sz,
+                      m_mbm->used_size());
+    }
+
+    {
+        std::unique_lock< std::mutex > lg{m_mtx};
+        const auto bid = s_cast< const meta_blk* >(cookie)->hdr.h.bid.to_integer();
+        m_write_sbs[bid].cookie = cookie;
+        m_write_sbs[bid].str = md5_sum(r_cast< const char* >(buf), sz);
+    }
+    iomanager.iobuf_free(buf);
+
+    this->recover_with_on_complete();
+
+    this->validate();
+
+    this->shutdown();
+}
+
+// 1. update small sbs often enough to go through a few compactions of the update journal;
+// 2. remove a journaled sb and add a new one in its place;
+// 3. recovery test and verify callback context data matches;
+TEST_F(VMetaBlkMgrTest, random_journal_test) {
+    mtype = "Test_Rand_Journal";
+    reset_counters();
+    m_start_time = Clock::now();
+    register_client();
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.metablk.journal_size_mb = 1;
+        HS_SETTINGS_FACTORY().save();
+    });
+
+    static constexpr uint64_t sz{8 * Ki};
+    std::vector< void* > jcookies(8, nullptr);
+    std::vector< uint8_t* > bufs;
+    for (auto& cookie : jcookies) {
+        bufs.push_back(iomanager.iobuf_alloc(512, sz));
+        gen_rand_buf(bufs.back(), sz);
+        m_mbm->add_sub_sb(mtype, bufs.back(), sz, cookie);
+    }
+
+    std::random_device rd;
+    std::default_random_engine re{rd()};
+    std::uniform_int_distribution< size_t > idx_rand{0, jcookies.size() - 1};
+    for (uint32_t i{0}; i < 500; ++i) {
+        auto const idx = idx_rand(re);
+        gen_rand_buf(bufs[idx], sz);
+        m_mbm->update_sub_sb(bufs[idx], sz, jcookies[idx]);
+    }
+
+    m_mbm->remove_sub_sb(jcookies.back());
+    gen_rand_buf(bufs.back(), sz);
+    m_mbm->add_sub_sb(mtype, bufs.back(), sz, jcookies.back());
+
+    {
+        std::unique_lock< std::mutex > lg{m_mtx};
+        for (size_t i{0}; i < jcookies.size(); ++i) {
+            const auto bid = s_cast< const meta_blk* >(jcookies[i])->hdr.h.bid.to_integer();
+            m_write_sbs[bid].cookie = jcookies[i];
+            m_write_sbs[bid].str = md5_sum(r_cast< const char* >(bufs[i]), sz);
+        }
+    }
+    for (auto* buf : bufs) {
+        iomanager.iobuf_free(buf);
+    }
+
+    this->recover_with_on_complete();
+
+    this->validate();
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.metablk.journal_size_mb = 0;
+        HS_SETTINGS_FACTORY().save();
+    });
+
+    this->shutdown();
+}
+
+// 1. add, update and remove sbs in batches;
+// 2. recovery test and verify callback context data matches;
+TEST_F(VMetaBlkMgrTest, random_batch_test) {
+    mtype = "Test_Rand_Batch";
+    reset_counters();
+    m_start_time = Clock::now();
+    register_client();
+
+    for (uint32_t i{0}; i < 50; ++i) {
+        this->do_sb_batch(i % 8);
+    }
+
+    this->recover_with_on_complete();
+
+    this->validate();
+
+    this->shutdown();
+}
+
+// 1. random write, update, remove;
+// 2. recovery with small scan windows and the independent subsystems recovered in parallel, verify callback context
+// data matches;
+TEST_F(VMetaBlkMgrTest, random_parallel_recovery_test) {
+    mtype = "Test_Rand_Parallel_Recovery";
+    reset_counters();
+    m_start_time = Clock::now();
+    register_client();
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.metablk.parallel_recovery = true;
+        s.metablk.scan_readahead_blks = 4;
+        s.metablk.scan_ovf_concurrency = 2;
+        HS_SETTINGS_FACTORY().save();
+    });
+
+    this->do_rand_load();
+
+    this->recover_with_on_complete();
+
+    this->validate();
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.metablk.parallel_recovery = false;
+        s.metablk.scan_readahead_blks = 16;
+        s.metablk.scan_ovf_concurrency = 64;
+        HS_SETTINGS_FACTORY().save();
+    });
+
+    this->shutdown();
+}
+
 #ifdef _PRERELEASE // release build doens't have flip point
 //
 // 1. Turn on flip to simulate fix is not there;
@@ -939,6 +1304,29 @@ TEST_F(VMetaBlkMgrTest, CompressionBackoff) {
     this->shutdown();
 }
 
+TEST_F(VMetaBlkMgrTest, CompressionCodec) {
+    mtype = "Test_Compression_Codec";
+    reset_counters();
+    m_start_time = Clock::now();
+    this->register_client();
+
+    // medium size superblocks are below min_compress_size_mb, but compressed by the lz4 codecs
+    compressible_buf = true;
+    for (auto const codec : {meta_compress_codec_t::LZ4, meta_compress_codec_t::LZ4HC}) {
+        m_mbm->set_compress_codec(mtype, codec);
+        const auto size_written = this->do_sb_write(true /* do_overflow */, 256 * Ki);
+        ASSERT_LT(size_written, 256 * Ki) << "superblock is not compressed with codec " << enum_name(codec);
+    }
+    compressible_buf = false;
+
+    // recovery decompresses each superblock with the codec recorded in its header
+    this->recover_with_on_complete();
+
+    this->validate();
+
+    this->shutdown();
+}
+
 SISL_OPTION_GROUP(
     test_meta_blk_mgr,
     (fixed_write_size_enabled, "", "fixed_write_size_enabled", "fixed write size enabled 0 or 1",
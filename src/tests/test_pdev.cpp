@@ -13,9 +13,12 @@
  * specific language governing permissions and limitations under the License.
  *
  *********************************************************************************/
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <map>
@@ -32,6 +35,7 @@
 
 #include "device/device.h"
 #include "device/physical_dev.hpp"
+#include "device/uring_drive.hpp"
 
 using namespace homestore;
 SISL_LOGGING_INIT(HOMESTORE_LOG_MODS)
@@ -262,6 +266,40 @@ TEST_F(PDevTest, RandomChunkOpsWithRestart) {
             num_removed, available_size);
 }
 
+TEST_F(PDevTest, UringReadWrite) {
+    if (SISL_OPTIONS["spdk"].as< bool >()) { GTEST_SKIP() << "io_uring drive is not applicable for spdk"; }
+    if (!m_first_data_pdev->enable_uring()) { GTEST_SKIP() << "io_uring is not available on this system"; }
+
+    auto const align = std::max(m_first_data_pdev->align_size(), 512u);
+    auto const size = 4 * align;
+    auto const offset = m_first_data_pdev->data_start_offset();
+    auto* wbuf = r_cast< char* >(std::aligned_alloc(align, size));
+    auto* rbuf = r_cast< char* >(std::aligned_alloc(align, size));
+    std::memset(wbuf, 0xab, size);
+
+    LOGINFO("Write and read back through io_uring with regular buffers");
+    ASSERT_FALSE(m_first_data_pdev->async_write(wbuf, size, offset, false, true /* via_uring */).get());
+    ASSERT_FALSE(m_first_data_pdev->async_read(rbuf, size, offset, false, true /* via_uring */).get());
+    ASSERT_EQ(std::memcmp(wbuf, rbuf, size), 0) << "Data read through io_uring does not match";
+
+    LOGINFO("Batched write from fixed buffer and read with iomgr");
+    auto* uring = m_first_data_pdev->uring();
+    auto* fbuf = uring->alloc_fixed_buf(size);
+    if (fbuf != nullptr) {
+        std::memset(fbuf, 0xcd, size);
+        auto f = m_first_data_pdev->async_write(r_cast< char* >(fbuf), size, offset, true, true /* via_uring */);
+        m_first_data_pdev->submit_batch(true /* via_uring */);
+        ASSERT_FALSE(std::move(f).get());
+        ASSERT_GT(uring->fixed_ios(), 0u);
+        ASSERT_FALSE(m_first_data_pdev->sync_read(rbuf, size, offset));
+        ASSERT_EQ(std::memcmp(fbuf, rbuf, size), 0) << "Data written from fixed buffer does not match";
+        uring->free_fixed_buf(fbuf);
+    }
+
+    std::free(wbuf);
+    std::free(rbuf);
+}
+
 int main(int argc, char* argv[]) {
     SISL_OPTIONS_LOAD(argc, argv, logging, test_pdev, iomgr);
     ::testing::InitGoogleTest(&argc, argv);
@@ -16,6 +16,22 @@
 
 class RaftReplDevTest : public RaftReplDevTestBase {};
 
+class RaftReplDevWitnessTest : public RaftReplDevTestBase {
+public:
+    void SetUp() override {
+        // Last of the replicas of the group is the witness, which keeps only the log of the entries
+        g_helper->set_witness_replica(witness_replica());
+        RaftReplDevTestBase::SetUp();
+    }
+
+    void TearDown() override {
+        RaftReplDevTestBase::TearDown();
+        g_helper->set_witness_replica(std::nullopt);
+    }
+
+    uint16_t witness_replica() const { return SISL_OPTIONS["replicas"].as< uint32_t >() - 1; }
+};
+
 TEST_F(RaftReplDevTest, Write_Restart_Write) {
     LOGINFO("Homestore replica={} setup completed", g_helper->replica_num());
     g_helper->sync_for_test_start();
@@ -43,6 +59,92 @@ TEST_F(RaftReplDevTest, Write_Restart_Write) {
     g_helper->sync_for_cleanup_start();
 }
 
+TEST_F(RaftReplDevTest, Compressed_Journal_Entry) {
+    LOGINFO("Homestore replica={} setup completed", g_helper->replica_num());
+    g_helper->sync_for_test_start();
+
+    // Entries with a large and compressible header and key, which are compressed however small
+    uint32_t prev_min_size{0};
+    HS_SETTINGS_FACTORY().modifiable_settings([&prev_min_size](auto& s) {
+        prev_min_size = s.consensus.journal_entry_compression_min_size;
+        s.consensus.journal_entry_compression_min_size = 1;
+    });
+    HS_SETTINGS_FACTORY().save();
+    for (auto const& db : dbs_) {
+        db->set_journal_pad_size(512);
+    }
+
+    LOGINFO("Write the entries, whose header and key are verified by every replica upon commit");
+    this->write_on_leader(100, true /* wait_for_commit */);
+
+    g_helper->sync_for_verify_start();
+    LOGINFO("Validate all data written so far by reading them");
+    this->validate_data();
+    g_helper->sync_for_cleanup_start();
+
+    LOGINFO("Restart all the homestore replicas, which replay the compressed entries of their journal");
+    g_helper->restart();
+    g_helper->sync_for_test_start();
+    this->assign_leader(0);
+    this->write_on_leader(100, true /* wait_for_commit */);
+
+    g_helper->sync_for_verify_start();
+    LOGINFO("Validate all data written (including pre-restart data) by reading them");
+    this->validate_data();
+    g_helper->sync_for_cleanup_start();
+
+    for (auto const& db : dbs_) {
+        db->set_journal_pad_size(0);
+    }
+    HS_SETTINGS_FACTORY().modifiable_settings(
+        [prev_min_size](auto& s) { s.consensus.journal_entry_compression_min_size = prev_min_size; });
+    HS_SETTINGS_FACTORY().save();
+}
+
+TEST_F(RaftReplDevTest, Batched_Push_Data) {
+    LOGINFO("Homestore replica={} setup completed", g_helper->replica_num());
+    g_helper->sync_for_test_start();
+
+    LOGINFO("Coalesce the pushes of data into batches of upto 64KB");
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.consensus.push_data_batch_size_kb = 64; });
+    HS_SETTINGS_FACTORY().save();
+
+    this->write_on_leader(SISL_OPTIONS["num_io"].as< uint64_t >(), true /* wait_for_commit */);
+
+    g_helper->sync_for_verify_start();
+    LOGINFO("Validate all data pushed in batches by reading them");
+    this->validate_data();
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.consensus.push_data_batch_size_kb = 0; });
+    HS_SETTINGS_FACTORY().save();
+    g_helper->sync_for_cleanup_start();
+}
+
+TEST_F(RaftReplDevTest, Aligned_Push_Data) {
+    LOGINFO("Homestore replica={} setup completed", g_helper->replica_num());
+    g_helper->sync_for_test_start();
+
+    LOGINFO("Pad the data of all the pushes to be aligned in the rpc payload, both single and batched ones");
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.consensus.push_data_align_min_size_kb = 1; });
+    HS_SETTINGS_FACTORY().save();
+    this->write_on_leader(SISL_OPTIONS["num_io"].as< uint64_t >(), true /* wait_for_commit */);
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.consensus.push_data_batch_size_kb = 64; });
+    HS_SETTINGS_FACTORY().save();
+    this->write_on_leader(SISL_OPTIONS["num_io"].as< uint64_t >(), true /* wait_for_commit */);
+
+    g_helper->sync_for_verify_start();
+    LOGINFO("Validate all data pushed with padding by reading them");
+    this->validate_data();
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) {
+        s.consensus.push_data_align_min_size_kb = 16;
+        s.consensus.push_data_batch_size_kb = 0;
+    });
+    HS_SETTINGS_FACTORY().save();
+    g_helper->sync_for_cleanup_start();
+}
+
 #ifdef _PRERELEASE
 TEST_F(RaftReplDevTest, Follower_Fetch_OnActive_ReplicaGroup) {
     LOGINFO("Homestore replica={} setup completed", g_helper->replica_num());
@@ -61,8 +163,220 @@ TEST_F(RaftReplDevTest, Follower_Fetch_OnActive_ReplicaGroup) {
 
     g_helper->sync_for_cleanup_start();
 }
+
+TEST_F(RaftReplDevTest, Follower_Pipelined_Fetch) {
+    LOGINFO("Homestore replica={} setup completed", g_helper->replica_num());
+    g_helper->sync_for_test_start();
+
+    // Fetches of a block each, with only a couple of them outstanding, so that the rest are queued behind them
+    uint32_t prev_max_size{2 * 1024};
+    uint32_t prev_max_outstanding{8};
+    HS_SETTINGS_FACTORY().modifiable_settings([&prev_max_size, &prev_max_outstanding](auto& s) {
+        prev_max_size = s.consensus.data_fetch_max_size_kb;
+        prev_max_outstanding = s.consensus.data_fetch_max_outstanding;
+        s.consensus.data_fetch_max_size_kb = SISL_OPTIONS["block_size"].as< uint32_t >() / 1024;
+        s.consensus.data_fetch_max_outstanding = 2;
+    });
+    HS_SETTINGS_FACTORY().save();
+
+    if (g_helper->replica_num() != 0) {
+        LOGINFO("Set flip to drop the pushes, for the data to be fetched");
+        g_helper->set_basic_flip("drop_push_data_request", 100);
+    }
+    this->write_on_leader(100, true /* wait_for_commit */);
+
+    g_helper->sync_for_verify_start();
+    LOGINFO("Validate all data written so far by reading them");
+    this->validate_data();
+
+    HS_SETTINGS_FACTORY().modifiable_settings([prev_max_size, prev_max_outstanding](auto& s) {
+        s.consensus.data_fetch_max_size_kb = prev_max_size;
+        s.consensus.data_fetch_max_outstanding = prev_max_outstanding;
+    });
+    HS_SETTINGS_FACTORY().save();
+
+    g_helper->sync_for_cleanup_start();
+}
 #endif
 
+TEST_F(RaftReplDevTest, Batched_Commit) {
+    LOGINFO("Homestore replica={} setup completed", g_helper->replica_num());
+    g_helper->sync_for_test_start();
+
+    uint32_t prev_max{0};
+    HS_SETTINGS_FACTORY().modifiable_settings([&prev_max](auto& s) {
+        prev_max = s.consensus.commit_batch_max_entries;
+        s.consensus.commit_batch_max_entries = 16;
+    });
+    HS_SETTINGS_FACTORY().save();
+
+    this->write_on_leader(SISL_OPTIONS["num_io"].as< uint64_t >(), true /* wait_for_commit */);
+
+    g_helper->sync_for_verify_start();
+    LOGINFO("Validate all data written so far by reading them");
+    this->validate_data();
+    ASSERT_GT(pick_one_db()->db_batch_commit_count(), 0u) << "Entries are not committed in batches";
+
+    HS_SETTINGS_FACTORY().modifiable_settings([prev_max](auto& s) { s.consensus.commit_batch_max_entries = prev_max; });
+    HS_SETTINGS_FACTORY().save();
+
+    g_helper->sync_for_cleanup_start();
+}
+
+TEST_F(RaftReplDevTest, Parallel_Commit) {
+    LOGINFO("Homestore replica={} setup completed", g_helper->replica_num());
+    g_helper->sync_for_test_start();
+
+    uint32_t prev_max{0};
+    uint32_t prev_parallelism{0};
+    HS_SETTINGS_FACTORY().modifiable_settings([&prev_max, &prev_parallelism](auto& s) {
+        prev_max = s.consensus.commit_batch_max_entries;
+        prev_parallelism = s.consensus.commit_parallelism;
+        s.consensus.commit_batch_max_entries = 16;
+        s.consensus.commit_parallelism = 4;
+    });
+    HS_SETTINGS_FACTORY().save();
+
+    this->write_on_leader(SISL_OPTIONS["num_io"].as< uint64_t >(), true /* wait_for_commit */);
+
+    g_helper->sync_for_verify_start();
+    LOGINFO("Validate all data written so far by reading them");
+    this->validate_data();
+
+    HS_SETTINGS_FACTORY().modifiable_settings([prev_max, prev_parallelism](auto& s) {
+        s.consensus.commit_batch_max_entries = prev_max;
+        s.consensus.commit_parallelism = prev_parallelism;
+    });
+    HS_SETTINGS_FACTORY().save();
+
+    g_helper->sync_for_cleanup_start();
+}
+
+TEST_F(RaftReplDevTest, Read_Index) {
+    LOGINFO("Homestore replica={} setup completed", g_helper->replica_num());
+    g_helper->sync_for_test_start();
+
+    // Only the leader waits for the writes to be committed, the followers are to catch up through the read index
+    this->write_on_leader(SISL_OPTIONS["num_io"].as< uint64_t >(), g_helper->replica_num() == 0 /* wait_for_commit */);
+    g_helper->sync_for_verify_start();
+
+    auto db = pick_one_db();
+    auto const result = db->repl_dev()->read_index().get();
+    ASSERT_FALSE(result.hasError()) << "Read index failed with error=" << enum_name(result.error());
+    ASSERT_GE(db->db_commit_count(), written_entries_) << "Not all writes are committed after the read index";
+
+    LOGINFO("Validate all data written so far by reading them");
+    this->validate_data();
+    g_helper->sync_for_cleanup_start();
+}
+
+TEST_F(RaftReplDevTest, Hedged_Read) {
+    LOGINFO("Homestore replica={} setup completed", g_helper->replica_num());
+    g_helper->sync_for_test_start();
+
+    // Hedging is enabled at start, with a low delay so that some of the local reads are overdue
+    uint32_t prev_budget_pct;
+    uint64_t prev_min_delay_us;
+    HS_SETTINGS_FACTORY().modifiable_settings([&prev_budget_pct, &prev_min_delay_us](auto& s) {
+        prev_budget_pct = s.consensus.hedged_read_budget_pct;
+        prev_min_delay_us = s.consensus.hedged_read_min_delay_us;
+        s.consensus.hedged_read_budget_pct = 100;
+        s.consensus.hedged_read_min_delay_us = 50;
+    });
+    HS_SETTINGS_FACTORY().save();
+    g_helper->restart();
+    g_helper->sync_for_test_start();
+    this->assign_leader(0);
+
+    this->write_on_leader(SISL_OPTIONS["num_io"].as< uint64_t >(), true /* wait_for_commit */);
+    g_helper->sync_for_verify_start();
+
+    LOGINFO("Validate all data written so far by hedged reads of them");
+    this->validate_data(true /* hedged */);
+    g_helper->sync_for_cleanup_start();
+
+    HS_SETTINGS_FACTORY().modifiable_settings([prev_budget_pct, prev_min_delay_us](auto& s) {
+        s.consensus.hedged_read_budget_pct = prev_budget_pct;
+        s.consensus.hedged_read_min_delay_us = prev_min_delay_us;
+    });
+    HS_SETTINGS_FACTORY().save();
+}
+
+TEST_F(RaftReplDevTest, Quiesce_Idle_Group) {
+    LOGINFO("Homestore replica={} setup completed", g_helper->replica_num());
+    g_helper->sync_for_test_start();
+
+    uint32_t prev_idle_ms{0};
+    HS_SETTINGS_FACTORY().modifiable_settings([&prev_idle_ms](auto& s) {
+        prev_idle_ms = s.consensus.quiesce_idle_ms;
+        s.consensus.quiesce_idle_ms = 2000;
+    });
+    HS_SETTINGS_FACTORY().save();
+
+    // Group is idle for longer than the quiesce idle time, with the checks every second
+    std::this_thread::sleep_for(std::chrono::seconds{5});
+    auto rdev = std::dynamic_pointer_cast< RaftReplDev >(pick_one_db()->repl_dev());
+    ASSERT_TRUE(rdev->is_quiesced()) << "Idle group is not quiesced";
+    g_helper->sync_for_verify_start();
+    g_helper->sync_for_test_start();
+
+    // Writes wake up the group
+    this->write_on_leader(SISL_OPTIONS["num_io"].as< uint64_t >(), true /* wait_for_commit */);
+    g_helper->sync_for_verify_start();
+    ASSERT_FALSE(rdev->is_quiesced()) << "Group is still quiesced after the writes";
+
+    LOGINFO("Validate all data written so far by reading them");
+    this->validate_data();
+
+    HS_SETTINGS_FACTORY().modifiable_settings([prev_idle_ms](auto& s) { s.consensus.quiesce_idle_ms = prev_idle_ms; });
+    HS_SETTINGS_FACTORY().save();
+    g_helper->sync_for_cleanup_start();
+}
+
+TEST_F(RaftReplDevTest, Shared_Logdev) {
+    LOGINFO("Homestore replica={} setup completed", g_helper->replica_num());
+
+    uint32_t prev_per_logdev{1};
+    HS_SETTINGS_FACTORY().modifiable_settings([&prev_per_logdev](auto& s) {
+        prev_per_logdev = s.consensus.repl_devs_per_logdev;
+        s.consensus.repl_devs_per_logdev = 2;
+    });
+    HS_SETTINGS_FACTORY().save();
+
+    // Repl devs created from now on share a logdev, two of them to each
+    LOGINFO("Create 2 more ReplDevs sharing a logdev");
+    for (uint32_t i{0}; i < 2; ++i) {
+        auto db = std::make_shared< TestReplicatedDB >();
+        g_helper->register_listener(db);
+        this->dbs_.emplace_back(std::move(db));
+    }
+    g_helper->sync_for_test_start();
+
+    auto rdev1 = std::dynamic_pointer_cast< RaftReplDev >(dbs_[dbs_.size() - 2]->repl_dev());
+    auto rdev2 = std::dynamic_pointer_cast< RaftReplDev >(dbs_.back()->repl_dev());
+    ASSERT_EQ(rdev1->get_logdev_id(), rdev2->get_logdev_id()) << "Repl devs do not share the logdev";
+    ASSERT_NE(rdev1->get_logstore_id(), rdev2->get_logstore_id()) << "Repl devs share the logstore";
+
+    for (auto const& db : dbs_) {
+        this->write_on_leader(SISL_OPTIONS["num_io"].as< uint64_t >(), true /* wait_for_commit */, db);
+    }
+    g_helper->sync_for_verify_start();
+    LOGINFO("Validate all data written so far by reading them");
+    this->validate_data();
+
+    // Each logstore is truncated on its own, without affecting the other one in the logdev
+    dbs_[dbs_.size() - 2]->truncate(0);
+    this->write_on_leader(SISL_OPTIONS["num_io"].as< uint64_t >(), true /* wait_for_commit */, dbs_.back());
+    g_helper->sync_for_test_start();
+    g_helper->sync_for_verify_start();
+    this->validate_data();
+
+    HS_SETTINGS_FACTORY().modifiable_settings(
+        [prev_per_logdev](auto& s) { s.consensus.repl_devs_per_logdev = prev_per_logdev; });
+    HS_SETTINGS_FACTORY().save();
+    g_helper->sync_for_cleanup_start();
+}
+
 // do some io before restart;
 TEST_F(RaftReplDevTest, Follower_Incremental_Resync) {
     LOGINFO("Homestore replica={} setup completed", g_helper->replica_num());
@@ -385,6 +699,109 @@ TEST_F(RaftReplDevTest, BaselineTest) {
     LOGINFO("BaselineTest done");
 }
 
+TEST_F(RaftReplDevWitnessTest, Witness_Commit) {
+    LOGINFO("Homestore replica={} setup completed", g_helper->replica_num());
+    g_helper->sync_for_test_start();
+
+    this->assign_leader(0);
+    this->write_on_leader(100, true /* wait_for_commit */);
+
+    g_helper->sync_for_verify_start();
+    auto const [with_data, no_local_data] = this->pick_one_db()->db_data_count();
+    if (g_helper->replica_num() == witness_replica()) {
+        LOGINFO("Witness committed all entries without storing the data of any of them");
+        ASSERT_TRUE(this->pick_one_db()->repl_dev()->is_witness());
+        ASSERT_EQ(no_local_data, with_data);
+    } else {
+        ASSERT_FALSE(this->pick_one_db()->repl_dev()->is_witness());
+        ASSERT_EQ(no_local_data, 0u);
+    }
+
+    LOGINFO("Validate all data written so far by reading them");
+    this->validate_data();
+    g_helper->sync_for_cleanup_start();
+}
+
+TEST_F(RaftReplDevWitnessTest, Witness_Yields_Leadership) {
+    LOGINFO("Homestore replica={} setup completed", g_helper->replica_num());
+    g_helper->sync_for_test_start();
+
+    this->assign_leader(0);
+    this->write_on_leader(20, true /* wait_for_commit */);
+
+    g_helper->sync_for_verify_start();
+    auto db = this->pick_one_db();
+    if (g_helper->replica_num() == witness_replica()) {
+        LOGINFO("Witness takes over the leadership, which it is expected to yield right away");
+        auto result = db->repl_dev()->become_leader().get();
+        LOGINFO("Witness requested the leadership, has_error={}", result.hasError());
+    }
+    g_helper->sync_for_test_start();
+
+    while (true) {
+        auto const leader_uuid = db->repl_dev()->get_leader_id();
+        if (!leader_uuid.is_nil() && (g_helper->member_id(leader_uuid) != witness_replica())) { break; }
+        LOGINFO("Waiting for a full member to become leader");
+        std::this_thread::sleep_for(std::chrono::milliseconds{500});
+    }
+    if (g_helper->replica_num() == witness_replica()) { ASSERT_FALSE(db->repl_dev()->is_leader()); }
+
+    LOGINFO("Write on the new leader, which has to be one of the full members");
+    this->write_on_leader(20, true /* wait_for_commit */);
+
+    g_helper->sync_for_verify_start();
+    LOGINFO("Validate all data written so far by reading them");
+    this->validate_data();
+    g_helper->sync_for_cleanup_start();
+}
+
+TEST_F(RaftReplDevWitnessTest, Witness_Promote_Read) {
+    LOGINFO("Homestore replica={} setup completed", g_helper->replica_num());
+    g_helper->sync_for_test_start();
+
+    this->assign_leader(0);
+    this->write_on_leader(50, true /* wait_for_commit */);
+
+    g_helper->sync_for_verify_start();
+    auto db = this->pick_one_db();
+    auto const [pre_with_data, pre_no_local_data] = db->db_data_count();
+    if (g_helper->replica_num() == witness_replica()) {
+        LOGINFO("Promote the witness to a full member");
+        ASSERT_EQ(db->repl_dev()->promote_witness(), ReplServiceError::OK);
+        ASSERT_FALSE(db->repl_dev()->is_witness());
+        ASSERT_EQ(pre_no_local_data, pre_with_data);
+    }
+    g_helper->sync_for_test_start();
+
+    LOGINFO("Write on the leader after the promotion");
+    this->write_on_leader(50, true /* wait_for_commit */);
+
+    g_helper->sync_for_verify_start();
+    if (g_helper->replica_num() == witness_replica()) {
+        // Promotion doesn't fetch the data of the entries committed before it, only the later ones are stored
+        auto const [with_data, no_local_data] = db->db_data_count();
+        ASSERT_EQ(no_local_data, pre_no_local_data);
+        ASSERT_GT(with_data, pre_with_data);
+    }
+    LOGINFO("Validate all data written after the promotion by reading them");
+    this->validate_data();
+    g_helper->sync_for_cleanup_start();
+
+    LOGINFO("Restart the promoted replica, which stays a full member");
+    this->restart_replica(witness_replica());
+    g_helper->sync_for_test_start();
+    if (g_helper->replica_num() == witness_replica()) { ASSERT_FALSE(db->repl_dev()->is_witness()); }
+
+    LOGINFO("Switch the leader to the promoted replica and write the data on it");
+    this->assign_leader(witness_replica());
+    this->write_on_leader(50, true /* wait_for_commit */);
+
+    g_helper->sync_for_verify_start();
+    LOGINFO("Validate all data written so far by reading them");
+    this->validate_data();
+    g_helper->sync_for_cleanup_start();
+}
+
 int main(int argc, char* argv[]) {
     int parsed_argc = argc;
     char** orig_argv = argv;
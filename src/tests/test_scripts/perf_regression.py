@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+## @file perf_regression.py
+#
+# Runs the benchmarks with fixed seeds and args, and compares their throughput and latencies with a stored baseline.
+# Exits with 1 if any of them regressed beyond the tolerance, so that changes to the hot paths can be gated on it.
+#
+#   perf_regression.py --dirpath=bin/ --update_baseline   # record the baseline, on the commit to compare against
+#   perf_regression.py --dirpath=bin/                      # compare the current build against it
+
+import argparse
+import json
+import os
+import statistics
+import subprocess
+import sys
+
+sys.stdout.flush()
+
+# Benchmark binary and its args of each suite. Args are fixed, along with the seed, so that the runs of a suite do the
+# same ops across the builds.
+suites = {
+    'log_store': {'bin': 'log_store_benchmark', 'args': ''},
+    'index_btree': {'bin': 'index_btree_benchmark', 'args': ''},
+    'blk_alloc': {'bin': 'blk_alloc_benchmark', 'args': ''},
+    'data_svc': {'bin': 'data_svc_benchmark', 'args': '--num_ios=100000 --working_set_mb=512'},
+    'raft_repl': {'bin': 'raft_repl_dev_benchmark', 'args': '--replicas=3 --run_time_secs=30', 'no_seed': True,
+                  'json_suffix': '.replica0'},
+}
+
+# Metrics compared, by their name within the results of a benchmark. Max latencies are left out, being too noisy.
+higher_is_better = {'items_per_second', 'bytes_per_second', 'iops', 'rate', 'bandwidth_mbps'}
+higher_is_better_suffixes = ('_rate', '_per_sec')
+lower_is_better_suffixes = ('_p50_us', '_p90_us', '_p99_us', '_p999_us', 'recovery_us', 'time_ms')
+lower_is_better = {'p50_us', 'p90_us', 'p99_us', 'p999_us'}
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(description='Run the benchmarks and compare them with the baseline.')
+    parser.add_argument('-t', '--test_suits', help='Comma separated suites to run, all if empty', default='')
+    parser.add_argument('-d', '--dirpath', help='Directory path of the benchmark binaries', default='bin/')
+    parser.add_argument('-b', '--baseline', help='Baseline file', default='perf_baseline.json')
+    parser.add_argument('-o', '--outdir', help='Directory for the results of the runs', default='perf_results')
+    parser.add_argument('-u', '--update_baseline', help='Store the results as the baseline', action='store_true')
+    parser.add_argument('-s', '--seed', help='Seed of the random engines of the benchmarks', type=int, default=1234)
+    parser.add_argument('-r', '--repetitions', help='Runs of each suite, the median of which is taken', type=int,
+                        default=3)
+    parser.add_argument('--throughput_tolerance_pct', help='Drop of throughput tolerated', type=float, default=10.0)
+    parser.add_argument('--latency_tolerance_pct', help='Rise of latency tolerated', type=float, default=20.0)
+    parser.add_argument('-c', '--commit', help='Commit id recorded in the results', default='')
+    parser.add_argument('-l', '--dev_list', help='Device list', default='')
+    args, unknown = parser.parse_known_args()
+
+    addln_opts = ''
+    if args.dev_list:
+        addln_opts += f' --device_list {args.dev_list}'
+    if args.commit:
+        addln_opts += f' --commit={args.commit}'
+    return args, addln_opts
+
+
+def direction(metric):
+    if (metric in higher_is_better) or metric.endswith(higher_is_better_suffixes):
+        return 1
+    if (metric in lower_is_better) or metric.endswith(lower_is_better_suffixes):
+        return -1
+    return 0
+
+
+def flatten(prefix, j, out):
+    for k, v in j.items():
+        name = f'{prefix}.{k}' if prefix else k
+        if isinstance(v, dict):
+            flatten(name, v, out)
+        elif isinstance(v, (int, float)) and direction(k) != 0:
+            out[name] = float(v)
+
+
+# Metrics of the results of a run, by benchmark name. Google benchmark json has a list of the benchmarks with their
+# counters, the raft benchmark has its own json of phases.
+def parse_results(path):
+    with open(path) as f:
+        j = json.load(f)
+
+    results = {}
+    if 'benchmarks' in j:
+        for bm in j['benchmarks']:
+            if bm.get('run_type') == 'aggregate' or bm.get('error_occurred'):
+                continue
+            metrics = {}
+            flatten('', {k: v for k, v in bm.items() if not isinstance(v, dict)}, metrics)
+            results[bm['name']] = metrics
+    else:
+        for phase, pj in j.items():
+            if isinstance(pj, dict):
+                metrics = {}
+                flatten('', pj, metrics)
+                results[phase] = metrics
+    return results
+
+
+def run_suite(name, suite, options, addln_opts):
+    runs = []
+    for i in range(options.repetitions):
+        json_out = os.path.join(options.outdir, f'{name}.{i}.json')
+        cmd = f'{options.dirpath}{suite["bin"]} {suite["args"]} --json_out={json_out}'
+        if not suite.get('no_seed'):
+            cmd += f' --seed={options.seed}'
+        print(f'Running {cmd}{addln_opts}')
+        subprocess.check_call(cmd + addln_opts, stderr=subprocess.STDOUT, shell=True)
+        runs.append(parse_results(json_out + suite.get('json_suffix', '')))
+
+    # Median of each metric across the runs
+    results = {}
+    for bm in runs[0]:
+        results[bm] = {}
+        for metric in runs[0][bm]:
+            values = [r[bm][metric] for r in runs if metric in r.get(bm, {})]
+            results[bm][metric] = statistics.median(values)
+    return results
+
+
+def compare(name, results, baseline, options):
+    regressions = []
+    for bm, metrics in results.items():
+        base = baseline.get(bm)
+        if base is None:
+            print(f'[{name}] {bm}: not in baseline, skipping')
+            continue
+        for metric, value in metrics.items():
+            if (metric not in base) or (base[metric] == 0):
+                continue
+            change_pct = (value - base[metric]) * 100.0 / base[metric]
+            d = direction(metric.split('.')[-1])
+            if d > 0:
+                regressed = (-change_pct > options.throughput_tolerance_pct)
+            else:
+                regressed = (change_pct > options.latency_tolerance_pct)
+            line = f'[{name}] {bm} {metric}: baseline={base[metric]:.2f} current={value:.2f} ({change_pct:+.1f}%)'
+            if regressed:
+                regressions.append(line)
+                print('REGRESSION ' + line)
+            else:
+                print(line)
+    return regressions
+
+
+def main():
+    options, addln_opts = parse_arguments()
+    os.makedirs(options.outdir, exist_ok=True)
+
+    names = options.test_suits.split(',') if options.test_suits else list(suites.keys())
+    for name in names:
+        if name not in suites:
+            print(f"Unknown test suite: {name}")
+            sys.exit(1)
+
+    baseline = {}
+    if os.path.exists(options.baseline):
+        with open(options.baseline) as f:
+            baseline = json.load(f)
+    elif not options.update_baseline:
+        print(f'Baseline {options.baseline} not found, run with --update_baseline first')
+        sys.exit(1)
+
+    regressions = []
+    for name in names:
+        results = run_suite(name, suites[name], options, addln_opts)
+        if options.update_baseline:
+            baseline[name] = results
+        else:
+            regressions += compare(name, results, baseline.get(name, {}), options)
+
+    if options.update_baseline:
+        with open(options.baseline, 'w') as f:
+            json.dump(baseline, f, indent=4, sort_keys=True)
+        print(f'Baseline of suites {names} is stored in {options.baseline}')
+        return
+
+    if regressions:
+        print(f'{len(regressions)} metrics regressed beyond the tolerance:')
+        for line in regressions:
+            print(line)
+        sys.exit(1)
+    print('No regressions found')
+
+
+if __name__ == "__main__":
+    main()
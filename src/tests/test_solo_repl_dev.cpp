@@ -308,6 +308,45 @@ TEST_F(SoloReplDevTest, TestHeaderOnly) {
     this->m_task_waiter.start([this]() { this->restart(); }).get();
 }
 
+TEST_F(SoloReplDevTest, TestBatchedJournal) {
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.consensus.solo_journal_batch_max_entries = 16; });
+    HS_SETTINGS_FACTORY().save();
+
+    LOGINFO("Step 1: run on worker threads to schedule writes, journaled and committed in batches");
+    this->m_io_runner.set_task([this]() {
+        uint32_t nblks = rand() % ((64 * Ki) / g_block_size);
+        uint32_t key_size = rand() % 512 + 8;
+        this->write_io(key_size, nblks * g_block_size, g_block_size);
+    });
+    this->m_io_runner.execute().get();
+
+    LOGINFO("Step 2: Restart homestore and validate replay of the batched entries");
+    this->m_task_waiter.start([this]() { this->restart(); }).get();
+
+    HS_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.consensus.solo_journal_batch_max_entries = 0; });
+    HS_SETTINGS_FACTORY().save();
+}
+
+TEST_F(SoloReplDevTest, TestPooledReq) {
+    // Released request is reused by the next one on the same thread, reset but keeping its builder capacity
+    repl_req_ctx* first{nullptr};
+    {
+        auto rreq = repl_req_ctx::make_pooled();
+        first = rreq.get();
+        auto& builder = rreq->create_fb_builder();
+        builder.Finish(builder.CreateString(std::string(1024, 'a')));
+        rreq->release_fb_builder();
+        ASSERT_EQ(rreq->use_count(), 1u);
+    }
+
+    auto rreq = repl_req_ctx::make_pooled();
+    ASSERT_EQ(rreq.get(), first) << "Released request is not reused";
+    ASSERT_EQ(rreq->lsn(), -1);
+    ASSERT_EQ(rreq->state(), repl_req_state_t::INIT);
+    ASSERT_EQ(rreq->journal_entry(), nullptr);
+    ASSERT_EQ(rreq->create_fb_builder().GetSize(), 0u);
+}
+
 SISL_OPTION_GROUP(test_solo_repl_dev,
                   (block_size, "", "block_size", "block size to io",
                    ::cxxopts::value< uint32_t >()->default_value("4096"), "number"));